@@ -0,0 +1,19 @@
+#if __VERSION__ >= 330
+layout(location=0) in vec2 Position;
+layout(location=2) in vec4 Color;
+layout(location=3) in vec2 Texcoord;
+#else
+in vec2 Position;
+in vec4 Color;
+in vec2 Texcoord;
+#endif
+
+out vec2 uv;
+out vec4 col;
+
+void main()
+{
+    col = Color.zyxw;
+    uv = Texcoord;
+    gl_Position = vec4(Position, 0., 1.);
+}
@@ -0,0 +1,34 @@
+// Upsamples a texture rendered at a lower resolution. The four nearest
+// texels are weighted by their bilinear weight and by how close their depth
+// is to the depth of the pixel, so that occlusion doesn't bleed across
+// depth discontinuities.
+
+uniform sampler2D source;
+uniform sampler2D depth;
+uniform vec2 pixel;
+uniform vec2 source_pixel;
+uniform float source_lod;
+
+out vec4 FragColor;
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy * pixel;
+    float pixel_depth = textureLod(depth, uv, 0.).x;
+
+    vec2 texel = uv / source_pixel - 0.5;
+    vec2 base = floor(texel);
+    vec2 f = texel - base;
+
+    float sum = 0., total_weight = 0.;
+    for (int i = 0; i < 4; i++) {
+        vec2 offset = vec2(float(i & 1), float(i >> 1));
+        vec2 tap_uv = (base + offset + 0.5) * source_pixel;
+        vec2 bilinear = mix(1. - f, f, offset);
+        float tap_depth = textureLod(depth, tap_uv, source_lod).x;
+        float weight = bilinear.x * bilinear.y / (.001 + abs(tap_depth - pixel_depth));
+        sum += textureLod(source, tap_uv, 0.).x * weight;
+        total_weight += weight;
+    }
+    FragColor = vec4(sum / total_weight);
+}
@@ -0,0 +1,16 @@
+// Draws a quad from a signed distance field stored in the alpha channel,
+// e.g. the glyphs of distance field fonts. The edge is where the distance
+// is 0.5, and it is antialiased over about one pixel at any scale.
+uniform sampler2D tex;
+
+in vec2 uv;
+in vec4 col;
+out vec4 FragColor;
+
+void main()
+{
+    float distance = texture(tex, uv).a;
+    float width = max(fwidth(distance), 0.0001);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    FragColor = vec4(col.rgb, col.a * alpha);
+}
@@ -0,0 +1,30 @@
+layout(location = 0) in vec3 Position;
+layout(location = 1) in vec3 Normal;
+layout(location = 2) in vec4 Color;
+layout(location = 3) in vec2 Texcoord;
+
+layout(location = 7) in vec3 Origin;
+layout(location = 8) in vec3 Orientation;
+layout(location = 9) in vec3 Scale;
+// Layer of the textures in the texture arrays
+layout(location = 10) in uvec2 Layer;
+
+out vec3 nor;
+out vec2 uv;
+out vec4 color;
+flat out float layer;
+
+mat4 getWorldMatrix(vec3 translation, vec3 rotation, vec3 scale);
+mat4 getInverseWorldMatrix(vec3 translation, vec3 rotation, vec3 scale);
+
+void main(void)
+{
+    mat4 ModelMatrix = getWorldMatrix(Origin, Orientation, Scale);
+    mat4 TransposeInverseModelView = transpose(getInverseWorldMatrix(Origin, Orientation, Scale) * InverseViewMatrix);
+    gl_Position = ProjectionViewMatrix *  ModelMatrix * vec4(Position, 1.);
+    // Keep orthogonality
+    nor = (TransposeInverseModelView * vec4(Normal, 0.)).xyz;
+    uv = Texcoord;
+    color = Color.zyxw;
+    layer = float(Layer.x);
+}
@@ -0,0 +1,15 @@
+uniform sampler2DArray glosstex;
+
+in vec3 nor;
+in vec2 uv;
+flat in float layer;
+out vec3 EncodedNormal;
+
+vec2 EncodeNormal(vec3 n);
+
+void main(void)
+{
+    float glossmap = texture(glosstex, vec3(uv, layer)).x;
+    EncodedNormal.xy = 0.5 * EncodeNormal(normalize(nor)) + 0.5;
+    EncodedNormal.z = glossmap;
+}
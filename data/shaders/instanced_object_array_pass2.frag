@@ -0,0 +1,19 @@
+uniform sampler2DArray Albedo;
+uniform sampler2DArray SpecMap;
+
+in vec2 uv;
+in vec4 color;
+flat in float layer;
+out vec4 FragColor;
+
+vec3 getLightFactor(vec3 diffuseMatColor, vec3 specularMatColor, float specMapValue, float emitMapValue);
+
+void main(void)
+{
+    vec4 col = texture(Albedo, vec3(uv, layer));
+    float specmap = texture(SpecMap, vec3(uv, layer)).g;
+    float emitmap = texture(SpecMap, vec3(uv, layer)).b;
+    col.xyz *= pow(color.xyz, vec3(2.2));
+
+    FragColor = vec4(getLightFactor(col.xyz, vec3(1.), specmap, emitmap) , 1.);
+}
@@ -0,0 +1,77 @@
+// Shades a pixel with all point lights of its cluster (see lightcluster.comp).
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 63
+
+uniform sampler2D ntex;
+uniform sampler2D dtex;
+uniform float zn;
+uniform float zf;
+
+struct PointLight
+{
+    vec4 position_energy;
+    vec4 color_radius;
+};
+
+layout (std430) buffer PointLights
+{
+    PointLight lights[];
+};
+
+layout (std430) buffer LightClusters
+{
+    uint clusters[];
+};
+
+out vec4 Diff;
+out vec4 Spec;
+
+vec3 DecodeNormal(vec2 n);
+vec3 SpecularBRDF(vec3 normal, vec3 eyedir, vec3 lightdir, vec3 color, float roughness);
+vec3 DiffuseBRDF(vec3 normal, vec3 eyedir, vec3 lightdir, vec3 color, float roughness);
+vec4 getPosFromUVDepth(vec3 uvDepth, mat4 InverseProjectionMatrix);
+
+void main()
+{
+    vec2 texc = gl_FragCoord.xy / screen;
+    float z = texture(dtex, texc).x;
+    vec4 xpos = getPosFromUVDepth(vec3(texc, z), InverseProjectionMatrix);
+
+    uvec2 tile = uvec2(clamp(texc * vec2(CLUSTER_X, CLUSTER_Y), vec2(0.), vec2(CLUSTER_X - 1, CLUSTER_Y - 1)));
+    float slice = log(max(xpos.z, zn) / zn) / log(zf / zn) * float(CLUSTER_Z);
+    uint cluster = (uint(clamp(slice, 0., float(CLUSTER_Z - 1))) * uint(CLUSTER_Y) + tile.y) * uint(CLUSTER_X) + tile.x;
+    uint offset = cluster * uint(MAX_LIGHTS_PER_CLUSTER + 1);
+    uint count = clusters[offset];
+    if (count == 0u) discard;
+
+    vec3 norm = normalize(DecodeNormal(2. * texture(ntex, texc).xy - 1.));
+    float roughness = texture(ntex, texc).z;
+    vec3 eyedir = -normalize(xpos.xyz);
+
+    vec3 diffuse = vec3(0.);
+    vec3 specular = vec3(0.);
+    for (uint i = 0u; i < count; i++)
+    {
+        PointLight light = lights[clusters[offset + 1u + i]];
+        vec4 pseudocenter = ViewMatrix * vec4(light.position_energy.xyz, 1.0);
+        vec3 light_pos = pseudocenter.xyz / pseudocenter.w;
+        float radius = light.color_radius.w;
+        float d = distance(light_pos, xpos.xyz);
+        float att = light.position_energy.w * 20. / (1. + d * d);
+        att *= (radius - d) / radius;
+        if (att <= 0.) continue;
+
+        // Light Direction
+        vec3 L = -normalize(xpos.xyz - light_pos);
+
+        float NdotL = clamp(dot(norm, L), 0., 1.);
+        vec3 light_col = light.color_radius.xyz * NdotL * att;
+        specular += SpecularBRDF(norm, eyedir, L, vec3(1.), roughness) * light_col;
+        diffuse += DiffuseBRDF(norm, eyedir, L, vec3(1.), roughness) * light_col;
+    }
+
+    Diff = vec4(diffuse, 1.);
+    Spec = vec4(specular, 1.);
+}
@@ -0,0 +1,30 @@
+uniform sampler2D tex;
+
+uniform float fogmax;
+uniform float startH;
+uniform float endH;
+uniform float start;
+uniform float end;
+uniform vec3 col;
+
+in vec2 uv;
+in vec4 color;
+out vec4 FragColor;
+
+void main()
+{
+    vec4 diffusecolor = texture(tex, uv);
+    diffusecolor.xyz *= pow(color.xyz, vec3(2.2));
+    diffusecolor.a *= color.a;
+
+    // fogmax is 0 if the track has no fog
+    vec3 tmp = vec3(gl_FragCoord.xy / screen, gl_FragCoord.z);
+    tmp = 2. * tmp - 1.;
+    vec4 xpos = vec4(tmp, 1.0);
+    xpos = InverseProjectionMatrix * xpos;
+    xpos.xyz /= xpos.w;
+    float fog = min(smoothstep(start, end, length(xpos.xyz)), fogmax);
+
+    vec4 finalcolor = vec4(col, 0.) * fog + diffusecolor * (1. - fog);
+    FragColor = vec4(finalcolor.rgb * finalcolor.a, finalcolor.a);
+}
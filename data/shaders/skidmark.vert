@@ -0,0 +1,29 @@
+uniform float time;
+uniform float fade_time;
+
+in vec4 Start;
+in vec4 End;
+in vec4 StartSide;
+in vec4 EndSide;
+in float BirthTime;
+in vec4 Color;
+
+out vec2 uv;
+out vec4 color;
+
+void main(void)
+{
+    // The 4 vertices of the strip are the left and right corners of the
+    // start cross section, then of the end cross section.
+    bool is_end = gl_VertexID >= 2;
+    float side = (gl_VertexID & 1) == 0 ? -1. : 1.;
+    vec4 center = is_end ? End : Start;
+    vec4 half_width = is_end ? EndSide : StartSide;
+
+    gl_Position = ProjectionMatrix * ViewMatrix * vec4(center.xyz + side * half_width.xyz, 1.);
+    uv = vec2(.5 + .5 * side, center.w);
+
+    float fade = clamp(1. - (time - BirthTime) / fade_time, 0., 1.);
+    color = Color.zyxw;
+    color.a *= half_width.w * fade;
+}
@@ -0,0 +1,33 @@
+// Adds the blurred bloom and lens flare to the scene and tonemaps it in one
+// pass. The lens flare is the brightest channel of the horizontally blurred
+// copies of the bloom, tinted blue (lens flare blend by samuncle).
+uniform sampler2D tex;
+uniform sampler2D bloom_128;
+uniform sampler2D bloom_256;
+uniform sampler2D bloom_512;
+uniform sampler2D lens_128;
+uniform sampler2D lens_256;
+uniform sampler2D lens_512;
+uniform float vignette_weight;
+
+out vec4 FragColor;
+
+vec4 toneMap(vec4 col, vec2 uv, float vignette_weight);
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / screen;
+    vec4 col = texture(tex, uv);
+
+    vec3 bloom = .125 * texture(bloom_128, uv).xyz;
+    bloom += .25 * texture(bloom_256, uv).xyz;
+    bloom += .5 * texture(bloom_512, uv).xyz;
+
+    vec3 lens = .125 * texture(lens_128, uv).xyz;
+    lens += .25 * texture(lens_256, uv).xyz;
+    lens += .5 * texture(lens_512, uv).xyz;
+    float final = max(lens.r, max(lens.g, lens.b));
+
+    col.xyz += bloom + vec3(final * 0.1, final * 0.2, final);
+    FragColor = toneMap(col, uv, vignette_weight);
+}
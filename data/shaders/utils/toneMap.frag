@@ -0,0 +1,12 @@
+// Uncharted2 tonemap with Auria's custom coefficients, and vignette
+vec4 toneMap(vec4 col, vec2 uv, float vignette_weight)
+{
+    vec4 perChannel = (col * (6.9 * col + .5)) / (col * (5.2 * col + 1.7) + 0.06);
+    perChannel = pow(perChannel, vec4(2.2));
+
+    vec2 inside = uv - 0.5;
+    float vignette = 1. - dot(inside, inside) * vignette_weight;
+    vignette = clamp(pow(vignette, 0.8), 0., 1.);
+
+    return vec4(perChannel.xyz * vignette, col.a);
+}
@@ -0,0 +1,7 @@
+in vec4 color;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = color;
+}
@@ -49,7 +49,9 @@ namespace scene
 			: RelativeTranslation(position), RelativeRotation(rotation), RelativeScale(scale),
 				Parent(0), SceneManager(mgr), TriangleSelector(0), ID(id),
 				AutomaticCullingState(EAC_BOX), DebugDataVisible(EDS_OFF),
-				IsVisible(true), IsDebugObject(false)
+				IsVisible(true), IsDebugObject(false),
+				TransformationRevision(0), ParentTransformationRevision(0),
+				AlwaysUpdateAbsolutePosition(false)
 		{
 			if (parent)
 				parent->addChild(this);
@@ -648,9 +650,27 @@ namespace scene
 
 		//! Updates the absolute position based on the relative and the parents position
 		/** Note: This does not recursively update the parents absolute positions, so if you have a deeper
-			hierarchy you might want to update the parents first.*/
+			hierarchy you might want to update the parents first.
+			The absolute transformation is only recalculated if the relative
+			translation, rotation or scale or the absolute transformation of
+			the parent changed since the last call, so that static nodes cost
+			next to nothing each frame.*/
 		virtual void updateAbsolutePosition()
 		{
+			const u32 parentRevision = Parent ? Parent->TransformationRevision : 0;
+			if (TransformationRevision != 0 && !AlwaysUpdateAbsolutePosition &&
+				parentRevision == ParentTransformationRevision &&
+				equalsExactly(RelativeTranslation, LastRelativeTranslation) &&
+				equalsExactly(RelativeRotation, LastRelativeRotation) &&
+				equalsExactly(RelativeScale, LastRelativeScale))
+				return;
+
+			LastRelativeTranslation = RelativeTranslation;
+			LastRelativeRotation = RelativeRotation;
+			LastRelativeScale = RelativeScale;
+			ParentTransformationRevision = parentRevision;
+			TransformationRevision = nextTransformationRevision();
+
 			if (Parent)
 			{
 				AbsoluteTransformation =
@@ -661,6 +681,16 @@ namespace scene
 		}
 
 
+		//! Returns the revision of the absolute transformation.
+		/** The revision changes each time the absolute transformation is
+		recalculated, so it can be used to detect that a node moved.
+		\return The revision, unique among all nodes. */
+		u32 getTransformationRevision() const
+		{
+			return TransformationRevision;
+		}
+
+
 		//! Returns the parent of this scene node
 		/** \return A pointer to the parent. */
 		scene::ISceneNode* getParent() const
@@ -761,6 +791,8 @@ namespace scene
 			RelativeTranslation = toCopyFrom->RelativeTranslation;
 			RelativeRotation = toCopyFrom->RelativeRotation;
 			RelativeScale = toCopyFrom->RelativeScale;
+			TransformationRevision = 0;
+			AlwaysUpdateAbsolutePosition = toCopyFrom->AlwaysUpdateAbsolutePosition;
 			ID = toCopyFrom->ID;
 			setTriangleSelector(toCopyFrom->TriangleSelector);
 			AutomaticCullingState = toCopyFrom->AutomaticCullingState;
@@ -848,6 +880,38 @@ namespace scene
 
 		//! Is debug object?
 		bool IsDebugObject;
+
+		//! Relative transformation the absolute transformation was last calculated from.
+		core::vector3df LastRelativeTranslation;
+		core::vector3df LastRelativeRotation;
+		core::vector3df LastRelativeScale;
+
+		//! Revision of the absolute transformation, 0 if it was never calculated.
+		u32 TransformationRevision;
+
+		//! Revision of the parent's absolute transformation it was last calculated from.
+		u32 ParentTransformationRevision;
+
+		//! Set by nodes whose relative transformation is not stored in
+		//! RelativeTranslation, RelativeRotation and RelativeScale.
+		bool AlwaysUpdateAbsolutePosition;
+
+		//! Compares two vectors without tolerance, so that small moves
+		//! are not lost.
+		static bool equalsExactly(const core::vector3df& a, const core::vector3df& b)
+		{
+			return a.X == b.X && a.Y == b.Y && a.Z == b.Z;
+		}
+
+		//! Returns a new revision for an absolute transformation, to be used
+		//! by nodes which override updateAbsolutePosition.
+		static u32 nextTransformationRevision()
+		{
+			static u32 revision = 0;
+			if (++revision == 0)
+				revision = 1;
+			return revision;
+		}
 	};
 
 
@@ -20,6 +20,8 @@ CDummyTransformationSceneNode::CDummyTransformationSceneNode(
 	#endif
 
 	setAutomaticCulling(scene::EAC_OFF);
+	// The relative transformation matrix can be changed at any time
+	AlwaysUpdateAbsolutePosition = true;
 }
 
 
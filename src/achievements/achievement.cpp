@@ -171,24 +171,6 @@ void Achievement::increase(const std::string & key,
     check();
 }   // increase
 
-// ----------------------------------------------------------------------------
-/** Called at the end of a race to potentially reset values.
- */
-void Achievement::onRaceEnd()
-{
-    if(m_achievement_info->needsResetAfterRace())
-        reset();
-}   // onRaceEnd
-
-// ----------------------------------------------------------------------------
-/** Called at the end of a lap to potentially reset values.
-*/
-void Achievement::onLapEnd()
-{
-    if (m_achievement_info->needsResetAfterLap())
-        reset();
-}   // onLapEnd
-
 // ----------------------------------------------------------------------------
 /** Checks if this achievement has been achieved.
  */
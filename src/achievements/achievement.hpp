@@ -70,8 +70,6 @@ public:
 
     virtual void reset();
     virtual irr::core::stringw getProgressAsString() const;
-    void onRaceEnd();
-    void onLapEnd();
     // ------------------------------------------------------------------------
     /** Returns the id of this achievement. */
     uint32_t getID() const { return m_id; }
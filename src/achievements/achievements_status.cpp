@@ -53,6 +53,8 @@ AchievementsStatus::~AchievementsStatus()
         delete it->second;
     }
     m_achievements.clear();
+    m_reset_after_race.clear();
+    m_reset_after_lap.clear();
 }   // ~AchievementsStatus
 
 // ----------------------------------------------------------------------------
@@ -84,6 +86,10 @@ void AchievementsStatus::load(const XMLNode * input)
 void AchievementsStatus::add(Achievement *achievement)
 {
     m_achievements[achievement->getID()] = achievement;
+    if (achievement->getInfo()->needsResetAfterRace())
+        m_reset_after_race.push_back(achievement);
+    else if (achievement->getInfo()->needsResetAfterLap())
+        m_reset_after_lap.push_back(achievement);
 }    // add
 
 
@@ -161,9 +167,10 @@ void AchievementsStatus::sync(const std::vector<uint32_t> & achieved_ids)
 void AchievementsStatus::onRaceEnd()
 {
     //reset all values that need to be reset
-    std::map<uint32_t, Achievement *>::iterator iter;
-    for ( iter = m_achievements.begin(); iter != m_achievements.end(); ++iter ) {
-        iter->second->onRaceEnd();
+    for (unsigned int i = 0; i < m_reset_after_race.size(); i++)
+    {
+        if (!m_reset_after_race[i]->isAchieved())
+            m_reset_after_race[i]->reset();
     }
 }   // onRaceEnd
 
@@ -171,8 +178,9 @@ void AchievementsStatus::onRaceEnd()
 void AchievementsStatus::onLapEnd()
 {
     //reset all values that need to be reset
-    std::map<uint32_t, Achievement *>::iterator iter;
-    for (iter = m_achievements.begin(); iter != m_achievements.end(); ++iter) {
-        iter->second->onLapEnd();
+    for (unsigned int i = 0; i < m_reset_after_lap.size(); i++)
+    {
+        if (!m_reset_after_lap[i]->isAchieved())
+            m_reset_after_lap[i]->reset();
     }
 }   // onLapEnd
@@ -27,6 +27,7 @@
 
 #include <irrString.h>
 #include <string>
+#include <vector>
 
 class UTFWriter;
 class XMLNode;
@@ -42,6 +43,12 @@ class AchievementsStatus
 {
 private:
     std::map<uint32_t, Achievement *> m_achievements;
+
+    /** The achievements whose values are reset at the end of each race
+     *  or lap, so that the other ones don't have to be visited. */
+    std::vector<Achievement *> m_reset_after_race;
+    std::vector<Achievement *> m_reset_after_lap;
+
     bool         m_online;
     bool         m_valid;
 
@@ -44,6 +44,7 @@ Addon::Addon(const XMLNode &xml)
     m_icon_url           = "";
     m_icon_basename      = "";
     m_icon_revision      = 0;
+    m_icon_etag          = "";
     m_size               = 0;
     m_date               = 0;
     m_min_include_ver    = "";
@@ -101,6 +102,7 @@ Addon::Addon(const XMLNode &xml)
         m_icon_basename = StringUtils::getBasename(m_icon_url);
 
     xml.get("icon-revision",      &m_icon_revision     );
+    xml.get("icon-etag",          &m_icon_etag         );
     xml.get("size",               &m_size              );
 
     xml.get("min-include-version",&m_min_include_ver   );
@@ -122,7 +124,8 @@ void Addon::copyInstallData(const Addon &addon)
     m_zip_file      = addon.m_zip_file;
     m_icon_url      = addon.m_icon_url;
     m_icon_basename = addon.m_icon_basename;
-    m_icon_revision = addon.m_revision;
+    // The icon revision and ETag are kept, so that the cached icon is
+    // validated with the server for the new revision.
     m_designer      = addon.m_designer;
     m_status        = addon.m_status;
     m_date          = addon.m_date;
@@ -156,6 +159,8 @@ void Addon::writeXML(std::ofstream *out_stream)
                   << "\" size=\""                << m_size
                   << "\" icon-revision=\""       << m_icon_revision
                   << "\" icon-name=\"" << m_icon_basename
+                  << "\" icon-etag=\""
+                  << StringUtils::xmlEncode(core::stringw(m_icon_etag.c_str()))
                   << "\"/>\n";
 }   // writeXML
 
@@ -106,6 +106,9 @@ private:
     std::string m_icon_url;
     /** Name of the icon to use. */
     std::string m_icon_basename;
+    /** ETag the server sent with the downloaded icon, used to only download
+     *  the icon again if it was changed on the server. */
+    std::string m_icon_etag;
     /** True if the icon is cached/loaded and can be displayed. */
     bool        m_icon_ready;
     /** The name of the zip file on the addon server. */
@@ -209,8 +212,9 @@ public:
     // ------------------------------------------------------------------------
     /** Returns true if the (cached) icon needs to be updated. This is the
      *  case if the addon revision number is higher than the revision number
-     *  of the icon (this leaves some chance of false positives - i.e. icons
-     *  that were not changed will still be downloaded). */
+     *  of the icon. Since an icon is often not changed with a new revision,
+     *  the icon is then requested with its ETag, and only downloaded again if
+     *  it was changed on the server. */
     bool iconNeedsUpdate() const
     {
         return m_revision > m_icon_revision;
@@ -230,6 +234,12 @@ public:
      *  to be displayed. */
     bool iconReady() const { return m_icon_ready; }
     // ------------------------------------------------------------------------
+    /** Returns the ETag of the downloaded icon, or "" if unknown. */
+    const std::string& getIconETag() const { return m_icon_etag; }
+    // ------------------------------------------------------------------------
+    /** Sets the ETag of the downloaded icon. */
+    void setIconETag(const std::string &etag) { m_icon_etag = etag; }
+    // ------------------------------------------------------------------------
     /** Marks that the icon for this addon can be displayed. */
     void setIconReady()
     {
@@ -61,6 +61,7 @@ AddonsManager::AddonsManager() : m_addons_list(std::vector<Addon>() ),
     m_addons_list.lock();
     // Clear the list in case that a reinit is being done.
     m_addons_list.getData().clear();
+    m_addon_index.clear();
     loadInstalledAddons();
     m_addons_list.unlock();
 }   // AddonsManager
@@ -150,6 +151,7 @@ void AddonsManager::initAddons(const XMLNode *xml)
     m_addons_list.lock();
     // Clear the list in case that a reinit is being done.
     m_addons_list.getData().clear();
+    m_addon_index.clear();
     loadInstalledAddons();
     m_addons_list.unlock();
 
@@ -217,7 +219,7 @@ void AddonsManager::initAddons(const XMLNode *xml)
             }
             else
             {
-                m_addons_list.getData().push_back(addon);
+                appendAddon(addon);
                 index = (int) m_addons_list.getData().size()-1;
             }
             // Mark that this addon still exists on the server
@@ -267,6 +269,7 @@ void AddonsManager::initAddons(const XMLNode *xml)
         m_addons_list.getData().pop_back();
         count--;
     }
+    rebuildAddonIndex();
     m_addons_list.unlock();
 
     m_state.setAtomic(STATE_READY);
@@ -372,6 +375,9 @@ void AddonsManager::downloadIcons()
                 Addon *m_addon;  // stores this addon object
                 void afterOperation()
                 {
+                    HTTPRequest::afterOperation();
+                    if (!hadDownloadError() && !wasNotModified())
+                        m_addon->setIconETag(getETag());
                     m_addon->setIconReady();
                 }   // callback
             public:
@@ -380,6 +386,9 @@ void AddonsManager::downloadIcons()
                             Addon *addon     ) : HTTPRequest(filename, true, 1)
                 {
                     m_addon = addon;  setURL(url);
+                    // An existing icon is only downloaded again if it was
+                    // changed on the server
+                    setConditional(addon->getIconETag());
                 }   // IconRequest
             };
             IconRequest *r = new IconRequest("icons/"+icon, url, &addon);
@@ -414,7 +423,7 @@ void AddonsManager::loadInstalledAddons()
             node->getName()=="track"    )
         {
             Addon addon(*node);
-            m_addons_list.getData().push_back(addon);
+            appendAddon(addon);
         }
     }   // for i <= xml->getNumNodes()
 
@@ -439,15 +448,35 @@ const Addon* AddonsManager::getAddon(const std::string &id) const
  */
 int AddonsManager::getAddonIndex(const std::string &id) const
 {
-    for(unsigned int i = 0; i < m_addons_list.getData().size(); i++)
-    {
-        if(m_addons_list.getData()[i].getId()== id)
-        {
-            return i;
-        }
-    }
-    return -1;
+    std::unordered_map<std::string, unsigned int>::const_iterator i =
+                                                       m_addon_index.find(id);
+    return i == m_addon_index.end() ? -1 : (int)i->second;
 }   // getAddonIndex
+// ----------------------------------------------------------------------------
+/** Adds an addon at the end of the list of addons. If an addon with the same
+ *  id is already in the list, the index keeps pointing to the first one.
+ *  Must be called with m_addons_list locked.
+ *  \param addon The addon to add.
+ */
+void AddonsManager::appendAddon(const Addon &addon)
+{
+    m_addon_index.insert(std::make_pair(addon.getId(),
+                               (unsigned int)m_addons_list.getData().size()));
+    m_addons_list.getData().push_back(addon);
+}   // appendAddon
+
+// ----------------------------------------------------------------------------
+/** Recreates the index of all addons after addons were removed from the
+ *  list. Must be called with m_addons_list locked.
+ */
+void AddonsManager::rebuildAddonIndex()
+{
+    m_addon_index.clear();
+    for (unsigned int i = 0; i < m_addons_list.getData().size(); i++)
+        m_addon_index.insert(std::make_pair(m_addons_list.getData()[i].getId(),
+                                            i));
+}   // rebuildAddonIndex
+
 // ----------------------------------------------------------------------------
 bool AddonsManager::anyAddonsInstalled() const
 {
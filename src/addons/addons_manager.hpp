@@ -21,6 +21,7 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 #include "addons/addon.hpp"
@@ -37,6 +38,10 @@ private:
      *  combined from the addons_installed.xml file first, then information
      *  from the downloaded list of items is merged/added to that. */
     Synchronised<std::vector<Addon> >  m_addons_list;
+    /** Index of each addon id in m_addons_list, so that merging the list of
+     *  addons on the server does not need a linear search for each addon.
+     *  Protected by the lock of m_addons_list. */
+    std::unordered_map<std::string, unsigned int> m_addon_index;
     /** Full filename of the addons_installed.xml file. */
     std::string                        m_file_installed;
 
@@ -52,6 +57,8 @@ private:
     Synchronised<STATE_TYPE> m_state;
 
     void  saveInstalled();
+    void  appendAddon(const Addon &addon);
+    void  rebuildAddonIndex();
     void  loadInstalledAddons();
     void  downloadIcons();
 
@@ -18,14 +18,258 @@
 #include <string.h>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <map>
+#include <vector>
 
+#include "config/hardware_stats.hpp"
 #include "graphics/irr_driver.hpp"
 #include "io/file_manager.hpp"
 #include "utils/string_utils.hpp"
 
+#ifndef WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <pthread.h>
+#include <stdio.h>
+#include <zlib.h>
+
 #include <IWriteFile.h>
 using namespace irr;
 using namespace io;
+
+namespace
+{
+    /** Maximum number of threads used to extract a zip file. */
+    const int MAX_ZIP_THREADS = 8;
+    /** Size of the buffer used to write the extracted files. */
+    const unsigned ZIP_WRITE_BUFFER = 1024 * 1024;
+
+    /** A file in a zip archive, as read from the central directory. */
+    struct ZipEntry
+    {
+        std::string m_name;
+        std::string m_destination;
+        unsigned    m_method;
+        uint32_t    m_crc;
+        uint32_t    m_compressed_size;
+        uint32_t    m_size;
+        uint32_t    m_header_offset;
+    };   // ZipEntry
+
+    /** The data shared by all threads that extract a zip file. */
+    struct ZipJob
+    {
+        const unsigned char  *m_data;
+        size_t                m_size;
+        std::string           m_from;
+        std::vector<ZipEntry> m_entries;
+        /** Index of the next entry to extract, protected by m_mutex. */
+        unsigned              m_next;
+        bool                  m_error;
+        pthread_mutex_t       m_mutex;
+    };   // ZipJob
+
+    // ------------------------------------------------------------------------
+    uint32_t read16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+    uint32_t read32(const unsigned char *p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }   // read32
+
+    // ------------------------------------------------------------------------
+    /** Reads the central directory of a zip file.
+     *  \return False if the file is not a zip file this extractor supports
+     *          (e.g. zip64 or encrypted files).
+     */
+    bool readZipEntries(ZipJob *job, const std::string &to)
+    {
+        const unsigned char *data = job->m_data;
+        const size_t size = job->m_size;
+        if (size < 22)
+            return false;
+
+        // The end of central directory record is at the end of the file,
+        // followed by a comment of at most 64 KB.
+        size_t eocd = size - 22;
+        const size_t min_eocd = size > 22 + 65535 ? size - 22 - 65535 : 0;
+        while (read32(data + eocd) != 0x06054b50)
+        {
+            if (eocd == min_eocd)
+                return false;
+            eocd--;
+        }
+        const unsigned count     = read16(data + eocd + 10);
+        const uint32_t cd_size   = read32(data + eocd + 12);
+        const uint32_t cd_offset = read32(data + eocd + 16);
+        if (count == 0xffff || cd_offset == 0xffffffff ||
+            (size_t)cd_offset + cd_size > eocd)
+            return false;
+
+        // Index of each destination name, since their paths are ignored
+        // a later file overwrites an earlier one with the same name.
+        std::map<std::string, unsigned> destinations;
+        size_t pos = cd_offset;
+        for (unsigned i = 0; i < count; i++)
+        {
+            if (pos + 46 > eocd || read32(data + pos) != 0x02014b50)
+                return false;
+            ZipEntry entry;
+            const unsigned flags = read16(data + pos + 8);
+            entry.m_method          = read16(data + pos + 10);
+            entry.m_crc             = read32(data + pos + 16);
+            entry.m_compressed_size = read32(data + pos + 20);
+            entry.m_size            = read32(data + pos + 24);
+            const unsigned name_len = read16(data + pos + 28);
+            const unsigned extra    = read16(data + pos + 30);
+            const unsigned comment  = read16(data + pos + 32);
+            entry.m_header_offset   = read32(data + pos + 42);
+            if (pos + 46 + name_len > eocd)
+                return false;
+            entry.m_name.assign((const char*)data + pos + 46, name_len);
+            pos += 46 + name_len + extra + comment;
+
+            if ((flags & 1) != 0 ||
+                (entry.m_method != 0 && entry.m_method != 8) ||
+                entry.m_size == 0xffffffff ||
+                entry.m_compressed_size == 0xffffffff)
+                return false;
+            if (entry.m_name.empty() ||
+                entry.m_name[entry.m_name.size() - 1] == '/' ||
+                entry.m_name[0] == '.')
+                continue;
+            entry.m_destination =
+                to + "/" + StringUtils::getBasename(entry.m_name);
+
+            std::map<std::string, unsigned>::iterator it =
+                destinations.find(entry.m_destination);
+            if (it != destinations.end())
+            {
+                job->m_entries[it->second] = entry;
+                continue;
+            }
+            destinations[entry.m_destination] =
+                (unsigned)job->m_entries.size();
+            job->m_entries.push_back(entry);
+        }
+        return true;
+    }   // readZipEntries
+
+    // ------------------------------------------------------------------------
+    /** Extracts one file and verifies its CRC.
+     *  \param buffer Buffer of ZIP_WRITE_BUFFER bytes.
+     *  \return True if successful.
+     */
+    bool extractEntry(const ZipJob &job, const ZipEntry &entry,
+                      unsigned char *buffer)
+    {
+        const size_t header = entry.m_header_offset;
+        if (header + 30 > job.m_size || read32(job.m_data + header) != 0x04034b50)
+            return false;
+        const size_t start = header + 30 + read16(job.m_data + header + 26)
+                                         + read16(job.m_data + header + 28);
+        if (start + entry.m_compressed_size > job.m_size)
+            return false;
+        const unsigned char *src = job.m_data + start;
+
+        FILE *out = fopen(entry.m_destination.c_str(), "wb");
+        if (!out)
+        {
+            Log::warn("addons", "Couldn't create the file '%s'. The directory "
+                      "might not exist. This is ignored, but the addon might "
+                      "not work.", entry.m_destination.c_str());
+            return false;
+        }
+
+        bool ok = true;
+        uLong crc = crc32(0L, Z_NULL, 0);
+        if (entry.m_method == 0)
+        {
+            // Stored: write directly from the mapped archive
+            crc = crc32(crc, src, entry.m_size);
+            ok = entry.m_size == entry.m_compressed_size &&
+                 fwrite(src, 1, entry.m_size, out) == entry.m_size;
+        }
+        else
+        {
+            z_stream stream;
+            memset(&stream, 0, sizeof(stream));
+            // Negative window bits: raw deflate data without zlib header
+            ok = inflateInit2(&stream, -MAX_WBITS) == Z_OK;
+            stream.next_in  = (Bytef*)src;
+            stream.avail_in = entry.m_compressed_size;
+            int result = Z_OK;
+            while (ok && result != Z_STREAM_END)
+            {
+                stream.next_out  = buffer;
+                stream.avail_out = ZIP_WRITE_BUFFER;
+                result = inflate(&stream, Z_NO_FLUSH);
+                if (result != Z_OK && result != Z_STREAM_END)
+                {
+                    ok = false;
+                    break;
+                }
+                const unsigned n = ZIP_WRITE_BUFFER - stream.avail_out;
+                if (n == 0 && result != Z_STREAM_END)
+                {
+                    // No progress: the data is truncated
+                    ok = false;
+                    break;
+                }
+                crc = crc32(crc, buffer, n);
+                ok = fwrite(buffer, 1, n, out) == n;
+            }
+            ok = ok && stream.total_out == entry.m_size;
+            inflateEnd(&stream);
+        }
+        if (fclose(out) != 0)
+            ok = false;
+
+        if (ok && crc != entry.m_crc)
+        {
+            Log::warn("addons", "CRC error in '%s' of archive '%s'.",
+                      entry.m_name.c_str(), job.m_from.c_str());
+            ok = false;
+        }
+        else if (!ok)
+        {
+            Log::warn("addons", "Could not extract '%s' from archive '%s'. "
+                      "This is ignored, but the addon might not work.",
+                      entry.m_name.c_str(), job.m_from.c_str());
+        }
+        return ok;
+    }   // extractEntry
+
+    // ------------------------------------------------------------------------
+    /** Thread function: extracts entries till all are done. */
+    void* extractThread(void *obj)
+    {
+        ZipJob *job = (ZipJob*)obj;
+        std::vector<unsigned char> buffer(ZIP_WRITE_BUFFER);
+        while (true)
+        {
+            pthread_mutex_lock(&job->m_mutex);
+            const unsigned index = job->m_next++;
+            pthread_mutex_unlock(&job->m_mutex);
+            if (index >= job->m_entries.size())
+                break;
+            const ZipEntry &entry = job->m_entries[index];
+            Log::info("addons", "Unzipping file '%s'.", entry.m_name.c_str());
+            if (!extractEntry(*job, entry, &buffer[0]))
+            {
+                pthread_mutex_lock(&job->m_mutex);
+                job->m_error = true;
+                pthread_mutex_unlock(&job->m_mutex);
+            }
+        }
+        return NULL;
+    }   // extractThread
+
+}   // namespace
 s32 IFileSystem_copyFileToFile(IWriteFile* dst, IReadFile* src)
 {
   char buf[1024];
@@ -49,12 +293,15 @@ s32 IFileSystem_copyFileToFile(IWriteFile* dst, IReadFile* src)
 }   // IFileSystem_copyFileToFile
 
 // ----------------------------------------------------------------------------
-/** Extracts all files from the zip archive 'from' to the directory 'to'.
+/** Extracts all files from the zip archive 'from' to the directory 'to'
+ *  using the zip reader of irrlicht. This is used for archives that
+ *  extract_zip can't read itself.
  *  \param from A zip archive.
  *  \param to The destination directory.
  *  \return True if successful.
  */
-bool extract_zip(const std::string &from, const std::string &to)
+static bool extract_zip_archive(const std::string &from,
+                                const std::string &to)
 {
     //Add the zip to the file system
     IFileSystem *file_system = irr_driver->getDevice()->getFileSystem();
@@ -117,4 +364,89 @@ bool extract_zip(const std::string &from, const std::string &to)
     file_system->removeFileArchive(file_system->getAbsolutePath(from.c_str()));
 
     return !error;
+}   // extract_zip_archive
+
+// ----------------------------------------------------------------------------
+/** Extracts all files from the zip archive 'from' to the directory 'to'.
+ *  The archive is memory mapped, and the files are inflated by several
+ *  threads in parallel. The CRC of each file is checked while it is written.
+ *  Archives that are not supported here (zip64, encrypted files or other
+ *  compression methods) are extracted with irrlicht.
+ *  \param from A zip archive.
+ *  \param to The destination directory.
+ *  \return True if successful.
+ */
+bool extract_zip(const std::string &from, const std::string &to)
+{
+    ZipJob job;
+    job.m_data  = NULL;
+    job.m_size  = 0;
+    job.m_from  = from;
+    job.m_next  = 0;
+    job.m_error = false;
+
+#ifdef WIN32
+    std::vector<unsigned char> content;
+    FILE *file = fopen(from.c_str(), "rb");
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (file_size > 0)
+    {
+        content.resize(file_size);
+        if (fread(&content[0], file_size, 1, file) == 1)
+        {
+            job.m_data = &content[0];
+            job.m_size = file_size;
+        }
+    }
+    fclose(file);
+#else
+    int fd = open(from.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map != MAP_FAILED)
+    {
+        job.m_data = (const unsigned char*)map;
+        job.m_size = st.st_size;
+    }
+#endif
+
+    if (!job.m_data || !readZipEntries(&job, to))
+    {
+#ifndef WIN32
+        if (job.m_data)
+            munmap((void*)job.m_data, job.m_size);
+#endif
+        return extract_zip_archive(from, to);
+    }
+
+    pthread_mutex_init(&job.m_mutex, NULL);
+    int num_threads = std::min(HardwareStats::getNumProcessors(),
+                               MAX_ZIP_THREADS);
+    num_threads = std::min(num_threads, (int)job.m_entries.size());
+    // The current thread extracts files as well
+    std::vector<pthread_t> threads;
+    for (int i = 1; i < num_threads; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, &extractThread, &job) == 0)
+            threads.push_back(thread);
+    }
+    extractThread(&job);
+    for (unsigned int i = 0; i < threads.size(); i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&job.m_mutex);
+
+#ifndef WIN32
+    munmap((void*)job.m_data, job.m_size);
+#endif
+    return !job.m_error;
 }   // extract_zip
@@ -458,11 +458,17 @@ void Ipo::update(float time, Vec3 *xyz, Vec3 *hpr,Vec3 *scale)
     case Ipo::IPO_SCALEZ : if(scale) scale->setZ(get(time, 0)); break;
     case Ipo::IPO_LOCXYZ :
         {
-            if(xyz)
+            if(!xyz) break;
+            if(m_ipo_data->m_points.size()<2)
             {
-                for(unsigned int j=0; j<3; j++)
-                    (*xyz)[j] = get(time, j);
+                *xyz = m_ipo_data->m_points[0];
+                break;
             }
+            // Search the segment only once for all three axis
+            time = m_ipo_data->adjustTime(time);
+            const unsigned int n = findSegment(time);
+            for(unsigned int j=0; j<3; j++)
+                (*xyz)[j] = m_ipo_data->get(time, j, n);
             break;
         }
 
@@ -481,21 +487,46 @@ float Ipo::get(float time, unsigned int index) const
     assert(!isnan(time));
 
     // Avoid crash in case that only one point is given for this IPO.
-    if(m_next_n==0)
+    if(m_ipo_data->m_points.size()<2)
         return m_ipo_data->m_points[0][index];
 
     time = m_ipo_data->adjustTime(time);
 
-    // Time was reset since the last cached value for n,
-    // reset n to start from the beginning again.
-    if(time < m_ipo_data->m_points[m_next_n-1].getW())
-        m_next_n = 1;
-    // Search for the first point in the (sorted) array which is greater or equal
-    // to the current time.
-    while(m_next_n<m_ipo_data->m_points.size()-1 &&
-         time >=m_ipo_data->m_points[m_next_n].getW())
-        m_next_n++;
-    float rval = m_ipo_data->get(time, index, m_next_n-1);
+    float rval = m_ipo_data->get(time, index, findSegment(time));
     assert(!isnan(rval));
     return rval;
 }   // get
+
+// ----------------------------------------------------------------------------
+/** Compares the time of a control point (stored in W) with a time. */
+static bool isBeforeControlPoint(float time, const Vec3 &point)
+{
+    return time < point.getW();
+}   // isBeforeControlPoint
+
+// ----------------------------------------------------------------------------
+/** Returns the index of the control point at which the segment containing
+ *  time starts. Since time usually increases slowly, the segment used last
+ *  time and the one after it are tried first, otherwise (e.g. when a cyclic
+ *  animation restarts) the segment is searched with a binary search.
+ *  \param time The time, already adjusted with adjustTime. At least two
+ *         control points must exist.
+ */
+unsigned int Ipo::findSegment(float time) const
+{
+    const std::vector<Vec3> &points = m_ipo_data->m_points;
+    const unsigned int last = (unsigned int)points.size()-1;
+    // m_next_n is the first point in [1, last] after time, or last
+    for(unsigned int i=0; i<2 && m_next_n<=last; i++, m_next_n++)
+    {
+        if(time < points[m_next_n-1].getW())
+            break;
+        if(m_next_n==last || time < points[m_next_n].getW())
+            return m_next_n-1;
+    }
+    m_next_n = (unsigned int)(std::upper_bound(points.begin()+1,
+                                               points.begin()+last, time,
+                                               isBeforeControlPoint)
+                              - points.begin());
+    return m_next_n-1;
+}   // findSegment
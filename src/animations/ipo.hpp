@@ -114,6 +114,7 @@ private:
     mutable unsigned int m_next_n;
 
     Ipo(const Ipo *ipo);
+    unsigned int findSegment(float time) const;
 public:
              Ipo(const XMLNode &curve, float fps=25, bool reverse=false);
     virtual ~Ipo();
@@ -21,6 +21,9 @@
 #include <stdio.h>
 
 #include "audio/sfx_base.hpp"
+#include "graphics/camera.hpp"
+#include "graphics/central_settings.hpp"
+#include "graphics/irr_driver.hpp"
 #include "graphics/material.hpp"
 #include "graphics/material_manager.hpp"
 #include "graphics/mesh_tools.hpp"
@@ -32,7 +35,10 @@
 #include "physics/triangle_mesh.hpp"
 #include "tracks/bezier_curve.hpp"
 #include "tracks/track_object.hpp"
+#include "tracks/track_object_presentation.hpp"
 #include "utils/constants.hpp"
+#include <ICameraSceneNode.h>
+#include <SViewFrustum.h>
 #include <ISceneManager.h>
 #include <IMeshSceneNode.h>
 
@@ -87,6 +93,12 @@ void ThreeDAnimation::update(float dt)
 
         if (!m_playing) return;
 
+        // Objects nobody can see are not moved until they become visible
+        // again. Only the cheap interpolation above is done each frame,
+        // so that visibility is tested at the current position.
+        if (isOutsideAllViews(xyz, scale))
+            return;
+
         // Note that the rotation order of irrlicht is different from the one
         // in blender. So in order to reproduce the blender IPO rotations
         // correctly, we have to get the rotations around each axis and combine
@@ -112,3 +124,65 @@ void ThreeDAnimation::update(float dt)
         }
     }
 }   // update
+
+// ----------------------------------------------------------------------------
+/** Returns true if the animated object is a mesh without physics and without
+ *  children, that would be outside of the view frustums of all cameras at
+ *  the given position. Such an object can skip moving its scene node, since
+ *  nothing depends on its position. Objects that can cast shadows or light
+ *  into the view (i.e. when shadows or global illumination are enabled) and
+ *  important (e.g. cutscene) animations are never culled.
+ *  \param xyz The new position of the object.
+ *  \param scale The new scale of the object.
+ */
+bool ThreeDAnimation::isOutsideAllViews(const Vec3 &xyz,
+                                        const Vec3 &scale) const
+{
+    if (m_important_animation || !m_object ||
+        m_object->getPhysicalObject() || Camera::getNumCameras() == 0 ||
+        !CVS->isGLSL() || CVS->isShadowEnabled() ||
+        CVS->isGlobalIlluminationEnabled())
+        return false;
+
+    const TrackObjectPresentationMesh *mesh =
+              m_object->getPresentation<TrackObjectPresentationMesh>();
+    if (!mesh || !mesh->getNode())
+        return false;
+    const scene::ISceneNode *node = mesh->getNode();
+    // Only nodes directly below the root are tested, so that the position
+    // of the animation is in world coordinates.
+    if (!node->getChildren().empty() ||
+        node->getParent() != irr_driver->getSceneManager()->getRootSceneNode())
+        return false;
+
+    // A sphere around the origin of the node that contains its bounding
+    // box in any rotation.
+    const core::aabbox3df &box = node->getBoundingBox();
+    const core::vector3df extent(
+        std::max(fabsf(box.MinEdge.X), fabsf(box.MaxEdge.X)),
+        std::max(fabsf(box.MinEdge.Y), fabsf(box.MaxEdge.Y)),
+        std::max(fabsf(box.MinEdge.Z), fabsf(box.MaxEdge.Z)));
+    const float max_scale = std::max(fabsf(scale.getX()),
+                            std::max(fabsf(scale.getY()),
+                                     fabsf(scale.getZ())));
+    const float radius = extent.getLength() * max_scale;
+    const core::vector3df center = xyz.toIrrVector();
+
+    for (unsigned int i = 0; i < Camera::getNumCameras(); i++)
+    {
+        const scene::SViewFrustum *frustum =
+            Camera::getCamera(i)->getCameraSceneNode()->getViewFrustum();
+        bool outside = false;
+        for (unsigned int j = 0; j < scene::SViewFrustum::VF_PLANE_COUNT; j++)
+        {
+            if (frustum->planes[j].getDistanceTo(center) > radius)
+            {
+                outside = true;
+                break;
+            }
+        }
+        if (!outside)
+            return false;
+    }
+    return true;
+}   // isOutsideAllViews
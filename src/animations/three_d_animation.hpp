@@ -70,6 +70,8 @@ private:
 
     //scene::ISceneNode*    m_node;
 
+    bool         isOutsideAllViews(const Vec3 &xyz, const Vec3 &scale) const;
+
 public:
                  ThreeDAnimation(const XMLNode &node, TrackObject* object);
     virtual     ~ThreeDAnimation();
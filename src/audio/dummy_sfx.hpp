@@ -60,6 +60,13 @@ public:
     virtual SFXStatus  getStatus()                      { return SFX_STOPPED; }
     virtual void       onSoundEnabledBack()             {}
     virtual void       setRolloff(float rolloff)        {}
+    virtual float      getAudibility(const Vec3 &listener) { return 0.0f; }
+    virtual bool       hasSource() const                { return false; }
+    virtual bool       attachSource(ALuint source)      { return false; }
+    virtual ALuint     detachSource()                   { return 0;     }
+    virtual void       getSourceState(Vec3 *position, float *max_distance,
+                                      float *gain) const {}
+    virtual void       updateSource(float gain)         {}
     virtual const SFXBuffer* getBuffer() const          { return NULL; }
 
 };   // DummySFX
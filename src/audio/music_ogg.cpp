@@ -29,16 +29,27 @@
 
 #include "audio/music_manager.hpp"
 #include "audio/sfx_manager.hpp"
+#include "config/user_config.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
 
+#include <algorithm>
+
 MusicOggStream::MusicOggStream()
 {
     //m_oggStream= NULL;
-    m_soundBuffers[0] = m_soundBuffers[1]= 0;
+    for (int i = 0; i < m_num_buffers; i++)
+        m_soundBuffers[i] = 0;
     m_soundSource     = -1;
     m_pausedMusic     = true;
     m_playing         = false;
+    m_ring_read       = 0;
+    m_ring_count      = 0;
+    m_decoder_running = false;
+    m_decoder_quit    = false;
+    m_decoder_failed  = false;
+    pthread_mutex_init(&m_ring_mutex, NULL);
+    pthread_cond_init(&m_ring_cond, NULL);
 }   // MusicOggStream
 
 //-----------------------------------------------------------------------------
@@ -46,12 +57,15 @@ MusicOggStream::~MusicOggStream()
 {
     if(stopMusic() == false)
         Log::warn("MusicOgg", "problems while stopping music.");
+    pthread_cond_destroy(&m_ring_cond);
+    pthread_mutex_destroy(&m_ring_mutex);
 }   // ~MusicOggStream
 
 //-----------------------------------------------------------------------------
 bool MusicOggStream::load(const std::string& filename)
 {
     if (isPlaying()) stopMusic();
+    stopDecoder();
 
     m_error = true;
     m_fileName = filename;
@@ -111,7 +125,7 @@ bool MusicOggStream::load(const std::string& filename)
     if (m_vorbisInfo->channels == 1) nb_channels = AL_FORMAT_MONO16;
     else                             nb_channels = AL_FORMAT_STEREO16;
 
-    alGenBuffers(2, m_soundBuffers);
+    alGenBuffers(m_num_buffers, m_soundBuffers);
     if (check("alGenBuffers") == false) return false;
 
     alGenSources(1, &m_soundSource);
@@ -124,10 +138,136 @@ bool MusicOggStream::load(const std::string& filename)
     alSourcef (m_soundSource, AL_GAIN,            1.0          );
     alSourcei (m_soundSource, AL_SOURCE_RELATIVE, AL_TRUE      );
 
+    m_free_buffers.clear();
+    m_free_buffers.reserve(m_num_buffers);
     m_error=false;
+    startDecoder();
     return true;
 }   // load
 
+//-----------------------------------------------------------------------------
+/** Starts the thread that decodes the music into the ring of PCM buffers.
+ *  The number of buffers is taken from the user config.
+ */
+void MusicOggStream::startDecoder()
+{
+    const unsigned count =
+        std::max(2, (int)UserConfigParams::m_music_prefetch_buffers);
+    m_ring.resize(count * m_buffer_size);
+    m_ring_sizes.assign(count, 0);
+    m_ring_read      = 0;
+    m_ring_count     = 0;
+    m_decoder_quit   = false;
+    m_decoder_failed = false;
+
+    int error = pthread_create(&m_decoder_thread, NULL,
+                               &MusicOggStream::decoderLoop, this);
+    if (error)
+    {
+        Log::error("MusicOgg", "Could not create decoder thread, error=%d.",
+                   error);
+        m_decoder_failed = true;
+        return;
+    }
+    m_decoder_running = true;
+}   // startDecoder
+
+//-----------------------------------------------------------------------------
+/** Stops the decoder thread and waits till it has finished. Must be called
+ *  before the ogg stream is closed.
+ */
+void MusicOggStream::stopDecoder()
+{
+    if (!m_decoder_running)
+        return;
+    pthread_mutex_lock(&m_ring_mutex);
+    m_decoder_quit = true;
+    pthread_cond_broadcast(&m_ring_cond);
+    pthread_mutex_unlock(&m_ring_mutex);
+    pthread_join(m_decoder_thread, NULL);
+    m_decoder_running = false;
+}   // stopDecoder
+
+//-----------------------------------------------------------------------------
+/** The decoder thread: fills free buffers of the ring with decoded music,
+ *  and waits while all buffers are full.
+ *  \param obj The music stream.
+ */
+void* MusicOggStream::decoderLoop(void *obj)
+{
+    MusicOggStream *me = (MusicOggStream*)obj;
+    const unsigned count = (unsigned)me->m_ring_sizes.size();
+
+    pthread_mutex_lock(&me->m_ring_mutex);
+    while (!me->m_decoder_quit)
+    {
+        if (me->m_ring_count == count)
+        {
+            pthread_cond_wait(&me->m_ring_cond, &me->m_ring_mutex);
+            continue;
+        }
+        // Only this thread writes to the buffers after the decoded ones,
+        // so the lock is not needed while decoding.
+        const unsigned index = (me->m_ring_read + me->m_ring_count) % count;
+        pthread_mutex_unlock(&me->m_ring_mutex);
+        int size = 0;
+        bool ok = me->decodeChunk(&me->m_ring[index * m_buffer_size], &size);
+        pthread_mutex_lock(&me->m_ring_mutex);
+        if (!ok)
+        {
+            me->m_decoder_failed = true;
+            pthread_cond_broadcast(&me->m_ring_cond);
+            break;
+        }
+        me->m_ring_sizes[index] = size;
+        me->m_ring_count++;
+        pthread_cond_broadcast(&me->m_ring_cond);
+    }
+    pthread_mutex_unlock(&me->m_ring_mutex);
+    return NULL;
+}   // decoderLoop
+
+//-----------------------------------------------------------------------------
+/** Decodes one buffer of music. At the end of the file decoding continues
+ *  at the first sample, so the loop has no gap.
+ *  \param pcm Where to store the data, m_buffer_size bytes.
+ *  \param size On return the number of bytes decoded.
+ *  \return False if the stream can't be decoded.
+ */
+bool MusicOggStream::decodeChunk(char *pcm, int *size)
+{
+    const int isBigEndian = (IS_LITTLE_ENDIAN ? 0 : 1);
+    bool at_start = false;
+    int  portion;
+
+    *size = 0;
+    while(*size < m_buffer_size)
+    {
+        long result = ov_read(&m_oggStream, pcm + *size, m_buffer_size - *size,
+                              isBigEndian, 2, 1, &portion);
+        if (result > 0)
+        {
+            *size += result;
+            at_start = false;
+        }
+        else if (result == 0)
+        {
+            // End of file: seek to the beginning (causes the music to
+            // loop). If there is no data after seeking, the file is empty.
+            if (at_start || ov_pcm_seek(&m_oggStream, 0) != 0)
+                return *size > 0;
+            at_start = true;
+        }
+        else if (result != OV_HOLE)
+        {
+            Log::error("MusicOgg", "Decoding %s failed: %s",
+                       m_fileName.c_str(), errorString(result).c_str());
+            return *size > 0;
+        }
+    }
+    return true;
+}   // decodeChunk
+
 //-----------------------------------------------------------------------------
 bool MusicOggStream::empty()
 {
@@ -155,12 +295,14 @@ bool MusicOggStream::release()
     }
 
     pauseMusic();
+    stopDecoder();
     m_fileName= "";
 
     empty();
     alDeleteSources(1, &m_soundSource);
     check("alDeleteSources");
-    alDeleteBuffers(2, m_soundBuffers);
+    alDeleteBuffers(m_num_buffers, m_soundBuffers);
+    m_free_buffers.clear();
     check("alDeleteBuffers");
 
     // Handle error correctly
@@ -178,13 +320,20 @@ bool MusicOggStream::playMusic()
     if(isPlaying())
         return true;
 
-    if(!streamIntoBuffer(m_soundBuffers[0]))
-        return false;
-
-    if(!streamIntoBuffer(m_soundBuffers[1]))
+    // Wait for the decoder to provide the first buffer only, the others
+    // are queued up in update() if they are not ready yet.
+    if(!streamIntoBuffer(m_soundBuffers[0], true))
         return false;
+    alSourceQueueBuffers(m_soundSource, 1, m_soundBuffers);
 
-    alSourceQueueBuffers(m_soundSource, 2, m_soundBuffers);
+    m_free_buffers.clear();
+    for (int i = 1; i < m_num_buffers; i++)
+    {
+        if (streamIntoBuffer(m_soundBuffers[i], false))
+            alSourceQueueBuffers(m_soundSource, 1, &m_soundBuffers[i]);
+        else
+            m_free_buffers.push_back(m_soundBuffers[i]);
+    }
 
     alSourcePlay(m_soundSource);
     m_pausedMusic = false;
@@ -275,7 +424,6 @@ void MusicOggStream::update()
     }
 
     int processed= 0;
-    bool active= true;
 
     alGetSourcei(m_soundSource, AL_BUFFERS_PROCESSED, &processed);
 
@@ -285,20 +433,24 @@ void MusicOggStream::update()
 
         alSourceUnqueueBuffers(m_soundSource, 1, &buffer);
         if(!check("alSourceUnqueueBuffers")) return;
+        m_free_buffers.push_back(buffer);
+    }
 
-        active = streamIntoBuffer(buffer);
-        if(!active)
-        {
-            // no more data. Seek to beginning (causes the sound to loop)
-            ov_time_seek(&m_oggStream, 0);
-            active = streamIntoBuffer(buffer);//now there really should be data
-        }
-
+    // Refill with the data that was decoded in the meantime. This never
+    // decodes, so a slow update can only use up the prefetched buffers.
+    while (!m_free_buffers.empty())
+    {
+        ALuint buffer = m_free_buffers.back();
+        if (!streamIntoBuffer(buffer, false))
+            break;
         alSourceQueueBuffers(m_soundSource, 1, &buffer);
         if (!check("alSourceQueueBuffers")) return;
+        m_free_buffers.pop_back();
     }
 
-    if (active)
+    int queued = 0;
+    alGetSourcei(m_soundSource, AL_BUFFERS_QUEUED, &queued);
+    if (queued > 0)
     {
         // For debugging
         SFXManager::checkError("before source state");
@@ -313,46 +465,48 @@ void MusicOggStream::update()
             if (count<10)
                 Log::warn("MusicOgg", "Music not playing when it should be. "
                           "Source state: %d", state);
-            alGetSourcei(m_soundSource, AL_BUFFERS_PROCESSED, &processed);
             alSourcePlay(m_soundSource);
         }
     }
-    else
+    else if (m_decoder_failed)
     {
-        Log::warn("MusicOgg", "Attempt to stream music into buffer failed "
-                              "twice in a row.");
+        Log::warn("MusicOgg", "Attempt to stream music into buffer failed.");
+        m_pausedMusic = true;
     }
 }   // update
 
 //-----------------------------------------------------------------------------
-bool MusicOggStream::streamIntoBuffer(ALuint buffer)
+/** Copies the next decoded buffer of the ring into an OpenAL buffer.
+ *  \param buffer The OpenAL buffer.
+ *  \param wait If the function should wait for the decoder if no data is
+ *         available yet.
+ *  \return False if no decoded data was available.
+ */
+bool MusicOggStream::streamIntoBuffer(ALuint buffer, bool wait)
 {
-    char pcm[m_buffer_size];
-    const int isBigEndian = (IS_LITTLE_ENDIAN ? 0 : 1);
-
-    int  size = 0;
-    int  portion;
-    int  result;
-
-    while(size < m_buffer_size)
+    pthread_mutex_lock(&m_ring_mutex);
+    while (wait && m_ring_count == 0 && m_decoder_running &&
+           !m_decoder_failed)
+        pthread_cond_wait(&m_ring_cond, &m_ring_mutex);
+    if (m_ring_count == 0)
     {
-        result = ov_read(&m_oggStream, pcm + size, m_buffer_size - size,
-                         isBigEndian, 2, 1, &portion);
-
-        if(result > 0)
-            size += result;
-        else
-            if(result < 0)
-                throw errorString(result);
-            else
-                break;
+        pthread_mutex_unlock(&m_ring_mutex);
+        return false;
     }
+    const unsigned index = m_ring_read;
+    const int size = m_ring_sizes[index];
+    pthread_mutex_unlock(&m_ring_mutex);
 
-    if(size == 0) return false;
-
-    alBufferData(buffer, nb_channels, pcm, size, m_vorbisInfo->rate);
+    // The decoder doesn't touch this buffer till it is released below
+    alBufferData(buffer, nb_channels, &m_ring[index * m_buffer_size], size,
+                 m_vorbisInfo->rate);
     check("alBufferData");
 
+    pthread_mutex_lock(&m_ring_mutex);
+    m_ring_read = (m_ring_read + 1) % (unsigned)m_ring_sizes.size();
+    m_ring_count--;
+    pthread_cond_broadcast(&m_ring_cond);
+    pthread_mutex_unlock(&m_ring_mutex);
     return true;
 }   // streamIntoBuffer
 
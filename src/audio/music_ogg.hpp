@@ -21,7 +21,9 @@
 
 #if HAVE_OGGVORBIS
 
+#include <pthread.h>
 #include <string>
+#include <vector>
 
 #include <ogg/ogg.h>
 // Disable warning about potential loss of precision in vorbisfile.h
@@ -42,6 +44,11 @@
 
 /**
   * \brief ogg files based implementation of the Music interface
+  *  The music is decoded by a separate thread into a ring of PCM buffers,
+  *  so that update() (called from the sfx thread) only needs to copy
+  *  already decoded data into OpenAL buffers. When the end of the file is
+  *  reached, the decoder continues with the start of the file in the same
+  *  buffer, so looping has no gap.
   * \ingroup audio
   */
 class MusicOggStream : public Music
@@ -69,7 +76,11 @@ protected:
 
 private:
     bool release();
-    bool streamIntoBuffer(ALuint buffer);
+    bool streamIntoBuffer(ALuint buffer, bool wait);
+    bool decodeChunk(char *pcm, int *size);
+    void startDecoder();
+    void stopDecoder();
+    static void* decoderLoop(void *obj);
 
     std::string     m_fileName;
     FILE*           m_oggFile;
@@ -79,14 +90,37 @@ private:
 
     bool            m_playing;
 
-    ALuint m_soundBuffers[2];
+    /** Number of OpenAL buffers queued to the source. */
+    static const int m_num_buffers = 4;
+    ALuint m_soundBuffers[m_num_buffers];
+    /** OpenAL buffers that were played but could not be refilled yet,
+     *  because the decoder was behind. */
+    std::vector<ALuint> m_free_buffers;
     ALuint m_soundSource;
     ALenum nb_channels;
 
     bool m_pausedMusic;
 
-    //one full second of audio at 44100 samples per second
+    //a quarter of a second of stereo audio at 44100 samples per second
     static const int m_buffer_size = 11025*4;
+
+    /** The decoded PCM buffers, each m_buffer_size bytes. */
+    std::vector<char> m_ring;
+    /** Number of valid bytes in each buffer of the ring. */
+    std::vector<int>  m_ring_sizes;
+    /** Index of the next buffer to pass to OpenAL, and number of decoded
+     *  buffers. */
+    unsigned          m_ring_read, m_ring_count;
+    /** Protects the ring indices and the flags used by the decoder. */
+    pthread_mutex_t   m_ring_mutex;
+    /** Signalled when a buffer was decoded or consumed. */
+    pthread_cond_t    m_ring_cond;
+    pthread_t         m_decoder_thread;
+    bool              m_decoder_running;
+    /** Set to stop the decoder thread. */
+    bool              m_decoder_quit;
+    /** Set by the decoder when the stream can't be decoded (anymore). */
+    bool              m_decoder_failed;
 };
 
 #endif
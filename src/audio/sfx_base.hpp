@@ -76,6 +76,13 @@ public:
     virtual void       reallySetMasterVolumeNow(float gain) = 0;
     virtual void       onSoundEnabledBack()                 = 0;
     virtual void       setRolloff(float rolloff)            = 0;
+    virtual float      getAudibility(const Vec3 &listener)  = 0;
+    virtual bool       hasSource() const                    = 0;
+    virtual bool       attachSource(ALuint source)          = 0;
+    virtual ALuint     detachSource()                       = 0;
+    virtual void       getSourceState(Vec3 *position, float *max_distance,
+                                      float *gain) const    = 0;
+    virtual void       updateSource(float gain)             = 0;
     virtual const SFXBuffer* getBuffer() const              = 0;
     virtual SFXStatus  getStatus()                          = 0;
 
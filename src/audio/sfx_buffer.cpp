@@ -22,6 +22,7 @@
 #include "io/file_manager.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
+#include "utils/types.hpp"
 
 #if HAVE_OGGVORBIS
 #  include <vorbis/codec.h>
@@ -35,6 +36,53 @@
 #  endif
 #endif
 
+#ifndef WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+/** Magic number and version at the start of each cached sfx. The header
+ *  is followed by the number of channels, the rate and the size of the
+ *  16 bit PCM data. */
+static const char     PCM_CACHE_MAGIC[4]  = { 'S', 'P', 'C', 'M' };
+static const uint32_t PCM_CACHE_VERSION   = 1;
+static const size_t   PCM_CACHE_HEADER    = 4 + 4 * sizeof(uint32_t);
+
+/** Buffers are loaded lazily, which can happen from the main thread and
+ *  the sfx thread. */
+static pthread_mutex_t g_load_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//----------------------------------------------------------------------------
+/** Computes the FNV-1a hash of the content of a file.
+ *  \return False if the file can't be read.
+ */
+static bool hashFile(const std::string &name, uint64_t *hash)
+{
+    FILE *file = fopen(name.c_str(), "rb");
+    if (!file)
+        return false;
+    *hash = 14695981039346656037ULL;
+    unsigned char chunk[16384];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            *hash ^= chunk[i];
+            *hash *= 1099511628211ULL;
+        }
+    }
+    fclose(file);
+    return true;
+}   // hashFile
+
 //----------------------------------------------------------------------------
 /** Creates a sfx. The parameter are taken from the parameters:
  *  \param file File name of the buffer.
@@ -97,28 +145,49 @@ bool SFXBuffer::load()
     if (UserConfigParams::m_sfx == false) return false;
     
 #if HAVE_OGGVORBIS
-    if (m_loaded) return false;
+    pthread_mutex_lock(&g_load_mutex);
+    if (m_loaded)
+    {
+        pthread_mutex_unlock(&g_load_mutex);
+        return false;
+    }
 
     alGetError(); // clear errors from previously
 
     alGenBuffers(1, &m_buffer);
     if (!SFXManager::checkError("generating a buffer"))
     {
+        pthread_mutex_unlock(&g_load_mutex);
         return false;
     }
 
     assert( alIsBuffer(m_buffer) );
 
-    if (!loadVorbisBuffer(m_file, m_buffer))
+    std::string cache_file;
+    uint64_t hash;
+    if (hashFile(m_file, &hash))
+    {
+        char name[32];
+        sprintf(name, "%016llx.pcm", (unsigned long long)hash);
+        cache_file = file_manager->getCachedSfxDir() + name;
+    }
+
+    if ((cache_file.empty() || !loadCachedBuffer(cache_file, m_buffer)) &&
+        !loadVorbisBuffer(m_file, m_buffer, cache_file))
     {
         Log::error("SFXBuffer", "Could not load sound effect %s",
                    m_file.c_str());
-        // TODO: free al buffer here?
+        alDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+        pthread_mutex_unlock(&g_load_mutex);
         return false;
     }
+    m_loaded = true;
+    pthread_mutex_unlock(&g_load_mutex);
+#else
+    m_loaded = true;
 #endif
 
-    m_loaded = true;
     return true;
 }   // load
 
@@ -131,21 +200,165 @@ bool SFXBuffer::load()
 void SFXBuffer::unload()
 {
 #if HAVE_OGGVORBIS
+    pthread_mutex_lock(&g_load_mutex);
     if (m_loaded)
     {
         alDeleteBuffers(1, &m_buffer);
         m_buffer = 0;
     }
-#endif
     m_loaded = false;
+    pthread_mutex_unlock(&g_load_mutex);
+#else
+    m_loaded = false;
+#endif
 }   // unload
 
+//----------------------------------------------------------------------------
+/** Loads decoded data from the cache into an OpenAL buffer. The cache file
+ *  is mapped into memory (where supported), so the data is passed to
+ *  OpenAL without an additional copy.
+ *  \param cache_file Name of the cache file.
+ *  \param buffer The OpenAL buffer to fill.
+ *  \return False if there is no valid cache file.
+ */
+bool SFXBuffer::loadCachedBuffer(const std::string &cache_file,
+                                 ALuint buffer)
+{
+#if HAVE_OGGVORBIS
+    const char *data = NULL;
+    size_t size = 0;
+#ifdef WIN32
+    std::vector<char> content;
+    FILE *file = fopen(cache_file.c_str(), "rb");
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (file_size > 0)
+    {
+        content.resize(file_size);
+        if (fread(&content[0], file_size, 1, file) == 1)
+        {
+            data = &content[0];
+            size = file_size;
+        }
+    }
+    fclose(file);
+#else
+    int fd = open(cache_file.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map != MAP_FAILED)
+    {
+        data = (const char*)map;
+        size = st.st_size;
+    }
+#endif
+
+    bool ok = false;
+    if (data && size >= PCM_CACHE_HEADER)
+    {
+        uint32_t header[4];
+        memcpy(header, data + 4, sizeof(header));
+        const uint32_t channels = header[1], rate = header[2];
+        const uint32_t len      = header[3];
+        ok = memcmp(data, PCM_CACHE_MAGIC, 4) == 0 &&
+             header[0] == PCM_CACHE_VERSION &&
+             (channels == 1 || channels == 2) &&
+             size == PCM_CACHE_HEADER + len;
+        if (ok)
+        {
+            alBufferData(buffer, channels == 1 ? AL_FORMAT_MONO16
+                                               : AL_FORMAT_STEREO16,
+                         data + PCM_CACHE_HEADER, len, rate);
+            ok = SFXManager::checkError("loading a cached sfx");
+        }
+    }
+#ifndef WIN32
+    if (data)
+        munmap((void*)data, size);
+#endif
+    if (!ok)
+    {
+        if (data)
+        {
+            Log::info("SFXBuffer", "Discarding cached sfx '%s'.",
+                      cache_file.c_str());
+            remove(cache_file.c_str());
+        }
+        return false;
+    }
+    computeDuration(buffer);
+    return true;
+#else
+    return false;
+#endif
+}   // loadCachedBuffer
+
+//----------------------------------------------------------------------------
+/** Saves decoded data in the cache (see loadCachedBuffer). The data is
+ *  first written to a temporary file, so an interrupted write never leaves
+ *  a truncated cache file.
+ */
+void SFXBuffer::saveCachedBuffer(const std::string &cache_file, int channels,
+                                 int rate, const char *data, long len) const
+{
+    std::string tmp = cache_file + ".tmp";
+    FILE *file = fopen(tmp.c_str(), "wb");
+    if (!file)
+    {
+        Log::warn("SFXBuffer", "Can't write cached sfx '%s'.", tmp.c_str());
+        return;
+    }
+    const uint32_t header[4] = { PCM_CACHE_VERSION, (uint32_t)channels,
+                                 (uint32_t)rate, (uint32_t)len };
+    bool ok = fwrite(PCM_CACHE_MAGIC, 4, 1, file) == 1 &&
+              fwrite(header, sizeof(header), 1, file) == 1 &&
+              fwrite(data, len, 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    remove(cache_file.c_str());
+    if (!ok || rename(tmp.c_str(), cache_file.c_str()) != 0)
+    {
+        Log::warn("SFXBuffer", "Can't write cached sfx '%s'.",
+                  cache_file.c_str());
+        remove(tmp.c_str());
+    }
+}   // saveCachedBuffer
+
+//----------------------------------------------------------------------------
+/** Computes the duration from the buffer data, unless the xml data
+ *  specified a duration (which is not the norm).
+ */
+void SFXBuffer::computeDuration(ALuint buffer)
+{
+#if HAVE_OGGVORBIS
+    if(m_duration < 0)
+    {
+        ALint buffer_size, frequency, bits_per_sample, channels;
+        alGetBufferi(buffer, AL_SIZE,      &buffer_size    );
+        alGetBufferi(buffer, AL_FREQUENCY, &frequency      );
+        alGetBufferi(buffer, AL_CHANNELS,  &channels       );
+        alGetBufferi(buffer, AL_BITS,      &bits_per_sample);
+        m_duration = float(buffer_size) 
+                   / (frequency*channels*(bits_per_sample / 8));
+    }
+#endif
+}   // computeDuration
+
 //----------------------------------------------------------------------------
 /** Load a vorbis file into an OpenAL buffer
  *  based on a routine by Peter Mulholland, used with permission (quote :
  *  "Feel free to use")
+ *  \param cache_file If not empty, the decoded data is saved in this file.
  */
-bool SFXBuffer::loadVorbisBuffer(const std::string &name, ALuint buffer)
+bool SFXBuffer::loadVorbisBuffer(const std::string &name, ALuint buffer,
+                                 const std::string &cache_file)
 {
 #if HAVE_OGGVORBIS
     const int ogg_endianness = (IS_LITTLE_ENDIAN ? 0 : 1);
@@ -206,6 +419,8 @@ bool SFXBuffer::loadVorbisBuffer(const std::string &name, ALuint buffer)
                  : AL_FORMAT_STEREO16,
                  data, len, info->rate);
     success = true;
+    if (!cache_file.empty() && (info->channels == 1 || info->channels == 2))
+        saveCachedBuffer(cache_file, info->channels, info->rate, data, len);
 
     free(data);
 
@@ -214,16 +429,7 @@ bool SFXBuffer::loadVorbisBuffer(const std::string &name, ALuint buffer)
 
     // Allow the xml data to overwrite the duration, but if there is no
     // duration (which is the norm), compute it:
-    if(m_duration < 0)
-    {
-        ALint buffer_size, frequency, bits_per_sample, channels;
-        alGetBufferi(buffer, AL_SIZE,      &buffer_size    );
-        alGetBufferi(buffer, AL_FREQUENCY, &frequency      );
-        alGetBufferi(buffer, AL_CHANNELS,  &channels       );
-        alGetBufferi(buffer, AL_BITS,      &bits_per_sample);
-        m_duration = float(buffer_size) 
-                   / (frequency*channels*(bits_per_sample / 8));
-    }
+    computeDuration(buffer);
     return success;
 #else
     return false;
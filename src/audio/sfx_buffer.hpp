@@ -40,6 +40,10 @@ class XMLNode;
 
 /**
  * \brief The buffer (data) for one kind of sound effects
+ *  Buffers are loaded when the first sfx using them is initialised, so
+ *  sound effects that are never played are never decoded. The decoded data
+ *  is cached on disk, keyed by a hash of the vorbis file, so that later
+ *  loads only have to map the cached file.
  * \ingroup audio
  */
 class SFXBuffer
@@ -72,7 +76,12 @@ private:
     /** Duration of the sfx. */
     float    m_duration;
 
-    bool loadVorbisBuffer(const std::string &name, ALuint buffer);
+    bool loadVorbisBuffer(const std::string &name, ALuint buffer,
+                          const std::string &cache_file);
+    bool loadCachedBuffer(const std::string &cache_file, ALuint buffer);
+    void saveCachedBuffer(const std::string &cache_file, int channels,
+                          int rate, const char *data, long len) const;
+    void computeDuration(ALuint buffer);
 
 public:
 
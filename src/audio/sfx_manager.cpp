@@ -22,12 +22,15 @@
 #include "audio/sfx_buffer.hpp"
 #include "config/user_config.hpp"
 #include "io/file_manager.hpp"
+#include "modes/profile_world.hpp"
 #include "modes/world.hpp"
 #include "race/race_manager.hpp"
+#include "utils/profiler.hpp"
 
 #include <pthread.h>
 #include <stdexcept>
 #include <algorithm>
+#include <functional>
 #include <cerrno>
 #include <map>
 
@@ -76,6 +79,8 @@ SFXManager::SFXManager()
     m_initialized = music_manager->initialized();
     m_master_gain = UserConfigParams::m_sfx_volume;
     m_last_update_time = -1.0f;
+    m_num_sources      = 0;
+    m_sources_created  = false;
     // Init position, since it can be used before positionListener is called.
     // No need to use lock here, since the thread will be created later.
     m_listener_position.getData() = Vec3(0, 0, 0);
@@ -93,26 +98,33 @@ SFXManager::SFXManager()
     // Should be the default, but just in case:
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
 
-    m_thread_id.setAtomic(new pthread_t());
-    // The thread is created even if there atm sfx are disabled
-    // (since the user might enable it later).
-    int error = pthread_create(m_thread_id.getData(), &attr,
-                               &SFXManager::mainLoop, this);
-    if (error)
+    // Without graphics (e.g. a dedicated server) there is nobody to listen,
+    // so no thread is created, and all commands are discarded.
+    if (ProfileWorld::isNoGraphics())
     {
-        m_thread_id.lock();
-        delete m_thread_id.getData();
-        m_thread_id.unlock();
         m_thread_id.setAtomic(0);
-        Log::error("SFXManager", "Could not create thread, error=%d.",
-                   errno);
+        setCanBeDeleted();
+    }
+    else
+    {
+        m_thread_id.setAtomic(new pthread_t());
+        // The thread is created even if there atm sfx are disabled
+        // (since the user might enable it later).
+        int error = pthread_create(m_thread_id.getData(), &attr,
+                                   &SFXManager::mainLoop, this);
+        if (error)
+        {
+            m_thread_id.lock();
+            delete m_thread_id.getData();
+            m_thread_id.unlock();
+            m_thread_id.setAtomic(0);
+            Log::error("SFXManager", "Could not create thread, error=%d.",
+                       errno);
+        }
     }
     pthread_attr_destroy(&attr);
 
     setMasterSFXVolume( UserConfigParams::m_sfx_volume );
-    m_sfx_commands.lock();
-    m_sfx_commands.getData().clear();
-    m_sfx_commands.unlock();
 
 }  // SoundManager
 
@@ -122,8 +134,11 @@ SFXManager::SFXManager()
 SFXManager::~SFXManager()
 {
     m_thread_id.lock();
-    pthread_join(*m_thread_id.getData(), NULL);
-    delete m_thread_id.getData();
+    if (m_thread_id.getData())
+    {
+        pthread_join(*m_thread_id.getData(), NULL);
+        delete m_thread_id.getData();
+    }
     m_thread_id.unlock();
     pthread_cond_destroy(&m_cond_request);
 
@@ -164,6 +179,16 @@ SFXManager::~SFXManager()
     }
     m_all_sfx_types.clear();
 
+#if HAVE_OGGVORBIS
+    // All sfx returned their sources when they were deleted
+    m_free_sources.lock();
+    if (!m_free_sources.getData().empty())
+        alDeleteSources((ALsizei)m_free_sources.getData().size(),
+                        &m_free_sources.getData()[0]);
+    m_free_sources.getData().clear();
+    m_free_sources.unlock();
+#endif
+
 }   // ~SFXManager
 
 //----------------------------------------------------------------------------
@@ -175,8 +200,7 @@ SFXManager::~SFXManager()
  */
 void SFXManager::queue(SFXCommands command,  SFXBase *sfx)
 {
-    SFXCommand *sfx_command = new SFXCommand(command, sfx);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, sfx));
 }   // queue
 
 //----------------------------------------------------------------------------
@@ -189,8 +213,7 @@ void SFXManager::queue(SFXCommands command,  SFXBase *sfx)
  */
 void SFXManager::queue(SFXCommands command, SFXBase *sfx, float f)
 {
-    SFXCommand *sfx_command = new SFXCommand(command, sfx, f);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, sfx, f));
 }   // queue(float)
 
 //----------------------------------------------------------------------------
@@ -203,8 +226,7 @@ void SFXManager::queue(SFXCommands command, SFXBase *sfx, float f)
  */
 void SFXManager::queue(SFXCommands command, SFXBase *sfx, const Vec3 &p)
 {
-   SFXCommand *sfx_command = new SFXCommand(command, sfx, p);
-   queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, sfx, p));
 }   // queue (Vec3)
 
 //----------------------------------------------------------------------------
@@ -213,8 +235,7 @@ void SFXManager::queue(SFXCommands command, SFXBase *sfx, const Vec3 &p)
  */
 void SFXManager::queue(SFXCommands command, MusicInformation *mi)
 {
-    SFXCommand *sfx_command = new SFXCommand(command, mi);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, mi));
 }   // queue(MusicInformation)
 //----------------------------------------------------------------------------
 /** Queues a command for the music manager that takes a floating point value
@@ -224,40 +245,118 @@ void SFXManager::queue(SFXCommands command, MusicInformation *mi)
  */
 void SFXManager::queue(SFXCommands command, MusicInformation *mi, float f)
 {
-    SFXCommand *sfx_command = new SFXCommand(command, mi, f);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, mi, f));
 }   // queue(MusicInformation)
 
 //----------------------------------------------------------------------------
 /** Enqueues a command to the sfx queue threadsafe. Then signal the
  *  sfx manager to wake up.
- *  \param command Pointer to the command to queue up.
+ *  \param command The command to queue up.
  */
-void SFXManager::queueCommand(SFXCommand *command)
+void SFXManager::queueCommand(const SFXCommand &command)
 {
+    // If there is no sfx thread, the command would never be executed. Only
+    // the memory of sound effects that are to be deleted is freed.
+    if (!m_thread_id.getAtomic())
+    {
+        if (command.m_command == SFX_DELETE)
+            deleteSFX(command.m_sfx);
+        return;
+    }
+
+    PROFILER_COUNT("SFX commands queued", 1);
     m_sfx_commands.lock();
-    if(World::getWorld() && 
-        m_sfx_commands.getData().size() > 20*race_manager->getNumberOfKarts()+20 &&
-        race_manager->getMinorMode() != RaceManager::MINOR_MODE_CUTSCENE)
+    m_sfx_commands.getData().push(command);
+    m_sfx_commands.unlock();
+}   // queueCommand
+
+//============================================================================
+SFXManager::SFXCommandQueue::SFXCommandQueue()
+{
+    m_ring.resize(CAPACITY);
+    m_coalesce.resize(COALESCE_SIZE, 0);
+    m_read  = 0;
+    m_write = 0;
+}   // SFXCommandQueue
+
+//----------------------------------------------------------------------------
+/** Returns the index in m_coalesce for the sfx and command of a command. */
+unsigned SFXManager::SFXCommandQueue::getHash(const SFXCommand &command) const
+{
+    size_t h = (size_t)command.m_sfx / sizeof(void*);
+    h = h * 31 + command.m_command;
+    return (unsigned)(h ^ (h >> 10)) & (COALESCE_SIZE - 1);
+}   // getHash
+
+//----------------------------------------------------------------------------
+/** Adds a command to the queue, or replaces the parameter of a waiting
+ *  command that sets the same property of the same sound source.
+ */
+void SFXManager::SFXCommandQueue::push(const SFXCommand &command)
+{
+    const bool coalescable = isCoalescable(command.m_command) &&
+                             command.m_sfx != NULL;
+    unsigned hash = 0;
+    if (coalescable)
     {
-        if(command->m_command==SFX_POSITION || command->m_command==SFX_LOOP ||
-           command->m_command==SFX_SPEED                                       )
+        hash = getHash(command);
+        const unsigned n = m_coalesce[hash];
+        // Check that the command is still waiting, and that it wasn't
+        // overwritten by a command with the same hash.
+        if (m_write - n - 1 < m_write - m_read)
         {
-            delete command;
-            static int count_messages = 0;
-            if(count_messages < 5)
+            SFXCommand &waiting = m_ring[n % CAPACITY];
+            if (waiting.m_sfx == command.m_sfx &&
+                waiting.m_command == command.m_command)
             {
-                Log::warn("SFXManager", "Throttling sfx - queue size %d",
-                         m_sfx_commands.getData().size());
-                count_messages++;
+                waiting.m_parameter = command.m_parameter;
+                return;
             }
-            m_sfx_commands.unlock();
-            return;
-        }   // if throttling
+        }
     }
-    m_sfx_commands.getData().push_back(command);
-    m_sfx_commands.unlock();
-}   // queueCommand
+
+    // Keep the order of commands: once the ring is full, all commands go
+    // to the overflow vector till it is drained.
+    if (m_write - m_read == CAPACITY || !m_overflow.empty())
+    {
+        if (m_overflow.empty())
+            Log::warn("SFXManager", "Command queue is full.");
+        m_overflow.push_back(command);
+        return;
+    }
+    if (coalescable)
+        m_coalesce[hash] = m_write;
+    m_ring[m_write % CAPACITY] = command;
+    m_write++;
+}   // push
+
+//----------------------------------------------------------------------------
+/** Removes up to max_count commands from the queue and copies them to
+ *  commands, stopping after an SFX_EXIT command.
+ *  \return Number of commands copied.
+ */
+unsigned SFXManager::SFXCommandQueue::pop(SFXCommand *commands,
+                                          unsigned max_count)
+{
+    if (m_read == m_write && !m_overflow.empty())
+    {
+        unsigned n = std::min((unsigned)m_overflow.size(), CAPACITY);
+        for (unsigned i = 0; i < n; i++)
+            m_ring[(m_write + i) % CAPACITY] = m_overflow[i];
+        m_write += n;
+        m_overflow.erase(m_overflow.begin(), m_overflow.begin() + n);
+    }
+
+    unsigned count = 0;
+    while (count < max_count && m_read != m_write)
+    {
+        commands[count] = m_ring[m_read % CAPACITY];
+        m_read++;
+        if (commands[count++].m_command == SFX_EXIT)
+            break;
+    }
+    return count;
+}   // pop
 
 //----------------------------------------------------------------------------
 /** Puts a NULL request into the queue, which will trigger the thread to
@@ -282,87 +381,41 @@ void* SFXManager::mainLoop(void *obj)
 
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
 
-    me->m_sfx_commands.lock();
+    // Commands are copied out of the queue in batches, so that the lock
+    // is not held while executing them.
+    const unsigned MAX_BATCH = 64;
+    SFXCommand batch[MAX_BATCH];
+    bool exit = false;
 
-    // Wait till we have an empty sfx in the queue
-    while (me->m_sfx_commands.getData().empty() ||
-           me->m_sfx_commands.getData().front()->m_command!=SFX_EXIT)
+    me->m_sfx_commands.lock();
+    while (!exit)
     {
-        bool empty = me->m_sfx_commands.getData().empty();
-
         // Wait in cond_wait for a request to arrive. The 'while' is necessary
         // since "spurious wakeups from the pthread_cond_wait ... may occur"
         // (pthread_cond_wait man page)!
-        while (empty)
+        while (me->m_sfx_commands.getData().empty())
         {
             pthread_cond_wait(&me->m_cond_request, me->m_sfx_commands.getMutex());
-            empty = me->m_sfx_commands.getData().empty();
-        }
-        SFXCommand *current = me->m_sfx_commands.getData().front();
-        me->m_sfx_commands.getData().erase(me->m_sfx_commands.getData().begin());
-
-        if (current->m_command == SFX_EXIT)
-        {
-            delete current;
-            break;
         }
+        unsigned count = me->m_sfx_commands.getData().pop(batch, MAX_BATCH);
         me->m_sfx_commands.unlock();
-        switch (current->m_command)
-        {
-        case SFX_PLAY:     current->m_sfx->reallyPlayNow();       break;
-        case SFX_STOP:     current->m_sfx->reallyStopNow();       break;
-        case SFX_PAUSE:    current->m_sfx->reallyPauseNow();      break;
-        case SFX_RESUME:   current->m_sfx->reallyResumeNow();     break;
-        case SFX_SPEED:    current->m_sfx->reallySetSpeed(
-            current->m_parameter.getX());   break;
-        case SFX_POSITION: current->m_sfx->reallySetPosition(
-            current->m_parameter);   break;
-        case SFX_VOLUME:   current->m_sfx->reallySetVolume(
-            current->m_parameter.getX());   break;
-        case SFX_MASTER_VOLUME:
-            current->m_sfx->reallySetMasterVolumeNow(
-                current->m_parameter.getX());   break;
-        case SFX_LOOP:     current->m_sfx->reallySetLoop(
-            current->m_parameter.getX() != 0);   break;
-        case SFX_DELETE:     me->deleteSFX(current->m_sfx);       break;
-        case SFX_PAUSE_ALL:  me->reallyPauseAllNow();             break;
-        case SFX_RESUME_ALL: me->reallyResumeAllNow();            break;
-        case SFX_LISTENER:   me->reallyPositionListenerNow();     break;
-        case SFX_UPDATE:     me->reallyUpdateNow(current);        break;
-        case SFX_MUSIC_START:
-        {
-            current->m_music_information->setDefaultVolume();
-            current->m_music_information->startMusic();           break;
-        }
-        case SFX_MUSIC_STOP:
-            current->m_music_information->stopMusic();            break;
-        case SFX_MUSIC_PAUSE:
-            current->m_music_information->pauseMusic();           break;
-        case SFX_MUSIC_RESUME:
-            current->m_music_information->resumeMusic();
-            // This might be necessasary if the volume was changed
-            // in the in-game menu
-            current->m_music_information->setDefaultVolume();     break;
-        case SFX_MUSIC_SWITCH_FAST:
-            current->m_music_information->switchToFastMusic();    break;
-        case SFX_MUSIC_SET_TMP_VOLUME:
-        {
-            MusicInformation *mi = current->m_music_information;
-            mi->setTemporaryVolume(current->m_parameter.getX());  break;
-        }
-        case SFX_MUSIC_WAITING:
-               current->m_music_information->setMusicWaiting();   break;
-        case SFX_MUSIC_DEFAULT_VOLUME:
+
+        for (unsigned i = 0; i < count; i++)
         {
-            current->m_music_information->setDefaultVolume();
-        }
-        default: assert("Not yet supported.");
+            const SFXCommand &current = batch[i];
+            if (current.m_command == SFX_EXIT)
+            {
+                exit = true;
+                break;
+            }
+            me->executeCommand(current);
         }
-        delete current;
-        current = NULL;
-        // We access the size without lock, doesn't matter if we
+        if (exit)
+            break;
+
+        // We access the queue without lock, doesn't matter if we
         // should get an incorrect value because of concurrent read/writes
-        if (me->m_sfx_commands.getData().size() == 0)
+        if (me->m_sfx_commands.getData().empty())
         {
             // Wait some time to let other threads run, then queue an
             // update event to keep music playing.
@@ -380,15 +433,68 @@ void* SFXManager::mainLoop(void *obj)
     // need to keep the user waiting for STK to exit.
     me->setCanBeDeleted();
 
-    // Clean up memory to avoid leak detection
-    while(!me->m_sfx_commands.getData().empty())
-    {
-        delete me->m_sfx_commands.getData().front();
-        me->m_sfx_commands.getData().erase(me->m_sfx_commands.getData().begin());
-    }
     return NULL;
 }   // mainLoop
 
+//----------------------------------------------------------------------------
+/** Executes a single command, called from the sfx thread.
+ *  \param current The command to execute.
+ */
+void SFXManager::executeCommand(const SFXCommand &current)
+{
+    switch (current.m_command)
+    {
+    case SFX_PLAY:     current.m_sfx->reallyPlayNow();       break;
+    case SFX_STOP:     current.m_sfx->reallyStopNow();       break;
+    case SFX_PAUSE:    current.m_sfx->reallyPauseNow();      break;
+    case SFX_RESUME:   current.m_sfx->reallyResumeNow();     break;
+    case SFX_SPEED:    current.m_sfx->reallySetSpeed(
+        current.m_parameter.getX());   break;
+    case SFX_POSITION: current.m_sfx->reallySetPosition(
+        current.m_parameter);   break;
+    case SFX_VOLUME:   current.m_sfx->reallySetVolume(
+        current.m_parameter.getX());   break;
+    case SFX_MASTER_VOLUME:
+        current.m_sfx->reallySetMasterVolumeNow(
+            current.m_parameter.getX());   break;
+    case SFX_LOOP:     current.m_sfx->reallySetLoop(
+        current.m_parameter.getX() != 0);   break;
+    case SFX_DELETE:     deleteSFX(current.m_sfx);       break;
+    case SFX_PAUSE_ALL:  reallyPauseAllNow();             break;
+    case SFX_RESUME_ALL: reallyResumeAllNow();            break;
+    case SFX_LISTENER:   reallyPositionListenerNow();     break;
+    case SFX_UPDATE:     reallyUpdateNow(current);        break;
+    case SFX_MUSIC_START:
+    {
+        current.m_music_information->setDefaultVolume();
+        current.m_music_information->startMusic();           break;
+    }
+    case SFX_MUSIC_STOP:
+        current.m_music_information->stopMusic();            break;
+    case SFX_MUSIC_PAUSE:
+        current.m_music_information->pauseMusic();           break;
+    case SFX_MUSIC_RESUME:
+        current.m_music_information->resumeMusic();
+        // This might be necessasary if the volume was changed
+        // in the in-game menu
+        current.m_music_information->setDefaultVolume();     break;
+    case SFX_MUSIC_SWITCH_FAST:
+        current.m_music_information->switchToFastMusic();    break;
+    case SFX_MUSIC_SET_TMP_VOLUME:
+    {
+        MusicInformation *mi = current.m_music_information;
+        mi->setTemporaryVolume(current.m_parameter.getX());  break;
+    }
+    case SFX_MUSIC_WAITING:
+           current.m_music_information->setMusicWaiting();   break;
+    case SFX_MUSIC_DEFAULT_VOLUME:
+    {
+        current.m_music_information->setDefaultVolume();
+    }
+    default: assert("Not yet supported.");
+    }
+}   // executeCommand
+
 //----------------------------------------------------------------------------
 /** Called when sound is globally switched on or off. It either pauses or
  *  resumes all sound effects. 
@@ -396,16 +502,9 @@ void* SFXManager::mainLoop(void *obj)
  */
 void SFXManager::toggleSound(const bool on)
 {
-    // When activating SFX, load all buffers
+    // Buffers are loaded when they are first played
     if (on)
     {
-        std::map<std::string, SFXBuffer*>::iterator i = m_all_sfx_types.begin();
-        for (; i != m_all_sfx_types.end(); i++)
-        {
-            SFXBuffer* buffer = (*i).second;
-            buffer->load();
-        }
-
         reallyResumeAllNow();
         m_all_sfx.lock();
         const int sfx_amount = (int)m_all_sfx.getData().size();
@@ -478,25 +577,8 @@ void SFXManager::loadSfx()
 
     delete root;
 
-    // Now load them in parallel
-    const int max = m_all_sfx_types.size();
-    SFXBuffer **array = new SFXBuffer *[max];
-    i = 0;
-
-    for (std::map<std::string, SFXBuffer*>::iterator it = m_all_sfx_types.begin();
-         it != m_all_sfx_types.end(); it++)
-    {
-        SFXBuffer* const buffer = (*it).second;
-        array[i++] = buffer;
-    }
-
-    #pragma omp parallel for private(i)
-    for (i = 0; i < max; i++)
-    {
-        array[i]->load();
-    }
-
-    delete [] array;
+    // The buffers are not loaded here: each one is loaded the first time
+    // a sfx using it is played (see SFXOpenAL::attachSource).
 }   // loadSfx
 
 // -----------------------------------------------------------------------------
@@ -506,7 +588,9 @@ void SFXManager::loadSfx()
  *  enumeration for each effect, for each kart.
  *  \param sfx_name
  *  \param sfxFile must be an absolute pathname
- *  \return        whether loading this sound effect was successful
+ *  \param load   If the buffer should be loaded now instead of when it is
+ *                first played.
+ *  \return        the buffer, or NULL if loading it failed
 
 */
 SFXBuffer* SFXManager::addSingleSfx(const std::string &sfx_name,
@@ -530,12 +614,16 @@ SFXBuffer* SFXManager::addSingleSfx(const std::string &sfx_name,
         return NULL;
     }
 
+    // Unless loading was requested, the buffer is loaded when it is first
+    // played.
+    if (!load) return buffer;
+
     if (UserConfigParams::logMisc())
         Log::debug("SFXManager", "Loading SFX %s", sfx_file.c_str());
 
-    if (load && buffer->load()) return buffer;
+    if (!buffer->load()) return NULL;
 
-    return NULL;
+    return buffer;
 } // addSingleSFX
 
 //----------------------------------------------------------------------------
@@ -683,7 +771,7 @@ void SFXManager::update()
  *  This function is executed once per frame (triggered by the audio thread).
  *  \param current The sfx command - used to get timestep information.
 */
-void SFXManager::reallyUpdateNow(SFXCommand *current)
+void SFXManager::reallyUpdateNow(const SFXCommand &current)
 {
     if (m_last_update_time < 0.0)
     {
@@ -695,7 +783,7 @@ void SFXManager::reallyUpdateNow(SFXCommand *current)
     m_last_update_time = StkTime::getRealTime();
     float dt = float(m_last_update_time - previous_update_time);
 
-    assert(current->m_command==SFX_UPDATE);
+    assert(current.m_command==SFX_UPDATE);
     if (music_manager->getCurrentMusic())
         music_manager->getCurrentMusic()->update(dt);
     m_all_sfx.lock();
@@ -718,8 +806,183 @@ void SFXManager::reallyUpdateNow(SFXCommand *current)
     }   // for i in m_all_sfx
     m_quick_sounds.unlock();
 
+    updateVoices();
 }   // reallyUpdateNow
 
+//----------------------------------------------------------------------------
+/** Creates the pool of sources used by all sfx. This is done once, so that
+ *  no source has to be created while playing. Creation stops if the driver
+ *  runs out of sources.
+ */
+void SFXManager::createSources()
+{
+    m_sources_created = true;
+#if HAVE_OGGVORBIS
+    if (!sfxAllowed()) return;
+    for (m_num_sources = 0; m_num_sources < MAX_SOURCES; m_num_sources++)
+    {
+        ALuint source;
+        alGenSources(1, &source);
+        if (alGetError() != AL_NO_ERROR)
+            break;
+        m_free_sources.getData().push_back(source);
+    }
+    Log::info("SFXManager", "Created %d sources.", m_num_sources);
+#endif
+}   // createSources
+
+//----------------------------------------------------------------------------
+/** Returns a source of the pool that is not used by any sfx, or 0 if all
+ *  sources are in use.
+ */
+ALuint SFXManager::getFreeSource()
+{
+    ALuint source = 0;
+    m_free_sources.lock();
+    if (!m_sources_created)
+        createSources();
+    if (!m_free_sources.getData().empty())
+    {
+        source = m_free_sources.getData().back();
+        m_free_sources.getData().pop_back();
+    }
+    m_free_sources.unlock();
+    return source;
+}   // getFreeSource
+
+//----------------------------------------------------------------------------
+/** Returns a source to the pool.
+ *  \param source The source, which must have been stopped.
+ */
+void SFXManager::releaseSource(ALuint source)
+{
+    m_free_sources.lock();
+    m_free_sources.getData().push_back(source);
+    m_free_sources.unlock();
+}   // releaseSource
+
+//----------------------------------------------------------------------------
+/** Decides which sfx get a source. All playing sfx are sorted by how well
+ *  they can be heard, and only the most audible ones (as many as there are
+ *  sources) are played by OpenAL. The others are virtual, they only advance
+ *  their play time. Paused sfx keep their source unless it is needed by a
+ *  more audible sfx. Called once per update from the sfx thread.
+ */
+void SFXManager::updateVoices()
+{
+    if (!m_sources_created || m_num_sources == 0 || !sfxAllowed()) return;
+
+    const Vec3 listener = m_listener_position.getAtomic();
+    m_voices.clear();
+    m_all_sfx.lock();
+    for (unsigned int i = 0; i < m_all_sfx.getData().size(); i++)
+    {
+        SFXBase *sfx = m_all_sfx.getData()[i];
+        if (sfx->getStatus() == SFXBase::SFX_PLAYING || sfx->hasSource())
+            m_voices.push_back(std::make_pair(sfx->getAudibility(listener),
+                                              sfx));
+    }
+    m_all_sfx.unlock();
+    m_quick_sounds.lock();
+    std::map<std::string, SFXBase*>::iterator i =
+                                               m_quick_sounds.getData().begin();
+    for (; i != m_quick_sounds.getData().end(); i++)
+    {
+        SFXBase *sfx = i->second;
+        if (sfx->getStatus() == SFXBase::SFX_PLAYING || sfx->hasSource())
+            m_voices.push_back(std::make_pair(sfx->getAudibility(listener),
+                                              sfx));
+    }
+    m_quick_sounds.unlock();
+
+    if (m_voices.size() > m_num_sources)
+    {
+        // Only the order of the audible sfx matters
+        std::nth_element(m_voices.begin(), m_voices.begin() + m_num_sources,
+                         m_voices.end(),
+                         std::greater<std::pair<float, SFXBase*> >());
+    }
+
+    // First take the sources from sfx that are not audible enough, then
+    // give them to the most audible sfx that have none.
+    for (unsigned int j = 0; j < m_voices.size(); j++)
+    {
+        SFXBase *sfx = m_voices[j].second;
+        bool keep = j < m_num_sources &&
+                    (m_voices[j].first > 0 ||
+                     sfx->getStatus() == SFXBase::SFX_PAUSED);
+        if (!keep && sfx->hasSource())
+            releaseSource(sfx->detachSource());
+    }
+    for (unsigned int j = 0; j < m_voices.size() && j < m_num_sources; j++)
+    {
+        SFXBase *sfx = m_voices[j].second;
+        if (m_voices[j].first <= 0 || sfx->hasSource())
+            continue;
+        ALuint source = getFreeSource();
+        if (!source)
+            break;
+        if (!sfx->attachSource(source))
+            releaseSource(source);
+    }
+    updateSources(listener);
+}   // updateVoices
+
+//----------------------------------------------------------------------------
+/** Sends the changed positions, pitches and gains of all sfx with a source
+ *  to OpenAL. The position and speed commands only store the new values in
+ *  the sfx, so each source is updated at most once per frame, and only if
+ *  a value changed enough to be heard.
+ *  \param listener Position of the listener.
+ */
+void SFXManager::updateSources(const Vec3 &listener)
+{
+    m_batch_sfx.clear();
+    m_batch_x.clear();
+    m_batch_y.clear();
+    m_batch_z.clear();
+    m_batch_max_distance.clear();
+    m_batch_gain.clear();
+    for (unsigned int j = 0; j < m_voices.size(); j++)
+    {
+        SFXBase *sfx = m_voices[j].second;
+        if (!sfx->hasSource())
+            continue;
+        Vec3 position;
+        float max_distance, gain;
+        sfx->getSourceState(&position, &max_distance, &gain);
+        m_batch_sfx.push_back(sfx);
+        m_batch_x.push_back(position.getX());
+        m_batch_y.push_back(position.getY());
+        m_batch_z.push_back(position.getZ());
+        m_batch_max_distance.push_back(max_distance);
+        m_batch_gain.push_back(gain);
+    }
+
+    const unsigned int count = (unsigned int)m_batch_sfx.size();
+    if (count == 0) return;
+    const float  lx = listener.getX(), ly = listener.getY(),
+                 lz = listener.getZ();
+    const float *x  = &m_batch_x[0];
+    const float *y  = &m_batch_y[0];
+    const float *z  = &m_batch_z[0];
+    const float *max_distance = &m_batch_max_distance[0];
+    float       *gain = &m_batch_gain[0];
+    // Mute the sfx that are too far away, non-positional sfx have a
+    // negative maximum distance.
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const float dx = x[i] - lx, dy = y[i] - ly, dz = z[i] - lz;
+        const float d2 = dx*dx + dy*dy + dz*dz;
+        const bool audible = max_distance[i] < 0.0f ||
+                             d2 <= max_distance[i] * max_distance[i];
+        gain[i] = audible ? gain[i] : 0.0f;
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+        m_batch_sfx[i]->updateSource(gain[i]);
+}   // updateSources
+
 //----------------------------------------------------------------------------
 /** Delete a sound effect object, and removes it from the internal list of
  *  all SFXs. This call deletes the object, and removes it from the list of
@@ -20,7 +20,6 @@
 #define HEADER_SFX_MANAGER_HPP
 
 #include "utils/can_be_deleted.hpp"
-#include "utils/leak_check.hpp"
 #include "utils/no_copy.hpp"
 #include "utils/synchronised.hpp"
 #include "utils/vec3.hpp"
@@ -110,11 +109,10 @@ public:
 private:
 
     /** Data structure for the queue, which stores a sfx and the command to 
-     *  execute for it. */
-    class SFXCommand : public NoCopy
+     *  execute for it. Commands are stored by value in the queue, so no
+     *  memory is allocated when queueing a command. */
+    class SFXCommand
     {
-    private:
-        LEAK_CHECK()
     public:
         /** The sound effect for which the command should be executed. */
         SFXBase *m_sfx;
@@ -128,16 +126,25 @@ private:
          *  floating point values are stored in the X component. */
         Vec3        m_parameter;
         // --------------------------------------------------------------------
-        SFXCommand(SFXCommands command, SFXBase *base)
+        SFXCommand()
         {
-            m_command   = command;
-            m_sfx       = base;
+            m_command           = SFX_UPDATE;
+            m_sfx               = NULL;
+            m_music_information = NULL;
         }   // SFXCommand()
         // --------------------------------------------------------------------
+        SFXCommand(SFXCommands command, SFXBase *base)
+        {
+            m_command           = command;
+            m_sfx               = base;
+            m_music_information = NULL;
+        }   // SFXCommand(SFXBase*)
+        // --------------------------------------------------------------------
         /** Constructor for music information commands. */
         SFXCommand(SFXCommands command, MusicInformation *mi)
         {
             m_command           = command;
+            m_sfx               = NULL;
             m_music_information = mi;
         }   // SFXCommnd(MusicInformation*)
         // --------------------------------------------------------------------
@@ -147,24 +154,72 @@ private:
         {
             m_command = command;
             m_parameter.setX(f);
+            m_sfx               = NULL;
             m_music_information = mi;
         }   // SFXCommnd(MusicInformation *, float)
         // --------------------------------------------------------------------
         SFXCommand(SFXCommands command, SFXBase *base, float parameter)
         {
-            m_command   = command;
-            m_sfx       = base;
+            m_command           = command;
+            m_sfx               = base;
+            m_music_information = NULL;
             m_parameter.setX(parameter);
         }   // SFXCommand(float)
         // --------------------------------------------------------------------
         SFXCommand(SFXCommands command, SFXBase *base, const Vec3 &parameter)
         {
-            m_command   = command;
-            m_sfx       = base;
-            m_parameter = parameter;
+            m_command           = command;
+            m_sfx               = base;
+            m_music_information = NULL;
+            m_parameter         = parameter;
         }   // SFXCommand(Vec3)
     };   // SFXCommand
     // ========================================================================
+    /** A fixed size ring buffer of commands. Commands that only set a
+     *  property of a sound source (position, speed, volume) are coalesced:
+     *  if the same property of the same source is still waiting in the
+     *  queue, only its parameter is replaced. So the queue can't be flooded
+     *  by karts updating their engine sounds every frame, and no commands
+     *  need to be dropped. If the ring should still be full, commands are
+     *  kept in an overflow vector till there is room again. All functions
+     *  must be called with the lock of m_sfx_commands held. */
+    class SFXCommandQueue
+    {
+    private:
+        /** Number of commands in the ring. */
+        static const unsigned CAPACITY = 4096;
+        /** Number of entries of the table used to find coalescable
+         *  commands, a power of two. */
+        static const unsigned COALESCE_SIZE = 1024;
+
+        std::vector<SFXCommand> m_ring;
+        /** Number of commands read from and written to the ring so far.
+         *  Both wrap around, only their difference matters. */
+        unsigned                m_read, m_write;
+        /** For a hash of sfx and command, the write count of the last
+         *  coalescable command with that hash. */
+        std::vector<unsigned>   m_coalesce;
+        /** Commands that didn't fit into the ring, in order. */
+        std::vector<SFXCommand> m_overflow;
+
+        unsigned getHash(const SFXCommand &command) const;
+        bool     isCoalescable(SFXCommands command) const
+        {
+            return command == SFX_POSITION || command == SFX_SPEED ||
+                   command == SFX_VOLUME;
+        }   // isCoalescable
+    public:
+                 SFXCommandQueue();
+        void     push(const SFXCommand &command);
+        unsigned pop(SFXCommand *commands, unsigned max_count);
+        // --------------------------------------------------------------------
+        /** Returns true if no command is waiting. */
+        bool     empty() const
+        {
+            return m_read == m_write && m_overflow.empty();
+        }   // empty
+    };   // SFXCommandQueue
+    // ========================================================================
 
     /** The position of the listener. Its lock will be used to
      *  access m_listener_{position,front, up}. */
@@ -184,8 +239,31 @@ private:
     /** The actual instances (sound sources) */
     Synchronised<std::vector<SFXBase*> > m_all_sfx;
 
+    /** Maximum number of OpenAL sources used for sound effects. */
+    static const unsigned MAX_SOURCES = 32;
+
+    /** Sources of the pool that are not used by any sfx. */
+    Synchronised<std::vector<ALuint> > m_free_sources;
+
+    /** Number of sources created for the pool. */
+    unsigned                  m_num_sources;
+
+    /** If the sources of the pool were created. */
+    bool                      m_sources_created;
+
+    /** Audibility of the playing sfx, reused in each update. */
+    std::vector<std::pair<float, SFXBase*> > m_voices;
+
+    /** The sfx that have a source, and their positions, maximum distances
+     *  and gains, in separate arrays so that the distance culling of all
+     *  sources is one loop over contiguous data. */
+    std::vector<SFXBase*>     m_batch_sfx;
+    std::vector<float>        m_batch_x, m_batch_y, m_batch_z;
+    std::vector<float>        m_batch_max_distance;
+    std::vector<float>        m_batch_gain;
+
     /** The list of sound effects to be played in the next update. */
-    Synchronised< std::vector<SFXCommand*> > m_sfx_commands;
+    Synchronised<SFXCommandQueue> m_sfx_commands;
 
     /** To play non-positional sounds without having to create a
      *  new object for each. */
@@ -211,8 +289,12 @@ private:
 
     static void* mainLoop(void *obj);
     void deleteSFX(SFXBase *sfx);
-    void queueCommand(SFXCommand *command);
+    void queueCommand(const SFXCommand &command);
+    void executeCommand(const SFXCommand &current);
     void reallyPositionListenerNow();
+    void createSources();
+    void updateVoices();
+    void updateSources(const Vec3 &listener);
 
 public:
     static void create();
@@ -250,13 +332,15 @@ public:
     SFXBase*                 createSoundSource(const std::string &name,
                                                const bool addToSFXList=true);
 
+    ALuint                   getFreeSource();
+    void                     releaseSource(ALuint source);
     void                     deleteSFXMapping(const std::string &name);
     void                     pauseAll();
     void                     reallyPauseAllNow();
     void                     resumeAll();
     void                     reallyResumeAllNow();
     void                     update();
-    void                     reallyUpdateNow(SFXCommand *current);
+    void                     reallyUpdateNow(const SFXCommand &current);
     bool                     soundExist(const std::string &name);
     void                     setMasterSFXVolume(float gain);
     float                    getMasterSFXVolume() const { return m_master_gain; }
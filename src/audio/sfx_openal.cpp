@@ -33,11 +33,17 @@
 #  include <AL/al.h>
 #endif
 
+#include <algorithm>
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
 #include <string>
 
+/** Changes smaller than these are not sent to OpenAL. */
+static const float POSITION_THRESHOLD = 0.02f;
+static const float PITCH_THRESHOLD    = 0.002f;
+static const float GAIN_THRESHOLD     = 0.005f;
+
 SFXOpenAL::SFXOpenAL(SFXBuffer* buffer, bool positional, float volume, 
                      bool owns_buffer) 
          : SFXBase()
@@ -52,6 +58,11 @@ SFXOpenAL::SFXOpenAL(SFXBuffer* buffer, bool positional, float volume,
     m_master_gain  = 1.0f;
     m_owns_buffer  = owns_buffer;
     m_play_time    = 0.0f;
+    m_position     = Vec3(0, 0, 0);
+    m_pitch        = 1.0f;
+    m_rolloff      = buffer->getRolloff();
+    m_source_pitch = m_pitch;
+    m_source_gain  = 0.0f;
 
     // Don't initialise anything else if the sfx manager was not correctly
     // initialised. First of all the initialisation will not work, and it
@@ -63,14 +74,12 @@ SFXOpenAL::SFXOpenAL(SFXBuffer* buffer, bool positional, float volume,
 }   // SFXOpenAL
 
 //-----------------------------------------------------------------------------
-/** Deletes the sfx source, and if it owns the buffer, also deletes the sound
- *  buffer. */
+/** Returns the source to the pool, and if it owns the buffer, also deletes
+ *  the sound buffer. */
 SFXOpenAL::~SFXOpenAL()
 {
-    if (m_status!=SFX_UNKNOWN && m_status!=SFX_NOT_INITIALISED)
-    {
-        alDeleteSources(1, &m_sound_source);
-    }
+    if (m_sound_source)
+        SFXManager::get()->releaseSource(detachSource());
 
     if (m_owns_buffer && m_sound_buffer)
     {
@@ -80,51 +89,171 @@ SFXOpenAL::~SFXOpenAL()
 }   // ~SFXOpenAL
 
 //-----------------------------------------------------------------------------
-/** Initialises the sfx. 
+/** Initialises the sfx. No source is created here, sources are taken from
+ *  the pool of the sfx manager when the sfx is played. The buffer is loaded
+ *  when the sfx gets its first source.
  */
 bool SFXOpenAL::init()
 {
     m_status = SFX_UNKNOWN;
 
-    alGenSources(1, &m_sound_source );
-    if (!SFXManager::checkError("generating a source"))
+    if (!m_sound_buffer)
         return false;
 
-    assert( alIsBuffer(m_sound_buffer->getBufferID()) );
-    assert( alIsSource(m_sound_source) );
+    m_status = SFX_STOPPED;
+    return true;
+}   // init
 
-    alSourcei (m_sound_source, AL_BUFFER, m_sound_buffer->getBufferID());
+//-----------------------------------------------------------------------------
+/** Returns the gain of the source, including the master volume. */
+float SFXOpenAL::getGain() const
+{
+    return (m_gain < 0.0f ? m_default_gain : m_gain) * m_master_gain;
+}   // getGain
 
-    if (!SFXManager::checkError("attaching the buffer to the source"))
-        return false;
+//-----------------------------------------------------------------------------
+/** Sets the gain of the source, which is 0 if the sfx is further away from
+ *  the listener than the maximum distance of its buffer. */
+void SFXOpenAL::applyGain()
+{
+    if (m_positional && SFXManager::get()->getListenerPos()
+                            .distance(m_position) > m_sound_buffer->getMaxDist())
+        m_source_gain = 0.0f;
+    else
+        m_source_gain = getGain();
+    alSourcef(m_sound_source, AL_GAIN, m_source_gain);
+}   // applyGain
 
-    alSource3f(m_sound_source, AL_POSITION,       0.0, 0.0, 0.0);
-    alSource3f(m_sound_source, AL_VELOCITY,       0.0, 0.0, 0.0);
-    alSource3f(m_sound_source, AL_DIRECTION,      0.0, 0.0, 0.0);
+//-----------------------------------------------------------------------------
+/** Returns how well this sfx can be heard, which is used by the sfx manager
+ *  to decide which sfx get a source. This approximates the inverse distance
+ *  clamped model of OpenAL. Sounds that are not positional (menu sounds,
+ *  and the sounds of the local kart in single player) are preferred.
+ *  \param listener Position of the listener.
+ */
+float SFXOpenAL::getAudibility(const Vec3 &listener)
+{
+    if (m_status != SFX_PLAYING)
+        return 0.0f;
+    if (!m_positional)
+        return 4.0f * getGain();
 
-    alSourcef (m_sound_source, AL_ROLLOFF_FACTOR, m_sound_buffer->getRolloff());
-    alSourcef (m_sound_source, AL_MAX_DISTANCE,   m_sound_buffer->getMaxDist());
+    const float distance = listener.distance(m_position);
+    if (distance > m_sound_buffer->getMaxDist())
+        return 0.0f;
+    return getGain() / (1.0f + m_rolloff * std::max(distance - 1.0f, 0.0f));
+}   // getAudibility
 
-    if (m_gain < 0.0f)
+//-----------------------------------------------------------------------------
+/** Gives this sfx a source from the pool, and sets all its properties. If
+ *  the sfx is playing, it continues at the current play time. This loads
+ *  the buffer if this is the first time it is used.
+ *  \param source The source to use.
+ *  \return False if the buffer couldn't be loaded, in which case the
+ *          source is not used.
+ */
+bool SFXOpenAL::attachSource(ALuint source)
+{
+    assert(!m_sound_source);
+    if (!m_sound_buffer->isLoaded() && !m_sound_buffer->load())
     {
-        alSourcef (m_sound_source, AL_GAIN, m_default_gain * m_master_gain);
+        // Loading fails too if sfx were disabled in the meantime
+        if (SFXManager::get()->sfxAllowed())
+            m_status = SFX_UNKNOWN;
+        return false;
     }
-    else
+    m_sound_source = source;
+
+    alSourcei (m_sound_source, AL_BUFFER, m_sound_buffer->getBufferID());
+    alSource3f(m_sound_source, AL_POSITION, m_position.getX(),
+               m_position.getY(), -m_position.getZ());
+    alSource3f(m_sound_source, AL_VELOCITY,       0.0, 0.0, 0.0);
+    alSource3f(m_sound_source, AL_DIRECTION,      0.0, 0.0, 0.0);
+    alSourcef (m_sound_source, AL_ROLLOFF_FACTOR, m_rolloff);
+    alSourcef (m_sound_source, AL_MAX_DISTANCE,   m_sound_buffer->getMaxDist());
+    alSourcef (m_sound_source, AL_PITCH,          m_pitch);
+    alSourcei (m_sound_source, AL_SOURCE_RELATIVE,
+               m_positional ? AL_FALSE : AL_TRUE);
+    alSourcei (m_sound_source, AL_LOOPING, m_loop ? AL_TRUE : AL_FALSE);
+    applyGain();
+    m_source_position = m_position;
+    m_source_pitch    = m_pitch;
+
+    if (m_status == SFX_PLAYING)
     {
-        alSourcef (m_sound_source, AL_GAIN, m_gain * m_master_gain);
+        float duration = m_sound_buffer->getDuration();
+        float offset = m_play_time;
+        if (m_loop && duration > 0)
+            offset = fmodf(offset, duration);
+        if (offset > 0 && offset < duration)
+            alSourcef(m_sound_source, AL_SEC_OFFSET, offset);
+        alSourcePlay(m_sound_source);
     }
+    SFXManager::checkError("attaching a source");
+    return true;
+}   // attachSource
 
-    if (m_positional) alSourcei (m_sound_source, AL_SOURCE_RELATIVE, AL_FALSE);
-    else              alSourcei (m_sound_source, AL_SOURCE_RELATIVE, AL_TRUE);
+//-----------------------------------------------------------------------------
+/** Stops the source of this sfx and removes it, so that it can be used by
+ *  another sfx. The sfx keeps its state and play time.
+ *  \return The source that was used.
+ */
+ALuint SFXOpenAL::detachSource()
+{
+    ALuint source = m_sound_source;
+    alSourceStop(source);
+    alSourcei(source, AL_BUFFER, 0);
+    SFXManager::checkError("detaching a source");
+    m_sound_source = 0;
+    return source;
+}   // detachSource
 
-    alSourcei(m_sound_source, AL_LOOPING, m_loop ? AL_TRUE : AL_FALSE);
+//-----------------------------------------------------------------------------
+/** Returns the parameters the sfx manager needs to compute the gain of the
+ *  source of this sfx.
+ *  \param position On return the position of the sfx.
+ *  \param max_distance On return the distance after which the sfx can't be
+ *         heard, or a negative value for non-positional sfx.
+ *  \param gain On return the gain without distance culling.
+ */
+void SFXOpenAL::getSourceState(Vec3 *position, float *max_distance,
+                               float *gain) const
+{
+    *position     = m_position;
+    *max_distance = m_positional ? m_sound_buffer->getMaxDist() : -1.0f;
+    *gain         = getGain();
+}   // getSourceState
 
-    if(!SFXManager::checkError("setting up the source"))
-        return false;
+//-----------------------------------------------------------------------------
+/** Sends the position, pitch and gain to the source if they changed enough
+ *  since they were last set. Called by the sfx manager once per update.
+ *  \param gain The gain computed by the sfx manager, 0 if the sfx is too
+ *         far away from the listener.
+ */
+void SFXOpenAL::updateSource(float gain)
+{
+    if (!m_sound_source) return;
 
-    m_status = SFX_STOPPED;
-    return true;
-}   // init
+    if (fabsf(gain - m_source_gain) > GAIN_THRESHOLD ||
+        (gain == 0.0f && m_source_gain != 0.0f))
+    {
+        alSourcef(m_sound_source, AL_GAIN, gain);
+        m_source_gain = gain;
+    }
+    if (fabsf(m_pitch - m_source_pitch) > PITCH_THRESHOLD)
+    {
+        alSourcef(m_sound_source, AL_PITCH, m_pitch);
+        m_source_pitch = m_pitch;
+    }
+    if (m_positional && (m_position - m_source_position).length2() >
+                        POSITION_THRESHOLD * POSITION_THRESHOLD)
+    {
+        alSource3f(m_sound_source, AL_POSITION, m_position.getX(),
+                   m_position.getY(), -m_position.getZ());
+        m_source_position = m_position;
+    }
+    SFXManager::checkError("updating source");
+}   // updateSource
 
 // ------------------------------------------------------------------------
 /** Updates the status of a playing sfx. If the sound has been played long
@@ -136,8 +265,14 @@ void SFXOpenAL::updatePlayingSFX(float dt)
 {
     assert(m_status==SFX_PLAYING);
     m_play_time += dt;
-    if(!m_loop && m_play_time > m_sound_buffer->getDuration())
+    // The duration is only known once the buffer is loaded
+    if(!m_loop && m_sound_buffer->isLoaded() &&
+       m_play_time > m_sound_buffer->getDuration())
+    {
         m_status = SFX_STOPPED;
+        if (m_sound_source)
+            SFXManager::get()->releaseSource(detachSource());
+    }
 }   // updatePlayingSFX
 
 //-----------------------------------------------------------------------------
@@ -153,6 +288,7 @@ void SFXOpenAL::setSpeed(float factor)
 
 //-----------------------------------------------------------------------------
 /** Changes the pitch of a sound effect. Executed from the sfx manager thread.
+ *  The pitch is sent to OpenAL in the next update.
  *  \param factor Speedup/slowdown between 0.5 and 2.0
  */
 void SFXOpenAL::reallySetSpeed(float factor)
@@ -173,8 +309,7 @@ void SFXOpenAL::reallySetSpeed(float factor)
     {
         factor = 0.5f;
     }
-    alSourcef(m_sound_source,AL_PITCH,factor);
-    SFXManager::checkError("setting speed");
+    m_pitch = factor;
 }   // reallySetSpeed
 
 //-----------------------------------------------------------------------------
@@ -189,7 +324,8 @@ void SFXOpenAL::setVolume(float volume)
 }   // setVolume
 
 //-----------------------------------------------------------------------------
-/** Changes the volume of a sound effect.
+/** Changes the volume of a sound effect. The gain is sent to OpenAL in the
+ *  next update.
  *  \param volume Volume adjustment between 0.0 (mute) and 1.0 (full volume).
  */
 void SFXOpenAL::reallySetVolume(float volume)
@@ -204,8 +340,6 @@ void SFXOpenAL::reallySetVolume(float volume)
         if(m_status==SFX_UNKNOWN)
             return;
     }
-
-    alSourcef(m_sound_source, AL_GAIN, m_gain * m_master_gain);
 }   // reallySetVolume
 
 //-----------------------------------------------------------------------------
@@ -221,18 +355,12 @@ void SFXOpenAL::setMasterVolume(float volume)
 }   // setMasterVolume
 
 //-----------------------------------------------------------------------------
-/** Sets the master volume.
+/** Sets the master volume. The gain is sent to OpenAL in the next update.
  *  \param volume Master volume.
  */
 void SFXOpenAL::reallySetMasterVolumeNow(float volume)
 {
     m_master_gain = volume;
-    
-    if(m_status==SFX_UNKNOWN || m_status == SFX_NOT_INITIALISED) return;
-
-    alSourcef(m_sound_source, AL_GAIN, 
-               (m_gain < 0.0f ? m_default_gain : m_gain) * m_master_gain);
-    SFXManager::checkError("setting volume");
 }   // reallySetMasterVolumeNow
 
 //-----------------------------------------------------------------------------
@@ -259,6 +387,7 @@ void SFXOpenAL::reallySetLoop(bool status)
             return;
     }
 
+    if (!m_sound_source) return;
     alSourcei(m_sound_source, AL_LOOPING, status ? AL_TRUE : AL_FALSE);
     SFXManager::checkError("looping");
 }   // reallySetLoop
@@ -273,7 +402,8 @@ void SFXOpenAL::stop()
 }   // stop
 
 //-----------------------------------------------------------------------------
-/** The sfx manager thread executes a stop for this sfx.
+/** The sfx manager thread executes a stop for this sfx. The source is
+ *  returned to the pool.
  */
 void SFXOpenAL::reallyStopNow()
 {
@@ -281,9 +411,8 @@ void SFXOpenAL::reallyStopNow()
     {
         m_status = SFX_STOPPED;
         m_loop = false;
-        alSourcei(m_sound_source, AL_LOOPING, AL_FALSE);
-        alSourceStop(m_sound_source);
-        SFXManager::checkError("stoping");
+        if (m_sound_source)
+            SFXManager::get()->releaseSource(detachSource());
     }
 }   // reallyStopNow
 
@@ -305,6 +434,7 @@ void SFXOpenAL::reallyPauseNow()
     // from pauseAll, and we have to make sure to only pause playing sfx.
     if (m_status != SFX_PLAYING || !SFXManager::get()->sfxAllowed()) return;
     m_status = SFX_PAUSED;
+    if (!m_sound_source) return;
     alSourcePause(m_sound_source);
     SFXManager::checkError("pausing");
 }   // reallyPauseNow
@@ -332,9 +462,11 @@ void SFXOpenAL::reallyResumeNow()
 
     if(m_status==SFX_PAUSED)
     {
+        m_status = SFX_PLAYING;
+        if (!m_sound_source)
+            return;
         alSourcePlay(m_sound_source);
         SFXManager::checkError("resuming");
-        m_status = SFX_PLAYING;
     }
 }   // reallyResumeNow
 
@@ -359,20 +491,30 @@ void SFXOpenAL::play()
 }   // play
 
 //-----------------------------------------------------------------------------
-/** Plays this sound effect.
+/** Plays this sound effect. If the sfx has no source, it gets a free one
+ *  from the pool if possible. Otherwise it stays virtual till the sfx
+ *  manager decides that it is audible enough to get a source.
  */
 void SFXOpenAL::reallyPlayNow()
 {
     if (!SFXManager::get()->sfxAllowed()) return;
     if (m_status==SFX_NOT_INITIALISED)
     {
-        // lazily create OpenAL source when needed
+        // lazily initialise when needed
         init();
 
-        // creation of OpenAL source failed, giving up
+        // initialisation failed, giving up
         if (m_status==SFX_UNKNOWN) return;
     }
 
+    if (!m_sound_source)
+    {
+        ALuint source = SFXManager::get()->getFreeSource();
+        if (source && !attachSource(source))
+            SFXManager::get()->releaseSource(source);
+        return;
+    }
+
     alSourcePlay(m_sound_source);
     SFXManager::checkError("playing");
 }   // reallyPlayNow
@@ -389,7 +531,8 @@ void SFXOpenAL::setPosition(const Vec3 &position)
 }   // setPosition
 
 //-----------------------------------------------------------------------------
-/** Sets the position where this sound effects is played.
+/** Sets the position where this sound effects is played. The position is
+ *  sent to OpenAL in the next update.
  *  \param position Position of the sound effect.
  */
 void SFXOpenAL::reallySetPosition(const Vec3 &position)
@@ -413,21 +556,7 @@ void SFXOpenAL::reallySetPosition(const Vec3 &position)
         return;
     }
 
-    alSource3f(m_sound_source, AL_POSITION, position.getX(),
-               position.getY(), -position.getZ());
-
-    if (SFXManager::get()->getListenerPos().distance(position)
-        > m_sound_buffer->getMaxDist())
-    {
-        alSourcef(m_sound_source, AL_GAIN, 0);
-    }
-    else
-    {
-        alSourcef(m_sound_source, AL_GAIN, 
-                  (m_gain < 0.0f ? m_default_gain : m_gain) * m_master_gain);
-    }
-
-    SFXManager::checkError("positioning");
+    m_position = position;
 }   // reallySetPosition
 
 //-----------------------------------------------------------------------------
@@ -449,11 +578,8 @@ void SFXOpenAL::onSoundEnabledBack()
         if (m_status==SFX_NOT_INITIALISED) init();
         if (m_status!=SFX_UNKNOWN)
         {
-            alSourcef(m_sound_source, AL_GAIN, 0);
             play();
             pause();
-            alSourcef(m_sound_source, AL_GAIN,
-                     (m_gain < 0.0f ? m_default_gain : m_gain) * m_master_gain);
         }
     }
 }   // onSoundEnabledBack
@@ -462,7 +588,9 @@ void SFXOpenAL::onSoundEnabledBack()
 
 void SFXOpenAL::setRolloff(float rolloff)
 {
-    alSourcef (m_sound_source, AL_ROLLOFF_FACTOR,  rolloff);
+    m_rolloff = rolloff;
+    if (m_sound_source)
+        alSourcef (m_sound_source, AL_ROLLOFF_FACTOR,  rolloff);
 }
 
 #endif //if HAVE_OGGVORBIS
@@ -32,6 +32,11 @@
 
 /**
   * \brief OpenAL implementation of the abstract SFXBase interface
+  *  A sound effect is a virtual voice: all its settings are stored here, and
+  *  it only gets an OpenAL source from the pool of the SFXManager while it
+  *  is one of the most audible sounds. Without a source its play time is
+  *  still advanced, so it continues at the right offset when it gets a
+  *  source again.
   * \ingroup audio
   */
 class SFXOpenAL : public SFXBase
@@ -42,7 +47,8 @@ private:
     /** Buffers hold sound data. */
     SFXBuffer*   m_sound_buffer;
 
-    /** Sources are points emitting sound. */
+    /** Sources are points emitting sound. 0 if this sfx currently has no
+     *  source from the pool. */
     ALuint       m_sound_source;
 
     /** The status of this SFX. */
@@ -75,6 +81,24 @@ private:
     /** How long the sfx has been playing. */
     float m_play_time;
 
+    /** Last position set, applied when a source is attached. */
+    Vec3  m_position;
+
+    /** Last pitch set. */
+    float m_pitch;
+
+    /** Rolloff factor of the source. */
+    float m_rolloff;
+
+    /** Position, pitch and gain last set on the source, so that only
+     *  changes beyond a threshold are sent to OpenAL. */
+    Vec3  m_source_position;
+    float m_source_pitch;
+    float m_source_gain;
+
+    float getGain() const;
+    void  applyGain();
+
 public:
               SFXOpenAL(SFXBuffer* buffer, bool positional, float volume,
                         bool owns_buffer = false);
@@ -103,6 +127,15 @@ public:
     virtual void      reallySetMasterVolumeNow(float volue);
     virtual void      onSoundEnabledBack();
     virtual void      setRolloff(float rolloff);
+    virtual float     getAudibility(const Vec3 &listener);
+    virtual bool      attachSource(ALuint source);
+    virtual ALuint    detachSource();
+    virtual void      getSourceState(Vec3 *position, float *max_distance,
+                                     float *gain) const;
+    virtual void      updateSource(float gain);
+    // ------------------------------------------------------------------------
+    /** Returns if this sfx currently has an OpenAL source. */
+    virtual bool      hasSource() const { return m_sound_source != 0; }
     // ------------------------------------------------------------------------
     /** Returns if this sfx is looped or not. */
     virtual bool      isLooped() { return m_loop; }
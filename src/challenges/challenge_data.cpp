@@ -41,6 +41,7 @@ ChallengeData::ChallengeData(const std::string& filename)
     m_gp_id        = "";
     m_version      = 0;
     m_num_trophies = 0;
+    m_goals_loaded = false;
 
     for (int d=0; d<RaceManager::DIFFICULTY_COUNT; d++)
     {
@@ -154,72 +155,6 @@ ChallengeData::ChallengeData(const std::string& filename)
     }
     requirements_node->get("trophies", &m_num_trophies);
 
-    const XMLNode* difficulties[RaceManager::DIFFICULTY_COUNT];
-    difficulties[0] = root->getNode("easy");
-    difficulties[1] = root->getNode("medium");
-    difficulties[2] = root->getNode("hard");
-
-    // Note that the challenges can only be done in three difficulties
-    if (difficulties[0] == NULL || difficulties[1] == NULL ||
-        difficulties[2] == NULL)
-    {
-        error("<easy> or <medium> or <hard>");
-    }
-
-    for (int d=0; d<=RaceManager::DIFFICULTY_HARD; d++)
-    {
-        const XMLNode* karts_node = difficulties[d]->getNode("karts");
-        if (karts_node == NULL) error("<karts .../>");
-
-        int num_karts = -1;
-        if (!karts_node->get("number", &num_karts)) error("karts");
-        m_num_karts[d] = num_karts;
-
-        std::string ai_kart_ident;
-        if (karts_node->get("aiIdent", &ai_kart_ident))
-            m_ai_kart_ident[d] = ai_kart_ident;
-
-        std::string superPower;
-        if (karts_node->get("superPower", &superPower))
-        {
-            if (superPower == "nolokBoss")
-            {
-                m_ai_superpower[d] = RaceManager::SUPERPOWER_NOLOK_BOSS;
-            }
-            else
-            {
-                Log::warn("ChallengeData", "Unknown superpower '%s'",
-                          superPower.c_str());
-            }
-        }
-
-        const XMLNode* requirements_node =
-                                   difficulties[d]->getNode("requirements");
-        if (requirements_node == NULL) error("<requirements .../>");
-
-        int position = -1;
-        if (!requirements_node->get("position", &position) &&
-            (m_minor == RaceManager::MINOR_MODE_FOLLOW_LEADER ||
-             m_mode  == CM_GRAND_PRIX))
-        {
-            error("position");
-        }
-        else
-        {
-            m_position[d] = position;
-        }
-
-        int time = -1;
-        if (requirements_node->get("time", &time)) m_time[d] = (float)time;
-
-        if (m_time[d] < 0 && m_position[d] < 0) error("position/time");
-
-        // This is optional
-        int energy = -1;
-        if (requirements_node->get("energy", &energy)) m_energy[d] = energy;
-
-    }
-
     std::vector<XMLNode*> unlocks;
     root->getNodes("unlock", unlocks);
     for(unsigned int i=0; i<unlocks.size(); i++)
@@ -253,6 +188,94 @@ ChallengeData::ChallengeData(const std::string& filename)
     m_challenge_description = description;
 }   // ChallengeData
 
+// ----------------------------------------------------------------------------
+/** Reads the karts and requirements of each difficulty from the challenge
+ *  file. This is only done the first time a challenge is displayed, started
+ *  or tested, so that entering story mode doesn't have to parse the goals of
+ *  all challenges. If the file is incorrect an error is printed and the
+ *  defaults are kept.
+ */
+void ChallengeData::loadGoals() const
+{
+    if (m_goals_loaded) return;
+    m_goals_loaded = true;
+
+    std::auto_ptr<XMLNode> root(new XMLNode(m_filename));
+    try
+    {
+        const XMLNode* difficulties[RaceManager::DIFFICULTY_COUNT];
+        difficulties[0] = root->getNode("easy");
+        difficulties[1] = root->getNode("medium");
+        difficulties[2] = root->getNode("hard");
+
+        // Note that the challenges can only be done in three difficulties
+        if (difficulties[0] == NULL || difficulties[1] == NULL ||
+            difficulties[2] == NULL)
+        {
+            error("<easy> or <medium> or <hard>");
+        }
+
+        for (int d=0; d<=RaceManager::DIFFICULTY_HARD; d++)
+        {
+            const XMLNode* karts_node = difficulties[d]->getNode("karts");
+            if (karts_node == NULL) error("<karts .../>");
+
+            int num_karts = -1;
+            if (!karts_node->get("number", &num_karts)) error("karts");
+            m_num_karts[d] = num_karts;
+
+            std::string ai_kart_ident;
+            if (karts_node->get("aiIdent", &ai_kart_ident))
+                m_ai_kart_ident[d] = ai_kart_ident;
+
+            std::string superPower;
+            if (karts_node->get("superPower", &superPower))
+            {
+                if (superPower == "nolokBoss")
+                {
+                    m_ai_superpower[d] = RaceManager::SUPERPOWER_NOLOK_BOSS;
+                }
+                else
+                {
+                    Log::warn("ChallengeData", "Unknown superpower '%s'",
+                              superPower.c_str());
+                }
+            }
+
+            const XMLNode* requirements_node =
+                                     difficulties[d]->getNode("requirements");
+            if (requirements_node == NULL) error("<requirements .../>");
+
+            int position = -1;
+            if (!requirements_node->get("position", &position) &&
+                (m_minor == RaceManager::MINOR_MODE_FOLLOW_LEADER ||
+                 m_mode  == CM_GRAND_PRIX))
+            {
+                error("position");
+            }
+            else
+            {
+                m_position[d] = position;
+            }
+
+            int time = -1;
+            if (requirements_node->get("time", &time))
+                m_time[d] = (float)time;
+
+            if (m_time[d] < 0 && m_position[d] < 0) error("position/time");
+
+            // This is optional
+            int energy = -1;
+            if (requirements_node->get("energy", &energy))
+                m_energy[d] = energy;
+        }
+    }
+    catch (std::runtime_error&)
+    {
+        // The error was already printed by error()
+    }
+}   // loadGoals
+
 // ----------------------------------------------------------------------------
 void ChallengeData::error(const char *id) const
 {
@@ -348,6 +371,7 @@ void ChallengeData::setUnlocks(const std::string &id, RewardType reward)
 // ----------------------------------------------------------------------------
 void ChallengeData::setRace(RaceManager::Difficulty d) const
 {
+    loadGoals();
     if(m_mode==CM_GRAND_PRIX)
         race_manager->setMajorMode(RaceManager::MAJOR_MODE_GRAND_PRIX);
     else if(m_mode==CM_SINGLE_RACE)
@@ -401,6 +425,8 @@ bool ChallengeData::isChallengeFulfilled() const
     // so they can't be fulfilled here.
     if(m_mode==CM_GRAND_PRIX) return false;
 
+    loadGoals();
+
     // Single races
     // ------------
     World *world = World::getWorld();
@@ -452,6 +478,7 @@ bool ChallengeData::isChallengeFulfilled() const
  */
 bool ChallengeData::isGPFulfilled() const
 {
+    loadGoals();
     int d = race_manager->getDifficulty();
 
     // Note that we have to call race_manager->getNumKarts, since there
@@ -83,12 +83,17 @@ private:
     RaceManager::MinorRaceModeType m_minor;
 
     int                            m_num_laps;
-    int                            m_position[RaceManager::DIFFICULTY_COUNT];
-    int                            m_num_karts[RaceManager::DIFFICULTY_COUNT];
-    std::string                    m_ai_kart_ident[RaceManager::DIFFICULTY_COUNT];
-    float                          m_time[RaceManager::DIFFICULTY_COUNT];
-    int                            m_energy[RaceManager::DIFFICULTY_COUNT];
-    RaceManager::AISuperPower      m_ai_superpower[RaceManager::DIFFICULTY_COUNT];
+
+    /** The goals per difficulty are only read from the challenge file
+     *  when they are first needed (see loadGoals), only the data needed
+     *  to lock and display challenges is read at startup. */
+    mutable bool                      m_goals_loaded;
+    mutable int                       m_position[RaceManager::DIFFICULTY_COUNT];
+    mutable int                       m_num_karts[RaceManager::DIFFICULTY_COUNT];
+    mutable std::string               m_ai_kart_ident[RaceManager::DIFFICULTY_COUNT];
+    mutable float                     m_time[RaceManager::DIFFICULTY_COUNT];
+    mutable int                       m_energy[RaceManager::DIFFICULTY_COUNT];
+    mutable RaceManager::AISuperPower m_ai_superpower[RaceManager::DIFFICULTY_COUNT];
     std::string                    m_gp_id;
     std::string                    m_track_id;
     std::string                    m_filename;
@@ -98,6 +103,7 @@ private:
     void setUnlocks(const std::string &id,
                     ChallengeData::RewardType reward);
     void error(const char *id) const;
+    void loadGoals() const;
 
     /** Short, internal name for this challenge. */
     std::string              m_id;
@@ -200,6 +206,7 @@ public:
      */
     int getPosition(RaceManager::Difficulty difficulty) const
     {
+        loadGoals();
         return m_position[difficulty];
     }   // getPosition
 
@@ -208,6 +215,7 @@ public:
      */
     int getNumKarts(RaceManager::Difficulty difficulty) const
     {
+        loadGoals();
         return m_num_karts[difficulty];
     }   // getNumKarts
     // ------------------------------------------------------------------------
@@ -215,6 +223,7 @@ public:
      */
     float getTime(RaceManager::Difficulty difficulty) const
     {
+        loadGoals();
         return m_time[difficulty];
     }   // getTime
     // ------------------------------------------------------------------------
@@ -222,6 +231,7 @@ public:
      */
     int getEnergy(RaceManager::Difficulty difficulty) const
     {
+        loadGoals();
         return m_energy[difficulty];
     }   // getEnergy
     // ------------------------------------------------------------------------
@@ -229,6 +239,7 @@ public:
      */
     const std::string& getAIKartIdent(RaceManager::Difficulty difficulty) const
     {
+        loadGoals();
         return m_ai_kart_ident[difficulty];
     }
 
@@ -261,7 +261,8 @@ void PlayerManager::save()
     std::string filename = file_manager->getUserConfigFile("players.xml");
     try
     {
-        UTFWriter players_file(filename.c_str());
+        // The file is written by the background writer on close()
+        UTFWriter players_file(filename.c_str(), /*in_memory*/true);
 
         players_file << L"<?xml version=\"1.0\"?>\n";
         players_file << L"<players version=\"1\" >\n";
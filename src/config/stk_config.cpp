@@ -150,6 +150,7 @@ void STKConfig::load(const std::string &filename)
     CHECK_NEG(m_replay_delta_pos2,         "replay delta-position"      );
     CHECK_NEG(m_replay_dt,                 "replay delta-t"             );
     CHECK_NEG(m_smooth_angle_limit,        "physics smooth-angle-limit" );
+    CHECK_NEG(m_simulation_rate,           "physics simulation-rate"    );
 
     // Square distance to make distance checks cheaper (no sqrt)
     m_replay_delta_pos2 *= m_replay_delta_pos2;
@@ -178,6 +179,7 @@ void STKConfig::init_defaults()
     m_shield_restrict_weapos     = false;
     m_max_karts                  = -100;
     m_max_skidmarks              = -100;
+    m_simulation_rate            = -100;
     m_min_kart_version           = -100;
     m_max_kart_version           = -100;
     m_min_track_version          = -100;
@@ -187,6 +189,8 @@ void STKConfig::init_defaults()
     m_replay_delta_angle         = -100;
     m_replay_delta_pos2          = -100;
     m_replay_dt                  = -100;
+    m_replay_text_format         = false;
+    m_replay_compress            = true;
     m_title_music                = NULL;
     m_enable_networking          = true;
     m_smooth_normals             = false;
@@ -257,6 +261,7 @@ void STKConfig::getAllData(const XMLNode * root)
     {
         physics_node->get("smooth-normals",     &m_smooth_normals    );
         physics_node->get("smooth-angle-limit", &m_smooth_angle_limit);
+        physics_node->get("simulation-rate",    &m_simulation_rate   );
     }
 
     if (const XMLNode *startup_node= root->getNode("startup"))
@@ -374,6 +379,8 @@ void STKConfig::getAllData(const XMLNode * root)
         replay_node->get("delta-pos",   &m_replay_delta_pos2 );
         replay_node->get("delta-t",     &m_replay_dt         );
         replay_node->get("max-time",    &m_replay_max_time   );
+        replay_node->get("text-format", &m_replay_text_format);
+        replay_node->get("compress",    &m_replay_compress   );
 
     }
 
@@ -102,6 +102,12 @@ public:
      *  triangle are more than this value, the physics will use the normal
      *  of the triangle in smoothing normal. */
     float m_smooth_angle_limit;
+
+    /** Number of simulation ticks per second. The world is updated with a
+     *  fixed time step of 1/m_simulation_rate seconds, independent of the
+     *  frame rate, and the graphics are interpolated between ticks. If 0,
+     *  the world is updated once per frame with the frame time instead. */
+    int   m_simulation_rate;
     int   m_max_skidmarks;           /**<Maximum number of skid marks/kart.  */
     float m_skid_fadeout_time;       /**<Time till skidmarks fade away.      */
     float m_near_ground;             /**<Determines when a kart is not near
@@ -157,6 +163,13 @@ public:
      *  be generated. */
     float m_replay_delta_angle;
 
+    /** If set, replays are saved in the old (larger) text format instead
+     *  of the binary format. */
+    bool m_replay_text_format;
+
+    /** If set, the chunks of binary replay files are compressed. */
+    bool m_replay_compress;
+
 private:
     /** True if stk_config has been loaded. This is necessary if the
      *  --stk-config command line parameter has been specified to avoid
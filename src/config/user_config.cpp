@@ -34,6 +34,7 @@ static PtrVector<UserConfigParam, REF> all_params;
 #include "config/saved_grand_prix.hpp"
 #include "config/stk_config.hpp"
 #include "guiengine/engine.hpp"
+#include "io/background_writer.hpp"
 #include "io/file_manager.hpp"
 #include "io/utf_writer.hpp"
 #include "io/xml_node.hpp"
@@ -43,6 +44,7 @@ static PtrVector<UserConfigParam, REF> all_params;
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <stdlib.h>
 #include <string>
 #include <vector>
@@ -61,7 +63,7 @@ UserConfigParam::~UserConfigParam()
  *  \param stream the xml writer.
  *  \param level determines indentation level.
  */
-void UserConfigParam::writeInner(std::ofstream& stream, int level) const
+void UserConfigParam::writeInner(std::ostream& stream, int level) const
 {
     std::string tab(level * 4,' ');
     stream << "    " << tab.c_str() << m_param_name.c_str() << "=\""
@@ -88,7 +90,7 @@ GroupUserConfigParam::GroupUserConfigParam(const char* group_name,
 }   // GroupUserConfigParam
 
 // ----------------------------------------------------------------------------
-void GroupUserConfigParam::write(std::ofstream& stream) const
+void GroupUserConfigParam::write(std::ostream& stream) const
 {
     const int attr_amount = (int)m_attributes.size();
 
@@ -118,7 +120,7 @@ void GroupUserConfigParam::write(std::ofstream& stream) const
 }   // write
 
 // ----------------------------------------------------------------------------
-void GroupUserConfigParam::writeInner(std::ofstream& stream, int level) const
+void GroupUserConfigParam::writeInner(std::ostream& stream, int level) const
 {
     std::string tab(level * 4,' ');
     for(int i = 0; i < level; i++) tab =+ "    ";
@@ -244,7 +246,7 @@ ListUserConfigParam<T, U>::ListUserConfigParam(const char* param_name,
 
 // ----------------------------------------------------------------------------
 template<typename T, typename U>
-void ListUserConfigParam<T, U>::write(std::ofstream& stream) const
+void ListUserConfigParam<T, U>::write(std::ostream& stream) const
 {
     const int elts_amount = m_elements.size();
 
@@ -349,7 +351,7 @@ IntUserConfigParam::IntUserConfigParam(int default_value,
 }   // IntUserConfigParam
 
 // ----------------------------------------------------------------------------
-void IntUserConfigParam::write(std::ofstream& stream) const
+void IntUserConfigParam::write(std::ostream& stream) const
 {
     if(m_comment.size() > 0) stream << "    <!-- " << m_comment.c_str()
                                     << " -->\n";
@@ -412,7 +414,7 @@ TimeUserConfigParam::TimeUserConfigParam(StkTime::TimeType default_value,
 }   // TimeUserConfigParam
 
 // ----------------------------------------------------------------------------
-void TimeUserConfigParam::write(std::ofstream& stream) const
+void TimeUserConfigParam::write(std::ostream& stream) const
 {
     if(m_comment.size() > 0) stream << "    <!-- " << m_comment.c_str()
                                     << " -->\n";
@@ -483,7 +485,7 @@ StringUserConfigParam::StringUserConfigParam(const char* default_value,
 }   // StringUserConfigParam
 
 // ----------------------------------------------------------------------------
-void StringUserConfigParam::write(std::ofstream& stream) const
+void StringUserConfigParam::write(std::ostream& stream) const
 {
     if(m_comment.size() > 0) stream << "    <!-- " << m_comment.c_str()
                                     << " -->\n";
@@ -535,7 +537,7 @@ BoolUserConfigParam::BoolUserConfigParam(bool default_value,
 
 
 // ----------------------------------------------------------------------------
-void BoolUserConfigParam::write(std::ofstream& stream) const
+void BoolUserConfigParam::write(std::ostream& stream) const
 {
     if(m_comment.size() > 0) stream << "    <!-- " << m_comment.c_str()
                                     << " -->\n";
@@ -620,7 +622,7 @@ FloatUserConfigParam::FloatUserConfigParam(float default_value,
 }   // FloatUserConfigParam
 
 // ----------------------------------------------------------------------------
-void FloatUserConfigParam::write(std::ofstream& stream) const
+void FloatUserConfigParam::write(std::ostream& stream) const
 {
     if(m_comment.size() > 0) stream << "    <!-- " << m_comment.c_str()
                                     << " -->\n";
@@ -747,7 +749,8 @@ void UserConfig::saveConfig()
 
     try
     {
-        std::ofstream configfile (filename.c_str(), std::ofstream::out);
+        // The file is written by the background writer
+        std::ostringstream configfile;
 
         configfile << "<?xml version=\"1.0\"?>\n";
         configfile << "<stkconfig version=\"" << m_current_config_version
@@ -761,7 +764,8 @@ void UserConfig::saveConfig()
         }
 
         configfile << "</stkconfig>\n";
-        configfile.close();
+        std::string data = configfile.str();
+        BackgroundWriter::write(filename, &data);
     }
     catch (std::runtime_error& e)
     {
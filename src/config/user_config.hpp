@@ -68,8 +68,8 @@ protected:
     std::string m_comment;
 public:
     virtual     ~UserConfigParam();
-    virtual void write(std::ofstream & stream) const = 0;
-    virtual void writeInner(std::ofstream & stream, int level = 0) const;
+    virtual void write(std::ostream& stream) const = 0;
+    virtual void writeInner(std::ostream& stream, int level = 0) const;
     virtual void findYourDataInAChildOf(const XMLNode* node) = 0;
     virtual void findYourDataInAnAttributeOf(const XMLNode* node) = 0;
     virtual irr::core::stringc toString() const = 0;
@@ -85,8 +85,8 @@ public:
     GroupUserConfigParam(const char* param_name,
                        GroupUserConfigParam* group,
                        const char* comment = NULL);
-    void write(std::ofstream& stream) const;
-    void writeInner(std::ofstream& stream, int level = 0) const;
+    void write(std::ostream& stream) const;
+    void writeInner(std::ostream& stream, int level = 0) const;
     void findYourDataInAChildOf(const XMLNode* node);
     void findYourDataInAnAttributeOf(const XMLNode* node);
 
@@ -119,7 +119,7 @@ public:
                          int nb_elts,
                          ...);
 
-    void write(std::ofstream& stream) const;
+    void write(std::ostream& stream) const;
     void findYourDataInAChildOf(const XMLNode* node);
     void findYourDataInAnAttributeOf(const XMLNode* node);
 
@@ -150,7 +150,7 @@ public:
                        GroupUserConfigParam* group,
                        const char* comment = NULL);
 
-    void write(std::ofstream& stream) const;
+    void write(std::ostream& stream) const;
     void findYourDataInAChildOf(const XMLNode* node);
     void findYourDataInAnAttributeOf(const XMLNode* node);
 
@@ -177,7 +177,7 @@ public:
     TimeUserConfigParam(StkTime::TimeType default_value, const char* param_name,
                         GroupUserConfigParam* group, const char* comment=NULL);
 
-    void write(std::ofstream& stream) const;
+    void write(std::ostream& stream) const;
     void findYourDataInAChildOf(const XMLNode* node);
     void findYourDataInAnAttributeOf(const XMLNode* node);
 
@@ -204,7 +204,7 @@ public:
                           GroupUserConfigParam* group,
                           const char* comment = NULL);
 
-    void write(std::ofstream& stream) const;
+    void write(std::ostream& stream) const;
     void findYourDataInAChildOf(const XMLNode* node);
     void findYourDataInAnAttributeOf(const XMLNode* node);
 
@@ -235,7 +235,7 @@ public:
     BoolUserConfigParam(bool default_value, const char* param_name,
                         GroupUserConfigParam* group,
                         const char* comment = NULL);
-    void write(std::ofstream& stream) const;
+    void write(std::ostream& stream) const;
     void findYourDataInAChildOf(const XMLNode* node);
     void findYourDataInAnAttributeOf(const XMLNode* node);
 
@@ -261,7 +261,7 @@ public:
                          GroupUserConfigParam* group,
                          const char* comment = NULL);
 
-    void write(std::ofstream& stream) const;
+    void write(std::ostream& stream) const;
     void findYourDataInAChildOf(const XMLNode* node);
     void findYourDataInAnAttributeOf(const XMLNode* node);
 
@@ -319,6 +319,10 @@ namespace UserConfigParams
     PARAM_PREFIX FloatUserConfigParam       m_music_volume
             PARAM_DEFAULT(  FloatUserConfigParam(0.7f, "music_volume",
             &m_audio_group, "Music volume from 0.0 to 1.0") );
+    PARAM_PREFIX IntUserConfigParam         m_music_prefetch_buffers
+            PARAM_DEFAULT(  IntUserConfigParam(8, "music_prefetch_buffers",
+            &m_audio_group, "Number of quarter second buffers of music that "
+                            "are decoded ahead by the music thread.") );
 
     // ---- Race setup
     PARAM_PREFIX GroupUserConfigParam        m_race_setup_group
@@ -440,6 +444,10 @@ namespace UserConfigParams
     PARAM_PREFIX IntUserConfigParam         m_max_fps
             PARAM_DEFAULT(  IntUserConfigParam(120, "max_fps",
                        &m_video_group, "Maximum fps, should be at least 60") );
+    PARAM_PREFIX BoolUserConfigParam        m_retained_menus
+            PARAM_DEFAULT(  BoolUserConfigParam(true, "retained_menus",
+                            &m_video_group, "Only redraw menus when something "
+                                            "changed") );
     PARAM_PREFIX BoolUserConfigParam        m_force_legacy_device
         PARAM_DEFAULT(BoolUserConfigParam(false, "force_legacy_device",
         &m_video_group, "Force OpenGL 2 context, even if OpenGL 3 is available."));
@@ -447,6 +455,19 @@ namespace UserConfigParams
     PARAM_PREFIX BoolUserConfigParam        m_texture_compression
         PARAM_DEFAULT(BoolUserConfigParam(true, "enable_texture_compression",
         &m_video_group, "Enable Texture Compression"));
+    PARAM_PREFIX BoolUserConfigParam        m_texture_streaming
+        PARAM_DEFAULT(BoolUserConfigParam(true, "enable_texture_streaming",
+        &m_video_group, "Load cached compressed textures in the background "
+                        "while the game is running"));
+    PARAM_PREFIX FloatUserConfigParam       m_texture_upload_budget
+        PARAM_DEFAULT(FloatUserConfigParam(2.0f, "texture_upload_budget",
+        &m_video_group, "Time in ms per frame used to upload streamed "
+                        "textures"));
+    PARAM_PREFIX IntUserConfigParam         m_texture_vram_budget
+        PARAM_DEFAULT(IntUserConfigParam(0, "texture_vram_budget",
+        &m_video_group, "Memory in MB that streamed textures may use, the "
+                        "largest mipmap levels of unused textures are "
+                        "dropped above it (0 = unlimited)"));
     /** This is a bit flag: bit 0: enabled (1) or disabled(0). 
      *  Bit 1: setting done by default(0), or by user choice (2). This allows
      *  to e.g. disable h.d. textures on hd3000 as default, but still allow the
@@ -476,6 +497,18 @@ namespace UserConfigParams
     PARAM_PREFIX BoolUserConfigParam        m_azdo
         PARAM_DEFAULT(BoolUserConfigParam(false, "enable_azdo",
         &m_video_group, "Enable 'Approaching Zero Driver Overhead' mode (very experimental !)"));
+    PARAM_PREFIX BoolUserConfigParam        m_texture_arrays
+        PARAM_DEFAULT(BoolUserConfigParam(true, "enable_texture_arrays",
+        &m_video_group, "Pack the textures of solid meshes into texture arrays if 'Approaching Zero Driver Overhead' mode is not used"));
+    PARAM_PREFIX BoolUserConfigParam        m_packed_vertices
+        PARAM_DEFAULT(BoolUserConfigParam(true, "enable_packed_vertices",
+        &m_video_group, "Store the normals, tangents and lightmap coordinates of meshes in a smaller format"));
+    PARAM_PREFIX BoolUserConfigParam        m_dynamic_resolution
+        PARAM_DEFAULT(BoolUserConfigParam(false, "enable_dynamic_resolution",
+        &m_video_group, "Lower the resolution of the 3D scene when the GPU can't hold the target frame time"));
+    PARAM_PREFIX FloatUserConfigParam       m_dynamic_resolution_target
+        PARAM_DEFAULT(FloatUserConfigParam(16.0f, "dynamic_resolution_target_ms",
+        &m_video_group, "GPU time per frame in ms the dynamic resolution tries to hold"));
     PARAM_PREFIX BoolUserConfigParam        m_sdsm
         PARAM_DEFAULT(BoolUserConfigParam(false, "enable_sdsm",
         &m_video_group, "Enable Sampled Distribued Shadow Map (buggy atm)"));
@@ -554,6 +587,12 @@ namespace UserConfigParams
             PARAM_DEFAULT(  IntUserConfigParam(16, "server_max_players",
                                        "Maximum number of players on the server.") );
 
+    PARAM_PREFIX FloatUserConfigParam       m_network_interpolation_delay
+            PARAM_DEFAULT(  FloatUserConfigParam(0.15f, "network_interpolation_delay",
+                                       "How far (in seconds) remote karts are displayed behind "
+                                       "the server time. Should be more than the time between "
+                                       "two kart updates.") );
+
     PARAM_PREFIX StringListUserConfigParam         m_stun_servers
             PARAM_DEFAULT(  StringListUserConfigParam("Stun_servers", "The stun servers"
                             " that will be used to know the public address.",
@@ -587,6 +626,24 @@ namespace UserConfigParams
             PARAM_DEFAULT( StringUserConfigParam("packets_log.txt", "packets_log_filename",
                                                  "Where to log received and sent packets.") );
 
+    PARAM_PREFIX StringUserConfigParam m_network_stats_filename
+            PARAM_DEFAULT( StringUserConfigParam("", "network_stats_filename",
+                                                 "If not empty, network statistics are appended "
+                                                 "to this file once per second (one line of JSON "
+                                                 "each).") );
+
+    PARAM_PREFIX IntUserConfigParam m_worker_threads
+            PARAM_DEFAULT( IntUserConfigParam(-1, "worker_threads",
+                                              "Number of threads used for parallel "
+                                              "updates (including the main thread), "
+                                              "-1 to use one per processor.") );
+
+    PARAM_PREFIX IntUserConfigParam m_track_cache_size
+            PARAM_DEFAULT( IntUserConfigParam(256, "track_cache_size",
+                                              "Memory in MB used to keep the meshes and "
+                                              "textures of recently used tracks loaded, "
+                                              "0 to free them after each race.") );
+
     // ---- Graphic Quality
     PARAM_PREFIX GroupUserConfigParam        m_graphics_quality
             PARAM_DEFAULT( GroupUserConfigParam("GFX",
@@ -657,6 +714,10 @@ namespace UserConfigParams
             PARAM_DEFAULT(BoolUserConfigParam(false,
                            "ssao", &m_graphics_quality,
                            "Enable Screen Space Ambient Occlusion") );
+    PARAM_PREFIX IntUserConfigParam          m_ssao_downscale
+            PARAM_DEFAULT( IntUserConfigParam(1,
+                           "ssao_downscale", &m_graphics_quality,
+                           "Divisor of the resolution Screen Space Ambient Occlusion is computed at (1, 2 or 4)") );
     PARAM_PREFIX IntUserConfigParam          m_shadows_resolution
             PARAM_DEFAULT( IntUserConfigParam(0,
                            "shadows_resoltion", &m_graphics_quality,
@@ -845,6 +906,17 @@ namespace UserConfigParams
             PARAM_DEFAULT( BoolUserConfigParam(false, "artist_debug_mode",
                                "Whether to enable track debugging features") );
 
+    PARAM_PREFIX FloatUserConfigParam       m_script_time_budget
+            PARAM_DEFAULT( FloatUserConfigParam(20.0f, "script_time_budget",
+                               "Time in ms the scripts of a track may run per "
+                               "frame before they are aborted, 0 for no "
+                               "limit") );
+
+    PARAM_PREFIX BoolUserConfigParam        m_script_profiling
+            PARAM_DEFAULT( BoolUserConfigParam(false, "script_profiling",
+                               "Log the script functions which took most "
+                               "time when a track is left") );
+
     // TODO? implement blacklist for new irrlicht device and GUI
     PARAM_PREFIX std::vector<std::string>   m_blacklist_res;
 
@@ -18,10 +18,208 @@
 #include "2dutils.hpp"
 #include "central_settings.hpp"
 #include "glwrap.hpp"
+#include "graphics/transient_buffer.hpp"
 #include "utils/cpp2011.hpp"
 
 #include "../../lib/irrlicht/source/Irrlicht/COpenGLTexture.h"
 
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+#include <vector>
+
+/** Quads drawn with draw2DImage between begin2DBatch() and end2DBatch() are
+ *  collected here and drawn with one draw call per run of quads that share
+ *  the texture, blending and clip rectangle. Any other 2D draw flushes the
+ *  pending quads first, so that the drawing order is kept. */
+namespace Batch2D
+{
+    struct Vertex
+    {
+        float         m_position[2];
+        float         m_uv[2];
+        video::SColor m_color;
+    };   // Vertex
+
+    int                 g_depth = 0;
+    std::vector<Vertex> g_vertices;
+    GLuint              g_texture = 0;
+    bool                g_alpha = false;
+    bool                g_distance_field = false;
+    bool                g_has_clip = false;
+    core::rect<s32>     g_clip;
+}   // namespace Batch2D
+
+// ----------------------------------------------------------------------------
+/** Starts collecting the quads drawn with draw2DImage. Calls can be nested,
+ *  the quads are drawn at the latest when the outermost end2DBatch is
+ *  called. */
+void begin2DBatch()
+{
+    Batch2D::g_depth++;
+}   // begin2DBatch
+
+// ----------------------------------------------------------------------------
+void end2DBatch()
+{
+    assert(Batch2D::g_depth > 0);
+    Batch2D::g_depth--;
+    if (Batch2D::g_depth == 0)
+        flush2DBatch();
+}   // end2DBatch
+
+// ----------------------------------------------------------------------------
+/** Draws the quads collected so far. Must be called before drawing anything
+ *  that doesn't go through the functions in this file while a batch is
+ *  open. */
+void flush2DBatch()
+{
+    if (Batch2D::g_vertices.empty())
+        return;
+
+    if (Batch2D::g_alpha)
+    {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    else
+    {
+        glDisable(GL_BLEND);
+    }
+    if (Batch2D::g_has_clip)
+    {
+        glEnable(GL_SCISSOR_TEST);
+        const core::dimension2d<u32>& renderTargetSize = irr_driver->getActualScreenSize();
+        glScissor(Batch2D::g_clip.UpperLeftCorner.X,
+            renderTargetSize.Height - Batch2D::g_clip.LowerRightCorner.Y,
+            Batch2D::g_clip.getWidth(), Batch2D::g_clip.getHeight());
+    }
+
+    UIShader::Batched2DShader *shader = UIShader::Batched2DShader::getInstance();
+    if (Batch2D::g_distance_field)
+    {
+        glUseProgram(UIShader::Batched2DDistanceFieldShader::getInstance()->Program);
+        UIShader::Batched2DDistanceFieldShader::getInstance()
+                                      ->SetTextureUnits(Batch2D::g_texture);
+    }
+    else
+    {
+        glUseProgram(shader->Program);
+        shader->SetTextureUnits(Batch2D::g_texture);
+    }
+    glBindVertexArray(shader->vao);
+    const size_t vertices_size = Batch2D::g_vertices.size()
+                               * sizeof(Batch2D::Vertex);
+    size_t offset = 0;
+    void *dst = TransientBuffer::isUsable()
+              ? TransientBuffer::getInstance()->allocate(vertices_size,
+                                                sizeof(Batch2D::Vertex), &offset)
+              : NULL;
+    if (dst)
+    {
+        // Written into the persistently mapped ring, which only needs the
+        // vertex pointers to be moved to the allocated range
+        memcpy(dst, Batch2D::g_vertices.data(), vertices_size);
+        glBindBuffer(GL_ARRAY_BUFFER, TransientBuffer::getInstance()->getBuffer());
+    }
+    else
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, shader->vbo);
+        // Orphan the previous storage so that the driver doesn't have to
+        // wait for the last draw call using it
+        const size_t size = UIShader::Batched2DShader::MAX_QUADS * 4
+                          * sizeof(Batch2D::Vertex);
+        glBufferData(GL_ARRAY_BUFFER, size, 0, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices_size,
+                        Batch2D::g_vertices.data());
+    }
+    const GLsizei stride = sizeof(Batch2D::Vertex);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride,
+                          (GLvoid*)(offset + 2 * sizeof(float)));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          (GLvoid*)(offset + 4 * sizeof(float)));
+    glDrawElements(GL_TRIANGLES, (GLsizei)(Batch2D::g_vertices.size() / 4 * 6),
+        GL_UNSIGNED_SHORT, 0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (Batch2D::g_has_clip)
+        glDisable(GL_SCISSOR_TEST);
+    glUseProgram(0);
+    Batch2D::g_vertices.clear();
+
+    glGetError();
+}   // flush2DBatch
+
+// ----------------------------------------------------------------------------
+/** Adds a quad to the current batch, flushing it first if the quad can't be
+ *  drawn in the same call.
+ *  \param colors The colors of the 4 vertices, or NULL for white.
+ *  \param single_color True if colors points to a single color that is used
+ *         for all vertices.
+ *  \param distance_field True if the alpha channel of the texture is a
+ *         distance field, see draw2DDistanceFieldImage.
+ */
+static void addQuadToBatch(const video::ITexture *texture,
+    const core::rect<s32>& destRect, const core::rect<s32>& sourceRect,
+    const core::rect<s32>* clipRect, const video::SColor *colors,
+    bool single_color, bool useAlphaChannelOfTexture,
+    bool distance_field = false)
+{
+    if (clipRect && !clipRect->isValid())
+        return;
+
+    const GLuint gl_texture = static_cast<const irr::video::COpenGLTexture*>(texture)->getOpenGLTextureName();
+    if (!Batch2D::g_vertices.empty() &&
+        (Batch2D::g_texture != gl_texture ||
+         Batch2D::g_alpha != useAlphaChannelOfTexture ||
+         Batch2D::g_distance_field != distance_field ||
+         Batch2D::g_has_clip != (clipRect != NULL) ||
+         (clipRect && Batch2D::g_clip != *clipRect) ||
+         Batch2D::g_vertices.size() >= UIShader::Batched2DShader::MAX_QUADS * 4))
+        flush2DBatch();
+    Batch2D::g_texture = gl_texture;
+    Batch2D::g_alpha = useAlphaChannelOfTexture;
+    Batch2D::g_distance_field = distance_field;
+    Batch2D::g_has_clip = clipRect != NULL;
+    if (clipRect)
+        Batch2D::g_clip = *clipRect;
+
+    const core::dimension2d<u32> &screen = irr_driver->getActualScreenSize();
+    const float left   = 2.0f * destRect.UpperLeftCorner.X  / screen.Width  - 1.0f;
+    const float right  = 2.0f * destRect.LowerRightCorner.X / screen.Width  - 1.0f;
+    const float top    = 1.0f - 2.0f * destRect.UpperLeftCorner.Y  / screen.Height;
+    const float bottom = 1.0f - 2.0f * destRect.LowerRightCorner.Y / screen.Height;
+
+    const core::dimension2d<u32> &size = texture->getSize();
+    const float u0 = float(sourceRect.UpperLeftCorner.X)  / size.Width;
+    const float u1 = float(sourceRect.LowerRightCorner.X) / size.Width;
+    float v_top    = float(sourceRect.UpperLeftCorner.Y)  / size.Height;
+    float v_bottom = float(sourceRect.LowerRightCorner.Y) / size.Height;
+    // Render targets are upside down, see getSize
+    if (texture->isRenderTarget())
+        std::swap(v_top, v_bottom);
+
+    // Same vertex order as quad_buffer, which the unbatched shaders use
+    const float positions[4][4] = { { left,  bottom, u0, v_bottom },
+                                    { left,  top,    u0, v_top    },
+                                    { right, bottom, u1, v_bottom },
+                                    { right, top,    u1, v_top    } };
+    for (unsigned i = 0; i < 4; i++)
+    {
+        Batch2D::Vertex vertex;
+        vertex.m_position[0] = positions[i][0];
+        vertex.m_position[1] = positions[i][1];
+        vertex.m_uv[0]       = positions[i][2];
+        vertex.m_uv[1]       = positions[i][3];
+        vertex.m_color       = !colors ? video::SColor(255, 255, 255, 255)
+                             : single_color ? colors[0] : colors[i];
+        Batch2D::g_vertices.push_back(vertex);
+    }
+}   // addQuadToBatch
+
+// ----------------------------------------------------------------------------
+
 static void drawTexColoredQuad(const video::ITexture *texture, const video::SColor *col, float width, float height,
     float center_pos_x, float center_pos_y, float tex_center_pos_x, float tex_center_pos_y,
     float tex_width, float tex_height)
@@ -128,6 +326,12 @@ void draw2DImage(const video::ITexture* texture, const core::rect<s32>& destRect
         draw2DImage(texture, destRect, sourceRect, clipRect, duplicatedArray, useAlphaChannelOfTexture);
         return;
     }
+    if (Batch2D::g_depth > 0)
+    {
+        addQuadToBatch(texture, destRect, sourceRect, clipRect, &colors,
+                       /*single_color*/true, useAlphaChannelOfTexture);
+        return;
+    }
 
     float width, height,
         center_pos_x, center_pos_y,
@@ -180,6 +384,7 @@ void draw2DImageFromRTT(GLuint texture, size_t texture_w, size_t texture_h,
     const core::rect<s32>& sourceRect, const core::rect<s32>* clipRect,
     const video::SColor &colors, bool useAlphaChannelOfTexture)
 {
+    flush2DBatch();
     if (useAlphaChannelOfTexture)
     {
         glEnable(GL_BLEND);
@@ -217,6 +422,12 @@ void draw2DImage(const video::ITexture* texture, const core::rect<s32>& destRect
         irr_driver->getVideoDriver()->draw2DImage(texture, destRect, sourceRect, clipRect, colors, useAlphaChannelOfTexture);
         return;
     }
+    if (Batch2D::g_depth > 0)
+    {
+        addQuadToBatch(texture, destRect, sourceRect, clipRect, colors,
+                       /*single_color*/false, useAlphaChannelOfTexture);
+        return;
+    }
 
     float width, height,
         center_pos_x, center_pos_y,
@@ -259,6 +470,30 @@ void draw2DImage(const video::ITexture* texture, const core::rect<s32>& destRect
     glGetError();
 }
 
+// ----------------------------------------------------------------------------
+/** Draws a part of a texture whose alpha channel is a signed distance field
+ *  (as created by the font tool), so that it stays sharp at any scale. It is
+ *  always drawn with alpha blending, and batched with the other quads.
+ *  Without shaders the distance field is drawn as plain alpha, which is
+ *  blurry but readable.
+ */
+void draw2DDistanceFieldImage(const video::ITexture* texture,
+    const core::rect<s32>& destRect, const core::rect<s32>& sourceRect,
+    const core::rect<s32>* clipRect, const video::SColor* const colors)
+{
+    if (!CVS->isGLSL())
+    {
+        irr_driver->getVideoDriver()->draw2DImage(texture, destRect, sourceRect,
+                                                  clipRect, colors, true);
+        return;
+    }
+    begin2DBatch();
+    addQuadToBatch(texture, destRect, sourceRect, clipRect, colors,
+                   /*single_color*/false, /*alpha*/true,
+                   /*distance_field*/true);
+    end2DBatch();
+}   // draw2DDistanceFieldImage
+
 void draw2DVertexPrimitiveList(video::ITexture *tex, const void* vertices,
     u32 vertexCount, const void* indexList, u32 primitiveCount,
     video::E_VERTEX_TYPE vType, scene::E_PRIMITIVE_TYPE pType, video::E_INDEX_TYPE iType)
@@ -268,6 +503,7 @@ void draw2DVertexPrimitiveList(video::ITexture *tex, const void* vertices,
         irr_driver->getVideoDriver()->draw2DVertexPrimitiveList(vertices, vertexCount, indexList, primitiveCount, vType, pType, iType);
         return;
     }
+    flush2DBatch();
     GLuint tmpvao, tmpvbo, tmpibo;
     primitiveCount += 2;
     glGenVertexArrays(1, &tmpvao);
@@ -303,6 +539,7 @@ void GL32_draw2DRectangle(video::SColor color, const core::rect<s32>& position,
         irr_driver->getVideoDriver()->draw2DRectangle(color, position, clip);
         return;
     }
+    flush2DBatch();
 
     core::dimension2d<u32> frame_size = irr_driver->getActualScreenSize();
     const int screen_w = frame_size.Width;
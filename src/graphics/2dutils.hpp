@@ -27,6 +27,10 @@
 #include <ITexture.h>
 #include <irrTypes.h>
 
+void begin2DBatch();
+void end2DBatch();
+void flush2DBatch();
+
 void draw2DImageFromRTT(GLuint texture, size_t texture_w, size_t texture_h,
     const irr::core::rect<irr::s32>& destRect,
     const irr::core::rect<irr::s32>& sourceRect, const irr::core::rect<irr::s32>* clipRect,
@@ -40,6 +44,11 @@ void draw2DImage(const irr::video::ITexture* texture, const irr::core::rect<irr:
     const irr::core::rect<irr::s32>& sourceRect, const irr::core::rect<irr::s32>* clipRect,
     const irr::video::SColor* const colors, bool useAlphaChannelOfTexture);
 
+void draw2DDistanceFieldImage(const irr::video::ITexture* texture,
+    const irr::core::rect<irr::s32>& destRect,
+    const irr::core::rect<irr::s32>& sourceRect, const irr::core::rect<irr::s32>* clipRect,
+    const irr::video::SColor* const colors);
+
 void draw2DVertexPrimitiveList(irr::video::ITexture *t, const void* vertices,
     irr::u32 vertexCount, const void* indexList, irr::u32 primitiveCount,
     irr::video::E_VERTEX_TYPE vType = irr::video::EVT_STANDARD, irr::scene::E_PRIMITIVE_TYPE pType = irr::scene::EPT_TRIANGLES, irr::video::E_INDEX_TYPE iType = irr::video::EIT_16BIT);
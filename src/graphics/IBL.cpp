@@ -21,6 +21,9 @@
 #include <cmath>
 #include <set>
 #include "central_settings.hpp"
+#include "utils/worker_pool.hpp"
+
+#include <vector>
 
 static void getXYZ(GLenum face, float i, float j, float &x, float &y, float &z)
 {
@@ -69,41 +72,47 @@ static void getYml(GLenum face, size_t edge_size,
     float *Y1minus1, float *Y10, float *Y11,
     float *Y2minus2, float *Y2minus1, float *Y20, float *Y21, float *Y22)
 {
-#pragma omp parallel for
-    for (int i = 0; i < int(edge_size); i++)
+    WorkerPool::Job job = [&](unsigned int first, unsigned int last)
     {
-        for (unsigned j = 0; j < edge_size; j++)
+        for (unsigned i = first; i < last; i++)
         {
-            float x, y, z;
-            float fi = float(i), fj = float(j);
-            fi /= edge_size, fj /= edge_size;
-            fi = 2 * fi - 1, fj = 2 * fj - 1;
-            getXYZ(face, fi, fj, x, y, z);
-
-            // constant part of Ylm
-            float c00 = 0.282095f;
-            float c1minus1 = 0.488603f;
-            float c10 = 0.488603f;
-            float c11 = 0.488603f;
-            float c2minus2 = 1.092548f;
-            float c2minus1 = 1.092548f;
-            float c21 = 1.092548f;
-            float c20 = 0.315392f;
-            float c22 = 0.546274f;
-
-            size_t idx = i * edge_size + j;
-
-            Y00[idx] = c00;
-            Y1minus1[idx] = c1minus1 * y;
-            Y10[idx] = c10 * z;
-            Y11[idx] = c11 * x;
-            Y2minus2[idx] = c2minus2 * x * y;
-            Y2minus1[idx] = c2minus1 * y * z;
-            Y21[idx] = c21 * x * z;
-            Y20[idx] = c20 * (3 * z * z - 1);
-            Y22[idx] = c22 * (x * x - y * y);
+            for (unsigned j = 0; j < edge_size; j++)
+            {
+                float x, y, z;
+                float fi = float(i), fj = float(j);
+                fi /= edge_size, fj /= edge_size;
+                fi = 2 * fi - 1, fj = 2 * fj - 1;
+                getXYZ(face, fi, fj, x, y, z);
+
+                // constant part of Ylm
+                float c00 = 0.282095f;
+                float c1minus1 = 0.488603f;
+                float c10 = 0.488603f;
+                float c11 = 0.488603f;
+                float c2minus2 = 1.092548f;
+                float c2minus1 = 1.092548f;
+                float c21 = 1.092548f;
+                float c20 = 0.315392f;
+                float c22 = 0.546274f;
+
+                size_t idx = i * edge_size + j;
+
+                Y00[idx] = c00;
+                Y1minus1[idx] = c1minus1 * y;
+                Y10[idx] = c10 * z;
+                Y11[idx] = c11 * x;
+                Y2minus2[idx] = c2minus2 * x * y;
+                Y2minus1[idx] = c2minus1 * y * z;
+                Y21[idx] = c21 * x * z;
+                Y20[idx] = c20 * (3 * z * z - 1);
+                Y22[idx] = c22 * (x * x - y * y);
+            }
         }
-    }
+    };
+    if (WorkerPool::exists())
+        WorkerPool::get()->parallelFor((unsigned int)edge_size, 8, job);
+    else
+        job(0, (unsigned int)edge_size);
 }
 
 
@@ -121,95 +130,58 @@ static void projectSH(Color *CubemapFace[6], size_t edge_size,
         redSHCoeff[i] = 0;
     }
 
-    float wh = float(edge_size * edge_size);
-    float b0 = 0., b1 = 0., b2 = 0., b3 = 0., b4 = 0., b5 = 0., b6 = 0., b7 = 0., b8 = 0.;
-    float r0 = 0., r1 = 0., r2 = 0., r3 = 0., r4 = 0., r5 = 0., r6 = 0., r7 = 0., r8 = 0.;
-    float g0 = 0., g1 = 0., g2 = 0., g3 = 0., g4 = 0., g5 = 0., g6 = 0., g7 = 0., g8 = 0.;
-    for (unsigned face = 0; face < 6; face++)
+    // Each row of each face is summed up separately, so that the rows can be
+    // done in parallel and the result does not depend on the thread count
+    const float wh = float(edge_size * edge_size);
+    std::vector<float> row_sums(6 * edge_size * 27, 0.f);
+    WorkerPool::Job job = [&](unsigned int first, unsigned int last)
     {
-#pragma omp parallel for reduction(+ : b0, b1, b2, b3, b4, b5, b6, b7, b8, r0, r1, r2, r3, r4, r5, r6, r7, r8, g0, g1, g2, g3, g4, g5, g6, g7, g8)
-        for (int i = 0; i < int(edge_size); i++)
+        for (unsigned int row = first; row < last; row++)
         {
+            const unsigned face = row / edge_size;
+            const unsigned i = row % edge_size;
+            float *sum = &row_sums[27 * row];
             for (unsigned j = 0; j < edge_size; j++)
             {
-                int idx = i * edge_size + j;
+                size_t idx = i * edge_size + j;
                 float fi = float(i), fj = float(j);
                 fi /= edge_size, fj /= edge_size;
                 fi = 2 * fi - 1, fj = 2 * fj - 1;
 
-
                 float d = sqrt(fi * fi + fj * fj + 1);
 
                 // Constant obtained by projecting unprojected ref values
                 float solidangle = 2.75f / (wh * pow(d, 1.5f));
-                // pow(., 2.2) to convert from srgb
-                float b = CubemapFace[face][edge_size * i + j].Blue;
-                float g = CubemapFace[face][edge_size * i + j].Green;
-                float r = CubemapFace[face][edge_size * i + j].Red;
-
-                b0 += b * Y00[face][idx] * solidangle;
-                b1 += b * Y1minus1[face][idx] * solidangle;
-                b2 += b * Y10[face][idx] * solidangle;
-                b3 += b * Y11[face][idx] * solidangle;
-                b4 += b * Y2minus2[face][idx] * solidangle;
-                b5 += b * Y2minus1[face][idx] * solidangle;
-                b6 += b * Y20[face][idx] * solidangle;
-                b7 += b * Y21[face][idx] * solidangle;
-                b8 += b * Y22[face][idx] * solidangle;
-
-                g0 += g * Y00[face][idx] * solidangle;
-                g1 += g * Y1minus1[face][idx] * solidangle;
-                g2 += g * Y10[face][idx] * solidangle;
-                g3 += g * Y11[face][idx] * solidangle;
-                g4 += g * Y2minus2[face][idx] * solidangle;
-                g5 += g * Y2minus1[face][idx] * solidangle;
-                g6 += g * Y20[face][idx] * solidangle;
-                g7 += g * Y21[face][idx] * solidangle;
-                g8 += g * Y22[face][idx] * solidangle;
-
-
-                r0 += r * Y00[face][idx] * solidangle;
-                r1 += r * Y1minus1[face][idx] * solidangle;
-                r2 += r * Y10[face][idx] * solidangle;
-                r3 += r * Y11[face][idx] * solidangle;
-                r4 += r * Y2minus2[face][idx] * solidangle;
-                r5 += r * Y2minus1[face][idx] * solidangle;
-                r6 += r * Y20[face][idx] * solidangle;
-                r7 += r * Y21[face][idx] * solidangle;
-                r8 += r * Y22[face][idx] * solidangle;
+                const float Y[9] = { Y00[face][idx], Y1minus1[face][idx],
+                                     Y10[face][idx], Y11[face][idx],
+                                     Y2minus2[face][idx], Y2minus1[face][idx],
+                                     Y20[face][idx], Y21[face][idx],
+                                     Y22[face][idx] };
+                const Color &c = CubemapFace[face][idx];
+                for (unsigned k = 0; k < 9; k++)
+                {
+                    sum[k]      += c.Blue  * Y[k] * solidangle;
+                    sum[9 + k]  += c.Green * Y[k] * solidangle;
+                    sum[18 + k] += c.Red   * Y[k] * solidangle;
+                }
             }
         }
-    }
+    };
+    if (WorkerPool::exists())
+        WorkerPool::get()->parallelFor(6 * (unsigned int)edge_size, 8, job);
+    else
+        job(0, 6 * (unsigned int)edge_size);
 
-    blueSHCoeff[0] = b0;
-    blueSHCoeff[1] = b1;
-    blueSHCoeff[2] = b2;
-    blueSHCoeff[3] = b3;
-    blueSHCoeff[4] = b4;
-    blueSHCoeff[5] = b5;
-    blueSHCoeff[6] = b6;
-    blueSHCoeff[7] = b7;
-    blueSHCoeff[8] = b8;
-
-    redSHCoeff[0] = r0;
-    redSHCoeff[1] = r1;
-    redSHCoeff[2] = r2;
-    redSHCoeff[3] = r3;
-    redSHCoeff[4] = r4;
-    redSHCoeff[5] = r5;
-    redSHCoeff[6] = r6;
-    redSHCoeff[7] = r7;
-    redSHCoeff[8] = r8;
-
-    greenSHCoeff[0] = g0;
-    greenSHCoeff[1] = g1;
-    greenSHCoeff[2] = g2;
-    greenSHCoeff[3] = g3;
-    greenSHCoeff[4] = g4;
-    greenSHCoeff[5] = g5;
-    greenSHCoeff[6] = g6;
-    greenSHCoeff[7] = g7;
-    greenSHCoeff[8] = g8;
+    for (unsigned row = 0; row < 6 * edge_size; row++)
+    {
+        const float *sum = &row_sums[27 * row];
+        for (unsigned k = 0; k < 9; k++)
+        {
+            blueSHCoeff[k]  += sum[k];
+            greenSHCoeff[k] += sum[9 + k];
+            redSHCoeff[k]   += sum[18 + k];
+        }
+    }
 }
 
 void SphericalHarmonics(Color *CubemapFace[6], size_t edge_size, float *blueSHCoeff, float *greenSHCoeff, float *redSHCoeff)
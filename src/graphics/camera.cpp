@@ -56,6 +56,7 @@ Camera::Camera(int camera_index, AbstractKart* kart) : m_kart(NULL)
     m_original_kart = kart;
     m_camera        = irr_driver->addCameraSceneNode();
     m_previous_pv_matrix = core::matrix4();
+    m_graphics_state_valid = false;
 
 #ifdef DEBUG
     if (kart != NULL)
@@ -331,11 +332,47 @@ void Camera::reset()
 {
     m_kart = m_original_kart;
     setMode(CM_NORMAL);
+    m_graphics_state_valid = false;
 
     if (m_kart != NULL)
         setInitialTransform();
 }   // reset
 
+//-----------------------------------------------------------------------------
+/** Called after each simulation tick if the simulation runs with a fixed
+ *  time step: stores the position and target of the camera set in this
+ *  tick, keeping the values of the previous tick.
+ */
+void Camera::saveGraphicsState()
+{
+    m_graphics_position[0] = m_graphics_position[1];
+    m_graphics_target[0]   = m_graphics_target[1];
+    m_graphics_position[1] = m_camera->getPosition();
+    m_graphics_target[1]   = m_camera->getTarget();
+    if (!m_graphics_state_valid)
+    {
+        m_graphics_position[0] = m_graphics_position[1];
+        m_graphics_target[0]   = m_graphics_target[1];
+        m_graphics_state_valid = true;
+    }
+}   // saveGraphicsState
+
+//-----------------------------------------------------------------------------
+/** Places the camera between its state after the previous and the last
+ *  simulation tick.
+ *  \param alpha Fraction of a tick since the last tick, 1 restores the
+ *         state of the last tick.
+ */
+void Camera::interpolateGraphics(float alpha)
+{
+    if (!m_graphics_state_valid)
+        return;
+    m_camera->setPosition(m_graphics_position[0]
+                  + (m_graphics_position[1] - m_graphics_position[0])*alpha);
+    m_camera->setTarget(m_graphics_target[0]
+                  + (m_graphics_target[1] - m_graphics_target[0])*alpha);
+}   // interpolateGraphics
+
 //-----------------------------------------------------------------------------
 /** Saves the current kart position as initial starting position for the
  *  camera.
@@ -139,6 +139,15 @@ private:
     /** The target direction for the camera, only used for the first person camera. */
     core::vector3df m_target_direction;
 
+    /** Position and target of the camera after the previous (index 0) and
+     *  the last (index 1) simulation tick, used to interpolate the camera
+     *  if the simulation runs with a fixed time step. */
+    core::vector3df m_graphics_position[2];
+    core::vector3df m_graphics_target[2];
+
+    /** False until the state was saved after the first tick. */
+    bool m_graphics_state_valid;
+
     /** The speed at which the direction changes, only used for the first person camera. */
     core::vector3df m_direction_velocity;
 
@@ -275,6 +284,8 @@ public:
     void setInitialTransform();
     void activate(bool alsoActivateInIrrlicht=true);
     void update            (float dt);
+    void saveGraphicsState ();
+    void interpolateGraphics(float alpha);
     void setKart(AbstractKart *new_kart);
 
     // ------------------------------------------------------------------------
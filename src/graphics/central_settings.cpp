@@ -41,6 +41,9 @@ void CentralVideoSettings::init()
     hasSSBO = false;
     hasImageLoadStore = false;
     hasMultiDrawIndirect = false;
+    hasProgramBinary = false;
+    hasCopyImage = false;
+    hasVertexType2101010Rev = false;
     hasTextureCompression = false;
     hasUBO = false;
     hasGS = false;
@@ -135,6 +138,26 @@ void CentralVideoSettings::init()
             hasMultiDrawIndirect = true;
             Log::info("GLDriver", "ARB Multi Draw Indirect Present");
         }
+        if (!GraphicsRestrictions::isDisabled(GraphicsRestrictions::GR_GET_PROGRAM_BINARY) &&
+            hasGLExtension("GL_ARB_get_program_binary")) {
+            // Some drivers expose the extension without any binary format
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            hasProgramBinary = formats > 0;
+            if (hasProgramBinary)
+                Log::info("GLDriver", "ARB Get Program Binary Present");
+        }
+        if (!GraphicsRestrictions::isDisabled(GraphicsRestrictions::GR_COPY_IMAGE) &&
+            hasGLExtension("GL_ARB_copy_image")) {
+            hasCopyImage = true;
+            Log::info("GLDriver", "ARB Copy Image Present");
+        }
+        if (!GraphicsRestrictions::isDisabled(GraphicsRestrictions::GR_VERTEX_TYPE_2_10_10_10_REV) &&
+            (hasGLExtension("GL_ARB_vertex_type_2_10_10_10_rev") ||
+             m_gl_major_version > 3 || (m_gl_major_version == 3 && m_gl_minor_version >= 3))) {
+            hasVertexType2101010Rev = true;
+            Log::info("GLDriver", "ARB Vertex Type 2_10_10_10_rev Present");
+        }
         if (!GraphicsRestrictions::isDisabled(GraphicsRestrictions::GR_EXT_TEXTURE_COMPRESSION_S3TC) &&
             hasGLExtension("GL_EXT_texture_compression_s3tc")) {
             hasTextureCompression = true;
@@ -280,6 +303,21 @@ bool CentralVideoSettings::isARBMultiDrawIndirectUsable() const
     return hasMultiDrawIndirect;
 }
 
+bool CentralVideoSettings::isARBGetProgramBinaryUsable() const
+{
+    return hasProgramBinary;
+}
+
+bool CentralVideoSettings::isARBCopyImageUsable() const
+{
+    return hasCopyImage;
+}
+
+bool CentralVideoSettings::isARBVertexType2101010RevUsable() const
+{
+    return hasVertexType2101010Rev;
+}
+
 bool CentralVideoSettings::supportsShadows() const
 {
     return isARBGeometryShader4Usable() && isARBUniformBufferObjectUsable();
@@ -305,6 +343,27 @@ bool CentralVideoSettings::supportsAsyncInstanceUpload() const
     return isARBBufferStorageUsable() && isARBImageLoadStoreUsable();
 }
 
+// The clusters are computed in a compute shader and read from the light
+// shader through storage buffers, using the matrices of the UBO.
+bool CentralVideoSettings::supportsClusteredLighting() const
+{
+    return isARBComputeShaderUsable() && isARBShaderStorageBufferObjectUsable() &&
+           isARBUniformBufferObjectUsable() && getGLSLVersion() >= 430;
+}
+
+// The cached shadow maps are copied into the shadow map each frame, which
+// requires complete (i.e. immutable) textures
+bool CentralVideoSettings::supportsStaticShadowCache() const
+{
+    return isARBCopyImageUsable() && isARBTextureStorageUsable();
+}
+
+// The textures are copied into immutable texture arrays
+bool CentralVideoSettings::supportsTextureArrayBatching() const
+{
+    return supportsIndirectInstancingRendering() && isARBCopyImageUsable() && isARBTextureStorageUsable();
+}
+
 bool CentralVideoSettings::isShadowEnabled() const
 {
     return supportsShadows() && (UserConfigParams::m_shadows_resolution > 0);
@@ -326,12 +385,41 @@ bool CentralVideoSettings::isSDSMEnabled() const
     return isShadowEnabled() && isARBShaderAtomicCountersUsable() && isARBShaderStorageBufferObjectUsable() && isARBComputeShaderUsable() && isARBImageLoadStoreUsable() && UserConfigParams::m_sdsm;
 }
 
+// The static geometry of the far cascades is rendered into a cache and only
+// re-rendered when the cascade moves. With SDSM the cascades are computed
+// on the GPU and change every frame.
+bool CentralVideoSettings::isStaticShadowCacheEnabled() const
+{
+    return isShadowEnabled() && supportsStaticShadowCache() && !isSDSMEnabled();
+}
+
 // See http://fr.slideshare.net/CassEveritt/approaching-zero-driver-overhead
 bool CentralVideoSettings::isAZDOEnabled() const
 {
     return supportsIndirectInstancingRendering() && isARBBindlessTextureUsable() && isARBMultiDrawIndirectUsable() && UserConfigParams::m_azdo;
 }
 
+// Without bindless textures, the solid meshes whose textures are packed in
+// the same texture arrays are drawn with one call.
+bool CentralVideoSettings::isTextureArrayBatchingEnabled() const
+{
+    return supportsTextureArrayBatching() && !isAZDOEnabled() && UserConfigParams::m_texture_arrays;
+}
+
+// The normals and tangents of the meshes in the VAOManager buffers are stored
+// as 10 bits integers, and the lightmap coordinates as half floats.
+bool CentralVideoSettings::isPackedVertexFormatEnabled() const
+{
+    return isARBVertexType2101010RevUsable() && UserConfigParams::m_packed_vertices;
+}
+
+// The resolution of the render targets of the deferred pipeline follows the
+// GPU time of the frames, see IrrDriver::updateDynamicResolution.
+bool CentralVideoSettings::isDynamicResolutionEnabled() const
+{
+    return isDefferedEnabled() && UserConfigParams::m_dynamic_resolution;
+}
+
 // Switch between Exponential Shadow Map (better but slower filtering) and Percentage Closer Filtering (faster but with some stability issue)
 bool CentralVideoSettings::isESMEnabled() const
 {
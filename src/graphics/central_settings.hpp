@@ -40,6 +40,9 @@ private:
     bool hasSSBO;
     bool hasImageLoadStore;
     bool hasMultiDrawIndirect;
+    bool hasProgramBinary;
+    bool hasCopyImage;
+    bool hasVertexType2101010Rev;
 
     bool m_need_rh_workaround;
     bool m_need_srgb_workaround;
@@ -69,6 +72,9 @@ public:
     bool isARBShaderStorageBufferObjectUsable() const;
     bool isARBImageLoadStoreUsable() const;
     bool isARBMultiDrawIndirectUsable() const;
+    bool isARBGetProgramBinaryUsable() const;
+    bool isARBCopyImageUsable() const;
+    bool isARBVertexType2101010RevUsable() const;
 
 
     // Are all required extensions available for feature support
@@ -77,13 +83,20 @@ public:
     bool supportsIndirectInstancingRendering() const;
     bool supportsComputeShadersFiltering() const;
     bool supportsAsyncInstanceUpload() const;
+    bool supportsClusteredLighting() const;
+    bool supportsStaticShadowCache() const;
+    bool supportsTextureArrayBatching() const;
 
     // "Macro" around feature support and user config
     bool isShadowEnabled() const;
     bool isGlobalIlluminationEnabled() const;
     bool isTextureCompressionEnabled() const;
     bool isSDSMEnabled() const;
+    bool isStaticShadowCacheEnabled() const;
     bool isAZDOEnabled() const;
+    bool isTextureArrayBatchingEnabled() const;
+    bool isPackedVertexFormatEnabled() const;
+    bool isDynamicResolutionEnabled() const;
     bool isESMEnabled() const;
     bool isDefferedEnabled() const;
 };
@@ -0,0 +1,607 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "graphics/cpu_particles.hpp"
+
+#include "graphics/irr_driver.hpp"
+#include "tracks/track.hpp"
+#include "utils/helpers.hpp"
+#include "utils/vec3.hpp"
+#include "utils/worker_pool.hpp"
+
+#include <ICameraSceneNode.h>
+#include <IParticleEmitter.h>
+#include <ISceneManager.h>
+#include <SViewFrustum.h>
+
+#include <algorithm>
+#include <stdlib.h>
+
+std::vector<CPUParticleSystem*> CPUParticleSystem::m_all_pending;
+
+/** The maximum number of particles, the same as irrlicht's, so that the
+ *  16 bit indices of the vertex buffer don't overflow. */
+static const unsigned int MAX_PARTICLES = 16250;
+
+// ----------------------------------------------------------------------------
+scene::IParticleSystemSceneNode *CPUParticleSystem::addParticleNode()
+{
+    scene::ISceneManager *sm = irr_driver->getSceneManager();
+    CPUParticleSystem *node = new CPUParticleSystem(sm->getRootSceneNode(),
+                                                    sm);
+    node->drop();
+    return node;
+}   // addParticleNode
+
+// ----------------------------------------------------------------------------
+CPUParticleSystem::CPUParticleSystem(scene::ISceneNode* parent,
+                                     scene::ISceneManager* mgr)
+                 : CParticleSystemSceneNode(/*default emitter*/false, parent,
+                                            mgr, -1, core::vector3df(0, 0, 0),
+                                            core::vector3df(0, 0, 0),
+                                            core::vector3df(1, 1, 1))
+{
+    m_pending = false;
+    m_paused  = false;
+    removeAllAffectors();
+}   // CPUParticleSystem
+
+// ----------------------------------------------------------------------------
+CPUParticleSystem::~CPUParticleSystem()
+{
+    if (m_pending)
+    {
+        m_all_pending.erase(std::find(m_all_pending.begin(),
+                                      m_all_pending.end(), this));
+    }
+}   // ~CPUParticleSystem
+
+// ----------------------------------------------------------------------------
+/** Removes all effects (and any irrlicht affectors that were added). */
+void CPUParticleSystem::removeAllAffectors()
+{
+    CParticleSystemSceneNode::removeAllAffectors();
+    m_has_fade_out  = false;
+    m_has_gravity   = false;
+    m_has_fade_away = false;
+    m_has_scale     = false;
+    m_has_color     = false;
+    m_wind_speed    = 0.0f;
+    m_wind_seed     = 0.0f;
+    m_height_map.clear();
+    m_height_map_first_time = false;
+}   // removeAllAffectors
+
+// ----------------------------------------------------------------------------
+/** Fades the particles to a color during the end of their life time, like
+ *  irrlicht's fade out affector. */
+void CPUParticleSystem::setFadeOut(const video::SColor &color,
+                                   u32 fade_out_time)
+{
+    m_has_fade_out   = true;
+    m_fade_out_color = color;
+    m_fade_out_time  = (float)fade_out_time;
+}   // setFadeOut
+
+// ----------------------------------------------------------------------------
+/** Changes the velocity of the particles to the gravity, which is reached
+ *  time_force_lost milliseconds after a particle was emitted, like irrlicht's
+ *  gravity affector. */
+void CPUParticleSystem::setGravity(const core::vector3df &gravity,
+                                   u32 time_force_lost)
+{
+    m_has_gravity  = true;
+    m_gravity      = gravity;
+    m_gravity_time = (float)time_force_lost;
+}   // setGravity
+
+// ----------------------------------------------------------------------------
+/** Fades particles away depending on their distance to the camera.
+ *  \param start,end Squared distances at which particles start fading and
+ *         are completely faded out.
+ */
+void CPUParticleSystem::setFadeAway(float start, float end)
+{
+    assert(end >= start);
+    m_has_fade_away   = true;
+    m_fade_away_start = start;
+    m_fade_away_end   = end;
+}   // setFadeAway
+
+// ----------------------------------------------------------------------------
+/** Scales the particles during their life time, at the end their size is
+ *  the start size multiplied by factor. */
+void CPUParticleSystem::setScale(const core::vector2df &factor)
+{
+    m_has_scale    = true;
+    m_scale_factor = factor;
+}   // setScale
+
+// ----------------------------------------------------------------------------
+/** Changes the color of the particles during their life time.
+ *  \param from,to Color (0 to 255 for each component) at the start and at
+ *         the end of the life time.
+ */
+void CPUParticleSystem::setColors(const core::vector3df &from,
+                                  const core::vector3df &to)
+{
+    m_has_color  = true;
+    m_color_from = from;
+    m_color_to   = to;
+}   // setColors
+
+// ----------------------------------------------------------------------------
+/** Moves the particles with the wind. */
+void CPUParticleSystem::setWind(float speed)
+{
+    m_wind_speed = speed;
+    m_wind_seed  = (float)((rand() % 1000) - 500);
+}   // setWind
+
+// ----------------------------------------------------------------------------
+/** Removes particles that fall below the ground of a track. */
+void CPUParticleSystem::setHeightMap(Track *track)
+{
+    m_height_map = track->getHeightMap();
+
+    const Vec3 *aabb_min, *aabb_max;
+    track->getAABB(&aabb_min, &aabb_max);
+    m_track_x     = aabb_min->getX();
+    m_track_z     = aabb_min->getZ();
+    m_track_x_len = aabb_max->getX() - aabb_min->getX();
+    m_track_z_len = aabb_max->getZ() - aabb_min->getZ();
+    m_height_map_first_time = true;
+}   // setHeightMap
+
+// ----------------------------------------------------------------------------
+void CPUParticleSystem::clearParticles()
+{
+    for (unsigned int k = 0; k < 3; k++)
+    {
+        m_pos[k].clear();
+        m_velocity[k].clear();
+        m_start_velocity[k].clear();
+    }
+    m_start_time.clear();
+    m_end_time.clear();
+    m_start_color.clear();
+    m_color.clear();
+    for (unsigned int k = 0; k < 2; k++)
+    {
+        m_start_size[k].clear();
+        m_size[k].clear();
+    }
+}   // clearParticles
+
+// ----------------------------------------------------------------------------
+/** Appends an emitted particle. */
+void CPUParticleSystem::addParticle(const scene::SParticle &particle)
+{
+    core::vector3df pos = particle.pos;
+    core::vector3df start_velocity = particle.startVector;
+    AbsoluteTransformation.rotateVect(start_velocity);
+    if (ParticlesAreGlobal)
+        AbsoluteTransformation.transformVect(pos);
+
+    m_pos[0].push_back(pos.X);
+    m_pos[1].push_back(pos.Y);
+    m_pos[2].push_back(pos.Z);
+    m_velocity[0].push_back(particle.vector.X);
+    m_velocity[1].push_back(particle.vector.Y);
+    m_velocity[2].push_back(particle.vector.Z);
+    m_start_velocity[0].push_back(start_velocity.X);
+    m_start_velocity[1].push_back(start_velocity.Y);
+    m_start_velocity[2].push_back(start_velocity.Z);
+    m_start_time.push_back(particle.startTime);
+    m_end_time.push_back(particle.endTime);
+    m_start_color.push_back(particle.startColor);
+    m_color.push_back(particle.color);
+    m_start_size[0].push_back(particle.startSize.Width);
+    m_start_size[1].push_back(particle.startSize.Height);
+    m_size[0].push_back(particle.size.Width);
+    m_size[1].push_back(particle.size.Height);
+}   // addParticle
+
+// ----------------------------------------------------------------------------
+/** Removes a particle by moving the last particle into its place. */
+void CPUParticleSystem::removeParticle(unsigned int i)
+{
+    const unsigned int last = getNumParticles() - 1;
+    for (unsigned int k = 0; k < 3; k++)
+    {
+        m_pos[k][i]            = m_pos[k][last];
+        m_velocity[k][i]       = m_velocity[k][last];
+        m_start_velocity[k][i] = m_start_velocity[k][last];
+        m_pos[k].pop_back();
+        m_velocity[k].pop_back();
+        m_start_velocity[k].pop_back();
+    }
+    m_start_time[i]  = m_start_time[last];
+    m_end_time[i]    = m_end_time[last];
+    m_start_color[i] = m_start_color[last];
+    m_color[i]       = m_color[last];
+    m_start_time.pop_back();
+    m_end_time.pop_back();
+    m_start_color.pop_back();
+    m_color.pop_back();
+    for (unsigned int k = 0; k < 2; k++)
+    {
+        m_start_size[k][i] = m_start_size[k][last];
+        m_size[k][i]       = m_size[k][last];
+        m_start_size[k].pop_back();
+        m_size[k].pop_back();
+    }
+}   // removeParticle
+
+// ----------------------------------------------------------------------------
+void CPUParticleSystem::OnRegisterSceneNode()
+{
+    doParticleSystem(irr_driver->getDevice()->getTimer()->getTime());
+
+    if (IsVisible && !m_paused && getNumParticles() != 0)
+    {
+        SceneManager->registerNodeForRendering(this);
+        ISceneNode::OnRegisterSceneNode();
+    }
+}   // OnRegisterSceneNode
+
+// ----------------------------------------------------------------------------
+/** Emits the new particles and queues the simulation of all particles, which
+ *  is done by simulatePending. Everything that is not thread safe (the
+ *  emitter, random numbers, the wind and the camera) is done here.
+ */
+void CPUParticleSystem::doParticleSystem(u32 time)
+{
+    // An update that was not simulated since the node was not rendered
+    if (m_pending)
+    {
+        m_all_pending.erase(std::find(m_all_pending.begin(),
+                                      m_all_pending.end(), this));
+        simulate();
+    }
+
+    // A paused system continues where it stopped
+    if (LastEmitTime == 0 || m_paused)
+    {
+        LastEmitTime = time;
+        return;
+    }
+
+    const u32 now = time;
+    const u32 dt  = time - LastEmitTime;
+    LastEmitTime  = time;
+
+    if (Emitter && IsVisible)
+    {
+        scene::SParticle *array = NULL;
+        s32 new_particles = Emitter->emitt(now, dt, array);
+        if (new_particles > 0 && array)
+        {
+            new_particles = std::min(new_particles,
+                                     s32(MAX_PARTICLES - getNumParticles()));
+            for (s32 i = 0; i < new_particles; i++)
+                addParticle(array[i]);
+        }
+    }
+
+    // Spread the particles over the height at the first update
+    m_pending_skip_height_map = m_height_map_first_time;
+    if (m_height_map_first_time && !m_height_map.empty())
+    {
+        for (unsigned int n = 0; n < getNumParticles(); n++)
+        {
+            const int i = (int)((m_pos[0][n] - m_track_x) / m_track_x_len
+                                * HEIGHT_MAP_RESOLUTION);
+            const int j = (int)((m_pos[2][n] - m_track_z) / m_track_z_len
+                                * HEIGHT_MAP_RESOLUTION);
+            if (i >= HEIGHT_MAP_RESOLUTION || j >= HEIGHT_MAP_RESOLUTION ||
+                i < 0 || j < 0)
+                continue;
+            const float h = m_height_map[i*HEIGHT_MAP_RESOLUTION + j];
+            m_pos[1][n] = h + (m_pos[1][n] - h) * ((rand() % 500) / 500.0f);
+        }
+        m_height_map_first_time = false;
+    }
+
+    m_pending_wind = core::vector3df(0, 0, 0);
+    if (m_wind_speed > 0.0f)
+    {
+        const float t = irr_driver->getDevice()->getTimer()->getTime()
+                      / 10000.0f;
+        m_pending_wind = irr_driver->getWind();
+        m_pending_wind *= m_wind_speed * std::min(noise2d(t, m_wind_seed),
+                                                  -0.2f);
+    }
+    if (m_has_fade_away)
+    {
+        m_pending_camera =
+                    SceneManager->getActiveCamera()->getPosition();
+    }
+
+    m_pending_now = now;
+    m_pending_dt  = dt;
+    m_pending     = true;
+    m_all_pending.push_back(this);
+
+    // The bounding box is only updated by the simulation, so extend it by
+    // the new particles for culling
+    core::aabbox3df &box = Buffer->BoundingBox;
+    core::matrix4 absinv(AbsoluteTransformation,
+                         core::matrix4::EM4CONST_INVERSE);
+    for (unsigned int n = 0; n < getNumParticles(); n++)
+    {
+        if (m_start_time[n] != now)
+            continue;
+        core::vector3df p(m_pos[0][n], m_pos[1][n], m_pos[2][n]);
+        if (ParticlesAreGlobal)
+            absinv.transformVect(p);
+        box.addInternalPoint(p);
+    }
+}   // doParticleSystem
+
+// ----------------------------------------------------------------------------
+/** Applies all effects to all particles, moves them and removes the ones
+ *  whose life time is over. Each effect is a separate loop over the arrays
+ *  of the attributes it needs. This only uses data of this node and is
+ *  called in parallel for all nodes.
+ */
+void CPUParticleSystem::simulate()
+{
+    m_pending = false;
+    const u32 now = m_pending_now;
+    const unsigned int count = getNumParticles();
+
+    if (m_has_fade_out)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (m_end_time[i] - now < m_fade_out_time)
+            {
+                const float d = (m_end_time[i] - now) / m_fade_out_time;
+                m_color[i] = m_start_color[i].getInterpolated(m_fade_out_color,
+                                                              d);
+            }
+        }
+    }
+
+    if (m_has_gravity)
+    {
+        const float gravity[3] = { m_gravity.X, m_gravity.Y, m_gravity.Z };
+        for (unsigned int i = 0; i < count; i++)
+        {
+            float d = (now - m_start_time[i]) / m_gravity_time;
+            d = 1.0f - core::clamp(d, 0.0f, 1.0f);
+            // Interpolate in double precision like irrlicht does
+            const f64 inv = 1.0 - d;
+            for (unsigned int k = 0; k < 3; k++)
+                m_velocity[k][i] = (float)(gravity[k] * inv
+                                           + m_start_velocity[k][i] * d);
+        }
+    }
+
+    if (m_has_fade_away)
+    {
+        const float range = m_fade_away_end - m_fade_away_start;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const float x = m_pos[0][i] - m_pending_camera.X;
+            const float y = m_pos[1][i] - m_pending_camera.Y;
+            const float z = m_pos[2][i] - m_pending_camera.Z;
+            const float distance_squared = x*x + y*y + z*z;
+            if (distance_squared < m_fade_away_start)
+                m_color[i].setAlpha(255);
+            else if (distance_squared > m_fade_away_end)
+                m_color[i].setAlpha(0);
+            else
+                m_color[i].setAlpha((int)((distance_squared
+                                           - m_fade_away_start) / range));
+        }
+    }
+
+    if (m_has_scale)
+    {
+        const float factor[2] = { m_scale_factor.X, m_scale_factor.Y };
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const f32 fraction = (f32)(now - m_start_time[i])
+                               / (m_end_time[i] - m_start_time[i]);
+            for (unsigned int k = 0; k < 2; k++)
+            {
+                const float start = m_start_size[k][i];
+                m_size[k][i] = start + (start * factor[k] - start)
+                                     * fraction;
+            }
+        }
+    }
+
+    if (m_has_color)
+    {
+        const core::vector3df diff = m_color_to - m_color_from;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const f32 fraction = (f32)(now - m_start_time[i])
+                               / (m_end_time[i] - m_start_time[i]);
+            const core::vector3df c = m_color_from + diff * fraction;
+            m_color[i] = video::SColor(255, (int)c.X, (int)c.Y, (int)c.Z);
+        }
+    }
+
+    if (m_wind_speed > 0.0f)
+    {
+        const float wind[3] = { m_pending_wind.X, m_pending_wind.Y,
+                                m_pending_wind.Z };
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            float *pos = m_pos[k].data();
+            const float offset = wind[k];
+            for (unsigned int i = 0; i < count; i++)
+                pos[i] += offset;
+        }
+    }
+
+    if (!m_height_map.empty() && !m_pending_skip_height_map)
+    {
+        for (unsigned int n = 0; n < count; n++)
+        {
+            const int i = (int)((m_pos[0][n] - m_track_x) / m_track_x_len
+                                * HEIGHT_MAP_RESOLUTION);
+            const int j = (int)((m_pos[2][n] - m_track_z) / m_track_z_len
+                                * HEIGHT_MAP_RESOLUTION);
+            if (i >= HEIGHT_MAP_RESOLUTION || j >= HEIGHT_MAP_RESOLUTION ||
+                i < 0 || j < 0)
+                continue;
+            if (m_pos[1][n] < m_height_map[i*HEIGHT_MAP_RESOLUTION + j])
+                m_end_time[n] = m_start_time[n];   // destroy particle
+        }
+    }
+
+    // Remove the dead particles, then move the others
+    for (unsigned int i = 0; i < getNumParticles();)
+    {
+        if (now > m_end_time[i])
+            removeParticle(i);
+        else
+            i++;
+    }
+    const unsigned int alive = getNumParticles();
+    const f32 scale = (f32)m_pending_dt;
+    for (unsigned int k = 0; k < 3; k++)
+    {
+        float *pos = m_pos[k].data();
+        const float *velocity = m_velocity[k].data();
+        for (unsigned int i = 0; i < alive; i++)
+            pos[i] += velocity[i] * scale;
+    }
+
+    core::aabbox3df &box = Buffer->BoundingBox;
+    if (ParticlesAreGlobal)
+        box.reset(AbsoluteTransformation.getTranslation());
+    else
+        box.reset(core::vector3df(0, 0, 0));
+    for (unsigned int i = 0; i < alive; i++)
+        box.addInternalPoint(m_pos[0][i], m_pos[1][i], m_pos[2][i]);
+
+    const f32 m = std::max(ParticleSize.Width, ParticleSize.Height) * 0.5f;
+    box.MaxEdge += core::vector3df(m, m, m);
+    box.MinEdge -= core::vector3df(m, m, m);
+    if (ParticlesAreGlobal)
+    {
+        core::matrix4 absinv(AbsoluteTransformation,
+                             core::matrix4::EM4CONST_INVERSE);
+        absinv.transformBoxEx(box);
+    }
+}   // simulate
+
+// ----------------------------------------------------------------------------
+/** Simulates all particle systems with a pending update in parallel. */
+void CPUParticleSystem::simulatePending()
+{
+    if (m_all_pending.empty())
+        return;
+    std::vector<CPUParticleSystem*> pending;
+    pending.swap(m_all_pending);
+    WorkerPool::get()->parallelFor((unsigned int)pending.size(),
+        /*chunk_size*/1,
+        [&pending](unsigned int first, unsigned int last)
+        {
+            for (unsigned int i = first; i < last; i++)
+                pending[i]->simulate();
+        }, "Particle simulation");
+}   // simulatePending
+
+// ----------------------------------------------------------------------------
+/** Makes sure the vertex and index buffer can hold count particles. */
+void CPUParticleSystem::resizeBuffers(unsigned int count)
+{
+    if (count * 4 <= Buffer->getVertexCount() &&
+        count * 6 <= Buffer->getIndexCount())
+        return;
+
+    u32 old_size = Buffer->getVertexCount();
+    Buffer->Vertices.set_used(count * 4);
+    for (u32 i = old_size; i < Buffer->Vertices.size(); i += 4)
+    {
+        Buffer->Vertices[0+i].TCoords.set(0.0f, 0.0f);
+        Buffer->Vertices[1+i].TCoords.set(0.0f, 1.0f);
+        Buffer->Vertices[2+i].TCoords.set(1.0f, 1.0f);
+        Buffer->Vertices[3+i].TCoords.set(1.0f, 0.0f);
+    }
+
+    u32 old_index_size = Buffer->getIndexCount();
+    u32 vertex = old_size;
+    Buffer->Indices.set_used(count * 6);
+    for (u32 i = old_index_size; i < Buffer->Indices.size(); i += 6)
+    {
+        Buffer->Indices[0+i] = (u16)(0 + vertex);
+        Buffer->Indices[1+i] = (u16)(2 + vertex);
+        Buffer->Indices[2+i] = (u16)(1 + vertex);
+        Buffer->Indices[3+i] = (u16)(0 + vertex);
+        Buffer->Indices[4+i] = (u16)(3 + vertex);
+        Buffer->Indices[5+i] = (u16)(2 + vertex);
+        vertex += 4;
+    }
+}   // resizeBuffers
+
+// ----------------------------------------------------------------------------
+/** Simulates all pending particle systems if necessary, then draws the
+ *  particles as billboards facing the camera. */
+void CPUParticleSystem::render()
+{
+    simulatePending();
+
+    video::IVideoDriver *driver = SceneManager->getVideoDriver();
+    scene::ICameraSceneNode *camera = SceneManager->getActiveCamera();
+    const unsigned int count = getNumParticles();
+    if (!camera || !driver || count == 0)
+        return;
+
+    const core::matrix4 &m =
+                      camera->getViewFrustum()->getTransform(video::ETS_VIEW);
+    const core::vector3df view(-m[2], -m[6], -m[10]);
+
+    resizeBuffers(count);
+    video::S3DVertex *vertices = Buffer->Vertices.pointer();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const f32 w = 0.5f * m_size[0][i];
+        const f32 h = -0.5f * m_size[1][i];
+        const core::vector3df horizontal(m[0] * w, m[4] * w, m[8] * w);
+        const core::vector3df vertical(m[1] * h, m[5] * h, m[9] * h);
+        const core::vector3df pos(m_pos[0][i], m_pos[1][i], m_pos[2][i]);
+        video::S3DVertex *v = vertices + 4*i;
+        v[0].Pos = pos + horizontal + vertical;
+        v[1].Pos = pos + horizontal - vertical;
+        v[2].Pos = pos - horizontal - vertical;
+        v[3].Pos = pos - horizontal + vertical;
+        for (unsigned int k = 0; k < 4; k++)
+        {
+            v[k].Color  = m_color[i];
+            v[k].Normal = view;
+        }
+    }
+
+    core::matrix4 mat;
+    if (!ParticlesAreGlobal)
+        mat.setTranslation(AbsoluteTransformation.getTranslation());
+    driver->setTransform(video::ETS_WORLD, mat);
+    driver->setMaterial(Buffer->Material);
+    driver->drawVertexPrimitiveList(Buffer->getVertices(), count * 4,
+                                    Buffer->getIndices(), count * 2,
+                                    video::EVT_STANDARD, scene::EPT_TRIANGLES,
+                                    Buffer->getIndexType());
+}   // render
@@ -0,0 +1,147 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_CPU_PARTICLES_HPP
+#define HEADER_CPU_PARTICLES_HPP
+
+#include "../lib/irrlicht/source/Irrlicht/CParticleSystemSceneNode.h"
+
+#include <SColor.h>
+#include <vector>
+
+using namespace irr;
+
+class Track;
+
+/** A particle system for the fixed pipeline. It replaces the particle array
+ *  and the affectors of irrlicht's particle system with particle data stored
+ *  as one array per attribute, and built-in effects that are set with the
+ *  functions below instead of affectors: fade out, gravity, fade away with
+ *  the distance to the camera, scaling, color change, wind and collision
+ *  with the height map of a track. They are applied in the same order and
+ *  with the same results as the affectors used before.
+ *  New particles are emitted when the node is registered for rendering, since
+ *  irrlicht's emitters are not thread safe. The simulation of all particle
+ *  systems registered in a frame is then done in parallel by the worker pool
+ *  when the first one of them is rendered.
+ *  \ingroup graphics
+ */
+class CPUParticleSystem : public scene::CParticleSystemSceneNode
+{
+private:
+    /** Attributes of all particles, indexed by particle. */
+    std::vector<float>         m_pos[3];
+    std::vector<float>         m_velocity[3];
+    std::vector<float>         m_start_velocity[3];
+    std::vector<u32>           m_start_time;
+    std::vector<u32>           m_end_time;
+    std::vector<video::SColor> m_start_color;
+    std::vector<video::SColor> m_color;
+    std::vector<float>         m_start_size[2];
+    std::vector<float>         m_size[2];
+
+    /** Fade out to a color at the end of the life time. */
+    bool                       m_has_fade_out;
+    video::SColor              m_fade_out_color;
+    float                      m_fade_out_time;
+
+    /** Gravity, reached after m_gravity_time. */
+    bool                       m_has_gravity;
+    core::vector3df            m_gravity;
+    float                      m_gravity_time;
+
+    /** Squared distances from the camera at which particles start to fade
+     *  and are completely faded. */
+    bool                       m_has_fade_away;
+    float                      m_fade_away_start, m_fade_away_end;
+
+    /** Size at the end of the life time relative to the start size. */
+    bool                       m_has_scale;
+    core::vector2df            m_scale_factor;
+
+    /** Color at the start and end of the life time. */
+    bool                       m_has_color;
+    core::vector3df            m_color_from, m_color_to;
+
+    /** Wind speed and the seed of its noise, 0 if there is no wind. */
+    float                      m_wind_speed;
+    float                      m_wind_seed;
+
+    /** Height map of the track, HEIGHT_MAP_RESOLUTION squared values. */
+    std::vector<float>         m_height_map;
+    float                      m_track_x, m_track_z;
+    float                      m_track_x_len, m_track_z_len;
+    /** True until the particles were spread over the height at the first
+     *  update after the height map was set. */
+    bool                       m_height_map_first_time;
+
+    /** True if the particles are neither simulated nor drawn, see
+     *  ParticleLODManager. */
+    bool                       m_paused;
+
+    /** The update waiting for simulate: the time, the time since the last
+     *  update, the wind offset and the camera position. */
+    bool                       m_pending;
+    u32                        m_pending_now;
+    u32                        m_pending_dt;
+    bool                       m_pending_skip_height_map;
+    core::vector3df            m_pending_wind;
+    core::vector3df            m_pending_camera;
+
+    /** All particle systems with a pending update. */
+    static std::vector<CPUParticleSystem*> m_all_pending;
+
+    void         addParticle(const scene::SParticle &particle);
+    void         removeParticle(unsigned int i);
+    void         resizeBuffers(unsigned int count);
+    void         simulate();
+    static void  simulatePending();
+
+public:
+    static scene::IParticleSystemSceneNode *addParticleNode();
+
+                 CPUParticleSystem(scene::ISceneNode* parent,
+                                   scene::ISceneManager* mgr);
+    virtual     ~CPUParticleSystem();
+    virtual void OnRegisterSceneNode();
+    virtual void doParticleSystem(u32 time);
+    virtual void render();
+    virtual void clearParticles();
+    virtual void removeAllAffectors();
+
+    void         setFadeOut(const video::SColor &color, u32 fade_out_time);
+    void         setGravity(const core::vector3df &gravity,
+                            u32 time_force_lost);
+    void         setFadeAway(float start, float end);
+    void         setScale(const core::vector2df &factor);
+    void         setColors(const core::vector3df &from,
+                           const core::vector3df &to);
+    void         setWind(float speed);
+    void         setHeightMap(Track *track);
+    // ------------------------------------------------------------------------
+    /** Pauses or resumes the simulation. */
+    void         setPaused(bool paused) { m_paused = paused; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of particles. */
+    unsigned int getNumParticles() const
+    {
+        return (unsigned int)m_start_time.size();
+    }   // getNumParticles
+};   // CPUParticleSystem
+
+#endif
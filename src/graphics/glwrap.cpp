@@ -24,6 +24,7 @@
 #include "utils/profiler.hpp"
 #include "utils/cpp2011.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <sstream>
@@ -144,47 +145,101 @@ void initGL()
 #endif
 }
 
-ScopedGPUTimer::ScopedGPUTimer(GPUTimer &t) : timer(t)
+ScopedGPUTimer::ScopedGPUTimer(GPUTimer &t) : timer(t), started(false)
 {
-    if (!UserConfigParams::m_profiler_enabled) return;
-    if (profiler.isFrozen()) return;
-    if (!timer.canSubmitQuery) return;
+    // The dynamic resolution needs the times even if the profiler is hidden
+    // or frozen
+    if (!CVS->isDynamicResolutionEnabled())
+    {
+        if (!UserConfigParams::m_profiler_enabled && !timer.accumulate) return;
+        if (profiler.isFrozen()) return;
+    }
+    // All queries are in flight: skip this measurement instead of waiting
+    if (timer.pendingCount == GPUTimer::QUERY_COUNT) return;
 #ifdef GL_TIME_ELAPSED
     if (!timer.initialised)
     {
-        glGenQueries(1, &timer.query);
+        glGenQueries(GPUTimer::QUERY_COUNT, timer.queries);
         timer.initialised = true;
     }
-    glBeginQuery(GL_TIME_ELAPSED, timer.query);
+    unsigned query = (timer.firstPending + timer.pendingCount) % GPUTimer::QUERY_COUNT;
+    glBeginQuery(GL_TIME_ELAPSED, timer.queries[query]);
+    started = true;
 #endif
 }
 ScopedGPUTimer::~ScopedGPUTimer()
 {
-    if (!UserConfigParams::m_profiler_enabled) return;
-    if (profiler.isFrozen()) return;
-    if (!timer.canSubmitQuery) return;
+    if (!started) return;
 #ifdef GL_TIME_ELAPSED
     glEndQuery(GL_TIME_ELAPSED);
-    timer.canSubmitQuery = false;
+    timer.pendingCount++;
 #endif
 }
 
-GPUTimer::GPUTimer() : initialised(false), lastResult(0), canSubmitQuery(true)
+GPUTimer::GPUTimer() : initialised(false), firstPending(0), pendingCount(0),
+                       lastResult(0), historyNext(0), accumulate(false)
 {
 }
 
-unsigned GPUTimer::elapsedTimeus()
+/** Reads the results of the queries that are available, without waiting
+ *  for the others. Should be called once per frame.
+ */
+void GPUTimer::poll()
 {
+#ifdef GL_TIME_ELAPSED
     if (!initialised)
+        return;
+    while (pendingCount > 0)
+    {
+        GLuint query = queries[firstPending];
+        GLuint result;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &result);
+        if (result == GL_FALSE)
+            break;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT, &result);
+        lastResult = result / 1000;
+        addSample(lastResult);
+        firstPending = (firstPending + 1) % QUERY_COUNT;
+        pendingCount--;
+    }
+#endif
+}
+
+/** Returns the last GPU time that was measured, in us. */
+unsigned GPUTimer::elapsedTimeus()
+{
+    poll();
+    return lastResult;
+}
+
+void GPUTimer::addSample(unsigned us)
+{
+    if (history.size() < HISTORY_SIZE)
+        history.push_back(us);
+    else
+        history[historyNext] = us;
+    historyNext = (historyNext + 1) % HISTORY_SIZE;
+    if (accumulate)
+        samples.push_back(us);
+}
+
+/** Starts (after clearing the previous samples) or stops keeping all
+ *  results. The timer also measures while the profiler is hidden if
+ *  accumulating. */
+void GPUTimer::setAccumulate(bool enabled)
+{
+    accumulate = enabled;
+    if (enabled)
+        samples.clear();
+}
+
+unsigned GPUTimer::getPercentile(std::vector<unsigned> values, float fraction)
+{
+    if (values.empty())
         return 0;
-    GLuint result;
-    glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &result);
-    if (result == GL_FALSE)
-        return lastResult;
-    glGetQueryObjectuiv(query, GL_QUERY_RESULT, &result);
-    lastResult = result / 1000;
-    canSubmitQuery = true;
-    return result / 1000;
+    size_t n = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
 }
 
 FrameBuffer::FrameBuffer() {}
@@ -270,6 +325,17 @@ void FrameBuffer::Blit(const FrameBuffer &Src, FrameBuffer &Dst, GLbitfield mask
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
+/** Copies the color of Src into the rectangle (x0, y0) - (x1, y1) of Dst,
+ *  scaling it if the sizes differ. */
+void FrameBuffer::BlitToArea(const FrameBuffer &Src, FrameBuffer &Dst, size_t x0, size_t y0, size_t x1, size_t y1)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, Src.fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, Dst.fbo);
+    glBlitFramebuffer(0, 0, (int)Src.width, (int)Src.height, (int)x0, (int)y0, (int)x1, (int)y1, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
 void FrameBuffer::BlitToDefault(size_t x0, size_t y0, size_t x1, size_t y1)
 {
     glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
@@ -40,21 +40,53 @@ class ScopedGPUTimer
 {
 protected:
     GPUTimer &timer;
+    /** If a query was started, i.e. the timer wasn't skipped. */
+    bool started;
 public:
     ScopedGPUTimer(GPUTimer &);
     ~ScopedGPUTimer();
 };
 
+/** Measures the GPU time of a pass with a ring of GL_TIME_ELAPSED queries,
+ *  whose results are read without waiting once they are available. The
+ *  last results are kept to compute rolling percentiles; if all samples
+ *  are accumulated (benchmark mode), percentiles of the whole run can be
+ *  computed as well.
+ */
 class GPUTimer
 {
     friend class ScopedGPUTimer;
-    GLuint query;
+public:
+    /** Number of queries, i.e. of frames the results can lag behind. */
+    static const unsigned QUERY_COUNT = 4;
+private:
+    /** Number of samples of the rolling percentiles. */
+    static const unsigned HISTORY_SIZE = 256;
+    GLuint queries[QUERY_COUNT];
     bool initialised;
+    /** Index of the oldest query whose result wasn't read, and number of
+     *  ended queries whose results weren't read. */
+    unsigned firstPending;
+    unsigned pendingCount;
     unsigned lastResult;
-    bool canSubmitQuery;
+    std::vector<unsigned> history;
+    unsigned historyNext;
+    bool accumulate;
+    std::vector<unsigned> samples;
+
+    void addSample(unsigned us);
+    static unsigned getPercentile(std::vector<unsigned> values, float fraction);
 public:
     GPUTimer();
+    void poll();
     unsigned elapsedTimeus();
+    void setAccumulate(bool enabled);
+    /** Returns a percentile (fraction between 0 and 1) of the last results
+     *  in us. */
+    unsigned getRollingPercentile(float fraction) const { return getPercentile(history, fraction); }
+    /** Returns a percentile of all results since setAccumulate(true). */
+    unsigned getAccumulatedPercentile(float fraction) const { return getPercentile(samples, fraction); }
+    const std::vector<unsigned>& getAccumulatedSamples() const { return samples; }
 };
 
 class FrameBuffer
@@ -76,6 +108,7 @@ public:
     size_t getWidth() const { return width; }
     size_t getHeight() const { return height; }
     static void Blit(const FrameBuffer &Src, FrameBuffer &Dst, GLbitfield mask = GL_COLOR_BUFFER_BIT, GLenum filter = GL_NEAREST);
+    static void BlitToArea(const FrameBuffer &Src, FrameBuffer &Dst, size_t x0, size_t y0, size_t x1, size_t y1);
     void BlitToDefault(size_t, size_t, size_t, size_t);
 
     LEAK_CHECK();
@@ -62,8 +62,8 @@ ParticleSystemProxy::ParticleSystemProxy(bool createDefaultEmitter,
     m_color_to[0] = m_color_to[1] = m_color_to[2] = 1.0;
     
     // We set these later but avoid coverity report them
-    heighmapbuffer = 0;
     heightmaptexture = 0;
+    m_last_simulated_frame = 0;
     has_height_map = false;
     flip = false;
     track_x = 0;
@@ -81,10 +81,6 @@ ParticleSystemProxy::~ParticleSystemProxy()
         free(ParticleParams);
     if (!m_first_execution)
         cleanGL();
-    if (heighmapbuffer)
-        glDeleteBuffers(1, &heighmapbuffer);
-    if (heightmaptexture)
-        glDeleteTextures(1, &heightmaptexture);
 }
 
 void ParticleSystemProxy::setFlip()
@@ -92,31 +88,16 @@ void ParticleSystemProxy::setFlip()
     flip = true;
 }
 
-void ParticleSystemProxy::setHeightmap(const std::vector<std::vector<float> > &hm,
+/** Makes the particles stop at the ground.
+ *  \param texture Texture buffer with the height map of the track, which is
+ *         owned by the track and shared by all emitters.
+ */
+void ParticleSystemProxy::setHeightmap(GLuint texture,
     float f1, float f2, float f3, float f4)
 {
     track_x = f1, track_z = f2, track_x_len = f3, track_z_len = f4;
-
-    unsigned width  = (unsigned)hm.size();
-    unsigned height = (unsigned)hm[0].size();
-    float *hm_array = new float[width * height];
-    for (unsigned i = 0; i < width; i++)
-    {
-        for (unsigned j = 0; j < height; j++)
-        {
-            hm_array[i * height + j] = hm[i][j];
-        }
-    }
+    heightmaptexture = texture;
     has_height_map = true;
-    glGenBuffers(1, &heighmapbuffer);
-    glBindBuffer(GL_TEXTURE_BUFFER, heighmapbuffer);
-    glBufferData(GL_TEXTURE_BUFFER, width * height * sizeof(float), hm_array, GL_STREAM_COPY);
-    glGenTextures(1, &heightmaptexture);
-    glBindTexture(GL_TEXTURE_BUFFER, heightmaptexture);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, heighmapbuffer);
-    glBindBuffer(GL_TEXTURE_BUFFER, 0);
-
-    delete[] hm_array;
 }
 
 static
@@ -531,6 +512,12 @@ void ParticleSystemProxy::render() {
     if (m_first_execution)
         generateVAOs();
     m_first_execution = false;
-    simulate();
+    // In splitscreen the particles are drawn for each camera, but must only
+    // move once per frame
+    if (m_last_simulated_frame != irr_driver->getFrameNumber())
+    {
+        m_last_simulated_frame = irr_driver->getFrameNumber();
+        simulate();
+    }
     draw();
 }
@@ -27,7 +27,7 @@ namespace irr { namespace video{ class ITexture; } }
 class ParticleSystemProxy : public scene::CParticleSystemSceneNode
 {
 protected:
-    GLuint tfb_buffers[2], initial_values_buffer, heighmapbuffer, heightmaptexture, quaternionsbuffer;
+    GLuint tfb_buffers[2], initial_values_buffer, heightmaptexture, quaternionsbuffer;
     GLuint current_simulation_vao, non_current_simulation_vao;
     GLuint current_rendering_vao, non_current_rendering_vao;
     bool m_alpha_additive, has_height_map, flip;
@@ -35,6 +35,8 @@ protected:
     float m_color_from[3];
     float m_color_to[3];
     bool m_first_execution;
+    /** Frame the particles were last simulated in. */
+    unsigned int m_last_simulated_frame;
     bool m_randomize_initial_y;
 
     GLuint texture;
@@ -97,7 +99,7 @@ public:
     void setColorTo(float r, float g, float b) { m_color_to[0] = r; m_color_to[1] = g; m_color_to[2] = b; }
     const float* getColorFrom() const { return m_color_from; }
     const float* getColorTo() const { return m_color_to; }
-    void setHeightmap(const std::vector<std::vector<float> >&, float, float, float, float);
+    void setHeightmap(GLuint texture, float, float, float, float);
     void setFlip();
 };
 
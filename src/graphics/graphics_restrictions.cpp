@@ -60,6 +60,9 @@ namespace GraphicsRestrictions
             "AdvancedPipeline",
             "FramebufferSRGBWorking",
             "GI",
+            "GetProgramBinary",
+            "CopyImage",
+            "VertexType2101010Rev",
         };
     }   // namespace Private
     using namespace Private;
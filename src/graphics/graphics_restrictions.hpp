@@ -54,6 +54,9 @@ namespace GraphicsRestrictions
         GR_ADVANCED_PIPELINE,
         GR_FRAMEBUFFER_SRGB_WORKING,
         GR_GI,
+        GR_GET_PROGRAM_BINARY,
+        GR_COPY_IMAGE,
+        GR_VERTEX_TYPE_2_10_10_10_REV,
         GR_COUNT  /** MUST be last entry. */
     } ;
 
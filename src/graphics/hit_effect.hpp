@@ -20,6 +20,7 @@
 #define HEADER_HIT_EFFECT_HPP
 
 #include "utils/no_copy.hpp"
+#include "utils/object_pool.hpp"
 
 class Vec3;
 
@@ -40,6 +41,14 @@ public:
                  /** Constructor for a hit effect. */
                  HitEffect() {m_player_kart_hit = false; }
     virtual     ~HitEffect() {}
+    // ------------------------------------------------------------------------
+    /** Hit effects are created for each hit, so their memory is recycled. */
+    static void *operator new(size_t size)
+                           { return ObjectPool<HitEffect>::allocate(size); }
+    // ------------------------------------------------------------------------
+    static void  operator delete(void *p, size_t size)
+                           { ObjectPool<HitEffect>::release(p, size);      }
+    // ------------------------------------------------------------------------
     /** Updates a hit effect. Called once per frame.
      *  \param dt Time step size.
      *  \return True if the hit effect is finished and can be removed. */
@@ -27,9 +27,12 @@
 #include "graphics/light.hpp"
 #include "graphics/material_manager.hpp"
 #include "graphics/particle_kind_manager.hpp"
+#include "graphics/particle_lod_manager.hpp"
 #include "graphics/per_camera_node.hpp"
 #include "graphics/post_processing.hpp"
+#include "graphics/precooked_mesh.hpp"
 #include "graphics/referee.hpp"
+#include "graphics/screenshot_writer.hpp"
 #include "graphics/shaders.hpp"
 #include "graphics/stkanimatedmesh.hpp"
 #include "graphics/stkbillboard.hpp"
@@ -37,6 +40,8 @@
 #include "graphics/stkscenemanager.hpp"
 #include "graphics/sun.hpp"
 #include "graphics/rtts.hpp"
+#include "graphics/texture_array_manager.hpp"
+#include "graphics/transient_buffer.hpp"
 #include "graphics/texturemanager.hpp"
 #include "graphics/water.hpp"
 #include "graphics/wind.hpp"
@@ -117,8 +122,12 @@ IrrDriver::IrrDriver()
     m_request_screenshot = false;
     m_shaders             = NULL;
     m_rtts                = NULL;
+    m_render_scale_index  = 0;
+    m_gpu_frame_time      = -1.0f;
+    m_render_scale_frames = 0;
     m_post_processing     = NULL;
     m_wind                = new Wind();
+    m_frame_number        = 0;
     m_mipviz = m_wireframe = m_normals = m_ssaoviz = \
         m_lightviz = m_shadowviz = m_distortviz = m_rsm = m_rh = m_gi = m_boundingboxesviz = false;
     SkyboxCubeMap = m_last_light_bucket_distance = 0;
@@ -126,7 +135,10 @@ IrrDriver::IrrDriver()
     m_shadow_camnodes[1] = NULL;
     m_shadow_camnodes[2] = NULL;
     m_shadow_camnodes[3] = NULL;
+    m_rsm_matrix_initialized = false;
+    invalidateShadowCache();
     memset(object_count, 0, sizeof(object_count));
+    m_render_frame = 0;
 }   // IrrDriver
 
 // ----------------------------------------------------------------------------
@@ -149,6 +161,8 @@ IrrDriver::~IrrDriver()
     }
     assert(m_device != NULL);
 
+    stopTextureStreaming();
+    stopScreenshots();
     m_device->drop();
     m_device = NULL;
     m_modes.clear();
@@ -489,7 +503,9 @@ void IrrDriver::initDevice()
     m_scene_manager = m_device->getSceneManager();
     m_gui_env       = m_device->getGUIEnvironment();
     m_video_driver  = m_device->getVideoDriver();
-    m_sync = 0;
+    for (unsigned i = 0; i < INSTANCE_BUFFER_COUNT; i++)
+        m_sync[i] = 0;
+    m_instance_buffer_index = 0;
 
     m_actual_screen_size = m_video_driver->getCurrentRenderTargetSize();
 
@@ -799,7 +815,10 @@ void IrrDriver::applyResolutionSettings()
     ShadowPassCmd::getInstance()->kill();
     RSMPassCmd::getInstance()->kill();
     GlowPassCmd::getInstance()->kill();
+    TransientBuffer::kill();
     resetTextureTable();
+    stopTextureStreaming();
+    stopScreenshots();
     // initDevice will drop the current device.
     initDevice();
 
@@ -932,12 +951,36 @@ scene::IAnimatedMesh *IrrDriver::getAnimatedMesh(const std::string &filename)
 
 // ----------------------------------------------------------------------------
 
-/** Loads a non-animated mesh and returns a pointer to it.
+/** Loads a non-animated mesh and returns a pointer to it. The first time a
+ *  mesh is loaded its precooked version is used if it is up to date, which
+ *  avoids parsing the mesh file. Otherwise the mesh is parsed, and the
+ *  precooked version is written for the next time.
  *  \param filename  File to load.
  */
 scene::IMesh *IrrDriver::getMesh(const std::string &filename)
 {
-    scene::IAnimatedMesh* am = getAnimatedMesh(filename);
+    scene::IAnimatedMesh* am = NULL;
+    // Compressed meshes are cached by the name of the file in the archive,
+    // so they can't be found by their name here
+    if (StringUtils::getExtension(filename) != "b3dz" &&
+        !m_scene_manager->getMeshCache()->getMeshByName(filename.c_str()))
+    {
+        am = loadPrecookedMesh(filename);
+        if (am)
+        {
+            setAllMaterialFlags(am);
+            m_scene_manager->getMeshCache()->addMesh(filename.c_str(), am);
+            am->drop();
+        }
+        else
+        {
+            am = getAnimatedMesh(filename);
+            if (am)
+                savePrecookedMesh(filename, am);
+        }
+    }
+    else
+        am = getAnimatedMesh(filename);
     if (am == NULL)
     {
         Log::error("irr_driver", "Cannot load mesh <%s>\n",
@@ -1716,16 +1759,14 @@ void IrrDriver::setRTT(RTT* rtt)
 {
     memset(m_shadow_camnodes, 0, 4 * sizeof(void*));
     m_rtts = rtt;
+    // The cache textures belong to the RTT
+    invalidateShadowCache();
 }
 // ----------------------------------------------------------------------------
 void IrrDriver::onLoadWorld()
 {
     if (CVS->isGLSL())
-    {
-        const core::recti &viewport = Camera::getCamera(0)->getViewport();
-        size_t width = viewport.LowerRightCorner.X - viewport.UpperLeftCorner.X, height = viewport.LowerRightCorner.Y - viewport.UpperLeftCorner.Y;
-        m_rtts = new RTT(width, height);
-    }
+        createRTT();
 }
 // ----------------------------------------------------------------------------
 void IrrDriver::onUnloadWorld()
@@ -1733,8 +1774,114 @@ void IrrDriver::onUnloadWorld()
     delete m_rtts;
     m_rtts = NULL;
 
+    clearDrawCallBatches();
+    if (CVS->isTextureArrayBatchingEnabled())
+        TextureArrayManager::getInstance()->reset();
     suppressSkyBox();
 }
+
+// ----------------------------------------------------------------------------
+/** Scales of the resolution of the 3D scene the dynamic resolution chooses
+ *  from, from the full resolution down. */
+static const float g_render_scales[] = { 1.0f, 0.85f, 0.7f, 0.6f, 0.5f };
+static const unsigned RENDER_SCALE_COUNT =
+                            sizeof(g_render_scales) / sizeof(g_render_scales[0]);
+/** Number of frames the GPU time is measured at a scale before it can be
+ *  changed again. It is larger than the latency of the GPU timers, and
+ *  avoids recreating the render targets too often. */
+static const unsigned RENDER_SCALE_MIN_FRAMES = 60;
+
+// ----------------------------------------------------------------------------
+/** (Re)creates the render targets with the size of the viewport of the first
+ *  camera, scaled by the current scale of the dynamic resolution.
+ */
+void IrrDriver::createRTT()
+{
+    delete m_rtts;
+    const core::recti &viewport = Camera::getCamera(0)->getViewport();
+    const float scale = getRenderScale();
+    size_t width  = size_t((viewport.LowerRightCorner.X
+                            - viewport.UpperLeftCorner.X) * scale);
+    size_t height = size_t((viewport.LowerRightCorner.Y
+                            - viewport.UpperLeftCorner.Y) * scale);
+    m_rtts = new RTT(width, height);
+    invalidateShadowCache();
+    m_gpu_frame_time = -1.0f;
+    m_render_scale_frames = 0;
+}   // createRTT
+
+// ----------------------------------------------------------------------------
+/** Returns the scale of the resolution of the 3D scene relative to the
+ *  viewports of the cameras.
+ */
+float IrrDriver::getRenderScale() const
+{
+    return g_render_scales[m_render_scale_index];
+}   // getRenderScale
+
+// ----------------------------------------------------------------------------
+/** Chooses the resolution of the 3D scene from the GPU time of the last
+ *  frames, so that it stays below UserConfigParams::m_dynamic_resolution_target.
+ *  The scale is lowered by one step if the smoothed time exceeds the target,
+ *  and raised by one step only if the time predicted for the larger number
+ *  of pixels is clearly below the target, to avoid oscillating between two
+ *  scales. The final pass-through of the post-processed image to the
+ *  viewport upscales it. Must be called once per frame, after the GPU timers
+ *  were polled.
+ */
+void IrrDriver::updateDynamicResolution()
+{
+    if (!m_rtts)
+        return;
+    if (!CVS->isDynamicResolutionEnabled())
+    {
+        if (m_render_scale_index != 0)
+        {
+            m_render_scale_index = 0;
+            createRTT();
+        }
+        return;
+    }
+
+    // The GUI is drawn at the screen resolution and doesn't scale
+    float gpu_time = 0.0f;
+    for (unsigned i = 0; i < Q_LAST; i++)
+    {
+        if (i != Q_GUI)
+            gpu_time += getGPUTimer(i).elapsedTimeus();
+    }
+    m_render_scale_frames++;
+    // The first frames after a change may still be measured at the old scale
+    if (m_render_scale_frames < GPUTimer::QUERY_COUNT)
+        return;
+    if (m_gpu_frame_time < 0.0f)
+        m_gpu_frame_time = gpu_time;
+    else
+        m_gpu_frame_time = 0.9f * m_gpu_frame_time + 0.1f * gpu_time;
+    if (m_render_scale_frames < RENDER_SCALE_MIN_FRAMES)
+        return;
+
+    const float target = UserConfigParams::m_dynamic_resolution_target * 1000.0f;
+    unsigned index = m_render_scale_index;
+    if (m_gpu_frame_time > target && index + 1 < RENDER_SCALE_COUNT)
+    {
+        index++;
+    }
+    else if (index > 0)
+    {
+        const float ratio = g_render_scales[index - 1] / g_render_scales[index];
+        if (m_gpu_frame_time * ratio * ratio < 0.9f * target)
+            index--;
+    }
+    if (index == m_render_scale_index)
+        return;
+
+    Log::debug("irr_driver", "GPU time %.2f ms, changing the render scale "
+               "from %.2f to %.2f.", m_gpu_frame_time / 1000.0f,
+               g_render_scales[m_render_scale_index], g_render_scales[index]);
+    m_render_scale_index = index;
+    createRTT();
+}   // updateDynamicResolution
 // ----------------------------------------------------------------------------
 /** Sets the ambient light.
  *  \param light The colour of the light to set.
@@ -2014,20 +2161,13 @@ void IrrDriver::drawJoint(bool drawline, bool drawname,
 #endif
 
 // ----------------------------------------------------------------------------
-/** Requess a screenshot from irrlicht, and save it in a file.
+/** Requests a screenshot of the current frame. The file is written in the
+ *  background, and a message is shown once it is (see showScreenshotResults).
  */
 void IrrDriver::doScreenShot()
 {
     m_request_screenshot = false;
 
-    video::IImage* image = m_video_driver->createScreenShot();
-    if(!image)
-    {
-        Log::error("IrrDriver", "Could not create screen shot.");
-        return;
-    }
-
-    // Screenshot was successful.
     time_t rawtime;
     time ( &rawtime );
     tm* timeInfo = localtime( &rawtime );
@@ -2041,32 +2181,46 @@ void IrrDriver::doScreenShot()
     if (World::getWorld() == NULL) track_name = "menu";
     std::string path = file_manager->getScreenshotDir()+track_name+"-"+time_buffer+".png";
 
-    if (irr_driver->getVideoDriver()->writeImageToFile(image, path.c_str(), 0))
+    startScreenshot(path);
+}   // doScreenShot
+
+// ----------------------------------------------------------------------------
+/** Shows a message for each screenshot that was written (or failed to be)
+ *  since the last frame.
+ */
+void IrrDriver::showScreenshotResults()
+{
+    updateScreenshots(&m_saved_screenshots);
+    for (unsigned i = 0; i < m_saved_screenshots.size(); i++)
     {
+        const std::string &path = m_saved_screenshots[i].first;
+        if (m_saved_screenshots[i].second)
+            Log::info("IrrDriver", "Screenshot saved to '%s'.", path.c_str());
+        else
+            Log::error("IrrDriver", "Could not save screenshot to '%s'.",
+                       path.c_str());
+
         RaceGUIBase* base = World::getWorld()
                           ? World::getWorld()->getRaceGUI()
                           : NULL;
-        if (base)
+        if (!base)
+            continue;
+        if (m_saved_screenshots[i].second)
         {
             base->addMessage(
                       core::stringw(("Screenshot saved to\n" + path).c_str()),
                       NULL, 2.0f, video::SColor(255,255,255,255), true, false);
-        }   // if base
-    }
-    else
-    {
-        RaceGUIBase* base = World::getWorld()->getRaceGUI();
-        if (base)
+        }
+        else
         {
             base->addMessage(
                 core::stringw(("FAILED saving screenshot to\n" + path +
                               "\n:(").c_str()),
                 NULL, 2.0f, video::SColor(255,255,255,255),
                 true, false);
-        }   // if base
-    }   // if failed writing screenshot file
-    image->drop();
-}   // doScreenShot
+        }
+    }   // for i < m_saved_screenshots.size()
+}   // showScreenshotResults
 
 // ----------------------------------------------------------------------------
 /** Update, called once per frame.
@@ -2101,8 +2255,13 @@ void IrrDriver::update(float dt)
     }
 
     m_wind->update();
+    m_frame_number++;
+    updateTextureStreaming();
+    showScreenshotResults();
 
     World *world = World::getWorld();
+    if (world)
+        ParticleLODManager::getInstance()->update();
 
     if (GUIEngine::getCurrentScreen() != NULL &&
         GUIEngine::getCurrentScreen()->needs3D() &&
@@ -2124,6 +2283,12 @@ void IrrDriver::update(float dt)
     }
     else if (!world)
     {
+        // Keep the last frame on screen if the menu didn't change
+        if (!GUIEngine::needsRedraw(dt))
+        {
+            GUIEngine::skipFrame(dt);
+            return;
+        }
         m_video_driver->beginScene(/*backBuffer clear*/ true, /*zBuffer*/ true,
                                    video::SColor(255,100,101,140));
 
@@ -2139,15 +2304,6 @@ void IrrDriver::update(float dt)
         renderFixed(dt);
 
 
-    if (world != NULL && world->getPhysics() != NULL)
-    {
-        IrrDebugDrawer* debug_drawer = world->getPhysics()->getDebugDrawer();
-        if (debug_drawer != NULL && debug_drawer->debugEnabled())
-        {
-            debug_drawer->beginNextFrame();
-        }
-    }
-
     if (m_request_screenshot) doScreenShot();
 
     // Enable this next print statement to get render information printed
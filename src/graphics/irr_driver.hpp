@@ -28,6 +28,7 @@
  */
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <IVideoDriver.h>
@@ -37,6 +38,7 @@
 #include "IrrlichtDevice.h"
 #include "ISkinnedMesh.h"
 #include "graphics/shaders.hpp"
+#include "graphics/vaomanager.hpp"
 #include "graphics/wind.hpp"
 #include "io/file_manager.hpp"
 #include "utils/aligned_array.hpp"
@@ -94,6 +96,8 @@ enum TypeFBO
     FBO_HALF2_R,
     FBO_QUARTER1,
     FBO_QUARTER2,
+    FBO_QUARTER1_R,
+    FBO_QUARTER2_R,
     FBO_EIGHTH1,
     FBO_EIGHTH2,
     FBO_DISPLACE,
@@ -133,6 +137,8 @@ enum TypeRTT
 
     RTT_QUARTER1,
     RTT_QUARTER2,
+    RTT_QUARTER1_R,
+    RTT_QUARTER2_R,
     //    RTT_QUARTER3,
     //    RTT_QUARTER4,
 
@@ -182,7 +188,11 @@ enum TypeRTT
 class IrrDriver : public IEventReceiver, public NoCopy
 {
 private:
-    GLsync m_sync;
+    /** Fences set after the last use of each copy of the instance buffers,
+     *  see INSTANCE_BUFFER_COUNT. */
+    GLsync m_sync[INSTANCE_BUFFER_COUNT];
+    /** Copy of the instance buffers used by the current scene. */
+    unsigned m_instance_buffer_index;
     /** The irrlicht device. */
     IrrlichtDevice             *m_device;
     /** Irrlicht scene manager. */
@@ -199,14 +209,32 @@ private:
     Shaders              *m_shaders;
     /** Wind. */
     Wind                 *m_wind;
+    /** Number of frames updated so far. */
+    unsigned int          m_frame_number;
     /** RTTs. */
     RTT                *m_rtts;
+    /** Index in the scales of the dynamic resolution of the scale of the
+     *  resolution of m_rtts. */
+    unsigned           m_render_scale_index;
+    /** Smoothed GPU time of the frames in us, or a negative value if no time
+     *  was measured at the current scale. */
+    float              m_gpu_frame_time;
+    /** Number of frames rendered since the scale was changed. */
+    unsigned           m_render_scale_frames;
     std::vector<core::matrix4> sun_ortho_matrix;
     core::vector3df    rh_extend;
     core::matrix4      rh_matrix;
     core::matrix4      rsm_matrix;
     bool               m_rsm_matrix_initialized;
     bool               m_rsm_map_available;
+    /** True if the radiance hints were computed from the current RSM, for
+     *  m_rh_matrix_cached and m_rh_sun_color_cached. The RSM only contains
+     *  the scene at the time it was rendered, so the radiance hints only
+     *  have to be computed again when the volume moves with the camera or
+     *  the sun changes. */
+    bool               m_rh_available;
+    core::matrix4      m_rh_matrix_cached;
+    video::SColorf     m_rh_sun_color_cached;
     core::vector2df    m_current_screen_size;
     core::dimension2du m_actual_screen_size;
 
@@ -281,6 +309,8 @@ private:
     void                 createListOfVideoModes();
 
     bool                 m_request_screenshot;
+    /** Screenshots written in the last frame, reused to avoid allocations. */
+    std::vector<std::pair<std::string, bool> > m_saved_screenshots;
 
     bool                 m_wireframe;
     bool                 m_mipviz;
@@ -298,6 +328,10 @@ private:
     unsigned             object_count[PASS_COUNT];
     unsigned             poly_count[PASS_COUNT];
     u32                  m_renderpass;
+    /** Number of rendered frames. In splitscreen the scene is prepared once
+     *  per camera, this is used to do the camera independent updates of
+     *  the scene nodes only once per frame. */
+    unsigned int         m_render_frame;
     class STKMeshSceneNode *m_sun_interposer;
     scene::ICameraSceneNode *m_suncam;
     core::vector3df m_sundirection;
@@ -306,7 +340,28 @@ private:
     scene::ICameraSceneNode *m_shadow_camnodes[4];
     float m_shadows_cam[4][24];
 
+    /** Static shadow cache: the static geometry of the far cascades is
+     *  rendered into a cache, which is only updated if the cascade leaves
+     *  the (enlarged) light space box it was rendered for, or if the set
+     *  of static shadow casters changed. */
+    /** True if the cache is used for the cascade in the current frame. */
+    bool            m_shadow_cache_used[4];
+    /** True if the cache of a cascade contains the static geometry for
+     *  m_shadow_cache_box. */
+    bool            m_shadow_cache_rendered[4];
+    /** Light space box, projection, size and sun view matrix of the
+     *  cascade when its cache was rendered. */
+    core::aabbox3df m_shadow_cache_box[4];
+    core::matrix4   m_shadow_cache_projection[4];
+    std::pair<float, float> m_shadow_cache_scale[4];
+    core::matrix4   m_shadow_cache_sun_view[4];
+    /** Hash of the static shadow casters of each cascade. */
+    uint64_t        m_shadow_cache_signature[4];
+
     std::vector<GlowData> m_glowing;
+    /** The glowing nodes of the current frame: m_glowing and the items.
+     *  Kept as member so that its memory is reused each frame. */
+    std::vector<GlowData> m_frame_glowing;
 
     std::vector<LightNode *> m_lights;
 
@@ -337,8 +392,10 @@ private:
     void renderNormalsVisualisation();
     void renderTransparent();
     void renderParticles();
-    void computeSunVisibility();
     void renderShadows();
+    core::matrix4 getCachedShadowProjection(unsigned cascade,
+                                      const core::matrix4 &sun_view,
+                                      const std::vector<core::vector3df> &points);
     void renderRSM();
     void renderGlow(std::vector<GlowData>& glows);
     void renderSSAO();
@@ -347,12 +404,14 @@ private:
     void renderLightsScatter(unsigned pointlightCount);
     void renderShadowsDebug();
     void doScreenShot();
+    void showScreenshotResults();
     void PrepareDrawCalls(scene::ICameraSceneNode *camnode);
 public:
          IrrDriver();
         ~IrrDriver();
     void initDevice();
     void reset();
+    void warmupShaders();
     void setMaxTextureSize();
     void getOpenGLData(std::string *vendor, std::string *renderer,
                        std::string *version);
@@ -366,6 +425,30 @@ public:
     {
         return sun_ortho_matrix;
     }
+    // ------------------------------------------------------------------------
+    /** Index of the first shadow cascade whose static geometry is cached. */
+    static const unsigned FIRST_CACHED_CASCADE = 2;
+    // ------------------------------------------------------------------------
+    /** Returns true if the static shadow casters of the given cascade are
+     *  drawn into the shadow cache in the current frame. */
+    bool isShadowCacheUsed(unsigned cascade) const
+    {
+        return m_shadow_cache_used[cascade];
+    }
+    // ------------------------------------------------------------------------
+    /** Forces the static shadow cache, the RSM and the radiance hints to be
+     *  rendered again, e.g. because the render targets were recreated. */
+    void invalidateShadowCache()
+    {
+        for (unsigned i = 0; i < 4; i++)
+        {
+            m_shadow_cache_used[i] = false;
+            m_shadow_cache_rendered[i] = false;
+            m_shadow_cache_signature[i] = 0;
+        }
+        m_rsm_map_available = false;
+        m_rh_available = false;
+    }
     void IncreaseObjectCount();
     void IncreasePolyCount(unsigned);
     core::array<video::IRenderTarget> &getMainSetup();
@@ -543,6 +626,10 @@ public:
     inline PostProcessing* getPostProcessing()  {return m_post_processing;}
     // ------------------------------------------------------------------------
     inline core::vector3df getWind()  {return m_wind->getWind();}
+    // ------------------------------------------------------------------------
+    /** Returns the number of the current frame, for scene nodes which are
+     *  rendered once for each camera but must only be updated once. */
+    unsigned int getFrameNumber() const { return m_frame_number; }
     // -----------------------------------------------------------------------
     core::vector3df getSunDirection() const { return m_sundirection; };
     // -----------------------------------------------------------------------
@@ -571,6 +658,9 @@ public:
     FrameBuffer& getFBO(TypeFBO which);
     GLuint getDepthStencilTexture();
     // ------------------------------------------------------------------------
+    /** Returns the number of the frame currently rendered. */
+    unsigned int getRenderFrame() const { return m_render_frame; }
+    // ------------------------------------------------------------------------
     void resetDebugModes()
     {
         m_wireframe = false;
@@ -682,6 +772,7 @@ public:
     const core::matrix4 &getProjViewMatrix() const { return m_ProjViewMatrix; }
     const core::matrix4 &getInvProjViewMatrix() const { return m_InvProjViewMatrix; }
     const core::vector2df &getCurrentScreenSize() const { return m_current_screen_size; }
+    void setCurrentScreenSize(const core::vector2df &size);
     const core::dimension2du getActualScreenSize() const { return m_actual_screen_size; }
     // ------------------------------------------------------------------------
     float getSSAORadius() const
@@ -727,6 +818,9 @@ public:
 
     void onLoadWorld();
     void onUnloadWorld();
+    void createRTT();
+    void updateDynamicResolution();
+    float getRenderScale() const;
 
     void renderScene(scene::ICameraSceneNode * const camnode, unsigned pointlightcount, std::vector<GlowData>& glows, float dt, bool hasShadows, bool forceRTT);
     unsigned UpdateLightsInfo(scene::ICameraSceneNode * const camnode, float dt);
@@ -51,6 +51,11 @@ LODNode::LODNode(std::string group_name, scene::ISceneNode* parent,
 
     m_forced_lod = -1;
     m_last_tick = 0;
+    for (unsigned int i = 0; i < MAX_CACHED_CAMERAS; i++)
+    {
+        m_cached_level[i] = -2;
+        m_cached_frame[i] = (unsigned int)-1;
+    }
 }
 
 LODNode::~LODNode()
@@ -62,6 +67,68 @@ void LODNode::render()
     //ISceneNode::render();
 }
 
+/** Relative distance by which an object has to move past a LOD distance
+ *  before the level changes, to avoid popping when it is at the boundary. */
+static const float LOD_HYSTERESIS = 0.1f;
+
+// ---------------------------------------------------------------------------
+/** Returns the position from which the LOD distances are measured for the
+ *  given camera. This is computed only once per frame and camera (instead
+ *  of once per LOD node and call).
+ */
+static const Vec3& getObserverPosition(Camera *camera)
+{
+    static Vec3         observer_pos;
+    static Camera      *observer_camera = NULL;
+    static unsigned int observer_frame  = 0;
+    if (observer_camera != camera ||
+        observer_frame  != irr_driver->getRenderFrame())
+    {
+        observer_camera = camera;
+        observer_frame  = irr_driver->getRenderFrame();
+        AbstractKart* kart = camera->getKart();
+        // use kart position and not camera position when a kart is available,
+        // because for some effects the camera will be moved to various locations
+        // (for instance shadows), so using camera position for LOD may result
+        // in objects being culled when they shouldn't
+        observer_pos = (kart != NULL ? kart->getFrontXYZ()
+                     : camera->getCameraSceneNode()->getAbsolutePosition());
+    }
+    return observer_pos;
+}   // getObserverPosition
+
+// ---------------------------------------------------------------------------
+/** Computes the level for an observer at the given position.
+ *  \param previous_level The level used in the previous frame: a level
+ *         closer than it is only used once the distance is a bit below its
+ *         LOD distance, and the previous level is kept until the distance
+ *         is a bit beyond it. -1 means the object was hidden, -2 that there
+ *         is no previous level.
+ */
+int LODNode::computeLevel(const Vec3 &pos, int previous_level) const
+{
+    const float dist =
+        (m_nodes[0]->getAbsolutePosition()).getDistanceFromSQ(pos.toIrrVector());
+
+    const unsigned int previous = previous_level == -1
+                                ? (unsigned int)m_detail.size()
+                                : (unsigned int)previous_level;
+    // The LOD distances are squared, so are the factors
+    const float closer = (1.0f - LOD_HYSTERESIS)*(1.0f - LOD_HYSTERESIS);
+    const float further = (1.0f + LOD_HYSTERESIS)*(1.0f + LOD_HYSTERESIS);
+    for (unsigned int n=0; n<m_detail.size(); n++)
+    {
+        float detail = (float)m_detail[n];
+        if (previous_level != -2)
+            detail *= n < previous ? closer : further;
+        if (dist < detail)
+            return n;
+    }
+
+    return -1;
+}   // computeLevel
+
+// ---------------------------------------------------------------------------
 /** Returns the level to use, or -1 if the object is too far
  *  away.
  */
@@ -77,23 +144,19 @@ int LODNode::getLevel()
     Camera* camera = Camera::getActiveCamera();
     if (camera == NULL)
         return (int)m_detail.size() - 1;
-    AbstractKart* kart = camera->getKart();
-    // use kart position and not camera position when a kart is available,
-    // because for some effects the camera will be moved to various locations
-    // (for instance shadows), so using camera position for LOD may result
-    // in objects being culled when they shouldn't
-    const Vec3 &pos = (kart != NULL ? kart->getFrontXYZ() : camera->getCameraSceneNode()->getAbsolutePosition());
 
-    const int dist =
-        (int)((m_nodes[0]->getAbsolutePosition()).getDistanceFromSQ(pos.toIrrVector() ));
+    const Vec3 &pos = getObserverPosition(camera);
+    const unsigned int index = camera->getIndex();
+    if (index >= MAX_CACHED_CAMERAS)
+        return computeLevel(pos, -2);
 
-    for (unsigned int n=0; n<m_detail.size(); n++)
+    const unsigned int frame = irr_driver->getRenderFrame();
+    if (m_cached_frame[index] != frame)
     {
-        if (dist < m_detail[n])
-            return n;
+        m_cached_level[index] = computeLevel(pos, m_cached_level[index]);
+        m_cached_frame[index] = frame;
     }
-
-    return -1;
+    return m_cached_level[index];
 }  // getLevel
 
 // ---------------------------------------------------------------------------
@@ -30,6 +30,7 @@ namespace irr
     namespace scene { class ISceneManager; class ISceneNode; }
 }
 using namespace irr;
+class Vec3;
 
 #include <set>
 
@@ -73,6 +74,19 @@ private:
 
     u32 m_last_tick;
 
+    /** Number of cameras for which the level is cached. */
+    static const unsigned int MAX_CACHED_CAMERAS = 4;
+
+    /** The level computed for each camera, and the render frame it was
+     *  computed in: getLevel() is called several times per frame (animation,
+     *  culling, registration), but the level only needs to be computed once
+     *  per frame and camera. The level is also used for hysteresis. A level
+     *  of -2 means that no level was computed yet. */
+    int          m_cached_level[MAX_CACHED_CAMERAS];
+    unsigned int m_cached_frame[MAX_CACHED_CAMERAS];
+
+    int computeLevel(const Vec3 &pos, int previous_level) const;
+
 public:
 
     LODNode(std::string group_name, scene::ISceneNode* parent, scene::ISceneManager* mgr, s32 id=-1);
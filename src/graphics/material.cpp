@@ -575,7 +575,8 @@ void Material::initCustomSFX(const XMLNode *sfx)
         // so just misuse the getModelFile function
         const std::string full_path = file_manager->getAsset(FileManager::MODEL,
                                                              filename);
-        SFXBuffer* buffer = SFXManager::get()->loadSingleSfx(sfx, full_path);
+        SFXBuffer* buffer = SFXManager::get()->loadSingleSfx(sfx, full_path,
+                                                             false);
 
         if (buffer != NULL)
         {
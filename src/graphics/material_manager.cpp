@@ -63,37 +63,73 @@ MaterialManager::~MaterialManager()
 
 //-----------------------------------------------------------------------------
 
+/** Adds a material to the temporary layer.
+ */
+void MaterialManager::addMaterial(Material *m)
+{
+    m_materials.push_back(m);
+    m_layers[1].m_by_name[m->getTexFname()]         = m;
+    m_layers[1].m_by_full_path[m->getTexFullPath()] = m;
+    m_texture_cache.clear();
+}   // addMaterial
+
+//-----------------------------------------------------------------------------
+/** Returns the latest material with the given texture name or full path,
+ *  searching temporary (track) materials first.
+ *  \param name Texture name or full path of the texture.
+ *  \param full_path True if name is a full path.
+ *  \return The material, or NULL if there is none.
+ */
+Material *MaterialManager::findMaterial(const std::string &name,
+                                        bool full_path) const
+{
+    for (int layer = 1; layer >= 0; layer--)
+    {
+        const std::unordered_map<std::string, Material*> &map =
+            full_path ? m_layers[layer].m_by_full_path
+                      : m_layers[layer].m_by_name;
+        std::unordered_map<std::string, Material*>::const_iterator it =
+            map.find(name);
+        if (it != map.end())
+            return it->second;
+    }
+    return NULL;
+}   // findMaterial
+
+//-----------------------------------------------------------------------------
+
 Material* MaterialManager::getMaterialFor(video::ITexture* t,
                                           scene::IMeshBuffer *mb)
 {
     if (t == NULL)
         return m_default_material;
 
+    std::unordered_map<const video::ITexture*, TextureCacheEntry>::iterator
+        cached = m_texture_cache.find(t);
+    if (cached != m_texture_cache.end() &&
+        cached->second.m_name == t->getName().getPath())
+        return cached->second.m_material ? cached->second.m_material
+                                         : m_default_material;
+
     core::stringc img_path = core::stringc(t->getName());
-    const std::string image = StringUtils::getBasename(img_path.c_str());
+    Material *material;
     if (!img_path.empty() && (img_path.findFirst('/') != -1 || img_path.findFirst('\\') != -1))
     {
-        // Search backward so that temporary (track) textures are found first
-        for (int i = (int)m_materials.size() - 1; i >= 0; i--)
-        {
-            if (m_materials[i]->getTexFullPath() == img_path.c_str())
-            {
-                return m_materials[i];
-            }
-        }
+        material = findMaterial(img_path.c_str(), /*full_path*/true);
     }
     else
     {
-        for (int i = (int)m_materials.size() - 1; i >= 0; i--)
-        {
-            if (m_materials[i]->getTexFname() == image)
-            {
-                return m_materials[i];
-            }
-        }   // for i
+        const std::string image = StringUtils::getBasename(img_path.c_str());
+        material = findMaterial(image, /*full_path*/false);
     }
-    return m_default_material;
-}
+
+    // The default material might only be created later, so it is not
+    // stored in the cache
+    TextureCacheEntry &entry = m_texture_cache[t];
+    entry.m_material = material;
+    entry.m_name     = t->getName().getPath();
+    return material ? material : m_default_material;
+}   // getMaterialFor
 
 //-----------------------------------------------------------------------------
 /** Searches for the material in the given texture, and calls a function
@@ -164,15 +200,9 @@ void MaterialManager::adjustForFog(video::ITexture* t,
                                    bool use_fog) const
 {
     const std::string image = StringUtils::getBasename(core::stringc(t->getName()).c_str());
-    // Search backward so that temporary (track) textures are found first
-    for(int i = (int)m_materials.size()-1; i>=0; i-- )
-    {
-        if (m_materials[i]->getTexFname()==image)
-        {
-            m_materials[i]->adjustForFog(parent, &(mb->getMaterial()), use_fog);
-            return;
-        }
-    }   // for i
+    Material *material = findMaterial(image, /*full_path*/false);
+    if (material)
+        material->adjustForFog(parent, &(mb->getMaterial()), use_fog);
 }   // adjustForFog
 
 //-----------------------------------------------------------------------------
@@ -198,7 +228,7 @@ void MaterialManager::setAllUntexturedMaterialFlags(scene::IMeshBuffer *mb)
 //-----------------------------------------------------------------------------
 int MaterialManager::addEntity(Material *m)
 {
-    m_materials.push_back(m);
+    addMaterial(m);
     return (int)m_materials.size()-1;
 }
 
@@ -216,7 +246,7 @@ void MaterialManager::loadMaterial()
         addSharedMaterial(deprecated, true);
 
     // Save index of shared textures
-    m_shared_material_index = (int)m_materials.size();
+    makeMaterialsPermanent();
 }   // MaterialManager
 
 //-----------------------------------------------------------------------------
@@ -236,7 +266,7 @@ void MaterialManager::addSharedMaterial(const std::string& filename, bool deprec
         msg <<"FATAL: Parsing error in '"<<filename<<"'\n";
         throw std::runtime_error(msg.str());
     }
-    m_shared_material_index = (int)m_materials.size();
+    makeMaterialsPermanent();
 }   // addSharedMaterial
 
 //-----------------------------------------------------------------------------
@@ -269,7 +299,7 @@ bool MaterialManager::pushTempMaterial(const XMLNode *root,
         }
         try
         {
-            m_materials.push_back(new Material(node, deprecated));
+            addMaterial(new Material(node, deprecated));
         }
         catch(std::exception& e)
         {
@@ -289,6 +319,9 @@ void MaterialManager::popTempMaterial()
         delete m_materials[i];
         m_materials.pop_back();
     }   // for i6
+    m_layers[1].m_by_name.clear();
+    m_layers[1].m_by_full_path.clear();
+    m_texture_cache.clear();
 }   // popTempMaterial
 
 //-----------------------------------------------------------------------------
@@ -329,19 +362,16 @@ Material *MaterialManager::getMaterial(const std::string& fname,
     else
         basename = fname;
         
-    // Search backward so that temporary (track) textures are found first
-    for(int i = (int)m_materials.size()-1; i>=0; i-- )
-    {
-        if(m_materials[i]->getTexFname()==basename) return m_materials[i];
-    }
+    Material *material = findMaterial(basename, /*full_path*/false);
+    if(material) return material;
 
     // Add the new material
     Material* m = new Material(fname, is_full_path, complain_if_not_found);
-    m_materials.push_back(m);
+    addMaterial(m);
     if(make_permanent)
     {
         assert(m_shared_material_index==(int)m_materials.size()-1);
-        m_shared_material_index = (int)m_materials.size();
+        makeMaterialsPermanent();
     }
     return m ;
 }   // getMaterial
@@ -353,17 +383,19 @@ Material *MaterialManager::getMaterial(const std::string& fname,
 void MaterialManager::makeMaterialsPermanent()
 {
     m_shared_material_index = (int) m_materials.size();
+    // Later materials override earlier ones with the same name
+    Layer &temp = m_layers[1];
+    for (const auto &it : temp.m_by_name)
+        m_layers[0].m_by_name[it.first] = it.second;
+    for (const auto &it : temp.m_by_full_path)
+        m_layers[0].m_by_full_path[it.first] = it.second;
+    temp.m_by_name.clear();
+    temp.m_by_full_path.clear();
 }   // makeMaterialsPermanent
 
 // ----------------------------------------------------------------------------
 bool MaterialManager::hasMaterial(const std::string& fname)
 {
     std::string basename=StringUtils::getBasename(fname);
-
-    // Search backward so that temporary (track) textures are found first
-    for(int i = (int)m_materials.size()-1; i>=0; i-- )
-    {
-        if(m_materials[i]->getTexFname()==basename) return true;
-    }
-    return false;
+    return findMaterial(basename, /*full_path*/false) != NULL;
 }
@@ -22,6 +22,8 @@
 
 #include "utils/no_copy.hpp"
 
+#include <path.h>
+
 namespace irr
 {
     namespace video { class ITexture;    }
@@ -30,6 +32,7 @@ namespace irr
 using namespace irr;
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class Material;
@@ -37,17 +40,47 @@ class XMLReader;
 class XMLNode;
 
 /**
+  * Materials are looked up through two layers of hash maps: the temporary
+  * layer contains the materials added since the last time all materials
+  * were made permanent (e.g. the track specific materials), and is searched
+  * before the permanent layer. In each layer the latest material with a
+  * given name wins, as with the previous backward search in m_materials.
   * \ingroup graphics
   */
 class MaterialManager : public NoCopy
 {
 private:
+    /** The materials of one layer by texture name and by full path. */
+    struct Layer
+    {
+        std::unordered_map<std::string, Material*> m_by_name;
+        std::unordered_map<std::string, Material*> m_by_full_path;
+    };   // Layer
+
+    /** The material found for a texture by getMaterialFor, and the name
+     *  of the texture at that time, since the texture might have been
+     *  deleted and its address reused since. */
+    struct TextureCacheEntry
+    {
+        Material *m_material;
+        io::path  m_name;
+    };   // TextureCacheEntry
 
     void    parseMaterialFile(const std::string& filename);
+    void    addMaterial(Material *m);
+    Material *findMaterial(const std::string &name, bool full_path) const;
     int     m_shared_material_index;
 
     std::vector<Material*> m_materials;
 
+    /** The permanent (index 0) and the temporary (index 1) layer. */
+    Layer     m_layers[2];
+
+    /** Caches the result of getMaterialFor for each texture. It is cleared
+     *  whenever a material is added or removed. */
+    std::unordered_map<const video::ITexture*, TextureCacheEntry>
+              m_texture_cache;
+
     Material* m_default_material;
 
 public:
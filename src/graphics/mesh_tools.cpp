@@ -23,8 +23,15 @@
 #include <IMeshBuffer.h>
 #include "utils/log.hpp"
 #include "graphics/irr_driver.hpp"
+#include "io/file_manager.hpp"
 #include "modes/world.hpp"
 #include "tracks/track.hpp"
+#include "utils/worker_pool.hpp"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
 
 void MeshTools::minMax3D(scene::IMesh* mesh, Vec3 *min, Vec3 *max) {
 
@@ -324,6 +331,382 @@ void recalculateTangents(scene::IMesh* mesh, bool recalculateNormals, bool smoot
     }
 }
 
+// ----------------------------------------------------------------------------
+/** Size of the vertex cache the triangles are ordered for. */
+static const int VERTEX_CACHE_SIZE = 32;
+
+/** Score of a vertex for the vertex cache optimization, from its position
+ *  in the simulated cache (-1 if not in it) and the number of triangles
+ *  still to be emitted that use it. See Tom Forsyth, "Linear-Speed Vertex
+ *  Cache Optimisation".
+ */
+static float getVertexCacheScore(int cache_position, unsigned remaining)
+{
+    if (remaining == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cache_position >= 0)
+    {
+        // The vertices of the last triangle get a fixed score, so that
+        // the next triangle does not just reuse one of its edges
+        if (cache_position < 3)
+            score = 0.75f;
+        else
+            score = powf(1.0f - (cache_position - 3) /
+                                float(VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+    // Vertices with few triangles left get a boost, so that they are
+    // finished and don't stay around
+    return score + 2.0f / sqrtf((float)remaining);
+}   // getVertexCacheScore
+
+// ----------------------------------------------------------------------------
+/** Reorders the triangles of a buffer for the post transform vertex cache of
+ *  the GPU, and then the vertices in the order they are first used, which
+ *  also makes the vertex fetches more linear.
+ */
+static void optimizeVertexCache(scene::SMeshBufferTangents *buffer)
+{
+    core::array<u16> &indices = buffer->Indices;
+    const u32 triangle_count = indices.size() / 3;
+    const u32 vertex_count = buffer->Vertices.size();
+    if (triangle_count == 0)
+        return;
+
+    // Triangles using each vertex, the first remaining[v] entries starting
+    // at first_triangle[v] are the triangles not yet emitted
+    std::vector<unsigned> remaining(vertex_count, 0);
+    for (u32 i = 0; i < 3 * triangle_count; i++)
+        remaining[indices[i]]++;
+    std::vector<unsigned> first_triangle(vertex_count + 1, 0);
+    for (u32 v = 0; v < vertex_count; v++)
+        first_triangle[v + 1] = first_triangle[v] + remaining[v];
+    std::vector<unsigned> triangles(3 * triangle_count);
+    std::vector<unsigned> fill(first_triangle.begin(),
+                               first_triangle.end() - 1);
+    for (u32 i = 0; i < 3 * triangle_count; i++)
+        triangles[fill[indices[i]]++] = i / 3;
+
+    std::vector<int>   cache_position(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count);
+    for (u32 v = 0; v < vertex_count; v++)
+        vertex_score[v] = getVertexCacheScore(-1, remaining[v]);
+    std::vector<bool>  emitted(triangle_count, false);
+
+    int best = -1;
+    float best_score = -1.0f;
+    for (u32 t = 0; t < triangle_count; t++)
+    {
+        const float score = vertex_score[indices[3 * t]] +
+                            vertex_score[indices[3 * t + 1]] +
+                            vertex_score[indices[3 * t + 2]];
+        if (score > best_score)
+        {
+            best_score = score;
+            best = t;
+        }
+    }
+
+    std::vector<u16> output;
+    output.reserve(3 * triangle_count);
+    std::vector<u16> cache, new_cache;
+    u32 next_unemitted = 0;
+    for (u32 n = 0; n < triangle_count; n++)
+    {
+        if (best < 0)
+        {
+            // No triangle uses a vertex in the cache, continue anywhere
+            while (emitted[next_unemitted])
+                next_unemitted++;
+            best = next_unemitted;
+        }
+        const u32 t = best;
+        emitted[t] = true;
+
+        new_cache.clear();
+        for (u32 k = 0; k < 3; k++)
+        {
+            const u16 v = indices[3 * t + k];
+            output.push_back(v);
+            unsigned *list = &triangles[first_triangle[v]];
+            for (unsigned j = 0; j < remaining[v]; j++)
+            {
+                if (list[j] == t)
+                {
+                    list[j] = list[remaining[v] - 1];
+                    break;
+                }
+            }
+            remaining[v]--;
+            if (std::find(new_cache.begin(), new_cache.end(), v) ==
+                new_cache.end())
+                new_cache.push_back(v);
+        }
+        for (unsigned i = 0; i < cache.size(); i++)
+        {
+            if (std::find(new_cache.begin(), new_cache.end(), cache[i]) ==
+                new_cache.end())
+                new_cache.push_back(cache[i]);
+        }
+
+        // Update the vertices in the cache and the ones that were pushed
+        // out, then find the best triangle using any of them
+        for (unsigned i = 0; i < new_cache.size(); i++)
+        {
+            const u16 v = new_cache[i];
+            cache_position[v] = i < (unsigned)VERTEX_CACHE_SIZE ? i : -1;
+            vertex_score[v] = getVertexCacheScore(cache_position[v],
+                                                  remaining[v]);
+        }
+        best = -1;
+        best_score = -1.0f;
+        for (unsigned i = 0; i < new_cache.size() &&
+                             i < (unsigned)VERTEX_CACHE_SIZE; i++)
+        {
+            const u16 v = new_cache[i];
+            for (unsigned j = 0; j < remaining[v]; j++)
+            {
+                const unsigned tri = triangles[first_triangle[v] + j];
+                const float score = vertex_score[indices[3 * tri]] +
+                                    vertex_score[indices[3 * tri + 1]] +
+                                    vertex_score[indices[3 * tri + 2]];
+                if (score > best_score)
+                {
+                    best_score = score;
+                    best = tri;
+                }
+            }
+        }
+        if (new_cache.size() > (unsigned)VERTEX_CACHE_SIZE)
+            new_cache.resize(VERTEX_CACHE_SIZE);
+        cache.swap(new_cache);
+    }
+
+    std::vector<int> remap(vertex_count, -1);
+    core::array<video::S3DVertexTangents> vertices;
+    vertices.reallocate(vertex_count);
+    for (u32 i = 0; i < output.size(); i++)
+    {
+        const u16 v = output[i];
+        if (remap[v] < 0)
+        {
+            remap[v] = vertices.size();
+            vertices.push_back(buffer->Vertices[v]);
+        }
+        indices[i] = remap[v];
+    }
+    buffer->Vertices = vertices;
+}   // optimizeVertexCache
+
+// ----------------------------------------------------------------------------
+/** Version of the cached mesh files, must be increased whenever the
+ *  processing in createMeshWithTangents changes. */
+static const u32 MESH_CACHE_VERSION = 1;
+
+/** Returns a hash of the data of a mesh and of the processing options, which
+ *  identifies its processed version in the cache.
+ */
+static u64 getMeshHash(scene::IMesh* mesh,
+                       bool(*predicate)(scene::IMeshBuffer*),
+                       bool recalculateNormals, bool smooth,
+                       bool angleWeighted, bool calculateTangents)
+{
+    // 64 bit FNV-1a
+    u64 hash = 14695981039346656037ULL;
+    struct Hasher
+    {
+        static void add(u64 *hash, const void *data, size_t size)
+        {
+            const unsigned char *c = (const unsigned char*)data;
+            for (size_t i = 0; i < size; i++)
+            {
+                *hash ^= c[i];
+                *hash *= 1099511628211ULL;
+            }
+        }
+    };
+    const u32 flags = MESH_CACHE_VERSION << 4 | (recalculateNormals ? 1 : 0) |
+                      (smooth ? 2 : 0) | (angleWeighted ? 4 : 0) |
+                      (calculateTangents ? 8 : 0);
+    Hasher::add(&hash, &flags, sizeof(flags));
+    for (u32 b = 0; b < mesh->getMeshBufferCount(); b++)
+    {
+        scene::IMeshBuffer* mb = mesh->getMeshBuffer(b);
+        const u32 header[4] = { predicate(mb) ? 1u : 0u,
+                                (u32)mb->getVertexType(),
+                                mb->getVertexCount(), mb->getIndexCount() };
+        Hasher::add(&hash, header, sizeof(header));
+        Hasher::add(&hash, mb->getVertices(), mb->getVertexCount() *
+                    video::getVertexPitchFromType(mb->getVertexType()));
+        Hasher::add(&hash, mb->getIndices(), mb->getIndexCount() *
+                    (mb->getIndexType() == video::EIT_16BIT ? 2 : 4));
+    }
+    return hash;
+}   // getMeshHash
+
+// ----------------------------------------------------------------------------
+/** Reads the processed buffers of a mesh from the cache. The file contains
+ *  the magic, version and hash of the mesh, the number of buffers, and for
+ *  each buffer its vertex and index count followed by its vertices and
+ *  indices.
+ *  \return True if all buffers were read.
+ */
+static bool loadCachedMesh(const std::string &filename, u64 hash,
+                        const std::vector<scene::SMeshBufferTangents*> &buffers)
+{
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return false;
+    char magic[4];
+    u32 version = 0, count = 0;
+    u64 file_hash = 0;
+    bool ok = fread(magic, 4, 1, f) == 1 && memcmp(magic, "STKM", 4) == 0 &&
+              fread(&version, sizeof(version), 1, f) == 1 &&
+              version == MESH_CACHE_VERSION &&
+              fread(&file_hash, sizeof(file_hash), 1, f) == 1 &&
+              file_hash == hash &&
+              fread(&count, sizeof(count), 1, f) == 1 &&
+              count == buffers.size();
+    for (u32 i = 0; ok && i < count; i++)
+    {
+        u32 sizes[2];
+        ok = fread(sizes, sizeof(sizes), 1, f) == 1 &&
+             sizes[0] > 0 && sizes[0] <= 65536 && sizes[1] > 0;
+        if (!ok)
+            break;
+        buffers[i]->Vertices.set_used(sizes[0]);
+        buffers[i]->Indices.set_used(sizes[1]);
+        ok = fread(buffers[i]->Vertices.pointer(),
+                   sizeof(video::S3DVertexTangents), sizes[0], f) == sizes[0]
+          && fread(buffers[i]->Indices.pointer(), sizeof(u16), sizes[1], f)
+                                                                 == sizes[1];
+    }
+    fclose(f);
+    if (!ok)
+    {
+        Log::warn("MeshTools", "Ignoring invalid cached mesh '%s'.",
+                  filename.c_str());
+    }
+    return ok;
+}   // loadCachedMesh
+
+// ----------------------------------------------------------------------------
+/** Saves the processed buffers of a mesh in the cache, see loadCachedMesh.
+ *  The data is first written to a temporary file, so an interrupted write
+ *  never leaves a truncated cache file.
+ */
+static void saveCachedMesh(const std::string &filename, u64 hash,
+                        const std::vector<scene::SMeshBufferTangents*> &buffers)
+{
+    std::string tmp = filename + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+    {
+        Log::warn("MeshTools", "Can't write cached mesh '%s'.", tmp.c_str());
+        return;
+    }
+    const u32 version = MESH_CACHE_VERSION;
+    const u32 count = (u32)buffers.size();
+    bool ok = fwrite("STKM", 4, 1, f) == 1 &&
+              fwrite(&version, sizeof(version), 1, f) == 1 &&
+              fwrite(&hash, sizeof(hash), 1, f) == 1 &&
+              fwrite(&count, sizeof(count), 1, f) == 1;
+    for (u32 i = 0; ok && i < count; i++)
+    {
+        const u32 sizes[2] = { buffers[i]->Vertices.size(),
+                               buffers[i]->Indices.size() };
+        ok = fwrite(sizes, sizeof(sizes), 1, f) == 1 &&
+             fwrite(buffers[i]->Vertices.const_pointer(),
+                    sizeof(video::S3DVertexTangents), sizes[0], f) == sizes[0]
+          && fwrite(buffers[i]->Indices.const_pointer(), sizeof(u16),
+                    sizes[1], f) == sizes[1];
+    }
+    ok = fclose(f) == 0 && ok;
+    remove(filename.c_str());
+    if (!ok || rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+        Log::warn("MeshTools", "Can't write cached mesh '%s'.",
+                  filename.c_str());
+        remove(tmp.c_str());
+    }
+}   // saveCachedMesh
+
+// ----------------------------------------------------------------------------
+/** Fills a buffer with the vertices of a buffer converted to tangent
+ *  vertices, merging identical vertices, and computes the tangents.
+ */
+static void createBufferWithTangents(scene::IMeshBuffer* original,
+                                     scene::SMeshBufferTangents* buffer,
+                                     bool recalculateNormals, bool smooth,
+                                     bool angleWeighted,
+                                     bool calculateTangents)
+{
+    const u32 idxCnt = original->getIndexCount();
+    const u16* idx = original->getIndices();
+
+    // The buffer may contain data from an invalid cache file
+    buffer->Vertices.set_used(0);
+    buffer->Indices.set_used(0);
+    buffer->Vertices.reallocate(idxCnt);
+    buffer->Indices.reallocate(idxCnt);
+
+    core::map<video::S3DVertexTangents, int> vertMap;
+    int vertLocation;
+
+    // copy vertices
+
+    const video::E_VERTEX_TYPE vType = original->getVertexType();
+    video::S3DVertexTangents vNew;
+    for (u32 i = 0; i<idxCnt; ++i)
+    {
+        switch (vType)
+        {
+            case video::EVT_STANDARD:
+            {
+                const video::S3DVertex* v =
+                    (const video::S3DVertex*)original->getVertices();
+                vNew = video::S3DVertexTangents(
+                    v[idx[i]].Pos, v[idx[i]].Normal, v[idx[i]].Color, v[idx[i]].TCoords);
+            }
+            break;
+            case video::EVT_2TCOORDS:
+            {
+                const video::S3DVertex2TCoords* v =
+                    (const video::S3DVertex2TCoords*)original->getVertices();
+                vNew = video::S3DVertexTangents(
+                    v[idx[i]].Pos, v[idx[i]].Normal, v[idx[i]].Color, v[idx[i]].TCoords);
+            }
+            break;
+            case video::EVT_TANGENTS:
+            {
+                    const video::S3DVertexTangents* v =
+                        (const video::S3DVertexTangents*)original->getVertices();
+                    vNew = v[idx[i]];
+            }
+            break;
+        }
+        core::map<video::S3DVertexTangents, int>::Node* n = vertMap.find(vNew);
+        if (n)
+        {
+            vertLocation = n->getValue();
+        }
+        else
+        {
+            vertLocation = buffer->Vertices.size();
+            buffer->Vertices.push_back(vNew);
+            vertMap.insert(vNew, vertLocation);
+        }
+
+        // create new indices
+        buffer->Indices.push_back(vertLocation);
+    }
+
+    if (calculateTangents)
+        recalculateTangents(buffer, recalculateNormals, smooth, angleWeighted);
+    optimizeVertexCache(buffer);
+}   // createBufferWithTangents
+
+// ----------------------------------------------------------------------------
 bool MeshTools::isNormalMap(scene::IMeshBuffer* mb)
 {
     if (!CVS->isGLSL())
@@ -360,12 +743,12 @@ scene::IMesh* MeshTools::createMeshWithTangents(scene::IMesh* mesh, bool(*predic
         return mesh;
     }
 
+    // Create the new buffers first, so that they can be filled in parallel
+    std::vector<scene::SMeshBufferTangents*> buffers;
+    std::vector<scene::IMeshBuffer*> originals;
     for (u32 b = 0; b<meshBufferCount; ++b)
     {
         scene::IMeshBuffer* original = mesh->getMeshBuffer(b);
-        const u32 idxCnt = original->getIndexCount();
-        const u16* idx = original->getIndices();
-
         if (!predicate(original))
         {
             clone->addMeshBuffer(original);
@@ -373,72 +756,43 @@ scene::IMesh* MeshTools::createMeshWithTangents(scene::IMesh* mesh, bool(*predic
         }
 
         scene::SMeshBufferTangents* buffer = new scene::SMeshBufferTangents();
-
         buffer->Material = original->getMaterial();
-        buffer->Vertices.reallocate(idxCnt);
-        buffer->Indices.reallocate(idxCnt);
-
-        core::map<video::S3DVertexTangents, int> vertMap;
-        int vertLocation;
-
-        // copy vertices
+        clone->addMeshBuffer(buffer);
+        buffer->drop();
+        buffers.push_back(buffer);
+        originals.push_back(original);
+    }
 
-        const video::E_VERTEX_TYPE vType = original->getVertexType();
-        video::S3DVertexTangents vNew;
-        for (u32 i = 0; i<idxCnt; ++i)
+    // The processed buffers are cached, keyed by the hash of the mesh data
+    const u64 hash = getMeshHash(mesh, predicate, recalculateNormals, smooth,
+                                 angleWeighted, calculateTangents);
+    char hash_name[32];
+    sprintf(hash_name, "%016llx.mesh", (unsigned long long)hash);
+    const std::string cache_file = file_manager->getCachedMeshesDir() +
+                                   hash_name;
+    if (!loadCachedMesh(cache_file, hash, buffers))
+    {
+        WorkerPool::Job job = [&](unsigned int first, unsigned int last)
         {
-            switch (vType)
+            for (unsigned int i = first; i < last; i++)
             {
-                case video::EVT_STANDARD:
-                {
-                    const video::S3DVertex* v =
-                        (const video::S3DVertex*)original->getVertices();
-                    vNew = video::S3DVertexTangents(
-                        v[idx[i]].Pos, v[idx[i]].Normal, v[idx[i]].Color, v[idx[i]].TCoords);
-                }
-                break;
-                case video::EVT_2TCOORDS:
-                {
-                    const video::S3DVertex2TCoords* v =
-                        (const video::S3DVertex2TCoords*)original->getVertices();
-                    vNew = video::S3DVertexTangents(
-                        v[idx[i]].Pos, v[idx[i]].Normal, v[idx[i]].Color, v[idx[i]].TCoords);
-                }
-                break;
-                case video::EVT_TANGENTS:
-                {
-                        const video::S3DVertexTangents* v =
-                            (const video::S3DVertexTangents*)original->getVertices();
-                        vNew = v[idx[i]];
-                }
-                break;
-            }
-            core::map<video::S3DVertexTangents, int>::Node* n = vertMap.find(vNew);
-            if (n)
-            {
-                vertLocation = n->getValue();
+                createBufferWithTangents(originals[i], buffers[i],
+                                         recalculateNormals, smooth,
+                                         angleWeighted, calculateTangents);
             }
-            else
-            {
-                vertLocation = buffer->Vertices.size();
-                buffer->Vertices.push_back(vNew);
-                vertMap.insert(vNew, vertLocation);
-            }
-
-            // create new indices
-            buffer->Indices.push_back(vertLocation);
-        }
-        buffer->recalculateBoundingBox();
-
-        // add new buffer
-        clone->addMeshBuffer(buffer);
-        buffer->drop();
+        };
+        if (WorkerPool::exists())
+            WorkerPool::get()->parallelFor((unsigned int)buffers.size(), 1,
+                                           job);
+        else
+            job(0, (unsigned int)buffers.size());
+        saveCachedMesh(cache_file, hash, buffers);
     }
+    for (unsigned int i = 0; i < buffers.size(); i++)
+        buffers[i]->recalculateBoundingBox();
 
     clone->recalculateBoundingBox();
-    if (calculateTangents)
-        recalculateTangents(clone, recalculateNormals, smooth, angleWeighted);
-    
+
     int mbcount = clone->getMeshBufferCount();
     for (int i = 0; i < mbcount; i++)
     {
@@ -18,9 +18,11 @@
 
 #include "graphics/particle_emitter.hpp"
 #include "graphics/central_settings.hpp"
+#include "graphics/cpu_particles.hpp"
 #include "graphics/material.hpp"
 #include "graphics/material_manager.hpp"
 #include "graphics/particle_kind.hpp"
+#include "graphics/particle_lod_manager.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/shaders.hpp"
 #include "graphics/wind.hpp"
@@ -100,84 +102,6 @@ public:
 };   // FadeAwayAffector
 
 
-// ============================================================================
-
-class HeightMapCollisionAffector : public scene::IParticleAffector
-{
-    std::vector< std::vector<float> > m_height_map;
-    Track* m_track;
-    bool m_first_time;
-
-public:
-    HeightMapCollisionAffector(Track* t) : m_height_map(t->buildHeightMap())
-    {
-        m_track = t;
-        m_first_time = true;
-    }
-
-    virtual void affect(u32 now, scene::SParticle* particlearray, u32 count)
-    {
-        const Vec3* aabb_min;
-        const Vec3* aabb_max;
-        m_track->getAABB(&aabb_min, &aabb_max);
-        float track_x = aabb_min->getX();
-        float track_z = aabb_min->getZ();
-        const float track_x_len = aabb_max->getX() - aabb_min->getX();
-        const float track_z_len = aabb_max->getZ() - aabb_min->getZ();
-
-        for (unsigned int n=0; n<count; n++)
-        {
-            scene::SParticle& curr = particlearray[n];
-            const int i = (int)( (curr.pos.X - track_x)
-                                 /track_x_len*(HEIGHT_MAP_RESOLUTION) );
-            const int j = (int)( (curr.pos.Z - track_z)
-                                 /track_z_len*(HEIGHT_MAP_RESOLUTION) );
-            if (i >= HEIGHT_MAP_RESOLUTION || j >= HEIGHT_MAP_RESOLUTION) continue;
-            if (i < 0 || j < 0) continue;
-
-            /*
-            // debug draw
-            core::vector3df lp = curr.pos;
-            core::vector3df lp2 = curr.pos;
-            lp2.Y = m_height_map[i][j] + 0.02f;
-
-            irr_driver->getVideoDriver()->draw3DLine(lp, lp2, video::SColor(255,255,0,0));
-            core::vector3df lp3 = lp2;
-            lp3.X += 0.1f;
-            lp3.Y += 0.02f;
-            lp3.Z += 0.1f;
-            lp2.X -= 0.1f;
-            lp2.Y -= 0.02f;
-            lp2.Z -= 0.1f;
-            irr_driver->getVideoDriver()->draw3DBox(core::aabbox3d< f32 >(lp2, lp3), video::SColor(255,255,0,0));
-            */
-
-            if (m_first_time)
-            {
-                curr.pos.Y = m_height_map[i][j]
-                           + (curr.pos.Y - m_height_map[i][j])
-                                *((rand()%500)/500.0f);
-            }
-            else
-            {
-                if (curr.pos.Y < m_height_map[i][j])
-                {
-                    //curr.color = video::SColor(255,255,0,0);
-                    curr.endTime = curr.startTime; // destroy particle
-                }
-            }
-        }
-
-        if (m_first_time) m_first_time = false;
-    }
-
-    virtual scene::E_PARTICLE_AFFECTOR_TYPE getType() const
-    {
-        // FIXME: this method seems to make sense only for built-in affectors
-        return scene::EPAT_FADE_OUT;
-    }
-};
-
 // ============================================================================
 
 class WindAffector : public scene::IParticleAffector
@@ -218,71 +142,6 @@ public:
 
 };   // WindAffector
 
-// ============================================================================
-
-class ScaleAffector : public scene::IParticleAffector
-{
-public:
-    ScaleAffector(const core::vector2df& scaleFactor = core::vector2df(1.0f, 1.0f)) : ScaleFactor(scaleFactor)
-    {
-    }
-
-    virtual void affect(u32 now, scene::SParticle *particlearray, u32 count)
-    {
-        for (u32 i = 0; i<count; i++)
-        {
-            const u32 maxdiff = particlearray[i].endTime - particlearray[i].startTime;
-            const u32 curdiff = now - particlearray[i].startTime;
-            const f32 timefraction = (f32)curdiff / maxdiff;
-            core::dimension2df destsize = particlearray[i].startSize * ScaleFactor;
-            particlearray[i].size = particlearray[i].startSize + (destsize - particlearray[i].startSize) * timefraction;
-        }
-    }
-
-    virtual scene::E_PARTICLE_AFFECTOR_TYPE getType() const
-    {
-        return scene::EPAT_SCALE;
-    }
-
-protected:
-    core::vector2df ScaleFactor;
-};
-
-// ============================================================================
-
-class ColorAffector : public scene::IParticleAffector
-{
-protected:
-    core::vector3df m_color_from;
-    core::vector3df m_color_to;
-
-public:
-    ColorAffector(const core::vector3df& colorFrom, const core::vector3df& colorTo) :
-        m_color_from(colorFrom), m_color_to(colorTo)
-    {
-    }
-
-    virtual void affect(u32 now, scene::SParticle *particlearray, u32 count)
-    {
-        for (u32 i = 0; i<count; i++)
-        {
-            const u32 maxdiff = particlearray[i].endTime - particlearray[i].startTime;
-            const u32 curdiff = now - particlearray[i].startTime;
-            const f32 timefraction = (f32)curdiff / maxdiff;
-            core::vector3df curr_color = m_color_from + (m_color_to - m_color_from)* timefraction;
-            particlearray[i].color = video::SColor(255, (int)curr_color.X, (int)curr_color.Y, (int)curr_color.Z);
-        }
-    }
-
-    virtual scene::E_PARTICLE_AFFECTOR_TYPE getType() const
-    {
-        return scene::EPAT_SCALE;
-    }
-
-};
-
-
-
 // ============================================================================
 
 ParticleEmitter::ParticleEmitter(const ParticleKind* type,
@@ -302,10 +161,13 @@ ParticleEmitter::ParticleEmitter(const ParticleKind* type,
     m_is_glsl = CVS->isGLSL();
     m_randomize_initial_y = randomize_initial_y;
     m_important = important;
+    m_lod_factor = 1.0f;
+    m_paused = false;
 
 
     setParticleType(type);
     assert(m_node != NULL);
+    ParticleLODManager::getInstance()->addEmitter(this);
 
 }   // KartParticleSystem
 
@@ -315,6 +177,7 @@ ParticleEmitter::ParticleEmitter(const ParticleKind* type,
 ParticleEmitter::~ParticleEmitter()
 {
     assert(m_magic_number == 0x58781325);
+    ParticleLODManager::getInstance()->removeEmitter(this);
     if (m_node != NULL)
         irr_driver->removeNode(m_node);
     m_emitter->drop();
@@ -381,11 +244,9 @@ void ParticleEmitter::setCreationRateRelative(float fraction)
  */
 void ParticleEmitter::setCreationRateAbsolute(float f)
 {
-    m_emitter->setMinParticlesPerSecond(int(f));
-    m_emitter->setMaxParticlesPerSecond(int(f));
-
     m_min_rate = f;
     m_max_rate = f;
+    applyCreationRate();
 
 #if 0
     // FIXME: to work around irrlicht bug, when an emitter is paused by setting the rate
@@ -416,9 +277,51 @@ void ParticleEmitter::setCreationRateAbsolute(float f)
 int ParticleEmitter::getCreationRate()
 {
     if (m_node->getEmitter() == NULL) return 0;
-    return m_emitter->getMinParticlesPerSecond();
+    return int(m_min_rate);
 }
 
+//-----------------------------------------------------------------------------
+/** Sets the creation rate of the irrlicht emitter from the creation rate and
+ *  the level of detail factor.
+ */
+void ParticleEmitter::applyCreationRate()
+{
+    m_emitter->setMinParticlesPerSecond(int(m_min_rate*m_lod_factor));
+    m_emitter->setMaxParticlesPerSecond(int(m_max_rate*m_lod_factor));
+}   // applyCreationRate
+
+//-----------------------------------------------------------------------------
+/** Sets the level of detail, called by the ParticleLODManager.
+ *  \param factor Factor for the creation rate.
+ *  \param paused True if the particles are not in any view, which stops
+ *         the simulation of the CPU particle system (GPU particles that
+ *         are not in any view are not simulated anyway).
+ */
+void ParticleEmitter::setLOD(float factor, bool paused)
+{
+    if (!m_emitter)
+        return;
+    if (factor != m_lod_factor)
+    {
+        m_lod_factor = factor;
+        applyCreationRate();
+    }
+    if (paused != m_paused)
+    {
+        m_paused = paused;
+        if (!m_is_glsl)
+            static_cast<CPUParticleSystem*>(m_node)->setPaused(paused);
+    }
+}   // setLOD
+
+//-----------------------------------------------------------------------------
+/** Returns the number of live particles expected at the current creation
+ *  rate without level of detail. */
+float ParticleEmitter::getExpectedParticles() const
+{
+    return m_max_rate * m_particle_type->getMaxLifetime() / 1000.0f;
+}   // getExpectedParticles
+
 //-----------------------------------------------------------------------------
 /** Sets the position of the particle emitter.
  *  \param pos The position for the particle emitter.
@@ -454,7 +357,7 @@ void ParticleEmitter::setParticleType(const ParticleKind* type)
             if (m_is_glsl)
                 m_node = ParticleSystemProxy::addParticleNode(m_is_glsl, type->randomizeInitialY());
             else
-                m_node = irr_driver->addParticleNode();
+                m_node = CPUParticleSystem::addParticleNode();
             
             if (m_is_glsl)
             {
@@ -598,11 +501,7 @@ void ParticleEmitter::setParticleType(const ParticleKind* type)
             }
         }
     }
-    else
-    {
-        m_emitter->setMinParticlesPerSecond(int(m_min_rate));
-        m_emitter->setMaxParticlesPerSecond(int(m_max_rate));
-    }
+    applyCreationRate();
 
     m_emitter->setMinStartSize(core::dimension2df(minSize, minSize));
     m_emitter->setMaxStartSize(core::dimension2df(maxSize, maxSize));
@@ -611,26 +510,55 @@ void ParticleEmitter::setParticleType(const ParticleKind* type)
     {
         m_node->setEmitter(m_emitter); // this grabs the emitter
 
-        scene::IParticleFadeOutAffector *af = m_node->createFadeOutParticleAffector(video::SColor(0, 255, 255, 255),
-                                                                                    type->getFadeoutTime());
-        m_node->addAffector(af);
-        af->drop();
+        // Without shaders the effects are built into the particle system
+        CPUParticleSystem *cpu_node =
+            m_is_glsl ? NULL : static_cast<CPUParticleSystem*>(m_node);
+
+        if (cpu_node)
+        {
+            cpu_node->setFadeOut(video::SColor(0, 255, 255, 255),
+                                 type->getFadeoutTime());
+        }
+        else
+        {
+            scene::IParticleFadeOutAffector *af = m_node->createFadeOutParticleAffector(video::SColor(0, 255, 255, 255),
+                                                                                        type->getFadeoutTime());
+            m_node->addAffector(af);
+            af->drop();
+        }
 
         if (type->getGravityStrength() != 0)
         {
-            scene::IParticleGravityAffector *gaf = m_node->createGravityAffector(core::vector3df(00.0f, type->getGravityStrength(), 0.0f),
-                                                                                 type->getForceLostToGravityTime());
-            m_node->addAffector(gaf);
-            gaf->drop();
+            const core::vector3df gravity(0.0f, type->getGravityStrength(),
+                                          0.0f);
+            if (cpu_node)
+            {
+                cpu_node->setGravity(gravity,
+                                     type->getForceLostToGravityTime());
+            }
+            else
+            {
+                scene::IParticleGravityAffector *gaf = m_node->createGravityAffector(gravity,
+                                                                                     type->getForceLostToGravityTime());
+                m_node->addAffector(gaf);
+                gaf->drop();
+            }
         }
 
         const float fas = type->getFadeAwayStart();
         const float fae = type->getFadeAwayEnd();
         if (fas > 0.0f && fae > 0.0f)
         {
-            FadeAwayAffector* faa = new FadeAwayAffector(fas*fas, fae*fae);
-            m_node->addAffector(faa);
-            faa->drop();
+            if (cpu_node)
+            {
+                cpu_node->setFadeAway(fas*fas, fae*fae);
+            }
+            else
+            {
+                FadeAwayAffector* faa = new FadeAwayAffector(fas*fas, fae*fae);
+                m_node->addAffector(faa);
+                faa->drop();
+            }
         }
 
         if (type->hasScaleAffector())
@@ -643,9 +571,7 @@ void ParticleEmitter::setParticleType(const ParticleKind* type)
             {
                 core::vector2df factor = core::vector2df(type->getScaleAffectorFactorX(),
                     type->getScaleAffectorFactorY());
-                scene::IParticleAffector* scale_affector = new ScaleAffector(factor);
-                m_node->addAffector(scale_affector);
-                scale_affector->drop();
+                cpu_node->setScale(factor);
             }
         }
 
@@ -676,18 +602,23 @@ void ParticleEmitter::setParticleType(const ParticleKind* type)
                                                              float(color_to.getGreen()),
                                                              float(color_to.getBlue()));
 
-                ColorAffector* affector = new ColorAffector(color_from_v, color_to_v);
-                m_node->addAffector(affector);
-                affector->drop();
+                cpu_node->setColors(color_from_v, color_to_v);
             }
         }
 
         const float windspeed = type->getWindSpeed();
         if (windspeed > 0.01f)
         {
-            WindAffector *waf = new WindAffector(windspeed);
-            m_node->addAffector(waf);
-            waf->drop();
+            if (cpu_node)
+            {
+                cpu_node->setWind(windspeed);
+            }
+            else
+            {
+                WindAffector *waf = new WindAffector(windspeed);
+                m_node->addAffector(waf);
+                waf->drop();
+            }
 
             // TODO: wind affector for GLSL particles
         }
@@ -715,14 +646,13 @@ void ParticleEmitter::addHeightMapAffector(Track* t)
         float track_z = aabb_min->getZ();
         const float track_x_len = aabb_max->getX() - aabb_min->getX();
         const float track_z_len = aabb_max->getZ() - aabb_min->getZ();
-        static_cast<ParticleSystemProxy *>(m_node)->setHeightmap(t->buildHeightMap(),
-            track_x, track_z, track_x_len, track_z_len);
+        static_cast<ParticleSystemProxy *>(m_node)->setHeightmap(
+            t->getHeightMapTexture(), track_x, track_z, track_x_len,
+            track_z_len);
     }
     else
     {
-        HeightMapCollisionAffector* hmca = new HeightMapCollisionAffector(t);
-        m_node->addAffector(hmca);
-        hmca->drop();
+        static_cast<CPUParticleSystem*>(m_node)->setHeightMap(t);
     }
 }
 
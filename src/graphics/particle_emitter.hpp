@@ -76,8 +76,18 @@ private:
 
     bool m_randomize_initial_y;
 
+    /** Important emitters are not affected by the level of detail. */
     bool m_important;
 
+    /** Factor for the creation rate set by the ParticleLODManager. */
+    float m_lod_factor;
+
+    /** True if the simulation is paused since the particles are not in any
+     *  view. */
+    bool m_paused;
+
+    void         applyCreationRate();
+
 public:
 
     LEAK_CHECK()
@@ -111,6 +121,13 @@ public:
     void         addHeightMapAffector(Track* t);
 
     bool         randomizeInitialY() const { return m_randomize_initial_y; }
+
+    void         setLOD(float factor, bool paused);
+    float        getExpectedParticles() const;
+    // ------------------------------------------------------------------------
+    /** Returns true if this emitter is not affected by the level of
+     *  detail. */
+    bool         isImportant() const { return m_important; }
 };
 #endif
 
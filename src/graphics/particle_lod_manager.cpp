@@ -0,0 +1,145 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "graphics/particle_lod_manager.hpp"
+
+#include "graphics/camera.hpp"
+#include "graphics/particle_emitter.hpp"
+
+#include <ICameraSceneNode.h>
+#include <IParticleSystemSceneNode.h>
+#include <SViewFrustum.h>
+
+#include <algorithm>
+
+/** Up to this distance to a camera emitters use their full rate. */
+static const float NEAR_DISTANCE = 20.0f;
+/** From this distance on emitters use MIN_FACTOR of their rate. */
+static const float FAR_DISTANCE  = 150.0f;
+static const float MIN_FACTOR    = 0.2f;
+/** Number of live particles of all emitters that are not important. */
+static const float PARTICLE_BUDGET = 6000.0f;
+
+// ----------------------------------------------------------------------------
+void ParticleLODManager::addEmitter(ParticleEmitter *emitter)
+{
+    m_emitters.push_back(emitter);
+}   // addEmitter
+
+// ----------------------------------------------------------------------------
+void ParticleLODManager::removeEmitter(ParticleEmitter *emitter)
+{
+    std::vector<ParticleEmitter*>::iterator it =
+                 std::find(m_emitters.begin(), m_emitters.end(), emitter);
+    if (it != m_emitters.end())
+        m_emitters.erase(it);
+}   // removeEmitter
+
+// ----------------------------------------------------------------------------
+/** Returns true if a box is in the view frustum. */
+static bool isInFrustum(const scene::SViewFrustum &frustum,
+                        const core::aabbox3df &box)
+{
+    core::vector3df edges[8];
+    box.getEdges(edges);
+    for (unsigned int i = 0; i < scene::SViewFrustum::VF_PLANE_COUNT; i++)
+    {
+        bool inside = false;
+        for (unsigned int j = 0; j < 8; j++)
+        {
+            if (frustum.planes[i].classifyPointRelation(edges[j])
+                != core::ISREL3D_FRONT)
+            {
+                inside = true;
+                break;
+            }
+        }
+        if (!inside)
+            return false;
+    }
+    return true;
+}   // isInFrustum
+
+// ----------------------------------------------------------------------------
+/** Computes the level of detail of all emitters. Called once per frame
+ *  before rendering, after the cameras were updated.
+ */
+void ParticleLODManager::update()
+{
+    const unsigned int num_cameras = Camera::getNumCameras();
+    if (num_cameras == 0 || m_emitters.empty())
+        return;
+
+    m_factors.resize(m_emitters.size());
+    m_paused.resize(m_emitters.size());
+
+    float total = 0.0f;
+    for (unsigned int i = 0; i < m_emitters.size(); i++)
+    {
+        ParticleEmitter *emitter = m_emitters[i];
+        scene::IParticleSystemSceneNode *node = emitter->getNode();
+        m_factors[i] = 1.0f;
+        m_paused[i]  = false;
+        // Hidden nodes (e.g. by a LOD node) don't emit anyway
+        if (emitter->isImportant() || !node || !node->isTrulyVisible())
+            continue;
+
+        const core::vector3df pos = node->getAbsolutePosition();
+        core::aabbox3df box = node->getTransformedBoundingBox();
+        box.addInternalPoint(pos);
+
+        bool visible = false;
+        float min_distance2 = -1.0f;
+        for (unsigned int c = 0; c < num_cameras; c++)
+        {
+            scene::ICameraSceneNode *camera =
+                                    Camera::getCamera(c)->getCameraSceneNode();
+            const float d2 = (camera->getAbsolutePosition() - pos)
+                           .getLengthSQ();
+            if (min_distance2 < 0 || d2 < min_distance2)
+                min_distance2 = d2;
+            if (!visible && isInFrustum(*camera->getViewFrustum(), box))
+                visible = true;
+        }
+
+        if (!visible)
+        {
+            m_factors[i] = 0.0f;
+            m_paused[i]  = true;
+            continue;
+        }
+
+        const float distance = sqrtf(min_distance2);
+        if (distance > FAR_DISTANCE)
+            m_factors[i] = MIN_FACTOR;
+        else if (distance > NEAR_DISTANCE)
+            m_factors[i] = 1.0f - (1.0f - MIN_FACTOR)
+                         * (distance - NEAR_DISTANCE)
+                         / (FAR_DISTANCE - NEAR_DISTANCE);
+        total += m_factors[i] * emitter->getExpectedParticles();
+    }   // for i < m_emitters.size()
+
+    const float budget_factor = total > PARTICLE_BUDGET
+                              ? PARTICLE_BUDGET / total : 1.0f;
+    for (unsigned int i = 0; i < m_emitters.size(); i++)
+    {
+        if (!m_emitters[i]->isImportant() && !m_paused[i])
+            m_factors[i] *= budget_factor;
+        m_emitters[i]->setLOD(m_factors[i], m_paused[i]);
+    }
+}   // update
@@ -0,0 +1,57 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_PARTICLE_LOD_MANAGER_HPP
+#define HEADER_PARTICLE_LOD_MANAGER_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/singleton.hpp"
+
+#include <vector>
+
+class ParticleEmitter;
+
+/** Keeps the number of particles bounded. Once per frame the creation rate
+ *  of each particle emitter is scaled with its distance to the nearest
+ *  camera, emitters whose particles are not in the view of any camera stop
+ *  emitting and are paused, and if the expected number of live particles
+ *  of all emitters is above a budget all rates are scaled down to fit.
+ *  Emitters marked as important are not affected.
+ *  \ingroup graphics
+ */
+class ParticleLODManager : public Singleton<ParticleLODManager>,
+                           public NoCopy
+{
+    friend class Singleton<ParticleLODManager>;
+private:
+    std::vector<ParticleEmitter*> m_emitters;
+
+    /** Factor and paused state computed for each emitter in update. */
+    std::vector<float>            m_factors;
+    std::vector<bool>             m_paused;
+
+             ParticleLODManager() {}
+    virtual ~ParticleLODManager() {}
+
+public:
+    void     addEmitter(ParticleEmitter *emitter);
+    void     removeEmitter(ParticleEmitter *emitter);
+    void     update();
+};   // ParticleLODManager
+
+#endif
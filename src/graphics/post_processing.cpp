@@ -499,7 +499,9 @@ void PostProcessing::renderGlow(unsigned tex)
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
 
-void PostProcessing::renderSSAO()
+/** Renders the ambient occlusion into out_fbo, which can be smaller than the
+ *  screen. */
+void PostProcessing::renderSSAO(FrameBuffer &out_fbo)
 {
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_BLEND);
@@ -508,12 +510,33 @@ void PostProcessing::renderSSAO()
     irr_driver->getFBO(FBO_LINEAR_DEPTH).Bind();
     FullScreenShader::LinearizeDepthShader::getInstance()->SetTextureUnits(irr_driver->getDepthStencilTexture());
     DrawFullScreenEffect<FullScreenShader::LinearizeDepthShader>(irr_driver->getSceneManager()->getActiveCamera()->getNearValue(), irr_driver->getSceneManager()->getActiveCamera()->getFarValue());
-    irr_driver->getFBO(FBO_SSAO).Bind();
+    out_fbo.Bind();
 
     FullScreenShader::SSAOShader::getInstance()->SetTextureUnits(irr_driver->getRenderTargetTexture(RTT_LINEAR_DEPTH));
     glGenerateMipmap(GL_TEXTURE_2D);
 
+    // The shader computes the positions of the pixels from the screen size
+    const core::vector2df screen_size = irr_driver->getCurrentScreenSize();
+    const core::vector2df out_size(float(out_fbo.getWidth()), float(out_fbo.getHeight()));
+    if (out_size != screen_size)
+        irr_driver->setCurrentScreenSize(out_size);
     DrawFullScreenEffect<FullScreenShader::SSAOShader>(irr_driver->getSSAORadius(), irr_driver->getSSAOK(), irr_driver->getSSAOSigma());
+    if (out_size != screen_size)
+        irr_driver->setCurrentScreenSize(screen_size);
+}
+
+/** Upsamples the red channel of in_fbo into out_fbo, weighting the texels by
+ *  their difference of linear depth with the pixel.
+ *  \param depth_lod Mip level of the linear depth with the size of in_fbo.
+ */
+void PostProcessing::renderBilateralUpsample(FrameBuffer &in_fbo, FrameBuffer &out_fbo, float depth_lod)
+{
+    out_fbo.Bind();
+    FullScreenShader::BilateralUpsampleShader::getInstance()->SetTextureUnits(in_fbo.getRTT()[0], irr_driver->getRenderTargetTexture(RTT_LINEAR_DEPTH));
+    DrawFullScreenEffect<FullScreenShader::BilateralUpsampleShader>(
+        core::vector2df(1.0f / out_fbo.getWidth(), 1.0f / out_fbo.getHeight()),
+        core::vector2df(1.0f / in_fbo.getWidth(), 1.0f / in_fbo.getHeight()),
+        depth_lod);
 }
 
 void PostProcessing::renderMotionBlur(unsigned , FrameBuffer &in_fbo, FrameBuffer &out_fbo)
@@ -571,6 +594,22 @@ static void toneMap(FrameBuffer &fbo, GLuint rtt, float vignette_weight)
     DrawFullScreenEffect<FullScreenShader::ToneMapShader>(vignette_weight);
 }
 
+/** Adds the blurred bloom and lens flare textures to the scene and tonemaps
+ *  it in one pass, instead of blending them onto the full resolution scene
+ *  before tonemapping it. */
+static void toneMapWithBloom(FrameBuffer &fbo, GLuint rtt, float vignette_weight)
+{
+    fbo.Bind();
+    FullScreenShader::ToneMapBloomShader::getInstance()->SetTextureUnits(rtt,
+        irr_driver->getRenderTargetTexture(RTT_BLOOM_128),
+        irr_driver->getRenderTargetTexture(RTT_BLOOM_256),
+        irr_driver->getRenderTargetTexture(RTT_BLOOM_512),
+        irr_driver->getRenderTargetTexture(RTT_LENS_128),
+        irr_driver->getRenderTargetTexture(RTT_LENS_256),
+        irr_driver->getRenderTargetTexture(RTT_LENS_512));
+    DrawFullScreenEffect<FullScreenShader::ToneMapBloomShader>(vignette_weight);
+}
+
 static void renderDoF(FrameBuffer &fbo, GLuint rtt)
 {
     fbo.Bind();
@@ -580,7 +619,10 @@ static void renderDoF(FrameBuffer &fbo, GLuint rtt)
 
 void PostProcessing::applyMLAA()
 {
-    const core::vector2df &PIXEL_SIZE = core::vector2df(1.0f / UserConfigParams::m_width, 1.0f / UserConfigParams::m_height);
+    // The render targets can be smaller than the screen with the dynamic
+    // resolution
+    const FrameBuffer &mlaa_fbo = irr_driver->getFBO(FBO_MLAA_TMP);
+    const core::vector2df &PIXEL_SIZE = core::vector2df(1.0f / mlaa_fbo.getWidth(), 1.0f / mlaa_fbo.getHeight());
 
     irr_driver->getFBO(FBO_MLAA_TMP).Bind();
     glEnable(GL_STENCIL_TEST);
@@ -672,7 +714,6 @@ FrameBuffer *PostProcessing::render(scene::ICameraSceneNode * const camnode, boo
 
             // Fade to quarter
             irr_driver->getFBO(FBO_QUARTER1).Bind();
-            glViewport(0, 0, irr_driver->getActualScreenSize().Width / 4, irr_driver->getActualScreenSize().Height / 4);
             renderGodFade(out_fbo->getRTT()[0], col);
 
             // Blur
@@ -714,10 +755,11 @@ FrameBuffer *PostProcessing::render(scene::ICameraSceneNode * const camnode, boo
 
     // Simulate camera defects from there
 
+    const bool bloom = isRace && UserConfigParams::m_bloom;
     {
         PROFILER_PUSH_CPU_MARKER("- Bloom", 0xFF, 0x00, 0x00);
         ScopedGPUTimer Timer(irr_driver->getGPUTimer(Q_BLOOM));
-        if (isRace && UserConfigParams::m_bloom)
+        if (bloom)
         {
             glClear(GL_STENCIL_BUFFER_BIT);
             glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE);
@@ -745,24 +787,8 @@ FrameBuffer *PostProcessing::render(scene::ICameraSceneNode * const camnode, boo
             renderHorizontalBlur(irr_driver->getFBO(FBO_LENS_512), irr_driver->getFBO(FBO_TMP_512));
             renderHorizontalBlur(irr_driver->getFBO(FBO_LENS_256), irr_driver->getFBO(FBO_TMP_256));
             renderHorizontalBlur(irr_driver->getFBO(FBO_LENS_128), irr_driver->getFBO(FBO_TMP_128));
-            
-
-            // Additively blend on top of tmp1
-            in_fbo->Bind();
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_ONE, GL_ONE);
-            glBlendEquation(GL_FUNC_ADD);
-            
-            FullScreenShader::BloomBlendShader::getInstance()->SetTextureUnits(
-                irr_driver->getRenderTargetTexture(RTT_BLOOM_128), irr_driver->getRenderTargetTexture(RTT_BLOOM_256), irr_driver->getRenderTargetTexture(RTT_BLOOM_512));
-            DrawFullScreenEffect<FullScreenShader::BloomBlendShader>();
-
-            FullScreenShader::LensBlendShader::getInstance()->SetTextureUnits(
-                irr_driver->getRenderTargetTexture(RTT_LENS_128), irr_driver->getRenderTargetTexture(RTT_LENS_256), irr_driver->getRenderTargetTexture(RTT_LENS_512));
-            DrawFullScreenEffect<FullScreenShader::LensBlendShader>();
 
-
-            glDisable(GL_BLEND);
+            // The blurred textures are added to the scene by the tonemap
             glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
         } // end if bloom
         PROFILER_POP_CPU_MARKER();
@@ -773,14 +799,11 @@ FrameBuffer *PostProcessing::render(scene::ICameraSceneNode * const camnode, boo
         PROFILER_PUSH_CPU_MARKER("- Tonemap", 0xFF, 0x00, 0x00);
         ScopedGPUTimer Timer(irr_driver->getGPUTimer(Q_TONEMAP));
 		// only enable vignette during race
-		if(isRace)
-		{
-			toneMap(*out_fbo, in_fbo->getRTT()[0], 1.0);
-		}
+		const float vignette_weight = isRace ? 1.0f : 0.0f;
+		if (bloom)
+			toneMapWithBloom(*out_fbo, in_fbo->getRTT()[0], vignette_weight);
 		else
-		{
-			toneMap(*out_fbo, in_fbo->getRTT()[0], 0.0);
-		}
+			toneMap(*out_fbo, in_fbo->getRTT()[0], vignette_weight);
         std::swap(in_fbo, out_fbo);
         PROFILER_POP_CPU_MARKER();
     }
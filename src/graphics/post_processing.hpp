@@ -76,7 +76,7 @@ public:
     /** Generate diffuse and specular map */
     void         renderSunlight(const core::vector3df &direction, const video::SColorf &col);
 
-    void renderSSAO();
+    void renderSSAO(FrameBuffer &out_fbo);
     void renderEnvMap(const float *bSHCoeff, const float *gSHCoeff, const float *rSHCoeff, unsigned skycubemap);
     void renderRHDebug(unsigned SHR, unsigned SHG, unsigned SHB, const core::matrix4 &rh_matrix, const core::vector3df &rh_extend);
     void renderGI(const core::matrix4 &RHMatrix, const core::vector3df &rh_extend, unsigned shr, unsigned shg, unsigned shb);
@@ -89,6 +89,7 @@ public:
 
     void renderGaussian6BlurLayer(FrameBuffer &in_fbo, size_t layer, float sigmaH, float sigmaV);
     void renderGaussian17TapBlur(FrameBuffer &in_fbo, FrameBuffer &auxiliary);
+    void renderBilateralUpsample(FrameBuffer &in_fbo, FrameBuffer &out_fbo, float depth_lod);
 
     /** Render tex. Used for blit/texture resize */
     void renderPassThrough(unsigned tex, unsigned width, unsigned height);
@@ -0,0 +1,449 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/precooked_mesh.hpp"
+
+#include "graphics/irr_driver.hpp"
+#include "io/file_manager.hpp"
+#include "utils/log.hpp"
+
+#include <IAnimatedMesh.h>
+#include <ISkinnedMesh.h>
+#include <SAnimatedMesh.h>
+#include <SMesh.h>
+#include <SMeshBuffer.h>
+#include <SMeshBufferLightMap.h>
+#include <SMeshBufferTangents.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <vector>
+
+/** Version of the precooked files, must be increased whenever the format
+ *  changes. */
+static const u32 PRECOOKED_MESH_VERSION = 1;
+
+namespace
+{
+    /** Header of a precooked file. */
+    struct FileHeader
+    {
+        char m_magic[4];
+        u32  m_version;
+        /** Size and modification time of the source file. */
+        u64  m_source_size;
+        u64  m_source_mtime;
+        u32  m_buffer_count;
+        f32  m_box[6];
+    };   // FileHeader
+
+    /** Header of each mesh buffer, followed by the names of its textures,
+     *  its vertices and its indices. */
+    struct BufferHeader
+    {
+        u32  m_vertex_type;
+        u32  m_vertex_count;
+        u32  m_index_count;
+        f32  m_box[6];
+        /** Material without the textures. */
+        u32  m_material_type;
+        u32  m_colors[4];
+        f32  m_params[5];
+        u8   m_bytes[8];
+        u32  m_flags;
+        /** Length of the name of each texture, 0 if unused. */
+        u32  m_texture_name_length[video::MATERIAL_MAX_TEXTURES];
+        u8   m_texture_wrap[video::MATERIAL_MAX_TEXTURES];
+        u8   m_texture_filter[video::MATERIAL_MAX_TEXTURES];
+        u8   m_has_texture_matrix[video::MATERIAL_MAX_TEXTURES];
+    };   // BufferHeader
+
+    /** The boolean material flags stored in BufferHeader::m_flags. */
+    const video::E_MATERIAL_FLAG g_material_flags[] =
+    {
+        video::EMF_WIREFRAME, video::EMF_POINTCLOUD,
+        video::EMF_GOURAUD_SHADING, video::EMF_LIGHTING,
+        video::EMF_ZWRITE_ENABLE, video::EMF_BACK_FACE_CULLING,
+        video::EMF_FRONT_FACE_CULLING, video::EMF_FOG_ENABLE,
+        video::EMF_NORMALIZE_NORMALS, video::EMF_USE_MIP_MAPS
+    };
+}
+
+//-----------------------------------------------------------------------------
+/** Returns the name of the precooked file of a mesh file. */
+static std::string getPrecookedName(const std::string &filename)
+{
+    // 64 bit FNV-1a of the full path, meshes of different tracks often
+    // have the same name
+    u64 hash = 14695981039346656037ULL;
+    for (unsigned i = 0; i < filename.size(); i++)
+    {
+        hash ^= (unsigned char)filename[i];
+        hash *= 1099511628211ULL;
+    }
+    char name[32];
+    sprintf(name, "%016llx.spm", (unsigned long long)hash);
+    return file_manager->getCachedMeshesDir() + name;
+}   // getPrecookedName
+
+//-----------------------------------------------------------------------------
+/** Gets the size and modification time of the source file of a mesh.
+ *  \return False if the file doesn't exist.
+ */
+static bool getSourceStamp(const std::string &filename, u64 *size, u64 *mtime)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+        return false;
+    *size  = (u64)st.st_size;
+    *mtime = (u64)st.st_mtime;
+    return true;
+}   // getSourceStamp
+
+//-----------------------------------------------------------------------------
+static void storeBox(const core::aabbox3df &box, f32 *out)
+{
+    out[0] = box.MinEdge.X; out[1] = box.MinEdge.Y; out[2] = box.MinEdge.Z;
+    out[3] = box.MaxEdge.X; out[4] = box.MaxEdge.Y; out[5] = box.MaxEdge.Z;
+}   // storeBox
+
+//-----------------------------------------------------------------------------
+static core::aabbox3df loadBox(const f32 *in)
+{
+    return core::aabbox3df(in[0], in[1], in[2], in[3], in[4], in[5]);
+}   // loadBox
+
+//-----------------------------------------------------------------------------
+/** Creates an empty mesh buffer for a vertex type.
+ *  \return The buffer, or NULL if the type is unknown.
+ */
+static scene::IMeshBuffer *createBuffer(u32 vertex_type, u32 vertex_count,
+                                        u32 index_count, void **vertices,
+                                        u16 **indices)
+{
+    switch (vertex_type)
+    {
+    case video::EVT_STANDARD:
+    {
+        scene::SMeshBuffer *mb = new scene::SMeshBuffer();
+        mb->Vertices.set_used(vertex_count);
+        mb->Indices.set_used(index_count);
+        *vertices = mb->Vertices.pointer();
+        *indices  = mb->Indices.pointer();
+        return mb;
+    }
+    case video::EVT_2TCOORDS:
+    {
+        scene::SMeshBufferLightMap *mb = new scene::SMeshBufferLightMap();
+        mb->Vertices.set_used(vertex_count);
+        mb->Indices.set_used(index_count);
+        *vertices = mb->Vertices.pointer();
+        *indices  = mb->Indices.pointer();
+        return mb;
+    }
+    case video::EVT_TANGENTS:
+    {
+        scene::SMeshBufferTangents *mb = new scene::SMeshBufferTangents();
+        mb->Vertices.set_used(vertex_count);
+        mb->Indices.set_used(index_count);
+        *vertices = mb->Vertices.pointer();
+        *indices  = mb->Indices.pointer();
+        return mb;
+    }
+    default:
+        return NULL;
+    }
+}   // createBuffer
+
+//-----------------------------------------------------------------------------
+/** Loads the precooked version of a static mesh.
+ *  \param filename Name of the source file of the mesh.
+ *  \return The mesh (which must be dropped by the caller), or NULL if there
+ *          is no precooked version or it is outdated.
+ */
+scene::IAnimatedMesh *loadPrecookedMesh(const std::string &filename)
+{
+    u64 source_size, source_mtime;
+    if (!getSourceStamp(filename, &source_size, &source_mtime))
+        return NULL;
+
+    const std::string name = getPrecookedName(filename);
+    FILE *f = fopen(name.c_str(), "rb");
+    if (!f)
+        return NULL;
+    std::vector<char> data;
+    if (fseek(f, 0, SEEK_END) == 0)
+    {
+        long size = ftell(f);
+        if (size > 0 && fseek(f, 0, SEEK_SET) == 0)
+        {
+            data.resize(size);
+            if (fread(&data[0], 1, size, f) != (size_t)size)
+                data.clear();
+        }
+    }
+    fclose(f);
+
+    // Reads size bytes from the file data, returns NULL past its end
+    size_t offset = 0;
+    auto read = [&](size_t size) -> const char*
+    {
+        if (size > data.size() - offset)
+            return NULL;
+        const char *p = &data[offset];
+        offset += size;
+        return p;
+    };
+
+    FileHeader header;
+    const char *p = data.empty() ? NULL : read(sizeof(header));
+    if (!p)
+        return NULL;
+    memcpy(&header, p, sizeof(header));
+    if (memcmp(header.m_magic, "STKP", 4) != 0 ||
+        header.m_version != PRECOOKED_MESH_VERSION ||
+        header.m_source_size != source_size ||
+        header.m_source_mtime != source_mtime)
+        return NULL;
+
+    video::IVideoDriver *driver = irr_driver->getVideoDriver();
+    scene::SMesh *mesh = new scene::SMesh();
+    bool ok = true;
+    for (u32 b = 0; ok && b < header.m_buffer_count; b++)
+    {
+        BufferHeader bh;
+        p = read(sizeof(bh));
+        if (!p)
+        {
+            ok = false;
+            break;
+        }
+        memcpy(&bh, p, sizeof(bh));
+
+        void *vertices;
+        u16 *indices;
+        scene::IMeshBuffer *mb = createBuffer(bh.m_vertex_type,
+                                              bh.m_vertex_count,
+                                              bh.m_index_count, &vertices,
+                                              &indices);
+        if (!mb)
+        {
+            ok = false;
+            break;
+        }
+
+        video::SMaterial &m = mb->getMaterial();
+        m.MaterialType       = (video::E_MATERIAL_TYPE)bh.m_material_type;
+        m.AmbientColor       = video::SColor(bh.m_colors[0]);
+        m.DiffuseColor       = video::SColor(bh.m_colors[1]);
+        m.EmissiveColor      = video::SColor(bh.m_colors[2]);
+        m.SpecularColor      = video::SColor(bh.m_colors[3]);
+        m.Shininess          = bh.m_params[0];
+        m.MaterialTypeParam  = bh.m_params[1];
+        m.MaterialTypeParam2 = bh.m_params[2];
+        m.Thickness          = bh.m_params[3];
+        m.ZBuffer            = bh.m_bytes[0];
+        m.AntiAliasing       = bh.m_bytes[1];
+        m.ColorMask          = bh.m_bytes[2];
+        m.ColorMaterial      = bh.m_bytes[3];
+        m.BlendOperation     = (video::E_BLEND_OPERATION)bh.m_bytes[4];
+        m.PolygonOffsetFactor    = bh.m_bytes[5];
+        m.PolygonOffsetDirection = (video::E_POLYGON_OFFSET)bh.m_bytes[6];
+        for (unsigned i = 0; i < sizeof(g_material_flags) /
+                                 sizeof(g_material_flags[0]); i++)
+            m.setFlag(g_material_flags[i], (bh.m_flags & (1 << i)) != 0);
+
+        for (u32 t = 0; ok && t < video::MATERIAL_MAX_TEXTURES; t++)
+        {
+            video::SMaterialLayer &layer = m.TextureLayer[t];
+            layer.TextureWrapU     = bh.m_texture_wrap[t] & 0x0f;
+            layer.TextureWrapV     = bh.m_texture_wrap[t] >> 4;
+            layer.BilinearFilter   = (bh.m_texture_filter[t] & 1) != 0;
+            layer.TrilinearFilter  = (bh.m_texture_filter[t] & 2) != 0;
+            if (bh.m_texture_name_length[t] > 0)
+            {
+                p = read(bh.m_texture_name_length[t]);
+                ok = p != NULL;
+                if (ok)
+                {
+                    layer.Texture = driver->getTexture(io::path(
+                        std::string(p, bh.m_texture_name_length[t]).c_str()));
+                }
+            }
+            if (ok && bh.m_has_texture_matrix[t])
+            {
+                p = read(16 * sizeof(f32));
+                ok = p != NULL;
+                if (ok)
+                {
+                    core::matrix4 matrix;
+                    memcpy(matrix.pointer(), p, 16 * sizeof(f32));
+                    layer.setTextureMatrix(matrix);
+                }
+            }
+        }
+
+        const size_t vertex_size = bh.m_vertex_count *
+            video::getVertexPitchFromType((video::E_VERTEX_TYPE)bh.m_vertex_type);
+        const size_t index_size = bh.m_index_count * sizeof(u16);
+        const char *vertex_data = ok ? read(vertex_size) : NULL;
+        const char *index_data  = vertex_data ? read(index_size) : NULL;
+        ok = index_data != NULL;
+        if (ok)
+        {
+            memcpy(vertices, vertex_data, vertex_size);
+            memcpy(indices, index_data, index_size);
+            mb->setBoundingBox(loadBox(bh.m_box));
+            mesh->addMeshBuffer(mb);
+        }
+        mb->drop();
+    }
+
+    if (!ok || offset != data.size())
+    {
+        Log::warn("PrecookedMesh", "Ignoring invalid precooked mesh '%s'.",
+                  name.c_str());
+        mesh->drop();
+        return NULL;
+    }
+    mesh->setBoundingBox(loadBox(header.m_box));
+
+    scene::SAnimatedMesh *animated_mesh = new scene::SAnimatedMesh(mesh);
+    mesh->drop();
+    return animated_mesh;
+}   // loadPrecookedMesh
+
+//-----------------------------------------------------------------------------
+/** Writes the precooked version of a mesh, unless it is animated. The data
+ *  is first written to a temporary file, so an interrupted write never
+ *  leaves a truncated file.
+ *  \param filename Name of the source file of the mesh.
+ *  \param mesh The mesh loaded from this file.
+ */
+void savePrecookedMesh(const std::string &filename,
+                       scene::IAnimatedMesh *mesh)
+{
+    if (mesh->getMeshType() == scene::EAMT_SKINNED &&
+        ((scene::ISkinnedMesh*)mesh)->getJointCount() > 0)
+        return;
+    scene::IMesh *m = mesh->getMesh(0);
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_magic, "STKP", 4);
+    header.m_version = PRECOOKED_MESH_VERSION;
+    if (!m ||
+        !getSourceStamp(filename, &header.m_source_size,
+                        &header.m_source_mtime))
+        return;
+    header.m_buffer_count = m->getMeshBufferCount();
+    storeBox(m->getBoundingBox(), header.m_box);
+
+    // Assemble the whole file first, so that it can be written at once
+    std::vector<char> data;
+    auto write = [&](const void *p, size_t size)
+    {
+        data.insert(data.end(), (const char*)p, (const char*)p + size);
+    };
+    write(&header, sizeof(header));
+
+    for (u32 b = 0; b < m->getMeshBufferCount(); b++)
+    {
+        scene::IMeshBuffer *mb = m->getMeshBuffer(b);
+        if (mb->getIndexType() != video::EIT_16BIT)
+            return;
+        const video::SMaterial &material = mb->getMaterial();
+
+        BufferHeader bh;
+        memset(&bh, 0, sizeof(bh));
+        bh.m_vertex_type  = mb->getVertexType();
+        bh.m_vertex_count = mb->getVertexCount();
+        bh.m_index_count  = mb->getIndexCount();
+        storeBox(mb->getBoundingBox(), bh.m_box);
+        bh.m_material_type = material.MaterialType;
+        bh.m_colors[0] = material.AmbientColor.color;
+        bh.m_colors[1] = material.DiffuseColor.color;
+        bh.m_colors[2] = material.EmissiveColor.color;
+        bh.m_colors[3] = material.SpecularColor.color;
+        bh.m_params[0] = material.Shininess;
+        bh.m_params[1] = material.MaterialTypeParam;
+        bh.m_params[2] = material.MaterialTypeParam2;
+        bh.m_params[3] = material.Thickness;
+        bh.m_bytes[0]  = material.ZBuffer;
+        bh.m_bytes[1]  = material.AntiAliasing;
+        bh.m_bytes[2]  = material.ColorMask;
+        bh.m_bytes[3]  = material.ColorMaterial;
+        bh.m_bytes[4]  = material.BlendOperation;
+        bh.m_bytes[5]  = material.PolygonOffsetFactor;
+        bh.m_bytes[6]  = material.PolygonOffsetDirection;
+        for (unsigned i = 0; i < sizeof(g_material_flags) /
+                                 sizeof(g_material_flags[0]); i++)
+        {
+            if (material.getFlag(g_material_flags[i]))
+                bh.m_flags |= 1 << i;
+        }
+
+        std::vector<std::string> texture_names;
+        for (u32 t = 0; t < video::MATERIAL_MAX_TEXTURES; t++)
+        {
+            const video::SMaterialLayer &layer = material.TextureLayer[t];
+            texture_names.push_back(layer.Texture
+                ? std::string(layer.Texture->getName().getPath().c_str())
+                : std::string());
+            bh.m_texture_name_length[t] = (u32)texture_names.back().size();
+            bh.m_texture_wrap[t]   = layer.TextureWrapU |
+                                     layer.TextureWrapV << 4;
+            bh.m_texture_filter[t] = (layer.BilinearFilter  ? 1 : 0) |
+                                     (layer.TrilinearFilter ? 2 : 0);
+            bh.m_has_texture_matrix[t] =
+                !layer.getTextureMatrix().isIdentity();
+        }
+        write(&bh, sizeof(bh));
+        for (u32 t = 0; t < video::MATERIAL_MAX_TEXTURES; t++)
+        {
+            write(texture_names[t].c_str(), texture_names[t].size());
+            if (bh.m_has_texture_matrix[t])
+            {
+                write(material.TextureLayer[t].getTextureMatrix().pointer(),
+                      16 * sizeof(f32));
+            }
+        }
+        write(mb->getVertices(), mb->getVertexCount() *
+              video::getVertexPitchFromType(mb->getVertexType()));
+        write(mb->getIndices(), mb->getIndexCount() * sizeof(u16));
+    }
+
+    const std::string name = getPrecookedName(filename);
+    const std::string tmp = name + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+    {
+        Log::warn("PrecookedMesh", "Can't write precooked mesh '%s'.",
+                  tmp.c_str());
+        return;
+    }
+    bool ok = fwrite(&data[0], 1, data.size(), f) == data.size();
+    ok = fclose(f) == 0 && ok;
+    remove(name.c_str());
+    if (!ok || rename(tmp.c_str(), name.c_str()) != 0)
+    {
+        Log::warn("PrecookedMesh", "Can't write precooked mesh '%s'.",
+                  name.c_str());
+        remove(tmp.c_str());
+    }
+}   // savePrecookedMesh
@@ -0,0 +1,44 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_PRECOOKED_MESH_HPP
+#define HEADER_PRECOOKED_MESH_HPP
+
+#include <string>
+
+namespace irr
+{
+    namespace scene { class IAnimatedMesh; }
+}
+using namespace irr;
+
+/** \file precooked_mesh.hpp
+ *  Stores static meshes in the cache directory in a binary format that is
+ *  loaded with a single read: the vertices and indices of each buffer are
+ *  stored as they are used by the GPU, together with the bounding boxes
+ *  and the materials (texture names and flags). A precooked mesh is only
+ *  used as long as the size and modification time of its source file
+ *  match. Meshes with joints are never precooked, they are always loaded
+ *  by their loader.
+ *  \ingroup graphics
+ */
+
+scene::IAnimatedMesh *loadPrecookedMesh(const std::string &filename);
+void                  savePrecookedMesh(const std::string &filename,
+                                        scene::IAnimatedMesh *mesh);
+
+#endif
@@ -19,6 +19,7 @@
 #include "graphics/irr_driver.hpp"
 
 #include "config/user_config.hpp"
+#include "graphics/2dutils.hpp"
 #include "graphics/callbacks.hpp"
 #include "central_settings.hpp"
 #include "graphics/glwrap.hpp"
@@ -44,11 +45,31 @@
 
 extern std::vector<float> BoundingBoxes;
 
+// Profiler markers only store the pointer to their name
+static const char* DRAW_ALL_MARKERS[] =
+{
+    "drawAll() for kart 0", "drawAll() for kart 1",
+    "drawAll() for kart 2", "drawAll() for kart 3",
+    "drawAll() for other karts"
+};
+static const char* RENDER_PLAYER_VIEW_MARKERS[] =
+{
+    "renderPlayerView() for kart 0", "renderPlayerView() for kart 1",
+    "renderPlayerView() for kart 2", "renderPlayerView() for kart 3",
+    "renderPlayerView() for other karts"
+};
+
 void IrrDriver::renderGLSL(float dt)
 {
     BoundingBoxes.clear();
+    m_render_frame++;
     World *world = World::getWorld(); // Never NULL.
 
+    // Read the GPU times of the previous frames that are available
+    for (unsigned i = 0; i < Q_LAST; i++)
+        getGPUTimer(i).poll();
+    updateDynamicResolution();
+
     Track *track = world->getTrack();
 
     for (unsigned i = 0; i < PowerupManager::POWERUP_MAX; i++)
@@ -91,7 +112,8 @@ void IrrDriver::renderGLSL(float dt)
 
     // Get a list of all glowing things. The driver's list contains the static ones,
     // here we add items, as they may disappear each frame.
-    std::vector<GlowData> glows = m_glowing;
+    std::vector<GlowData> &glows = m_frame_glowing;
+    glows.assign(m_glowing.begin(), m_glowing.end());
 
     ItemManager * const items = ItemManager::get();
     const u32 itemcount = items->getNumberOfItems();
@@ -158,9 +180,7 @@ void IrrDriver::renderGLSL(float dt)
         Camera * const camera = Camera::getCamera(cam);
         scene::ICameraSceneNode * const camnode = camera->getCameraSceneNode();
 
-        std::ostringstream oss;
-        oss << "drawAll() for kart " << cam;
-        PROFILER_PUSH_CPU_MARKER(oss.str().c_str(), (cam+1)*60,
+        PROFILER_PUSH_CPU_MARKER(DRAW_ALL_MARKERS[MIN2(cam, 4)], (cam+1)*60,
                                  0x00, 0x00);
         camera->activate(!CVS->isDefferedEnabled());
         rg->preRenderCallback(camera);   // adjusts start referee
@@ -184,7 +204,10 @@ void IrrDriver::renderGLSL(float dt)
         unsigned plc = UpdateLightsInfo(camnode, dt);
         PROFILER_POP_CPU_MARKER();
         PROFILER_PUSH_CPU_MARKER("UBO upload", 0x0, 0xFF, 0x0);
-        computeMatrixesAndCameras(camnode, viewport.LowerRightCorner.X - viewport.UpperLeftCorner.X, viewport.LowerRightCorner.Y - viewport.UpperLeftCorner.Y);
+        // The scene is rendered at the size of the render targets, which
+        // is scaled by the dynamic resolution
+        const float scale = getRenderScale();
+        computeMatrixesAndCameras(camnode, size_t((viewport.LowerRightCorner.X - viewport.UpperLeftCorner.X) * scale), size_t((viewport.LowerRightCorner.Y - viewport.UpperLeftCorner.Y) * scale));
         uploadLightingData();
         PROFILER_POP_CPU_MARKER();
         renderScene(camnode, plc, glows, dt, track->hasShadows(), false);
@@ -218,27 +241,24 @@ void IrrDriver::renderGLSL(float dt)
             IrrDebugDrawer* debug_drawer = world->getPhysics()->getDebugDrawer();
             if (debug_drawer != NULL && debug_drawer->debugEnabled())
             {
-                const std::map<video::SColor, std::vector<float> >& lines = debug_drawer->getLines();
-                std::map<video::SColor, std::vector<float> >::const_iterator it;
-
-                glUseProgram(UtilShader::ColoredLine::getInstance()->Program);
-                glBindVertexArray(UtilShader::ColoredLine::getInstance()->vao);
-                glBindBuffer(GL_ARRAY_BUFFER, UtilShader::ColoredLine::getInstance()->vbo);
-                for (it = lines.begin(); it != lines.end(); it++)
+                const std::vector<IrrDebugDrawer::LineVertex> &lines =
+                                                    debug_drawer->getLines();
+                if (!lines.empty())
                 {
-                    UtilShader::ColoredLine::getInstance()->setUniforms(it->first);
-                    const std::vector<float> &vertex = it->second;
-                    const float *tmp = vertex.data();
-                    for (unsigned int i = 0; i < vertex.size(); i += 1024 * 6)
-                    {
-                        unsigned count = MIN2((int)vertex.size() - i, 1024 * 6);
-                        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(float), &tmp[i]);
-
-                        glDrawArrays(GL_LINES, 0, count / 3);
-                    }
+                    // All lines are uploaded at once and drawn with one
+                    // call, the buffer is orphaned each frame
+                    glUseProgram(UtilShader::DebugLine::getInstance()->Program);
+                    UtilShader::DebugLine::getInstance()->setUniforms();
+                    glBindVertexArray(UtilShader::DebugLine::getInstance()->vao);
+                    glBindBuffer(GL_ARRAY_BUFFER, UtilShader::DebugLine::getInstance()->vbo);
+                    glBufferData(GL_ARRAY_BUFFER,
+                          lines.size() * sizeof(IrrDebugDrawer::LineVertex),
+                          lines.data(), GL_STREAM_DRAW);
+                    glDrawArrays(GL_LINES, 0, (GLsizei)lines.size());
+                    glBindBuffer(GL_ARRAY_BUFFER, 0);
+                    glUseProgram(0);
+                    glBindVertexArray(0);
                 }
-                glUseProgram(0);
-                glBindVertexArray(0);
             }
         }
 
@@ -299,17 +319,20 @@ void IrrDriver::renderGLSL(float dt)
         irr_driver->getActualScreenSize().Width,
         irr_driver->getActualScreenSize().Height));
 
+    // The icons, messages and texts of all player views are collected in
+    // one 2D batch, so that the quads sharing a texture (e.g. the same
+    // powerup icon in several views) are drawn together.
+    begin2DBatch();
     for(unsigned int i=0; i<Camera::getNumCameras(); i++)
     {
         Camera *camera = Camera::getCamera(i);
-        std::ostringstream oss;
-        oss << "renderPlayerView() for kart " << i;
-
-        PROFILER_PUSH_CPU_MARKER(oss.str().c_str(), 0x00, 0x00, (i+1)*60);
+        PROFILER_PUSH_CPU_MARKER(RENDER_PLAYER_VIEW_MARKERS[MIN2(i, 4)],
+                                 0x00, 0x00, (i+1)*60);
         rg->renderPlayerView(camera, dt);
 
         PROFILER_POP_CPU_MARKER();
     }  // for i<getNumKarts
+    end2DBatch();
 
     {
         ScopedGPUTimer Timer(getGPUTimer(Q_GUI));
@@ -415,7 +438,8 @@ void IrrDriver::renderScene(scene::ICameraSceneNode * const camnode, unsigned po
     {
         PROFILER_PUSH_CPU_MARKER("- SSAO", 0xFF, 0xFF, 0x00);
         ScopedGPUTimer Timer(getGPUTimer(Q_SSAO));
-        if (UserConfigParams::m_ssao)
+        // Model previews in the menus (forceRTT) are not worth the cost
+        if (UserConfigParams::m_ssao && !forceRTT)
             renderSSAO();
         PROFILER_POP_CPU_MARKER();
     }
@@ -494,10 +518,6 @@ void IrrDriver::renderScene(scene::ICameraSceneNode * const camnode, unsigned po
     } // end glow
     PROFILER_POP_CPU_MARKER();
 
-    PROFILER_PUSH_CPU_MARKER("- Lensflare/godray", 0x00, 0xFF, 0xFF);
-    computeSunVisibility();
-    PROFILER_POP_CPU_MARKER();
-
     // Render transparent
     {
         PROFILER_PUSH_CPU_MARKER("- Transparent Pass", 0xFF, 0x00, 0x00);
@@ -506,7 +526,10 @@ void IrrDriver::renderScene(scene::ICameraSceneNode * const camnode, unsigned po
         PROFILER_POP_CPU_MARKER();
     }
 
-    m_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // The instance buffers are not used anymore by this scene
+    if (m_sync[m_instance_buffer_index])
+        glDeleteSync(m_sync[m_instance_buffer_index]);
+    m_sync[m_instance_buffer_index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
     // Render particles
     {
@@ -546,9 +569,7 @@ void IrrDriver::renderFixed(float dt)
     {
         Camera *camera = Camera::getCamera(i);
 
-        std::ostringstream oss;
-        oss << "drawAll() for kart " << i;
-        PROFILER_PUSH_CPU_MARKER(oss.str().c_str(), (i+1)*60,
+        PROFILER_PUSH_CPU_MARKER(DRAW_ALL_MARKERS[MIN2(i, 4)], (i+1)*60,
                                  0x00, 0x00);
         camera->activate();
         rg->preRenderCallback(camera);   // adjusts start referee
@@ -574,10 +595,8 @@ void IrrDriver::renderFixed(float dt)
     for(unsigned int i=0; i<Camera::getNumCameras(); i++)
     {
         Camera *camera = Camera::getCamera(i);
-        std::ostringstream oss;
-        oss << "renderPlayerView() for kart " << i;
-
-        PROFILER_PUSH_CPU_MARKER(oss.str().c_str(), 0x00, 0x00, (i+1)*60);
+        PROFILER_PUSH_CPU_MARKER(RENDER_PLAYER_VIEW_MARKERS[MIN2(i, 4)],
+                                 0x00, 0x00, (i+1)*60);
         rg->renderPlayerView(camera, dt);
         PROFILER_POP_CPU_MARKER();
 
@@ -601,17 +620,6 @@ void IrrDriver::renderFixed(float dt)
 
 // ----------------------------------------------------------------------------
 
-void IrrDriver::computeSunVisibility()
-{
-    // Is the lens flare enabled & visible? Check last frame's query.
-    bool hasgodrays = false;
-
-    if (World::getWorld() != NULL)
-    {
-        hasgodrays = World::getWorld()->getTrack()->hasGodRays();
-    }
-}
-
 void IrrDriver::renderParticles()
 {
     glDepthMask(GL_FALSE);
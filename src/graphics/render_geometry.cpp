@@ -23,6 +23,8 @@
 #include "graphics/post_processing.hpp"
 #include "graphics/rtts.hpp"
 #include "graphics/shaders.hpp"
+#include "graphics/skid_mark_renderer.hpp"
+#include "graphics/texture_array_manager.hpp"
 #include "modes/world.hpp"
 #include "utils/log.hpp"
 #include "utils/profiler.hpp"
@@ -492,6 +494,84 @@ void multidraw1stPass(Args...args)
     }
 }
 
+/** Draws some of the commands of the solid pass of a material. */
+static void drawSolidCommands(Material::ShaderType mat, unsigned first,
+                              unsigned count)
+{
+    const size_t offset = SolidPassCmd::getInstance()->Offset[mat] + first;
+    if (CVS->isARBMultiDrawIndirectUsable())
+    {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT,
+            (const void*)(offset * sizeof(DrawElementsIndirectCommand)),
+            (int)count, sizeof(DrawElementsIndirectCommand));
+        return;
+    }
+    for (unsigned i = 0; i < count; i++)
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (const void*)((offset + i) * sizeof(DrawElementsIndirectCommand)));
+}   // drawSolidCommands
+
+/** Calls draw_group for each run of meshes whose textures are packed in the
+ *  same texture arrays (they are sorted by group, see InstanceBatches), and
+ *  draw_mesh for each mesh whose textures are not packed.
+ */
+template<typename F, typename G>
+static void forEachTextureArrayGroup(const std::vector<GLMesh *> &meshes,
+                                     F draw_group, G draw_mesh)
+{
+    const TextureArrayManager *tam = TextureArrayManager::getInstance();
+    unsigned i = 0;
+    while (i < meshes.size())
+    {
+        const unsigned group = tam->getGroup(meshes[i]);
+        if (group == 0)
+        {
+            draw_mesh(i);
+            i++;
+            continue;
+        }
+        unsigned end = i + 1;
+        while (end < meshes.size() && tam->getGroup(meshes[end]) == group)
+            end++;
+        draw_group(group, i, end - i);
+        i = end;
+    }
+}   // forEachTextureArrayGroup
+
+/** Replaces renderInstancedMeshes1stPass<DefaultMaterial> if the textures
+ *  are packed in texture arrays. */
+static void renderTextureArrayMeshes1stPass()
+{
+    typedef MeshShader::InstancedObjectArrayPass1Shader ArrayShader;
+    typedef DefaultMaterial::InstancedFirstPassShader SingleShader;
+    const std::vector<GLMesh *> &meshes = DefaultMaterial::InstancedList::getInstance()->SolidPass;
+    const TextureArrayManager *tam = TextureArrayManager::getInstance();
+    glBindVertexArray(VAOManager::getInstance()->getInstanceVAO(DefaultMaterial::VertexType, DefaultMaterial::Instance));
+    GLuint program = 0;
+    forEachTextureArrayGroup(meshes,
+        [&](unsigned group, unsigned first, unsigned count)
+        {
+            if (program != ArrayShader::getInstance()->Program)
+            {
+                program = ArrayShader::getInstance()->Program;
+                glUseProgram(program);
+            }
+            ArrayShader::getInstance()->SetTextureUnits(tam->getArray(group, 1));
+            ArrayShader::getInstance()->setUniforms();
+            drawSolidCommands(DefaultMaterial::MaterialType, first, count);
+        },
+        [&](unsigned i)
+        {
+            if (program != SingleShader::getInstance()->Program)
+            {
+                program = SingleShader::getInstance()->Program;
+                glUseProgram(program);
+            }
+            TexExpander<SingleShader>::ExpandTex(*meshes[i], DefaultMaterial::FirstPassTextures);
+            SingleShader::getInstance()->setUniforms();
+            drawSolidCommands(DefaultMaterial::MaterialType, i, 1);
+        });
+}   // renderTextureArrayMeshes1stPass
+
 static core::vector3df windDir;
 
 void IrrDriver::renderSolidFirstPass()
@@ -530,7 +610,10 @@ void IrrDriver::renderSolidFirstPass()
         }
         else if (CVS->supportsIndirectInstancingRendering())
         {
-            renderInstancedMeshes1stPass<DefaultMaterial>();
+            if (CVS->isTextureArrayBatchingEnabled())
+                renderTextureArrayMeshes1stPass();
+            else
+                renderInstancedMeshes1stPass<DefaultMaterial>();
             renderInstancedMeshes1stPass<AlphaRef>();
             renderInstancedMeshes1stPass<UnlitMat>();
             renderInstancedMeshes1stPass<SphereMap>();
@@ -587,6 +670,42 @@ void renderInstancedMeshes2ndPass(const std::vector<GLuint> &Prefilled_tex, Args
 }
 
 
+/** Replaces renderInstancedMeshes2ndPass<DefaultMaterial> if the textures
+ *  are packed in texture arrays. */
+static void renderTextureArrayMeshes2ndPass(const std::vector<GLuint> &Prefilled_tex)
+{
+    typedef MeshShader::InstancedObjectArrayPass2Shader ArrayShader;
+    typedef DefaultMaterial::InstancedSecondPassShader SingleShader;
+    const std::vector<GLMesh *> &meshes = DefaultMaterial::InstancedList::getInstance()->SolidPass;
+    const TextureArrayManager *tam = TextureArrayManager::getInstance();
+    glBindVertexArray(VAOManager::getInstance()->getInstanceVAO(DefaultMaterial::VertexType, DefaultMaterial::Instance));
+    GLuint program = 0;
+    forEachTextureArrayGroup(meshes,
+        [&](unsigned group, unsigned first, unsigned count)
+        {
+            if (program != ArrayShader::getInstance()->Program)
+            {
+                program = ArrayShader::getInstance()->Program;
+                glUseProgram(program);
+            }
+            ArrayShader::getInstance()->SetTextureUnits(Prefilled_tex[0], Prefilled_tex[1], Prefilled_tex[2],
+                                                        tam->getArray(group, 0), tam->getArray(group, 1));
+            ArrayShader::getInstance()->setUniforms();
+            drawSolidCommands(DefaultMaterial::MaterialType, first, count);
+        },
+        [&](unsigned i)
+        {
+            if (program != SingleShader::getInstance()->Program)
+            {
+                program = SingleShader::getInstance()->Program;
+                glUseProgram(program);
+            }
+            TexExpander<SingleShader>::ExpandTex(*meshes[i], DefaultMaterial::SecondPassTextures, Prefilled_tex[0], Prefilled_tex[1], Prefilled_tex[2]);
+            SingleShader::getInstance()->setUniforms();
+            drawSolidCommands(DefaultMaterial::MaterialType, i, 1);
+        });
+}   // renderTextureArrayMeshes2ndPass
+
 template<typename T, typename...Args>
 void multidraw2ndPass(const std::vector<uint64_t> &Handles, Args... args)
 {
@@ -680,7 +799,10 @@ void IrrDriver::renderSolidSecondPass()
         }
         else if (CVS->supportsIndirectInstancingRendering())
         {
-            renderInstancedMeshes2ndPass<DefaultMaterial>(DiffSpecSSAOTex);
+            if (CVS->isTextureArrayBatchingEnabled())
+                renderTextureArrayMeshes2ndPass(DiffSpecSSAOTex);
+            else
+                renderInstancedMeshes2ndPass<DefaultMaterial>(DiffSpecSSAOTex);
             renderInstancedMeshes2ndPass<AlphaRef>(DiffSpecSSAOTex);
             renderInstancedMeshes2ndPass<UnlitMat>(DiffSpecSSAOTex);
             renderInstancedMeshes2ndPass<SphereMap>(DiffSpecSSAOTex);
@@ -820,6 +942,9 @@ void IrrDriver::renderTransparent()
     for (unsigned i = 0; i < BillBoardList::getInstance()->size(); i++)
         BillBoardList::getInstance()->at(i)->render();
 
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    SkidMarkRenderer::getInstance()->render();
+
     if (!CVS->isDefferedEnabled())
         return;
 
@@ -941,9 +1066,9 @@ struct shadow_custom_unroll_args<N, List...>
 };
 
 template<typename T, int...List>
-void renderShadow(unsigned cascade)
+void renderShadow(unsigned pass, unsigned cascade)
 {
-    auto &t = T::List::getInstance()->Shadows[cascade];
+    auto &t = T::List::getInstance()->Shadows[pass];
     glUseProgram(T::ShadowPassShader::getInstance()->Program);
     if (CVS->isARBBaseInstanceUsable())
         glBindVertexArray(VAOManager::getInstance()->getVAO(T::VertexType));
@@ -961,37 +1086,85 @@ void renderShadow(unsigned cascade)
 }
 
 template<typename T, typename...Args>
-void renderInstancedShadow(unsigned cascade, Args ...args)
+void renderInstancedShadow(unsigned pass, unsigned cascade, Args ...args)
 {
     glUseProgram(T::InstancedShadowPassShader::getInstance()->Program);
     glBindVertexArray(VAOManager::getInstance()->getInstanceVAO(T::VertexType, InstanceTypeShadow));
-    std::vector<GLMesh *> &t = T::InstancedList::getInstance()->Shadows[cascade];
+    std::vector<GLMesh *> &t = T::InstancedList::getInstance()->Shadows[pass];
     for (unsigned i = 0; i < t.size(); i++)
     {
         GLMesh *mesh = t[i];
 
         TexExpander<typename T::InstancedShadowPassShader>::template ExpandTex(*mesh, T::ShadowTextures);
         T::InstancedShadowPassShader::getInstance()->setUniforms(cascade, args...);
-        size_t tmp = ShadowPassCmd::getInstance()->Offset[cascade][T::MaterialType] + i;
+        size_t tmp = ShadowPassCmd::getInstance()->Offset[pass][T::MaterialType] + i;
         glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (const void*)((tmp) * sizeof(DrawElementsIndirectCommand)));
     }
 
 }
 
 template<typename T, typename...Args>
-static void multidrawShadow(unsigned i, Args ...args)
+static void multidrawShadow(unsigned pass, unsigned cascade, Args ...args)
 {
     glUseProgram(T::InstancedShadowPassShader::getInstance()->Program);
     glBindVertexArray(VAOManager::getInstance()->getInstanceVAO(T::VertexType, InstanceTypeShadow));
-    if (ShadowPassCmd::getInstance()->Size[i][T::MaterialType])
+    if (ShadowPassCmd::getInstance()->Size[pass][T::MaterialType])
     {
-        T::InstancedShadowPassShader::getInstance()->setUniforms(i, args...);
+        T::InstancedShadowPassShader::getInstance()->setUniforms(cascade, args...);
         glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, 
-            (const void*)(ShadowPassCmd::getInstance()->Offset[i][T::MaterialType] * sizeof(DrawElementsIndirectCommand)),
-            (int)ShadowPassCmd::getInstance()->Size[i][T::MaterialType], sizeof(DrawElementsIndirectCommand));
+            (const void*)(ShadowPassCmd::getInstance()->Offset[pass][T::MaterialType] * sizeof(DrawElementsIndirectCommand)),
+            (int)ShadowPassCmd::getInstance()->Size[pass][T::MaterialType], sizeof(DrawElementsIndirectCommand));
     }
 }
 
+/** Draws the shadow casters of a shadow pass into the layer of a cascade.
+ *  \param pass The shadow pass, see SHADOW_CACHE_PASS.
+ *  \param cascade The cascade (and layer of the shadow map).
+ */
+static void renderShadowPass(unsigned pass, unsigned cascade)
+{
+    renderShadow<DefaultMaterial, 1>(pass, cascade);
+    renderShadow<SphereMap, 1>(pass, cascade);
+    renderShadow<DetailMat, 1>(pass, cascade);
+    renderShadow<SplattingMat, 1>(pass, cascade);
+    renderShadow<NormalMat, 1>(pass, cascade);
+    renderShadow<AlphaRef, 1>(pass, cascade);
+    renderShadow<UnlitMat, 1>(pass, cascade);
+    renderShadow<GrassMat, 3, 1>(pass, cascade);
+
+    if (CVS->supportsIndirectInstancingRendering())
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ShadowPassCmd::getInstance()->drawindirectcmd);
+
+    if (CVS->isAZDOEnabled())
+    {
+        multidrawShadow<DefaultMaterial>(pass, cascade);
+        multidrawShadow<DetailMat>(pass, cascade);
+        multidrawShadow<NormalMat>(pass, cascade);
+        multidrawShadow<AlphaRef>(pass, cascade);
+        multidrawShadow<UnlitMat>(pass, cascade);
+        multidrawShadow<GrassMat>(pass, cascade, windDir);
+    }
+    else if (CVS->supportsIndirectInstancingRendering())
+    {
+        renderInstancedShadow<DefaultMaterial>(pass, cascade);
+        renderInstancedShadow<DetailMat>(pass, cascade);
+        renderInstancedShadow<AlphaRef>(pass, cascade);
+        renderInstancedShadow<UnlitMat>(pass, cascade);
+        renderInstancedShadow<GrassMat>(pass, cascade, windDir);
+        renderInstancedShadow<NormalMat>(pass, cascade);
+    }
+}   // renderShadowPass
+
+/** Copies one layer between the shadow map and the static shadow cache. */
+static void copyShadowLayer(GLuint src, unsigned src_layer, GLuint dst,
+                            unsigned dst_layer)
+{
+    glCopyImageSubData(src, GL_TEXTURE_2D_ARRAY, 0, 0, 0, src_layer,
+                       dst, GL_TEXTURE_2D_ARRAY, 0, 0, 0, dst_layer,
+                       UserConfigParams::m_shadows_resolution,
+                       UserConfigParams::m_shadows_resolution, 1);
+}   // copyShadowLayer
+
 void IrrDriver::renderShadows()
 {
     glDepthFunc(GL_LEQUAL);
@@ -1016,36 +1189,32 @@ void IrrDriver::renderShadows()
     {
         ScopedGPUTimer Timer(getGPUTimer(Q_SHADOWS_CASCADE0 + cascade));
 
-        renderShadow<DefaultMaterial, 1>(cascade);
-        renderShadow<SphereMap, 1>(cascade);
-        renderShadow<DetailMat, 1>(cascade);
-        renderShadow<SplattingMat, 1>(cascade);
-        renderShadow<NormalMat, 1>(cascade);
-        renderShadow<AlphaRef, 1>(cascade);
-        renderShadow<UnlitMat, 1>(cascade);
-        renderShadow<GrassMat, 3, 1>(cascade);
-
-        if (CVS->supportsIndirectInstancingRendering())
-            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ShadowPassCmd::getInstance()->drawindirectcmd);
-
-        if (CVS->isAZDOEnabled())
+        // The static shadow casters of a cached cascade are only drawn when
+        // the cache is outdated, otherwise the cache is copied into the
+        // shadow map before the dynamic casters are drawn on top of it.
+        if (m_shadow_cache_used[cascade])
         {
-            multidrawShadow<DefaultMaterial>(cascade);
-            multidrawShadow<DetailMat>(cascade);
-            multidrawShadow<NormalMat>(cascade);
-            multidrawShadow<AlphaRef>(cascade);
-            multidrawShadow<UnlitMat>(cascade);
-            multidrawShadow<GrassMat>(cascade, windDir);
-        }
-        else if (CVS->supportsIndirectInstancingRendering())
-        {
-            renderInstancedShadow<DefaultMaterial>(cascade);
-            renderInstancedShadow<DetailMat>(cascade);
-            renderInstancedShadow<AlphaRef>(cascade);
-            renderInstancedShadow<UnlitMat>(cascade);
-            renderInstancedShadow<GrassMat>(cascade, windDir);
-            renderInstancedShadow<NormalMat>(cascade);
+            const unsigned layer = cascade - FIRST_CACHED_CASCADE;
+            if (!m_shadow_cache_rendered[cascade])
+            {
+                renderShadowPass(SHADOW_CACHE_PASS + cascade, cascade);
+                copyShadowLayer(m_rtts->getShadowDepthTexture(), cascade,
+                                m_rtts->getShadowDepthCacheTexture(), layer);
+                if (CVS->isESMEnabled())
+                    copyShadowLayer(m_rtts->getShadowColorTexture(), cascade,
+                                    m_rtts->getShadowColorCacheTexture(), layer);
+                m_shadow_cache_rendered[cascade] = true;
+            }
+            else
+            {
+                copyShadowLayer(m_rtts->getShadowDepthCacheTexture(), layer,
+                                m_rtts->getShadowDepthTexture(), cascade);
+                if (CVS->isESMEnabled())
+                    copyShadowLayer(m_rtts->getShadowColorCacheTexture(), layer,
+                                    m_rtts->getShadowColorTexture(), cascade);
+            }
         }
+        renderShadowPass(cascade, cascade);
     }
 
     glDisable(GL_POLYGON_OFFSET_FILL);
@@ -1180,4 +1349,73 @@ void IrrDriver::renderRSM()
         renderRSMShadow<DetailMat>(rsm_matrix);
     }
     m_rsm_map_available = true;
+    m_rh_available = false;
 }
+
+// ----------------------------------------------------------------------------
+/** Creates the non instanced shaders of a material. */
+template<typename T>
+static void warmupMaterialShaders(bool shadows, bool rsm)
+{
+    T::FirstPassShader::getInstance();
+    T::SecondPassShader::getInstance();
+    if (shadows)
+        T::ShadowPassShader::getInstance();
+    if (rsm)
+        T::RSMShader::getInstance();
+}   // warmupMaterialShaders
+
+// ----------------------------------------------------------------------------
+/** Creates the instanced shaders of a material. */
+template<typename T>
+static void warmupInstancedShaders(bool shadows, bool rsm)
+{
+    T::InstancedFirstPassShader::getInstance();
+    T::InstancedSecondPassShader::getInstance();
+    if (shadows)
+        T::InstancedShadowPassShader::getInstance();
+    if (rsm)
+        T::InstancedRSMShader::getInstance();
+}   // warmupInstancedShaders
+
+// ----------------------------------------------------------------------------
+/** Creates all shaders of the solid, shadow and RSM passes that are used
+ *  with the current settings. The shaders are otherwise created (compiled,
+ *  or loaded from the program binary cache) the first time a mesh needs
+ *  them, which stalls a frame in the race. This is called while a track is
+ *  loaded, so the cost is moved to the loading screen.
+ */
+void IrrDriver::warmupShaders()
+{
+    if (!CVS->isGLSL())
+        return;
+    PROFILER_PUSH_CPU_MARKER("Warmup shaders", 0xFF, 0x00, 0xFF);
+    const bool shadows = CVS->isShadowEnabled();
+    const bool rsm = CVS->isGlobalIlluminationEnabled();
+
+    warmupMaterialShaders<DefaultMaterial>(shadows, rsm);
+    warmupMaterialShaders<AlphaRef>(shadows, rsm);
+    warmupMaterialShaders<SphereMap>(shadows, rsm);
+    warmupMaterialShaders<UnlitMat>(shadows, rsm);
+    warmupMaterialShaders<GrassMat>(shadows, rsm);
+    warmupMaterialShaders<NormalMat>(shadows, rsm);
+    warmupMaterialShaders<DetailMat>(shadows, rsm);
+    warmupMaterialShaders<SplattingMat>(shadows, rsm);
+
+    if (CVS->supportsIndirectInstancingRendering())
+    {
+        warmupInstancedShaders<DefaultMaterial>(shadows, rsm);
+        warmupInstancedShaders<AlphaRef>(shadows, rsm);
+        warmupInstancedShaders<SphereMap>(shadows, rsm);
+        warmupInstancedShaders<UnlitMat>(shadows, rsm);
+        warmupInstancedShaders<GrassMat>(shadows, rsm);
+        warmupInstancedShaders<NormalMat>(shadows, rsm);
+        warmupInstancedShaders<DetailMat>(shadows, rsm);
+        if (!CVS->isAZDOEnabled() && CVS->isTextureArrayBatchingEnabled())
+        {
+            MeshShader::InstancedObjectArrayPass1Shader::getInstance();
+            MeshShader::InstancedObjectArrayPass2Shader::getInstance();
+        }
+    }
+    PROFILER_POP_CPU_MARKER();
+}   // warmupShaders
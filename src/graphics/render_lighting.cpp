@@ -32,7 +32,7 @@
 #define MAX2(a, b) ((a) > (b) ? (a) : (b))
 #define MIN2(a, b) ((a) > (b) ? (b) : (a))
 
-static LightShader::PointLightInfo PointLightsInfo[MAXLIGHT];
+static LightShader::PointLightInfo PointLightsInfo[MAX_CLUSTERED_LIGHTS];
 
 static void renderPointLights(unsigned count)
 {
@@ -53,12 +53,58 @@ static void renderPointLights(unsigned count)
     glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
 }
 
+/** Renders the point lights with clustered shading: a compute shader first
+ *  assigns the lights to the clusters of the view frustum, then each pixel
+ *  is shaded in one full screen pass with only the lights of its cluster.
+ *  Unlike renderPointLights, this is not limited to MAXLIGHT lights, and
+ *  the cost depends on the number of lights per cluster.
+ */
+static void renderClusteredPointLights(unsigned count)
+{
+    // The light scattering still renders the nearest MAXLIGHT lights as
+    // instanced quads
+    glBindBuffer(GL_ARRAY_BUFFER, LightShader::PointLightShader::getInstance()->vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, MIN2(count, MAXLIGHT) * sizeof(LightShader::PointLightInfo), PointLightsInfo);
+    if (count == 0)
+        return;
+
+    const scene::ICameraSceneNode *camera = irr_driver->getSceneManager()->getActiveCamera();
+    const float zn = camera->getNearValue();
+    const float zf = camera->getFarValue();
+
+    LightShader::LightClusterShader *cluster_shader = LightShader::LightClusterShader::getInstance();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, cluster_shader->lights_ssbo);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(LightShader::PointLightInfo), PointLightsInfo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, cluster_shader->lights_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, cluster_shader->clusters_ssbo);
+
+    glUseProgram(cluster_shader->Program);
+    cluster_shader->setUniforms(zn, zf, (int)count);
+    glDispatchCompute(1, 1, CLUSTER_Z);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+
+    LightShader::ClusteredPointLightShader::getInstance()->SetTextureUnits(irr_driver->getRenderTargetTexture(RTT_NORMAL_AND_DEPTH), irr_driver->getDepthStencilTexture());
+    DrawFullScreenEffect<LightShader::ClusteredPointLightShader>(zn, zf);
+}
+
+/** The point lights sorted into buckets by distance, a static so that its
+ *  memory is reused each frame. */
+static std::vector<LightNode *> g_light_buckets[15];
+
 unsigned IrrDriver::UpdateLightsInfo(scene::ICameraSceneNode * const camnode, float dt)
 {
     const u32 lightcount = (u32)m_lights.size();
     const core::vector3df &campos = camnode->getAbsolutePosition();
 
-    std::vector<LightNode *> BucketedLN[15];
+    std::vector<LightNode *> *BucketedLN = g_light_buckets;
+    for (unsigned i = 0; i < 15; i++)
+        BucketedLN[i].clear();
     for (unsigned int i = 0; i < lightcount; i++)
     {
         if (!m_lights[i]->isVisible())
@@ -76,51 +122,53 @@ unsigned IrrDriver::UpdateLightsInfo(scene::ICameraSceneNode * const camnode, fl
         BucketedLN[idx].push_back(m_lights[i]);
     }
 
+    // Without clustered lighting each light is rendered on its own, so
+    // only the nearest lights are used
+    const unsigned max_lights = CVS->supportsClusteredLighting() ? MAX_CLUSTERED_LIGHTS : MAXLIGHT;
     unsigned lightnum = 0;
+    bool skipped_lights = false;
 
     for (unsigned i = 0; i < 15; i++)
     {
         for (unsigned j = 0; j < BucketedLN[i].size(); j++)
         {
-            if (++lightnum >= MAXLIGHT)
+            LightNode* light_node = BucketedLN[i].at(j);
+            if (lightnum >= max_lights)
             {
-                LightNode* light_node = BucketedLN[i].at(j);
                 light_node->setEnergyMultiplier(0.0f);
+                skipped_lights = true;
+                continue;
             }
-            else
-            {
-                LightNode* light_node = BucketedLN[i].at(j);
 
-                float em = light_node->getEnergyMultiplier();
-                if (em < 1.0f)
-                {
-                    light_node->setEnergyMultiplier(std::min(1.0f, em + dt));
-                }
+            float em = light_node->getEnergyMultiplier();
+            if (em < 1.0f)
+            {
+                light_node->setEnergyMultiplier(std::min(1.0f, em + dt));
+            }
 
-                const core::vector3df &pos = light_node->getAbsolutePosition();
-                PointLightsInfo[lightnum].posX = pos.X;
-                PointLightsInfo[lightnum].posY = pos.Y;
-                PointLightsInfo[lightnum].posZ = pos.Z;
+            const core::vector3df &pos = light_node->getAbsolutePosition();
+            PointLightsInfo[lightnum].posX = pos.X;
+            PointLightsInfo[lightnum].posY = pos.Y;
+            PointLightsInfo[lightnum].posZ = pos.Z;
 
-                PointLightsInfo[lightnum].energy = light_node->getEffectiveEnergy();
+            PointLightsInfo[lightnum].energy = light_node->getEffectiveEnergy();
 
-                const core::vector3df &col = light_node->getColor();
-                PointLightsInfo[lightnum].red = col.X;
-                PointLightsInfo[lightnum].green = col.Y;
-                PointLightsInfo[lightnum].blue = col.Z;
+            const core::vector3df &col = light_node->getColor();
+            PointLightsInfo[lightnum].red = col.X;
+            PointLightsInfo[lightnum].green = col.Y;
+            PointLightsInfo[lightnum].blue = col.Z;
 
-                // Light radius
-                PointLightsInfo[lightnum].radius = light_node->getRadius();
-            }
+            // Light radius
+            PointLightsInfo[lightnum].radius = light_node->getRadius();
+            lightnum++;
         }
-        if (lightnum > MAXLIGHT)
+        if (skipped_lights)
         {
             irr_driver->setLastLightBucketDistance(i * 10);
             break;
         }
     }
 
-    lightnum++;
     return lightnum;
 }
 
@@ -150,9 +198,17 @@ extern float shadowSplit[5];
 void IrrDriver::renderLights(unsigned pointlightcount, bool hasShadow)
 {
     //RH
-    if (CVS->isGlobalIlluminationEnabled() && hasShadow)
+    const video::SColorf &sun_color = irr_driver->getSunColor();
+    if (CVS->isGlobalIlluminationEnabled() && hasShadow &&
+        (!m_rh_available || rh_matrix != m_rh_matrix_cached ||
+         sun_color.r != m_rh_sun_color_cached.r ||
+         sun_color.g != m_rh_sun_color_cached.g ||
+         sun_color.b != m_rh_sun_color_cached.b))
     {
         ScopedGPUTimer timer(irr_driver->getGPUTimer(Q_RH));
+        m_rh_available = true;
+        m_rh_matrix_cached = rh_matrix;
+        m_rh_sun_color_cached = sun_color;
         glDisable(GL_BLEND);
         m_rtts->getRH().Bind();
         glBindVertexArray(SharedObject::FullScreenQuadVAO);
@@ -230,16 +286,39 @@ void IrrDriver::renderLights(unsigned pointlightcount, bool hasShadow)
     }
     {
         ScopedGPUTimer timer(irr_driver->getGPUTimer(Q_POINTLIGHTS));
-        renderPointLights(MIN2(pointlightcount, MAXLIGHT));
+        if (CVS->supportsClusteredLighting())
+            renderClusteredPointLights(pointlightcount);
+        else
+            renderPointLights(MIN2(pointlightcount, MAXLIGHT));
     }
 }
 
+/** Renders the ambient occlusion into RTT_HALF1_R, where the lighting pass
+ *  reads it. With UserConfigParams::m_ssao_downscale set to 2 or 4, the
+ *  occlusion is computed and blurred at half or quarter resolution instead
+ *  of at full resolution; the quarter resolution result is upsampled with
+ *  a depth-aware filter.
+ */
 void IrrDriver::renderSSAO()
 {
+    if (UserConfigParams::m_ssao_downscale == 2)
+    {
+        m_post_processing->renderSSAO(m_rtts->getFBO(FBO_HALF1_R));
+        m_post_processing->renderGaussian17TapBlur(irr_driver->getFBO(FBO_HALF1_R), irr_driver->getFBO(FBO_HALF2_R));
+        return;
+    }
+    if (UserConfigParams::m_ssao_downscale >= 4)
+    {
+        m_post_processing->renderSSAO(m_rtts->getFBO(FBO_QUARTER1_R));
+        m_post_processing->renderGaussian17TapBlur(irr_driver->getFBO(FBO_QUARTER1_R), irr_driver->getFBO(FBO_QUARTER2_R));
+        m_post_processing->renderBilateralUpsample(irr_driver->getFBO(FBO_QUARTER1_R), irr_driver->getFBO(FBO_HALF1_R), 2.0f);
+        return;
+    }
+
     m_rtts->getFBO(FBO_SSAO).Bind();
     glClearColor(1., 1., 1., 1.);
     glClear(GL_COLOR_BUFFER_BIT);
-    m_post_processing->renderSSAO();
+    m_post_processing->renderSSAO(m_rtts->getFBO(FBO_SSAO));
     // Blur it to reduce noise.
     FrameBuffer::Blit(m_rtts->getFBO(FBO_SSAO), m_rtts->getFBO(FBO_HALF1_R), GL_COLOR_BUFFER_BIT, GL_LINEAR);
     m_post_processing->renderGaussian17TapBlur(irr_driver->getFBO(FBO_HALF1_R), irr_driver->getFBO(FBO_HALF2_R));
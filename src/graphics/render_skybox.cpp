@@ -19,9 +19,15 @@
 #include "graphics/IBL.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/shaders.hpp"
+#include "io/file_manager.hpp"
 #include "modes/world.hpp"
+#include "utils/log.hpp"
 #include "utils/profiler.hpp"
 
+#include <fstream>
+#include <stdint.h>
+#include <vector>
+
 #define MAX2(a, b) ((a) > (b) ? (a) : (b))
 #define MIN2(a, b) ((a) > (b) ? (b) : (a))
 
@@ -214,13 +220,29 @@ static void displayCoeff(float *SHCoeff)
     }
 }*/
 
-void swapPixels(char *old_img, char *new_img, unsigned stride, unsigned old_i, unsigned old_j, unsigned new_i, unsigned new_j)
+/** Rotates a square image by 90 degrees, so that the pixel of row i and
+ *  column j of the result is the pixel of row j and column size-1-i of the
+ *  source. The image is processed in tiles that fit in the cache, so that
+ *  neither the reads nor the writes jump through the whole image for each
+ *  pixel.
+ */
+static void rotateImage(const uint32_t *src, uint32_t *dst, unsigned size)
 {
-    new_img[4 * (stride * new_i + new_j)] = old_img[4 * (stride * old_i + old_j)];
-    new_img[4 * (stride * new_i + new_j) + 1] = old_img[4 * (stride * old_i + old_j) + 1];
-    new_img[4 * (stride * new_i + new_j) + 2] = old_img[4 * (stride * old_i + old_j) + 2];
-    new_img[4 * (stride * new_i + new_j) + 3] = old_img[4 * (stride * old_i + old_j) + 3];
-}
+    const unsigned TILE_SIZE = 32;
+    for (unsigned tile_i = 0; tile_i < size; tile_i += TILE_SIZE)
+    {
+        const unsigned end_i = MIN2(tile_i + TILE_SIZE, size);
+        for (unsigned tile_j = 0; tile_j < size; tile_j += TILE_SIZE)
+        {
+            const unsigned end_j = MIN2(tile_j + TILE_SIZE, size);
+            for (unsigned i = tile_i; i < end_i; i++)
+            {
+                for (unsigned j = tile_j; j < end_j; j++)
+                    dst[size * i + j] = src[size * j + size - 1 - i];
+            }
+        }
+    }
+}   // rotateImage
 
 
 /** Generate an opengl cubemap texture from 6 2d textures.
@@ -248,9 +270,11 @@ GLuint generateCubeMapFromTextures(const std::vector<video::ITexture *> &texture
     }
 
     const unsigned texture_permutation[] = { 2, 3, 0, 1, 5, 4 };
-    char *rgba[6];
-    for (unsigned i = 0; i < 6; i++)
-        rgba[i] = new char[size * size * 4];
+    // Each face is uploaded before the next one is converted, so the same
+    // buffers are used for all of them
+    std::vector<uint32_t> rgba(size * size);
+    std::vector<uint32_t> rotated;
+    glBindTexture(GL_TEXTURE_CUBE_MAP, result);
     for (unsigned i = 0; i < 6; i++)
     {
         unsigned idx = texture_permutation[i];
@@ -263,35 +287,175 @@ GLuint generateCubeMapFromTextures(const std::vector<video::ITexture *> &texture
             );
         textures[idx]->unlock();
 
-        image->copyToScaling(rgba[i], size, size);
+        image->copyToScaling(&rgba[0], size, size);
         image->drop();
 
+        const uint32_t *data = &rgba[0];
         if (i == 2 || i == 3)
         {
-            char *tmp = new char[size * size * 4];
-            memcpy(tmp, rgba[i], size * size * 4);
-            for (unsigned x = 0; x < size; x++)
-            {
-                for (unsigned y = 0; y < size; y++)
-                {
-                    swapPixels(tmp, rgba[i], size, x, y, (size - y - 1), x);
-                }
-            }
-            delete[] tmp;
+            rotated.resize(size * size);
+            rotateImage(&rgba[0], &rotated[0], size);
+            data = &rotated[0];
         }
 
-        glBindTexture(GL_TEXTURE_CUBE_MAP, result);
         if (CVS->isTextureCompressionEnabled())
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_COMPRESSED_SRGB_ALPHA, size, size, 0, GL_BGRA, GL_UNSIGNED_BYTE, (GLvoid*)rgba[i]);
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_COMPRESSED_SRGB_ALPHA, size, size, 0, GL_BGRA, GL_UNSIGNED_BYTE, (GLvoid*)data);
         else
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_SRGB_ALPHA, size, size, 0, GL_BGRA, GL_UNSIGNED_BYTE, (GLvoid*)rgba[i]);
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_SRGB_ALPHA, size, size, 0, GL_BGRA, GL_UNSIGNED_BYTE, (GLvoid*)data);
     }
     glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-    for (unsigned i = 0; i < 6; i++)
-        delete[] rgba[i];
     return result;
 }
 
+// ----------------------------------------------------------------------------
+/** Values computed from a set of skybox textures are cached in a file next
+ *  to the cached textures, which starts with this magic number and version,
+ *  followed by the names of the textures it was computed from. */
+static const int SKYBOX_CACHE_MAGIC   = 0x4c424953;
+static const int SKYBOX_CACHE_VERSION = 1;
+/** Size of the specular cubemap, it has all mipmap levels down to 1x1. */
+static const unsigned SPECULAR_CUBEMAP_SIZE = 256;
+
+// ----------------------------------------------------------------------------
+/** Returns the file in which values computed from the given textures are
+ *  cached, or an empty string if they can't be cached (e.g. because a
+ *  texture was not loaded from a file).
+ *  \param extension Appended to the name of the cache file.
+ */
+static std::string getSkyboxCacheFile(
+                                const std::vector<video::ITexture*> &textures,
+                                const std::string &extension)
+{
+    for (unsigned i = 0; i < textures.size(); i++)
+    {
+        if (irr_driver->getTextureName(textures[i]).empty())
+            return "";
+    }
+    return file_manager->getTextureCacheLocation(
+                       irr_driver->getTextureName(textures[0])) + extension;
+}   // getSkyboxCacheFile
+
+// ----------------------------------------------------------------------------
+/** Opens a cache file and checks that it was written from the given
+ *  textures and that none of them changed since.
+ *  \return True if the file can be used, the stream is then positioned
+ *          after the header.
+ */
+static bool openSkyboxCache(const std::string &file,
+                            const std::vector<video::ITexture*> &textures,
+                            std::ifstream *ifs)
+{
+    for (unsigned i = 0; i < textures.size(); i++)
+    {
+        if (file_manager->fileIsNewer(irr_driver->getTextureName(textures[i]),
+                                      file))
+            return false;
+    }
+    ifs->open(file.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs->is_open())
+        return false;
+    int header[3] = { 0, 0, 0 };
+    ifs->read((char*)header, sizeof(header));
+    if (ifs->fail() || header[0] != SKYBOX_CACHE_MAGIC ||
+        header[1] != SKYBOX_CACHE_VERSION || header[2] != (int)textures.size())
+        return false;
+    for (unsigned i = 0; i < textures.size(); i++)
+    {
+        int length = 0;
+        ifs->read((char*)&length, sizeof(int));
+        if (ifs->fail() || length < 0 || length > 4096)
+            return false;
+        std::string name(length, ' ');
+        ifs->read(&name[0], length);
+        if (ifs->fail() || name != irr_driver->getTextureName(textures[i]))
+            return false;
+    }
+    return true;
+}   // openSkyboxCache
+
+// ----------------------------------------------------------------------------
+/** Creates a cache file and writes the header for the given textures. */
+static bool createSkyboxCache(const std::string &file,
+                              const std::vector<video::ITexture*> &textures,
+                              std::ofstream *ofs)
+{
+    ofs->open(file.c_str(), std::ios::out | std::ios::binary);
+    if (!ofs->is_open())
+        return false;
+    int header[3] = { SKYBOX_CACHE_MAGIC, SKYBOX_CACHE_VERSION,
+                      (int)textures.size() };
+    ofs->write((char*)header, sizeof(header));
+    for (unsigned i = 0; i < textures.size(); i++)
+    {
+        const std::string name = irr_driver->getTextureName(textures[i]);
+        int length = (int)name.size();
+        ofs->write((char*)&length, sizeof(int));
+        ofs->write(name.data(), length);
+    }
+    return true;
+}   // createSkyboxCache
+
+// ----------------------------------------------------------------------------
+/** Loads the prefiltered specular cubemap of the skybox from the cache.
+ *  \return The cubemap, or 0 if it is not cached.
+ */
+static GLuint loadSpecularCubemap(const std::string &file,
+                                  const std::vector<video::ITexture*> &textures)
+{
+    std::ifstream ifs;
+    if (file.empty() || !openSkyboxCache(file, textures, &ifs))
+        return 0;
+
+    GLuint cubemap_texture;
+    glGenTextures(1, &cubemap_texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture);
+    // Half floats, 4 channels
+    std::vector<char> data(SPECULAR_CUBEMAP_SIZE * SPECULAR_CUBEMAP_SIZE * 8);
+    unsigned level = 0;
+    for (unsigned size = SPECULAR_CUBEMAP_SIZE; size > 0; size /= 2, level++)
+    {
+        for (unsigned face = 0; face < 6; face++)
+        {
+            ifs.read(&data[0], size * size * 8);
+            if (ifs.fail())
+            {
+                Log::warn("IrrDriver", "Specular cubemap cache '%s' is "
+                          "incomplete.", file.c_str());
+                glDeleteTextures(1, &cubemap_texture);
+                return 0;
+            }
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level,
+                         GL_RGBA16F, size, size, 0, GL_RGBA, GL_HALF_FLOAT,
+                         &data[0]);
+        }
+    }
+    return cubemap_texture;
+}   // loadSpecularCubemap
+
+// ----------------------------------------------------------------------------
+/** Saves all levels of the prefiltered specular cubemap of the skybox. */
+static void saveSpecularCubemap(const std::string &file,
+                                const std::vector<video::ITexture*> &textures,
+                                GLuint cubemap_texture)
+{
+    std::ofstream ofs;
+    if (file.empty() || !createSkyboxCache(file, textures, &ofs))
+        return;
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture);
+    std::vector<char> data(SPECULAR_CUBEMAP_SIZE * SPECULAR_CUBEMAP_SIZE * 8);
+    unsigned level = 0;
+    for (unsigned size = SPECULAR_CUBEMAP_SIZE; size > 0; size /= 2, level++)
+    {
+        for (unsigned face = 0; face < 6; face++)
+        {
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level,
+                          GL_RGBA, GL_HALF_FLOAT, &data[0]);
+            ofs.write(&data[0], size * size * 8);
+        }
+    }
+}   // saveSpecularCubemap
+
+// ----------------------------------------------------------------------------
 void IrrDriver::prepareSkybox()
 {
     glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
@@ -300,10 +464,26 @@ void IrrDriver::prepareSkybox()
     if (!SkyboxTextures.empty())
     {
         SkyboxCubeMap = generateCubeMapFromTextures(SkyboxTextures);
-        SkyboxSpecularProbe = generateSpecularCubemap(SkyboxCubeMap);
+        // Without deferred rendering the probe is unused and left empty
+        std::string cache_file;
+        if (CVS->isDefferedEnabled())
+            cache_file = getSkyboxCacheFile(SkyboxTextures, ".specular");
+        SkyboxSpecularProbe = loadSpecularCubemap(cache_file, SkyboxTextures);
+        if (!SkyboxSpecularProbe)
+        {
+            SkyboxSpecularProbe = generateSpecularCubemap(SkyboxCubeMap);
+            saveSpecularCubemap(cache_file, SkyboxTextures,
+                                SkyboxSpecularProbe);
+        }
     }
-}
+}   // prepareSkybox
+
+// ----------------------------------------------------------------------------
 
+/** Computes the spherical harmonics coefficients of the diffuse lighting,
+ *  from the spherical harmonics textures of the track if it has any
+ *  (the result is then cached), otherwise from the ambient light.
+ */
 void IrrDriver::generateDiffuseCoefficients()
 {
     const unsigned texture_permutation[] = { 2, 3, 0, 1, 5, 4 };
@@ -311,8 +491,21 @@ void IrrDriver::generateDiffuseCoefficients()
     unsigned sh_w = 0, sh_h = 0;
     unsigned char *sh_rgba[6];
 
+    std::string cache_file;
     if (SphericalHarmonicsTextures.size() == 6)
     {
+        cache_file = getSkyboxCacheFile(SphericalHarmonicsTextures, ".sh");
+        std::ifstream ifs;
+        if (!cache_file.empty() &&
+            openSkyboxCache(cache_file, SphericalHarmonicsTextures, &ifs))
+        {
+            ifs.read((char*)blueSHCoeff,  9 * sizeof(float));
+            ifs.read((char*)greenSHCoeff, 9 * sizeof(float));
+            ifs.read((char*)redSHCoeff,   9 * sizeof(float));
+            if (!ifs.fail())
+                return;
+        }
+
 
         for (unsigned i = 0; i < 6; i++)
         {
@@ -381,6 +574,15 @@ void IrrDriver::generateDiffuseCoefficients()
         delete[] FloatTexCube[i];
     }
 
+    std::ofstream ofs;
+    if (!cache_file.empty() &&
+        createSkyboxCache(cache_file, SphericalHarmonicsTextures, &ofs))
+    {
+        ofs.write((char*)blueSHCoeff,  9 * sizeof(float));
+        ofs.write((char*)greenSHCoeff, 9 * sizeof(float));
+        ofs.write((char*)redSHCoeff,   9 * sizeof(float));
+    }
+
     if (SphericalHarmonicsTextures.size() != 6)
     {
         // Diffuse env map is x 0.25, compensate
@@ -101,6 +101,8 @@ RTT::RTT(size_t width, size_t height)
     RenderTargetTextures[RTT_QUARTER2] = generateRTT(quarter, GL_RGBA16F, GL_BGRA, GL_FLOAT);
     RenderTargetTextures[RTT_EIGHTH2] = generateRTT(eighth, GL_RGBA16F, GL_BGRA, GL_FLOAT);
     RenderTargetTextures[RTT_HALF2_R] = generateRTT(half, GL_R16F, GL_RED, GL_FLOAT);
+    RenderTargetTextures[RTT_QUARTER1_R] = generateRTT(quarter, GL_R16F, GL_RED, GL_FLOAT);
+    RenderTargetTextures[RTT_QUARTER2_R] = generateRTT(quarter, GL_R16F, GL_RED, GL_FLOAT);
 
     RenderTargetTextures[RTT_BLOOM_1024] = generateRTT(shadowsize0, GL_RGBA16F, GL_BGR, GL_FLOAT);
     RenderTargetTextures[RTT_SCALAR_1024] = generateRTT(shadowsize0, GL_R32F, GL_RED, GL_FLOAT);
@@ -177,6 +179,12 @@ RTT::RTT(size_t width, size_t height)
     somevector.push_back(RenderTargetTextures[RTT_QUARTER2]);
     FrameBuffers.push_back(new FrameBuffer(somevector, quarter.Width, quarter.Height));
     somevector.clear();
+    somevector.push_back(RenderTargetTextures[RTT_QUARTER1_R]);
+    FrameBuffers.push_back(new FrameBuffer(somevector, quarter.Width, quarter.Height));
+    somevector.clear();
+    somevector.push_back(RenderTargetTextures[RTT_QUARTER2_R]);
+    FrameBuffers.push_back(new FrameBuffer(somevector, quarter.Width, quarter.Height));
+    somevector.clear();
     somevector.push_back(RenderTargetTextures[RTT_EIGHTH1]);
     FrameBuffers.push_back(new FrameBuffer(somevector, eighth.Width, eighth.Height));
     somevector.clear();
@@ -233,6 +241,13 @@ RTT::RTT(size_t width, size_t height)
         m_shadow_FBO = new FrameBuffer(somevector, shadowDepthTex, UserConfigParams::m_shadows_resolution, UserConfigParams::m_shadows_resolution, true);
     }
 
+    if (CVS->isStaticShadowCacheEnabled())
+    {
+        const unsigned cached_cascades = 4 - IrrDriver::FIRST_CACHED_CASCADE;
+        shadowColorCacheTex = generateRTT3D(GL_TEXTURE_2D_ARRAY, UserConfigParams::m_shadows_resolution, UserConfigParams::m_shadows_resolution, cached_cascades, GL_R32F, GL_RED, GL_FLOAT, 1);
+        shadowDepthCacheTex = generateRTT3D(GL_TEXTURE_2D_ARRAY, UserConfigParams::m_shadows_resolution, UserConfigParams::m_shadows_resolution, cached_cascades, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 1);
+    }
+
     if (CVS->isGlobalIlluminationEnabled())
     {
         //Todo : use "normal" shadowtex
@@ -277,6 +292,11 @@ RTT::~RTT()
         glDeleteTextures(1, &shadowColorTex);
         glDeleteTextures(1, &shadowDepthTex);
     }
+    if (CVS->isStaticShadowCacheEnabled())
+    {
+        glDeleteTextures(1, &shadowColorCacheTex);
+        glDeleteTextures(1, &shadowDepthCacheTex);
+    }
     if (CVS->isGlobalIlluminationEnabled())
     {
         delete m_RH_FBO;
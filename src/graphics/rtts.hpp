@@ -47,6 +47,10 @@ public:
     FrameBuffer &getRSM() { return *m_RSM; }
 
     unsigned getDepthStencilTexture() const { return DepthStencilTexture; }
+    unsigned getShadowColorTexture() const { return shadowColorTex; }
+    unsigned getShadowDepthTexture() const { return shadowDepthTex; }
+    unsigned getShadowColorCacheTexture() const { return shadowColorCacheTex; }
+    unsigned getShadowDepthCacheTexture() const { return shadowDepthCacheTex; }
     unsigned getRenderTarget(enum TypeRTT target) const { return RenderTargetTextures[target]; }
     FrameBuffer& getFBO(enum TypeFBO fbo) { return FrameBuffers[fbo]; }
 
@@ -61,6 +65,9 @@ private:
     int m_height;
 
     unsigned shadowColorTex, shadowNormalTex, shadowDepthTex;
+    /** Static geometry of the cached shadow cascades, one layer per cascade
+     *  from IrrDriver::FIRST_CACHED_CASCADE on. */
+    unsigned shadowColorCacheTex, shadowDepthCacheTex;
     unsigned RSM_Color, RSM_Normal, RSM_Depth;
     unsigned RH_Red, RH_Green, RH_Blue;
     FrameBuffer* m_shadow_FBO, *m_RSM, *m_RH_FBO;
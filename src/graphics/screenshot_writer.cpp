@@ -0,0 +1,240 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/screenshot_writer.hpp"
+
+#include "graphics/central_settings.hpp"
+#include "graphics/gl_headers.hpp"
+#include "graphics/irr_driver.hpp"
+#include "utils/log.hpp"
+
+#include <pthread.h>
+#include <string.h>
+
+namespace
+{
+    /** A frame read into a pixel buffer object, waiting for the GPU. */
+    struct PendingScreenshot
+    {
+        GLuint                     m_pbo;
+        GLsync                     m_fence;
+        core::dimension2du         m_size;
+        std::string                m_path;
+    };   // PendingScreenshot
+
+    /** An image handed to a writer thread. */
+    struct WrittenScreenshot
+    {
+        pthread_t                  m_thread;
+        video::IImage             *m_image;
+        std::string                m_path;
+        bool                       m_done;
+        bool                       m_ok;
+    };   // WrittenScreenshot
+}
+
+static std::vector<PendingScreenshot>   g_pending_screenshots;
+static std::vector<WrittenScreenshot*>  g_written_screenshots;
+static pthread_mutex_t g_written_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//-----------------------------------------------------------------------------
+/** Encodes and writes one screenshot, runs in a thread of its own. */
+static void *writeScreenshot(void *obj)
+{
+    WrittenScreenshot *ws = (WrittenScreenshot*)obj;
+    bool ok = irr_driver->getVideoDriver()->writeImageToFile(ws->m_image,
+                                                   ws->m_path.c_str(), 0);
+    ws->m_image->drop();
+    pthread_mutex_lock(&g_written_mutex);
+    ws->m_image = NULL;
+    ws->m_ok    = ok;
+    ws->m_done  = true;
+    pthread_mutex_unlock(&g_written_mutex);
+    return NULL;
+}   // writeScreenshot
+
+//-----------------------------------------------------------------------------
+/** Starts a thread that writes an image to a file. The image is dropped by
+ *  the thread.
+ */
+static void startWriting(video::IImage *image, const std::string &path)
+{
+    WrittenScreenshot *ws = new WrittenScreenshot();
+    ws->m_image = image;
+    ws->m_path  = path;
+    ws->m_done  = false;
+    ws->m_ok    = false;
+    if (pthread_create(&ws->m_thread, NULL, &writeScreenshot, ws) != 0)
+    {
+        Log::warn("Screenshot", "Could not start writer thread, writing "
+                  "screenshot on the main thread.");
+        ws->m_ok = irr_driver->getVideoDriver()->writeImageToFile(image,
+                                                           path.c_str(), 0);
+        image->drop();
+        ws->m_image = NULL;
+        ws->m_done  = true;
+        ws->m_thread = pthread_self();
+    }
+    g_written_screenshots.push_back(ws);
+}   // startWriting
+
+//-----------------------------------------------------------------------------
+/** Copies a mapped pixel buffer into an image. OpenGL stores the rows bottom
+ *  up, the image top down.
+ */
+static video::IImage *createImage(const PendingScreenshot &ps,
+                                  const uint8_t *pixels)
+{
+    video::IImage *image = irr_driver->getVideoDriver()
+                         ->createImage(video::ECF_A8R8G8B8, ps.m_size);
+    if (!image)
+        return NULL;
+    uint8_t *dst = (uint8_t*)image->lock();
+    const unsigned pitch = image->getPitch();
+    const unsigned row   = ps.m_size.Width * 4;
+    for (unsigned y = 0; y < ps.m_size.Height; y++)
+    {
+        uint8_t *dst_row = dst + (ps.m_size.Height - 1 - y) * pitch;
+        memcpy(dst_row, pixels + y * row, row);
+        // The alpha of the framebuffer is meaningless
+        for (unsigned x = 3; x < row; x += 4)
+            dst_row[x] = 0xFF;
+    }
+    image->unlock();
+    return image;
+}   // createImage
+
+//-----------------------------------------------------------------------------
+/** Starts saving the current frame as a screenshot. Must be called after the
+ *  frame was rendered and before it is presented. The result is reported by
+ *  updateScreenshots once the file is written.
+ *  \param path Name of the file to write.
+ */
+void startScreenshot(const std::string &path)
+{
+    if (!CVS->isGLSL())
+    {
+        video::IImage *image =
+            irr_driver->getVideoDriver()->createScreenShot();
+        if (!image)
+        {
+            Log::error("Screenshot", "Could not create screen shot.");
+            return;
+        }
+        startWriting(image, path);
+        return;
+    }
+
+    PendingScreenshot ps;
+    ps.m_size = irr_driver->getActualScreenSize();
+    ps.m_path = path;
+    glGenBuffers(1, &ps.m_pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, ps.m_pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, ps.m_size.Width * ps.m_size.Height * 4,
+                 NULL, GL_STREAM_READ);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadBuffer(GL_BACK);
+    glReadPixels(0, 0, ps.m_size.Width, ps.m_size.Height, GL_BGRA,
+                 GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    ps.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    g_pending_screenshots.push_back(ps);
+}   // startScreenshot
+
+//-----------------------------------------------------------------------------
+/** Called once per frame. Hands the screenshots the GPU has finished reading
+ *  to writer threads, and collects the threads that are done.
+ *  \param saved On return contains the name of each file written since the
+ *         last call, and whether writing it succeeded.
+ */
+void updateScreenshots(std::vector<std::pair<std::string, bool> > *saved)
+{
+    saved->clear();
+    for (unsigned i = 0; i < g_pending_screenshots.size();)
+    {
+        PendingScreenshot &ps = g_pending_screenshots[i];
+        GLenum reason = glClientWaitSync(ps.m_fence,
+                                         GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (reason == GL_TIMEOUT_EXPIRED)
+        {
+            i++;
+            continue;
+        }
+        glDeleteSync(ps.m_fence);
+
+        video::IImage *image = NULL;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, ps.m_pbo);
+        const uint8_t *pixels = reason == GL_WAIT_FAILED ? NULL :
+            (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                  ps.m_size.Width * ps.m_size.Height * 4,
+                                  GL_MAP_READ_BIT);
+        if (pixels)
+        {
+            image = createImage(ps, pixels);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glDeleteBuffers(1, &ps.m_pbo);
+
+        if (image)
+            startWriting(image, ps.m_path);
+        else
+            saved->push_back(std::make_pair(ps.m_path, false));
+        g_pending_screenshots.erase(g_pending_screenshots.begin() + i);
+    }
+
+    for (unsigned i = 0; i < g_written_screenshots.size();)
+    {
+        WrittenScreenshot *ws = g_written_screenshots[i];
+        pthread_mutex_lock(&g_written_mutex);
+        const bool done = ws->m_done;
+        pthread_mutex_unlock(&g_written_mutex);
+        if (!done)
+        {
+            i++;
+            continue;
+        }
+        if (!pthread_equal(ws->m_thread, pthread_self()))
+            pthread_join(ws->m_thread, NULL);
+        saved->push_back(std::make_pair(ws->m_path, ws->m_ok));
+        delete ws;
+        g_written_screenshots.erase(g_written_screenshots.begin() + i);
+    }
+}   // updateScreenshots
+
+//-----------------------------------------------------------------------------
+/** Waits for all writer threads and discards the screenshots the GPU hasn't
+ *  finished yet. Must be called before the OpenGL context is destroyed.
+ */
+void stopScreenshots()
+{
+    for (unsigned i = 0; i < g_written_screenshots.size(); i++)
+    {
+        WrittenScreenshot *ws = g_written_screenshots[i];
+        if (!pthread_equal(ws->m_thread, pthread_self()))
+            pthread_join(ws->m_thread, NULL);
+        delete ws;
+    }
+    g_written_screenshots.clear();
+
+    for (unsigned i = 0; i < g_pending_screenshots.size(); i++)
+    {
+        glDeleteSync(g_pending_screenshots[i].m_fence);
+        glDeleteBuffers(1, &g_pending_screenshots[i].m_pbo);
+    }
+    g_pending_screenshots.clear();
+}   // stopScreenshots
@@ -0,0 +1,39 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_SCREENSHOT_WRITER_HPP
+#define HEADER_SCREENSHOT_WRITER_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/** \file screenshot_writer.hpp
+ *  Saves screenshots without stalling the main thread. With the GLSL
+ *  pipeline the frame is read into a pixel buffer object, which the GPU
+ *  fills while the next frames are rendered. Once its fence is signalled
+ *  the pixels are copied into an image, which is then encoded and written
+ *  as PNG by a thread of its own.
+ *  \ingroup graphics
+ */
+
+void startScreenshot(const std::string &path);
+void updateScreenshots(std::vector<std::pair<std::string, bool> > *saved);
+void stopScreenshots();
+
+#endif
@@ -102,6 +102,8 @@
 #include "graphics/glwrap.hpp"
 #include <assert.h>
 #include <IGPUProgrammingServices.h>
+#include <stdio.h>
+#include <string.h>
 
 using namespace video;
 
@@ -142,10 +144,12 @@ static std::string LoadHeader()
     return result;
 }
 
-// Mostly from shader tutorial
-GLuint LoadShader(const char * file, unsigned type)
+/** Returns the complete source of a shader as it is passed to the driver:
+ *  the version and extension directives and the defines depending on the
+ *  available features, followed by the common header and the file content.
+ */
+std::string getShaderSource(const char * file)
 {
-    GLuint Id = glCreateShader(type);
     char versionString[20];
     sprintf(versionString, "#version %d\n", CVS->getGLSLVersion());
     std::string Code = versionString;
@@ -172,6 +176,14 @@ GLuint LoadShader(const char * file, unsigned type)
             Code += "\n" + Line;
         Stream.close();
     }
+    return Code;
+}   // getShaderSource
+
+// Mostly from shader tutorial
+GLuint LoadShader(const char * file, unsigned type)
+{
+    GLuint Id = glCreateShader(type);
+    std::string Code = getShaderSource(file);
     GLint Result = GL_FALSE;
     int InfoLogLength;
     Log::info("GLWrap", "Compiling shader : %s", file);
@@ -199,6 +211,155 @@ GLuint LoadShader(const char * file, unsigned type)
     return Id;
 }
 
+// ----------------------------------------------------------------------------
+/** Magic number and version at the start of each cached program binary. */
+static const char     PROGRAM_BINARY_MAGIC[4] = { 'S', 'P', 'R', 'G' };
+static const uint32_t PROGRAM_BINARY_VERSION  = 1;
+
+/** Returns true if linked programs are cached on disk. */
+bool useProgramBinaryCache()
+{
+    return CVS->isARBGetProgramBinaryUsable();
+}   // useProgramBinaryCache
+
+// ----------------------------------------------------------------------------
+/** Adds a string to a FNV-1a hash. */
+void hashProgramString(uint64_t *hash, const std::string &s)
+{
+    for (unsigned int i = 0; i < s.size(); i++)
+    {
+        *hash ^= (unsigned char)s[i];
+        *hash *= 1099511628211ULL;
+    }
+    // Separate consecutive strings, so that "ab"+"c" != "a"+"bc"
+    *hash ^= 0xff;
+    *hash *= 1099511628211ULL;
+}   // hashProgramString
+
+// ----------------------------------------------------------------------------
+/** Returns the initial value of the hash that identifies a cached program.
+ *  A binary is only valid for the driver that created it, so the vendor,
+ *  renderer and driver version are part of the hash; the shader sources
+ *  (which include all defines) are added by hashProgramSources().
+ */
+uint64_t getProgramBinaryHash(AttributeType Tp)
+{
+    static std::string driver;
+    if (driver.empty())
+    {
+        driver = std::string((const char*)glGetString(GL_VENDOR)) + "|"
+               + (const char*)glGetString(GL_RENDERER) + "|"
+               + (const char*)glGetString(GL_VERSION);
+    }
+    uint64_t hash = 14695981039346656037ULL;
+    hashProgramString(&hash, driver);
+    hash ^= (uint64_t)Tp;
+    hash *= 1099511628211ULL;
+    return hash;
+}   // getProgramBinaryHash
+
+// ----------------------------------------------------------------------------
+static std::string getProgramBinaryFilename(uint64_t hash)
+{
+    char name[32];
+    sprintf(name, "%016llx.bin", (unsigned long long)hash);
+    return file_manager->getCachedShadersDir() + name;
+}   // getProgramBinaryFilename
+
+// ----------------------------------------------------------------------------
+/** Tries to load a previously linked program from the cache. A cache file
+ *  contains the magic and version, the binary format and the binary itself.
+ *  The driver can still reject a binary (e.g. after a driver update that
+ *  did not change the version string), in which case the program has to
+ *  be compiled from source.
+ *  \param ProgramID The program object to load the binary into.
+ *  \param hash The hash of the program, see getProgramBinaryHash().
+ *  \return True if the program was loaded and linked successfully.
+ */
+bool loadProgramBinary(GLuint ProgramID, uint64_t hash)
+{
+    std::string filename = getProgramBinaryFilename(hash);
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return false;
+
+    char magic[4];
+    uint32_t version = 0;
+    GLenum format = 0;
+    uint32_t length = 0;
+    bool ok = fread(magic, 4, 1, f) == 1 &&
+              fread(&version, sizeof(version), 1, f) == 1 &&
+              fread(&format, sizeof(format), 1, f) == 1 &&
+              fread(&length, sizeof(length), 1, f) == 1 &&
+              memcmp(magic, PROGRAM_BINARY_MAGIC, 4) == 0 &&
+              version == PROGRAM_BINARY_VERSION && length > 0;
+    std::vector<char> binary;
+    if (ok)
+    {
+        binary.resize(length);
+        ok = fread(binary.data(), length, 1, f) == 1;
+    }
+    fclose(f);
+
+    if (ok)
+    {
+        glProgramBinary(ProgramID, format, binary.data(), length);
+        GLint Result = GL_FALSE;
+        glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+        ok = Result == GL_TRUE;
+    }
+    // Clear the error raised by a rejected binary
+    glGetError();
+    if (!ok)
+    {
+        Log::info("GLWrap", "Discarding cached program '%s'.",
+                  filename.c_str());
+        remove(filename.c_str());
+    }
+    return ok;
+}   // loadProgramBinary
+
+// ----------------------------------------------------------------------------
+/** Saves a linked program in the cache (see loadProgramBinary). The data
+ *  is first written to a temporary file, so an interrupted write never
+ *  leaves a truncated cache file.
+ */
+void saveProgramBinary(GLuint ProgramID, uint64_t hash)
+{
+    GLint length = 0;
+    glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(ProgramID, length, NULL, &format, binary.data());
+    if (glGetError() != GL_NO_ERROR)
+        return;
+
+    std::string filename = getProgramBinaryFilename(hash);
+    std::string tmp = filename + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+    {
+        Log::warn("GLWrap", "Can't write cached program '%s'.", tmp.c_str());
+        return;
+    }
+    uint32_t size = length;
+    bool ok = fwrite(PROGRAM_BINARY_MAGIC, 4, 1, f) == 1 &&
+              fwrite(&PROGRAM_BINARY_VERSION, sizeof(uint32_t), 1, f) == 1 &&
+              fwrite(&format, sizeof(format), 1, f) == 1 &&
+              fwrite(&size, sizeof(size), 1, f) == 1 &&
+              fwrite(binary.data(), size, 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    remove(filename.c_str());
+    if (!ok || rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+        Log::warn("GLWrap", "Can't write cached program '%s'.",
+                  filename.c_str());
+        remove(tmp.c_str());
+    }
+}   // saveProgramBinary
+
 void setAttribute(AttributeType Tp, GLuint ProgramID)
 {
     switch (Tp)
@@ -575,6 +736,29 @@ namespace UtilShader
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
+    DebugLine::DebugLine()
+    {
+        Program = LoadProgram(OBJECT,
+            GL_VERTEX_SHADER, file_manager->getAsset("shaders/object_pass.vert").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/vertexcolor.frag").c_str());
+
+        AssignUniforms();
+
+        // Position and color of IrrDebugDrawer::LineVertex
+        const GLsizei stride = 3 * sizeof(float) + sizeof(video::SColor);
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 0);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                              (GLvoid*)(3 * sizeof(float)));
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
     struct TexUnit
     {
         GLuint m_index;
@@ -867,6 +1051,20 @@ void BindTrilinearClampedArrayTexture(unsigned TU, unsigned tex)
     glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_ANISOTROPY_EXT, (float)aniso);
 }
 
+void BindTrilinearAnisotropicArrayTexture(unsigned TU, unsigned tex)
+{
+    glActiveTexture(GL_TEXTURE0 + TU);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, tex);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    int aniso = UserConfigParams::m_anisotropic;
+    if (aniso == 0) aniso = 1;
+    glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, (float)aniso);
+}
+
 void BindTextureVolume(GLuint TU, GLuint tex)
 {
     glActiveTexture(GL_TEXTURE0 + TU);
@@ -952,6 +1150,18 @@ namespace MeshShader
         AssignSamplerNames(Program, 0, "glosstex");
     }
 
+    InstancedObjectArrayPass1Shader::InstancedObjectArrayPass1Shader()
+    {
+        Program = LoadProgram(OBJECT,
+            GL_VERTEX_SHADER, file_manager->getAsset("shaders/utils/getworldmatrix.vert").c_str(),
+            GL_VERTEX_SHADER, file_manager->getAsset("shaders/instanced_object_array_pass.vert").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/encode_normal.frag").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/instanced_object_array_pass1.frag").c_str());
+
+        AssignUniforms();
+        AssignSamplerNames(Program, 0, "glosstex");
+    }
+
     InstancedObjectRefPass1Shader::InstancedObjectRefPass1Shader()
     {
         Program = LoadProgram(OBJECT,
@@ -1008,6 +1218,17 @@ namespace MeshShader
         AssignSamplerNames(Program, 0, "DiffuseMap", 1, "SpecularMap", 2, "SSAO", 3, "Albedo", 4, "SpecMap");
     }
 
+    InstancedObjectArrayPass2Shader::InstancedObjectArrayPass2Shader()
+    {
+        Program = LoadProgram(OBJECT,
+            GL_VERTEX_SHADER, file_manager->getAsset("shaders/utils/getworldmatrix.vert").c_str(),
+            GL_VERTEX_SHADER, file_manager->getAsset("shaders/instanced_object_array_pass.vert").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/getLightFactor.frag").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/instanced_object_array_pass2.frag").c_str());
+        AssignUniforms();
+        AssignSamplerNames(Program, 0, "DiffuseMap", 1, "SpecularMap", 2, "SSAO", 3, "Albedo", 4, "SpecMap");
+    }
+
     InstancedObjectRefPass2Shader::InstancedObjectRefPass2Shader()
     {
         Program = LoadProgram(OBJECT,
@@ -1150,6 +1371,15 @@ namespace MeshShader
         AssignSamplerNames(Program, 0, "tex");
     }
 
+    SkidMarkShader::SkidMarkShader()
+    {
+        Program = LoadProgram(OBJECT,
+            GL_VERTEX_SHADER, file_manager->getAsset("shaders/skidmark.vert").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/skidmark.frag").c_str());
+        AssignUniforms("time", "fade_time", "fogmax", "startH", "endH", "start", "end", "col");
+        AssignSamplerNames(Program, 0, "tex");
+    }
+
     BillboardShader::BillboardShader()
     {
         Program = LoadProgram(OBJECT,
@@ -1488,6 +1718,37 @@ namespace LightShader
         glVertexAttribDivisorARB(attrib_Color, 1);
         glVertexAttribDivisorARB(attrib_Radius, 1);
     }
+
+    LightClusterShader::LightClusterShader()
+    {
+        Program = LoadProgram(OBJECT,
+            GL_COMPUTE_SHADER, file_manager->getAsset("shaders/lightcluster.comp").c_str());
+        AssignUniforms("zn", "zf", "light_count");
+        glShaderStorageBlockBinding(Program, glGetProgramResourceIndex(Program, GL_SHADER_STORAGE_BLOCK, "PointLights"), 3);
+        glShaderStorageBlockBinding(Program, glGetProgramResourceIndex(Program, GL_SHADER_STORAGE_BLOCK, "LightClusters"), 4);
+
+        glGenBuffers(1, &lights_ssbo);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lights_ssbo);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_CLUSTERED_LIGHTS * sizeof(PointLightInfo), 0, GL_DYNAMIC_DRAW);
+        glGenBuffers(1, &clusters_ssbo);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusters_ssbo);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, CLUSTER_X * CLUSTER_Y * CLUSTER_Z * (MAX_LIGHTS_PER_CLUSTER + 1) * sizeof(GLuint), 0, GL_DYNAMIC_COPY);
+    }
+
+    ClusteredPointLightShader::ClusteredPointLightShader()
+    {
+        Program = LoadProgram(OBJECT,
+            GL_VERTEX_SHADER, file_manager->getAsset("shaders/screenquad.vert").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/decodeNormal.frag").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/SpecularBRDF.frag").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/DiffuseBRDF.frag").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/getPosFromUVDepth.frag").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/pointlight_clustered.frag").c_str());
+        AssignUniforms("zn", "zf");
+        AssignSamplerNames(Program, 0, "ntex", 1, "dtex");
+        glShaderStorageBlockBinding(Program, glGetProgramResourceIndex(Program, GL_SHADER_STORAGE_BLOCK, "PointLights"), 3);
+        glShaderStorageBlockBinding(Program, glGetProgramResourceIndex(Program, GL_SHADER_STORAGE_BLOCK, "LightClusters"), 4);
+    }
 }
 
 
@@ -1572,36 +1833,29 @@ namespace FullScreenShader
         AssignSamplerNames(Program, 0, "tex");
     }
 
-    BloomBlendShader::BloomBlendShader()
-    {
-        Program = LoadProgram(OBJECT,
-            GL_VERTEX_SHADER, file_manager->getAsset("shaders/screenquad.vert").c_str(),
-            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/bloomblend.frag").c_str());
-        AssignUniforms();
-
-        AssignSamplerNames(Program, 0, "tex_128", 1, "tex_256", 2, "tex_512");
-    }
-	
-	LensBlendShader::LensBlendShader()
+    ToneMapShader::ToneMapShader()
     {
         Program = LoadProgram(OBJECT,
             GL_VERTEX_SHADER, file_manager->getAsset("shaders/screenquad.vert").c_str(),
-            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/lensblend.frag").c_str());
-        AssignUniforms();
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/getRGBfromCIEXxy.frag").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/getCIEXYZ.frag").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/toneMap.frag").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/tonemap.frag").c_str());
+        AssignUniforms("vignette_weight");
 
-        AssignSamplerNames(Program, 0, "tex_128", 1, "tex_256", 2, "tex_512");
+        AssignSamplerNames(Program, 0, "tex");
     }
 
-    ToneMapShader::ToneMapShader()
+    ToneMapBloomShader::ToneMapBloomShader()
     {
         Program = LoadProgram(OBJECT,
             GL_VERTEX_SHADER, file_manager->getAsset("shaders/screenquad.vert").c_str(),
-            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/getRGBfromCIEXxy.frag").c_str(),
-            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/getCIEXYZ.frag").c_str(),
-            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/tonemap.frag").c_str());
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/utils/toneMap.frag").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/tonemap_bloom.frag").c_str());
         AssignUniforms("vignette_weight");
 
-        AssignSamplerNames(Program, 0, "text");
+        AssignSamplerNames(Program, 0, "tex", 1, "bloom_128", 2, "bloom_256", 3, "bloom_512",
+                           4, "lens_128", 5, "lens_256", 6, "lens_512");
     }
 
     DepthOfFieldShader::DepthOfFieldShader()
@@ -1752,6 +2006,15 @@ namespace FullScreenShader
         AssignSamplerNames(Program, 0, "tex", 1, "depth");
     }
 
+    BilateralUpsampleShader::BilateralUpsampleShader()
+    {
+        Program = LoadProgram(OBJECT,
+            GL_VERTEX_SHADER, file_manager->getAsset("shaders/screenquad.vert").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/bilateral_upsample.frag").c_str());
+        AssignUniforms("pixel", "source_pixel", "source_lod");
+        AssignSamplerNames(Program, 0, "source", 1, "depth");
+    }
+
     ComputeGaussian17TapHShader::ComputeGaussian17TapHShader()
     {
         Program = LoadProgram(OBJECT,
@@ -2044,6 +2307,57 @@ namespace UIShader
         AssignSamplerNames(Program, 0, "tex");
     }
 
+    Batched2DDistanceFieldShader::Batched2DDistanceFieldShader()
+    {
+        Program = LoadProgram(OBJECT,
+            GL_VERTEX_SHADER, file_manager->getAsset("shaders/batched2d.vert").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/distancefieldquad.frag").c_str());
+        AssignUniforms();
+        AssignSamplerNames(Program, 0, "tex");
+    }
+
+    Batched2DShader::Batched2DShader()
+    {
+        Program = LoadProgram(OBJECT,
+            GL_VERTEX_SHADER, file_manager->getAsset("shaders/batched2d.vert").c_str(),
+            GL_FRAGMENT_SHADER, file_manager->getAsset("shaders/colortexturedquad.frag").c_str());
+        AssignUniforms();
+        AssignSamplerNames(Program, 0, "tex");
+
+        // Each vertex is x, y (in NDC), u, v and the color as 4 bytes
+        const GLsizei stride = 4 * sizeof(float) + sizeof(video::SColor);
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, MAX_QUADS * 4 * stride, 0, GL_STREAM_DRAW);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(2);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, 0);
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid *)(2 * sizeof(float)));
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (GLvoid *)(4 * sizeof(float)));
+
+        // The quads are drawn as two triangles, the order of the vertices
+        // of a quad is the same as in quad_buffer
+        std::vector<u16> indices(MAX_QUADS * 6);
+        for (unsigned i = 0; i < MAX_QUADS; i++)
+        {
+            indices[6 * i + 0] = 4 * i + 0;
+            indices[6 * i + 1] = 4 * i + 1;
+            indices[6 * i + 2] = 4 * i + 2;
+            indices[6 * i + 3] = 4 * i + 2;
+            indices[6 * i + 4] = 4 * i + 1;
+            indices[6 * i + 5] = 4 * i + 3;
+        }
+        glGenBuffers(1, &ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(u16), indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
     TextureRectShader::TextureRectShader()
     {
         Program = LoadProgram(OBJECT,
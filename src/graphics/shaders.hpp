@@ -47,6 +47,15 @@ public:
     ColoredLine();
 };
 
+/** Draws lines with a color per vertex, used for the bullet debug view. */
+class DebugLine : public ShaderHelperSingleton<DebugLine>
+{
+public:
+    GLuint vao, vbo;
+
+    DebugLine();
+};
+
 class SpecularIBLGenerator : public ShaderHelperSingleton<SpecularIBLGenerator, core::matrix4, float >, public TextureRead<Trilinear_cubemap>
 {
 public:
@@ -88,6 +97,14 @@ public:
     InstancedObjectPass1Shader();
 };
 
+/** Pass 1 of the solid meshes whose textures are packed in texture arrays,
+ *  see TextureArrayManager. */
+class InstancedObjectArrayPass1Shader : public ShaderHelperSingleton<InstancedObjectArrayPass1Shader>, public TextureRead<Trilinear_Anisotropic_Array2D>
+{
+public:
+    InstancedObjectArrayPass1Shader();
+};
+
 class InstancedObjectRefPass1Shader : public ShaderHelperSingleton<InstancedObjectRefPass1Shader>, public TextureRead<Trilinear_Anisotropic_Filtered, Trilinear_Anisotropic_Filtered>
 {
 public:
@@ -118,6 +135,14 @@ public:
     InstancedObjectPass2Shader();
 };
 
+/** Pass 2 of the solid meshes whose textures are packed in texture arrays,
+ *  see TextureArrayManager. */
+class InstancedObjectArrayPass2Shader : public ShaderHelperSingleton<InstancedObjectArrayPass2Shader>, public TextureRead<Nearest_Filtered, Nearest_Filtered, Bilinear_Filtered, Trilinear_Anisotropic_Array2D, Trilinear_Anisotropic_Array2D>
+{
+public:
+    InstancedObjectArrayPass2Shader();
+};
+
 class InstancedObjectRefPass2Shader : public ShaderHelperSingleton<InstancedObjectRefPass2Shader>, public TextureRead<Nearest_Filtered, Nearest_Filtered, Bilinear_Filtered, Trilinear_Anisotropic_Filtered, Trilinear_Anisotropic_Filtered>
 {
 public:
@@ -196,6 +221,12 @@ public:
     TransparentFogShader();
 };
 
+class SkidMarkShader : public ShaderHelperSingleton<SkidMarkShader, float, float, float, float, float, float, float, video::SColorf>, public TextureRead<Trilinear_Anisotropic_Filtered>
+{
+public:
+    SkidMarkShader();
+};
+
 class BillboardShader : public ShaderHelperSingleton<BillboardShader, core::matrix4, core::matrix4, core::vector3df, core::dimension2df>, public TextureRead<Trilinear_Anisotropic_Filtered>
 {
 public:
@@ -307,6 +338,16 @@ public:
 
 #define MAXLIGHT 32
 
+// Clustered lighting: number of clusters along the screen axes and in depth,
+// the maximum number of lights in one cluster, and in the whole view.
+// These must match the constants in lightcluster.comp and
+// pointlight_clustered.frag.
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 63
+#define MAX_CLUSTERED_LIGHTS 1024
+
 namespace LightShader
 {
     struct PointLightInfo
@@ -337,6 +378,24 @@ namespace LightShader
         GLuint vao;
         PointLightScatterShader();
     };
+
+    /** Compute shader that stores the lights affecting each cluster. */
+    class LightClusterShader : public ShaderHelperSingleton<LightClusterShader, float, float, int>
+    {
+    public:
+        /** The PointLightInfo of all lights. */
+        GLuint lights_ssbo;
+        /** For each cluster the number of lights and their indices. */
+        GLuint clusters_ssbo;
+        LightClusterShader();
+    };
+
+    /** Shades each pixel with the lights of its cluster. */
+    class ClusteredPointLightShader : public ShaderHelperSingleton<ClusteredPointLightShader, float, float>, public TextureRead<Nearest_Filtered, Nearest_Filtered>
+    {
+    public:
+        ClusteredPointLightShader();
+    };
 }
 
 namespace ParticleShader
@@ -389,24 +448,21 @@ public:
     BloomShader();
 };
 
-class BloomBlendShader : public ShaderHelperSingleton<BloomBlendShader>, public TextureRead<Bilinear_Filtered, Bilinear_Filtered, Bilinear_Filtered>
-{
-public:
-    BloomBlendShader();
-};
 
-class LensBlendShader : public ShaderHelperSingleton<LensBlendShader>, public TextureRead<Bilinear_Filtered, Bilinear_Filtered, Bilinear_Filtered>
+class ToneMapShader : public ShaderHelperSingleton<ToneMapShader, float>, public TextureRead<Nearest_Filtered>
 {
 public:
-    LensBlendShader();
-};
 
+    ToneMapShader();
+};
 
-class ToneMapShader : public ShaderHelperSingleton<ToneMapShader, float>, public TextureRead<Nearest_Filtered>
+class ToneMapBloomShader : public ShaderHelperSingleton<ToneMapBloomShader, float>,
+    public TextureRead<Nearest_Filtered, Bilinear_Filtered, Bilinear_Filtered, Bilinear_Filtered,
+                       Bilinear_Filtered, Bilinear_Filtered, Bilinear_Filtered>
 {
 public:
 
-    ToneMapShader();
+    ToneMapBloomShader();
 };
 
 class DepthOfFieldShader : public ShaderHelperSingleton<DepthOfFieldShader>, public TextureRead<Bilinear_Filtered, Nearest_Filtered>
@@ -479,6 +535,12 @@ public:
     Gaussian17TapHShader();
 };
 
+class BilateralUpsampleShader : public ShaderHelperSingleton<BilateralUpsampleShader, core::vector2df, core::vector2df, float>, public TextureRead<Neared_Clamped_Filtered, Semi_trilinear>
+{
+public:
+    BilateralUpsampleShader();
+};
+
 class ComputeGaussian17TapHShader : public ShaderHelperSingleton<ComputeGaussian17TapHShader, core::vector2df>, public TextureRead<Neared_Clamped_Filtered, Neared_Clamped_Filtered>
 {
 public:
@@ -664,6 +726,28 @@ public:
     Primitive2DList();
 };
 
+/** Draws the quads collected by the 2D batch, see begin2DBatch(). */
+class Batched2DShader : public ShaderHelperSingleton<Batched2DShader>, public TextureRead<Bilinear_Filtered>
+{
+public:
+    /** Maximum number of quads of a draw call, limited by the 16 bit
+     *  indices. */
+    static const unsigned MAX_QUADS = 4096;
+    GLuint vao;
+    GLuint vbo;
+    GLuint ibo;
+
+    Batched2DShader();
+};
+
+/** Draws the quads collected by the 2D batch from a distance field, with the
+ *  vertex array of Batched2DShader. */
+class Batched2DDistanceFieldShader : public ShaderHelperSingleton<Batched2DDistanceFieldShader>, public TextureRead<Bilinear_Filtered>
+{
+public:
+    Batched2DDistanceFieldShader();
+};
+
 class TextureRectShader : public ShaderHelperSingleton<TextureRectShader, core::vector2df, core::vector2df, core::vector2df, core::vector2df>, public TextureRead<Bilinear_Filtered>
 {
 public:
@@ -19,6 +19,7 @@
 #define SHADERS_UTIL_HPP
 
 #include "utils/singleton.hpp"
+#include <string>
 #include <vector>
 #include <matrix4.h>
 #include <SColor.h>
@@ -29,6 +30,7 @@ bool needsUBO();
 
 unsigned getGLSLVersion();
 
+std::string getShaderSource(const char * file);
 GLuint LoadShader(const char * file, unsigned type);
 GLuint LoadTFBProgram(const char * vertex_file_path, const char **varyings, unsigned varyingscount);
 
@@ -69,10 +71,43 @@ enum AttributeType
 
 void setAttribute(AttributeType Tp, GLuint ProgramID);
 
+bool useProgramBinaryCache();
+void hashProgramString(uint64_t *hash, const std::string &s);
+uint64_t getProgramBinaryHash(AttributeType Tp);
+bool loadProgramBinary(GLuint ProgramID, uint64_t hash);
+void saveProgramBinary(GLuint ProgramID, uint64_t hash);
+
+template<typename ... Types>
+void hashProgramSources(uint64_t *hash)
+{
+    return;
+}
+
+/** Adds the type and complete source of each shader to the hash of a
+ *  program, so that a cached binary is never used for modified shaders. */
+template<typename ... Types>
+void hashProgramSources(uint64_t *hash, GLint ShaderType, const char *filepath, Types ... args)
+{
+    *hash ^= (uint64_t)ShaderType;
+    *hash *= 1099511628211ULL;
+    hashProgramString(hash, getShaderSource(filepath));
+    hashProgramSources(hash, args...);
+}
+
 template<typename ... Types>
 GLint LoadProgram(AttributeType Tp, Types ... args)
 {
     GLint ProgramID = glCreateProgram();
+    uint64_t hash = 0;
+    bool use_cache = useProgramBinaryCache();
+    if (use_cache)
+    {
+        hash = getProgramBinaryHash(Tp);
+        hashProgramSources(&hash, args...);
+        if (loadProgramBinary(ProgramID, hash))
+            return ProgramID;
+        glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     loadAndAttach(ProgramID, args...);
     if (getGLSLVersion() < 330)
         setAttribute(Tp, ProgramID);
@@ -90,6 +125,8 @@ GLint LoadProgram(AttributeType Tp, Types ... args)
         Log::error("GLWrapp", ErrorMessage);
         delete[] ErrorMessage;
     }
+    else if (use_cache)
+        saveProgramBinary(ProgramID, hash);
 
     GLenum glErr = glGetError();
     if (glErr != GL_NO_ERROR)
@@ -239,6 +276,7 @@ enum SamplerType {
     Volume_Linear_Filtered,
     Trilinear_cubemap,
     Trilinear_Clamped_Array2D,
+    Trilinear_Anisotropic_Array2D,
 };
 
 void setTextureSampler(GLenum, GLuint, GLuint, GLuint);
@@ -530,6 +568,29 @@ struct BindTexture<Trilinear_Clamped_Array2D, tp...>
     }
 };
 
+template<SamplerType...tp>
+struct CreateSamplers<Trilinear_Anisotropic_Array2D, tp...>
+{
+    static void exec(std::vector<unsigned> &v, std::vector<GLenum> &e)
+    {
+        v.push_back(createTrilinearSampler());
+        e.push_back(GL_TEXTURE_2D_ARRAY);
+        CreateSamplers<tp...>::exec(v, e);
+    }
+};
+
+void BindTrilinearAnisotropicArrayTexture(unsigned TU, unsigned tex);
+
+template<SamplerType...tp>
+struct BindTexture<Trilinear_Anisotropic_Array2D, tp...>
+{
+    template <int N, typename...Args>
+    static void exec(const std::vector<unsigned> &TU, GLuint TexId, Args... args)
+    {
+        BindTrilinearAnisotropicArrayTexture(TU[N], TexId);
+        BindTexture<tp...>::template exec<N + 1>(TU, args...);
+    }
+};
 
 template<SamplerType...tp>
 class TextureRead
@@ -16,11 +16,14 @@
 //  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 
+#include <cmath>
 #include <limits>
 #include <ICameraSceneNode.h>
 #include <SViewFrustum.h>
 #include "../../lib/irrlicht/source/Irrlicht/CSceneManager.h"
 #include "../../lib/irrlicht/source/Irrlicht/os.h"
+#include "config/user_config.hpp"
+#include "graphics/camera.hpp"
 #include "graphics/central_settings.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/shaders.hpp"
@@ -92,6 +95,87 @@ getTighestFitOrthoProj(const core::matrix4 &transform, const std::vector<vector3
     return tmp_matrix;
 }
 
+/** Fraction of the size of a cached cascade it is enlarged by on each side,
+ *  so that the camera can move for a while before the cache must be
+ *  rendered again. */
+static const float SHADOW_CACHE_MARGIN = 0.15f;
+
+/** Returns the projection of a cascade whose static geometry is cached. The
+ *  projection the cache was rendered with is kept as long as the light space
+ *  box of the cascade stays inside the box of the cache. Otherwise a new,
+ *  enlarged box is computed and snapped to the shadow map texels, and the
+ *  cache is marked to be rendered again.
+ *  \param cascade Index of the cascade.
+ *  \param sun_view View matrix of the sun camera.
+ *  \param points The corners of the view frustum of the cascade.
+ */
+core::matrix4 IrrDriver::getCachedShadowProjection(unsigned cascade,
+                                        const core::matrix4 &sun_view,
+                                        const std::vector<vector3df> &points)
+{
+    core::aabbox3df box(std::numeric_limits<float>::infinity(),
+                        std::numeric_limits<float>::infinity(),
+                        std::numeric_limits<float>::infinity(),
+                        -std::numeric_limits<float>::infinity(),
+                        -std::numeric_limits<float>::infinity(),
+                        -std::numeric_limits<float>::infinity());
+    for (unsigned i = 0; i < points.size(); i++)
+    {
+        vector3df transformed;
+        sun_view.transformVect(transformed, points[i]);
+        box.MinEdge.X = MIN2(box.MinEdge.X, transformed.X);
+        box.MinEdge.Y = MIN2(box.MinEdge.Y, transformed.Y);
+        box.MinEdge.Z = MIN2(box.MinEdge.Z, transformed.Z);
+        box.MaxEdge.X = MAX2(box.MaxEdge.X, transformed.X);
+        box.MaxEdge.Y = MAX2(box.MaxEdge.Y, transformed.Y);
+        box.MaxEdge.Z = MAX2(box.MaxEdge.Z, transformed.Z);
+    }
+
+    if (m_shadow_cache_rendered[cascade] &&
+        m_shadow_cache_sun_view[cascade] == sun_view &&
+        box.isFullInside(m_shadow_cache_box[cascade]))
+    {
+        m_shadow_scales[cascade] = m_shadow_cache_scale[cascade];
+        return m_shadow_cache_projection[cascade];
+    }
+
+    const vector3df extent = box.getExtent();
+    const float margin = SHADOW_CACHE_MARGIN * MAX2(extent.X, extent.Y);
+    box.MinEdge -= vector3df(margin, margin, margin);
+    box.MaxEdge += vector3df(margin, margin, margin);
+
+    // Snap the box to the texels, so that the cache and the dynamic
+    // casters are rasterized consistently when the cache is updated.
+    const float resolution = float(UserConfigParams::m_shadows_resolution);
+    const float texel_x = (extent.X + 2 * margin) / resolution;
+    const float texel_y = (extent.Y + 2 * margin) / resolution;
+    if (texel_x > 0 && texel_y > 0)
+    {
+        box.MinEdge.X = texel_x * floorf(box.MinEdge.X / texel_x);
+        box.MinEdge.Y = texel_y * floorf(box.MinEdge.Y / texel_y);
+        box.MaxEdge.X = texel_x * ceilf(box.MaxEdge.X / texel_x);
+        box.MaxEdge.Y = texel_y * ceilf(box.MaxEdge.Y / texel_y);
+    }
+
+    core::matrix4 projection;
+    m_shadow_cache_scale[cascade].first = box.MaxEdge.X - box.MinEdge.X;
+    m_shadow_cache_scale[cascade].second = box.MaxEdge.Y - box.MinEdge.Y;
+    // Prevent Matrix without extend
+    if (box.MinEdge.X != box.MaxEdge.X && box.MinEdge.Y != box.MaxEdge.Y)
+    {
+        projection.buildProjectionMatrixOrthoLH(box.MinEdge.X, box.MaxEdge.X,
+                                                box.MaxEdge.Y, box.MinEdge.Y,
+                                                box.MinEdge.Z - 100,
+                                                box.MaxEdge.Z);
+    }
+    m_shadow_cache_box[cascade] = box;
+    m_shadow_cache_projection[cascade] = projection;
+    m_shadow_cache_sun_view[cascade] = sun_view;
+    m_shadow_cache_rendered[cascade] = false;
+    m_shadow_scales[cascade] = m_shadow_cache_scale[cascade];
+    return projection;
+}   // getCachedShadowProjection
+
 float shadowSplit[5] = { 1., 5., 20., 50., 150 };
 
 struct CascadeBoundingBox
@@ -174,6 +258,19 @@ and matrixes and cameras for the four shadow cascade and RSM.
 *   \param width of the rendering viewport
 *   \param height of the rendering viewport
 */
+/** Changes the size of the target the full screen passes that follow render
+ *  to, as read by the shaders from the screen uniform. Used by the passes
+ *  rendered at a lower resolution; the size must be reset afterwards.
+ */
+void IrrDriver::setCurrentScreenSize(const core::vector2df &size)
+{
+    m_current_screen_size = size;
+    float tmp[2] = { size.X, size.Y };
+    glBindBuffer(GL_UNIFORM_BUFFER, SharedObject::ViewProjectionMatrixesUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, (16 * 9) * sizeof(float), 2 * sizeof(float), tmp);
+}
+
+// ----------------------------------------------------------------------------
 void IrrDriver::computeMatrixesAndCameras(scene::ICameraSceneNode * const camnode, size_t width, size_t height)
 {
     if (CVS->isSDSMEnabled())
@@ -216,6 +313,7 @@ void IrrDriver::computeMatrixesAndCameras(scene::ICameraSceneNode * const camnod
         if (m_shadow_camnodes[i])
             delete m_shadow_camnodes[i];
         m_shadow_camnodes[i] = (scene::ICameraSceneNode *) m_suncam->clone();
+        m_shadow_cache_used[i] = false;
     }
     sun_ortho_matrix.clear();
     const core::matrix4 &SunCamViewMatrix = m_suncam->getViewMatrix();
@@ -232,6 +330,11 @@ void IrrDriver::computeMatrixesAndCameras(scene::ICameraSceneNode * const camnod
         core::aabbox3df trackbox(vmin.toIrrVector(), vmax.toIrrVector() -
             core::vector3df(0, 30, 0));
 
+        // The shadow cache is only used with one camera, since each camera
+        // would need its own cache.
+        const bool use_shadow_cache = CVS->isStaticShadowCacheEnabled() &&
+                                      Camera::getNumCameras() <= 1;
+
         // Shadow Matrixes and cameras
         for (unsigned i = 0; i < 4; i++)
         {
@@ -270,7 +373,12 @@ void IrrDriver::computeMatrixesAndCameras(scene::ICameraSceneNode * const camnod
             memcpy(m_shadows_cam[i], tmp, 24 * sizeof(float));
 
             std::vector<vector3df> vectors = getFrustrumVertex(*frustrum);
-            tmp_matrix = getTighestFitOrthoProj(SunCamViewMatrix, vectors, m_shadow_scales[i]);
+            m_shadow_cache_used[i] = use_shadow_cache &&
+                                     i >= FIRST_CACHED_CASCADE;
+            if (m_shadow_cache_used[i])
+                tmp_matrix = getCachedShadowProjection(i, SunCamViewMatrix, vectors);
+            else
+                tmp_matrix = getTighestFitOrthoProj(SunCamViewMatrix, vectors, m_shadow_scales[i]);
 
 
             m_shadow_camnodes[i]->setProjectionMatrix(tmp_matrix, true);
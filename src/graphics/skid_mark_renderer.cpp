@@ -0,0 +1,225 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/skid_mark_renderer.hpp"
+
+#include "config/stk_config.hpp"
+#include "graphics/irr_driver.hpp"
+#include "graphics/shaders.hpp"
+#include "graphics/texturemanager.hpp"
+#include "modes/world.hpp"
+#include "tracks/track.hpp"
+
+#include <algorithm>
+#include <stddef.h>
+
+// ----------------------------------------------------------------------------
+SkidMarkRenderer::SkidMarkRenderer()
+{
+    m_segments.resize(MAX_SEGMENTS);
+    m_owners.resize(MAX_SEGMENTS, NULL);
+    m_next        = 0;
+    m_count       = 0;
+    m_dirty_first = MAX_SEGMENTS;
+    m_dirty_last  = 0;
+    m_vbo         = 0;
+    m_vao         = 0;
+    m_time        = 0.0f;
+    m_texture     = irr_driver->getTexture("skidmarks.png");
+    // Keep the texture alive, the renderer lives longer than a race
+    if (m_texture)
+        m_texture->grab();
+}   // SkidMarkRenderer
+
+// ----------------------------------------------------------------------------
+SkidMarkRenderer::~SkidMarkRenderer()
+{
+    if (m_vao)
+    {
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vbo);
+    }
+    if (m_texture)
+        m_texture->drop();
+}   // ~SkidMarkRenderer
+
+// ----------------------------------------------------------------------------
+/** Creates the ring buffer and the vertex array that reads one segment per
+ *  instance.
+ */
+void SkidMarkRenderer::createBuffers()
+{
+    GLuint program = MeshShader::SkidMarkShader::getInstance()->Program;
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, MAX_SEGMENTS * sizeof(Segment), 0,
+                 GL_DYNAMIC_DRAW);
+
+    const char *names[] = { "Start", "End", "StartSide", "EndSide" };
+    const size_t offsets[] = { offsetof(Segment, m_start),
+                               offsetof(Segment, m_end),
+                               offsetof(Segment, m_start_side),
+                               offsetof(Segment, m_end_side) };
+    for (unsigned i = 0; i < 4; i++)
+    {
+        GLuint attrib = glGetAttribLocation(program, names[i]);
+        glEnableVertexAttribArray(attrib);
+        glVertexAttribPointer(attrib, 4, GL_FLOAT, GL_FALSE, sizeof(Segment),
+                              (GLvoid*)offsets[i]);
+        glVertexAttribDivisorARB(attrib, 1);
+    }
+    GLuint attrib_birth = glGetAttribLocation(program, "BirthTime");
+    glEnableVertexAttribArray(attrib_birth);
+    glVertexAttribPointer(attrib_birth, 1, GL_FLOAT, GL_FALSE, sizeof(Segment),
+                          (GLvoid*)offsetof(Segment, m_birth_time));
+    glVertexAttribDivisorARB(attrib_birth, 1);
+    GLuint attrib_color = glGetAttribLocation(program, "Color");
+    glEnableVertexAttribArray(attrib_color);
+    glVertexAttribPointer(attrib_color, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(Segment),
+                          (GLvoid*)offsetof(Segment, m_color));
+    glVertexAttribDivisorARB(attrib_color, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // Everything written before the buffer existed must be uploaded
+    markDirty(0, m_count);
+}   // createBuffers
+
+// ----------------------------------------------------------------------------
+/** Adds the segments first to last (excluded) to the range to upload. */
+void SkidMarkRenderer::markDirty(unsigned first, unsigned last)
+{
+    m_dirty_first = std::min(m_dirty_first, first);
+    m_dirty_last  = std::max(m_dirty_last,  last);
+}   // markDirty
+
+// ----------------------------------------------------------------------------
+/** Adds a segment to the ring.
+ *  \param owner The skid marks the segment belongs to.
+ *  \param start,end Centers of the start and end cross sections.
+ *  \param start_side,end_side Half of the start and end cross sections.
+ *  \param start_v,end_v Texture coordinates along the mark.
+ *  \param previous The previous segment of the same mark as returned by
+ *         this function, or -1 if this is the first segment of a mark. The
+ *         first segment fades in, and the last one fades out towards its
+ *         end.
+ *  \return Index of the segment, to be passed as previous segment.
+ */
+int SkidMarkRenderer::addSegment(const SkidMarks *owner, const Vec3 &start,
+                                 const Vec3 &start_side, float start_v,
+                                 const Vec3 &end, const Vec3 &end_side,
+                                 float end_v, const video::SColor &color,
+                                 int previous)
+{
+    // The previous segment isn't the last one of its mark anymore
+    if (previous >= 0 && m_owners[previous] == owner)
+    {
+        m_segments[previous].m_end_side[3] = 1.0f;
+        markDirty(previous, previous + 1);
+    }
+
+    unsigned index = m_next;
+    Segment &segment = m_segments[index];
+    for (unsigned i = 0; i < 3; i++)
+    {
+        segment.m_start[i]      = start[i];
+        segment.m_end[i]        = end[i];
+        segment.m_start_side[i] = start_side[i];
+        segment.m_end_side[i]   = end_side[i];
+    }
+    segment.m_start[3]      = start_v;
+    segment.m_end[3]        = end_v;
+    segment.m_start_side[3] = previous >= 0 ? 1.0f : 0.0f;
+    segment.m_end_side[3]   = 0.0f;
+    segment.m_birth_time    = m_time;
+    segment.m_color         = color;
+    m_owners[index]         = owner;
+
+    markDirty(index, index + 1);
+    m_next = (m_next + 1) % MAX_SEGMENTS;
+    m_count = std::max(m_count, index + 1);
+    return (int)index;
+}   // addSegment
+
+// ----------------------------------------------------------------------------
+/** Hides all segments of a skid marks object, called when it is reset or
+ *  deleted.
+ */
+void SkidMarkRenderer::removeSegments(const SkidMarks *owner)
+{
+    for (unsigned i = 0; i < m_count; i++)
+    {
+        if (m_owners[i] != owner)
+            continue;
+        m_owners[i] = NULL;
+        m_segments[i].m_color.setAlpha(0);
+        markDirty(i, i + 1);
+    }
+}   // removeSegments
+
+// ----------------------------------------------------------------------------
+/** Uploads the changed segments and draws all of them. Must be called in the
+ *  transparent pass, with premultiplied alpha blending.
+ */
+void SkidMarkRenderer::render()
+{
+    if (m_count == 0 || !m_texture)
+        return;
+    if (!m_vao)
+        createBuffers();
+
+    if (m_dirty_first < m_dirty_last)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, m_dirty_first * sizeof(Segment),
+                        (m_dirty_last - m_dirty_first) * sizeof(Segment),
+                        &m_segments[m_dirty_first]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        m_dirty_first = MAX_SEGMENTS;
+        m_dirty_last  = 0;
+    }
+
+    float fogmax = 0.0f, startH = 0.0f, endH = 0.0f, start = 0.0f, end = 1.0f;
+    video::SColorf col(0.0f, 0.0f, 0.0f);
+    if (World::getWorld() && World::getWorld()->isFogEnabled())
+    {
+        const Track * const track = World::getWorld()->getTrack();
+        fogmax = track->getFogMax();
+        startH = track->getFogStartHeight();
+        endH   = track->getFogEndHeight();
+        start  = track->getFogStart();
+        end    = track->getFogEnd();
+        const video::SColor tmpcol = track->getFogColor();
+        col = video::SColorf(tmpcol.getRed() / 255.0f,
+                             tmpcol.getGreen() / 255.0f,
+                             tmpcol.getBlue() / 255.0f);
+    }
+
+    compressTexture(m_texture, true);
+    glUseProgram(MeshShader::SkidMarkShader::getInstance()->Program);
+    glBindVertexArray(m_vao);
+    MeshShader::SkidMarkShader::getInstance()->SetTextureUnits(
+                                                 getTextureGLuint(m_texture));
+    MeshShader::SkidMarkShader::getInstance()->setUniforms(m_time,
+        stk_config->m_skid_fadeout_time, fogmax, startH, endH, start, end,
+        col);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_count);
+    glBindVertexArray(0);
+}   // render
@@ -0,0 +1,109 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_SKID_MARK_RENDERER_HPP
+#define HEADER_SKID_MARK_RENDERER_HPP
+
+#include "graphics/gl_headers.hpp"
+#include "utils/no_copy.hpp"
+#include "utils/singleton.hpp"
+#include "utils/vec3.hpp"
+
+#include <SColor.h>
+#include <vector>
+
+namespace irr
+{
+    namespace video { class ITexture; }
+}
+using namespace irr;
+
+class SkidMarks;
+
+/** Draws the skid marks of all karts with the GLSL pipeline. The segments of
+ *  all skid marks (a segment is the quad between two consecutive cross
+ *  sections of a mark) are stored in one ring buffer on the GPU and drawn
+ *  with a single instanced draw call in the transparent pass. Each segment
+ *  stores the time it was added at, and the vertex shader fades it out
+ *  from its age, so that nothing has to be rewritten on the CPU while the
+ *  marks fade. When the ring is full the oldest segments are overwritten,
+ *  which is invisible as long as they have faded out.
+ *  \ingroup graphics
+ */
+class SkidMarkRenderer : public Singleton<SkidMarkRenderer>, public NoCopy
+{
+    friend class Singleton<SkidMarkRenderer>;
+private:
+    /** One segment as stored in the vertex buffer, read as per instance
+     *  attributes. */
+    struct Segment
+    {
+        /** Center of the start cross section, and texture coordinate along
+         *  the mark. */
+        float         m_start[4];
+        /** Center of the end cross section, and texture coordinate. */
+        float         m_end[4];
+        /** Half width vector at the start, and alpha at the start. */
+        float         m_start_side[4];
+        /** Half width vector at the end, and alpha at the end. */
+        float         m_end_side[4];
+        /** Time the segment was added at. */
+        float         m_birth_time;
+        video::SColor m_color;
+    };   // Segment
+
+    /** Number of segments in the ring. */
+    static const unsigned MAX_SEGMENTS = 16384;
+
+    /** Copy of the ring, the changed part is uploaded before drawing. */
+    std::vector<Segment>          m_segments;
+    /** Skid marks each segment belongs to, or NULL if removed. */
+    std::vector<const SkidMarks*> m_owners;
+    /** Index of the next segment to write. */
+    unsigned         m_next;
+    /** Number of segments written so far, at most MAX_SEGMENTS. */
+    unsigned         m_count;
+    /** Range of segments changed since the last upload. */
+    unsigned         m_dirty_first, m_dirty_last;
+
+    GLuint           m_vbo;
+    GLuint           m_vao;
+    video::ITexture *m_texture;
+
+    /** Time the segments age with. */
+    float            m_time;
+
+    void     createBuffers();
+    void     markDirty(unsigned first, unsigned last);
+
+             SkidMarkRenderer();
+    virtual ~SkidMarkRenderer();
+
+public:
+    int      addSegment(const SkidMarks *owner, const Vec3 &start,
+                        const Vec3 &start_side, float start_v,
+                        const Vec3 &end, const Vec3 &end_side, float end_v,
+                        const video::SColor &color, int previous);
+    void     removeSegments(const SkidMarks *owner);
+    void     render();
+    // ------------------------------------------------------------------------
+    /** Advances the time the segments fade with, called once per world
+     *  update. */
+    void     update(float dt) { m_time += dt; }
+};   // SkidMarkRenderer
+
+#endif
@@ -20,7 +20,9 @@
 #include "graphics/skid_marks.hpp"
 
 #include "config/stk_config.hpp"
+#include "graphics/central_settings.hpp"
 #include "graphics/irr_driver.hpp"
+#include "graphics/skid_mark_renderer.hpp"
 #include "karts/controller/controller.hpp"
 #include "karts/abstract_kart.hpp"
 #include "karts/skidding.hpp"
@@ -55,6 +57,9 @@ SkidMarks::SkidMarks(const AbstractKart& kart, float width) : m_kart(kart)
     m_material->TextureLayer[0].Texture = irr_driver->getTexture("skidmarks.png");
     m_skid_marking            = false;
     m_current                 = -1;
+    m_last_v                  = 0.0f;
+    m_last_segment[0]         = -1;
+    m_last_segment[1]         = -1;
 }   // SkidMark
 
 //-----------------------------------------------------------------------------
@@ -81,6 +86,8 @@ void SkidMarks::reset()
     m_nodes.clear();
     m_skid_marking = false;
     m_current      = -1;
+    if (CVS->isGLSL())
+        SkidMarkRenderer::getInstance()->removeSegments(this);
 }   // reset
 
 //-----------------------------------------------------------------------------
@@ -95,11 +102,15 @@ void SkidMarks::update(float dt, bool force_skid_marks,
     if(m_kart.isWheeless())
         return;
 
-    float f = dt/stk_config->m_skid_fadeout_time*m_start_alpha;
-    for(unsigned int i=0; i<m_left.size(); i++)
+    // The GLSL renderer fades the marks in the vertex shader
+    if (!CVS->isGLSL())
     {
-        m_left[i]->fade(f);
-        m_right[i]->fade(f);
+        float f = dt/stk_config->m_skid_fadeout_time*m_start_alpha;
+        for(unsigned int i=0; i<m_left.size(); i++)
+        {
+            m_left[i]->fade(f);
+            m_right[i]->fade(f);
+        }
     }
 
     // Get raycast information
@@ -131,6 +142,8 @@ void SkidMarks::update(float dt, bool force_skid_marks,
         if (!is_skidding)   // end skid marking
         {
             m_skid_marking = false;
+            if (CVS->isGLSL())
+                return;
             // The vertices and indices will not change anymore
             // (till these skid mark quads are deleted)
             m_left[m_current]->setHardwareMappingHint(scene::EHM_STATIC);
@@ -146,6 +159,12 @@ void SkidMarks::update(float dt, bool force_skid_marks,
         delta.normalize();
         delta *= m_width*0.5f;
 
+        if (CVS->isGLSL())
+        {
+            addSegments(raycast_left, raycast_right, delta);
+            return;
+        }
+
         Vec3 start = m_left[m_current]->getCenterStart();
         Vec3 newPoint = (raycast_left + raycast_right)/2;
         // this linear distance does not account for the kart turning, it's true,
@@ -179,6 +198,26 @@ void SkidMarks::update(float dt, bool force_skid_marks,
     delta.normalize();
     delta *= m_width*0.5f;
 
+    if (CVS->isGLSL())
+    {
+        m_color = custom_color != NULL ? *custom_color
+                                       : video::SColor(255, m_start_grey,
+                                                       m_start_grey,
+                                                       m_start_grey);
+        m_color.setAlpha(m_start_alpha);
+        m_last_center[0]  = raycast_left;
+        m_last_center[1]  = raycast_right;
+        m_last_center[0].setY(raycast_left.getY() + m_avoid_z_fighting);
+        m_last_center[1].setY(raycast_right.getY() + m_avoid_z_fighting);
+        m_last_side       = delta;
+        m_last_v          = 0.0f;
+        m_last_segment[0] = -1;
+        m_last_segment[1] = -1;
+        m_center_start    = (raycast_left + raycast_right)/2;
+        m_skid_marking    = true;
+        return;
+    }
+
     SkidMarkQuads *smq_left =
         new SkidMarkQuads(raycast_left-delta, raycast_left+delta ,
                           m_material, m_avoid_z_fighting, custom_color);
@@ -230,6 +269,32 @@ void SkidMarks::update(float dt, bool force_skid_marks,
     m_right[m_current]->setHardwareMappingHint(scene::EHM_STREAM);
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Adds the segments from the last cross section of both marks to the
+ *  current one to the SkidMarkRenderer.
+ *  \param left,right Centers of the current cross sections.
+ *  \param side Half width of the current cross sections.
+ */
+void SkidMarks::addSegments(const Vec3 &left, const Vec3 &right,
+                            const Vec3 &side)
+{
+    // this linear distance does not account for the kart turning, it's true,
+    // but it produces good enough results
+    float v = ((left + right)/2 - m_center_start).length()*0.5f;
+    const Vec3 center[2] = { left, right };
+    for (unsigned i = 0; i < 2; i++)
+    {
+        Vec3 end = center[i];
+        end.setY(end.getY() + m_avoid_z_fighting);
+        m_last_segment[i] = SkidMarkRenderer::getInstance()
+            ->addSegment(this, m_last_center[i], m_last_side, m_last_v, end,
+                         side, v, m_color, m_last_segment[i]);
+        m_last_center[i] = end;
+    }
+    m_last_side = side;
+    m_last_v    = v;
+}   // addSegments
+
 //=============================================================================
 SkidMarks::SkidMarkQuads::SkidMarkQuads(const Vec3 &left,
                                         const Vec3 &right,
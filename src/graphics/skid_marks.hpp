@@ -107,6 +107,24 @@ private:
      *  different height. */
     static float                  m_avoid_z_fighting;
 
+    // With the GLSL pipeline the marks are drawn by the SkidMarkRenderer,
+    // which only needs the latest cross section of each mark.
+    /** Center (left and right wheel) of the last added cross section. */
+    Vec3                          m_last_center[2];
+    /** Half width of the last added cross section. */
+    Vec3                          m_last_side;
+    /** Texture coordinate of the last added cross section. */
+    float                         m_last_v;
+    /** Last segment added to the renderer for each wheel, -1 at the start
+     *  of a mark. */
+    int                           m_last_segment[2];
+    /** Point between the wheels where the current mark started. */
+    Vec3                          m_center_start;
+    /** Color of the current mark. */
+    video::SColor                 m_color;
+
+    void addSegments(const Vec3 &left, const Vec3 &right, const Vec3 &side);
+
 public:
          SkidMarks(const AbstractKart& kart, float width=0.32f);
         ~SkidMarks();
@@ -25,6 +25,7 @@
 #include "graphics/material_manager.hpp"
 #include "graphics/stkmeshscenenode.hpp"
 #include "io/file_manager.hpp"
+#include "karts/controller/ai_perception.hpp"
 #include "karts/controller/controller.hpp"
 #include "karts/abstract_kart.hpp"
 #include "karts/kart_properties.hpp"
@@ -408,16 +409,22 @@ void SlipStream::update(float dt)
     // Then test if this kart is in the slipstream range of another kart:
     // ------------------------------------------------------------------
     World *world           = World::getWorld();
-    unsigned int num_karts = world->getNumKarts();
     bool is_sstreaming     = false;
     m_target_kart          = NULL;
 
-    // Note that this loop can not be simply replaced with a shorter loop
-    // using only the karts with a better position - since a kart might
-    // be a lap behind
-    for(unsigned int i=0; i<num_karts; i++)
+    // Only test the karts which are close on the track. Note that this can
+    // not simply use the karts with a better position - since a kart might
+    // be a lap behind. The distance along the driveline can be longer than
+    // the actual distance in curves, so use twice the slipstream range.
+    const float max_length = m_kart->getKartProperties()->getSlipstreamLength()
+                           * m_kart->getPlayerDifficulty()->getSlipstreamLength()
+                           + m_kart->getKartLength();
+    world->getAIPerception()->getKartsNearOnTrack(m_kart->getWorldKartId(),
+                                                  2.0f*max_length,
+                                                  &m_nearby_karts);
+    for(unsigned int i=0; i<m_nearby_karts.size(); i++)
     {
-        m_target_kart= world->getKart(i);
+        m_target_kart= world->getKart(m_nearby_karts[i]);
         // Don't test for slipstream with itself, a kart that is being
         // rescued or exploding, or an eliminated kart
         if(m_target_kart==m_kart               ||
@@ -475,11 +482,11 @@ void SlipStream::update(float dt)
             m_kart->getController()->isPlayerController())
             m_target_kart->getSlipstream()
                          ->setDebugColor(video::SColor(255, 0, 0, 255));
-    }   // for i < num_karts
+    }   // for i < m_nearby_karts.size()
 
     if(!is_sstreaming)
     {
-        if(UserConfigParams::m_slipstream_debug &&
+        if(UserConfigParams::m_slipstream_debug && m_target_kart &&
             m_kart->getController()->isPlayerController())
             m_target_kart->getSlipstream()
                          ->setDebugColor(video::SColor(255, 255, 0, 0));
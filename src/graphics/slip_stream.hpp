@@ -30,6 +30,8 @@ using namespace irr;
 #include "graphics/moving_texture.hpp"
 #include "utils/no_copy.hpp"
 
+#include <vector>
+
 class AbstractKart;
 class Quad;
 class Material;
@@ -81,6 +83,10 @@ private:
      ** overtake the right kart. */
     AbstractKart* m_target_kart;
 
+    /** The karts close enough on the track to be tested, kept to avoid
+     *  allocating the list each frame. */
+    std::vector<unsigned int> m_nearby_karts;
+
     void         createMesh(Material* material);
     void         setDebugColor(const video::SColor &color);
 public:
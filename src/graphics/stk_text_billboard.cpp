@@ -59,6 +59,7 @@ void STKTextBillboard::updateAbsolutePosition()
     }
     else
         AbsoluteTransformation = getRelativeTransformation();
+    TransformationRevision = nextTransformationRevision();
 }
 
 scene::IMesh* STKTextBillboard::getTextMesh(core::stringw text, gui::ScalableFont* font)
@@ -41,6 +41,8 @@ const core::vector3df& scale) :
 {
     isGLInitialized = false;
     isMaterialInitialized = false;
+    m_uploaded_frame = -1.0f;
+    m_uploaded_strength = 0.0f;
 #ifdef DEBUG
     m_debug_name = debug_name;
 #endif
@@ -76,6 +78,7 @@ void STKAnimatedMesh::setMesh(scene::IAnimatedMesh* mesh)
 {
     isGLInitialized = false;
     isMaterialInitialized = false;
+    m_uploaded_frame = -1.0f;
     cleanGLMeshes();
     CAnimatedMeshSceneNode::setMesh(mesh);
 }
@@ -143,6 +146,19 @@ void STKAnimatedMesh::updateNoGL()
     }
 }
 
+/** Returns true if the skinned vertices differ from the ones uploaded last
+ *  time. Karts only change their frame while steering changes, so most of
+ *  the time their vertices don't have to be uploaded again. Joints set from
+ *  outside (EJUOR_CONTROL) can change without the frame changing, so they
+ *  are always uploaded.
+ */
+bool STKAnimatedMesh::needsVertexUpload() const
+{
+    return m_uploaded_frame < 0.0f || JointMode == scene::EJUOR_CONTROL ||
+           m_uploaded_frame != getFrameNr() ||
+           m_uploaded_strength != AnimationStrength;
+}   // needsVertexUpload
+
 void STKAnimatedMesh::updateGL()
 {
 
@@ -189,34 +205,29 @@ void STKAnimatedMesh::updateGL()
         isGLInitialized = true;
     }
 
+    if (!needsVertexUpload())
+        return;
+    m_uploaded_frame = getFrameNr();
+    m_uploaded_strength = AnimationStrength;
+
     for (u32 i = 0; i<m->getMeshBufferCount(); ++i)
     {
         scene::IMeshBuffer* mb = m->getMeshBuffer(i);
         const video::SMaterial& material = ReadOnlyMaterials ? mb->getMaterial() : Materials[i];
         if (isObject(material.MaterialType))
         {
-
-            size_t size = mb->getVertexCount() * GLmeshes[i].Stride, offset = GLmeshes[i].vaoBaseVertex * GLmeshes[i].Stride;
-            void *buf;
-            if (CVS->supportsAsyncInstanceUpload())
+            // The GPU may still read the vertices of the previous frame, so
+            // they are updated with glBufferSubData instead of being written
+            // to a mapped buffer
+            if (CVS->isARBBaseInstanceUsable())
             {
-                buf = VAOManager::getInstance()->getVBOPtr(mb->getVertexType());
-                buf = (char *)buf + offset;
+                VAOManager::getInstance()->updateVertices(mb);
             }
             else
             {
                 glBindVertexArray(0);
-                if (CVS->isARBBaseInstanceUsable())
-                    glBindBuffer(GL_ARRAY_BUFFER, VAOManager::getInstance()->getVBO(mb->getVertexType()));
-                else
-                    glBindBuffer(GL_ARRAY_BUFFER, GLmeshes[i].vertex_buffer);
-                GLbitfield bitfield = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
-                buf = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, bitfield);
-            }
-            memcpy(buf, mb->getVertices(), size);
-            if (!CVS->supportsAsyncInstanceUpload())
-            {
-                glUnmapBuffer(GL_ARRAY_BUFFER);
+                glBindBuffer(GL_ARRAY_BUFFER, GLmeshes[i].vertex_buffer);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, mb->getVertexCount() * GLmeshes[i].Stride, mb->getVertices());
                 glBindBuffer(GL_ARRAY_BUFFER, 0);
             }
         }
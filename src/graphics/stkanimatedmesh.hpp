@@ -31,7 +31,13 @@ protected:
     bool isGLInitialized;
     std::vector<GLMesh> GLmeshes;
     core::matrix4 ModelViewProjectionMatrix;
+    /** Frame and animation strength of the vertices that were last
+     *  uploaded, used to skip the upload if the pose did not change. A
+     *  negative frame forces the next upload. */
+    irr::f32 m_uploaded_frame;
+    irr::f32 m_uploaded_strength;
     void cleanGLMeshes();
+    bool needsVertexUpload() const;
 public:
     virtual void updateNoGL();
     virtual void updateGL();
@@ -45,6 +51,7 @@ public:
   virtual void render();
   virtual void setMesh(irr::scene::IAnimatedMesh* mesh);
   virtual bool glow() const { return false; }
+  virtual bool isAnimated() const { return true; }
 };
 
 #endif // STKANIMATEDMESH_HPP
@@ -0,0 +1,174 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "graphics/stkinstancegroup.hpp"
+
+#include "graphics/stkmeshscenenode.hpp"
+
+#include <algorithm>
+
+/** Maximum number of instances in a leaf of the hierarchy. */
+static const unsigned int MAX_LEAF_INSTANCES = 4;
+
+// ----------------------------------------------------------------------------
+STKInstanceGroup::STKInstanceGroup(scene::ISceneNode *parent,
+                                   scene::ISceneManager *mgr)
+                : scene::ISceneNode(parent, mgr, -1)
+{
+#ifdef DEBUG
+    setName("instance group");
+#endif
+    m_box.reset(0.0f, 0.0f, 0.0f);
+}   // STKInstanceGroup
+
+// ----------------------------------------------------------------------------
+/** Moves a node into this group. The node must not move anymore, and the
+ *  group must have the identity transformation, which keeps the absolute
+ *  transformation of the node. build must be called after all nodes were
+ *  added.
+ */
+void STKInstanceGroup::addInstance(STKMeshSceneNode *node)
+{
+    node->setParent(this);
+    node->updateAbsolutePosition();
+
+    const core::matrix4 &trans = node->getAbsoluteTransformation();
+    core::vector3df edges[8];
+    node->getMesh()->getBoundingBox().getEdges(edges);
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        trans.transformVect(edges[i]);
+        m_instance_edges.push_back(edges[i]);
+        if (m_instances.empty() && i == 0)
+            m_box.reset(edges[i]);
+        else
+            m_box.addInternalPoint(edges[i]);
+    }
+    m_instances.push_back(node);
+    m_tree.clear();
+}   // addInstance
+
+// ----------------------------------------------------------------------------
+/** Builds the bounding volume hierarchy over all instances, and sorts the
+ *  instances so that each leaf covers a range of them.
+ */
+void STKInstanceGroup::build()
+{
+    m_tree.clear();
+    if (m_instances.empty())
+        return;
+
+    std::vector<unsigned int> order(m_instances.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+        order[i] = i;
+    buildTree(0, (unsigned int)order.size(), &order);
+
+    std::vector<STKMeshSceneNode*> instances(m_instances.size());
+    std::vector<core::vector3df> edges(m_instance_edges.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+    {
+        instances[i] = m_instances[order[i]];
+        std::copy(m_instance_edges.begin() + 8 * order[i],
+                  m_instance_edges.begin() + 8 * (order[i] + 1),
+                  edges.begin() + 8 * i);
+    }
+    m_instances.swap(instances);
+    m_instance_edges.swap(edges);
+}   // build
+
+// ----------------------------------------------------------------------------
+/** Creates the subtree of the instances first to last (excluded) of order,
+ *  by splitting them at the median along the longest axis of the bounding
+ *  box of their centers.
+ *  \return Index of the root of the subtree.
+ */
+unsigned int STKInstanceGroup::buildTree(unsigned int first,
+                                         unsigned int last,
+                                         std::vector<unsigned int> *order)
+{
+    const unsigned int index = (unsigned int)m_tree.size();
+    m_tree.push_back(TreeNode());
+
+    core::aabbox3df box, centers;
+    for (unsigned int i = first; i < last; i++)
+    {
+        core::aabbox3df instance_box(m_instance_edges[8 * (*order)[i]]);
+        for (unsigned int j = 1; j < 8; j++)
+            instance_box.addInternalPoint(m_instance_edges[8*(*order)[i]+j]);
+        if (i == first)
+        {
+            box = instance_box;
+            centers.reset(instance_box.getCenter());
+        }
+        else
+        {
+            box.addInternalBox(instance_box);
+            centers.addInternalPoint(instance_box.getCenter());
+        }
+    }
+    box.getEdges(m_tree[index].m_edges);
+    m_tree[index].m_children[0] = m_tree[index].m_children[1] = 0;
+    m_tree[index].m_first = first;
+    m_tree[index].m_last  = last;
+    if (last - first <= MAX_LEAF_INSTANCES)
+        return index;
+
+    const core::vector3df extent = centers.getExtent();
+    const int axis = extent.X >= extent.Y && extent.X >= extent.Z ? 0
+                   : extent.Y >= extent.Z ? 1 : 2;
+    const std::vector<core::vector3df> &edges = m_instance_edges;
+    const unsigned int middle = (first + last) / 2;
+    std::nth_element(order->begin() + first, order->begin() + middle,
+                     order->begin() + last,
+                     [&edges, axis](unsigned int a, unsigned int b)
+    {
+        // Edges 0 and 7 are opposite corners of the box
+        const core::vector3df ca = edges[8 * a] + edges[8 * a + 7];
+        const core::vector3df cb = edges[8 * b] + edges[8 * b + 7];
+        return axis == 0 ? ca.X < cb.X : axis == 1 ? ca.Y < cb.Y
+                                                   : ca.Z < cb.Z;
+    });
+
+    const unsigned int left  = buildTree(first, middle, order);
+    const unsigned int right = buildTree(middle, last, order);
+    m_tree[index].m_children[0] = left;
+    m_tree[index].m_children[1] = right;
+    return index;
+}   // buildTree
+
+// ----------------------------------------------------------------------------
+/** Removes a node from the scene graph and from the instances, e.g. when
+ *  its track object is deleted. The hierarchy is kept, the instance is only
+ *  skipped. */
+bool STKInstanceGroup::removeChild(scene::ISceneNode *child)
+{
+    std::vector<STKMeshSceneNode*>::iterator it =
+        std::find(m_instances.begin(), m_instances.end(), child);
+    if (it != m_instances.end())
+        *it = NULL;
+    return scene::ISceneNode::removeChild(child);
+}   // removeChild
+
+// ----------------------------------------------------------------------------
+void STKInstanceGroup::removeAll()
+{
+    m_instances.clear();
+    m_instance_edges.clear();
+    m_tree.clear();
+    scene::ISceneNode::removeAll();
+}   // removeAll
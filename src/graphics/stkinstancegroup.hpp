@@ -0,0 +1,96 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_STK_INSTANCE_GROUP_HPP
+#define HEADER_STK_INSTANCE_GROUP_HPP
+
+#include <ISceneNode.h>
+
+#include <vector>
+
+using namespace irr;
+
+class STKMeshSceneNode;
+
+/** Groups the nodes of static track objects. The nodes become children of
+ *  the group, and the scene traversal visits the group instead of all its
+ *  nodes. The world space bounding boxes of the nodes are computed once,
+ *  since they never move, and are organized in a bounding volume hierarchy
+ *  so that whole subtrees can be culled against each camera. The meshes of
+ *  all nodes are still drawn with the instanced draw calls, which are
+ *  batched by mesh buffer.
+ *  \ingroup graphics
+ */
+class STKInstanceGroup : public scene::ISceneNode
+{
+public:
+    /** A node of the bounding volume hierarchy. */
+    struct TreeNode
+    {
+        /** The 8 edges of the bounding box of all instances below. */
+        core::vector3df m_edges[8];
+        /** The two children, or 0 for a leaf (the root is no child). */
+        unsigned int    m_children[2];
+        /** The instances first to last (excluded) of a leaf. */
+        unsigned int    m_first, m_last;
+    };   // TreeNode
+
+private:
+    /** The instances, NULL once removed. */
+    std::vector<STKMeshSceneNode*> m_instances;
+    /** The 8 edges of the world space bounding box of each instance. */
+    std::vector<core::vector3df>   m_instance_edges;
+    /** The bounding box of all instances, in world space. */
+    core::aabbox3df                m_box;
+    /** The hierarchy, the root is the first node. */
+    std::vector<TreeNode>          m_tree;
+
+    unsigned int buildTree(unsigned int first, unsigned int last,
+                           std::vector<unsigned int> *order);
+
+public:
+                 STKInstanceGroup(scene::ISceneNode *parent,
+                                  scene::ISceneManager *mgr);
+    void         addInstance(STKMeshSceneNode *node);
+    void         build();
+    virtual bool removeChild(scene::ISceneNode *child);
+    virtual void removeAll();
+    // ------------------------------------------------------------------------
+    virtual void render() {}
+    // ------------------------------------------------------------------------
+    virtual const core::aabbox3d<f32>& getBoundingBox() const { return m_box; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of nodes of the hierarchy, 0 before build. */
+    unsigned int getTreeNodeCount() const
+    {
+        return (unsigned int)m_tree.size();
+    }
+    // ------------------------------------------------------------------------
+    const TreeNode& getTreeNode(unsigned int i) const { return m_tree[i]; }
+    // ------------------------------------------------------------------------
+    /** Returns an instance, or NULL if it was removed. */
+    STKMeshSceneNode *getInstance(unsigned int i) { return m_instances[i]; }
+    // ------------------------------------------------------------------------
+    /** Returns the 8 edges of the world space bounding box of an instance. */
+    const core::vector3df *getInstanceEdges(unsigned int i) const
+    {
+        return &m_instance_edges[8 * i];
+    }
+};   // STKInstanceGroup
+
+#endif
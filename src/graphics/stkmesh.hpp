@@ -53,6 +53,14 @@ struct GLMesh {
     size_t vaoOffset;
     video::E_VERTEX_TYPE VAOType;
     uint64_t TextureHandles[6];
+    /** Group of texture arrays the textures were packed into (0 if none),
+     *  valid if TextureArrayGeneration is the one of the
+     *  TextureArrayManager. */
+    unsigned TextureArrayGroup;
+    unsigned TextureArrayGeneration;
+    /** Render frame in which the textures were last marked as used, see
+     *  markTextureUsed. */
+    unsigned TextureUseFrame;
     scene::IMeshBuffer *mb;
 #ifdef DEBUG
     std::string debug_name;
@@ -68,31 +76,105 @@ bool isObject(video::E_MATERIAL_TYPE type);
 
 core::vector3df getWindDir();
 
+/** Shadow passes: pass i < 4 contains the shadow casters of cascade i which
+ *  are not cached, pass SHADOW_CACHE_PASS + i the static shadow casters of
+ *  cascade i if the static shadow cache is used for it. */
+enum
+{
+    SHADOW_CACHE_PASS = 4,
+    SHADOW_PASS_COUNT = 8
+};
+
 
 class STKMeshCommon
 {
 protected:
     std::string m_debug_name;
 
+private:
+    /** The absolute transformation the instance transform was computed
+     *  for. */
+    core::matrix4 m_instance_matrix;
+    bool          m_instance_transform_valid;
+    /** One more than the frame in which this node was updated the last
+     *  time, 0 if it was never updated. */
+    unsigned int  m_update_frame;
+    /** The absolute transformation of the last frame and the number of
+     *  frames since it changed, used to find the static shadow casters. */
+    core::matrix4 m_static_matrix;
+    unsigned int  m_static_frames;
+
 public:
+    /** Number of frames a node must not move to be drawn into the static
+     *  shadow cache. */
+    static const unsigned int STATIC_FRAMES = 60;
+
     PtrVector<GLMesh, REF> MeshSolidMaterial[Material::SHADERTYPE_COUNT];
     PtrVector<GLMesh, REF> TransparentMesh[TM_COUNT];
+    /** The absolute transformation decomposed for the instance buffers. */
+    core::vector3df InstanceOrigin, InstanceOrientation, InstanceScale;
+
+    STKMeshCommon() : m_instance_transform_valid(false), m_update_frame(0),
+                      m_static_frames(0) {}
+    /** Returns true the first time this is called for a frame, i.e. if the
+     *  node must be updated (animations, buffer upload). In splitscreen a
+     *  node seen by several cameras is only updated for the first one. */
+    bool needsUpdate(unsigned int frame)
+    {
+        if (m_update_frame == frame + 1)
+            return false;
+        m_update_frame = frame + 1;
+        return true;
+    }
+    /** Decomposes the absolute transformation for the instance buffers.
+     *  Since getRotationDegrees is expensive, this is only done if the
+     *  transformation changed, i.e. once for static track geometry. */
+    void updateInstanceTransform(const core::matrix4 &mat)
+    {
+        if (m_instance_transform_valid && mat == m_instance_matrix)
+            return;
+        m_instance_matrix = mat;
+        InstanceOrigin = mat.getTranslation();
+        InstanceOrientation = mat.getRotationDegrees();
+        InstanceScale = mat.getScale();
+        m_instance_transform_valid = true;
+    }
+    /** Counts the frames in which the absolute transformation did not
+     *  change. Must be called once per frame. */
+    void updateStaticState(const core::matrix4 &mat)
+    {
+        if (mat == m_static_matrix)
+        {
+            if (m_static_frames < STATIC_FRAMES)
+                m_static_frames++;
+            return;
+        }
+        m_static_matrix = mat;
+        m_static_frames = 0;
+    }
+    /** Returns true if the node can be drawn into the static shadow cache,
+     *  i.e. it is not animated and did not move for STATIC_FRAMES frames. */
+    bool isStatic() const
+    {
+        return !isAnimated() && m_static_frames >= STATIC_FRAMES;
+    }
     virtual void updateNoGL() = 0;
     virtual void updateGL() = 0;
     virtual bool glow() const = 0;
     virtual bool isImmediateDraw() const { return false; }
+    virtual bool isAnimated() const { return false; }
 };
 
 template<typename T, typename... Args>
 class MeshList : public Singleton<T>
 {
 public:
-    std::vector<STK::Tuple<Args...> > SolidPass, Shadows[4], RSM;
+    std::vector<STK::Tuple<Args...> > SolidPass, Shadows[SHADOW_PASS_COUNT], RSM;
     void clear()
     {
         SolidPass.clear();
         RSM.clear();
-        for (unsigned i = 0; i < 4; i++)
+        for (unsigned i = 0; i < SHADOW_PASS_COUNT; i++)
             Shadows[i].clear();
     }
 };
@@ -101,12 +183,12 @@ template<typename T>
 class InstancedMeshList : public Singleton<T>
 {
 public:
-    std::vector<GLMesh *> SolidPass, Shadows[4], RSM;
+    std::vector<GLMesh *> SolidPass, Shadows[SHADOW_PASS_COUNT], RSM;
     void clear()
     {
         SolidPass.clear();
         RSM.clear();
-        for (unsigned i = 0; i < 4; i++)
+        for (unsigned i = 0; i < SHADOW_PASS_COUNT; i++)
             Shadows[i].clear();
     }
 };
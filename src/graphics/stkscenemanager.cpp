@@ -20,6 +20,9 @@
 #include "graphics/stkmesh.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/central_settings.hpp"
+#include "graphics/stkinstancegroup.hpp"
+#include "graphics/texture_array_manager.hpp"
+#include "graphics/texturemanager.hpp"
 #include "stkanimatedmesh.hpp"
 #include "stkmeshscenenode.hpp"
 #include "utils/ptr_vector.hpp"
@@ -32,115 +35,198 @@
 #include "lod_node.hpp"
 #include "utils/profiler.hpp"
 #include "utils/time.hpp"
+#include "utils/worker_pool.hpp"
 
 #include <ISceneManager.h>
 #include <ISceneNode.h>
 
 #include <unordered_map>
 #include <SViewFrustum.h>
+#include <algorithm>
+#include <climits>
 #include <functional>
 
 template<typename T>
 struct InstanceFiller
 {
-    static void add(GLMesh *, scene::ISceneNode *, T &);
+    static void add(GLMesh *, STKMeshCommon *, T &);
 };
 
+template<typename T>
+static void fillInstanceTransform(STKMeshCommon *node, T &Instance)
+{
+    Instance.Origin.X = node->InstanceOrigin.X;
+    Instance.Origin.Y = node->InstanceOrigin.Y;
+    Instance.Origin.Z = node->InstanceOrigin.Z;
+    Instance.Orientation.X = node->InstanceOrientation.X;
+    Instance.Orientation.Y = node->InstanceOrientation.Y;
+    Instance.Orientation.Z = node->InstanceOrientation.Z;
+    Instance.Scale.X = node->InstanceScale.X;
+    Instance.Scale.Y = node->InstanceScale.Y;
+    Instance.Scale.Z = node->InstanceScale.Z;
+}
+
 template<>
-void InstanceFiller<InstanceDataSingleTex>::add(GLMesh *mesh, scene::ISceneNode *node, InstanceDataSingleTex &Instance)
+void InstanceFiller<InstanceDataSingleTex>::add(GLMesh *mesh, STKMeshCommon *node, InstanceDataSingleTex &Instance)
 {
-    const core::matrix4 &mat = node->getAbsoluteTransformation();
-    const core::vector3df &Origin = mat.getTranslation();
-    const core::vector3df &Orientation = mat.getRotationDegrees();
-    const core::vector3df &Scale = mat.getScale();
-    Instance.Origin.X = Origin.X;
-    Instance.Origin.Y = Origin.Y;
-    Instance.Origin.Z = Origin.Z;
-    Instance.Orientation.X = Orientation.X;
-    Instance.Orientation.Y = Orientation.Y;
-    Instance.Orientation.Z = Orientation.Z;
-    Instance.Scale.X = Scale.X;
-    Instance.Scale.Y = Scale.Y;
-    Instance.Scale.Z = Scale.Z;
+    fillInstanceTransform(node, Instance);
     Instance.Texture = mesh->TextureHandles[0];
 }
 
 template<>
-void InstanceFiller<InstanceDataDualTex>::add(GLMesh *mesh, scene::ISceneNode *node, InstanceDataDualTex &Instance)
+void InstanceFiller<InstanceDataDualTex>::add(GLMesh *mesh, STKMeshCommon *node, InstanceDataDualTex &Instance)
 {
-    const core::matrix4 &mat = node->getAbsoluteTransformation();
-    const core::vector3df &Origin = mat.getTranslation();
-    const core::vector3df &Orientation = mat.getRotationDegrees();
-    const core::vector3df &Scale = mat.getScale();
-    Instance.Origin.X = Origin.X;
-    Instance.Origin.Y = Origin.Y;
-    Instance.Origin.Z = Origin.Z;
-    Instance.Orientation.X = Orientation.X;
-    Instance.Orientation.Y = Orientation.Y;
-    Instance.Orientation.Z = Orientation.Z;
-    Instance.Scale.X = Scale.X;
-    Instance.Scale.Y = Scale.Y;
-    Instance.Scale.Z = Scale.Z;
+    fillInstanceTransform(node, Instance);
     Instance.Texture = mesh->TextureHandles[0];
     Instance.SecondTexture = mesh->TextureHandles[1];
 }
 
 template<>
-void InstanceFiller<InstanceDataThreeTex>::add(GLMesh *mesh, scene::ISceneNode *node, InstanceDataThreeTex &Instance)
+void InstanceFiller<InstanceDataThreeTex>::add(GLMesh *mesh, STKMeshCommon *node, InstanceDataThreeTex &Instance)
 {
-    const core::matrix4 &mat = node->getAbsoluteTransformation();
-    const core::vector3df &Origin = mat.getTranslation();
-    const core::vector3df &Orientation = mat.getRotationDegrees();
-    const core::vector3df &Scale = mat.getScale();
-    Instance.Origin.X = Origin.X;
-    Instance.Origin.Y = Origin.Y;
-    Instance.Origin.Z = Origin.Z;
-    Instance.Orientation.X = Orientation.X;
-    Instance.Orientation.Y = Orientation.Y;
-    Instance.Orientation.Z = Orientation.Z;
-    Instance.Scale.X = Scale.X;
-    Instance.Scale.Y = Scale.Y;
-    Instance.Scale.Z = Scale.Z;
+    fillInstanceTransform(node, Instance);
     Instance.Texture = mesh->TextureHandles[0];
     Instance.SecondTexture = mesh->TextureHandles[1];
     Instance.ThirdTexture = mesh->TextureHandles[2];
 }
 
 template<>
-void InstanceFiller<GlowInstanceData>::add(GLMesh *mesh, scene::ISceneNode *node, GlowInstanceData &Instance)
+void InstanceFiller<GlowInstanceData>::add(GLMesh *mesh, STKMeshCommon *node, GlowInstanceData &Instance)
 {
     STKMeshSceneNode *nd = dynamic_cast<STKMeshSceneNode*>(node);
-    const core::matrix4 &mat = node->getAbsoluteTransformation();
-    const core::vector3df &Origin = mat.getTranslation();
-    const core::vector3df &Orientation = mat.getRotationDegrees();
-    const core::vector3df &Scale = mat.getScale();
     Instance.Color = nd->getGlowColor().color;
-    Instance.Origin.X = Origin.X;
-    Instance.Origin.Y = Origin.Y;
-    Instance.Origin.Z = Origin.Z;
-    Instance.Orientation.X = Orientation.X;
-    Instance.Orientation.Y = Orientation.Y;
-    Instance.Orientation.Z = Orientation.Z;
-    Instance.Scale.X = Scale.X;
-    Instance.Scale.Y = Scale.Y;
-    Instance.Scale.Z = Scale.Z;
+    fillInstanceTransform(node, Instance);
 }
 
+typedef std::vector<std::pair<GLMesh *, STKMeshCommon *> > InstanceList;
+
+/** The instances drawn in one pass with one shader type, grouped by mesh
+ *  buffer (each group becomes one indirect draw command). The groups are
+ *  retained from frame to frame and only their instance lists are cleared,
+ *  so once all meshes of a track have been seen, gathering the draw calls
+ *  doesn't allocate anything. The groups are drawn sorted by texture (and
+ *  then by vertex offset), the order is only sorted again when a new mesh
+ *  buffer is added.
+ */
+class InstanceBatches
+{
+private:
+    struct SortKey
+    {
+        /** Meshes packed in the same texture arrays are drawn together,
+         *  before the unpacked ones. */
+        unsigned               m_texture_array;
+        const video::ITexture *m_texture;
+        size_t                 m_base_vertex;
+        unsigned               m_batch;
+        bool operator<(const SortKey &other) const
+        {
+            if (m_texture_array != other.m_texture_array)
+                return m_texture_array < other.m_texture_array;
+            if (m_texture != other.m_texture)
+                return m_texture < other.m_texture;
+            return m_base_vertex < other.m_base_vertex;
+        }
+    };
+
+    std::unordered_map<scene::IMeshBuffer *, unsigned> m_batch_index;
+    std::vector<InstanceList> m_batches;
+    std::vector<SortKey>      m_order;
+    bool                      m_sorted;
+
+public:
+    InstanceBatches() : m_sorted(true) {}
+    // ------------------------------------------------------------------------
+    void add(GLMesh *mesh, STKMeshCommon *node)
+    {
+        auto it = m_batch_index.find(mesh->mb);
+        unsigned batch;
+        if (it == m_batch_index.end())
+        {
+            batch = (unsigned)m_batches.size();
+            m_batch_index[mesh->mb] = batch;
+            m_batches.push_back(InstanceList());
+            const unsigned group = CVS->isTextureArrayBatchingEnabled()
+                ? TextureArrayManager::getInstance()->getGroup(mesh) : 0;
+            SortKey key = { group > 0 ? group : UINT_MAX, mesh->textures[0],
+                            mesh->vaoBaseVertex, batch };
+            m_order.push_back(key);
+            m_sorted = false;
+        }
+        else
+            batch = it->second;
+        m_batches[batch].emplace_back(mesh, node);
+    }   // add
+    // ------------------------------------------------------------------------
+    /** Removes all instances, but keeps the batches for the next frame. */
+    void clearInstances()
+    {
+        for (InstanceList &list : m_batches)
+            list.clear();
+    }   // clearInstances
+    // ------------------------------------------------------------------------
+    /** Removes all batches, e.g. when the track is unloaded (the mesh
+     *  buffers are then deleted). */
+    void clear()
+    {
+        m_batch_index.clear();
+        m_batches.clear();
+        m_order.clear();
+        m_sorted = true;
+    }   // clear
+    // ------------------------------------------------------------------------
+    /** Sorts the batches if necessary, and adds the number of instances and
+     *  the number of non-empty batches (i.e. draw commands) to the counters.
+     *  Called serially before the batches are filled in parallel. */
+    void count(size_t *num_instances, size_t *num_commands)
+    {
+        sort();
+        for (const InstanceList &list : m_batches)
+        {
+            if (list.empty()) continue;
+            *num_instances += list.size();
+            (*num_commands)++;
+        }
+    }   // count
+    // ------------------------------------------------------------------------
+    /** Sorts the batches, if a new batch was added since the last sort. */
+    void sort()
+    {
+        if (!m_sorted)
+        {
+            std::sort(m_order.begin(), m_order.end());
+            m_sorted = true;
+        }
+    }   // sort
+    // ------------------------------------------------------------------------
+    /** Calls f for each non-empty instance list in draw order. */
+    template<typename F>
+    void forEach(F f)
+    {
+        sort();
+        for (const SortKey &key : m_order)
+        {
+            const InstanceList &list = m_batches[key.m_batch];
+            if (!list.empty())
+                f(list);
+        }
+    }   // forEach
+};   // InstanceBatches
+
 template<typename T>
 static void
-FillInstances_impl(std::vector<std::pair<GLMesh *, scene::ISceneNode *> > InstanceList, T * InstanceBuffer, DrawElementsIndirectCommand *CommandBuffer,
+FillInstances_impl(const InstanceList &Instances, T * InstanceBuffer, DrawElementsIndirectCommand *CommandBuffer,
     size_t &InstanceBufferOffset, size_t &CommandBufferOffset, size_t &PolyCount)
 {
     // Should never be empty
-    GLMesh *mesh = InstanceList.front().first;
+    GLMesh *mesh = Instances.front().first;
     size_t InitialOffset = InstanceBufferOffset;
 
-    for (unsigned i = 0; i < InstanceList.size(); i++)
+    for (unsigned i = 0; i < Instances.size(); i++)
     {
-        auto &Tp = InstanceList[i];
-        scene::ISceneNode *node = Tp.second;
+        STKMeshCommon *node = Instances[i].second;
         InstanceFiller<T>::add(mesh, node, InstanceBuffer[InstanceBufferOffset++]);
-        assert(InstanceBufferOffset * sizeof(T) < 10000 * sizeof(InstanceDataDualTex));
+        assert(InstanceBufferOffset <= INSTANCE_BUFFER_COUNT * INSTANCE_BUFFER_SIZE);
     }
 
     DrawElementsIndirectCommand &CurrentCommand = CommandBuffer[CommandBufferOffset++];
@@ -155,23 +241,24 @@ FillInstances_impl(std::vector<std::pair<GLMesh *, scene::ISceneNode *> > Instan
 
 template<typename T>
 static
-void FillInstances(const std::unordered_map<scene::IMeshBuffer *, std::vector<std::pair<GLMesh *, scene::ISceneNode*> > > &GatheredGLMesh, std::vector<GLMesh *> &InstancedList,
+void FillInstances(InstanceBatches &GatheredGLMesh, std::vector<GLMesh *> &InstancedList,
     T *InstanceBuffer, DrawElementsIndirectCommand *CommandBuffer, size_t &InstanceBufferOffset, size_t &CommandBufferOffset, size_t &Polycount)
 {
-    auto It = GatheredGLMesh.begin(), E = GatheredGLMesh.end();
-    for (; It != E; ++It)
+    GatheredGLMesh.forEach([&](const InstanceList &List)
     {
-        FillInstances_impl<T>(It->second, InstanceBuffer, CommandBuffer, InstanceBufferOffset, CommandBufferOffset, Polycount);
+        FillInstances_impl<T>(List, InstanceBuffer, CommandBuffer, InstanceBufferOffset, CommandBufferOffset, Polycount);
         if (!CVS->isAZDOEnabled())
-            InstancedList.push_back(It->second.front().first);
-    }
+            InstancedList.push_back(List.front().first);
+    });
 }
 
-static std::unordered_map <scene::IMeshBuffer *, std::vector<std::pair<GLMesh *, scene::ISceneNode*> > > MeshForSolidPass[Material::SHADERTYPE_COUNT], MeshForShadowPass[Material::SHADERTYPE_COUNT][4], MeshForRSM[Material::SHADERTYPE_COUNT];
-static std::unordered_map <scene::IMeshBuffer *, std::vector<std::pair<GLMesh *, scene::ISceneNode*> > > MeshForGlowPass;
+static InstanceBatches MeshForSolidPass[Material::SHADERTYPE_COUNT], MeshForShadowPass[Material::SHADERTYPE_COUNT][SHADOW_PASS_COUNT], MeshForRSM[Material::SHADERTYPE_COUNT];
+static InstanceBatches MeshForGlowPass;
 static std::vector <STKMeshCommon *> DeferredUpdate;
 
 static core::vector3df windDir;
+/** Order independent hash of the static shadow casters of each cascade. */
+static uint64_t ShadowCacheSignature[4];
 
 // From irrlicht code
 static
@@ -195,44 +282,95 @@ static void addEdge(const core::vector3df &P0, const core::vector3df &P1)
     BoundingBoxes.push_back(P1.Z);
 }
 
+/** Tests the bounding box of a node, given by its 8 edges in world space,
+ *  against the frustum of a camera. The edges are computed once by the
+ *  caller, since each node is tested against up to 6 cameras (the camera,
+ *  the 4 shadow cascades and the RSM camera). */
 static
-bool isCulledPrecise(const scene::ICameraSceneNode *cam, const scene::ISceneNode *node)
+bool isCulledPrecise(const scene::ICameraSceneNode *cam, const scene::ISceneNode *node, const core::vector3df edges[8])
 {
     if (!node->getAutomaticCulling())
         return false;
 
-    const core::matrix4 &trans = node->getAbsoluteTransformation();
     const scene::SViewFrustum &frust = *cam->getViewFrustum();
+    for (s32 i = 0; i < scene::SViewFrustum::VF_PLANE_COUNT; ++i)
+        if (isBoxInFrontOfPlane(frust.planes[i], edges))
+            return true;
+    return false;
+}
 
+static
+bool isCulledPrecise(const scene::ICameraSceneNode *cam, const scene::ISceneNode *node)
+{
+    if (!node->getAutomaticCulling())
+        return false;
+
+    const core::matrix4 &trans = node->getAbsoluteTransformation();
     core::vector3df edges[8];
     node->getBoundingBox().getEdges(edges);
     for (unsigned i = 0; i < 8; i++)
         trans.transformVect(edges[i]);
+    return isCulledPrecise(cam, node, edges);
+}
 
-    for (s32 i = 0; i < scene::SViewFrustum::VF_PLANE_COUNT; ++i)
-        if (isBoxInFrontOfPlane(frust.planes[i], edges))
-            return true;
-    return false;
+/** Returns a hash of a shadow caster, which is added to the signature of the
+ *  static shadow casters of a cascade (the finalizer of MurmurHash3). */
+static uint64_t hashShadowCaster(const STKMeshCommon *node)
+{
+    uint64_t h = (uint64_t)(size_t)node;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/** Returns the shadow pass a mesh is drawn in. Meshes that are animated by
+ *  the wind or by a texture matrix are never cached, even if their node
+ *  does not move. */
+static unsigned getShadowPass(unsigned pass, unsigned cascade, unsigned Mat,
+                              const GLMesh *mesh)
+{
+    if (pass < SHADOW_CACHE_PASS)
+        return pass;
+    if (Mat == Material::SHADERTYPE_VEGETATION ||
+        !mesh->TextureMatrix.isIdentity())
+        return cascade;
+    return pass;
 }
 
 static void
 handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *ImmediateDraw,
     const scene::ICameraSceneNode *cam, scene::ICameraSceneNode *shadowcam[4], const scene::ICameraSceneNode *rsmcam,
-    bool &culledforcam, bool culledforshadowcam[4], bool &culledforrsm, bool drawRSM)
+    bool &culledforcam, bool culledforshadowcam[4], bool &culledforrsm, bool drawRSM,
+    const core::vector3df *world_edges = NULL)
 {
     STKMeshCommon *node = dynamic_cast<STKMeshCommon*>(Node);
     if (!node)
         return;
-    node->updateNoGL();
-    DeferredUpdate.push_back(node);
+    if (node->needsUpdate(irr_driver->getRenderFrame()))
+    {
+        node->updateStaticState(Node->getAbsoluteTransformation());
+        node->updateNoGL();
+        DeferredUpdate.push_back(node);
+    }
 
 
     const core::matrix4 &trans = Node->getAbsoluteTransformation();
 
     core::vector3df edges[8];
-    Node->getBoundingBox().getEdges(edges);
-    for (unsigned i = 0; i < 8; i++)
-        trans.transformVect(edges[i]);
+    if (world_edges)
+    {
+        for (unsigned i = 0; i < 8; i++)
+            edges[i] = world_edges[i];
+    }
+    else
+    {
+        Node->getBoundingBox().getEdges(edges);
+        for (unsigned i = 0; i < 8; i++)
+            trans.transformVect(edges[i]);
+    }
 
     /* From irrlicht
        /3--------/7
@@ -267,10 +405,12 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
         return;
     }
 
-    culledforcam = culledforcam || isCulledPrecise(cam, Node);
-    culledforrsm = culledforrsm || isCulledPrecise(rsmcam, Node);
+    node->updateInstanceTransform(trans);
+
+    culledforcam = culledforcam || isCulledPrecise(cam, Node, edges);
+    culledforrsm = culledforrsm || !drawRSM || !UserConfigParams::m_gi || isCulledPrecise(rsmcam, Node, edges);
     for (unsigned i = 0; i < 4; i++)
-        culledforshadowcam[i] = culledforshadowcam[i] || isCulledPrecise(shadowcam[i], Node);
+        culledforshadowcam[i] = culledforshadowcam[i] || !CVS->isShadowEnabled() || isCulledPrecise(shadowcam[i], Node, edges);
 
     // Transparent
 
@@ -309,6 +449,18 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
 
     if (!culledforcam)
     {
+        const unsigned frame = irr_driver->getRenderFrame();
+        for (unsigned Mat = 0; Mat < Material::SHADERTYPE_COUNT; ++Mat)
+        {
+            for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
+            {
+                if (mesh->TextureUseFrame == frame)
+                    continue;
+                mesh->TextureUseFrame = frame;
+                for (unsigned i = 0; i < 8; i++)
+                    markTextureUsed(mesh->textures[i]);
+            }
+        }
         for (unsigned Mat = 0; Mat < Material::SHADERTYPE_COUNT; ++Mat)
         {
             if (CVS->supportsIndirectInstancingRendering())
@@ -316,10 +468,15 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
                 for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
                 {
                     if (node->glow())
-                        MeshForGlowPass[mesh->mb].emplace_back(mesh, Node);
+                        MeshForGlowPass.add(mesh, node);
 
                     if (Mat != Material::SHADERTYPE_SPLATTING && mesh->TextureMatrix.isIdentity())
-                        MeshForSolidPass[Mat][mesh->mb].emplace_back(mesh, Node);
+                    {
+                        if (Mat == Material::SHADERTYPE_SOLID &&
+                            CVS->isTextureArrayBatchingEnabled())
+                            TextureArrayManager::getInstance()->pack(mesh);
+                        MeshForSolidPass[Mat].add(mesh, node);
+                    }
                     else
                     {
                         core::matrix4 ModelMatrix = Node->getAbsoluteTransformation(), InvModelMatrix;
@@ -382,23 +539,31 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
     }
     if (!CVS->isShadowEnabled())
         return;
+    const bool is_static = node->isStatic();
     for (unsigned cascade = 0; cascade < 4; ++cascade)
     {
         if (culledforshadowcam[cascade])
             continue;
+        unsigned pass = cascade;
+        if (is_static && irr_driver->isShadowCacheUsed(cascade))
+        {
+            pass = SHADOW_CACHE_PASS + cascade;
+            ShadowCacheSignature[cascade] += hashShadowCaster(node);
+        }
         for (unsigned Mat = 0; Mat < Material::SHADERTYPE_COUNT; ++Mat)
         {
             if (CVS->supportsIndirectInstancingRendering())
             {
                 for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
                 {
+                    const unsigned mesh_pass = getShadowPass(pass, cascade, Mat, mesh);
                     if (Mat != Material::SHADERTYPE_SPLATTING)
-                        MeshForShadowPass[Mat][cascade][mesh->mb].emplace_back(mesh, Node);
+                        MeshForShadowPass[Mat][mesh_pass].add(mesh, node);
                     else
                     {
                         core::matrix4 ModelMatrix = Node->getAbsoluteTransformation(), InvModelMatrix;
                         ModelMatrix.getInverse(InvModelMatrix);
-                        ListMatSplatting::getInstance()->Shadows[cascade].emplace_back(mesh, ModelMatrix, InvModelMatrix);
+                        ListMatSplatting::getInstance()->Shadows[mesh_pass].emplace_back(mesh, ModelMatrix, InvModelMatrix);
                     }
                 }
             }
@@ -409,31 +574,32 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
 
                 for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
                 {
+                    const unsigned mesh_pass = getShadowPass(pass, cascade, Mat, mesh);
                     switch (Mat)
                     {
                     case Material::SHADERTYPE_SOLID:
-                        ListMatDefault::getInstance()->Shadows[cascade].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
+                        ListMatDefault::getInstance()->Shadows[mesh_pass].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
                         break;
                     case Material::SHADERTYPE_ALPHA_TEST:
-                        ListMatAlphaRef::getInstance()->Shadows[cascade].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
+                        ListMatAlphaRef::getInstance()->Shadows[mesh_pass].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
                         break;
                     case Material::SHADERTYPE_NORMAL_MAP:
-                        ListMatNormalMap::getInstance()->Shadows[cascade].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
+                        ListMatNormalMap::getInstance()->Shadows[mesh_pass].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
                         break;
                     case Material::SHADERTYPE_DETAIL_MAP:
-                        ListMatDetails::getInstance()->Shadows[cascade].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
+                        ListMatDetails::getInstance()->Shadows[mesh_pass].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
                         break;
                     case Material::SHADERTYPE_SOLID_UNLIT:
-                        ListMatUnlit::getInstance()->Shadows[cascade].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
+                        ListMatUnlit::getInstance()->Shadows[mesh_pass].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
                         break;
                     case Material::SHADERTYPE_SPHERE_MAP:
-                        ListMatSphereMap::getInstance()->Shadows[cascade].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
+                        ListMatSphereMap::getInstance()->Shadows[mesh_pass].emplace_back(mesh, ModelMatrix, InvModelMatrix, mesh->TextureMatrix);
                         break;
                     case Material::SHADERTYPE_SPLATTING:
-                        ListMatSplatting::getInstance()->Shadows[cascade].emplace_back(mesh, ModelMatrix, InvModelMatrix);
+                        ListMatSplatting::getInstance()->Shadows[mesh_pass].emplace_back(mesh, ModelMatrix, InvModelMatrix);
                         break;
                     case Material::SHADERTYPE_VEGETATION:
-                        ListMatGrass::getInstance()->Shadows[cascade].emplace_back(mesh, ModelMatrix, InvModelMatrix, windDir);
+                        ListMatGrass::getInstance()->Shadows[mesh_pass].emplace_back(mesh, ModelMatrix, InvModelMatrix, windDir);
                     }
                 }
             }
@@ -457,7 +623,7 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
                 else
                 {
                     for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
-                        MeshForRSM[Mat][mesh->mb].emplace_back(mesh, Node);
+                        MeshForRSM[Mat].add(mesh, node);
                 }
             }
             else
@@ -501,6 +667,47 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
     }
 }
 
+/** Culls a node of the hierarchy of a group of static instances against
+ *  all cameras, and then its children or, for a leaf, its instances. A
+ *  subtree is skipped as soon as it is culled for all cameras. */
+static void
+handleInstanceGroup(STKInstanceGroup *group, unsigned int tree_node, std::vector<scene::ISceneNode *> *ImmediateDraw,
+    const scene::ICameraSceneNode* cam, scene::ICameraSceneNode *shadow_cam[4], const scene::ICameraSceneNode *rsmcam,
+    bool culledforcam, bool culledforshadowcam[4], bool culledforrsm, bool drawRSM)
+{
+    const STKInstanceGroup::TreeNode &tn = group->getTreeNode(tree_node);
+    bool groupculledforcam = culledforcam || isCulledPrecise(cam, group, tn.m_edges);
+    bool groupculledforrsm = culledforrsm || !drawRSM || !UserConfigParams::m_gi || isCulledPrecise(rsmcam, group, tn.m_edges);
+    bool groupculledforshadowcam[4];
+    bool all_culled = groupculledforcam && groupculledforrsm;
+    for (unsigned i = 0; i < 4; i++)
+    {
+        groupculledforshadowcam[i] = culledforshadowcam[i] || !CVS->isShadowEnabled() || isCulledPrecise(shadow_cam[i], group, tn.m_edges);
+        all_culled = all_culled && groupculledforshadowcam[i];
+    }
+    if (all_culled)
+        return;
+
+    if (tn.m_children[0])
+    {
+        for (unsigned i = 0; i < 2; i++)
+            handleInstanceGroup(group, tn.m_children[i], ImmediateDraw, cam, shadow_cam, rsmcam, groupculledforcam, groupculledforshadowcam, groupculledforrsm, drawRSM);
+        return;
+    }
+
+    for (unsigned int n = tn.m_first; n < tn.m_last; n++)
+    {
+        STKMeshSceneNode *node = group->getInstance(n);
+        if (!node || !node->isVisible())
+            continue;
+        bool newculledforcam = groupculledforcam;
+        bool newculledforrsm = groupculledforrsm;
+        bool newculledforshadowcam[4] = { groupculledforshadowcam[0], groupculledforshadowcam[1], groupculledforshadowcam[2], groupculledforshadowcam[3] };
+        handleSTKCommon(node, ImmediateDraw, cam, shadow_cam, rsmcam, newculledforcam, newculledforshadowcam, newculledforrsm, drawRSM,
+                        group->getInstanceEdges(n));
+    }
+}
+
 static void
 parseSceneManager(core::list<scene::ISceneNode*> &List, std::vector<scene::ISceneNode *> *ImmediateDraw,
     const scene::ICameraSceneNode* cam, scene::ICameraSceneNode *shadow_cam[4], const scene::ICameraSceneNode *rsmcam,
@@ -529,6 +736,13 @@ parseSceneManager(core::list<scene::ISceneNode*> &List, std::vector<scene::IScen
             continue;
         }
 
+        if (STKInstanceGroup *group = dynamic_cast<STKInstanceGroup *>(*I))
+        {
+            if (group->getTreeNodeCount() > 0)
+                handleInstanceGroup(group, 0, ImmediateDraw, cam, shadow_cam, rsmcam, culledforcam, culledforshadowcam, culledforrsm, drawRSM);
+            continue;
+        }
+
         bool newculledforcam = culledforcam;
         bool newculledforrsm = culledforrsm;
         bool newculledforshadowcam[4] = { culledforshadowcam[0], culledforshadowcam[1], culledforshadowcam[2], culledforshadowcam[3] };
@@ -539,21 +753,105 @@ parseSceneManager(core::list<scene::ISceneNode*> &List, std::vector<scene::IScen
     }
 }
 
-template<Material::ShaderType Mat, typename T> static void
-GenDrawCalls(unsigned cascade, std::vector<GLMesh *> &InstancedList,
-    T *InstanceBuffer, DrawElementsIndirectCommand *CommandBuffer, size_t &InstanceBufferOffset, size_t &CommandBufferOffset, size_t &PolyCount)
+/** One task of filling the instance and draw command buffers: the instances
+ *  of one InstanceBatches object are written to a range of the buffers that
+ *  was reserved before, so that all tasks can run in parallel without any
+ *  locking.
+ */
+struct DrawCallTask
+{
+    InstanceBatches             *m_batches;
+    std::vector<GLMesh *>       *m_instanced_list;
+    void                        *m_instance_buffer;
+    DrawElementsIndirectCommand *m_command_buffer;
+    size_t                       m_instance_offset;
+    size_t                       m_command_offset;
+    size_t                       m_poly_count;
+    void                       (*m_fill)(DrawCallTask *task);
+};   // DrawCallTask
+
+template<typename T>
+static void fillDrawCallTask(DrawCallTask *task)
+{
+    size_t instance_offset = task->m_instance_offset;
+    size_t command_offset = task->m_command_offset;
+    task->m_poly_count = 0;
+    FillInstances<T>(*task->m_batches, *task->m_instanced_list,
+                     (T *)task->m_instance_buffer, task->m_command_buffer,
+                     instance_offset, command_offset, task->m_poly_count);
+}   // fillDrawCallTask
+
+/** Reserves the range of the buffers for the instances and commands of the
+ *  specified batches, and adds a task to fill it.
+ *  \param instance_offset and command_offset On input the start of the
+ *         range, on return the end of the range.
+ */
+template<typename T>
+static void addDrawCallTask(std::vector<DrawCallTask> *tasks,
+                            InstanceBatches &batches,
+                            std::vector<GLMesh *> &instanced_list,
+                            T *instance_buffer,
+                            DrawElementsIndirectCommand *command_buffer,
+                            size_t *instance_offset, size_t *command_offset)
+{
+    DrawCallTask task;
+    task.m_batches         = &batches;
+    task.m_instanced_list  = &instanced_list;
+    task.m_instance_buffer = instance_buffer;
+    task.m_command_buffer  = command_buffer;
+    task.m_instance_offset = *instance_offset;
+    task.m_command_offset  = *command_offset;
+    task.m_poly_count      = 0;
+    task.m_fill            = fillDrawCallTask<T>;
+    batches.count(instance_offset, command_offset);
+    tasks->push_back(task);
+}   // addDrawCallTask
+
+/** Maps an instance or command buffer for writing, used if persistent
+ *  mapping is not supported. The copies of the ring that are still used by
+ *  the GPU are not written, so the buffer is neither synchronized nor
+ *  orphaned; only the copy that is filled is flushed in unmapBuffer.
+ */
+template<typename T>
+static T *mapBuffer(GLenum target, GLuint buffer)
+{
+    glBindBuffer(target, buffer);
+    return (T *)glMapBufferRange(target, 0, INSTANCE_BUFFER_COUNT * INSTANCE_BUFFER_SIZE * sizeof(T),
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+}
+
+/** Flushes the copy of a buffer starting at first and unmaps it. */
+template<typename T>
+static void unmapBuffer(GLenum target, GLuint buffer, size_t first)
 {
-    if (CVS->supportsIndirectInstancingRendering())
-        ShadowPassCmd::getInstance()->Offset[cascade][Mat] = CommandBufferOffset; // Store command buffer offset
-    FillInstances<T>(MeshForShadowPass[Mat][cascade], InstancedList, InstanceBuffer, CommandBuffer, InstanceBufferOffset, CommandBufferOffset, PolyCount);
-    if (CVS->isAZDOEnabled())
-        ShadowPassCmd::getInstance()->Size[cascade][Mat] = CommandBufferOffset - ShadowPassCmd::getInstance()->Offset[cascade][Mat];
+    glBindBuffer(target, buffer);
+    glFlushMappedBufferRange(target, first * sizeof(T), INSTANCE_BUFFER_SIZE * sizeof(T));
+    glUnmapBuffer(target);
 }
 
-int enableOpenMP;
+static std::vector<DrawCallTask> DrawCallTasks;
+
+// ----------------------------------------------------------------------------
+/** Forgets all retained draw call batches. Must be called when the meshes
+ *  of a track are deleted.
+ */
+void clearDrawCallBatches()
+{
+    for (unsigned Mat = 0; Mat < Material::SHADERTYPE_COUNT; ++Mat)
+    {
+        MeshForSolidPass[Mat].clear();
+        MeshForRSM[Mat].clear();
+        for (unsigned i = 0; i < SHADOW_PASS_COUNT; i++)
+            MeshForShadowPass[Mat][i].clear();
+    }
+    MeshForGlowPass.clear();
+}   // clearDrawCallBatches
 
 static void FixBoundingBoxes(scene::ISceneNode* node)
 {
+    // The box of a group is computed when its instances are added
+    if (dynamic_cast<STKInstanceGroup*>(node))
+        return;
     for (scene::ISceneNode *child : node->getChildren())
     {
         FixBoundingBoxes(child);
@@ -586,53 +884,66 @@ void IrrDriver::PrepareDrawCalls(scene::ICameraSceneNode *camnode)
 
     for (unsigned Mat = 0; Mat < Material::SHADERTYPE_COUNT; ++Mat)
     {
-        MeshForSolidPass[Mat].clear();
-        MeshForRSM[Mat].clear();
-        for (unsigned i = 0; i < 4; i++)
-            MeshForShadowPass[Mat][i].clear();
+        MeshForSolidPass[Mat].clearInstances();
+        MeshForRSM[Mat].clearInstances();
+        for (unsigned i = 0; i < SHADOW_PASS_COUNT; i++)
+            MeshForShadowPass[Mat][i].clearInstances();
     }
-    MeshForGlowPass.clear();
+    MeshForGlowPass.clearInstances();
     DeferredUpdate.clear();
     core::list<scene::ISceneNode*> List = m_scene_manager->getRootSceneNode()->getChildren();
 
 PROFILER_PUSH_CPU_MARKER("- culling", 0xFF, 0xFF, 0x0);
-    for (scene::ISceneNode *child : List)
-        FixBoundingBoxes(child);
+    // The bounding boxes only depend on the scene, so in splitscreen they
+    // are only fixed when the first camera is rendered.
+    static unsigned int fixed_boxes_frame = 0;
+    if (fixed_boxes_frame != irr_driver->getRenderFrame() + 1)
+    {
+        for (scene::ISceneNode *child : List)
+            FixBoundingBoxes(child);
+        fixed_boxes_frame = irr_driver->getRenderFrame() + 1;
+    }
 
     bool cam = false, rsmcam = false;
     bool shadowcam[4] = { false, false, false, false };
+    for (unsigned i = 0; i < 4; i++)
+        ShadowCacheSignature[i] = 0;
     parseSceneManager(List, ImmediateDrawList::getInstance(), camnode, m_shadow_camnodes, m_suncam, cam, shadowcam, rsmcam, !m_rsm_map_available);
 PROFILER_POP_CPU_MARKER();
 
-    // Add a 1 s timeout
-    if (!m_sync)
-        m_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
-    PROFILER_PUSH_CPU_MARKER("- Sync Stall", 0xFF, 0x0, 0x0);
-    GLenum reason = glClientWaitSync(m_sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    // Render the static shadow cache again if the set of static shadow
+    // casters of a cascade changed
+    for (unsigned i = 0; i < 4; i++)
+    {
+        if (m_shadow_cache_used[i] &&
+            ShadowCacheSignature[i] != m_shadow_cache_signature[i])
+        {
+            m_shadow_cache_signature[i] = ShadowCacheSignature[i];
+            m_shadow_cache_rendered[i] = false;
+        }
+    }
 
-    while (reason != GL_ALREADY_SIGNALED)
+    // The instance and command buffers are used as a ring: the copy filled
+    // now was last used INSTANCE_BUFFER_COUNT scenes ago, so its fence is
+    // almost always signaled and the CPU doesn't wait for the GPU.
+    m_instance_buffer_index = (m_instance_buffer_index + 1) % INSTANCE_BUFFER_COUNT;
+    if (m_sync[m_instance_buffer_index])
     {
-        if (reason == GL_WAIT_FAILED) break;
-        StkTime::sleep(1);
-        reason = glClientWaitSync(m_sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        GLsync sync = m_sync[m_instance_buffer_index];
+        GLenum reason = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (reason == GL_TIMEOUT_EXPIRED)
+        {
+            PROFILER_PUSH_CPU_MARKER("- Sync Stall", 0xFF, 0x0, 0x0);
+            while (reason == GL_TIMEOUT_EXPIRED)
+            {
+                StkTime::sleep(1);
+                reason = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            }
+            PROFILER_POP_CPU_MARKER();
+        }
+        glDeleteSync(sync);
+        m_sync[m_instance_buffer_index] = 0;
     }
-    glDeleteSync(m_sync);
-    PROFILER_POP_CPU_MARKER();
-    /*    switch (reason)
-    {
-    case GL_ALREADY_SIGNALED:
-    printf("Already Signaled\n");
-    break;
-    case GL_TIMEOUT_EXPIRED:
-    printf("Timeout Expired\n");
-    break;
-    case GL_CONDITION_SATISFIED:
-    printf("Condition Satisfied\n");
-    break;
-    case GL_WAIT_FAILED:
-    printf("Wait Failed\n");
-    break;
-    }*/
     PROFILER_PUSH_CPU_MARKER("- Animations/Buffer upload", 0x0, 0x0, 0x0);
     for (unsigned i = 0; i < DeferredUpdate.size(); i++)
         DeferredUpdate[i]->updateGL();
@@ -644,28 +955,44 @@ PROFILER_POP_CPU_MARKER();
     InstanceDataDualTex *InstanceBufferDualTex;
     InstanceDataThreeTex *InstanceBufferThreeTex;
     InstanceDataSingleTex *ShadowInstanceBuffer;
-    InstanceDataSingleTex *RSMInstanceBuffer;
+    InstanceDataSingleTex *RSMInstanceBuffer = NULL;
     GlowInstanceData *GlowInstanceBuffer;
     DrawElementsIndirectCommand *CmdBuffer;
     DrawElementsIndirectCommand *ShadowCmdBuffer;
-    DrawElementsIndirectCommand *RSMCmdBuffer;
+    DrawElementsIndirectCommand *RSMCmdBuffer = NULL;
     DrawElementsIndirectCommand *GlowCmdBuffer;
+    VAOManager *vao_manager = VAOManager::getInstance();
+    const bool drawRSM = !m_rsm_map_available;
+
+    PROFILER_PUSH_CPU_MARKER("- Draw Command upload", 0xFF, 0x0, 0xFF);
 
     if (CVS->supportsAsyncInstanceUpload())
     {
-        InstanceBufferDualTex = (InstanceDataDualTex*)VAOManager::getInstance()->getInstanceBufferPtr(InstanceTypeDualTex);
-        InstanceBufferThreeTex = (InstanceDataThreeTex*)VAOManager::getInstance()->getInstanceBufferPtr(InstanceTypeThreeTex);
-        ShadowInstanceBuffer = (InstanceDataSingleTex*)VAOManager::getInstance()->getInstanceBufferPtr(InstanceTypeShadow);
-        RSMInstanceBuffer = (InstanceDataSingleTex*)VAOManager::getInstance()->getInstanceBufferPtr(InstanceTypeRSM);
-        GlowInstanceBuffer = (GlowInstanceData*)VAOManager::getInstance()->getInstanceBufferPtr(InstanceTypeGlow);
+        InstanceBufferDualTex = (InstanceDataDualTex*)vao_manager->getInstanceBufferPtr(InstanceTypeDualTex);
+        InstanceBufferThreeTex = (InstanceDataThreeTex*)vao_manager->getInstanceBufferPtr(InstanceTypeThreeTex);
+        ShadowInstanceBuffer = (InstanceDataSingleTex*)vao_manager->getInstanceBufferPtr(InstanceTypeShadow);
+        RSMInstanceBuffer = (InstanceDataSingleTex*)vao_manager->getInstanceBufferPtr(InstanceTypeRSM);
+        GlowInstanceBuffer = (GlowInstanceData*)vao_manager->getInstanceBufferPtr(InstanceTypeGlow);
         CmdBuffer = SolidPassCmd::getInstance()->Ptr;
         ShadowCmdBuffer = ShadowPassCmd::getInstance()->Ptr;
         GlowCmdBuffer = GlowPassCmd::getInstance()->Ptr;
         RSMCmdBuffer = RSMPassCmd::getInstance()->Ptr;
-        enableOpenMP = 1;
     }
     else
-        enableOpenMP = 0;
+    {
+        InstanceBufferDualTex = mapBuffer<InstanceDataDualTex>(GL_ARRAY_BUFFER, vao_manager->getInstanceBuffer(InstanceTypeDualTex));
+        InstanceBufferThreeTex = mapBuffer<InstanceDataThreeTex>(GL_ARRAY_BUFFER, vao_manager->getInstanceBuffer(InstanceTypeThreeTex));
+        ShadowInstanceBuffer = mapBuffer<InstanceDataSingleTex>(GL_ARRAY_BUFFER, vao_manager->getInstanceBuffer(InstanceTypeShadow));
+        GlowInstanceBuffer = mapBuffer<GlowInstanceData>(GL_ARRAY_BUFFER, vao_manager->getInstanceBuffer(InstanceTypeGlow));
+        CmdBuffer = mapBuffer<DrawElementsIndirectCommand>(GL_DRAW_INDIRECT_BUFFER, SolidPassCmd::getInstance()->drawindirectcmd);
+        ShadowCmdBuffer = mapBuffer<DrawElementsIndirectCommand>(GL_DRAW_INDIRECT_BUFFER, ShadowPassCmd::getInstance()->drawindirectcmd);
+        GlowCmdBuffer = mapBuffer<DrawElementsIndirectCommand>(GL_DRAW_INDIRECT_BUFFER, GlowPassCmd::getInstance()->drawindirectcmd);
+        if (drawRSM)
+        {
+            RSMInstanceBuffer = mapBuffer<InstanceDataSingleTex>(GL_ARRAY_BUFFER, vao_manager->getInstanceBuffer(InstanceTypeRSM));
+            RSMCmdBuffer = mapBuffer<DrawElementsIndirectCommand>(GL_DRAW_INDIRECT_BUFFER, RSMPassCmd::getInstance()->drawindirectcmd);
+        }
+    }
 
     ListInstancedMatDefault::getInstance()->clear();
     ListInstancedMatAlphaRef::getInstance()->clear();
@@ -675,179 +1002,125 @@ PROFILER_POP_CPU_MARKER();
     ListInstancedMatDetails::getInstance()->clear();
     ListInstancedMatUnlit::getInstance()->clear();
 
-    size_t SolidPoly = 0, ShadowPoly = 0, MiscPoly = 0;
-
-    PROFILER_PUSH_CPU_MARKER("- Draw Command upload", 0xFF, 0x0, 0xFF);
-
-#pragma omp parallel sections if(enableOpenMP)
+    // Reserve the buffer ranges of all passes (in the same layout as the
+    // draw functions expect) in the current copy of the buffers, and create
+    // one task per pass, shader type and shadow cascade.
+    const size_t first = m_instance_buffer_index * INSTANCE_BUFFER_SIZE;
+    DrawCallTasks.clear();
     {
-#pragma omp section
-        {
-            size_t offset = 0, current_cmd = 0;
-            if (!CVS->supportsAsyncInstanceUpload())
-            {
-                glBindBuffer(GL_ARRAY_BUFFER, VAOManager::getInstance()->getInstanceBuffer(InstanceTypeDualTex));
-                InstanceBufferDualTex = (InstanceDataDualTex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, 10000 * sizeof(InstanceDataDualTex), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, SolidPassCmd::getInstance()->drawindirectcmd);
-                CmdBuffer = (DrawElementsIndirectCommand*)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, 10000 * sizeof(DrawElementsIndirectCommand), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-            }
-
-
-            // Default Material
-            SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_SOLID] = current_cmd;
-            FillInstances(MeshForSolidPass[Material::SHADERTYPE_SOLID], ListInstancedMatDefault::getInstance()->SolidPass, InstanceBufferDualTex, CmdBuffer, offset, current_cmd, SolidPoly);
-            SolidPassCmd::getInstance()->Size[Material::SHADERTYPE_SOLID] = current_cmd - SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_SOLID];
-            // Alpha Ref
-            SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_ALPHA_TEST] = current_cmd;
-            FillInstances(MeshForSolidPass[Material::SHADERTYPE_ALPHA_TEST], ListInstancedMatAlphaRef::getInstance()->SolidPass, InstanceBufferDualTex, CmdBuffer, offset, current_cmd, SolidPoly);
-            SolidPassCmd::getInstance()->Size[Material::SHADERTYPE_ALPHA_TEST] = current_cmd - SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_ALPHA_TEST];
-            // Unlit
-            SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_SOLID_UNLIT] = current_cmd;
-            FillInstances(MeshForSolidPass[Material::SHADERTYPE_SOLID_UNLIT], ListInstancedMatUnlit::getInstance()->SolidPass, InstanceBufferDualTex, CmdBuffer, offset, current_cmd, SolidPoly);
-            SolidPassCmd::getInstance()->Size[Material::SHADERTYPE_SOLID_UNLIT] = current_cmd - SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_SOLID_UNLIT];
-            // Spheremap
-            SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_SPHERE_MAP] = current_cmd;
-            FillInstances(MeshForSolidPass[Material::SHADERTYPE_SPHERE_MAP], ListInstancedMatSphereMap::getInstance()->SolidPass, InstanceBufferDualTex, CmdBuffer, offset, current_cmd, SolidPoly);
-            SolidPassCmd::getInstance()->Size[Material::SHADERTYPE_SPHERE_MAP] = current_cmd - SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_SPHERE_MAP];
-            // Grass
-            SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_VEGETATION] = current_cmd;
-            FillInstances(MeshForSolidPass[Material::SHADERTYPE_VEGETATION], ListInstancedMatGrass::getInstance()->SolidPass, InstanceBufferDualTex, CmdBuffer, offset, current_cmd, SolidPoly);
-            SolidPassCmd::getInstance()->Size[Material::SHADERTYPE_VEGETATION] = current_cmd - SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_VEGETATION];
-
-            if (!CVS->supportsAsyncInstanceUpload())
-            {
-                glUnmapBuffer(GL_ARRAY_BUFFER);
-                glBindBuffer(GL_ARRAY_BUFFER, VAOManager::getInstance()->getInstanceBuffer(InstanceTypeThreeTex));
-                InstanceBufferThreeTex = (InstanceDataThreeTex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, 10000 * sizeof(InstanceDataSingleTex), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-
-            }
-
-            // Detail
-            SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_DETAIL_MAP] = current_cmd;
-            FillInstances(MeshForSolidPass[Material::SHADERTYPE_DETAIL_MAP], ListInstancedMatDetails::getInstance()->SolidPass, InstanceBufferThreeTex, CmdBuffer, offset, current_cmd, SolidPoly);
-            SolidPassCmd::getInstance()->Size[Material::SHADERTYPE_DETAIL_MAP] = current_cmd - SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_DETAIL_MAP];
-            // Normal Map
-            SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_NORMAL_MAP] = current_cmd;
-            FillInstances(MeshForSolidPass[Material::SHADERTYPE_NORMAL_MAP], ListInstancedMatNormalMap::getInstance()->SolidPass, InstanceBufferThreeTex, CmdBuffer, offset, current_cmd, SolidPoly);
-            SolidPassCmd::getInstance()->Size[Material::SHADERTYPE_NORMAL_MAP] = current_cmd - SolidPassCmd::getInstance()->Offset[Material::SHADERTYPE_NORMAL_MAP];
+        size_t offset = first, current_cmd = first;
+        SolidPassCmd *cmd = SolidPassCmd::getInstance();
+#define ADD_SOLID_TASK(MAT, LIST, BUFFER)                                      \
+        cmd->Offset[MAT] = current_cmd;                                        \
+        addDrawCallTask(&DrawCallTasks, MeshForSolidPass[MAT],                 \
+                        LIST::getInstance()->SolidPass, BUFFER, CmdBuffer,     \
+                        &offset, &current_cmd);                                \
+        cmd->Size[MAT] = current_cmd - cmd->Offset[MAT];
+        ADD_SOLID_TASK(Material::SHADERTYPE_SOLID, ListInstancedMatDefault, InstanceBufferDualTex);
+        ADD_SOLID_TASK(Material::SHADERTYPE_ALPHA_TEST, ListInstancedMatAlphaRef, InstanceBufferDualTex);
+        ADD_SOLID_TASK(Material::SHADERTYPE_SOLID_UNLIT, ListInstancedMatUnlit, InstanceBufferDualTex);
+        ADD_SOLID_TASK(Material::SHADERTYPE_SPHERE_MAP, ListInstancedMatSphereMap, InstanceBufferDualTex);
+        ADD_SOLID_TASK(Material::SHADERTYPE_VEGETATION, ListInstancedMatGrass, InstanceBufferDualTex);
+        ADD_SOLID_TASK(Material::SHADERTYPE_DETAIL_MAP, ListInstancedMatDetails, InstanceBufferThreeTex);
+        ADD_SOLID_TASK(Material::SHADERTYPE_NORMAL_MAP, ListInstancedMatNormalMap, InstanceBufferThreeTex);
+#undef ADD_SOLID_TASK
+        assert(offset <= first + INSTANCE_BUFFER_SIZE && current_cmd <= first + INSTANCE_BUFFER_SIZE);
+    }
+    const size_t num_solid_tasks = DrawCallTasks.size();
 
+    {
+        size_t offset = first, current_cmd = first;
+        GlowPassCmd::getInstance()->Offset = current_cmd;
+        addDrawCallTask(&DrawCallTasks, MeshForGlowPass,
+                        *ListInstancedGlow::getInstance(), GlowInstanceBuffer,
+                        GlowCmdBuffer, &offset, &current_cmd);
+        GlowPassCmd::getInstance()->Size = current_cmd - GlowPassCmd::getInstance()->Offset;
+        assert(offset <= first + INSTANCE_BUFFER_SIZE && current_cmd <= first + INSTANCE_BUFFER_SIZE);
+    }
+    const size_t first_shadow_task = DrawCallTasks.size();
 
-            if (!CVS->supportsAsyncInstanceUpload())
-            {
-                glUnmapBuffer(GL_ARRAY_BUFFER);
-                glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
-            }
-        }
-#pragma omp section
+    irr_driver->setPhase(SHADOW_PASS);
+    {
+        size_t offset = first, current_cmd = first;
+        ShadowPassCmd *cmd = ShadowPassCmd::getInstance();
+        for (unsigned i = 0; i < SHADOW_PASS_COUNT; i++)
         {
-            size_t offset = 0, current_cmd = 0;
-
-            if (!CVS->supportsAsyncInstanceUpload())
-            {
-                glBindBuffer(GL_ARRAY_BUFFER, VAOManager::getInstance()->getInstanceBuffer(InstanceTypeGlow));
-                GlowInstanceBuffer = (GlowInstanceData*)glMapBufferRange(GL_ARRAY_BUFFER, 0, 10000 * sizeof(InstanceDataDualTex), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, GlowPassCmd::getInstance()->drawindirectcmd);
-                GlowCmdBuffer = (DrawElementsIndirectCommand*)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, 10000 * sizeof(DrawElementsIndirectCommand), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-            }
-
-            // Glow
-            if (CVS->supportsIndirectInstancingRendering())
-                GlowPassCmd::getInstance()->Offset = offset; // Store command buffer offset
-
-            auto It = MeshForGlowPass.begin(), E = MeshForGlowPass.end();
-            for (; It != E; ++It)
-            {
-                size_t Polycnt = 0;
-                FillInstances_impl<GlowInstanceData>(It->second, GlowInstanceBuffer, GlowCmdBuffer, offset, current_cmd, Polycnt);
-                if (!CVS->isAZDOEnabled())
-                    ListInstancedGlow::getInstance()->push_back(It->second.front().first);
-            }
-
-            if (CVS->isAZDOEnabled())
-                GlowPassCmd::getInstance()->Size = current_cmd - GlowPassCmd::getInstance()->Offset;
-
-            if (!CVS->supportsAsyncInstanceUpload())
-            {
-                glUnmapBuffer(GL_ARRAY_BUFFER);
-                glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
-            }
+#define ADD_SHADOW_TASK(MAT, LIST)                                             \
+            cmd->Offset[i][MAT] = current_cmd;                                 \
+            addDrawCallTask(&DrawCallTasks, MeshForShadowPass[MAT][i],         \
+                            LIST::getInstance()->Shadows[i],                   \
+                            ShadowInstanceBuffer, ShadowCmdBuffer,             \
+                            &offset, &current_cmd);                            \
+            cmd->Size[i][MAT] = current_cmd - cmd->Offset[i][MAT];
+            ADD_SHADOW_TASK(Material::SHADERTYPE_SOLID, ListInstancedMatDefault);
+            ADD_SHADOW_TASK(Material::SHADERTYPE_ALPHA_TEST, ListInstancedMatAlphaRef);
+            ADD_SHADOW_TASK(Material::SHADERTYPE_SOLID_UNLIT, ListInstancedMatUnlit);
+            ADD_SHADOW_TASK(Material::SHADERTYPE_NORMAL_MAP, ListInstancedMatNormalMap);
+            ADD_SHADOW_TASK(Material::SHADERTYPE_SPHERE_MAP, ListInstancedMatSphereMap);
+            ADD_SHADOW_TASK(Material::SHADERTYPE_DETAIL_MAP, ListInstancedMatDetails);
+            ADD_SHADOW_TASK(Material::SHADERTYPE_VEGETATION, ListInstancedMatGrass);
+#undef ADD_SHADOW_TASK
         }
-#pragma omp section
-        {
-            irr_driver->setPhase(SHADOW_PASS);
+        assert(offset <= first + INSTANCE_BUFFER_SIZE && current_cmd <= first + INSTANCE_BUFFER_SIZE);
+    }
+    const size_t last_shadow_task = DrawCallTasks.size();
 
-            size_t offset = 0, current_cmd = 0;
-            if (!CVS->supportsAsyncInstanceUpload())
-            {
-                glBindBuffer(GL_ARRAY_BUFFER, VAOManager::getInstance()->getInstanceBuffer(InstanceTypeShadow));
-                ShadowInstanceBuffer = (InstanceDataSingleTex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, 10000 * sizeof(InstanceDataDualTex), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ShadowPassCmd::getInstance()->drawindirectcmd);
-                ShadowCmdBuffer = (DrawElementsIndirectCommand*)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, 10000 * sizeof(DrawElementsIndirectCommand), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-            }
+    if (drawRSM)
+    {
+        size_t offset = first, current_cmd = first;
+        RSMPassCmd *cmd = RSMPassCmd::getInstance();
+#define ADD_RSM_TASK(MAT, LIST)                                                \
+        cmd->Offset[MAT] = current_cmd;                                        \
+        addDrawCallTask(&DrawCallTasks, MeshForRSM[MAT],                       \
+                        LIST::getInstance()->RSM, RSMInstanceBuffer,           \
+                        RSMCmdBuffer, &offset, &current_cmd);                  \
+        cmd->Size[MAT] = current_cmd - cmd->Offset[MAT];
+        ADD_RSM_TASK(Material::SHADERTYPE_SOLID, ListInstancedMatDefault);
+        ADD_RSM_TASK(Material::SHADERTYPE_ALPHA_TEST, ListInstancedMatAlphaRef);
+        ADD_RSM_TASK(Material::SHADERTYPE_SOLID_UNLIT, ListInstancedMatUnlit);
+        ADD_RSM_TASK(Material::SHADERTYPE_DETAIL_MAP, ListInstancedMatDetails);
+        ADD_RSM_TASK(Material::SHADERTYPE_NORMAL_MAP, ListInstancedMatNormalMap);
+#undef ADD_RSM_TASK
+        assert(offset <= first + INSTANCE_BUFFER_SIZE && current_cmd <= first + INSTANCE_BUFFER_SIZE);
+    }
 
-            for (unsigned i = 0; i < 4; i++)
-            {
-                // Mat default
-                GenDrawCalls<Material::SHADERTYPE_SOLID>(i, ListInstancedMatDefault::getInstance()->Shadows[i], ShadowInstanceBuffer, ShadowCmdBuffer, offset, current_cmd, ShadowPoly);
-                // Mat AlphaRef
-                GenDrawCalls<Material::SHADERTYPE_ALPHA_TEST>(i, ListInstancedMatAlphaRef::getInstance()->Shadows[i], ShadowInstanceBuffer, ShadowCmdBuffer, offset, current_cmd, ShadowPoly);
-                // Mat Unlit
-                GenDrawCalls<Material::SHADERTYPE_SOLID_UNLIT>(i, ListInstancedMatUnlit::getInstance()->Shadows[i], ShadowInstanceBuffer, ShadowCmdBuffer, offset, current_cmd, ShadowPoly);
-                // Mat NormalMap
-                GenDrawCalls<Material::SHADERTYPE_NORMAL_MAP>(i, ListInstancedMatNormalMap::getInstance()->Shadows[i], ShadowInstanceBuffer, ShadowCmdBuffer, offset, current_cmd, ShadowPoly);
-                // Mat Spheremap
-                GenDrawCalls<Material::SHADERTYPE_SPHERE_MAP>(i, ListInstancedMatSphereMap::getInstance()->Shadows[i], ShadowInstanceBuffer, ShadowCmdBuffer, offset, current_cmd, ShadowPoly);
-                // Mat Detail
-                GenDrawCalls<Material::SHADERTYPE_DETAIL_MAP>(i, ListInstancedMatDetails::getInstance()->Shadows[i], ShadowInstanceBuffer, ShadowCmdBuffer, offset, current_cmd, ShadowPoly);
-                // Mat Grass
-                GenDrawCalls<Material::SHADERTYPE_VEGETATION>(i, ListInstancedMatGrass::getInstance()->Shadows[i], ShadowInstanceBuffer, ShadowCmdBuffer, offset, current_cmd, ShadowPoly);
-            }
-            if (!CVS->supportsAsyncInstanceUpload())
+    // With persistently mapped buffers the tasks can be executed by the
+    // worker threads, otherwise the buffers must be unmapped by this thread
+    // anyway, and the tasks are cheap enough to do them here.
+    if (CVS->supportsAsyncInstanceUpload())
+    {
+        WorkerPool::get()->parallelFor((unsigned int)DrawCallTasks.size(), 1,
+            [](unsigned int first, unsigned int last)
             {
-                glUnmapBuffer(GL_ARRAY_BUFFER);
-                glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
-            }
-        }
-#pragma omp section
-        if (!m_rsm_map_available)
+                for (unsigned int i = first; i < last; i++)
+                    DrawCallTasks[i].m_fill(&DrawCallTasks[i]);
+            }, "Instance upload");
+    }
+    else
+    {
+        for (unsigned int i = 0; i < DrawCallTasks.size(); i++)
+            DrawCallTasks[i].m_fill(&DrawCallTasks[i]);
+
+        unmapBuffer<InstanceDataDualTex>(GL_ARRAY_BUFFER, vao_manager->getInstanceBuffer(InstanceTypeDualTex), first);
+        unmapBuffer<InstanceDataThreeTex>(GL_ARRAY_BUFFER, vao_manager->getInstanceBuffer(InstanceTypeThreeTex), first);
+        unmapBuffer<InstanceDataSingleTex>(GL_ARRAY_BUFFER, vao_manager->getInstanceBuffer(InstanceTypeShadow), first);
+        unmapBuffer<GlowInstanceData>(GL_ARRAY_BUFFER, vao_manager->getInstanceBuffer(InstanceTypeGlow), first);
+        unmapBuffer<DrawElementsIndirectCommand>(GL_DRAW_INDIRECT_BUFFER, SolidPassCmd::getInstance()->drawindirectcmd, first);
+        unmapBuffer<DrawElementsIndirectCommand>(GL_DRAW_INDIRECT_BUFFER, ShadowPassCmd::getInstance()->drawindirectcmd, first);
+        unmapBuffer<DrawElementsIndirectCommand>(GL_DRAW_INDIRECT_BUFFER, GlowPassCmd::getInstance()->drawindirectcmd, first);
+        if (drawRSM)
         {
-            size_t offset = 0, current_cmd = 0;
-            if (!CVS->supportsAsyncInstanceUpload())
-            {
-                glBindBuffer(GL_ARRAY_BUFFER, VAOManager::getInstance()->getInstanceBuffer(InstanceTypeRSM));
-                RSMInstanceBuffer = (InstanceDataSingleTex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, 10000 * sizeof(InstanceDataDualTex), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, RSMPassCmd::getInstance()->drawindirectcmd);
-                RSMCmdBuffer = (DrawElementsIndirectCommand*)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, 10000 * sizeof(DrawElementsIndirectCommand), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-            }
-
-            // Default Material
-            RSMPassCmd::getInstance()->Offset[Material::SHADERTYPE_SOLID] = current_cmd;
-            FillInstances(MeshForRSM[Material::SHADERTYPE_SOLID], ListInstancedMatDefault::getInstance()->RSM, RSMInstanceBuffer, RSMCmdBuffer, offset, current_cmd, MiscPoly);
-            RSMPassCmd::getInstance()->Size[Material::SHADERTYPE_SOLID] = current_cmd - RSMPassCmd::getInstance()->Offset[Material::SHADERTYPE_SOLID];
-            // Alpha Ref
-            RSMPassCmd::getInstance()->Offset[Material::SHADERTYPE_ALPHA_TEST] = current_cmd;
-            FillInstances(MeshForRSM[Material::SHADERTYPE_ALPHA_TEST], ListInstancedMatAlphaRef::getInstance()->RSM, RSMInstanceBuffer, RSMCmdBuffer, offset, current_cmd, MiscPoly);
-            RSMPassCmd::getInstance()->Size[Material::SHADERTYPE_ALPHA_TEST] = current_cmd - RSMPassCmd::getInstance()->Offset[Material::SHADERTYPE_ALPHA_TEST];
-            // Unlit
-            RSMPassCmd::getInstance()->Offset[Material::SHADERTYPE_SOLID_UNLIT] = current_cmd;
-            FillInstances(MeshForRSM[Material::SHADERTYPE_SOLID_UNLIT], ListInstancedMatUnlit::getInstance()->RSM, RSMInstanceBuffer, RSMCmdBuffer, offset, current_cmd, MiscPoly);
-            RSMPassCmd::getInstance()->Size[Material::SHADERTYPE_SOLID_UNLIT] = current_cmd - RSMPassCmd::getInstance()->Offset[Material::SHADERTYPE_SOLID_UNLIT];
-            // Detail
-            RSMPassCmd::getInstance()->Offset[Material::SHADERTYPE_DETAIL_MAP] = current_cmd;
-            FillInstances(MeshForRSM[Material::SHADERTYPE_DETAIL_MAP], ListInstancedMatDetails::getInstance()->RSM, RSMInstanceBuffer, RSMCmdBuffer, offset, current_cmd, MiscPoly);
-            RSMPassCmd::getInstance()->Size[Material::SHADERTYPE_DETAIL_MAP] = current_cmd - RSMPassCmd::getInstance()->Offset[Material::SHADERTYPE_DETAIL_MAP];
-            // Normal Map
-            RSMPassCmd::getInstance()->Offset[Material::SHADERTYPE_NORMAL_MAP] = current_cmd;
-            FillInstances(MeshForRSM[Material::SHADERTYPE_NORMAL_MAP], ListInstancedMatNormalMap::getInstance()->RSM, RSMInstanceBuffer, RSMCmdBuffer, offset, current_cmd, MiscPoly);
-            RSMPassCmd::getInstance()->Size[Material::SHADERTYPE_NORMAL_MAP] = current_cmd - RSMPassCmd::getInstance()->Offset[Material::SHADERTYPE_NORMAL_MAP];
-
-            if (!CVS->supportsAsyncInstanceUpload())
-            {
-                glUnmapBuffer(GL_ARRAY_BUFFER);
-                glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
-            }
+            unmapBuffer<InstanceDataSingleTex>(GL_ARRAY_BUFFER, vao_manager->getInstanceBuffer(InstanceTypeRSM), first);
+            unmapBuffer<DrawElementsIndirectCommand>(GL_DRAW_INDIRECT_BUFFER, RSMPassCmd::getInstance()->drawindirectcmd, first);
         }
     }
+
+    size_t SolidPoly = 0, ShadowPoly = 0;
+    for (unsigned int i = 0; i < num_solid_tasks; i++)
+        SolidPoly += DrawCallTasks[i].m_poly_count;
+    for (size_t i = first_shadow_task; i < last_shadow_task; i++)
+        ShadowPoly += DrawCallTasks[i].m_poly_count;
+
     PROFILER_POP_CPU_MARKER();
     poly_count[SOLID_NORMAL_AND_DEPTH_PASS] += SolidPoly;
     poly_count[SHADOW_PASS] += ShadowPoly;
@@ -37,16 +37,17 @@ public:
     DrawElementsIndirectCommand *Ptr;
     CommandBuffer()
     {
+        const size_t size = INSTANCE_BUFFER_COUNT * INSTANCE_BUFFER_SIZE * sizeof(DrawElementsIndirectCommand);
         glGenBuffers(1, &drawindirectcmd);
         glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawindirectcmd);
         if (CVS->supportsAsyncInstanceUpload())
         {
-            glBufferStorage(GL_DRAW_INDIRECT_BUFFER, 10000 * sizeof(DrawElementsIndirectCommand), 0, GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT);
-            Ptr = (DrawElementsIndirectCommand *)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, 10000 * sizeof(DrawElementsIndirectCommand), GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT);
+            glBufferStorage(GL_DRAW_INDIRECT_BUFFER, size, 0, GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT);
+            Ptr = (DrawElementsIndirectCommand *)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, size, GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT);
         }
         else
         {
-            glBufferData(GL_DRAW_INDIRECT_BUFFER, 10000 * sizeof(DrawElementsIndirectCommand), 0, GL_STREAM_DRAW);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, size, 0, GL_STREAM_DRAW);
         }
     }
 };
@@ -70,7 +71,7 @@ public:
 class ShadowPassCmd : public CommandBuffer<ShadowPassCmd>
 {
 public:
-    size_t Offset[4][Material::SHADERTYPE_COUNT], Size[4][Material::SHADERTYPE_COUNT];
+    size_t Offset[SHADOW_PASS_COUNT][Material::SHADERTYPE_COUNT], Size[SHADOW_PASS_COUNT][Material::SHADERTYPE_COUNT];
 };
 
 class RSMPassCmd : public CommandBuffer<RSMPassCmd>
@@ -85,5 +86,6 @@ public:
     size_t Offset, Size;
 };
 
+void clearDrawCallBatches();
 
 #endif
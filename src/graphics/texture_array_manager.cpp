@@ -0,0 +1,247 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/texture_array_manager.hpp"
+
+#include "graphics/stkmesh.hpp"
+#include "graphics/texturemanager.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+TextureArrayManager::TextureArrayManager()
+{
+    m_generation = 1;
+}   // TextureArrayManager
+
+// ----------------------------------------------------------------------------
+TextureArrayManager::~TextureArrayManager()
+{
+    reset();
+}   // ~TextureArrayManager
+
+// ----------------------------------------------------------------------------
+/** Deletes all texture arrays. Must be called when the meshes of a track are
+ *  deleted, together with clearDrawCallBatches.
+ */
+void TextureArrayManager::reset()
+{
+    for (const Group &group : m_groups)
+        glDeleteTextures(2, group.m_arrays);
+    m_groups.clear();
+    m_layers.clear();
+    m_unsupported.clear();
+    m_generation++;
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Queries the size, format and number of mipmap levels of a texture.
+ *  \return False if the texture has no storage.
+ */
+bool TextureArrayManager::getFormat(GLuint texture,
+                                    TextureFormat *format) const
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH,
+                             &format->m_width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT,
+                             &format->m_height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT,
+                             &format->m_format);
+    if (format->m_width <= 0 || format->m_height <= 0)
+        return false;
+
+    GLint max_levels = 1;
+    for (GLint size = std::max(format->m_width, format->m_height); size > 1;
+         size /= 2)
+        max_levels++;
+    format->m_levels = 1;
+    while (format->m_levels < max_levels)
+    {
+        GLint width = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, format->m_levels,
+                                 GL_TEXTURE_WIDTH, &width);
+        if (width == 0)
+            break;
+        format->m_levels++;
+    }
+    return true;
+}   // getFormat
+
+// ----------------------------------------------------------------------------
+/** Creates an immutable texture array.
+ *  \return The texture, or 0 if the format can't be used for an array.
+ */
+GLuint TextureArrayManager::createArray(const TextureFormat &format,
+                                        unsigned layers) const
+{
+    GLuint id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+    while (glGetError() != GL_NO_ERROR) {}
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, format.m_levels, format.m_format,
+                   format.m_width, format.m_height, layers);
+    if (glGetError() != GL_NO_ERROR)
+    {
+        glDeleteTextures(1, &id);
+        return 0;
+    }
+    return id;
+}   // createArray
+
+// ----------------------------------------------------------------------------
+/** Copies all mipmap levels of a texture (or of a layer of an array) into a
+ *  layer of an array.
+ */
+void TextureArrayManager::copyLayer(GLuint src, GLenum src_target,
+                                    unsigned src_layer, GLuint dst,
+                                    unsigned dst_layer,
+                                    const TextureFormat &format) const
+{
+    for (GLint level = 0; level < format.m_levels; level++)
+    {
+        glCopyImageSubData(src, src_target, level, 0, 0, src_layer,
+                           dst, GL_TEXTURE_2D_ARRAY, level, 0, 0, dst_layer,
+                           std::max(1, format.m_width >> level),
+                           std::max(1, format.m_height >> level), 1);
+    }
+}   // copyLayer
+
+// ----------------------------------------------------------------------------
+/** Doubles the number of layers of the arrays of a group.
+ *  \return False if the arrays couldn't be created.
+ */
+bool TextureArrayManager::growGroup(Group *group)
+{
+    const unsigned capacity = group->m_capacity == 0
+                            ? 4 : std::min(2 * group->m_capacity, MAX_LAYERS);
+    GLuint arrays[2];
+    arrays[0] = createArray(group->m_key.first, capacity);
+    arrays[1] = arrays[0] ? createArray(group->m_key.second, capacity) : 0;
+    if (!arrays[1])
+    {
+        if (arrays[0])
+            glDeleteTextures(1, &arrays[0]);
+        return false;
+    }
+    for (unsigned layer = 0; layer < group->m_num_layers; layer++)
+    {
+        copyLayer(group->m_arrays[0], GL_TEXTURE_2D_ARRAY, layer, arrays[0],
+                  layer, group->m_key.first);
+        copyLayer(group->m_arrays[1], GL_TEXTURE_2D_ARRAY, layer, arrays[1],
+                  layer, group->m_key.second);
+    }
+    if (group->m_capacity > 0)
+        glDeleteTextures(2, group->m_arrays);
+    group->m_arrays[0] = arrays[0];
+    group->m_arrays[1] = arrays[1];
+    group->m_capacity = capacity;
+    return true;
+}   // growGroup
+
+// ----------------------------------------------------------------------------
+/** Copies the albedo and specular map of a mesh into a layer of the texture
+ *  arrays of their size and format, unless this was already done. Textures
+ *  shared by several meshes are only packed once.
+ */
+void TextureArrayManager::pack(GLMesh *mesh)
+{
+    if (mesh->TextureArrayGeneration == m_generation)
+        return;
+    mesh->TextureArrayGeneration = m_generation;
+    mesh->TextureArrayGroup = 0;
+    if (!mesh->textures[0] || !mesh->textures[1])
+        return;
+
+    const std::pair<GLuint, GLuint> textures(
+                                         getTextureGLuint(mesh->textures[0]),
+                                         getTextureGLuint(mesh->textures[1]));
+    unsigned group;
+    unsigned layer;
+    auto it = m_layers.find(textures);
+    if (it != m_layers.end())
+    {
+        group = it->second.first;
+        layer = it->second.second;
+    }
+    else
+    {
+        GroupKey key;
+        if (!getFormat(textures.first, &key.first) ||
+            !getFormat(textures.second, &key.second) ||
+            m_unsupported.count(key))
+            return;
+
+        group = 0;
+        for (unsigned i = 0; i < m_groups.size(); i++)
+        {
+            if (!(m_groups[i].m_key < key) && !(key < m_groups[i].m_key) &&
+                m_groups[i].m_num_layers < MAX_LAYERS)
+            {
+                group = i + 1;
+                break;
+            }
+        }
+        if (group == 0)
+        {
+            Group new_group;
+            new_group.m_key = key;
+            new_group.m_arrays[0] = new_group.m_arrays[1] = 0;
+            new_group.m_num_layers = 0;
+            new_group.m_capacity = 0;
+            m_groups.push_back(new_group);
+            group = (unsigned)m_groups.size();
+        }
+
+        Group &g = m_groups[group - 1];
+        if (g.m_num_layers == g.m_capacity && !growGroup(&g))
+        {
+            if (g.m_capacity == 0)
+            {
+                Log::info("TextureArrayManager",
+                          "Format 0x%x of size %dx%d can't be used in a "
+                          "texture array.", key.first.m_format,
+                          key.first.m_width, key.first.m_height);
+                m_groups.pop_back();
+                m_unsupported.insert(key);
+            }
+            return;
+        }
+        layer = g.m_num_layers++;
+        copyLayer(textures.first, GL_TEXTURE_2D, 0, g.m_arrays[0], layer,
+                  key.first);
+        copyLayer(textures.second, GL_TEXTURE_2D, 0, g.m_arrays[1], layer,
+                  key.second);
+        m_layers[textures] = std::make_pair(group, layer);
+    }
+
+    mesh->TextureArrayGroup = group;
+    mesh->TextureHandles[0] = layer;
+    mesh->TextureHandles[1] = layer;
+}   // pack
+
+// ----------------------------------------------------------------------------
+/** Returns the group of texture arrays a mesh was packed into, or 0 if its
+ *  textures are not in an array.
+ */
+unsigned TextureArrayManager::getGroup(const GLMesh *mesh) const
+{
+    if (mesh->TextureArrayGeneration != m_generation)
+        return 0;
+    return mesh->TextureArrayGroup;
+}   // getGroup
@@ -0,0 +1,111 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_TEXTURE_ARRAY_MANAGER_HPP
+#define HEADER_TEXTURE_ARRAY_MANAGER_HPP
+
+#include "graphics/gl_headers.hpp"
+#include "utils/no_copy.hpp"
+#include "utils/singleton.hpp"
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+struct GLMesh;
+
+/** Packs the textures of solid meshes into texture arrays, so that meshes
+ *  whose textures have the same size and format can be drawn with one
+ *  multi draw indirect call on GPUs without bindless textures. The first
+ *  two textures of a mesh (albedo and specular map) are copied into the same
+ *  layer of two arrays, which together form a group. A mesh is packed the
+ *  first time it is drawn instanced, and the arrays grow as needed. All
+ *  arrays are deleted when the track is unloaded.
+ *  Since the handles in the instance data are unused without bindless
+ *  textures, the layer of a packed mesh is stored in its TextureHandles.
+ */
+class TextureArrayManager : public Singleton<TextureArrayManager>,
+                            public NoCopy
+{
+    friend class Singleton<TextureArrayManager>;
+private:
+    /** Size and format of a texture. */
+    struct TextureFormat
+    {
+        GLint m_width, m_height, m_format, m_levels;
+        bool operator<(const TextureFormat &other) const
+        {
+            if (m_width != other.m_width) return m_width < other.m_width;
+            if (m_height != other.m_height) return m_height < other.m_height;
+            if (m_format != other.m_format) return m_format < other.m_format;
+            return m_levels < other.m_levels;
+        }
+    };   // TextureFormat
+
+    typedef std::pair<TextureFormat, TextureFormat> GroupKey;
+
+    /** Two arrays with the albedo and specular maps of the packed meshes. */
+    struct Group
+    {
+        GroupKey m_key;
+        GLuint   m_arrays[2];
+        unsigned m_num_layers;
+        unsigned m_capacity;
+    };   // Group
+
+    /** Maximum number of layers of an array, the minimum any GL 3.0
+     *  implementation supports. */
+    static const unsigned MAX_LAYERS = 256;
+
+    std::vector<Group> m_groups;
+
+    /** Group (1-based) and layer of each pair of textures. */
+    std::map<std::pair<GLuint, GLuint>, std::pair<unsigned, unsigned> >
+                       m_layers;
+
+    /** Formats that can't be used for a texture array. */
+    std::set<GroupKey> m_unsupported;
+
+    /** Incremented each time the arrays are deleted, so that meshes packed
+     *  before are recognized. */
+    unsigned m_generation;
+
+    bool     getFormat(GLuint texture, TextureFormat *format) const;
+    GLuint   createArray(const TextureFormat &format, unsigned layers) const;
+    void     copyLayer(GLuint src, GLenum src_target, unsigned src_layer,
+                       GLuint dst, unsigned dst_layer,
+                       const TextureFormat &format) const;
+    bool     growGroup(Group *group);
+
+             TextureArrayManager();
+    virtual ~TextureArrayManager();
+
+public:
+    void     reset();
+    void     pack(GLMesh *mesh);
+    unsigned getGroup(const GLMesh *mesh) const;
+    // ------------------------------------------------------------------------
+    /** Returns the albedo (index 0) or specular (index 1) array of a group
+     *  returned by getGroup. */
+    GLuint   getArray(unsigned group, unsigned index) const
+    {
+        return m_groups[group - 1].m_arrays[index];
+    }
+};   // TextureArrayManager
+
+#endif
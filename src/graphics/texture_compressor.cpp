@@ -0,0 +1,278 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "graphics/texture_compressor.hpp"
+
+#include "utils/worker_pool.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+namespace TextureCompressor
+{
+    // ------------------------------------------------------------------------
+    /** Reads the 4x4 block at x, y of a BGRA image, repeating the last
+     *  row and column for blocks that are not fully inside the image.
+     */
+    static void readBlock(const unsigned char *bgra, unsigned int width,
+                          unsigned int height, unsigned int x, unsigned int y,
+                          unsigned char block[64])
+    {
+        for (unsigned int j = 0; j < 4; j++)
+        {
+            const unsigned int py = std::min(y + j, height - 1);
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                const unsigned int px = std::min(x + i, width - 1);
+                memcpy(block + 4 * (4 * j + i), bgra + 4 * (py * width + px),
+                       4);
+            }
+        }
+    }   // readBlock
+
+    // ------------------------------------------------------------------------
+    static unsigned short toRGB565(int r, int g, int b)
+    {
+        return (unsigned short)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+    }   // toRGB565
+
+    // ------------------------------------------------------------------------
+    static void fromRGB565(unsigned short c, int rgb[3])
+    {
+        rgb[0] = (c >> 11) & 31;  rgb[0] = (rgb[0] << 3) | (rgb[0] >> 2);
+        rgb[1] = (c >> 5)  & 63;  rgb[1] = (rgb[1] << 2) | (rgb[1] >> 4);
+        rgb[2] =  c        & 31;  rgb[2] = (rgb[2] << 3) | (rgb[2] >> 2);
+    }   // fromRGB565
+
+    // ------------------------------------------------------------------------
+    /** Compresses the colours of a block into 8 bytes, always using the four
+     *  colour mode (which is the only one in BC3).
+     */
+    static void compressColorBlock(const unsigned char block[64],
+                                   unsigned char out[8])
+    {
+        int min_c[3] = { 255, 255, 255 }, max_c[3] = { 0, 0, 0 };
+        for (unsigned int i = 0; i < 16; i++)
+        {
+            // BGRA to RGB
+            for (unsigned int c = 0; c < 3; c++)
+            {
+                const int v = block[4 * i + 2 - c];
+                min_c[c] = std::min(min_c[c], v);
+                max_c[c] = std::max(max_c[c], v);
+            }
+        }
+        // Inset the bounding box by 1/16 of its size, which reduces the
+        // error of the fit
+        for (unsigned int c = 0; c < 3; c++)
+        {
+            const int inset = (max_c[c] - min_c[c]) >> 4;
+            min_c[c] = std::min(255, min_c[c] + inset);
+            max_c[c] = std::max(0, max_c[c] - inset);
+        }
+
+        unsigned short c0 = toRGB565(max_c[0], max_c[1], max_c[2]);
+        unsigned short c1 = toRGB565(min_c[0], min_c[1], min_c[2]);
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        unsigned int indices = 0;
+        if (c0 != c1)
+        {
+            int palette[4][3];
+            fromRGB565(c0, palette[0]);
+            fromRGB565(c1, palette[1]);
+            for (unsigned int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (unsigned int i = 0; i < 16; i++)
+            {
+                int best = 0, best_error = 0x7fffffff;
+                for (int p = 0; p < 4; p++)
+                {
+                    int error = 0;
+                    for (unsigned int c = 0; c < 3; c++)
+                    {
+                        const int d = block[4 * i + 2 - c] - palette[p][c];
+                        error += d * d;
+                    }
+                    if (error < best_error)
+                    {
+                        best_error = error;
+                        best = p;
+                    }
+                }
+                indices |= best << (2 * i);
+            }
+        }
+
+        out[0] = c0 & 0xff;  out[1] = c0 >> 8;
+        out[2] = c1 & 0xff;  out[3] = c1 >> 8;
+        for (unsigned int i = 0; i < 4; i++)
+            out[4 + i] = (indices >> (8 * i)) & 0xff;
+    }   // compressColorBlock
+
+    // ------------------------------------------------------------------------
+    /** Compresses the alpha values of a block into 8 bytes, using the mode
+     *  with eight interpolated values.
+     */
+    static void compressAlphaBlock(const unsigned char block[64],
+                                   unsigned char out[8])
+    {
+        int a0 = 0, a1 = 255;
+        for (unsigned int i = 0; i < 16; i++)
+        {
+            a0 = std::max(a0, (int)block[4 * i + 3]);
+            a1 = std::min(a1, (int)block[4 * i + 3]);
+        }
+        out[0] = (unsigned char)a0;
+        out[1] = (unsigned char)a1;
+
+        unsigned long long indices = 0;
+        if (a0 != a1)
+        {
+            int palette[8];
+            palette[0] = a0;
+            palette[1] = a1;
+            for (int p = 1; p < 7; p++)
+                palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+            for (unsigned int i = 0; i < 16; i++)
+            {
+                const int a = block[4 * i + 3];
+                int best = 0, best_error = 256;
+                for (int p = 0; p < 8; p++)
+                {
+                    const int error = abs(a - palette[p]);
+                    if (error < best_error)
+                    {
+                        best_error = error;
+                        best = p;
+                    }
+                }
+                indices |= (unsigned long long)best << (3 * i);
+            }
+        }
+        for (unsigned int i = 0; i < 6; i++)
+            out[2 + i] = (indices >> (8 * i)) & 0xff;
+    }   // compressAlphaBlock
+
+    // ------------------------------------------------------------------------
+    /** Returns the size of a compressed image in bytes. */
+    size_t getCompressedSize(unsigned int width, unsigned int height,
+                             bool alpha)
+    {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) *
+               (alpha ? 16 : 8);
+    }   // getCompressedSize
+
+    // ------------------------------------------------------------------------
+    /** Compresses a BGRA image to BC1 or BC3.
+     *  \param bgra The image, 4 bytes per pixel.
+     *  \param alpha True to compress to BC3 (with alpha), otherwise BC1.
+     *  \param out Receives the compressed image, must be
+     *         getCompressedSize() bytes.
+     */
+    void compressImage(const unsigned char *bgra, unsigned int width,
+                       unsigned int height, bool alpha, unsigned char *out)
+    {
+        const unsigned int blocks_x = (width + 3) / 4;
+        const unsigned int block_size = alpha ? 16 : 8;
+        WorkerPool::Job job = [&](unsigned int first, unsigned int last)
+        {
+            unsigned char block[64];
+            for (unsigned int by = first; by < last; by++)
+            {
+                unsigned char *row = out + (size_t)by * blocks_x * block_size;
+                for (unsigned int bx = 0; bx < blocks_x; bx++)
+                {
+                    readBlock(bgra, width, height, 4 * bx, 4 * by, block);
+                    unsigned char *dest = row + bx * block_size;
+                    if (alpha)
+                    {
+                        compressAlphaBlock(block, dest);
+                        dest += 8;
+                    }
+                    compressColorBlock(block, dest);
+                }
+            }
+        };
+
+        const unsigned int blocks_y = (height + 3) / 4;
+        if (WorkerPool::exists())
+            WorkerPool::get()->parallelFor(blocks_y, 4, job);
+        else
+            job(0, blocks_y);
+    }   // compressImage
+
+    // ------------------------------------------------------------------------
+    /** Compresses a BGRA image and all its mipmap levels, which are created
+     *  with a box filter.
+     *  \param levels Receives the compressed levels, starting with the
+     *         image itself down to 1x1.
+     */
+    void compressWithMipmaps(const unsigned char *bgra, unsigned int width,
+                             unsigned int height, bool alpha,
+                             std::vector<Level> *levels)
+    {
+        levels->clear();
+        std::vector<unsigned char> current, next;
+        const unsigned char *image = bgra;
+        while (true)
+        {
+            levels->push_back(Level());
+            Level &level = levels->back();
+            level.m_width  = width;
+            level.m_height = height;
+            level.m_data.resize(getCompressedSize(width, height, alpha));
+            compressImage(image, width, height, alpha, &level.m_data[0]);
+            if (width == 1 && height == 1)
+                break;
+
+            const unsigned int next_width  = std::max(1u, width  / 2);
+            const unsigned int next_height = std::max(1u, height / 2);
+            next.resize((size_t)next_width * next_height * 4);
+            for (unsigned int y = 0; y < next_height; y++)
+            {
+                const unsigned int y0 = std::min(2 * y,     height - 1);
+                const unsigned int y1 = std::min(2 * y + 1, height - 1);
+                for (unsigned int x = 0; x < next_width; x++)
+                {
+                    const unsigned int x0 = std::min(2 * x,     width - 1);
+                    const unsigned int x1 = std::min(2 * x + 1, width - 1);
+                    for (unsigned int c = 0; c < 4; c++)
+                    {
+                        const unsigned int sum =
+                            image[4 * (y0 * width + x0) + c] +
+                            image[4 * (y0 * width + x1) + c] +
+                            image[4 * (y1 * width + x0) + c] +
+                            image[4 * (y1 * width + x1) + c];
+                        next[4 * (y * next_width + x) + c] =
+                            (unsigned char)((sum + 2) / 4);
+                    }
+                }
+            }
+            current.swap(next);
+            image  = &current[0];
+            width  = next_width;
+            height = next_height;
+        }
+    }   // compressWithMipmaps
+
+}   // TextureCompressor
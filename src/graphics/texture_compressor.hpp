@@ -0,0 +1,54 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_TEXTURE_COMPRESSOR_HPP
+#define HEADER_TEXTURE_COMPRESSOR_HPP
+
+#include <stddef.h>
+#include <vector>
+
+/** Compresses textures to S3TC (BC1 aka DXT1 for opaque textures, BC3 aka
+ *  DXT5 with alpha) on the CPU, including all mipmap levels. This avoids
+ *  the slow and driver dependent compression done by glTexImage2D with a
+ *  compressed internal format. The blocks are compressed in parallel by the
+ *  WorkerPool. The colours are fitted to the bounding box of each block
+ *  (J.M.P. van Waveren, "Real-Time DXT Compression"), which is fast and
+ *  close to what drivers do.
+ *  \ingroup graphics
+ */
+namespace TextureCompressor
+{
+    /** A compressed mipmap level. */
+    struct Level
+    {
+        unsigned int               m_width;
+        unsigned int               m_height;
+        std::vector<unsigned char> m_data;
+    };   // Level
+
+    size_t getCompressedSize(unsigned int width, unsigned int height,
+                             bool alpha);
+    void   compressImage(const unsigned char *bgra, unsigned int width,
+                         unsigned int height, bool alpha,
+                         unsigned char *out);
+    void   compressWithMipmaps(const unsigned char *bgra, unsigned int width,
+                               unsigned int height, bool alpha,
+                               std::vector<Level> *levels);
+}   // TextureCompressor
+
+#endif
@@ -17,10 +17,19 @@
 
 #include "central_settings.hpp"
 #include "texturemanager.hpp"
+#include <deque>
 #include <fstream>
+#include <pthread.h>
 #include <sstream>
 #include "../../lib/irrlicht/source/Irrlicht/COpenGLTexture.h"
+#include "config/user_config.hpp"
+#include "graphics/texture_compressor.hpp"
 #include "irr_driver.hpp"
+#include "utils/log.hpp"
+#include "utils/profiler.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
 
 
 GLuint getTextureGLuint(irr::video::ITexture *tex)
@@ -37,20 +46,567 @@ GLuint getDepthTexture(irr::video::ITexture *tex)
 static std::set<irr::video::ITexture *> AlreadyTransformedTexture;
 static std::map<int, video::ITexture*> unicolor_cache;
 
+/** First integer of cached textures which contain all mipmap levels, which
+ *  can't be the internal format at the start of the old single level
+ *  files. */
+static const int CACHED_TEXTURE_MAGIC   = 0x5a544c47;
+static const int CACHED_TEXTURE_VERSION = 2;
+
+static void convertTexture(irr::video::ITexture *tex, bool srgb,
+                           bool premul_alpha, const std::string &cached_file);
+
+/** A cached compressed texture which is read by the streaming thread and
+ *  then uploaded on the main thread. */
+struct StreamedTexture
+{
+    video::ITexture *m_texture;
+    GLuint           m_gl_name;
+    bool             m_srgb;
+    bool             m_premul_alpha;
+    std::string      m_file;
+    int              m_internal_format;
+    int              m_width;
+    int              m_height;
+    /** Total size of the data of all levels. */
+    int              m_size;
+    /** Size of each mipmap level. Files in the old format only contain the
+     *  first level, the others are then created by the driver. */
+    std::vector<int> m_level_sizes;
+    bool             m_all_levels;
+    /** Number of the largest levels which are not uploaded, to reduce the
+     *  memory the texture uses. */
+    int              m_skip_levels;
+    /** The compressed data of all levels, NULL if the file could not be
+     *  read. */
+    char            *m_data;
+    /** Value of g_stream_generation when the request was made. */
+    unsigned int     m_generation;
+};   // StreamedTexture
+
+/** Textures waiting to be read, and textures read but not yet uploaded.
+ *  Both are protected by g_stream_mutex. */
+static std::deque<StreamedTexture*> g_stream_requests;
+static std::deque<StreamedTexture*> g_stream_loaded;
+static pthread_mutex_t g_stream_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  g_stream_cond  = PTHREAD_COND_INITIALIZER;
+static pthread_t      *g_stream_thread = NULL;
+static bool            g_stream_abort  = false;
+/** Increased when the textures are reset, so that requests which are being
+ *  read at that time are discarded. */
+static unsigned int    g_stream_generation = 0;
+/** Pixel buffer object used to upload streamed textures. */
+static GLuint          g_stream_pbo = 0;
+
+/** A streamed texture whose resolution is adapted to the texture memory
+ *  budget, see updateTextureResidency. */
+struct ResidentTexture
+{
+    video::ITexture  *m_texture;
+    bool              m_srgb;
+    bool              m_premul_alpha;
+    std::string       m_file;
+    /** Size of each mipmap level in the cached file. */
+    std::vector<int>  m_level_sizes;
+    /** Number of the largest levels which are currently not uploaded. */
+    int               m_skipped_levels;
+    /** Render frame in which a mesh using the texture was last drawn, 0 if
+     *  it was never drawn. Textures not used by meshes (e.g. in the GUI)
+     *  always keep all levels. */
+    unsigned int      m_last_used;
+    /** True while a request to upload it with other levels is queued. */
+    bool              m_pending;
+};   // ResidentTexture
+
+/** All streamed textures, indexed by their OpenGL name. */
+static std::map<GLuint, ResidentTexture> g_resident_textures;
+/** Memory used by the uploaded levels of all resident textures. */
+static int64_t         g_resident_bytes = 0;
+/** Number of frames between two updates of the residency. */
+static const unsigned int RESIDENCY_UPDATE_INTERVAL = 30;
+/** Textures not used in that many frames are the first to lose levels. */
+static const unsigned int RESIDENCY_UNUSED_FRAMES   = 300;
+/** Textures never lose their levels smaller than this. */
+static const int       RESIDENCY_MIN_SIZE = 128;
+
+static void requestStreamedTexture(irr::video::ITexture *tex, bool srgb,
+                                   bool premul_alpha,
+                                   const std::string &cached_file,
+                                   int skip_levels = 0);
+
+//-----------------------------------------------------------------------------
+/** Deletes all pending streaming requests. Must be called with
+ *  g_stream_mutex locked. */
+static void clearStreamedTextures()
+{
+    g_stream_generation++;
+    for (unsigned int i = 0; i < g_stream_requests.size(); i++)
+        delete g_stream_requests[i];
+    g_stream_requests.clear();
+    for (unsigned int i = 0; i < g_stream_loaded.size(); i++)
+    {
+        delete[] g_stream_loaded[i]->m_data;
+        delete g_stream_loaded[i];
+    }
+    g_stream_loaded.clear();
+}   // clearStreamedTextures
+
+//-----------------------------------------------------------------------------
 void resetTextureTable()
 {
     AlreadyTransformedTexture.clear();
     unicolor_cache.clear();
+    pthread_mutex_lock(&g_stream_mutex);
+    clearStreamedTextures();
+    pthread_mutex_unlock(&g_stream_mutex);
+    g_resident_textures.clear();
+    g_resident_bytes = 0;
 }
 
+//-----------------------------------------------------------------------------
+/** Returns true if cached compressed textures should be loaded in the
+ *  background. This is not possible with bindless textures, since their
+ *  handle is created (which makes the texture immutable) right after
+ *  compressTexture returns.
+ */
+static bool useTextureStreaming()
+{
+    return UserConfigParams::m_texture_streaming && !CVS->isAZDOEnabled();
+}   // useTextureStreaming
+
+//-----------------------------------------------------------------------------
+/** Reads the header and data of a cached compressed texture. This does not
+ *  use OpenGL, so it can be called from any thread.
+ *  \param compressed_tex Name of the cached file.
+ *  \param st On return contains the format, size and data of the texture.
+ *  \return true if the file could be read.
+ */
+static bool readCompressedTexture(const std::string& compressed_tex,
+                                  StreamedTexture *st)
+{
+    st->m_data = NULL;
+    st->m_level_sizes.clear();
+    std::ifstream ifs(compressed_tex.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs.is_open())
+        return false;
+
+    int magic = 0;
+    ifs.read((char*)&magic, sizeof(int));
+    st->m_all_levels = magic == CACHED_TEXTURE_MAGIC;
+    if (st->m_all_levels)
+    {
+        int version = 0, levels = 0;
+        ifs.read((char*)&version, sizeof(int));
+        ifs.read((char*)&st->m_internal_format, sizeof(int));
+        ifs.read((char*)&st->m_width, sizeof(int));
+        ifs.read((char*)&st->m_height, sizeof(int));
+        ifs.read((char*)&levels, sizeof(int));
+        if (ifs.fail() || version != CACHED_TEXTURE_VERSION || levels <= 0 ||
+            levels > 32)
+            return false;
+        st->m_level_sizes.resize(levels);
+        ifs.read((char*)&st->m_level_sizes[0], levels * sizeof(int));
+    }
+    else
+    {
+        st->m_internal_format = magic;
+        st->m_level_sizes.resize(1);
+        ifs.read((char*)&st->m_width, sizeof(int));
+        ifs.read((char*)&st->m_height, sizeof(int));
+        ifs.read((char*)&st->m_level_sizes[0], sizeof(int));
+    }
+    if (ifs.fail())
+        return false;
+
+    st->m_size = 0;
+    for (unsigned int i = 0; i < st->m_level_sizes.size(); i++)
+    {
+        if (st->m_level_sizes[i] <= 0)
+            return false;
+        st->m_size += st->m_level_sizes[i];
+    }
+
+    st->m_data = new char[st->m_size];
+    ifs.read(st->m_data, st->m_size);
+    if (ifs.fail())
+    {
+        delete[] st->m_data;
+        st->m_data = NULL;
+        return false;
+    }
+    return true;
+}   // readCompressedTexture
+
+//-----------------------------------------------------------------------------
+/** Uploads all mipmap levels of a compressed texture to the currently bound
+ *  texture, or only the first one and lets the driver create the others
+ *  for files in the old format. If pixel buffer objects are available, the
+ *  data is copied into one first, so that the driver can transfer it
+ *  asynchronously.
+ *  \return The number of largest levels that were skipped as requested in
+ *           m_skip_levels, always 0 for files in the old format.
+ */
+static int uploadCompressedTexture(const StreamedTexture &st)
+{
+    const int skip = st.m_all_levels
+        ? std::max(0, std::min(st.m_skip_levels,
+                               (int)st.m_level_sizes.size() - 1))
+        : 0;
+    size_t first = 0;
+    for (int level = 0; level < skip; level++)
+        first += st.m_level_sizes[level];
+
+    const bool use_pbo = CVS->isGLSL();
+    if (use_pbo)
+    {
+        if (!g_stream_pbo)
+            glGenBuffers(1, &g_stream_pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_stream_pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, st.m_size - first,
+                     st.m_data + first, GL_STREAM_DRAW);
+    }
+    size_t offset = 0;
+    for (unsigned int level = skip; level < st.m_level_sizes.size(); level++)
+    {
+        const char *data = use_pbo ? (const char*)NULL + offset
+                                   : st.m_data + first + offset;
+        glCompressedTexImage2D(GL_TEXTURE_2D, level - skip,
+                               st.m_internal_format,
+                               std::max(1, st.m_width >> level),
+                               std::max(1, st.m_height >> level), 0,
+                               st.m_level_sizes[level], (GLvoid*)data);
+        offset += st.m_level_sizes[level];
+    }
+    if (use_pbo)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!st.m_all_levels)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    else
+    {
+        // Levels left from a previous larger upload must not be sampled
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                        (int)st.m_level_sizes.size() - skip - 1);
+    }
+    return skip;
+}   // uploadCompressedTexture
+
+//-----------------------------------------------------------------------------
+/** Returns the memory used by the uploaded levels of a resident texture. */
+static int64_t getResidentSize(const ResidentTexture &rt)
+{
+    int64_t size = 0;
+    for (unsigned int i = rt.m_skipped_levels; i < rt.m_level_sizes.size();
+         i++)
+        size += rt.m_level_sizes[i];
+    return size;
+}   // getResidentSize
+
+//-----------------------------------------------------------------------------
+/** Records the levels of a streamed texture which were just uploaded, so
+ *  that updateTextureResidency can change them later.
+ */
+static void setResidentLevels(const StreamedTexture &st, int skipped)
+{
+    std::map<GLuint, ResidentTexture>::iterator it =
+        g_resident_textures.find(st.m_gl_name);
+    if (it == g_resident_textures.end())
+    {
+        ResidentTexture rt;
+        rt.m_texture      = st.m_texture;
+        rt.m_srgb         = st.m_srgb;
+        rt.m_premul_alpha = st.m_premul_alpha;
+        rt.m_file         = st.m_file;
+        rt.m_last_used    = 0;
+        it = g_resident_textures.insert(std::make_pair(st.m_gl_name,
+                                                        rt)).first;
+    }
+    else
+        g_resident_bytes -= getResidentSize(it->second);
+    it->second.m_level_sizes    = st.m_level_sizes;
+    it->second.m_skipped_levels = skipped;
+    it->second.m_pending        = false;
+    g_resident_bytes += getResidentSize(it->second);
+}   // setResidentLevels
+
+//-----------------------------------------------------------------------------
+/** Saves the mipmap levels compressed by the texture compressor, see
+ *  readCompressedTexture for the format.
+ */
+static void saveCompressedLevels(const std::string &cached_file,
+                                 int internal_format,
+                                 const std::vector<TextureCompressor::Level>
+                                     &levels)
+{
+    std::ofstream ofs(cached_file.c_str(), std::ios::out | std::ios::binary);
+    if (!ofs.is_open())
+        return;
+    int header[6] = { CACHED_TEXTURE_MAGIC, CACHED_TEXTURE_VERSION,
+                      internal_format, (int)levels[0].m_width,
+                      (int)levels[0].m_height, (int)levels.size() };
+    ofs.write((char*)header, sizeof(header));
+    for (unsigned int i = 0; i < levels.size(); i++)
+    {
+        int size = (int)levels[i].m_data.size();
+        ofs.write((char*)&size, sizeof(int));
+    }
+    for (unsigned int i = 0; i < levels.size(); i++)
+    {
+        ofs.write((char*)&levels[i].m_data[0], levels[i].m_data.size());
+    }
+}   // saveCompressedLevels
+
+//-----------------------------------------------------------------------------
+/** The streaming thread: reads the requested cached textures and hands
+ *  them to the main thread, which uploads them in updateTextureStreaming.
+ */
+static void *streamTextures(void *obj)
+{
+    pthread_mutex_lock(&g_stream_mutex);
+    while (!g_stream_abort)
+    {
+        if (g_stream_requests.empty())
+        {
+            pthread_cond_wait(&g_stream_cond, &g_stream_mutex);
+            continue;
+        }
+        StreamedTexture *st = g_stream_requests.front();
+        g_stream_requests.pop_front();
+        pthread_mutex_unlock(&g_stream_mutex);
+
+        readCompressedTexture(st->m_file, st);
+
+        pthread_mutex_lock(&g_stream_mutex);
+        if (st->m_generation != g_stream_generation)
+        {
+            // The textures were reset in the meantime
+            delete[] st->m_data;
+            delete st;
+            continue;
+        }
+        g_stream_loaded.push_back(st);
+    }
+    pthread_mutex_unlock(&g_stream_mutex);
+    return NULL;
+}   // streamTextures
+
+//-----------------------------------------------------------------------------
+/** Queues a cached compressed texture to be loaded in the background. Until
+ *  it is uploaded, the texture keeps the uncompressed image that irrlicht
+ *  uploaded when loading it, which serves as placeholder.
+ */
+static void requestStreamedTexture(irr::video::ITexture *tex, bool srgb,
+                                   bool premul_alpha,
+                                   const std::string &cached_file,
+                                   int skip_levels)
+{
+    StreamedTexture *st = new StreamedTexture();
+    st->m_texture      = tex;
+    st->m_gl_name      = getTextureGLuint(tex);
+    st->m_srgb         = srgb;
+    st->m_premul_alpha = premul_alpha;
+    st->m_file         = cached_file;
+    st->m_skip_levels  = skip_levels;
+    st->m_data         = NULL;
+
+    pthread_mutex_lock(&g_stream_mutex);
+    if (!g_stream_thread)
+    {
+        g_stream_abort  = false;
+        g_stream_thread = new pthread_t;
+        if (pthread_create(g_stream_thread, NULL, &streamTextures, NULL) != 0)
+        {
+            Log::warn("TextureManager",
+                      "Could not create texture streaming thread.");
+            delete g_stream_thread;
+            g_stream_thread = NULL;
+        }
+    }
+    st->m_generation = g_stream_generation;
+    // Without a thread the request is read in updateTextureStreaming
+    g_stream_requests.push_back(st);
+    pthread_cond_signal(&g_stream_cond);
+    pthread_mutex_unlock(&g_stream_mutex);
+}   // requestStreamedTexture
+
+//-----------------------------------------------------------------------------
+/** Marks the textures of a mesh as used in the current frame. Called by the
+ *  scene manager for each visible mesh, at most once per frame.
+ */
+void markTextureUsed(irr::video::ITexture *tex)
+{
+    if (!tex || g_resident_textures.empty())
+        return;
+    std::map<GLuint, ResidentTexture>::iterator it =
+        g_resident_textures.find(getTextureGLuint(tex));
+    if (it != g_resident_textures.end())
+        it->second.m_last_used = irr_driver->getRenderFrame();
+}   // markTextureUsed
+
+//-----------------------------------------------------------------------------
+/** Keeps the memory used by streamed textures within
+ *  UserConfigParams::m_texture_vram_budget. When over budget, the largest
+ *  mipmap level of the least recently drawn textures is dropped by
+ *  uploading them again from the cache without it. When there is room
+ *  again, the levels of recently drawn textures are restored, so the
+ *  quality degrades gracefully and only for what is not seen.
+ *  Textures which were never drawn by a mesh are not touched.
+ */
+static void updateTextureResidency()
+{
+    const unsigned int frame = irr_driver->getRenderFrame();
+    if (frame % RESIDENCY_UPDATE_INTERVAL != 0)
+        return;
+    PROFILER_SET_GAUGE("Texture memory (KB)", (int)(g_resident_bytes / 1024));
+    if (UserConfigParams::m_texture_vram_budget <= 0 ||
+        !useTextureStreaming())
+        return;
+
+    const int64_t budget =
+        (int64_t)UserConfigParams::m_texture_vram_budget * 1024 * 1024;
+    // Memory that will be used once the pending requests are uploaded
+    int64_t total = 0;
+    std::vector<std::pair<unsigned int, GLuint> > by_age;
+    for (std::map<GLuint, ResidentTexture>::const_iterator it =
+         g_resident_textures.begin(); it != g_resident_textures.end(); it++)
+    {
+        const ResidentTexture &rt = it->second;
+        if (rt.m_pending)
+            continue;
+        total += getResidentSize(rt);
+        if (rt.m_last_used > 0)
+            by_age.push_back(std::make_pair(rt.m_last_used, it->first));
+    }
+    std::sort(by_age.begin(), by_age.end());
+
+    if (total > budget)
+    {
+        // Drop one level of the least recently used textures first
+        for (unsigned int i = 0; i < by_age.size() && total > budget; i++)
+        {
+            ResidentTexture &rt = g_resident_textures[by_age[i].second];
+            const int level = rt.m_skipped_levels;
+            const int width  = (int)rt.m_texture->getSize().Width;
+            const int height = (int)rt.m_texture->getSize().Height;
+            if (level + 1 >= (int)rt.m_level_sizes.size() ||
+                std::max(width, height) >> (level + 1) < RESIDENCY_MIN_SIZE)
+                continue;
+            total -= rt.m_level_sizes[level];
+            rt.m_pending = true;
+            requestStreamedTexture(rt.m_texture, rt.m_srgb, rt.m_premul_alpha,
+                                   rt.m_file, level + 1);
+        }
+    }
+    else
+    {
+        // Restore a level of the most recently used textures while staying
+        // clearly below the budget, so that textures don't flip each update
+        const int64_t target = budget / 10 * 9;
+        for (int i = (int)by_age.size() - 1; i >= 0; i--)
+        {
+            if (by_age[i].first + RESIDENCY_UNUSED_FRAMES < frame)
+                break;
+            ResidentTexture &rt = g_resident_textures[by_age[i].second];
+            if (rt.m_skipped_levels == 0)
+                continue;
+            const int level = rt.m_skipped_levels - 1;
+            if (total + rt.m_level_sizes[level] > target)
+                break;
+            total += rt.m_level_sizes[level];
+            rt.m_pending = true;
+            requestStreamedTexture(rt.m_texture, rt.m_srgb, rt.m_premul_alpha,
+                                   rt.m_file, level);
+        }
+    }
+}   // updateTextureResidency
+
+//-----------------------------------------------------------------------------
+/** Uploads the streamed textures that were read by the streaming thread.
+ *  Called once per frame from the main thread, it stops once the time
+ *  budget set in UserConfigParams::m_texture_upload_budget is used (but
+ *  uploads at least one texture per frame).
+ */
+void updateTextureStreaming()
+{
+    updateTextureResidency();
+
+    double start = StkTime::getRealTime();
+    double budget = UserConfigParams::m_texture_upload_budget * 0.001;
+    while (true)
+    {
+        pthread_mutex_lock(&g_stream_mutex);
+        StreamedTexture *st = NULL;
+        if (!g_stream_loaded.empty())
+        {
+            st = g_stream_loaded.front();
+            g_stream_loaded.pop_front();
+        }
+        else if (!g_stream_thread && !g_stream_requests.empty())
+        {
+            st = g_stream_requests.front();
+            g_stream_requests.pop_front();
+            readCompressedTexture(st->m_file, st);
+        }
+        pthread_mutex_unlock(&g_stream_mutex);
+        if (!st)
+            break;
+
+        glBindTexture(GL_TEXTURE_2D, st->m_gl_name);
+        if (st->m_data)
+        {
+            const int skipped = uploadCompressedTexture(*st);
+            if (st->m_all_levels)
+                setResidentLevels(*st, skipped);
+        }
+        else
+        {
+            // The cached file could not be read, compress the texture now
+            convertTexture(st->m_texture, st->m_srgb, st->m_premul_alpha,
+                           st->m_file);
+            std::map<GLuint, ResidentTexture>::iterator it =
+                g_resident_textures.find(st->m_gl_name);
+            if (it != g_resident_textures.end())
+            {
+                g_resident_bytes -= getResidentSize(it->second);
+                g_resident_textures.erase(it);
+            }
+        }
+        delete[] st->m_data;
+        delete st;
+        if (StkTime::getRealTime() - start > budget)
+            break;
+    }
+}   // updateTextureStreaming
+
+//-----------------------------------------------------------------------------
+/** Stops the streaming thread and discards all pending requests. Must be
+ *  called before the OpenGL context is destroyed.
+ */
+void stopTextureStreaming()
+{
+    pthread_mutex_lock(&g_stream_mutex);
+    g_stream_abort = true;
+    clearStreamedTextures();
+    pthread_cond_broadcast(&g_stream_cond);
+    pthread_mutex_unlock(&g_stream_mutex);
+    if (g_stream_thread)
+    {
+        pthread_join(*g_stream_thread, NULL);
+        delete g_stream_thread;
+        g_stream_thread = NULL;
+    }
+    if (g_stream_pbo)
+    {
+        glDeleteBuffers(1, &g_stream_pbo);
+        g_stream_pbo = 0;
+    }
+}   // stopTextureStreaming
+
+//-----------------------------------------------------------------------------
 void compressTexture(irr::video::ITexture *tex, bool srgb, bool premul_alpha)
 {
     if (AlreadyTransformedTexture.find(tex) != AlreadyTransformedTexture.end())
         return;
     AlreadyTransformedTexture.insert(tex);
 
-    glBindTexture(GL_TEXTURE_2D, getTextureGLuint(tex));
-
     std::string cached_file;
     if (CVS->isTextureCompressionEnabled())
     {
@@ -59,12 +615,31 @@ void compressTexture(irr::video::ITexture *tex, bool srgb, bool premul_alpha)
         if (!tex_name.empty()) {
             cached_file = file_manager->getTextureCacheLocation(tex_name) + ".gltz";
             if (!file_manager->fileIsNewer(tex_name, cached_file)) {
+                if (useTextureStreaming())
+                {
+                    requestStreamedTexture(tex, srgb, premul_alpha,
+                                           cached_file);
+                    return;
+                }
+                glBindTexture(GL_TEXTURE_2D, getTextureGLuint(tex));
                 if (loadCompressedTexture(cached_file))
                     return;
             }
         }
     }
 
+    glBindTexture(GL_TEXTURE_2D, getTextureGLuint(tex));
+    convertTexture(tex, srgb, premul_alpha, cached_file);
+}   // compressTexture
+
+//-----------------------------------------------------------------------------
+/** Uploads the image of a texture to the currently bound texture, with the
+ *  srgb and compressed formats as requested, and saves it in the texture
+ *  cache if it was compressed.
+ */
+static void convertTexture(irr::video::ITexture *tex, bool srgb,
+                           bool premul_alpha, const std::string &cached_file)
+{
     size_t w = tex->getSize().Width, h = tex->getSize().Height;
     unsigned char *data = new unsigned char[w * h * 4];
     memcpy(data, tex->lock(), w * h * 4);
@@ -77,11 +652,17 @@ void compressTexture(irr::video::ITexture *tex, bool srgb, bool premul_alpha)
 
     if (premul_alpha)
     {
+        static float alpha_table[256];
+        static bool  alpha_table_ready = false;
+        if (!alpha_table_ready)
+        {
+            for (unsigned i = 0; i < 256; i++)
+                alpha_table[i] = pow(i / 255.f, 1.f / 2.2f);
+            alpha_table_ready = true;
+        }
         for (unsigned i = 0; i < w * h; i++)
         {
-            float alpha = data[4 * i + 3];
-            if (alpha > 0.)
-                alpha = pow(alpha / 255.f, 1.f / 2.2f);
+            float alpha = alpha_table[data[4 * i + 3]];
             data[4 * i] = (unsigned char)(data[4 * i] * alpha);
             data[4 * i + 1] = (unsigned char)(data[4 * i + 1] * alpha);
             data[4 * i + 2] = (unsigned char)(data[4 * i + 2] * alpha);
@@ -101,6 +682,26 @@ void compressTexture(irr::video::ITexture *tex, bool srgb, bool premul_alpha)
             internalFormat = (tex->hasAlpha()) ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
         else
             internalFormat = (tex->hasAlpha()) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+        // Compress all levels with our own compressor, which is much
+        // faster than most drivers
+        if (tex->getColorFormat() == video::ECF_A8R8G8B8)
+        {
+            std::vector<TextureCompressor::Level> levels;
+            TextureCompressor::compressWithMipmaps(data, w, h,
+                                                   tex->hasAlpha(), &levels);
+            delete[] data;
+            for (unsigned int i = 0; i < levels.size(); i++)
+            {
+                glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat,
+                                       levels[i].m_width, levels[i].m_height,
+                                       0, levels[i].m_data.size(),
+                                       (GLvoid*)&levels[i].m_data[0]);
+            }
+            if (!cached_file.empty())
+                saveCompressedLevels(cached_file, internalFormat, levels);
+            return;
+        }
     }
     glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, Format, GL_UNSIGNED_BYTE, (GLvoid *)data);
     glGenerateMipmap(GL_TEXTURE_2D);
@@ -111,7 +712,7 @@ void compressTexture(irr::video::ITexture *tex, bool srgb, bool premul_alpha)
         // Save the compressed texture in the cache for later use.
         saveCompressedTexture(cached_file);
     }
-}
+}   // convertTexture
 
 //-----------------------------------------------------------------------------
 /** Try to load a compressed texture from the given file name.
@@ -122,34 +723,13 @@ void compressTexture(irr::video::ITexture *tex, bool srgb, bool premul_alpha)
 */
 bool loadCompressedTexture(const std::string& compressed_tex)
 {
-    std::ifstream ifs(compressed_tex.c_str(), std::ios::in | std::ios::binary);
-    if (!ifs.is_open())
+    StreamedTexture st;
+    st.m_skip_levels = 0;
+    if (!readCompressedTexture(compressed_tex, &st))
         return false;
-
-    int internal_format;
-    int w, h;
-    int size = -1;
-    ifs.read((char*)&internal_format, sizeof(int));
-    ifs.read((char*)&w, sizeof(int));
-    ifs.read((char*)&h, sizeof(int));
-    ifs.read((char*)&size, sizeof(int));
-
-    if (ifs.fail() || size == -1)
-        return false;
-
-    char *data = new char[size];
-    ifs.read(data, size);
-    if (!ifs.fail())
-    {
-        glCompressedTexImage2D(GL_TEXTURE_2D, 0, internal_format,
-            w, h, 0, size, (GLvoid*)data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        delete[] data;
-        ifs.close();
-        return true;
-    }
-    delete[] data;
-    return false;
+    uploadCompressedTexture(st);
+    delete[] st.m_data;
+    return true;
 }
 
 //-----------------------------------------------------------------------------
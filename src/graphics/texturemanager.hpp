@@ -29,5 +29,8 @@ void resetTextureTable();
 void compressTexture(irr::video::ITexture *tex, bool srgb, bool premul_alpha = false);
 bool loadCompressedTexture(const std::string& compressed_tex);
 void saveCompressedTexture(const std::string& compressed_tex);
+void markTextureUsed(irr::video::ITexture *tex);
+void updateTextureStreaming();
+void stopTextureStreaming();
 
 #endif
@@ -0,0 +1,127 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "graphics/transient_buffer.hpp"
+
+#include "graphics/central_settings.hpp"
+#include "utils/log.hpp"
+
+/** Rounds an offset up to a multiple of alignment. */
+static size_t align(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}   // align
+
+// ----------------------------------------------------------------------------
+TransientBuffer::TransientBuffer()
+{
+    m_segment = 0;
+    m_used    = 0;
+    for (unsigned i = 0; i < SEGMENT_COUNT; i++)
+        m_sync[i] = 0;
+
+    const size_t size = SEGMENT_COUNT * SEGMENT_SIZE;
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                             GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    glBufferStorage(GL_ARRAY_BUFFER, size, 0, flags);
+    m_pointer = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (!m_pointer)
+        Log::warn("TransientBuffer", "Can't map the transient buffer.");
+}   // TransientBuffer
+
+// ----------------------------------------------------------------------------
+TransientBuffer::~TransientBuffer()
+{
+    for (unsigned i = 0; i < SEGMENT_COUNT; i++)
+    {
+        if (m_sync[i])
+            glDeleteSync(m_sync[i]);
+    }
+    if (m_pointer)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &m_buffer);
+}   // ~TransientBuffer
+
+// ----------------------------------------------------------------------------
+/** Returns true if the buffer can be used: it needs persistent mapping. */
+bool TransientBuffer::isUsable()
+{
+    return CVS->isARBBufferStorageUsable();
+}   // isUsable
+
+// ----------------------------------------------------------------------------
+/** Fences the current segment and moves to the next one, waiting until the
+ *  GPU doesn't read it anymore.
+ */
+void TransientBuffer::nextSegment()
+{
+    if (m_sync[m_segment])
+        glDeleteSync(m_sync[m_segment]);
+    m_sync[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_segment = (m_segment + 1) % SEGMENT_COUNT;
+    m_used = 0;
+    if (m_sync[m_segment])
+    {
+        GLenum reason = glClientWaitSync(m_sync[m_segment],
+                                         GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (reason != GL_ALREADY_SIGNALED &&
+               reason != GL_CONDITION_SATISFIED && reason != GL_WAIT_FAILED)
+        {
+            reason = glClientWaitSync(m_sync[m_segment],
+                                      GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(m_sync[m_segment]);
+        m_sync[m_segment] = 0;
+    }
+}   // nextSegment
+
+// ----------------------------------------------------------------------------
+/** Reserves memory for data that is used by the next draw calls. The GPU
+ *  must not read it after the ring wrapped around, i.e. it must only be
+ *  used until the end of the frame.
+ *  \param size Size of the data in bytes.
+ *  \param alignment The offset of the data is a multiple of it, e.g. the
+ *         vertex size or GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+ *  \param offset Returns the offset of the data in getBuffer().
+ *  \return Where to write the data, or NULL if it is too large (the caller
+ *          must then upload it itself).
+ */
+void *TransientBuffer::allocate(size_t size, size_t alignment, size_t *offset)
+{
+    if (!m_pointer || size > SEGMENT_SIZE)
+        return NULL;
+
+    *offset = align(m_segment * SEGMENT_SIZE + m_used, alignment);
+    if (*offset + size > (m_segment + 1) * SEGMENT_SIZE)
+    {
+        nextSegment();
+        *offset = align(m_segment * SEGMENT_SIZE, alignment);
+        if (*offset + size > (m_segment + 1) * SEGMENT_SIZE)
+            return NULL;
+    }
+    m_used = *offset + size - m_segment * SEGMENT_SIZE;
+    return m_pointer + *offset;
+}   // allocate
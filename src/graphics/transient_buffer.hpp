@@ -0,0 +1,69 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_TRANSIENT_BUFFER_HPP
+#define HEADER_TRANSIENT_BUFFER_HPP
+
+#include "graphics/gl_headers.hpp"
+#include "utils/no_copy.hpp"
+#include "utils/singleton.hpp"
+
+#include <stddef.h>
+
+/** A persistently mapped ring buffer for data that is written by the CPU
+ *  and read by the GPU only once, e.g. the vertices of the 2D batches. The
+ *  data is bump allocated, so that many small uploads don't each need a
+ *  glBufferData or glBufferSubData call, and is used with an offset into
+ *  the buffer. The ring is split into segments: when a segment is full, a
+ *  fence is inserted after the draw calls that read it, and the allocation
+ *  goes on in the next segment, after waiting for its fence if the GPU
+ *  still reads it.
+ *  \ingroup graphics
+ */
+class TransientBuffer : public Singleton<TransientBuffer>, public NoCopy
+{
+    friend class Singleton<TransientBuffer>;
+private:
+    /** Number of segments of the ring. */
+    static const unsigned SEGMENT_COUNT = 4;
+    /** Size of each segment in bytes, the largest possible allocation. */
+    static const size_t   SEGMENT_SIZE = 1024 * 1024;
+
+    GLuint    m_buffer;
+    char     *m_pointer;
+    GLsync    m_sync[SEGMENT_COUNT];
+    /** The segment the allocations are made in. */
+    unsigned  m_segment;
+    /** Bytes allocated in the current segment. */
+    size_t    m_used;
+
+    void      nextSegment();
+
+              TransientBuffer();
+    virtual  ~TransientBuffer();
+
+public:
+    static bool isUsable();
+    void       *allocate(size_t size, size_t alignment, size_t *offset);
+    // ------------------------------------------------------------------------
+    /** Returns the buffer object that the offsets returned by allocate are
+     *  in. */
+    GLuint      getBuffer() const { return m_buffer; }
+};   // TransientBuffer
+
+#endif
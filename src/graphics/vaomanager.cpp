@@ -20,9 +20,124 @@
 #include "stkmesh.hpp"
 #include "glwrap.hpp"
 #include "central_settings.hpp"
+#include "utils/profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Layouts of the vertices when packed_vertices is set. The positions,
+    // colors and texture coordinates keep their full precision (tiled
+    // texture coordinates go far beyond the range of half floats), the
+    // normals, tangents and bitangents use GL_INT_2_10_10_10_REV and the
+    // lightmap coordinates, which are in [0, 1], use half floats.
+    struct PackedVertex
+    {
+        float    Pos[3];
+        uint32_t Normal;
+        uint32_t Color;
+        float    TCoords[2];
+    };
+
+    struct PackedVertex2TCoords
+    {
+        float    Pos[3];
+        uint32_t Normal;
+        uint32_t Color;
+        float    TCoords[2];
+        uint16_t TCoords2[2];
+    };
+
+    struct PackedVertexTangents
+    {
+        float    Pos[3];
+        uint32_t Normal;
+        uint32_t Color;
+        float    TCoords[2];
+        uint32_t Tangent;
+        uint32_t Binormal;
+    };
+
+    static_assert(sizeof(PackedVertex) == 28, "Wrong packed vertex size");
+    static_assert(sizeof(PackedVertex2TCoords) == 32, "Wrong packed vertex size");
+    static_assert(sizeof(PackedVertexTangents) == 36, "Wrong packed vertex size");
+
+    // ------------------------------------------------------------------------
+    /** Packs a vector as a normalized GL_INT_2_10_10_10_REV value. */
+    uint32_t packVector(const core::vector3df &v)
+    {
+        core::vector3df n = v;
+        float length = n.getLength();
+        if (length > 0.0f)
+            n /= length;
+        const float c[3] = { n.X, n.Y, n.Z };
+        uint32_t result = 0;
+        for (unsigned i = 0; i < 3; i++)
+        {
+            int value = (int)roundf(std::min(std::max(c[i], -1.0f), 1.0f) * 511.0f);
+            result |= ((uint32_t)value & 0x3ff) << (10 * i);
+        }
+        return result;
+    }   // packVector
+
+    // ------------------------------------------------------------------------
+    /** Converts a float to a half float, rounding to nearest. Values too
+     *  small for a normalized half are flushed to zero. */
+    uint16_t packHalf(float f)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+        const int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+        uint32_t mantissa = bits & 0x7fffff;
+        if (exponent <= 0)
+            return sign;
+        if (exponent >= 31)
+            return sign | 0x7bff;
+        // Round to nearest, the carry may increase the exponent
+        uint32_t half = ((uint32_t)exponent << 10) + ((mantissa + 0x1000) >> 13);
+        return sign | (uint16_t)std::min(half, (uint32_t)0x7bff);
+    }   // packHalf
+
+    // ------------------------------------------------------------------------
+    void packCommon(const video::S3DVertex &src, float *pos, uint32_t *normal,
+                    uint32_t *color, float *tcoords)
+    {
+        pos[0] = src.Pos.X;
+        pos[1] = src.Pos.Y;
+        pos[2] = src.Pos.Z;
+        *normal = packVector(src.Normal);
+        memcpy(color, &src.Color, sizeof(uint32_t));
+        tcoords[0] = src.TCoords.X;
+        tcoords[1] = src.TCoords.Y;
+    }   // packCommon
+}
+
+/** Returns the size of the instance data of a type. */
+static size_t getInstanceDataSize(InstanceType it)
+{
+    switch (it)
+    {
+    case InstanceTypeDualTex:
+        return sizeof(InstanceDataDualTex);
+    case InstanceTypeThreeTex:
+        return sizeof(InstanceDataThreeTex);
+    case InstanceTypeShadow:
+    case InstanceTypeRSM:
+        return sizeof(InstanceDataSingleTex);
+    case InstanceTypeGlow:
+        return sizeof(GlowInstanceData);
+    default:
+        assert(0 && "Wrong instance type");
+        return 0;
+    }
+}
 
 VAOManager::VAOManager()
 {
+    packed_vertices = CVS->isPackedVertexFormatEnabled();
     for (unsigned i = 0; i < VTXTYPE_COUNT; i++)
     {
         vao[i] = 0;
@@ -36,16 +151,17 @@ VAOManager::VAOManager()
 
     for (unsigned i = 0; i < InstanceTypeCount; i++)
     {
+        const size_t size = INSTANCE_BUFFER_COUNT * INSTANCE_BUFFER_SIZE * getInstanceDataSize((InstanceType)i);
         glGenBuffers(1, &instance_vbo[i]);
         glBindBuffer(GL_ARRAY_BUFFER, instance_vbo[i]);
         if (CVS->supportsAsyncInstanceUpload())
         {
-            glBufferStorage(GL_ARRAY_BUFFER, 10000 * sizeof(InstanceDataDualTex), 0, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
-            Ptr[i] = glMapBufferRange(GL_ARRAY_BUFFER, 0, 10000 * sizeof(InstanceDataDualTex), GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
+            glBufferStorage(GL_ARRAY_BUFFER, size, 0, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
+            Ptr[i] = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
         }
         else
         {
-            glBufferData(GL_ARRAY_BUFFER, 10000 * sizeof(InstanceDataDualTex), 0, GL_STREAM_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, size, 0, GL_STREAM_DRAW);
         }
     }
 }
@@ -77,10 +193,14 @@ VAOManager::~VAOManager()
 
 }
 
+/** Makes sure that a buffer can store newLastIndex elements, doubling its
+ *  size if not (the old content is copied).
+ *  \param bufferSize Number of elements the buffer can store, updated.
+ */
 static void
-resizeBufferIfNecessary(size_t &lastIndex, size_t newLastIndex, size_t bufferSize, size_t stride, GLenum type, GLuint &id, void *&Pointer)
+resizeBufferIfNecessary(size_t &lastIndex, size_t newLastIndex, size_t &bufferSize, size_t stride, GLenum type, GLuint &id, void *&Pointer)
 {
-    if (newLastIndex * stride >= bufferSize)
+    if (newLastIndex >= bufferSize)
     {
         while (newLastIndex >= bufferSize)
             bufferSize = 2 * bufferSize + 1;
@@ -89,7 +209,9 @@ resizeBufferIfNecessary(size_t &lastIndex, size_t newLastIndex, size_t bufferSiz
         glBindBuffer(type, newVBO);
         if (CVS->supportsAsyncInstanceUpload())
         {
-            glBufferStorage(type, bufferSize *stride, 0, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
+            // Dynamic storage for the vertices of animated meshes, see
+            // updateVertices
+            glBufferStorage(type, bufferSize *stride, 0, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_DYNAMIC_STORAGE_BIT);
             Pointer = glMapBufferRange(type, 0, bufferSize * stride, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
         }
         else
@@ -114,6 +236,13 @@ void VAOManager::regenerateBuffer(enum VTXTYPE tp, size_t newlastvertex, size_t
     glBindVertexArray(0);
     resizeBufferIfNecessary(last_vertex[tp], newlastvertex, RealVBOSize[tp], getVertexPitch(tp), GL_ARRAY_BUFFER, vbo[tp], VBOPtr[tp]);
     resizeBufferIfNecessary(last_index[tp], newlastindex, RealIBOSize[tp], sizeof(u16), GL_ELEMENT_ARRAY_BUFFER, ibo[tp], IBOPtr[tp]);
+
+    size_t total = 0;
+    for (unsigned i = 0; i < VTXTYPE_COUNT; i++)
+        total += RealVBOSize[i] * getVertexPitch((enum VTXTYPE)i) + RealIBOSize[i] * sizeof(u16);
+    for (unsigned i = 0; i < InstanceTypeCount; i++)
+        total += INSTANCE_BUFFER_COUNT * INSTANCE_BUFFER_SIZE * getInstanceDataSize((InstanceType)i);
+    PROFILER_SET_GAUGE("Mesh buffer memory (KB)", (int)(total / 1024));
 }
 
 void VAOManager::regenerateVAO(enum VTXTYPE tp)
@@ -124,12 +253,68 @@ void VAOManager::regenerateVAO(enum VTXTYPE tp)
     glBindVertexArray(vao[tp]);
     glBindBuffer(GL_ARRAY_BUFFER, vbo[tp]);
 
-    VertexUtils::bindVertexArrayAttrib(getVertexType(tp));
+    bindVertexAttrib(tp);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo[tp]);
     glBindVertexArray(0);
 }
 
+/** Sets the vertex attributes of the buffer of a vertex type, which must be
+ *  bound to GL_ARRAY_BUFFER.
+ */
+void VAOManager::bindVertexAttrib(enum VTXTYPE tp) const
+{
+    if (!packed_vertices)
+    {
+        VertexUtils::bindVertexArrayAttrib(getVertexType(tp));
+        return;
+    }
+    GLsizei pitch = (GLsizei)getVertexPitch(tp);
+    // Position
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, pitch, 0);
+    // Normal
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, pitch, (GLvoid*)12);
+    // Color
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, pitch, (GLvoid*)16);
+    // Texcoord
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, pitch, (GLvoid*)20);
+    switch (tp)
+    {
+    case VTXTYPE_TCOORD:
+        // SecondTexcoord
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 2, GL_HALF_FLOAT, GL_FALSE, pitch, (GLvoid*)28);
+        break;
+    case VTXTYPE_TANGENT:
+        // Tangent
+        glEnableVertexAttribArray(5);
+        glVertexAttribPointer(5, 4, GL_INT_2_10_10_10_REV, GL_TRUE, pitch, (GLvoid*)28);
+        // Bitangent
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_INT_2_10_10_10_REV, GL_TRUE, pitch, (GLvoid*)32);
+        break;
+    default:
+        break;
+    }
+}
+
+/** Creates a vertex array for the buffers of a vertex type, and leaves it
+ *  bound. */
+GLuint VAOManager::createVertexArray(enum VTXTYPE tp) const
+{
+    GLuint result;
+    glGenVertexArrays(1, &result);
+    glBindVertexArray(result);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo[tp]);
+    bindVertexAttrib(tp);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo[tp]);
+    return result;
+}
+
 template<typename T>
 struct VAOInstanceUtil
 {
@@ -199,33 +384,33 @@ void VAOManager::regenerateInstancedVAO()
 {
     cleanInstanceVAOs();
 
-    enum video::E_VERTEX_TYPE IrrVT[] = { video::EVT_STANDARD, video::EVT_2TCOORDS, video::EVT_TANGENTS };
     for (unsigned i = 0; i < VTXTYPE_COUNT; i++)
     {
-        video::E_VERTEX_TYPE tp = IrrVT[i];
-        if (!vbo[tp] || !ibo[tp])
+        VTXTYPE vtx_type = (VTXTYPE)i;
+        video::E_VERTEX_TYPE tp = getVertexType(vtx_type);
+        if (!vbo[vtx_type] || !ibo[vtx_type])
             continue;
-        GLuint vao = createVAO(vbo[tp], ibo[tp], tp);
+        GLuint vao = createVertexArray(vtx_type);
         glBindBuffer(GL_ARRAY_BUFFER, instance_vbo[InstanceTypeDualTex]);
         VAOInstanceUtil<InstanceDataDualTex>::SetVertexAttrib();
         InstanceVAO[std::pair<video::E_VERTEX_TYPE, InstanceType>(tp, InstanceTypeDualTex)] = vao;
 
-        vao = createVAO(vbo[tp], ibo[tp], tp);
+        vao = createVertexArray(vtx_type);
         glBindBuffer(GL_ARRAY_BUFFER, instance_vbo[InstanceTypeThreeTex]);
         VAOInstanceUtil<InstanceDataThreeTex>::SetVertexAttrib();
         InstanceVAO[std::pair<video::E_VERTEX_TYPE, InstanceType>(tp, InstanceTypeThreeTex)] = vao;
 
-        vao = createVAO(vbo[tp], ibo[tp], tp);
+        vao = createVertexArray(vtx_type);
         glBindBuffer(GL_ARRAY_BUFFER, instance_vbo[InstanceTypeShadow]);
         VAOInstanceUtil<InstanceDataSingleTex>::SetVertexAttrib();
         InstanceVAO[std::pair<video::E_VERTEX_TYPE, InstanceType>(tp, InstanceTypeShadow)] = vao;
 
-        vao = createVAO(vbo[tp], ibo[tp], tp);
+        vao = createVertexArray(vtx_type);
         glBindBuffer(GL_ARRAY_BUFFER, instance_vbo[InstanceTypeRSM]);
         VAOInstanceUtil<InstanceDataSingleTex>::SetVertexAttrib();
         InstanceVAO[std::pair<video::E_VERTEX_TYPE, InstanceType>(tp, InstanceTypeRSM)] = vao;
 
-        vao = createVAO(vbo[tp], ibo[tp], tp);
+        vao = createVertexArray(vtx_type);
         glBindBuffer(GL_ARRAY_BUFFER, instance_vbo[InstanceTypeGlow]);
         VAOInstanceUtil<GlowInstanceData>::SetVertexAttrib();
         InstanceVAO[std::pair<video::E_VERTEX_TYPE, InstanceType>(tp, InstanceTypeGlow)] = vao;
@@ -242,10 +427,16 @@ size_t VAOManager::getVertexPitch(enum VTXTYPE tp) const
     switch (tp)
     {
     case VTXTYPE_STANDARD:
+        if (packed_vertices)
+            return sizeof(PackedVertex);
         return getVertexPitchFromType(video::EVT_STANDARD);
     case VTXTYPE_TCOORD:
+        if (packed_vertices)
+            return sizeof(PackedVertex2TCoords);
         return getVertexPitchFromType(video::EVT_2TCOORDS);
     case VTXTYPE_TANGENT:
+        if (packed_vertices)
+            return sizeof(PackedVertexTangents);
         return getVertexPitchFromType(video::EVT_TANGENTS);
     default:
         assert(0 && "Wrong vtxtype");
@@ -253,7 +444,7 @@ size_t VAOManager::getVertexPitch(enum VTXTYPE tp) const
     }
 }
 
-VAOManager::VTXTYPE VAOManager::getVTXTYPE(video::E_VERTEX_TYPE type)
+VAOManager::VTXTYPE VAOManager::getVTXTYPE(video::E_VERTEX_TYPE type) const
 {
     switch (type)
     {
@@ -268,7 +459,7 @@ VAOManager::VTXTYPE VAOManager::getVTXTYPE(video::E_VERTEX_TYPE type)
     }
 };
 
-irr::video::E_VERTEX_TYPE VAOManager::getVertexType(enum VTXTYPE tp)
+irr::video::E_VERTEX_TYPE VAOManager::getVertexType(enum VTXTYPE tp) const
 {
     switch (tp)
     {
@@ -291,7 +482,14 @@ void VAOManager::append(scene::IMeshBuffer *mb, VTXTYPE tp)
     if (CVS->supportsAsyncInstanceUpload())
     {
         void *tmp = (char*)VBOPtr[tp] + old_vtx_cnt * getVertexPitch(tp);
-        memcpy(tmp, mb->getVertices(), mb->getVertexCount() * getVertexPitch(tp));
+        copyVertices(mb, tmp);
+    }
+    else if (packed_vertices)
+    {
+        std::vector<char> packed(mb->getVertexCount() * getVertexPitch(tp));
+        copyVertices(mb, packed.data());
+        glBindBuffer(GL_ARRAY_BUFFER, vbo[tp]);
+        glBufferSubData(GL_ARRAY_BUFFER, old_vtx_cnt * getVertexPitch(tp), packed.size(), packed.data());
     }
     else
     {
@@ -332,3 +530,81 @@ std::pair<unsigned, unsigned> VAOManager::getBase(scene::IMeshBuffer *mb)
     assert(It != mappedBaseIndex[tp].end());
     return std::pair<unsigned, unsigned>(vtx, It->second);
 }
+
+/** Writes the vertices of a mesh buffer to dst in the format of the buffers,
+ *  i.e. getVertexPitch bytes per vertex.
+ */
+void VAOManager::copyVertices(scene::IMeshBuffer *mb, void *dst) const
+{
+    const VTXTYPE tp = getVTXTYPE(mb->getVertexType());
+    const unsigned count = mb->getVertexCount();
+    if (!packed_vertices)
+    {
+        memcpy(dst, mb->getVertices(), count * getVertexPitch(tp));
+        return;
+    }
+
+    switch (tp)
+    {
+    case VTXTYPE_STANDARD:
+    {
+        const video::S3DVertex *src = (const video::S3DVertex*)mb->getVertices();
+        PackedVertex *out = (PackedVertex*)dst;
+        for (unsigned i = 0; i < count; i++)
+            packCommon(src[i], out[i].Pos, &out[i].Normal, &out[i].Color, out[i].TCoords);
+        break;
+    }
+    case VTXTYPE_TCOORD:
+    {
+        const video::S3DVertex2TCoords *src = (const video::S3DVertex2TCoords*)mb->getVertices();
+        PackedVertex2TCoords *out = (PackedVertex2TCoords*)dst;
+        for (unsigned i = 0; i < count; i++)
+        {
+            packCommon(src[i], out[i].Pos, &out[i].Normal, &out[i].Color, out[i].TCoords);
+            out[i].TCoords2[0] = packHalf(src[i].TCoords2.X);
+            out[i].TCoords2[1] = packHalf(src[i].TCoords2.Y);
+        }
+        break;
+    }
+    case VTXTYPE_TANGENT:
+    {
+        const video::S3DVertexTangents *src = (const video::S3DVertexTangents*)mb->getVertices();
+        PackedVertexTangents *out = (PackedVertexTangents*)dst;
+        for (unsigned i = 0; i < count; i++)
+        {
+            packCommon(src[i], out[i].Pos, &out[i].Normal, &out[i].Color, out[i].TCoords);
+            out[i].Tangent = packVector(src[i].Tangent);
+            out[i].Binormal = packVector(src[i].Binormal);
+        }
+        break;
+    }
+    default:
+        assert(0 && "Wrong vtxtype");
+    }
+}
+
+/** Uploads the vertices of an animated mesh buffer, which must have been
+ *  appended before. The update is done with glBufferSubData, so that the
+ *  driver and not the CPU waits until the GPU doesn't use the previous
+ *  vertices anymore.
+ */
+void VAOManager::updateVertices(scene::IMeshBuffer *mb)
+{
+    VTXTYPE tp = getVTXTYPE(mb->getVertexType());
+    std::unordered_map<scene::IMeshBuffer*, unsigned>::iterator It;
+    It = mappedBaseVertex[tp].find(mb);
+    assert(It != mappedBaseVertex[tp].end());
+    const size_t pitch = getVertexPitch(tp);
+    const size_t size = mb->getVertexCount() * pitch;
+    const void *data = mb->getVertices();
+    if (packed_vertices)
+    {
+        packed_scratch.resize(size);
+        copyVertices(mb, packed_scratch.data());
+        data = packed_scratch.data();
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo[tp]);
+    glBufferSubData(GL_ARRAY_BUFFER, It->second * pitch, size, data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
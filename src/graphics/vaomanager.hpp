@@ -36,6 +36,13 @@ enum InstanceType
     InstanceTypeCount,
 };
 
+/** The instance and draw indirect command buffers hold this many copies,
+ *  used as a ring: one copy is filled while the GPU may still read the
+ *  copies of the previous scenes. */
+const unsigned INSTANCE_BUFFER_COUNT = 3;
+/** Number of instances (and of draw commands) of each copy. */
+const unsigned INSTANCE_BUFFER_SIZE = 10000;
+
 #ifdef WIN32
 #pragma pack(push, 1)
 #endif
@@ -164,18 +171,27 @@ class VAOManager : public Singleton<VAOManager>
     size_t last_vertex[VTXTYPE_COUNT], last_index[VTXTYPE_COUNT];
     std::unordered_map<irr::scene::IMeshBuffer*, unsigned> mappedBaseVertex[VTXTYPE_COUNT], mappedBaseIndex[VTXTYPE_COUNT];
     std::map<std::pair<irr::video::E_VERTEX_TYPE, InstanceType>, GLuint> InstanceVAO;
+    /** True if the vertices are stored in the packed format (see
+     *  copyVertices), decided once since all meshes share the buffers. */
+    bool packed_vertices;
 
     void cleanInstanceVAOs();
     void regenerateBuffer(enum VTXTYPE, size_t, size_t);
     void regenerateVAO(enum VTXTYPE);
     void regenerateInstancedVAO();
     size_t getVertexPitch(enum VTXTYPE) const;
-    VTXTYPE getVTXTYPE(irr::video::E_VERTEX_TYPE type);
-    irr::video::E_VERTEX_TYPE getVertexType(enum VTXTYPE tp);
+    void bindVertexAttrib(enum VTXTYPE) const;
+    GLuint createVertexArray(enum VTXTYPE) const;
+    VTXTYPE getVTXTYPE(irr::video::E_VERTEX_TYPE type) const;
+    irr::video::E_VERTEX_TYPE getVertexType(enum VTXTYPE tp) const;
     void append(irr::scene::IMeshBuffer *, VTXTYPE tp);
+    void copyVertices(irr::scene::IMeshBuffer *mb, void *dst) const;
+    /** Scratch buffer for the packed vertices of animated meshes. */
+    std::vector<char> packed_scratch;
 public:
     VAOManager();
     std::pair<unsigned, unsigned> getBase(irr::scene::IMeshBuffer *);
+    void updateVertices(irr::scene::IMeshBuffer *mb);
     GLuint getInstanceBuffer(InstanceType it) { return instance_vbo[it]; }
     void *getInstanceBufferPtr(InstanceType it) { return Ptr[it]; }
     unsigned getVBO(irr::video::E_VERTEX_TYPE type) { return vbo[getVTXTYPE(type)]; }
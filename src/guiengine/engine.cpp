@@ -670,6 +670,7 @@ namespace GUIEngine
 #include "guiengine/dialog_queue.hpp"
 #include "modes/demo_world.hpp"
 #include "modes/cutscene_world.hpp"
+#include "modes/profile_world.hpp"
 #include "modes/world.hpp"
 #include "states_screens/race_gui_base.hpp"
 
@@ -714,12 +715,43 @@ namespace GUIEngine
 
     float dt = 0;
 
+    /** True if something changed that requires the next frame to be drawn. */
+    bool  g_redraw_needed = true;
+    /** True if a decorative animation was drawn in the last frame. */
+    bool  g_animating = false;
+    /** Time since the last invalidate() call. */
+    float g_time_since_change = 0.0f;
+    /** Time since the last frame was drawn. */
+    float g_time_since_draw = 0.0f;
+
+    /** Decorative animations stop after nothing changed for this time. */
+    const float MAX_ANIMATION_TIME = 5.0f;
+    /** Menus are redrawn at least this often in case a change was missed
+     *  (e.g. irrlicht's own widgets, or the window being uncovered). This
+     *  also makes the cursor of an edit box blink, which toggles once per
+     *  second. */
+    const float MAX_RETAINED_TIME = 1.0f;
+
     // -----------------------------------------------------------------------
     float getLatestDt()
     {
         return dt;
     }   // getLatestDt
 
+    // -----------------------------------------------------------------------
+    void invalidate()
+    {
+        g_redraw_needed     = true;
+        g_time_since_change = 0.0f;
+    }   // invalidate
+
+    // -----------------------------------------------------------------------
+    void requestAnimationFrame()
+    {
+        g_animating = true;
+    }   // requestAnimationFrame
+
+
     // -----------------------------------------------------------------------
     struct MenuMessage
     {
@@ -746,9 +778,53 @@ namespace GUIEngine
 
         // add message
         gui_messages.push_back( MenuMessage(message, time) );
+        invalidate();
 
     }   // showMessage
 
+    // ------------------------------------------------------------------------
+    /** Returns if the current frame has to be drawn. Only menus without 3D
+     *  rendering and animations are retained, i.e. keep their last frame on
+     *  screen (by not swapping the buffers) instead of being redrawn every
+     *  frame.
+     *  \param dt Time step size.
+     */
+    bool needsRedraw(float dt)
+    {
+        g_time_since_change += dt;
+        g_time_since_draw   += dt;
+
+        // Screens that don't throttle the frame rate are animated
+        if (!UserConfigParams::m_retained_menus         ||
+            UserConfigParams::m_display_fps             ||
+            g_state_manager->getGameState() != MENU     ||
+            g_current_screen == NULL                    ||
+            g_current_screen->needs3D()                 ||
+            !g_current_screen->throttleFPS()            ||
+            !gui_messages.empty()                          )
+            return true;
+
+        return g_redraw_needed || g_time_since_draw >= MAX_RETAINED_TIME ||
+               (g_animating && g_time_since_change < MAX_ANIMATION_TIME);
+    }   // needsRedraw
+
+    // ------------------------------------------------------------------------
+    /** Called instead of render() if needsRedraw returned false. Only the
+     *  non-drawing part of render() is done.
+     *  \param elapsed_time Time step size.
+     */
+    void skipFrame(float elapsed_time)
+    {
+        GUIEngine::dt = elapsed_time;
+
+        if (ModalDialog::isADialogActive())
+            ModalDialog::getCurrent()->onUpdate(dt);
+        else
+            getCurrentScreen()->onUpdate(elapsed_time);
+
+        DemoWorld::updateIdleTimeAndStartDemo(elapsed_time);
+    }   // skipFrame
+
     // ------------------------------------------------------------------------
     Widget* getFocusForPlayer(const unsigned int playerID)
     {
@@ -808,6 +884,7 @@ namespace GUIEngine
     // ------------------------------------------------------------------------
     void clear()
     {
+        invalidate();
         g_env->clear();
         if (g_current_screen != NULL) g_current_screen->elementsWereDeleted();
         g_current_screen = NULL;
@@ -876,6 +953,7 @@ namespace GUIEngine
     void switchToScreen(const char* screen_name)
     {
         needsUpdate.clearWithoutDeleting();
+        invalidate();
 
         // clean what was left by the previous screen
         g_env->clear();
@@ -1164,6 +1242,11 @@ namespace GUIEngine
         // Not yet initialized, or already cleaned up
         if (g_skin == NULL) return;
 
+        // Anything drawn from now on that changes will invalidate again
+        g_redraw_needed   = false;
+        g_animating       = false;
+        g_time_since_draw = 0.0f;
+
         // ---- menu drawing
 
         // draw background image and sections
@@ -1211,7 +1294,14 @@ namespace GUIEngine
             else
             {
                 RaceGUIBase* rg = World::getWorld()->getRaceGUI();
-                if (rg != NULL) rg->renderGlobal(elapsed_time);
+                if (rg != NULL)
+                {
+                    // Collect the minimap, player icons and texts of the
+                    // race gui in one batch
+                    begin2DBatch();
+                    rg->renderGlobal(elapsed_time);
+                    end2DBatch();
+                }
             }
         }
 
@@ -1361,6 +1451,10 @@ namespace GUIEngine
 
     void addLoadingIcon(irr::video::ITexture* icon)
     {
+        // Nothing to show without graphics (e.g. on a dedicated server)
+        if (ProfileWorld::isNoGraphics())
+            return;
+
         if (icon != NULL)
         {
             g_loading_icons.push_back(icon);
@@ -224,6 +224,28 @@ namespace GUIEngine
       */
     void render(float dt);
 
+    /**
+      * \brief marks the GUI as changed, so that the next frame of a menu is
+      *        drawn. Menus that didn't change keep their last frame on screen.
+      */
+    void invalidate();
+
+    /**
+      * \brief called while drawing a purely decorative animation (e.g. the
+      *        glow of the focused widget) to keep the menu redrawn. These
+      *        animations stop once nothing changed for a while.
+      */
+    void requestAnimationFrame();
+
+    /**
+      * \brief checks if the current menu must be redrawn. If not, skipFrame
+      *        must be called instead of render.
+      */
+    bool needsRedraw(float dt);
+
+    /** \brief updates the current screen without drawing it */
+    void skipFrame(float dt);
+
     /** \brief renders a "loading" screen */
     void renderLoading(bool clearIcons = true);
 
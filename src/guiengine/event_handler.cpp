@@ -144,6 +144,15 @@ bool EventHandler::OnEvent (const SEvent &event)
         DemoWorld::resetIdleTime();
     }
 
+    // Irrlicht sends joystick events every frame, so they only invalidate
+    // the GUI if they trigger an action, see processGUIAction
+    if (event.EventType == EET_GUI_EVENT         ||
+        event.EventType == EET_MOUSE_INPUT_EVENT ||
+        event.EventType == EET_KEY_INPUT_EVENT      )
+    {
+        GUIEngine::invalidate();
+    }
+
     if (event.EventType == EET_GUI_EVENT)
     {
         return onGUIEvent(event) == EVENT_BLOCK;
@@ -249,6 +258,8 @@ void EventHandler::processGUIAction(const PlayerAction action,
                                     Input::InputType type,
                                     const int playerID)
 {
+    GUIEngine::invalidate();
+
     Screen* screen = GUIEngine::getCurrentScreen();
     if (screen != NULL)
     {
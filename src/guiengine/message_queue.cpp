@@ -148,6 +148,7 @@ void add(MessageType mt, const irr::core::stringw &message)
         g_current_display_time =-1.0f;
     }
     g_all_messages.push(m);
+    GUIEngine::invalidate();
 }   // add
 
 // ----------------------------------------------------------------------------
@@ -161,6 +162,8 @@ void update(float dt)
 {
     if(g_all_messages.empty()) return;
 
+    // Keep the menu redrawn until all messages timed out
+    GUIEngine::invalidate();
     g_current_display_time += dt;
     if(g_current_display_time > g_max_display_time)
     {
@@ -64,12 +64,7 @@ ModalDialog::ModalDialog(const float percentWidth, const float percentHeight,
 void ModalDialog::loadFromFile(const char* xmlFile)
 {
     doInit();
-    std::string path = file_manager->getAssetChecked(FileManager::GUI,xmlFile,
-                                                     true);
-    IXMLReader* xml = file_manager->createXMLReader(path);
-
-    Screen::parseScreenFileDiv(xml, m_widgets, m_irrlicht_window);
-    delete xml;
+    Screen::parseScreenFile(xmlFile, m_widgets, m_irrlicht_window);
 
     loadedFromFile();
 
@@ -140,6 +135,7 @@ void ModalDialog::doInit()
 
     GUIEngine::getSkin()->m_dialog = true;
     GUIEngine::getSkin()->m_dialog_size = 0.0f;
+    GUIEngine::invalidate();
 
     m_previous_mode=input_manager->getMode();
     input_manager->setMode(InputManager::MENU);
@@ -151,6 +147,7 @@ ModalDialog::~ModalDialog()
 {
     GUIEngine::getSkin()->m_dialog = false;
     GUIEngine::getSkin()->m_dialog_size = 0.0f;
+    GUIEngine::invalidate();
 
     // irrLicht is to stupid to remove focus from deleted widgets
     // so do it by hand
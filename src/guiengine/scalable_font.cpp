@@ -9,6 +9,7 @@
 #include "io/file_manager.hpp"
 #include "utils/translation.hpp"
 
+#include <functional>
 #include <IAttributes.h>
 #include <IGUIEnvironment.h>
 #include <IGUISpriteBank.h>
@@ -154,6 +155,10 @@ void ScalableFont::doReadXmlFile(io::IXMLReader* xml)
                 info.m_has_alpha   = (alpha == core::stringw("true"));
                 info.m_scale       = scale;
                 info.m_exclude_from_max_height_calculation = excludeFromMaxHeightCalculation;
+                // Distance fields store coverage in the alpha channel
+                info.m_distance_field = xml->getAttributeValue(L"distanceField") != NULL;
+                if (info.m_distance_field)
+                    info.m_has_alpha = true;
 
 
 #ifdef DEBUG
@@ -279,6 +284,7 @@ bool ScalableFont::load(io::IXMLReader* xml)
         if(a.width     > m_max_digit_area.width    ) m_max_digit_area.width     = a.width;
     }
     m_max_digit_area.overhang = 0;m_max_digit_area.underhang=0;
+    clearLayoutCache();
     return true;
 }
 void ScalableFont::setScale(const float scale)
@@ -420,17 +426,90 @@ const ScalableFont::SFontArea &ScalableFont::getAreaFromCharacter(const wchar_t
 void ScalableFont::setInvisibleCharacters( const wchar_t *s )
 {
     Invisible = s;
+    clearLayoutCache();
 }
 
 
 //! returns the dimension of text
 core::dimension2d<u32> ScalableFont::getDimension(const wchar_t* text) const
+{
+    return getLayout(text).m_dimension;
+}
+
+// ----------------------------------------------------------------------------
+size_t ScalableFont::LayoutKeyHash::operator()(const LayoutKey &key) const
+{
+    size_t hash = std::hash<std::wstring>()(key.m_text);
+    hash ^= std::hash<float>()(key.m_scale) + 0x9e3779b9 + (hash << 6)
+          + (hash >> 2);
+    hash ^= std::hash<s32>()(key.m_kerning_width) + 0x9e3779b9 + (hash << 6)
+          + (hash >> 2);
+    return hash ^ (key.m_mono_space_digits ? 1 : 0);
+}   // LayoutKeyHash::operator()
+
+// ----------------------------------------------------------------------------
+/** Removes all cached layouts. Must be called if the characters of the font
+ *  change. */
+void ScalableFont::clearLayoutCache()
+{
+    m_layouts.clear();
+    m_layout_lru.clear();
+}   // clearLayoutCache
+
+// ----------------------------------------------------------------------------
+/** Returns the layout of a string with the current settings of the font,
+ *  computing it if it is not cached. The returned reference stays valid until
+ *  the next call.
+ */
+const ScalableFont::TextLayout &ScalableFont::getLayout(const wchar_t *text) const
+{
+    LayoutKey key;
+    key.m_text                   = text;
+    key.m_scale                  = m_scale;
+    key.m_kerning_width          = GlobalKerningWidth;
+    key.m_mono_space_digits      = m_mono_space_digits;
+    key.m_fallback_font          = m_fallback_font;
+    key.m_fallback_font_scale    = m_fallback_font_scale;
+    key.m_fallback_kerning_width = m_fallback_kerning_width;
+
+    auto it = m_layouts.find(key);
+    if (it != m_layouts.end())
+    {
+        m_layout_lru.splice(m_layout_lru.begin(), m_layout_lru,
+                            it->second.m_lru_position);
+        return it->second;
+    }
+
+    if (m_layouts.size() >= MAX_CACHED_LAYOUTS)
+    {
+        m_layouts.erase(*m_layout_lru.back());
+        m_layout_lru.pop_back();
+    }
+
+    it = m_layouts.insert(std::make_pair(key, TextLayout())).first;
+    layoutText(text, &it->second);
+    m_layout_lru.push_front(&it->first);
+    it->second.m_lru_position = m_layout_lru.begin();
+    return it->second;
+}   // getLayout
+
+// ----------------------------------------------------------------------------
+/** Resolves the characters of a string and computes its dimension and the
+ *  quads of its visible characters.
+ */
+void ScalableFont::layoutText(const wchar_t *text, TextLayout *layout) const
 {
     assert(Areas.size() > 0);
 
     core::dimension2d<u32> dim(0, 0);
     core::dimension2d<u32> thisLine(0, (int)(MaxHeight*m_scale));
 
+    core::array< SGUISprite >& sprites        = SpriteBank->getSprites();
+    core::array< core::rect<s32> >& positions = SpriteBank->getPositions();
+    const int spriteAmount                    = sprites.size();
+
+    s32 line = 0;
+    s32 x    = 0;
     for (const wchar_t* p = text; *p; ++p)
     {
         if (*p == L'\r'  ||      // Windows breaks
@@ -442,6 +521,8 @@ core::dimension2d<u32> ScalableFont::getDimension(const wchar_t* text) const
             if (dim.Width < thisLine.Width)
                 dim.Width = thisLine.Width;
             thisLine.Width = 0;
+            x = 0;
+            line++;
             continue;
         }
 
@@ -449,23 +530,58 @@ core::dimension2d<u32> ScalableFont::getDimension(const wchar_t* text) const
         const SFontArea &area = getAreaFromCharacter(*p, &fallback);
 
         thisLine.Width += area.underhang;
+        x              += area.underhang;
+
+        const int spriteID = Invisible.findFirst(*p) < 0 ? area.spriteno : -1;
+        if (spriteID >= 0 && (fallback || spriteID < spriteAmount))
+        {
+            const SGUISprite &sprite = fallback
+                                     ? m_fallback_font->SpriteBank->getSprites()[spriteID]
+                                     : sprites[spriteID];
+            GlyphQuad glyph;
+            glyph.m_line       = line;
+            glyph.m_fallback   = fallback;
+            glyph.m_texture_id = sprite.Frames[0].textureNumber;
+            glyph.m_source     = fallback
+                               ? m_fallback_font->SpriteBank->getPositions()[sprite.Frames[0].rectNumber]
+                               : positions[sprite.Frames[0].rectNumber];
+
+            const TextureInfo& info = (fallback ?
+                                       (*(m_fallback_font->m_texture_files.find(glyph.m_texture_id))).second :
+                                       (*(m_texture_files.find(glyph.m_texture_id))).second
+                                       );
+            float char_scale = info.m_scale;
+            glyph.m_distance_field = info.m_distance_field;
+
+            core::dimension2d<s32> size = glyph.m_source.getSize();
+
+            float scale = (fallback ? m_scale*m_fallback_font_scale : m_scale);
+            size.Width  = (int)(size.Width  * scale * char_scale);
+            size.Height = (int)(size.Height * scale * char_scale);
+
+            // align vertically if character is smaller
+            int y_shift = (size.Height < MaxHeight*m_scale ? (int)((MaxHeight*m_scale - size.Height)/2.0f) : 0);
+
+            glyph.m_dest = core::rect<s32>(core::position2di(x, y_shift),
+                                           size);
+            layout->m_glyphs.push_back(glyph);
+        }
 
-        thisLine.Width += getCharWidth(area, fallback);
+        const int width = getCharWidth(area, fallback);
+        thisLine.Width += width;
+        x              += width;
     }
 
     dim.Height += thisLine.Height;
     if (dim.Width < thisLine.Width) dim.Width = thisLine.Width;
 
-   //Log::info("ScalableFont", "ScalableFont::getDimension returns: %d, %d", dim.Width, dim.Height);
-
     dim.Width  = (int)(dim.Width + 0.9f); // round up
     dim.Height = (int)(dim.Height + 0.9f);
 
-    //Log::info("ScalableFont", "After: %d, %d", dim.Width, dim.Height);
-
-    return dim;
-}
+    layout->m_dimension = dim;
+}   // layoutText
 
+// ----------------------------------------------------------------------------
 void ScalableFont::draw(const core::stringw& text,
     const core::rect<s32>& position, video::SColor color,
     bool hcenter, bool vcenter,
@@ -487,6 +603,21 @@ void ScalableFont::draw(const core::stringw& text,
     if (ignoreRTL) m_rtl = previousRTL;
 }
 
+//! draws a character in a single color, from a distance field if needed
+static void drawGlyph(video::ITexture* texture, const core::rect<s32>& dest,
+                      const core::rect<s32>& source,
+                      const core::rect<s32>* clip,
+                      const video::SColor& color, bool distance_field)
+{
+    if (distance_field)
+    {
+        const video::SColor colors[] = { color, color, color, color };
+        draw2DDistanceFieldImage(texture, dest, source, clip, colors);
+    }
+    else
+        draw2DImage(texture, dest, source, clip, color, true);
+}
+
 //! draws some text and clips it to the specified rectangle if wanted
 void ScalableFont::doDraw(const core::stringw& text,
                           const core::rect<s32>& position, video::SColor color,
@@ -509,12 +640,15 @@ void ScalableFont::doDraw(const core::stringw& text,
         m_shadow = true; // set back
     }
 
+    // Must be done after drawing the shadow, which could evict the layout
+    const TextLayout &layout = getLayout(text.c_str());
+
     core::position2d<s32> offset = position.UpperLeftCorner;
     core::dimension2d<s32> text_dimension;
 
     if (m_rtl || hcenter || vcenter || clip)
     {
-        text_dimension = getDimension(text.c_str());
+        text_dimension = layout.m_dimension;
 
         if (hcenter)    offset.X += (position.getWidth() - text_dimension.Width) / 2;
         else if (m_rtl) offset.X += (position.getWidth() - text_dimension.Width);
@@ -528,108 +662,37 @@ void ScalableFont::doDraw(const core::stringw& text,
         }
     }
 
-    // ---- collect character locations
-    const unsigned int text_size = text.size();
-    core::array<s32>               indices(text_size);
-    core::array<core::position2di> offsets(text_size);
-    std::vector<bool>              fallback(text_size);
-
-    for (u32 i = 0; i<text_size; i++)
+    // ---- do the actual rendering
+    // Glyphs (and their borders) usually share a texture, so that the whole
+    // string can be drawn with a single draw call
+    begin2DBatch();
+    core::position2di line_start = offset;
+    s32 line = 0;
+    for (unsigned int n = 0; n < layout.m_glyphs.size(); n++)
     {
-        wchar_t c = text[i];
-
-        if (c == L'\r' ||          // Windows breaks
-            c == L'\n'    )        // Unix breaks
+        const GlyphQuad &glyph = layout.m_glyphs[n];
+        if (glyph.m_line != line)
         {
-            if(c==L'\r' && text[i+1]==L'\n') c = text[++i];
-            offset.Y += (int)(MaxHeight*m_scale);
-            offset.X  = position.UpperLeftCorner.X;
+            line         = glyph.m_line;
+            line_start.X = position.UpperLeftCorner.X;
             if (hcenter)
-                offset.X += (position.getWidth() - text_dimension.Width) >> 1;
-            continue;
-        }   // if lineBreak
-
-        bool use_fallback_font = false;
-        const SFontArea &area  = getAreaFromCharacter(c, &use_fallback_font);
-        fallback[i]            = use_fallback_font;
-        offset.X              += area.underhang;
-        offsets.push_back(offset);
-        // Invisible character. add something to the array anyway so that
-        // indices from the various arrays remain in sync
-        indices.push_back( Invisible.findFirst(c) < 0  ? area.spriteno
-                                                       : -1            );
-        offset.X += getCharWidth(area, fallback[i]);
-    }   // for i<text_size
-
-    // ---- do the actual rendering
-    const int indiceAmount                    = indices.size();
-    core::array< SGUISprite >& sprites        = SpriteBank->getSprites();
-    core::array< core::rect<s32> >& positions = SpriteBank->getPositions();
-    core::array< SGUISprite >* fallback_sprites;
-    core::array< core::rect<s32> >* fallback_positions;
-    if(m_fallback_font!=NULL)
-    {
-        fallback_sprites   = &m_fallback_font->SpriteBank->getSprites();
-        fallback_positions = &m_fallback_font->SpriteBank->getPositions();
-    }
-    else
-    {
-        fallback_sprites   = NULL;
-        fallback_positions = NULL;
-    }
-
-    const int spriteAmount      = sprites.size();
-    for (int n=0; n<indiceAmount; n++)
-    {
-        const int spriteID = indices[n];
-        if (!fallback[n] && (spriteID < 0 || spriteID >= spriteAmount)) continue;
-        if (indices[n] == -1) continue;
-
-        //assert(sprites[spriteID].Frames.size() > 0);
-
-        const int texID = (fallback[n] ?
-                           (*fallback_sprites)[spriteID].Frames[0].textureNumber :
-                           sprites[spriteID].Frames[0].textureNumber);
-
-        core::rect<s32> source = (fallback[n] ?
-                                  (*fallback_positions)[(*fallback_sprites)[spriteID].Frames[0].rectNumber] :
-                                  positions[sprites[spriteID].Frames[0].rectNumber]);
-
-        const TextureInfo& info = (fallback[n] ?
-                                   (*(m_fallback_font->m_texture_files.find(texID))).second :
-                                   (*(m_texture_files.find(texID))).second
-                                   );
-        float char_scale = info.m_scale;
-
-        core::dimension2d<s32> size = source.getSize();
-
-        float scale = (fallback[n] ? m_scale*m_fallback_font_scale : m_scale);
-        size.Width  = (int)(size.Width  * scale * char_scale);
-        size.Height = (int)(size.Height * scale * char_scale);
-
-        // align vertically if character is smaller
-        int y_shift = (size.Height < MaxHeight*m_scale ? (int)((MaxHeight*m_scale - size.Height)/2.0f) : 0);
+                line_start.X += (position.getWidth() - text_dimension.Width) >> 1;
+            line_start.Y = offset.Y + line * (int)(MaxHeight*m_scale);
+        }
 
-        core::rect<s32> dest(offsets[n] + core::position2di(0, y_shift), size);
+        const int texID = glyph.m_texture_id;
+        const core::rect<s32> &source = glyph.m_source;
+        core::rect<s32> dest = glyph.m_dest + line_start;
 
-        video::ITexture* texture = (fallback[n] ?
+        video::ITexture* texture = (glyph.m_fallback ?
                                     m_fallback_font->SpriteBank->getTexture(texID) :
                                     SpriteBank->getTexture(texID) );
 
-        /*
-        if (fallback[n])
-        {
-            Log::info("ScalableFont", "Using fallback font %s; source area is %d, %d; size %d, %d; dest = %d, %d",
-                core::stringc(texture->getName()).c_str(), source.UpperLeftCorner.X, source.UpperLeftCorner.Y,
-                source.getWidth(), source.getHeight(), offsets[n].X, offsets[n].Y);
-        }
-        */
-
         if (texture == NULL)
         {
             // perform lazy loading
 
-            if (fallback[n])
+            if (glyph.m_fallback)
             {
                 m_fallback_font->lazyLoadTexture(texID);
                 texture = m_fallback_font->SpriteBank->getTexture(texID);
@@ -657,16 +720,14 @@ void ScalableFont::doDraw(const core::stringw& text,
                 for (int y_delta=-2; y_delta<=2; y_delta++)
                 {
                     if (x_delta == 0 || y_delta == 0) continue;
-                    draw2DImage(texture,
-                                dest + core::position2d<s32>(x_delta, y_delta),
-                                source,
-                                clip,
-                                black, true);
+                    drawGlyph(texture,
+                              dest + core::position2d<s32>(x_delta, y_delta),
+                              source, clip, black, glyph.m_distance_field);
                 }
             }
         }
 
-        if (fallback[n])
+        if (glyph.m_fallback)
         {
             // TODO: don't hardcode colors?
             video::SColor orange(color.getAlpha(), 255, 100, 0);
@@ -680,6 +741,11 @@ void ScalableFont::doDraw(const core::stringw& text,
                     source,
                     title_colors);
             }
+            else if (glyph.m_distance_field)
+            {
+                draw2DDistanceFieldImage(texture, dest, source, clip,
+                                         title_colors);
+            }
             else
             {
                 draw2DImage(texture,
@@ -701,13 +767,11 @@ void ScalableFont::doDraw(const core::stringw& text,
             }
             else
             {
-                draw2DImage(texture,
-                    dest,
-                    source,
-                    clip,
-                    color, true);
+                drawGlyph(texture, dest, source, clip, color,
+                          glyph.m_distance_field);
             }
 #ifdef FONT_DEBUG
+            flush2DBatch();
             video::IVideoDriver* driver = GUIEngine::getDriver();
             driver->draw2DLine(core::position2d<s32>(dest.UpperLeftCorner.X,  dest.UpperLeftCorner.Y),
                                core::position2d<s32>(dest.UpperLeftCorner.X,  dest.LowerRightCorner.Y),
@@ -724,6 +788,7 @@ void ScalableFont::doDraw(const core::stringw& text,
 #endif
         }
     }
+    end2DBatch();
 }
 
 
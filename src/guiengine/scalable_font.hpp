@@ -16,8 +16,11 @@
 #include "irrArray.h"
 
 
+#include <list>
 #include <map>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace irr
 {
@@ -57,11 +60,15 @@ class ScalableFont : public IGUIFontBitmap
         bool m_has_alpha;
         float m_scale;
         bool m_exclude_from_max_height_calculation;
+        /** True if the alpha channel of the texture is a distance field
+         *  (created with the "Distance field" option of the font tool). */
+        bool m_distance_field;
 
         TextureInfo()
         {
             m_has_alpha = false;
             m_scale = 1.0f;
+            m_distance_field = false;
         }
     };
 
@@ -97,6 +104,8 @@ public:
     {
         ScalableFont* out = new ScalableFont(*this);
         out->m_is_hollow_copy = true;
+        // The LRU list points into the map of the original
+        out->clearLayoutCache();
         out->setReferenceCount(1);
         return out;
     }
@@ -154,6 +163,7 @@ public:
 
     virtual void setInvisibleCharacters( const wchar_t *s );
 
+    void clearLayoutCache();
     void setScale(const float scale);
     float getScale() const { return m_scale; }
 
@@ -170,6 +180,70 @@ private:
         u32             spriteno;
     };
 
+    /** Everything that determines the layout of a string. Most of these
+     *  don't change after the font is set up, but the scale is changed
+     *  temporarily e.g. by the race gui. */
+    struct LayoutKey
+    {
+        std::wstring        m_text;
+        float               m_scale;
+        s32                 m_kerning_width;
+        bool                m_mono_space_digits;
+        const ScalableFont *m_fallback_font;
+        float               m_fallback_font_scale;
+        s32                 m_fallback_kerning_width;
+
+        bool operator==(const LayoutKey &other) const
+        {
+            return m_text == other.m_text && m_scale == other.m_scale &&
+                   m_kerning_width == other.m_kerning_width &&
+                   m_mono_space_digits == other.m_mono_space_digits &&
+                   m_fallback_font == other.m_fallback_font &&
+                   m_fallback_font_scale == other.m_fallback_font_scale &&
+                   m_fallback_kerning_width == other.m_fallback_kerning_width;
+        }
+    };   // LayoutKey
+
+    struct LayoutKeyHash
+    {
+        size_t operator()(const LayoutKey &key) const;
+    };   // LayoutKeyHash
+
+    /** A visible character of a laid out string. */
+    struct GlyphQuad
+    {
+        /** Line of the string the character is in. */
+        s32             m_line;
+        s32             m_texture_id;
+        bool            m_fallback;
+        /** True if the texture of the character is a distance field. */
+        bool            m_distance_field;
+        core::rect<s32> m_source;
+        /** Destination relative to the start of the line. */
+        core::rect<s32> m_dest;
+    };   // GlyphQuad
+
+    /** The result of resolving the characters of a string: its dimension and
+     *  the quads to draw, so that strings drawn every frame don't have to
+     *  look up each character again. */
+    struct TextLayout
+    {
+        core::dimension2d<u32>             m_dimension;
+        std::vector<GlyphQuad>             m_glyphs;
+        std::list<const LayoutKey*>::iterator m_lru_position;
+    };   // TextLayout
+
+    /** Maximum number of cached layouts, the least recently used ones are
+     *  removed first. */
+    static const unsigned MAX_CACHED_LAYOUTS = 512;
+
+    mutable std::unordered_map<LayoutKey, TextLayout, LayoutKeyHash>
+                                        m_layouts;
+    /** Keys of m_layouts, most recently used first. */
+    mutable std::list<const LayoutKey*> m_layout_lru;
+
+    const TextLayout &getLayout(const wchar_t *text) const;
+    void layoutText(const wchar_t *text, TextLayout *layout) const;
     int getCharWidth(const SFontArea& area, const bool fallback) const;
     s32 getAreaIDFromCharacter(const wchar_t c, bool* fallback_font) const;
     const SFontArea &getAreaFromCharacter(const wchar_t c, bool* fallback_font) const;
@@ -127,17 +127,12 @@ void Screen::loadFromFile()
 {
     assert(m_magic_number == 0xCAFEC001);
 
-    std::string path = file_manager->getAssetChecked(FileManager::GUI, m_filename, true);
-    IXMLReader* xml = file_manager->createXMLReader( path );
-
-    parseScreenFileDiv(xml, m_widgets);
+    parseScreenFile(m_filename, m_widgets);
     m_loaded = true;
     calculateLayout();
 
     // invoke callback so that the class deriving from Screen is aware of this event
     loadedFromFile();
-
-    delete xml;
 }   // loadFromFile
 
 // -----------------------------------------------------------------------------
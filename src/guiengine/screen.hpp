@@ -22,6 +22,7 @@
 #include <map>
 #include <string>
 #include <typeinfo>
+#include <vector>
 #include "utils/cpp2011.hpp"
 
 #include <irrString.h>
@@ -48,6 +49,8 @@ using namespace irr;
  */
 namespace GUIEngine
 {
+    struct ScreenFileNode;
+
 #define DEFINE_SCREEN_SINGLETON( ClassName )  \
     template<> ClassName* GUIEngine::ScreenSingleton< ClassName >::singleton = NULL
 
@@ -116,6 +119,10 @@ namespace GUIEngine
         /** to catch errors as early as possible, for debugging purposes only */
         unsigned int m_magic_number;
 
+        static void createWidgets(const std::vector<ScreenFileNode> &nodes,
+                                  PtrVector<Widget>& append_to,
+                                  irr::gui::IGUIElement* parent);
+
     protected:
         bool m_throttle_FPS;
 
@@ -129,11 +136,11 @@ namespace GUIEngine
          *
          * Builds a hierarchy of Widget objects whose contents are a direct
          * transcription of the XML file, with little analysis or layout
-         * performed on them.
+         * performed on them. Each file is only parsed once.
          */
-        static void parseScreenFileDiv(irr::io::IXMLReader* xml,
-                                       PtrVector<Widget>& append_to,
-                                       irr::gui::IGUIElement* parent = NULL);
+        static void parseScreenFile(const std::string &filename,
+                                    PtrVector<Widget>& append_to,
+                                    irr::gui::IGUIElement* parent = NULL);
 
 
         Screen(bool pause_race=true);
@@ -19,10 +19,13 @@
 #include "guiengine/screen.hpp"
 #include "guiengine/engine.hpp"
 #include "guiengine/widgets.hpp"
+#include "io/file_manager.hpp"
 #include "utils/translation.hpp"
 #include <iostream>
 #include <irrXML.h>
+#include <map>
 #include <sstream>
+#include <vector>
 
 using namespace irr;
 
@@ -33,251 +36,297 @@ using namespace io;
 using namespace gui;
 using namespace GUIEngine;
 
-void Screen::parseScreenFileDiv(irr::io::IXMLReader* xml, PtrVector<Widget>& append_to,
-                                irr::gui::IGUIElement* parent)
+/** An element of a GUI file with its attributes and children. The XML file
+ *  of each screen and dialog is only read once, the widgets are then
+ *  created from this tree each time they are needed (e.g. each time a
+ *  dialog is opened, or after the resolution was changed). */
+struct GUIEngine::ScreenFileNode
 {
-    // parse XML file
-    while (xml && xml->read())
+    std::wstring m_name;
+    std::map<std::wstring, std::wstring> m_attributes;
+    std::vector<ScreenFileNode> m_children;
+
+    /** Returns the value of an attribute, or NULL if it is not defined. */
+    const wchar_t* getAttribute(const wchar_t *name) const
     {
+        std::map<std::wstring, std::wstring>::const_iterator it =
+            m_attributes.find(name);
+        return it == m_attributes.end() ? NULL : it->second.c_str();
+    }
+};   // ScreenFileNode
 
-        switch (xml->getNodeType())
-        {
-            case irr::io::EXN_TEXT:
-            {
-                break;
-            }
+/** The GUI files read so far, indexed by their full path. */
+static std::map<std::string, ScreenFileNode> g_screen_files;
 
-            case irr::io::EXN_ELEMENT:
-            {
-                /* find which type of widget is specified by the current tag, and instanciate it */
-                if (wcscmp(L"div", xml->getNodeName()) == 0)
-                {
-                    Widget* w = new Widget(WTYPE_DIV);
-                    append_to.push_back(w);
-                }
-                else if (wcscmp(L"stkgui", xml->getNodeName()) == 0)
-                {
-                    // outer node that's there only to comply with XML standard (and expat)
-                    continue;
-                }
-                else if (wcscmp(L"placeholder", xml->getNodeName()) == 0)
-                {
-                    Widget* w = new Widget(WTYPE_DIV, true);
-                    append_to.push_back(w);
-                }
-                else if (wcscmp(L"box", xml->getNodeName()) == 0)
-                {
-                    Widget* w = new Widget(WTYPE_DIV);
-                    w->m_show_bounding_box = true;
-                    append_to.push_back(w);
-                }
-                else if (wcscmp(L"bottombar", xml->getNodeName()) == 0)
-                {
-                    Widget* w = new Widget(WTYPE_DIV);
-                    w->m_bottom_bar = true;
-                    append_to.push_back(w);
-                }
-                else if (wcscmp(L"topbar", xml->getNodeName()) == 0)
-                {
-                    Widget* w = new Widget(WTYPE_DIV);
-                    w->m_top_bar = true;
-                    append_to.push_back(w);
-                }
-                else if (wcscmp(L"roundedbox", xml->getNodeName()) == 0)
-                {
-                    Widget* w = new Widget(WTYPE_DIV);
-                    w->m_show_bounding_box = true;
-                    w->m_is_bounding_box_round = true;
-                    append_to.push_back(w);
-                }
-                else if (wcscmp(L"ribbon", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new RibbonWidget());
-                }
-                else if (wcscmp(L"buttonbar", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new RibbonWidget(RIBBON_TOOLBAR));
-                }
-                else if (wcscmp(L"tabs", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new RibbonWidget(RIBBON_TABS));
-                }
-                else if (wcscmp(L"spinner", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new SpinnerWidget());
-                }
-                else if (wcscmp(L"button", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new ButtonWidget());
-                }
-                else if (wcscmp(L"gauge", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new SpinnerWidget(true));
-                }
-                else if (wcscmp(L"progressbar", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new ProgressBarWidget());
-                }
-                else if (wcscmp(L"icon-button", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new IconButtonWidget());
-                }
-                else if (wcscmp(L"icon", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new IconButtonWidget(IconButtonWidget::SCALE_MODE_KEEP_TEXTURE_ASPECT_RATIO,
-                                                             false, false));
-                }
-                else if (wcscmp(L"checkbox", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new CheckBoxWidget());
-                }
-                else if (wcscmp(L"label", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new LabelWidget());
-                }
-                else if (wcscmp(L"bright", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new LabelWidget(false, true));
-                }
-                else if (wcscmp(L"bubble", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new BubbleWidget());
-                }
-                else if (wcscmp(L"header", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new LabelWidget(true));
-                }
-                else if (wcscmp(L"spacer", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new Widget(WTYPE_SPACER));
-                }
-                else if (wcscmp(L"ribbon_grid", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new DynamicRibbonWidget(false /* combo */, true /* multi-row */));
-                }
-                else if (wcscmp(L"scrollable_ribbon", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new DynamicRibbonWidget(true /* combo */, false /* multi-row */));
-                }
-                else if (wcscmp(L"scrollable_toolbar", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new DynamicRibbonWidget(false /* combo */, false /* multi-row */));
-                }
-                else if (wcscmp(L"model", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new ModelViewWidget());
-                }
-                else if (wcscmp(L"list", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new ListWidget());
-                }
-                else if (wcscmp(L"textbox", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new TextBoxWidget());
-                }
-                else if (wcscmp(L"ratingbar", xml->getNodeName()) == 0)
-                {
-                    append_to.push_back(new RatingBarWidget());
-                }
-                else
-                {
-                    Log::warn("Screen::parseScreenFileDiv", "unknown tag found in STK GUI file '%s'", xml->getNodeName());
-                    continue;
-                }
+// ----------------------------------------------------------------------------
+/** Reads the children of the current element of an XML file (or all
+ *  elements of the file) into a tree.
+ */
+static void readScreenFileNodes(io::IXMLReader* xml,
+                                std::vector<ScreenFileNode> &nodes)
+{
+    while (xml->read())
+    {
+        if (xml->getNodeType() == io::EXN_ELEMENT_END)
+            return;
+        if (xml->getNodeType() != io::EXN_ELEMENT)
+            continue;
 
-                /* retrieve the created widget */
-                Widget& widget = append_to[append_to.size()-1];
+        nodes.push_back(ScreenFileNode());
+        ScreenFileNode &node = nodes.back();
+        node.m_name = xml->getNodeName();
+        for (unsigned int i = 0; i < xml->getAttributeCount(); i++)
+            node.m_attributes[xml->getAttributeName(i)] =
+                xml->getAttributeValue(i);
+        if (!xml->isEmptyElement())
+            readScreenFileNodes(xml, node.m_children);
+    }
+}   // readScreenFileNodes
 
-                /* read widget properties using macro magic */
+// ----------------------------------------------------------------------------
+/** Creates the widgets of a GUI file, which is read the first time it is
+ *  needed.
+ *  \param filename Name of the file in the GUI directory.
+ *  \param append_to The widgets are added to this list.
+ *  \param parent Parent irrlicht element of the new widgets, can be NULL.
+ */
+void Screen::parseScreenFile(const std::string &filename,
+                             PtrVector<Widget>& append_to,
+                             irr::gui::IGUIElement* parent)
+{
+    std::string path = file_manager->getAssetChecked(FileManager::GUI,
+                                                     filename, true);
+    std::map<std::string, ScreenFileNode>::iterator it =
+        g_screen_files.find(path);
+    if (it == g_screen_files.end())
+    {
+        it = g_screen_files.insert(std::make_pair(path,
+                                                  ScreenFileNode())).first;
+        IXMLReader* xml = file_manager->createXMLReader(path);
+        if (xml)
+            readScreenFileNodes(xml, it->second.m_children);
+        delete xml;
+    }
+    createWidgets(it->second.m_children, append_to, parent);
+}   // parseScreenFile
 
-#define READ_PROPERTY( prop_name, prop_flag ) const wchar_t* prop_name = xml->getAttributeValue( L###prop_name ); \
-if(prop_name != NULL) widget.m_properties[prop_flag] = core::stringc(prop_name).c_str(); else widget.m_properties[prop_flag] = ""
+// ----------------------------------------------------------------------------
+/** Creates the widgets for the elements of a GUI file.
+ *  Builds a hierarchy of Widget objects whose contents are a direct
+ *  transcription of the XML file, with little analysis or layout
+ *  performed on them.
+ */
+void Screen::createWidgets(const std::vector<ScreenFileNode> &nodes,
+                           PtrVector<Widget>& append_to,
+                           irr::gui::IGUIElement* parent)
+{
+    for (unsigned int n = 0; n < nodes.size(); n++)
+    {
+        const ScreenFileNode &node = nodes[n];
+        const wchar_t *name = node.m_name.c_str();
 
-                READ_PROPERTY(id,             PROP_ID);
-                READ_PROPERTY(proportion,     PROP_PROPORTION);
-                READ_PROPERTY(width,          PROP_WIDTH);
-                READ_PROPERTY(height,         PROP_HEIGHT);
-                READ_PROPERTY(child_width,    PROP_CHILD_WIDTH);
-                READ_PROPERTY(child_height,   PROP_CHILD_HEIGHT);
-                READ_PROPERTY(word_wrap,      PROP_WORD_WRAP);
-                //READ_PROPERTY(grow_with_text, PROP_GROW_WITH_TEXT);
-                READ_PROPERTY(x,              PROP_X);
-                READ_PROPERTY(y,              PROP_Y);
-                READ_PROPERTY(layout,         PROP_LAYOUT);
-                READ_PROPERTY(align,          PROP_ALIGN);
-                READ_PROPERTY(custom_ratio,   PROP_CUSTOM_RATIO);
+        /* find which type of widget is specified by the current tag, and instanciate it */
+        if (wcscmp(L"div", name) == 0)
+        {
+            Widget* w = new Widget(WTYPE_DIV);
+            append_to.push_back(w);
+        }
+        else if (wcscmp(L"stkgui", name) == 0)
+        {
+            // outer node that's there only to comply with XML standard (and expat)
+            createWidgets(node.m_children, append_to, parent);
+            continue;
+        }
+        else if (wcscmp(L"placeholder", name) == 0)
+        {
+            Widget* w = new Widget(WTYPE_DIV, true);
+            append_to.push_back(w);
+        }
+        else if (wcscmp(L"box", name) == 0)
+        {
+            Widget* w = new Widget(WTYPE_DIV);
+            w->m_show_bounding_box = true;
+            append_to.push_back(w);
+        }
+        else if (wcscmp(L"bottombar", name) == 0)
+        {
+            Widget* w = new Widget(WTYPE_DIV);
+            w->m_bottom_bar = true;
+            append_to.push_back(w);
+        }
+        else if (wcscmp(L"topbar", name) == 0)
+        {
+            Widget* w = new Widget(WTYPE_DIV);
+            w->m_top_bar = true;
+            append_to.push_back(w);
+        }
+        else if (wcscmp(L"roundedbox", name) == 0)
+        {
+            Widget* w = new Widget(WTYPE_DIV);
+            w->m_show_bounding_box = true;
+            w->m_is_bounding_box_round = true;
+            append_to.push_back(w);
+        }
+        else if (wcscmp(L"ribbon", name) == 0)
+        {
+            append_to.push_back(new RibbonWidget());
+        }
+        else if (wcscmp(L"buttonbar", name) == 0)
+        {
+            append_to.push_back(new RibbonWidget(RIBBON_TOOLBAR));
+        }
+        else if (wcscmp(L"tabs", name) == 0)
+        {
+            append_to.push_back(new RibbonWidget(RIBBON_TABS));
+        }
+        else if (wcscmp(L"spinner", name) == 0)
+        {
+            append_to.push_back(new SpinnerWidget());
+        }
+        else if (wcscmp(L"button", name) == 0)
+        {
+            append_to.push_back(new ButtonWidget());
+        }
+        else if (wcscmp(L"gauge", name) == 0)
+        {
+            append_to.push_back(new SpinnerWidget(true));
+        }
+        else if (wcscmp(L"progressbar", name) == 0)
+        {
+            append_to.push_back(new ProgressBarWidget());
+        }
+        else if (wcscmp(L"icon-button", name) == 0)
+        {
+            append_to.push_back(new IconButtonWidget());
+        }
+        else if (wcscmp(L"icon", name) == 0)
+        {
+            append_to.push_back(new IconButtonWidget(IconButtonWidget::SCALE_MODE_KEEP_TEXTURE_ASPECT_RATIO,
+                                                     false, false));
+        }
+        else if (wcscmp(L"checkbox", name) == 0)
+        {
+            append_to.push_back(new CheckBoxWidget());
+        }
+        else if (wcscmp(L"label", name) == 0)
+        {
+            append_to.push_back(new LabelWidget());
+        }
+        else if (wcscmp(L"bright", name) == 0)
+        {
+            append_to.push_back(new LabelWidget(false, true));
+        }
+        else if (wcscmp(L"bubble", name) == 0)
+        {
+            append_to.push_back(new BubbleWidget());
+        }
+        else if (wcscmp(L"header", name) == 0)
+        {
+            append_to.push_back(new LabelWidget(true));
+        }
+        else if (wcscmp(L"spacer", name) == 0)
+        {
+            append_to.push_back(new Widget(WTYPE_SPACER));
+        }
+        else if (wcscmp(L"ribbon_grid", name) == 0)
+        {
+            append_to.push_back(new DynamicRibbonWidget(false /* combo */, true /* multi-row */));
+        }
+        else if (wcscmp(L"scrollable_ribbon", name) == 0)
+        {
+            append_to.push_back(new DynamicRibbonWidget(true /* combo */, false /* multi-row */));
+        }
+        else if (wcscmp(L"scrollable_toolbar", name) == 0)
+        {
+            append_to.push_back(new DynamicRibbonWidget(false /* combo */, false /* multi-row */));
+        }
+        else if (wcscmp(L"model", name) == 0)
+        {
+            append_to.push_back(new ModelViewWidget());
+        }
+        else if (wcscmp(L"list", name) == 0)
+        {
+            append_to.push_back(new ListWidget());
+        }
+        else if (wcscmp(L"textbox", name) == 0)
+        {
+            append_to.push_back(new TextBoxWidget());
+        }
+        else if (wcscmp(L"ratingbar", name) == 0)
+        {
+            append_to.push_back(new RatingBarWidget());
+        }
+        else
+        {
+            Log::warn("Screen::createWidgets", "unknown tag found in STK GUI file '%s'",
+                      core::stringc(name).c_str());
+            createWidgets(node.m_children, append_to, parent);
+            continue;
+        }
 
-                READ_PROPERTY(icon,           PROP_ICON);
-                READ_PROPERTY(focus_icon,     PROP_FOCUS_ICON);
-                READ_PROPERTY(text_align,     PROP_TEXT_ALIGN);
-                READ_PROPERTY(min_value,      PROP_MIN_VALUE);
-                READ_PROPERTY(max_value,      PROP_MAX_VALUE);
-                READ_PROPERTY(square_items,   PROP_SQUARE);
+        /* retrieve the created widget */
+        Widget& widget = append_to[append_to.size()-1];
 
-                READ_PROPERTY(max_width,      PROP_MAX_WIDTH);
-                READ_PROPERTY(max_height,     PROP_MAX_HEIGHT);
-                READ_PROPERTY(extend_label,   PROP_EXTEND_LABEL);
-                READ_PROPERTY(label_location, PROP_LABELS_LOCATION);
-                READ_PROPERTY(max_rows,       PROP_MAX_ROWS);
-                READ_PROPERTY(wrap_around,    PROP_WRAP_AROUND);
-                READ_PROPERTY(padding,        PROP_DIV_PADDING);
-                READ_PROPERTY(keep_selection, PROP_KEEP_SELECTION);
-#undef READ_PROPERTY
+        /* read widget properties using macro magic */
 
-                const wchar_t* text = xml->getAttributeValue( L"text" );
+#define READ_PROPERTY( prop_name, prop_flag ) const wchar_t* prop_name = node.getAttribute( L###prop_name ); \
+if(prop_name != NULL) widget.m_properties[prop_flag] = core::stringc(prop_name).c_str(); else widget.m_properties[prop_flag] = ""
 
-                if (text != NULL)
-                {
-                    widget.m_text = _(text);
-                }
+        READ_PROPERTY(id,             PROP_ID);
+        READ_PROPERTY(proportion,     PROP_PROPORTION);
+        READ_PROPERTY(width,          PROP_WIDTH);
+        READ_PROPERTY(height,         PROP_HEIGHT);
+        READ_PROPERTY(child_width,    PROP_CHILD_WIDTH);
+        READ_PROPERTY(child_height,   PROP_CHILD_HEIGHT);
+        READ_PROPERTY(word_wrap,      PROP_WORD_WRAP);
+        //READ_PROPERTY(grow_with_text, PROP_GROW_WITH_TEXT);
+        READ_PROPERTY(x,              PROP_X);
+        READ_PROPERTY(y,              PROP_Y);
+        READ_PROPERTY(layout,         PROP_LAYOUT);
+        READ_PROPERTY(align,          PROP_ALIGN);
+        READ_PROPERTY(custom_ratio,   PROP_CUSTOM_RATIO);
 
-                const wchar_t* raw_text = xml->getAttributeValue(L"raw_text");
+        READ_PROPERTY(icon,           PROP_ICON);
+        READ_PROPERTY(focus_icon,     PROP_FOCUS_ICON);
+        READ_PROPERTY(text_align,     PROP_TEXT_ALIGN);
+        READ_PROPERTY(min_value,      PROP_MIN_VALUE);
+        READ_PROPERTY(max_value,      PROP_MAX_VALUE);
+        READ_PROPERTY(square_items,   PROP_SQUARE);
 
-                if (raw_text != NULL)
-                {
-                    widget.m_text = raw_text;
-                }
+        READ_PROPERTY(max_width,      PROP_MAX_WIDTH);
+        READ_PROPERTY(max_height,     PROP_MAX_HEIGHT);
+        READ_PROPERTY(extend_label,   PROP_EXTEND_LABEL);
+        READ_PROPERTY(label_location, PROP_LABELS_LOCATION);
+        READ_PROPERTY(max_rows,       PROP_MAX_ROWS);
+        READ_PROPERTY(wrap_around,    PROP_WRAP_AROUND);
+        READ_PROPERTY(padding,        PROP_DIV_PADDING);
+        READ_PROPERTY(keep_selection, PROP_KEEP_SELECTION);
+#undef READ_PROPERTY
 
-                if (parent != NULL)
-                {
-                    widget.setParent(parent);
-                }
+        const wchar_t* text = node.getAttribute( L"text" );
 
-                /* a new div starts here, continue parsing with this new div as new parent */
-                if (widget.getType() == WTYPE_DIV || widget.getType() == WTYPE_RIBBON)
-                {
-                    parseScreenFileDiv( xml, append_to[append_to.size()-1].m_children, parent );
-                }
-            }// end case EXN_ELEMENT
+        if (text != NULL)
+        {
+            widget.m_text = _(text);
+        }
 
-                break;
-            case irr::io::EXN_ELEMENT_END:
-            {
-                // we're done parsing this 'div', return one step back in the recursive call
-                if (wcscmp(L"div", xml->getNodeName()) == 0)
-                    return;
-                if (wcscmp(L"box", xml->getNodeName()) == 0)
-                    return;
-                if (wcscmp(L"placeholder", xml->getNodeName()) == 0)
-                    return;
-                if (wcscmp(L"roundedbox", xml->getNodeName()) == 0)
-                    return;
-                if (wcscmp(L"bottombar", xml->getNodeName()) == 0)
-                    return;
-                if (wcscmp(L"topbar", xml->getNodeName()) == 0)
-                    return;
+        const wchar_t* raw_text = node.getAttribute(L"raw_text");
 
-                // We're done parsing this 'ribbon', return one step back in
-                // the recursive call.
-                if (wcscmp(L"ribbon", xml->getNodeName()) == 0 ||
-                    wcscmp(L"buttonbar", xml->getNodeName()) == 0 ||
-                    wcscmp(L"tabs", xml->getNodeName()) == 0)
-                    return;
-            }
-                break;
+        if (raw_text != NULL)
+        {
+            widget.m_text = raw_text;
+        }
 
-            default: break;
-        }//end switch
-    } // end while
-} // end function
+        if (parent != NULL)
+        {
+            widget.setParent(parent);
+        }
 
+        /* a new div starts here, continue with this new div as new parent,
+         * other elements should not have children */
+        if (widget.getType() == WTYPE_DIV || widget.getType() == WTYPE_RIBBON)
+            createWidgets(node.m_children, widget.m_children, parent);
+        else
+            createWidgets(node.m_children, append_to, parent);
+    }
+}   // createWidgets
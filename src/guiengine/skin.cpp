@@ -632,6 +632,8 @@ X##_yflip.LowerRightCorner.Y = w->m_skin_dest_y + \
         colorptr[3].setAlpha(100);
     }
 
+    // All pieces use the same texture and are drawn with one call
+    begin2DBatch();
     if ((areas & BoxRenderParams::LEFT) != 0)
     {
         draw2DImage(source, dest_area_left,
@@ -696,6 +698,7 @@ X##_yflip.LowerRightCorner.Y = w->m_skin_dest_y + \
                                             clipRect, colorptr,
                                             /*alpha*/true );
     }
+    end2DBatch();
 
     if (colorptr != NULL)
     {
@@ -1086,6 +1089,7 @@ void Skin::drawRibbonChild(const core::recti &rect, Widget* widget,
 
                 const float dt = GUIEngine::getLatestDt();
                 glow_effect += dt*3;
+                GUIEngine::requestAnimationFrame();
                 if (glow_effect > 6.2832f /* 2*PI */) glow_effect -= 6.2832f;
                 grow = (int)(45 + 10*sin(glow_effect));
 
@@ -1449,6 +1453,7 @@ void Skin::drawIconButton(const core::recti &rect, Widget* widget,
 
         const float dt = GUIEngine::getLatestDt();
         glow_effect += dt*3;
+        GUIEngine::requestAnimationFrame();
         if (glow_effect > 6.2832f /* 2*PI */) glow_effect -= 6.2832f;
         grow = (int)(45 + 10*sin(glow_effect));
 
@@ -1955,8 +1960,9 @@ void Skin::process3DPane(IGUIElement *element, const core::recti &rect,
         FrameBuffer* fb = mvw->getFrameBuffer();
         if (fb != NULL && fb->getRTT().size() > 0)
         {
-            draw2DImageFromRTT(fb->getRTT()[0], 512, 512,
-                rect, core::rect<s32>(0, 0, 512, 512), NULL, SColor(255, 255, 255, 255), true);
+            draw2DImageFromRTT(fb->getRTT()[0], fb->getWidth(),
+                fb->getHeight(), rect, mvw->getPreviewRect(), NULL,
+                SColor(255, 255, 255, 255), true);
         }
     }
     else if (type == WTYPE_ICON_BUTTON || type == WTYPE_MODEL_VIEW)
@@ -2300,6 +2306,7 @@ core::recti Skin::draw3DWindowBackground(IGUIElement *element,
                                SkinConfig::m_render_params["window::neutral"]);
 
         m_dialog_size += GUIEngine::getLatestDt()*5;
+        GUIEngine::invalidate();
     }
     else
     {
@@ -124,6 +124,7 @@ void Widget::setText(const wchar_t *s)
     m_text = s;
     if(m_element)
         m_element->setText(s);
+    GUIEngine::invalidate();
 }   // setText
 
 // -----------------------------------------------------------------------------
@@ -153,6 +154,7 @@ void Widget::setActivated()
     // even if this one is already active, do it anyway on purpose, maybe the
     // children widgets need to be updated
     m_deactivated = false;
+    GUIEngine::invalidate();
     const int count = m_children.size();
     for (int n=0; n<count; n++)
     {
@@ -167,6 +169,7 @@ void Widget::setDeactivated()
     // even if this one is already inactive, do it anyway on purpose, maybe the
     // children widgets need to be updated
     m_deactivated = true;
+    GUIEngine::invalidate();
     const int count = m_children.size();
     for (int n=0; n<count; n++)
     {
@@ -263,6 +266,7 @@ void Widget::setFocusForPlayer(const int playerID)
 
     m_player_focus[playerID] = true;
     GUIEngine::Private::g_focus_for_player[playerID] = this;
+    GUIEngine::invalidate();
 
     // Callback
     this->focused(playerID);
@@ -280,6 +284,7 @@ void Widget::unsetFocusForPlayer(const int playerID)
 
     if (m_player_focus[playerID]) this->unfocused(playerID, NULL);
     m_player_focus[playerID] = false;
+    GUIEngine::invalidate();
 }
 
 // -----------------------------------------------------------------------------
@@ -307,6 +312,7 @@ void Widget::move(const int x, const int y, const int w, const int h)
 
     if (m_element != NULL)
         m_element->setRelativePosition( core::rect < s32 > (x, y, x+w, y+h) );
+    GUIEngine::invalidate();
 }
 
 // -----------------------------------------------------------------------------
@@ -346,6 +352,7 @@ void Widget::setVisible(bool visible)
         m_element->setVisible(visible);
     }
     m_is_visible = visible;
+    GUIEngine::invalidate();
 
     const int childrenCount = m_children.size();
     for (int n=0; n<childrenCount; n++)
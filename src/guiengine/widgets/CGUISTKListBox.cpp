@@ -11,6 +11,8 @@
 #include "IGUIFont.h"
 #include "IGUISpriteBank.h"
 #include "IGUIScrollBar.h"
+#include "graphics/2dutils.hpp"
+#include "guiengine/engine.hpp"
 #include "utils/time.hpp"
 
 
@@ -147,6 +149,7 @@ void CGUISTKListBox::clear()
     Items.clear();
     ItemsIconWidth = 0;
     Selected = -1;
+    GUIEngine::invalidate();
 
     if (ScrollBar)
         ScrollBar->setPos(0);
@@ -208,6 +211,7 @@ void CGUISTKListBox::setSelected(s32 id)
     selectTime = (u32)StkTime::getTimeSinceEpoch();
 
     recalculateScrollPos();
+    GUIEngine::invalidate();
 }
 
 s32 CGUISTKListBox::getRowByCellText(const wchar_t * text)
@@ -468,13 +472,25 @@ void CGUISTKListBox::draw()
 
     frameRect.LowerRightCorner.Y = AbsoluteRect.UpperLeftCorner.Y + ItemHeight;
 
-    frameRect.UpperLeftCorner.Y -= ScrollBar->getPos();
-    frameRect.LowerRightCorner.Y -= ScrollBar->getPos();
+    // Only the rows inside the box are visited, so that the cost of drawing
+    // doesn't depend on the number of items. The row before the first one
+    // is included since its bottom edge may touch the box.
+    s32 first = 0;
+    if (ItemHeight > 0)
+        first = core::max_(0, ScrollBar->getPos() / ItemHeight - 1);
+
+    frameRect.UpperLeftCorner.Y += first*ItemHeight - ScrollBar->getPos();
+    frameRect.LowerRightCorner.Y += first*ItemHeight - ScrollBar->getPos();
 
     bool hl = (HighlightWhenNotFocused || Environment->hasFocus(this) || Environment->hasFocus(ScrollBar));
 
-    for (s32 i=0; i<(s32)Items.size(); ++i)
+    // Draw the text and icons of all rows in as few draw calls as possible
+    begin2DBatch();
+    for (s32 i=first; i<(s32)Items.size(); ++i)
     {
+        if (frameRect.UpperLeftCorner.Y > AbsoluteRect.LowerRightCorner.Y)
+            break;
+
         if (frameRect.LowerRightCorner.Y >= AbsoluteRect.UpperLeftCorner.Y &&
             frameRect.UpperLeftCorner.Y <= AbsoluteRect.LowerRightCorner.Y)
         {
@@ -504,6 +520,8 @@ void CGUISTKListBox::draw()
                         iconPos.Y += textRect.getHeight() / 2;
                         iconPos.X += ItemsIconWidth/2;
 
+                        // The sprite bank may draw through the driver
+                        flush2DBatch();
                         if ( i==Selected && hl )
                         {
                             IconBank->draw2DSprite(
@@ -555,6 +573,7 @@ void CGUISTKListBox::draw()
         frameRect.UpperLeftCorner.Y += ItemHeight;
         frameRect.LowerRightCorner.Y += ItemHeight;
     }
+    end2DBatch();
 
     IGUIElement::draw();
 }
@@ -566,6 +585,7 @@ u32 CGUISTKListBox::addItem(const ListItem & item)
     Items.push_back(item);
     recalculateItemHeight();
     recalculateIconWidth();
+    GUIEngine::invalidate();
     return Items.size() - 1;
 }
 
@@ -891,12 +891,18 @@ void DynamicRibbonWidget::updateItemDisplay()
 
     // ---- to determine which items go in which cell of the dynamic ribbon now,
     //      we create a temporary 2D table and fill them with the ID of the item
-    //      they need to display.
-    //int item_placement[row_amount][m_needed_cols];
+    //      they need to display. Only the columns that have an icon widget
+    //      are part of it, so that scrolling through a very large number of
+    //      items costs as much as scrolling through a screenful of them.
+    int visible_cols = 0;
+    for (int r=0; r<row_amount; r++)
+        visible_cols = std::max(visible_cols, (int)m_rows[r].m_children.size());
+    visible_cols = std::min(visible_cols, m_needed_cols);
+
     std::vector<std::vector<int> > item_placement;
     item_placement.resize(row_amount);
     for(int i=0; i<row_amount; i++)
-        item_placement[i].resize(m_needed_cols);
+        item_placement[i].resize(visible_cols);
 
     int counter = 0;
 
@@ -904,7 +910,7 @@ void DynamicRibbonWidget::updateItemDisplay()
     std::cout << m_items.size() << " items to be placed:\n{\n";
 #endif
 
-    for (int c=0; c<m_needed_cols; c++)
+    for (int c=0; c<visible_cols; c++)
     {
         for (int r=0; r<row_amount; r++)
         {
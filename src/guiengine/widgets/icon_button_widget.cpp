@@ -347,6 +347,7 @@ video::ITexture* IconButtonWidget::getDeactivatedTexture(video::ITexture* textur
 void IconButtonWidget::setTexture(video::ITexture* texture)
 {
     m_texture = texture;
+    GUIEngine::invalidate();
     if (texture == NULL)
     {
         m_deactivated_texture = NULL;
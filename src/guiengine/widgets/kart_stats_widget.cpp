@@ -67,6 +67,9 @@ KartStatsWidget::KartStatsWidget(core::recti area, const int player_id,
                        "kart '%s' nor any other kart.",
                        default_kart.c_str());
     }
+    props = kart_properties_manager->getLoadedKart(props->getIdent());
+    if(!props)
+        Log::fatal("KartSelectionScreen", "Can't load the default kart.");
 
 
     for (int i = 0; i < SKILL_COUNT; ++i)
@@ -17,6 +17,7 @@
 
 #include "config/user_config.hpp"
 #include "graphics/central_settings.hpp"
+#include "graphics/glwrap.hpp"
 #include "guiengine/engine.hpp"
 #include "guiengine/widgets/model_view_widget.hpp"
 #include "graphics/irr_driver.hpp"
@@ -33,6 +34,25 @@ using namespace GUIEngine;
 using namespace irr::core;
 using namespace irr::gui;
 
+/** Size of the image of a model view. */
+static const unsigned PREVIEW_SIZE = 512;
+/** Number of images in each row and column of the preview atlas. */
+static const unsigned ATLAS_COLUMNS = 4;
+static const unsigned ATLAS_ROWS    = 2;
+/** A model view is only rendered again once its rotation changed by that
+ *  many degrees, the last image is shown in between. */
+static const float    ANGLE_THRESHOLD = 2.0f;
+
+/** All model views are rendered with the same render targets, and their
+ *  images are then copied into one atlas, from which the skin draws them. */
+static RTT                   *g_preview_rtt   = NULL;
+static FrameBuffer           *g_preview_atlas = NULL;
+static GLuint                 g_preview_atlas_texture = 0;
+/** True for each slot of the atlas which is used by a widget. */
+static std::vector<bool>      g_preview_slots;
+/** Number of widgets which use the render targets. */
+static unsigned               g_preview_users = 0;
+
 ModelViewWidget::ModelViewWidget() :
 IconButtonWidget(IconButtonWidget::SCALE_MODE_KEEP_TEXTURE_ASPECT_RATIO, false, false)
 {
@@ -41,8 +61,10 @@ IconButtonWidget(IconButtonWidget::SCALE_MODE_KEEP_TEXTURE_ASPECT_RATIO, false,
     m_camera = NULL;
     m_light = NULL;
     m_type = WTYPE_MODEL_VIEW;
-    m_rtt_provider = NULL;
     m_rotation_mode = ROTATE_OFF;
+    m_rendered_angle = 0.0f;
+    m_preview_valid = false;
+    m_atlas_slot = -1;
     
     // so that the base class doesn't complain there is no icon defined
     m_properties[PROP_ICON]="gui/main_help.png";
@@ -54,8 +76,7 @@ ModelViewWidget::~ModelViewWidget()
 {
     GUIEngine::needsUpdate.remove(this);
     
-    delete m_rtt_provider;
-    m_rtt_provider = NULL;
+    releasePreview();
 }
 // -----------------------------------------------------------------------------
 void ModelViewWidget::add()
@@ -91,6 +112,7 @@ void ModelViewWidget::clearModels()
     m_rtt_main_node = NULL;
     m_camera = NULL;
     m_light = NULL;
+    m_preview_valid = false;
 }
 
 // -----------------------------------------------------------------------------
@@ -110,7 +132,7 @@ void ModelViewWidget::addModel(irr::scene::IMesh* mesh, const Vec3& location,
 void ModelViewWidget::update(float delta)
 {
     if (m_rtt_unsupported) return;
-    
+
     if (m_rotation_mode == ROTATE_CONTINUOUSLY)
     {
         angle += delta*m_rotation_speed;
@@ -159,34 +181,144 @@ void ModelViewWidget::update(float delta)
     if (!CVS->isGLSL())
         return;
     
-    if (m_rtt_provider == NULL)
-    {
-        std::string name = "model view ";
-        name += m_properties[PROP_ID].c_str();
-        
-        m_rtt_provider = new RTT(512, 512);
-    }
+    if (m_frame_buffer == NULL)
+        allocatePreview();
     
     if (m_rtt_main_node == NULL)
     {
         setupRTTScene(m_models, m_model_location, m_model_scale, m_model_frames);
     }
+
+    // Keep the last image while the model hardly turned
+    if (m_preview_valid && fabsf(angle - m_rendered_angle) < ANGLE_THRESHOLD)
+        return;
     
     m_rtt_main_node->setRotation(core::vector3df(0.0f, angle, 0.0f));
     
     m_rtt_main_node->setVisible(true);
 
-    m_frame_buffer = m_rtt_provider->render(m_camera, GUIEngine::getLatestDt());
+    FrameBuffer *result = g_preview_rtt->render(m_camera,
+                                                GUIEngine::getLatestDt());
 
     m_rtt_main_node->setVisible(false);
+
+    // Copy the image out of the shared render targets, which are
+    // overwritten by the next model view
+    glEnable(GL_FRAMEBUFFER_SRGB);
+    FrameBuffer::BlitToArea(*result, *m_frame_buffer,
+                            m_preview_rect.UpperLeftCorner.X,
+                            m_preview_rect.UpperLeftCorner.Y,
+                            m_preview_rect.LowerRightCorner.X,
+                            m_preview_rect.LowerRightCorner.Y);
+    glDisable(GL_FRAMEBUFFER_SRGB);
+
+    m_rendered_angle = angle;
+    m_preview_valid = true;
+    GUIEngine::invalidate();
 }
 
+// -----------------------------------------------------------------------------
+/** Creates the shared render targets if this is the first model view, and
+ *  reserves a slot of the atlas for the image of this widget. If all slots
+ *  are used, the widget gets its own frame buffer instead.
+ */
+void ModelViewWidget::allocatePreview()
+{
+    if (g_preview_users++ == 0)
+        g_preview_rtt = new RTT(PREVIEW_SIZE, PREVIEW_SIZE);
+
+    if (g_preview_atlas == NULL)
+    {
+        glGenTextures(1, &g_preview_atlas_texture);
+        glBindTexture(GL_TEXTURE_2D, g_preview_atlas_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8,
+                     ATLAS_COLUMNS * PREVIEW_SIZE, ATLAS_ROWS * PREVIEW_SIZE,
+                     0, GL_BGRA, GL_UNSIGNED_BYTE, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        g_preview_atlas = new FrameBuffer(
+            std::vector<GLuint>(1, g_preview_atlas_texture),
+            ATLAS_COLUMNS * PREVIEW_SIZE, ATLAS_ROWS * PREVIEW_SIZE);
+        g_preview_slots.assign(ATLAS_COLUMNS * ATLAS_ROWS, false);
+    }
+
+    m_atlas_slot = -1;
+    for (unsigned i = 0; i < g_preview_slots.size(); i++)
+    {
+        if (!g_preview_slots[i])
+        {
+            g_preview_slots[i] = true;
+            m_atlas_slot = i;
+            break;
+        }
+    }
+
+    if (m_atlas_slot >= 0)
+    {
+        const int x = (m_atlas_slot % ATLAS_COLUMNS) * PREVIEW_SIZE;
+        const int y = (m_atlas_slot / ATLAS_COLUMNS) * PREVIEW_SIZE;
+        m_frame_buffer = g_preview_atlas;
+        m_preview_rect = core::recti(x, y, x + PREVIEW_SIZE, y + PREVIEW_SIZE);
+    }
+    else
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, PREVIEW_SIZE,
+                     PREVIEW_SIZE, 0, GL_BGRA, GL_UNSIGNED_BYTE, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        m_frame_buffer = new FrameBuffer(std::vector<GLuint>(1, texture),
+                                         PREVIEW_SIZE, PREVIEW_SIZE);
+        m_preview_rect = core::recti(0, 0, PREVIEW_SIZE, PREVIEW_SIZE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_preview_valid = false;
+}   // allocatePreview
+
+// -----------------------------------------------------------------------------
+/** Frees the slot or frame buffer of this widget, and the shared render
+ *  targets once no model view uses them anymore.
+ */
+void ModelViewWidget::releasePreview()
+{
+    if (m_frame_buffer == NULL)
+        return;
+
+    if (m_atlas_slot >= 0)
+    {
+        g_preview_slots[m_atlas_slot] = false;
+    }
+    else
+    {
+        GLuint texture = m_frame_buffer->getRTT()[0];
+        delete m_frame_buffer;
+        glDeleteTextures(1, &texture);
+    }
+    m_frame_buffer = NULL;
+    m_atlas_slot = -1;
+    m_preview_valid = false;
+
+    if (--g_preview_users == 0)
+    {
+        delete g_preview_rtt;
+        g_preview_rtt = NULL;
+        delete g_preview_atlas;
+        g_preview_atlas = NULL;
+        glDeleteTextures(1, &g_preview_atlas_texture);
+        g_preview_atlas_texture = 0;
+        g_preview_slots.clear();
+    }
+}   // releasePreview
+
 void ModelViewWidget::setupRTTScene(PtrVector<scene::IMesh, REF>& mesh,
                                     AlignedArray<Vec3>& mesh_location,
                                     AlignedArray<Vec3>& mesh_scale,
                                     const std::vector<int>& model_frames)
 {
     irr_driver->suppressSkyBox();
+    m_preview_valid = false;
     
     if (m_rtt_main_node != NULL) m_rtt_main_node->remove();
     if (m_light != NULL) m_light->remove();
@@ -303,13 +435,11 @@ bool ModelViewWidget::isRotating()
 
 void ModelViewWidget::elementRemoved()
 {
-    delete m_rtt_provider;
-    m_rtt_provider = NULL;
+    releasePreview();
     IconButtonWidget::elementRemoved();
 }
 
 void ModelViewWidget::clearRttProvider()
 {
-    delete m_rtt_provider;
-    m_rtt_provider = NULL;
+    releasePreview();
 }
@@ -52,9 +52,20 @@ namespace GUIEngine
         
         video::ITexture* m_texture;
         
-        RTT* m_rtt_provider;
-        
         float angle;
+
+        /** Angle the image in the preview was rendered with. */
+        float m_rendered_angle;
+
+        /** True if the preview contains an image of the current models. */
+        bool m_preview_valid;
+
+        /** Slot of the preview atlas used by this widget, or -1 if it has
+         *  its own frame buffer because the atlas is full. */
+        int m_atlas_slot;
+
+        /** Part of the frame buffer the image of this widget is in. */
+        core::recti m_preview_rect;
         
         bool m_rtt_unsupported;
         
@@ -64,8 +75,13 @@ namespace GUIEngine
 
         scene::ISceneNode          *m_light;
 
+        /** Either the shared preview atlas or the own frame buffer of this
+         *  widget, NULL before the first update. */
         FrameBuffer                *m_frame_buffer;
 
+        void allocatePreview();
+        void releasePreview();
+
     public:
         
         LEAK_CHECK()
@@ -103,7 +119,15 @@ namespace GUIEngine
             AlignedArray<Vec3>& mesh_scale,
             const std::vector<int>& model_frames);
 
-        FrameBuffer* getFrameBuffer() { return m_frame_buffer; }
+        /** Returns the frame buffer the image of the models is in, or NULL
+         *  if nothing was rendered yet. */
+        FrameBuffer* getFrameBuffer()
+        {
+            return m_preview_valid ? m_frame_buffer : NULL;
+        }
+
+        /** Returns the part of the frame buffer the image is in. */
+        const core::recti& getPreviewRect() const { return m_preview_rect; }
     };
     
 }
@@ -182,6 +182,9 @@ PlayerKartWidget::PlayerKartWidget(KartSelectionScreen* parent,
                        "kart '%s' nor any other kart.",
                        default_kart.c_str());
     }
+    props = kart_properties_manager->getLoadedKart(props->getIdent());
+    if(!props)
+        Log::fatal("KartSelectionScreen", "Can't load the default kart.");
     m_kartInternalName = props->getIdent();
 
     const KartModel &kart_model = props->getMasterKartModel();
@@ -76,6 +76,7 @@ void ProgressBarWidget::setValue(int value)
     m_previous_value = value;
     if (m_show_label)
         setLabel(std::string(StringUtils::toString(value) + "%").c_str());
+    GUIEngine::invalidate();
 }   // setValue
 
 // -----------------------------------------------------------------------------
@@ -103,6 +104,7 @@ void ProgressBarWidget::update(float delta)
             cur = 1;
         m_value = int(m_previous_value + 
                       cur * (m_target_value - m_previous_value) );
+        GUIEngine::invalidate();
     }
 }   // update
 
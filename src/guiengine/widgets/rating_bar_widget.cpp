@@ -90,6 +90,7 @@ void RatingBarWidget::setRating(float rating)
 {
     m_rating = rating;
     setStepValues(m_rating);
+    GUIEngine::invalidate();
 }
 
 // -----------------------------------------------------------------------------
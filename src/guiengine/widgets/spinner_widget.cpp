@@ -329,6 +329,7 @@ void SpinnerWidget::setValue(const int new_value)
 {
     m_value = new_value;
     m_customText = "";
+    GUIEngine::invalidate();
 
     if (m_graphical)
     {
@@ -68,6 +68,7 @@ DeviceConfig::DeviceConfig()
     m_name    = "";
     m_enabled = true;
     m_plugged = 0;
+    m_actions_for_input_valid = false;
 }   // DeviceConfig
 
 // ------------------------------------------------------------------------
@@ -181,8 +182,23 @@ void DeviceConfig::setBinding ( const PlayerAction      action,
                                 wchar_t                 character)
 {
     m_bindings[action].set(type, id, direction, range, character);
+    m_actions_for_input_valid = false;
 }   // setBinding
 
+//------------------------------------------------------------------------------
+/** Rebuilds the table with the actions bound to each input. */
+void DeviceConfig::updateActionsForInput()
+{
+    m_actions_for_input.clear();
+    for (int n = 0; n < PA_COUNT; n++)
+    {
+        const int key = getInputKey(m_bindings[n].getType(),
+                                    m_bindings[n].getId());
+        m_actions_for_input[key].push_back((PlayerAction)n);
+    }
+    m_actions_for_input_valid = true;
+}   // updateActionsForInput
+
 //------------------------------------------------------------------------------
 /** Searches for a game actions associated with the given input event.
  * \note               Don't call this directly unless you are KeyboardDevice or
@@ -230,48 +246,56 @@ bool DeviceConfig::doGetAction(Input::InputType    type,
 {
     if (!m_enabled) return false;
 
+    if (!m_actions_for_input_valid)
+        updateActionsForInput();
+    std::unordered_map<int, std::vector<PlayerAction> >::const_iterator it =
+        m_actions_for_input.find(getInputKey(type, id));
+    if (it == m_actions_for_input.end())
+        return false;
+
     bool success = false;
-    int  n;
 
-    for (n = firstActionToCheck; ((n <= lastActionToCheck) && (!success)); n++)
+    // The actions of an input are sorted, so this tests the same bindings
+    // in the same order as testing all actions in the range.
+    for (unsigned int i = 0; i < it->second.size() && !success; i++)
     {
-        if ((m_bindings[n].getType() == type) && (m_bindings[n].getId() == id))
-        {
+        const int n = it->second[i];
+        if (n < firstActionToCheck || n > lastActionToCheck)
+            continue;
 
-            if (type == Input::IT_STICKMOTION)
+        if (type == Input::IT_STICKMOTION)
+        {
+            if(m_bindings[n].getRange() == Input::AR_HALF)
             {
-                if(m_bindings[n].getRange() == Input::AR_HALF)
-                {
-                    if ( ((m_bindings[n].getDirection() == Input::AD_POSITIVE)
-                           && (*value > 0))                                      ||
-                         ((m_bindings[n].getDirection() == Input::AD_NEGATIVE)
-                           && (*value < 0))                                        )
-                    {
-                        success = true;
-                       *action = (PlayerAction)n;
-                    }
-                }
-                else
+                if ( ((m_bindings[n].getDirection() == Input::AD_POSITIVE)
+                       && (*value > 0))                                      ||
+                     ((m_bindings[n].getDirection() == Input::AD_NEGATIVE)
+                       && (*value < 0))                                        )
                 {
-                    if ( ((m_bindings[n].getDirection() == Input::AD_POSITIVE)
-                           && (*value != -Input::MAX_VALUE))                     ||
-                         ((m_bindings[n].getDirection() == Input::AD_NEGATIVE)
-                           && (*value != Input::MAX_VALUE))                        )
-                    {
-                        success = true;
-                        *action = (PlayerAction)n;
-                        if(m_bindings[n].getDirection() == Input::AD_NEGATIVE)
-                            *value = -*value;
-                        *value = (*value + Input::MAX_VALUE) / 2;
-                    }
+                    success = true;
+                   *action = (PlayerAction)n;
                 }
             }
             else
             {
-                success = true;
-               *action = (PlayerAction)n;
+                if ( ((m_bindings[n].getDirection() == Input::AD_POSITIVE)
+                       && (*value != -Input::MAX_VALUE))                     ||
+                     ((m_bindings[n].getDirection() == Input::AD_NEGATIVE)
+                       && (*value != Input::MAX_VALUE))                        )
+                {
+                    success = true;
+                    *action = (PlayerAction)n;
+                    if(m_bindings[n].getDirection() == Input::AD_NEGATIVE)
+                        *value = -*value;
+                    *value = (*value + Input::MAX_VALUE) / 2;
+                }
             }
         }
+        else
+        {
+            success = true;
+           *action = (PlayerAction)n;
+        }
     } // end for n
 
     return success;
@@ -343,6 +367,7 @@ bool DeviceConfig::load(const XMLNode *config)
             error=true;
         }
     }   // for i in nodes
+    m_actions_for_input_valid = false;
     return !error;
 }   // load
 
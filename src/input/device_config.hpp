@@ -27,6 +27,8 @@
 #include <iosfwd>
 #include <irrString.h>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 /**
   * \ingroup config
@@ -52,6 +54,20 @@ private:
     /** Name of this configuratiom. */
     std::string m_name;
 
+    /** The actions bound to each input (see getInputKey) in increasing
+     *  order, so that an input can be mapped without testing all
+     *  bindings. Built on first use after the bindings changed. */
+    std::unordered_map<int, std::vector<PlayerAction> > m_actions_for_input;
+    bool m_actions_for_input_valid;
+
+    void updateActionsForInput();
+    // ------------------------------------------------------------------------
+    /** Combines the type and id of an input into a key. */
+    static int getInputKey(Input::InputType type, int id)
+    {
+        return id * (Input::IT_LAST + 1) + type;
+    }   // getInputKey
+
 protected:
 
     Binding  m_bindings[PA_COUNT];
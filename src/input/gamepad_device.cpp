@@ -23,6 +23,8 @@
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/player_controller.hpp"
 
+#include <climits>
+
 /** Constructor for GamePadDevice from a connected gamepad for which no
  *  configuration existed (defaults will be used)
  *  \param irrIndex Index of stick as given by irrLicht.
@@ -59,6 +61,7 @@ GamePadDevice::GamePadDevice(const int irr_index, const std::string &name,
 
     for(int n=0; n<SEvent::SJoystickEvent::NUMBER_OF_BUTTONS; n++)
         m_buttonPressed[n] = false;
+    resetReportedAxes();
 }   // GamePadDevice
 
 // ----------------------------------------------------------------------------
@@ -81,6 +84,31 @@ bool GamePadDevice::moved(int value) const
     return abs(value) > dz;
 }   // moved
 
+// ----------------------------------------------------------------------------
+/** Stores the value irrlicht reported for an axis, and returns if it differs
+ *  from the previously reported one.
+ *  \param axis Index of the axis, or Input::HAT_H_ID/HAT_V_ID for the hat.
+ */
+bool GamePadDevice::axisChanged(int axis, int value)
+{
+    const int n = SEvent::SJoystickEvent::NUMBER_OF_AXES;
+    const int index = axis == Input::HAT_H_ID ? n
+                    : axis == Input::HAT_V_ID ? n + 1 : axis;
+    if (m_reported_axis_value[index] == value)
+        return false;
+    m_reported_axis_value[index] = value;
+    return true;
+}   // axisChanged
+
+// ----------------------------------------------------------------------------
+/** Forgets the reported axis values, so that the next value of each axis is
+ *  dispatched even if it didn't change. */
+void GamePadDevice::resetReportedAxes()
+{
+    for (int i = 0; i < SEvent::SJoystickEvent::NUMBER_OF_AXES + 2; i++)
+        m_reported_axis_value[i] = INT_MIN;
+}   // resetReportedAxes
+
 // ----------------------------------------------------------------------------
 /** Returns the number of buttons of this gamepad. */
 int GamePadDevice::getNumberOfButtons() const
@@ -51,6 +51,11 @@ class GamePadDevice : public InputDevice
     /** Irrlicht index of this gamepad. */
     int                   m_irr_index;
 
+    /** Last value irrlicht reported for each axis, followed by the
+     *  horizontal and vertical hat. Irrlicht reports all axes in each
+     *  event, this is used to only dispatch the ones that changed. */
+    int m_reported_axis_value[SEvent::SJoystickEvent::NUMBER_OF_AXES + 2];
+
 public:
              GamePadDevice(const int irrIndex, const std::string &name,
                            const int axis_number,
@@ -66,6 +71,8 @@ public:
                                     ) OVERRIDE;
     int getNumberOfButtons() const;
     bool moved(int value) const;
+    bool axisChanged(int axis, int value);
+    void resetReportedAxes();
 
     // ------------------------------------------------------------------------
     /** Returns the irrlicht index of this gamepad. */
@@ -87,6 +87,17 @@ void InputManager::update(float dt)
     }
 }
 
+// -----------------------------------------------------------------------------
+/** Makes the next event of each gamepad dispatch all its axes, even the ones
+ *  that didn't change. Called when the karts were reset, so that a stick
+ *  held since before is applied again.
+ */
+void InputManager::resetReportedAxes()
+{
+    for (int i = 0; i < m_device_manager->getGamePadAmount(); i++)
+        m_device_manager->getGamePad(i)->resetReportedAxes();
+}   // resetReportedAxes
+
 //-----------------------------------------------------------------------------
 /** Destructor. Frees all data structures.
  */
@@ -834,12 +845,24 @@ EventPropagation InputManager::input(const SEvent& event)
 {
     if (event.EventType == EET_JOYSTICK_INPUT_EVENT)
     {
+        GamePadDevice* gp =
+            getDeviceManager()->getGamePadFromIrrID(event.JoystickEvent.Joystick);
+
+        // Each event contains all axes of the gamepad. In game only the
+        // ones that changed are dispatched, which avoids mapping and
+        // applying (and in network games sending) the same value again.
+        // Menus rely on repeated values to keep scrolling while a stick is
+        // held.
+        const bool only_changed_axes = gp && m_mode == INGAME;
+
         // Axes - FIXME, instead of checking all of them, ask the bindings
         // which ones to poll
         for (int axis_id=0; axis_id<SEvent::SJoystickEvent::NUMBER_OF_AXES ;
               axis_id++)
         {
             int value = event.JoystickEvent.Axis[axis_id];
+            if (only_changed_axes && !gp->axisChanged(axis_id, value))
+                continue;
 
             if (UserConfigParams::m_gamepad_debug)
             {
@@ -852,28 +875,21 @@ EventPropagation InputManager::input(const SEvent& event)
                           axis_id, Input::AD_NEUTRAL, value);
         }
 
-        if (event.JoystickEvent.POV == 65535)
-        {
-            dispatchInput(Input::IT_STICKMOTION, event.JoystickEvent.Joystick,
-                          Input::HAT_H_ID, Input::AD_NEUTRAL, 0);
-            dispatchInput(Input::IT_STICKMOTION, event.JoystickEvent.Joystick,
-                          Input::HAT_V_ID, Input::AD_NEUTRAL, 0);
-        }
-        else
+        int hat_h = 0, hat_v = 0;
+        if (event.JoystickEvent.POV != 65535)
         {
             // *0.017453925f is to convert degrees to radians
+            hat_h = (int)(cos(event.JoystickEvent.POV*0.017453925f/100.0f)
+                          *Input::MAX_VALUE);
+            hat_v = (int)(sin(event.JoystickEvent.POV*0.017453925f/100.0f)
+                          *Input::MAX_VALUE);
+        }
+        if (!only_changed_axes || gp->axisChanged(Input::HAT_H_ID, hat_h))
             dispatchInput(Input::IT_STICKMOTION, event.JoystickEvent.Joystick,
-                          Input::HAT_H_ID, Input::AD_NEUTRAL,
-                          (int)(cos(event.JoystickEvent.POV*0.017453925f/100.0f)
-                                *Input::MAX_VALUE));
+                          Input::HAT_H_ID, Input::AD_NEUTRAL, hat_h);
+        if (!only_changed_axes || gp->axisChanged(Input::HAT_V_ID, hat_v))
             dispatchInput(Input::IT_STICKMOTION, event.JoystickEvent.Joystick,
-                          Input::HAT_V_ID, Input::AD_NEUTRAL,
-                          (int)(sin(event.JoystickEvent.POV*0.017453925f/100.0f)
-                                *Input::MAX_VALUE));
-        }
-
-        GamePadDevice* gp =
-            getDeviceManager()->getGamePadFromIrrID(event.JoystickEvent.Joystick);
+                          Input::HAT_V_ID, Input::AD_NEUTRAL, hat_v);
 
         if (gp == NULL)
         {
@@ -1214,6 +1230,7 @@ void InputManager::setMode(InputDriverMode new_mode)
 
             //irr_driver->hidePointer();
 
+            resetReportedAxes();
             m_mode = INGAME;
 
             break;
@@ -97,6 +97,7 @@ public:
     bool    masterPlayerOnly() const;
 
     void   update(float dt);
+    void   resetReportedAxes();
 
     /** Returns the ID of the player that plays with the keyboard,
      *  or -1 if none. */
@@ -64,13 +64,14 @@ Wiimote::~Wiimote()
 // -----------------------------------------------------------------------------
 void Wiimote::resetIrrEvent()
 {
-    irr::SEvent &event = m_irr_event.getData();
+    irr::SEvent &event = m_irr_event;
     event.EventType = irr::EET_JOYSTICK_INPUT_EVENT;
     for(int i=0 ; i < irr::SEvent::SJoystickEvent::NUMBER_OF_AXES ; i++)
         event.JoystickEvent.Axis[i] = 0;
     event.JoystickEvent.Joystick = getIrrId();
     event.JoystickEvent.POV = 65535;
     event.JoystickEvent.ButtonStates = 0;
+    m_event_pending = false;
 }   // resetIrrEvent
 
 // -----------------------------------------------------------------------------
@@ -112,20 +113,22 @@ void Wiimote::update()
 
     const float angle = normalized_angle_2 * JOYSTICK_ABS_MAX_ANGLE;
 
-    m_irr_event.lock();
-    {
-
-        irr::SEvent::SJoystickEvent &ev = m_irr_event.getData().JoystickEvent;
-        ev.Axis[SEvent::SJoystickEvent::AXIS_X] =
+    irr::SEvent::SJoystickEvent &ev = m_irr_event.JoystickEvent;
+    const irr::s16 axis =
                  (irr::s16)(irr::core::clamp(angle, -JOYSTICK_ABS_MAX_ANGLE,
                                                     +JOYSTICK_ABS_MAX_ANGLE));
-        // --------------------- Wiimote buttons --------------------
-        // Copy the wiimote button structure, but mask out the non-button
-        // bits (4 bits of the button structure are actually bits for the
-        // accelerator).
-        ev.ButtonStates = m_wiimote_handle->btns & WIIMOTE_BUTTON_ALL;
+    // --------------------- Wiimote buttons --------------------
+    // Copy the wiimote button structure, but mask out the non-button
+    // bits (4 bits of the button structure are actually bits for the
+    // accelerator).
+    const irr::u32 buttons = m_wiimote_handle->btns & WIIMOTE_BUTTON_ALL;
+    if (ev.Axis[SEvent::SJoystickEvent::AXIS_X] != axis ||
+        ev.ButtonStates != buttons)
+    {
+        ev.Axis[SEvent::SJoystickEvent::AXIS_X] = axis;
+        ev.ButtonStates = buttons;
+        m_event_pending = true;
     }
-    m_irr_event.unlock();
 
 #ifdef DEBUG
     if(UserConfigParams::m_wiimote_debug)
@@ -172,12 +175,5 @@ void Wiimote::printDebugInfo() const
     }   // for i < count
 }   // printDebugInfo
 
-// ----------------------------------------------------------------------------
-/** Thread-safe reading of the last updated event
- */
-irr::SEvent Wiimote::getIrrEvent()
-{
-    return m_irr_event.getAtomic();
-}   // getIrrEvent
 
 #endif // ENABLE_WIIUSE
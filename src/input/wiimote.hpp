@@ -21,8 +21,6 @@
 
 #ifdef ENABLE_WIIUSE
 
-#include "utils/synchronised.hpp"
-
 #include "IEventReceiver.h"
 
 struct wiimote_t;
@@ -46,8 +44,13 @@ private:
     /** Corresponding gamepad managed by the DeviceManager */
     GamePadDevice*  m_gamepad_device;
 
-    /** Corresponding Irrlicht gamepad event */
-    Synchronised<irr::SEvent> m_irr_event;
+    /** Corresponding Irrlicht gamepad event. Only used by the update thread,
+     *  the main thread receives copies through the event queue of the
+     *  wiimote manager. */
+    irr::SEvent     m_irr_event;
+
+    /** True if the event changed since it was last queued. */
+    bool            m_event_pending;
 
     /** Whether the wiimote received a "disconnected" event */
     bool            m_connected;
@@ -64,7 +67,16 @@ public:
     /** To be called when the wiimote becomes unused */
     void        cleanup();
     void        update();
-    irr::SEvent getIrrEvent();
+
+    // -----------------------------------------------------------------------------
+    /** Returns the last updated event, only to be used in the update thread. */
+    const irr::SEvent& getIrrEvent() const { return m_irr_event; }
+    // -----------------------------------------------------------------------------
+    /** Returns true if the event changed and still has to be queued. */
+    bool isEventPending() const { return m_event_pending; }
+    // -----------------------------------------------------------------------------
+    /** Called once the event was queued for the main thread. */
+    void setEventQueued() { m_event_pending = false; }
 
     // -----------------------------------------------------------------------------
     /** Returns the wiiuse handle of this wiimote. */
@@ -33,6 +33,10 @@
 
 #include "wiiuse.h"
 
+#ifdef WIIUSE_BLUEZ
+#  include <sys/select.h>
+#endif
+
 WiimoteManager*  wiimote_manager;
 
 
@@ -44,6 +48,7 @@ static const int    WIIMOTE_START_IRR_ID   = 32;
 WiimoteManager::WiimoteManager()
 {
     m_all_wiimote_handles = NULL;
+    m_rumble_end_time     = 0.0;
 #ifdef WIIMOTE_THREADING
     m_shut = false;
 #endif
@@ -179,7 +184,8 @@ void WiimoteManager::launchDetection(int timeout)
     } // end for
 
     // ---------------------------------------------------
-    // Set the LEDs and rumble for 0.2s
+    // Set the LEDs and rumble for 0.2s. The update thread stops the
+    // rumble, so that detection doesn't have to wait for it.
     int leds[] = {WIIMOTE_LED_1, WIIMOTE_LED_2, WIIMOTE_LED_3, WIIMOTE_LED_4};
     for(unsigned int i=0 ; i < m_wiimotes.size(); i++)
     {
@@ -187,14 +193,7 @@ void WiimoteManager::launchDetection(int timeout)
         wiiuse_set_leds(wiimote_handle, leds[i]);
         wiiuse_rumble(wiimote_handle, 1);
     }
-
-    StkTime::sleep(200);
-
-    for(unsigned int i=0 ; i < m_wiimotes.size(); i++)
-    {
-        wiimote_t*  wiimote_handle = m_wiimotes[i]->getWiimoteHandle();
-        wiiuse_rumble(wiimote_handle, 0);
-    }
+    m_rumble_end_time = StkTime::getRealTime() + 0.2;
 
     // TODO: only enable accelerometer during race
     enableAccelerometer(true);
@@ -267,6 +266,10 @@ void WiimoteManager::cleanup()
 #endif
         // Cleanup WiiUse
         wiiuse_cleanup(m_all_wiimote_handles, MAX_WIIMOTES);
+
+        // Drop the events of the removed gamepads
+        irr::SEvent event;
+        while (m_events.pop(&event)) {}
     }
 
     for(unsigned int i=0; i<m_wiimotes.size(); i++)
@@ -275,6 +278,7 @@ void WiimoteManager::cleanup()
 
     // Reset
     m_all_wiimote_handles = NULL;
+    m_rumble_end_time     = 0.0;
 #ifdef WIIMOTE_THREADING
     m_shut                = false;
 #endif
@@ -286,11 +290,9 @@ void WiimoteManager::update()
 #ifndef WIIMOTE_THREADING
     threadFunc();
 #endif
-    for(unsigned int i=0 ; i < m_wiimotes.size(); i++)
-    {
-        irr::SEvent event = m_wiimotes[i]->getIrrEvent();
+    irr::SEvent event;
+    while (m_events.pop(&event))
         input_manager->input(event);
-    }
 }   // update
 
 // ----------------------------------------------------------------------------
@@ -305,6 +307,53 @@ void WiimoteManager::enableAccelerometer(bool state)
     }
 }   // enableAccelerometer
 
+// ----------------------------------------------------------------------------
+/** Blocks until one of the connected wiimotes sent data, or the timeout
+ *  expired. On Linux this waits on the bluetooth sockets. On Windows
+ *  wiiuse_poll already waits for the data of each wiimote, and on other
+ *  systems the thread just sleeps.
+ *  \param timeout Maximum time to wait in ms. The timeout keeps the pending
+ *         writes of wiiuse going, and lets the thread notice when it should
+ *         shut down.
+ */
+void WiimoteManager::waitForInput(int timeout)
+{
+#if defined(WIIUSE_BLUEZ)
+    fd_set fds;
+    FD_ZERO(&fds);
+    int highest_fd = -1;
+    for (unsigned int i = 0; i < m_wiimotes.size(); i++)
+    {
+        if (!WIIMOTE_IS_CONNECTED(m_all_wiimote_handles[i]))
+            continue;
+        FD_SET(m_all_wiimote_handles[i]->in_sock, &fds);
+        if (m_all_wiimote_handles[i]->in_sock > highest_fd)
+            highest_fd = m_all_wiimote_handles[i]->in_sock;
+    }
+    struct timeval tv;
+    tv.tv_sec  = 0;
+    tv.tv_usec = timeout * 1000;
+    select(highest_fd + 1, highest_fd >= 0 ? &fds : NULL, NULL, NULL, &tv);
+#elif !defined(WIIUSE_WIN32)
+    StkTime::sleep(1);
+#endif
+}   // waitForInput
+
+// ----------------------------------------------------------------------------
+/** Pushes the changed events of the wiimotes into the queue read by the main
+ *  thread. If the queue is full the event stays pending and is pushed again
+ *  with the next update, so the last state of a wiimote is never lost.
+ */
+void WiimoteManager::queueEvents()
+{
+    for (unsigned int i = 0; i < m_wiimotes.size(); i++)
+    {
+        if (m_wiimotes[i]->isEventPending() &&
+            m_events.push(m_wiimotes[i]->getIrrEvent()))
+            m_wiimotes[i]->setEventQueued();
+    }
+}   // queueEvents
+
 // ----------------------------------------------------------------------------
 /** Thread update method - wiimotes state is updated in another thread to
  *  avoid latency problems */
@@ -314,6 +363,17 @@ void WiimoteManager::threadFunc()
     while(!m_shut)
 #endif
     {
+#ifdef WIIMOTE_THREADING
+        waitForInput(10);
+#endif
+        if (m_rumble_end_time > 0.0 &&
+            StkTime::getRealTime() > m_rumble_end_time)
+        {
+            for (unsigned int i = 0; i < m_wiimotes.size(); i++)
+                wiiuse_rumble(m_wiimotes[i]->getWiimoteHandle(), 0);
+            m_rumble_end_time = 0.0;
+        }
+
         if(wiiuse_poll(m_all_wiimote_handles, MAX_WIIMOTES))
         {
             for (unsigned int i=0; i < m_wiimotes.size(); ++i)
@@ -362,7 +422,7 @@ void WiimoteManager::threadFunc()
             }
         }
 
-        StkTime::sleep(1);  // 'cause come on, the whole CPU is not ours :)
+        queueEvents();
     } // end while
 }   // threadFunc
 
@@ -24,6 +24,7 @@
 #include "input/wiimote.hpp"
 #include "states_screens/dialogs/message_dialog.hpp"
 #include "utils/cpp2011.hpp"
+#include "utils/lock_free_queue.hpp"
 
 #include "IEventReceiver.h"
 
@@ -63,12 +64,22 @@ private:
     bool            m_shut;
 #endif
 
+    /** Events of the wiimotes, pushed by the update thread whenever the
+     *  state of a wiimote changes, and passed on to the input manager in
+     *  update(). */
+    LockFreeQueue<irr::SEvent, 256> m_events;
+
+    /** Time at which the rumble started when connecting stops, or 0. */
+    double          m_rumble_end_time;
+
     /** True if wii is enabled via command line option. */
     static bool     m_enabled;
 
     /** Wiimotes update thread */
     void threadFunc();
     static void* threadFuncWrapper(void* data);
+    void            waitForInput(int timeout);
+    void            queueEvents();
     void            setWiimoteBindings(GamepadConfig* gamepad_config);
 
 public:
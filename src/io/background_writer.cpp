@@ -0,0 +1,182 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "io/background_writer.hpp"
+
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <assert.h>
+#include <stdio.h>
+
+BackgroundWriter *BackgroundWriter::m_background_writer = NULL;
+
+// ----------------------------------------------------------------------------
+void BackgroundWriter::create()
+{
+    assert(!m_background_writer);
+    m_background_writer = new BackgroundWriter();
+}   // create
+
+// ----------------------------------------------------------------------------
+/** Writes all queued files and stops the writer thread.
+ */
+void BackgroundWriter::destroy()
+{
+    delete m_background_writer;
+    m_background_writer = NULL;
+}   // destroy
+
+// ----------------------------------------------------------------------------
+BackgroundWriter::BackgroundWriter()
+{
+    m_quit = false;
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_queued_cond, NULL);
+    m_thread_started = pthread_create(&m_thread, NULL,
+                                      &BackgroundWriter::mainLoop, this) == 0;
+    if (!m_thread_started)
+        Log::warn("BackgroundWriter",
+                  "Could not create writer thread, saving synchronously.");
+}   // BackgroundWriter
+
+// ----------------------------------------------------------------------------
+BackgroundWriter::~BackgroundWriter()
+{
+    if (m_thread_started)
+    {
+        pthread_mutex_lock(&m_mutex);
+        m_quit = true;
+        pthread_cond_signal(&m_queued_cond);
+        pthread_mutex_unlock(&m_mutex);
+        pthread_join(m_thread, NULL);
+    }
+    pthread_cond_destroy(&m_queued_cond);
+    pthread_mutex_destroy(&m_mutex);
+}   // ~BackgroundWriter
+
+// ----------------------------------------------------------------------------
+/** Queues a file to be written. If the file is already queued, its content
+ *  is replaced. The file is written immediately if there is no writer
+ *  thread (e.g. before the writer is created or after it is destroyed).
+ *  \param filename Name of the file to write.
+ *  \param data The content of the file, which is taken over (the string
+ *         is empty afterwards).
+ */
+void BackgroundWriter::write(const std::string &filename, std::string *data)
+{
+    BackgroundWriter *writer = m_background_writer;
+    if (!writer || !writer->m_thread_started)
+    {
+        writeFile(filename, *data);
+        data->clear();
+        return;
+    }
+
+    pthread_mutex_lock(&writer->m_mutex);
+    Job *job = NULL;
+    for (unsigned int i = 0; i < writer->m_jobs.size(); i++)
+    {
+        if (writer->m_jobs[i].m_filename == filename)
+        {
+            job = &writer->m_jobs[i];
+            break;
+        }
+    }
+    if (!job)
+    {
+        writer->m_jobs.push_back(Job());
+        job = &writer->m_jobs.back();
+        job->m_filename = filename;
+    }
+    job->m_data.swap(*data);
+    data->clear();
+    pthread_cond_signal(&writer->m_queued_cond);
+    pthread_mutex_unlock(&writer->m_mutex);
+}   // write
+
+// ----------------------------------------------------------------------------
+/** Waits for jobs, and writes all jobs queued in DEBOUNCE_TIME at once.
+ */
+void *BackgroundWriter::mainLoop(void *obj)
+{
+    BackgroundWriter *writer = (BackgroundWriter*)obj;
+    pthread_mutex_lock(&writer->m_mutex);
+    while (true)
+    {
+        while (writer->m_jobs.empty() && !writer->m_quit)
+            pthread_cond_wait(&writer->m_queued_cond, &writer->m_mutex);
+        if (writer->m_jobs.empty())
+            break;
+
+        if (!writer->m_quit)
+        {
+            // Give the main thread the chance to save the same files again
+            pthread_mutex_unlock(&writer->m_mutex);
+            StkTime::sleep(DEBOUNCE_TIME);
+            pthread_mutex_lock(&writer->m_mutex);
+        }
+        std::vector<Job> jobs;
+        jobs.swap(writer->m_jobs);
+        pthread_mutex_unlock(&writer->m_mutex);
+
+        for (unsigned int i = 0; i < jobs.size(); i++)
+            writeFile(jobs[i].m_filename, jobs[i].m_data);
+
+        pthread_mutex_lock(&writer->m_mutex);
+    }
+    pthread_mutex_unlock(&writer->m_mutex);
+    return NULL;
+}   // mainLoop
+
+// ----------------------------------------------------------------------------
+/** Writes the data to a temporary file, which then replaces the file.
+ *  \return False if the file could not be written.
+ */
+bool BackgroundWriter::writeFile(const std::string &filename,
+                                 const std::string &data)
+{
+    const std::string tmp_filename = filename + ".new";
+    FILE *fd = fopen(tmp_filename.c_str(), "wb");
+    if (!fd)
+    {
+        Log::error("BackgroundWriter", "Could not open '%s' for writing.",
+                   tmp_filename.c_str());
+        return false;
+    }
+    const bool ok = fwrite(data.c_str(), 1, data.size(), fd) == data.size();
+    if (fclose(fd) != 0 || !ok)
+    {
+        Log::error("BackgroundWriter", "Could not write '%s'.",
+                   tmp_filename.c_str());
+        remove(tmp_filename.c_str());
+        return false;
+    }
+
+    // rename does not replace an existing file on windows
+#ifdef WIN32
+    remove(filename.c_str());
+#endif
+    if (rename(tmp_filename.c_str(), filename.c_str()) != 0)
+    {
+        Log::error("BackgroundWriter", "Could not rename '%s' to '%s'.",
+                   tmp_filename.c_str(), filename.c_str());
+        return false;
+    }
+    return true;
+}   // writeFile
@@ -0,0 +1,75 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_BACKGROUND_WRITER_HPP
+#define HEADER_BACKGROUND_WRITER_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+/** Writes files from a separate thread, so that saving the config and the
+ *  player data doesn't make the main thread wait for the disk. The main
+ *  thread creates the complete file content in memory and hands it to the
+ *  writer. The writer waits a little before writing, and if the same file
+ *  is written again in the meantime only the last content is written. Each
+ *  file is written to a temporary file first, which then replaces the
+ *  original file, so that a crash can't leave a half written file behind.
+ *  \ingroup io
+ */
+class BackgroundWriter : public NoCopy
+{
+private:
+    static BackgroundWriter *m_background_writer;
+
+    /** Time in milliseconds the writer waits for more writes of the same
+     *  files before writing. */
+    static const int DEBOUNCE_TIME = 250;
+
+    struct Job
+    {
+        std::string m_filename;
+        std::string m_data;
+    };   // Job
+
+    /** The files to write, at most one job per file. */
+    std::vector<Job> m_jobs;
+
+    /** Protects m_jobs and m_quit. */
+    pthread_mutex_t  m_mutex;
+    /** Signalled when a job is queued or the writer is destroyed. */
+    pthread_cond_t   m_queued_cond;
+    pthread_t        m_thread;
+    bool             m_thread_started;
+    bool             m_quit;
+
+                 BackgroundWriter();
+                ~BackgroundWriter();
+    static void *mainLoop(void *obj);
+    static bool  writeFile(const std::string &filename,
+                           const std::string &data);
+
+public:
+    static void create();
+    static void destroy();
+    static void write(const std::string &filename, std::string *data);
+};   // BackgroundWriter
+
+#endif
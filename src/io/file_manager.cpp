@@ -23,6 +23,7 @@
 #include "config/user_config.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/material_manager.hpp"
+#include "io/packed_archive.hpp"
 #include "karts/kart_properties_manager.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/command_line.hpp"
@@ -113,6 +114,7 @@ FileManager* file_manager = 0;
  */
 FileManager::FileManager()
 {
+    pthread_mutex_init(&m_directory_index_mutex, NULL);
     m_subdir_name.resize(ASSET_COUNT);
     m_subdir_name[CHALLENGE  ] = "challenges";
     m_subdir_name[FONT       ] = "fonts";
@@ -196,11 +198,19 @@ FileManager::FileManager()
         addRootDirs(root_dir+"../../supertuxkart-assets");
     if ( getenv ( "SUPERTUXKART_ROOT_PATH" ) != NULL )
         addRootDirs(getenv("SUPERTUXKART_ROOT_PATH"));
+    for(unsigned int i=0; i<m_root_dirs.size(); i++)
+        mountPackedArchives(m_root_dirs[i]);
 
     checkAndCreateConfigDir();
     checkAndCreateAddonsDir();
     checkAndCreateScreenshotDir();
     checkAndCreateCachedTexturesDir();
+    checkAndCreateCachedBvhDir();
+    checkAndCreateCachedMeshesDir();
+    checkAndCreateCachedShadersDir();
+    checkAndCreateCachedSfxDir();
+    checkAndCreateCachedScriptsDir();
+    checkAndCreateCachedTranslationsDir();
     checkAndCreateGPDir();
 
     redirectOutput();
@@ -358,15 +368,57 @@ FileManager::~FileManager()
     popModelSearchPath();
     popTextureSearchPath();
     popTextureSearchPath();
+    for(unsigned int i=0; i<m_packed_archives.size(); i++)
+        m_packed_archives[i]->drop();
+    m_packed_archives.clear();
     m_file_system->drop();
     m_file_system = NULL;
+    pthread_mutex_destroy(&m_directory_index_mutex);
 }   // ~FileManager
 
+// ----------------------------------------------------------------------------
+/** Mounts all packs (.stkpack files) in a directory, see PackedArchive.
+ *  \param dir The directory, ending with '/'.
+ */
+void FileManager::mountPackedArchives(const std::string &dir)
+{
+    DirectoryIndex index;
+    listDirectory(dir, &index);
+    for(std::unordered_set<std::string>::const_iterator
+        i = index.m_entries.begin(); i != index.m_entries.end(); i++)
+    {
+        if(StringUtils::getExtension(*i) != "stkpack")
+            continue;
+        PackedArchive *archive = PackedArchive::open(m_file_system, dir+*i);
+        if(!archive)
+            continue;
+        // The file system drops its archives without having grabbed them
+        archive->grab();
+        m_file_system->addFileArchive(archive);
+        m_packed_archives.push_back(archive);
+    }
+}   // mountPackedArchives
+
+// ----------------------------------------------------------------------------
+/** Returns true if a file or directory is contained in a mounted pack.
+ */
+bool FileManager::packedFileExists(const std::string &path) const
+{
+    for(unsigned int i=0; i<m_packed_archives.size(); i++)
+    {
+        if(m_packed_archives[i]->exists(path))
+            return true;
+    }
+    return false;
+}   // packedFileExists
+
 // ----------------------------------------------------------------------------
 /** Returns true if the specified file exists.
  */
 bool FileManager::fileExists(const std::string& path) const
 {
+    if(!m_packed_archives.empty() && packedFileExists(path))
+        return true;
 #ifdef DEBUG
     bool exists = m_file_system->existFile(path.c_str());
     if(exists) return true;
@@ -571,12 +623,152 @@ bool FileManager::findFile(std::string& full_path,
         i != search_path.rend(); ++i)
     {
         full_path = *i + file_name;
+#ifdef ANDROID
+        // Assets are not in real directories
         if(m_file_system->existFile(full_path.c_str())) return true;
+#else
+        if(indexedFileExists(full_path)) return true;
+#endif
     }
     full_path="";
     return false;
 }   // findFile
 
+//-----------------------------------------------------------------------------
+/** Returns the name a directory entry is stored with in a DirectoryIndex,
+ *  which is lower case on case insensitive file systems.
+ */
+static std::string getIndexName(const std::string &name)
+{
+#if defined(WIN32) || defined(__APPLE__)
+    return StringUtils::toLowerCase(name);
+#else
+    return name;
+#endif
+}   // getIndexName
+
+//-----------------------------------------------------------------------------
+/** Splits a path into the directory (including the trailing '/') and the
+ *  name of the entry.
+ */
+static void splitDirectory(const std::string &path, std::string *dir,
+                           std::string *name)
+{
+    const size_t slash = path.find_last_of("/\\");
+    if (slash == std::string::npos)
+    {
+        *dir  = "";
+        *name = path;
+    }
+    else
+    {
+        *dir  = path.substr(0, slash + 1);
+        *name = path.substr(slash + 1);
+    }
+}   // splitDirectory
+
+//-----------------------------------------------------------------------------
+/** Lists all entries of a directory into an index.
+ *  \param dir The directory, "" for the current directory.
+ */
+void FileManager::listDirectory(const std::string &dir,
+                                DirectoryIndex *index) const
+{
+    index->m_entries.clear();
+    index->m_mtime = 0;
+    index->m_listed_at = index->m_checked_at = time(NULL);
+
+    std::string path = dir.empty() ? "." : dir;
+    // stat fails on windows if there is a '/' at the end of the path
+    if (path.size() > 1 && (path[path.size()-1] == '/' ||
+                            path[path.size()-1] == '\\'))
+        path.erase(path.size() - 1);
+    struct stat mystat;
+    if (stat(path.c_str(), &mystat) < 0 || !S_ISDIR(mystat.st_mode))
+        return;
+    index->m_mtime = mystat.st_mtime;
+
+#if defined(WIN32)
+    WIN32_FIND_DATAA data;
+    HANDLE handle = FindFirstFileA((path + "/*").c_str(), &data);
+    if (handle == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        index->m_entries.insert(getIndexName(data.cFileName));
+    } while (FindNextFileA(handle, &data));
+    FindClose(handle);
+#else
+    DIR *d = opendir(path.c_str());
+    if (!d)
+        return;
+    while (struct dirent *entry = readdir(d))
+        index->m_entries.insert(getIndexName(entry->d_name));
+    closedir(d);
+#endif
+}   // listDirectory
+
+//-----------------------------------------------------------------------------
+/** Tests if a file or directory exists using the index of its directory.
+ *  A directory is listed the first time a file in it is searched. Its
+ *  modification time is checked at most once per second, and it is listed
+ *  again if it changed, so that files added by other programs are found.
+ *  \param path Path of the file.
+ */
+bool FileManager::indexedFileExists(const std::string &path) const
+{
+    std::string dir, name;
+    splitDirectory(path, &dir, &name);
+    if (name.empty())
+        return m_file_system->existFile(path.c_str());
+
+    pthread_mutex_lock(&m_directory_index_mutex);
+    const time_t now = time(NULL);
+    std::unordered_map<std::string, DirectoryIndex>::iterator i =
+        m_directory_index.find(dir);
+    if (i == m_directory_index.end())
+    {
+        i = m_directory_index.insert(std::make_pair(dir,
+                                                    DirectoryIndex())).first;
+        listDirectory(dir, &i->second);
+    }
+    else if (i->second.m_checked_at != now)
+    {
+        i->second.m_checked_at = now;
+        std::string stat_path = dir.empty() ? "." : dir;
+        if (stat_path.size() > 1)
+            stat_path.erase(stat_path.size() - 1);
+        struct stat mystat;
+        const time_t mtime = stat(stat_path.c_str(), &mystat) < 0
+                           ? 0 : mystat.st_mtime;
+        // A directory changed in the second it was listed in might have
+        // the same mtime after further changes, so list it again
+        if (mtime != i->second.m_mtime || mtime >= i->second.m_listed_at)
+            listDirectory(dir, &i->second);
+    }
+    const bool exists = i->second.m_entries.count(getIndexName(name)) > 0;
+    pthread_mutex_unlock(&m_directory_index_mutex);
+    return exists || (!m_packed_archives.empty() && packedFileExists(path));
+}   // indexedFileExists
+
+//-----------------------------------------------------------------------------
+/** Removes the index of the directory a file is in, after the file was
+ *  created or removed.
+ *  \param path Path of the file.
+ */
+void FileManager::invalidateDirectoryIndex(const std::string &path) const
+{
+    std::string dir, name;
+    std::string p = path;
+    // For a directory, remove the index of its parent
+    while (p.size() > 1 && (p[p.size()-1] == '/' || p[p.size()-1] == '\\'))
+        p.erase(p.size() - 1);
+    splitDirectory(p, &dir, &name);
+    pthread_mutex_lock(&m_directory_index_mutex);
+    m_directory_index.erase(dir);
+    pthread_mutex_unlock(&m_directory_index_mutex);
+}   // invalidateDirectoryIndex
+
 //-----------------------------------------------------------------------------
 std::string FileManager::getAssetChecked(FileManager::AssetType type,
                                          const std::string& name,
@@ -636,6 +828,54 @@ std::string FileManager::getCachedTexturesDir() const
     return m_cached_textures_dir;
 }   // getCachedTexturesDir
 
+//-----------------------------------------------------------------------------
+/** Returns the directory in which the collision BVHs of tracks are cached.
+*/
+std::string FileManager::getCachedBvhDir() const
+{
+    return m_cached_bvh_dir;
+}   // getCachedBvhDir
+
+//-----------------------------------------------------------------------------
+/** Returns the directory in which processed meshes are cached.
+*/
+std::string FileManager::getCachedMeshesDir() const
+{
+    return m_cached_meshes_dir;
+}   // getCachedMeshesDir
+
+//-----------------------------------------------------------------------------
+/** Returns the directory in which linked shader program binaries are cached.
+*/
+std::string FileManager::getCachedShadersDir() const
+{
+    return m_cached_shaders_dir;
+}   // getCachedShadersDir
+
+//-----------------------------------------------------------------------------
+/** Returns the directory in which decoded sound effects are cached.
+*/
+std::string FileManager::getCachedSfxDir() const
+{
+    return m_cached_sfx_dir;
+}   // getCachedSfxDir
+
+//-----------------------------------------------------------------------------
+/** Returns the directory in which compiled track scripts are cached.
+*/
+std::string FileManager::getCachedScriptsDir() const
+{
+    return m_cached_scripts_dir;
+}   // getCachedScriptsDir
+
+//-----------------------------------------------------------------------------
+/** Returns the directory in which parsed translations are cached.
+*/
+std::string FileManager::getCachedTranslationsDir() const
+{
+    return m_cached_translations_dir;
+}   // getCachedTranslationsDir
+
 //-----------------------------------------------------------------------------
 /** Returns the directory in which user-defined grand prix should be stored.
  */
@@ -692,6 +932,7 @@ bool FileManager::checkAndCreateDirectory(const std::string &path)
 #else
     bool error = mkdir(path.c_str(), 0755) != 0;
 #endif
+    invalidateDirectoryIndex(path);
     return !error;
 }   // checkAndCreateDirectory
 
@@ -922,6 +1163,153 @@ void FileManager::checkAndCreateCachedTexturesDir()
 
 }   // checkAndCreateCachedTexturesDir
 
+// ----------------------------------------------------------------------------
+/** Creates the directory for cached collision BVHs (next to the cached
+ *  textures). This will set m_cached_bvh_dir with the appropriate path.
+ */
+void FileManager::checkAndCreateCachedBvhDir()
+{
+#if defined(WIN32) || defined(__CYGWIN__)
+    m_cached_bvh_dir = m_user_config_dir + "cached-bvh/";
+#elif defined(__APPLE__)
+    m_cached_bvh_dir = getenv("HOME");
+    m_cached_bvh_dir += "/Library/Application Support/SuperTuxKart/CachedBvh/";
+#else
+    m_cached_bvh_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_bvh_dir += "cached-bvh/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_bvh_dir))
+    {
+        Log::error("FileManager", "Can not create cached bvh directory '%s', "
+            "falling back to '.'.", m_cached_bvh_dir.c_str());
+        m_cached_bvh_dir = "./";
+    }
+}   // checkAndCreateCachedBvhDir
+
+// ----------------------------------------------------------------------------
+/** Creates the directory for cached processed meshes (next to the cached
+ *  textures). This will set m_cached_meshes_dir with the appropriate path.
+ */
+void FileManager::checkAndCreateCachedMeshesDir()
+{
+#if defined(WIN32) || defined(__CYGWIN__)
+    m_cached_meshes_dir = m_user_config_dir + "cached-meshes/";
+#elif defined(__APPLE__)
+    m_cached_meshes_dir = getenv("HOME");
+    m_cached_meshes_dir += "/Library/Application Support/SuperTuxKart/CachedMeshes/";
+#else
+    m_cached_meshes_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_meshes_dir += "cached-meshes/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_meshes_dir))
+    {
+        Log::error("FileManager", "Can not create cached meshes directory "
+            "'%s', falling back to '.'.", m_cached_meshes_dir.c_str());
+        m_cached_meshes_dir = "./";
+    }
+}   // checkAndCreateCachedMeshesDir
+
+// ----------------------------------------------------------------------------
+/** Creates the directory for cached shader program binaries (next to the
+ *  cached textures). This will set m_cached_shaders_dir with the appropriate
+ *  path.
+ */
+void FileManager::checkAndCreateCachedShadersDir()
+{
+#if defined(WIN32) || defined(__CYGWIN__)
+    m_cached_shaders_dir = m_user_config_dir + "cached-shaders/";
+#elif defined(__APPLE__)
+    m_cached_shaders_dir = getenv("HOME");
+    m_cached_shaders_dir += "/Library/Application Support/SuperTuxKart/CachedShaders/";
+#else
+    m_cached_shaders_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_shaders_dir += "cached-shaders/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_shaders_dir))
+    {
+        Log::error("FileManager", "Can not create cached shaders directory '%s', "
+            "falling back to '.'.", m_cached_shaders_dir.c_str());
+        m_cached_shaders_dir = "./";
+    }
+}   // checkAndCreateCachedShadersDir
+
+// ----------------------------------------------------------------------------
+/** Creates the directory for decoded sound effects (next to the cached
+ *  textures). This will set m_cached_sfx_dir with the appropriate path.
+ */
+void FileManager::checkAndCreateCachedSfxDir()
+{
+#if defined(WIN32) || defined(__CYGWIN__)
+    m_cached_sfx_dir = m_user_config_dir + "cached-sfx/";
+#elif defined(__APPLE__)
+    m_cached_sfx_dir = getenv("HOME");
+    m_cached_sfx_dir += "/Library/Application Support/SuperTuxKart/CachedSfx/";
+#else
+    m_cached_sfx_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_sfx_dir += "cached-sfx/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_sfx_dir))
+    {
+        Log::error("FileManager", "Can not create cached sfx directory '%s', "
+            "falling back to '.'.", m_cached_sfx_dir.c_str());
+        m_cached_sfx_dir = "./";
+    }
+}   // checkAndCreateCachedSfxDir
+
+// ----------------------------------------------------------------------------
+/** Creates the directory for compiled track scripts (next to the cached
+ *  textures). This will set m_cached_scripts_dir with the appropriate path.
+ */
+void FileManager::checkAndCreateCachedScriptsDir()
+{
+#if defined(WIN32) || defined(__CYGWIN__)
+    m_cached_scripts_dir = m_user_config_dir + "cached-scripts/";
+#elif defined(__APPLE__)
+    m_cached_scripts_dir = getenv("HOME");
+    m_cached_scripts_dir += "/Library/Application Support/SuperTuxKart/CachedScripts/";
+#else
+    m_cached_scripts_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_scripts_dir += "cached-scripts/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_scripts_dir))
+    {
+        Log::error("FileManager", "Can not create cached scripts directory "
+            "'%s', falling back to '.'.", m_cached_scripts_dir.c_str());
+        m_cached_scripts_dir = "./";
+    }
+}   // checkAndCreateCachedScriptsDir
+
+// ----------------------------------------------------------------------------
+/** Creates the directory for parsed translations (next to the cached
+ *  textures). This will set m_cached_translations_dir with the appropriate
+ *  path.
+ */
+void FileManager::checkAndCreateCachedTranslationsDir()
+{
+#if defined(WIN32) || defined(__CYGWIN__)
+    m_cached_translations_dir = m_user_config_dir + "cached-translations/";
+#elif defined(__APPLE__)
+    m_cached_translations_dir = getenv("HOME");
+    m_cached_translations_dir += "/Library/Application Support/SuperTuxKart/CachedTranslations/";
+#else
+    m_cached_translations_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_translations_dir += "cached-translations/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_translations_dir))
+    {
+        Log::error("FileManager", "Can not create cached translations "
+            "directory '%s', falling back to '.'.",
+            m_cached_translations_dir.c_str());
+        m_cached_translations_dir = "./";
+    }
+}   // checkAndCreateCachedTranslationsDir
+
 // ----------------------------------------------------------------------------
 /** Creates the directories for user-defined grand prix. This will set m_gp_dir
  *  with the appropriate path.
@@ -1161,8 +1549,14 @@ bool FileManager::isDirectory(const std::string &path) const
     // a '/' at the end of the path.
     if(s[s.size()-1]=='/')
         s.erase(s.end()-1, s.end());
-    if(stat(s.c_str(), &mystat) < 0) return false;
-    return S_ISDIR(mystat.st_mode);
+    if(stat(s.c_str(), &mystat) == 0 && S_ISDIR(mystat.st_mode))
+        return true;
+    for(unsigned int i=0; i<m_packed_archives.size(); i++)
+    {
+        if(m_packed_archives[i]->isDirectory(path))
+            return true;
+    }
+    return false;
 }   // isDirectory
 
 //-----------------------------------------------------------------------------
@@ -1178,8 +1572,24 @@ void FileManager::listFiles(std::set<std::string>& result,
 {
     result.clear();
 
+    // Add the entries of all packs, the real files are added below
+    for(unsigned int i=0; i<m_packed_archives.size(); i++)
+    {
+        std::set<std::string> packed;
+        m_packed_archives[i]->listDirectory(dir, &packed);
+        for(std::set<std::string>::const_iterator j = packed.begin();
+            j != packed.end(); j++)
+        {
+            result.insert(make_full_path ? dir+"/"+*j : *j);
+        }
+    }
+
 #ifndef ANDROID
-    if(!isDirectory(dir))
+    struct stat mystat;
+    std::string s(dir);
+    if(s.size()>1 && s[s.size()-1]=='/')
+        s.erase(s.end()-1, s.end());
+    if(stat(s.c_str(), &mystat) < 0 || !S_ISDIR(mystat.st_mode))
         return;
 #endif
 
@@ -1233,7 +1643,10 @@ bool FileManager::removeFile(const std::string &name) const
     struct stat mystat;
     if(stat(name.c_str(), &mystat) < 0) return false;
     if( S_ISREG(mystat.st_mode))
+    {
+        invalidateDirectoryIndex(name);
         return remove(name.c_str())==0;
+    }
     return false;
 }   // removeFile
 
@@ -1266,6 +1679,7 @@ bool FileManager::removeDirectory(const std::string &name) const
             removeFile(*i);
         }
     }
+    invalidateDirectoryIndex(name);
 #if defined(WIN32)
         return RemoveDirectory(name.c_str())==TRUE;
 #else
@@ -1317,6 +1731,7 @@ bool FileManager::copyFile(const std::string &source, const std::string &dest)
     delete[] buffer;
     fclose(f_source);
     fclose(f_dest);
+    invalidateDirectoryIndex(dest);
     return true;
 }   // copyFile
 // ----------------------------------------------------------------------------
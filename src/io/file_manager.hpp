@@ -25,9 +25,13 @@
  * Contains generic utility classes for file I/O (especially XML handling).
  */
 
+#include <pthread.h>
 #include <string>
 #include <vector>
 #include <set>
+#include <time.h>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <irrString.h>
 #include <IFileSystem.h>
@@ -35,6 +39,7 @@ namespace irr { class IrrlichtDevice; }
 using namespace irr;
 
 #include "io/xml_node.hpp"
+class PackedArchive;
 #include "utils/no_copy.hpp"
 
 /**
@@ -75,6 +80,24 @@ private:
     /** Directory where resized textures are cached. */
     std::string       m_cached_textures_dir;
 
+    /** Directory where the collision BVHs of tracks are cached. */
+    std::string       m_cached_bvh_dir;
+
+    /** Directory where processed meshes (with tangents) are cached. */
+    std::string       m_cached_meshes_dir;
+
+    /** Directory where linked shader program binaries are cached. */
+    std::string       m_cached_shaders_dir;
+
+    /** Directory where decoded sound effects are cached. */
+    std::string       m_cached_sfx_dir;
+
+    /** Directory where compiled track scripts are cached. */
+    std::string       m_cached_scripts_dir;
+
+    /** Directory where parsed translations are cached. */
+    std::string       m_cached_translations_dir;
+
     /** Directory where user-defined grand prix are stored. */
     std::string       m_gp_dir;
 
@@ -82,6 +105,36 @@ private:
                       m_texture_search_path,
                       m_model_search_path,
                       m_music_search_path;
+
+    /** The names of all entries of a directory. */
+    struct DirectoryIndex
+    {
+        std::unordered_set<std::string> m_entries;
+        /** Modification time of the directory when it was listed, 0 if it
+         *  doesn't exist. */
+        time_t m_mtime;
+        /** Time the directory was listed at, and its mtime last checked. */
+        time_t m_listed_at;
+        time_t m_checked_at;
+    };
+    /** The index of each directory findFile searched in, so that finding a
+     *  file is a hash lookup instead of testing each search path with
+     *  the file system. */
+    mutable std::unordered_map<std::string, DirectoryIndex>
+                      m_directory_index;
+    mutable pthread_mutex_t
+                      m_directory_index_mutex;
+
+    /** All mounted packs. */
+    std::vector<PackedArchive*>
+                      m_packed_archives;
+
+    void              mountPackedArchives(const std::string &dir);
+    bool              packedFileExists(const std::string &path) const;
+    bool              indexedFileExists(const std::string &path) const;
+    void              listDirectory(const std::string &dir,
+                                    DirectoryIndex *index) const;
+    void              invalidateDirectoryIndex(const std::string &path) const;
     bool              findFile(std::string& full_path,
                                const std::string& fname,
                                const std::vector<std::string>& search_path)
@@ -95,6 +148,12 @@ private:
     void              checkAndCreateAddonsDir();
     void              checkAndCreateScreenshotDir();
     void              checkAndCreateCachedTexturesDir();
+    void              checkAndCreateCachedBvhDir();
+    void              checkAndCreateCachedMeshesDir();
+    void              checkAndCreateCachedShadersDir();
+    void              checkAndCreateCachedSfxDir();
+    void              checkAndCreateCachedScriptsDir();
+    void              checkAndCreateCachedTranslationsDir();
     void              checkAndCreateGPDir();
     void              discoverPaths();
 #if !defined(WIN32) && !defined(__CYGWIN__) && !defined(__APPLE__)
@@ -115,6 +174,12 @@ public:
 
     std::string       getScreenshotDir() const;
     std::string       getCachedTexturesDir() const;
+    std::string       getCachedBvhDir() const;
+    std::string       getCachedMeshesDir() const;
+    std::string       getCachedShadersDir() const;
+    std::string       getCachedSfxDir() const;
+    std::string       getCachedScriptsDir() const;
+    std::string       getCachedTranslationsDir() const;
     std::string       getGPDir() const;
     std::string       getTextureCacheLocation(const std::string& filename);
     bool              checkAndCreateDirectoryP(const std::string &path);
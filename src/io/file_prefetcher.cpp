@@ -0,0 +1,133 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "io/file_prefetcher.hpp"
+
+#include "io/file_manager.hpp"
+#include "utils/log.hpp"
+
+#include <assert.h>
+#include <set>
+#include <stdio.h>
+
+FilePrefetcher *FilePrefetcher::m_file_prefetcher = NULL;
+
+// ----------------------------------------------------------------------------
+void FilePrefetcher::create()
+{
+    assert(!m_file_prefetcher);
+    m_file_prefetcher = new FilePrefetcher();
+}   // create
+
+// ----------------------------------------------------------------------------
+void FilePrefetcher::destroy()
+{
+    delete m_file_prefetcher;
+    m_file_prefetcher = NULL;
+}   // destroy
+
+// ----------------------------------------------------------------------------
+FilePrefetcher::FilePrefetcher()
+{
+    m_quit = false;
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_queued_cond, NULL);
+    m_thread_started = pthread_create(&m_thread, NULL,
+                                      &FilePrefetcher::mainLoop, this) == 0;
+    if (!m_thread_started)
+        Log::warn("FilePrefetcher", "Could not create prefetch thread.");
+}   // FilePrefetcher
+
+// ----------------------------------------------------------------------------
+/** Stops the thread, files that have not been read yet are skipped.
+ */
+FilePrefetcher::~FilePrefetcher()
+{
+    if (m_thread_started)
+    {
+        pthread_mutex_lock(&m_mutex);
+        m_quit = true;
+        m_files.clear();
+        pthread_cond_signal(&m_queued_cond);
+        pthread_mutex_unlock(&m_mutex);
+        pthread_join(m_thread, NULL);
+    }
+    pthread_cond_destroy(&m_queued_cond);
+    pthread_mutex_destroy(&m_mutex);
+}   // ~FilePrefetcher
+
+// ----------------------------------------------------------------------------
+/** Queues all files of a directory to be read, replacing the files queued
+ *  before. Does nothing if the prefetcher was not created.
+ *  \param dir The directory.
+ */
+void FilePrefetcher::prefetchDirectory(const std::string &dir)
+{
+    FilePrefetcher *prefetcher = m_file_prefetcher;
+    if (!prefetcher || !prefetcher->m_thread_started)
+        return;
+
+    std::set<std::string> files;
+    file_manager->listFiles(files, dir, /*make_full_path*/true);
+
+    pthread_mutex_lock(&prefetcher->m_mutex);
+    prefetcher->m_files.assign(files.begin(), files.end());
+    pthread_cond_signal(&prefetcher->m_queued_cond);
+    pthread_mutex_unlock(&prefetcher->m_mutex);
+}   // prefetchDirectory
+
+// ----------------------------------------------------------------------------
+/** Waits for the next file to read.
+ *  \return False if the prefetcher is destroyed.
+ */
+bool FilePrefetcher::nextFile(std::string *filename)
+{
+    pthread_mutex_lock(&m_mutex);
+    while (m_files.empty() && !m_quit)
+        pthread_cond_wait(&m_queued_cond, &m_mutex);
+    const bool quit = m_quit;
+    if (!quit)
+    {
+        filename->swap(m_files.back());
+        m_files.pop_back();
+    }
+    pthread_mutex_unlock(&m_mutex);
+    return !quit;
+}   // nextFile
+
+// ----------------------------------------------------------------------------
+/** Reads the queued files, the data itself is discarded.
+ */
+void *FilePrefetcher::mainLoop(void *obj)
+{
+    FilePrefetcher *prefetcher = (FilePrefetcher*)obj;
+    std::vector<char> buffer(64 * 1024);
+    std::string filename;
+    while (prefetcher->nextFile(&filename))
+    {
+        FILE *fd = fopen(filename.c_str(), "rb");
+        if (!fd)
+            continue;
+        while (fread(&buffer[0], 1, buffer.size(), fd) == buffer.size() &&
+               !prefetcher->m_quit)
+        {
+        }
+        fclose(fd);
+    }
+    return NULL;
+}   // mainLoop
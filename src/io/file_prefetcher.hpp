@@ -0,0 +1,63 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_FILE_PREFETCHER_HPP
+#define HEADER_FILE_PREFETCHER_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+/** Reads files from a separate thread before they are needed, so that they
+ *  are in the file system cache when they are loaded. This is used to read
+ *  the files of a track while the player is still in the track info screen,
+ *  since the track can only be loaded (with its textures and meshes) from
+ *  the main thread once the race starts. A new request replaces all files
+ *  that have not been read yet.
+ *  \ingroup io
+ */
+class FilePrefetcher : public NoCopy
+{
+private:
+    static FilePrefetcher *m_file_prefetcher;
+
+    /** The files still to read. */
+    std::vector<std::string> m_files;
+
+    /** Protects m_files and m_quit. */
+    pthread_mutex_t  m_mutex;
+    /** Signalled when files are queued or the prefetcher is destroyed. */
+    pthread_cond_t   m_queued_cond;
+    pthread_t        m_thread;
+    bool             m_thread_started;
+    bool             m_quit;
+
+                 FilePrefetcher();
+                ~FilePrefetcher();
+    static void *mainLoop(void *obj);
+    bool         nextFile(std::string *filename);
+
+public:
+    static void create();
+    static void destroy();
+    static void prefetchDirectory(const std::string &dir);
+};   // FilePrefetcher
+
+#endif
@@ -0,0 +1,421 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "io/packed_archive.hpp"
+
+#include "utils/log.hpp"
+
+#include <IFileList.h>
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#ifndef WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace
+{
+    // ------------------------------------------------------------------------
+    uint16_t read16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+    // ------------------------------------------------------------------------
+    uint32_t read32(const uint8_t *p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }   // read32
+    // ------------------------------------------------------------------------
+    uint64_t read64(const uint8_t *p)
+    {
+        return read32(p) | ((uint64_t)read32(p + 4) << 32);
+    }   // read64
+
+    // ------------------------------------------------------------------------
+    /** Makes a path absolute and removes all '.' and '..' components and
+     *  duplicated '/', without accessing the file system.
+     *  \param path The path, using '/' as separator.
+     *  \param working_dir Directory relative paths are relative to, which
+     *         must end with '/'.
+     */
+    std::string flattenPath(const std::string &path,
+                            const std::string &working_dir)
+    {
+        std::string p = path;
+        for (unsigned int i = 0; i < p.size(); i++)
+            if (p[i] == '\\') p[i] = '/';
+        const bool is_absolute = !p.empty() &&
+                                 (p[0] == '/' || (p.size() > 1 && p[1] == ':'));
+        if (!is_absolute)
+            p = working_dir + p;
+
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (start <= p.size())
+        {
+            size_t end = p.find('/', start);
+            if (end == std::string::npos) end = p.size();
+            const std::string part = p.substr(start, end - start);
+            if (part == "..")
+            {
+                // Never remove a drive letter
+                if (!parts.empty() &&
+                    parts.back()[parts.back().size() - 1] != ':')
+                    parts.pop_back();
+            }
+            else if (!part.empty() && part != ".")
+                parts.push_back(part);
+            start = end + 1;
+        }
+
+        std::string result = p[0] == '/' ? "/" : "";
+        for (unsigned int i = 0; i < parts.size(); i++)
+        {
+            if (i > 0) result += '/';
+            result += parts[i];
+        }
+        return result;
+    }   // flattenPath
+
+    // ========================================================================
+    /** A file in a pack. Stored files are read from the mapped pack, which
+     *  is kept alive as long as the file exists; compressed files are
+     *  inflated into a buffer owned by the file. */
+    class PackedReadFile : public io::IReadFile
+    {
+    private:
+        PackedArchive *m_archive;
+        const uint8_t *m_data;
+        uint8_t       *m_owned_data;
+        long           m_size;
+        long           m_pos;
+        io::path       m_name;
+    public:
+        PackedReadFile(PackedArchive *archive, const uint8_t *data,
+                       uint8_t *owned_data, long size, const io::path &name)
+            : m_archive(archive), m_data(data), m_owned_data(owned_data),
+              m_size(size), m_pos(0), m_name(name)
+        {
+            if (m_archive)
+                m_archive->grab();
+        }   // PackedReadFile
+        // --------------------------------------------------------------------
+        virtual ~PackedReadFile()
+        {
+            delete [] m_owned_data;
+            if (m_archive)
+                m_archive->drop();
+        }   // ~PackedReadFile
+        // --------------------------------------------------------------------
+        virtual s32 read(void *buffer, u32 size_to_read)
+        {
+            long n = std::min((long)size_to_read, m_size - m_pos);
+            if (n <= 0)
+                return 0;
+            memcpy(buffer, m_data + m_pos, n);
+            m_pos += n;
+            return (s32)n;
+        }   // read
+        // --------------------------------------------------------------------
+        virtual bool seek(long final_pos, bool relative_movement)
+        {
+            const long pos = relative_movement ? m_pos + final_pos : final_pos;
+            if (pos < 0 || pos > m_size)
+                return false;
+            m_pos = pos;
+            return true;
+        }   // seek
+        // --------------------------------------------------------------------
+        virtual long getSize() const { return m_size; }
+        virtual long getPos() const { return m_pos; }
+        virtual const io::path &getFileName() const { return m_name; }
+    };   // PackedReadFile
+}   // namespace
+
+// ----------------------------------------------------------------------------
+PackedArchive::PackedArchive()
+{
+    m_data      = NULL;
+    m_size      = 0;
+    m_file_list = NULL;
+}   // PackedArchive
+
+// ----------------------------------------------------------------------------
+PackedArchive::~PackedArchive()
+{
+    if (m_file_list)
+        m_file_list->drop();
+#ifdef WIN32
+    delete [] m_data;
+#else
+    if (m_data)
+        munmap((void*)m_data, m_size);
+#endif
+}   // ~PackedArchive
+
+// ----------------------------------------------------------------------------
+/** Maps a pack into memory and reads its index.
+ *  \param file_system The irrlicht file system, used for the working
+ *         directory and to create the file list.
+ *  \param filename Name of the pack.
+ *  \return The archive, or NULL if the file is not a valid pack.
+ */
+PackedArchive *PackedArchive::open(io::IFileSystem *file_system,
+                                   const std::string &filename)
+{
+    PackedArchive *archive = new PackedArchive();
+    archive->m_filename = filename;
+    archive->m_working_dir =
+        flattenPath(file_system->getWorkingDirectory().c_str(), "/") + "/";
+    const size_t slash = filename.find_last_of("/\\");
+    const std::string dir = slash == std::string::npos
+                          ? "" : filename.substr(0, slash + 1);
+    archive->m_mount_dir = flattenPath(dir, archive->m_working_dir);
+    if (archive->m_mount_dir.empty() ||
+        archive->m_mount_dir[archive->m_mount_dir.size() - 1] != '/')
+        archive->m_mount_dir += "/";
+
+#ifdef WIN32
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (file)
+    {
+        fseek(file, 0, SEEK_END);
+        long file_size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (file_size > 0)
+        {
+            uint8_t *data = new uint8_t[file_size];
+            if (fread(data, file_size, 1, file) == 1)
+            {
+                archive->m_data = data;
+                archive->m_size = file_size;
+            }
+            else
+                delete [] data;
+        }
+        fclose(file);
+    }
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+            map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map != MAP_FAILED)
+        {
+            archive->m_data = (const uint8_t*)map;
+            archive->m_size = st.st_size;
+        }
+    }
+#endif
+
+    if (!archive->m_data || !archive->readIndex())
+    {
+        Log::warn("PackedArchive", "Can't read pack '%s'.", filename.c_str());
+        archive->drop();
+        return NULL;
+    }
+
+    archive->m_file_list =
+        file_system->createEmptyFileList(archive->m_mount_dir.c_str(),
+                                         /*ignoreCase*/false,
+                                         /*ignorePaths*/false);
+    for (unsigned int i = 0; i < archive->m_entries.size(); i++)
+    {
+        const Entry &e = archive->m_entries[i];
+        archive->m_file_list->addItem((archive->m_mount_dir + e.m_name).c_str(),
+                                      (u32)e.m_offset, (u32)e.m_size,
+                                      /*isDirectory*/false, i);
+    }
+    // The irrlicht file list uses a binary search
+    archive->m_file_list->sort();
+
+    Log::info("PackedArchive", "Mounted %d files of '%s' at '%s'.",
+              (int)archive->m_entries.size(), filename.c_str(),
+              archive->m_mount_dir.c_str());
+    return archive;
+}   // open
+
+// ----------------------------------------------------------------------------
+/** Reads and checks the header and index of the mapped pack.
+ *  \return False if the pack is invalid.
+ */
+bool PackedArchive::readIndex()
+{
+    const uint64_t header_size = 32;
+    if (m_size < header_size || memcmp(m_data, "STKP", 4) != 0)
+        return false;
+    const uint32_t version      = read32(m_data + 4);
+    const uint32_t num_entries  = read32(m_data + 8);
+    const uint64_t index_offset = read64(m_data + 16);
+    const uint64_t index_size   = read64(m_data + 24);
+    if (version != 1 || index_offset > m_size ||
+        index_size > m_size - index_offset)
+        return false;
+
+    const uint8_t *p   = m_data + index_offset;
+    const uint8_t *end = p + index_size;
+    m_entries.resize(num_entries);
+    for (unsigned int i = 0; i < num_entries; i++)
+    {
+        // offset, size, stored size, compression and name length
+        if (end - p < 30)
+            return false;
+        Entry &e = m_entries[i];
+        e.m_offset      = read64(p);
+        e.m_size        = read64(p + 8);
+        e.m_stored_size = read64(p + 16);
+        e.m_compression = read32(p + 24);
+        const uint16_t name_length = read16(p + 28);
+        p += 30;
+        if (end - p < name_length || e.m_offset > m_size ||
+            e.m_stored_size > m_size - e.m_offset ||
+            (e.m_compression != PACK_STORED &&
+             e.m_compression != PACK_ZLIB) ||
+            (e.m_compression == PACK_STORED && e.m_size != e.m_stored_size))
+            return false;
+        e.m_name.assign((const char*)p, name_length);
+        p += name_length;
+        m_index[e.m_name] = i;
+        addToDirectory(e.m_name);
+    }
+    return true;
+}   // readIndex
+
+// ----------------------------------------------------------------------------
+/** Adds a file and all directories it is in to their parent directories. */
+void PackedArchive::addToDirectory(const std::string &name)
+{
+    size_t start = 0;
+    std::string parent = "";
+    while (true)
+    {
+        size_t slash = name.find('/', start);
+        const std::string part = name.substr(start, slash == std::string::npos
+                                                    ? std::string::npos
+                                                    : slash - start);
+        m_directories[parent].insert(part);
+        if (slash == std::string::npos)
+            break;
+        parent = name.substr(0, slash);
+        m_directories[parent];
+        start = slash + 1;
+    }
+}   // addToDirectory
+
+// ----------------------------------------------------------------------------
+/** Converts a path to the name of an entry.
+ *  \param path The path, relative to the working directory or absolute.
+ *  \param name On return the name relative to the mount directory, without
+ *         a trailing '/'.
+ *  \return False if the path is not below the mount directory.
+ */
+bool PackedArchive::getRelativeName(const std::string &path,
+                                    std::string *name) const
+{
+    const std::string p = flattenPath(path, m_working_dir) + "/";
+    if (p.compare(0, m_mount_dir.size(), m_mount_dir) != 0)
+        return false;
+    *name = p.substr(m_mount_dir.size(), p.size() - m_mount_dir.size() - 1);
+    return true;
+}   // getRelativeName
+
+// ----------------------------------------------------------------------------
+/** Returns true if the pack contains the file or directory. */
+bool PackedArchive::exists(const std::string &path) const
+{
+    std::string name;
+    if (!getRelativeName(path, &name))
+        return false;
+    return m_index.count(name) > 0 || m_directories.count(name) > 0;
+}   // exists
+
+// ----------------------------------------------------------------------------
+/** Returns true if the pack contains files in the given directory. */
+bool PackedArchive::isDirectory(const std::string &path) const
+{
+    std::string name;
+    return getRelativeName(path, &name) && m_directories.count(name) > 0;
+}   // isDirectory
+
+// ----------------------------------------------------------------------------
+/** Adds the names of all files and subdirectories of a directory in the
+ *  pack to a set.
+ */
+void PackedArchive::listDirectory(const std::string &dir,
+                                  std::set<std::string> *result) const
+{
+    std::string name;
+    if (!getRelativeName(dir, &name))
+        return;
+    std::unordered_map<std::string, std::set<std::string> >::const_iterator
+        i = m_directories.find(name);
+    if (i != m_directories.end())
+        result->insert(i->second.begin(), i->second.end());
+}   // listDirectory
+
+// ----------------------------------------------------------------------------
+/** Opens a file of the pack, called by the irrlicht file system for each
+ *  file that is opened.
+ *  \return The file, or NULL if it is not in this pack.
+ */
+io::IReadFile *PackedArchive::createAndOpenFile(const io::path &filename)
+{
+    std::string name;
+    if (!getRelativeName(filename.c_str(), &name))
+        return NULL;
+    std::unordered_map<std::string, unsigned int>::const_iterator i =
+        m_index.find(name);
+    if (i == m_index.end())
+        return NULL;
+
+    const Entry &e = m_entries[i->second];
+    const io::path full_name = (m_mount_dir + e.m_name).c_str();
+    if (e.m_compression == PACK_STORED)
+    {
+        return new PackedReadFile(this, m_data + e.m_offset, NULL,
+                                  (long)e.m_size, full_name);
+    }
+
+    uint8_t *data = new uint8_t[(size_t)e.m_size + 1];
+    uLongf size = (uLongf)e.m_size;
+    if (uncompress(data, &size, m_data + e.m_offset,
+                   (uLong)e.m_stored_size) != Z_OK || size != e.m_size)
+    {
+        Log::error("PackedArchive", "Corrupt entry '%s' in '%s'.",
+                   e.m_name.c_str(), m_filename.c_str());
+        delete [] data;
+        return NULL;
+    }
+    return new PackedReadFile(NULL, data, data, (long)e.m_size, full_name);
+}   // createAndOpenFile
+
+// ----------------------------------------------------------------------------
+/** Opens a file by its index in the file list. */
+io::IReadFile *PackedArchive::createAndOpenFile(u32 index)
+{
+    if (index >= m_file_list->getFileCount())
+        return NULL;
+    return createAndOpenFile(m_file_list->getFullFileName(index));
+}   // createAndOpenFile
@@ -0,0 +1,122 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_PACKED_ARCHIVE_HPP
+#define HEADER_PACKED_ARCHIVE_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include <IFileArchive.h>
+#include <IFileSystem.h>
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace irr;
+
+/** \brief A read only archive of assets in one file, mapped into memory.
+ *  A pack (.stkpack, created by tools/pack_data.py) starts with a header,
+ *  followed by the content of all files (each aligned to 16 bytes, either
+ *  stored or zlib compressed), and ends with the index of all files. It
+ *  replaces the files below the directory it is stored in: a pack in
+ *  data/ with an entry 'textures/a.png' is found as data/textures/a.png.
+ *  The archive is added to the irrlicht file system, so all files read
+ *  through it (textures, models, xml files) are read from the pack, and
+ *  FileManager takes packs into account when searching files.
+ *  Stored files are read directly from the mapped memory.
+ *  \ingroup io
+ */
+class PackedArchive : public io::IFileArchive, public NoCopy
+{
+public:
+    /** Header at the start of a pack, all values are little endian. */
+    struct Header
+    {
+        char     m_magic[4];
+        uint32_t m_version;
+        uint32_t m_num_entries;
+        uint32_t m_flags;
+        uint64_t m_index_offset;
+        uint64_t m_index_size;
+    };   // Header
+
+    /** Compression of an entry. */
+    enum Compression { PACK_STORED = 0, PACK_ZLIB = 1 };
+
+private:
+    /** An entry of the index. */
+    struct Entry
+    {
+        std::string m_name;
+        uint64_t    m_offset;
+        uint64_t    m_size;
+        uint64_t    m_stored_size;
+        uint32_t    m_compression;
+    };   // Entry
+
+    /** The mapped file. */
+    const uint8_t     *m_data;
+    uint64_t           m_size;
+    /** Name of the pack file. */
+    std::string        m_filename;
+    /** Absolute directory the entries are relative to, ending with '/'. */
+    std::string        m_mount_dir;
+    /** Working directory relative paths are resolved against. */
+    std::string        m_working_dir;
+
+    std::vector<Entry> m_entries;
+    /** Index of each entry by name. */
+    std::unordered_map<std::string, unsigned int> m_index;
+    /** The names of all files and subdirectories in each directory ("" is
+     *  the mount directory). */
+    std::unordered_map<std::string, std::set<std::string> > m_directories;
+
+    /** File list for irrlicht, with the absolute names of all files. */
+    io::IFileList     *m_file_list;
+
+         PackedArchive();
+    bool readIndex();
+    void addToDirectory(const std::string &name);
+
+public:
+    static PackedArchive *open(io::IFileSystem *file_system,
+                               const std::string &filename);
+    virtual ~PackedArchive();
+
+    bool getRelativeName(const std::string &path, std::string *name) const;
+    bool exists(const std::string &path) const;
+    bool isDirectory(const std::string &path) const;
+    void listDirectory(const std::string &dir,
+                       std::set<std::string> *result) const;
+
+    virtual io::IReadFile *createAndOpenFile(const io::path &filename);
+    virtual io::IReadFile *createAndOpenFile(u32 index);
+    // ------------------------------------------------------------------------
+    virtual const io::IFileList *getFileList() const { return m_file_list; }
+    // ------------------------------------------------------------------------
+    /** Returns the name of the pack file. */
+    const std::string &getFilename() const { return m_filename; }
+    // ------------------------------------------------------------------------
+    /** Returns the directory the entries are relative to. */
+    const std::string &getMountDir() const { return m_mount_dir; }
+};   // PackedArchive
+
+#endif
@@ -18,6 +18,8 @@
 
 #include "io/utf_writer.hpp"
 
+#include "io/background_writer.hpp"
+
 #include <wchar.h>
 #include <string>
 #include <stdexcept>
@@ -25,10 +27,18 @@ using namespace irr;
 
 // ----------------------------------------------------------------------------
 
-UTFWriter::UTFWriter(const char* dest)
-         : m_base(dest, std::ios::out | std::ios::binary)
+/** Creates a writer for a file.
+ *  \param dest Name of the file.
+ *  \param in_memory If true the content is collected in memory and written
+ *         by the BackgroundWriter in close(), otherwise the file is written
+ *         directly.
+ */
+UTFWriter::UTFWriter(const char* dest, bool in_memory)
+         : m_in_memory(in_memory), m_filename(dest)
 {
-    if (!m_base.is_open())
+    if (!m_in_memory)
+        m_base.open(dest, std::ios::out | std::ios::binary);
+    if (!m_in_memory && !m_base.is_open())
     {
         throw std::runtime_error("Failed to open file for writing : " +
                                   std::string(dest));
@@ -38,14 +48,23 @@ UTFWriter::UTFWriter(const char* dest)
     // UTF-16 BOM is 0xFEFF; UTF-32 BOM is 0x0000FEFF. So this works in either case
     wchar_t BOM = 0xFEFF;
 
-    m_base.write((char *) &BOM, sizeof(wchar_t));
+    write((char *) &BOM, sizeof(wchar_t));
 }   // UTFWriter
 
+// ----------------------------------------------------------------------------
+void UTFWriter::write(const char *data, size_t size)
+{
+    if (m_in_memory)
+        m_memory.append(data, size);
+    else
+        m_base.write(data, size);
+}   // write
+
 // ----------------------------------------------------------------------------
 
 UTFWriter& UTFWriter::operator<< (const irr::core::stringw& txt)
 {
-    m_base.write((char *) txt.c_str(), txt.size() * sizeof(wchar_t));
+    write((char *) txt.c_str(), txt.size() * sizeof(wchar_t));
     return *this;
 }   // operator<< (stringw)
 
@@ -53,14 +72,17 @@ UTFWriter& UTFWriter::operator<< (const irr::core::stringw& txt)
 
 UTFWriter& UTFWriter::operator<< (const wchar_t*txt)
 {
-    m_base.write((char *) txt, wcslen(txt) * sizeof(wchar_t));
+    write((char *) txt, wcslen(txt) * sizeof(wchar_t));
     return *this;
 }   // operator<< (wchar_t)
 
 // ----------------------------------------------------------------------------
 void UTFWriter::close()
 {
-    m_base.close();
+    if (m_in_memory)
+        BackgroundWriter::write(m_filename, &m_memory);
+    else
+        m_base.close();
 }   // close
 
 // ----------------------------------------------------------------------------
@@ -24,6 +24,7 @@
 #include <irrString.h>
 
 #include <fstream>
+#include <string>
 
 /**
  * \brief utility class used to write wide (UTF-16 or UTF-32, depending of size of wchar_t) XML files
@@ -34,9 +35,17 @@
 class UTFWriter
 {
     std::ofstream m_base;
+
+    /** True if the file is created in memory and written by the
+     *  BackgroundWriter when it is closed. */
+    bool          m_in_memory;
+    std::string   m_filename;
+    std::string   m_memory;
+
+    void write(const char *data, size_t size);
 public:
 
-    UTFWriter(const char* dest);
+    UTFWriter(const char* dest, bool in_memory = false);
     void close();
 
     UTFWriter& operator<< (const irr::core::stringw& txt);
@@ -63,7 +72,7 @@ public:
         return operator<<(StringUtils::toString<T>(t));
     }   // operator<< (template)
     // ------------------------------------------------------------------------
-    bool is_open() { return m_base.is_open(); }
+    bool is_open() { return m_in_memory || m_base.is_open(); }
 };
 
 #endif
@@ -22,7 +22,49 @@
 #include "utils/interpolation_array.hpp"
 #include "utils/vec3.hpp"
 
+#include <algorithm>
+#include <errno.h>
 #include <stdexcept>
+#include <stdlib.h>
+
+namespace
+{
+    // ------------------------------------------------------------------------
+    /** Parses a float at the start of a string.
+     *  \return Pointer to the first character after the number, or NULL if
+     *          there is no number. */
+    const char *parseFloat(const char *s, float *value)
+    {
+        char *end;
+        *value = strtof(s, &end);
+        return end == s ? NULL : end;
+    }   // parseFloat
+
+    // ------------------------------------------------------------------------
+    /** Parses an integer at the start of a string, which must fit into the
+     *  range min to max.
+     *  \return Pointer to the first character after the number, or NULL if
+     *          there is no valid number. */
+    const char *parseInt(const char *s, int64_t min, int64_t max,
+                         int64_t *value)
+    {
+        char *end;
+        errno = 0;
+        long long v = strtoll(s, &end, 10);
+        if (end == s || errno == ERANGE || v < min || v > max)
+            return NULL;
+        *value = v;
+        return end;
+    }   // parseInt
+
+    // ------------------------------------------------------------------------
+    /** True if only spaces follow in a string. */
+    bool isAtEnd(const char *s)
+    {
+        while (*s == ' ') s++;
+        return *s == 0;
+    }   // isAtEnd
+}   // namespace
 
 XMLNode::XMLNode(io::IXMLReader *xml)
 {
@@ -86,19 +128,91 @@ XMLNode::~XMLNode()
 }   // ~XMLNode
 
 // ----------------------------------------------------------------------------
-/** Stores all attributes, and reads in all children.
+/** Reads a XML file element by element and passes each one to a visitor,
+ *  without keeping the nodes in memory. This is meant for large files of
+ *  which each element can be handled on its own.
+ *  \param filename Name of the XML file to read.
+ *  \param visitor The visitor to call.
+ *  \return False if the file could not be opened.
+ */
+bool XMLNode::visit(const std::string &filename, Visitor *visitor)
+{
+    io::IXMLReader *xml = file_manager->createXMLReader(filename);
+    if (xml == NULL)
+        return false;
+
+    // The node is reused for all elements to avoid allocations
+    XMLNode node;
+    node.m_file_name = filename;
+    std::vector<std::string> open_elements;
+    while (xml->read())
+    {
+        if (xml->getNodeType() == io::EXN_ELEMENT)
+        {
+            node.readAttributes(xml);
+            const unsigned int depth = (unsigned int)open_elements.size();
+            if (!visitor->startElement(node, depth))
+                break;
+            if (xml->isEmptyElement())
+                visitor->endElement(node.m_name, depth);
+            else
+                open_elements.push_back(node.m_name);
+        }
+        else if (xml->getNodeType() == io::EXN_ELEMENT_END &&
+                 !open_elements.empty())
+        {
+            visitor->endElement(open_elements.back(),
+                                (unsigned int)open_elements.size() - 1);
+            open_elements.pop_back();
+        }
+    }   // while
+    xml->drop();
+    return true;
+}   // visit
+
+// ----------------------------------------------------------------------------
+/** Stores the name and all attributes of the current element of a reader.
  *  \param xml The XML reader.
  */
-void XMLNode::readXML(io::IXMLReader *xml)
+void XMLNode::readAttributes(io::IXMLReader *xml)
 {
     m_name = std::string(core::stringc(xml->getNodeName()).c_str());
 
-    for(unsigned int i=0; i<xml->getAttributeCount(); i++)
+    const unsigned int count = xml->getAttributeCount();
+    m_attributes.resize(count);
+    for(unsigned int i=0; i<count; i++)
     {
-        std::string   name  = core::stringc(xml->getAttributeName(i)).c_str();
-        core::stringw value = xml->getAttributeValue(i);
-        m_attributes[name] = value;
+        Attribute &a     = m_attributes[i];
+        a.m_name         = core::stringc(xml->getAttributeName(i)).c_str();
+        a.m_value        = xml->getAttributeValue(i);
+        a.m_narrow_value = core::stringc(a.m_value).c_str();
     }   // for i
+    // Stable, so that the last of duplicated attributes is found
+    std::stable_sort(m_attributes.begin(), m_attributes.end());
+}   // readAttributes
+
+// ----------------------------------------------------------------------------
+/** Returns the attribute with the given name, or NULL if it is not defined.
+ */
+const XMLNode::Attribute *XMLNode::findAttribute(const std::string &name) const
+{
+    if(m_attributes.empty()) return NULL;
+    Attribute key;
+    key.m_name = name;
+    std::vector<Attribute>::const_iterator o =
+        std::upper_bound(m_attributes.begin(), m_attributes.end(), key);
+    if(o==m_attributes.begin()) return NULL;
+    --o;
+    return o->m_name==name ? &*o : NULL;
+}   // findAttribute
+
+// ----------------------------------------------------------------------------
+/** Stores all attributes, and reads in all children.
+ *  \param xml The XML reader.
+ */
+void XMLNode::readXML(io::IXMLReader *xml)
+{
+    readAttributes(xml);
 
     // If no children, we are done
     if(xml->isEmptyElement())
@@ -174,32 +288,25 @@ const void XMLNode::getNodes(const std::string &s, std::vector<XMLNode*>& out) c
 */
 int XMLNode::get(const std::string &attribute, std::string *value) const
 {
-    if(m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if(o==m_attributes.end()) return 0;
-    *value=core::stringc(o->second).c_str();
+    const Attribute *a = findAttribute(attribute);
+    if(!a) return 0;
+    *value = a->m_narrow_value;
     return 1;
 }   // get
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, core::stringw *value) const
 {
-    if(m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if(o==m_attributes.end()) return 0;
-    *value = o->second;
+    const Attribute *a = findAttribute(attribute);
+    if(!a) return 0;
+    *value = a->m_value;
     return 1;
 }   // get
 // ----------------------------------------------------------------------------
 int XMLNode::getAndDecode(const std::string &attribute, core::stringw *value) const
 {
-    if (m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if (o == m_attributes.end()) return 0;
-    std::string raw_value = core::stringc(o->second).c_str();
-    *value = StringUtils::xmlDecode(raw_value);
+    const Attribute *a = findAttribute(attribute);
+    if (!a) return 0;
+    *value = StringUtils::xmlDecode(a->m_narrow_value);
     return 1;
 }   // get
 // ----------------------------------------------------------------------------
@@ -228,34 +335,23 @@ int XMLNode::get(const std::string &attribute, core::vector3df *value) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, Vec3 *value) const
 {
-    std::string s = "";
-    if(!get(attribute, &s)) return 0;
-
-    std::vector<std::string> v = StringUtils::split(s,' ');
-    if (v.size() != 3)
+    const Attribute *a = findAttribute(attribute);
+    if(!a) return 0;
+
+    const char *s = a->m_narrow_value.c_str();
+    float xyz[3];
+    for (unsigned int i = 0; i < 3 && s; i++)
+        s = parseFloat(s, &xyz[i]);
+    if (!s || !isAtEnd(s))
     {
         Log::warn("[XMLNode]", "WARNING: Expected 3 floating-point values, but found '%s' in file %s",
-                    s.c_str(), m_file_name.c_str());
-        return 0;
-    }
-
-    float x, y, z;
-
-    if (StringUtils::parseString<float>(v[0], &x) &&
-        StringUtils::parseString<float>(v[1], &y) &&
-        StringUtils::parseString<float>(v[2], &z) )
-    {
-        value->setX(x);
-        value->setY(y);
-        value->setZ(z);
-    }
-    else
-    {
-        Log::warn("[XMLNode]", "WARNING: Expected 3 floating-point values, but found '%s' in file %s",
-                    s.c_str(), m_file_name.c_str());
+                    a->m_narrow_value.c_str(), m_file_name.c_str());
         return 0;
     }
 
+    value->setX(xyz[0]);
+    value->setY(xyz[1]);
+    value->setZ(xyz[2]);
     return 1;
 }   // get(Vec3)
 
@@ -311,32 +407,38 @@ int XMLNode::get(const std::string &attribute, video::SColorf *color) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, int32_t *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    const Attribute *a = findAttribute(attribute);
+    if(!a) return 0;
 
-    if (!StringUtils::parseString<int>(s, value))
+    int64_t v;
+    const char *end = parseInt(a->m_narrow_value.c_str(), INT32_MIN, INT32_MAX, &v);
+    if (!end || *end)
     {
         Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    a->m_narrow_value.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
         return 0;
     }
 
+    *value = (int32_t)v;
     return 1;
 }   // get(int32_t)
 
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, int64_t *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    const Attribute *a = findAttribute(attribute);
+    if(!a) return 0;
 
-    if (!StringUtils::parseString<int64_t>(s, value))
+    int64_t v;
+    const char *end = parseInt(a->m_narrow_value.c_str(), INT64_MIN, INT64_MAX, &v);
+    if (!end || *end)
     {
         Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    a->m_narrow_value.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
         return 0;
     }
 
+    *value = (int64_t)v;
     return 1;
 }   // get(int64_t)
 
@@ -344,58 +446,65 @@ int XMLNode::get(const std::string &attribute, int64_t *value) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, uint16_t *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    const Attribute *a = findAttribute(attribute);
+    if(!a) return 0;
 
-    if (!StringUtils::parseString<uint16_t>(s, value))
+    int64_t v;
+    const char *end = parseInt(a->m_narrow_value.c_str(), 0, UINT16_MAX, &v);
+    if (!end || *end)
     {
         Log::warn("[XMLNode]", "WARNING: Expected uint but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    a->m_narrow_value.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
         return 0;
     }
 
+    *value = (uint16_t)v;
     return 1;
-}   // get(uint32_t)
+}   // get(uint16_t)
 
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, uint32_t *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    const Attribute *a = findAttribute(attribute);
+    if(!a) return 0;
 
-    if (!StringUtils::parseString<unsigned int>(s, value))
+    int64_t v;
+    const char *end = parseInt(a->m_narrow_value.c_str(), 0, UINT32_MAX, &v);
+    if (!end || *end)
     {
         Log::warn("[XMLNode]", "WARNING: Expected uint but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    a->m_narrow_value.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
         return 0;
     }
 
+    *value = (uint32_t)v;
     return 1;
 }   // get(uint32_t)
 
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, float *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    const Attribute *a = findAttribute(attribute);
+    if(!a) return 0;
 
-    if (!StringUtils::parseString<float>(s, value))
+    const char *end = parseFloat(a->m_narrow_value.c_str(), value);
+    if (!end || *end)
     {
         Log::warn("[XMLNode]", "WARNING: Expected float but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    a->m_narrow_value.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
         return 0;
     }
 
     return 1;
-}   // get(int)
+}   // get(float)
 
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, bool *value) const
 {
-    std::string s;
+    const Attribute *a = findAttribute(attribute);
+    if(!a) return 0;
 
-    // FIXME: for some reason, missing attributes don't trigger that if???
-    if(!get(attribute, &s)) return 0;
+    const std::string &s = a->m_narrow_value;
     *value = s[0]=='T' || s[0]=='t' || s[0]=='Y' || s[0]=='y' ||
              s=="#t"   || s   =="#T" || s=="1";
     return 1;
@@ -428,20 +537,19 @@ int XMLNode::get(const std::string &attribute,
 int XMLNode::get(const std::string &attribute,
                  std::vector<float> *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    const Attribute *a = findAttribute(attribute);
+    if(!a) return 0;
 
-    std::vector<std::string> v = StringUtils::split(s,' ');
     value->clear();
-
-    const unsigned int count = (unsigned int)v.size();
-    for (unsigned int i=0; i<count; i++)
+    const char *s = a->m_narrow_value.c_str();
+    while (!isAtEnd(s))
     {
         float curr;
-        if (!StringUtils::parseString<float>(v[i], &curr))
+        s = parseFloat(s, &curr);
+        if (!s || (*s && *s != ' '))
         {
             Log::warn("[XMLNode]", "WARNING: Expected float but found '%s' for attribute '%s' of node '%s' in file %s",
-                        v[i].c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                        a->m_narrow_value.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
             return 0;
         }
 
@@ -459,24 +567,23 @@ int XMLNode::get(const std::string &attribute,
  */
 int XMLNode::get(const std::string &attribute, std::vector<int> *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    const Attribute *a = findAttribute(attribute);
+    if(!a) return 0;
 
-    std::vector<std::string> v = StringUtils::split(s,' ');
     value->clear();
-
-    const unsigned int count = (unsigned int)v.size();
-    for (unsigned int i=0; i<count; i++)
+    const char *s = a->m_narrow_value.c_str();
+    while (!isAtEnd(s))
     {
-        int val;
-        if (!StringUtils::parseString<int>(v[i], &val))
+        int64_t val;
+        s = parseInt(s, INT32_MIN, INT32_MAX, &val);
+        if (!s || (*s && *s != ' '))
         {
             Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s'",
-                        v[i].c_str(), attribute.c_str(), m_name.c_str());
+                        a->m_narrow_value.c_str(), attribute.c_str(), m_name.c_str());
             return 0;
         }
 
-        value->push_back(val);
+        value->push_back((int)val);
     }
     return (int) value->size();
 }   // get(vector<int>)
@@ -19,8 +19,8 @@
 #ifndef HEADER_XML_NODE_HPP
 #define HEADER_XML_NODE_HPP
 
-#include <string>
 #include <map>
+#include <string>
 #include <vector>
 
 #include <irrString.h>
@@ -45,18 +45,53 @@ class Vec3;
   */
 class XMLNode : public NoCopy
 {
+public:
+    /** Interface to read a file element by element with visit(), without
+     *  building a tree of nodes. */
+    class Visitor
+    {
+    public:
+        virtual ~Visitor() {}
+        /** Called for each element. The node only has the attributes of the
+         *  element, no sub nodes, and is only valid during the call.
+         *  \param depth Depth of the element, 0 for the root element.
+         *  eturn False to stop reading the file. */
+        virtual bool startElement(const XMLNode &node, unsigned int depth) = 0;
+        /** Called after all sub elements of an element were visited. */
+        virtual void endElement(const std::string &name, unsigned int depth) {}
+    };   // Visitor
+
 private:
+    /** An attribute, the value is stored both as read and converted to a
+     *  narrow string, so that the typed get functions don't have to convert
+     *  it each time. */
+    struct Attribute
+    {
+        std::string   m_name;
+        core::stringw m_value;
+        std::string   m_narrow_value;
+        bool operator<(const Attribute &other) const
+        {
+            return m_name < other.m_name;
+        }
+    };   // Attribute
+
     /** Name of this element. */
     std::string                          m_name;
-    /** List of all attributes. */
-    std::map<std::string, core::stringw> m_attributes;
+    /** List of all attributes, sorted by name. Nodes have only a few
+     *  attributes, so a sorted vector is smaller and faster than a map. */
+    std::vector<Attribute>               m_attributes;
     /** List of all sub nodes. */
     std::vector<XMLNode *>               m_nodes;
 
     void readXML(io::IXMLReader *xml);
+    void readAttributes(io::IXMLReader *xml);
+    const Attribute *findAttribute(const std::string &name) const;
 
     std::string                          m_file_name;
 
+         XMLNode() {}
+
 public:
          LEAK_CHECK();
          XMLNode(io::IXMLReader *xml);
@@ -66,6 +101,8 @@ public:
 
         ~XMLNode();
 
+    static bool visit(const std::string &filename, Visitor *visitor);
+
     const std::string &getName() const {return m_name; }
     const XMLNode     *getNode(const std::string &name) const;
     const void         getNodes(const std::string &s, std::vector<XMLNode*>& out) const;
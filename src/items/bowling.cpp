@@ -56,7 +56,7 @@ Bowling::Bowling(AbstractKart *kart)
     }
 
     createPhysics(y_offset, btVector3(0.0f, 0.0f, m_speed*2),
-                  new btSphereShape(0.5f*m_extend.getY()),
+                  getSphereShape(),
                   1.0f /*restitution*/,
                   -70.0f /*gravity*/,
                   true /*rotates*/);
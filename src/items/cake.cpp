@@ -90,7 +90,7 @@ Cake::Cake (AbstractKart *kart) : Flyable(kart, PowerupManager::POWERUP_CAKE)
         m_initial_velocity = Vec3(0.0f, up_velocity, m_speed);
 
         createPhysics(forward_offset, m_initial_velocity,
-                      new btCylinderShape(0.5f*m_extend),
+                      getCylinderShape(),
                       0.5f /* restitution */, -m_gravity,
                       true /* rotation */, false /* backwards */, &trans);
     }
@@ -104,7 +104,7 @@ Cake::Cake (AbstractKart *kart) : Flyable(kart, PowerupManager::POWERUP_CAKE)
         m_initial_velocity = Vec3(0.0f, up_velocity, m_speed);
 
         createPhysics(forward_offset, m_initial_velocity,
-                      new btCylinderShape(0.5f*m_extend),
+                      getCylinderShape(),
                       0.5f /* restitution */, -m_gravity,
                       true /* rotation */, backwards, &trans);
     }
@@ -36,6 +36,7 @@
 #include "karts/explosion_animation.hpp"
 #include "modes/world.hpp"
 #include "physics/physics.hpp"
+#include "physics/user_pointer.hpp"
 #include "tracks/track.hpp"
 #include "utils/constants.hpp"
 #include "utils/string_utils.hpp"
@@ -48,6 +49,9 @@ float         Flyable::m_st_min_height  [PowerupManager::POWERUP_MAX];
 float         Flyable::m_st_max_height  [PowerupManager::POWERUP_MAX];
 float         Flyable::m_st_force_updown[PowerupManager::POWERUP_MAX];
 Vec3          Flyable::m_st_extend      [PowerupManager::POWERUP_MAX];
+btCollisionShape* Flyable::m_st_shape   [PowerupManager::POWERUP_MAX];
+std::vector<scene::ISceneNode*>
+              Flyable::m_st_node_pool   [PowerupManager::POWERUP_MAX];
 // ----------------------------------------------------------------------------
 
 Flyable::Flyable(AbstractKart *kart, PowerupManager::PowerupType type,
@@ -71,11 +75,23 @@ Flyable::Flyable(AbstractKart *kart, PowerupManager::PowerupType type,
     m_position_offset              = Vec3(0,0,0);
     m_owner_has_temporary_immunity = true;
     m_do_terrain_info              = true;
+    m_swept_radius                 = 0.0f;
     m_max_lifespan = -1;
 
-    // Add the graphical model
-    setNode(irr_driver->addMesh(m_st_model[type], StringUtils::insertValues("flyable_%i", (int)type)));
-    irr_driver->applyObjectPassShader(getNode());
+    // Add the graphical model, reusing the node of a deleted flyable if
+    // possible.
+    if(!m_st_node_pool[type].empty())
+    {
+        setNode(m_st_node_pool[type].back());
+        m_st_node_pool[type].pop_back();
+        getNode()->setVisible(true);
+    }
+    else
+    {
+        setNode(irr_driver->addMesh(m_st_model[type],
+                         StringUtils::insertValues("flyable_%i", (int)type)));
+        irr_driver->applyObjectPassShader(getNode());
+    }
 #ifdef DEBUG
     std::string debug_name("flyable: ");
     debug_name += type;
@@ -157,6 +173,17 @@ void Flyable::createPhysics(float forw_offset, const Vec3 &velocity,
     m_body->setCollisionFlags(m_body->getCollisionFlags() |
                               btCollisionObject::CF_NO_CONTACT_RESPONSE);
 
+    // Size the continuous collision detection from the shape. Bullet only
+    // uses this for bodies with contact response (e.g. the bowling ball,
+    // which clears the flag above), all others are handled by
+    // checkSweptCollision.
+    btVector3 center;
+    float radius;
+    m_shape->getBoundingSphere(center, radius);
+    m_swept_radius = 0.5f*radius;
+    m_body->setCcdMotionThreshold(m_swept_radius);
+    m_body->setCcdSweptSphereRadius(m_swept_radius);
+    m_previous_position = getXYZ();
 }   // createPhysics
 
 // -----------------------------------------------------------------------------
@@ -190,15 +217,66 @@ void Flyable::init(const XMLNode &node, scene::IMesh *model,
     MeshTools::minMax3D(model, &min, &max);
     m_st_extend[type] = btVector3(max-min);
     m_st_model[type]  = model;
+    // Nodes using the old model can not be reused anymore.
+    for(unsigned int i=0; i<m_st_node_pool[type].size(); i++)
+        irr_driver->removeNode(m_st_node_pool[type][i]);
+    m_st_node_pool[type].clear();
+    // The shape depends on the size, so it must be created again.
+    if(m_st_shape[type])
+    {
+        delete m_st_shape[type];
+        m_st_shape[type] = NULL;
+    }
 }   // init
 
 //-----------------------------------------------------------------------------
 Flyable::~Flyable()
 {
-    if(m_shape) delete m_shape;
+    // The shape is shared by all flyables of this type, and the scene node
+    // is kept to be reused (so that ~Moveable does not remove it).
     World::getWorld()->getPhysics()->removeBody(getBody());
+    if(getNode())
+    {
+        getNode()->setVisible(false);
+        m_st_node_pool[m_type].push_back(getNode());
+        setNode(NULL);
+    }
 }   // ~Flyable
 
+//-----------------------------------------------------------------------------
+/** Removes all scene nodes that were kept for reuse. Must be called before
+ *  the scene is cleared, after all flyables were deleted.
+ */
+void Flyable::clearNodePool()
+{
+    for(unsigned int i=0; i<PowerupManager::POWERUP_MAX; i++)
+    {
+        for(unsigned int j=0; j<m_st_node_pool[i].size(); j++)
+            irr_driver->removeNode(m_st_node_pool[i][j]);
+        m_st_node_pool[i].clear();
+    }
+}   // clearNodePool
+
+//-----------------------------------------------------------------------------
+/** Returns the cylinder collision shape for flyables of this type, creating
+ *  it the first time it is needed. */
+btCollisionShape *Flyable::getCylinderShape()
+{
+    if(!m_st_shape[m_type])
+        m_st_shape[m_type] = new btCylinderShape(0.5f*m_extend);
+    return m_st_shape[m_type];
+}   // getCylinderShape
+
+//-----------------------------------------------------------------------------
+/** Returns the sphere collision shape for flyables of this type, creating
+ *  it the first time it is needed. */
+btCollisionShape *Flyable::getSphereShape()
+{
+    if(!m_st_shape[m_type])
+        m_st_shape[m_type] = new btSphereShape(0.5f*m_extend.getY());
+    return m_st_shape[m_type];
+}   // getSphereShape
+
 //-----------------------------------------------------------------------------
 /** Returns information on what is the closest kart and at what distance it is.
  *  All 3 parameters first are of type 'out'. 'inFrontOf' can be set if you
@@ -217,6 +295,18 @@ void Flyable::getClosestKart(const AbstractKart **minKart,
     *minDistSquared = 999999.9f;
     *minKart = NULL;
 
+    // The heading of the kart to aim from is the same for all karts tested,
+    // so it is computed only once: heading=trans.getBasis*(0,0,1) ... so
+    // save the multiplication.
+    Vec3 heading;
+    float heading_length2 = 0.0f;
+    if(inFrontOf != NULL)
+    {
+        Vec3 direction(inFrontOf->getTrans().getBasis().getColumn(2));
+        heading         = backwards ? -direction : direction;
+        heading_length2 = heading.length2();
+    }
+
     World *world = World::getWorld();
     for(unsigned int i=0 ; i<world->getNumKarts(); i++ )
     {
@@ -237,20 +327,17 @@ void Flyable::getClosestKart(const AbstractKart **minKart,
         if(inFrontOf != NULL)
         {
             // Ignore karts behind the current one
-            Vec3 to_target       = kart->getXYZ() - inFrontOf->getXYZ();
-            const float distance = to_target.length();
-            if(distance > 50) continue; // kart too far, don't aim at it
-
-            btTransform trans = inFrontOf->getTrans();
-            // get heading=trans.getBasis*(0,0,1) ... so save the multiplication:
-            Vec3 direction(trans.getBasis().getColumn(2));
-            // Originally it used angle = to_target.angle( backwards ? -direction : direction );
+            Vec3 to_target           = kart->getXYZ() - inFrontOf->getXYZ();
+            const float target_dist2 = to_target.length2();
+            // kart too far, don't aim at it
+            if(target_dist2 > 50*50) continue;
+
+            // Originally it used angle = to_target.angle(heading);
             // but sometimes due to rounding errors we get an acos(x) with x>1, causing
             // an assertion failure. So we remove the whole acos() test here and copy the
             // code from to_target.angle(...)
-            Vec3  v = backwards ? -direction : direction;
-            float s = sqrt(v.length2() * to_target.length2());
-            float c = to_target.dot(v)/s;
+            float s = sqrt(heading_length2 * target_dist2);
+            float c = to_target.dot(heading)/s;
             // Original test was: fabsf(acos(c))>1,  which is the same as
             // c<cos(1) (acos returns values in [0, pi] anyway)
             if(c<0.54) continue;
@@ -378,6 +465,9 @@ bool Flyable::updateAndDelete(float dt)
         return true;
     }
 
+    if(checkSweptCollision() && m_has_hit_something)
+        return true;
+
     // Add the position offset so that the flyable can adjust its position
     // (usually to do the raycast from a slightly higher position to avoid
     // problems finding the terrain in steep uphill sections).
@@ -414,6 +504,70 @@ bool Flyable::updateAndDelete(float dt)
     return false;
 }   // updateAndDelete
 
+// ----------------------------------------------------------------------------
+/** Sweep callback that only reports the track, and ignores hits where the
+ *  flyable moves away from the surface (i.e. the flyable starts touching
+ *  the track, e.g. a bouncing rubber ball).
+ */
+class TrackSweepCallback : public btCollisionWorld::ClosestConvexResultCallback
+{
+public:
+    TrackSweepCallback(const btVector3 &from, const btVector3 &to)
+        : btCollisionWorld::ClosestConvexResultCallback(from, to) {}
+    // ------------------------------------------------------------------------
+    virtual bool needsCollision(btBroadphaseProxy *proxy) const
+    {
+        const btCollisionObject *object =
+            (const btCollisionObject*)proxy->m_clientObject;
+        const UserPointer *up = (const UserPointer*)object->getUserPointer();
+        return up && up->is(UserPointer::UP_TRACK);
+    }   // needsCollision
+    // ------------------------------------------------------------------------
+    virtual btScalar addSingleResult(btCollisionWorld::LocalConvexResult &result,
+                                     bool normal_in_world_space)
+    {
+        btVector3 normal = normal_in_world_space
+                         ? result.m_hitNormalLocal
+                         : result.m_hitCollisionObject->getWorldTransform()
+                                  .getBasis()*result.m_hitNormalLocal;
+        if(normal.dot(m_convexToWorld-m_convexFromWorld) >= 0)
+            return 1.0f;
+        return ClosestConvexResultCallback::addSingleResult(result,
+                                                        normal_in_world_space);
+    }   // addSingleResult
+};   // TrackSweepCallback
+
+// ----------------------------------------------------------------------------
+/** Tests if the flyable passed through the track since the previous update,
+ *  which can happen if it moves further than its size in one physics step
+ *  (Bullet's continuous collision detection ignores bodies without contact
+ *  response). If so, the flyable is moved back to the point where it first
+ *  touched the track, and hitTrack is called.
+ *  \return True if the track was hit.
+ */
+bool Flyable::checkSweptCollision()
+{
+    const Vec3 from = m_previous_position;
+    const Vec3 &to  = getXYZ();
+    m_previous_position = to;
+    if(m_swept_radius<=0 || (to-from).length2() < m_swept_radius*m_swept_radius)
+        return false;
+
+    btSphereShape sphere(m_swept_radius);
+    btTransform start(btQuaternion(0, 0, 0, 1), from);
+    btTransform end(btQuaternion(0, 0, 0, 1), to);
+    TrackSweepCallback result(from, to);
+    World::getWorld()->getPhysics()->getPhysicsWorld()
+                     ->convexSweepTest(&sphere, start, end, result);
+    if(!result.hasHit())
+        return false;
+
+    m_previous_position = from.lerp(to, result.m_closestHitFraction);
+    setXYZ(m_previous_position);
+    hitTrack();
+    return true;
+}   // checkSweptCollision
+
 // ----------------------------------------------------------------------------
 /** Returns true if the item hit the kart who shot it (to avoid that an item
  *  that's too close to the shooter hits the shooter).
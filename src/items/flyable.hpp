@@ -32,6 +32,9 @@ using namespace irr;
 #include "items/powerup_manager.hpp"
 #include "karts/moveable.hpp"
 #include "tracks/terrain_info.hpp"
+#include "utils/object_pool.hpp"
+
+#include <vector>
 
 class AbstractKart;
 class HitEffect;
@@ -64,6 +67,17 @@ private:
      *  terrain yourself (e.g. order of operations is important)
      *  set this to false with a call do setDoTerrainInfo(). */
     bool              m_do_terrain_info;
+
+    /** Position at the end of the previous update, the swept collision test
+     *  checks the movement from here to the current position. */
+    Vec3              m_previous_position;
+
+    /** Radius of the sphere swept along the movement of this flyable. If
+     *  the flyable moves further than this in one frame it is tested for
+     *  passing through the track. */
+    float             m_swept_radius;
+
+    bool              checkSweptCollision();
 protected:
     /** Kart which shot this flyable. */
     AbstractKart*     m_owner;
@@ -119,6 +133,15 @@ protected:
     /** Size of the model. */
     static Vec3       m_st_extend[PowerupManager::POWERUP_MAX];
 
+    /** The collision shape of each type, which is shared by all flyables
+     *  of this type (the shape only depends on the size of the model). */
+    static btCollisionShape *m_st_shape[PowerupManager::POWERUP_MAX];
+
+    /** Scene nodes of flyables that were deleted, which are hidden and
+     *  reused for the next flyable of the same type. */
+    static std::vector<scene::ISceneNode*>
+                      m_st_node_pool[PowerupManager::POWERUP_MAX];
+
     /** Time since thrown. used so a kart can't hit himself when trying
      *  something, and also to put some time limit to some collectibles */
     float             m_time_since_thrown;
@@ -144,6 +167,9 @@ protected:
                                        float *fire_angle, float *up_velocity);
 
 
+    btCollisionShape *getCylinderShape();
+    btCollisionShape *getSphereShape();
+
     /** init bullet for moving objects like projectiles */
     void              createPhysics(float y_offset,
                                     const Vec3 &velocity,
@@ -161,6 +187,16 @@ public:
     virtual     ~Flyable     ();
     static void  init        (const XMLNode &node, scene::IMesh *model,
                               PowerupManager::PowerupType type);
+    static void  clearNodePool();
+    // ------------------------------------------------------------------------
+    /** Flyables are created and deleted very often, so their memory is
+     *  recycled. */
+    static void *operator new(size_t size)
+                             { return ObjectPool<Flyable>::allocate(size); }
+    // ------------------------------------------------------------------------
+    static void  operator delete(void *p, size_t size)
+                             { ObjectPool<Flyable>::release(p, size);      }
+    // ------------------------------------------------------------------------
     virtual bool              updateAndDelete(float);
     virtual HitEffect*        getHitEffect() const;
     bool                      isOwnerImmunity(const AbstractKart *kart_hit) const;
@@ -285,8 +285,9 @@ void Item::setParent(AbstractKart* parent)
 }   // setParent
 
 //-----------------------------------------------------------------------------
-/** Updated the item - rotates it, takes care of items coming back into
- *  the game after it has been collected.
+/** Updated the item - takes care of items coming back into the game after
+ *  it has been collected. The rotation is done by the item manager, see
+ *  setSpin.
  *  \param dt Time step size.
  */
 void Item::update(float dt)
@@ -315,21 +316,22 @@ void Item::update(float dt)
             }
         }   // time till return < 1
     }   // if collected
-    else
-    {   // not m_collected
-
-        if(!m_rotate || m_node == NULL) return;
-        // have it rotate
-        Vec3 rotation(0, dt*M_PI, 0);
-        core::vector3df r = m_node->getRotation();
-        r.Y += dt*180.0f;
-        if(r.Y>360.0f) r.Y -= 360.0f;
-
-        m_node->setRotation(r);
-        return;
-    }   // not m_collected
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Rotates the item by the given angle around its up axis. The item manager
+ *  computes the angle once per frame for all spinning items, and only calls
+ *  this for items that are close enough to a camera to be seen.
+ *  \param angle The angle in degrees.
+ */
+void Item::setSpin(float angle)
+{
+    core::vector3df r = m_original_hpr.toIrrHPR();
+    r.Y += angle;
+    if(r.Y>360.0f) r.Y -= 360.0f;
+    m_node->setRotation(r);
+}   // setSpin
+
 //-----------------------------------------------------------------------------
 /** Is called when the item is hit by a kart.  It sets the flag that the item
  *  has been collected, and the time to return to the parameter.
@@ -172,6 +172,7 @@ public:
                        TriggerItemListener* trigger);
     virtual       ~Item ();
     void          update  (float delta);
+    void          setSpin (float angle);
     virtual void  collected(const AbstractKart *kart, float t=2.0f);
     void          setParent(AbstractKart* parent);
     void          reset();
@@ -246,6 +247,12 @@ public:
     /** Returns true if this item is currently collected. */
     bool          wasCollected() const { return m_collected;}
     // ------------------------------------------------------------------------
+    /** Returns true if this item is currently spinning. */
+    bool          isSpinning() const
+    {
+        return m_rotate && !m_collected && m_node != NULL;
+    }   // isSpinning
+    // ------------------------------------------------------------------------
     /** Returns true if this item is used up and can be removed. */
     bool          isUsedUp()     const {return m_disappear_counter==0; }
     // ------------------------------------------------------------------------
@@ -269,6 +276,9 @@ public:
     /** Returns the XYZ position of the item. */
     const Vec3&   getXYZ() const { return m_xyz; }
     // ------------------------------------------------------------------------
+    /** Returns the square of the distance at which this item is collected. */
+    float         getDistance2() const { return m_distance_2; }
+    // ------------------------------------------------------------------------
     /** Returns the index of the graph node this item is on. */
     int           getGraphNode() const { return m_graph_node; }
     // ------------------------------------------------------------------------
@@ -18,25 +18,30 @@
 
 #include "items/item_manager.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 #include <sstream>
 
 #include "config/stk_config.hpp"
+#include "graphics/camera.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/material.hpp"
 #include "graphics/material_manager.hpp"
 #include "io/file_manager.hpp"
 #include "karts/abstract_kart.hpp"
 #include "modes/linear_world.hpp"
+#include "modes/world.hpp"
 #include "network/network_manager.hpp"
 #include "network/network_world.hpp"
 #include "tracks/quad_graph.hpp"
 #include "tracks/track.hpp"
+#include "utils/profiler.hpp"
 #include "utils/string_utils.hpp"
 
 #include <IMesh.h>
 #include <IAnimatedMesh.h>
+#include <ICameraSceneNode.h>
 
 std::vector<scene::IMesh *> ItemManager::m_item_mesh;
 std::vector<scene::IMesh *> ItemManager::m_item_lowres_mesh;
@@ -145,6 +150,7 @@ void ItemManager::removeTextures()
 ItemManager::ItemManager()
 {
     m_switch_time = -1.0f;
+    m_spin_time   = 0.0f;
     // The actual loading is done in loadDefaultItems
 
     // Prepare the switch to array, which stores which item should be
@@ -155,6 +161,12 @@ ItemManager::ItemManager()
         m_switch_to.push_back((Item::ItemType)i);
     setSwitchItems(stk_config->m_switch_items);
 
+    m_grid_min_x     = 0;
+    m_grid_min_z     = 0;
+    m_grid_cell_size = 1.0f;
+    m_grid_size_x    = 0;
+    m_grid_size_z    = 0;
+
     if(QuadGraph::get())
     {
         m_items_in_quads = new std::vector<AllItemTypes>;
@@ -197,6 +209,81 @@ ItemManager::~ItemManager()
     m_all_items.clear();
 }   // ~ItemManager
 
+//-----------------------------------------------------------------------------
+/** Creates the (empty) item grid covering the bounding box of the track.
+ *  The cells are 5m wide (items are collected at around 1m distance), but
+ *  at most 128x128 cells are used.
+ */
+void ItemManager::initItemGrid()
+{
+    const Vec3 *min, *max;
+    World::getWorld()->getTrack()->getAABB(&min, &max);
+    const float size_x = std::max(max->getX()-min->getX(), 0.0f);
+    const float size_z = std::max(max->getZ()-min->getZ(), 0.0f);
+    m_grid_cell_size = std::max(5.0f, std::max(size_x, size_z)/128.0f);
+    m_grid_min_x     = min->getX();
+    m_grid_min_z     = min->getZ();
+    m_grid_size_x    = (int)(size_x/m_grid_cell_size)+1;
+    m_grid_size_z    = (int)(size_z/m_grid_cell_size)+1;
+    m_item_grid.clear();
+    m_item_grid.resize(m_grid_size_x*m_grid_size_z);
+}   // initItemGrid
+
+//-----------------------------------------------------------------------------
+/** Returns the column of the item grid for a X coordinate. Coordinates
+ *  outside of the grid are clamped to the first or last column. */
+int ItemManager::getGridCellX(float x) const
+{
+    int i = (int)floorf((x-m_grid_min_x)/m_grid_cell_size);
+    return i<0 ? 0 : (i>=m_grid_size_x ? m_grid_size_x-1 : i);
+}   // getGridCellX
+
+//-----------------------------------------------------------------------------
+/** Returns the row of the item grid for a Z coordinate. Coordinates
+ *  outside of the grid are clamped to the first or last row. */
+int ItemManager::getGridCellZ(float z) const
+{
+    int i = (int)floorf((z-m_grid_min_z)/m_grid_cell_size);
+    return i<0 ? 0 : (i>=m_grid_size_z ? m_grid_size_z-1 : i);
+}   // getGridCellZ
+
+//-----------------------------------------------------------------------------
+/** Adds an item to or removes it from all cells of the item grid which
+ *  overlap the area in which the item can be collected. The items in each
+ *  cell are kept sorted by item id, so that checkItemHit tests them in the
+ *  same order as the list of all items.
+ *  \param item The item to add or remove.
+ *  \param insert True if the item is added, false if it is removed.
+ */
+void ItemManager::updateItemGrid(Item *item, bool insert)
+{
+    if(m_item_grid.empty())
+        initItemGrid();
+    const Vec3 &xyz    = item->getXYZ();
+    const float radius = sqrtf(item->getDistance2());
+    const int x0 = getGridCellX(xyz.getX()-radius);
+    const int x1 = getGridCellX(xyz.getX()+radius);
+    const int z0 = getGridCellZ(xyz.getZ()-radius);
+    const int z1 = getGridCellZ(xyz.getZ()+radius);
+    for(int z=z0; z<=z1; z++)
+    {
+        for(int x=x0; x<=x1; x++)
+        {
+            AllItemTypes &items = m_item_grid[z*m_grid_size_x+x];
+            AllItemTypes::iterator it = items.begin();
+            while(it!=items.end() && (*it)->getItemId()<item->getItemId())
+                it++;
+            if(insert)
+                items.insert(it, item);
+            else
+            {
+                assert(it!=items.end() && *it==item);
+                items.erase(it);
+            }
+        }   // for x
+    }   // for z
+}   // updateItemGrid
+
 //-----------------------------------------------------------------------------
 /** Inserts the new item into the items management data structures, if possible
  *  reusing an existing, unused entry (e.g. due to a removed bubble gum). Then
@@ -231,6 +318,8 @@ void ItemManager::insertItem(Item *item)
         else  // otherwise store it in the 'outside' index
             (*m_items_in_quads)[m_items_in_quads->size()-1].push_back(item);
     }   // if m_items_in_quads
+
+    updateItemGrid(item, /*insert*/true);
 }   // insertItem
 
 //-----------------------------------------------------------------------------
@@ -300,33 +389,31 @@ void ItemManager::collectedItem(Item *item, AbstractKart *kart, int add_info)
  */
 void  ItemManager::checkItemHit(AbstractKart* kart)
 {
-    // We could use m_items_in_quads to to check for item hits: take the quad
-    // of the graph node of the kart, and only check items in that quad. But
-    // then we also need to check for any adjacent quads (since an item just
-    // on the order of one quad might get hit from an adjacent quad). Then
-    // it is possible that a quad is that short that we need to test adjacent
-    // of adjacent quads. And check for items outside of the track.
-    // Since at this stace item detection is by far not a bottle neck,
-    // the original, simple and stable algorithm is left in place.
-
-    for(AllItemTypes::iterator i =m_all_items.begin();
-        i!=m_all_items.end();  i++)
+    // Only the items in the grid cell of the kart can be hit. The items
+    // are accessed by index, since collecting an item might add a new item
+    // (e.g. a trigger running a script). Used up items are only removed
+    // in update().
+    const Vec3 &xyz = kart->getXYZ();
+    const AllItemTypes &items = getItemsNear(xyz);
+    PROFILER_COUNT("Items checked", items.size());
+    for(unsigned int i=0; i<items.size(); i++)
     {
-        if((!*i) || (*i)->wasCollected()) continue;
+        Item *item = items[i];
+        if(item->wasCollected()) continue;
         // To allow inlining and avoid including kart.hpp in item.hpp,
         // we pass the kart and the position separately.
-        if((*i)->hitKart(kart->getXYZ(), kart))
+        if(item->hitKart(xyz, kart))
         {
             // if we're not playing online, pick the item.
             if (!NetworkWorld::getInstance()->isRunning())
-                collectedItem(*i, kart);
+                collectedItem(item, kart);
             else if (NetworkManager::getInstance()->isServer())
             {
-                collectedItem(*i, kart);
-                NetworkWorld::getInstance()->collectedItem(*i, kart);
+                collectedItem(item, kart);
+                NetworkWorld::getInstance()->collectedItem(item, kart);
             }
         }   // if hit
-    }   // for m_all_items
+    }   // for items
 }   // checkItemHit
 
 //-----------------------------------------------------------------------------
@@ -371,6 +458,7 @@ void ItemManager::reset()
     }  // whilem_all_items.end() i
 
     m_switch_time = -1;
+    m_spin_time   = 0.0f;
 }   // reset
 
 //-----------------------------------------------------------------------------
@@ -394,6 +482,19 @@ void ItemManager::update(float dt)
         }   // m_switch_time < 0
     }   // m_switch_time>=0
 
+    // All items spin with the same angle. Items further away from all
+    // cameras than the most distant level of their LOD node (see Item::Item)
+    // are hidden, so they are not rotated at all.
+    m_spin_time += dt;
+    const float spin_angle = fmodf(m_spin_time*180.0f, 360.0f);
+    const float max_distance2 = 100.0f*100.0f;
+    std::vector<Vec3> cameras;
+    for(unsigned int i=0; i<Camera::getNumCameras(); i++)
+    {
+        cameras.push_back(Vec3(Camera::getCamera(i)->getCameraSceneNode()
+                                                   ->getPosition()));
+    }
+
     for(AllItemTypes::iterator i =m_all_items.begin();
         i!=m_all_items.end();  i++)
     {
@@ -403,7 +504,18 @@ void ItemManager::update(float dt)
             if( (*i)->isUsedUp())
             {
                 deleteItem( *i );
+                continue;
             }   // if usedUp
+            if(!(*i)->isSpinning())
+                continue;
+            for(unsigned int c=0; c<cameras.size(); c++)
+            {
+                if((cameras[c]-(*i)->getXYZ()).length2() < max_distance2)
+                {
+                    (*i)->setSpin(spin_angle);
+                    break;
+                }
+            }   // for c
         }   // if *i
     }   // for m_all_items
 }   // update
@@ -416,20 +528,21 @@ void ItemManager::update(float dt)
 void ItemManager::deleteItem(Item *item)
 {
     // First check if the item needs to be removed from the items-in-quad list
+    // (using the same quad as insertItem).
     if(m_items_in_quads)
     {
-        const Vec3 &xyz = item->getXYZ();
-        int sector = QuadGraph::UNKNOWN_SECTOR;
-        QuadGraph::get()->findRoadSector(xyz, &sector);
-        unsigned int indx = sector==QuadGraph::UNKNOWN_SECTOR
+        const int graph_node = item->getGraphNode();
+        unsigned int indx = graph_node==-1
                           ? (unsigned int) m_items_in_quads->size()-1
-                          : sector;
+                          : QuadGraph::get()->getNode(graph_node).getQuadIndex();
         AllItemTypes &items = (*m_items_in_quads)[indx];
         AllItemTypes::iterator it = std::find(items.begin(), items.end(),item);
         assert(it!=items.end());
         items.erase(it);
     }   // if m_items_in_quads
 
+    updateItemGrid(item, /*insert*/false);
+
     int index = item->getItemId();
     m_all_items[index] = NULL;
     delete item;
@@ -82,6 +82,19 @@ private:
      *  field is undefined if no QuadGraph exist, e.g. in battle mode. */
     std::vector< AllItemTypes > *m_items_in_quads;
 
+    /** A uniform grid in the XZ plane over the track, each cell storing
+     *  (sorted by item id) all items which can be collected by a kart in
+     *  this cell. Unlike m_items_in_quads this also works for off-road
+     *  items and in arenas. Positions outside of the track are clamped to
+     *  the border cells. The grid is created when the first item is
+     *  inserted (since the track's bounding box is not known before). */
+    std::vector< AllItemTypes > m_item_grid;
+    float m_grid_min_x;
+    float m_grid_min_z;
+    float m_grid_cell_size;
+    int   m_grid_size_x;
+    int   m_grid_size_z;
+
     /** What item this item is switched to. */
     std::vector<Item::ItemType> m_switch_to;
 
@@ -89,8 +102,16 @@ private:
      *  value is <0, it indicates that the items are not switched atm. */
     float m_switch_time;
 
+    /** Time the items have been spinning, which determines the angle of
+     *  all spinning items. */
+    float m_spin_time;
+
     void  insertItem(Item *item);
     void  deleteItem(Item *item);
+    void  initItemGrid();
+    int   getGridCellX(float x) const;
+    int   getGridCellZ(float z) const;
+    void  updateItemGrid(Item *item, bool insert);
 
     // Make those private so only create/destroy functions can call them.
                    ItemManager();
@@ -119,6 +140,19 @@ public:
     /** Returns a pointer to the n-th item. */
     Item* getItem(unsigned int n)  { return m_all_items[n]; };
     // ------------------------------------------------------------------------
+    /** Returns all items that might be collected by a kart at the given
+     *  position, i.e. a superset of the items for which Item::hitKart is
+     *  true (in the order of their item ids).
+     *  \param xyz The position to test.
+     */
+    const AllItemTypes& getItemsNear(const Vec3 &xyz) const
+    {
+        static const AllItemTypes no_items;
+        if(m_item_grid.empty()) return no_items;
+        return m_item_grid[getGridCellZ(xyz.getZ())*m_grid_size_x
+                          +getGridCellX(xyz.getX())            ];
+    }   // getItemsNear
+    // ------------------------------------------------------------------------
     /** Returns a reference to the array of all items on the specified quad.
      */
     const AllItemTypes& getItemsInQuads(unsigned int n) const
@@ -78,14 +78,14 @@ Plunger::Plunger(AbstractKart *kart)
         m_initial_velocity = btVector3(0.0f, up_velocity, plunger_speed);
 
         createPhysics(forward_offset, m_initial_velocity,
-                      new btCylinderShape(0.5f*m_extend),
+                      getCylinderShape(),
                       0.5f /* restitution */ , gravity,
                       /* rotates */false , /*turn around*/false, &trans);
     }
     else
     {
         createPhysics(forward_offset, btVector3(pitch, 0.0f, plunger_speed),
-                      new btCylinderShape(0.5f*m_extend),
+                      getCylinderShape(),
                       0.5f /* restitution */, gravity,
                       false /* rotates */, m_reverse_mode, &kart_transform);
     }
@@ -59,6 +59,9 @@ public:
      */
     void         setKeepAlive(float t) {m_keep_alive = t;}
     // ------------------------------------------------------------------------
+    /** Returns the rubber band of this plunger, or NULL in reverse mode. */
+    RubberBand  *getRubberBand() { return m_rubber_band; }
+    // ------------------------------------------------------------------------
     /** No hit effect when it ends. */
     virtual HitEffect *getHitEffect() const {return NULL; }
     // ------------------------------------------------------------------------
@@ -26,6 +26,7 @@
 #include "items/powerup_manager.hpp"
 #include "items/powerup.hpp"
 #include "items/rubber_ball.hpp"
+#include "items/rubber_band.hpp"
 #include "karts/abstract_kart.hpp"
 
 ProjectileManager *projectile_manager=0;
@@ -52,6 +53,8 @@ void ProjectileManager::cleanup()
     }
 
     m_active_projectiles.clear();
+    Flyable::clearNodePool();
+
     for(HitEffects::iterator i  = m_active_hit_effects.begin();
         i != m_active_hit_effects.end(); ++i)
     {
@@ -67,51 +70,83 @@ void ProjectileManager::update(float dt)
 {
     updateServer(dt);
 
-    HitEffects::iterator he = m_active_hit_effects.begin();
-    while(he!=m_active_hit_effects.end())
+    // Finished hit effects are removed by moving the remaining ones to the
+    // front, instead of erasing each one (which moves all following ones).
+    unsigned int kept = 0;
+    for(unsigned int i=0; i<m_active_hit_effects.size(); i++)
     {
+        HitEffect *he = m_active_hit_effects[i];
         // While this shouldn't happen, we had one crash because of this
-        if(!(*he))
-        {
-            HitEffects::iterator next = m_active_hit_effects.erase(he);
-            he = next;
-        }
+        if(!he)
+            continue;
         // Update this hit effect. If it can be removed, remove it.
-        else if((*he)->updateAndDelete(dt))
-        {
-            delete *he;
-            HitEffects::iterator next = m_active_hit_effects.erase(he);
-            he = next;
-        }   // if hit effect finished
-        else  // hit effect not finished, go to next one.
-            he++;
-    }   // while hit effect != end
+        if(he->updateAndDelete(dt))
+            delete he;
+        else  // hit effect not finished, keep it.
+            m_active_hit_effects[kept++] = he;
+    }   // for i < m_active_hit_effects.size()
+    m_active_hit_effects.resize(kept);
 }   // update
 
 // -----------------------------------------------------------------------------
 /** Updates all rockets on the server (or no networking). */
 void ProjectileManager::updateServer(float dt)
 {
-    Projectiles::iterator p = m_active_projectiles.begin();
-    while(p!=m_active_projectiles.end())
+    // Cast the rays of all rubber bands in one batch. The plungers take
+    // their positions from physics first, as their update would do.
+    std::vector<RubberBand*> bands;
+    for(unsigned int i=0; i<m_active_projectiles.size(); i++)
+    {
+        Plunger *plunger = dynamic_cast<Plunger*>(m_active_projectiles[i]);
+        if(!plunger || !plunger->getRubberBand())
+            continue;
+        plunger->updatePosition();
+        bands.push_back(plunger->getRubberBand());
+    }
+    if(!bands.empty())
+        RubberBand::castRays(bands);
+
+    // As for the hit effects, the remaining projectiles are moved to the
+    // front in one pass, keeping their order.
+    unsigned int kept = 0;
+    for(unsigned int i=0; i<m_active_projectiles.size(); i++)
     {
-        bool can_be_deleted = (*p)->updateAndDelete(dt);
+        Flyable *f = m_active_projectiles[i];
+        bool can_be_deleted = f->updateAndDelete(dt);
         if(can_be_deleted)
         {
-            HitEffect *he = (*p)->getHitEffect();
+            HitEffect *he = f->getHitEffect();
             if(he)
                 addHitEffect(he);
-            Flyable *f=*p;
-            Projectiles::iterator p_next=m_active_projectiles.erase(p);
             delete f;
-            p=p_next;
         }
         else
-            p++;
-    }   // while p!=m_active_projectiles.end()
-    
+            m_active_projectiles[kept++] = f;
+    }   // for i < m_active_projectiles.size()
+    m_active_projectiles.resize(kept);
+
 }   // updateServer
 
+// -----------------------------------------------------------------------------
+/** Saves the graphical state of all projectiles after a simulation tick,
+ *  see Moveable::saveGraphicsState. */
+void ProjectileManager::saveGraphicsStates()
+{
+    for (Projectiles::iterator p  = m_active_projectiles.begin();
+                               p != m_active_projectiles.end(); ++p)
+        (*p)->saveGraphicsState();
+}   // saveGraphicsStates
+
+// -----------------------------------------------------------------------------
+/** Interpolates the graphical state of all projectiles between the last two
+ *  simulation ticks, see Moveable::interpolateGraphics. */
+void ProjectileManager::interpolateGraphics(float alpha)
+{
+    for (Projectiles::iterator p  = m_active_projectiles.begin();
+                               p != m_active_projectiles.end(); ++p)
+        (*p)->interpolateGraphics(alpha);
+}   // interpolateGraphics
+
 // -----------------------------------------------------------------------------
 /** Creates a new projectile of the given type.
  *  \param kart The kart which shoots the projectile.
@@ -134,22 +169,3 @@ Flyable *ProjectileManager::newProjectile(AbstractKart *kart,
     return f;
 }   // newProjectile
 
-// -----------------------------------------------------------------------------
-/** Returns true if a projectile is within the given distance of the specified
- *  kart.
- *  \param kart The kart for which the test is done.
- *  \param radius Distance within which the projectile must be.
-*/
-bool ProjectileManager::projectileIsClose(const AbstractKart * const kart,
-                                         float radius)
-{
-    float r2 = radius*radius;
-
-    for(Projectiles::iterator i  = m_active_projectiles.begin();
-                              i != m_active_projectiles.end();   i++)
-    {
-        float dist2 = (*i)->getXYZ().distance2(kart->getXYZ());
-        if(dist2<r2) return true;
-    }
-    return false;
-}   // projectileIsClose
@@ -59,12 +59,16 @@ public:
     void             loadData         ();
     void             cleanup          ();
     void             update           (float dt);
+    void             saveGraphicsStates();
+    void             interpolateGraphics(float alpha);
     Flyable*         newProjectile    (AbstractKart *kart,
                                        PowerupManager::PowerupType type);
     void             Deactivate       (Flyable *p) {}
     void             removeTextures   ();
-    bool             projectileIsClose(const AbstractKart * const kart,
-                                       float radius);
+    // ------------------------------------------------------------------------
+    /** Returns all projectiles which are currently moving on the track. */
+    const std::vector<Flyable*>& getActiveProjectiles() const
+                                               { return m_active_projectiles; }
     // ------------------------------------------------------------------------
     /** Adds a special hit effect to be shown.
      *  \param hit_effect The hit effect to be added. */
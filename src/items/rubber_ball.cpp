@@ -66,7 +66,7 @@ RubberBall::RubberBall(AbstractKart *kart)
     float forw_offset = 0.5f*kart->getKartLength() + m_extend.getZ()*0.5f+5.0f;
 
     createPhysics(forw_offset, btVector3(0.0f, 0.0f, m_speed*2),
-                  new btSphereShape(0.5f*m_extend.getY()),
+                  getSphereShape(),
                   -70.0f /*gravity*/,
                   true /*rotates*/);
 
@@ -377,9 +377,6 @@ bool RubberBall::updateAndDelete(float dt)
     m_previous_height = next_xyz.getY()-getHoT();
     setXYZ(next_xyz);
 
-    if(checkTunneling())
-        return true;
-
     // Determine new distance along track
     TrackSector::update(next_xyz);
 
@@ -390,7 +387,26 @@ bool RubberBall::updateAndDelete(float dt)
     else
         m_node->setScale(core::vector3df(1.0f, 1.0f, 1.0f));
 
-    return Flyable::updateAndDelete(dt);
+    // The swept collision test in Flyable::updateAndDelete keeps the ball
+    // from tunneling through the track, and calls hitTrack if it had to
+    // move the ball. If this happens four frames in a row the ball is
+    // considered stuck (e.g. it might try to tunnel through a wall to get
+    // to a 'close' target) and explodes.
+    const unsigned int tunnel_count = m_tunnel_count;
+    if(Flyable::updateAndDelete(dt))
+        return true;
+    if(m_tunnel_count==tunnel_count)
+        m_tunnel_count = 0;
+    else if(m_tunnel_count > 3)
+    {
+#ifdef PRINT_BALL_REMOVE_INFO
+        Log::debug("[RubberBall]", "Ball %d nearly tunneled at %f %f %f",
+                   m_id, getXYZ().getX(), getXYZ().getY(), getXYZ().getZ());
+#endif
+        hit(NULL);
+        return true;
+    }
+    return false;
 }   // updateAndDelete
 
 // ----------------------------------------------------------------------------
@@ -479,53 +495,6 @@ void RubberBall::interpolate(Vec3 *next_xyz, float dt)
     assert(!isnan((*next_xyz)[2]));
 }   // interpolate
 
-// ----------------------------------------------------------------------------
-/** Checks if the line from the previous ball position to the new position
- *  hits something, which indicates that the ball is tunneling through. If
- *  this happens, the ball position is adjusted so that it is just before
- *  the hit point. If tunneling happens four frames in a row the ball is
- *  considered stuck and explodes (e.g. the ball might try to tunnel through
- *  a wall to get to a 'close' target. In this case the ball would not
- *  move much anymore and be stuck).
- *  \return True if the ball tunneled often enough to be removed.
- */
-bool RubberBall::checkTunneling()
-{
-    const TriangleMesh &tm = World::getWorld()->getTrack()->getTriangleMesh();
-    Vec3 hit_point;
-    const Material *material;
-
-    tm.castRay(m_previous_xyz, getXYZ(), &hit_point, &material);
-
-    if(material)
-    {
-        // If there are three consecutive tunnelling
-        m_tunnel_count++;
-        if(m_tunnel_count > 3)
-        {
-#ifdef PRINT_BALL_REMOVE_INFO
-            Log::debug("[RubberBall]",
-                       "Ball %d nearly tunneled at %f %f %f -> %f %f %f",
-                        m_id, m_previous_xyz.getX(),m_previous_xyz.getY(),
-                        m_previous_xyz.getZ(),
-                        getXYZ().getX(),getXYZ().getY(),getXYZ().getZ());
-#endif
-            hit(NULL);
-            return true;
-        }
-        // In case of a hit, move the hit point towards the
-        // previous point by the radius of the ball --> this
-        // point will just allow the ball to avoid tunneling.
-        Vec3 diff = m_previous_xyz - hit_point;
-        hit_point += diff * (1.1f*m_extend.getY()/diff.length());
-        setXYZ(hit_point);
-        return false;
-    }
-    else
-        m_tunnel_count = 0;
-    return false;
-}   // checkTunneling
-
 // ----------------------------------------------------------------------------
 /** Updates the height of the rubber ball, and if necessary also adjusts the
  *  maximum height of the ball depending on distance from the target. The
@@ -599,6 +568,10 @@ float RubberBall::updateHeight()
  */
 float RubberBall::getMaxTerrainHeight(const Vec3 &vertical_offset) const
 {
+    // Most graph nodes have nothing above them, which is cached
+    if(!QuadGraph::get()->hasTerrainAbove(getCurrentGraphNode(), getXYZ()))
+        return 99999.f;
+
     const TriangleMesh &tm = World::getWorld()->getTrack()->getTriangleMesh();
     Vec3 to(getXYZ());
     to.setY(10000.0f);
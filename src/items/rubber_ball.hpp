@@ -179,9 +179,9 @@ private:
      *  used to keep track of the state of this ball. */
     bool         m_aiming_at_target;
 
-    /** This variable counts how often a ball tunneled (in consecutive
-     *  frames). If a ball tunnels a certain number of times, it is
-     *  considered stuck and will be removed. */
+    /** This variable counts how often a ball tried to tunnel through the
+     *  track (in consecutive frames). If a ball tunnels a certain number of
+     *  times, it is considered stuck and will be removed. */
     unsigned int m_tunnel_count;
 
     /** A 'ping' sound effect to be played when the ball hits the ground. */
@@ -197,13 +197,18 @@ private:
     void         moveTowardsTarget(Vec3 *next_xyz, float dt);
     void         initializeControlPoints(const Vec3 &xyz);
     float        getMaxTerrainHeight(const Vec3 &vertical_offset) const;
-    bool         checkTunneling();
 public:
                  RubberBall  (AbstractKart* kart);
     virtual     ~RubberBall();
     static  void init(const XMLNode &node, scene::IMesh *rubberball);
     virtual bool updateAndDelete(float dt);
     virtual bool hit(AbstractKart* kart, PhysicalObject* obj=NULL);
+    // ------------------------------------------------------------------------
+    /** Called by the swept collision test of Flyable when the ball would
+     *  have tunneled through the track (it was moved back in front of the
+     *  hit point). */
+    virtual void hitTrack() { m_tunnel_count++; }
+    // ------------------------------------------------------------------------
     static float getTimeBetweenRubberBalls()    {return m_time_between_balls;}
     // ------------------------------------------------------------------------
     /** This object does not create an explosion, all affects on
@@ -30,7 +30,9 @@
 #include "karts/max_speed.hpp"
 #include "modes/world.hpp"
 #include "physics/physics.hpp"
+#include "physics/triangle_mesh.hpp"
 #include "race/race_manager.hpp"
+#include "tracks/track.hpp"
 #include "utils/string_utils.hpp"
 #include "graphics/glwrap.hpp"
 
@@ -58,6 +60,8 @@ RubberBand::RubberBand(Plunger *plunger, AbstractKart *kart)
     m_mesh           = irr_driver->createQuadMesh(&m, /*create_one_quad*/ true);
     m_buffer         = m_mesh->getMeshBuffer(0);
     m_attached_state = RB_TO_PLUNGER;
+    m_has_batch_result = false;
+    m_batch_track_hit  = false;
     assert(m_buffer->getVertexType()==video::EVT_STANDARD);
 
     // Set the vertex colors properly, as the new pipeline doesn't use the old light values
@@ -194,32 +198,104 @@ void RubberBand::update(float dt)
 }   // update
 
 // ----------------------------------------------------------------------------
-/** Uses a raycast to see if anything has hit the rubber band.
+/** Casts the rays of all rubber bands that are still attached to their
+ *  plunger against the track mesh in one batch (see
+ *  TriangleMesh::castRays), which is the expensive part of their hit test.
+ *  Called by the projectile manager before the plungers are updated, after
+ *  their positions were taken from physics.
+ *  \param bands The rubber bands of all active plungers.
+ */
+void RubberBand::castRays(const std::vector<RubberBand*> &bands)
+{
+    std::vector<TriangleMesh::RayQuery> rays;
+    std::vector<RubberBand*> casting;
+    rays.reserve(bands.size());
+    casting.reserve(bands.size());
+    for(unsigned int i=0; i<bands.size(); i++)
+    {
+        RubberBand *band = bands[i];
+        if(band->m_attached_state!=RB_TO_PLUNGER ||
+           band->m_owner->isEliminated())
+            continue;
+        TriangleMesh::RayQuery ray;
+        ray.m_from = band->m_owner->getXYZ();
+        ray.m_to   = band->m_plunger->getXYZ();
+        rays.push_back(ray);
+        casting.push_back(band);
+    }
+
+    World::getWorld()->getTrack()->getTriangleMesh().castRays(&rays);
+
+    for(unsigned int i=0; i<casting.size(); i++)
+    {
+        RubberBand *band        = casting[i];
+        band->m_has_batch_result = true;
+        band->m_batch_from       = rays[i].m_from;
+        band->m_batch_to         = rays[i].m_to;
+        band->m_batch_track_hit  = rays[i].m_material!=NULL;
+        band->m_batch_hit_point  = rays[i].m_hit_point;
+    }
+}   // castRays
+
+// ----------------------------------------------------------------------------
+/** Uses a raycast to see if anything has hit the rubber band. The track
+ *  mesh is tested by the batched ray of castRays (or by a single ray if the
+ *  band has moved since then), all other objects by a raycast against the
+ *  physics world that skips the track.
  *  \param k Position of the kart = one end of the rubber band
  *  \param p Position of the plunger = other end of the rubber band.
  */
 void RubberBand::checkForHit(const Vec3 &k, const Vec3 &p)
 {
-    btCollisionWorld::ClosestRayResultCallback ray_callback(k, p);
-    // Disable raycast collision detection for this plunger and this kart!
-    short int old_plunger_group = m_plunger->getBody()->getBroadphaseHandle()->m_collisionFilterGroup;
-    short int old_kart_group=0;
-
-    // If the owner is being rescued, the broadphase handle does not exist!
-    if(m_owner->getBody()->getBroadphaseHandle())
-        old_kart_group = m_owner->getBody()->getBroadphaseHandle()->m_collisionFilterGroup;
-    m_plunger->getBody()->getBroadphaseHandle()->m_collisionFilterGroup = 0;
-    if(m_owner->getBody()->getBroadphaseHandle())
-        m_owner->getBody()->getBroadphaseHandle()->m_collisionFilterGroup = 0;
-
-    // Do the raycast
+    const TriangleMesh &track_mesh =
+                                World::getWorld()->getTrack()->getTriangleMesh();
+    bool track_hit;
+    Vec3 track_hit_point;
+    if(m_has_batch_result && m_batch_from==k && m_batch_to==p)
+    {
+        track_hit       = m_batch_track_hit;
+        track_hit_point = m_batch_hit_point;
+    }
+    else
+    {
+        const Material *material;
+        track_hit = track_mesh.castRay(k, p, &track_hit_point, &material);
+    }
+    m_has_batch_result = false;
+
+    /** Skips this plunger, the kart that shot it, and the track mesh. */
+    class BandRayCallback : public btCollisionWorld::ClosestRayResultCallback
+    {
+    public:
+        const btCollisionObject *m_plunger, *m_owner;
+        const TriangleMesh      *m_track_mesh;
+        BandRayCallback(const btVector3 &from, const btVector3 &to)
+            : btCollisionWorld::ClosestRayResultCallback(from, to) {}
+        virtual bool needsCollision(btBroadphaseProxy *proxy) const
+        {
+            const btCollisionObject *object =
+                                   (btCollisionObject*)proxy->m_clientObject;
+            if(object==m_plunger || object==m_owner)
+                return false;
+            const UserPointer *up = (UserPointer*)object->getUserPointer();
+            if(up && up->is(UserPointer::UP_TRACK) &&
+               up->getPointerTriangleMesh()==m_track_mesh)
+                return false;
+            return ClosestRayResultCallback::needsCollision(proxy);
+        }
+    };   // BandRayCallback
+
+    BandRayCallback ray_callback(k, p);
+    ray_callback.m_plunger    = m_plunger->getBody();
+    ray_callback.m_owner      = m_owner->getBody();
+    ray_callback.m_track_mesh = &track_mesh;
     World::getWorld()->getPhysics()->getPhysicsWorld()->rayTest(k, p,
                                                                 ray_callback);
-    // Reset collision groups
-    m_plunger->getBody()->getBroadphaseHandle()->m_collisionFilterGroup = old_plunger_group;
-    if(m_owner->getBody()->getBroadphaseHandle())
-        m_owner->getBody()->getBroadphaseHandle()->m_collisionFilterGroup = old_kart_group;
-    if(ray_callback.hasHit())
+
+    // Use whichever of the two hits is closer to the kart
+    if(ray_callback.hasHit() &&
+       (!track_hit || (ray_callback.m_hitPointWorld-k).length2()
+                      < (track_hit_point-k).length2()))
     {
         Vec3 pos(ray_callback.m_hitPointWorld);
         UserPointer *up = (UserPointer*)ray_callback.m_collisionObject->getUserPointer();
@@ -228,6 +304,8 @@ void RubberBand::checkForHit(const Vec3 &k, const Vec3 &p)
         else
             hit(NULL, &pos);
     }  // if raycast hast hit
+    else if(track_hit)
+        hit(NULL, &track_hit_point);
 
 }   // checkForHit
 
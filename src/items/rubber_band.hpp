@@ -22,6 +22,8 @@
 #include "utils/no_copy.hpp"
 #include "utils/vec3.hpp"
 
+#include <vector>
+
 namespace irr
 {
     namespace scene { class ISceneNode; class IMesh; class IMeshBuffer; }
@@ -63,6 +65,15 @@ private:
      *  plunger. */
     Vec3                m_end_position;
 
+    /** True if castRays has cast the track ray of the next hit check. */
+    bool                m_has_batch_result;
+    /** The ray cast by castRays, its result is only used if the band has
+     *  not moved since then. */
+    Vec3                m_batch_from, m_batch_to;
+    /** True if the batched ray hit the track, and where. */
+    bool                m_batch_track_hit;
+    Vec3                m_batch_hit_point;
+
     void checkForHit(const Vec3 &k, const Vec3 &p);
     void updatePosition();
 
@@ -71,5 +82,6 @@ public:
         ~RubberBand();
     void update(float dt);
     void hit(AbstractKart *kart_hit, const Vec3 *track_xyz=NULL);
+    static void castRays(const std::vector<RubberBand*> &bands);
 };   // RubberBand
 #endif
@@ -39,18 +39,19 @@ AbstractKart::AbstractKart(const std::string& ident,
              : Moveable()
 {
     m_world_kart_id   = world_kart_id;
-    m_kart_properties = kart_properties_manager->getKart(ident);
+    m_kart_properties = kart_properties_manager->getLoadedKart(ident);
     m_difficulty = difficulty;
     m_kart_animation  = NULL;
     assert(m_kart_properties != NULL);
+    m_physics_constants.init(m_kart_properties, m_difficulty);
 
     // We have to take a copy of the kart model, since otherwise
     // the animations will be mixed up (i.e. different instances of
     // the same model will set different animation frames).
     // Technically the mesh in m_kart_model needs to be grab'ed and
     // released when the kart is deleted, but since the original
-    // kart_model is stored in the kart_properties all the time,
-    // there is no risk of a mesh being deleted to early.
+    // kart_model is stored in the kart_properties until the world is
+    // deleted, there is no risk of a mesh being deleted to early.
     m_kart_model  = m_kart_properties->getKartModelCopy();
     m_kart_width  = m_kart_model->getWidth();
     m_kart_height = m_kart_model->getHeight();
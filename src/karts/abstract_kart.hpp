@@ -22,6 +22,7 @@
 #include "items/powerup_manager.hpp"
 #include "karts/moveable.hpp"
 #include "karts/controller/kart_control.hpp"
+#include "karts/kart_physics_constants.hpp"
 #include "karts/player_difficulty.hpp"
 #include "race/race_manager.hpp"
 
@@ -75,6 +76,10 @@ protected:
     /** The per-player difficulty. */
     const PlayerDifficulty *m_difficulty;
 
+    /** The properties used on each physics update, computed from the kart
+     *  properties and the difficulties. */
+    KartPhysicsConstants m_physics_constants;
+
     /** This stores a copy of the kart model. It has to be a copy
      *  since otherwise incosistencies can happen if the same kart
      *  is used more than once. */
@@ -123,7 +128,15 @@ public:
                             { return m_kart_properties; }
     // ------------------------------------------------------------------------
     /** Sets the kart properties. */
-    void setKartProperties(const KartProperties *kp) { m_kart_properties=kp; }
+    void setKartProperties(const KartProperties *kp)
+    {
+        m_kart_properties = kp;
+        m_physics_constants.init(m_kart_properties, m_difficulty);
+    }   // setKartProperties
+    // ------------------------------------------------------------------------
+    /** Returns the kart properties used on each physics update. */
+    const KartPhysicsConstants& getPhysicsConstants() const
+                            { return m_physics_constants; }
 
     // ========================================================================
     // Access to the per-player difficulty.
@@ -133,7 +146,11 @@ public:
                             { return m_difficulty; }
     // ------------------------------------------------------------------------
     /** Sets the per-player difficulty. */
-    void setPlayerDifficulty(const PlayerDifficulty *pd) { m_difficulty=pd; }
+    void setPlayerDifficulty(const PlayerDifficulty *pd)
+    {
+        m_difficulty = pd;
+        m_physics_constants.init(m_kart_properties, m_difficulty);
+    }   // setPlayerDifficulty
 
     // ------------------------------------------------------------------------
     /** Returns a unique identifier for this kart (name of the directory the
@@ -0,0 +1,173 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "karts/controller/ai_perception.hpp"
+
+#include "items/flyable.hpp"
+#include "items/projectile_manager.hpp"
+#include "karts/abstract_kart.hpp"
+#include "modes/linear_world.hpp"
+#include "modes/profile_world.hpp"
+#include "race/race_manager.hpp"
+#include "tracks/track.hpp"
+
+#include <algorithm>
+
+AIPerception::AIPerception()
+{
+    m_max_player_distance = 0.0f;
+    m_track_length        = 0.0f;
+}   // AIPerception
+
+//-----------------------------------------------------------------------------
+/** Takes a new snapshot of the world. Must be called after the physics were
+ *  updated and the karts have taken their new positions from the physics.
+ *  \param world The world to take the snapshot of.
+ */
+void AIPerception::update(const World *world)
+{
+    const unsigned int num_karts = world->getNumKarts();
+    m_x.resize(num_karts);
+    m_z.resize(num_karts);
+    m_velocity_x.resize(num_karts);
+    m_velocity_z.resize(num_karts);
+    m_forward_speed.resize(num_karts);
+    m_overall_distance.resize(num_karts);
+    m_eliminated.resize(num_karts);
+
+    const LinearWorld *linear_world = dynamic_cast<const LinearWorld*>(world);
+    for(unsigned int i=0; i<num_karts; i++)
+    {
+        const AbstractKart *kart = world->getKart(i);
+        const Vec3 &xyz          = kart->getXYZ();
+        const Vec3 &velocity     = kart->getVelocity();
+        m_x[i]                = xyz.getX();
+        m_z[i]                = xyz.getZ();
+        m_velocity_x[i]       = velocity.getX();
+        m_velocity_z[i]       = velocity.getZ();
+        m_forward_speed[i]    = kart->getVelocityLC().getZ();
+        m_overall_distance[i] = linear_world
+                              ? linear_world->getOverallDistance(i) : 0.0f;
+        m_eliminated[i]       = kart->isEliminated();
+    }
+
+    // Sort the karts by their distance down the track, so that the karts
+    // close to a kart can be found without testing all karts
+    m_track_order.clear();
+    if(linear_world)
+    {
+        m_track_length = world->getTrack()->getTrackLength();
+        m_track_distance.resize(num_karts);
+        m_track_order_index.resize(num_karts);
+        for(unsigned int i=0; i<num_karts; i++)
+        {
+            m_track_distance[i] = linear_world->getDistanceDownTrackForKart(i);
+            m_track_order.push_back(i);
+        }
+        const std::vector<float> &distance = m_track_distance;
+        std::sort(m_track_order.begin(), m_track_order.end(),
+                  [&distance](unsigned int a, unsigned int b)
+                  {
+                      return distance[a] < distance[b];
+                  });
+        for(unsigned int i=0; i<num_karts; i++)
+            m_track_order_index[m_track_order[i]] = i;
+    }
+
+    m_max_player_distance = 0.0f;
+    unsigned int n = ProfileWorld::isProfileMode()
+                   ? 0 : race_manager->getNumPlayers();
+    for(unsigned int i=0; i<n; i++)
+    {
+        unsigned int kart_id = world->getPlayerKart(i)->getWorldKartId();
+        if(m_overall_distance[kart_id]>m_max_player_distance)
+            m_max_player_distance = m_overall_distance[kart_id];
+    }
+
+    m_projectiles.clear();
+    const std::vector<Flyable*> &projectiles =
+                                   projectile_manager->getActiveProjectiles();
+    for(unsigned int i=0; i<projectiles.size(); i++)
+        m_projectiles.push_back(projectiles[i]->getXYZ());
+}   // update
+
+//-----------------------------------------------------------------------------
+/** Returns true if a projectile is within the given distance of a point.
+ *  \param xyz The point to test.
+ *  \param radius Distance within which the projectile must be.
+ */
+bool AIPerception::isProjectileClose(const Vec3 &xyz, float radius) const
+{
+    const float r2 = radius*radius;
+    for(unsigned int i=0; i<m_projectiles.size(); i++)
+    {
+        if(m_projectiles[i].distance2(xyz)<r2)
+            return true;
+    }
+    return false;
+}   // isProjectileClose
+
+//-----------------------------------------------------------------------------
+/** Collects the karts whose distance down the track is at most the given
+ *  distance ahead of or behind a kart (taking the start line into account,
+ *  so a kart a lap ahead is found as well). Outside of a linear world all
+ *  other karts are returned, so the result can always be used to limit the
+ *  karts to test.
+ *  \param kart_id World kart id of the kart.
+ *  \param distance Maximum difference of the distances down the track.
+ *  \param karts On return the world kart ids of the karts found, not
+ *         including kart_id.
+ */
+void AIPerception::getKartsNearOnTrack(unsigned int kart_id, float distance,
+                                       std::vector<unsigned int> *karts) const
+{
+    karts->clear();
+    const unsigned int n = (unsigned int)m_track_order.size();
+    if(n==0)
+    {
+        for(unsigned int i=0; i<getNumKarts(); i++)
+        {
+            if(i!=kart_id) karts->push_back(i);
+        }
+        return;
+    }
+
+    const unsigned int index = m_track_order_index[kart_id];
+    const float        d     = m_track_distance[kart_id];
+    // First the karts ahead, then the ones behind, each sweep stops at the
+    // first kart which is too far away
+    for(unsigned int step=1; step<n; step++)
+    {
+        const unsigned int other = m_track_order[(index+step) % n];
+        float diff = m_track_distance[other] - d;
+        if(diff<0) diff += m_track_length;
+        if(diff>distance) break;
+        karts->push_back(other);
+    }
+    const unsigned int ahead = (unsigned int)karts->size();
+    for(unsigned int step=1; step+ahead<n; step++)
+    {
+        const unsigned int other = m_track_order[(index+n-step) % n];
+        float diff = d - m_track_distance[other];
+        if(diff<0) diff += m_track_length;
+        if(diff>distance) break;
+        karts->push_back(other);
+    }
+}   // getKartsNearOnTrack
+
+/* EOF */
@@ -0,0 +1,111 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_AI_PERCEPTION_HPP
+#define HEADER_AI_PERCEPTION_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/vec3.hpp"
+
+#include <vector>
+
+class World;
+
+/** A snapshot of the world as seen by the AI, taken once per frame after
+ *  the physics update and before the controllers decide what to do. All
+ *  AI controllers read from this object instead of querying (and in part
+ *  recomputing) the same data for each AI kart, and since it is not
+ *  modified while the controllers decide, they can do so in parallel.
+ *  The kart data is stored as structure of arrays, indexed by the world
+ *  kart id, so that loops over all karts (e.g. in SkiddingAI::checkCrashes)
+ *  only touch the data they need.
+ *  The items are not copied: the per-quad lists of the ItemManager are
+ *  only changed outside of the decide phase.
+ * \ingroup controller
+ */
+class AIPerception : public NoCopy
+{
+private:
+    /** Position of each kart (2d, XZ plane). */
+    std::vector<float> m_x;
+    std::vector<float> m_z;
+    /** Velocity of each kart (2d, XZ plane). */
+    std::vector<float> m_velocity_x;
+    std::vector<float> m_velocity_z;
+    /** Forward speed of each kart (Z component of the local velocity). */
+    std::vector<float> m_forward_speed;
+    /** Distance each kart has driven in a linear world, 0 otherwise. */
+    std::vector<float> m_overall_distance;
+    /** 1 if the kart is eliminated, 0 otherwise. */
+    std::vector<char>  m_eliminated;
+
+    /** Distance down the track of each kart in the current lap, in a
+     *  linear world. */
+    std::vector<float> m_track_distance;
+    /** World kart ids sorted by their distance down the track, empty if
+     *  the world is not a linear world. */
+    std::vector<unsigned int> m_track_order;
+    /** Index of each kart in m_track_order. */
+    std::vector<unsigned int> m_track_order_index;
+    /** Length of the track, used to wrap distances around the lap. */
+    float              m_track_length;
+
+    /** The largest overall distance of all local player karts, or 0 if
+     *  there is no player kart (e.g. in profile mode). */
+    float              m_max_player_distance;
+
+    /** Positions of all active projectiles. */
+    std::vector<Vec3>  m_projectiles;
+
+public:
+         AIPerception();
+    void update(const World *world);
+    bool isProjectileClose(const Vec3 &xyz, float radius) const;
+    void getKartsNearOnTrack(unsigned int kart_id, float distance,
+                             std::vector<unsigned int> *karts) const;
+    // ------------------------------------------------------------------------
+    /** Returns the number of karts in the snapshot. */
+    unsigned int getNumKarts() const { return (unsigned int)m_x.size(); }
+    // ------------------------------------------------------------------------
+    float getX(unsigned int kart_id) const { return m_x[kart_id]; }
+    // ------------------------------------------------------------------------
+    float getZ(unsigned int kart_id) const { return m_z[kart_id]; }
+    // ------------------------------------------------------------------------
+    float getVelocityX(unsigned int kart_id) const
+                                           { return m_velocity_x[kart_id]; }
+    // ------------------------------------------------------------------------
+    float getVelocityZ(unsigned int kart_id) const
+                                           { return m_velocity_z[kart_id]; }
+    // ------------------------------------------------------------------------
+    float getForwardSpeed(unsigned int kart_id) const
+                                        { return m_forward_speed[kart_id]; }
+    // ------------------------------------------------------------------------
+    float getOverallDistance(unsigned int kart_id) const
+                                     { return m_overall_distance[kart_id]; }
+    // ------------------------------------------------------------------------
+    bool  isEliminated(unsigned int kart_id) const
+                                        { return m_eliminated[kart_id]!=0; }
+    // ------------------------------------------------------------------------
+    /** Returns the largest overall distance of all player karts, or 0 if
+     *  there are no player karts. */
+    float getMaxPlayerDistance() const { return m_max_player_distance; }
+};   // AIPerception
+
+#endif
+
+/* EOF */
@@ -63,6 +63,12 @@ public:
     virtual      ~Controller         () {};
     virtual void  reset              () = 0;
     virtual void  update             (float dt) = 0;
+    // ---------------------------------------------------------------------------
+    /** Called for the controllers of all karts in parallel before any kart
+     *  is updated. It may only read the state of the world and change data
+     *  of this controller; the results are then used in update(), which is
+     *  called serially. */
+    virtual void  decide             (float dt) {}
     virtual void  handleZipper       (bool play_sound) = 0;
     virtual void  collectedItem      (const Item &item, int add_info=-1,
                                       float previous_energy=0) = 0;
@@ -50,6 +50,10 @@
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
 
+/** How often (in seconds) the target point of a finished kart is searched,
+ *  as long as the kart stays on the same graph node. */
+static const float TARGET_UPDATE_TIME = 0.25f;
+
 EndController::EndController(AbstractKart *kart, StateManager::ActivePlayer *player,
                              Controller *prev_controller)
              : AIBaseController(kart, player)
@@ -128,6 +132,8 @@ void EndController::reset()
 
     m_crash_time       = 0.0f;
     m_time_since_stuck = 0.0f;
+    m_target_timer     = 0.0f;
+    m_target_node      = QuadGraph::UNKNOWN_SECTOR;
 
     m_track_node       = QuadGraph::UNKNOWN_SECTOR;
     // In battle mode there is no quad graph, so nothing to do in this case
@@ -204,7 +210,16 @@ void EndController::update(float dt)
 //-----------------------------------------------------------------------------
 void EndController::handleSteering(float dt)
 {
-    Vec3  target_point;
+    m_target_timer -= dt;
+    if(m_target_timer > 0 && m_target_node == m_track_node)
+    {
+        setSteering(steerToPoint(m_target_point), dt);
+        return;
+    }
+    m_target_timer = TARGET_UPDATE_TIME;
+    m_target_node  = m_track_node;
+
+    Vec3 &target_point = m_target_point;
 
     /*The AI responds based on the information we just gathered, using a
      *finite state machine.
@@ -22,6 +22,7 @@
 #define HEADER_END_CONTROLLER_HPP
 
 #include "karts/controller/ai_base_controller.hpp"
+#include "utils/vec3.hpp"
 
 class Camera;
 class LinearWorld;
@@ -63,6 +64,17 @@ private:
 
     float m_time_since_stuck;
 
+    /** The point the kart steers to. Finished karts don't need to react
+     *  quickly, so it is only searched again every TARGET_UPDATE_TIME
+     *  seconds, or when the kart reaches the next graph node. */
+    Vec3  m_target_point;
+
+    /** Time left till m_target_point is searched again. */
+    float m_target_timer;
+
+    /** The graph node m_target_point was searched from. */
+    int   m_target_node;
+
     /** Stores a pointer to the original controller. */
     Controller *m_previous_controller;
 
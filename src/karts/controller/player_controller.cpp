@@ -39,8 +39,19 @@
 #include "states_screens/race_gui_base.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
+#include "utils/profiler.hpp"
 #include "utils/translation.hpp"
 
+#include <chrono>
+
+/** Time of the first player action that no kart update has used yet. */
+static std::chrono::steady_clock::time_point g_pending_input_time;
+static bool g_input_pending = false;
+/** Time of the first player action used by a kart update in this frame,
+ *  i.e. the first one the next presented frame shows the reaction to. */
+static std::chrono::steady_clock::time_point g_applied_input_time;
+static bool g_input_applied = false;
+
 /** The constructor for a player kart.
  *  \param kart_name Name of the kart.
  *  \param position The starting position (1 to n).
@@ -94,6 +105,8 @@ void PlayerController::reset()
     m_prev_nitro   = false;
     m_sound_schedule = false;
     m_penalty_time = 0;
+    // Apply sticks that are already held again
+    input_manager->resetReportedAxes();
 }   // reset
 
 // ----------------------------------------------------------------------------
@@ -128,6 +141,12 @@ void PlayerController::resetInputState()
  */
 void PlayerController::action(PlayerAction action, int value)
 {
+    if (!g_input_pending)
+    {
+        g_pending_input_time = std::chrono::steady_clock::now();
+        g_input_pending      = true;
+    }
+
     switch (action)
     {
     case PA_STEER_LEFT:
@@ -321,6 +340,13 @@ void PlayerController::update(float dt)
     if (!history->replayHistory())
         steer(dt, m_steer_val);
 
+    if (g_input_pending && !g_input_applied)
+    {
+        g_applied_input_time = g_pending_input_time;
+        g_input_applied      = true;
+        g_input_pending      = false;
+    }
+
     if (World::getWorld()->isStartPhase())
     {
         if (m_controls->m_accel || m_controls->m_brake ||
@@ -496,3 +522,20 @@ void PlayerController::collectedItem(const Item &item, int add_info, float old_e
         }
     }
 }   // collectedItem
+
+// ----------------------------------------------------------------------------
+/** Called once the rendered frame was handed to the driver (after the buffer
+ *  swap). If a kart update in this frame used a player action, the time from
+ *  that action till now is shown as input latency in the profiler.
+ */
+void PlayerController::framePresented()
+{
+    if (!g_input_applied)
+        return;
+    g_input_applied = false;
+    const std::chrono::steady_clock::duration latency =
+        std::chrono::steady_clock::now() - g_applied_input_time;
+    PROFILER_SET_GAUGE("Input latency (us)",
+        (int)std::chrono::duration_cast<std::chrono::microseconds>(latency)
+                                                                   .count());
+}   // framePresented
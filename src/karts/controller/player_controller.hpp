@@ -81,6 +81,8 @@ public:
     // ------------------------------------------------------------------------
     /** Player will always be able to get a slipstream bonus. */
     virtual bool  disableSlipstreamBonus() const { return false; }
+    // ------------------------------------------------------------------------
+    static void   framePresented();
 
 };   // PlayerController
 
@@ -46,6 +46,7 @@
 #include "items/powerup.hpp"
 #include "items/projectile_manager.hpp"
 #include "karts/abstract_kart.hpp"
+#include "karts/controller/ai_perception.hpp"
 #include "karts/controller/kart_control.hpp"
 #include "karts/controller/ai_properties.hpp"
 #include "karts/kart_properties.hpp"
@@ -188,6 +189,7 @@ void SkiddingAI::reset()
     m_current_track_direction    = GraphNode::DIR_STRAIGHT;
     m_item_to_collect            = NULL;
     m_avoid_item_close           = false;
+    m_has_decision               = false;
     m_skid_probability_state     = SKID_PROBAB_NOT_YET;
     m_last_item_random           = NULL;
 
@@ -235,6 +237,10 @@ unsigned int SkiddingAI::getNextSector(unsigned int index)
  */
 void SkiddingAI::update(float dt)
 {
+    // The results of decide() can only be used in this update
+    bool has_decision = m_has_decision;
+    m_has_decision    = false;
+
     // This is used to enable firing an item backwards.
     m_controls->m_look_back = false;
     m_controls->m_nitro     = false;
@@ -319,15 +325,20 @@ void SkiddingAI::update(float dt)
         return;
     }
 
-    // Get information that is needed by more than 1 of the handling funcs
-    computeNearestKarts();
+    // Get information that is needed by more than 1 of the handling funcs,
+    // unless it was already computed in decide().
+    if(!has_decision)
+        computeNearestKarts();
 
     m_kart->setSlowdown(MaxSpeed::MS_DECREASE_AI,
                         m_ai_properties->getSpeedCap(m_distance_to_player),
                         /*fade_in_time*/0.0f);
-    //Detect if we are going to crash with the track and/or kart
-    checkCrashes(m_kart->getXYZ());
-    determineTrackDirection();
+    if(!has_decision)
+    {
+        //Detect if we are going to crash with the track and/or kart
+        checkCrashes(m_kart->getXYZ());
+        determineTrackDirection();
+    }
 
     // Special behaviour if we have a bomb attach: try to hit the kart ahead
     // of us.
@@ -393,6 +404,28 @@ void SkiddingAI::update(float dt)
     AIBaseController::update(dt);
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Computes the nearest karts, the possible crashes and the direction of
+ *  the track for the next update. This is called for all AI karts in
+ *  parallel (see World::update), so it only reads the world and writes
+ *  data of this controller. The remaining work of update() changes the
+ *  kart or the world (e.g. using items) and is done serially.
+ *  \param dt Time step size.
+ */
+void SkiddingAI::decide(float dt)
+{
+#ifndef AI_DEBUG
+    // With AI_DEBUG the curves are drawn, which must be done serially.
+    if(m_kart->getKartAnimation() || m_world->isStartPhase() ||
+       m_track_node == QuadGraph::UNKNOWN_SECTOR)
+        return;
+    computeNearestKarts();
+    checkCrashes(m_kart->getXYZ());
+    determineTrackDirection();
+    m_has_decision = true;
+#endif
+}   // decide
+
 //-----------------------------------------------------------------------------
 /** This function decides if the AI should brake.
  *  The decision can be based on race mode (e.g. in follow the leader the AI
@@ -640,8 +673,10 @@ void SkiddingAI::handleItemCollectionAndAvoidance(Vec3 *aim_point,
 
     int node = m_track_node;
     float distance = 0;
-    std::vector<const Item *> items_to_collect;
-    std::vector<const Item *> items_to_avoid;
+    std::vector<const Item *> &items_to_collect = m_items_to_collect;
+    std::vector<const Item *> &items_to_avoid   = m_items_to_avoid;
+    items_to_collect.clear();
+    items_to_avoid.clear();
 
     // 1) Filter and sort all items close by
     // -------------------------------------
@@ -1214,7 +1249,7 @@ void SkiddingAI::handleItems(const float dt)
             // Check if a flyable (cake, ...) is close. If so, use bubblegum
             // as shield
             if( !m_kart->isShielded() &&
-                projectile_manager->projectileIsClose(m_kart,
+                m_world->getAIPerception()->isProjectileClose(m_kart->getXYZ(),
                                     m_ai_properties->m_shield_incoming_radius) )
             {
                 m_controls->m_fire      = true;
@@ -1455,37 +1490,27 @@ void SkiddingAI::computeNearestKarts()
     else
         m_kart_behind = NULL;
 
+    const AIPerception *perception = m_world->getAIPerception();
     m_distance_ahead = m_distance_behind = 9999999.9f;
-    float my_dist = m_world->getOverallDistance(m_kart->getWorldKartId());
+    float my_dist = perception->getOverallDistance(m_kart->getWorldKartId());
     if(m_kart_ahead)
     {
         m_distance_ahead =
-            m_world->getOverallDistance(m_kart_ahead->getWorldKartId())
+            perception->getOverallDistance(m_kart_ahead->getWorldKartId())
             -my_dist;
     }
     if(m_kart_behind)
     {
         m_distance_behind = my_dist
-            -m_world->getOverallDistance(m_kart_behind->getWorldKartId());
+            -perception->getOverallDistance(m_kart_behind->getWorldKartId());
     }
 
     // Compute distance to nearest player kart
-    float max_overall_distance = 0.0f;
-    unsigned int n = ProfileWorld::isProfileMode()
-                   ? 0 : race_manager->getNumPlayers();
-    for(unsigned int i=0; i<n; i++)
-    {
-        unsigned int kart_id =
-            m_world->getPlayerKart(i)->getWorldKartId();
-        if(m_world->getOverallDistance(kart_id)>max_overall_distance)
-            max_overall_distance = m_world->getOverallDistance(kart_id);
-    }
+    float max_overall_distance = perception->getMaxPlayerDistance();
     if(max_overall_distance==0.0f)
         max_overall_distance = 999999.9f;   // force best driving
     // Now convert 'maximum overall distance' to distance to player.
-    m_distance_to_player =
-                m_world->getOverallDistance(m_kart->getWorldKartId())
-                - max_overall_distance;
+    m_distance_to_player = my_dist - max_overall_distance;
 }   // computeNearestKarts
 
 //-----------------------------------------------------------------------------
@@ -1722,7 +1747,10 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
         m_crashes.m_kart = slip->getSlipstreamTarget()->getWorldKartId();
     }
 
-    const size_t NUM_KARTS = m_world->getNumKarts();
+    const AIPerception *perception = m_world->getAIPerception();
+    const unsigned int NUM_KARTS   = perception->getNumKarts();
+    const unsigned int my_id       = m_kart->getWorldKartId();
+    const float my_forward_speed   = perception->getForwardSpeed(my_id);
 
     //Protection against having vel_normal with nan values
     const Vec3 &VEL = m_kart->getVelocity();
@@ -1752,20 +1780,20 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
          */
         if( m_crashes.m_kart == -1 )
         {
+            const float t = i*dt;
             for( unsigned int j = 0; j < NUM_KARTS; ++j )
             {
-                const AbstractKart* kart = m_world->getKart(j);
                 // Ignore eliminated karts
-                if(kart==m_kart||kart->isEliminated()) continue;
-                const AbstractKart *other_kart = m_world->getKart(j);
+                if(j==my_id || perception->isEliminated(j)) continue;
                 // Ignore karts ahead that are faster than this kart.
-                if(m_kart->getVelocityLC().getZ() < other_kart->getVelocityLC().getZ())
+                if(my_forward_speed < perception->getForwardSpeed(j))
                     continue;
-                Vec3 other_kart_xyz = other_kart->getXYZ()
-                                    + other_kart->getVelocity()*(i*dt);
-                float kart_distance = (step_coord - other_kart_xyz).length_2d();
+                float dx = step_coord.getX() - perception->getX(j)
+                         - perception->getVelocityX(j)*t;
+                float dz = step_coord.getZ() - perception->getZ(j)
+                         - perception->getVelocityZ(j)*t;
 
-                if( kart_distance < m_kart_length)
+                if( dx*dx+dz*dz < m_kart_length*m_kart_length)
                     m_crashes.m_kart = j;
             }
         }
@@ -1925,7 +1953,6 @@ void SkiddingAI::findNonCrashingPointFixed(Vec3 *aim_position, int *last_node)
     int target_sector;
 
     Vec3 direction;
-    Vec3 step_track_coord;
 
     // The original while(1) loop is replaced with a for loop to avoid
     // infinite loops (which we had once or twice). Usually the number
@@ -1955,19 +1982,17 @@ void SkiddingAI::findNonCrashingPointFixed(Vec3 *aim_position, int *last_node)
         }
 
         Vec3 step_coord;
+        const GraphNode &node = QuadGraph::get()->getNode(*last_node);
+        const float max_distance = node.getPathWidth()*0.5f - m_kart_width * 0.5f;
         //Test if we crash if we drive towards the target sector
         for(unsigned int i = 2; i < steps; ++i )
         {
             step_coord = m_kart->getXYZ()+direction*m_kart_length * float(i);
 
-            QuadGraph::get()->spatialToTrack(&step_track_coord, step_coord,
-                                             *last_node );
-
-            float distance = fabsf(step_track_coord[0]);
+            float distance = node.getDistanceToCenterLine(step_coord);
 
             //If we are outside, the previous node is what we are looking for
-            if ( distance + m_kart_width * 0.5f
-                 > QuadGraph::get()->getNode(*last_node).getPathWidth()*0.5f )
+            if ( distance > max_distance )
             {
                 *aim_position = QuadGraph::get()->getQuadOfNode(*last_node)
                                                  .getCenter();
@@ -2021,7 +2046,6 @@ void SkiddingAI::findNonCrashingPointFixed(Vec3 *aim_position, int *last_node)
     int target_sector;
 
     Vec3 direction;
-    Vec3 step_track_coord;
 
     float angle1;
     // The original while(1) loop is replaced with a for loop to avoid
@@ -2064,19 +2088,17 @@ void SkiddingAI::findNonCrashingPointFixed(Vec3 *aim_position, int *last_node)
         }
 
         Vec3 step_coord;
+        const GraphNode &node = QuadGraph::get()->getNode(*last_node);
+        const float max_distance = node.getPathWidth() - m_kart_width * 0.5f;
         //Test if we crash if we drive towards the target sector
         for(unsigned int i = 2; i < steps; ++i )
         {
             step_coord = m_kart->getXYZ()+direction*m_kart_length * float(i);
 
-            QuadGraph::get()->spatialToTrack(&step_track_coord, step_coord,
-                                             *last_node );
-
-            float distance = fabsf(step_track_coord[0]);
+            float distance = node.getDistanceToCenterLine(step_coord);
 
             //If we are outside, the previous node is what we are looking for
-            if ( distance + m_kart_width * 0.5f
-                 > QuadGraph::get()->getNode(*last_node).getPathWidth() )
+            if ( distance > max_distance )
             {
                 *aim_position = QuadGraph::get()->getQuadOfNode(*last_node)
                                                  .getCenter();
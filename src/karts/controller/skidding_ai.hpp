@@ -152,6 +152,12 @@ private:
     /** If set an item that the AI should aim for. */
     const Item *m_item_to_collect;
 
+    /** The items close by to collect and to avoid, only used in
+     *  handleItemCollectionAndAvoidance. Members so that their memory is
+     *  reused each frame. */
+    std::vector<const Item *> m_items_to_collect;
+    std::vector<const Item *> m_items_to_avoid;
+
     /** True if items to avoid are close by. Used to avoid using zippers
      *  (which would make it more difficult to avoid items). */
     bool m_avoid_item_close;
@@ -159,6 +165,10 @@ private:
     /** Distance to the player, used for rubber-banding. */
     float m_distance_to_player;
 
+    /** True if decide() computed the nearest karts, crashes and track
+     *  direction for the next update. */
+    bool m_has_decision;
+
     /** A random number generator to decide if the AI should skid or not. */
     RandomGenerator m_random_skid;
 
@@ -260,6 +270,7 @@ public:
                  SkiddingAI(AbstractKart *kart);
                 ~SkiddingAI();
     virtual void update      (float delta) ;
+    virtual void decide      (float delta) ;
     virtual void reset       ();
     virtual const irr::core::stringw& getNamePostfix() const;
 };
@@ -52,10 +52,13 @@ void GhostKart::addTransform(float time, const btTransform &trans)
     // FIXME: for now avoid that transforms for the same time are set
     // twice (to avoid division by zero in update). This should be
     // done when saving in replay
-    if(m_all_times.size()>0 && m_all_times.back()==time)
+    if(m_all_transform.size()>0 && m_all_transform.back().m_time==time)
         return;
-    m_all_times.push_back(time);
-    m_all_transform.push_back(trans);
+    TransformKey key;
+    key.m_time     = time;
+    key.m_origin   = trans.getOrigin();
+    key.m_rotation = trans.getRotation();
+    m_all_transform.push_back(key);
 }   // addTransform
 
 // ----------------------------------------------------------------------------
@@ -94,26 +97,22 @@ void GhostKart::updateTransform(float t, float dt)
 {
 
     // Find (if necessary) the next index to use
-    while(m_current_transform+1 < m_all_times.size() &&
-          t>=m_all_times[m_current_transform+1])
+    const unsigned int size = (unsigned int)m_all_transform.size();
+    while(m_current_transform+1 < size &&
+          t>=m_all_transform[m_current_transform+1].m_time)
     {
           m_current_transform ++;
     }
-    if(m_current_transform+1>=m_all_times.size())
+    if(m_current_transform+1>=size)
     {
         m_node->setVisible(false);
         return;
     }
 
-    float f =(t - m_all_times[m_current_transform])
-           / (  m_all_times[m_current_transform+1]
-              - m_all_times[m_current_transform]  );
-    setXYZ((1-f)*m_all_transform[m_current_transform  ].getOrigin()
-           + f  *m_all_transform[m_current_transform+1].getOrigin() );
-    const btQuaternion q = m_all_transform[m_current_transform].getRotation()
-                          .slerp(m_all_transform[m_current_transform+1]
-                                 .getRotation(),
-                                 f);
-    setRotation(q);
+    const TransformKey &prev = m_all_transform[m_current_transform  ];
+    const TransformKey &next = m_all_transform[m_current_transform+1];
+    float f = (t - prev.m_time) / (next.m_time - prev.m_time);
+    setXYZ((1-f)*prev.m_origin + f*next.m_origin);
+    setRotation(prev.m_rotation.slerp(next.m_rotation, f));
     Moveable::updateGraphics(dt, Vec3(0,0,0), btQuaternion(0, 0, 0, 1));
 }   // update
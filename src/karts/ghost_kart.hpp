@@ -21,6 +21,7 @@
 
 #include "karts/kart.hpp"
 #include "replay/replay_base.hpp"
+#include "utils/vec3.hpp"
 
 #include "LinearMath/btTransform.h"
 
@@ -36,16 +37,24 @@
 class GhostKart : public Kart
 {
 private:
-    /** The list of the times at which the transform were reached. */
-    std::vector<float>       m_all_times;
+    /** A transform of the ghost and the time it was reached at. Storing
+     *  them together keeps the two keyframes interpolated between next to
+     *  each other in memory, and the rotation is converted to a quaternion
+     *  once when the replay is read instead of every frame. */
+    struct TransformKey
+    {
+        float        m_time;
+        Vec3         m_origin;
+        btQuaternion m_rotation;
+    };   // TransformKey
 
-    /** The transforms to assume at the corresponding time in m_all_times. */
-    std::vector<btTransform> m_all_transform;
+    /** All transforms of the ghost, sorted by time. */
+    std::vector<TransformKey> m_all_transform;
 
     std::vector<ReplayBase::KartReplayEvent> m_replay_events;
 
-    /** Pointer to the last index in m_all_times that is smaller than
-     *  the current world time. */
+    /** Index of the last transform in m_all_transform whose time is not
+     *  after the current world time. */
     unsigned int m_current_transform;
 
     /** Index of the next kart replay event. */
@@ -85,6 +85,8 @@
 #  include <math.h>
 #endif
 
+const float Kart::TERRAIN_RAY_EPSILON = 0.3f;
+
 /** The kart constructor.
  *  \param ident  The identifier for the kart model to use.
  *  \param position The position (or rank) for this kart (between 1 and
@@ -169,6 +171,9 @@ Kart::Kart (const std::string& ident, unsigned int world_kart_id,
     m_skid_sound    = SFXManager::get()->createSoundSource( "skid"  );
     m_terrain_sound          = NULL;
     m_previous_terrain_sound = NULL;
+    m_terrain_sound_new      = false;
+    m_terrain_sound_speed    = 0.0f;
+    m_terrain_sound_paused   = false;
 
 }   // Kart
 
@@ -220,6 +225,11 @@ void Kart::init(RaceManager::KartType type)
     {
         animations = false;
     }
+    // Ghosts use the static model: its meshes are shared with all other
+    // karts of the same model (via the mesh cache) and can be drawn
+    // instanced, so many ghosts cost little more than a single kart.
+    if (type == RaceManager::KT_GHOST)
+        animations = false;
     loadData(type, animations);
 
     m_kart_gfx = new KartGFX(this);
@@ -957,24 +967,17 @@ float Kart::getActualWheelForce()
 {
     float add_force = m_max_speed->getCurrentAdditionalEngineForce();
     assert(!isnan(add_force));
-    const std::vector<float>& gear_ratio=m_kart_properties->getGearSwitchRatio();
-    for(unsigned int i=0; i<gear_ratio.size(); i++)
+    const KartPhysicsConstants &pc = m_physics_constants;
+    for(unsigned int i=0; i<pc.m_num_gears; i++)
     {
-        if(m_speed <= m_kart_properties->getMaxSpeed() *
-                      m_difficulty->getMaxSpeed() * gear_ratio[i])
+        if(m_speed <= pc.m_gear_max_speed[i])
         {
-            assert(!isnan(m_kart_properties->getMaxPower() *
-                          m_difficulty->getMaxPower()));
-            assert(!isnan(m_kart_properties->getGearPowerIncrease()[i]));
-            return m_kart_properties->getMaxPower() *
-                   m_difficulty->getMaxPower()
-                  *m_kart_properties->getGearPowerIncrease()[i]
-                  +add_force;
+            assert(!isnan(pc.m_gear_power[i]));
+            return pc.m_gear_power[i] + add_force;
         }
     }
-    assert(!isnan(m_kart_properties->getMaxPower() * m_difficulty->getMaxPower()));
-    return m_kart_properties->getMaxPower() * m_difficulty->getMaxPower()
-          +add_force * 2;
+    assert(!isnan(pc.m_max_power));
+    return pc.m_max_power + add_force * 2;
 
 }   // getActualWheelForce
 
@@ -1083,6 +1086,30 @@ void Kart::eliminate()
     m_node->setVisible(false);
 }   // eliminate
 
+//-----------------------------------------------------------------------------
+/** Casts the terrain rays of all karts in one batch (see
+ *  TerrainInfo::castRays). This is called after the physics update and
+ *  before the karts are updated, so update() can use the results unless
+ *  the kart was moved in the meantime (e.g. by a rescue animation).
+ *  \param karts All karts of the world.
+ */
+void Kart::castTerrainRays(const std::vector<AbstractKart*> &karts)
+{
+    std::vector<TerrainInfo*> infos;
+    std::vector<btTransform>  transforms;
+    infos.reserve(karts.size());
+    transforms.reserve(karts.size());
+    for(unsigned int i=0; i<karts.size(); i++)
+    {
+        Kart *kart = dynamic_cast<Kart*>(karts[i]);
+        if(!kart || kart->isEliminated())
+            continue;
+        infos.push_back(kart->m_terrain_info);
+        transforms.push_back(kart->getTrans());
+    }
+    TerrainInfo::castRays(infos, transforms, Vec3(0, TERRAIN_RAY_EPSILON, 0));
+}   // castTerrainRays
+
 //-----------------------------------------------------------------------------
 /** Updates the kart in each time step. It updates the physics setting,
  *  particle effects, camera position, etc.
@@ -1174,16 +1201,16 @@ void Kart::update(float dt)
         // When the kart is jumping, linear damping reduces the falling speed
         // of a kart so much that it can appear to be in slow motion. So
         // disable linear damping if a kart is in the air
-        m_body->setDamping(0, m_kart_properties->getChassisAngularDamping());
+        m_body->setDamping(0, m_physics_constants.m_chassis_angular_damping);
     }
     else
     {
-        m_body->setDamping(m_kart_properties->getChassisLinearDamping(),
-                           m_kart_properties->getChassisAngularDamping());
+        m_body->setDamping(m_physics_constants.m_chassis_linear_damping,
+                           m_physics_constants.m_chassis_angular_damping);
     }
 
     //m_wheel_rotation gives the rotation around the X-axis
-    m_wheel_rotation_dt = m_speed*dt / m_kart_properties->getWheelRadius();
+    m_wheel_rotation_dt = m_speed*dt / m_physics_constants.m_wheel_radius;
     m_wheel_rotation   += m_wheel_rotation_dt;
     m_wheel_rotation    = fmodf(m_wheel_rotation, 2*M_PI);
 
@@ -1243,7 +1270,7 @@ void Kart::update(float dt)
     // partly tunnels through the track). While tunneling should not be
     // happening (since Z velocity is clamped), the epsilon is left in place
     // just to be on the safe side (it will not hit the chassis itself).
-    Vec3 epsilon(0,0.3f,0);
+    Vec3 epsilon(0,TERRAIN_RAY_EPSILON,0);
 
     // Make sure that the ray doesn't hit the kart. This is done by
     // resetting the collision filter group, so that this collision
@@ -1330,7 +1357,7 @@ void Kart::update(float dt)
     static video::SColor green(255, 61, 87, 23);
 
     // draw skidmarks if relevant (we force pink skidmarks on when hitting a bubblegum)
-    if(m_kart_properties->getSkiddingProperties()->hasSkidmarks())
+    if(m_skidmarks)
     {
         m_skidmarks->update(dt,
                             m_bubblegum_time > 0,
@@ -1495,6 +1522,7 @@ void Kart::handleMaterialSFX(const Material *material)
             m_terrain_sound = SFXManager::get()->createSoundSource(s);
             m_terrain_sound->play();
             m_terrain_sound->setLoop(true);
+            m_terrain_sound_new = true;
         }
         else
         {
@@ -1522,8 +1550,23 @@ void Kart::handleMaterialSFX(const Material *material)
       (m_terrain_sound->getStatus()==SFXBase::SFX_PLAYING ||
        m_terrain_sound->getStatus()==SFXBase::SFX_PAUSED))
     {
-        m_terrain_sound->setPosition(getXYZ());
-        material->setSFXSpeed(m_terrain_sound, m_speed, m_schedule_pause);
+        // Only queue sfx commands if the position or speed changed, most
+        // of the time a kart either stands still or is on the same terrain
+        if (m_terrain_sound_new ||
+            getXYZ().distance2(m_terrain_sound_xyz) > 0.01f)
+        {
+            m_terrain_sound->setPosition(getXYZ());
+            m_terrain_sound_xyz = getXYZ();
+        }
+        if (m_terrain_sound_new ||
+            fabsf(m_speed - m_terrain_sound_speed) > 0.1f ||
+            m_schedule_pause != m_terrain_sound_paused)
+        {
+            material->setSFXSpeed(m_terrain_sound, m_speed, m_schedule_pause);
+            m_terrain_sound_speed  = m_speed;
+            m_terrain_sound_paused = m_schedule_pause;
+        }
+        m_terrain_sound_new = false;
     }
 
 }   // handleMaterialSFX
@@ -1594,6 +1637,16 @@ void Kart::handleMaterialGFX()
     if (!UserConfigParams::m_graphical_effects)
         return;
 
+    // A surface effect (e.g. water) can only be above a terrain with the
+    // 'below surface' flag. While the kart is falling or jumping over any
+    // other terrain only the emitter has to be stopped, the upward raycast
+    // is only done while the kart is below a surface.
+    if (!material || !material->isBelowSurface())
+    {
+        m_kart_gfx->setCreationRateAbsolute(KartGFX::KGFX_TERRAIN, 0);
+        return;
+    }
+
     // Use the middle of the contact points of the two rear wheels
     // as the point from which to cast the ray upwards
     const btWheelInfo::RaycastInfo &ri2 =
@@ -1641,6 +1694,7 @@ void Kart::handleMaterialGFX()
         m_terrain_sound = SFXManager::get()->createSoundSource(s);
         m_terrain_sound->play();
         m_terrain_sound->setLoop(false);
+        m_terrain_sound_new = true;
     }
 
 }   // handleMaterialGFX
@@ -1741,8 +1795,7 @@ void Kart::updateNitro(float dt)
     {
         return;
     }
-    m_collected_energy -= dt * m_kart_properties->getNitroConsumption() *
-                          m_difficulty->getNitroConsumption();
+    m_collected_energy -= dt * m_physics_constants.m_nitro_consumption;
     if (m_collected_energy < 0)
     {
         m_collected_energy = 0;
@@ -1751,15 +1804,12 @@ void Kart::updateNitro(float dt)
 
     if (increase_speed)
     {
+        const KartPhysicsConstants &pc = m_physics_constants;
         m_max_speed->increaseMaxSpeed(MaxSpeed::MS_INCREASE_NITRO,
-                                     m_kart_properties->getNitroMaxSpeedIncrease() *
-                                     m_difficulty->getNitroMaxSpeedIncrease(),
-                                     m_kart_properties->getNitroEngineForce() *
-                                     m_difficulty->getNitroEngineForce(),
-                                     m_kart_properties->getNitroDuration() *
-                                     m_difficulty->getNitroDuration(),
-                                     m_kart_properties->getNitroFadeOutTime() *
-                                     m_difficulty->getNitroFadeOutTime());
+                                      pc.m_nitro_max_speed_increase,
+                                      pc.m_nitro_engine_force,
+                                      pc.m_nitro_duration,
+                                      pc.m_nitro_fade_out_time);
     }
 }   // updateNitro
 
@@ -2129,11 +2179,13 @@ void Kart::updatePhysics(float dt)
     // Only apply if near ground instead of purely based on speed avoiding
     // the "parachute on top" look.
     const Vec3 &v = m_body->getLinearVelocity();
-    if(/*isNearGround() &&*/ v.getY() < - m_kart_properties->getSuspensionTravelCM()*0.01f*60)
+    const float max_fall_speed =
+                           m_physics_constants.m_suspension_travel_cm*0.01f*60;
+    if(/*isNearGround() &&*/ v.getY() < - max_fall_speed)
     {
         Vec3 v_clamped = v;
         // clamp the speed to 99% of the maxium falling speed.
-        v_clamped.setY(-m_kart_properties->getSuspensionTravelCM()*0.01f*60 * 0.99f);
+        v_clamped.setY(-max_fall_speed * 0.99f);
         //m_body->setLinearVelocity(v_clamped);
     }
 
@@ -2260,10 +2312,8 @@ void Kart::updateEnginePowerAndBrakes(float dt)
                 m_brake_time += dt;
                 // Apply the brakes - include the time dependent brake increase
                 float f = 1 + m_brake_time
-                            * m_kart_properties->getBrakeTimeIncrease() *
-                              m_difficulty->getBrakeTimeIncrease();
-                m_vehicle->setAllBrakes(m_kart_properties->getBrakeFactor() *
-                    m_difficulty->getBrakeFactor() * f);
+                            * m_physics_constants.m_brake_time_increase;
+                m_vehicle->setAllBrakes(m_physics_constants.m_brake_factor * f);
             }
             else   // m_speed < 0
             {
@@ -2271,8 +2321,7 @@ void Kart::updateEnginePowerAndBrakes(float dt)
                 // going backward, apply reverse gear ratio (unless he goes
                 // too fast backwards)
                 if ( -m_speed <  m_max_speed->getCurrentMaxSpeed()
-                                 *m_kart_properties->getMaxSpeedReverseRatio() *
-                                 m_difficulty->getMaxSpeedReverseRatio())
+                           *m_physics_constants.m_max_speed_reverse_ratio)
                 {
                     // The backwards acceleration is artificially increased to
                     // allow players to get "unstuck" quicker if they hit e.g.
@@ -2348,7 +2397,7 @@ void Kart::updateSliding()
     for (unsigned int i=0; i<4; i++)
     {
         btWheelInfo& wheel = m_vehicle->getWheelInfo(i);
-        wheel.m_frictionSlip = friction*m_kart_properties->getFrictionSlip();
+        wheel.m_frictionSlip = friction*m_physics_constants.m_friction_slip;
     }
 
     m_vehicle->setSliding(enable_sliding);
@@ -2450,8 +2499,8 @@ void Kart::loadData(RaceManager::KartType type, bool is_animated_model)
                                 getNode(),
                                 true);
 
-        // FIXME: in multiplayer mode, this will result in several instances
-        //        of the heightmap being calculated and kept in memory
+        // The height map is baked once by the track and shared by the
+        // emitters of all local players
         m_sky_particles_emitter->addHeightMapAffector(track);
     }
 
@@ -2459,7 +2508,9 @@ void Kart::loadData(RaceManager::KartType type, bool is_animated_model)
 
     m_slipstream = new SlipStream(this);
 
-    if(m_kart_properties->getSkiddingProperties()->hasSkidmarks())
+    // Ghosts never skid, there is nothing to record skid marks for
+    if(type != RaceManager::KT_GHOST &&
+       m_kart_properties->getSkiddingProperties()->hasSkidmarks())
     {
         m_skidmarks = new SkidMarks(*this);
         m_skidmarks->adjustFog(
@@ -2541,8 +2592,7 @@ void Kart::updateGraphics(float dt, const Vec3& offset_xyz,
     {
         // fabs(speed) is important, otherwise the negative number will
         // become a huge unsigned number in the particle scene node!
-        float f = fabsf(getSpeed())/(m_kart_properties->getMaxSpeed() *
-                  m_difficulty->getMaxSpeed());
+        float f = fabsf(getSpeed())/m_physics_constants.m_max_speed;
         // The speed of the kart can be higher (due to powerups) than
         // the normal maximum speed of the kart.
         if(f>1.0f) f = 1.0f;
@@ -2574,8 +2624,7 @@ void Kart::updateGraphics(float dt, const Vec3& offset_xyz,
     // leaning might get less if a kart gets a special that increases
     // its maximum speed, but not the current speed (by much). On the
     // other hand, that ratio can often be greater than 1.
-    float speed_frac = m_speed / m_kart_properties->getMaxSpeed() *
-                       m_difficulty->getMaxSpeed();
+    float speed_frac = m_speed / m_physics_constants.m_max_speed;
     if(speed_frac>1.0f)
         speed_frac = 1.0f;
     else if (speed_frac < 0.0f)  // no leaning when backwards driving
@@ -2583,14 +2632,14 @@ void Kart::updateGraphics(float dt, const Vec3& offset_xyz,
 
     const float steer_frac = m_skidding->getSteeringFraction();
 
-    const float roll_speed = m_kart_properties->getLeanSpeed();
+    const float roll_speed = m_physics_constants.m_lean_speed;
     if(speed_frac > 0.8f && fabsf(steer_frac)>0.5f)
     {
         // Use steering ^ 7, which means less effect at lower
         // steering
         const float f = m_skidding->getSteeringFraction();
         const float f2 = f*f;
-        const float max_lean = -m_kart_properties->getMaxLean()
+        const float max_lean = -m_physics_constants.m_max_lean
                              * f2*f2*f2*f
                              * speed_frac;
         if(max_lean>0)
@@ -2631,7 +2680,7 @@ void Kart::updateGraphics(float dt, const Vec3& offset_xyz,
     float lean_height = tan(fabsf(m_current_lean)) * getKartWidth()*0.5f;
 
     float heading = m_skidding->getVisualSkidRotation();
-    float xx = fabsf(m_speed)* getKartProperties()->getDownwardImpulseFactor()*0.0006f;
+    float xx = fabsf(m_speed)* m_physics_constants.m_downward_impulse_factor*0.0006f;
     Vec3 center_shift = Vec3(0, m_skidding->getGraphicalJumpOffset()
                               + lean_height +m_graphical_y_offset+xx, 0);
 
@@ -66,6 +66,9 @@ class Kart : public AbstractKart
 {
     friend class Skidding;
 private:
+    /** Height above the kart position from which the terrain ray is cast. */
+    static const float TERRAIN_RAY_EPSILON;
+
     /** Handles speed increase and capping due to powerup, terrain, ... */
     MaxSpeed *m_max_speed;
 
@@ -210,6 +213,14 @@ private:
     /** A pointer to the previous terrain sound needs to be saved so that an
      *  'older' sfx can be finished and an abrupt end of the sfx is avoided. */
     SFXBase      *m_previous_terrain_sound;
+    /** True if the terrain sound was just created and its position and
+     *  speed still have to be set. */
+    bool          m_terrain_sound_new;
+    /** Position, speed and pause state the terrain sound was last updated
+     *  with, so that the sfx manager only gets commands if they change. */
+    Vec3          m_terrain_sound_xyz;
+    float         m_terrain_sound_speed;
+    bool          m_terrain_sound_paused;
     SFXBase      *m_skid_sound;
     SFXBase      *m_goo_sound;
     SFXBase      *m_boing_sound;
@@ -279,6 +290,7 @@ public:
     virtual void   crashed          (const Material *m, const Vec3 &normal);
     virtual float  getHoT           () const;
     virtual void   update           (float dt);
+    static  void   castTerrainRays  (const std::vector<AbstractKart*> &karts);
     virtual void   finishedRace(float time);
     virtual void   setPosition(int p);
     virtual void   beep             ();
@@ -284,8 +284,7 @@ void KartGFX::updateTerrain(const ParticleKind *pk)
     if (skidding > 1.0f && on_ground)
         rate = fabsf(m_kart->getControls().m_steer) > 0.8 ? skidding - 1 : 0;
     else if (speed >= 0.5f && on_ground)
-        rate = speed/m_kart->getKartProperties()->getMaxSpeed() *
-               m_kart->getPlayerDifficulty()->getMaxSpeed();
+        rate = speed/m_kart->getPhysicsConstants().m_max_speed;
     else
     {
         pe->setCreationRateAbsolute(0);
@@ -804,7 +804,11 @@ void KartModel::update(float dt, float rotation_dt, float steer,  float speed)
         core::vector3df pos =  m_wheel_graphics_position[i].toIrrVector();
         pos.Y -= rel_suspension;
 
-        m_wheel_node[i]->setPosition(pos);
+        // Only touch the scene node if the transform actually changed, a
+        // kart standing still (e.g. before the start or while rescued)
+        // then doesn't dirty its wheels each frame.
+        if (m_wheel_node[i]->getPosition() != pos)
+            m_wheel_node[i]->setPosition(pos);
 
         // Now calculate the new rotation: (old + change) mod 360
         float new_rotation = m_wheel_node[i]->getRotation().X
@@ -814,7 +818,8 @@ void KartModel::update(float dt, float rotation_dt, float steer,  float speed)
         // Only apply steer to first 2 wheels.
         if (i < 2)
             wheel_rotation += wheel_steer;
-        m_wheel_node[i]->setRotation(wheel_rotation);
+        if (m_wheel_node[i]->getRotation() != wheel_rotation)
+            m_wheel_node[i]->setRotation(wheel_rotation);
     } // for (i < 4)
 
     // If animations are disabled, stop here
@@ -845,14 +850,17 @@ void KartModel::update(float dt, float rotation_dt, float steer,  float speed)
             if (speed_factor >= 0.0f)
             {
                 float anim_speed = speed * speed_factor;
-                obj.m_node->setAnimationSpeed(anim_speed);
+                if (obj.m_node->getAnimationSpeed() != anim_speed)
+                    obj.m_node->setAnimationSpeed(anim_speed);
             }
 
             // Texture animation
             core::vector2df tex_speed;
             tex_speed.X = GET_VALUE(obj, m_texture_speed.X);
             tex_speed.Y = GET_VALUE(obj, m_texture_speed.Y);
-            if (tex_speed != core::vector2df(0.0f, 0.0f))
+            // The texture matrices only need to be updated if the kart
+            // moved, i.e. if the offset changed
+            if (tex_speed != core::vector2df(0.0f, 0.0f) && speed*dt != 0.0f)
             {
                 obj.m_texture_cur_offset += speed * tex_speed * dt;
                 if (obj.m_texture_cur_offset.X > 1.0f) obj.m_texture_cur_offset.X = fmod(obj.m_texture_cur_offset.X, 1.0f);
@@ -891,7 +899,8 @@ void KartModel::update(float dt, float rotation_dt, float steer,  float speed)
                                         -m_animation_frame[AF_LEFT]   )*steer);
     else                frame = (float)m_animation_frame[AF_STRAIGHT];
 
-    m_animated_node->setCurrentFrame(frame);
+    if (m_animated_node->getFrameNr() != frame)
+        m_animated_node->setCurrentFrame(frame);
 }   // update
 //-----------------------------------------------------------------------------
 void KartModel::attachHat()
@@ -0,0 +1,84 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "karts/kart_physics_constants.hpp"
+
+#include "karts/kart_properties.hpp"
+#include "karts/player_difficulty.hpp"
+#include "utils/log.hpp"
+
+#include <assert.h>
+
+// ----------------------------------------------------------------------------
+/** Computes the constants from the properties of a kart. Must be called
+ *  again if the properties or the difficulty of the kart change.
+ *  \param kp The kart properties, using the difficulty of the race.
+ *  \param difficulty The per-player difficulty.
+ */
+void KartPhysicsConstants::init(const KartProperties *kp,
+                                const PlayerDifficulty *difficulty)
+{
+    m_max_speed               = kp->getMaxSpeed() * difficulty->getMaxSpeed();
+    m_max_power               = kp->getMaxPower() * difficulty->getMaxPower();
+    m_max_speed_reverse_ratio = kp->getMaxSpeedReverseRatio()
+                              * difficulty->getMaxSpeedReverseRatio();
+    m_brake_factor            = kp->getBrakeFactor()
+                              * difficulty->getBrakeFactor();
+    m_brake_time_increase     = kp->getBrakeTimeIncrease()
+                              * difficulty->getBrakeTimeIncrease();
+
+    const std::vector<float> &gear_ratio    = kp->getGearSwitchRatio();
+    const std::vector<float> &gear_increase = kp->getGearPowerIncrease();
+    assert(gear_ratio.size() <= gear_increase.size());
+    m_num_gears = (unsigned int)gear_ratio.size();
+    if (m_num_gears > MAX_GEARS)
+    {
+        Log::warn("KartPhysicsConstants", "Kart '%s' has %u gears, only %u "
+                  "are used.", kp->getIdent().c_str(), m_num_gears, MAX_GEARS);
+        m_num_gears = MAX_GEARS;
+    }
+    for (unsigned int i = 0; i < m_num_gears; i++)
+    {
+        m_gear_max_speed[i] = m_max_speed * gear_ratio[i];
+        m_gear_power[i]     = m_max_power * gear_increase[i];
+    }
+
+    m_nitro_consumption        = kp->getNitroConsumption()
+                               * difficulty->getNitroConsumption();
+    m_nitro_max_speed_increase = kp->getNitroMaxSpeedIncrease()
+                               * difficulty->getNitroMaxSpeedIncrease();
+    m_nitro_engine_force       = kp->getNitroEngineForce()
+                               * difficulty->getNitroEngineForce();
+    m_nitro_duration           = kp->getNitroDuration()
+                               * difficulty->getNitroDuration();
+    m_nitro_fade_out_time      = kp->getNitroFadeOutTime()
+                               * difficulty->getNitroFadeOutTime();
+
+    m_wheel_radius            = kp->getWheelRadius();
+    m_wheel_base              = kp->getWheelBase();
+    m_friction_slip           = kp->getFrictionSlip();
+    m_chassis_linear_damping  = kp->getChassisLinearDamping();
+    m_chassis_angular_damping = kp->getChassisAngularDamping();
+    m_suspension_travel_cm    = kp->getSuspensionTravelCM();
+    m_downward_impulse_factor = kp->getDownwardImpulseFactor();
+    m_track_connection_accel  = kp->getTrackConnectionAccel();
+    m_smooth_flying_impulse   = kp->getSmoothFlyingImpulse();
+    m_max_lean                = kp->getMaxLean();
+    m_lean_speed              = kp->getLeanSpeed();
+    m_exp_spring_response     = kp->getExpSpringResponse();
+}   // init
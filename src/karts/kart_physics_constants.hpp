@@ -0,0 +1,76 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_KART_PHYSICS_CONSTANTS_HPP
+#define HEADER_KART_PHYSICS_CONSTANTS_HPP
+
+class KartProperties;
+class PlayerDifficulty;
+
+/** The kart properties read on each physics update, computed once per kart
+ *  for the difficulty of the race and the per-player difficulty. The values
+ *  are stored next to each other in the kart, so that the physics and
+ *  skidding code find them without going through the getters of several
+ *  objects. Since it only contains numbers it can be copied as a block.
+ * \ingroup karts
+ */
+struct KartPhysicsConstants
+{
+    /** Maximum number of gears. */
+    static const unsigned int MAX_GEARS = 8;
+
+    /** Maximum speed of the kart. */
+    float m_max_speed;
+    /** Engine power of the kart. */
+    float m_max_power;
+    /** Number of gears used. */
+    unsigned int m_num_gears;
+    /** Speed up to which each gear is used. */
+    float m_gear_max_speed[MAX_GEARS];
+    /** Engine power in each gear. */
+    float m_gear_power[MAX_GEARS];
+    /** Maximum speed driving backwards, as fraction of the maximum speed. */
+    float m_max_speed_reverse_ratio;
+    /** Braking force, and how it increases over time. */
+    float m_brake_factor;
+    float m_brake_time_increase;
+
+    /** Nitro consumption per second, and its effect on the speed. */
+    float m_nitro_consumption;
+    float m_nitro_max_speed_increase;
+    float m_nitro_engine_force;
+    float m_nitro_duration;
+    float m_nitro_fade_out_time;
+
+    float m_wheel_radius;
+    float m_wheel_base;
+    float m_friction_slip;
+    float m_chassis_linear_damping;
+    float m_chassis_angular_damping;
+    float m_suspension_travel_cm;
+    float m_downward_impulse_factor;
+    float m_track_connection_accel;
+    float m_smooth_flying_impulse;
+    float m_max_lean;
+    float m_lean_speed;
+    bool  m_exp_spring_response;
+
+    void init(const KartProperties *kp, const PlayerDifficulty *difficulty);
+};   // KartPhysicsConstants
+
+#endif
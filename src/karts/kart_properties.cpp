@@ -47,7 +47,8 @@ float KartProperties::UNDEFINED = -99.9f;
  *  Otherwise the defaults are taken from STKConfig (and since they are all
  *  defined, it is guaranteed that each kart has well defined physics values).
  */
-KartProperties::KartProperties(const std::string &filename)
+KartProperties::KartProperties(const std::string &filename,
+                               const XMLNode *index_node)
 {
     m_icon_material = NULL;
     m_minimap_icon  = NULL;
@@ -111,6 +112,10 @@ KartProperties::KartProperties(const std::string &filename)
     m_shape                      = 32;  // close enough to a circle.
     m_engine_sfx_type            = "engine_small";
     m_kart_model                 = NULL;
+    m_data_loaded                = false;
+    m_models_loaded              = false;
+    m_textures_loaded            = false;
+    m_shadow_texture             = NULL;
     m_has_rand_wheels            = false;
     m_nitro_min_consumption      = 0.53f;
     // The default constructor for stk_config uses filename=""
@@ -119,7 +124,10 @@ KartProperties::KartProperties(const std::string &filename)
         m_skidding_properties = NULL;
         for(unsigned int i=0; i<RaceManager::DIFFICULTY_COUNT; i++)
             m_ai_properties[i]= NULL;
-        load(filename, "kart");
+        if(index_node)
+            loadIndexData(filename, *index_node);
+        else
+            load(filename, "kart");
     }
     else
     {
@@ -199,13 +207,7 @@ void KartProperties::load(const std::string &filename, const std::string &node)
     // share the same KartModel
     m_kart_model  = new KartModel(/*is_master*/true);
 
-    m_root  = StringUtils::getPath(filename)+"/";
-    m_ident = StringUtils::getBasename(StringUtils::getPath(filename));
-    // If this is an addon kart, add "addon_" to the identifier - just in
-    // case that an addon kart has the same directory name (and therefore
-    // identifier) as an included kart.
-    if(Addon::isAddon(filename))
-        m_ident = Addon::createAddonId(m_ident);
+    setRootAndIdent(filename);
     try
     {
         if(!root || root->getName()!="kart")
@@ -231,19 +233,55 @@ void KartProperties::load(const std::string &filename, const std::string &node)
     if(m_groups.size()==0)
         m_groups.push_back(DEFAULT_GROUP_NAME);
 
+    m_icon_file = m_root+m_icon_file;
+    m_data_loaded = true;
+}   // load
 
-    // Load material
-    std::string materials_file = m_root+"materials.xml";
-    file_manager->pushModelSearchPath  (m_root);
-    file_manager->pushTextureSearchPath(m_root);
+//-----------------------------------------------------------------------------
+/** Sets the directory and identifier of this kart from the name of its
+ *  kart.xml file.
+ */
+void KartProperties::setRootAndIdent(const std::string &filename)
+{
+    m_root  = StringUtils::getPath(filename)+"/";
+    m_ident = StringUtils::getBasename(StringUtils::getPath(filename));
+    // If this is an addon kart, add "addon_" to the identifier - just in
+    // case that an addon kart has the same directory name (and therefore
+    // identifier) as an included kart.
+    if(Addon::isAddon(filename))
+        m_ident = Addon::createAddonId(m_ident);
+}   // setRootAndIdent
 
-    irr_driver->setTextureErrorMessage("Error while loading kart '%s':",
-                                       m_name);
+//-----------------------------------------------------------------------------
+/** Only reads the values needed to list the kart (name, groups, icon and
+ *  version) from an entry of the kart index. Everything else is loaded the
+ *  first time loadModels is called.
+ *  \param filename Full path of the kart.xml file.
+ *  \param node The index entry, using the same attribute names as kart.xml.
+ */
+void KartProperties::loadIndexData(const std::string &filename,
+                                   const XMLNode &node)
+{
+    setRootAndIdent(filename);
+    node.get("version",   &m_version  );
+    node.get("name",      &m_name     );
+    node.get("icon-file", &m_icon_file);
+    node.get("groups",    &m_groups   );
+    if(m_groups.size()==0)
+        m_groups.push_back(DEFAULT_GROUP_NAME);
+    m_icon_file = m_root+m_icon_file;
+}   // loadIndexData
 
+//-----------------------------------------------------------------------------
+/** Loads the materials and textures of this kart, and computes the values
+ *  that depend on the size of the model. This is only done the first time
+ *  the models are loaded, the textures are kept when the models are
+ *  unloaded again.
+ */
+void KartProperties::loadTextures()
+{
     // addShared makes sure that these textures/material infos stay in memory
-    material_manager->addSharedMaterial(materials_file);
-
-    m_icon_file = m_root+m_icon_file;
+    material_manager->addSharedMaterial(m_root+"materials.xml");
 
     // Make permanent is important, since otherwise icons can get deleted
     // (e.g. when freeing temp. materials from a track, the last icon
@@ -263,20 +301,6 @@ void KartProperties::load(const std::string &filename, const std::string &node)
         m_minimap_icon = getUnicolorTexture(m_color);
     }
 
-    // Only load the model if the .kart file has the appropriate version,
-    // otherwise warnings are printed.
-    if (m_version >= 1)
-    {
-        const bool success = m_kart_model->loadModels(*this);
-        if (!success)
-        {
-            delete m_kart_model;
-            file_manager->popTextureSearchPath();
-            file_manager->popModelSearchPath();
-            throw std::runtime_error("Cannot load kart models");
-        }
-    }
-
     if(m_gravity_center_shift.getX()==UNDEFINED)
     {
         m_gravity_center_shift.setX(0);
@@ -302,12 +326,63 @@ void KartProperties::load(const std::string &filename, const std::string &node)
     }
 
     m_shadow_texture = irr_driver->getTexture(m_shadow_file);
+    m_textures_loaded = true;
+}   // loadTextures
+
+//-----------------------------------------------------------------------------
+/** Loads the 3d models of this kart, and if this kart was created from the
+ *  kart index, first all its other data. Called by the
+ *  KartPropertiesManager when the kart is about to be shown or used.
+ *  \return False if the models could not be loaded.
+ */
+bool KartProperties::loadModels()
+{
+    if(m_models_loaded)
+        return true;
+    if(!m_data_loaded)
+        load(m_root+"kart.xml", "kart");
+
+    file_manager->pushModelSearchPath  (m_root);
+    file_manager->pushTextureSearchPath(m_root);
+    irr_driver->setTextureErrorMessage("Error while loading kart '%s':",
+                                       m_name);
+
+    // Only load the model if the .kart file has the appropriate version,
+    // otherwise warnings are printed.
+    bool success = true;
+    if (m_version >= 1)
+        success = m_kart_model->loadModels(*this);
+    if(success)
+    {
+        m_models_loaded = true;
+        if(!m_textures_loaded)
+            loadTextures();
+    }
 
     irr_driver->unsetTextureErrorMessage();
     file_manager->popTextureSearchPath();
     file_manager->popModelSearchPath();
+    return success;
+}   // loadModels
 
-}   // load
+//-----------------------------------------------------------------------------
+/** Frees the meshes of this kart. The model information is read again from
+ *  kart.xml, since a master KartModel can not load its meshes again. Must
+ *  not be called while any copy of the model exists.
+ */
+void KartProperties::unloadModels()
+{
+    if(!m_models_loaded)
+        return;
+    delete m_kart_model;
+    m_kart_model    = new KartModel(/*is_master*/true);
+    m_models_loaded = false;
+
+    const XMLNode *root = new XMLNode(m_root+"kart.xml");
+    if(root && root->getName()=="kart")
+        m_kart_model->loadInfo(*root);
+    delete root;
+}   // unloadModels
 
 //-----------------------------------------------------------------------------
 /** Actually reads in the data from the xml file.
@@ -84,6 +84,18 @@ private:
      *  the kart_properties object is const. */
     mutable KartModel       *m_kart_model;
 
+    /** False if only the information from the kart index was read, in
+     *  which case all other values are undefined until loadModels is
+     *  called. */
+    bool                     m_data_loaded;
+
+    /** True if the meshes of m_kart_model are loaded. */
+    bool                     m_models_loaded;
+
+    /** True once the textures were loaded and the values depending on the
+     *  size of the model were computed, which is only done once. */
+    bool                     m_textures_loaded;
+
     /** List of all groups the kart belongs to. */
     std::vector<std::string> m_groups;
 
@@ -401,16 +413,23 @@ private:
 
     void  load              (const std::string &filename,
                              const std::string &node);
+    void  loadIndexData     (const std::string &filename,
+                             const XMLNode &node);
+    void  setRootAndIdent   (const std::string &filename);
+    void  loadTextures      ();
 
 
 public:
-          KartProperties    (const std::string &filename="");
+          KartProperties    (const std::string &filename="",
+                             const XMLNode *index_node=NULL);
          ~KartProperties    ();
     void  copyFrom          (const KartProperties *source);
     void  getAllData        (const XMLNode * root);
     void  checkAllSet       (const std::string &filename);
     float getStartupBoost   () const;
     bool  isInGroup         (const std::string &group) const;
+    bool  loadModels        ();
+    void  unloadModels      ();
     bool operator<(const KartProperties &other) const;
 
     // ------------------------------------------------------------------------
@@ -435,14 +454,27 @@ public:
     video::ITexture *getMinimapIcon  () const {return m_minimap_icon;         }
 
     // ------------------------------------------------------------------------
-    /** Returns a pointer to the KartModel object. */
+    /** Returns a pointer to the KartModel object. The models must have been
+     *  loaded, see KartPropertiesManager::getLoadedKart. */
     KartModel*    getKartModelCopy   () const
-                                            {return m_kart_model->makeCopy(); }
+    {
+        assert(m_models_loaded);
+        return m_kart_model->makeCopy();
+    }   // getKartModelCopy
 
     // ------------------------------------------------------------------------
     /** Returns a pointer to the main KartModel object. This copy
-     *  should not be modified, not attachModel be called on it. */
-    const KartModel& getMasterKartModel() const {return *m_kart_model;        }
+     *  should not be modified, not attachModel be called on it. The models
+     *  must have been loaded, see KartPropertiesManager::getLoadedKart. */
+    const KartModel& getMasterKartModel() const
+    {
+        assert(m_models_loaded);
+        return *m_kart_model;
+    }   // getMasterKartModel
+
+    // ------------------------------------------------------------------------
+    /** Returns true if the models of this kart are loaded. */
+    bool hasModels() const { return m_models_loaded; }
 
     // ------------------------------------------------------------------------
     /** Sets the name of a mesh to be used for this kart.
@@ -450,7 +482,8 @@ public:
      */
     void setHatMeshName(const std::string &hat_name)
     {
-        m_kart_model->setHatMeshName(hat_name);
+        if(m_kart_model)
+            m_kart_model->setHatMeshName(hat_name);
     }   // setHatMeshName
     // ------------------------------------------------------------------------
     /** Returns the name of this kart.
@@ -27,6 +27,8 @@
 #include "graphics/irr_driver.hpp"
 #include "guiengine/engine.hpp"
 #include "io/file_manager.hpp"
+#include "io/utf_writer.hpp"
+#include "io/xml_node.hpp"
 #include "karts/kart_properties.hpp"
 #include "utils/log.hpp"
 #include "utils/string_utils.hpp"
@@ -36,15 +38,22 @@
 #include <stdio.h>
 #include <stdexcept>
 #include <iostream>
+#include <sys/stat.h>
 
 KartPropertiesManager *kart_properties_manager=0;
 
 std::vector<std::string> KartPropertiesManager::m_kart_search_path;
 
+/** Version of the kart index file, increase it when the content of an
+ *  entry changes. */
+static const int KART_INDEX_VERSION = 1;
+
 /** Constructor, only clears internal data structures. */
 KartPropertiesManager::KartPropertiesManager()
 {
     m_all_groups.clear();
+    m_kart_index         = NULL;
+    m_kart_index_changed = false;
 }   // KartPropertiesManager
 
 //-----------------------------------------------------------------------------
@@ -52,6 +61,7 @@ KartPropertiesManager::KartPropertiesManager()
  */
 KartPropertiesManager::~KartPropertiesManager()
 {
+    delete m_kart_index;
 }   // ~KartPropertiesManager
 
 //-----------------------------------------------------------------------------
@@ -72,6 +82,7 @@ void KartPropertiesManager::addKartSearchDir(const std::string &s)
 void KartPropertiesManager::unloadAllKarts()
 {
     m_karts_properties.clearAndDeleteAll();
+    m_loaded_karts.clear();
     m_selected_karts.clear();
     m_kart_available.clear();
     m_groups_2_indices.clear();
@@ -87,6 +98,7 @@ void KartPropertiesManager::removeKart(const std::string &ident)
     // Remove the kart properties from the vector of all kart properties
     int index = getKartId(ident);
     const KartProperties *kp = getKart(ident);  // must be done before remove
+    m_loaded_karts.remove(m_karts_properties.get(index));
     m_karts_properties.remove(index);
     m_all_kart_dirs.erase(m_all_kart_dirs.begin()+index);
     m_kart_available.erase(m_kart_available.begin()+index);
@@ -147,6 +159,7 @@ void KartPropertiesManager::removeKart(const std::string &ident)
 void KartPropertiesManager::loadAllKarts(bool loading_icon)
 {
     m_all_kart_dirs.clear();
+    loadKartIndex();
     std::vector<std::string>::const_iterator dir;
     for(dir = m_kart_search_path.begin(); dir!=m_kart_search_path.end(); dir++)
     {
@@ -172,8 +185,95 @@ void KartPropertiesManager::loadAllKarts(bool loading_icon)
             }
         }   // for all files in the currently handled directory
     }   // for i
+
+    // Also rewrite the index if a kart was removed
+    if(m_kart_index_changed ||
+        m_kart_index_entries.size()!=m_karts_properties.size())
+        saveKartIndex();
+    delete m_kart_index;
+    m_kart_index = NULL;
+    m_kart_index_entries.clear();
 }   // loadAllKarts
 
+//-----------------------------------------------------------------------------
+/** Reads the kart index from the config directory, see saveKartIndex.
+ */
+void KartPropertiesManager::loadKartIndex()
+{
+    delete m_kart_index;
+    m_kart_index_entries.clear();
+    m_kart_index_changed = false;
+    m_kart_index = file_manager->createXMLTree(
+                               file_manager->getUserConfigFile("kart_index.xml"));
+    int version = 0;
+    if(!m_kart_index || m_kart_index->getName()!="kart-index" ||
+        !m_kart_index->get("version", &version) ||
+        version!=KART_INDEX_VERSION)
+    {
+        delete m_kart_index;
+        m_kart_index = NULL;
+        return;
+    }
+
+    for(unsigned int i=0; i<m_kart_index->getNumNodes(); i++)
+    {
+        const XMLNode *node = m_kart_index->getNode(i);
+        std::string dir;
+        if(node->getName()=="kart" && node->get("dir", &dir))
+            m_kart_index_entries[dir] = node;
+    }
+}   // loadKartIndex
+
+//-----------------------------------------------------------------------------
+/** Writes the name, groups, icon and version of all karts to the kart index
+ *  in the config directory, together with the modification time and size of
+ *  their kart.xml file.
+ */
+void KartPropertiesManager::saveKartIndex() const
+{
+    const std::string filename =
+                              file_manager->getUserConfigFile("kart_index.xml");
+    try
+    {
+        UTFWriter index(filename.c_str());
+        index << L"<?xml version=\"1.0\"?>\n";
+        index << L"<kart-index version=\"" << KART_INDEX_VERSION << L"\">\n";
+        for(unsigned int i=0; i<m_karts_properties.size(); i++)
+        {
+            const KartProperties &kp = m_karts_properties[i];
+            struct stat xml_stat;
+            if(stat((m_all_kart_dirs[i]+"/kart.xml").c_str(), &xml_stat)!=0)
+                continue;
+
+            std::string icon = kp.getAbsoluteIconFile();
+            if(icon.compare(0, kp.getKartDir().size(), kp.getKartDir())==0)
+                icon = icon.substr(kp.getKartDir().size());
+            std::string groups;
+            for(unsigned int g=0; g<kp.getGroups().size(); g++)
+                groups += (g==0 ? "" : " ") + kp.getGroups()[g];
+
+            index << L"  <kart dir=\""
+                  << StringUtils::xmlEncode(m_all_kart_dirs[i].c_str())
+                  << L"\" mtime=\"" << (int64_t)xml_stat.st_mtime
+                  << L"\" size=\""  << (int64_t)xml_stat.st_size
+                  << L"\" version=\"" << kp.getVersion()
+                  << L"\"\n        name=\""
+                  << StringUtils::xmlEncode(kp.getNonTranslatedName().c_str())
+                  << L"\" icon-file=\"" << StringUtils::xmlEncode(icon.c_str())
+                  << L"\" groups=\"" << StringUtils::xmlEncode(groups.c_str())
+                  << L"\"/>\n";
+        }
+        index << L"</kart-index>\n";
+        index.close();
+    }
+    catch(std::exception &e)
+    {
+        Log::warn("[KartPropertiesManager]",
+                  "Problems saving the kart index '%s': %s",
+                  filename.c_str(), e.what());
+    }
+}   // saveKartIndex
+
 //-----------------------------------------------------------------------------
 /** Loads a single kart and (if not disabled) the oorresponding 3d model.
  *  \param filename Full path to the kart config file.
@@ -184,10 +284,29 @@ bool KartPropertiesManager::loadKart(const std::string &dir)
     if(!file_manager->fileExists(config_filename))
         return false;
 
+    // Only use the index entry if kart.xml did not change since the index
+    // was written, otherwise kart.xml is parsed.
+    const XMLNode *index_node = NULL;
+    std::map<std::string, const XMLNode*>::const_iterator entry =
+                                                m_kart_index_entries.find(dir);
+    struct stat xml_stat;
+    if(entry!=m_kart_index_entries.end() &&
+        stat(config_filename.c_str(), &xml_stat)==0)
+    {
+        int64_t mtime = -1, size = -1;
+        entry->second->get("mtime", &mtime);
+        entry->second->get("size",  &size );
+        if(mtime==(int64_t)xml_stat.st_mtime &&
+            size==(int64_t)xml_stat.st_size)
+            index_node = entry->second;
+    }
+    if(!index_node)
+        m_kart_index_changed = true;
+
     KartProperties* kart_properties;
     try
     {
-        kart_properties = new KartProperties(config_filename);
+        kart_properties = new KartProperties(config_filename, index_node);
     }
     catch (std::runtime_error& err)
     {
@@ -229,6 +348,7 @@ bool KartPropertiesManager::loadKart(const std::string &dir)
   */
 void KartPropertiesManager::setHatMeshName(const std::string &hat_name)
 {
+    m_hat_mesh_name = hat_name;
     for (unsigned int i=0; i<m_karts_properties.size(); i++)
     {
         m_karts_properties[i].setHatMeshName(hat_name);
@@ -265,6 +385,57 @@ const KartProperties* KartPropertiesManager::getKart(
     return NULL;
 }   // getKart
 
+//-----------------------------------------------------------------------------
+/** Returns the kart properties with the given ident after loading all its
+ *  data and models if necessary. This must be used instead of getKart
+ *  whenever more than the name, groups or icon of a kart is needed, e.g. to
+ *  show its model or to use it in a race.
+ *  \param ident Identifier of the kart.
+ *  \return The kart, or NULL if it does not exist or can not be loaded.
+ */
+const KartProperties* KartPropertiesManager::getLoadedKart(
+                                                      const std::string &ident)
+{
+    for (unsigned int i=0; i<m_karts_properties.size(); i++)
+    {
+        KartProperties *kp = m_karts_properties.get(i);
+        if (kp->getIdent() != ident)
+            continue;
+
+        m_loaded_karts.remove(kp);
+        if (!kp->hasModels())
+        {
+            if (!kp->loadModels())
+            {
+                Log::error("[Kart_Properties_Manager]",
+                           "Cannot load the models of kart '%s', it will "
+                           "not be available.", ident.c_str());
+                m_kart_available[i] = false;
+                return NULL;
+            }
+            if (m_hat_mesh_name != "")
+                kp->setHatMeshName(m_hat_mesh_name);
+        }
+        m_loaded_karts.push_front(kp);
+        return kp;
+    }
+    return NULL;
+}   // getLoadedKart
+
+//-----------------------------------------------------------------------------
+/** Unloads the models of the least recently used karts, so that at most
+ *  MAX_LOADED_KARTS stay loaded. Must only be called when no copy of
+ *  any kart model is in use, i.e. after the world is deleted.
+ */
+void KartPropertiesManager::unloadUnusedKarts()
+{
+    while (m_loaded_karts.size() > MAX_LOADED_KARTS)
+    {
+        m_loaded_karts.back()->unloadModels();
+        m_loaded_karts.pop_back();
+    }
+}   // unloadUnusedKarts
+
 //-----------------------------------------------------------------------------
 const KartProperties* KartPropertiesManager::getKartById(int i) const
 {
@@ -21,6 +21,7 @@
 #define HEADER_KART_PROPERTIES_MANAGER_HPP
 
 #include "utils/ptr_vector.hpp"
+#include <list>
 #include <map>
 
 #include "network/remote_kart_info.hpp"
@@ -29,8 +30,15 @@
 #define ALL_KART_GROUPS_ID  "all"
 
 class KartProperties;
-
-/**
+class XMLNode;
+
+/** Manages all karts. At startup only the information needed to list a kart
+  * (name, groups, icon and version) is read. It is cached in an index in the
+  * config directory, so that kart.xml files which have not changed since
+  * the last start are not even parsed. All other data and the models of a
+  * kart are loaded when the kart is first shown or used (see
+  * getLoadedKart), and the models of the least recently used karts are
+  * unloaded again after a race.
   * \ingroup karts
   */
 class KartPropertiesManager: public NoCopy
@@ -58,6 +66,27 @@ private:
      *  all clients or not. */
     std::vector<bool>        m_kart_available;
 
+    /** Number of karts whose models are kept loaded after a race. */
+    static const unsigned int MAX_LOADED_KARTS = 16;
+
+    /** All karts whose models are loaded, the most recently used first. */
+    std::list<KartProperties*> m_loaded_karts;
+
+    /** Name of the hat mesh to use for all karts, or empty. */
+    std::string              m_hat_mesh_name;
+
+    /** The kart index read at startup, or NULL. */
+    XMLNode                 *m_kart_index;
+
+    /** The entry of the kart index for each kart directory. */
+    std::map<std::string, const XMLNode*> m_kart_index_entries;
+
+    /** True if the kart index needs to be written again. */
+    bool                     m_kart_index_changed;
+
+    void                     loadKartIndex();
+    void                     saveKartIndex() const;
+
 protected:
 
     typedef PtrVector<KartProperties> KartPropertiesVector;
@@ -70,6 +99,8 @@ public:
     static void              addKartSearchDir       (const std::string &s);
     const KartProperties*    getKartById            (int i) const;
     const KartProperties*    getKart(const std::string &ident) const;
+    const KartProperties*    getLoadedKart(const std::string &ident);
+    void                     unloadUnusedKarts();
     const int                getKartId(const std::string &ident) const;
     int                      getKartByGroup(const std::string& group,
                                            int i) const;
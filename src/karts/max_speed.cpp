@@ -53,6 +53,8 @@ MaxSpeed::MaxSpeed(AbstractKart *kart)
     m_add_engine_force  = 0;
     // This can be used if command line option -N is used
     m_current_max_speed = 0;
+    m_active_decreases  = 0;
+    m_active_increases  = 0;
 }   // MaxSpeed
 
 // ----------------------------------------------------------------------------
@@ -62,8 +64,7 @@ MaxSpeed::MaxSpeed(AbstractKart *kart)
  */
 void MaxSpeed::reset()
 {
-    m_current_max_speed = m_kart->getKartProperties()->getMaxSpeed() *
-                          m_kart->getPlayerDifficulty()->getMaxSpeed();
+    m_current_max_speed = m_kart->getPhysicsConstants().m_max_speed;
     m_min_speed         = -1.0f;
 
     for(unsigned int i=MS_DECREASE_MIN; i<MS_DECREASE_MAX; i++)
@@ -79,6 +80,8 @@ void MaxSpeed::reset()
         SpeedIncrease si;
         m_speed_increase[i] = si;
     }
+    m_active_decreases = 0;
+    m_active_increases = 0;
 }   // reset
 
 // ----------------------------------------------------------------------------
@@ -100,6 +103,7 @@ void MaxSpeed::increaseMaxSpeed(unsigned int category, float add_speed,
     m_speed_increase[category].m_fade_out_time   = fade_out_time;
     m_speed_increase[category].m_current_speedup = add_speed;
     m_speed_increase[category].m_engine_force    = engine_force;
+    m_active_increases |= 1 << category;
 }   // increaseMaxSpeed
 
 // ----------------------------------------------------------------------------
@@ -178,6 +182,7 @@ void MaxSpeed::setSlowdown(unsigned int category, float max_speed_fraction,
     m_speed_decrease[category].m_max_speed_fraction = max_speed_fraction;
     m_speed_decrease[category].m_fade_in_time       = fade_in_time;
     m_speed_decrease[category].m_duration           = duration;
+    m_active_decreases |= 1 << category;
 }   // setSlowdown
 
 // ----------------------------------------------------------------------------
@@ -225,6 +230,9 @@ float MaxSpeed::getSpeedIncreaseTimeLeft(unsigned int category)
  *  current maximum speed. Note that the function can be called with
  *  dt=0, in which case the maxium speed will be updated, but no
  *  change to any of the speed increase/decrease objects will be done.
+ *  Only the active categories are updated: inactive ones have a fraction
+ *  of 1 and a speed increase and engine force of 0, so skipping them
+ *  gives exactly the same result.
  *  \param dt Time step size (dt=0 only updates the current maximum speed).
  */
 void MaxSpeed::update(float dt)
@@ -236,24 +244,30 @@ void MaxSpeed::update(float dt)
     float slowdown_factor = 1.0f;
     for(unsigned int i=MS_DECREASE_MIN; i<MS_DECREASE_MAX; i++)
     {
+        if((m_active_decreases & (1 << i)) == 0) continue;
         SpeedDecrease &slowdown = m_speed_decrease[i];
         slowdown.update(dt);
         slowdown_factor = std::min(slowdown_factor,
                                    slowdown.getSlowdownFraction());
+        if(slowdown.m_current_fraction   == 1.0f &&
+           slowdown.m_max_speed_fraction == 1.0f    )
+            m_active_decreases &= ~(1 << i);
     }
 
     m_add_engine_force  = 0;
-    m_current_max_speed = m_kart->getKartProperties()->getMaxSpeed() *
-                          m_kart->getPlayerDifficulty()->getMaxSpeed();
+    m_current_max_speed = m_kart->getPhysicsConstants().m_max_speed;
 
     // Then add the speed increase from each category
     // ----------------------------------------------
     for(unsigned int i=MS_INCREASE_MIN; i<MS_INCREASE_MAX; i++)
     {
+        if((m_active_increases & (1 << i)) == 0) continue;
         SpeedIncrease &speedup = m_speed_increase[i];
         speedup.update(dt);
         m_current_max_speed += speedup.getSpeedIncrease();
         m_add_engine_force  += speedup.getEngineForce();
+        if(speedup.m_duration < -speedup.m_fade_out_time)
+            m_active_increases &= ~(1 << i);
     }
     m_current_max_speed *= slowdown_factor;
 
@@ -148,6 +148,14 @@ private:
      *  for each possible category. */
     SpeedIncrease  m_speed_increase[MS_INCREASE_MAX];
 
+    /** Bit i is set if speed decrease category i might not be 1, i.e. if
+     *  it has to be updated. Most of the time only few categories are
+     *  active (e.g. the terrain), so update skips the others. */
+    unsigned int   m_active_decreases;
+
+    /** Bit i is set if speed increase category i has not expired yet. */
+    unsigned int   m_active_increases;
+
 
 public:
           MaxSpeed(AbstractKart *kart);
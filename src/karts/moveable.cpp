@@ -35,6 +35,7 @@ Moveable::Moveable()
     m_mesh            = NULL;
     m_node            = NULL;
     m_heading         = 0;
+    m_graphics_state_valid = false;
 }   // Moveable
 
 //-----------------------------------------------------------------------------
@@ -77,6 +78,45 @@ void Moveable::updateGraphics(float dt, const Vec3& offset_xyz,
     m_node->setRotation(hpr.toIrrHPR());
 }   // updateGraphics
 
+//-----------------------------------------------------------------------------
+/** Called after each simulation tick if the simulation runs with a fixed
+ *  time step: stores the position and rotation of the scene node (as set by
+ *  updateGraphics in this tick), keeping the values of the previous tick.
+ */
+void Moveable::saveGraphicsState()
+{
+    m_graphics_xyz[0]      = m_graphics_xyz[1];
+    m_graphics_rotation[0] = m_graphics_rotation[1];
+    m_graphics_xyz[1]      = m_node->getPosition();
+    m_graphics_rotation[1] = core::quaternion(m_node->getRotation()
+                                              * core::DEGTORAD);
+    if (!m_graphics_state_valid)
+    {
+        m_graphics_xyz[0]      = m_graphics_xyz[1];
+        m_graphics_rotation[0] = m_graphics_rotation[1];
+        m_graphics_state_valid = true;
+    }
+}   // saveGraphicsState
+
+//-----------------------------------------------------------------------------
+/** Places the scene node between its state after the previous and the last
+ *  simulation tick.
+ *  \param alpha Fraction of a tick since the last tick, 1 restores the
+ *         state of the last tick.
+ */
+void Moveable::interpolateGraphics(float alpha)
+{
+    if (!m_graphics_state_valid)
+        return;
+    m_node->setPosition(m_graphics_xyz[0]
+                        + (m_graphics_xyz[1] - m_graphics_xyz[0])*alpha);
+    core::quaternion q;
+    q.slerp(m_graphics_rotation[0], m_graphics_rotation[1], alpha);
+    core::vector3df hpr;
+    q.toEuler(hpr);
+    m_node->setRotation(hpr*core::RADTODEG);
+}   // interpolateGraphics
+
 //-----------------------------------------------------------------------------
 /** The reset position must be set before calling reset
  */
@@ -89,6 +129,8 @@ void Moveable::reset()
         m_body->setCenterOfMassTransform(m_transform);
     }
     m_node->setVisible(true);  // In case that the objects was eliminated
+    // Don't interpolate between the old and the reset position
+    m_graphics_state_valid = false;
 
     Vec3 up       = getTrans().getBasis().getColumn(1);
     m_pitch       = atan2(up.getZ(), fabsf(up.getY()));
@@ -125,6 +167,18 @@ void Moveable::stopFlying()
  *  \param float dt Time step size.
  */
 void Moveable::update(float dt)
+{
+    updatePosition();
+    updateGraphics(dt, Vec3(0,0,0), btQuaternion(0, 0, 0, 1));
+}   // update
+
+//-----------------------------------------------------------------------------
+/** Takes the transform from the physics body and updates the velocity in
+ *  local coordinates, heading, pitch and roll. This can be called more than
+ *  once per time step, e.g. before all karts are updated, so that the
+ *  controllers of all karts see the same and latest positions.
+ */
+void Moveable::updatePosition()
 {
     if(m_body->getInvMass()!=0)
         m_motion_state->getWorldTransform(m_transform);
@@ -138,9 +192,7 @@ void Moveable::update(float dt)
     Vec3 up       = getTrans().getBasis().getColumn(1);
     m_pitch       = atan2(up.getZ(), fabsf(up.getY()));
     m_roll        = atan2(up.getX(), up.getY());
-
-    updateGraphics(dt, Vec3(0,0,0), btQuaternion(0, 0, 0, 1));
-}   // update
+}   // updatePosition
 
 //-----------------------------------------------------------------------------
 /** Creates the bullet rigid body for this moveable.
@@ -26,6 +26,8 @@ namespace irr
 }
 using namespace irr;
 #include "btBulletDynamicsCommon.h"
+#include <quaternion.h>
+#include <vector3d.h>
 
 #include "physics/kart_motion_state.hpp"
 #include "physics/user_pointer.hpp"
@@ -50,6 +52,14 @@ private:
     /** The roll between -180 and 180 degrees. */
     float                  m_roll;
 
+    /** Position and rotation of the scene node after the previous (index 0)
+     *  and the last (index 1) simulation tick. Used to interpolate the
+     *  graphics if the simulation runs with a fixed time step. */
+    core::vector3df        m_graphics_xyz[2];
+    core::quaternion       m_graphics_rotation[2];
+    /** False until the graphics state was saved after the first tick. */
+    bool                   m_graphics_state_valid;
+
 protected:
     UserPointer            m_user_pointer;
     scene::IMesh          *m_mesh;
@@ -104,6 +114,9 @@ public:
                                  const btQuaternion& off_rotation);
     virtual void  reset();
     virtual void  update(float dt) ;
+    void          updatePosition();
+    void          saveGraphicsState();
+    void          interpolateGraphics(float alpha);
     btRigidBody  *getBody() const {return m_body; }
     void          createBody(float mass, btTransform& trans,
                              btCollisionShape *shape,
@@ -344,7 +344,7 @@ void Skidding::update(float dt, bool is_on_ground,
             angle = m_kart->getKartProperties()
                                 ->getMaxSteerAngle(SPEED)
                         * fabsf(getSteeringFraction());
-            float r = m_kart->getKartProperties()->getWheelBase()
+            float r = m_kart->getPhysicsConstants().m_wheel_base
                    / asin(angle)*1.0f;
 
             const int num_steps = 50;
@@ -165,7 +165,9 @@
 #include "input/input_manager.hpp"
 #include "input/keyboard_device.hpp"
 #include "input/wiimote_manager.hpp"
+#include "io/background_writer.hpp"
 #include "io/file_manager.hpp"
+#include "io/file_prefetcher.hpp"
 #include "items/attachment_manager.hpp"
 #include "items/item_manager.hpp"
 #include "items/projectile_manager.hpp"
@@ -204,11 +206,38 @@
 #include "utils/leak_check.hpp"
 #include "utils/log.hpp"
 #include "utils/translation.hpp"
+#include "utils/worker_pool.hpp"
+
+#include <chrono>
 
 static void cleanSuperTuxKart();
 static void cleanUserConfig();
 void runUnitTests();
 
+// ============================================================================
+/** Start of the current startup phase, see logStartupPhase. */
+static std::chrono::steady_clock::time_point g_startup_phase_start =
+                                               std::chrono::steady_clock::now();
+/** Sum of all startup phases logged so far. */
+static double g_startup_time = 0.0;
+
+// ----------------------------------------------------------------------------
+/** Prints (with --log=debug) how long the startup phase that just ended
+ *  took, so that slow phases can be found. The next phase starts now.
+ *  \param phase Name of the phase that ended.
+ */
+static void logStartupPhase(const char *phase)
+{
+    const std::chrono::steady_clock::time_point now =
+                                               std::chrono::steady_clock::now();
+    const double duration =
+        std::chrono::duration<double>(now - g_startup_phase_start).count();
+    g_startup_time       += duration;
+    g_startup_phase_start = now;
+    Log::debug("Startup", "%-28s %7.3f s (total %7.3f s)", phase, duration,
+               g_startup_time);
+}   // logStartupPhase
+
 // ============================================================================
 //                        gamepad visualisation screen
 // ============================================================================
@@ -525,8 +554,23 @@ void cmdLineHelp()
                               "laps.\n"
     "       --profile-time=n   Enable automatic driven profile mode for n "
                               "seconds.\n"
-    "       --no-graphics      Do not display the actual race.\n"
+    "       --no-graphics      Do not display the actual race. Together with\n"
+    "                          --server this runs a dedicated server without\n"
+    "                          sound.\n"
     "       --with-profile     Enables the profile mode.\n"
+    "       --benchmark=file   Run the profile race with a fixed random seed\n"
+    "                          and write the time of each subsystem as JSON\n"
+    "                          to file (implies --with-profile).\n"
+    "       --benchmark-seed=n Random seed used in benchmark mode (default 1).\n"
+    "       --benchmark-baseline=file Fail (exit code 1) if a subsystem is\n"
+    "                          slower than in this previous benchmark report.\n"
+    "       --benchmark-threshold=n Allowed regression in percent (default 10).\n"
+    "       --benchmark-camera Fly the camera along the driveline at a fixed\n"
+    "                          distance per frame instead of following a kart.\n"
+    "       --micro-benchmark=file Time the hot paths of the engine with the\n"
+    "                          karts of a profile race and the loaded track as\n"
+    "                          input, write the results as JSON to file and end\n"
+    "                          the race (uses --benchmark-seed).\n"
     "       --demo-mode=t      Enables demo mode after t seconds idle time in "
                                "main menu.\n"
     "       --demo-tracks=t1,t2 List of tracks to be used in demo mode. No\n"
@@ -538,6 +582,16 @@ void cmdLineHelp()
     // "       --history=n        Replay history file 'history.dat' using:\n"
     // "                            n=1: recorded positions\n"
     // "                            n=2: recorded key strokes\n"
+    "       --history-file=file Replay this history file (with --history).\n"
+    "       --history-report=file Replay the history once, as fast as\n"
+    "                          possible, write the lap times, the divergence\n"
+    "                          from the recorded positions and the time of\n"
+    "                          each subsystem as JSON to file, and exit.\n"
+    "       --history-batch=DIR Replay all history files (*.dat) in DIR with\n"
+    "                          physics in parallel processes without\n"
+    "                          graphics, writing a report for each.\n"
+    "       --history-jobs=n   Number of parallel replays (default: number\n"
+    "                          of processors).\n"
     "       --server           Start a server (not a playing client).\n"
     "       --login=s          Automatically log in (set the login).\n"
     "       --password=s       Automatically log in (set the password).\n"
@@ -719,6 +773,15 @@ int handleCmdLinePreliminary()
     if (CommandLine::has("--easter", &n))
         UserConfigParams::m_easter_ear_mode = n;
 
+    // The batch replay only starts other STK processes, so it doesn't
+    // need any of the other managers.
+    if(CommandLine::has("--history-batch", &s))
+    {
+        int jobs = 0;
+        CommandLine::has("--history-jobs", &jobs);
+        exit(History::runBatch(s, jobs));
+    }
+
     return 0;
 }   // handleCmdLinePreliminary
 
@@ -797,8 +860,10 @@ int handleCmdLine()
         for(unsigned int i=0;
             i<kart_properties_manager->getNumberOfKarts(); i++)
         {
-            const KartProperties *km =
-                kart_properties_manager->getKartById(i);
+            const KartProperties *km = kart_properties_manager
+                          ->getLoadedKart(kart_properties_manager
+                                          ->getKartById(i)->getIdent());
+            if (!km) continue;
             Log::info("main", "%s:\t%swidth: %f length: %f height: %f "
                       "mesh-buffer count %d",
                       km->getIdent().c_str(),
@@ -984,6 +1049,41 @@ int handleCmdLine()
         }
     }   // --with-profile
 
+    if(CommandLine::has("--benchmark", &s))
+    {
+        int seed = 1;
+        CommandLine::has("--benchmark-seed", &seed);
+        ProfileWorld::setBenchmark(s, seed);
+        if (!ProfileWorld::isProfileMode())
+        {
+            UserConfigParams::m_no_start_screen = true;
+            ProfileWorld::setProfileModeLaps(1);
+            race_manager->setNumLaps(1);
+        }
+        std::string baseline;
+        if(CommandLine::has("--benchmark-baseline", &baseline))
+        {
+            int threshold = 10;
+            CommandLine::has("--benchmark-threshold", &threshold);
+            ProfileWorld::setBenchmarkBaseline(baseline, threshold*0.01f);
+        }
+        if(CommandLine::has("--benchmark-camera"))
+            ProfileWorld::setBenchmarkCamera();
+    }   // --benchmark
+
+    if(CommandLine::has("--micro-benchmark", &s))
+    {
+        int seed = 1;
+        CommandLine::has("--benchmark-seed", &seed);
+        ProfileWorld::setMicroBenchmark(s, seed);
+        // The race ends once enough kart movements were recorded
+        if (!ProfileWorld::isProfileMode())
+        {
+            UserConfigParams::m_no_start_screen = true;
+            ProfileWorld::setProfileModeTime(600.0f);
+        }
+    }   // --micro-benchmark
+
     if(CommandLine::has("--ghost"))
         ReplayPlay::create();
 
@@ -1003,6 +1103,11 @@ int handleCmdLine()
         UserConfigParams::m_no_start_screen = true;
     }   // --history
 
+    if(CommandLine::has("--history-file", &s))
+        history->setReplayFile(s);
+    if(CommandLine::has("--history-report", &s))
+        history->setReportFile(s);
+
     // Demo mode
     if(CommandLine::has("--demo-mode", &s))
     {
@@ -1079,6 +1184,7 @@ void initUserConfig()
     // depend on artist debug flag). So init the rest of the file manager
     // after reading the user config file.
     file_manager->init();
+    BackgroundWriter::create();
     if (UserConfigParams::m_language.toString() != "system")
     {
 #ifdef WIN32
@@ -1105,6 +1211,7 @@ void initRest()
 
     // Now create the actual non-null device in the irrlicht driver
     irr_driver->initDevice();
+    logStartupPhase("Graphics device");
 
     // Init GUI
     IrrlichtDevice* device = irr_driver->getDevice();
@@ -1117,6 +1224,7 @@ void initRest()
     }
 
     GUIEngine::init(device, driver, StateManager::get());
+    logStartupPhase("GUI engine");
 
     // This only initialises the non-network part of the addons manager. The
     // online section of the addons manager will be initialised from a
@@ -1134,6 +1242,8 @@ void initRest()
 
     music_manager = new MusicManager();
     SFXManager::create();
+    WorkerPool::create();
+    FilePrefetcher::create();
     // The order here can be important, e.g. KartPropertiesManager needs
     // defaultKartProperties, which are defined in stk_config.
     history                 = new History              ();
@@ -1145,6 +1255,7 @@ void initRest()
     powerup_manager         = new PowerupManager       ();
     attachment_manager      = new AttachmentManager    ();
     highscore_manager       = new HighscoreManager     ();
+    logStartupPhase("Managers");
 
     // The maximum texture size can not be set earlier, since
     // e.g. the background image needs to be loaded in high res.
@@ -1156,6 +1267,7 @@ void initRest()
 
     track_manager->loadTrackList();
     music_manager->addMusicToTracks();
+    logStartupPhase("Track list");
 
     GUIEngine::addLoadingIcon(irr_driver->getTexture(FileManager::GUI,
                                                      "notes.png"      ) );
@@ -1180,7 +1292,7 @@ void initRest()
         UserConfigParams::m_last_track.revertToDefaults();
 
     race_manager->setTrack(UserConfigParams::m_last_track);
-
+    logStartupPhase("Grand prix and race setup");
 }   // initRest
 
 //=============================================================================
@@ -1268,6 +1380,7 @@ int main(int argc, char *argv[] )
         initUserConfig();
 
         handleCmdLinePreliminary();
+        logStartupPhase("User config");
 
         initRest();
 
@@ -1281,6 +1394,7 @@ int main(int argc, char *argv[] )
         input_manager->setMode(InputManager::MENU);
         main_loop = new MainLoop();
         material_manager->loadMaterial();
+        logStartupPhase("Materials");
 
         // Load the font textures - they are all lazily loaded
         // so no need to push a texture search path. They will actually
@@ -1295,6 +1409,7 @@ int main(int argc, char *argv[] )
         kart_properties_manager -> loadAllKarts    ();
         handleXmasMode();
         handleEasterEarMode();
+        logStartupPhase("Karts");
 
         // Needs the kart and track directories to load potential challenges
         // in those dirs, so it can only be created after reading tracks
@@ -1306,6 +1421,7 @@ int main(int argc, char *argv[] )
         // initialise the game slots of all players and the AchievementsManager
         // to initialise the AchievementsStatus, so it is done only now.
         PlayerManager::get()->initRemainingData();
+        logStartupPhase("Challenges and players");
 
         GUIEngine::addLoadingIcon( irr_driver->getTexture(FileManager::GUI,
                                                           "gui_lock.png"  ) );
@@ -1336,6 +1452,7 @@ int main(int argc, char *argv[] )
         file_manager->popTextureSearchPath();
 
         attachment_manager->loadModels();
+        logStartupPhase("Items and powerups");
 
         GUIEngine::addLoadingIcon( irr_driver->getTexture(FileManager::GUI,
                                                           "banana.png")    );
@@ -1378,6 +1495,7 @@ int main(int argc, char *argv[] )
                 }
             }
         }
+        logStartupPhase("Network and addons");
 
         if(UserConfigParams::m_unit_testing)
         {
@@ -1477,9 +1595,10 @@ int main(int argc, char *argv[] )
             race_manager->setupPlayerKartInfo();
             race_manager->startNew(false);
             main_loop->run();
-            // well, actually run() will never return, since
-            // it exits after replaying history (see history::GetNextDT()).
-            // So the next line is just to make this obvious here!
+            // run() only returns in report mode, after the history was
+            // replayed once (see History::updateReplay()).
+            if(history->isReportMode())
+                exit(history->isReportWritten() ? 0 : 1);
             exit(-3);
         }
 
@@ -1545,7 +1664,7 @@ int main(int argc, char *argv[] )
 
     delete file_manager;
 
-    return 0 ;
+    return ProfileWorld::getExitCode();
 }   // main
 
 // ============================================================================
@@ -1620,6 +1739,8 @@ static void cleanSuperTuxKart()
         Log::info("Thread", "SFXManager not stopping, exiting anyway.");
     }
     SFXManager::destroy();
+    WorkerPool::destroy();
+    FilePrefetcher::destroy();
 
     // Music manager can not be deleted before the sfx thread is stopped
     // (since sfx commands can contain music information, which are
@@ -1656,6 +1777,8 @@ static void cleanUserConfig()
         user_config->saveConfig();
         delete user_config;
     }
+    // Writes all files that are still queued
+    BackgroundWriter::destroy();
 
     if(irr_driver)              delete irr_driver;
 }   // cleanUserConfig
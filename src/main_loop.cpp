@@ -20,19 +20,23 @@
 #include "main_loop.hpp"
 
 #include <assert.h>
+#include <math.h>
 
 #include "audio/sfx_manager.hpp"
+#include "config/stk_config.hpp"
 #include "config/user_config.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/material_manager.hpp"
 #include "guiengine/engine.hpp"
 #include "input/input_manager.hpp"
 #include "input/wiimote_manager.hpp"
+#include "karts/controller/player_controller.hpp"
 #include "modes/profile_world.hpp"
 #include "modes/world.hpp"
 #include "network/protocol_manager.hpp"
 #include "network/network_world.hpp"
 #include "online/request_manager.hpp"
+#include "race/history.hpp"
 #include "race/race_manager.hpp"
 #include "states_screens/state_manager.hpp"
 #include "utils/profiler.hpp"
@@ -43,9 +47,13 @@ MainLoop::MainLoop() :
 m_abort(false),
 m_frame_count(0)
 {
-    m_curr_time = 0;
-    m_prev_time = 0;
+    m_curr_time = std::chrono::steady_clock::now();
+    m_prev_time = m_curr_time;
+    m_frame_time_average   = 0;
+    m_frame_time_deviation = 0;
     m_throttle_fps = true;
+    m_fixed_time_step = false;
+    m_simulation_accumulator = 0;
 }  // MainLoop
 
 //-----------------------------------------------------------------------------
@@ -60,37 +68,51 @@ MainLoop::~MainLoop()
  */
 float MainLoop::getLimitedDt()
 {
-    IrrlichtDevice* device = irr_driver->getDevice();
+    typedef std::chrono::steady_clock Clock;
     m_prev_time = m_curr_time;
 
-    float dt;  // needed outside of the while loop
-    while( 1 )
+    // Throttle fps if more than maximum, which can reduce
+    // the noise the fan on a graphics card makes.
+    // When in menus, reduce FPS much, it's not necessary to push to the maximum for plain menus
+    const int max_fps = (StateManager::get()->throttleFPS() ? 30 : UserConfigParams::m_max_fps);
+    if (m_throttle_fps && max_fps > 0 && !ProfileWorld::isProfileMode() &&
+        !history->isReportMode())
     {
-        m_curr_time = device->getTimer()->getRealTime();
-        dt = (float)(m_curr_time - m_prev_time);
-
-        // don't allow the game to run slower than a certain amount.
-        // when the computer can't keep it up, slow down the shown time instead
-        static const float max_elapsed_time = 3.0f*1.0f/60.0f*1000.0f; /* time 3 internal substeps take */
-        if(dt > max_elapsed_time) dt=max_elapsed_time;
-
-        // Throttle fps if more than maximum, which can reduce
-        // the noise the fan on a graphics card makes.
-        // When in menus, reduce FPS much, it's not necessary to push to the maximum for plain menus
-        const int max_fps = (StateManager::get()->throttleFPS() ? 30 : UserConfigParams::m_max_fps);
-        const int current_fps = (int)(1000.0f/dt);
-        if (m_throttle_fps && current_fps > max_fps && !ProfileWorld::isProfileMode())
+        const Clock::time_point frame_end = m_prev_time +
+            std::chrono::duration_cast<Clock::duration>(
+                                   std::chrono::duration<double>(1.0/max_fps));
+        Clock::time_point now = Clock::now();
+        if (now < frame_end)
         {
-            int wait_time = 1000/max_fps - 1000/current_fps;
-            if(wait_time < 1) wait_time = 1;
-
             PROFILER_PUSH_CPU_MARKER("Throttle framerate", 0, 0, 0);
-            StkTime::sleep(wait_time);
+            // Sleeping can take longer than requested, so only sleep for
+            // most of the remaining time, and give up the time slice till
+            // the exact end of the frame.
+            static const int SPIN_TIME_MS = 2;
+            const int sleep_time = (int)std::chrono::duration_cast<
+                std::chrono::milliseconds>(frame_end - now).count()
+                - SPIN_TIME_MS;
+            if (sleep_time > 0)
+                StkTime::sleep(sleep_time);
+            while (Clock::now() < frame_end)
+                StkTime::sleep(0);
             PROFILER_POP_CPU_MARKER();
         }
-        else break;
     }
-    dt *= 0.001f;
+
+    m_curr_time = Clock::now();
+    float dt = std::chrono::duration<float>(m_curr_time - m_prev_time).count();
+
+    // don't allow the game to run slower than a certain amount.
+    // when the computer can't keep it up, slow down the shown time instead
+    static const float max_elapsed_time = 3.0f*1.0f/60.0f; /* time 3 internal substeps take */
+    if(dt > max_elapsed_time) dt=max_elapsed_time;
+
+    m_frame_time_average   += 0.05f*(dt - m_frame_time_average);
+    m_frame_time_deviation += 0.05f*(fabsf(dt - m_frame_time_average)
+                                     - m_frame_time_deviation);
+    PROFILER_SET_GAUGE("Frame time deviation (us)",
+                       (int)(m_frame_time_deviation*1000000.0f));
     return dt;
 }   // getLimitedDt
 
@@ -103,9 +125,44 @@ void MainLoop::updateRace(float dt)
     if(ProfileWorld::isProfileMode()) dt=1.0f/60.0f;
 
     if (NetworkWorld::getInstance<NetworkWorld>()->isRunning())
+    {
+        // The network world uses its own fixed ticks
+        m_fixed_time_step = true;
         NetworkWorld::getInstance<NetworkWorld>()->update(dt);
-    else
+        return;
+    }
+
+    // Replaying a history needs the recorded time steps, and profile
+    // mode already uses a constant dt.
+    if (stk_config->m_simulation_rate == 0 || history->replayHistory() ||
+        ProfileWorld::isProfileMode())
+    {
+        m_fixed_time_step = false;
         World::getWorld()->updateWorld(dt);
+        return;
+    }
+
+    // Simulate in fixed ticks, and interpolate the graphics between the
+    // last two ticks for the time that is left over.
+    m_fixed_time_step = true;
+    const float tick = 1.0f / stk_config->m_simulation_rate;
+    m_simulation_accumulator += dt;
+    World *world = World::getWorld();
+    if (m_simulation_accumulator >= tick)
+        world->interpolateGraphics(1.0f);
+    while (m_simulation_accumulator >= tick)
+    {
+        m_simulation_accumulator -= tick;
+        world->updateWorld(tick);
+        // The world might have been deleted or replaced
+        if (World::getWorld() != world)
+        {
+            m_simulation_accumulator = 0;
+            return;
+        }
+        world->saveGraphicsStates();
+    }
+    world->interpolateGraphics(m_simulation_accumulator / tick);
 }   // updateRace
 
 //-----------------------------------------------------------------------------
@@ -113,9 +170,7 @@ void MainLoop::updateRace(float dt)
  */
 void MainLoop::run()
 {
-    IrrlichtDevice* device = irr_driver->getDevice();
-
-    m_curr_time = device->getTimer()->getRealTime();
+    m_curr_time = std::chrono::steady_clock::now();
     while(!m_abort)
     {
         PROFILER_PUSH_CPU_MARKER("Main loop", 0xFF, 0x00, 0xF7);
@@ -149,6 +204,7 @@ void MainLoop::run()
 
             PROFILER_PUSH_CPU_MARKER("IrrDriver update", 0x00, 0x00, 0x7F);
             irr_driver->update(dt);
+            PlayerController::framePresented();
             PROFILER_POP_CPU_MARKER();
 
             // Update sfx and music after graphics, so that graphics code
@@ -20,7 +20,7 @@
 #ifndef HEADER_MAIN_LOOP_HPP
 #define HEADER_MAIN_LOOP_HPP
 
-typedef unsigned long Uint32;
+#include <chrono>
 
 
 /** Management class for the whole gameflow, this is where the
@@ -31,9 +31,18 @@ private:
     bool m_abort;
     bool m_throttle_fps;
 
+    /** True if the world is currently updated with a fixed time step. */
+    bool m_fixed_time_step;
+
     int      m_frame_count;
-    Uint32   m_curr_time;
-    Uint32   m_prev_time;
+    std::chrono::steady_clock::time_point m_curr_time;
+    std::chrono::steady_clock::time_point m_prev_time;
+    /** Running average of the frame time, and of its deviation from that
+     *  average (in seconds), which shows how even the frame pacing is. */
+    float    m_frame_time_average;
+    float    m_frame_time_deviation;
+    /** Time not yet simulated with fixed ticks. */
+    float    m_simulation_accumulator;
     float    getLimitedDt();
     void     updateRace(float dt);
 public:
@@ -45,6 +54,10 @@ public:
     // ------------------------------------------------------------------------
     /** Returns true if STK is to be stoppe. */
     bool isAborted() const { return m_abort; }
+    // ------------------------------------------------------------------------
+    /** Returns true if the world is updated with a fixed time step, i.e.
+     *  each update simulates exactly one tick. */
+    bool isFixedTimeStep() const { return m_fixed_time_step; }
 };   // MainLoop
 
 extern MainLoop* main_loop;
@@ -32,6 +32,7 @@
 #include "tracks/track_sector.hpp"
 #include "tracks/track.hpp"
 #include "utils/constants.hpp"
+#include "utils/profiler.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/translation.hpp"
 
@@ -115,6 +116,12 @@ void LinearWorld::reset()
 
     if(m_distance_increase<0) m_distance_increase = 1.0f;  // shouldn't happen
 
+    // Start with all karts in the order of their kart ids, the first call
+    // to updateRacePosition will then sort them.
+    m_race_order.clear();
+    for(unsigned int i=0; i<kart_amount; i++)
+        m_race_order.push_back(i);
+
     // First all kart infos must be updated before the kart position can be
     // recomputed, since otherwise 'new' (initialised) valued will be compared
     // with old values.
@@ -651,6 +658,7 @@ btTransform LinearWorld::getRescueTransform(unsigned int index) const
  */
 void LinearWorld::updateRacePosition()
 {
+    PROFILER_PUSH_CPU_MARKER("LinearWorld::updateRacePosition", 0x00, 0x40, 0x7F);
     // Mostly for debugging:
     beginSetKartPositions();
     const unsigned int kart_amount = (unsigned int) m_karts.size();
@@ -659,58 +667,65 @@ void LinearWorld::updateRacePosition()
     bool rank_changed = false;
 #endif
 
-    // NOTE: if you do any changes to this loop, the next loop (see
-    // DEBUG_KART_RANK below) needs to have the same changes applied
-    // so that debug output is still correct!!!!!!!!!!!
+    // Karts that are either eliminated or have finished the race already
+    // have their (final) position assigned. If these karts would get their
+    // rank updated, it could happen that a kart that finished first will be
+    // overtaken after crossing the finishing line and become second!
+    // All karts that are still racing are behind the karts that have
+    // finished, so count those first.
+    unsigned int num_finished = 0;
     for (unsigned int i=0; i<kart_amount; i++)
     {
         AbstractKart* kart = m_karts[i];
-        // Karts that are either eliminated or have finished the
-        // race already have their (final) position assigned. If
-        // these karts would get their rank updated, it could happen
-        // that a kart that finished first will be overtaken after
-        // crossing the finishing line and become second!
         if(kart->isEliminated() || kart->hasFinishedRace())
         {
             // This is only necessary to support debugging inconsistencies
             // in kart position parameters.
             setKartPosition(i, kart->getPosition());
-            continue;
+            if(!kart->isEliminated())
+                num_finished++;
         }
-        KartInfo& kart_info = m_kart_info[i];
-
-        int p = 1 ;
+    }
 
-        const unsigned int my_id = kart->getWorldKartId();
-        const float my_distance  = m_kart_info[my_id].m_overall_distance;
+    // Remove karts that are not racing anymore from the race order.
+    unsigned int num_racing = 0;
+    for (unsigned int n=0; n<m_race_order.size(); n++)
+    {
+        const AbstractKart *kart = m_karts[m_race_order[n]];
+        if(!kart->isEliminated() && !kart->hasFinishedRace())
+            m_race_order[num_racing++] = m_race_order[n];
+    }
+    m_race_order.resize(num_racing);
 
-        // Count karts ahead of the current kart, i.e. kart that are
-        // already finished or have covered a larger overall distance.
-        for (unsigned int j = 0 ; j < kart_amount ; j++)
+    // The order of the karts rarely changes between two frames, and then
+    // mostly only two neighbouring karts are swapped. So an insertion sort
+    // of the order of the last frame is nearly linear.
+    for (unsigned int n=1; n<num_racing; n++)
+    {
+        const unsigned int id = m_race_order[n];
+        unsigned int m = n;
+        while(m>0 && isAheadOf(id, m_race_order[m-1]))
         {
-            // don't compare a kart with itself and ignore eliminated karts
-            if(j == my_id || m_karts[j]->isEliminated())
-                continue;
-
-            // If the other kart has:
-            // - finished the race (but this kart hasn't)
-            // - or is ahead
-            // - or has the same distance (very unlikely) but started earlier
-            // it is ahead --> increase position
-            if((!kart->hasFinishedRace() && m_karts[j]->hasFinishedRace()) ||
-                m_kart_info[j].m_overall_distance > my_distance            ||
-               (m_kart_info[j].m_overall_distance == my_distance &&
-                m_karts[j]->getInitialPosition()<kart->getInitialPosition() ) )
-            {
-                p++;
-            }
+            m_race_order[m] = m_race_order[m-1];
+            m--;
+        }
+        m_race_order[m] = id;
+    }
+
+    // NOTE: if you do any changes to the ordering, the next loop (see
+    // DEBUG_KART_RANK below) needs to have the same changes applied
+    // so that debug output is still correct!!!!!!!!!!!
+    for (unsigned int n=0; n<num_racing; n++)
+    {
+        const unsigned int i = m_race_order[n];
+        KartInfo& kart_info = m_kart_info[i];
 
-        } //next kart
+        const int p = num_finished + n + 1;
 
 #ifndef DEBUG
         setKartPosition(i, p);
 #else
-        rank_changed |= kart->getPosition()!=p;
+        rank_changed |= m_karts[i]->getPosition()!=p;
         if (!setKartPosition(i,p))
         {
             Log::error("[LinearWorld]", "Same rank used twice!!");
@@ -728,14 +743,14 @@ void LinearWorld::updateRacePosition()
             }
 
             Log::debug("[LinearWorld]", "Who has each ranking so far :");
-            for (unsigned int d=0; d<i; d++)
+            for (unsigned int d=0; d<kart_amount; d++)
             {
                 Log::debug("[LinearWorld]", "%s has rank %d", m_karts[d]->getIdent().c_str(),
                             m_karts[d]->getPosition());
             }
 
             Log::debug("[LinearWorld]", "    --> And %s is being set at rank %d",
-                        kart->getIdent().c_str(), p);
+                        m_karts[i]->getIdent().c_str(), p);
             history->Save();
             assert(false);
         }
@@ -751,7 +766,7 @@ void LinearWorld::updateRacePosition()
             music_manager->switchToFastMusic();
             m_faster_music_active=true;
         }
-    }   // for i<kart_amount
+    }   // for n<num_racing
 
     // Define this to get a detailled analyses each time a race position
     // changes.
@@ -823,8 +838,24 @@ void LinearWorld::updateRacePosition()
 #endif
 
     endSetKartPositions();
+    PROFILER_POP_CPU_MARKER();
 }   // updateRacePosition
 
+//-----------------------------------------------------------------------------
+/** Returns true if kart a is ahead of kart b, i.e. it has covered a larger
+ *  overall distance, or the same distance (very unlikely) but started ahead.
+ *  This is used to sort the karts that are still racing.
+ *  \param a, b World ids of the two karts.
+ */
+bool LinearWorld::isAheadOf(unsigned int a, unsigned int b) const
+{
+    const float distance_a = m_kart_info[a].m_overall_distance;
+    const float distance_b = m_kart_info[b].m_overall_distance;
+    return distance_a > distance_b ||
+          (distance_a == distance_b &&
+           m_karts[a]->getInitialPosition() < m_karts[b]->getInitialPosition());
+}   // isAheadOf
+
 //-----------------------------------------------------------------------------
 /** Checks if a kart is going in the wrong direction. This is done only for
  *  player karts to display a message to the player.
@@ -111,8 +111,15 @@ protected:
       */
     AlignedArray<KartInfo> m_kart_info;
 
+    /** The world ids of all karts that are still racing (i.e. are neither
+     *  eliminated nor have finished the race), sorted by their race
+     *  position. Since the order rarely changes between two frames, it is
+     *  kept from frame to frame and updated with an insertion sort. */
+    std::vector<unsigned int> m_race_order;
+
     virtual void  checkForWrongDirection(unsigned int i, float dt);
     void          updateRacePosition();
+    bool          isAheadOf(unsigned int a, unsigned int b) const;
     virtual float estimateFinishTimeForKart(AbstractKart* kart) OVERRIDE;
 
 public:
@@ -20,20 +20,59 @@
 
 #include "main_loop.hpp"
 #include "graphics/camera.hpp"
+#include "graphics/glwrap.hpp"
 #include "graphics/irr_driver.hpp"
+#include "graphics/material_manager.hpp"
+#include "io/file_manager.hpp"
+#include "io/xml_node.hpp"
 #include "karts/kart_with_stats.hpp"
 #include "karts/controller/controller.hpp"
+#include "network/network_string.hpp"
+#include "physics/triangle_mesh.hpp"
+#include "tracks/check_line.hpp"
+#include "tracks/check_manager.hpp"
+#include "tracks/quad_graph.hpp"
 #include "tracks/track.hpp"
+#include "utils/log.hpp"
+#include "utils/profiler.hpp"
+#include "utils/random_generator.hpp"
+#include "utils/string_utils.hpp"
 
 #include <ISceneManager.h>
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 ProfileWorld::ProfileType ProfileWorld::m_profile_mode=PROFILE_NONE;
 int   ProfileWorld::m_num_laps    = 0;
 float ProfileWorld::m_time        = 0.0f;
 bool  ProfileWorld::m_no_graphics = false;
+std::string ProfileWorld::m_benchmark_file;
+int   ProfileWorld::m_benchmark_seed = 0;
+std::string ProfileWorld::m_baseline_file;
+float ProfileWorld::m_max_regression = 0.1f;
+int   ProfileWorld::m_exit_code   = 0;
+bool  ProfileWorld::m_benchmark_camera = false;
+std::string ProfileWorld::m_micro_benchmark_file;
+
+/** Distance the benchmark camera flies per frame. */
+static const float BENCHMARK_CAMERA_STEP = 0.5f;
+
+/** Number of kart movements recorded for the micro benchmarks, and the
+ *  number of frames between two recordings of a kart. */
+static const unsigned int MICRO_SAMPLES         = 4096;
+static const int          MICRO_SAMPLE_INTERVAL = 4;
+
+/** Results of the micro benchmarks are added to this, so that the compiler
+ *  can't remove the benchmarked calls. */
+static volatile int g_micro_sink = 0;
 
 //-----------------------------------------------------------------------------
 /** The constructor sets the number of (local) players to 0, since only AI
@@ -56,6 +95,18 @@ ProfileWorld::ProfileWorld()
     m_num_transparent  = 0;
     m_num_trans_effect = 0;
     m_num_calls        = 0;
+    m_camera_distance  = 0.0f;
+    m_micro_done       = false;
+
+    if (isBenchmark() || isMicroBenchmark())
+    {
+        // Seed all random number generators, so that the AI takes the same
+        // decisions (and the items are the same) in each run.
+        srand(m_benchmark_seed);
+        RandomGenerator::generateAllSeeds();
+        if (isBenchmark())
+            profiler.setAccumulateTotals(true);
+    }
 }   // ProfileWorld
 
 //-----------------------------------------------------------------------------
@@ -92,6 +143,48 @@ void ProfileWorld::setProfileModeLaps(int laps)
     m_num_laps     = laps;
 }   // setProfileModeLaps
 
+//-----------------------------------------------------------------------------
+/** Enables the benchmark mode: the race is run with a fixed seed, and the
+ *  time spent in each profiler marker is written as JSON to a file. A
+ *  profile mode (laps or time) must be selected as well.
+ *  \param file Name of the file to write the report to.
+ *  \param seed Seed for the random number generators.
+ */
+void ProfileWorld::setBenchmark(const std::string &file, int seed)
+{
+    m_benchmark_file = file;
+    m_benchmark_seed = seed;
+}   // setBenchmark
+
+//-----------------------------------------------------------------------------
+/** Sets a report of a previous benchmark run, which the results of this
+ *  run are compared with. If the time per frame of any subsystem increased
+ *  by more than the specified fraction, the exit code is set to 1.
+ *  \param file Name of the baseline report.
+ *  \param max_regression Maximum allowed increase, e.g. 0.1 for 10%.
+ */
+void ProfileWorld::setBenchmarkBaseline(const std::string &file,
+                                        float max_regression)
+{
+    m_baseline_file  = file;
+    m_max_regression = max_regression;
+}   // setBenchmarkBaseline
+
+//-----------------------------------------------------------------------------
+/** Enables the micro benchmarks: the race is run with a fixed seed while the
+ *  movements of the karts are recorded. Then the hot paths of the engine
+ *  (finding the road sector, ray casts, check lines, race positions, ...)
+ *  are timed with the recorded movements and the loaded track as input,
+ *  the results are written as JSON to a file, and the race is ended.
+ *  \param file Name of the file to write the results to.
+ *  \param seed Seed for the random number generators.
+ */
+void ProfileWorld::setMicroBenchmark(const std::string &file, int seed)
+{
+    m_micro_benchmark_file = file;
+    m_benchmark_seed       = seed;
+}   // setMicroBenchmark
+
 //-----------------------------------------------------------------------------
 /** Creates a kart, having a certain position, starting location, and local
  *  and global player id (if applicable).
@@ -122,8 +215,12 @@ AbstractKart *ProfileWorld::createKart(const std::string &kart_ident, int index,
     // karts can be seen.
     if (index == (int)race_manager->getNumberOfKarts()-1)
     {
-        // The camera keeps track of all cameras and will free them
-        Camera::createCamera(new_kart);
+        if (isBenchmark() && m_benchmark_camera)
+            createCameraPath();
+        // The camera keeps track of all cameras and will free them. The
+        // benchmark camera is not attached to a kart, and positioned in
+        // update.
+        Camera::createCamera(m_camera_path.empty() ? new_kart : NULL);
     }
     return new_kart;
 }   // createKart
@@ -134,6 +231,14 @@ AbstractKart *ProfileWorld::createKart(const std::string &kart_ident, int index,
  */
 bool ProfileWorld::isRaceOver()
 {
+    if (m_micro_done)
+        return true;
+
+    // The benchmark camera flies the requested number of laps along the
+    // driveline, independent of the karts
+    if (!m_camera_path.empty() && m_profile_mode == PROFILE_LAPS)
+        return m_camera_distance >= m_num_laps * m_camera_path_distance.back();
+
     if(m_profile_mode==PROFILE_TIME)
         return getTime()>m_time;
 
@@ -165,8 +270,356 @@ void ProfileWorld::update(float dt)
     m_num_transparent  += attr->getAttributeAsInt("drawn_transparent" );
     m_num_trans_effect += attr->getAttributeAsInt("drawn_transparent_effect" );
 
+    if (!m_camera_path.empty())
+        updateBenchmarkCamera();
+
+    if (isMicroBenchmark() && !m_micro_done)
+    {
+        collectMicroSamples();
+        if (m_micro_samples.size() >= MICRO_SAMPLES)
+        {
+            runMicroBenchmarks();
+            m_micro_done = true;
+        }
+    }
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Records the movements of all karts every few frames, as input for the
+ *  micro benchmarks.
+ */
+void ProfileWorld::collectMicroSamples()
+{
+    if (m_micro_previous_xyz.size() != m_karts.size())
+    {
+        m_micro_previous_xyz.clear();
+        for (unsigned int i = 0; i < m_karts.size(); i++)
+            m_micro_previous_xyz.push_back(m_karts[i]->getXYZ());
+        return;
+    }
+    for (unsigned int i = 0; i < m_karts.size(); i++)
+    {
+        const Vec3 &xyz = m_karts[i]->getXYZ();
+        if ((m_frame_count + i) % MICRO_SAMPLE_INTERVAL == 0 &&
+            m_micro_samples.size() < MICRO_SAMPLES)
+        {
+            MicroSample sample;
+            sample.m_old_xyz = m_micro_previous_xyz[i];
+            sample.m_new_xyz = xyz;
+            sample.m_kart    = i;
+            m_micro_samples.push_back(sample);
+        }
+        m_micro_previous_xyz[i] = xyz;
+    }
+}   // collectMicroSamples
+
+//-----------------------------------------------------------------------------
+/** The result of a micro benchmark: time per operation in ns. */
+struct MicroResult
+{
+    std::string  m_name;
+    unsigned int m_ops;
+    double       m_median_ns;
+    double       m_min_ns;
+};   // MicroResult
+
+//-----------------------------------------------------------------------------
+/** Times a function which does a number of operations per call. The function
+ *  is called often enough that one measurement takes at least 10 ms, and the
+ *  median of 9 measurements is used, which keeps the results stable.
+ *  \param name Name of the benchmark in the results.
+ *  \param ops Number of operations done by one call of the function.
+ *  \param f The function to time.
+ */
+template<typename F>
+static MicroResult timeMicroBenchmark(const std::string &name,
+                                      unsigned int ops, F f)
+{
+    typedef std::chrono::steady_clock Clock;
+    f();   // warm up caches
+    unsigned int calls = 1;
+    while (calls < (1u << 20))
+    {
+        Clock::time_point start = Clock::now();
+        for (unsigned int i = 0; i < calls; i++)
+            f();
+        if (Clock::now() - start >= std::chrono::milliseconds(10))
+            break;
+        calls *= 2;
+    }
+
+    std::vector<double> times;
+    for (unsigned int repeat = 0; repeat < 9; repeat++)
+    {
+        Clock::time_point start = Clock::now();
+        for (unsigned int i = 0; i < calls; i++)
+            f();
+        const double ns = (double)std::chrono::duration_cast<
+                          std::chrono::nanoseconds>(Clock::now() - start).count();
+        times.push_back(ns / ((double)calls * std::max(ops, 1u)));
+    }
+    std::sort(times.begin(), times.end());
+    MicroResult result;
+    result.m_name      = name;
+    result.m_ops       = ops;
+    result.m_median_ns = times[times.size() / 2];
+    result.m_min_ns    = times[0];
+    Log::info("profile", "%s: %f ns per operation.", name.c_str(),
+              result.m_median_ns);
+    return result;
+}   // timeMicroBenchmark
+
+//-----------------------------------------------------------------------------
+/** Runs the micro benchmarks with the recorded kart movements and the
+ *  loaded track as input, and writes the results as JSON.
+ */
+void ProfileWorld::runMicroBenchmarks()
+{
+    const std::vector<MicroSample> &samples = m_micro_samples;
+    std::vector<MicroResult> results;
+
+    QuadGraph *graph = QuadGraph::get();
+    if (graph)
+    {
+        results.push_back(timeMicroBenchmark("QuadGraph::findRoadSector",
+            (unsigned int)samples.size(), [&]()
+        {
+            for (unsigned int i = 0; i < samples.size(); i++)
+            {
+                int sector = QuadGraph::UNKNOWN_SECTOR;
+                graph->findRoadSector(samples[i].m_new_xyz, &sector);
+                g_micro_sink += sector;
+            }
+        }));
+    }
+
+    const TriangleMesh &mesh = m_track->getTriangleMesh();
+    results.push_back(timeMicroBenchmark("TriangleMesh::castRay",
+        (unsigned int)samples.size(), [&]()
+    {
+        for (unsigned int i = 0; i < samples.size(); i++)
+        {
+            const Vec3 &xyz = samples[i].m_new_xyz;
+            btVector3 hit, normal;
+            const Material *material;
+            g_micro_sink += mesh.castRay(xyz + Vec3(0, 1.0f, 0),
+                                         xyz - Vec3(0, 100.0f, 0), &hit,
+                                         &material, &normal);
+        }
+    }));
+
+    // All check lines tested with all recorded movements. This changes the
+    // state of the check lines, but the race ends after the benchmarks.
+    std::vector<CheckLine*> lines;
+    for (unsigned int i = 0; i < CheckManager::get()->getCheckStructureCount();
+         i++)
+    {
+        CheckLine *line = dynamic_cast<CheckLine*>(
+                                 CheckManager::get()->getCheckStructure(i));
+        if (line)
+            lines.push_back(line);
+    }
+    if (!lines.empty())
+    {
+        results.push_back(timeMicroBenchmark("CheckLine::isTriggered",
+            (unsigned int)(samples.size() * lines.size()), [&]()
+        {
+            for (unsigned int i = 0; i < samples.size(); i++)
+            {
+                for (unsigned int j = 0; j < lines.size(); j++)
+                {
+                    g_micro_sink += lines[j]->isTriggered(
+                                    samples[i].m_old_xyz, samples[i].m_new_xyz,
+                                    samples[i].m_kart);
+                }
+            }
+        }));
+    }
+
+    results.push_back(timeMicroBenchmark("LinearWorld::updateRacePosition/" +
+        StringUtils::toString(m_karts.size()), 1, [&]()
+    {
+        updateRacePosition();
+    }));
+
+    // All textures loaded for the track and the karts
+    video::IVideoDriver *driver = irr_driver->getVideoDriver();
+    std::vector<video::ITexture*> textures;
+    for (unsigned int i = 0; i < driver->getTextureCount(); i++)
+        textures.push_back(driver->getTextureByIndex(i));
+    if (!textures.empty())
+    {
+        results.push_back(timeMicroBenchmark("MaterialManager::getMaterialFor",
+            (unsigned int)textures.size(), [&]()
+        {
+            for (unsigned int i = 0; i < textures.size(); i++)
+            {
+                g_micro_sink += material_manager->getMaterialFor(textures[i],
+                                                                   NULL) != NULL;
+            }
+        }));
+    }
+
+    // A kart update like message: id, position and rotation of all karts
+    results.push_back(timeMicroBenchmark("NetworkString::encode_decode",
+        (unsigned int)m_karts.size(), [&]()
+    {
+        NetworkString ns;
+        for (unsigned int i = 0; i < m_karts.size(); i++)
+        {
+            const Vec3 &xyz = m_karts[i]->getXYZ();
+            const btQuaternion rot = m_karts[i]->getTrans().getRotation();
+            ns.addUInt8(i).addFloat(xyz.getX()).addFloat(xyz.getY())
+              .addFloat(xyz.getZ()).addFloat(rot.getX()).addFloat(rot.getY())
+              .addFloat(rot.getZ()).addFloat(rot.getW());
+        }
+        float sum = 0;
+        for (int pos = 0; pos + 29 <= ns.size(); pos += 29)
+        {
+            sum += ns.getUInt8(pos);
+            for (int j = 0; j < 7; j++)
+                sum += ns.getFloat(pos + 1 + 4 * j);
+        }
+        g_micro_sink += (int)sum;
+    }));
+
+    const std::string scene = m_track->getTrackFile("scene.xml");
+    results.push_back(timeMicroBenchmark("XMLNode::parse/scene.xml", 1, [&]()
+    {
+        XMLNode *root = file_manager->createXMLTree(scene);
+        g_micro_sink += root ? root->getNumNodes() : 0;
+        delete root;
+    }));
+
+    results.push_back(timeMicroBenchmark("StringUtils::conversions",
+        (unsigned int)samples.size(), [&]()
+    {
+        for (unsigned int i = 0; i < samples.size(); i++)
+        {
+            const std::string s = StringUtils::toString(samples[i].m_new_xyz.getX());
+            float f = 0;
+            StringUtils::fromString(s, f);
+            const std::string utf8 = StringUtils::wide_to_utf8(
+                                     StringUtils::utf8_to_wide(s.c_str()).c_str());
+            g_micro_sink += (int)f + (int)utf8.size();
+        }
+    }));
+
+    std::ofstream out(m_micro_benchmark_file.c_str());
+    if (!out.is_open())
+    {
+        Log::error("profile", "Can't open micro benchmark file '%s'.",
+                   m_micro_benchmark_file.c_str());
+        m_exit_code = 1;
+        return;
+    }
+    out << "{\n";
+    out << "  \"track\": \"" << m_track->getIdent() << "\",\n";
+    out << "  \"num_karts\": " << m_karts.size() << ",\n";
+    out << "  \"seed\": " << m_benchmark_seed << ",\n";
+    out << "  \"samples\": " << samples.size() << ",\n";
+    out << "  \"benchmarks\": {\n";
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        out << "    \"" << results[i].m_name << "\": {\"ops\": "
+            << results[i].m_ops << ", \"median_ns\": "
+            << results[i].m_median_ns << ", \"min_ns\": "
+            << results[i].m_min_ns << "}"
+            << (i + 1 == results.size() ? "" : ",") << "\n";
+    }
+    out << "  }\n";
+    out << "}\n";
+    Log::info("profile", "Micro benchmark results written to '%s'.",
+              m_micro_benchmark_file.c_str());
+}   // runMicroBenchmarks
+
+//-----------------------------------------------------------------------------
+/** Creates the path of the benchmark camera from the centers of the main
+ *  driveline, i.e. starting at the first node and always following the
+ *  first successor. Without a driveline (e.g. in arenas) the camera follows
+ *  a kart.
+ */
+void ProfileWorld::createCameraPath()
+{
+    QuadGraph *graph = QuadGraph::get();
+    if (!graph || graph->getNumNodes() < 2)
+    {
+        Log::warn("profile", "Track has no driveline, the benchmark camera "
+                  "follows a kart.");
+        return;
+    }
+
+    unsigned int node = 0;
+    do
+    {
+        m_camera_path.push_back(graph->getNode(node).getCenter());
+        if (graph->getNumberOfSuccessors(node) == 0)
+            break;
+        node = graph->getNode(node).getSuccessor(0);
+    } while (node != 0 && m_camera_path.size() < graph->getNumNodes());
+
+    float distance = 0.0f;
+    for (unsigned int i = 0; i < m_camera_path.size(); i++)
+    {
+        m_camera_path_distance.push_back(distance);
+        const Vec3 &next = m_camera_path[(i + 1) % m_camera_path.size()];
+        distance += (next - m_camera_path[i]).length();
+    }
+    m_camera_path_distance.push_back(distance);
+    if (distance <= 0.0f)
+    {
+        m_camera_path.clear();
+        m_camera_path_distance.clear();
+    }
+}   // createCameraPath
+
+//-----------------------------------------------------------------------------
+/** Returns the point of the closed camera path at a certain distance from
+ *  its start, interpolated with a Catmull-Rom spline so that the camera
+ *  doesn't jerk at the path points.
+ */
+Vec3 ProfileWorld::getCameraPathPoint(float distance) const
+{
+    const unsigned int n = (unsigned int)m_camera_path.size();
+    distance = fmodf(distance, m_camera_path_distance.back());
+    const unsigned int i = (unsigned int)(std::upper_bound(
+                                m_camera_path_distance.begin(),
+                                m_camera_path_distance.end(), distance)
+                          - m_camera_path_distance.begin()) - 1;
+    const float length = m_camera_path_distance[i+1]
+                       - m_camera_path_distance[i];
+    const float t = length > 0 ? (distance - m_camera_path_distance[i]) / length
+                               : 0.0f;
+
+    const Vec3 &p0 = m_camera_path[(i + n - 1) % n];
+    const Vec3 &p1 = m_camera_path[i];
+    const Vec3 &p2 = m_camera_path[(i + 1) % n];
+    const Vec3 &p3 = m_camera_path[(i + 2) % n];
+    const float t2 = t * t, t3 = t2 * t;
+    return (p1 * 2.0f + (p2 - p0) * t
+            + (p0 * 2.0f - p1 * 5.0f + p2 * 4.0f - p3) * t2
+            + (p1 * 3.0f - p0 - p2 * 3.0f + p3) * t3) * 0.5f;
+}   // getCameraPathPoint
+
+//-----------------------------------------------------------------------------
+/** Moves the benchmark camera a fixed distance along its path, so that each
+ *  run renders the same frames, regardless of the frame rate.
+ */
+void ProfileWorld::updateBenchmarkCamera()
+{
+    m_camera_distance += BENCHMARK_CAMERA_STEP;
+    const Vec3 up(0, 3.0f, 0);
+    const Vec3 xyz    = getCameraPathPoint(m_camera_distance) + up;
+    const Vec3 target = getCameraPathPoint(m_camera_distance + 10.0f)
+                      + up * 0.5f;
+
+    scene::ICameraSceneNode *camera =
+        Camera::getCamera(0)->getCameraSceneNode();
+    camera->setPosition(xyz.toIrrVector());
+    camera->setTarget(target.toIrrVector());
+    camera->updateAbsolutePosition();
+}   // updateBenchmarkCamera
+
 //-----------------------------------------------------------------------------
 /** This function is called when the race is finished, but end-of-race
  *  animations have still to be played. In the case of profiling,
@@ -344,6 +797,151 @@ void ProfileWorld::enterRaceOverState()
                off_track_count);
         Log::verbose("profile", "");
     }   // for it !=all_groups.end
+
+    if (isBenchmark())
+    {
+        profiler.setAccumulateTotals(false);
+        writeBenchmarkReport(runtime);
+        if (!m_baseline_file.empty())
+            compareWithBaseline();
+    }
     delete this;
     main_loop->abort();
 }   // enterRaceOverState
+
+//-----------------------------------------------------------------------------
+/** Writes the benchmark report: the race setup, the time spent in each
+ *  profiler marker (in total and per frame), and the results of all karts.
+ *  Each marker is written on a line of its own, which is what
+ *  compareWithBaseline() expects.
+ *  \param runtime Real time the race took in seconds.
+ */
+void ProfileWorld::writeBenchmarkReport(float runtime)
+{
+    std::ofstream out(m_benchmark_file.c_str());
+    if (!out.is_open())
+    {
+        Log::error("profile", "Can't open benchmark file '%s'.",
+                   m_benchmark_file.c_str());
+        m_exit_code = 1;
+        return;
+    }
+    out << "{\n";
+    out << "  \"track\": \"" << m_track->getIdent() << "\",\n";
+    out << "  \"num_karts\": " << m_karts.size() << ",\n";
+    if (m_profile_mode == PROFILE_TIME)
+        out << "  \"profile_time\": " << m_time << ",\n";
+    else
+        out << "  \"profile_laps\": " << m_num_laps << ",\n";
+    out << "  \"seed\": " << m_benchmark_seed << ",\n";
+    out << "  \"camera_path\": "
+        << (m_camera_path.empty() ? "false" : "true") << ",\n";
+    if (!m_camera_path.empty())
+        out << "  \"camera_distance\": " << m_camera_distance << ",\n";
+    out << "  \"frames\": " << m_frame_count << ",\n";
+    out << "  \"race_time\": " << getTime() << ",\n";
+    out << "  \"real_time\": " << runtime << ",\n";
+    out << "  \"subsystems\": {\n";
+    const Profiler::MarkerTotals &totals = profiler.getMarkerTotals();
+    for (Profiler::MarkerTotals::const_iterator it = totals.begin();
+         it != totals.end(); it++)
+    {
+        out << "    \"" << it->first << "\": {\"calls\": "
+            << it->second.m_count << ", \"total_ms\": " << it->second.m_time
+            << ", \"per_frame_ms\": "
+            << (m_frame_count > 0 ? it->second.m_time/m_frame_count : 0.0)
+            << "}" << (it == --totals.end() ? "" : ",") << "\n";
+    }
+    out << "  },\n";
+    // GPU time of each pass, in us per frame (only the passes that were
+    // rendered, the GPU timers are not available with --no-graphics)
+    out << "  \"gpu_passes\": {";
+    bool first_pass = true;
+    for (unsigned int i = 0; i < Q_LAST && !m_no_graphics; i++)
+    {
+        const GPUTimer &timer = irr_driver->getGPUTimer(i);
+        const std::vector<unsigned> &samples = timer.getAccumulatedSamples();
+        if (samples.empty())
+            continue;
+        double sum = 0;
+        for (unsigned int j = 0; j < samples.size(); j++)
+            sum += samples[j];
+        out << (first_pass ? "\n" : ",\n") << "    \"" << getGPUPhaseName(i)
+            << "\": {\"samples\": " << samples.size()
+            << ", \"mean_us\": " << sum / samples.size()
+            << ", \"p50_us\": " << timer.getAccumulatedPercentile(0.5f)
+            << ", \"p95_us\": " << timer.getAccumulatedPercentile(0.95f)
+            << ", \"p99_us\": " << timer.getAccumulatedPercentile(0.99f)
+            << "}";
+        first_pass = false;
+    }
+    out << "\n  },\n";
+    out << "  \"karts\": [\n";
+    for (unsigned int i = 0; i < m_karts.size(); i++)
+    {
+        out << "    {\"ident\": \"" << m_karts[i]->getIdent()
+            << "\", \"start_position\": " << i+1
+            << ", \"end_position\": " << m_karts[i]->getPosition()
+            << ", \"finish_time\": " << m_karts[i]->getFinishTime() << "}"
+            << (i+1 == m_karts.size() ? "" : ",") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+    Log::info("profile", "Benchmark report written to '%s'.",
+              m_benchmark_file.c_str());
+}   // writeBenchmarkReport
+
+//-----------------------------------------------------------------------------
+/** Compares the time per frame of all subsystems with the baseline report
+ *  (which was written by writeBenchmarkReport). Markers that take less than
+ *  0.01 ms per frame in the baseline are too noisy and are ignored. If any
+ *  subsystem regressed by more than m_max_regression, the exit code is set
+ *  to 1.
+ */
+void ProfileWorld::compareWithBaseline()
+{
+    std::ifstream in(m_baseline_file.c_str());
+    if (!in.is_open())
+    {
+        Log::error("profile", "Can't open benchmark baseline '%s'.",
+                   m_baseline_file.c_str());
+        m_exit_code = 1;
+        return;
+    }
+
+    std::map<std::string, double> baseline;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t pos = line.find("\"per_frame_ms\":");
+        if (pos == std::string::npos) continue;
+        size_t start = line.find('"');
+        size_t end   = line.find('"', start+1);
+        baseline[line.substr(start+1, end-start-1)] =
+            atof(line.c_str() + pos + strlen("\"per_frame_ms\":"));
+    }
+
+    const Profiler::MarkerTotals &totals = profiler.getMarkerTotals();
+    for (std::map<std::string, double>::const_iterator it = baseline.begin();
+         it != baseline.end(); it++)
+    {
+        Profiler::MarkerTotals::const_iterator current =
+                                                     totals.find(it->first);
+        if (current == totals.end() || it->second < 0.01 ||
+            m_frame_count == 0)
+            continue;
+        double per_frame = current->second.m_time / m_frame_count;
+        if (per_frame > it->second * (1.0 + m_max_regression))
+        {
+            Log::error("profile", "Regression in '%s': %f ms per frame, "
+                       "baseline %f ms.", it->first.c_str(), per_frame,
+                       it->second);
+            m_exit_code = 1;
+        }
+        else
+        {
+            Log::info("profile", "'%s': %f ms per frame, baseline %f ms.",
+                      it->first.c_str(), per_frame, it->second);
+        }
+    }
+}   // compareWithBaseline
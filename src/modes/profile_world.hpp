@@ -21,6 +21,11 @@
 
 #include "modes/standard_race.hpp"
 
+#include "utils/vec3.hpp"
+
+#include <string>
+#include <vector>
+
 class Kart;
 
 /**
@@ -43,6 +48,62 @@ private:
     /** In time based profiling only: time to run. */
     static float m_time;
 
+    /** If not empty, benchmark mode is enabled and the results are written
+     *  as JSON to this file. */
+    static std::string m_benchmark_file;
+
+    /** Benchmark mode only: seed for all random number generators. */
+    static int   m_benchmark_seed;
+
+    /** Benchmark mode only: if not empty, a previous benchmark report, the
+     *  subsystem times of which are compared with the current ones. */
+    static std::string m_baseline_file;
+
+    /** Maximum increase of the time per frame of a subsystem compared with
+     *  the baseline (as a fraction) before the benchmark fails. */
+    static float m_max_regression;
+
+    /** Exit code of STK, set to 1 if the benchmark failed. */
+    static int   m_exit_code;
+
+    /** Benchmark mode only: if the camera flies along the driveline at a
+     *  fixed distance per frame instead of following a kart, so that the
+     *  same frames are rendered in each run. */
+    static bool  m_benchmark_camera;
+
+    /** If not empty, the micro benchmarks are run during the race and
+     *  their results are written as JSON to this file. */
+    static std::string m_micro_benchmark_file;
+
+    /** A movement of a kart recorded during the race, used as realistic
+     *  input for the micro benchmarks. */
+    struct MicroSample
+    {
+        Vec3         m_old_xyz;
+        Vec3         m_new_xyz;
+        unsigned int m_kart;
+    };   // MicroSample
+
+    /** The kart movements recorded for the micro benchmarks. */
+    std::vector<MicroSample> m_micro_samples;
+
+    /** Position of each kart in the previous frame. */
+    std::vector<Vec3>  m_micro_previous_xyz;
+
+    /** True once the micro benchmarks were run, which ends the race. */
+    bool         m_micro_done;
+
+    /** The points the benchmark camera flies through (the centers of the
+     *  main driveline), empty if the camera follows a kart. */
+    std::vector<Vec3>  m_camera_path;
+
+    /** Distance from the first point to each point of m_camera_path, the
+     *  last entry is the length of the closed path. */
+    std::vector<float> m_camera_path_distance;
+
+    /** Distance the benchmark camera has flown so far. */
+    float        m_camera_distance;
+
     /** Return value of real time at start of race. */
     unsigned int m_start_time;
 
@@ -72,6 +133,14 @@ protected:
      *  used by DemoWorld. */
     static int   m_num_laps;
 
+    void writeBenchmarkReport(float runtime);
+    void compareWithBaseline();
+    void createCameraPath();
+    Vec3 getCameraPathPoint(float distance) const;
+    void updateBenchmarkCamera();
+    void collectMicroSamples();
+    void runMicroBenchmarks();
+
     virtual AbstractKart *createKart(const std::string &kart_ident, int index,
                                      int local_player_id, int global_player_id,
                                      RaceManager::KartType type,
@@ -88,6 +157,23 @@ public:
 
     static   void setProfileModeTime(float time);
     static   void setProfileModeLaps(int laps);
+    static   void setBenchmark(const std::string &file, int seed);
+    static   void setBenchmarkBaseline(const std::string &file,
+                                       float max_regression);
+    static   void setMicroBenchmark(const std::string &file, int seed);
+    // ------------------------------------------------------------------------
+    /** Lets the camera fly along the driveline in benchmark mode. */
+    static   void setBenchmarkCamera() { m_benchmark_camera = true; }
+    // ------------------------------------------------------------------------
+    /** Returns true if the benchmark mode was selected. */
+    static   bool isBenchmark() { return !m_benchmark_file.empty(); }
+    // ------------------------------------------------------------------------
+    /** Returns true if the micro benchmarks were selected. */
+    static   bool isMicroBenchmark() { return !m_micro_benchmark_file.empty(); }
+    // ------------------------------------------------------------------------
+    /** Returns the exit code of STK, which is non-zero if a benchmark
+     *  regressed compared with its baseline. */
+    static   int  getExitCode() { return m_exit_code; }
     // ------------------------------------------------------------------------
     /** Returns true if profile mode was selected. */
     static   bool isProfileMode() {return m_profile_mode!=PROFILE_NONE; }
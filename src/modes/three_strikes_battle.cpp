@@ -17,7 +17,9 @@
 
 #include "modes/three_strikes_battle.hpp"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 #include <IMeshSceneNode.h>
 
 #include "audio/music_manager.hpp"
@@ -363,7 +365,8 @@ void ThreeStrikesBattle::update(float dt)
 }   // update
 
 //-----------------------------------------------------------------------------
-/** Updates the ranking of the karts.
+/** Updates the ranking of the karts. This is only called when a kart is
+ *  hit (which is the only time the lives change) and at the end of the race.
  */
 void ThreeStrikesBattle::updateKartRanks()
 {
@@ -373,45 +376,31 @@ void ThreeStrikesBattle::updateKartRanks()
 
     const unsigned int NUM_KARTS = getNumKarts();
 
-    int *karts_list = new int[NUM_KARTS];
-    for( unsigned int n = 0; n < NUM_KARTS; ++n ) karts_list[n] = n;
-
-    bool sorted=false;
-    do
+    // The time of each kart is computed once, and not for each comparison
+    std::vector<int> times(NUM_KARTS);
+    std::vector<int> karts_list(NUM_KARTS);
+    for( unsigned int n = 0; n < NUM_KARTS; ++n )
     {
-        sorted = true;
-        for( unsigned int n = 0; n < NUM_KARTS-1; ++n )
-        {
-            const int this_karts_time =
-                  m_karts[karts_list[n]]->hasFinishedRace()
-                ? (int)m_karts[karts_list[n]]->getFinishTime()
-                : (int)WorldStatus::getTime();
-            const int next_karts_time =
-                   m_karts[karts_list[n+1]]->hasFinishedRace()
-                ? (int)m_karts[karts_list[n+1]]->getFinishTime()
-                : (int)WorldStatus::getTime();
-
-            // Swap if next kart survived longer or has more lives
-            bool swap = next_karts_time > this_karts_time ||
-                        m_kart_info[karts_list[n+1]].m_lives
-                        > m_kart_info[karts_list[n]].m_lives;
-
-            if(swap)
-            {
-                int tmp = karts_list[n+1];
-                karts_list[n+1] = karts_list[n];
-                karts_list[n] = tmp;
-                sorted = false;
-                break;
-            }
-        }   // for n = 0; n < NUM_KARTS-1
-    } while(!sorted);
+        karts_list[n] = n;
+        times[n] = m_karts[n]->hasFinishedRace()
+                 ? (int)m_karts[n]->getFinishTime()
+                 : (int)WorldStatus::getTime();
+    }
+
+    // Karts that survived longer come first, then the ones with more lives.
+    // Karts that are equal keep the order of their ids.
+    std::stable_sort(karts_list.begin(), karts_list.end(),
+                     [this, &times](int a, int b)
+                     {
+                         if (times[a] != times[b])
+                             return times[a] > times[b];
+                         return m_kart_info[a].m_lives > m_kart_info[b].m_lives;
+                     });
 
     for( unsigned int n = 0; n < NUM_KARTS; ++n )
     {
         setKartPosition(karts_list[n], n+1);
     }
-    delete [] karts_list;
     endSetKartPositions();
 }   // updateKartRank
 
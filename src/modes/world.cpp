@@ -26,12 +26,15 @@
 #include "challenges/unlock_manager.hpp"
 #include "config/user_config.hpp"
 #include "graphics/camera.hpp"
+#include "graphics/central_settings.hpp"
 #include "graphics/irr_driver.hpp"
+#include "graphics/skid_mark_renderer.hpp"
 #include "io/file_manager.hpp"
 #include "input/device_manager.hpp"
 #include "input/keyboard_device.hpp"
 #include "items/projectile_manager.hpp"
 #include "karts/controller/player_controller.hpp"
+#include "karts/controller/ai_perception.hpp"
 #include "karts/controller/end_controller.hpp"
 #include "karts/controller/skidding_ai.hpp"
 #include "karts/controller/network_player_controller.hpp"
@@ -60,6 +63,7 @@
 #include "utils/profiler.hpp"
 #include "utils/translation.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/worker_pool.hpp"
 
 #include <algorithm>
 #include <assert.h>
@@ -112,6 +116,7 @@ World::World() : WorldStatus(), m_clear_color(255,100,101,140)
 #endif
 
     m_physics            = NULL;
+    m_ai_perception      = NULL;
     m_race_gui           = NULL;
     m_saved_race_gui     = NULL;
     m_use_highscores     = true;
@@ -154,7 +159,7 @@ void World::init()
 
     // Grab the track file
     m_track = track_manager->getTrack(race_manager->getTrackName());
-	m_script_engine = new Scripting::ScriptEngine();
+	m_script_engine = new Scripting::ScriptEngine(this);
     if(!m_track)
     {
         std::ostringstream msg;
@@ -165,6 +170,7 @@ void World::init()
 
     // Create the physics
     m_physics = new Physics();
+    m_ai_perception = new AIPerception();
 
     unsigned int num_karts = race_manager->getNumberOfKarts();
     //assert(num_karts > 0);
@@ -397,12 +403,15 @@ World::~World()
         delete m_karts[i];
 
     m_karts.clear();
+    kart_properties_manager->unloadUnusedKarts();
     Camera::removeAllCameras();
 
     projectile_manager->cleanup();
     // In case that the track is not found, m_physics is still undefined.
     if(m_physics)
         delete m_physics;
+    if(m_ai_perception)
+        delete m_ai_perception;
 
     m_world = NULL;
 
@@ -889,6 +898,35 @@ void World::updateWorld(float dt)
     }
 }   // updateWorld
 
+// ----------------------------------------------------------------------------
+/** Called after each simulation tick if the simulation runs with a fixed
+ *  time step. Saves the graphical state of the karts, projectiles and
+ *  cameras, so that they can be interpolated between the last two ticks.
+ */
+void World::saveGraphicsStates()
+{
+    for (unsigned int i = 0; i < m_karts.size(); i++)
+        m_karts[i]->saveGraphicsState();
+    projectile_manager->saveGraphicsStates();
+    for (unsigned int i = 0; i < Camera::getNumCameras(); i++)
+        Camera::getCamera(i)->saveGraphicsState();
+}   // saveGraphicsStates
+
+// ----------------------------------------------------------------------------
+/** Interpolates the graphical state of karts, projectiles and cameras
+ *  between the last two simulation ticks.
+ *  \param alpha Fraction of a tick since the last tick, 1 restores the
+ *         state of the last tick (which must be done before the next tick).
+ */
+void World::interpolateGraphics(float alpha)
+{
+    for (unsigned int i = 0; i < m_karts.size(); i++)
+        m_karts[i]->interpolateGraphics(alpha);
+    projectile_manager->interpolateGraphics(alpha);
+    for (unsigned int i = 0; i < Camera::getNumCameras(); i++)
+        Camera::getCamera(i)->interpolateGraphics(alpha);
+}   // interpolateGraphics
+
 #define MEASURE_FPS 0
 
 //-----------------------------------------------------------------------------
@@ -923,6 +961,7 @@ void World::update(float dt)
 #endif
 
     PROFILER_PUSH_CPU_MARKER("World::update (sub-updates)", 0x20, 0x7F, 0x00);
+    m_script_engine->startFrame();
     history->update(dt);
     if(ReplayRecorder::get()) ReplayRecorder::get()->update(dt);
     if(ReplayPlay::get()) ReplayPlay::get()->update(dt);
@@ -937,11 +976,38 @@ void World::update(float dt)
 
     PROFILER_PUSH_CPU_MARKER("World::update (AI)", 0x40, 0x7F, 0x00);
     const int kart_amount = (int)m_karts.size();
+    // Take the new positions from physics first, so that the batched
+    // terrain rays and all controllers use the same, latest positions.
+    for (int i = 0 ; i < kart_amount; ++i)
+    {
+        if(!m_karts[i]->isEliminated()) m_karts[i]->updatePosition();
+    }
+    Kart::castTerrainRays(m_karts);
+    m_ai_perception->update(this);
+
+    // Decide phase: the controllers of all karts evaluate the world (using
+    // the AI perception snapshot) in parallel. The karts (and controllers)
+    // then apply their decisions serially in their update.
+    if(!history->replayHistory())
+    {
+        WorkerPool::get()->parallelFor(kart_amount, 1,
+            [this, dt](unsigned int first, unsigned int last)
+            {
+                for (unsigned int i = first; i < last; i++)
+                {
+                    if(!m_karts[i]->isEliminated())
+                        m_karts[i]->getController()->decide(dt);
+                }
+            }, "AI decide");
+    }
+
     for (int i = 0 ; i < kart_amount; ++i)
     {
         // Update all karts that are not eliminated
         if(!m_karts[i]->isEliminated()) m_karts[i]->update(dt) ;
     }
+    if (CVS->isGLSL())
+        SkidMarkRenderer::getInstance()->update(dt);
     PROFILER_POP_CPU_MARKER();
 
     PROFILER_PUSH_CPU_MARKER("World::update (camera)", 0x60, 0x7F, 0x00);
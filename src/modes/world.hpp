@@ -38,6 +38,7 @@
 #include "LinearMath/btTransform.h"
 
 class AbstractKart;
+class AIPerception;
 class btRigidBody;
 class Controller;
 class PhysicalObject;
@@ -97,6 +98,8 @@ protected:
     RandomGenerator           m_random;
 
     Physics*      m_physics;
+    /** The snapshot of the world used by the AI controllers. */
+    AIPerception* m_ai_perception;
     bool          m_force_disable_fog;
     AbstractKart* m_fastest_kart;
     /** Number of eliminated karts. */
@@ -290,6 +293,8 @@ public:
     void            scheduleExitRace() { m_schedule_exit_race = true; }
     void            scheduleTutorial();
     void            updateWorld(float dt);
+    void            saveGraphicsStates();
+    void            interpolateGraphics(float alpha);
     void            handleExplosion(const Vec3 &xyz, AbstractKart *kart_hit,
                                     PhysicalObject *object);
     AbstractKart*   getPlayerKart(unsigned int player) const;
@@ -320,6 +325,9 @@ public:
     /** Returns a pointer to the physics. */
     Physics        *getPhysics() const { return m_physics; }
     // ------------------------------------------------------------------------
+    /** Returns the snapshot of the world taken for the AI in this frame. */
+    const AIPerception *getAIPerception() const { return m_ai_perception; }
+    // ------------------------------------------------------------------------
     /** Returns a pointer to the track. */
     Track          *getTrack() const { return m_track; }
     // ------------------------------------------------------------------------
@@ -135,7 +135,7 @@ void ClientNetworkManager::run()
         return;
     }
     m_localhost = new STKHost();
-    m_localhost->setupClient(1, 2, 0, 0);
+    m_localhost->setupClient(1, CHANNEL_COUNT, 0, 0);
     m_localhost->startListening();
 
     Log::info("ClientNetworkManager", "Host initialized.");
@@ -171,16 +171,17 @@ void ClientNetworkManager::reset()
 
     m_connected = false;
     m_localhost = new STKHost();
-    m_localhost->setupClient(1, 2, 0, 0);
+    m_localhost->setupClient(1, CHANNEL_COUNT, 0, 0);
     m_localhost->startListening();
 
 }
 
-void ClientNetworkManager::sendPacket(const NetworkString& data, bool reliable)
+void ClientNetworkManager::sendPacket(const NetworkString& data, bool reliable,
+                                      NetworkChannel channel)
 {
     if (m_peers.size() > 1)
         Log::warn("ClientNetworkManager", "Ambiguous send of data.\n");
-    m_peers[0]->sendPacket(data, reliable);
+    m_peers[0]->sendPacket(data, reliable, channel);
 }
 
 STKPeer* ClientNetworkManager::getPeer()
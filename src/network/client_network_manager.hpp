@@ -50,8 +50,10 @@ class ClientNetworkManager : public NetworkManager
         /*! \brief Sends a packet to the server.
          *  \param data : The network 8-bit string to send.
          *  \param reliable : If set to true, ENet will ensure that the packet is received.
+         *  \param channel : The ENet channel to send the packet on.
          */
-        virtual void sendPacket(const NetworkString& data, bool reliable = true);
+        virtual void sendPacket(const NetworkString& data, bool reliable = true,
+                                NetworkChannel channel = CHANNEL_LOBBY);
         
         /*! \brief Get the peer (the server)
          *  \return The peer with whom we're connected (if it exists). NULL elseway.
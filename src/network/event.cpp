@@ -19,12 +19,83 @@
 #include "network/event.hpp"
 #include "network/network_manager.hpp"
 
+#include "utils/lock_free_queue.hpp"
 #include "utils/log.hpp"
 
 #include <string.h>
 
+/** Pool of events that have been processed and can be reused. */
+static LockFreeQueue<Event*, 256> g_free_events;
+
+// ----------------------------------------------------------------------------
+
 Event::Event(ENetEvent* event)
 {
+    peer = new STKPeer*;
+    set(event);
+}
+
+// ----------------------------------------------------------------------------
+
+Event::Event(const Event& event)
+{
+    m_packet = NULL;
+    m_data = event.m_data;
+    // copy the peer
+    peer = new STKPeer*;
+    *peer = *event.peer;
+    type = event.type;
+}
+
+// ----------------------------------------------------------------------------
+
+Event::~Event()
+{
+    delete peer;
+    peer = NULL;
+    m_packet = NULL;
+}
+
+// ----------------------------------------------------------------------------
+
+Event* Event::create(ENetEvent* event)
+{
+    Event* evt;
+    if (!g_free_events.pop(&evt))
+        return new Event(event);
+    evt->set(event);
+    return evt;
+}
+
+// ----------------------------------------------------------------------------
+
+Event* Event::create(const Event& batch, int pos, int size)
+{
+    Event* evt;
+    if (!g_free_events.pop(&evt))
+        evt = new Event(batch);
+    evt->type = EVENT_TYPE_MESSAGE;
+    *evt->peer = *batch.peer;
+    evt->m_packet = NULL;
+    evt->m_data.assign(batch.m_data.getBytes() + pos, size);
+    return evt;
+}
+
+// ----------------------------------------------------------------------------
+
+void Event::release(Event* event)
+{
+    if (!g_free_events.push(event))
+        delete event; // pool is full
+}
+
+// ----------------------------------------------------------------------------
+/** Initialises this event from an ENet event. The data of the packet is
+ *  copied and the packet is destroyed.
+ */
+void Event::set(ENetEvent* event)
+{
+    *peer = NULL;
     switch (event->type)
     {
     case ENET_EVENT_TYPE_CONNECT:
@@ -42,8 +113,11 @@ Event::Event(ENetEvent* event)
     }
     if (type == EVENT_TYPE_MESSAGE)
     {
-        m_data = NetworkString(std::string((char*)(event->packet->data), event->packet->dataLength-1));
+        // reuses the memory of a previously released event
+        m_data.assign(event->packet->data, (int)event->packet->dataLength-1);
     }
+    else
+        m_data.assign(NULL, 0);
 
     m_packet = NULL;
     if (event->packet)
@@ -53,14 +127,21 @@ Event::Event(ENetEvent* event)
         enet_packet_destroy(m_packet); // we got all we need, just remove the data.
     m_packet = NULL;
 
-    std::vector<STKPeer*> peers = NetworkManager::getInstance()->getPeers();
-    peer = new STKPeer*;
-    *peer = NULL;
+    // Registered peers are stored in the user data of their ENet peer, so
+    // that they are found without searching all peers for each message.
+    if (event->peer && event->peer->data)
+    {
+        *peer = (STKPeer*)event->peer->data;
+        return;
+    }
+    const std::vector<STKPeer*> &peers =
+                                    NetworkManager::getInstance()->getPeers();
     for (unsigned int i = 0; i < peers.size(); i++)
     {
         if (peers[i]->m_peer == event->peer)
         {
             *peer = peers[i];
+            event->peer->data = peers[i];
             Log::verbose("Event", "The peer you sought has been found on %lx", (long int)(peer));
             return;
         }
@@ -69,26 +150,14 @@ Event::Event(ENetEvent* event)
     {
         STKPeer* new_peer = new STKPeer();
         new_peer->m_peer = event->peer;
+        if (event->peer)
+            event->peer->data = new_peer;
         *peer = new_peer;
         Log::debug("Event", "Creating a new peer, address are STKPeer:%lx, Peer:%lx", (long int)(new_peer), (long int)(event->peer));
     }
 }
 
-Event::Event(const Event& event)
-{
-    m_packet = NULL;
-    m_data = event.m_data;
-    // copy the peer
-    peer = event.peer;
-    type = event.type;
-}
-
-Event::~Event()
-{
-    delete peer;
-    peer = NULL;
-    m_packet = NULL;
-}
+// ----------------------------------------------------------------------------
 
 void Event::removeFront(int size)
 {
@@ -48,6 +48,9 @@ enum EVENT_TYPE
  * Indeed, when packets are logged, the state of the peer cannot be stored at
  * all times, and then the user of this class can rely only on the address/port
  * of the peer, and not on values that might change over time.
+ * Events received from the network are allocated with create() and must be
+ * given back with release() once they have been processed, so that the
+ * Event objects (and the memory of their data) can be reused.
  */
 class Event
 {
@@ -65,21 +68,43 @@ class Event
          */
         ~Event();
 
+        /*! \brief Get an event for an ENet event, reusing a released one
+         *  if possible. Must only be called from the network listening
+         *  thread.
+         *  \param event : The event that needs to be translated.
+         */
+        static Event* create(ENetEvent* event);
+        /*! \brief Get an event for one message of a batch, reusing a
+         *  released one if possible. Must only be called from the network
+         *  listening thread.
+         *  \param batch : The event the batch was received in.
+         *  \param pos : Position of the message in the data of the batch.
+         *  \param size : Size of the message.
+         */
+        static Event* create(const Event& batch, int pos, int size);
+        /*! \brief Gives an event back to the pool of free events. Can be
+         *  called from any thread.
+         *  \param event : The event that is not needed anymore.
+         */
+        static void release(Event* event);
+
         /*! \brief Remove bytes at the beginning of data.
          *  \param size : The number of bytes to remove.
          */
         void removeFront(int size);
 
-        /*! \brief Get a copy of the data.
-         *  \return A copy of the message data. This is empty for events like
+        /*! \brief Get the data.
+         *  \return The message data. This is empty for events like
          *  connection or disconnections.
          */
-        NetworkString data() const { return m_data; }
+        const NetworkString& data() const { return m_data; }
 
         EVENT_TYPE type;    //!< Type of the event.
         STKPeer** peer;     //!< Pointer to the peer that triggered that event.
 
     private:
+        void set(ENetEvent* event);
+
         NetworkString m_data; //!< Copy of the data passed by the event.
         ENetPacket* m_packet; //!< A pointer on the ENetPacket to be deleted.
 };
@@ -177,7 +177,7 @@ const NetworkPlayerProfile* GameSetup::getProfile(uint8_t id)
 
 //-----------------------------------------------------------------------------
 
-const NetworkPlayerProfile* GameSetup::getProfile(std::string kart_name)
+const NetworkPlayerProfile* GameSetup::getProfile(const std::string &kart_name)
 {
     for (unsigned int i = 0; i < m_players.size(); i++)
     {
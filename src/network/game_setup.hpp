@@ -82,7 +82,7 @@ class GameSetup
          *  \param kart_name : Name of the kart used by the player.
          *  \return The profile of the player having the kart kart_name.
          */
-        const NetworkPlayerProfile* getProfile(std::string kart_name);
+        const NetworkPlayerProfile* getProfile(const std::string &kart_name);
 
         /*! \brief Used to know if a kart is available.
          *  \param kart_name : Name of the kart to check.
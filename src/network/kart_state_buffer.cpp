@@ -0,0 +1,144 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/kart_state_buffer.hpp"
+
+/** Constructor.
+ *  \param max_extrapolation Maximum time (in seconds) a kart will be dead
+ *         reckoned past the newest state. After that it is kept in place.
+ */
+KartStateBuffer::KartStateBuffer(float max_extrapolation)
+{
+    m_max_extrapolation = max_extrapolation;
+    reset();
+}   // KartStateBuffer
+
+// ----------------------------------------------------------------------------
+/** Removes all states. */
+void KartStateBuffer::reset()
+{
+    m_first = 0;
+    m_count = 0;
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Adds a new state. States must be added in increasing time order, a state
+ *  that is not newer than the latest state is ignored. If the buffer is
+ *  full, the oldest state is discarded.
+ *  \param time Server time of this state.
+ *  \param xyz Position of the kart.
+ *  \param rotation Rotation of the kart.
+ */
+void KartStateBuffer::addState(float time, const Vec3 &xyz,
+                               const btQuaternion &rotation)
+{
+    if (m_count > 0 && time <= getLatestTime())
+        return;
+    if (m_count == BUFFER_SIZE)
+    {
+        m_first = (m_first + 1) % BUFFER_SIZE;
+        m_count--;
+    }
+    State &s     = m_states[(m_first + m_count) % BUFFER_SIZE];
+    s.m_time     = time;
+    s.m_xyz      = xyz;
+    s.m_rotation = rotation;
+    m_count++;
+}   // addState
+
+// ----------------------------------------------------------------------------
+/** Estimates the velocity at state n using the neighbouring states. */
+Vec3 KartStateBuffer::getTangent(unsigned int n) const
+{
+    if (m_count < 2)
+        return Vec3(0, 0, 0);
+    unsigned int prev = n > 0         ? n - 1 : n;
+    unsigned int next = n + 1 < m_count ? n + 1 : n;
+    const State &a = getState(prev);
+    const State &b = getState(next);
+    float dt = b.m_time - a.m_time;
+    if (dt <= 0)
+        return Vec3(0, 0, 0);
+    return (b.m_xyz - a.m_xyz) / dt;
+}   // getTangent
+
+// ----------------------------------------------------------------------------
+/** Computes the state of the kart at the specified time.
+ *  \param time The (server) time for which to compute the state.
+ *  \param xyz On return the position.
+ *  \param rotation On return the rotation.
+ *  \param velocity On return the linear velocity.
+ *  \return False if there is no state at all.
+ */
+bool KartStateBuffer::getState(float time, Vec3 *xyz, btQuaternion *rotation,
+                               Vec3 *velocity) const
+{
+    if (m_count == 0)
+        return false;
+
+    const State &first = getState(0);
+    if (time <= first.m_time)
+    {
+        *xyz      = first.m_xyz;
+        *rotation = first.m_rotation;
+        *velocity = getTangent(0);
+        return true;
+    }
+
+    const State &last = getState(m_count - 1);
+    if (time >= last.m_time)
+    {
+        // Dead reckoning for a limited time only, to avoid that a kart
+        // drifts away after a longer packet loss.
+        float dt  = time - last.m_time;
+        if (dt > m_max_extrapolation)
+            dt = m_max_extrapolation;
+        *velocity = getTangent(m_count - 1);
+        *xyz      = last.m_xyz + *velocity * dt;
+        *rotation = last.m_rotation;
+        return true;
+    }
+
+    unsigned int i = 0;
+    while (getState(i + 1).m_time < time)
+        i++;
+    const State &s0 = getState(i);
+    const State &s1 = getState(i + 1);
+    float h  = s1.m_time - s0.m_time;
+    float t  = (time - s0.m_time) / h;
+    float t2 = t*t;
+    float t3 = t2*t;
+    Vec3 m0  = getTangent(i)     * h;
+    Vec3 m1  = getTangent(i + 1) * h;
+
+    // Cubic hermite basis functions and their derivatives
+    float h00 =  2*t3 - 3*t2 + 1;
+    float h10 =    t3 - 2*t2 + t;
+    float h01 = -2*t3 + 3*t2;
+    float h11 =    t3 -   t2;
+    *xyz = s0.m_xyz*h00 + m0*h10 + s1.m_xyz*h01 + m1*h11;
+
+    float d00 =  6*t2 - 6*t;
+    float d10 =  3*t2 - 4*t + 1;
+    float d01 = -6*t2 + 6*t;
+    float d11 =  3*t2 - 2*t;
+    *velocity = (s0.m_xyz*d00 + m0*d10 + s1.m_xyz*d01 + m1*d11) / h;
+
+    *rotation = s0.m_rotation.slerp(s1.m_rotation, t);
+    return true;
+}   // getState
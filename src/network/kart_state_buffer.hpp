@@ -0,0 +1,87 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file kart_state_buffer.hpp
+ *  \brief Time stamped history of the state of a remote kart.
+ */
+
+#ifndef KART_STATE_BUFFER_HPP
+#define KART_STATE_BUFFER_HPP
+
+#include "utils/vec3.hpp"
+
+#include "LinearMath/btQuaternion.h"
+
+/** \class KartStateBuffer
+ *  \brief A small ring buffer of time stamped kart states received from the
+ *  server. It is used to display remote karts slightly in the past, so that
+ *  there are (nearly) always two states to interpolate between. Positions
+ *  are interpolated using cubic hermite splines (the tangents are estimated
+ *  from the neighbouring states), rotations using slerp. If no newer state
+ *  is available, the kart is extrapolated with its last velocity for a
+ *  limited amount of time.
+ *  \ingroup network
+ */
+class KartStateBuffer
+{
+public:
+    /** Maximum number of states kept. */
+    static const unsigned int BUFFER_SIZE = 16;
+
+private:
+    struct State
+    {
+        float        m_time;
+        Vec3         m_xyz;
+        btQuaternion m_rotation;
+    };   // State
+
+    State        m_states[BUFFER_SIZE];
+
+    /** Index of the oldest state in m_states. */
+    unsigned int m_first;
+
+    /** Number of valid states. */
+    unsigned int m_count;
+
+    /** Maximum time a kart is extrapolated past the last known state. */
+    float        m_max_extrapolation;
+
+    const State& getState(unsigned int n) const
+    {
+        return m_states[(m_first + n) % BUFFER_SIZE];
+    }
+    Vec3 getTangent(unsigned int n) const;
+
+public:
+              KartStateBuffer(float max_extrapolation = 0.25f);
+    void      reset();
+    void      addState(float time, const Vec3 &xyz,
+                       const btQuaternion &rotation);
+    bool      getState(float time, Vec3 *xyz, btQuaternion *rotation,
+                       Vec3 *velocity) const;
+    // ------------------------------------------------------------------------
+    /** Returns the number of states stored. */
+    unsigned int getNumberOfStates() const { return m_count; }
+    // ------------------------------------------------------------------------
+    /** Returns the time of the most recent state. Only valid if there is
+     *  at least one state. */
+    float     getLatestTime() const { return getState(m_count-1).m_time; }
+};   // KartStateBuffer
+
+#endif // KART_STATE_BUFFER_HPP
@@ -22,6 +22,7 @@
 #include "network/protocols/show_public_address.hpp"
 #include "network/protocols/get_public_address.hpp"
 
+#include "network/network_statistics.hpp"
 #include "network/protocol_manager.hpp"
 #include "network/client_network_manager.hpp"
 #include "network/server_network_manager.hpp"
@@ -39,6 +40,9 @@ NetworkManager::NetworkManager()
     m_public_address.port = 0;
     m_localhost = NULL;
     m_game_setup = NULL;
+    // The statistics are accessed from several threads, so make sure they
+    // are created before any network thread is started.
+    NetworkStatistics::getInstance();
 }
 
 //-----------------------------------------------------------------------------
@@ -54,6 +58,7 @@ NetworkManager::~NetworkManager()
         delete m_peers.back();
         m_peers.pop_back();
     }
+    NetworkStatistics::kill();
 }
 
 //-----------------------------------------------------------------------------
@@ -92,7 +97,7 @@ bool NetworkManager::connect(TransportAddress peer)
     if (peerExists(peer))
         return isConnectedTo(peer);
 
-    return STKPeer::connectToHost(m_localhost, peer, 2, 0);
+    return STKPeer::connectToHost(m_localhost, peer, CHANNEL_COUNT, 0);
 }
 
 //-----------------------------------------------------------------------------
@@ -135,24 +140,36 @@ void NetworkManager::notifyEvent(Event* event)
 
 //-----------------------------------------------------------------------------
 
-void NetworkManager::sendPacket(STKPeer* peer, const NetworkString& data, bool reliable)
+void NetworkManager::sendPacket(STKPeer* peer, const NetworkString& data,
+                                bool reliable, NetworkChannel channel)
 {
     if (peer)
-        peer->sendPacket(data, reliable);
+        peer->sendPacket(data, reliable, channel);
 }
 
 //-----------------------------------------------------------------------------
 
-void NetworkManager::sendPacketExcept(STKPeer* peer, const NetworkString& data, bool reliable)
+void NetworkManager::sendPacketExcept(STKPeer* peer, const NetworkString& data,
+                                      bool reliable, NetworkChannel channel)
 {
+    // The same packet is sent to all peers, instead of one copy per peer
+    ENetPacket* packet = NULL;
+    unsigned int count = 0;
     for (unsigned int i = 0; i < m_peers.size(); i++)
     {
         STKPeer* p = m_peers[i];
         if (!p->isSamePeer(peer))
         {
-            p->sendPacket(data, reliable);
+            if (!packet)
+                packet = STKPeer::createPacket(data, reliable, channel);
+            p->sendPacket(packet, channel);
+            count++;
         }
     }
+    if (packet && packet->referenceCount == 0)
+        enet_packet_destroy(packet); // it was not queued for any peer
+    if (count > 0)
+        NetworkStatistics::getInstance()->addOutgoingPacket(data, count);
 }
 
 //-----------------------------------------------------------------------------
@@ -178,6 +195,7 @@ void NetworkManager::disconnected()
     // remove all peers
     for (unsigned int i = 0; i < m_peers.size(); i++)
     {
+        m_peers[i]->detach();
         delete m_peers[i];
         m_peers[i] = NULL;
     }
@@ -216,6 +234,7 @@ void NetworkManager::removePeer(STKPeer* peer)
     {
         if (m_peers[i]->isSamePeer(peer) && !removed) // remove only one
         {
+            m_peers[i]->detach();
             delete m_peers[i];
             m_peers.erase(m_peers.begin()+i, m_peers.begin()+i+1);
             Log::verbose("NetworkManager", "The peer has been removed from the Network Manager.");
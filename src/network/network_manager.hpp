@@ -74,15 +74,21 @@ class NetworkManager : public AbstractSingleton<NetworkManager>
         virtual void setManualSocketsMode(bool manual);
 
         // message/packets related functions
+        /** \brief Called by the listening thread for each received event.
+         *  The event is handed over to the ProtocolManager which will
+         *  release it once it is processed. */
         virtual void notifyEvent(Event* event);
         virtual void sendPacket(const NetworkString& data,
-                                bool reliable = true) = 0;
+                                bool reliable = true,
+                                NetworkChannel channel = CHANNEL_LOBBY) = 0;
         virtual void sendPacket(STKPeer* peer,
                                 const NetworkString& data,
-                                bool reliable = true);
+                                bool reliable = true,
+                                NetworkChannel channel = CHANNEL_LOBBY);
         virtual void sendPacketExcept(STKPeer* peer,
                                 const NetworkString& data,
-                                bool reliable = true);
+                                bool reliable = true,
+                                NetworkChannel channel = CHANNEL_LOBBY);
 
         // Game related functions
         virtual GameSetup* setupNewGame(); //!< Creates a new game setup and returns it
@@ -101,7 +107,8 @@ class NetworkManager : public AbstractSingleton<NetworkManager>
         inline bool isClient()              { return !isServer();         }
         bool isPlayingOnline()              { return m_playing_online;    }
         STKHost* getHost()                  { return m_localhost;         }
-        std::vector<STKPeer*> getPeers()    { return m_peers;             }
+        /** Returns the connected peers, without copying them. */
+        const std::vector<STKPeer*>& getPeers() const { return m_peers; }
         unsigned int getPeerCount()         { return (int)m_peers.size(); }
         TransportAddress getPublicAddress() { return m_public_address;    }
         GameSetup* getGameSetup()           { return m_game_setup;        }
@@ -0,0 +1,166 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/network_race_recorder.hpp"
+
+#include "io/file_manager.hpp"
+#include "karts/abstract_kart.hpp"
+#include "modes/world.hpp"
+#include "race/race_manager.hpp"
+#include "tracks/track.hpp"
+#include "utils/log.hpp"
+
+#include <stdio.h>
+#include <time.h>
+
+namespace
+{
+    /** Adds values to the data of a recording in little endian order. */
+    void addUInt8(std::vector<uint8_t> *data, uint8_t value)
+    {
+        data->push_back(value);
+    }   // addUInt8
+
+    void addUInt32(std::vector<uint8_t> *data, uint32_t value)
+    {
+        for (unsigned int i = 0; i < 4; i++)
+            data->push_back((value >> (8*i)) & 0xff);
+    }   // addUInt32
+
+    void addString(std::vector<uint8_t> *data, const std::string &s)
+    {
+        addUInt8(data, (uint8_t)s.size());
+        data->insert(data->end(), s.begin(), s.begin() + (s.size() & 0xff));
+    }   // addString
+}
+
+// ----------------------------------------------------------------------------
+/** Removes all recorded data, called when a race starts. */
+void NetworkRaceRecorder::reset()
+{
+    m_actions.clear();
+    m_items.clear();
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Records an action of a player as it is applied by the server.
+ *  \param tick The tick the action was applied in.
+ *  \param controller_index Index of the kart of the player.
+ *  \param controls The serialized kart controls sent with the action.
+ *  \param action The action.
+ *  \param value The value of the action.
+ */
+void NetworkRaceRecorder::recordAction(uint32_t tick, uint8_t controller_index,
+                                       uint8_t controls, uint8_t action,
+                                       int value)
+{
+    RecordedAction ra;
+    ra.m_tick             = tick;
+    ra.m_controller_index = controller_index;
+    ra.m_controls         = controls;
+    ra.m_action           = action;
+    ra.m_value            = value;
+    m_actions.push_back(ra);
+}   // recordAction
+
+// ----------------------------------------------------------------------------
+/** Records that a kart collected an item.
+ *  \param tick The tick in which the item was collected.
+ *  \param item_id Id of the item.
+ *  \param kart_id World id of the kart.
+ */
+void NetworkRaceRecorder::recordItem(uint32_t tick, uint32_t item_id,
+                                     uint8_t kart_id)
+{
+    RecordedItem ri;
+    ri.m_tick    = tick;
+    ri.m_item_id = item_id;
+    ri.m_kart_id = kart_id;
+    m_items.push_back(ri);
+}   // recordItem
+
+// ----------------------------------------------------------------------------
+/** Writes the recording into the user config directory. The name of the
+ *  file contains the track and the time the race ended at.
+ */
+void NetworkRaceRecorder::save() const
+{
+    World *world = World::getWorld();
+    if (!world)
+        return;
+
+    std::vector<uint8_t> data;
+    data.reserve(64 + m_actions.size()*11 + m_items.size()*9);
+    data.push_back('S'); data.push_back('T');
+    data.push_back('K'); data.push_back('N');
+    addUInt32(&data, VERSION);
+    addString(&data, world->getTrack()->getIdent());
+    addUInt8(&data, (uint8_t)race_manager->getNumLaps());
+    addUInt8(&data, (uint8_t)race_manager->getDifficulty());
+    addUInt8(&data, (uint8_t)world->getNumKarts());
+    for (unsigned int i = 0; i < world->getNumKarts(); i++)
+        addString(&data, world->getKart(i)->getIdent());
+
+    addUInt32(&data, (uint32_t)m_actions.size());
+    for (unsigned int i = 0; i < m_actions.size(); i++)
+    {
+        const RecordedAction &ra = m_actions[i];
+        addUInt32(&data, ra.m_tick);
+        addUInt8(&data, ra.m_controller_index);
+        addUInt8(&data, ra.m_controls);
+        addUInt8(&data, ra.m_action);
+        addUInt32(&data, (uint32_t)ra.m_value);
+    }
+    addUInt32(&data, (uint32_t)m_items.size());
+    for (unsigned int i = 0; i < m_items.size(); i++)
+    {
+        addUInt32(&data, m_items[i].m_tick);
+        addUInt32(&data, m_items[i].m_item_id);
+        addUInt8(&data, m_items[i].m_kart_id);
+    }
+
+    time_t rawtime;
+    time(&rawtime);
+    const tm *time_info = localtime(&rawtime);
+    char time_buffer[32];
+    strftime(time_buffer, sizeof(time_buffer), "%Y.%m.%d_%H.%M.%S",
+             time_info);
+    const std::string filename = file_manager->getUserConfigFile(
+           world->getTrack()->getIdent() + "-" + time_buffer + ".netrace");
+
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f)
+    {
+        Log::error("NetworkRaceRecorder", "Can't open '%s' for writing.",
+                   filename.c_str());
+        return;
+    }
+    bool ok = fwrite(&data[0], 1, data.size(), f) == data.size();
+    ok = fclose(f) == 0 && ok;
+    if (ok)
+    {
+        Log::info("NetworkRaceRecorder", "Saved %d actions and %d items "
+                  "(%d bytes) in '%s'.", (int)m_actions.size(),
+                  (int)m_items.size(), (int)data.size(), filename.c_str());
+    }
+    else
+    {
+        Log::error("NetworkRaceRecorder", "Could not write '%s'.",
+                   filename.c_str());
+    }
+}   // save
@@ -0,0 +1,79 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file network_race_recorder.hpp
+ *  \brief Records the inputs of a networked race on the server.
+ */
+
+#ifndef NETWORK_RACE_RECORDER_HPP
+#define NETWORK_RACE_RECORDER_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include <string>
+#include <vector>
+
+/** \class NetworkRaceRecorder
+ *  \brief Records what the server needs to simulate a networked race again:
+ *  the race setup, the tick stamped actions of all players in the order
+ *  they were applied, and the items that were collected (to check a new
+ *  simulation against). Since the race is simulated in fixed ticks, this
+ *  is enough to reproduce it, at a small fraction of the size of a replay
+ *  that stores the transforms of all karts.
+ *  The recording is written in little endian binary format when the race
+ *  ends: a header with the magic 'STKN', the version, the track, the number
+ *  of laps, the difficulty and the karts, followed by the actions and the
+ *  items.
+ *  \ingroup network
+ */
+class NetworkRaceRecorder : public NoCopy
+{
+private:
+    struct RecordedAction
+    {
+        uint32_t m_tick;
+        uint8_t  m_controller_index;
+        /** The serialized kart controls sent with the action. */
+        uint8_t  m_controls;
+        uint8_t  m_action;
+        int32_t  m_value;
+    };   // RecordedAction
+
+    struct RecordedItem
+    {
+        uint32_t m_tick;
+        uint32_t m_item_id;
+        uint8_t  m_kart_id;
+    };   // RecordedItem
+
+    /** Version of the file format. */
+    static const uint32_t VERSION = 1;
+
+    std::vector<RecordedAction> m_actions;
+    std::vector<RecordedItem>   m_items;
+
+public:
+    void reset();
+    void recordAction(uint32_t tick, uint8_t controller_index,
+                      uint8_t controls, uint8_t action, int value);
+    void recordItem(uint32_t tick, uint32_t item_id, uint8_t kart_id);
+    void save() const;
+};   // NetworkRaceRecorder
+
+#endif // NETWORK_RACE_RECORDER_HPP
@@ -0,0 +1,296 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/network_statistics.hpp"
+
+#include "config/user_config.hpp"
+#include "io/file_manager.hpp"
+#include "network/network_manager.hpp"
+#include "network/network_string.hpp"
+#include "network/stk_peer.hpp"
+#include "utils/log.hpp"
+#include "utils/profiler.hpp"
+#include "utils/time.hpp"
+
+#include <chrono>
+#include <sstream>
+
+/** Names of the protocol types as used in the dump and the summary. */
+static const char* g_protocol_names[NetworkStatistics::NUM_PROTOCOL_TYPES] =
+{
+    "none", "connection", "lobby_room", "start_game", "synchronization",
+    "kart_update", "game_events", "controller_events"
+};
+
+// ----------------------------------------------------------------------------
+NetworkStatistics::NetworkStatistics()
+{
+    for (unsigned int i = 0; i < NUM_PROTOCOL_TYPES; i++)
+    {
+        m_bytes_in[i].store(0);
+        m_bytes_out[i].store(0);
+        m_packets_in[i].store(0);
+        m_packets_out[i].store(0);
+        m_handler_time[i].store(0);
+        m_last_bytes_in[i]     = 0;
+        m_last_bytes_out[i]    = 0;
+        m_last_packets_in[i]   = 0;
+        m_last_packets_out[i]  = 0;
+        m_last_handler_time[i] = 0;
+        m_bytes_in_rate[i]     = 0;
+        m_bytes_out_rate[i]    = 0;
+        m_packets_in_rate[i]   = 0;
+        m_packets_out_rate[i]  = 0;
+        m_handler_time_rate[i] = 0;
+    }
+    m_queued_events.store(0);
+    m_max_queued_events.store(0);
+    m_last_max_queued_events = 0;
+    m_last_update_time       = -1.0;
+
+    m_dump_file = NULL;
+    if (UserConfigParams::m_network_stats_filename.toString() != "")
+    {
+        std::string s = file_manager->getUserConfigFile(
+                                   UserConfigParams::m_network_stats_filename);
+        m_dump_file = fopen(s.c_str(), "w");
+        if (!m_dump_file)
+            Log::warn("NetworkStatistics", "Could not open '%s'.", s.c_str());
+    }
+}   // NetworkStatistics
+
+// ----------------------------------------------------------------------------
+NetworkStatistics::~NetworkStatistics()
+{
+    if (m_dump_file)
+        fclose(m_dump_file);
+}   // ~NetworkStatistics
+
+// ----------------------------------------------------------------------------
+/** Returns a monotonic time stamp in microseconds, used to measure the time
+ *  spent in protocol handlers (StkTime only has millisecond resolution).
+ */
+uint64_t NetworkStatistics::getMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}   // getMicroseconds
+
+// ----------------------------------------------------------------------------
+/** Returns the index of the protocol type of a message, which is stored in
+ *  its first byte.
+ */
+unsigned int NetworkStatistics::getTypeIndex(const NetworkString &ns)
+{
+    if (ns.size() == 0)
+        return PROTOCOL_NONE;
+    unsigned int type = ns[0];
+    return type < NUM_PROTOCOL_TYPES ? type : PROTOCOL_NONE;
+}   // getTypeIndex
+
+// ----------------------------------------------------------------------------
+/** Counts a received message. Called from the listening thread. */
+void NetworkStatistics::addIncomingPacket(const NetworkString &ns)
+{
+    unsigned int type = getTypeIndex(ns);
+    m_bytes_in[type].fetch_add(ns.size(), std::memory_order_relaxed);
+    m_packets_in[type].fetch_add(1, std::memory_order_relaxed);
+    PROFILER_COUNT("Network packets received", 1);
+}   // addIncomingPacket
+
+// ----------------------------------------------------------------------------
+/** Counts a sent message.
+ *  \param ns The message, including the protocol type byte.
+ *  \param num_peers Number of peers the message is sent to.
+ */
+void NetworkStatistics::addOutgoingPacket(const NetworkString &ns,
+                                          unsigned int num_peers)
+{
+    unsigned int type = getTypeIndex(ns);
+    m_bytes_out[type].fetch_add((uint64_t)ns.size()*num_peers,
+                                std::memory_order_relaxed);
+    m_packets_out[type].fetch_add(num_peers, std::memory_order_relaxed);
+}   // addOutgoingPacket
+
+// ----------------------------------------------------------------------------
+/** Adds the time spent in an event handler or update of a protocol. */
+void NetworkStatistics::addHandlerTime(PROTOCOL_TYPE type,
+                                       uint64_t microseconds)
+{
+    unsigned int index = type < NUM_PROTOCOL_TYPES ? type : PROTOCOL_NONE;
+    m_handler_time[index].fetch_add(microseconds, std::memory_order_relaxed);
+}   // addHandlerTime
+
+// ----------------------------------------------------------------------------
+/** Called when an event is queued in the ProtocolManager. */
+void NetworkStatistics::eventQueued()
+{
+    int n = m_queued_events.fetch_add(1, std::memory_order_relaxed) + 1;
+    int max = m_max_queued_events.load(std::memory_order_relaxed);
+    while (n > max &&
+           !m_max_queued_events.compare_exchange_weak(max, n,
+                                                  std::memory_order_relaxed))
+    {
+    }
+}   // eventQueued
+
+// ----------------------------------------------------------------------------
+/** Called when the ProtocolManager took n events from its queue. */
+void NetworkStatistics::eventsDispatched(int n)
+{
+    m_queued_events.fetch_sub(n, std::memory_order_relaxed);
+}   // eventsDispatched
+
+// ----------------------------------------------------------------------------
+/** Computes the rates once per second, samples the peer statistics and
+ *  dumps them if requested. Must be called from the main thread.
+ */
+void NetworkStatistics::update()
+{
+    double now = StkTime::getRealTime();
+    if (m_last_update_time < 0)
+    {
+        m_last_update_time = now;
+        return;
+    }
+    float dt = (float)(now - m_last_update_time);
+    if (dt < 1.0f)
+        return;
+    m_last_update_time = now;
+
+    for (unsigned int i = 0; i < NUM_PROTOCOL_TYPES; i++)
+    {
+        uint64_t bytes_in     = m_bytes_in[i].load();
+        uint64_t bytes_out    = m_bytes_out[i].load();
+        uint32_t packets_in   = m_packets_in[i].load();
+        uint32_t packets_out  = m_packets_out[i].load();
+        uint64_t handler_time = m_handler_time[i].load();
+        m_bytes_in_rate[i]     = (bytes_in     - m_last_bytes_in[i]    ) / dt;
+        m_bytes_out_rate[i]    = (bytes_out    - m_last_bytes_out[i]   ) / dt;
+        m_packets_in_rate[i]   = (packets_in   - m_last_packets_in[i]  ) / dt;
+        m_packets_out_rate[i]  = (packets_out  - m_last_packets_out[i] ) / dt;
+        m_handler_time_rate[i] = (handler_time - m_last_handler_time[i])
+                               / (1000.0f*dt);
+        m_last_bytes_in[i]     = bytes_in;
+        m_last_bytes_out[i]    = bytes_out;
+        m_last_packets_in[i]   = packets_in;
+        m_last_packets_out[i]  = packets_out;
+        m_last_handler_time[i] = handler_time;
+    }
+    m_last_max_queued_events =
+                    m_max_queued_events.exchange(m_queued_events.load());
+
+    m_peers.clear();
+    NetworkManager *manager = NetworkManager::getInstance();
+    if (manager)
+    {
+        const std::vector<STKPeer*> &peers = manager->getPeers();
+        for (unsigned int i = 0; i < peers.size(); i++)
+        {
+            if (!peers[i]->exists())
+                continue;
+            PeerStatistics ps;
+            ps.m_address     = peers[i]->getAddress();
+            ps.m_port        = peers[i]->getPort();
+            ps.m_rtt         = peers[i]->getRoundTripTime();
+            ps.m_jitter      = peers[i]->getRoundTripTimeVariance();
+            ps.m_packet_loss = peers[i]->getPacketLoss();
+            m_peers.push_back(ps);
+        }
+    }
+
+    if (m_dump_file)
+        dump();
+}   // update
+
+// ----------------------------------------------------------------------------
+/** Appends the current rates as one line of JSON to the dump file. */
+void NetworkStatistics::dump()
+{
+    std::ostringstream oss;
+    oss << "{\"time\":" << m_last_update_time
+        << ",\"queued_events\":" << m_queued_events.load()
+        << ",\"max_queued_events\":" << m_last_max_queued_events
+        << ",\"protocols\":{";
+    for (unsigned int i = 0; i < NUM_PROTOCOL_TYPES; i++)
+    {
+        if (i > 0) oss << ",";
+        oss << "\"" << g_protocol_names[i] << "\":{"
+            << "\"bytes_in\":"       << m_bytes_in_rate[i]
+            << ",\"bytes_out\":"     << m_bytes_out_rate[i]
+            << ",\"packets_in\":"    << m_packets_in_rate[i]
+            << ",\"packets_out\":"   << m_packets_out_rate[i]
+            << ",\"handler_ms\":"    << m_handler_time_rate[i] << "}";
+    }
+    oss << "},\"peers\":[";
+    for (unsigned int i = 0; i < m_peers.size(); i++)
+    {
+        const PeerStatistics &p = m_peers[i];
+        if (i > 0) oss << ",";
+        oss << "{\"address\":\"" << ((p.m_address>>24)&0xff) << "."
+            << ((p.m_address>>16)&0xff) << "." << ((p.m_address>>8)&0xff)
+            << "." << (p.m_address&0xff) << ":" << p.m_port << "\""
+            << ",\"rtt\":"    << p.m_rtt
+            << ",\"jitter\":" << p.m_jitter
+            << ",\"loss\":"   << p.m_packet_loss << "}";
+    }
+    oss << "]}\n";
+    fputs(oss.str().c_str(), m_dump_file);
+    fflush(m_dump_file);
+}   // dump
+
+// ----------------------------------------------------------------------------
+/** Returns a short human readable summary of the statistics, as shown in
+ *  the profiler.
+ */
+std::string NetworkStatistics::getSummary() const
+{
+    float in = 0, out = 0, handler = 0;
+    for (unsigned int i = 0; i < NUM_PROTOCOL_TYPES; i++)
+    {
+        in      += m_bytes_in_rate[i];
+        out     += m_bytes_out_rate[i];
+        handler += m_handler_time_rate[i];
+    }
+    std::ostringstream oss;
+    oss.precision(3);
+    oss << "Network: in " << in/1024.0f << " kB/s, out " << out/1024.0f
+        << " kB/s, handlers " << handler << " ms/s, queue "
+        << m_queued_events.load() << " (max " << m_last_max_queued_events
+        << ")\n";
+    for (unsigned int i = 0; i < NUM_PROTOCOL_TYPES; i++)
+    {
+        if (m_bytes_in_rate[i] == 0 && m_bytes_out_rate[i] == 0 &&
+            m_handler_time_rate[i] == 0)
+            continue;
+        oss << "  " << g_protocol_names[i] << ": in "
+            << m_bytes_in_rate[i]/1024.0f << " kB/s, out "
+            << m_bytes_out_rate[i]/1024.0f << " kB/s, "
+            << m_handler_time_rate[i] << " ms/s\n";
+    }
+    for (unsigned int i = 0; i < m_peers.size(); i++)
+    {
+        const PeerStatistics &p = m_peers[i];
+        oss << "  peer " << ((p.m_address>>24)&0xff) << "."
+            << ((p.m_address>>16)&0xff) << "." << ((p.m_address>>8)&0xff)
+            << "." << (p.m_address&0xff) << ":" << p.m_port
+            << ": rtt " << p.m_rtt << " ms, jitter " << p.m_jitter
+            << " ms, loss " << p.m_packet_loss*100.0f << "%\n";
+    }
+    return oss.str();
+}   // getSummary
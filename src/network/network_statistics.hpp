@@ -0,0 +1,129 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file network_statistics.hpp
+ *  \brief Counters about the network traffic and the protocol handlers.
+ */
+
+#ifndef NETWORK_STATISTICS_HPP
+#define NETWORK_STATISTICS_HPP
+
+#include "network/protocol.hpp"
+#include "utils/singleton.hpp"
+#include "utils/types.hpp"
+
+#include <atomic>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class NetworkString;
+
+/** \class NetworkStatistics
+ *  \brief Collects statistics about the network: bytes and packets sent and
+ *  received per protocol type, the number of events waiting in the
+ *  ProtocolManager, the time spent in the event handlers and updates of
+ *  each protocol type, and the round trip time, jitter and packet loss of
+ *  each peer (as measured by ENet).
+ *  The counters can be updated from any thread without locking. The rates
+ *  are computed once per second by update() (which must be called from the
+ *  main thread); they are shown in the profiler and, if
+ *  UserConfigParams::m_network_stats_filename is set, appended as one line
+ *  of JSON per second to that file.
+ *  \ingroup network
+ */
+class NetworkStatistics : public Singleton<NetworkStatistics>
+{
+    friend class Singleton<NetworkStatistics>;
+public:
+    /** Number of different protocol types, indexed by the PROTOCOL_TYPE
+     *  values. Unknown types are counted as PROTOCOL_NONE. */
+    static const unsigned int NUM_PROTOCOL_TYPES = PROTOCOL_CONTROLLER_EVENTS+1;
+
+    /** Statistics of one peer, sampled once per second. */
+    struct PeerStatistics
+    {
+        uint32_t m_address;
+        uint16_t m_port;
+        /** Mean round trip time in ms. */
+        uint32_t m_rtt;
+        /** Variance of the round trip time (jitter) in ms. */
+        uint32_t m_jitter;
+        /** Mean loss of reliable packets, between 0 and 1. */
+        float    m_packet_loss;
+    };   // PeerStatistics
+
+private:
+    /** Counters that are updated from the network threads. */
+    std::atomic<uint64_t> m_bytes_in[NUM_PROTOCOL_TYPES];
+    std::atomic<uint64_t> m_bytes_out[NUM_PROTOCOL_TYPES];
+    std::atomic<uint32_t> m_packets_in[NUM_PROTOCOL_TYPES];
+    std::atomic<uint32_t> m_packets_out[NUM_PROTOCOL_TYPES];
+    /** Time spent in the handlers of each protocol type, in us. */
+    std::atomic<uint64_t> m_handler_time[NUM_PROTOCOL_TYPES];
+    /** Number of events received but not yet dispatched. */
+    std::atomic<int>      m_queued_events;
+    /** Maximum of m_queued_events since the last update. */
+    std::atomic<int>      m_max_queued_events;
+
+    /** Values of the counters at the time of the last update, used to
+     *  compute the rates. */
+    uint64_t m_last_bytes_in[NUM_PROTOCOL_TYPES];
+    uint64_t m_last_bytes_out[NUM_PROTOCOL_TYPES];
+    uint32_t m_last_packets_in[NUM_PROTOCOL_TYPES];
+    uint32_t m_last_packets_out[NUM_PROTOCOL_TYPES];
+    uint64_t m_last_handler_time[NUM_PROTOCOL_TYPES];
+
+    /** Rates per second computed in the last update. */
+    float    m_bytes_in_rate[NUM_PROTOCOL_TYPES];
+    float    m_bytes_out_rate[NUM_PROTOCOL_TYPES];
+    float    m_packets_in_rate[NUM_PROTOCOL_TYPES];
+    float    m_packets_out_rate[NUM_PROTOCOL_TYPES];
+    /** Time in ms per second spent in the handlers of each type. */
+    float    m_handler_time_rate[NUM_PROTOCOL_TYPES];
+    int      m_last_max_queued_events;
+
+    std::vector<PeerStatistics> m_peers;
+
+    /** Real time of the last update. */
+    double   m_last_update_time;
+
+    /** File to which the statistics are dumped, or NULL. */
+    FILE    *m_dump_file;
+
+             NetworkStatistics();
+    virtual ~NetworkStatistics();
+    static unsigned int getTypeIndex(const NetworkString &ns);
+    void     dump();
+
+public:
+    void        addIncomingPacket(const NetworkString &ns);
+    void        addOutgoingPacket(const NetworkString &ns,
+                                  unsigned int num_peers = 1);
+    void        addHandlerTime(PROTOCOL_TYPE type, uint64_t microseconds);
+    void        eventQueued();
+    void        eventsDispatched(int n);
+    void        update();
+    std::string getSummary() const;
+    static uint64_t getMicroseconds();
+    // ------------------------------------------------------------------------
+    /** Returns the statistics of all peers at the last update. */
+    const std::vector<PeerStatistics>& getPeers() const { return m_peers; }
+};   // NetworkStatistics
+
+#endif // NETWORK_STATISTICS_HPP
@@ -16,9 +16,107 @@
 //  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "network/network_string.hpp"
 
+#include <pthread.h>
+
 NetworkString operator+(NetworkString const& a, NetworkString const& b)
 {
     NetworkString ns(a);
     ns += b;
     return ns;
 }
+
+// ----------------------------------------------------------------------------
+/** Maximum number of free buffers kept per thread. */
+static const unsigned int MAX_POOLED_BUFFERS = 32;
+/** Buffers that grew larger than this are freed instead of pooled. */
+static const unsigned int MAX_POOLED_CAPACITY = 64*1024;
+
+static pthread_key_t  g_buffer_pool_key;
+static pthread_once_t g_buffer_pool_once = PTHREAD_ONCE_INIT;
+
+// ----------------------------------------------------------------------------
+/** Frees the buffers of a thread's pool when the thread exits. */
+void NetworkString::deleteBufferPool(void *data)
+{
+    std::vector<Buffer*> *pool = static_cast<std::vector<Buffer*>*>(data);
+    for (unsigned int i = 0; i < pool->size(); i++)
+        delete (*pool)[i];
+    delete pool;
+}   // deleteBufferPool
+
+// ----------------------------------------------------------------------------
+void NetworkString::createBufferPoolKey()
+{
+    pthread_key_create(&g_buffer_pool_key, deleteBufferPool);
+}   // createBufferPoolKey
+
+// ----------------------------------------------------------------------------
+/** Returns the pool of free buffers of the calling thread. */
+std::vector<NetworkString::Buffer*>* NetworkString::getBufferPool()
+{
+    pthread_once(&g_buffer_pool_once, createBufferPoolKey);
+    std::vector<Buffer*> *pool =
+        static_cast<std::vector<Buffer*>*>(pthread_getspecific(g_buffer_pool_key));
+    if (!pool)
+    {
+        pool = new std::vector<Buffer*>();
+        pool->reserve(MAX_POOLED_BUFFERS);
+        pthread_setspecific(g_buffer_pool_key, pool);
+    }
+    return pool;
+}   // getBufferPool
+
+// ----------------------------------------------------------------------------
+/** Returns an empty buffer with a reference count of one, reusing a buffer
+ *  from the calling thread's pool if possible.
+ */
+NetworkString::Buffer* NetworkString::allocateBuffer()
+{
+    std::vector<Buffer*> *pool = getBufferPool();
+    Buffer *buffer;
+    if (pool->empty())
+        buffer = new Buffer();
+    else
+    {
+        buffer = pool->back();
+        pool->pop_back();
+        buffer->m_data.clear();   // keeps the capacity
+    }
+    buffer->m_ref_count.store(1);
+    return buffer;
+}   // allocateBuffer
+
+// ----------------------------------------------------------------------------
+/** Decreases the reference count of a buffer, and puts it into the calling
+ *  thread's pool once it is not used anymore.
+ */
+void NetworkString::releaseBuffer(Buffer *buffer)
+{
+    if (--buffer->m_ref_count > 0)
+        return;
+    std::vector<Buffer*> *pool = getBufferPool();
+    if (pool->size() >= MAX_POOLED_BUFFERS ||
+        buffer->m_data.capacity() > MAX_POOLED_CAPACITY)
+    {
+        delete buffer;
+        return;
+    }
+    pool->push_back(buffer);
+}   // releaseBuffer
+
+// ----------------------------------------------------------------------------
+/** Gives this string its own buffer (e.g. before it is modified), which
+ *  only contains the bytes after the read cursor.
+ */
+void NetworkString::makeUnique()
+{
+    Buffer *buffer = allocateBuffer();
+    if (m_buffer)
+    {
+        buffer->m_data.assign(m_buffer->m_data.begin()+m_current_offset,
+                              m_buffer->m_data.end());
+        releaseBuffer(m_buffer);
+    }
+    m_buffer         = buffer;
+    m_current_offset = 0;
+}   // makeUnique
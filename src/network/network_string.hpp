@@ -25,6 +25,7 @@
 
 #include "utils/types.hpp"
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <stdarg.h>
@@ -35,6 +36,12 @@ typedef unsigned char uchar;
 /** \class NetworkString
  *  \brief Describes a chain of 8-bit unsigned integers.
  *  This class allows you to easily create and parse 8-bit strings.
+ *  The bytes are stored in a reference counted buffer which is shared
+ *  between copies of a string (copy on write), so copying a received
+ *  message is cheap. Removing bytes from the front only advances a read
+ *  cursor, so parsing a message with the getAndRemove functions is O(n).
+ *  Buffers are taken from and given back to a small per-thread pool, so
+ *  that the steady-state packet handling does not allocate memory.
  */
 class NetworkString
 {
@@ -46,20 +53,94 @@ class NetworkString
     double d;
     uint8_t i[8];
     } d_as_i; // double as integer
+
+    /** The memory shared between copies of a network string. */
+    struct Buffer
+    {
+        std::vector<uint8_t> m_data;
+        std::atomic<int>     m_ref_count;
+    };   // Buffer
+
+    static Buffer* allocateBuffer();
+    static void    releaseBuffer(Buffer* buffer);
+    static std::vector<Buffer*>* getBufferPool();
+    static void    createBufferPoolKey();
+    static void    deleteBufferPool(void *data);
+    void           makeUnique();
+
+    // ------------------------------------------------------------------------
+    /** Returns the data for modification, making a private copy first if
+     *  the buffer is shared with another string. */
+    std::vector<uint8_t>& writable()
+    {
+        if (!m_buffer || m_buffer->m_ref_count.load() > 1)
+            makeUnique();
+        return m_buffer->m_data;
+    }   // writable
+
+    // ------------------------------------------------------------------------
+    /** Returns the byte at the given position relative to the read cursor. */
+    uint8_t at(int pos) const
+    {
+        assert(pos >= 0 && pos < size());
+        return m_buffer->m_data[m_current_offset+pos];
+    }   // at
+
     public:
-        NetworkString() { }
-        NetworkString(const uint8_t& value) { m_string.push_back(value); }
-        NetworkString(NetworkString const& copy) { m_string = copy.m_string; }
-        NetworkString(const std::string & value) { m_string = std::vector<uint8_t>(value.begin(), value.end()); }
+        NetworkString() : m_buffer(NULL), m_current_offset(0) { }
+        NetworkString(const uint8_t& value) : m_buffer(NULL), m_current_offset(0)
+        {
+            writable().push_back(value);
+        }
+        NetworkString(NetworkString const& copy)
+        {
+            m_buffer         = copy.m_buffer;
+            m_current_offset = copy.m_current_offset;
+            if (m_buffer)
+                m_buffer->m_ref_count++;
+        }
+        NetworkString(const std::string & value) : m_buffer(NULL), m_current_offset(0)
+        {
+            writable().assign(value.begin(), value.end());
+        }
+        ~NetworkString()
+        {
+            if (m_buffer)
+                releaseBuffer(m_buffer);
+        }
+        NetworkString& operator=(NetworkString const& copy)
+        {
+            if (copy.m_buffer)
+                copy.m_buffer->m_ref_count++;
+            if (m_buffer)
+                releaseBuffer(m_buffer);
+            m_buffer         = copy.m_buffer;
+            m_current_offset = copy.m_current_offset;
+            return *this;
+        }
 
+        /** Replaces the content with the given bytes, reusing the already
+         *  allocated memory if possible. */
+        void assign(const uint8_t* data, int size)
+        {
+            m_current_offset = 0;
+            writable().assign(data, data+size);
+        }
+
+        /** Skips the first size bytes. This only moves the read cursor. */
         NetworkString& removeFront(int size)
         {
-            m_string.erase(m_string.begin(), m_string.begin()+size);
+            assert(size <= this->size());
+            m_current_offset += size;
             return *this;
         }
         NetworkString& remove(int pos, int size)
         {
-            m_string.erase(m_string.begin()+pos, m_string.begin()+pos+size);
+            if (pos == 0)
+                return removeFront(size);
+            std::vector<uint8_t> &data = writable();
+            data.erase(data.begin()+m_current_offset+pos,
+                       data.begin()+m_current_offset+pos+size);
             return *this;
         }
 
@@ -70,32 +151,35 @@ class NetworkString
 
         NetworkString& addUInt8(const uint8_t& value)
         {
-            m_string.push_back(value);
+            writable().push_back(value);
             return *this;
         }
         inline NetworkString& ai8(const uint8_t& value) { return addUInt8(value); }
         NetworkString& addUInt16(const uint16_t& value)
         {
-            m_string.push_back((value>>8)&0xff);
-            m_string.push_back(value&0xff);
+            std::vector<uint8_t> &data = writable();
+            data.push_back((value>>8)&0xff);
+            data.push_back(value&0xff);
             return *this;
         }
         inline NetworkString& ai16(const uint16_t& value) { return addUInt16(value); }
         NetworkString& addUInt32(const uint32_t& value)
         {
-            m_string.push_back((value>>24)&0xff);
-            m_string.push_back((value>>16)&0xff);
-            m_string.push_back((value>>8)&0xff);
-            m_string.push_back(value&0xff);
+            std::vector<uint8_t> &data = writable();
+            data.push_back((value>>24)&0xff);
+            data.push_back((value>>16)&0xff);
+            data.push_back((value>>8)&0xff);
+            data.push_back(value&0xff);
             return *this;
         }
         inline NetworkString& ai32(const uint32_t& value) { return addUInt32(value); }
         NetworkString& addInt(const int& value)
         {
-            m_string.push_back((value>>24)&0xff);
-            m_string.push_back((value>>16)&0xff);
-            m_string.push_back((value>>8)&0xff);
-            m_string.push_back(value&0xff);
+            std::vector<uint8_t> &data = writable();
+            data.push_back((value>>24)&0xff);
+            data.push_back((value>>16)&0xff);
+            data.push_back((value>>8)&0xff);
+            data.push_back(value&0xff);
             return *this;
         }
         inline NetworkString& ai(const int& value) { return addInt(value); }
@@ -103,10 +187,8 @@ class NetworkString
         {
             assert(sizeof(float)==4);
             f_as_i.f = value;
-            m_string.push_back(f_as_i.i[0]);
-            m_string.push_back(f_as_i.i[1]);
-            m_string.push_back(f_as_i.i[2]);
-            m_string.push_back(f_as_i.i[3]);
+            std::vector<uint8_t> &data = writable();
+            data.insert(data.end(), f_as_i.i, f_as_i.i+4);
             return *this;
         }
         inline NetworkString& af(const float& value) { return addFloat(value); }
@@ -114,51 +196,58 @@ class NetworkString
         {
             assert(sizeof(double)==8);
             d_as_i.d = value;
-            m_string.push_back(d_as_i.i[0]);
-            m_string.push_back(d_as_i.i[1]);
-            m_string.push_back(d_as_i.i[2]);
-            m_string.push_back(d_as_i.i[3]);
-            m_string.push_back(d_as_i.i[4]);
-            m_string.push_back(d_as_i.i[5]);
-            m_string.push_back(d_as_i.i[6]);
-            m_string.push_back(d_as_i.i[7]);
+            std::vector<uint8_t> &data = writable();
+            data.insert(data.end(), d_as_i.i, d_as_i.i+8);
             return *this;
         }
         inline NetworkString& ad(const double& value) { return addDouble(value); }
         NetworkString& addChar(const char& value)
         {
-            m_string.push_back((uint8_t)(value));
+            writable().push_back((uint8_t)(value));
             return *this;
         }
         inline NetworkString& ac(const char& value) { return addChar(value); }
 
         NetworkString& addString(const std::string& value)
         {
-            for (unsigned int i = 0; i < value.size(); i++)
-                m_string.push_back((uint8_t)(value[i]));
+            std::vector<uint8_t> &data = writable();
+            data.insert(data.end(), value.begin(), value.end());
             return *this;
         }
         inline NetworkString& as(const std::string& value) { return addString(value); }
 
         NetworkString& operator+=(NetworkString const& value)
         {
-            m_string.insert( m_string.end(), value.m_string.begin(), value.m_string.end() );
+            if (value.size() == 0)
+                return *this;
+            // Keep a reference in case value shares (or is) our buffer
+            NetworkString source(value);
+            const uint8_t *begin = source.getBytes();
+            std::vector<uint8_t> &data = writable();
+            data.insert(data.end(), begin, begin+source.size());
             return *this;
         }
 
         const std::string std_string() const
         {
-            std::string str(m_string.begin(), m_string.end());
+            if (size() == 0)
+                return std::string();
+            std::string str(m_buffer->m_data.begin()+m_current_offset,
+                            m_buffer->m_data.end());
             return str;
         }
 
         int size() const
         {
-            return (int)m_string.size();
+            return m_buffer ? (int)m_buffer->m_data.size() - m_current_offset
+                            : 0;
         }
 
-        uint8_t* getBytes() { return &m_string[0]; };
-        const uint8_t* getBytes() const { return &m_string[0]; };
+        uint8_t* getBytes() { return writable().data() + m_current_offset; };
+        const uint8_t* getBytes() const
+        {
+            return m_buffer ? m_buffer->m_data.data() + m_current_offset : NULL;
+        };
 
         template<typename T, size_t n>
         T get(int pos) const
@@ -168,7 +257,7 @@ class NetworkString
             while(a--)
             {
                 result <<= 8; // offset one byte
-                result += ((uint8_t)(m_string[pos+n-1-a]) & 0xff); // add the data to result
+                result += ((uint8_t)(at(pos+n-1-a)) & 0xff); // add the data to result
             }
             return result;
         }
@@ -180,7 +269,7 @@ class NetworkString
         inline uint8_t      getUInt8(int pos = 0)  const { return get<uint8_t,1>(pos);         }
         inline char         getChar(int pos = 0)   const { return get<char,1>(pos);            }
         inline unsigned char getUChar(int pos = 0) const { return get<unsigned char,1>(pos);   }
-        std::string         getString(int pos, int len) const { return std::string(m_string.begin()+pos, m_string.begin()+pos+len); }
+        std::string         getString(int pos, int len) const { return std::string((const char*)getBytes()+pos, len); }
 
         inline int          gi(int pos = 0)        const { return get<int,4>(pos);             }
         inline uint32_t     gui(int pos = 0)       const { return get<uint32_t,4>(pos);        }
@@ -189,32 +278,27 @@ class NetworkString
         inline uint8_t      gui8(int pos = 0)      const { return get<uint8_t,1>(pos);         }
         inline char         gc(int pos = 0)        const { return get<char,1>(pos);            }
         inline unsigned char guc(int pos = 0)      const { return get<unsigned char,1>(pos);   }
-        std::string         gs(int pos, int len)   const { return std::string(m_string.begin()+pos, m_string.begin()+pos+len); }
+        std::string         gs(int pos, int len)   const { return getString(pos, len); }
 
         double getDouble(int pos = 0) //!< BEWARE OF PRECISION
         {
             for (int i = 0; i < 8; i++)
-                d_as_i.i[i] = m_string[pos+i];
+                d_as_i.i[i] = at(pos+i);
             return d_as_i.d;
         }
         float getFloat(int pos = 0) //!< BEWARE OF PRECISION
         {
             for (int i = 0; i < 4; i++)
-                f_as_i.i[i] = m_string[pos+i];
+                f_as_i.i[i] = at(pos+i);
             return f_as_i.f;
         }
 
-        //! Functions to get while removing
+        //! Functions to get while removing. Reading from the front only
+        //! advances the read cursor.
         template<typename T, size_t n>
         T getAndRemove(int pos)
         {
-            int a = n;
-            T result = 0;
-            while(a--)
-            {
-                result <<= 8; // offset one byte
-                result += ((uint8_t)(m_string[pos+n-1-a]) & 0xff); // add the data
-            }
+            T result = get<T, n>(pos);
             remove(pos,n);
             return result;
         }
@@ -228,17 +312,15 @@ class NetworkString
         inline unsigned char getAndRemoveUChar(int pos = 0)  { return getAndRemove<unsigned char,1>(pos);   }
         double getAndRemoveDouble(int pos = 0) //!< BEWARE OF PRECISION
         {
-            for (int i = 0; i < 8; i++)
-                d_as_i.i[i] = m_string[pos+i];
-            return d_as_i.d;
+            double result = getDouble(pos);
             remove(pos, 8);
+            return result;
         }
         float getAndRemoveFloat(int pos = 0) //!< BEWARE OF PRECISION
         {
-            for (int i = 0; i < 4; i++)
-                f_as_i.i[i] = m_string[pos+i];
-            return f_as_i.f;
+            float result = getFloat(pos);
             remove(pos, 4);
+            return result;
         }
 
         inline NetworkString& gui8(uint8_t* dst)   { *dst = getAndRemoveUInt8(0);  return *this; }
@@ -252,7 +334,10 @@ class NetworkString
         inline NetworkString& gf(float* dst)       { *dst = getAndRemoveFloat(0);  return *this; }
 
     protected:
-        std::vector<uint8_t> m_string;
+        /** The (possibly shared) buffer, NULL if nothing was added yet. */
+        Buffer* m_buffer;
+        /** Read cursor: number of bytes at the front that were removed. */
+        int     m_current_offset;
 };
 
 NetworkString operator+(NetworkString const& a, NetworkString const& b);
@@ -5,14 +5,21 @@
 #include "network/protocols/synchronization_protocol.hpp"
 #include "network/protocols/controller_events_protocol.hpp"
 #include "network/protocols/game_events_protocol.hpp"
+#include "network/protocols/kart_update_protocol.hpp"
 #include "modes/world.hpp"
 
+#include "items/item.hpp"
+#include "karts/abstract_kart.hpp"
 #include "karts/controller/controller.hpp"
 
+const float NetworkWorld::TICK_DURATION = 1.0f/60.0f;
+
 NetworkWorld::NetworkWorld()
 {
     m_running = false;
     m_has_run = false;
+    m_current_tick     = 0;
+    m_tick_accumulator = 0.0f;
 }
 
 NetworkWorld::~NetworkWorld()
@@ -34,23 +41,50 @@ void NetworkWorld::update(float dt)
         }
         World::getWorld()->setNetworkWorld(true);
     }
-    World::getWorld()->updateWorld(dt);
-    if (World::getWorld()->getPhase() >= WorldStatus::RESULT_DISPLAY_PHASE) // means it's the end
+    ControllerEventsProtocol* controller_events =
+        static_cast<ControllerEventsProtocol*>(ProtocolManager::getInstance()
+                              ->getProtocol(PROTOCOL_CONTROLLER_EVENTS));
+    KartUpdateProtocol* kart_update = static_cast<KartUpdateProtocol*>(
+        ProtocolManager::getInstance()->getProtocol(PROTOCOL_KART_UPDATE));
+
+    m_tick_accumulator += dt;
+    while (m_tick_accumulator >= TICK_DURATION)
     {
-        // consider the world finished.
-        stop();
-        Log::info("NetworkWorld", "The game is considered finish.");
+        m_tick_accumulator -= TICK_DURATION;
+        if (controller_events)
+            controller_events->applyActions(m_current_tick);
+        World::getWorld()->updateWorld(TICK_DURATION);
+        m_current_tick++;
+        if (kart_update)
+            kart_update->endOfTick(m_current_tick);
+        if (World::getWorld()->getPhase() >= WorldStatus::RESULT_DISPLAY_PHASE) // means it's the end
+        {
+            // consider the world finished.
+            stop();
+            Log::info("NetworkWorld", "The game is considered finish.");
+            break;
+        }
     }
 }
 
 void NetworkWorld::start()
 {
     m_running = true;
+    m_current_tick     = 0;
+    m_tick_accumulator = 0.0f;
+    m_recorder.reset();
 }
 
 void NetworkWorld::stop()
 {
     m_running = false;
+    if (NetworkManager::getInstance()->isServer())
+        m_recorder.save();
+    // The clocks were kept synchronized during the race only
+    Protocol *protocol = ProtocolManager::getInstance()
+                       ->getProtocol(PROTOCOL_SYNCHRONIZATION);
+    if (protocol)
+        ProtocolManager::getInstance()->requestTerminate(protocol);
 }
 
 bool NetworkWorld::isRaceOver()
@@ -63,6 +97,8 @@ bool NetworkWorld::isRaceOver()
 void NetworkWorld::collectedItem(Item *item, AbstractKart *kart)
 {
     assert(NetworkManager::getInstance()->isServer()); // this is only called in the server
+    m_recorder.recordItem(m_current_tick, item->getItemId(),
+                          (uint8_t)kart->getWorldKartId());
     GameEventsProtocol* protocol = static_cast<GameEventsProtocol*>(
         ProtocolManager::getInstance()->getProtocol(PROTOCOL_GAME_EVENTS));
     protocol->collectedItem(item,kart);
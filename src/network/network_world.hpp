@@ -23,7 +23,9 @@
 #define NETWORK_WORLD_HPP
 
 #include "input/input.hpp"
+#include "network/network_race_recorder.hpp"
 #include "utils/singleton.hpp"
+#include "utils/types.hpp"
 #include <map>
 
 class Controller;
@@ -33,11 +35,18 @@ class Item;
 
 /*! \brief Manages the world updates during an online game
  *  This function's update is to be called instead of the normal World update
+ *  The world is simulated in fixed ticks of TICK_DURATION seconds, which
+ *  are counted from the end of the countdown on. Inputs and kart states
+ *  sent over the network are stamped with the tick number, so that server
+ *  and clients refer to the same simulation step.
 */
 class NetworkWorld : public AbstractSingleton<NetworkWorld>
 {
     friend class AbstractSingleton<NetworkWorld>;
     public:
+        /** Duration of one simulation tick. */
+        static const float TICK_DURATION;
+
         void update(float dt);
 
         void start();
@@ -47,12 +56,23 @@ class NetworkWorld : public AbstractSingleton<NetworkWorld>
 
         void collectedItem(Item *item, AbstractKart *kart);
         void controllerAction(Controller* controller, PlayerAction action, int value);
+        /** Returns the number of the tick that is simulated next. */
+        uint32_t getCurrentTick() const { return m_current_tick; }
+        /** Server only: returns the recorder of the current race. */
+        NetworkRaceRecorder* getRecorder() { return &m_recorder; }
 
         std::string m_self_kart;
     protected:
         bool m_running;
         float m_race_time;
         bool m_has_run;
+        /** Number of the next tick to simulate. */
+        uint32_t m_current_tick;
+        /** Time not yet simulated because it is less than a tick. */
+        float m_tick_accumulator;
+        /** Server only: records the inputs of the race, saved when the race
+         *  is over. */
+        NetworkRaceRecorder m_recorder;
 
     private:
         NetworkWorld();
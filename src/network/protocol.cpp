@@ -25,6 +25,8 @@ Protocol::Protocol(CallbackObject* callback_object, PROTOCOL_TYPE type)
 {
     m_callback_object = callback_object;
     m_type = type;
+    // Poll as often as the protocol manager did before it was event driven
+    m_asynchronous_update_interval = 0.002;
 }
 
 Protocol::~Protocol()
@@ -89,7 +91,7 @@ bool Protocol::isByteCorrect(Event* event, int byte_nb, int value)
 
 void Protocol::sendMessageToPeersChangingToken(NetworkString prefix, NetworkString message)
 {
-    std::vector<STKPeer*> peers = NetworkManager::getInstance()->getPeers();
+    const std::vector<STKPeer*> &peers = NetworkManager::getInstance()->getPeers();
     for (unsigned int i = 0; i < peers.size(); i++)
     {
         prefix.ai8(4).ai32(peers[i]->getClientServerToken());
@@ -43,6 +43,7 @@ enum PROTOCOL_TYPE
     PROTOCOL_KART_UPDATE = 5,   //!< Protocol to update karts position, rotation etc...
     PROTOCOL_GAME_EVENTS = 6,   //!< Protocol to communicate the game events.
     PROTOCOL_CONTROLLER_EVENTS = 7,//!< Protocol to transfer controller modifications
+    PROTOCOL_BATCH = 8,         //!< Several messages sent in one packet, see ProtocolManager.
     PROTOCOL_SILENT = 0xffff    //!< Used for protocols that do not subscribe to any network event.
 };
 
@@ -104,6 +105,22 @@ class Protocol
         /*! \brief Called by the protocol listener as often as possible. Must be re-defined.
          */
         virtual void asynchronousUpdate() = 0;
+        /*! \brief Sets how often asynchronousUpdate is called.
+         *  \param interval : Time in seconds between two calls. A negative
+         *  value means that it is never called, i.e. the protocol only
+         *  reacts to events.
+         */
+        void setAsynchronousUpdateInterval(double interval)
+        {
+            m_asynchronous_update_interval = interval;
+        }
+        /*! \brief Returns the time between two calls of asynchronousUpdate
+         *  in seconds, negative if it is not called at all.
+         */
+        double getAsynchronousUpdateInterval() const
+        {
+            return m_asynchronous_update_interval;
+        }
         /*! \brief Called when the protocol is to be killed.
          */
         virtual void kill();
@@ -123,6 +140,7 @@ class Protocol
         ProtocolManager* m_listener;        //!< The protocol listener
         PROTOCOL_TYPE m_type;               //!< The type of the protocol
         CallbackObject* m_callback_object;   //!< The callback object, if needed
+        double m_asynchronous_update_interval; //!< Seconds between calls of asynchronousUpdate
 };
 
 #endif // PROTOCOL_HPP
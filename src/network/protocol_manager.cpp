@@ -20,12 +20,15 @@
 
 #include "network/protocol.hpp"
 #include "network/network_manager.hpp"
+#include "network/network_statistics.hpp"
 #include "utils/log.hpp"
 #include "utils/time.hpp"
 
 #include <assert.h>
+#include <chrono>
 #include <cstdlib>
 #include <errno.h>
+#include <map>
 #include <typeinfo>
 
 void* protocolManagerUpdate(void* data)
@@ -45,7 +48,7 @@ void* protocolManagerAsynchronousUpdate(void* data)
     while(manager && !manager->exit())
     {
         manager->asynchronousUpdate();
-        StkTime::sleep(2);
+        manager->waitForAsynchronousWork();
     }
     manager->m_asynchronous_thread_running = false;
     return NULL;
@@ -59,6 +62,11 @@ ProtocolManager::ProtocolManager()
     pthread_mutex_init(&m_requests_mutex, NULL);
     pthread_mutex_init(&m_id_mutex, NULL);
     pthread_mutex_init(&m_exit_mutex, NULL);
+    pthread_mutex_init(&m_outgoing_mutex, NULL);
+    pthread_mutex_init(&m_asynchronous_wakeup_mutex, NULL);
+    pthread_cond_init(&m_asynchronous_cond, NULL);
+    m_asynchronous_wakeup = false;
+    m_next_asynchronous_update = 0;
     m_next_protocol_id = 0;
 
 
@@ -81,7 +89,9 @@ ProtocolManager::~ProtocolManager()
 
 void ProtocolManager::abort()
 {
+    flushOutgoingMessages();
     pthread_mutex_unlock(&m_exit_mutex); // will stop the update function
+    wakeUpAsynchronousThread();
     pthread_join(*m_asynchronous_update_thread, NULL); // wait the thread to finish
     pthread_mutex_lock(&m_events_mutex);
     pthread_mutex_lock(&m_protocols_mutex);
@@ -92,6 +102,9 @@ void ProtocolManager::abort()
         delete m_protocols[i].protocol;
     for (unsigned int i = 0; i < m_events_to_process.size() ; i++)
         delete m_events_to_process[i].event;
+    Event* event;
+    while (m_incoming_events.pop(&event))
+        delete event;
     m_protocols.clear();
     m_requests.clear();
     m_events_to_process.clear();
@@ -107,80 +120,294 @@ void ProtocolManager::abort()
     pthread_mutex_destroy(&m_requests_mutex);
     pthread_mutex_destroy(&m_id_mutex);
     pthread_mutex_destroy(&m_exit_mutex);
+    pthread_mutex_destroy(&m_outgoing_mutex);
+    pthread_mutex_destroy(&m_asynchronous_wakeup_mutex);
+    pthread_cond_destroy(&m_asynchronous_cond);
 }
 
 void ProtocolManager::notifyEvent(Event* event)
 {
-    pthread_mutex_lock(&m_events_mutex);
-    Event* event2 = new Event(*event);
-    // register protocols that will receive this event
-    std::vector<unsigned int> protocols_ids;
-    PROTOCOL_TYPE searchedProtocol = PROTOCOL_NONE;
-    if (event2->type == EVENT_TYPE_MESSAGE)
+    // A batch is split into one event per message (see
+    // flushOutgoingMessages), so that protocols never see batches.
+    if (event->type == EVENT_TYPE_MESSAGE && event->data().size() > 0 &&
+        event->data()[0] == PROTOCOL_BATCH)
     {
-        if (event2->data().size() > 0)
-        {
-            searchedProtocol = (PROTOCOL_TYPE)(event2->data()[0]);
-            event2->removeFront(1);
-        }
-        else
+        const NetworkString& data = event->data();
+        int pos = 1;
+        while (pos + 2 <= data.size())
         {
-            Log::warn("ProtocolManager", "Not enough data.");
+            int size = data.gui16(pos);
+            if (size == 0 || pos + 2 + size > data.size())
+            {
+                Log::warn("ProtocolManager", "Invalid message batch.");
+                break;
+            }
+            pushIncomingEvent(Event::create(*event, pos + 2, size));
+            pos += 2 + size;
         }
+        Event::release(event);
     }
-    if (event2->type == EVENT_TYPE_CONNECTED)
+    else
+        pushIncomingEvent(event);
+    wakeUpAsynchronousThread();
+}
+
+/** Pushes an event in the queue of events to dispatch. */
+void ProtocolManager::pushIncomingEvent(Event* event)
+{
+    // The queue is only full if the update threads are stuck: wait for
+    // them instead of dropping (possibly reliable) messages.
+    while (!m_incoming_events.push(event))
+        StkTime::sleep(1);
+    NetworkStatistics::getInstance()->eventQueued();
+}
+
+/** Wakes up the asynchronous thread, e.g. because an event or a request
+ *  arrived. Can be called from any thread.
+ */
+void ProtocolManager::wakeUpAsynchronousThread()
+{
+    pthread_mutex_lock(&m_asynchronous_wakeup_mutex);
+    m_asynchronous_wakeup = true;
+    pthread_cond_signal(&m_asynchronous_cond);
+    pthread_mutex_unlock(&m_asynchronous_wakeup_mutex);
+}
+
+/** Called by the asynchronous thread after each asynchronousUpdate: sleeps
+ *  until the thread is woken up or until the next protocol must be updated.
+ */
+void ProtocolManager::waitForAsynchronousWork()
+{
+    pthread_mutex_lock(&m_asynchronous_wakeup_mutex);
+    double wait = m_next_asynchronous_update - StkTime::getRealTime();
+    if (!m_asynchronous_wakeup && wait > 0)
     {
-        searchedProtocol = PROTOCOL_CONNECTION;
+        // pthread_cond_timedwait takes an absolute time
+        std::chrono::system_clock::duration t =
+               std::chrono::system_clock::now().time_since_epoch()
+             + std::chrono::microseconds((long long)(wait*1000000.0));
+        long long ns =
+             std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+        struct timespec deadline;
+        deadline.tv_sec  = (time_t)(ns / 1000000000);
+        deadline.tv_nsec = (long)(ns % 1000000000);
+        // Returns on timeout, signal or spurious wakeup: in all cases the
+        // protocols are updated and the deadline is computed again.
+        pthread_cond_timedwait(&m_asynchronous_cond,
+                               &m_asynchronous_wakeup_mutex, &deadline);
     }
-    Log::verbose("ProtocolManager", "Received event for protocols of type %d", searchedProtocol);
+    m_asynchronous_wakeup = false;
+    pthread_mutex_unlock(&m_asynchronous_wakeup_mutex);
+}
+
+/** Moves all events received by the listening thread into
+ *  m_events_to_process, and determines the protocols that must receive them.
+ *  The list of protocols for each PROTOCOL_TYPE is only computed once per
+ *  batch. Must be called with m_events_mutex locked (which also makes sure
+ *  that only one thread at a time pops from the lock-free queue).
+ */
+void ProtocolManager::drainIncomingEvents()
+{
+    Event* event;
+    if (!m_incoming_events.pop(&event))
+        return;
+    int count = 0;
+
+    // Protocols ids for each protocol type, index PROTOCOL_NONE is used
+    // for disconnection events, which are sent to all protocols.
+    std::map<int, std::vector<unsigned int> > ids_per_type;
     pthread_mutex_lock(&m_protocols_mutex);
-    for (unsigned int i = 0; i < m_protocols.size() ; i++)
+    do
     {
-        if (m_protocols[i].protocol->getProtocolType() == searchedProtocol || event2->type == EVENT_TYPE_DISCONNECTED) // pass data to protocols even when paused
+        count++;
+        PROTOCOL_TYPE searchedProtocol = PROTOCOL_NONE;
+        if (event->type == EVENT_TYPE_MESSAGE)
         {
-            protocols_ids.push_back(m_protocols[i].id);
+            if (event->data().size() > 0)
+            {
+                searchedProtocol = (PROTOCOL_TYPE)(event->data()[0]);
+                event->removeFront(1);
+            }
+            else
+            {
+                Log::warn("ProtocolManager", "Not enough data.");
+            }
         }
-    }
-    pthread_mutex_unlock(&m_protocols_mutex);
-    if (searchedProtocol == PROTOCOL_NONE) // no protocol was aimed, show the msg to debug
-    {
-        Log::debug("ProtocolManager", "NO PROTOCOL : Message is \"%s\"", event2->data().std_string().c_str());
-    }
+        if (event->type == EVENT_TYPE_CONNECTED)
+        {
+            searchedProtocol = PROTOCOL_CONNECTION;
+        }
+        Log::verbose("ProtocolManager", "Received event for protocols of type %d", searchedProtocol);
 
-    if (protocols_ids.size() != 0)
-    {
-        EventProcessingInfo epi;
-        epi.arrival_time = (double)StkTime::getTimeSinceEpoch();
-        epi.event = event2;
-        epi.protocols_ids = protocols_ids;
-        m_events_to_process.push_back(epi); // add the event to the queue
-    }
-    else
-        Log::warn("ProtocolManager", "Received an event for %d that has no destination protocol.", searchedProtocol);
-    pthread_mutex_unlock(&m_events_mutex);
+        bool to_all = event->type == EVENT_TYPE_DISCONNECTED;
+        int key = to_all ? (int)PROTOCOL_NONE : (int)searchedProtocol;
+        std::map<int, std::vector<unsigned int> >::iterator ids =
+                                                      ids_per_type.find(key);
+        if (ids == ids_per_type.end())
+        {
+            std::vector<unsigned int> &protocols_ids = ids_per_type[key];
+            for (unsigned int i = 0; i < m_protocols.size() ; i++)
+            {
+                if (m_protocols[i].protocol->getProtocolType() == searchedProtocol || to_all) // pass data to protocols even when paused
+                {
+                    protocols_ids.push_back(m_protocols[i].id);
+                }
+            }
+            ids = ids_per_type.find(key);
+        }
+
+        if (!to_all && searchedProtocol == PROTOCOL_NONE) // no protocol was aimed, show the msg to debug
+        {
+            Log::debug("ProtocolManager", "NO PROTOCOL : Message is \"%s\"", event->data().std_string().c_str());
+        }
+
+        if (ids->second.size() != 0)
+        {
+            EventProcessingInfo epi;
+            epi.arrival_time = (double)StkTime::getTimeSinceEpoch();
+            epi.event = event;
+            epi.protocols_ids = ids->second;
+            m_events_to_process.push_back(epi); // add the event to the queue
+        }
+        else
+        {
+            Log::warn("ProtocolManager", "Received an event for %d that has no destination protocol.", searchedProtocol);
+            Event::release(event);
+        }
+    } while (m_incoming_events.pop(&event));
+    pthread_mutex_unlock(&m_protocols_mutex);
+    NetworkStatistics::getInstance()->eventsDispatched(count);
 }
 
 void ProtocolManager::sendMessage(Protocol* sender, const NetworkString& message, bool reliable)
 {
-    NetworkString newMessage;
-    newMessage.ai8(sender->getProtocolType()); // add one byte to add protocol type
-    newMessage += message;
-    NetworkManager::getInstance()->sendPacket(newMessage, reliable);
+    queueMessage(OUTGOING_ALL, NULL, sender, message, reliable);
 }
 
 void ProtocolManager::sendMessage(Protocol* sender, STKPeer* peer, const NetworkString& message, bool reliable)
 {
-    NetworkString newMessage;
-    newMessage.ai8(sender->getProtocolType()); // add one byte to add protocol type
-    newMessage += message;
-    NetworkManager::getInstance()->sendPacket(peer, newMessage, reliable);
+    if (peer)
+        queueMessage(OUTGOING_PEER, peer, sender, message, reliable);
 }
 void ProtocolManager::sendMessageExcept(Protocol* sender, STKPeer* peer, const NetworkString& message, bool reliable)
+{
+    queueMessage(OUTGOING_ALL_EXCEPT, peer, sender, message, reliable);
+}
+
+/** Returns the channel the messages of a protocol are sent on. Each
+ *  protocol always uses the same channel, so its messages keep their order.
+ */
+static NetworkChannel getChannel(PROTOCOL_TYPE type)
+{
+    switch (type)
+    {
+    case PROTOCOL_KART_UPDATE:       return CHANNEL_STATE;
+    case PROTOCOL_GAME_EVENTS:
+    case PROTOCOL_CONTROLLER_EVENTS: return CHANNEL_EVENTS;
+    default:                         return CHANNEL_LOBBY;
+    }
+}   // getChannel
+
+/** Adds a message to the batch of messages for its peers, see
+ *  flushOutgoingMessages.
+ */
+void ProtocolManager::queueMessage(OutgoingTarget target, STKPeer* peer,
+                                   Protocol* sender,
+                                   const NetworkString& message,
+                                   bool reliable)
 {
     NetworkString newMessage;
     newMessage.ai8(sender->getProtocolType()); // add one byte to add protocol type
     newMessage += message;
-    NetworkManager::getInstance()->sendPacketExcept(peer, newMessage, reliable);
+    const NetworkChannel channel = getChannel(sender->getProtocolType());
+    if (newMessage.size() > 0xffff)
+    {
+        // Too big for the size field of a batch
+        flushOutgoingMessages();
+        sendPacket(target, peer, newMessage, reliable, channel);
+        return;
+    }
+
+    pthread_mutex_lock(&m_outgoing_mutex);
+    OutgoingBatch* batch = NULL;
+    for (int i = (int)m_outgoing.size() - 1; i >= 0; i--)
+    {
+        OutgoingBatch& b = m_outgoing[i];
+        if (b.reliable != reliable || b.channel != channel)
+            continue;
+        bool same_peers = b.target == target && b.peer == peer;
+        if (reliable)
+        {
+            // Only the last reliable batch can be used, to keep the order
+            if (same_peers)
+                batch = &b;
+            break;
+        }
+        if (same_peers &&
+            b.data.size() + 2 + newMessage.size() < MAX_UNRELIABLE_BATCH_SIZE)
+        {
+            batch = &b;
+            break;
+        }
+    }
+    if (!batch)
+    {
+        m_outgoing.push_back(OutgoingBatch());
+        batch = &m_outgoing.back();
+        batch->target   = target;
+        batch->peer     = peer;
+        batch->reliable = reliable;
+        batch->channel  = channel;
+        batch->count    = 0;
+    }
+    batch->data.ai16((uint16_t)newMessage.size());
+    batch->data += newMessage;
+    batch->count++;
+    pthread_mutex_unlock(&m_outgoing_mutex);
+}
+
+void ProtocolManager::flushOutgoingMessages()
+{
+    pthread_mutex_lock(&m_outgoing_mutex);
+    for (unsigned int i = 0; i < m_outgoing.size(); i++)
+    {
+        OutgoingBatch& b = m_outgoing[i];
+        NetworkString packet;
+        if (b.count == 1)
+        {
+            // A single message is sent as is
+            packet = b.data;
+            packet.removeFront(2);
+        }
+        else
+        {
+            packet.ai8(PROTOCOL_BATCH);
+            packet += b.data;
+        }
+        sendPacket(b.target, b.peer, packet, b.reliable, b.channel);
+    }
+    m_outgoing.clear();
+    pthread_mutex_unlock(&m_outgoing_mutex);
+}
+
+/** Sends a packet with the network manager. */
+void ProtocolManager::sendPacket(OutgoingTarget target, STKPeer* peer,
+                                 const NetworkString& data, bool reliable,
+                                 NetworkChannel channel)
+{
+    NetworkManager *manager = NetworkManager::getInstance();
+    switch (target)
+    {
+    case OUTGOING_ALL:
+        manager->sendPacket(data, reliable, channel);
+        break;
+    case OUTGOING_PEER:
+        manager->sendPacket(peer, data, reliable, channel);
+        break;
+    case OUTGOING_ALL_EXCEPT:
+        manager->sendPacketExcept(peer, data, reliable, channel);
+        break;
+    }
 }
 
 uint32_t ProtocolManager::requestStart(Protocol* protocol)
@@ -190,6 +417,7 @@ uint32_t ProtocolManager::requestStart(Protocol* protocol)
     ProtocolInfo info;
     info.protocol = protocol;
     info.state = PROTOCOL_STATE_RUNNING;
+    info.next_asynchronous_update = 0;
     assignProtocolId(&info); // assign a unique id to the protocol.
     req.protocol_info = info;
     req.type = PROTOCOL_REQUEST_START;
@@ -197,6 +425,7 @@ uint32_t ProtocolManager::requestStart(Protocol* protocol)
     pthread_mutex_lock(&m_requests_mutex);
     m_requests.push_back(req);
     pthread_mutex_unlock(&m_requests_mutex);
+    wakeUpAsynchronousThread();
 
     return info.id;
 }
@@ -213,6 +442,7 @@ void ProtocolManager::requestStop(Protocol* protocol)
     pthread_mutex_lock(&m_requests_mutex);
     m_requests.push_back(req);
     pthread_mutex_unlock(&m_requests_mutex);
+    wakeUpAsynchronousThread();
 }
 
 void ProtocolManager::requestPause(Protocol* protocol)
@@ -227,6 +457,7 @@ void ProtocolManager::requestPause(Protocol* protocol)
     pthread_mutex_lock(&m_requests_mutex);
     m_requests.push_back(req);
     pthread_mutex_unlock(&m_requests_mutex);
+    wakeUpAsynchronousThread();
 }
 
 void ProtocolManager::requestUnpause(Protocol* protocol)
@@ -241,6 +472,7 @@ void ProtocolManager::requestUnpause(Protocol* protocol)
     pthread_mutex_lock(&m_requests_mutex);
     m_requests.push_back(req);
     pthread_mutex_unlock(&m_requests_mutex);
+    wakeUpAsynchronousThread();
 }
 
 void ProtocolManager::requestTerminate(Protocol* protocol)
@@ -264,6 +496,7 @@ void ProtocolManager::requestTerminate(Protocol* protocol)
     }
     m_requests.push_back(req);
     pthread_mutex_unlock(&m_requests_mutex);
+    wakeUpAsynchronousThread();
 }
 
 void ProtocolManager::startProtocol(ProtocolInfo protocol)
@@ -333,10 +566,14 @@ bool ProtocolManager::propagateEvent(EventProcessingInfo* event, bool synchronou
         if (event->protocols_ids[index] == m_protocols[i].id)
         {
             bool result = false;
+            uint64_t start = NetworkStatistics::getMicroseconds();
             if (synchronous)
                 result = m_protocols[i].protocol->notifyEvent(event->event);
             else
                 result = m_protocols[i].protocol->notifyEventAsynchronous(event->event);
+            NetworkStatistics::getInstance()->addHandlerTime(
+                                   m_protocols[i].protocol->getProtocolType(),
+                                   NetworkStatistics::getMicroseconds()-start);
             if (result)
                 event->protocols_ids.pop_back();
             else
@@ -345,9 +582,7 @@ bool ProtocolManager::propagateEvent(EventProcessingInfo* event, bool synchronou
     }
     if (event->protocols_ids.size() == 0 || (StkTime::getTimeSinceEpoch()-event->arrival_time) >= TIME_TO_KEEP_EVENTS)
     {
-        // because we made a copy of the event
-        delete event->event->peer; // no more need of that
-        delete event->event;
+        Event::release(event->event);
         return true;
     }
     return false;
@@ -357,6 +592,7 @@ void ProtocolManager::update()
 {
     // before updating, notice protocols that they have received events
     pthread_mutex_lock(&m_events_mutex); // secure threads
+    drainIncomingEvents();
     int size = (int)m_events_to_process.size();
     int offset = 0;
     for (int i = 0; i < size; i++)
@@ -374,15 +610,24 @@ void ProtocolManager::update()
     for (unsigned int i = 0; i < m_protocols.size(); i++)
     {
         if (m_protocols[i].state == PROTOCOL_STATE_RUNNING)
+        {
+            uint64_t start = NetworkStatistics::getMicroseconds();
             m_protocols[i].protocol->update();
+            NetworkStatistics::getInstance()->addHandlerTime(
+                                   m_protocols[i].protocol->getProtocolType(),
+                                   NetworkStatistics::getMicroseconds()-start);
+        }
     }
     pthread_mutex_unlock(&m_protocols_mutex);
+    flushOutgoingMessages();
+    NetworkStatistics::getInstance()->update();
 }
 
 void ProtocolManager::asynchronousUpdate()
 {
     // before updating, notice protocols that they have received information
     pthread_mutex_lock(&m_events_mutex); // secure threads
+    drainIncomingEvents();
     int size = (int)m_events_to_process.size();
     int offset = 0;
     for (int i = 0; i < size; i++)
@@ -394,16 +639,38 @@ void ProtocolManager::asynchronousUpdate()
             offset --;
         }
     }
+    double now  = StkTime::getRealTime();
+    double next = now + MAX_ASYNCHRONOUS_SLEEP;
+    // Events that were not handled yet (e.g. because they are handled in
+    // the main thread) are tried again soon, and dropped after some time.
+    if (m_events_to_process.size() > 0)
+        next = now + 0.002;
     pthread_mutex_unlock(&m_events_mutex); // release the mutex
 
-    // now update all protocols that need to be updated in asynchronous mode
+    // now update all protocols that need to be updated in asynchronous
+    // mode, i.e. whose update interval has passed
     pthread_mutex_lock(&m_asynchronous_protocols_mutex);
     for (unsigned int i = 0; i < m_protocols.size(); i++)
     {
-        if (m_protocols[i].state == PROTOCOL_STATE_RUNNING)
+        if (m_protocols[i].state != PROTOCOL_STATE_RUNNING)
+            continue;
+        double interval = m_protocols[i].protocol->getAsynchronousUpdateInterval();
+        if (interval < 0)
+            continue;
+        if (now >= m_protocols[i].next_asynchronous_update)
+        {
+            uint64_t start = NetworkStatistics::getMicroseconds();
             m_protocols[i].protocol->asynchronousUpdate();
+            NetworkStatistics::getInstance()->addHandlerTime(
+                                   m_protocols[i].protocol->getProtocolType(),
+                                   NetworkStatistics::getMicroseconds()-start);
+            m_protocols[i].next_asynchronous_update = now + interval;
+        }
+        if (m_protocols[i].next_asynchronous_update < next)
+            next = m_protocols[i].next_asynchronous_update;
     }
     pthread_mutex_unlock(&m_asynchronous_protocols_mutex);
+    m_next_asynchronous_update = next;
 
     // process queued events for protocols
     // these requests are asynchronous
@@ -431,6 +698,7 @@ void ProtocolManager::asynchronousUpdate()
     }
     m_requests.clear();
     pthread_mutex_unlock(&m_requests_mutex);
+    flushOutgoingMessages();
 }
 
 int ProtocolManager::runningProtocolsCount()
@@ -26,6 +26,8 @@
 #include "network/event.hpp"
 #include "network/network_string.hpp"
 #include "network/protocol.hpp"
+#include "network/types.hpp"
+#include "utils/lock_free_queue.hpp"
 #include "utils/singleton.hpp"
 #include "utils/types.hpp"
 
@@ -33,6 +35,13 @@
 
 #define TIME_TO_KEEP_EVENTS 1.0
 
+/** Maximum time the asynchronous thread sleeps if there is nothing to do. */
+#define MAX_ASYNCHRONOUS_SLEEP 1.0
+
+/** Maximum size of a batch of unreliable messages, so that it fits in one
+ *  datagram together with the ENet and UDP headers. */
+#define MAX_UNRELIABLE_BATCH_SIZE 1200
+
 /*!
  * \enum PROTOCOL_STATE
  * \brief Defines the three states that a protocol can have.
@@ -68,6 +77,7 @@ typedef struct ProtocolInfo
     PROTOCOL_STATE  state;      //!< The state of the protocol
     Protocol*       protocol;   //!< A pointer to the protocol
     uint32_t        id;         //!< The unique id of the protocol
+    double          next_asynchronous_update; //!< When to call asynchronousUpdate next
 } ProtocolInfo;
 
 /*!
@@ -113,21 +123,39 @@ class ProtocolManager : public AbstractSingleton<ProtocolManager>
         /*!
          * \brief Function that processes incoming events.
          * This function is called by the network manager each time there is an
-         * incoming packet.
+         * incoming packet. It only pushes the event into a lock-free queue,
+         * the events are dispatched to the protocols in batches the next
+         * time one of the update functions is called. The protocol manager
+         * takes ownership of the event, which is released with
+         * Event::release once it is processed.
          */
         virtual void            notifyEvent(Event* event);
         /*!
-         * \brief WILL BE COMMENTED LATER
+         * \brief Sends a message to all peers.
+         * The message is queued and sent at the end of the next update,
+         * together with the other messages to the same peers (see
+         * flushOutgoingMessages).
          */
         virtual void            sendMessage(Protocol* sender, const NetworkString& message, bool reliable = true);
         /*!
-         * \brief WILL BE COMMENTED LATER
+         * \brief Sends a message to one peer, see sendMessage.
          */
         virtual void            sendMessage(Protocol* sender, STKPeer* peer, const NetworkString& message, bool reliable = true);
         /*!
-         * \brief WILL BE COMMENTED LATER
+         * \brief Sends a message to all peers but one, see sendMessage.
          */
         virtual void            sendMessageExcept(Protocol* sender, STKPeer* peer, const NetworkString& message, bool reliable = true);
+        /*!
+         * \brief Sends the queued messages.
+         * Messages queued for the same peers and channel are sent in one
+         * packet, which starts with PROTOCOL_BATCH and contains the size
+         * (16 bits) and data of each message. Unreliable batches are limited
+         * to MAX_UNRELIABLE_BATCH_SIZE. Reliable messages are only batched
+         * with the reliable message queued just before them on their
+         * channel, so that they still arrive in the order they were sent.
+         * Called at the end of both update functions.
+         */
+        void                    flushOutgoingMessages();
 
         /*!
          * \brief Asks the manager to start a protocol.
@@ -284,7 +312,31 @@ class ProtocolManager : public AbstractSingleton<ProtocolManager>
          */
         virtual void            protocolTerminated(ProtocolInfo protocol);
 
+        /*! Who a queued message is sent to. */
+        enum OutgoingTarget
+        {
+            OUTGOING_ALL,       //!< All peers (or the server).
+            OUTGOING_PEER,      //!< One peer.
+            OUTGOING_ALL_EXCEPT //!< All peers but one.
+        };
+        /*! Queued messages for the same peers, sent as one packet. */
+        struct OutgoingBatch
+        {
+            OutgoingTarget target;
+            STKPeer*       peer;
+            bool           reliable;
+            NetworkChannel channel;
+            int            count;   //!< Number of messages in data.
+            NetworkString  data;    //!< Size and data of each message.
+        };
+
+        void                    queueMessage(OutgoingTarget target, STKPeer* peer, Protocol* sender, const NetworkString& message, bool reliable);
+        void                    sendPacket(OutgoingTarget target, STKPeer* peer, const NetworkString& data, bool reliable, NetworkChannel channel);
+        void                    pushIncomingEvent(Event* event);
         bool                    propagateEvent(EventProcessingInfo* event, bool synchronous);
+        void                    drainIncomingEvents();
+        void                    wakeUpAsynchronousThread();
+        void                    waitForAsynchronousWork();
 
         // protected members
         /*!
@@ -293,6 +345,13 @@ class ProtocolManager : public AbstractSingleton<ProtocolManager>
          * state and their unique id.
          */
         std::vector<ProtocolInfo>       m_protocols;
+        /*!
+         * \brief Events received by the listening thread that have not yet
+         * been dispatched. The listening thread pushes without any lock,
+         * the queue is drained (with m_events_mutex locked) by the update
+         * functions.
+         */
+        LockFreeQueue<Event*, 1024>     m_incoming_events;
         /*!
          * \brief Contains the network events to pass to protocols.
          */
@@ -307,6 +366,8 @@ class ProtocolManager : public AbstractSingleton<ProtocolManager>
          * been formerly started.
          */
         uint32_t                        m_next_protocol_id;
+        /*! \brief Messages queued by the sendMessage functions. */
+        std::vector<OutgoingBatch>      m_outgoing;
 
         // mutexes:
         /*! Used to ensure that the event queue is used thread-safely.       */
@@ -321,6 +382,19 @@ class ProtocolManager : public AbstractSingleton<ProtocolManager>
         pthread_mutex_t                 m_id_mutex;
         /*! Used when need to quit.*/
         pthread_mutex_t                 m_exit_mutex;
+        /*! Protects m_outgoing, messages are sent from several threads.     */
+        pthread_mutex_t                 m_outgoing_mutex;
+        /*! Protects m_asynchronous_wakeup, used with m_asynchronous_cond. */
+        pthread_mutex_t                 m_asynchronous_wakeup_mutex;
+        /*! The asynchronous thread sleeps on this condition until there is
+         *  an event or request, or until the next protocol wants to be
+         *  updated. */
+        pthread_cond_t                  m_asynchronous_cond;
+        /*! True if the asynchronous thread was woken up. */
+        bool                            m_asynchronous_wakeup;
+        /*! Real time at which asynchronousUpdate must be called next. Only
+         *  accessed by the asynchronous thread. */
+        double                          m_next_asynchronous_update;
 
         /*! Update thread.*/
         pthread_t* m_update_thread;
@@ -33,6 +33,7 @@ ClientLobbyRoomProtocol::ClientLobbyRoomProtocol(const TransportAddress& server_
 {
     m_server_address = server_address;
     m_server = NULL;
+    setAsynchronousUpdateInterval(-1);   // only reacts to events
 }
 
 //-----------------------------------------------------------------------------
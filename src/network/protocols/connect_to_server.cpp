@@ -36,6 +36,11 @@
 #include <ifaddrs.h>
 #endif
 
+/** Timeouts (in seconds) of the steps of joining a server. */
+static const double STUN_TIMEOUT     = 10.0;
+static const double REQUEST_TIMEOUT  = 15.0;
+static const double CONNECT_TIMEOUT  = 30.0;
+
 // ----------------------------------------------------------------------------
 
 ConnectToServer::ConnectToServer() :
@@ -87,8 +92,55 @@ void ConnectToServer::setup()
     m_server_address.ip = 0;
     m_server_address.port = 0;
     m_current_protocol_id = 0;
+    m_server_protocol_id = 0;
+    m_server_request_started = false;
+    m_step_start_time = StkTime::getRealTime();
 }
 
+// ----------------------------------------------------------------------------
+/** Changes the state and starts the timeout of the new step. */
+void ConnectToServer::setState(STATE state)
+{
+    m_state = state;
+    m_step_start_time = StkTime::getRealTime();
+}   // setState
+
+// ----------------------------------------------------------------------------
+bool ConnectToServer::isTerminated(uint32_t protocol_id)
+{
+    return m_listener->getProtocolState(protocol_id)
+        == PROTOCOL_STATE_TERMINATED;
+}   // isTerminated
+
+// ----------------------------------------------------------------------------
+bool ConnectToServer::hasTimedOut(double timeout) const
+{
+    return StkTime::getRealTime() > m_step_start_time + timeout;
+}   // hasTimedOut
+
+// ----------------------------------------------------------------------------
+/** Gives up joining after a step timed out: stops the protocols that are
+ *  still running and hides our address again if it was published.
+ *  \param step Description of the step for the log.
+ */
+void ConnectToServer::abort(const char* step)
+{
+    Log::error("ConnectToServer", "Timed out while %s.", step);
+    m_listener->requestTerminate(m_listener->getProtocol(m_current_protocol_id));
+    if (m_server_request_started)
+        m_listener->requestTerminate(m_listener->getProtocol(m_server_protocol_id));
+    if (m_state == GETTING_SELF_ADDRESS)
+    {
+        m_state = DONE;
+        return;
+    }
+    // The address might have changed
+    if (m_state == CONNECTING)
+        GetPublicAddress::clearCache();
+    m_state = HIDING_ADDRESS;
+    m_current_protocol_id = m_listener->requestStart(new HidePublicAddress());
+}   // abort
+
 // ----------------------------------------------------------------------------
 
 void ConnectToServer::asynchronousUpdate()
@@ -99,51 +151,55 @@ void ConnectToServer::asynchronousUpdate()
         {
             Log::info("ConnectToServer", "Protocol starting");
             m_current_protocol_id = m_listener->requestStart(new GetPublicAddress(&m_public_address));
-            m_state = GETTING_SELF_ADDRESS;
+            // Quick join doesn't need our address, find the server meanwhile
+            if (m_quick_join)
+            {
+                m_server_protocol_id = m_listener->requestStart(new QuickJoinProtocol(&m_server_address, &m_server_id));
+                m_server_request_started = true;
+            }
+            setState(GETTING_SELF_ADDRESS);
             break;
         }
         case GETTING_SELF_ADDRESS:
-            if (m_listener->getProtocolState(m_current_protocol_id)
-            == PROTOCOL_STATE_TERMINATED) // now we know the public addr
+            if (isTerminated(m_current_protocol_id)) // now we know the public addr
             {
-                m_state = SHOWING_SELF_ADDRESS;
                 NetworkManager::getInstance()->setPublicAddress(m_public_address); // set our public address
-                m_current_protocol_id = m_listener->requestStart(new ShowPublicAddress());
                 Log::info("ConnectToServer", "Public address known");
-                /*
-                if (m_quick_join)
-                    m_current_protocol_id = m_listener->requestStart(new QuickJoinProtocol(&m_server_address, &m_server_id));
-                else
-                    m_current_protocol_id = m_listener->requestStart(new GetPeerAddress(m_server_id, &m_server_address));*/
+                m_current_protocol_id = m_listener->requestStart(new ShowPublicAddress());
+                // The server address only depends on our public ip, get it
+                // while our address is being published
+                if (!m_quick_join)
+                {
+                    m_server_protocol_id = m_listener->requestStart(new GetPeerAddress(m_host_id, &m_server_address));
+                    m_server_request_started = true;
+                }
+                setState(SHOWING_SELF_ADDRESS);
             }
+            else if (hasTimedOut(STUN_TIMEOUT))
+                abort("getting the public address");
             break;
         case SHOWING_SELF_ADDRESS:
-            if (m_listener->getProtocolState(m_current_protocol_id)
-            == PROTOCOL_STATE_TERMINATED) // now our public address is in the database
+            // The server must see our address before we ask to connect
+            if (isTerminated(m_current_protocol_id) &&
+                isTerminated(m_server_protocol_id))
             {
-                Log::info("ConnectToServer", "Public address shown");
+                Log::info("ConnectToServer", "Public address shown, server's address known");
                 if (m_quick_join)
                 {
-                    m_current_protocol_id = m_listener->requestStart(new QuickJoinProtocol(&m_server_address, &m_server_id));
-                    m_state = REQUESTING_CONNECTION;
+                    // Quick join already made the connection request
+                    m_current_protocol_id = m_server_protocol_id;
                 }
                 else
                 {
-                    m_current_protocol_id = m_listener->requestStart(new GetPeerAddress(m_host_id, &m_server_address));
-                    m_state = GETTING_SERVER_ADDRESS;
+                    if (m_server_address.ip == m_public_address.ip) // we're in the same lan (same public ip address) !!
+                        Log::info("ConnectToServer", "Server appears to be in the same LAN.");
+                    m_current_protocol_id = m_listener->requestStart(new RequestConnection(m_server_id));
                 }
+                m_server_request_started = false;
+                setState(REQUESTING_CONNECTION);
             }
-            break;
-        case GETTING_SERVER_ADDRESS:
-            if (m_listener->getProtocolState(m_current_protocol_id)
-            == PROTOCOL_STATE_TERMINATED) // we know the server address
-            {
-                Log::info("ConnectToServer", "Server's address known");
-                if (m_server_address.ip == m_public_address.ip) // we're in the same lan (same public ip address) !!
-                    Log::info("ConnectToServer", "Server appears to be in the same LAN.");
-                m_state = REQUESTING_CONNECTION;
-                m_current_protocol_id = m_listener->requestStart(new RequestConnection(m_server_id));
-            }
+            else if (hasTimedOut(REQUEST_TIMEOUT))
+                abort("publishing the address and getting the server's address");
             break;
         case REQUESTING_CONNECTION:
             if (m_listener->getProtocolState(m_current_protocol_id)
@@ -229,15 +285,17 @@ void ConnectToServer::asynchronousUpdate()
 
 #endif
                         m_server_address = sender;
-                        m_state = CONNECTING;
+                        setState(CONNECTING);
                     }
                 }
                 else
                 {
-                    m_state = CONNECTING;
+                    setState(CONNECTING);
                     m_current_protocol_id = m_listener->requestStart(new PingProtocol(m_server_address, 2.0));
                 }
             }
+            else if (hasTimedOut(REQUEST_TIMEOUT))
+                abort("requesting the connection");
             break;
         case CONNECTING: // waiting the server to answer our connection
             {
@@ -248,6 +306,8 @@ void ConnectToServer::asynchronousUpdate()
                     NetworkManager::getInstance()->connect(m_server_address);
                     Log::info("ConnectToServer", "Trying to connect to %u:%u", m_server_address.ip, m_server_address.port);
                 }
+                if (hasTimedOut(CONNECT_TIMEOUT))
+                    abort("connecting to the server");
                 break;
             }
         case CONNECTED:
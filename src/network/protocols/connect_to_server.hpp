@@ -23,6 +23,11 @@
 #include "network/types.hpp"
 #include <string>
 
+/** Joins a server. The independent steps are run at the same time: the
+ *  server is looked up while STUN finds our public address, and our address
+ *  is published while the server address is being resolved. Each step has
+ *  its own timeout, after which joining is given up.
+ */
 class ConnectToServer : public Protocol, public CallbackObject
 {
     public:
@@ -41,14 +46,18 @@ class ConnectToServer : public Protocol, public CallbackObject
         uint32_t m_server_id;
         uint32_t m_host_id;
         uint32_t m_current_protocol_id;
+        /** The protocol looking up the server, run next to the others. */
+        uint32_t m_server_protocol_id;
+        bool m_server_request_started;
         bool m_quick_join;
+        /** Time the current step was started at, for its timeout. */
+        double m_step_start_time;
 
         enum STATE
         {
             NONE,
             GETTING_SELF_ADDRESS,
             SHOWING_SELF_ADDRESS,
-            GETTING_SERVER_ADDRESS,
             REQUESTING_CONNECTION,
             CONNECTING,
             CONNECTED,
@@ -57,6 +66,11 @@ class ConnectToServer : public Protocol, public CallbackObject
             EXITING
         };
         STATE m_state;
+
+        void setState(STATE state);
+        bool isTerminated(uint32_t protocol_id);
+        bool hasTimedOut(double timeout) const;
+        void abort(const char* step);
 };
 
 #endif // CONNECT_TO_SERVER_HPP
@@ -11,12 +11,16 @@
 ControllerEventsProtocol::ControllerEventsProtocol() :
         Protocol(NULL, PROTOCOL_CONTROLLER_EVENTS)
 {
+    pthread_mutex_init(&m_pending_actions_mutex, NULL);
+    setAsynchronousUpdateInterval(-1);   // only reacts to events
+    m_outgoing_tick = 0;
 }
 
 //-----------------------------------------------------------------------------
 
 ControllerEventsProtocol::~ControllerEventsProtocol()
 {
+    pthread_mutex_destroy(&m_pending_actions_mutex);
 }
 
 //-----------------------------------------------------------------------------
@@ -25,7 +29,7 @@ void ControllerEventsProtocol::setup()
 {
     m_self_controller_index = 0;
     std::vector<AbstractKart*> karts = World::getWorld()->getKarts();
-    std::vector<STKPeer*> peers = NetworkManager::getInstance()->getPeers();
+    const std::vector<STKPeer*> &peers = NetworkManager::getInstance()->getPeers();
     for (unsigned int i = 0; i < karts.size(); i++)
     {
         if (karts[i]->getIdent() == NetworkWorld::getInstance()->m_self_kart)
@@ -79,28 +83,25 @@ bool ControllerEventsProtocol::notifyEventAsynchronous(Event* event)
     }
     NetworkString ns = pure_message;
 
+    uint32_t tick = ns.gui32();
     ns.removeFront(4);
     uint8_t client_index = -1;
+    pthread_mutex_lock(&m_pending_actions_mutex);
     while (ns.size() >= 9)
     {
-        uint8_t controller_index = ns.gui8();
-        client_index = controller_index;
-        uint8_t serialized_1 = ns.gui8(1);
-        PlayerAction action  = (PlayerAction)(ns.gui8(4));
-        int action_value = ns.gui32(5);
-
-        KartControl* controls   = m_controllers[controller_index].first->getControls();
-        controls->m_brake       = (serialized_1 & 0x40)!=0;
-        controls->m_nitro       = (serialized_1 & 0x20)!=0;
-        controls->m_rescue      = (serialized_1 & 0x10)!=0;
-        controls->m_fire        = (serialized_1 & 0x08)!=0;
-        controls->m_look_back   = (serialized_1 & 0x04)!=0;
-        controls->m_skid        = KartControl::SkidControl(serialized_1 & 0x03);
-
-        m_controllers[controller_index].first->action(action, action_value);
+        TickedAction ta;
+        ta.m_tick             = tick;
+        ta.m_controller_index = ns.gui8();
+        ta.m_serialized_1     = ns.gui8(1);
+        ta.m_action           = (PlayerAction)(ns.gui8(4));
+        ta.m_value            = ns.gui32(5);
+        client_index = ta.m_controller_index;
+        if (ta.m_controller_index < m_controllers.size())
+            m_pending_actions.push_back(ta);
         ns.removeFront(9);
         //Log::info("ControllerEventProtocol", "Registered one action.");
     }
+    pthread_mutex_unlock(&m_pending_actions_mutex);
     if (ns.size() > 0 && ns.size() != 9)
     {
         Log::warn("ControllerEventProtocol", "The data seems corrupted. Remains %d", ns.size());
@@ -121,7 +122,7 @@ bool ControllerEventsProtocol::notifyEventAsynchronous(Event* event)
             NetworkString ns2;
             ns2.ai32(m_controllers[i].second->getClientServerToken());
             ns2 += pure_message;
-            m_listener->sendMessage(this, m_controllers[i].second, ns2, false);
+            m_listener->sendMessage(this, m_controllers[i].second, ns2, true);
             //Log::info("ControllerEventsProtocol", "Sizes are %d and %d", ns2.size(), pure_message.size());
         }
     }
@@ -130,17 +131,68 @@ bool ControllerEventsProtocol::notifyEventAsynchronous(Event* event)
 
 //-----------------------------------------------------------------------------
 
+/** Sends the actions of the local player collected during this frame. */
 void ControllerEventsProtocol::update()
 {
-}
+    if (!m_outgoing_actions.empty())
+        flushActions();
+}   // update
+
+//-----------------------------------------------------------------------------
+/** Applies all received actions that belong to the specified tick or to an
+ *  earlier one. Called by the NetworkWorld at the beginning of each tick.
+ *  \param tick The tick that is going to be simulated.
+ */
+void ControllerEventsProtocol::applyActions(uint32_t tick)
+{
+    pthread_mutex_lock(&m_pending_actions_mutex);
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < m_pending_actions.size(); i++)
+    {
+        const TickedAction &ta = m_pending_actions[i];
+        if (ta.m_tick > tick)
+        {
+            m_pending_actions[kept++] = ta;
+            continue;
+        }
+        Controller *controller  = m_controllers[ta.m_controller_index].first;
+        KartControl* controls   = controller->getControls();
+        controls->m_brake       = (ta.m_serialized_1 & 0x40)!=0;
+        controls->m_nitro       = (ta.m_serialized_1 & 0x20)!=0;
+        controls->m_rescue      = (ta.m_serialized_1 & 0x10)!=0;
+        controls->m_fire        = (ta.m_serialized_1 & 0x08)!=0;
+        controls->m_look_back   = (ta.m_serialized_1 & 0x04)!=0;
+        controls->m_skid        = KartControl::SkidControl(ta.m_serialized_1 & 0x03);
+        controller->action(ta.m_action, ta.m_value);
+        if (m_listener->isServer())
+        {
+            NetworkWorld::getInstance()->getRecorder()->recordAction(tick,
+                ta.m_controller_index, ta.m_serialized_1,
+                (uint8_t)ta.m_action, ta.m_value);
+        }
+    }
+    m_pending_actions.resize(kept);
+    pthread_mutex_unlock(&m_pending_actions_mutex);
+}   // applyActions
 
 //-----------------------------------------------------------------------------
 
+/** Queues an action of the local player to be sent to the server. The
+ *  actions of one tick are sent in one message, either at the end of the
+ *  frame or when an action of a later tick is queued. Repeated analog
+ *  values of an action only send the latest one, but pressing or releasing
+ *  (a value of 0) is always kept.
+ */
 void ControllerEventsProtocol::controllerAction(Controller* controller,
         PlayerAction action, int value)
 {
     assert(!m_listener->isServer());
 
+    const uint32_t tick = NetworkWorld::getInstance()->getCurrentTick();
+    if (!m_outgoing_actions.empty() && tick != m_outgoing_tick)
+        flushActions();
+    m_outgoing_tick = tick;
+
     KartControl* controls = controller->getControls();
     uint8_t serialized_1 = 0;
     serialized_1 |= (controls->m_brake==true);
@@ -154,18 +206,49 @@ void ControllerEventsProtocol::controllerAction(Controller* controller,
     serialized_1 |= (controls->m_look_back==true);
     serialized_1 <<= 2;
     serialized_1 += controls->m_skid;
-    uint8_t serialized_2 = (uint8_t)(controls->m_accel*255.0);
-    uint8_t serialized_3 = (uint8_t)(controls->m_steer*127.0);
+    m_outgoing_controls[0] = serialized_1;
+    m_outgoing_controls[1] = (uint8_t)(controls->m_accel*255.0);
+    m_outgoing_controls[2] = (uint8_t)(controls->m_steer*127.0);
+
+    for (unsigned int i = 0; i < m_outgoing_actions.size(); i++)
+    {
+        OutgoingAction &oa = m_outgoing_actions[i];
+        if (oa.m_action == action && oa.m_value != 0 && value != 0)
+        {
+            oa.m_value = value;
+            return;
+        }
+    }
+    OutgoingAction oa;
+    oa.m_action = action;
+    oa.m_value  = value;
+    m_outgoing_actions.push_back(oa);
+}   // controllerAction
 
+//-----------------------------------------------------------------------------
+/** Sends all queued actions of the local player in one message. They all get
+ *  the latest state of the kart controls, which the receiver sets before
+ *  applying each action.
+ */
+void ControllerEventsProtocol::flushActions()
+{
     NetworkString ns;
     ns.ai32(m_controllers[m_self_controller_index].second->getClientServerToken());
-    ns.af(World::getWorld()->getTime());
-    ns.ai8(m_self_controller_index);
-    ns.ai8(serialized_1).ai8(serialized_2).ai8(serialized_3);
-    ns.ai8((uint8_t)(action)).ai32(value);
+    ns.ai32(m_outgoing_tick);
+    for (unsigned int i = 0; i < m_outgoing_actions.size(); i++)
+    {
+        const OutgoingAction &oa = m_outgoing_actions[i];
+        ns.ai8(m_self_controller_index);
+        ns.ai8(m_outgoing_controls[0]).ai8(m_outgoing_controls[1])
+          .ai8(m_outgoing_controls[2]);
+        ns.ai8((uint8_t)(oa.m_action)).ai32(oa.m_value);
+    }
+    Log::debug("ControllerEventsProtocol", "Sending %d actions of tick %d",
+               (int)m_outgoing_actions.size(), m_outgoing_tick);
+    m_outgoing_actions.clear();
 
-    Log::info("ControllerEventsProtocol", "Action %d value %d", action, value);
-    m_listener->sendMessage(this, ns, false); // send message to server
-}
+    // Inputs must not be lost, the server simulates the kart with them
+    m_listener->sendMessage(this, ns, true); // send message to server
+}   // flushActions
 
 
@@ -6,12 +6,49 @@
 #include "input/input.hpp"
 #include "karts/controller/controller.hpp"
 
+/** \class ControllerEventsProtocol
+ *  \brief Transfers the actions of the players. Each action is stamped with
+ *  the NetworkWorld tick at which it happened. Received actions are not
+ *  applied immediately, but queued and applied at the beginning of the
+ *  tick they belong to (or as soon as possible if they arrive late), so
+ *  that the server simulates all karts with the same tick based inputs.
+ */
 class ControllerEventsProtocol : public Protocol
 {
     protected:
+        /** An action received from the network, waiting to be applied. */
+        struct TickedAction
+        {
+            uint32_t     m_tick;
+            uint8_t      m_controller_index;
+            uint8_t      m_serialized_1;
+            PlayerAction m_action;
+            int          m_value;
+        };   // TickedAction
+
         std::vector<std::pair<Controller*, STKPeer*> > m_controllers;
         uint32_t m_self_controller_index;
 
+        /** Received actions that are not yet applied, in order of arrival. */
+        std::vector<TickedAction> m_pending_actions;
+        pthread_mutex_t           m_pending_actions_mutex;
+
+        /** An action of the local player that is not yet sent. */
+        struct OutgoingAction
+        {
+            PlayerAction m_action;
+            int          m_value;
+        };   // OutgoingAction
+
+        /** Actions of the local player, all from tick m_outgoing_tick, which
+         *  are sent together in one message. */
+        std::vector<OutgoingAction> m_outgoing_actions;
+        uint32_t                    m_outgoing_tick;
+        /** Serialized kart controls after the latest outgoing action. */
+        uint8_t                     m_outgoing_controls[3];
+
+        void flushActions();
+
     public:
         ControllerEventsProtocol();
         virtual ~ControllerEventsProtocol();
@@ -22,6 +59,7 @@ class ControllerEventsProtocol : public Protocol
         virtual void asynchronousUpdate() {}
 
         void controllerAction(Controller* controller, PlayerAction action, int value);
+        void applyActions(uint32_t tick);
 
 };
 
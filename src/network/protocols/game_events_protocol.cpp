@@ -11,6 +11,7 @@
 
 GameEventsProtocol::GameEventsProtocol() : Protocol(NULL, PROTOCOL_GAME_EVENTS)
 {
+    setAsynchronousUpdateInterval(-1);   // only reacts to events
 }
 
 GameEventsProtocol::~GameEventsProtocol()
@@ -76,7 +77,7 @@ void GameEventsProtocol::collectedItem(Item* item, AbstractKart* kart)
     assert(setup);
     const NetworkPlayerProfile* player_profile = setup->getProfile(kart->getIdent()); // use kart name
 
-    std::vector<STKPeer*> peers = NetworkManager::getInstance()->getPeers();
+    const std::vector<STKPeer*> &peers = NetworkManager::getInstance()->getPeers();
     for (unsigned int i = 0; i < peers.size(); i++)
     {
         NetworkString ns;
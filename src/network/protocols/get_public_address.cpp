@@ -26,6 +26,7 @@
 
 #include "utils/log.hpp"
 #include "utils/random_generator.hpp"
+#include "utils/time.hpp"
 
 #include <assert.h>
 
@@ -44,6 +45,14 @@
 #include <sys/types.h>
 
 
+/** How long (in seconds) a public address found with STUN is reused. */
+static const double CACHE_DURATION = 600.0;
+
+/** The last public address found, so that joining again soon after doesn't
+ *  need another STUN round trip. */
+static TransportAddress g_cached_address;
+static double           g_cached_time = -1.0;
+
 int stunRand()
 {
     static bool init = false;
@@ -66,6 +75,21 @@ GetPublicAddress::~GetPublicAddress()
 void GetPublicAddress::setup()
 {
     m_state = NOTHING_DONE;
+    if (g_cached_time >= 0.0 && g_cached_address.ip != 0 &&
+        StkTime::getRealTime() - g_cached_time < CACHE_DURATION)
+    {
+        Log::verbose("GetPublicAddress", "Using the cached public address.");
+        TransportAddress* addr = static_cast<TransportAddress*>(m_callback_object);
+        *addr = g_cached_address;
+        m_state = ADDRESS_KNOWN;
+    }
+}
+
+/** Forgets the cached public address, e.g. when connecting with it failed,
+ *  so that the next request asks a STUN server again. */
+void GetPublicAddress::clearCache()
+{
+    g_cached_time = -1.0;
 }
 
 void GetPublicAddress::asynchronousUpdate()
@@ -233,6 +257,8 @@ void GetPublicAddress::asynchronousUpdate()
                     TransportAddress* addr = static_cast<TransportAddress*>(m_callback_object);
                     addr->ip = address;
                     addr->port = port;
+                    g_cached_address = *addr;
+                    g_cached_time    = StkTime::getRealTime();
                 }
                 else
                     m_state = NOTHING_DONE; // need to re-send the stun request
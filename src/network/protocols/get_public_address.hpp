@@ -33,6 +33,8 @@ class GetPublicAddress : public Protocol
         virtual void update() {}
         virtual void asynchronousUpdate();
 
+        static void clearCache();
+
     protected:
         enum STATE
         {
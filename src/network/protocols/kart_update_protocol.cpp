@@ -1,11 +1,25 @@
 #include "network/protocols/kart_update_protocol.hpp"
 
+#include "config/user_config.hpp"
 #include "karts/abstract_kart.hpp"
-#include "modes/world.hpp"
+#include "modes/linear_world.hpp"
+#include "network/game_setup.hpp"
+#include "network/network_manager.hpp"
 #include "network/protocol_manager.hpp"
 #include "network/network_world.hpp"
+#include "tracks/track.hpp"
+#include "utils/log.hpp"
 #include "utils/time.hpp"
 
+#include <math.h>
+
+/** Additional space around the track's bounding box that can still be
+ *  represented by the quantized positions (e.g. karts jumping high). */
+static const float QUANTIZE_MARGIN = 20.0f;
+
+const float KartUpdateProtocol::RELEVANCE_NEAR_DISTANCE =  30.0f;
+const float KartUpdateProtocol::RELEVANCE_FAR_DISTANCE  = 100.0f;
+
 KartUpdateProtocol::KartUpdateProtocol()
     : Protocol(NULL, PROTOCOL_KART_UPDATE)
 {
@@ -22,44 +36,352 @@ KartUpdateProtocol::KartUpdateProtocol()
             m_self_kart_index = i;
         }
     }
+
+    const Vec3 *min, *max;
+    World::getWorld()->getTrack()->getAABB(&min, &max);
+    m_quantize_min = *min - Vec3(QUANTIZE_MARGIN);
+    Vec3 extent = *max - *min + Vec3(2.0f*QUANTIZE_MARGIN);
+    for (unsigned int i = 0; i < 3; i++)
+        m_quantize_step[i] = extent[i] / 65535.0f;
+
+    for (unsigned int i = 0; i < SNAPSHOT_HISTORY; i++)
+        m_snapshots[i].m_sequence = 0;
+    m_last_sequence = 0;
+    m_last_sent_ack = 0;
+    m_last_ack_time = 0;
+    m_state_buffers.resize(m_karts.size());
+    m_server_time_offset       = 0.0f;
+    m_server_time_offset_valid = false;
+    for (unsigned int i = 0; i < PREDICTION_HISTORY; i++)
+        m_predictions[i].m_tick = 0;
+    m_has_correction = false;
     pthread_mutex_init(&m_positions_updates_mutex, NULL);
+    setAsynchronousUpdateInterval(-1);   // only reacts to events
 }
 
 KartUpdateProtocol::~KartUpdateProtocol()
 {
 }
 
+//-----------------------------------------------------------------------------
+/** Converts one coordinate into a 16 bit fixed point value relative to the
+ *  (extended) bounding box of the track. Values outside are clamped.
+ *  \param f The coordinate to quantize.
+ *  \param axis Index of the axis (0 to 2).
+ */
+uint16_t KartUpdateProtocol::quantizeCoordinate(float f, int axis) const
+{
+    float q = (f - m_quantize_min[axis]) / m_quantize_step[axis];
+    if (q < 0.0f)     return 0;
+    if (q > 65535.0f) return 65535;
+    return (uint16_t)(q + 0.5f);
+}   // quantizeCoordinate
+
+//-----------------------------------------------------------------------------
+float KartUpdateProtocol::dequantizeCoordinate(uint16_t q, int axis) const
+{
+    return m_quantize_min[axis] + q * m_quantize_step[axis];
+}   // dequantizeCoordinate
+
+//-----------------------------------------------------------------------------
+/** Compresses a quaternion into 32 bits using the 'smallest three'
+ *  encoding: the index of the largest component is stored in 2 bits, the
+ *  other three components (which are in [-1/sqrt(2), 1/sqrt(2)]) use 10
+ *  bits each. The largest component is reconstructed from the unit length.
+ */
+uint32_t KartUpdateProtocol::compressQuaternion(const btQuaternion &q)
+{
+    btQuaternion n = q.normalized();
+    float c[4] = { n.x(), n.y(), n.z(), n.w() };
+    int largest = 0;
+    for (int i = 1; i < 4; i++)
+    {
+        if (fabsf(c[i]) > fabsf(c[largest]))
+            largest = i;
+    }
+    // q and -q are the same rotation, so make the largest one positive
+    float sign = c[largest] < 0 ? -1.0f : 1.0f;
+    uint32_t result = largest;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i == largest) continue;
+        float v = (sign*c[i]*(float)M_SQRT2 + 1.0f) * 0.5f * 1023.0f;
+        if (v < 0.0f)    v = 0.0f;
+        if (v > 1023.0f) v = 1023.0f;
+        result = (result << 10) | (uint32_t)(v + 0.5f);
+    }
+    return result;
+}   // compressQuaternion
+
+//-----------------------------------------------------------------------------
+btQuaternion KartUpdateProtocol::decompressQuaternion(uint32_t data)
+{
+    int largest = data >> 30;
+    float c[4];
+    float sum = 0.0f;
+    for (int i = 3; i >= 0; i--)
+    {
+        if (i == largest) continue;
+        c[i] = ((data & 1023) / 1023.0f * 2.0f - 1.0f) / (float)M_SQRT2;
+        sum += c[i]*c[i];
+        data >>= 10;
+    }
+    c[largest] = sum < 1.0f ? sqrtf(1.0f - sum) : 0.0f;
+    return btQuaternion(c[0], c[1], c[2], c[3]);
+}   // decompressQuaternion
+
+//-----------------------------------------------------------------------------
+KartUpdateProtocol::KartState
+                        KartUpdateProtocol::quantize(const AbstractKart *kart) const
+{
+    KartState state;
+    const Vec3 &xyz = kart->getXYZ();
+    for (int i = 0; i < 3; i++)
+        state.m_xyz[i] = quantizeCoordinate(xyz[i], i);
+    state.m_rotation = compressQuaternion(kart->getRotation());
+    return state;
+}   // quantize
+
+//-----------------------------------------------------------------------------
+/** Adds the state of one kart to a network string. If a baseline is
+ *  specified, only the components that differ from the baseline are sent.
+ *  If the state is identical to the baseline, only the kart id and an empty
+ *  flag byte are added: the receiver must be able to distinguish this from
+ *  a kart that was not updated in this snapshot at all.
+ */
+void KartUpdateProtocol::addKartState(NetworkString *ns, uint8_t kart_id,
+                                      const KartState &state,
+                                      const KartState *baseline) const
+{
+    uint8_t flags = KART_STATE_ALL;
+    if (baseline)
+    {
+        flags = 0;
+        if (state.m_xyz[0]   != baseline->m_xyz[0]  ) flags |= KART_STATE_X;
+        if (state.m_xyz[1]   != baseline->m_xyz[1]  ) flags |= KART_STATE_Y;
+        if (state.m_xyz[2]   != baseline->m_xyz[2]  ) flags |= KART_STATE_Z;
+        if (state.m_rotation != baseline->m_rotation) flags |= KART_STATE_ROTATION;
+    }
+    ns->ai8(kart_id).ai8(flags);
+    if (flags & KART_STATE_X)        ns->ai16(state.m_xyz[0]);
+    if (flags & KART_STATE_Y)        ns->ai16(state.m_xyz[1]);
+    if (flags & KART_STATE_Z)        ns->ai16(state.m_xyz[2]);
+    if (flags & KART_STATE_ROTATION) ns->ai32(state.m_rotation);
+}   // addKartState
+
+//-----------------------------------------------------------------------------
+/** Reads the state of one kart added with addKartState. Components that are
+ *  not contained in the message are left unchanged in state, so the caller
+ *  must initialise it with the baseline.
+ *  \return False if the message is too short.
+ */
+bool KartUpdateProtocol::readKartState(const NetworkString &ns, int *offset,
+                                       uint8_t *kart_id,
+                                       KartState *state) const
+{
+    if (ns.size() < *offset + 2)
+        return false;
+    *kart_id      = ns.getUInt8(*offset);
+    uint8_t flags = ns.getUInt8(*offset+1);
+    int size = 2;
+    for (int i = 0; i < 3; i++)
+        if (flags & (KART_STATE_X << i)) size += 2;
+    if (flags & KART_STATE_ROTATION) size += 4;
+    if (ns.size() < *offset + size)
+        return false;
+
+    int pos = *offset + 2;
+    for (int i = 0; i < 3; i++)
+    {
+        if (flags & (KART_STATE_X << i))
+        {
+            state->m_xyz[i] = ns.getUInt16(pos);
+            pos += 2;
+        }
+    }
+    if (flags & KART_STATE_ROTATION)
+        state->m_rotation = ns.getUInt32(pos);
+    *offset += size;
+    return true;
+}   // readKartState
+
+//-----------------------------------------------------------------------------
+/** Client only: stores a kart state received from the server. States of
+ *  remote karts are added to the kart's state buffer, the state of the local
+ *  kart is kept to correct the prediction at the end of the next tick.
+ *  The caller must hold m_positions_updates_mutex.
+ *  \param kart_id World id of the kart.
+ *  \param state The received state.
+ *  \param server_time The time at which the server sent that state.
+ *  \param tick The tick at which the server sent that state.
+ */
+void KartUpdateProtocol::queueKartState(uint8_t kart_id, const KartState &state,
+                                        float server_time, uint32_t tick)
+{
+    if (kart_id >= m_karts.size())
+    {
+        Log::warn("KartUpdateProtocol", "Invalid kart id %d.", kart_id);
+        return;
+    }
+    Vec3 xyz(dequantizeCoordinate(state.m_xyz[0], 0),
+             dequantizeCoordinate(state.m_xyz[1], 1),
+             dequantizeCoordinate(state.m_xyz[2], 2));
+    btQuaternion rotation = decompressQuaternion(state.m_rotation);
+    if (kart_id == m_self_kart_index)
+    {
+        m_has_correction      = true;
+        m_correction_tick     = tick;
+        m_correction_xyz      = xyz;
+        m_correction_rotation = rotation;
+        return;
+    }
+    m_state_buffers[kart_id].addState(server_time, xyz, rotation);
+}   // queueKartState
+
+//-----------------------------------------------------------------------------
+/** Client only: sets all remote karts to their state at the current server
+ *  time minus the interpolation delay. Setting the velocity as well keeps
+ *  the physics between two frames consistent with the interpolation.
+ *  The caller must hold m_positions_updates_mutex.
+ */
+void KartUpdateProtocol::updateRemoteKarts()
+{
+    if (!m_server_time_offset_valid)
+        return;
+    float time = World::getWorld()->getTime() + m_server_time_offset
+               - UserConfigParams::m_network_interpolation_delay;
+    for (unsigned int i = 0; i < m_karts.size(); i++)
+    {
+        if (i == m_self_kart_index)
+            continue;
+        Vec3 xyz, velocity;
+        btQuaternion rotation;
+        if (!m_state_buffers[i].getState(time, &xyz, &rotation, &velocity))
+            continue;
+        btTransform transform = m_karts[i]->getBody()->getInterpolationWorldTransform();
+        transform.setOrigin(xyz);
+        transform.setRotation(rotation);
+        m_karts[i]->getBody()->setCenterOfMassTransform(transform);
+        m_karts[i]->getBody()->setLinearVelocity(velocity);
+    }
+}   // updateRemoteKarts
+
+//-----------------------------------------------------------------------------
+/** Returns the snapshot with the given sequence number from a history,
+ *  or NULL if it is not (or not anymore) available.
+ *  \param history Ring buffer of SNAPSHOT_HISTORY snapshots.
+ *  \param sequence The sequence number to look for.
+ */
+const KartUpdateProtocol::Snapshot*
+                    KartUpdateProtocol::findSnapshot(const Snapshot *history,
+                                                     uint16_t sequence)
+{
+    if (sequence == 0)
+        return NULL;
+    const Snapshot &s = history[sequence % SNAPSHOT_HISTORY];
+    return s.m_sequence == sequence ? &s : NULL;
+}   // findSnapshot
+
+//-----------------------------------------------------------------------------
+/** Server messages: time (float), tick (uint32), sequence (uint16),
+ *  baseline sequence (uint16, equal to sequence for full snapshots), number
+ *  of kart entries (uint8), kart entries. Client messages: time (float),
+ *  acknowledged sequence (uint16, 0 if none).
+ */
 bool KartUpdateProtocol::notifyEventAsynchronous(Event* event)
 {
     if (event->type != EVENT_TYPE_MESSAGE)
         return true;
     NetworkString ns = event->data();
-    if (ns.size() < 36)
+    if (m_listener->isServer())
+    {
+        if (ns.size() < 6)
+        {
+            Log::info("KartUpdateProtocol", "Message too short.");
+            return true;
+        }
+        uint16_t ack = ns.getUInt16(4);
+        pthread_mutex_lock(&m_positions_updates_mutex);
+        if (ack != 0)
+            m_peer_snapshots[*event->peer].m_ack = ack;
+        pthread_mutex_unlock(&m_positions_updates_mutex);
+        return true;
+    }
+
+    if (ns.size() < 13)
     {
         Log::info("KartUpdateProtocol", "Message too short.");
         return true;
     }
-    ns.removeFront(4);
-    while(ns.size() >= 16)
-    {
-        uint32_t kart_id = ns.getUInt32(0);
-
-        float a,b,c;
-        a = ns.getFloat(4);
-        b = ns.getFloat(8);
-        c = ns.getFloat(12);
-        float d,e,f,g;
-        d = ns.getFloat(16);
-        e = ns.getFloat(20);
-        f = ns.getFloat(24);
-        g = ns.getFloat(28);
-        pthread_mutex_trylock(&m_positions_updates_mutex);
-        m_next_positions.push_back(Vec3(a,b,c));
-        m_next_quaternions.push_back(btQuaternion(d,e,f,g));
-        m_karts_ids.push_back(kart_id);
-        pthread_mutex_unlock(&m_positions_updates_mutex);
-        ns.removeFront(32);
+    uint32_t tick     = ns.getUInt32(4);
+    uint16_t sequence = ns.getUInt16(8);
+    uint16_t baseline = ns.getUInt16(10);
+    uint8_t  count    = ns.getUInt8(12);
+    // Ignore snapshots that arrive out of order
+    if (m_last_sequence != 0 && (int16_t)(sequence - m_last_sequence) <= 0)
+        return true;
+
+    Snapshot snapshot;
+    snapshot.m_sequence = sequence;
+    if (baseline != sequence)
+    {
+        const Snapshot *base = findSnapshot(m_snapshots, baseline);
+        if (!base)
+        {
+            Log::verbose("KartUpdateProtocol",
+                         "Missing baseline %d for snapshot %d.",
+                         baseline, sequence);
+            return true;
+        }
+        snapshot.m_karts = base->m_karts;
+    }
+    snapshot.m_karts.resize(m_karts.size());
+    // Karts that are not contained in the message were not updated in this
+    // snapshot (since they are not relevant for this client).
+    std::vector<bool> updated(m_karts.size(), false);
+
+    int offset = 13;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (ns.size() <= offset)
+        {
+            Log::info("KartUpdateProtocol", "Message too short.");
+            return true;
+        }
+        // Start with the baseline state, a delta only contains changes
+        uint8_t kart_id = ns.getUInt8(offset);
+        KartState state = kart_id < snapshot.m_karts.size()
+                        ? snapshot.m_karts[kart_id] : KartState();
+        if (!readKartState(ns, &offset, &kart_id, &state))
+        {
+            Log::info("KartUpdateProtocol", "Message too short.");
+            return true;
+        }
+        if (kart_id < snapshot.m_karts.size())
+        {
+            snapshot.m_karts[kart_id] = state;
+            updated[kart_id] = true;
+        }
+    }
+
+    float server_time = ns.getFloat(0);
+    pthread_mutex_lock(&m_positions_updates_mutex);
+    m_snapshots[sequence % SNAPSHOT_HISTORY] = snapshot;
+    m_last_sequence = sequence;
+    // Smooth the estimated clock offset, so that a single late packet does
+    // not make the karts jump.
+    float time_offset = server_time - World::getWorld()->getTime();
+    if (m_server_time_offset_valid)
+        m_server_time_offset = 0.9f*m_server_time_offset + 0.1f*time_offset;
+    else
+        m_server_time_offset = time_offset;
+    m_server_time_offset_valid = true;
+    for (unsigned int i = 0; i < snapshot.m_karts.size(); i++)
+    {
+        if (updated[i])
+            queueKartState(i, snapshot.m_karts[i], server_time, tick);
     }
+    pthread_mutex_unlock(&m_positions_updates_mutex);
     return true;
 }
 
@@ -71,68 +393,262 @@ void KartUpdateProtocol::update()
 {
     if (!World::getWorld())
         return;
-    static double time = 0;
+    if (m_listener->isServer())
+        return;   // snapshots are sent at the end of a tick
+
+    // Acknowledge new snapshots soon (at most 30 times per second), so
+    // that the server can use them as baseline, and repeat the last
+    // acknowledgement 10 times per second in case it was lost.
     double current_time = StkTime::getRealTime();
-    if (current_time > time + 0.1) // 10 updates per second
+    pthread_mutex_lock(&m_positions_updates_mutex);
+    uint16_t ack = m_last_sequence;
+    pthread_mutex_unlock(&m_positions_updates_mutex);
+    double ack_interval = ack != m_last_sent_ack ? 1.0/30.0 : 0.1;
+    if (current_time > m_last_ack_time + ack_interval)
     {
-        time = current_time;
-        if (m_listener->isServer())
-        {
-            NetworkString ns;
-            ns.af( World::getWorld()->getTime());
-            for (unsigned int i = 0; i < m_karts.size(); i++)
-            {
-                AbstractKart* kart = m_karts[i];
-                Vec3 v = kart->getXYZ();
-                btQuaternion quat = kart->getRotation();
-                ns.ai32( kart->getWorldKartId());
-                ns.af(v[0]).af(v[1]).af(v[2]); // add position
-                ns.af(quat.x()).af(quat.y()).af(quat.z()).af(quat.w()); // add rotation
-                Log::verbose("KartUpdateProtocol", "Sending %d's positions %f %f %f", kart->getWorldKartId(), v[0], v[1], v[2]);
-            }
-            m_listener->sendMessage(this, ns, false);
-        }
-        else
-        {
-            AbstractKart* kart = m_karts[m_self_kart_index];
-            Vec3 v = kart->getXYZ();
-            btQuaternion quat = kart->getRotation();
-            NetworkString ns;
-            ns.af( World::getWorld()->getTime());
-            ns.ai32( kart->getWorldKartId());
-            ns.af(v[0]).af(v[1]).af(v[2]); // add position
-            ns.af(quat.x()).af(quat.y()).af(quat.z()).af(quat.w()); // add rotation
-            Log::verbose("KartUpdateProtocol", "Sending %d's positions %f %f %f", kart->getWorldKartId(), v[0], v[1], v[2]);
-            m_listener->sendMessage(this, ns, false);
-        }
+        m_last_ack_time = current_time;
+        m_last_sent_ack = ack;
+        NetworkString ns;
+        ns.af( World::getWorld()->getTime());
+        ns.ai16(ack);
+        m_listener->sendMessage(this, ns, false);
     }
     switch(pthread_mutex_trylock(&m_positions_updates_mutex))
     {
         case 0: /* if we got the lock */
-            while (!m_next_positions.empty())
-            {
-                uint32_t id = m_karts_ids.back();
-                if (id != m_self_kart_index || m_listener->isServer()) // server takes all updates
-                {
-                    Vec3 pos = m_next_positions.back();
-                    btTransform transform = m_karts[id]->getBody()->getInterpolationWorldTransform();
-                    transform.setOrigin(pos);
-                    transform.setRotation(m_next_quaternions.back());
-                    m_karts[id]->getBody()->setCenterOfMassTransform(transform);
-                    //m_karts[id]->getBody()->setLinearVelocity(Vec3(0,0,0));
-                    Log::verbose("KartUpdateProtocol", "Update kart %i pos to %f %f %f", id, pos[0], pos[1], pos[2]);
-                }
-                m_next_positions.pop_back();
-                m_next_quaternions.pop_back();
-                m_karts_ids.pop_back();
-            }
+            updateRemoteKarts();
             pthread_mutex_unlock(&m_positions_updates_mutex);
             break;
         default:
             break;
     }
-}
+}   // update
+
+//-----------------------------------------------------------------------------
+/** Called by the NetworkWorld after each simulated tick. The server sends
+ *  snapshots to the peers whose snapshot interval has passed, a client
+ *  records the predicted state of its kart and applies a pending
+ *  correction.
+ *  \param tick Number of the tick that has just been simulated plus one,
+ *         i.e. the state of the world is the state 'at' this tick.
+ */
+void KartUpdateProtocol::endOfTick(uint32_t tick)
+{
+    if (m_listener->isServer())
+    {
+        sendSnapshot(tick);
+        return;
+    }
+
+    AbstractKart *kart = m_karts[m_self_kart_index];
+    PredictedState &prediction = m_predictions[tick % PREDICTION_HISTORY];
+    prediction.m_tick     = tick;
+    prediction.m_xyz      = kart->getXYZ();
+    prediction.m_rotation = kart->getRotation();
+
+    pthread_mutex_lock(&m_positions_updates_mutex);
+    if (m_has_correction)
+    {
+        correctPrediction();
+        m_has_correction = false;
+    }
+    pthread_mutex_unlock(&m_positions_updates_mutex);
+}   // endOfTick
+
+//-----------------------------------------------------------------------------
+/** Client only: compares the authoritative state of the local kart with the
+ *  state predicted for the same tick. If they differ too much, the error is
+ *  added to the current state of the kart and to all predictions after that
+ *  tick. The caller must hold m_positions_updates_mutex.
+ */
+void KartUpdateProtocol::correctPrediction()
+{
+    const PredictedState &p = m_predictions[m_correction_tick % PREDICTION_HISTORY];
+    if (p.m_tick != m_correction_tick)
+        return;   // too old, or not yet simulated
+
+    // Allow for the precision lost by quantizing the state
+    Vec3 error = m_correction_xyz - p.m_xyz;
+    btQuaternion rotation_error = m_correction_rotation * p.m_rotation.inverse();
+    if (error.length2() < 0.01f && fabsf(rotation_error.getAngle()) < 0.02f)
+        return;
+
+    Log::verbose("KartUpdateProtocol", "Correcting prediction of tick %d "
+                 "by %f %f %f.", m_correction_tick, error[0], error[1],
+                 error[2]);
+    AbstractKart *kart = m_karts[m_self_kart_index];
+    btTransform transform = kart->getBody()->getCenterOfMassTransform();
+    transform.setOrigin(transform.getOrigin() + error);
+    transform.setRotation(rotation_error * transform.getRotation());
+    kart->getBody()->setCenterOfMassTransform(transform);
+
+    for (unsigned int i = 0; i < PREDICTION_HISTORY; i++)
+    {
+        PredictedState &later = m_predictions[i];
+        if (later.m_tick > m_correction_tick)
+        {
+            later.m_xyz      += error;
+            later.m_rotation  = rotation_error * later.m_rotation;
+        }
+    }
+}   // correctPrediction
+
+//-----------------------------------------------------------------------------
+/** Server only: computes how relevant a kart is for the player driving
+ *  the observer kart, expressed as the number of snapshots between two
+ *  updates of that kart. On tracks the distance along the quad graph is
+ *  used (so that karts on a different part of the track behind a wall are
+ *  considered far away), karts behind the observer (i.e. outside of the
+ *  view of its camera) count as twice as far away.
+ *  \param observer The kart of the receiving player, can be NULL.
+ *  \param kart The kart whose state is sent.
+ *  \return 1 if the kart is to be sent in each snapshot, 2 for every
+ *          second snapshot, etc.
+ */
+unsigned int KartUpdateProtocol::getUpdateInterval(const AbstractKart *observer,
+                                                   const AbstractKart *kart) const
+{
+    if (!observer || observer == kart)
+        return 1;
+
+    Vec3 delta = kart->getXYZ() - observer->getXYZ();
+    float distance = delta.length();
+    if (distance < RELEVANCE_NEAR_DISTANCE)
+        return 1;
+
+    LinearWorld *lw = dynamic_cast<LinearWorld*>(World::getWorld());
+    if (lw)
+    {
+        float length = World::getWorld()->getTrack()->getTrackLength();
+        float d = fabsf(lw->getDistanceDownTrackForKart(kart->getWorldKartId())
+                  - lw->getDistanceDownTrackForKart(observer->getWorldKartId()));
+        if (d > 0.5f*length)
+            d = length - d;
+        if (d > distance)
+            distance = d;
+    }
+
+    Vec3 forward = observer->getTrans().getBasis().getColumn(2);
+    if (forward.dot(delta) < 0)
+        distance *= 2.0f;
+
+    if (distance < RELEVANCE_NEAR_DISTANCE) return 1;
+    if (distance < RELEVANCE_FAR_DISTANCE ) return 2;
+    return 4;
+}   // getUpdateInterval
+
+//-----------------------------------------------------------------------------
+/** Server only: takes a snapshot of all karts and sends it to each peer,
+ *  delta encoded against the last snapshot this peer acknowledged. Karts
+ *  that are not relevant for a peer are only sent in some snapshots (see
+ *  getUpdateInterval), full snapshots always contain all karts.
+ *  \param tick The tick at which the snapshot is taken.
+ */
+void KartUpdateProtocol::sendSnapshot(uint32_t tick)
+{
+    const std::vector<STKPeer*> &peers = NetworkManager::getInstance()->getPeers();
+    std::vector<KartState> states;
+    for (unsigned int i = 0; i < peers.size(); i++)
+    {
+        pthread_mutex_lock(&m_positions_updates_mutex);
+        PeerSnapshots &history = m_peer_snapshots[peers[i]];
+        if (tick < history.m_next_tick)
+        {
+            pthread_mutex_unlock(&m_positions_updates_mutex);
+            continue;
+        }
+        updateSnapshotInterval(peers[i], &history);
+        history.m_next_tick = tick + history.m_interval;
+        history.m_count++;
+
+        // The states are only quantized (and a sequence number used) if
+        // a snapshot is sent to at least one peer in this tick
+        if (states.empty())
+        {
+            m_last_sequence++;
+            if (m_last_sequence == 0)  // 0 is reserved for 'no snapshot'
+                m_last_sequence = 1;
+            states.resize(m_karts.size());
+            for (unsigned int j = 0; j < m_karts.size(); j++)
+                states[j] = quantize(m_karts[j]);
+        }
 
+        const AbstractKart *observer = NULL;
+        NetworkPlayerProfile *profile = peers[i]->getPlayerProfile();
+        if (profile && profile->world_kart_id < m_karts.size())
+            observer = m_karts[profile->world_kart_id];
+
+        const Snapshot *base = findSnapshot(history.m_snapshots,
+                                            history.m_ack);
+        Snapshot &sent = history.m_snapshots[m_last_sequence
+                                             % SNAPSHOT_HISTORY];
+        if (base == &sent)
+            base = NULL;
+
+        NetworkString entries;
+        unsigned int count = 0;
+        // Karts that are not sent keep the state of the baseline
+        if (base)
+            sent.m_karts = base->m_karts;
+        sent.m_karts.resize(m_karts.size());
+        sent.m_sequence = m_last_sequence;
+        for (unsigned int j = 0; j < states.size(); j++)
+        {
+            if (base &&
+                history.m_count % getUpdateInterval(observer, m_karts[j]) != 0)
+                continue;
+            addKartState(&entries, m_karts[j]->getWorldKartId(), states[j],
+                         base ? &base->m_karts[j] : NULL);
+            sent.m_karts[j] = states[j];
+            count++;
+        }
+        pthread_mutex_unlock(&m_positions_updates_mutex);
 
+        NetworkString ns;
+        ns.af( World::getWorld()->getTime());
+        ns.ai32(tick);
+        ns.ai16(m_last_sequence);
+        ns.ai16(base ? base->m_sequence : m_last_sequence);
+        ns.ai8(count);
+        ns += entries;
+        Log::verbose("KartUpdateProtocol",
+                     "Sending snapshot %d (baseline %d) with %d karts.",
+                     m_last_sequence,
+                     base ? base->m_sequence : m_last_sequence,
+                     count);
+        m_listener->sendMessage(this, peers[i], ns, false);
+    }
+}   // sendSnapshot
 
+//-----------------------------------------------------------------------------
+/** Adapts the number of ticks between the snapshots to a peer to its
+ *  connection, at most once per second. On signs of congestion (packet
+ *  loss, ENet throttling the peer, or a high round trip time) the interval
+ *  is doubled. On a good link it is decreased by one tick, so the rate
+ *  rises slowly back to one snapshot per tick.
+ *  \param peer The peer.
+ *  \param history The snapshots of this peer, contains the interval.
+ */
+void KartUpdateProtocol::updateSnapshotInterval(const STKPeer *peer,
+                                                PeerSnapshots *history) const
+{
+    history->m_ticks_since_adapt += history->m_interval;
+    if (history->m_ticks_since_adapt * NetworkWorld::TICK_DURATION < 1.0f)
+        return;
+    history->m_ticks_since_adapt = 0;
 
+    const float    loss     = peer->getPacketLoss();
+    const float    throttle = peer->getPacketThrottle();
+    const uint32_t rtt      = peer->getRoundTripTime();
+    if (loss > 0.05f || throttle < 0.5f || rtt > 300)
+    {
+        history->m_interval *= 2;
+        if (history->m_interval > MAX_SNAPSHOT_INTERVAL_TICKS)
+            history->m_interval = MAX_SNAPSHOT_INTERVAL_TICKS;
+    }
+    else if (loss < 0.01f && throttle >= 1.0f && rtt < 150 &&
+             history->m_interval > MIN_SNAPSHOT_INTERVAL_TICKS)
+    {
+        history->m_interval--;
+    }
+}   // updateSnapshotInterval
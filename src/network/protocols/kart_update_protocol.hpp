@@ -1,13 +1,46 @@
 #ifndef KART_UPDATE_PROTOCOL_HPP
 #define KART_UPDATE_PROTOCOL_HPP
 
+#include "network/kart_state_buffer.hpp"
 #include "network/protocol.hpp"
 #include "utils/vec3.hpp"
 #include "LinearMath/btQuaternion.h"
-#include <list>
+#include <map>
 
 class AbstractKart;
+class STKPeer;
 
+/** \class KartUpdateProtocol
+ *  \brief Synchronises the position and rotation of all karts.
+ *  The server sends snapshots of all karts at a fixed rate. Positions are
+ *  quantized to 16 bit fixed point values relative to the track's bounding
+ *  box, rotations are compressed using the 'smallest three' encoding in 32
+ *  bits. Each snapshot is delta encoded against the last snapshot a peer
+ *  acknowledged: only the components that changed since then are sent.
+ *  Clients periodically acknowledge the most recent snapshot they decoded.
+ *  Not every kart is sent to every client in each snapshot: karts that are
+ *  far away from (or behind) the kart of a client are only sent in every
+ *  second or fourth snapshot. Since this means that each client knows a
+ *  different set of kart states, the server keeps the history of sent
+ *  snapshots per peer to compute the deltas.
+ *  The server is authoritative: it simulates all karts (using the tick
+ *  stamped inputs of the ControllerEventsProtocol) and ignores the kart
+ *  positions of the clients. Snapshots contain the tick they were taken
+ *  at. The number of ticks between two snapshots is adapted per peer to
+ *  its connection (see updateSnapshotInterval): peers with a fast and
+ *  reliable link get up to one snapshot per tick, congested ones as few as
+ *  MAX_SNAPSHOT_INTERVAL_TICKS allows.
+ *  Clients do not apply received states of remote karts immediately: they
+ *  are stored in a KartStateBuffer per kart, and remote karts are displayed
+ *  a configurable delay behind the (estimated) server time, interpolating
+ *  between the received states.
+ *  The local kart is predicted: the client records its state at the end of
+ *  each tick. When the authoritative state for a tick arrives, it is
+ *  compared with the prediction for the same tick, and if they differ the
+ *  error is added to the current state and to all later predictions. This
+ *  is equivalent to re-simulating the kart from the corrected state with
+ *  the same inputs, as long as the error is small.
+ */
 class KartUpdateProtocol : public Protocol
 {
     public:
@@ -19,13 +52,156 @@ class KartUpdateProtocol : public Protocol
         virtual void update();
         virtual void asynchronousUpdate() {};
 
+        void endOfTick(uint32_t tick);
+
     protected:
+        /** Number of snapshots that are kept to be used as baseline. At
+         *  the highest snapshot rate this covers about one second of round
+         *  trip, which is only used for peers with a low round trip time. */
+        static const unsigned int SNAPSHOT_HISTORY = 64;
+
+        /** Range of the number of ticks between two snapshots to a peer,
+         *  and the number a peer starts with. */
+        static const unsigned int MIN_SNAPSHOT_INTERVAL_TICKS     = 1;
+        static const unsigned int MAX_SNAPSHOT_INTERVAL_TICKS     = 12;
+        static const unsigned int DEFAULT_SNAPSHOT_INTERVAL_TICKS = 6;
+
+        /** Karts closer than this to a player's kart are sent in each
+         *  snapshot to this player. */
+        static const float RELEVANCE_NEAR_DISTANCE;
+
+        /** Karts further than this are sent in every fourth snapshot only,
+         *  karts in between in every second. */
+        static const float RELEVANCE_FAR_DISTANCE;
+
+        /** Number of predicted states of the local kart that are kept.
+         *  At 60 ticks per second this covers 2 seconds of round trip. */
+        static const unsigned int PREDICTION_HISTORY = 128;
+
+        /** Bits in the per kart flag byte, indicating which of the
+         *  components are contained in a (delta) kart entry. */
+        enum { KART_STATE_X        = 0x01,
+               KART_STATE_Y        = 0x02,
+               KART_STATE_Z        = 0x04,
+               KART_STATE_ROTATION = 0x08,
+               KART_STATE_ALL      = 0x0f };
+
+        /** The quantized state of one kart as it is sent over the network. */
+        struct KartState
+        {
+            uint16_t m_xyz[3];
+            uint32_t m_rotation;
+        };   // KartState
+
+        /** Client only: the predicted state of the local kart after a tick. */
+        struct PredictedState
+        {
+            uint32_t     m_tick;
+            Vec3         m_xyz;
+            btQuaternion m_rotation;
+        };   // PredictedState
+
+        /** The state of all karts at one point in time. */
+        struct Snapshot
+        {
+            /** Sequence number, 0 indicates an unused entry. */
+            uint16_t               m_sequence;
+            std::vector<KartState> m_karts;
+        };   // Snapshot
+
+        /** Server only: the snapshots sent to one peer, i.e. the kart
+         *  states this peer knows about, and the last acknowledged one. */
+        struct PeerSnapshots
+        {
+            uint16_t m_ack;
+            /** Number of ticks between two snapshots to this peer. */
+            unsigned int m_interval;
+            /** Ticks since the interval was last adapted. */
+            unsigned int m_ticks_since_adapt;
+            /** Tick at which the next snapshot is sent. */
+            uint32_t m_next_tick;
+            /** Number of snapshots sent to this peer, used to decide which
+             *  karts are contained in a snapshot. */
+            uint32_t m_count;
+            Snapshot m_snapshots[SNAPSHOT_HISTORY];
+            PeerSnapshots()
+            {
+                m_ack               = 0;
+                m_interval          = DEFAULT_SNAPSHOT_INTERVAL_TICKS;
+                m_ticks_since_adapt = 0;
+                m_next_tick         = 0;
+                m_count             = 0;
+                for (unsigned int i = 0; i < SNAPSHOT_HISTORY; i++)
+                    m_snapshots[i].m_sequence = 0;
+            }
+        };   // PeerSnapshots
+
+        uint16_t    quantizeCoordinate(float f, int axis) const;
+        float       dequantizeCoordinate(uint16_t q, int axis) const;
+        static uint32_t     compressQuaternion(const btQuaternion &q);
+        static btQuaternion decompressQuaternion(uint32_t data);
+        KartState   quantize(const AbstractKart *kart) const;
+        void        addKartState(NetworkString *ns, uint8_t kart_id,
+                                 const KartState &state,
+                                 const KartState *baseline) const;
+        bool        readKartState(const NetworkString &ns, int *offset,
+                                  uint8_t *kart_id, KartState *state) const;
+        void        queueKartState(uint8_t kart_id, const KartState &state,
+                                   float server_time, uint32_t tick);
+        void        updateRemoteKarts();
+        void        sendSnapshot(uint32_t tick);
+        void        updateSnapshotInterval(const STKPeer *peer,
+                                           PeerSnapshots *history) const;
+        void        correctPrediction();
+        unsigned int getUpdateInterval(const AbstractKart *observer,
+                                       const AbstractKart *kart) const;
+        static const Snapshot* findSnapshot(const Snapshot *history,
+                                            uint16_t sequence);
+
         std::vector<AbstractKart*> m_karts;
         uint32_t m_self_kart_index;
 
-        std::list<Vec3> m_next_positions;
-        std::list<btQuaternion> m_next_quaternions;
-        std::list<uint32_t> m_karts_ids;
+        /** Minimum corner of the box used for quantizing positions. */
+        Vec3     m_quantize_min;
+        /** Size of one quantization step along each axis. */
+        Vec3     m_quantize_step;
+
+        /** Client only: ring buffer of recently received snapshots,
+         *  indexed by sequence number. */
+        Snapshot m_snapshots[SNAPSHOT_HISTORY];
+
+        /** Server: sequence number of the last sent snapshot. Client:
+         *  sequence number of the last decoded snapshot (0 if none). */
+        uint16_t m_last_sequence;
+
+        /** Client only: last acknowledged sequence number, and the real
+         *  time it was sent at. */
+        uint16_t m_last_sent_ack;
+        double   m_last_ack_time;
+
+        /** Server only: the snapshots sent to each peer. */
+        std::map<const STKPeer*, PeerSnapshots> m_peer_snapshots;
+
+        /** Client only: the received states of each kart. */
+        std::vector<KartStateBuffer> m_state_buffers;
+
+        /** Client only: estimated difference between the server time and
+         *  the local world time. */
+        float    m_server_time_offset;
+
+        /** Client only: true once m_server_time_offset was initialised. */
+        bool     m_server_time_offset_valid;
+
+        /** Client only: ring buffer of predicted states of the local kart,
+         *  indexed by tick. */
+        PredictedState m_predictions[PREDICTION_HISTORY];
+
+        /** Client only: true if an authoritative state of the local kart
+         *  was received and not yet compared with the prediction. */
+        bool         m_has_correction;
+        uint32_t     m_correction_tick;
+        Vec3         m_correction_xyz;
+        btQuaternion m_correction_rotation;
 
         pthread_mutex_t m_positions_updates_mutex;
 };
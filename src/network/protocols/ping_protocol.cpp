@@ -25,6 +25,7 @@ PingProtocol::PingProtocol(const TransportAddress& ping_dst, double delay_betwee
 {
     m_ping_dst = ping_dst;
     m_delay_between_pings = delay_between_pings;
+    setAsynchronousUpdateInterval(delay_between_pings);
 }
 
 PingProtocol::~PingProtocol()
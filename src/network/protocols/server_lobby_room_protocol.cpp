@@ -37,12 +37,20 @@
 
 ServerLobbyRoomProtocol::ServerLobbyRoomProtocol() : LobbyRoomProtocol(NULL)
 {
+    setAsynchronousUpdateInterval(-1);   // only reacts to events
+    m_poll_request   = NULL;
+    m_last_poll_time = 0;
 }
 
 //-----------------------------------------------------------------------------
 
 ServerLobbyRoomProtocol::~ServerLobbyRoomProtocol()
 {
+    // A request still being executed is deleted by the request manager
+    if (m_poll_request && m_poll_request->isDone())
+        delete m_poll_request;
+    else if (m_poll_request)
+        m_poll_request->setManageMemory(true);
 }
 
 //-----------------------------------------------------------------------------
@@ -147,7 +155,7 @@ void ServerLobbyRoomProtocol::update()
 
 void ServerLobbyRoomProtocol::startGame()
 {
-    std::vector<STKPeer*> peers = NetworkManager::getInstance()->getPeers();
+    const std::vector<STKPeer*> &peers = NetworkManager::getInstance()->getPeers();
     for (unsigned int i = 0; i < peers.size(); i++)
     {
         NetworkString ns;
@@ -162,7 +170,7 @@ void ServerLobbyRoomProtocol::startGame()
 
 void ServerLobbyRoomProtocol::startSelection()
 {
-    std::vector<STKPeer*> peers = NetworkManager::getInstance()->getPeers();
+    const std::vector<STKPeer*> &peers = NetworkManager::getInstance()->getPeers();
     for (unsigned int i = 0; i < peers.size(); i++)
     {
         NetworkString ns;
@@ -174,24 +182,27 @@ void ServerLobbyRoomProtocol::startSelection()
 
 //-----------------------------------------------------------------------------
 
+/** Polls the stk server for clients that want to connect, every 10 seconds.
+ *  The request is executed by the request manager thread, so that the
+ *  lobby (and the main loop) doesn't wait for the answer.
+ */
 void ServerLobbyRoomProtocol::checkIncomingConnectionRequests()
 {
-    // first poll every 5 seconds
-    static double last_poll_time = 0;
-    if (StkTime::getRealTime() > last_poll_time+10.0)
+    if (!m_poll_request && StkTime::getRealTime() > m_last_poll_time+10.0)
     {
-        last_poll_time = StkTime::getRealTime();
+        m_last_poll_time = StkTime::getRealTime();
         TransportAddress addr = NetworkManager::getInstance()->getPublicAddress();
-        Online::XMLRequest* request = new Online::XMLRequest();
-        PlayerManager::setUserDetails(request, "poll-connection-requests", Online::API::SERVER_PATH);
-
-        request->addParameter("address", addr.ip);
-        request->addParameter("port", addr.port);
+        m_poll_request = new Online::XMLRequest();
+        PlayerManager::setUserDetails(m_poll_request, "poll-connection-requests", Online::API::SERVER_PATH);
 
-        request->executeNow();
-        assert(request->isDone());
+        m_poll_request->addParameter("address", addr.ip);
+        m_poll_request->addParameter("port", addr.port);
 
-        const XMLNode * result = request->getXMLData();
+        Online::RequestManager::get()->addRequest(m_poll_request);
+    }
+    else if (m_poll_request && m_poll_request->isDone())
+    {
+        const XMLNode * result = m_poll_request->getXMLData();
         std::string rec_success;
 
         if(result->get("success", &rec_success))
@@ -216,7 +227,8 @@ void ServerLobbyRoomProtocol::checkIncomingConnectionRequests()
         {
             Log::error("ServerLobbyRoomProtocol", "Cannot retrieve the list.");
         }
-        delete request;
+        delete m_poll_request;
+        m_poll_request = NULL;
     }
 
     // now
@@ -254,7 +266,7 @@ void ServerLobbyRoomProtocol::checkRaceFinished()
             }
         }
 
-        std::vector<STKPeer*> peers = NetworkManager::getInstance()->getPeers();
+        const std::vector<STKPeer*> &peers = NetworkManager::getInstance()->getPeers();
 
         NetworkString queue;
         for (unsigned int i = 0; i < karts_results.size(); i++)
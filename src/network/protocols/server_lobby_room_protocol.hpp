@@ -3,6 +3,8 @@
 
 #include "network/protocols/lobby_room_protocol.hpp"
 
+namespace Online { class XMLRequest; }
+
 class ServerLobbyRoomProtocol : public LobbyRoomProtocol
 {
     public:
@@ -36,6 +38,10 @@ class ServerLobbyRoomProtocol : public LobbyRoomProtocol
         uint8_t m_next_id; //!< Next id to assign to a peer.
         std::vector<TransportAddress> m_peers;
         std::vector<uint32_t> m_incoming_peers_ids;
+        /** The pending request for the connection requests, or NULL. */
+        Online::XMLRequest *m_poll_request;
+        /** Time the connection requests were last polled at. */
+        double m_last_poll_time;
         uint32_t m_current_protocol_id;
         TransportAddress m_public_address;
         bool m_selection_enabled;
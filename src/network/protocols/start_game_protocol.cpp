@@ -28,6 +28,7 @@ StartGameProtocol::StartGameProtocol(GameSetup* game_setup)
         m_player_states.insert(std::pair<NetworkPlayerProfile*, STATE>(players[i], LOADING));
     }
     m_ready_count = 0;
+    setAsynchronousUpdateInterval(-1);   // only reacts to events
 }
 
 StartGameProtocol::~StartGameProtocol()
@@ -6,27 +6,49 @@
 #include "network/protocols/game_events_protocol.hpp"
 #include "utils/time.hpp"
 
+#include <algorithm>
+#include <math.h>
+
+/** The local clock, in seconds since the first protocol was created. Times
+ *  are sent as milliseconds of this clock. */
+static double getLocalTime()
+{
+    static const double start_time = StkTime::getRealTime();
+    return StkTime::getRealTime() - start_time;
+}   // getLocalTime
+
 //-----------------------------------------------------------------------------
 
 SynchronizationProtocol::SynchronizationProtocol() : Protocol(NULL, PROTOCOL_SYNCHRONIZATION)
 {
     unsigned int size = NetworkManager::getInstance()->getPeerCount();
-    m_pings.resize(size, std::map<uint32_t,double>());
-    m_pings_count.resize(size);
+    m_clocks.resize(size);
     for (unsigned int i = 0; i < size; i++)
     {
-        m_pings_count[i] = 0;
+        PeerClock &clock = m_clocks[i];
+        for (unsigned int j = 0; j < PING_HISTORY; j++)
+        {
+            clock.m_send_time[j]     = 0.0;
+            clock.m_send_sequence[j] = 0;
+        }
+        clock.m_pings_sent     = 0;
+        clock.m_next_sample    = 0;
+        clock.m_offset         = 0.0;
+        clock.m_skew           = 0.0;
+        clock.m_reference_time = 0.0;
+        clock.m_rtt            = 0.0;
+        clock.m_jitter         = 0.0;
     }
-    m_successed_pings.resize(size);
-    m_total_diff.resize(size);
-    m_average_ping.resize(size);
+    pthread_mutex_init(&m_clocks_mutex, NULL);
     m_countdown_activated = false;
+    m_last_ping_time = getLocalTime();
 }
 
 //-----------------------------------------------------------------------------
 
 SynchronizationProtocol::~SynchronizationProtocol()
 {
+    pthread_mutex_destroy(&m_clocks_mutex);
 }
 
 //-----------------------------------------------------------------------------
@@ -46,7 +68,7 @@ bool SynchronizationProtocol::notifyEventAsynchronous(Event* event)
     uint32_t request = data.gui8(5);
     uint32_t sequence = data.gui32(6);
 
-    std::vector<STKPeer*> peers = NetworkManager::getInstance()->getPeers();
+    const std::vector<STKPeer*> &peers = NetworkManager::getInstance()->getPeers();
 
     if (m_listener->isServer())
     {
@@ -57,7 +79,7 @@ bool SynchronizationProtocol::notifyEventAsynchronous(Event* event)
         }
     }
 
-    uint8_t peer_id;
+    int peer_id = -1;
     for (unsigned int i = 0; i < peers.size(); i++)
     {
         if (peers[i]->isSamePeer(*event->peer))
@@ -65,6 +87,11 @@ bool SynchronizationProtocol::notifyEventAsynchronous(Event* event)
             peer_id = i;
         }
     }
+    if (peer_id < 0 || peer_id >= (int)m_clocks.size())
+    {
+        Log::warn("SynchronizationProtocol", "Message from an unknown peer.");
+        return true;
+    }
     if (peers[peer_id]->getClientServerToken() != token)
     {
         Log::warn("SynchronizationProtocol", "Bad token from peer %d", talk_id);
@@ -73,41 +100,178 @@ bool SynchronizationProtocol::notifyEventAsynchronous(Event* event)
 
     if (request)
     {
+        // Answer with the local time, which gives the clock offset
         NetworkString response;
-        response.ai8(data.gui8(talk_id)).ai32(token).ai8(0).ai32(sequence);
+        response.ai8(talk_id).ai32(token).ai8(0).ai32(sequence)
+                .ai32((uint32_t)(getLocalTime()*1000.0));
         m_listener->sendMessage(this, peers[peer_id], response, false);
         Log::verbose("SynchronizationProtocol", "Answering sequence %u", sequence);
         if (data.size() == 14 && !m_listener->isServer()) // countdown time in the message
         {
+            // The countdown was sent half a round trip ago
             uint32_t time_to_start = data.gui32(10);
+            const double countdown = time_to_start/1000.0
+                                   - 0.5*getRoundTripTime(peer_id);
             Log::debug("SynchronizationProtocol", "Request to start game in %d.", time_to_start);
             if (!m_countdown_activated)
-                startCountdown(time_to_start);
+                startCountdown((int)(countdown*1000.0));
             else
-                m_countdown = (double)(time_to_start/1000.0);
+                m_countdown = countdown;
         }
         else
             Log::verbose("SynchronizationProtocol", "No countdown for now.");
     }
     else // response
     {
-        if (sequence >= m_pings[peer_id].size())
+        if (data.size() < 14)
+        {
+            Log::warn("SynchronizationProtocol", "Answer without time.");
+            return true;
+        }
+        pthread_mutex_lock(&m_clocks_mutex);
+        PeerClock &clock = m_clocks[peer_id];
+        const unsigned int index = sequence % PING_HISTORY;
+        if (sequence >= clock.m_pings_sent ||
+            clock.m_send_sequence[index] != sequence)
         {
+            pthread_mutex_unlock(&m_clocks_mutex);
             Log::warn("SynchronizationProtocol", "The sequence# %u isn't known.", sequence);
             return true;
         }
-        double current_time = StkTime::getRealTime();
-        m_total_diff[peer_id] += current_time - m_pings[peer_id][sequence];
+        const double send_time = clock.m_send_time[index];
+        const double peer_time = data.gui32(10) / 1000.0;
+        Sample sample;
+        sample.m_local_time = getLocalTime();
+        sample.m_rtt        = sample.m_local_time - send_time;
+        // Assume that the answer was sent half way through the round trip
+        sample.m_offset     = peer_time - 0.5*(send_time + sample.m_local_time);
+        addSample(&clock, sample);
         Log::verbose("SynchronizationProtocol", "InstantPing is %u",
-            (unsigned int)((current_time - m_pings[peer_id][sequence])*1000));
-        m_successed_pings[peer_id]++;
-        m_average_ping[peer_id] = (int)((m_total_diff[peer_id]/m_successed_pings[peer_id])*1000.0);
-
-        Log::debug("SynchronizationProtocol", "Ping is %u", m_average_ping[peer_id]);
+            (unsigned int)(sample.m_rtt*1000));
+        Log::debug("SynchronizationProtocol", "Ping is %u, offset %f",
+                   (unsigned int)(clock.m_rtt*1000), clock.m_offset);
+        pthread_mutex_unlock(&m_clocks_mutex);
     }
     return true;
 }
 
+//-----------------------------------------------------------------------------
+/** Adds a sample to the history of a peer and updates the estimate of its
+ *  clock. Must be called with m_clocks_mutex locked.
+ */
+void SynchronizationProtocol::addSample(PeerClock *clock,
+                                        const Sample &sample)
+{
+    if (clock->m_samples.size() < PING_HISTORY)
+        clock->m_samples.push_back(sample);
+    else
+        clock->m_samples[clock->m_next_sample] = sample;
+    clock->m_next_sample = (clock->m_next_sample + 1) % PING_HISTORY;
+
+    std::vector<Sample> sorted = clock->m_samples;
+    std::sort(sorted.begin(), sorted.end(),
+              [](const Sample &a, const Sample &b) {return a.m_rtt < b.m_rtt;});
+    const unsigned int n = (unsigned int)sorted.size();
+
+    // Round trip time and jitter use all samples, the median is not affected
+    // by a few lost or delayed packets
+    clock->m_rtt = sorted[n/2].m_rtt;
+    double deviation = 0.0;
+    for (unsigned int i = 0; i < n; i++)
+        deviation += fabs(sorted[i].m_rtt - clock->m_rtt);
+    clock->m_jitter = deviation / n;
+
+    // Only the faster half of the pings are used for the offset: a delay in
+    // one direction makes the offset of a sample wrong by half of it
+    const unsigned int used = (n + 1) / 2;
+    double mean_time = 0.0, mean_offset = 0.0;
+    for (unsigned int i = 0; i < used; i++)
+    {
+        mean_time   += sorted[i].m_local_time;
+        mean_offset += sorted[i].m_offset;
+    }
+    mean_time   /= used;
+    mean_offset /= used;
+
+    // Least squares fit of the offset over time gives the skew
+    double var = 0.0, cov = 0.0;
+    for (unsigned int i = 0; i < used; i++)
+    {
+        const double dt = sorted[i].m_local_time - mean_time;
+        var += dt * dt;
+        cov += dt * (sorted[i].m_offset - mean_offset);
+    }
+    double skew = 0.0;
+    // Needs samples over at least a second to say anything about the skew
+    if (used >= 4 && var > used * 0.25)
+        skew = cov / var;
+    // Clocks of real hardware don't drift more than this
+    clock->m_skew           = std::max(-0.001, std::min(0.001, skew));
+    clock->m_offset         = mean_offset;
+    clock->m_reference_time = mean_time;
+}   // addSample
+
+//-----------------------------------------------------------------------------
+/** Returns the time of the clock of a peer minus the local time, in seconds.
+ */
+double SynchronizationProtocol::getPeerClockOffset(unsigned int peer)
+{
+    if (peer >= m_clocks.size())
+        return 0.0;
+    pthread_mutex_lock(&m_clocks_mutex);
+    const PeerClock &clock = m_clocks[peer];
+    const double offset = clock.m_offset
+                   + clock.m_skew * (getLocalTime() - clock.m_reference_time);
+    pthread_mutex_unlock(&m_clocks_mutex);
+    return offset;
+}   // getPeerClockOffset
+
+//-----------------------------------------------------------------------------
+/** Returns the time of the server in seconds, which is the same on all
+ *  peers and can be used to time stamp events.
+ */
+double SynchronizationProtocol::getServerTime()
+{
+    if (m_listener->isServer())
+        return getLocalTime();
+    // The only peer of a client is the server
+    return getLocalTime() + getPeerClockOffset(0);
+}   // getServerTime
+
+//-----------------------------------------------------------------------------
+/** Returns the median round trip time to a peer in seconds. */
+double SynchronizationProtocol::getRoundTripTime(unsigned int peer)
+{
+    if (peer >= m_clocks.size())
+        return 0.0;
+    pthread_mutex_lock(&m_clocks_mutex);
+    const double rtt = m_clocks[peer].m_rtt;
+    pthread_mutex_unlock(&m_clocks_mutex);
+    return rtt;
+}   // getRoundTripTime
+
+//-----------------------------------------------------------------------------
+/** Returns the mean deviation of the round trip time to a peer in seconds. */
+double SynchronizationProtocol::getJitter(unsigned int peer)
+{
+    if (peer >= m_clocks.size())
+        return 0.0;
+    pthread_mutex_lock(&m_clocks_mutex);
+    const double jitter = m_clocks[peer].m_jitter;
+    pthread_mutex_unlock(&m_clocks_mutex);
+    return jitter;
+}   // getJitter
+
+//-----------------------------------------------------------------------------
+/** Returns how long states received from a peer should be delayed before
+ *  they are shown, so that the next state usually arrives in time: the
+ *  one way delay plus twice the jitter.
+ */
+double SynchronizationProtocol::getInterpolationDelay(unsigned int peer)
+{
+    return 0.5*getRoundTripTime(peer) + 2.0*getJitter(peer);
+}   // getInterpolationDelay
+
 //-----------------------------------------------------------------------------
 
 void SynchronizationProtocol::setup()
@@ -121,9 +285,8 @@ void SynchronizationProtocol::setup()
 
 void SynchronizationProtocol::asynchronousUpdate()
 {
-    static double timer = StkTime::getRealTime();
     double current_time = StkTime::getRealTime();
-    if (m_countdown_activated)
+    if (m_countdown_activated && !m_has_quit)
     {
         m_countdown -= (current_time - m_last_countdown_update);
         m_last_countdown_update = current_time;
@@ -135,7 +298,7 @@ void SynchronizationProtocol::asynchronousUpdate()
             m_listener->requestStart(new KartUpdateProtocol());
             m_listener->requestStart(new ControllerEventsProtocol());
             m_listener->requestStart(new GameEventsProtocol());
-            m_listener->requestTerminate(this);
+            // Keep running to keep the clocks synchronized during the race
             return;
         }
         static int seconds = -1;
@@ -149,25 +312,30 @@ void SynchronizationProtocol::asynchronousUpdate()
             Log::info("SynchronizationProtocol", "Starting in %d seconds.", seconds);
         }
     }
-    if (current_time > timer+0.1)
+    const double local_time = getLocalTime();
+    if (local_time > m_last_ping_time+0.1)
     {
-        std::vector<STKPeer*> peers = NetworkManager::getInstance()->getPeers();
-        for (unsigned int i = 0; i < peers.size(); i++)
+        m_last_ping_time = local_time;
+        const std::vector<STKPeer*> &peers = NetworkManager::getInstance()->getPeers();
+        pthread_mutex_lock(&m_clocks_mutex);
+        for (unsigned int i = 0; i < peers.size() && i < m_clocks.size(); i++)
         {
+            PeerClock &clock = m_clocks[i];
+            const uint32_t sequence = clock.m_pings_sent++;
             NetworkString ns;
-            ns.ai8(i).addUInt32(peers[i]->getClientServerToken()).addUInt8(1).addUInt32(m_pings[i].size());
+            ns.ai8(i).addUInt32(peers[i]->getClientServerToken()).addUInt8(1).addUInt32(sequence);
             // now add the countdown if necessary
-            if (m_countdown_activated && m_listener->isServer())
+            if (m_countdown_activated && !m_has_quit && m_listener->isServer())
             {
                 ns.addUInt32((int)(m_countdown*1000.0));
                 Log::debug("SynchronizationProtocol", "CNTActivated: Countdown value : %f", m_countdown);
             }
-            Log::verbose("SynchronizationProtocol", "Added sequence number %u for peer %d", m_pings[i].size(), i);
-            timer = current_time;
-            m_pings[i].insert(std::pair<int,double>(m_pings_count[i], timer));
+            Log::verbose("SynchronizationProtocol", "Added sequence number %u for peer %d", sequence, i);
+            clock.m_send_time[sequence % PING_HISTORY]     = local_time;
+            clock.m_send_sequence[sequence % PING_HISTORY] = sequence;
             m_listener->sendMessage(this, peers[i], ns, false);
-            m_pings_count[i]++;
         }
+        pthread_mutex_unlock(&m_clocks_mutex);
     }
 
 }
@@ -2,9 +2,21 @@
 #define SYNCHRONIZATION_PROTOCOL_HPP
 
 #include "network/protocol.hpp"
+
+#include <pthread.h>
 #include <vector>
-#include <map>
 
+/** \class SynchronizationProtocol
+ *  \brief Synchronizes the clocks of the peers and the start of the race.
+ *  Pings are sent to each peer every 100 ms. The answer to a ping contains
+ *  the time of the peer when answering, which gives (like NTP) the round
+ *  trip time and the offset of the peer clock for each ping. The last
+ *  PING_HISTORY samples of each peer are kept. Only the samples with the
+ *  lowest round trip times are used to estimate the offset, since network
+ *  queues only ever delay packets, and the skew of the clocks is found by
+ *  fitting a line through them. The protocol keeps running during the race,
+ *  so that the estimate stays current.
+ */
 class SynchronizationProtocol : public Protocol
 {
     public:
@@ -20,16 +32,59 @@ class SynchronizationProtocol : public Protocol
 
         int getCountdown() { return (int)(m_countdown*1000.0); }
 
+        double getServerTime();
+        double getPeerClockOffset(unsigned int peer);
+        double getRoundTripTime(unsigned int peer);
+        double getJitter(unsigned int peer);
+        double getInterpolationDelay(unsigned int peer);
+
     protected:
-        std::vector<std::map<uint32_t, double> > m_pings;
-        std::vector<uint32_t> m_average_ping;
-        std::vector<uint32_t> m_pings_count;
-        std::vector<uint32_t> m_successed_pings;
-        std::vector<double> m_total_diff;
+        /** Number of ping samples kept per peer. */
+        static const unsigned int PING_HISTORY = 32;
+
+        /** The result of one ping. */
+        struct Sample
+        {
+            /** Local time at which the answer was received. */
+            double m_local_time;
+            double m_rtt;
+            /** Time of the peer minus local time. */
+            double m_offset;
+        };   // Sample
+
+        /** State of the clock of a peer, as estimated from the pings. */
+        struct PeerClock
+        {
+            /** Send time and sequence number of the recent pings, indexed
+             *  by sequence number modulo PING_HISTORY. */
+            double               m_send_time[PING_HISTORY];
+            uint32_t             m_send_sequence[PING_HISTORY];
+            /** Number of pings sent so far, i.e. the next sequence number. */
+            uint32_t             m_pings_sent;
+            /** Ring of the most recent samples. */
+            std::vector<Sample>  m_samples;
+            unsigned int         m_next_sample;
+
+            double               m_offset;
+            /** Drift of the offset per second. */
+            double               m_skew;
+            /** Local time at which the offset is m_offset. */
+            double               m_reference_time;
+            double               m_rtt;
+            double               m_jitter;
+        };   // PeerClock
+
+        std::vector<PeerClock> m_clocks;
+        /** Protects m_clocks, which is read from the main thread. */
+        pthread_mutex_t        m_clocks_mutex;
+
         bool m_countdown_activated;
         double m_countdown;
         double m_last_countdown_update;
+        double m_last_ping_time;
         bool m_has_quit;
+
+        void addSample(PeerClock *clock, const Sample &sample);
 };
 
 #endif // SYNCHRONIZATION_PROTOCOL_HPP
@@ -105,7 +105,7 @@ void ServerNetworkManager::run()
         return;
     }
     m_localhost = new STKHost();
-    m_localhost->setupServer(STKHost::HOST_ANY, 7321, 16, 2, 0, 0);
+    m_localhost->setupServer(STKHost::HOST_ANY, 7321, 16, CHANNEL_COUNT, 0, 0);
     m_localhost->startListening();
 
     Log::info("ServerNetworkManager", "Host initialized.");
@@ -126,7 +126,8 @@ void ServerNetworkManager::kickAllPlayers()
     }
 }
 
-void ServerNetworkManager::sendPacket(const NetworkString& data, bool reliable)
+void ServerNetworkManager::sendPacket(const NetworkString& data, bool reliable,
+                                      NetworkChannel channel)
 {
-    m_localhost->broadcastPacket(data, reliable);
+    m_localhost->broadcastPacket(data, reliable, channel);
 }
@@ -41,7 +41,8 @@ class ServerNetworkManager : public NetworkManager
 
         void kickAllPlayers();
 
-        virtual void sendPacket(const NetworkString& data, bool reliable = true);
+        virtual void sendPacket(const NetworkString& data, bool reliable = true,
+                                NetworkChannel channel = CHANNEL_LOBBY);
 
         virtual bool isServer()         { return true; }
 
@@ -21,9 +21,11 @@
 #include "config/user_config.hpp"
 #include "io/file_manager.hpp"
 #include "network/network_manager.hpp"
+#include "network/network_statistics.hpp"
 #include "utils/log.hpp"
 #include "utils/time.hpp"
 
+#include <sstream>
 #include <string.h>
 #if defined(WIN32)
 #  include "ws2tcpip.h"
@@ -62,16 +64,17 @@ void STKHost::logPacket(const NetworkString &ns, bool incoming)
 {
     if (m_log_file == NULL)
         return;
-    pthread_mutex_lock(&m_log_mutex);
-    if (incoming)
-        fprintf(m_log_file, "[%d\t]  <--  ", (int)(StkTime::getRealTime()));
-    else
-        fprintf(m_log_file, "[%d\t]  -->  ", (int)(StkTime::getRealTime()));
+    // Format the line before locking, so that the threads only wait for
+    // each other while the line is written.
+    std::ostringstream line;
+    line << "[" << (int)(StkTime::getRealTime()) << "\t]  "
+         << (incoming ? "<--  " : "-->  ");
     for (int i = 0; i < ns.size(); i++)
-    {
-        fprintf(m_log_file, "%d.", ns[i]);
-    }
-    fprintf(m_log_file, "\n");
+        line << (int)ns[i] << ".";
+    line << "\n";
+    const std::string &s = line.str();
+    pthread_mutex_lock(&m_log_mutex);
+    fwrite(s.c_str(), 1, s.size(), m_log_file);
     pthread_mutex_unlock(&m_log_mutex);
 }
 
@@ -85,12 +88,16 @@ void* STKHost::receive_data(void* self)
     while (!myself->mustStopListening())
     {
         while (enet_host_service(host, &event, 20) != 0) {
-            Event* evt = new Event(&event);
+            if (event.type == ENET_EVENT_TYPE_NONE)
+                continue;
+            Event* evt = Event::create(&event);
             if (evt->type == EVENT_TYPE_MESSAGE)
+            {
+                NetworkStatistics::getInstance()->addIncomingPacket(evt->data());
                 logPacket(evt->data(), true);
-            if (event.type != ENET_EVENT_TYPE_NONE)
-                NetworkManager::getInstance()->notifyEvent(evt);
-            delete evt;
+            }
+            // the event is owned by the protocol manager from now on
+            NetworkManager::getInstance()->notifyEvent(evt);
         }
     }
     myself->m_listening = false;
@@ -325,11 +332,13 @@ uint8_t* STKHost::receiveRawPacket(TransportAddress sender, int max_tries)
 
 // ----------------------------------------------------------------------------
 
-void STKHost::broadcastPacket(const NetworkString& data, bool reliable)
+void STKHost::broadcastPacket(const NetworkString& data, bool reliable,
+                              NetworkChannel channel)
 {
-    ENetPacket* packet = enet_packet_create(data.getBytes(), data.size() + 1,
-               (reliable ? ENET_PACKET_FLAG_RELIABLE : ENET_PACKET_FLAG_UNSEQUENCED));
-    enet_host_broadcast(m_host, 0, packet);
+    ENetPacket* packet = STKPeer::createPacket(data, reliable, channel);
+    enet_host_broadcast(m_host, channel, packet);
+    NetworkStatistics::getInstance()->addOutgoingPacket(data,
+                     (unsigned int)NetworkManager::getInstance()->getPeers().size());
     STKHost::logPacket(data, false);
 }
 
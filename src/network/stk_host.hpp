@@ -141,8 +141,10 @@ class STKHost
         uint8_t*    receiveRawPacket(TransportAddress sender, int max_tries = -1);
         /*! \brief Broadcasts a packet to all peers.
          *  \param data : Data to send.
+         *  \param channel : The channel to send the packet on.
          */
-        void        broadcastPacket(const NetworkString& data, bool reliable = true);
+        void        broadcastPacket(const NetworkString& data, bool reliable = true,
+                                    NetworkChannel channel = CHANNEL_LOBBY);
 
         /*! \brief Tells if a peer is known.
          *  \return True if the peer is known, false elseway.
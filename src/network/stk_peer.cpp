@@ -18,6 +18,7 @@
 
 #include "network/stk_peer.hpp"
 #include "network/network_manager.hpp"
+#include "network/network_statistics.hpp"
 #include "utils/log.hpp"
 
 #include <string.h>
@@ -43,6 +44,17 @@ STKPeer::STKPeer(const STKPeer& peer)
     m_token_set = peer.m_token_set;
 }
 
+//-----------------------------------------------------------------------------
+/** Removes this peer from the user data of its ENet peer, must be called
+ *  before the peer is deleted while the ENet host still exists, so that
+ *  events of that ENet peer don't find the deleted peer.
+ */
+void STKPeer::detach()
+{
+    if (m_peer && m_peer->data == this)
+        m_peer->data = NULL;
+}
+
 //-----------------------------------------------------------------------------
 
 STKPeer::~STKPeer()
@@ -73,7 +85,8 @@ bool STKPeer::connectToHost(STKHost* localhost, TransportAddress host,
        + ((host.ip & 0x000000ff) << 24); // because ENet wants little endian
     address.port = host.port;
 
-    ENetPeer* peer = enet_host_connect(localhost->m_host, &address, 2, 0);
+    ENetPeer* peer = enet_host_connect(localhost->m_host, &address,
+                                       channel_count, data);
     if (peer == NULL)
     {
         Log::error("STKPeer", "Could not try to connect to server.\n");
@@ -95,14 +108,31 @@ void STKPeer::disconnect()
 
 //-----------------------------------------------------------------------------
 
-void STKPeer::sendPacket(NetworkString const& data, bool reliable)
+/** Creates an ENet packet containing a message. The packet can be sent to
+ *  several peers with sendPacket(ENetPacket*), ENet counts the references
+ *  to it and frees it once it was sent to all of them. Unreliable packets
+ *  on the state channel are sequenced, i.e. ENet drops a kart update that
+ *  arrives after a newer one.
+ */
+ENetPacket* STKPeer::createPacket(NetworkString const& data, bool reliable,
+                                  NetworkChannel channel)
+{
+    enet_uint32 flags = ENET_PACKET_FLAG_RELIABLE;
+    if (!reliable)
+        flags = channel == CHANNEL_STATE ? 0 : ENET_PACKET_FLAG_UNSEQUENCED;
+    return enet_packet_create(data.getBytes(), data.size() + 1, flags);
+}
+
+//-----------------------------------------------------------------------------
+
+void STKPeer::sendPacket(NetworkString const& data, bool reliable,
+                         NetworkChannel channel)
 {
     Log::verbose("STKPeer", "sending packet of size %d to %i.%i.%i.%i:%i",
                 data.size(), (m_peer->address.host>>0)&0xff,
                 (m_peer->address.host>>8)&0xff,(m_peer->address.host>>16)&0xff,
                 (m_peer->address.host>>24)&0xff,m_peer->address.port);
-    ENetPacket* packet = enet_packet_create(data.getBytes(), data.size() + 1,
-                (reliable ? ENET_PACKET_FLAG_RELIABLE : ENET_PACKET_FLAG_UNSEQUENCED));
+    ENetPacket* packet = createPacket(data, reliable, channel);
     /* to debug the packet output
     printf("STKPeer: ");
     for (unsigned int i = 0; i < data.size(); i++)
@@ -111,7 +141,17 @@ void STKPeer::sendPacket(NetworkString const& data, bool reliable)
     }
     printf("\n");
     */
-    enet_peer_send(m_peer, 0, packet);
+    enet_peer_send(m_peer, channel, packet);
+    NetworkStatistics::getInstance()->addOutgoingPacket(data);
+}
+
+//-----------------------------------------------------------------------------
+/** Sends a packet created with createPacket. If the packet is not sent to
+ *  any peer, the caller must destroy it.
+ */
+void STKPeer::sendPacket(ENetPacket* packet, NetworkChannel channel)
+{
+    enet_peer_send(m_peer, channel, packet);
 }
 
 //-----------------------------------------------------------------------------
@@ -130,6 +170,39 @@ uint16_t STKPeer::getPort() const
 
 //-----------------------------------------------------------------------------
 
+/** Returns the mean round trip time to this peer in ms, as measured by ENet
+ *  using the acknowledgements of reliable packets. */
+uint32_t STKPeer::getRoundTripTime() const
+{
+    return m_peer->roundTripTime;
+}
+
+//-----------------------------------------------------------------------------
+
+/** Returns the variance of the round trip time (i.e. the jitter) in ms. */
+uint32_t STKPeer::getRoundTripTimeVariance() const
+{
+    return m_peer->roundTripTimeVariance;
+}
+
+//-----------------------------------------------------------------------------
+
+/** Returns the mean loss of reliable packets, between 0 and 1. */
+float STKPeer::getPacketLoss() const
+{
+    return m_peer->packetLoss / (float)ENET_PEER_PACKET_LOSS_SCALE;
+}
+
+//-----------------------------------------------------------------------------
+/** Returns the fraction of unreliable packets ENet currently lets through
+ *  to this peer, which ENet decreases when the round trip time rises. */
+float STKPeer::getPacketThrottle() const
+{
+    return m_peer->packetThrottle / (float)ENET_PEER_PACKET_THROTTLE_SCALE;
+}
+
+//-----------------------------------------------------------------------------
+
 bool STKPeer::isConnected() const
 {
     Log::info("STKPeer", "The peer state is %i", m_peer->state);
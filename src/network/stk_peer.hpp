@@ -40,9 +40,15 @@ class STKPeer
         STKPeer(const STKPeer& peer);
         virtual ~STKPeer();
 
-        virtual void sendPacket(const NetworkString& data, bool reliable = true);
+        virtual void sendPacket(const NetworkString& data, bool reliable = true,
+                                NetworkChannel channel = CHANNEL_LOBBY);
+        void sendPacket(ENetPacket* packet,
+                        NetworkChannel channel = CHANNEL_LOBBY);
+        static ENetPacket* createPacket(const NetworkString& data, bool reliable,
+                                        NetworkChannel channel = CHANNEL_LOBBY);
         static bool connectToHost(STKHost* localhost, TransportAddress host, uint32_t channel_count, uint32_t data);
         void disconnect();
+        void detach();
 
         void setClientServerToken(const uint32_t& token) { *m_client_server_token = token; *m_token_set = true; }
         void unsetClientServerToken() { *m_token_set = false; }
@@ -53,6 +59,10 @@ class STKPeer
         bool exists() const;
         uint32_t getAddress() const;
         uint16_t getPort() const;
+        uint32_t getRoundTripTime() const;
+        uint32_t getRoundTripTimeVariance() const;
+        float    getPacketLoss() const;
+        float    getPacketThrottle() const;
         NetworkPlayerProfile* getPlayerProfile() { return (m_player_profile)?(*m_player_profile):NULL; }
         uint32_t getClientServerToken() const   { return *m_client_server_token; }
         bool     isClientServerTokenSet() const { return *m_token_set; }
@@ -30,6 +30,19 @@
 #define ADDRESS_FORMAT "%d.%d.%d.%d:%d"
 #define ADDRESS_ARGS(ip,port) ((ip>>24)&0xff),((ip>>16)&0xff),((ip>>8)&0xff),((ip>>0)&0xff),port
 
+/*! \enum NetworkChannel
+ *  \brief The ENet channels the messages are sent on. ENet only orders and
+ *  resends reliable packets within a channel, so a lost lobby message or
+ *  game event doesn't hold back the kart updates on the other channels.
+ */
+enum NetworkChannel
+{
+    CHANNEL_LOBBY  = 0,     //!< Connection, lobby and start of the game.
+    CHANNEL_EVENTS = 1,     //!< Game and controller events.
+    CHANNEL_STATE  = 2,     //!< Kart updates, older ones are dropped.
+    CHANNEL_COUNT  = 3      //!< Number of channels to open per peer.
+};
+
 /*! \class CallbackObject
  *  \brief Class that must be inherited to pass objects to protocols.
  */
@@ -27,6 +27,7 @@
 
 #include <curl/curl.h>
 #include <assert.h>
+#include <sys/stat.h>
 
 namespace Online
 {
@@ -93,6 +94,14 @@ namespace Online
         m_filename      = "";
         m_parameters    = "";
         m_curl_code     = CURLE_OK;
+        m_curl_session  = NULL;
+        m_file          = NULL;
+        m_headers       = NULL;
+        m_etag          = "";
+        m_conditional   = false;
+        m_resumable     = false;
+        m_resume_from   = 0;
+        m_response_code = 0;
         m_progress.setAtomic(0);
     }   // init
 
@@ -170,13 +179,13 @@ namespace Online
         curl_easy_setopt(m_curl_session, CURLOPT_CONNECTTIMEOUT, 20);
         curl_easy_setopt(m_curl_session, CURLOPT_LOW_SPEED_LIMIT, 10);
         curl_easy_setopt(m_curl_session, CURLOPT_LOW_SPEED_TIME, 20);
+        curl_easy_setopt(m_curl_session, CURLOPT_TCP_KEEPALIVE, 1L);
         //curl_easy_setopt(m_curl_session, CURLOPT_VERBOSE, 1L);
         if (m_url.substr(0, 8) == "https://")
         {
             // https, load certificate info
-            struct curl_slist *chunk = NULL;
-            chunk = curl_slist_append(chunk, "Host: addons.supertuxkart.net");
-            curl_easy_setopt(m_curl_session, CURLOPT_HTTPHEADER, chunk);
+            m_headers = curl_slist_append(m_headers,
+                                          "Host: addons.supertuxkart.net");
             CURLcode error = curl_easy_setopt(m_curl_session, CURLOPT_CAINFO,
                        file_manager->getAsset("addons.supertuxkart.net.pem").c_str());
             if (error != CURLE_OK)
@@ -200,24 +209,137 @@ namespace Online
      */
     void HTTPRequest::operation()
     {
-        if (!m_curl_session)
+        if (!m_curl_session || !setupTransfer())
             return;
 
-        FILE *fout = NULL;
+        m_curl_code = curl_easy_perform(m_curl_session);
+        Request::operation();
+        finishTransfer();
+    }   // operation
+
+    // ------------------------------------------------------------------------
+    /** Adds the download to the multi handle of the RequestManager, which
+     *  runs it together with the other downloads. Connections and TLS
+     *  sessions to the same host are reused between requests.
+     *  \param multi The curl multi handle.
+     *  \return False if the download could not be started.
+     */
+    bool HTTPRequest::startTransfer(CURLM *multi)
+    {
+        if (!m_curl_session || !setupTransfer())
+            return false;
+
+        curl_easy_setopt(m_curl_session, CURLOPT_SHARE,
+                         RequestManager::get()->getCurlShare());
+        curl_easy_setopt(m_curl_session, CURLOPT_PRIVATE, (Request*)this);
+        CURLMcode error = curl_multi_add_handle(multi, m_curl_session);
+        if (error != CURLM_OK)
+        {
+            Log::error("HTTPRequest", "Can't start download of %s: %s",
+                       m_url.c_str(), curl_multi_strerror(error));
+            m_curl_code = CURLE_FAILED_INIT;
+            finishTransfer();
+            return false;
+        }
+        return true;
+    }   // startTransfer
+
+    // ------------------------------------------------------------------------
+    /** Called by the RequestManager when the download added by startTransfer
+     *  has finished.
+     *  \param code The curl result of the download.
+     */
+    void HTTPRequest::transferFinished(CURLcode code)
+    {
+        m_curl_code = code;
+        finishTransfer();
+    }   // transferFinished
+
+    // ------------------------------------------------------------------------
+    /** Sets up where the received data is stored, and the parameters to send.
+     *  \return False if the file to download into can't be opened.
+     */
+    bool HTTPRequest::setupTransfer()
+    {
+        m_file = NULL;
         if (m_filename.size() > 0)
         {
-            fout = fopen((m_filename+".part").c_str(), "wb");
+            const std::string part = m_filename + ".part";
+            m_resume_from = 0;
+            std::string resume_etag;
+            if (m_resumable)
+            {
+                // A download is only continued if the ETag of the partial
+                // file is known, so that the server can check that the
+                // file was not changed in the meantime.
+                FILE *etag_file = fopen((part + ".etag").c_str(), "rb");
+                m_file = etag_file ? fopen(part.c_str(), "rb") : NULL;
+                if (m_file)
+                {
+                    char buffer[256];
+                    size_t n = fread(buffer, 1, sizeof(buffer) - 1, etag_file);
+                    resume_etag.assign(buffer, n);
+                    fseek(m_file, 0, SEEK_END);
+                    m_resume_from = resume_etag.empty() ? 0 : ftell(m_file);
+                    fclose(m_file);
+                }
+                if (etag_file)
+                    fclose(etag_file);
+            }
+            m_file = fopen(part.c_str(), m_resume_from > 0 ? "ab" : "wb");
 
-            if (!fout)
+            if (!m_file)
             {
                 Log::error("HTTPRequest",
                            "Can't open '%s' for writing, ignored.",
-                           (m_filename+".part").c_str());
-                return;
+                           part.c_str());
+                return false;
             }
-            curl_easy_setopt(m_curl_session,  CURLOPT_WRITEDATA,     fout  );
+            curl_easy_setopt(m_curl_session,  CURLOPT_WRITEDATA,     m_file);
             curl_easy_setopt(m_curl_session,  CURLOPT_WRITEFUNCTION, fwrite);
+
+            if (m_resume_from > 0)
+            {
+                Log::info("HTTPRequest", "Continuing download of %s at %ld.",
+                          m_url.c_str(), m_resume_from);
+                curl_easy_setopt(m_curl_session, CURLOPT_RESUME_FROM_LARGE,
+                                 (curl_off_t)m_resume_from);
+                // If the file was changed, the server sends the whole file,
+                // which curl reports as range error.
+                m_headers = curl_slist_append(m_headers,
+                                        ("If-Range: " + resume_etag).c_str());
+            }
+            else if (m_conditional && file_manager->fileExists(m_filename))
+            {
+                if (!m_etag.empty())
+                {
+                    m_headers = curl_slist_append(m_headers,
+                                       ("If-None-Match: " + m_etag).c_str());
+                }
+                struct stat file_info;
+                if (stat(m_filename.c_str(), &file_info) == 0)
+                {
+                    curl_easy_setopt(m_curl_session, CURLOPT_TIMECONDITION,
+                                     (long)CURL_TIMECOND_IFMODSINCE);
+                    curl_easy_setopt(m_curl_session, CURLOPT_TIMEVALUE,
+                                     (long)file_info.st_mtime);
+                }
+            }
+            m_etag = "";
+            curl_easy_setopt(m_curl_session, CURLOPT_HEADERDATA, this);
+            curl_easy_setopt(m_curl_session, CURLOPT_HEADERFUNCTION,
+                             &HTTPRequest::headerCallback);
+        }
+        else
+        {
+            // Let curl ask for a compressed answer in any encoding it
+            // supports, and decompress it while receiving. Files are not
+            // compressed, since resuming a download counts the bytes of the
+            // file itself.
+            curl_easy_setopt(m_curl_session, CURLOPT_ACCEPT_ENCODING, "");
         }
+        if (m_headers)
+            curl_easy_setopt(m_curl_session, CURLOPT_HTTPHEADER, m_headers);
         else
         {
             curl_easy_setopt(m_curl_session, CURLOPT_WRITEDATA,
@@ -279,13 +401,63 @@ namespace Online
                     // Unknown system type
             #endif
         curl_easy_setopt(m_curl_session, CURLOPT_USERAGENT, uagent.c_str());
+        return true;
+    }   // setupTransfer
 
-        m_curl_code = curl_easy_perform(m_curl_session);
-        Request::operation();
-
-        if (fout)
+    // ------------------------------------------------------------------------
+    /** Closes the file the data was downloaded into, and on success renames
+     *  it to its final name.
+     */
+    void HTTPRequest::finishTransfer()
+    {
+        if (m_file)
         {
-            fclose(fout);
+            fclose(m_file);
+            m_file = NULL;
+            const std::string part = m_filename + ".part";
+            curl_easy_getinfo(m_curl_session, CURLINFO_RESPONSE_CODE,
+                              &m_response_code);
+            if (m_curl_code == CURLE_OK && wasNotModified())
+            {
+                // The existing file is up to date
+                file_manager->removeFile(part);
+                if(UserConfigParams::logAddons())
+                    Log::info("HTTPRequest", "%s was not modified.",
+                              m_url.c_str());
+                return;
+            }
+            if (m_curl_code == CURLE_OK && m_response_code >= 400)
+            {
+                Log::error("HTTPRequest", "Download of %s failed with http "
+                           "status %ld.", m_url.c_str(), m_response_code);
+                m_curl_code = CURLE_HTTP_RETURNED_ERROR;
+                // Don't continue a download the server refused
+                file_manager->removeFile(part);
+                file_manager->removeFile(part + ".etag");
+                return;
+            }
+            if (m_curl_code == CURLE_RANGE_ERROR)
+            {
+                Log::warn("HTTPRequest", "%s can't be continued, it will be "
+                          "downloaded again.", m_url.c_str());
+                file_manager->removeFile(part);
+                file_manager->removeFile(part + ".etag");
+                return;
+            }
+            if (m_curl_code != CURLE_OK && m_resumable && !m_etag.empty())
+            {
+                // Keep the partial file, and store its ETag so that the
+                // next download can continue where this one stopped.
+                FILE *etag_file = fopen((part + ".etag").c_str(), "wb");
+                if (etag_file)
+                {
+                    fwrite(m_etag.c_str(), 1, m_etag.size(), etag_file);
+                    fclose(etag_file);
+                }
+                return;
+            }
+            if (m_resumable)
+                file_manager->removeFile(part + ".etag");
             if (m_curl_code == CURLE_OK)
             {
                 if(UserConfigParams::logAddons())
@@ -311,8 +483,8 @@ namespace Online
                     m_curl_code = CURLE_WRITE_ERROR;
                 }
             }   // m_curl_code ==CURLE_OK
-        }   // if fout
-    }   // operation
+        }   // if m_file
+    }   // finishTransfer
 
     // ------------------------------------------------------------------------
     /** Cleanup once the download is finished. The value of progress is
@@ -328,6 +500,8 @@ namespace Online
 
         Request::afterOperation();
         curl_easy_cleanup(m_curl_session);
+        curl_slist_free_all(m_headers);
+        m_headers = NULL;
     }   // afterOperation
 
     // ------------------------------------------------------------------------
@@ -345,6 +519,30 @@ namespace Online
         return size * nmemb;
     }   // writeCallback
 
+    // ------------------------------------------------------------------------
+    /** Callback from curl for each received header line, which stores the
+     *  ETag sent by the server.
+     *  \param buffer The header line, not 0 terminated.
+     *  \param size Size of one block.
+     *  \param nmemb Number of blocks received.
+     *  \param userp Pointer to the request.
+     */
+    size_t HTTPRequest::headerCallback(char *buffer, size_t size,
+                                       size_t nmemb, void *userp)
+    {
+        HTTPRequest *request = (HTTPRequest*)userp;
+        std::string line(buffer, size * nmemb);
+        if (line.size() > 5 &&
+            StringUtils::toLowerCase(line.substr(0, 5)) == "etag:")
+        {
+            std::string::size_type start = line.find_first_not_of(" \t", 5);
+            std::string::size_type end   = line.find_last_not_of(" \t\r\n");
+            if (start != std::string::npos && end >= start)
+                request->m_etag = line.substr(start, end - start + 1);
+        }
+        return size * nmemb;
+    }   // headerCallback
+
     // ----------------------------------------------------------------------------
     /** Callback function from curl: inform about progress. It makes sure that
      *  the value reported by getProgress () is <1 while the download is still
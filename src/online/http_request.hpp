@@ -30,6 +30,7 @@
 #endif
 #include <curl/curl.h>
 #include <assert.h>
+#include <stdio.h>
 #include <string>
 
 namespace Online
@@ -68,6 +69,29 @@ namespace Online
         /** curl return code. */
         CURLcode m_curl_code;
 
+        /** The file the data is written to while downloading into a file. */
+        FILE *m_file;
+
+        /** Additional headers sent with the request. */
+        struct curl_slist *m_headers;
+
+        /** The ETag sent to the server (to only download a file if it was
+         *  changed), and on return the ETag received from the server. */
+        std::string m_etag;
+
+        /** If the file to download already exists, only download it if it
+         *  was changed on the server. */
+        bool m_conditional;
+
+        /** If an interrupted download into a file is continued. */
+        bool m_resumable;
+
+        /** Number of bytes of a previous download that are continued. */
+        long m_resume_from;
+
+        /** The http response code. */
+        long m_response_code;
+
         /** String to store the received data in. */
         std::string m_string_buffer;
 
@@ -75,6 +99,11 @@ namespace Online
         virtual void prepareOperation() OVERRIDE;
         virtual void operation() OVERRIDE;
         virtual void afterOperation() OVERRIDE;
+        virtual bool startTransfer(CURLM *multi) OVERRIDE;
+        virtual void transferFinished(CURLcode code) OVERRIDE;
+
+        bool setupTransfer();
+        void finishTransfer();
 
         static int progressDownload(void *clientp, double dltotal,
                                     double dlnow,  double ultotal,
@@ -82,6 +111,8 @@ namespace Online
 
         static size_t writeCallback(void *contents, size_t size,
                                     size_t nmemb,   void *userp);
+        static size_t headerCallback(char *buffer, size_t size,
+                                     size_t nmemb, void *userp);
         void init();
 
     public :
@@ -154,6 +185,40 @@ namespace Online
             curl_free(s2);
         }   // addParameter
 
+        // --------------------------------------------------------------------
+        /** Only downloads the file if it does not exist yet, or if it was
+         *  changed on the server since it was downloaded.
+         *  \param etag The ETag of the existing file, or "" if unknown. */
+        void setConditional(const std::string &etag)
+        {
+            assert(isPreparing());
+            m_conditional = true;
+            m_etag        = etag;
+        }   // setConditional
+
+        // --------------------------------------------------------------------
+        /** Keeps the partially downloaded file if the download is
+         *  interrupted, so that the next download of the same file only
+         *  requests the missing part. */
+        void setResumable(bool resumable)
+        {
+            assert(isPreparing());
+            m_resumable = resumable;
+        }   // setResumable
+
+        // --------------------------------------------------------------------
+        /** Returns true if the file was not downloaded, since the existing
+         *  file is up to date. */
+        bool wasNotModified() const { return m_response_code == 304; }
+
+        // --------------------------------------------------------------------
+        /** Returns the ETag received from the server, or "" if none. */
+        const std::string& getETag() const
+        {
+            assert(hasBeenExecuted());
+            return m_etag;
+        }   // getETag
+
         // --------------------------------------------------------------------
         /** Returns the current progress. */
         float getProgress() const { return m_progress.getAtomic(); }
@@ -61,7 +61,6 @@ OnlineProfile::OnlineProfile(const uint32_t  & userid,
                              bool is_current_user)
 {
     m_state                    = (State)0;
-    m_cache_bit                = true;
     m_id                       = userid;
     m_is_current_user          = is_current_user;
     m_username                 = username;
@@ -84,7 +83,6 @@ OnlineProfile::OnlineProfile(const XMLNode * xml, ConstructorType type)
 {
     m_relation_info            = NULL;
     m_is_friend                = false;
-    m_cache_bit                = true;
     m_has_fetched_friends      = false;
     m_has_fetched_achievements = false;
     if (type == C_RELATION_INFO)
@@ -101,8 +101,6 @@ private:
     bool                            m_has_fetched_achievements;
     std::vector<uint32_t>           m_achievements;
 
-    bool                            m_cache_bit;
-
     void storeFriends(const XMLNode * input);
     void storeAchievements(const XMLNode * input);
 
@@ -166,16 +164,6 @@ public:
         delete m_relation_info; m_relation_info = r;
     }   // setRelationInfo
 
-    // ------------------------------------------------------------------------
-    /** Sets the cache bit of this profile. Used by the cache eviction
-     *  algorithm. */
-    void setCacheBit(bool cache_bit)  { m_cache_bit = cache_bit; }
-
-    // ------------------------------------------------------------------------
-    /** Returns the cache bit for this profile. Used by the cache eviction
-     *  algorithm. */
-    bool getCacheBit() const { return m_cache_bit; }
-
     // ------------------------------------------------------------------------
     /** Returns the online id of this profile. */
     uint32_t getID() const { return m_id; }
@@ -123,34 +123,30 @@ void ProfileManager::addToCache(OnlineProfile * profile)
 void ProfileManager::addDirectToCache(OnlineProfile* profile)
 {
     assert(profile != NULL);
-    if (m_profiles_cache.size() >= m_max_cache_size)
+    // Cache already full, remove the least recently used entries till
+    // enough space is available.
+    while (m_profiles_cache.size() >= m_max_cache_size &&
+           !m_cache_order.empty())
     {
-        // Cache already full, try to find entries that
-        // don't have their used bit set
-        ProfilesMap::iterator iter;
-        for (iter = m_profiles_cache.begin(); iter != m_profiles_cache.end();)
-        {
-            if (!iter->second->getCacheBit())
-            {
-                updateAllFriendFlags(iter->second);
-                delete iter->second;
-                iter = m_profiles_cache.erase(iter);
-                // Keep on deleting till enough space is available.
-                if(m_profiles_cache.size()<m_max_cache_size)
-                    break;
-            }
-            else
-            {
-                ++iter;
-            }
-        } // for profile in cache
-    }
+        const uint32_t id = m_cache_order.front();
+        m_cache_order.pop_front();
+        m_cache_position.erase(id);
+        ProfilesMap::iterator iter = m_profiles_cache.find(id);
+        assert(iter != m_profiles_cache.end());
+        OnlineProfile *oldest = iter->second;
+        m_profiles_cache.erase(iter);
+        updateAllFriendFlags(oldest);
+        delete oldest;
+    }   // while cache full
 
     m_profiles_cache[profile->getID()] = profile;
+    m_cache_position[profile->getID()] =
+        m_cache_order.insert(m_cache_order.end(), profile->getID());
 }   // addDirectToCache
 
 // ------------------------------------------------------------------------
-/** Checks if a profile is in cache. If so, it updates its usage bit.
+/** Checks if a profile is in cache. If so, it is marked as the most
+*  recently used one.
 *  \param id Identifier for the profile to check.
 */
 bool ProfileManager::isInCache(const uint32_t id)
@@ -158,7 +154,7 @@ bool ProfileManager::isInCache(const uint32_t id)
     ProfilesMap::const_iterator i = m_profiles_cache.find(id);
     if (i != m_profiles_cache.end())
     {
-        updateCacheBits(i->second);
+        markCacheUsed(id);
         return true;
     }
 
@@ -204,38 +200,17 @@ void ProfileManager::updateAllFriendFlags(const OnlineProfile *profile)
 }   // updateAllFriendFlags
 
 // ------------------------------------------------------------------------
-/** This function updates the cache bits of all cached entries. It will
-*  set the cache bit of the given profile. Then, if the cachen is full
-*  it will check if there are any entries that don't have the cache bit
-*  set (i.e. entries that can be discarded because they were not used).
-*  If no such entry is found, all usage flags will be reset, and only
-*  the one for the given entry will remain set. This results with high
-*  probability that most often used entries will remain in the cache,
-*  without adding much overhead.
-*/
-void ProfileManager::updateCacheBits(OnlineProfile * profile)
+/** Moves a cached profile to the end of the eviction order, so that the
+ *  least recently used profiles are removed first when the cache is full.
+ *  \param id The id of the cached profile that was used.
+ */
+void ProfileManager::markCacheUsed(uint32_t id)
 {
-    profile->setCacheBit(true);
-    if (m_profiles_cache.size() >= m_max_cache_size)
-    {
-        ProfilesMap::iterator iter;
-        for (iter = m_profiles_cache.begin();
-            iter != m_profiles_cache.end(); ++iter)
-        {
-            if (!iter->second->getCacheBit())
-                return;
-        }
-
-        // All cache bits are set! Set them all to zero except the one
-        // currently being visited
-        for (iter = m_profiles_cache.begin();
-            iter != m_profiles_cache.end(); ++iter)
-        {
-            iter->second->setCacheBit(false);
-        }
-        profile->setCacheBit(true);
-    }
-}   // updateCacheBits
+    std::map<uint32_t, CacheOrder::iterator>::iterator pos =
+        m_cache_position.find(id);
+    assert(pos != m_cache_position.end());
+    m_cache_order.splice(m_cache_order.end(), m_cache_order, pos->second);
+}   // markCacheUsed
 
 // ------------------------------------------------------------------------
 /** True if the profile with the given id is persistent.
@@ -24,6 +24,7 @@
 #include <irrString.h>
 
 #include <assert.h>
+#include <list>
 #include <map>
 #include <string>
 
@@ -56,11 +57,19 @@ private:
      *  and friends. */
     ProfilesMap m_profiles_persistent;
 
-    /** Any profiles that don't go into the persistent map, go here. This
-     *  uses a pseudo-LRU algorithm with age bits to remove entries when
-     *  the max size is reached. */
+    /** Any profiles that don't go into the persistent map, go here. The
+     *  least recently used entry is removed when the max size is
+     *  reached. */
     ProfilesMap  m_profiles_cache;
 
+    /** The ids of all cached profiles, least recently used first. */
+    typedef std::list<uint32_t> CacheOrder;
+    CacheOrder   m_cache_order;
+
+    /** The position of each cached profile in m_cache_order, so that it
+     *  can be moved to the end when used without searching the list. */
+    std::map<uint32_t, CacheOrder::iterator> m_cache_position;
+
     /** A temporary profile that is currently being 'visited',
      *  e.g. its data is shown in a gui. */
     OnlineProfile* m_currently_visiting;
@@ -70,7 +79,7 @@ private:
      *  loaded, to make sure they can be all stored). */
     unsigned int  m_max_cache_size;
 
-    void updateCacheBits(OnlineProfile *profile);
+    void markCacheUsed(uint32_t id);
     void addDirectToCache(OnlineProfile *profile);
     void updateFriendFlagsInCache(const ProfilesMap &cache,
                                   uint32_t profile_id);
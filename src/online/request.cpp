@@ -65,11 +65,50 @@ namespace Online
         prepareOperation();
         if (RequestManager::get()->getAbort() && isAbortable()) return;
         operation();
+        finishExecution();
+    }   // execute
+
+    // ------------------------------------------------------------------------
+    /** Starts executing the request in the RequestManager thread. The
+     *  transfer of a http request is added to the curl multi handle, all
+     *  other requests are executed completely.
+     *  \param multi The curl multi handle of the RequestManager.
+     *  \return True if the transfer is running in the multi handle, in which
+     *          case onTransferFinished must be called once it is done.
+     */
+    bool Request::startExecution(CURLM *multi)
+    {
+        assert(isBusy());
+        if (RequestManager::get()->getAbort() && isAbortable()) return false;
+        prepareOperation();
+        if (RequestManager::get()->getAbort() && isAbortable()) return false;
+        if (startTransfer(multi))
+            return true;
+        finishExecution();
+        return false;
+    }   // startExecution
+
+    // ------------------------------------------------------------------------
+    /** Finishes a request whose transfer was running in the multi handle.
+     *  \param code The curl result of the transfer.
+     */
+    void Request::onTransferFinished(CURLcode code)
+    {
+        transferFinished(code);
+        finishExecution();
+    }   // onTransferFinished
+
+    // ------------------------------------------------------------------------
+    /** Marks the request as executed and calls afterOperation, unless STK is
+     *  being aborted.
+     */
+    void Request::finishExecution()
+    {
         if (RequestManager::get()->getAbort() && isAbortable()) return;
         setExecuted();
         if (RequestManager::get()->getAbort() && isAbortable()) return;
         afterOperation();
-    }   // execute
+    }   // finishExecution
 
     // ------------------------------------------------------------------------
     /** Executes the request now, i.e. in the main thread and without involving
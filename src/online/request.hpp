@@ -127,6 +127,20 @@ namespace Online
         /** Virtual function to be called after an operation. */
         virtual void afterOperation()   {}
 
+        // --------------------------------------------------------------------
+        /** Starts the operation in the RequestManager thread. Requests that
+         *  download data add their transfer to the curl multi handle and
+         *  return true, so that several downloads can run at the same time.
+         *  The default executes the operation at once. */
+        virtual bool startTransfer(CURLM *multi) { operation(); return false; }
+
+        // --------------------------------------------------------------------
+        /** Called when the transfer started by startTransfer has finished.
+         *  \param code The curl result of the transfer. */
+        virtual void transferFinished(CURLcode code) {}
+
+        void         finishExecution();
+
     public:
         enum RequestType
         {
@@ -138,6 +152,8 @@ namespace Online
         void     execute();
         void     executeNow();
         void     queue();
+        bool     startExecution(CURLM *multi);
+        void     onTransferFinished(CURLcode code);
 
         // --------------------------------------------------------------------
         /** Executed when a request has finished. */
@@ -42,6 +42,9 @@ namespace Online
 {
     RequestManager * RequestManager::m_request_manager = NULL;
 
+    const int RequestManager::m_max_running[RequestManager::PC_COUNT] =
+        { 4, 4, 2 };
+
     // ------------------------------------------------------------------------
     /** Deletes the http manager.
      */
@@ -71,6 +74,10 @@ namespace Online
         m_game_polling_interval = 60;  // same for game polling
         m_time_since_poll       = m_menu_polling_interval;
         curl_global_init(CURL_GLOBAL_DEFAULT);
+        m_curl_multi = NULL;
+        m_curl_share = NULL;
+        for (int i = 0; i < PC_COUNT; i++)
+            m_num_running[i] = 0;
         pthread_cond_init(&m_cond_request, NULL);
         m_abort.setAtomic(false);
     }   // RequestManager
@@ -176,10 +183,36 @@ namespace Online
         m_request_queue.unlock();
     }   // addRequest
 
+    // ------------------------------------------------------------------------
+    /** Returns the priority class of a request, which limits how many
+     *  requests of similar priority can run at the same time.
+     */
+    RequestManager::PriorityClass
+                   RequestManager::getPriorityClass(const Online::Request *r)
+    {
+        if (r->getPriority() >= HTTP_MAX_PRIORITY)
+            return PC_HIGH;
+        return r->getPriority() <= 1 ? PC_LOW : PC_NORMAL;
+    }   // getPriorityClass
+
+    // ------------------------------------------------------------------------
+    /** Returns the number of requests whose transfer is running. */
+    int RequestManager::getNumRunning() const
+    {
+        int n = 0;
+        for (int i = 0; i < PC_COUNT; i++)
+            n += m_num_running[i];
+        return n;
+    }   // getNumRunning
+
     // ------------------------------------------------------------------------
     /** The actual main loop, which is started as a separate thread from the
-     *  constructor. After testing for a new server, fetching news, the list
-     *  of packages to download, it will wait for commands to be issued.
+     *  constructor. It starts the queued requests in order of priority, as
+     *  long as the limit of running requests of their priority class is not
+     *  reached, and runs their transfers. If no transfer is running it
+     *  waits for commands to be issued. Once the quit request is at the top
+     *  of the queue no more requests are started, and the loop exits when
+     *  the running requests are finished.
      *  \param obj: A pointer to this object, passed on by pthread_create
      */
     void *RequestManager::mainLoop(void *obj)
@@ -188,35 +221,63 @@ namespace Online
 
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
 
-        me->m_current_request = NULL;
+        me->m_curl_multi = curl_multi_init();
+#ifdef CURLPIPE_MULTIPLEX
+        curl_multi_setopt(me->m_curl_multi, CURLMOPT_PIPELINING,
+                          CURLPIPE_MULTIPLEX);
+#endif
+        me->m_curl_share = curl_share_init();
+        curl_share_setopt(me->m_curl_share, CURLSHOPT_SHARE,
+                          CURL_LOCK_DATA_DNS);
+        curl_share_setopt(me->m_curl_share, CURLSHOPT_SHARE,
+                          CURL_LOCK_DATA_SSL_SESSION);
+
+        bool quit = false;
         me->m_request_queue.lock();
-        while (me->m_request_queue.getData().empty() ||
-               me->m_request_queue.getData().top()->getType() != Request::RT_QUIT)
+        while (true)
         {
-            bool empty = me->m_request_queue.getData().empty();
-
-            // Wait in cond_wait for a request to arrive. The 'while' is necessary
-            // since "spurious wakeups from the pthread_cond_wait ... may occur"
-            // (pthread_cond_wait man page)!
-            while (empty)
+            // Start as many requests as allowed, in order of priority
+            while (!quit && !me->m_request_queue.getData().empty())
             {
-                pthread_cond_wait(&me->m_cond_request, me->m_request_queue.getMutex());
-                empty = me->m_request_queue.getData().empty();
+                Request *request = me->m_request_queue.getData().top();
+                if (request->getType() == Request::RT_QUIT)
+                {
+                    quit = true;
+                    break;
+                }
+                PriorityClass pc = getPriorityClass(request);
+                if (me->m_num_running[pc] >= m_max_running[pc])
+                    break;
+                me->m_request_queue.getData().pop();
+                me->m_request_queue.unlock();
+
+                if (request->startExecution(me->m_curl_multi))
+                    me->m_num_running[pc]++;
+                // This test is necessary in case that execute() was aborted
+                // (otherwise the assert in addResult will be triggered).
+                else if (!me->getAbort())
+                    me->addResult(request);
+                me->m_request_queue.lock();
             }
-            me->m_current_request = me->m_request_queue.getData().top();
-            me->m_request_queue.getData().pop();
 
-            if (me->m_current_request->getType() == Request::RT_QUIT)
+            if (me->getNumRunning() == 0)
             {
-                delete me->m_current_request;
-                break;
+                if (quit)
+                    break;
+                // Wait in cond_wait for a request to arrive. The 'while' is
+                // necessary since "spurious wakeups from the
+                // pthread_cond_wait ... may occur" (pthread_cond_wait man
+                // page)!
+                while (me->m_request_queue.getData().empty())
+                {
+                    pthread_cond_wait(&me->m_cond_request,
+                                      me->m_request_queue.getMutex());
+                }
+                continue;
             }
 
             me->m_request_queue.unlock();
-            me->m_current_request->execute();
-            // This test is necessary in case that execute() was aborted
-            // (otherwise the assert in addResult will be triggered).
-            if (!me->getAbort()) me->addResult(me->m_current_request);
+            me->handleTransfers();
             me->m_request_queue.lock();
         } // while handle all requests
 
@@ -236,11 +297,48 @@ namespace Online
             delete request;
         }
         me->m_request_queue.unlock();
+        curl_multi_cleanup(me->m_curl_multi);
+        curl_share_cleanup(me->m_curl_share);
         pthread_exit(NULL);
 
         return 0;
     }   // mainLoop
 
+    // ------------------------------------------------------------------------
+    /** Runs the transfers in the multi handle, and finishes the requests
+     *  whose transfer is done. Waits at most 100 ms for any activity, so that
+     *  new requests are started soon enough.
+     */
+    void RequestManager::handleTransfers()
+    {
+        int running = 0;
+        curl_multi_perform(m_curl_multi, &running);
+
+        CURLMsg *message;
+        int messages_left;
+        while ((message = curl_multi_info_read(m_curl_multi, &messages_left)))
+        {
+            if (message->msg != CURLMSG_DONE)
+                continue;
+            // The message is invalid once the handle is removed
+            CURL *session = message->easy_handle;
+            CURLcode code = message->data.result;
+            char *data = NULL;
+            curl_easy_getinfo(session, CURLINFO_PRIVATE, &data);
+            Request *request = (Request*)data;
+            curl_multi_remove_handle(m_curl_multi, session);
+
+            m_num_running[getPriorityClass(request)]--;
+            request->onTransferFinished(code);
+            // Aborted requests are not executed, see mainLoop
+            if (!getAbort())
+                addResult(request);
+        }
+
+        if (getNumRunning() > 0)
+            curl_multi_wait(m_curl_multi, NULL, 0, 100, NULL);
+    }   // handleTransfers
+
     // ------------------------------------------------------------------------
     /** Inserts a request into the queue of results.
      *  \param request The pointer to the request to insert.
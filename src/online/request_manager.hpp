@@ -45,7 +45,11 @@ namespace Online
      *  requests involve a http(s) requests to be sent to the stk server, and
      *  receive an answer (e.g. to sign in; or to download an addon). The
      *  requests are sorted by priority (e.g. sign in and out have higher
-     *  priority than downloading addon icons).
+     *  priority than downloading addon icons). The downloads are run by one
+     *  curl multi handle, so several requests are executed at the same time
+     *  and connections (including TLS sessions) to the servers are reused.
+     *  The number of requests running at the same time is limited for each
+     *  priority class, and requests are always started in priority order.
      *  A request is created and initialised from the main thread. When it
      *  is moved into the request queue, it must not be handled by the main
      *  thread anymore, only the RequestManager thread can handle it.
@@ -94,8 +98,28 @@ namespace Online
             /** Time passed since the last poll request. */
             float                     m_time_since_poll;
 
-            /** The current requested being worked on. */
-            Online::Request *         m_current_request;
+            /** Priority classes, each allows a limited number of requests
+             *  to run at the same time. */
+            enum PriorityClass
+            {
+                PC_LOW,      // Priority 1 or lower, e.g. addon icons
+                PC_NORMAL,   // e.g. sign in, achievements
+                PC_HIGH,     // HTTP_MAX_PRIORITY, e.g. sign out
+                PC_COUNT
+            };
+
+            /** Maximum number of running requests of each priority class. */
+            static const int m_max_running[PC_COUNT];
+
+            /** Number of requests of each priority class whose transfer is
+             *  running in the multi handle. */
+            int                       m_num_running[PC_COUNT];
+
+            /** The curl multi handle that runs all transfers. */
+            CURLM *                   m_curl_multi;
+
+            /** Shares DNS and TLS session caches between all transfers. */
+            CURLSH *                  m_curl_share;
 
             /** A conditional variable to wake up the main loop. */
             pthread_cond_t            m_cond_request;
@@ -128,6 +152,9 @@ namespace Online
 
             void addResult(Online::Request *request);
             void handleResultQueue();
+            void handleTransfers();
+            int  getNumRunning() const;
+            static PriorityClass getPriorityClass(const Online::Request *r);
 
             static void *mainLoop(void *obj);
 
@@ -160,6 +187,10 @@ namespace Online
             void stopNetworkThread();
 
             bool getAbort() { return m_abort.getAtomic(); }
+            // ----------------------------------------------------------------
+            /** Returns the curl share handle all transfers of the manager
+             *  thread use. */
+            CURLSH *getCurlShare() { return m_curl_share; }
             void update(float dt);
 
             // ----------------------------------------------------------------
@@ -21,6 +21,7 @@
 #include <string>
 #include <irrString.h>
 #include <assert.h>
+#include <set>
 #include "config/user_config.hpp"
 #include "utils/translation.hpp"
 #include "utils/time.hpp"
@@ -86,7 +87,11 @@ namespace Online
         return request;
     }
 
-    void ServersManager::refresh(bool success, const XMLNode * input)
+    /** Merges a downloaded server list into the cached servers.
+     *  \param servers The downloaded servers, which are either taken over
+     *         by the manager or deleted. The vector is cleared.
+     */
+    void ServersManager::refresh(bool success, std::vector<Server*> *servers)
     {
         if (!success)
         {
@@ -94,27 +99,100 @@ namespace Online
             return;
         }
 
-        const XMLNode * servers_xml = input->getNode("servers");
-        cleanUpServers();
-        for (unsigned int i = 0; i < servers_xml->getNumNodes(); i++)
+        // Update the cached servers in place, so that the list doesn't have
+        // to be rebuilt and servers that are still listed keep their address
+        m_sorted_servers.lock();
+        m_mapped_servers.lock();
+        PtrVector<Server> &sorted = m_sorted_servers.getData();
+        std::map<uint32_t, Server*> &mapped = m_mapped_servers.getData();
+        std::set<uint32_t> listed;
+        for (unsigned int i = 0; i < servers->size(); i++)
+        {
+            Server *server = (*servers)[i];
+            listed.insert(server->getServerId());
+            std::map<uint32_t, Server*>::iterator it =
+                mapped.find(server->getServerId());
+            if (it == mapped.end())
+            {
+                sorted.push_back(server);
+                mapped[server->getServerId()] = server;
+            }
+            else
+            {
+                *it->second = *server;
+                delete server;
+            }
+        }
+
+        // Remove the servers that are not listed anymore
+        std::map<uint32_t, Server*>::iterator it = mapped.begin();
+        while (it != mapped.end())
         {
-            addServer(new Server(*servers_xml->getNode(i)));
+            if (listed.count(it->first))
+            {
+                it++;
+                continue;
+            }
+            sorted.erase((void*)it->second);
+            mapped.erase(it++);
         }
+        m_mapped_servers.unlock();
+        m_sorted_servers.unlock();
+        servers->clear();
         m_last_load_time.setAtomic((float)StkTime::getRealTime());
     }
 
+    // ------------------------------------------------------------------------
+    ServersManager::RefreshRequest::~RefreshRequest()
+    {
+        for (unsigned int i = 0; i < m_servers.size(); i++)
+            delete m_servers[i];
+    }   // ~RefreshRequest
+
+    // ------------------------------------------------------------------------
+    /** Called in the request thread after the list was downloaded, creates
+     *  the servers from the XML answer. */
+    void ServersManager::RefreshRequest::afterOperation()
+    {
+        XMLRequest::afterOperation();
+        if (!isSuccess())
+            return;
+        const XMLNode * servers_xml = getXMLData()->getNode("servers");
+        if (!servers_xml)
+            return;
+        m_servers.reserve(servers_xml->getNumNodes());
+        for (unsigned int i = 0; i < servers_xml->getNumNodes(); i++)
+            m_servers.push_back(new Server(*servers_xml->getNode(i)));
+    }   // afterOperation
+
+    // ------------------------------------------------------------------------
     void ServersManager::RefreshRequest::callback()
     {
-        ServersManager::get()->refresh(isSuccess(), getXMLData());
+        ServersManager::get()->refresh(isSuccess(), &m_servers);
     }
 
     // ============================================================================
+    /** Returns the server with the most players that still has a free slot,
+     *  or the first server if all are full.
+     */
     const Server * ServersManager::getQuickPlay() const
     {
-        if(m_sorted_servers.getData().size() > 0)
-            return getServerBySort(0);
+        MutexLocker(m_sorted_servers);
+        const PtrVector<Server> &servers = m_sorted_servers.getData();
+        if (servers.size() == 0)
+            return NULL;
 
-        return NULL;
+        const Server *best = NULL;
+        for (unsigned int i = 0; i < servers.size(); i++)
+        {
+            const Server *server = servers.get(i);
+            if (server->getCurrentPlayers() >= server->getMaxPlayers())
+                continue;
+            if (!best ||
+                server->getCurrentPlayers() > best->getCurrentPlayers())
+                best = server;
+        }
+        return best ? best : servers.get(0);
     }
 
     // ============================================================================
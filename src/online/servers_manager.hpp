@@ -24,8 +24,11 @@
 #include "online/server.hpp"
 #include "online/request_manager.hpp"
 #include "online/xml_request.hpp"
+#include "utils/cpp2011.hpp"
 #include "utils/synchronised.hpp"
 
+#include <vector>
+
 namespace Online
 {
     /**
@@ -36,11 +39,19 @@ namespace Online
     {
     public:
 
+        /** Downloads the server list. The servers are created in the request
+         *  thread, so that the main thread only has to merge them into the
+         *  list. */
         class RefreshRequest : public XMLRequest
         {
+            /** The listed servers, owned by the request until merged. */
+            std::vector<Server*> m_servers;
+
+            virtual void afterOperation() OVERRIDE;
             virtual void callback ();
         public:
             RefreshRequest() : XMLRequest() {}
+            ~RefreshRequest();
         };
 
     private:
@@ -56,7 +67,7 @@ namespace Online
         Synchronised<Server *>                          m_joined_server;
 
         Synchronised<float>                             m_last_load_time;
-        void                                            refresh(bool success, const XMLNode * input);
+        void                                            refresh(bool success, std::vector<Server*> *servers);
         void                                            cleanUpServers();
 
     public:
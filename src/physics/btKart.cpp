@@ -444,7 +444,7 @@ void btKart::updateVehicle( btScalar step )
         btVector3 terrain_up(0,1,0);
         btVector3 axis = kart_up.cross(terrain_up);
         // Give a nicely balanced feeling for rebalancing the kart
-        m_chassisBody->applyTorqueImpulse(axis * m_kart->getKartProperties()->getSmoothFlyingImpulse());
+        m_chassisBody->applyTorqueImpulse(axis * m_kart->getPhysicsConstants().m_smooth_flying_impulse);
     }
     
     // Work around: make sure that either both wheels on one axis
@@ -538,7 +538,7 @@ void btKart::updateVehicle( btScalar step )
 
     // If configured, add a force to keep karts on the track
     // -----------------------------------------------------
-    float dif = m_kart->getKartProperties()->getDownwardImpulseFactor();
+    float dif = m_kart->getPhysicsConstants().m_downward_impulse_factor;
     if(dif!=0 && m_num_wheels_on_ground==4)
     {
         float f = -fabsf(m_kart->getSpeed()) * dif;
@@ -637,6 +637,10 @@ void btKart::updateSuspension(btScalar deltaTime)
     (void)deltaTime;
 
     btScalar chassisMass = btScalar(1.) / m_chassisBody->getInvMass();
+    const bool exp_spring_response =
+        m_kart->getPhysicsConstants().m_exp_spring_response;
+    const btScalar track_connection_force =
+        -m_kart->getPhysicsConstants().m_track_connection_accel * chassisMass;
 
     for (int w_it=0; w_it<getNumWheels(); w_it++)
     {
@@ -649,9 +653,7 @@ void btKart::updateSuspension(btScalar deltaTime)
             // a force pulling the axis down (towards the ground). Note that it
             // is already guaranteed that either both or no wheels on one axis
             // are on the ground, so we have to test only one of the wheels
-            wheel_info.m_wheelsSuspensionForce =
-                 -m_kart->getKartProperties()->getTrackConnectionAccel()
-                * chassisMass;
+            wheel_info.m_wheelsSuspensionForce = track_connection_force;
             continue;
         }
 
@@ -661,7 +663,7 @@ void btKart::updateSuspension(btScalar deltaTime)
         btScalar susp_length    = wheel_info.getSuspensionRestLength();
         btScalar current_length = wheel_info.m_raycastInfo.m_suspensionLength;
         btScalar length_diff    = (susp_length - current_length);
-        if(m_kart->getKartProperties()->getExpSpringResponse())
+        if(exp_spring_response)
             length_diff *= fabsf(length_diff)/susp_length;
         float f = (1.0f + fabsf(length_diff) / susp_length);
         // Scale the length diff. This results that in uphill sections, when
@@ -690,6 +692,55 @@ void btKart::updateSuspension(btScalar deltaTime)
 
 }   // updateSuspension
 
+// ----------------------------------------------------------------------------
+/** Returns true if a ground object can't move and isn't moving: its inverse
+ *  mass and inertia are zero and it has no velocity. All terms of such a
+ *  body in the friction computations are exactly zero, so they can be
+ *  skipped without changing any result.
+ */
+static inline bool isStaticGround(const btRigidBody *body)
+{
+    return body->getInvMass() == btScalar(0.)                      &&
+           body->getInvInertiaDiagLocal().isZero()                 &&
+           body->getLinearVelocity().isZero()                      &&
+           body->getAngularVelocity().isZero();
+}   // isStaticGround
+
+// ----------------------------------------------------------------------------
+/** Computes the side impulse of a wheel standing on static ground. This is
+ *  resolveSingleBilateral with all terms of the ground body dropped (they
+ *  are all exactly zero), without the relative velocity along the jacobian
+ *  which resolveSingleBilateral computes and then discards, and with the
+ *  transposed chassis basis computed only once per kart.
+ *  \param chassis The chassis body.
+ *  \param world2chassis The transposed basis of the chassis.
+ *  \param pos Contact point of the wheel.
+ *  \param normal Axle of the wheel, the direction of the impulse.
+ */
+static inline btScalar resolveStaticBilateral(const btRigidBody &chassis,
+                                             const btMatrix3x3 &world2chassis,
+                                             const btVector3 &pos,
+                                             const btVector3 &normal)
+{
+    btScalar normalLenSqr = normal.length2();
+    btAssert(btFabs(normalLenSqr) < btScalar(1.1));
+    if (normalLenSqr > btScalar(1.1))
+        return btScalar(0.);
+
+    btVector3 rel_pos1 = pos - chassis.getCenterOfMassPosition();
+    btVector3 vel      = chassis.getVelocityInLocalPoint(rel_pos1);
+
+    btVector3 aJ       = world2chassis * rel_pos1.cross(normal);
+    btVector3 MinvJt   = chassis.getInvInertiaDiagLocal() * aJ;
+    btScalar jacDiagAB = chassis.getInvMass() + MinvJt.dot(aJ);
+    btAssert(jacDiagAB > btScalar(0.0));
+    btScalar jacDiagABInv = btScalar(1.) / jacDiagAB;
+
+    btScalar rel_vel = normal.dot(vel);
+    btScalar contactDamping = btScalar(0.2);
+    return -contactDamping * rel_vel * jacDiagABInv;
+}   // resolveStaticBilateral
+
 // ----------------------------------------------------------------------------
 struct btWheelContactPoint
 {
@@ -699,23 +750,31 @@ struct btWheelContactPoint
     btVector3    m_frictionDirectionWorld;
     btScalar     m_jacDiagABInv;
     btScalar     m_maxImpulse;
+    /** True if body1 is static ground, see isStaticGround. */
+    bool         m_body1_static;
 
 
     btWheelContactPoint(btRigidBody* body0, btRigidBody* body1,
                         const btVector3& frictionPosWorld,
                         const btVector3& frictionDirectionWorld,
-                        btScalar maxImpulse)
+                        btScalar maxImpulse, bool body1_static)
         :m_body0(body0),
          m_body1(body1),
          m_frictionPositionWorld(frictionPosWorld),
          m_frictionDirectionWorld(frictionDirectionWorld),
-         m_maxImpulse(maxImpulse)
+         m_maxImpulse(maxImpulse),
+         m_body1_static(body1_static)
     {
         btScalar denom0 = body0->computeImpulseDenominator(frictionPosWorld,
                                                        frictionDirectionWorld);
+        btScalar relaxation = 1.f;
+        if(m_body1_static)
+        {
+            m_jacDiagABInv = relaxation/denom0;
+            return;
+        }
         btScalar denom1 = body1->computeImpulseDenominator(frictionPosWorld,
                                                        frictionDirectionWorld);
-        btScalar relaxation = 1.f;
         m_jacDiagABInv = relaxation/(denom0+denom1);
     }
 
@@ -731,14 +790,17 @@ btScalar btKart::calcRollingFriction(btWheelContactPoint& contactPoint)
 
     btVector3 rel_pos1 = contactPosWorld
                        - contactPoint.m_body0->getCenterOfMassPosition();
-    btVector3 rel_pos2 = contactPosWorld
-                       - contactPoint.m_body1->getCenterOfMassPosition();
 
     btScalar maxImpulse  = contactPoint.m_maxImpulse;
 
-    btVector3 vel1 = contactPoint.m_body0->getVelocityInLocalPoint(rel_pos1);
-    btVector3 vel2 = contactPoint.m_body1->getVelocityInLocalPoint(rel_pos2);
-    btVector3 vel = vel1 - vel2;
+    btVector3 vel = contactPoint.m_body0->getVelocityInLocalPoint(rel_pos1);
+    // The velocity of static ground is zero
+    if(!contactPoint.m_body1_static)
+    {
+        btVector3 rel_pos2 = contactPosWorld
+                           - contactPoint.m_body1->getCenterOfMassPosition();
+        vel -= contactPoint.m_body1->getVelocityInLocalPoint(rel_pos2);
+    }
 
     btScalar vrel = contactPoint.m_frictionDirectionWorld.dot(vel);
 
@@ -754,6 +816,13 @@ btScalar btKart::calcRollingFriction(btWheelContactPoint& contactPoint)
 
 void btKart::updateFriction(btScalar timeStep)
 {
+    // Most wheels are on the static track, for which the ground terms
+    // of the friction computations can be skipped
+    bool ground_static[4];
+    btAssert(getNumWheels() <= 4);
+    const btMatrix3x3 world2chassis =
+        m_chassisBody->getCenterOfMassTransform().getBasis().transpose();
+
     //calculate the impulse, so that the wheels don't move sidewards
     for (int i=0;i<getNumWheels();i++)
     {
@@ -764,6 +833,7 @@ void btKart::updateFriction(btScalar timeStep)
             (btRigidBody*) wheelInfo.m_raycastInfo.m_groundObject;
 
         if(!groundObject) continue;
+        ground_static[i] = isStaticGround(groundObject);
         const btTransform& wheelTrans = getWheelTransformWS( i );
 
         btMatrix3x3 wheelBasis0 = wheelTrans.getBasis();
@@ -780,12 +850,22 @@ void btKart::updateFriction(btScalar timeStep)
         m_forwardWS[i] = surfNormalWS.cross(m_axle[i]);
         m_forwardWS[i].normalize();
 
-        resolveSingleBilateral(*m_chassisBody,
-                               wheelInfo.m_raycastInfo.m_contactPointWS,
-                               *groundObject,
-                               wheelInfo.m_raycastInfo.m_contactPointWS,
-                               btScalar(0.), m_axle[i],m_sideImpulse[i],
-                               timeStep);
+        if(ground_static[i])
+        {
+            m_sideImpulse[i] = resolveStaticBilateral(*m_chassisBody,
+                                      world2chassis,
+                                      wheelInfo.m_raycastInfo.m_contactPointWS,
+                                      m_axle[i]);
+        }
+        else
+        {
+            resolveSingleBilateral(*m_chassisBody,
+                                   wheelInfo.m_raycastInfo.m_contactPointWS,
+                                   *groundObject,
+                                   wheelInfo.m_raycastInfo.m_contactPointWS,
+                                   btScalar(0.), m_axle[i],m_sideImpulse[i],
+                                   timeStep);
+        }
 
         btScalar sideFrictionStiffness2 = btScalar(1.0);
         m_sideImpulse[i] *= sideFrictionStiffness2;
@@ -835,7 +915,8 @@ void btKart::updateFriction(btScalar timeStep)
                                     : defaultRollingFrictionImpulse;
                 btWheelContactPoint contactPt(m_chassisBody, groundObject,
                                      wheelInfo.m_raycastInfo.m_contactPointWS,
-                                     m_forwardWS[wheel],maxImpulse);
+                                     m_forwardWS[wheel],maxImpulse,
+                                     ground_static[wheel]);
                 rollingFriction = calcRollingFriction(contactPt);
                 // This is a work around for the problem that a kart shakes
                 // if it is braking: we get a minor impulse forward, which
@@ -29,6 +29,7 @@
 IrrDebugDrawer::IrrDebugDrawer()
 {
     m_debug_mode = DM_NONE;
+    m_vertices.reserve(RESERVED_VERTICES);
 }   // IrrDebugDrawer
 
 // -----------------------------------------------------------------------------
@@ -58,35 +59,44 @@ void IrrDebugDrawer::setDebugMode(DebugModeType mode)
 void IrrDebugDrawer::drawLine(const btVector3& from, const btVector3& to,
                               const btVector3& color)
 {
-    video::SColor c(255, (int)(color.getX()*255), (int)(color.getY()*255),
-                         (int)(color.getZ()*255)                          );
+    const core::vector3df start(from.getX(), from.getY(), from.getZ());
+    const core::vector3df end(to.getX(), to.getY(), to.getZ());
 
-    //World::getWorld()->getCa
-
-    if (from.distance2(m_camera_pos) > 10000) return;
+    // Discard the line if both ends are outside of the same frustum plane
+    for (unsigned i = 0; i < scene::SViewFrustum::VF_PLANE_COUNT; i++)
+    {
+        const core::plane3df &plane = m_frustum.planes[i];
+        if (plane.classifyPointRelation(start) == core::ISREL3D_FRONT &&
+            plane.classifyPointRelation(end)   == core::ISREL3D_FRONT)
+            return;
+    }
 
-    std::vector<float>& v = m_lines[c];
-    v.push_back(from.getX());
-    v.push_back(from.getY());
-    v.push_back(from.getZ());
-    v.push_back(to.getX());
-    v.push_back(to.getY());
-    v.push_back(to.getZ());
-    //draw3DLine((const core::vector3df&)from, (const core::vector3df&)to, c);
-}
+    video::SColor c(255, (int)(color.getX()*255), (int)(color.getY()*255),
+                         (int)(color.getZ()*255)                          );
+    LineVertex v;
+    v.m_color = c;
+    v.m_position[0] = start.X;
+    v.m_position[1] = start.Y;
+    v.m_position[2] = start.Z;
+    m_vertices.push_back(v);
+    v.m_position[0] = end.X;
+    v.m_position[1] = end.Y;
+    v.m_position[2] = end.Z;
+    m_vertices.push_back(v);
+}   // drawLine
 
 // -----------------------------------------------------------------------------
-
+/** Removes the lines of the previous camera, and takes the frustum of the
+ *  active camera to cull the next lines against. Called before bullet
+ *  draws the world for a camera.
+ */
 void IrrDebugDrawer::beginNextFrame()
 {
-    for (std::map<video::SColor, std::vector<float> >::iterator it = m_lines.begin(); it != m_lines.end(); it++)
-    {
-        it->second.clear();
-    }
+    m_vertices.clear();
 
     scene::ICameraSceneNode* camera = irr_driver->getSceneManager()->getActiveCamera();
-    m_camera_pos = camera->getPosition();
-}
+    m_frustum = *camera->getViewFrustum();
+}   // beginNextFrame
 
 /* EOF */
 
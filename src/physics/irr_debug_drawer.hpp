@@ -22,8 +22,8 @@
 #include "btBulletDynamicsCommon.h"
 
 #include <SColor.h>
+#include <SViewFrustum.h>
 #include "utils/vec3.hpp"
-#include <map>
 #include <vector>
 
 /**
@@ -42,9 +42,24 @@ public:
                                   };
     DebugModeType   m_debug_mode;
 
-    std::map<video::SColor, std::vector<float> > m_lines;
+    /** One end of a line, as stored in the vertex buffer. */
+    struct LineVertex
+    {
+        float         m_position[3];
+        video::SColor m_color;
+    };   // LineVertex
 
-    Vec3 m_camera_pos;
+private:
+    /** Number of line vertices reserved up front, so that the buffer
+     *  doesn't have to grow while bullet draws a big track. */
+    static const unsigned   RESERVED_VERTICES = 1 << 18;
+
+    /** All lines of the current camera, two vertices per line. */
+    std::vector<LineVertex> m_vertices;
+
+    /** Frustum of the camera the lines are drawn for, lines completely
+     *  outside of it are discarded. */
+    scene::SViewFrustum     m_frustum;
 
 protected:
     virtual void    setDebugMode(int debug_mode) {}
@@ -75,7 +90,8 @@ public:
     void            setDebugMode(DebugModeType mode);
 
     void            beginNextFrame();
-    const std::map<video::SColor, std::vector<float> >& getLines() const { return m_lines; }
+    /** Returns the vertices of the lines to draw, two per line. */
+    const std::vector<LineVertex>& getLines() const { return m_vertices; }
 };   // IrrDebugDrawer
 
 #endif
@@ -27,8 +27,12 @@ using namespace irr;
 #include "graphics/mesh_tools.hpp"
 #include "io/file_manager.hpp"
 #include "io/xml_node.hpp"
+#include "items/flyable.hpp"
+#include "items/projectile_manager.hpp"
+#include "karts/abstract_kart.hpp"
 #include "modes/world.hpp"
 #include "physics/physics.hpp"
+#include "physics/stk_dynamics_world.hpp"
 #include "physics/triangle_mesh.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_object.hpp"
@@ -117,6 +121,8 @@ PhysicalObject::PhysicalObject(bool is_dynamic,
 {
     m_shape              = NULL;
     m_body               = NULL;
+    m_kinematic_active   = false;
+    m_activation_radius  = 0.0f;
     m_motion_state       = NULL;
     m_reset_when_too_low = false;
     m_reset_height       = 0;
@@ -144,6 +150,12 @@ PhysicalObject::PhysicalObject(bool is_dynamic,
     m_reset_height       = settings.m_reset_height;
     m_on_kart_collision  = settings.m_on_kart_collision;
     m_on_item_collision  = settings.m_on_item_collision;
+    if (m_on_kart_collision.size() > 0)
+        m_on_kart_collision_function.setDeclaration(
+                     "void " + m_on_kart_collision + "(int, const string)");
+    if (m_on_item_collision.size() > 0)
+        m_on_item_collision_function.setDeclaration(
+                "void " + m_on_item_collision + "(int, int, const string)");
 
     m_init_pos.setIdentity();
     Vec3 radHpr(m_init_hpr);
@@ -181,6 +193,16 @@ PhysicalObject::~PhysicalObject()
 
 // ----------------------------------------------------------------------------
 
+const float PhysicalObject::ACTIVATION_MARGIN = 30.0f;
+
+// ----------------------------------------------------------------------------
+/** Moves the body to a new position, called when the track object is
+ *  animated. A kinematic body is only moved while a kart or flyable is
+ *  close to it, otherwise it is put to sleep and left where it is, so that
+ *  bullet neither updates its bounding box nor its kinematic state.
+ *  \param xyz New position of the object.
+ *  \param hpr New rotation of the object in degrees.
+ */
 void PhysicalObject::move(const Vec3& xyz, const core::vector3df& hpr)
 {
     Vec3 hpr2(hpr);
@@ -194,9 +216,54 @@ void PhysicalObject::move(const Vec3& xyz, const core::vector3df& hpr)
     q = btQuaternion(tempQuat.X, tempQuat.Y, tempQuat.Z, tempQuat.W);
 
     btTransform trans(q, xyz-quatRotate(q,m_graphical_offset));
+    if (!m_is_dynamic)
+    {
+        if (!isNearKartOrFlyable(trans.getOrigin()))
+        {
+            if (m_kinematic_active)
+            {
+                m_body->forceActivationState(ISLAND_SLEEPING);
+                m_kinematic_active = false;
+            }
+            return;
+        }
+        if (!m_kinematic_active)
+        {
+            // Jump to the current position instead of letting bullet
+            // compute a huge velocity from the old position.
+            m_body->setWorldTransform(trans);
+            m_body->setInterpolationWorldTransform(trans);
+            m_body->forceActivationState(DISABLE_DEACTIVATION);
+            m_kinematic_active = true;
+        }
+    }
     m_motion_state->setWorldTransform(trans);
 }   // move
 
+// ----------------------------------------------------------------------------
+/** Returns true if a kart or a flyable is within the activation radius
+ *  of a position of this object.
+ *  \param xyz The position of the body.
+ */
+bool PhysicalObject::isNearKartOrFlyable(const Vec3 &xyz) const
+{
+    const float radius2 = m_activation_radius*m_activation_radius;
+    World *world = World::getWorld();
+    for (unsigned int i = 0; i < world->getNumKarts(); i++)
+    {
+        if ((world->getKart(i)->getXYZ() - xyz).length2() < radius2)
+            return true;
+    }
+    const std::vector<Flyable*> &flyables =
+                                     projectile_manager->getActiveProjectiles();
+    for (unsigned int i = 0; i < flyables.size(); i++)
+    {
+        if ((flyables[i]->getXYZ() - xyz).length2() < radius2)
+            return true;
+    }
+    return false;
+}   // isNearKartOrFlyable
+
 // ----------------------------------------------------------------------------
 /** Additional initialisation after loading of the model is finished.
  */
@@ -479,7 +546,14 @@ void PhysicalObject::init()
     {
         m_body->setCollisionFlags(   m_body->getCollisionFlags()
                                    | btCollisionObject::CF_KINEMATIC_OBJECT);
-        m_body->setActivationState(DISABLE_DEACTIVATION);
+        // Kinematic bodies sleep until they are animated close to a kart
+        // (see move), so that static props cost nothing per physics step.
+        // Active karts still collide with sleeping bodies.
+        m_body->forceActivationState(ISLAND_SLEEPING);
+        m_kinematic_active = false;
+        btVector3 center;
+        m_shape->getBoundingSphere(center, m_activation_radius);
+        m_activation_radius += center.length() + ACTIVATION_MARGIN;
     }
 
     World::getWorld()->getPhysics()->addBody(m_body);
@@ -552,6 +626,10 @@ void PhysicalObject::reset()
     m_body->setAngularVelocity(btVector3(0,0,0));
     m_body->setLinearVelocity(btVector3(0,0,0));
     m_body->activate();
+    // The bounding box of a sleeping body is not updated by bullet
+    if (!m_is_dynamic && !m_kinematic_active)
+        World::getWorld()->getPhysics()->getPhysicsWorld()
+                         ->updateSingleAabb(m_body);
 }   // reset
 
 // ----------------------------------------------------------------------------
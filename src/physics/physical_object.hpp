@@ -24,6 +24,7 @@
 #include "btBulletDynamicsCommon.h"
 
 #include "physics/user_pointer.hpp"
+#include "scriptengine/script_function.hpp"
 #include "utils/vec3.hpp"
 #include "utils/leak_check.hpp"
 
@@ -156,11 +157,29 @@ private:
     * when a (flyable) item collides with this object
     */
     std::string           m_on_item_collision;
+    /** The functions called on kart and item collisions, looked up only
+     *  once. */
+    Scripting::ScriptFunction m_on_kart_collision_function;
+    Scripting::ScriptFunction m_on_item_collision_function;
     /** If this body is a bullet dynamic body, i.e. affected by physics
      *  or not (static (not moving) or kinematic (animated outside
      *  of physics). */
     bool                  m_is_dynamic;
 
+    /** For kinematic bodies: true if the body is kept awake and follows
+     *  the animation, false while it sleeps because no kart or flyable
+     *  is close. */
+    bool                  m_kinematic_active;
+
+    /** Distance from the origin of the body within which a kart or
+     *  flyable keeps a kinematic body awake. */
+    float                 m_activation_radius;
+
+    /** The margin added to the size of the body to get the activation
+     *  radius. Karts and flyables cover much less than this in a time
+     *  step. */
+    static const float    ACTIVATION_MARGIN;
+
     /** Non-null only if the shape is exact */
     TriangleMesh         *m_triangle_mesh;
 
@@ -177,6 +196,7 @@ public:
     void         update         (float dt);
     void         init           ();
     void         move           (const Vec3& xyz, const core::vector3df& hpr);
+    bool         isNearKartOrFlyable(const Vec3 &xyz) const;
     void         hit            (const Material *m, const Vec3 &normal);
     bool         isSoccerBall   () const;
     bool castRay(const btVector3 &from,
@@ -196,6 +216,9 @@ public:
      *  hits it. */
     bool isCrashReset() const { return m_crash_reset; }
     // ------------------------------------------------------------------------
+    /** Returns true if the object is moved by the physics. */
+    bool isDynamic() const { return m_is_dynamic; }
+    // ------------------------------------------------------------------------
     /** Returns true if this object should cause an explosion if a kart hits
      *  it. */
     bool isExplodeKartObject () const { return m_explode_kart; }
@@ -213,6 +236,21 @@ public:
     // ------------------------------------------------------------------------
     const std::string& getOnItemCollisionFunction() const { return m_on_item_collision; }
     // ------------------------------------------------------------------------
+    /** Returns the script function "void f(int kart_id, const string id)"
+     *  called when a kart hits this object. */
+    Scripting::ScriptFunction* getOnKartCollisionScript()
+    {
+        return &m_on_kart_collision_function;
+    }   // getOnKartCollisionScript
+    // ------------------------------------------------------------------------
+    /** Returns the script function
+     *  "void f(int item_type, int owner_id, const string id)" called when a
+     *  flyable hits this object. */
+    Scripting::ScriptFunction* getOnItemCollisionScript()
+    {
+        return &m_on_item_collision_function;
+    }   // getOnItemCollisionScript
+    // ------------------------------------------------------------------------
     // Methods usable by scripts
 
     /**
@@ -29,6 +29,7 @@
 #include "karts/kart_properties.hpp"
 #include "karts/rescue_animation.hpp"
 #include "karts/controller/player_controller.hpp"
+#include "main_loop.hpp"
 #include "modes/soccer_world.hpp"
 #include "modes/world.hpp"
 #include "karts/explosion_animation.hpp"
@@ -41,6 +42,7 @@
 #include "scriptengine/script_engine.hpp"
 #include "tracks/track.hpp"
 #include "utils/profiler.hpp"
+#include "utils/worker_pool.hpp"
 
 // ----------------------------------------------------------------------------
 /** Initialise physics.
@@ -50,19 +52,30 @@ Physics::Physics() : btSequentialImpulseConstraintSolver()
 {
     m_collision_conf      = new btDefaultCollisionConfiguration();
     m_dispatcher          = new btCollisionDispatcher(m_collision_conf);
+    m_kart_kart_collision_function.setDeclaration(
+                                        "void onKartKartCollision(int, int)");
 }   // Physics
 
 //-----------------------------------------------------------------------------
 /** The actual initialisation of the physics, which is called after the track
  *  model is loaded. This allows the physics to use the actual track dimension
  *  for the axis sweep.
+ *  \param world_min, world_max The AABB of the track.
+ *  \param dynamic_broadphase If true a dynamic AABB tree is used as
+ *         broadphase instead of an axis sweep. This is faster on tracks with
+ *         large extents (where the quantised axis sweep gets imprecise) or
+ *         many moving objects.
  */
-void Physics::init(const Vec3 &world_min, const Vec3 &world_max)
+void Physics::init(const Vec3 &world_min, const Vec3 &world_max,
+                   bool dynamic_broadphase)
 {
     m_physics_loop_active = false;
-    m_axis_sweep          = new btAxisSweep3(world_min, world_max);
+    if(dynamic_broadphase)
+        m_broadphase      = new btDbvtBroadphase();
+    else
+        m_broadphase      = new btAxisSweep3(world_min, world_max);
     m_dynamics_world      = new STKDynamicsWorld(m_dispatcher,
-                                                 m_axis_sweep,
+                                                 m_broadphase,
                                                  this,
                                                  m_collision_conf);
     m_karts_to_delete.clear();
@@ -79,7 +92,7 @@ Physics::~Physics()
 {
     delete m_debug_drawer;
     delete m_dynamics_world;
-    delete m_axis_sweep;
+    delete m_broadphase;
     delete m_dispatcher;
     delete m_collision_conf;
 }   // ~Physics
@@ -100,10 +113,90 @@ void Physics::addKart(const AbstractKart *kart)
         if(btRigidBody::upcast(all_objs[i])== kart->getBody())
             return;
     }
-    m_dynamics_world->addRigidBody(kart->getBody());
+    addBody(kart->getBody());
     m_dynamics_world->addVehicle(kart->getVehicle());
 }   // addKart
 
+// ----------------------------------------------------------------------------
+/** Collision groups of the bodies. Bullet's predefined filter bits are not
+ *  used, except that all masks contain btBroadphaseProxy::DefaultFilter so
+ *  that ray and sweep tests with the default filter still find every
+ *  object.
+ */
+enum CollisionGroup
+{
+    CG_KART           = 1 << 6,
+    CG_FLYABLE        = 1 << 7,
+    CG_TRACK          = 1 << 8,
+    CG_OBJECT         = 1 << 9,
+    CG_STATIC_OBJECT  = 1 << 10,
+    CG_ANIMATION      = 1 << 11,
+    CG_STATIC         = CG_TRACK | CG_STATIC_OBJECT | CG_ANIMATION,
+    CG_ALL            = CG_KART  | CG_FLYABLE | CG_OBJECT | CG_STATIC
+};   // CollisionGroup
+
+// ----------------------------------------------------------------------------
+/** Determines collision group and mask of a body from its user pointer, so
+ *  that pairs which are not handled by collectCollisions and don't need a
+ *  contact response never reach the narrowphase. Static and kinematic
+ *  bodies (including the rubber ball) never collide with each other.
+ *  Bodies without a user pointer collide with everything.
+ *  \param body The body to add to the world.
+ *  \param group On return the collision group of the body.
+ *  \param mask On return the groups this body collides with.
+ */
+void Physics::getCollisionFilter(const btRigidBody *body, short *group,
+                                 short *mask)
+{
+    const UserPointer *up = (const UserPointer*)body->getUserPointer();
+    const bool is_static = body->isStaticOrKinematicObject();
+    if(!up || up->is(UserPointer::UP_UNDEF))
+    {
+        *group = is_static ? CG_STATIC_OBJECT : CG_OBJECT;
+        *mask  = CG_ALL;
+    }
+    else if(up->is(UserPointer::UP_KART))
+    {
+        *group = CG_KART;
+        *mask  = CG_ALL;
+    }
+    else if(up->is(UserPointer::UP_FLYABLE))
+    {
+        *group = CG_FLYABLE;
+        *mask  = CG_ALL;
+    }
+    else if(up->is(UserPointer::UP_TRACK))
+    {
+        *group = CG_TRACK;
+        *mask  = CG_KART | CG_FLYABLE | CG_OBJECT;
+    }
+    else if(up->is(UserPointer::UP_ANIMATION))
+    {
+        *group = CG_ANIMATION;
+        *mask  = CG_KART | CG_FLYABLE | CG_OBJECT;
+    }
+    else   // UP_PHYSICAL_OBJECT
+    {
+        *group = is_static ? CG_STATIC_OBJECT : CG_OBJECT;
+        *mask  = CG_ALL;
+    }
+    if(is_static)
+        *mask &= ~CG_STATIC;
+    *mask |= btBroadphaseProxy::DefaultFilter;
+}   // getCollisionFilter
+
+// ----------------------------------------------------------------------------
+/** Adds a body to the physics world, using the collision group and mask of
+ *  its type. The user pointer of the body must be set before it is added.
+ *  \param body The body to add.
+ */
+void Physics::addBody(btRigidBody *body)
+{
+    short group, mask;
+    getCollisionFilter(body, &group, &mask);
+    m_dynamics_world->addRigidBody(body, group, mask);
+}   // addBody
+
 //-----------------------------------------------------------------------------
 /** Removes a kart from the physics engine. This is used when rescuing a kart
  *  (and during cleanup).
@@ -149,14 +242,48 @@ void Physics::update(float dt)
     // of objects.
     m_all_collisions.clear();
 
-    // Maximum of three substeps. This will work for framerate down to
-    // 20 FPS (bullet default frequency is 60 HZ).
-    m_dynamics_world->stepSimulation(dt, 3);
+    // With a fixed time step do exactly one bullet step per tick (a
+    // maximum of 0 substeps makes bullet use dt as time step, without
+    // interpolating the motion states). Otherwise use a maximum of three
+    // substeps. This will work for framerate down to 20 FPS (bullet
+    // default frequency is 60 HZ).
+    if (main_loop && main_loop->isFixedTimeStep())
+        m_dynamics_world->stepSimulation(dt, 0);
+    else
+        m_dynamics_world->stepSimulation(dt, 3);
+
+    // First compute the responses to all kart-kart collisions. This has no
+    // side effects, so it is done in parallel. All side effects are then
+    // applied in the loop below in the order of the collisions, so the
+    // result does not depend on the number of threads.
+    m_kart_kart_collisions.clear();
+    for(unsigned int i=0; i<m_all_collisions.size(); i++)
+    {
+        if(m_all_collisions[i].getUserPointer(0)->is(UserPointer::UP_KART))
+            m_kart_kart_collisions.push_back(i);
+    }
+    m_kart_kart_responses.resize(m_kart_kart_collisions.size());
+    WorkerPool::get()->parallelFor((unsigned int)m_kart_kart_collisions.size(),
+        /*chunk_size*/8,
+        [this](unsigned int first, unsigned int last)
+        {
+            for(unsigned int i=first; i<last; i++)
+            {
+                const CollisionPair &c =
+                                  m_all_collisions[m_kart_kart_collisions[i]];
+                computeKartKartResponse(c.getUserPointer(0)->getPointerKart(),
+                                        c.getContactPointCS(0),
+                                        c.getUserPointer(1)->getPointerKart(),
+                                        c.getContactPointCS(1),
+                                        &m_kart_kart_responses[i]);
+            }
+        }, "Kart collisions");
 
     // Now handle the actual collision. Note: flyables can not be removed
     // inside of this loop, since the same flyables might hit more than one
     // other object. So only a flag is set in the flyables, the actual
     // clean up is then done later in the projectile manager.
+    unsigned int kart_kart_index = 0;
     std::vector<CollisionPair>::iterator p;
     for(p=m_all_collisions.begin(); p!=m_all_collisions.end(); ++p)
     {
@@ -164,14 +291,17 @@ void Physics::update(float dt)
         // --------------------
         if(p->getUserPointer(0)->is(UserPointer::UP_KART))
         {
-            KartKartCollision(p->getUserPointer(0)->getPointerKart(),
-                              p->getContactPointCS(0),
-                              p->getUserPointer(1)->getPointerKart(),
-                              p->getContactPointCS(1)                );
+            // Only one kart needs to handle the attachments, it will
+            // fix the attachments for the other kart.
+            AbstractKart *kart_a = p->getUserPointer(0)->getPointerKart();
+            AbstractKart *kart_b = p->getUserPointer(1)->getPointerKart();
+            kart_a->crashed(kart_b, /*handle_attachments*/true);
+            kart_b->crashed(kart_a, /*handle_attachments*/false);
+            applyKartKartResponse(m_kart_kart_responses[kart_kart_index++]);
             Scripting::ScriptEngine* script_engine = World::getWorld()->getScriptEngine();
             int kartid1 = p->getUserPointer(0)->getPointerKart()->getWorldKartId();
             int kartid2 = p->getUserPointer(1)->getPointerKart()->getWorldKartId();
-            script_engine->runFunction("void onKartKartCollision(int, int)",
+            script_engine->runFunction(&m_kart_kart_collision_function,
                 [=](asIScriptContext* ctx) {
                     ctx->SetArgDWord(0, kartid1);
                     ctx->SetArgDWord(1, kartid2);
@@ -187,11 +317,10 @@ void Physics::update(float dt)
             AbstractKart *kart = p->getUserPointer(1)->getPointerKart();
             int kartId = kart->getWorldKartId();
             PhysicalObject* obj = p->getUserPointer(0)->getPointerPhysicalObject();
-            std::string obj_id = obj->getID();
-            std::string scripting_function = obj->getOnKartCollisionFunction();
-            if (scripting_function.size() > 0)
+            if (!obj->getOnKartCollisionScript()->empty())
             {
-                script_engine->runFunction("void " + scripting_function + "(int, const string)",
+                std::string obj_id = obj->getID();
+                script_engine->runFunction(obj->getOnKartCollisionScript(),
                     [&](asIScriptContext* ctx) {
                         ctx->SetArgDWord(0, kartId);
                         ctx->SetArgObject(1, &obj_id);
@@ -259,11 +388,10 @@ void Physics::update(float dt)
             Scripting::ScriptEngine* script_engine = World::getWorld()->getScriptEngine();
             Flyable* flyable = p->getUserPointer(0)->getPointerFlyable();
             PhysicalObject* obj = p->getUserPointer(1)->getPointerPhysicalObject();
-            std::string obj_id = obj->getID();
-            std::string scripting_function = obj->getOnItemCollisionFunction();
-            if (scripting_function.size() > 0)
+            if (!obj->getOnItemCollisionScript()->empty())
             {
-                script_engine->runFunction("void " + scripting_function + "(int, int, const string)",
+                std::string obj_id = obj->getID();
+                script_engine->runFunction(obj->getOnItemCollisionScript(),
                         [&](asIScriptContext* ctx) {
                         ctx->SetArgDWord(0, (int)flyable->getType());
                         ctx->SetArgDWord(1, flyable->getOwnerId());
@@ -342,9 +470,9 @@ void Physics::update(float dt)
 //-----------------------------------------------------------------------------
 /** Handles the special case of two karts colliding with each other, which
  *  means that bombs must be passed on. If both karts have a bomb, they'll
- *  explode immediately. This function is called from physics::update() on the
- *  server and if no networking is used, and from race_state on the client to
- *  replay what happened on the server.
+ *  explode immediately. Physics::update() handles kart-kart collisions in
+ *  the same way, but computes the responses of all collisions in parallel
+ *  first.
  *  \param kart_a First kart involved in the collision.
  *  \param contact_point_a Location of collision at first kart (in kart
  *         coordinates).
@@ -357,11 +485,34 @@ void Physics::KartKartCollision(AbstractKart *kart_a,
                                 AbstractKart *kart_b,
                                 const Vec3 &contact_point_b)
 {
+    KartKartResponse response;
+    computeKartKartResponse(kart_a, contact_point_a, kart_b, contact_point_b,
+                            &response);
     // Only one kart needs to handle the attachments, it will
     // fix the attachments for the other kart.
     kart_a->crashed(kart_b, /*handle_attachments*/true);
     kart_b->crashed(kart_a, /*handle_attachments*/false);
+    applyKartKartResponse(response);
+}   // KartKartCollision
 
+//-----------------------------------------------------------------------------
+/** Computes how two colliding karts are pushed away from each other. This
+ *  only reads the state of the karts, so it can be called for different
+ *  collisions in parallel.
+ *  \param kart_a First kart involved in the collision.
+ *  \param contact_point_a Location of collision at first kart (in kart
+ *         coordinates).
+ *  \param kart_b Second kart involved in the collision.
+ *  \param contact_point_b Location of collision at second kart (in kart
+ *         coordinates).
+ *  \param response On return the impulses to apply.
+ */
+void Physics::computeKartKartResponse(AbstractKart *kart_a,
+                                      const Vec3 &contact_point_a,
+                                      AbstractKart *kart_b,
+                                      const Vec3 &contact_point_b,
+                                      KartKartResponse *response)
+{
     AbstractKart *left_kart, *right_kart;
 
     // Determine which kart is pushed to the left, and which one to the
@@ -443,34 +594,47 @@ void Physics::KartKartCollision(AbstractKart *kart_a,
     f_left  = f_left  * f_left;
     f_right = f_right * f_right;
 
+    // The impulse for the right kart pushes it to the left, and the
+    // impulse of the left kart to the right.
+    const KartProperties *kp_left  = left_kart->getKartProperties();
+    const KartProperties *kp_right = right_kart->getKartProperties();
+    response->m_left_kart          = left_kart;
+    response->m_right_kart         = right_kart;
+    response->m_right_impulse      = right_kart->getTrans().getBasis()
+                        * Vec3(kp_left->getCollisionImpulse()*f_right, 0, 0);
+    response->m_right_impulse_time = kp_left->getCollisionImpulseTime();
+    response->m_left_impulse       = left_kart->getTrans().getBasis()
+                       * Vec3(-kp_right->getCollisionImpulse()*f_left, 0, 0);
+    response->m_left_impulse_time  = kp_right->getCollisionImpulseTime();
+}   // computeKartKartResponse
+
+//-----------------------------------------------------------------------------
+/** Applies the impulses computed in computeKartKartResponse to the karts. */
+void Physics::applyKartKartResponse(const KartKartResponse &response)
+{
     // First push one kart to the left (if there is not already
     // an impulse happening - one collision might cause more
     // than one impulse otherwise)
+    AbstractKart *right_kart = response.m_right_kart;
     if(right_kart->getVehicle()->getCentralImpulseTime()<=0)
     {
-        const KartProperties *kp = left_kart->getKartProperties();
-        Vec3 impulse(kp->getCollisionImpulse()*f_right, 0, 0);
-        impulse = right_kart->getTrans().getBasis() * impulse;
         right_kart->getVehicle()
-                 ->setTimedCentralImpulse(kp->getCollisionImpulseTime(),
-                                          impulse);
-        right_kart ->getBody()->setAngularVelocity(btVector3(0,0,0));
+                  ->setTimedCentralImpulse(response.m_right_impulse_time,
+                                           response.m_right_impulse);
+        right_kart->getBody()->setAngularVelocity(btVector3(0,0,0));
     }
 
     // Then push the other kart to the right (if there is no
     // impulse happening atm).
+    AbstractKart *left_kart = response.m_left_kart;
     if(left_kart->getVehicle()->getCentralImpulseTime()<=0)
     {
-        const KartProperties *kp = right_kart->getKartProperties();
-        Vec3 impulse = Vec3(-kp->getCollisionImpulse()*f_left, 0, 0);
-        impulse = left_kart->getTrans().getBasis() * impulse;
         left_kart->getVehicle()
-                  ->setTimedCentralImpulse(kp->getCollisionImpulseTime(),
-                                           impulse);
+                 ->setTimedCentralImpulse(response.m_left_impulse_time,
+                                          response.m_left_impulse);
         left_kart->getBody()->setAngularVelocity(btVector3(0,0,0));
     }
-
-}   // KartKartCollision
+}   // applyKartKartResponse
 
 //-----------------------------------------------------------------------------
 /** This function is called at each internal bullet timestep. It is used
@@ -501,6 +665,18 @@ btScalar Physics::solveGroup(btCollisionObject** bodies, int numBodies,
                                                         debugDrawer,
                                                         stackAlloc,
                                                         dispatcher);
+    collectCollisions();
+    return returnValue;
+}   // solveGroup
+
+// ----------------------------------------------------------------------------
+/** Records the collisions of all contact manifolds after the constraints were
+ *  solved. This is called once per physics substep, after all islands were
+ *  solved, and goes through the manifolds in the order of the dispatcher, so
+ *  the recorded collisions don't depend on how the islands were solved.
+ */
+void Physics::collectCollisions()
+{
     int currentNumManifolds = m_dispatcher->getNumManifolds();
     // We can't explode a rocket in a loop, since a rocket might collide with
     // more than one object, and/or more than once with each object (if there
@@ -643,9 +819,7 @@ btScalar Physics::solveGroup(btCollisionObject** bodies, int numBodies,
         else
             assert("Unknown user pointer");           // 4) Should never happen
     }   // for i<numManifolds
-
-    return returnValue;
-}   // solveGroup
+}   // collectCollisions
 
 // ----------------------------------------------------------------------------
 /** A debug draw function to show the track and all karts.
@@ -666,6 +840,7 @@ void Physics::draw()
     irr_driver->getVideoDriver()->setMaterial(material);
     irr_driver->getVideoDriver()->setTransform(video::ETS_WORLD,
                                                core::IdentityMatrix);
+    m_debug_drawer->beginNextFrame();
     m_dynamics_world->debugDrawWorld();
     return;
 }   // draw
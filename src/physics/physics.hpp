@@ -32,6 +32,7 @@
 #include "physics/irr_debug_drawer.hpp"
 #include "physics/stk_dynamics_world.hpp"
 #include "physics/user_pointer.hpp"
+#include "scriptengine/script_function.hpp"
 
 class AbstractKart;
 class STKDynamicsWorld;
@@ -121,6 +122,29 @@ private:
             push_back(CollisionPair(a, contact_point_a, b, contact_point_b));
         }
     };  // CollisionList
+    // ========================================================================
+    /** The response to a kart-kart collision: which kart is pushed to the
+     *  left and which to the right, and the impulses to apply. It is
+     *  computed without side effects (so the responses of all collisions
+     *  can be computed in parallel), and applied later. */
+    struct KartKartResponse
+    {
+        AbstractKart *m_left_kart;
+        AbstractKart *m_right_kart;
+        /** The impulses (in world coordinates) and their durations. */
+        Vec3          m_left_impulse;
+        Vec3          m_right_impulse;
+        float         m_left_impulse_time;
+        float         m_right_impulse_time;
+    };   // KartKartResponse
+
+    /** The responses for the kart-kart collisions in m_all_collisions, in
+     *  the same order. */
+    std::vector<KartKartResponse>    m_kart_kart_responses;
+
+    /** Indices of kart-kart collisions in m_all_collisions. */
+    std::vector<unsigned int>        m_kart_kart_collisions;
+
     // ========================================================================
 
     /** This flag is set while bullets time step processing is taking
@@ -141,16 +165,31 @@ private:
     /** Used in physics debugging to draw the physics world. */
     IrrDebugDrawer                  *m_debug_drawer;
     btCollisionDispatcher           *m_dispatcher;
-    btBroadphaseInterface           *m_axis_sweep;
+    /** The broadphase, either an axis sweep sized to the track or a
+     *  dynamic AABB tree. */
+    btBroadphaseInterface           *m_broadphase;
     btDefaultCollisionConfiguration *m_collision_conf;
     CollisionList                    m_all_collisions;
 
+    /** The script function called on each kart-kart collision. */
+    Scripting::ScriptFunction        m_kart_kart_collision_function;
+
+    static void computeKartKartResponse(AbstractKart *kart_a,
+                                        const Vec3 &contact_point_a,
+                                        AbstractKart *kart_b,
+                                        const Vec3 &contact_point_b,
+                                        KartKartResponse *response);
+    static void applyKartKartResponse(const KartKartResponse &response);
+    static void getCollisionFilter(const btRigidBody *body, short *group,
+                                   short *mask);
+
 public:
           Physics          ();
          ~Physics          ();
-    void  init             (const Vec3 &min_world, const Vec3 &max_world);
+    void  init             (const Vec3 &min_world, const Vec3 &max_world,
+                            bool dynamic_broadphase=false);
     void  addKart          (const AbstractKart *k);
-    void  addBody          (btRigidBody* b) {m_dynamics_world->addRigidBody(b);}
+    void  addBody          (btRigidBody* b);
     void  removeKart       (const AbstractKart *k);
     void  removeBody       (btRigidBody* b) {m_dynamics_world->removeRigidBody(b);}
     void  KartKartCollision(AbstractKart *ka, const Vec3 &contact_point_a,
@@ -172,6 +211,7 @@ public:
                                 const btContactSolverInfo& info,
                                 btIDebugDraw* debugDrawer, btStackAlloc* stackAlloc,
                                 btDispatcher* dispatcher);
+    void collectCollisions();
 };
 
 #endif // HEADER_PHYSICS_HPP
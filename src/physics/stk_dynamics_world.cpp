@@ -0,0 +1,188 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "physics/stk_dynamics_world.hpp"
+
+#include "physics/physics.hpp"
+#include "utils/worker_pool.hpp"
+
+#include "BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
+
+#include <algorithm>
+#include <atomic>
+
+// ----------------------------------------------------------------------------
+/** Returns the island of a constraint, the same way bullet does. */
+static inline int getConstraintIslandId(const btTypedConstraint *constraint)
+{
+    const btCollisionObject &object0 = constraint->getRigidBodyA();
+    const btCollisionObject &object1 = constraint->getRigidBodyB();
+    return object0.getIslandTag() >= 0 ? object0.getIslandTag()
+                                       : object1.getIslandTag();
+}   // getConstraintIslandId
+
+// ----------------------------------------------------------------------------
+/** Sorts constraints by their island. */
+class SortConstraintOnIslandPredicate
+{
+public:
+    bool operator()(const btTypedConstraint *lhs,
+                    const btTypedConstraint *rhs) const
+    {
+        return getConstraintIslandId(lhs) < getConstraintIslandId(rhs);
+    }
+};   // SortConstraintOnIslandPredicate
+
+// ----------------------------------------------------------------------------
+/** Copies the bodies, manifolds and constraints of each island reported by
+ *  the island manager, which reuses its arrays for the next island. */
+struct STKDynamicsWorld::IslandCollector
+                       : public btSimulationIslandManager::IslandCallback
+{
+    STKDynamicsWorld *m_world;
+
+    IslandCollector(STKDynamicsWorld *world) : m_world(world) {}
+    // ------------------------------------------------------------------------
+    virtual void ProcessIsland(btCollisionObject **bodies, int num_bodies,
+                               btPersistentManifold **manifolds,
+                               int num_manifolds, int island_id)
+    {
+        Island island;
+        island.m_first_constraint = 0;
+        island.m_num_constraints  = 0;
+        const btAlignedObjectArray<btTypedConstraint*> &constraints =
+                                                 m_world->m_sorted_constraints;
+        int i = 0;
+        while (i < constraints.size() &&
+               getConstraintIslandId(constraints[i]) != island_id)
+            i++;
+        island.m_first_constraint = i;
+        for (; i < constraints.size(); i++)
+        {
+            if (getConstraintIslandId(constraints[i]) == island_id)
+                island.m_num_constraints++;
+        }
+        // Only solve islands with some work, like bullet does
+        if (num_manifolds + island.m_num_constraints == 0)
+            return;
+
+        island.m_first_body = m_world->m_island_bodies.size();
+        island.m_num_bodies = num_bodies;
+        for (i = 0; i < num_bodies; i++)
+            m_world->m_island_bodies.push_back(bodies[i]);
+        island.m_first_manifold = m_world->m_island_manifolds.size();
+        island.m_num_manifolds  = num_manifolds;
+        for (i = 0; i < num_manifolds; i++)
+            m_world->m_island_manifolds.push_back(manifolds[i]);
+        m_world->m_islands.push_back(island);
+    }   // ProcessIsland
+};   // IslandCollector
+
+// ----------------------------------------------------------------------------
+STKDynamicsWorld::STKDynamicsWorld(btDispatcher*             dispatcher,
+                                   btBroadphaseInterface*    pair_cache,
+                                   Physics*                  physics,
+                                   btCollisionConfiguration* configuration)
+                : btDiscreteDynamicsWorld(dispatcher, pair_cache, physics,
+                                          configuration)
+{
+    m_physics = physics;
+}   // STKDynamicsWorld
+
+// ----------------------------------------------------------------------------
+STKDynamicsWorld::~STKDynamicsWorld()
+{
+    for (unsigned int i = 0; i < m_solvers.size(); i++)
+        delete m_solvers[i];
+}   // ~STKDynamicsWorld
+
+// ----------------------------------------------------------------------------
+/** Solves the constraints of one island. */
+void STKDynamicsWorld::solveIsland(btSequentialImpulseConstraintSolver *solver,
+                                   const Island &island,
+                                   btContactSolverInfo &solver_info)
+{
+    btCollisionObject **bodies = island.m_num_bodies
+                               ? &m_island_bodies[island.m_first_body] : 0;
+    btPersistentManifold **manifolds = island.m_num_manifolds
+                           ? &m_island_manifolds[island.m_first_manifold] : 0;
+    btTypedConstraint **constraints = island.m_num_constraints
+                       ? &m_sorted_constraints[island.m_first_constraint] : 0;
+    solver->solveGroup(bodies, island.m_num_bodies, manifolds,
+                       island.m_num_manifolds, constraints,
+                       island.m_num_constraints, solver_info, m_debugDrawer,
+                       m_stackAlloc, m_dispatcher1);
+}   // solveIsland
+
+// ----------------------------------------------------------------------------
+/** Solves the constraints of all islands. Unlike bullet, which combines small
+ *  islands into batches, each island is solved on its own, so that islands
+ *  can be handed out to the threads of the worker pool. Since islands share
+ *  no dynamic bodies this gives the same result as batching them.
+ */
+void STKDynamicsWorld::solveConstraints(btContactSolverInfo &solver_info)
+{
+    // Without split islands bullet passes everything as one group
+    if (!m_islandManager->getSplitIslands())
+    {
+        btDiscreteDynamicsWorld::solveConstraints(solver_info);
+        return;
+    }
+
+    m_sorted_constraints.resize(m_constraints.size());
+    for (int i = 0; i < m_constraints.size(); i++)
+        m_sorted_constraints[i] = m_constraints[i];
+    m_sorted_constraints.quickSort(SortConstraintOnIslandPredicate());
+
+    m_islands.clear();
+    m_island_bodies.resize(0);
+    m_island_manifolds.resize(0);
+
+    m_constraintSolver->prepareSolve(getNumCollisionObjects(),
+                                     getDispatcher()->getNumManifolds());
+    IslandCollector collector(this);
+    m_islandManager->buildAndProcessIslands(getDispatcher(), this,
+                                            &collector);
+
+    if (!m_islands.empty())
+    {
+        WorkerPool *pool = WorkerPool::get();
+        const unsigned int num_threads =
+            std::min(pool->getNumThreads(), (unsigned int)m_islands.size());
+        while (m_solvers.size() < num_threads)
+            m_solvers.push_back(new btSequentialImpulseConstraintSolver());
+
+        // Each item is one solver, which takes islands until all are
+        // done. This keeps each solver on one thread at a time.
+        std::atomic<unsigned int> next_island(0);
+        pool->parallelFor(num_threads, /*chunk_size*/1,
+            [this, &next_island, &solver_info](unsigned int first,
+                                               unsigned int last)
+            {
+                for (unsigned int t = first; t < last; t++)
+                {
+                    unsigned int n;
+                    while ((n = next_island++) < m_islands.size())
+                        solveIsland(m_solvers[t], m_islands[n], solver_info);
+                }
+            }, "Island solver");
+        m_physics->collectCollisions();
+    }
+
+    m_constraintSolver->allSolved(solver_info, m_debugDrawer, m_stackAlloc);
+}   // solveConstraints
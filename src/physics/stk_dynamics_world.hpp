@@ -21,20 +21,59 @@
 
 #include "btBulletDynamicsCommon.h"
 
+#include <vector>
+
+class Physics;
+
+/** The dynamics world of STK. The constraints of independent simulation
+ *  islands are solved in parallel by the worker pool, each thread with its
+ *  own solver. An island is always solved on its own, so the result does
+ *  not depend on the number of threads or on the order in which the islands
+ *  are solved. The collisions are recorded by Physics once all islands are
+ *  solved.
+ *  \ingroup physics
+ */
 class STKDynamicsWorld : public btDiscreteDynamicsWorld
 {
-public:
-    /** The standard constructor which just created a btDiscreteDynamicsWorld. */
-    STKDynamicsWorld(btDispatcher*             dispatcher,
-                     btBroadphaseInterface*    pairCache,
-                     btConstraintSolver*       constraintSolver,
-                     btCollisionConfiguration* collisionConfiguration)
-
-                   : btDiscreteDynamicsWorld(dispatcher, pairCache,
-                                             constraintSolver,
-                                             collisionConfiguration)
+private:
+    /** The bodies, manifolds and constraints of one island, as ranges in
+     *  m_island_bodies, m_island_manifolds and the sorted constraints. */
+    struct Island
     {
-    }
+        int m_first_body, m_num_bodies;
+        int m_first_manifold, m_num_manifolds;
+        int m_first_constraint, m_num_constraints;
+    };   // Island
+
+    /** The physics, which records the collisions of each substep. */
+    Physics *m_physics;
+
+    /** One solver for each thread of the worker pool. */
+    std::vector<btSequentialImpulseConstraintSolver*> m_solvers;
+
+    /** The islands of the current substep. */
+    std::vector<Island> m_islands;
+    btAlignedObjectArray<btCollisionObject*>     m_island_bodies;
+    btAlignedObjectArray<btPersistentManifold*>  m_island_manifolds;
+    /** All constraints, sorted by island. */
+    btAlignedObjectArray<btTypedConstraint*>     m_sorted_constraints;
+
+    struct IslandCollector;
+
+    void solveIsland(btSequentialImpulseConstraintSolver *solver,
+                     const Island &island, btContactSolverInfo &solver_info);
+
+protected:
+    virtual void solveConstraints(btContactSolverInfo &solver_info);
+
+public:
+    /** The standard constructor which just created a btDiscreteDynamicsWorld
+     *  with the physics as constraint solver. */
+             STKDynamicsWorld(btDispatcher*             dispatcher,
+                              btBroadphaseInterface*    pairCache,
+                              Physics*                  physics,
+                              btCollisionConfiguration* collisionConfiguration);
+    virtual ~STKDynamicsWorld();
 
     /** Resets m_localTime to 0. This allows more precise replay of
      *  physics, which is important for replaying histories. */
@@ -43,4 +82,3 @@ public:
 };   // STKDynamicsWorld
 #endif
 /* EOF */
-
@@ -23,9 +23,13 @@
 #include "modes/world.hpp"
 #include "physics/physics.hpp"
 #include "utils/constants.hpp"
+#include "utils/profiler.hpp"
 #include "utils/time.hpp"
 
+#include <algorithm>
 #include <fstream>
+#include <stdio.h>
+#include <string.h>
 
 // -----------------------------------------------------------------------------
 /** Constructor: Initialises all data structures with zero.
@@ -42,6 +46,7 @@ TriangleMesh::TriangleMesh() : m_mesh()
     // (and m_mesh->m_weldingThreshold at m_normals
     m_collision_shape  = NULL;
     m_collision_object = NULL;
+    m_cached_bvh_buffer = NULL;
     m_user_pointer.set(this);
 }   // TriangleMesh
 
@@ -84,11 +89,137 @@ void TriangleMesh::addTriangle(const btVector3 &t1, const btVector3 &t2,
     m_p1p2p3.push_back(edge1.cross(edge2).length2());
 }   // addTriangle
 
+// -----------------------------------------------------------------------------
+/** Returns a hash of all triangles of this mesh, which is used to check if
+ *  a cached BVH was created for this mesh (FNV-1a over all vertices).
+ */
+uint64_t TriangleMesh::getHash() const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(unsigned int i=0; i<m_triangleIndex2Material.size(); i++)
+    {
+        btVector3 *p[3];
+        getTriangle(i, &p[0], &p[1], &p[2]);
+        for(unsigned int j=0; j<3; j++)
+        {
+            float xyz[3] = { p[j]->getX(), p[j]->getY(), p[j]->getZ() };
+            const unsigned char *c = (const unsigned char*)xyz;
+            for(unsigned int k=0; k<sizeof(xyz); k++)
+            {
+                hash ^= c[k];
+                hash *= 1099511628211ULL;
+            }
+        }
+    }
+    return hash;
+}   // getHash
+
+// -----------------------------------------------------------------------------
+/** Tries to load a cached BVH for this mesh. The file starts with a header
+ *  of BVH_CACHE_HEADER_SIZE bytes (magic, version and the hash of the mesh
+ *  it was created for), followed by the serialized quantized BVH.
+ *  \param filename Name of the cache file.
+ *  \return The BVH, or NULL if the file does not exist or does not belong
+ *          to this mesh.
+ */
+btOptimizedBvh* TriangleMesh::loadCachedBvh(const std::string &filename)
+{
+    FILE *f = fopen(filename.c_str(), "rb");
+    if(!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if(size <= (long)BVH_CACHE_HEADER_SIZE)
+    {
+        fclose(f);
+        return NULL;
+    }
+
+    // The serialized BVH must be 16 byte aligned, which is guaranteed
+    // since the header size is a multiple of 16.
+    unsigned char *bytes = (unsigned char*)btAlignedAlloc(size, 16);
+    bool ok = fread(bytes, size, 1, f)==1;
+    fclose(f);
+
+    uint32_t version = 0;
+    uint64_t hash    = 0;
+    memcpy(&version, bytes+4, sizeof(version));
+    memcpy(&hash,    bytes+8, sizeof(hash)   );
+    btOptimizedBvh *bvh = NULL;
+    if(ok && memcmp(bytes, "SBVH", 4)==0 && version==BVH_CACHE_VERSION &&
+       hash==getHash())
+    {
+        bvh = btOptimizedBvh::deSerializeInPlace(bytes+BVH_CACHE_HEADER_SIZE,
+                                         size-BVH_CACHE_HEADER_SIZE,
+                                         /*swap endian*/false);
+    }
+    if(!bvh || !bvh->isQuantized())
+    {
+        Log::warn("TriangleMesh", "Ignoring invalid cached BVH '%s'.",
+                  filename.c_str());
+        btAlignedFree(bytes);
+        return NULL;
+    }
+    // The serialized BVH is used in place, so keep the buffer.
+    m_cached_bvh_buffer = bytes;
+    return bvh;
+}   // loadCachedBvh
+
+// -----------------------------------------------------------------------------
+/** Saves the BVH of this mesh in a cache file (see loadCachedBvh). The
+ *  data is first written to a temporary file, so an interrupted write
+ *  never leaves a truncated cache file.
+ *  \param bvh The BVH to save.
+ *  \param filename Name of the cache file.
+ */
+void TriangleMesh::saveCachedBvh(btOptimizedBvh *bvh,
+                                 const std::string &filename) const
+{
+    unsigned int size = bvh->calculateSerializeBufferSize();
+    unsigned char *bytes =
+        (unsigned char*)btAlignedAlloc(BVH_CACHE_HEADER_SIZE+size, 16);
+    memset(bytes, 0, BVH_CACHE_HEADER_SIZE);
+    uint32_t version = BVH_CACHE_VERSION;
+    uint64_t hash    = getHash();
+    memcpy(bytes,   "SBVH",   4);
+    memcpy(bytes+4, &version, sizeof(version));
+    memcpy(bytes+8, &hash,    sizeof(hash)   );
+    if(!bvh->serialize(bytes+BVH_CACHE_HEADER_SIZE, size,
+                       /*swap endian*/false))
+    {
+        btAlignedFree(bytes);
+        return;
+    }
+
+    std::string tmp = filename+".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if(!f)
+    {
+        Log::warn("TriangleMesh", "Can't write cached BVH '%s'.",
+                  tmp.c_str());
+        btAlignedFree(bytes);
+        return;
+    }
+    bool ok = fwrite(bytes, BVH_CACHE_HEADER_SIZE+size, 1, f)==1;
+    ok = fclose(f)==0 && ok;
+    btAlignedFree(bytes);
+    remove(filename.c_str());
+    if(!ok || rename(tmp.c_str(), filename.c_str())!=0)
+    {
+        Log::warn("TriangleMesh", "Can't write cached BVH '%s'.",
+                  filename.c_str());
+        remove(tmp.c_str());
+    }
+}   // saveCachedBvh
+
 // -----------------------------------------------------------------------------
 /** Creates a collision body only, which can be used for raycasting, but
- *  has no physical properties.
- *  @param serialized_bhv if non-null, load the serialized bhv from file instead
- *                        of builing it on the fly
+ *  has no physical properties. The BVH uses quantized AABBs (which need
+ *  less memory) unless the mesh has too many triangles for them.
+ *  @param serialized_bhv if non-null, the name of a file in which the BVH
+ *         is cached: if this file contains a BVH for this mesh it is used,
+ *         otherwise the BVH is built and saved in this file.
  */
 void TriangleMesh::createCollisionShape(bool create_collision_object, const char* serialized_bhv)
 {
@@ -103,53 +234,25 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
     // Now convert the triangle mesh into a static rigid body
     btBvhTriangleMeshShape* bhv_triangle_mesh;
 
-    if (serialized_bhv != NULL)
-    {
-        FILE *f = fopen(serialized_bhv, "rb");
-        fseek(f, 0, SEEK_END);
-        long pos = ftell(f);
-        assert(pos != -1L);
-        fseek(f, 0, SEEK_SET);
-
-        void* bytes = btAlignedAlloc(pos, 16);
-        fread(bytes, pos, 1, f);
-        fclose(f);
+    // Quantized nodes store the triangle index in 21 bits.
+    const bool quantized = m_triangleIndex2Material.size() < (1<<21);
 
-        btOptimizedBvh* bhv = btOptimizedBvh::deSerializeInPlace(bytes, pos, !IS_LITTLE_ENDIAN);
-        if (bhv == NULL)
-        {
-            Log::warn("TriangleMesh", "Failed to load serialized BHV");
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
-        }
-        else
-        {
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */,
-                                                           false /* buildBvh */);
-            bhv_triangle_mesh->setOptimizedBvh( bhv );
-        }
-        // Do *NOT* free the bytes, 'deSerializeInPlace' makes the btOptimizedBvh object
-        // directly at this memory location
-        //free(bytes);
+    btOptimizedBvh *bvh = NULL;
+    if (serialized_bhv != NULL && quantized)
+        bvh = loadCachedBvh(serialized_bhv);
 
+    if (bvh)
+    {
+        bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, true /* useQuantizedAabbCompression */,
+                                                       false /* buildBvh */);
+        bhv_triangle_mesh->setOptimizedBvh(bvh);
     }
     else
     {
-        bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
-
-        /*
-         // code to serialize triangle mesh
-        btOptimizedBvh* bvh = bhv_triangle_mesh->getOptimizedBvh();
-        unsigned int ssize = bvh->calculateSerializeBufferSize();
-        char* buffer = (char*)btAlignedAlloc(ssize, 16);
-        bool success = bvh->serialize(buffer, ssize, !IS_LITTLE_ENDIAN);
-        printf("serialization success = %i\n", success);
-
-        std::ofstream fileout("/tmp/btOptimizedBvh");
-        fileout.write(buffer, ssize);
-        fileout.close();
-
-        btAlignedFree(buffer);
-         */
+        bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, quantized /* useQuantizedAabbCompression */);
+        if (serialized_bhv != NULL && quantized)
+            saveCachedBvh(bhv_triangle_mesh->getOptimizedBvh(),
+                          serialized_bhv);
     }
 
     m_collision_shape = bhv_triangle_mesh;
@@ -174,8 +277,8 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
  *  removed and all objects together with the track is converted again into
  *  a single rigid body. This avoids using irrlicht (or the graphics engine)
  *  for height of terrain detection).
- *  @param serializedBhv if non-NULL, the bhv is deserialized instead of
- *                       being calculated on the fly
+ *  @param serializedBhv if non-NULL, the name of the file in which the
+ *                       BVH is cached (see createCollisionShape)
  */
 void TriangleMesh::createPhysicalBody(btCollisionObject::CollisionFlags flags,
                                       const char* serializedBhv)
@@ -189,12 +292,12 @@ void TriangleMesh::createPhysicalBody(btCollisionObject::CollisionFlags flags,
     btRigidBody::btRigidBodyConstructionInfo info(0.0f, m_motion_state,
                                                   m_collision_shape);
     m_body=new btRigidBody(info);
-    World::getWorld()->getPhysics()->addBody(m_body);
-
     m_body->setUserPointer(&m_user_pointer);
     m_body->setCollisionFlags(m_body->getCollisionFlags()  |
                               flags                        |
                               btCollisionObject::CF_CUSTOM_MATERIAL_CALLBACK);
+    // The user pointer must be set first, it determines the collision group
+    World::getWorld()->getPhysics()->addBody(m_body);
 }   // createPhysicalBody
 
 // ----------------------------------------------------------------------------
@@ -222,8 +325,24 @@ void TriangleMesh::removeAll()
     }
     delete m_collision_shape;
     m_collision_shape = NULL;
+    removeCachedBvh();
 }   // removeAll
 
+// -----------------------------------------------------------------------------
+/** Frees the buffer of a BVH loaded from the cache. The collision shape
+ *  using this BVH must already be deleted.
+ */
+void TriangleMesh::removeCachedBvh()
+{
+    if(!m_cached_bvh_buffer)
+        return;
+    btOptimizedBvh *bvh =
+        (btOptimizedBvh*)(m_cached_bvh_buffer+BVH_CACHE_HEADER_SIZE);
+    bvh->~btOptimizedBvh();
+    btAlignedFree(m_cached_bvh_buffer);
+    m_cached_bvh_buffer = NULL;
+}   // removeCachedBvh
+
 // -----------------------------------------------------------------------------
 /** Interpolates the normal at the given position for the triangle with
  *  a given index. The position must be inside of the given triangle.
@@ -290,6 +409,7 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
                            btVector3 *xyz, const Material **material,
                            btVector3 *normal, bool interpolate_normal) const
 {
+    PROFILER_COUNT("Raycasts", 1);
     if(!m_collision_shape)
     {
         *material=NULL;
@@ -375,3 +495,90 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
     return ray_callback.hasHit();
 
 }   // castRay
+
+// ----------------------------------------------------------------------------
+/** Spreads the lower 16 bits of a value to the even bits of the result,
+ *  used to compute Morton codes. */
+static uint32_t spreadBits(uint32_t x)
+{
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}   // spreadBits
+
+// ----------------------------------------------------------------------------
+/** Casts a batch of rays against this mesh. The rays are cast in the order
+ *  of a Morton (Z order) curve of their start points in the XZ plane, so
+ *  that consecutive rays mostly traverse the same nodes of the BVH, which
+ *  are then still in the cache.
+ *  \param rays The rays to cast. On return the hit point, normal and
+ *         material (NULL if nothing was hit) of each ray are set.
+ *  \param interpolate_normal If true the normals are interpolated (see
+ *         castRay).
+ */
+void TriangleMesh::castRays(std::vector<RayQuery> *rays,
+                            bool interpolate_normal) const
+{
+    if(rays->empty())
+        return;
+    PROFILER_COUNT("Raycasts", rays->size());
+
+    btVector3 min = (*rays)[0].m_from, max = min;
+    for(unsigned int i=1; i<rays->size(); i++)
+    {
+        min.setMin((*rays)[i].m_from);
+        max.setMax((*rays)[i].m_from);
+    }
+    btVector3 scale = max-min;
+    for(unsigned int j=0; j<3; j++)
+        scale[j] = scale[j]>0 ? 65535.0f/scale[j] : 0.0f;
+
+    std::vector<std::pair<uint32_t, unsigned int> > order(rays->size());
+    for(unsigned int i=0; i<rays->size(); i++)
+    {
+        const btVector3 p = ((*rays)[i].m_from - min) * scale;
+        order[i].first  = spreadBits((uint32_t)p.getX())
+                        | (spreadBits((uint32_t)p.getZ()) << 1);
+        order[i].second = i;
+    }
+    std::sort(order.begin(), order.end());
+
+    for(unsigned int i=0; i<order.size(); i++)
+    {
+        RayQuery &ray = (*rays)[order[i].second];
+        castRay(ray.m_from, ray.m_to, &ray.m_hit_point, &ray.m_material,
+                &ray.m_normal, interpolate_normal);
+    }
+}   // castRays
+
+// ----------------------------------------------------------------------------
+/** Returns true if there might be a triangle in the given axis aligned box.
+ *  This uses the BVH of the mesh, so a triangle is reported if its
+ *  bounding box (not necessarily the triangle itself) overlaps the box.
+ *  The mesh must not be transformed (as the track mesh).
+ *  \param min, max The corners of the box.
+ */
+bool TriangleMesh::hasTrianglesInBox(const btVector3 &min,
+                                     const btVector3 &max) const
+{
+    class TriangleFound : public btTriangleCallback
+    {
+    public:
+        bool m_found;
+        virtual void processTriangle(btVector3 *triangle, int part_id,
+                                     int triangle_index)
+        {
+            m_found = true;
+        }
+    };   // TriangleFound
+
+    TriangleFound callback;
+    callback.m_found = false;
+    const btConcaveShape *shape =
+                            static_cast<const btConcaveShape*>(m_collision_shape);
+    shape->processAllTriangles(&callback, min, max);
+    return callback.m_found;
+}   // hasTrianglesInBox
@@ -19,11 +19,13 @@
 #ifndef HEADER_TRIANGLE_MESH_HPP
 #define HEADER_TRIANGLE_MESH_HPP
 
+#include <string>
 #include <vector>
 #include "btBulletDynamicsCommon.h"
 
 #include "physics/user_pointer.hpp"
 #include "utils/aligned_array.hpp"
+#include "utils/types.hpp"
 
 class Material;
 
@@ -33,6 +35,21 @@ class Material;
  */
 class TriangleMesh
 {
+public:
+    /** A ray to be cast in a batch with castRays, and its result. */
+    struct RayQuery
+    {
+        btVector3       m_from;
+        btVector3       m_to;
+        /** The closest hit point (only defined if m_material is not
+         *  NULL). */
+        btVector3       m_hit_point;
+        /** The normal at the hit point. */
+        btVector3       m_normal;
+        /** The material hit, or NULL if nothing was hit. */
+        const Material *m_material;
+    };   // RayQuery
+
 private:
     UserPointer                  m_user_pointer;
     std::vector<const Material*> m_triangleIndex2Material;
@@ -49,6 +66,21 @@ private:
     AlignedArray<btVector3>      m_normals;
     /** Pre-compute value used in smoothing. */
     AlignedArray<float>          m_p1p2p3;
+
+    /** Size of the header of a cached BVH file (a multiple of 16, since
+     *  the serialized BVH must be 16 byte aligned). */
+    static const unsigned int    BVH_CACHE_HEADER_SIZE = 16;
+    /** Version of the cached BVH files. */
+    static const unsigned int    BVH_CACHE_VERSION = 1;
+
+    /** If the BVH was loaded from the cache, the buffer that contains it
+     *  (the BVH is used in place). */
+    unsigned char               *m_cached_bvh_buffer;
+
+    btOptimizedBvh* loadCachedBvh(const std::string &filename);
+    void            saveCachedBvh(btOptimizedBvh *bvh,
+                                  const std::string &filename) const;
+    void            removeCachedBvh();
 public:
          TriangleMesh();
         ~TriangleMesh();
@@ -62,6 +94,7 @@ public:
                             const char* serializedBhv = NULL);
     void removeAll();
     void removeCollisionObject();
+    uint64_t getHash() const;
     btVector3 getInterpolatedNormal(unsigned int index,
                                     const btVector3 &position) const;
     // ------------------------------------------------------------------------
@@ -90,6 +123,9 @@ public:
     bool castRay(const btVector3 &from, const btVector3 &to,
                  btVector3 *xyz, const Material **material,
                  btVector3 *normal=NULL, bool interpolate_normal=false) const;
+    void castRays(std::vector<RayQuery> *rays,
+                  bool interpolate_normal=false) const;
+    bool hasTrianglesInBox(const btVector3 &min, const btVector3 &max) const;
     // ------------------------------------------------------------------------
     /** Returns the points of the 'indx' triangle.
      *  \param indx Index of the triangle to get.
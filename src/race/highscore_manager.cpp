@@ -20,6 +20,7 @@
 
 #include <stdexcept>
 #include <fstream>
+#include <stdio.h>
 
 #include "config/user_config.hpp"
 #include "io/file_manager.hpp"
@@ -32,17 +33,52 @@
 HighscoreManager* highscore_manager=0;
 const unsigned int HighscoreManager::CURRENT_HSCORE_FILE_VERSION = 3;
 
+/** Identifies a highscore journal, followed by the journal version. */
+static const char JOURNAL_MAGIC[4] = { 'S', 'T', 'K', 'J' };
+static const int32_t JOURNAL_VERSION = 1;
+
 HighscoreManager::HighscoreManager()
 {
-    m_can_write=true;
+    m_can_write       = true;
+    m_journal_entries = 0;
+    m_quit            = false;
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_queued_cond, NULL);
+    m_writer_started = pthread_create(&m_writer_thread, NULL,
+                                      &HighscoreManager::writerThread,
+                                      this) == 0;
+    if(!m_writer_started)
+        Log::warn("Highscore Manager",
+                  "Could not create writer thread, saving synchronously.");
     setFilename();
-    loadHighscores();
+    // The xml file is rewritten if it is missing or outdated, or if the
+    // journal is broken
+    bool rewrite = loadHighscores();
+    if(loadJournal())
+        rewrite = true;
+    if(rewrite)
+        compact();
 }   // HighscoreManager
 
 // -----------------------------------------------------------------------------
 HighscoreManager::~HighscoreManager()
 {
     saveHighscores();
+    // Merge the journal into the xml file, so that it is read fast and can
+    // be edited by hand.
+    if(m_journal_entries>0)
+        compact();
+    if(m_writer_started)
+    {
+        pthread_mutex_lock(&m_mutex);
+        m_quit = true;
+        pthread_cond_signal(&m_queued_cond);
+        pthread_mutex_unlock(&m_mutex);
+        pthread_join(m_writer_thread, NULL);
+    }
+    pthread_cond_destroy(&m_queued_cond);
+    pthread_mutex_destroy(&m_mutex);
+
     for(type_all_scores::iterator i  = m_all_scores.begin();
                                   i != m_all_scores.end();  i++)
         delete *i;
@@ -62,25 +98,23 @@ void HighscoreManager::setFilename()
     {
         m_filename=file_manager->getUserConfigFile("highscore.xml");
     }
+    m_journal_filename = StringUtils::removeExtension(m_filename)
+                       + ".journal";
 
     return;
 }   // SetFilename
 
 // -----------------------------------------------------------------------------
-void HighscoreManager::loadHighscores()
+bool HighscoreManager::loadHighscores()
 {
     XMLNode *root = NULL;
     root = file_manager->createXMLTree(m_filename);
     if(!root)
     {
-        saveHighscores();
-        if(m_can_write)
-        {
-            Log::info("Highscore Manager", "New highscore file '%s' created.\n",
-                    m_filename.c_str());
-        }
+        Log::info("Highscore Manager", "New highscore file '%s' created.\n",
+                  m_filename.c_str());
         delete root;
-        return;
+        return true;
     }
 
     try
@@ -102,11 +136,11 @@ void HighscoreManager::loadHighscores()
             user_config->setWarning( warning );
 
             // since we haven't had the chance to load the current scores yet,
-            // calling Save() now will generate an empty file with the right format.
-            saveHighscores();
+            // writing the file now will generate an empty file with the right
+            // format (and discard an old journal).
             delete root;
             root = NULL;
-            return;
+            return true;
         }
 
         // read all entries one by one and store them in 'm_all_scores'
@@ -123,7 +157,7 @@ void HighscoreManager::loadHighscores()
                 Log::error("Highscore Manager", "Invalid highscore entry will be skipped : %s\n", e.what());
                 continue;
             }
-            m_all_scores.push_back(highscores);
+            addEntry(highscores);
         }   // next entry
 
         if(UserConfigParams::logMisc())
@@ -140,23 +174,215 @@ void HighscoreManager::loadHighscores()
     }
     if(root)
         delete root;
+    return false;
 }   // loadHighscores
 
 // -----------------------------------------------------------------------------
+/** Reads the entries appended to the journal since the xml file was last
+ *  written. An entry in the journal replaces the entry for the same kind of
+ *  race. A truncated last entry (e.g. because of a crash while saving) is
+ *  ignored.
+ */
+bool HighscoreManager::loadJournal()
+{
+    FILE *fd = fopen(m_journal_filename.c_str(), "rb");
+    if(!fd) return false;
+    std::string data;
+    char buffer[4096];
+    size_t n;
+    while((n = fread(buffer, 1, sizeof(buffer), fd)) > 0)
+        data.append(buffer, n);
+    fclose(fd);
+
+    if(data.size() < 8 || memcmp(data.c_str(), JOURNAL_MAGIC, 4)!=0)
+    {
+        Log::warn("Highscore Manager", "Ignoring invalid journal '%s'.",
+                  m_journal_filename.c_str());
+        return true;
+    }
+    size_t offset = 8;
+    while(offset < data.size())
+    {
+        Highscores *highscores = Highscores::decode(data, &offset);
+        if(!highscores)
+        {
+            Log::warn("Highscore Manager",
+                      "Journal '%s' is truncated, the last entry is lost.",
+                      m_journal_filename.c_str());
+            // Rewrite the files, so that nothing is appended to the
+            // broken entry
+            return true;
+        }
+        addEntry(highscores);
+        m_journal_entries++;
+    }
+    return false;
+}   // loadJournal
+
+// -----------------------------------------------------------------------------
+/** Adds an entry to the list and the index. If there is already an entry for
+ *  the same kind of race, it is replaced.
+ */
+void HighscoreManager::addEntry(Highscores *highscores)
+{
+    Highscores *&slot = m_index[highscores->getKey()];
+    if(slot)
+    {
+        *slot = *highscores;
+        delete highscores;
+        return;
+    }
+    slot = highscores;
+    m_all_scores.push_back(highscores);
+}   // addEntry
+
+// -----------------------------------------------------------------------------
+/** Appends all entries that changed since the last save to the journal. If
+ *  the journal gets too long, the xml file is rewritten instead. The files
+ *  are written by a separate thread.
+ */
 void HighscoreManager::saveHighscores()
+{
+    WriteJob job;
+    job.m_write_xml = false;
+    unsigned int num_dirty = 0;
+    for(unsigned int i=0; i<m_all_scores.size(); i++)
+    {
+        if(!m_all_scores[i]->isDirty()) continue;
+        m_all_scores[i]->encode(&job.m_journal_data);
+        m_all_scores[i]->setDirty(false);
+        num_dirty++;
+    }
+    if(num_dirty==0) return;
+
+    m_journal_entries += num_dirty;
+    if(m_journal_entries > MAX_JOURNAL_ENTRIES)
+    {
+        compact();
+        return;
+    }
+    queueJob(&job);
+}   // saveHighscores
+
+// -----------------------------------------------------------------------------
+/** Writes all entries to the xml file and empties the journal. */
+void HighscoreManager::compact()
+{
+    WriteJob job;
+    job.m_write_xml = true;
+    for(unsigned int i=0; i<m_all_scores.size(); i++)
+    {
+        m_all_scores[i]->setDirty(false);
+        job.m_snapshot.push_back(*m_all_scores[i]);
+    }
+    m_journal_entries = 0;
+    queueJob(&job);
+}   // compact
+
+// -----------------------------------------------------------------------------
+/** Hands a job to the writer thread, or executes it if the thread could not
+ *  be started.
+ */
+void HighscoreManager::queueJob(WriteJob *job)
+{
+    if(!m_writer_started)
+    {
+        if(job->m_write_xml)
+            writeXML(job->m_snapshot);
+        else
+            writeJournal(job->m_journal_data);
+        return;
+    }
+    pthread_mutex_lock(&m_mutex);
+    m_queue.push_back(WriteJob());
+    m_queue.back().m_write_xml = job->m_write_xml;
+    m_queue.back().m_journal_data.swap(job->m_journal_data);
+    m_queue.back().m_snapshot.swap(job->m_snapshot);
+    pthread_cond_signal(&m_queued_cond);
+    pthread_mutex_unlock(&m_mutex);
+}   // queueJob
+
+// -----------------------------------------------------------------------------
+/** Executes the queued jobs in order, so that the journal and the xml file
+ *  always contain the complete state.
+ */
+void *HighscoreManager::writerThread(void *obj)
+{
+    HighscoreManager *hm = (HighscoreManager*)obj;
+    pthread_mutex_lock(&hm->m_mutex);
+    while(true)
+    {
+        while(hm->m_queue.empty() && !hm->m_quit)
+            pthread_cond_wait(&hm->m_queued_cond, &hm->m_mutex);
+        if(hm->m_queue.empty())
+            break;
+        WriteJob job;
+        job.m_write_xml = hm->m_queue.front().m_write_xml;
+        job.m_journal_data.swap(hm->m_queue.front().m_journal_data);
+        job.m_snapshot.swap(hm->m_queue.front().m_snapshot);
+        hm->m_queue.pop_front();
+        pthread_mutex_unlock(&hm->m_mutex);
+
+        if(job.m_write_xml)
+            hm->writeXML(job.m_snapshot);
+        else
+            hm->writeJournal(job.m_journal_data);
+
+        pthread_mutex_lock(&hm->m_mutex);
+    }
+    pthread_mutex_unlock(&hm->m_mutex);
+    return NULL;
+}   // writerThread
+
+// -----------------------------------------------------------------------------
+/** Appends encoded entries to the journal, creating it if necessary. Called
+ *  from the writer thread.
+ */
+void HighscoreManager::writeJournal(const std::string &data)
 {
     // Print error message only once
     if(!m_can_write) return;
 
+    FILE *fd = fopen(m_journal_filename.c_str(), "ab");
+    if(fd)
+        fseek(fd, 0, SEEK_END);
+    if(fd && ftell(fd)==0)
+    {
+        fwrite(JOURNAL_MAGIC, 1, 4, fd);
+        unsigned char version[4];
+        for(unsigned int i=0; i<4; i++)
+            version[i] = (unsigned char)((JOURNAL_VERSION >> (8*i)) & 0xff);
+        fwrite(version, 1, 4, fd);
+    }
+    if(!fd || fwrite(data.c_str(), 1, data.size(), fd)!=data.size())
+    {
+        Log::error("Highscore Manager", "Problems saving highscores in '%s'",
+                   m_journal_filename.c_str());
+        m_can_write = false;
+    }
+    if(fd)
+        fclose(fd);
+}   // writeJournal
+
+// -----------------------------------------------------------------------------
+/** Writes all entries to a temporary file which then replaces the xml file,
+ *  and deletes the journal. Called from the writer thread.
+ */
+void HighscoreManager::writeXML(const std::vector<Highscores> &snapshot)
+{
+    // Print error message only once
+    if(!m_can_write) return;
+
+    const std::string tmp_filename = m_filename + ".new";
     try
     {
-        UTFWriter highscore_file(m_filename.c_str());
+        UTFWriter highscore_file(tmp_filename.c_str());
         highscore_file << L"<?xml version=\"1.0\"?>\n";
         highscore_file << L"<highscores version=\"" << CURRENT_HSCORE_FILE_VERSION << "\">\n";
 
-        for(unsigned int i=0; i<m_all_scores.size(); i++)
+        for(unsigned int i=0; i<snapshot.size(); i++)
         {
-            m_all_scores[i]->writeEntry(highscore_file);
+            snapshot[i].writeEntry(highscore_file);
         }
         highscore_file << L"</highscores>\n";
         highscore_file.close();
@@ -166,9 +392,19 @@ void HighscoreManager::saveHighscores()
         Log::error("Highscore Manager","Problems saving highscores in '%s'\n", m_filename.c_str());
         puts(e.what());
         m_can_write=false;
+        return;
     }
-
-}   // saveHighscores
+    // rename does not replace an existing file on windows
+    remove(m_filename.c_str());
+    if(rename(tmp_filename.c_str(), m_filename.c_str())!=0)
+    {
+        Log::error("Highscore Manager", "Could not rename '%s' to '%s'.",
+                   tmp_filename.c_str(), m_filename.c_str());
+        m_can_write = false;
+        return;
+    }
+    remove(m_journal_filename.c_str());
+}   // writeXML
 
 // -----------------------------------------------------------------------------
 /*
@@ -182,19 +418,15 @@ Highscores* HighscoreManager::getHighscores(const Highscores::HighscoreType &hig
                                             const int number_of_laps,
                                             const bool reverse)
 {
-    Highscores *highscores = 0;
-
     // See if we already have a record for this type
-    for(type_all_scores::iterator i  = m_all_scores.begin();
-                                  i != m_all_scores.end();  i++)
-    {
-        if((*i)->matches(highscore_type, num_karts, difficulty, trackName,
-                         number_of_laps, reverse) )
-        {
-            // we found one entry for this kind of race, return it
-            return (*i);
-        }
-    }   // for i in m_all_scores
+    Highscores *&highscores = m_index[Highscores::getKey(highscore_type,
+                                                         num_karts,
+                                                         difficulty,
+                                                         trackName,
+                                                         number_of_laps,
+                                                         reverse)];
+    if(highscores)
+        return highscores;
 
     // we don't have an entry for such a race currently. Create one.
     highscores = new Highscores(highscore_type, num_karts, difficulty,
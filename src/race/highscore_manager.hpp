@@ -19,31 +19,74 @@
 #ifndef HEADER_HIGHSCORE_MANAGER_HPP
 #define HEADER_HIGHSCORE_MANAGER_HPP
 
+#include <deque>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+
+#include <pthread.h>
 
 #include "race/highscores.hpp"
+#include "utils/no_copy.hpp"
 
 /**
   * This class reads and writes the 'highscores.xml' file, and also takes
   * care of dealing with new records. One 'HighscoreEntry' object is created
   * for each highscore entry.
+  * Entries are indexed by the kind of race they are for. Saving after a
+  * race only appends the changed entries to a binary journal next to the
+  * xml file, which is merged into the xml file when the manager is deleted
+  * or when the journal gets long. All file access is done by a separate
+  * thread, so saving never blocks the game.
   * \ingroup race
   */
-class HighscoreManager
+class HighscoreManager : public NoCopy
 {
 public:
 private:
     static const unsigned int CURRENT_HSCORE_FILE_VERSION;
+    /** Number of entries appended to the journal after which the xml file
+     *  is rewritten. */
+    static const unsigned int MAX_JOURNAL_ENTRIES = 64;
     typedef std::vector<Highscores*> type_all_scores;
     type_all_scores m_all_scores;
 
+    /** All entries indexed by Highscores::getKey. */
+    std::unordered_map<std::string, Highscores*> m_index;
+
     std::string m_filename;
+    std::string m_journal_filename;
     bool        m_can_write;
 
-    void loadHighscores();
+    /** Number of entries in the journal. */
+    unsigned int m_journal_entries;
+
+    /** A job for the writer thread: data to append to the journal, or the
+     *  entries to write to the xml file, which empties the journal. */
+    struct WriteJob
+    {
+        bool                    m_write_xml;
+        std::string             m_journal_data;
+        std::vector<Highscores> m_snapshot;
+    };   // WriteJob
+
+    std::deque<WriteJob> m_queue;
+    bool                 m_quit;
+    bool                 m_writer_started;
+    pthread_t            m_writer_thread;
+    pthread_mutex_t      m_mutex;
+    pthread_cond_t       m_queued_cond;
+
+    bool loadHighscores();
+    bool loadJournal();
     void setFilename();
+    void addEntry(Highscores *highscores);
+    void compact();
+    void queueJob(WriteJob *job);
+    void writeXML(const std::vector<Highscores> &snapshot);
+    void writeJournal(const std::string &data);
+    static void *writerThread(void *obj);
 
 public:
                 HighscoreManager();
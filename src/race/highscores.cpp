@@ -21,9 +21,12 @@
 #include "io/utf_writer.hpp"
 #include "io/xml_node.hpp"
 #include "race/race_manager.hpp"
+#include "utils/string_utils.hpp"
 
 #include <stdexcept>
 #include <fstream>
+#include <stdint.h>
+#include <string.h>
 
 // -----------------------------------------------------------------------------
 Highscores::Highscores(const HighscoreType &highscore_type,
@@ -39,6 +42,7 @@ Highscores::Highscores(const HighscoreType &highscore_type,
     m_difficulty      = difficulty;
     m_number_of_laps  = number_of_laps;
     m_reverse         = reverse;
+    m_dirty           = false;
 
     for(int i=0; i<HIGHSCORE_LEN; i++)
     {
@@ -56,6 +60,7 @@ Highscores::Highscores(const XMLNode &node)
     m_difficulty      = -1;
     m_number_of_laps  = -1;
     m_reverse         = false;
+    m_dirty           = false;
 
     for(int i=0; i<HIGHSCORE_LEN; i++)
     {
@@ -105,7 +110,7 @@ void Highscores::readEntry(const XMLNode &node)
  *  resulting in empty entries here.
  *  \param writer The file stream to write the data to.
  */
-void Highscores::writeEntry(UTFWriter &writer)
+void Highscores::writeEntry(UTFWriter &writer) const
 {
     // Only
     bool one_is_set = false;
@@ -134,6 +139,119 @@ void Highscores::writeEntry(UTFWriter &writer)
     writer << L"  </highscore>\n";
 }   // writeEntry
 
+// -----------------------------------------------------------------------------
+namespace
+{
+    void addInt(std::string *data, int32_t n)
+    {
+        for(unsigned int i=0; i<4; i++)
+            data->push_back((char)(((uint32_t)n >> (8*i)) & 0xff));
+    }   // addInt
+    // -------------------------------------------------------------------------
+    void addString(std::string *data, const std::string &s)
+    {
+        addInt(data, (int32_t)s.size());
+        data->append(s);
+    }   // addString
+    // -------------------------------------------------------------------------
+    bool getInt(const std::string &data, size_t *offset, int32_t *n)
+    {
+        if(*offset+4 > data.size()) return false;
+        uint32_t u = 0;
+        for(unsigned int i=0; i<4; i++)
+            u |= (uint32_t)(uint8_t)data[*offset+i] << (8*i);
+        *n = (int32_t)u;
+        *offset += 4;
+        return true;
+    }   // getInt
+    // -------------------------------------------------------------------------
+    bool getString(const std::string &data, size_t *offset, std::string *s)
+    {
+        int32_t len;
+        if(!getInt(data, offset, &len) || len<0 ||
+           *offset+len > data.size())
+            return false;
+        s->assign(data, *offset, len);
+        *offset += len;
+        return true;
+    }   // getString
+}   // namespace
+
+// -----------------------------------------------------------------------------
+/** Appends a binary representation of this entry (independent of the size
+ *  of wchar_t and of the byte order) to a string, used by the highscore
+ *  journal.
+ */
+void Highscores::encode(std::string *data) const
+{
+    addString(data, m_track);
+    addString(data, m_highscore_type);
+    addInt(data, m_number_of_karts);
+    addInt(data, m_difficulty);
+    addInt(data, m_number_of_laps);
+    addInt(data, m_reverse ? 1 : 0);
+    for(int i=0; i<HIGHSCORE_LEN; i++)
+    {
+        int32_t time;
+        memcpy(&time, &m_time[i], sizeof(time));
+        addInt(data, time);
+        addString(data, m_kart_name[i]);
+        addString(data, StringUtils::wide_to_utf8(m_name[i].c_str()));
+    }
+}   // encode
+
+// -----------------------------------------------------------------------------
+/** Creates an entry from the data written by encode.
+ *  \param data The encoded data.
+ *  \param offset Offset to read from, on return the offset after the entry.
+ *  eturn The entry, or NULL if the data is truncated.
+ */
+Highscores *Highscores::decode(const std::string &data, size_t *offset)
+{
+    std::string track, type;
+    int32_t num_karts, difficulty, laps, reverse;
+    if(!getString(data, offset, &track    ) ||
+       !getString(data, offset, &type     ) ||
+       !getInt   (data, offset, &num_karts) ||
+       !getInt   (data, offset, &difficulty) ||
+       !getInt   (data, offset, &laps     ) ||
+       !getInt   (data, offset, &reverse  )    )
+        return NULL;
+
+    Highscores *highscores =
+        new Highscores(type, num_karts, (RaceManager::Difficulty)difficulty,
+                       track, laps, reverse!=0);
+    for(int i=0; i<HIGHSCORE_LEN; i++)
+    {
+        int32_t time;
+        std::string name;
+        if(!getInt   (data, offset, &time                         ) ||
+           !getString(data, offset, &highscores->m_kart_name[i]) ||
+           !getString(data, offset, &name                         )    )
+        {
+            delete highscores;
+            return NULL;
+        }
+        memcpy(&highscores->m_time[i], &time, sizeof(time));
+        highscores->m_name[i] = StringUtils::utf8_to_wide(name.c_str());
+    }
+    return highscores;
+}   // decode
+
+// -----------------------------------------------------------------------------
+/** Returns the key identifying the entry for a particular kind of race. */
+std::string Highscores::getKey(const HighscoreType &highscore_type,
+                               int num_karts, int difficulty,
+                               const std::string &track,
+                               const int number_of_laps, const bool reverse)
+{
+    return highscore_type + "|" + track + "|"
+         + StringUtils::toString(num_karts)      + "|"
+         + StringUtils::toString(difficulty)     + "|"
+         + StringUtils::toString(number_of_laps) + "|"
+         + (reverse ? "r" : "f");
+}   // getKey
+
 // -----------------------------------------------------------------------------
 int Highscores::matches(const HighscoreType &highscore_type,
                         int num_karts, const RaceManager::Difficulty &difficulty,
@@ -191,6 +309,7 @@ int Highscores::addData(const std::string& kart_name,
         m_name[position]      = name;
         m_time[position]      = time;
         m_kart_name[position] = kart_name;
+        m_dirty               = true;
     }
 
     return position+1;
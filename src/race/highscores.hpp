@@ -50,6 +50,8 @@ private:
     std::string         m_kart_name[HIGHSCORE_LEN];
     irr::core::stringw  m_name[HIGHSCORE_LEN];
     float               m_time[HIGHSCORE_LEN];
+    /** True if an entry was added since the last save. */
+    bool                m_dirty;
 public:
     /** Creates a new entry
       */
@@ -62,7 +64,13 @@ public:
     Highscores (const XMLNode &node);
 
     void readEntry (const XMLNode &node);
-    void writeEntry(UTFWriter &writer);
+    void writeEntry(UTFWriter &writer) const;
+    void encode    (std::string *data) const;
+    static Highscores *decode(const std::string &data, size_t *offset);
+    static std::string getKey(const HighscoreType &highscore_type,
+                              int num_karts, int difficulty,
+                              const std::string &track,
+                              const int number_of_laps, const bool reverse);
     int  matches   (const HighscoreType &highscore_type, int num_karts,
                     const RaceManager::Difficulty &difficulty,
                     const std::string &track, const int number_of_laps,
@@ -72,6 +80,18 @@ public:
     int  getNumberEntries() const;
     void getEntry  (int number, std::string &kart_name,
                     irr::core::stringw &name, float *const time) const;
+    // ------------------------------------------------------------------------
+    /** Returns the key the highscore manager indexes this entry by. */
+    std::string getKey() const
+    {
+        return getKey(m_highscore_type, m_number_of_karts, m_difficulty,
+                      m_track, m_number_of_laps, m_reverse);
+    }   // getKey
+    // ------------------------------------------------------------------------
+    /** True if an entry was added since setDirty(false) was called. */
+    bool isDirty() const { return m_dirty; }
+    // ------------------------------------------------------------------------
+    void setDirty(bool dirty) { m_dirty = dirty; }
 };  // Highscores
 
 #endif
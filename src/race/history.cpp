@@ -18,26 +18,216 @@
 
 #include "race/history.hpp"
 
+#include <algorithm>
+#include <assert.h>
+#include <fstream>
+#include <math.h>
+#include <set>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
 
+#include "config/hardware_stats.hpp"
 #include "io/file_manager.hpp"
+#include "main_loop.hpp"
+#include "modes/linear_world.hpp"
 #include "modes/world.hpp"
 #include "karts/abstract_kart.hpp"
 #include "physics/physics.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/track.hpp"
+#include "utils/command_line.hpp"
 #include "utils/constants.hpp"
+#include "utils/log.hpp"
+#include "utils/profiler.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 
 History* history = 0;
 
+namespace
+{
+    /** Positions are stored in millimeters. */
+    const float POSITION_SCALE = 1000.0f;
+    /** Quaternion components are stored as 16 bit fixed point values. */
+    const float ROTATION_SCALE = 32767.0f;
+
+    /** The state of a kart in the previous frame of a block, used to
+     *  encode and decode the differences. */
+    struct PreviousState
+    {
+        uint32_t m_steer, m_accel;
+        uint8_t  m_buttons;
+        int32_t  m_xyz[3];
+        int32_t  m_rotation[4];
+    };   // PreviousState
+
+    // ------------------------------------------------------------------------
+    uint32_t floatBits(float f)
+    {
+        uint32_t u;
+        memcpy(&u, &f, sizeof(u));
+        return u;
+    }   // floatBits
+
+    // ------------------------------------------------------------------------
+    float bitsFloat(uint32_t u)
+    {
+        float f;
+        memcpy(&f, &u, sizeof(f));
+        return f;
+    }   // bitsFloat
+
+    // ------------------------------------------------------------------------
+    /** Adds an unsigned value in 7 bit groups, so that small values (which
+     *  most of the differences are) only need one byte. */
+    void addVarInt(std::vector<uint8_t> *data, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            data->push_back((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        data->push_back(value);
+    }   // addVarInt
+
+    // ------------------------------------------------------------------------
+    bool getVarInt(const std::vector<uint8_t> &data, unsigned int *offset,
+                   uint32_t *value)
+    {
+        *value = 0;
+        for (unsigned int shift = 0; shift < 35; shift += 7)
+        {
+            if (*offset >= data.size())
+                return false;
+            uint8_t byte = data[(*offset)++];
+            *value |= (uint32_t)(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }   // getVarInt
+
+    // ------------------------------------------------------------------------
+    /** Adds the difference of two quantized values, mapping small negative
+     *  and positive differences to small unsigned values. */
+    void addDifference(std::vector<uint8_t> *data, int32_t value,
+                       int32_t *previous)
+    {
+        int32_t d = (int32_t)((uint32_t)value - (uint32_t)*previous);
+        addVarInt(data, ((uint32_t)d << 1) ^ (uint32_t)(d >> 31));
+        *previous = value;
+    }   // addDifference
+
+    // ------------------------------------------------------------------------
+    bool getDifference(const std::vector<uint8_t> &data, unsigned int *offset,
+                       int32_t *previous)
+    {
+        uint32_t u;
+        if (!getVarInt(data, offset, &u))
+            return false;
+        int32_t d = (int32_t)((u >> 1) ^ (0u - (u & 1)));
+        *previous = (int32_t)((uint32_t)*previous + (uint32_t)d);
+        return true;
+    }   // getDifference
+
+    // ------------------------------------------------------------------------
+    /** Reads and writes the 32 bit values of a block header, in little
+     *  endian byte order. */
+    void writeUInt32(FILE *fd, uint32_t value)
+    {
+        uint8_t b[4];
+        for (unsigned int i = 0; i < 4; i++)
+            b[i] = (value >> (8*i)) & 0xff;
+        fwrite(b, 1, 4, fd);
+    }   // writeUInt32
+
+    // ------------------------------------------------------------------------
+    bool readUInt32(FILE *fd, uint32_t *value)
+    {
+        uint8_t b[4];
+        if (fread(b, 1, 4, fd) != 4)
+            return false;
+        *value = 0;
+        for (unsigned int i = 0; i < 4; i++)
+            *value |= (uint32_t)b[i] << (8*i);
+        return true;
+    }   // readUInt32
+
+    // ------------------------------------------------------------------------
+    /** Compresses an encoded block and appends it to the file: the number
+     *  of frames, the uncompressed and the stored size, and the data (which
+     *  is not compressed if the stored size is the uncompressed size). */
+    void writeBlock(FILE *fd, const std::vector<uint8_t> &data,
+                    uint32_t num_frames)
+    {
+        std::vector<uint8_t> compressed(compressBound(data.size()));
+        uLongf size = compressed.size();
+        const bool use_compressed =
+            compress2(compressed.data(), &size, data.data(), data.size(),
+                      Z_DEFAULT_COMPRESSION) == Z_OK && size < data.size();
+        writeUInt32(fd, num_frames);
+        writeUInt32(fd, data.size());
+        if (use_compressed)
+        {
+            writeUInt32(fd, size);
+            fwrite(compressed.data(), 1, size, fd);
+        }
+        else
+        {
+            writeUInt32(fd, data.size());
+            fwrite(data.data(), 1, data.size(), fd);
+        }
+        // Keep the file complete, so that it can be copied by Save at
+        // any time, or used after a crash.
+        fflush(fd);
+    }   // writeBlock
+}   // namespace
+
 //-----------------------------------------------------------------------------
 /** Initialises the history object and sets the mode to none.
  */
 History::History()
 {
-    m_replay_mode = HISTORY_NONE;
+    m_replay_mode    = HISTORY_NONE;
+    m_current        = -1;
+    m_num_frames     = 0;
+    m_num_karts      = 0;
+    m_file           = NULL;
+    m_first_block    = 0;
+    m_writing        = false;
+    m_quit           = false;
+    m_writer_started = false;
+    m_report_written = false;
+    m_replay_start_time = 0;
+    m_replay_race_time  = 0;
+    m_replayed_frames   = 0;
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_queued_cond, NULL);
+    pthread_cond_init(&m_written_cond, NULL);
 }   // History
 
+//-----------------------------------------------------------------------------
+/** Writes all queued blocks and stops the writer thread.
+ */
+History::~History()
+{
+    if (m_writer_started)
+    {
+        pthread_mutex_lock(&m_mutex);
+        m_quit = true;
+        pthread_cond_signal(&m_queued_cond);
+        pthread_mutex_unlock(&m_mutex);
+        pthread_join(m_writer_thread, NULL);
+    }
+    if (m_file)
+        fclose(m_file);
+    pthread_cond_destroy(&m_written_cond);
+    pthread_cond_destroy(&m_queued_cond);
+    pthread_mutex_destroy(&m_mutex);
+}   // ~History
+
 //-----------------------------------------------------------------------------
 /** Starts replay from the history file in the current directory.
  */
@@ -47,31 +237,46 @@ void History::startReplay()
 }   // startReplay
 
 //-----------------------------------------------------------------------------
-/** Initialise the history for a new recording. It especially allocates memory
- *  to store the history.
+/** Initialise the history for a new recording. It starts the writer thread
+ *  if necessary, and (re)creates the stream file with the race information.
  */
 void History::initRecording()
 {
-    unsigned int max_frames = (unsigned int)(  stk_config->m_replay_max_time
-                                             / stk_config->m_replay_dt      );
-    allocateMemory(max_frames);
-    m_current = -1;
-    m_wrapped = false;
-    m_size    = 0;
+    if (!m_writer_started)
+    {
+        m_writer_started = pthread_create(&m_writer_thread, NULL,
+                                          &History::writerThread, this) == 0;
+    }
+    // The blocks of the previous recording still go to the old file
+    waitForWriter();
+    if (m_file)
+        fclose(m_file);
+
+    m_stream_filename = file_manager->getUserConfigFile("history.stream");
+    m_file = fopen(m_stream_filename.c_str(), "wb");
+    if (m_file)
+        writeHeader(m_file);
+    else
+        Log::warn("History", "Can't open '%s' for writing - can't record "
+                  "the history.", m_stream_filename.c_str());
+
+    m_num_karts = race_manager->getNumberOfKarts();
+    allocateMemory(BLOCK_FRAMES);
+    m_current    = -1;
+    m_num_frames = 0;
 }   // initRecording
 
 //-----------------------------------------------------------------------------
-/** Allocates memory for the history. This is used when recording as well
- *  as when replaying (since in replay the data is read into memory first).
+/** Allocates memory for one block of the history. This is used when
+ *  recording as well as when replaying.
  *  \param number_of_frames Maximum number of frames to store.
  */
 void History::allocateMemory(int number_of_frames)
 {
     m_all_deltas.resize   (number_of_frames);
-    unsigned int num_karts = race_manager->getNumberOfKarts();
-    m_all_controls.resize (number_of_frames*num_karts);
-    m_all_xyz.resize      (number_of_frames*num_karts);
-    m_all_rotations.resize(number_of_frames*num_karts);
+    m_all_controls.resize (number_of_frames*m_num_karts);
+    m_all_xyz.resize      (number_of_frames*m_num_karts);
+    m_all_rotations.resize(number_of_frames*m_num_karts);
 }   // allocateMemory
 
 //-----------------------------------------------------------------------------
@@ -93,32 +298,210 @@ void History::update(float dt)
  */
 void History::updateSaving(float dt)
 {
-    m_current++;
-    if(m_current>=(int)m_all_deltas.size())
-    {
-        m_wrapped = true;
-        m_current = 0;
-    }
-    else
-    {
-        // m_size must be m_all_deltas.size() or smaller
-        if(m_size<(int)m_all_deltas.size())
-            m_size ++;
-    }
-    m_all_deltas[m_current] = dt;
+    if(m_num_frames>=(int)BLOCK_FRAMES)
+        flushBlock();
+
+    const int frame = m_num_frames++;
+    m_all_deltas[frame] = dt;
 
     World *world = World::getWorld();
-    unsigned int num_karts = world->getNumKarts();
-    unsigned int index     = m_current*num_karts;
-    for(unsigned int i=0; i<num_karts; i++)
+    unsigned int index = frame*m_num_karts;
+    for(unsigned int i=0; i<m_num_karts; i++)
     {
-        const AbstractKart *kart         = world->getKart(i);
+        const AbstractKart *kart = world->getKart(i);
         m_all_controls[index+i]  = kart->getControls();
         m_all_xyz[index+i]       = kart->getXYZ();
         m_all_rotations[index+i] = kart->getVisualRotation();
     }   // for i
 }   // updateSaving
 
+//-----------------------------------------------------------------------------
+/** Encodes the frames recorded so far and hands them to the writer thread
+ *  (or writes them if the thread couldn't be started).
+ */
+void History::flushBlock()
+{
+    if(m_num_frames==0)
+        return;
+
+    if(m_file)
+    {
+        std::vector<uint8_t> data;
+        encodeBlock(&data);
+        if(m_writer_started)
+        {
+            pthread_mutex_lock(&m_mutex);
+            m_queue.push_back(EncodedBlock());
+            m_queue.back().m_num_frames = m_num_frames;
+            m_queue.back().m_data.swap(data);
+            pthread_cond_signal(&m_queued_cond);
+            pthread_mutex_unlock(&m_mutex);
+        }
+        else
+            writeBlock(m_file, data, m_num_frames);
+    }
+    m_num_frames = 0;
+}   // flushBlock
+
+//-----------------------------------------------------------------------------
+/** Waits till the writer thread has written all queued blocks.
+ */
+void History::waitForWriter()
+{
+    if(!m_writer_started)
+        return;
+    pthread_mutex_lock(&m_mutex);
+    while(!m_queue.empty() || m_writing)
+        pthread_cond_wait(&m_written_cond, &m_mutex);
+    pthread_mutex_unlock(&m_mutex);
+}   // waitForWriter
+
+//-----------------------------------------------------------------------------
+/** The writer thread, which compresses the queued blocks and appends them
+ *  to the stream file.
+ *  \param obj The history object.
+ */
+void *History::writerThread(void *obj)
+{
+    History *h = (History*)obj;
+    pthread_mutex_lock(&h->m_mutex);
+    while(true)
+    {
+        while(h->m_queue.empty() && !h->m_quit)
+            pthread_cond_wait(&h->m_queued_cond, &h->m_mutex);
+        if(h->m_queue.empty())
+            break;
+        EncodedBlock block;
+        block.m_num_frames = h->m_queue.front().m_num_frames;
+        block.m_data.swap(h->m_queue.front().m_data);
+        h->m_queue.pop_front();
+        h->m_writing = true;
+        pthread_mutex_unlock(&h->m_mutex);
+
+        // The file is only changed by initRecording after waiting for
+        // this thread, so it can be used without the lock.
+        writeBlock(h->m_file, block.m_data, block.m_num_frames);
+
+        pthread_mutex_lock(&h->m_mutex);
+        h->m_writing = false;
+        if(h->m_queue.empty())
+            pthread_cond_broadcast(&h->m_written_cond);
+    }
+    pthread_mutex_unlock(&h->m_mutex);
+    return NULL;
+}   // writerThread
+
+//-----------------------------------------------------------------------------
+/** Encodes the frames of the current block. The time steps and controls
+ *  are stored lossless as xor with the previous frame, positions and
+ *  rotations are quantized and stored as differences to the previous
+ *  frame. Each block starts from zero, so blocks can be decoded
+ *  independently.
+ *  \param data On return the encoded block.
+ */
+void History::encodeBlock(std::vector<uint8_t> *data) const
+{
+    data->clear();
+    data->reserve(m_num_frames*(4+m_num_karts*12));
+    uint32_t previous_delta = 0;
+    std::vector<PreviousState> previous(m_num_karts);
+    memset(previous.data(), 0, previous.size()*sizeof(PreviousState));
+
+    for(int i=0; i<m_num_frames; i++)
+    {
+        uint32_t delta = floatBits(m_all_deltas[i]);
+        addVarInt(data, delta ^ previous_delta);
+        previous_delta = delta;
+        for(unsigned int k=0; k<m_num_karts; k++)
+        {
+            const unsigned int index = i*m_num_karts+k;
+            PreviousState &p = previous[k];
+            const KartControl &control = m_all_controls[index];
+
+            uint32_t steer = floatBits(control.m_steer);
+            uint32_t accel = floatBits(control.m_accel);
+            uint8_t buttons = (uint8_t)control.getButtonsCompressed();
+            addVarInt(data, steer ^ p.m_steer);
+            addVarInt(data, accel ^ p.m_accel);
+            data->push_back(buttons ^ p.m_buttons);
+            p.m_steer   = steer;
+            p.m_accel   = accel;
+            p.m_buttons = buttons;
+
+            const Vec3 &xyz = m_all_xyz[index];
+            const float position[3] = { xyz.getX(), xyz.getY(), xyz.getZ() };
+            for(unsigned int j=0; j<3; j++)
+                addDifference(data,
+                              (int32_t)lrintf(position[j]*POSITION_SCALE),
+                              &p.m_xyz[j]);
+
+            const btQuaternion &q = m_all_rotations[index];
+            const float rotation[4] = { q.getX(), q.getY(), q.getZ(),
+                                        q.getW() };
+            for(unsigned int j=0; j<4; j++)
+                addDifference(data,
+                              (int32_t)lrintf(rotation[j]*ROTATION_SCALE),
+                              &p.m_rotation[j]);
+        }   // for k<m_num_karts
+    }   // for i<m_num_frames
+}   // encodeBlock
+
+//-----------------------------------------------------------------------------
+/** Decodes a block encoded with encodeBlock into the arrays. m_num_frames
+ *  must be set to the number of frames in the block.
+ *  \return False if the data is truncated.
+ */
+bool History::decodeBlock(const std::vector<uint8_t> &data)
+{
+    allocateMemory(m_num_frames);
+    unsigned int offset = 0;
+    uint32_t delta = 0;
+    std::vector<PreviousState> previous(m_num_karts);
+    memset(previous.data(), 0, previous.size()*sizeof(PreviousState));
+
+    for(int i=0; i<m_num_frames; i++)
+    {
+        uint32_t u;
+        if(!getVarInt(data, &offset, &u))
+            return false;
+        delta ^= u;
+        m_all_deltas[i] = bitsFloat(delta);
+        for(unsigned int k=0; k<m_num_karts; k++)
+        {
+            const unsigned int index = i*m_num_karts+k;
+            PreviousState &p = previous[k];
+            KartControl &control = m_all_controls[index];
+
+            if(!getVarInt(data, &offset, &u))
+                return false;
+            p.m_steer ^= u;
+            if(!getVarInt(data, &offset, &u) || offset>=data.size())
+                return false;
+            p.m_accel ^= u;
+            p.m_buttons ^= data[offset++];
+            control.m_steer = bitsFloat(p.m_steer);
+            control.m_accel = bitsFloat(p.m_accel);
+            control.setButtonsCompressed(char(p.m_buttons));
+
+            for(unsigned int j=0; j<3; j++)
+                if(!getDifference(data, &offset, &p.m_xyz[j]))
+                    return false;
+            for(unsigned int j=0; j<4; j++)
+                if(!getDifference(data, &offset, &p.m_rotation[j]))
+                    return false;
+            m_all_xyz[index] = Vec3(p.m_xyz[0] / POSITION_SCALE,
+                                    p.m_xyz[1] / POSITION_SCALE,
+                                    p.m_xyz[2] / POSITION_SCALE);
+            btQuaternion q(p.m_rotation[0] / ROTATION_SCALE,
+                           p.m_rotation[1] / ROTATION_SCALE,
+                           p.m_rotation[2] / ROTATION_SCALE,
+                           p.m_rotation[3] / ROTATION_SCALE);
+            m_all_rotations[index] = q.normalized();
+        }   // for k<m_num_karts
+    }   // for i<m_num_frames
+    return true;
+}   // decodeBlock
+
 //-----------------------------------------------------------------------------
 /** Sets the kart position and controls to the recorded history value.
  *  \param dt Time step size.
@@ -127,19 +510,35 @@ void History::updateReplay(float dt)
 {
     m_current++;
     World *world = World::getWorld();
-    if(m_current>=(int)m_all_deltas.size())
+    if(m_current>=m_num_frames)
     {
-        Log::info("History", "Replay finished");
         m_current = 0;
-        // Note that for physics replay all physics parameters
-        // need to be reset, e.g. velocity, ...
-        world->reset();
+        if(!readBlock())
+        {
+            Log::info("History", "Replay finished");
+            if(isReportMode())
+            {
+                writeReport();
+                main_loop->abort();
+                return;
+            }
+            fseek(m_file, m_first_block, SEEK_SET);
+            readBlock();
+            // Note that for physics replay all physics parameters
+            // need to be reset, e.g. velocity, ...
+            world->reset();
+        }
     }
+    if(m_replayed_frames==0)
+        m_replay_start_time = StkTime::getRealTime();
+    m_replayed_frames++;
+    m_replay_race_time += m_all_deltas[m_current];
+
     unsigned int num_karts = world->getNumKarts();
-    for(unsigned k=0; k<num_karts; k++)
+    for(unsigned k=0; k<num_karts && k<m_num_karts; k++)
     {
         AbstractKart *kart = world->getKart(k);
-        unsigned int index=m_current*num_karts+k;
+        unsigned int index=m_current*m_num_karts+k;
         if(m_replay_mode==HISTORY_POSITION)
         {
             kart->setXYZ(m_all_xyz[index]);
@@ -147,96 +546,194 @@ void History::updateReplay(float dt)
         }
         else
         {
+            // The recorded position was taken at the same point of the
+            // frame, so this is how far the simulation has drifted.
+            const float d = (kart->getXYZ() - m_all_xyz[index]).length();
+            m_max_divergence[k] = std::max(m_max_divergence[k], d);
+            m_sum_divergence[k] += d;
             kart->setControls(m_all_controls[index]);
         }
     }
 }   // updateReplay
 
 //-----------------------------------------------------------------------------
-/** Saves the history stored in the internal data structures into a file called
- *  history.dat.
+/** Writes the report of a replay as JSON: the race setup, the replayed and
+ *  the real time, the results and the divergence from the recorded
+ *  positions of each kart, and the time spent in each profiler marker.
  */
-void History::Save()
+void History::writeReport()
 {
-    FILE *fd = fopen("history.dat","w");
-    if(fd)
-        Log::info("History", "Saved in ./history.dat.");
-    else
+    profiler.setAccumulateTotals(false);
+    std::ofstream out(m_report_file.c_str());
+    if(!out.is_open())
     {
-        std::string fn = file_manager->getUserConfigFile("history.dat");
-        fd = fopen(fn.c_str(), "w");
-        if(fd)
-            Log::info("History", "Saved in '%s'.", fn.c_str());
+        Log::error("History", "Can't open report file '%s'.",
+                   m_report_file.c_str());
+        return;
     }
-    if(!fd)
+
+    World *world = World::getWorld();
+    LinearWorld *linear_world = dynamic_cast<LinearWorld*>(world);
+    const float real_time =
+        (float)(StkTime::getRealTime() - m_replay_start_time);
+
+    out << "{\n";
+    out << "  \"history\": \"" << m_replay_file << "\",\n";
+    out << "  \"track\": \"" << world->getTrack()->getIdent() << "\",\n";
+    out << "  \"mode\": \""
+        << (m_replay_mode==HISTORY_POSITION ? "position" : "physics")
+        << "\",\n";
+    out << "  \"frames\": " << m_replayed_frames << ",\n";
+    out << "  \"race_time\": " << m_replay_race_time << ",\n";
+    out << "  \"real_time\": " << real_time << ",\n";
+    out << "  \"karts\": [\n";
+    for(unsigned int k=0; k<m_num_karts && k<world->getNumKarts(); k++)
     {
-        Log::info("History", "Can't open history.dat file for writing - can't save history.");
-        Log::info("History", "Make sure history.dat in the current directory "
-                             "or the config directory is writable.");
-        return;
+        const AbstractKart *kart = world->getKart(k);
+        out << "    {\"ident\": \"" << kart->getIdent() << "\"";
+        if(linear_world)
+        {
+            out << ", \"laps\": " << linear_world->getKartLaps(k)
+                << ", \"time_at_last_lap\": "
+                << linear_world->getTimeAtLapForKart(k);
+        }
+        out << ", \"finished\": "
+            << (kart->hasFinishedRace() ? "true" : "false");
+        if(kart->hasFinishedRace())
+            out << ", \"finish_time\": " << kart->getFinishTime();
+        out << ", \"max_divergence\": " << m_max_divergence[k]
+            << ", \"mean_divergence\": "
+            << (m_replayed_frames > 0 ? m_sum_divergence[k]/m_replayed_frames
+                                      : 0.0f)
+            << "}" << (k+1 < m_num_karts ? "," : "") << "\n";
     }
+    out << "  ],\n";
+    out << "  \"subsystems\": {\n";
+    const Profiler::MarkerTotals &totals = profiler.getMarkerTotals();
+    for (Profiler::MarkerTotals::const_iterator it = totals.begin();
+         it != totals.end(); it++)
+    {
+        out << "    \"" << it->first << "\": {\"calls\": "
+            << it->second.m_count << ", \"total_ms\": " << it->second.m_time
+            << ", \"per_frame_ms\": "
+            << (m_replayed_frames > 0 ? it->second.m_time/m_replayed_frames
+                                      : 0.0)
+            << "}" << (it == --totals.end() ? "" : ",") << "\n";
+    }
+    out << "  }\n";
+    out << "}\n";
+    m_report_written = out.good();
+    Log::info("History", "Report written to '%s'.", m_report_file.c_str());
+}   // writeReport
 
-    World *world   = World::getWorld();
-    const int num_karts = world->getNumKarts();
+//-----------------------------------------------------------------------------
+/** Writes the race information at the start of a history file. It is
+ *  followed by the blocks.
+ */
+void History::writeHeader(FILE *fd) const
+{
+    const unsigned int num_karts = race_manager->getNumberOfKarts();
     fprintf(fd, "Version:  %s\n",   STK_VERSION);
     fprintf(fd, "numkarts: %d\n",   num_karts);
     fprintf(fd, "numplayers: %d\n", race_manager->getNumPlayers());
     fprintf(fd, "difficulty: %d\n", race_manager->getDifficulty());
-    fprintf(fd, "track: %s\n",      world->getTrack()->getIdent().c_str());
-
-    assert(num_karts > 0);
+    fprintf(fd, "track: %s\n",      race_manager->getTrackName().c_str());
+    for(unsigned int k=0; k<num_karts; k++)
+    {
+        fprintf(fd, "model %d: %s\n", k,
+                race_manager->getKartIdent(k).c_str());
+    }
+    fprintf(fd, "blocks:\n");
+    fflush(fd);
+}   // writeHeader
 
-    int k;
-    for(k=0; k<num_karts; k++)
+//-----------------------------------------------------------------------------
+/** Reads the next block of a replayed history.
+ *  \return False if the end of the file was reached (or the block is
+ *          damaged).
+ */
+bool History::readBlock()
+{
+    uint32_t num_frames, raw_size, stored_size;
+    if(!readUInt32(m_file, &num_frames) || !readUInt32(m_file, &raw_size) ||
+       !readUInt32(m_file, &stored_size) || num_frames==0 ||
+       num_frames>BLOCK_FRAMES || stored_size>raw_size)
+        return false;
+
+    std::vector<uint8_t> stored(stored_size);
+    if(fread(stored.data(), 1, stored_size, m_file)!=stored_size)
+        return false;
+    std::vector<uint8_t> raw;
+    if(stored_size==raw_size)
+        raw.swap(stored);
+    else
     {
-        fprintf(fd, "model %d: %s\n",k, world->getKart(k)->getIdent().c_str());
+        raw.resize(raw_size);
+        uLongf size = raw_size;
+        if(uncompress(raw.data(), &size, stored.data(), stored_size)!=Z_OK ||
+           size!=raw_size)
+            return false;
     }
-    fprintf(fd, "size:     %d\n", m_size);
+    m_num_frames = num_frames;
+    return decodeBlock(raw);
+}   // readBlock
 
-    int index = m_wrapped ? m_current : 0;
-    for(int i=0; i<m_size; i++)
+//-----------------------------------------------------------------------------
+/** Saves the history recorded so far into a file called history.dat. The
+ *  blocks are already in the stream file, so only the last, incomplete
+ *  block has to be written before the stream file is copied.
+ */
+void History::Save()
+{
+    flushBlock();
+    waitForWriter();
+    if(!m_file)
     {
-        fprintf(fd, "delta: %f\n",m_all_deltas[index]);
-        index=(index+1)%m_size;
+        Log::info("History", "No history was recorded - can't save history.");
+        return;
     }
 
-    index = num_karts * (m_wrapped ? m_current : 0);
-    for(int i=0; i<m_size; i++)
+    if(file_manager->copyFile(m_stream_filename, "history.dat"))
     {
-        for(int k=0; k<num_karts; k++)
-        {
-            fprintf(fd, "%f %f %d  %f %f %f  %f %f %f %f\n",
-                    m_all_controls[index+k].m_steer,
-                    m_all_controls[index+k].m_accel,
-                    m_all_controls[index+k].getButtonsCompressed(),
-                    m_all_xyz[index+k].getX(), m_all_xyz[index+k].getY(),
-                    m_all_xyz[index+k].getZ(),
-                    m_all_rotations[index+k].getX(),
-                    m_all_rotations[index+k].getY(),
-                    m_all_rotations[index+k].getZ(),
-                    m_all_rotations[index+k].getW()  );
-        }   // for i
-        index=(index+num_karts)%(num_karts*m_size);
-    }   // for k
-    fprintf(fd, "History file end.\n");
-    fclose(fd);
+        Log::info("History", "Saved in ./history.dat.");
+        return;
+    }
+    std::string fn = file_manager->getUserConfigFile("history.dat");
+    if(file_manager->copyFile(m_stream_filename, fn))
+    {
+        Log::info("History", "Saved in '%s'.", fn.c_str());
+        return;
+    }
+    Log::info("History", "Can't open history.dat file for writing - can't save history.");
+    Log::info("History", "Make sure history.dat in the current directory "
+                         "or the config directory is writable.");
 }   // Save
 
 //-----------------------------------------------------------------------------
-/** Loads a history from history.dat in the current directory.
+/** Loads a history from history.dat in the current directory. Only the race
+ *  information and the first block are read, the other blocks are read
+ *  while the history is replayed.
  */
 void History::Load()
 {
     char s[1024], s1[1024];
     int  n;
 
-    FILE *fd = fopen("history.dat","r");
-    if(fd)
+    FILE *fd = NULL;
+    if(!m_replay_file.empty())
+    {
+        fd = fopen(m_replay_file.c_str(), "rb");
+        if(!fd)
+            Log::fatal("History", "Could not open '%s'.",
+                       m_replay_file.c_str());
+        Log::info("History", "Reading '%s'.", m_replay_file.c_str());
+    }
+    else if((fd = fopen("history.dat","rb")) != NULL)
         Log::info("History", "Reading ./history.dat");
     else
     {
         std::string fn = file_manager->getUserConfigFile("history.dat");
-        fd = fopen(fn.c_str(), "r");
+        fd = fopen(fn.c_str(), "rb");
         if(fd)
             Log::info("History", "Reading '%s'.", fn.c_str());
     }
@@ -290,39 +787,132 @@ void History::Load()
     }   // for i<nKarts
     // FIXME: The model information is currently ignored
     fgets(s, 1023, fd);
-    if(sscanf(s,"size: %d",&m_size)!=1)
-        Log::fatal("History", "Number of records not found in history file.");
-
-    allocateMemory(m_size);
+    if(strncmp(s, "blocks:", 7)!=0)
+        Log::fatal("History", "No blocks found in history file (histories "
+                   "saved in the old text format can't be replayed).");
+
+    m_num_karts   = num_karts;
+    m_file        = fd;
+    m_first_block = ftell(fd);
+    if(!readBlock())
+        Log::fatal("History", "No frames found in history file.");
     m_current = -1;
 
-    for(int i=0; i<m_size; i++)
+    m_replayed_frames  = 0;
+    m_replay_race_time = 0;
+    m_max_divergence.assign(m_num_karts, 0.0f);
+    m_sum_divergence.assign(m_num_karts, 0.0f);
+    if(isReportMode())
+        profiler.setAccumulateTotals(true);
+}   // Load
+
+//-----------------------------------------------------------------------------
+namespace
+{
+    /** The state shared by the threads of runBatch. */
+    struct BatchState
     {
-        fgets(s, 1023, fd);
-        sscanf(s, "delta: %f\n",&m_all_deltas[i]);
-    }
+        std::vector<std::string> m_files;
+        unsigned int             m_next;
+        unsigned int             m_failed;
+        pthread_mutex_t          m_mutex;
+    };   // BatchState
+}   // namespace
 
-    for(int i=0; i<m_size; i++)
+//-----------------------------------------------------------------------------
+/** A thread of runBatch: replays the next history file in a new STK process
+ *  until all files are done.
+ *  \param obj The BatchState.
+ */
+void *History::batchThread(void *obj)
+{
+    BatchState *state = (BatchState*)obj;
+    while(true)
     {
-        for(unsigned int k=0; k<num_karts; k++)
+        pthread_mutex_lock(&state->m_mutex);
+        if(state->m_next>=state->m_files.size())
         {
-            unsigned int index = num_karts * i+k;
-            fgets(s, 1023, fd);
-            int buttonsCompressed;
-            float x,y,z,rx,ry,rz,rw;
-            sscanf(s, "%f %f %d  %f %f %f  %f %f %f %f\n",
-                    &m_all_controls[index].m_steer,
-                    &m_all_controls[index].m_accel,
-                    &buttonsCompressed,
-                    &x, &y, &z,
-                    &rx, &ry, &rz, &rw
-                    );
-            m_all_xyz[index]       = Vec3(x,y,z);
-            m_all_rotations[index] = btQuaternion(rx,ry,rz,rw);
-            m_all_controls[index].setButtonsCompressed(char(buttonsCompressed));
-        }   // for i
-    }   // for k
-    fprintf(fd, "History file end.\n");
-    fclose(fd);
-}   // Load
+            pthread_mutex_unlock(&state->m_mutex);
+            break;
+        }
+        const std::string file = state->m_files[state->m_next++];
+        pthread_mutex_unlock(&state->m_mutex);
+
+        const std::string cmd = "\"" + CommandLine::getExecName() + "\""
+                              + " --no-graphics --history=2"
+                              + " --history-file=" + file
+                              + " --history-report=" + file + ".json";
+        const int result = system(cmd.c_str());
+        if(result!=0)
+        {
+            Log::error("History", "Replaying '%s' failed (%d).",
+                       file.c_str(), result);
+            pthread_mutex_lock(&state->m_mutex);
+            state->m_failed++;
+            pthread_mutex_unlock(&state->m_mutex);
+        }
+        else
+            Log::info("History", "Replayed '%s'.", file.c_str());
+    }
+    return NULL;
+}   // batchThread
+
+//-----------------------------------------------------------------------------
+/** Replays all history files (*.dat) in a directory with physics, each in
+ *  its own STK process without graphics, several at the same time. Each
+ *  replay runs as fast as possible and writes a report next to its
+ *  history file (see writeReport). Since STK uses global state for the
+ *  world and all managers, separate processes are used rather than threads.
+ *  \param dir The directory with the history files.
+ *  \param jobs Number of replays to run at the same time, or 0 to use the
+ *         number of processors.
+ *  \return 0 if all replays succeeded, 1 otherwise.
+ */
+int History::runBatch(const std::string &dir, int jobs)
+{
+    std::set<std::string> files;
+    file_manager->listFiles(files, dir, /*make_full_path*/true);
 
+    BatchState state;
+    for(std::set<std::string>::const_iterator i = files.begin();
+        i != files.end(); i++)
+    {
+        if(StringUtils::hasSuffix(*i, ".dat"))
+            state.m_files.push_back(*i);
+    }
+    if(state.m_files.empty())
+    {
+        Log::error("History", "No history files (*.dat) found in '%s'.",
+                   dir.c_str());
+        return 1;
+    }
+
+    if(jobs<=0)
+        jobs = std::max(1, HardwareStats::getNumProcessors());
+    jobs = std::min(jobs, (int)state.m_files.size());
+    Log::info("History", "Replaying %d histories with %d jobs.",
+              (int)state.m_files.size(), jobs);
+
+    state.m_next   = 0;
+    state.m_failed = 0;
+    pthread_mutex_init(&state.m_mutex, NULL);
+    std::vector<pthread_t> threads(jobs);
+    int started = 0;
+    for(int i=0; i<jobs; i++)
+    {
+        if(pthread_create(&threads[started], NULL, &History::batchThread,
+                          &state) == 0)
+            started++;
+    }
+    // Do the work in this thread if no thread could be started
+    if(started==0)
+        batchThread(&state);
+    for(int i=0; i<started; i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&state.m_mutex);
+
+    Log::info("History", "%d of %d replays succeeded.",
+              (int)(state.m_files.size()-state.m_failed),
+              (int)state.m_files.size());
+    return state.m_failed==0 ? 0 : 1;
+}   // runBatch
@@ -19,21 +19,34 @@
 #ifndef HEADER_HISTORY_HPP
 #define HEADER_HISTORY_HPP
 
-#include <vector>
+#include <deque>
+#include <pthread.h>
+#include <stdio.h>
 #include <string>
+#include <vector>
 
 #include "LinearMath/btQuaternion.h"
 
 #include "karts/controller/kart_control.hpp"
 #include "utils/aligned_array.hpp"
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
 #include "utils/vec3.hpp"
 
 class Kart;
 
-/**
-  * \ingroup race
-  */
-class History
+/** Records the controls, positions and rotations of all karts in each
+ *  frame, so that a race can be replayed for debugging. The frames are
+ *  collected in blocks of at most BLOCK_FRAMES frames. A full block is
+ *  encoded (lossless controls and time steps, positions and rotations
+ *  quantized, all stored as differences to the previous frame) and handed
+ *  to a writer thread, which compresses it with zlib and appends it to a
+ *  stream file. So the length of a recording is not limited, and only one
+ *  block is kept in memory. Save() then only has to copy the stream file.
+ *  A replay reads the blocks one after the other from the file as well.
+ *  \ingroup race
+ */
+class History : public NoCopy
 {
 public:
     /** Determines which replay mode is selected:
@@ -47,21 +60,29 @@ public:
                              HISTORY_POSITION = 1,
                              HISTORY_PHYSICS  = 2 };
 private:
+    /** Maximum number of frames in one block. */
+    static const unsigned int BLOCK_FRAMES = 1024;
+
+    /** An encoded block waiting to be compressed and written. */
+    struct EncodedBlock
+    {
+        uint32_t             m_num_frames;
+        std::vector<uint8_t> m_data;
+    };   // EncodedBlock
+
     /** maximum number of history events to store. */
     HistoryReplayMode          m_replay_mode;
 
-    /** Points to the last used entry, and will wrap around. */
+    /** Index of the current frame in the current block. */
     int                        m_current;
 
-    /** True if the buffer has wrapped around. */
-    bool                       m_wrapped;
+    /** Number of frames in the current block. */
+    int                        m_num_frames;
 
-    /** Counts how many entries in the arrays are used.  So if
-     *  the buffer hasn't wrapped around, this will indicate
-     *  how many entries to save. */
-    int                        m_size;
+    /** Number of karts stored in each frame. */
+    unsigned int               m_num_karts;
 
-    /** Stores all time step sizes. */
+    /** Stores the time step sizes of the current block. */
     std::vector<float>         m_all_deltas;
 
     /** Stores the kart controls being used (for physics replay). */
@@ -76,16 +97,82 @@ private:
     /** The identities of the karts to use. */
     std::vector<std::string>  m_kart_ident;
 
+    /** The file the blocks are written to (while recording) or read
+     *  from (while replaying). */
+    FILE                      *m_file;
+
+    /** Name of the file the blocks are written to. */
+    std::string                m_stream_filename;
+
+    /** Offset of the first block in the file, used to restart a replay. */
+    long                       m_first_block;
+
+    /** Blocks not yet written by the writer thread. */
+    std::deque<EncodedBlock>   m_queue;
+
+    /** True while the writer thread writes a block. */
+    bool                       m_writing;
+
+    /** Tells the writer thread to exit. */
+    bool                       m_quit;
+
+    /** True if the writer thread was started. */
+    bool                       m_writer_started;
+
+    pthread_t                  m_writer_thread;
+    pthread_mutex_t            m_mutex;
+    /** Signals the writer thread that blocks or the exit are waiting. */
+    pthread_cond_t             m_queued_cond;
+    /** Signals that the writer thread has written all blocks. */
+    pthread_cond_t             m_written_cond;
+
+    /** The history file to replay, if empty history.dat in the current
+     *  or the config directory is used. */
+    std::string                m_replay_file;
+
+    /** If not empty, the history is replayed only once, and then a report
+     *  is written to this file and STK exits. */
+    std::string                m_report_file;
+
+    /** True if the report was written. */
+    bool                       m_report_written;
+
+    /** Real time the replay started at. */
+    double                     m_replay_start_time;
+
+    /** Sum of the replayed time steps. */
+    float                      m_replay_race_time;
+
+    /** Number of replayed frames. */
+    unsigned int               m_replayed_frames;
+
+    /** Maximum and sum of the distance between the simulated and the
+     *  recorded position of each kart in a physics replay. */
+    std::vector<float>         m_max_divergence;
+    std::vector<float>         m_sum_divergence;
+
     void  allocateMemory(int number_of_frames);
     void  updateSaving(float dt);
     void  updateReplay(float dt);
+    void  flushBlock();
+    void  waitForWriter();
+    void  writeHeader(FILE *fd) const;
+    bool  readBlock();
+    void  encodeBlock(std::vector<uint8_t> *data) const;
+    bool  decodeBlock(const std::vector<uint8_t> &data);
+    void  writeReport();
+    static void *writerThread(void *obj);
+    static void *batchThread(void *obj);
 public:
           History        ();
+         ~History        ();
     void  startReplay    ();
     void  initRecording  ();
     void  update         (float dt);
     void  Save           ();
     void  Load           ();
+    static int runBatch  (const std::string &dir, int jobs);
+
 
     // -------------------I-----------------------------------------------------
     /** Returns the identifier of the n-th kart. */
@@ -104,6 +191,19 @@ public:
     /** Enable replaying a history, enabled from the command line. */
     void  doReplayHistory(HistoryReplayMode m) {m_replay_mode = m;           }
     // ------------------------------------------------------------------------
+    /** Sets the history file to replay. */
+    void  setReplayFile(const std::string &f) { m_replay_file = f;           }
+    // ------------------------------------------------------------------------
+    /** Replays the history only once and writes a report to the file. */
+    void  setReportFile(const std::string &f) { m_report_file = f;           }
+    // ------------------------------------------------------------------------
+    /** Returns true if a report is written after replaying the history
+     *  once. The replay then runs as fast as possible. */
+    bool  isReportMode   () const { return !m_report_file.empty();          }
+    // ------------------------------------------------------------------------
+    /** Returns true if the report was written successfully. */
+    bool  isReportWritten() const { return m_report_written;                }
+    // ------------------------------------------------------------------------
     /** Returns true if the physics should not be simulated in replay mode.
      *  I.e. either no replay mode, or physics replay mode. */
     bool dontDoPhysics   () const { return m_replay_mode == HISTORY_POSITION;}
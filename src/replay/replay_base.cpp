@@ -20,6 +20,11 @@
 #include "io/file_manager.hpp"
 #include "race/race_manager.hpp"
 
+#include <algorithm>
+#include <string.h>
+
+const char ReplayBase::BINARY_MAGIC[4] = {'S', 'T', 'K', 'R'};
+
 // -----------------------------------------------------------------------------
 ReplayBase::ReplayBase()
 {
@@ -35,12 +40,120 @@ FILE* ReplayBase::openReplayFile(bool writeable)
 {
     m_filename = file_manager->getUserConfigFile(
                                        race_manager->getTrackName()+".replay");
-    FILE *fd = fopen(m_filename.c_str(), writeable ? "w" : "r");
+    // Always use binary mode: text replays only use '\n' as line ending,
+    // which is handled by fgets and sscanf on all platforms.
+    FILE *fd = fopen(m_filename.c_str(), writeable ? "wb" : "rb");
     if(!fd)
     {
         m_filename = race_manager->getTrackName()+".replay";
-        fd = fopen(m_filename.c_str(), writeable ? "w" : "r");
+        fd = fopen(m_filename.c_str(), writeable ? "wb" : "rb");
     }
     return fd;
 
 }   // openReplayFile
+
+// -----------------------------------------------------------------------------
+/** Functions to add values to the data of a binary replay file. All values
+ *  are stored in little endian byte order.
+ */
+void ReplayBase::addUInt8(std::vector<uint8_t> *data, uint8_t value)
+{
+    data->push_back(value);
+}   // addUInt8
+
+// -----------------------------------------------------------------------------
+void ReplayBase::addUInt16(std::vector<uint8_t> *data, uint16_t value)
+{
+    data->push_back(value & 0xff);
+    data->push_back(value >> 8);
+}   // addUInt16
+
+// -----------------------------------------------------------------------------
+void ReplayBase::addUInt32(std::vector<uint8_t> *data, uint32_t value)
+{
+    for (unsigned int i = 0; i < 4; i++)
+        data->push_back((value >> (8*i)) & 0xff);
+}   // addUInt32
+
+// -----------------------------------------------------------------------------
+void ReplayBase::addFloat(std::vector<uint8_t> *data, float value)
+{
+    uint32_t u;
+    memcpy(&u, &value, sizeof(u));
+    addUInt32(data, u);
+}   // addFloat
+
+// -----------------------------------------------------------------------------
+/** Adds a string (at most 255 characters) with its length. */
+void ReplayBase::addString(std::vector<uint8_t> *data,
+                           const std::string &value)
+{
+    unsigned int len = std::min((unsigned int)value.size(), 255u);
+    addUInt8(data, len);
+    data->insert(data->end(), value.begin(), value.begin()+len);
+}   // addString
+
+// -----------------------------------------------------------------------------
+/** Functions to read values from the data of a binary replay file.
+ *  \param data The data.
+ *  \param offset Offset at which to read, which is increased by the size
+ *         of the value.
+ *  \param value On return the value.
+ *  \return False if there are not enough bytes left.
+ */
+bool ReplayBase::getUInt8(const std::vector<uint8_t> &data,
+                          unsigned int *offset, uint8_t *value)
+{
+    if (*offset + 1 > data.size())
+        return false;
+    *value = data[*offset];
+    *offset += 1;
+    return true;
+}   // getUInt8
+
+// -----------------------------------------------------------------------------
+bool ReplayBase::getUInt16(const std::vector<uint8_t> &data,
+                           unsigned int *offset, uint16_t *value)
+{
+    if (*offset + 2 > data.size())
+        return false;
+    *value = data[*offset] | (data[*offset+1] << 8);
+    *offset += 2;
+    return true;
+}   // getUInt16
+
+// -----------------------------------------------------------------------------
+bool ReplayBase::getUInt32(const std::vector<uint8_t> &data,
+                           unsigned int *offset, uint32_t *value)
+{
+    if (*offset + 4 > data.size())
+        return false;
+    *value = 0;
+    for (unsigned int i = 0; i < 4; i++)
+        *value |= (uint32_t)data[*offset+i] << (8*i);
+    *offset += 4;
+    return true;
+}   // getUInt32
+
+// -----------------------------------------------------------------------------
+bool ReplayBase::getFloat(const std::vector<uint8_t> &data,
+                          unsigned int *offset, float *value)
+{
+    uint32_t u;
+    if (!getUInt32(data, offset, &u))
+        return false;
+    memcpy(value, &u, sizeof(u));
+    return true;
+}   // getFloat
+
+// -----------------------------------------------------------------------------
+bool ReplayBase::getString(const std::vector<uint8_t> &data,
+                           unsigned int *offset, std::string *value)
+{
+    uint8_t len;
+    if (!getUInt8(data, offset, &len) || *offset + len > data.size())
+        return false;
+    value->assign((const char*)&data[*offset], len);
+    *offset += len;
+    return true;
+}   // getString
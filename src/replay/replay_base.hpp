@@ -21,9 +21,11 @@
 
 #include "LinearMath/btTransform.h"
 #include "utils/no_copy.hpp"
+#include "utils/types.hpp"
 
 #include <stdio.h>
 #include <string>
+#include <vector>
 
 /**
   * \ingroup race
@@ -61,9 +63,59 @@ protected:
         float       m_time;
     };   // KartReplayEvent
 
+    // ------------------------------------------------------------------------
+    /** Binary replay files start with these four bytes. Text replay files
+     *  start with "Version:". */
+    static const char BINARY_MAGIC[4];
+
+    /** Flags in the header of a binary replay file. */
+    enum { BINARY_FLAG_COMPRESSED = 0x01 };
+
+    /** Maximum number of transform events in one chunk of a binary replay
+     *  file. A chunk also never spans more than 65 seconds, since the times
+     *  are stored as 16 bit milliseconds relative to the chunk start. */
+    static const unsigned int CHUNK_SIZE = 256;
+
+    /** Size of one quantized transform event in a chunk: time (2 bytes),
+     *  position (3*2 bytes), rotation (4*2 bytes). */
+    static const unsigned int CHUNK_EVENT_SIZE = 16;
+
+    /** Describes one chunk of transform events in a binary replay file. */
+    struct ChunkInfo
+    {
+        /** Time of the first transform event in this chunk. */
+        float    m_start_time;
+        /** Number of transform events in this chunk. */
+        uint16_t m_num_events;
+        /** Offset of the chunk relative to the end of the header. */
+        uint32_t m_offset;
+        /** Size of the chunk in the file (if it is equal to m_raw_size,
+         *  the chunk is not compressed). */
+        uint32_t m_stored_size;
+        /** Size of the uncompressed chunk. */
+        uint32_t m_raw_size;
+    };   // ChunkInfo
+
     // ------------------------------------------------------------------------
           ReplayBase();
     FILE *openReplayFile(bool writeable);
+
+    static void     addUInt8 (std::vector<uint8_t> *data, uint8_t  value);
+    static void     addUInt16(std::vector<uint8_t> *data, uint16_t value);
+    static void     addUInt32(std::vector<uint8_t> *data, uint32_t value);
+    static void     addFloat (std::vector<uint8_t> *data, float    value);
+    static void     addString(std::vector<uint8_t> *data,
+                              const std::string &value);
+    static bool     getUInt8 (const std::vector<uint8_t> &data,
+                              unsigned int *offset, uint8_t  *value);
+    static bool     getUInt16(const std::vector<uint8_t> &data,
+                              unsigned int *offset, uint16_t *value);
+    static bool     getUInt32(const std::vector<uint8_t> &data,
+                              unsigned int *offset, uint32_t *value);
+    static bool     getFloat (const std::vector<uint8_t> &data,
+                              unsigned int *offset, float    *value);
+    static bool     getString(const std::vector<uint8_t> &data,
+                              unsigned int *offset, std::string *value);
     // ----------------------------------------------------------------------
     /** Returns the filename that was opened. */
     const std::string &getReplayFilename() const { return m_filename;}
@@ -72,6 +124,9 @@ protected:
      *  that a loaded replay file can still be understood by this
      *  executable. */
     unsigned int getReplayVersion() const { return 1; }
+    // ----------------------------------------------------------------------
+    /** Returns the version number of the binary replay format. */
+    unsigned int getBinaryReplayVersion() const { return 1; }
 };   // ReplayBase
 
 #endif
@@ -26,7 +26,9 @@
 #include "tracks/track.hpp"
 
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <zlib.h>
 
 ReplayPlay *ReplayPlay::m_replay_play = NULL;
 
@@ -83,7 +85,6 @@ void ReplayPlay::update(float dt)
 void ReplayPlay::Load()
 {
     m_ghost_karts.clearAndDeleteAll();
-    char s[1024], s1[1024];
 
     FILE *fd = openReplayFile(/*writeable*/false);
     if(!fd)
@@ -96,6 +97,26 @@ void ReplayPlay::Load()
 
     Log::info("Replay", "Reading replay file '%s'.", getReplayFilename().c_str());
 
+    char magic[sizeof(BINARY_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), fd) == sizeof(magic) &&
+        memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0)
+        loadBinary(fd);
+    else
+    {
+        rewind(fd);
+        loadText(fd);
+    }
+    fclose(fd);
+}   // Load
+
+//-----------------------------------------------------------------------------
+/** Loads a replay file in the text format.
+ *  \param fd The file to read from.
+ */
+void ReplayPlay::loadText(FILE *fd)
+{
+    char s[1024], s1[1024];
+
     if (fgets(s, 1023, fd) == NULL)
         Log::fatal("Replay", "Could not read '%s'.", getReplayFilename().c_str());
 
@@ -144,9 +165,167 @@ void ReplayPlay::Load()
         readKartData(fd, s);
     }   // for k<num_ghost_karts
 
-    fprintf(fd, "Replay file end.\n");
-    fclose(fd);
-}   // Load
+}   // loadText
+
+//-----------------------------------------------------------------------------
+/** Loads a replay file in the binary format (see
+ *  ReplayRecorder::saveBinary). The magic number was already read. Only the
+ *  header is read at once, the chunks of transform events are then read
+ *  and decoded one at a time using the chunk index.
+ *  \param fd The file to read from.
+ */
+void ReplayPlay::loadBinary(FILE *fd)
+{
+    std::vector<uint8_t> prefix(8);
+    if (fread(prefix.data(), 1, prefix.size(), fd) != prefix.size())
+        Log::fatal("Replay", "Could not read '%s'.",
+                   getReplayFilename().c_str());
+    unsigned int offset = 0;
+    uint32_t version, header_size;
+    getUInt32(prefix, &offset, &version);
+    getUInt32(prefix, &offset, &header_size);
+    if (version != getBinaryReplayVersion())
+    {
+        Log::warn("Replay", "Replay is binary version '%d'", version);
+        Log::warn("Replay", "STK version is '%d'", getBinaryReplayVersion());
+        Log::warn("Replay", "We try to proceed, but it may fail.");
+    }
+
+    std::vector<uint8_t> header(header_size);
+    if (fread(header.data(), 1, header.size(), fd) != header.size())
+        Log::fatal("Replay", "Could not read header of '%s'.",
+                   getReplayFilename().c_str());
+    const long chunk_start = ftell(fd);
+
+    offset = 0;
+    uint8_t flags, difficulty, num_laps, num_karts;
+    std::string track;
+    if (!getUInt8 (header, &offset, &flags     ) ||
+        !getUInt8 (header, &offset, &difficulty) ||
+        !getUInt8 (header, &offset, &num_laps  ) ||
+        !getString(header, &offset, &track     ) ||
+        !getUInt8 (header, &offset, &num_karts )    )
+        Log::fatal("Replay", "Invalid header in replay file '%s'.",
+                   getReplayFilename().c_str());
+
+    if(race_manager->getDifficulty()!=(RaceManager::Difficulty)difficulty)
+        Log::warn("Replay", "Difficulty of replay is '%d', "
+                  "while '%d' is selected.",
+                  race_manager->getDifficulty(), difficulty);
+    assert(track==race_manager->getTrackName());
+    race_manager->setTrack(track);
+    race_manager->setNumLaps(num_laps);
+
+    std::vector<uint8_t> stored, raw;
+    for(unsigned int k=0; k<num_karts; k++)
+    {
+        std::string ident;
+        uint32_t num_events;
+        if (!getString(header, &offset, &ident     ) ||
+            !getUInt32(header, &offset, &num_events)    )
+            Log::fatal("Replay", "No data for kart %d found.", k);
+
+        GhostKart *ghost = new GhostKart(ident);
+        m_ghost_karts.push_back(ghost);
+        ghost->init(RaceManager::KT_GHOST);
+
+        for(unsigned int i=0; i<num_events; i++)
+        {
+            KartReplayEvent kre;
+            uint8_t type;
+            if (!getFloat(header, &offset, &kre.m_time) ||
+                !getUInt8(header, &offset, &type      )    )
+                Log::fatal("Replay", "Can't read event %d of kart %d.", i, k);
+            kre.m_type = (KartReplayEvent::KartReplayEventType)type;
+            ghost->addReplayEvent(kre);
+        }
+
+        uint16_t num_chunks;
+        if (!getUInt16(header, &offset, &num_chunks))
+            Log::fatal("Replay", "No chunk index for kart %d found.", k);
+        for(unsigned int i=0; i<num_chunks; i++)
+        {
+            ChunkInfo info;
+            if (!getFloat (header, &offset, &info.m_start_time ) ||
+                !getUInt16(header, &offset, &info.m_num_events ) ||
+                !getUInt32(header, &offset, &info.m_offset     ) ||
+                !getUInt32(header, &offset, &info.m_stored_size) ||
+                !getUInt32(header, &offset, &info.m_raw_size   )    )
+                Log::fatal("Replay", "Invalid chunk index for kart %d.", k);
+
+            stored.resize(info.m_stored_size);
+            if (fseek(fd, chunk_start+info.m_offset, SEEK_SET) != 0 ||
+                fread(stored.data(), 1, stored.size(), fd) != stored.size())
+            {
+                Log::warn("Replay", "Can't read chunk %d of kart %d, "
+                          "ignored.", i, k);
+                continue;
+            }
+            if (info.m_stored_size == info.m_raw_size)
+                raw.swap(stored);
+            else
+            {
+                raw.resize(info.m_raw_size);
+                uLongf size = info.m_raw_size;
+                if (uncompress(raw.data(), &size, stored.data(),
+                               stored.size()) != Z_OK ||
+                    size != info.m_raw_size)
+                {
+                    Log::warn("Replay", "Can't uncompress chunk %d of kart "
+                              "%d, ignored.", i, k);
+                    continue;
+                }
+            }
+            readChunk(raw, info, ghost);
+        }   // for i<num_chunks
+    }   // for k<num_karts
+}   // loadBinary
+
+//-----------------------------------------------------------------------------
+/** Decodes the transform events of one chunk of a binary replay file (see
+ *  ReplayRecorder::createChunk) and adds them to a ghost kart.
+ *  \param data The uncompressed data of the chunk.
+ *  \param info The index entry of the chunk.
+ *  \param ghost The ghost kart to which the transforms are added.
+ */
+void ReplayPlay::readChunk(const std::vector<uint8_t> &data,
+                           const ChunkInfo &info, GhostKart *ghost)
+{
+    unsigned int offset = 0;
+    float min[3], step[3];
+    for(unsigned int j=0; j<3; j++)
+        getFloat(data, &offset, &min[j]);
+    for(unsigned int j=0; j<3; j++)
+        getFloat(data, &offset, &step[j]);
+    if (offset + info.m_num_events*CHUNK_EVENT_SIZE > data.size())
+    {
+        Log::warn("Replay", "Chunk at %f is too short, ignored.",
+                  info.m_start_time);
+        return;
+    }
+
+    for(unsigned int i=0; i<info.m_num_events; i++)
+    {
+        uint16_t t, q;
+        getUInt16(data, &offset, &t);
+        float time = info.m_start_time + t*0.001f;
+        btVector3 xyz;
+        for(unsigned int j=0; j<3; j++)
+        {
+            getUInt16(data, &offset, &q);
+            xyz[j] = min[j] + q*step[j];
+        }
+        float r[4];
+        for(unsigned int j=0; j<4; j++)
+        {
+            getUInt16(data, &offset, &q);
+            r[j] = (int16_t)q/32767.0f;
+        }
+        btQuaternion rotation(r[0], r[1], r[2], r[3]);
+        rotation.normalize();
+        ghost->addTransform(time, btTransform(rotation, xyz));
+    }
+}   // readChunk
 
 //-----------------------------------------------------------------------------
 /** Reads all data from a replay file for a specific kart.
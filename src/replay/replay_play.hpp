@@ -44,6 +44,10 @@ private:
           ReplayPlay();
          ~ReplayPlay();
     void  readKartData(FILE *fd, char *next_line);
+    void  loadText(FILE *fd);
+    void  loadBinary(FILE *fd);
+    void  readChunk(const std::vector<uint8_t> &data, const ChunkInfo &info,
+                    GhostKart *ghost);
 public:
     void  init();
     void  update(float dt);
@@ -24,10 +24,12 @@
 #include "modes/world.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/track.hpp"
+#include "utils/vec3.hpp"
 
 #include <algorithm>
 #include <stdio.h>
 #include <string>
+#include <zlib.h>
 
 ReplayRecorder *ReplayRecorder::m_replay_recorder = NULL;
 
@@ -148,7 +150,8 @@ void ReplayRecorder::update(float dt)
 }   // update
 
 //-----------------------------------------------------------------------------
-/** Saves the replay data stored in the internal data structures.
+/** Saves the replay data stored in the internal data structures, either in
+ *  the binary format or (if set in stk_config) in the text format.
  */
 void ReplayRecorder::Save()
 {
@@ -166,6 +169,19 @@ void ReplayRecorder::Save()
 
     Log::info("ReplayRecorder", "Replay saved in '%s'.\n", getReplayFilename().c_str());
 
+    if(stk_config->m_replay_text_format)
+        saveText(fd);
+    else
+        saveBinary(fd);
+    fclose(fd);
+}   // Save
+
+//-----------------------------------------------------------------------------
+/** Saves the replay data in the text format.
+ *  \param fd The file to write to.
+ */
+void ReplayRecorder::saveText(FILE *fd)
+{
     World *world   = World::getWorld();
     unsigned int num_karts = world->getNumKarts();
     fprintf(fd, "Version:  %d\n",   getReplayVersion());
@@ -203,6 +219,146 @@ void ReplayRecorder::Save()
             fprintf(fd, "%f %d\n", p->m_time, p->m_type);
         }
     }
-    fclose(fd);
-}   // Save
+}   // saveText
+
+//-----------------------------------------------------------------------------
+/** Creates the raw data of one chunk of a binary replay file. The positions
+ *  are quantized to 16 bit relative to the bounding box of the chunk, the
+ *  rotations to 16 bit per quaternion component, and the times are stored
+ *  in milliseconds relative to the start of the chunk.
+ *  \param events Pointer to the first transform event of this chunk.
+ *  \param num_events Number of transform events in this chunk.
+ *  \param data The data is appended to this vector.
+ */
+void ReplayRecorder::createChunk(const TransformEvent *events,
+                                 unsigned int num_events,
+                                 std::vector<uint8_t> *data)
+{
+    Vec3 min = events[0].m_transform.getOrigin();
+    Vec3 max = min;
+    for(unsigned int i=1; i<num_events; i++)
+    {
+        min.min(events[i].m_transform.getOrigin());
+        max.max(events[i].m_transform.getOrigin());
+    }
+    Vec3 step = (max-min)/65535.0f;
+    for(unsigned int j=0; j<3; j++)
+        addFloat(data, min[j]);
+    for(unsigned int j=0; j<3; j++)
+        addFloat(data, step[j]);
+
+    const float start_time = events[0].m_time;
+    for(unsigned int i=0; i<num_events; i++)
+    {
+        const TransformEvent &e = events[i];
+        addUInt16(data, (uint16_t)((e.m_time-start_time)*1000.0f+0.5f));
+        const btVector3 &xyz = e.m_transform.getOrigin();
+        for(unsigned int j=0; j<3; j++)
+        {
+            float f = step[j]>0 ? (xyz[j]-min[j])/step[j] : 0.0f;
+            addUInt16(data, (uint16_t)std::min(f+0.5f, 65535.0f));
+        }
+        btQuaternion q = e.m_transform.getRotation();
+        for(unsigned int j=0; j<4; j++)
+        {
+            float f = btClamped(q[j], -1.0f, 1.0f)*32767.0f;
+            addUInt16(data, (uint16_t)(int16_t)(f<0 ? f-0.5f : f+0.5f));
+        }
+    }   // for i<num_events
+}   // createChunk
+
+//-----------------------------------------------------------------------------
+/** Saves the replay data in the binary format: a magic number, the format
+ *  version and the size of the header, followed by the header and the
+ *  chunks of transform events. The header contains the race information,
+ *  the skid events of each kart and an index of the chunks of each kart
+ *  (start time, number of events, offset and size), so a reader can find
+ *  and decode the chunks independently of each other. Each chunk can be
+ *  compressed with zlib.
+ *  \param fd The file to write to.
+ */
+void ReplayRecorder::saveBinary(FILE *fd)
+{
+    World *world   = World::getWorld();
+    unsigned int num_karts = world->getNumKarts();
+    unsigned int max_frames = (unsigned int)(  stk_config->m_replay_max_time
+                                             / stk_config->m_replay_dt      );
+    const bool compress = stk_config->m_replay_compress;
+
+    std::vector<uint8_t> header;
+    std::vector<uint8_t> chunks;
+    addUInt8(&header, compress ? BINARY_FLAG_COMPRESSED : 0);
+    addUInt8(&header, race_manager->getDifficulty());
+    addUInt8(&header, race_manager->getNumLaps());
+    addString(&header, world->getTrack()->getIdent());
+    addUInt8(&header, num_karts);
+
+    std::vector<uint8_t> raw, compressed;
+    for(unsigned int k=0; k<num_karts; k++)
+    {
+        addString(&header, world->getKart(k)->getIdent());
+        addUInt32(&header, m_kart_replay_event[k].size());
+        for(unsigned int i=0; i<m_kart_replay_event[k].size(); i++)
+        {
+            addFloat(&header, m_kart_replay_event[k][i].m_time);
+            addUInt8(&header, m_kart_replay_event[k][i].m_type);
+        }
+
+        // Split the transform events into chunks
+        unsigned int num_transforms = std::min(max_frames,
+                                               m_count_transforms[k]);
+        std::vector<ChunkInfo> index;
+        unsigned int start = 0;
+        while(start<num_transforms)
+        {
+            const TransformEvent *events = &(m_transform_events[k][start]);
+            unsigned int n = 1;
+            while(n<CHUNK_SIZE && start+n<num_transforms &&
+                  events[n].m_time-events[0].m_time < 65.0f)
+                n++;
+
+            raw.clear();
+            createChunk(events, n, &raw);
+            ChunkInfo info;
+            info.m_start_time  = events[0].m_time;
+            info.m_num_events  = n;
+            info.m_offset      = chunks.size();
+            info.m_raw_size    = raw.size();
+            info.m_stored_size = raw.size();
+            uLongf size = compressBound(raw.size());
+            compressed.resize(size);
+            if(compress &&
+               compress2(compressed.data(), &size, raw.data(), raw.size(),
+                         Z_BEST_COMPRESSION) == Z_OK &&
+               size < raw.size())
+            {
+                info.m_stored_size = size;
+                chunks.insert(chunks.end(), compressed.begin(),
+                              compressed.begin()+size);
+            }
+            else
+                chunks.insert(chunks.end(), raw.begin(), raw.end());
+            index.push_back(info);
+            start += n;
+        }   // while start<num_transforms
+
+        addUInt16(&header, index.size());
+        for(unsigned int i=0; i<index.size(); i++)
+        {
+            addFloat (&header, index[i].m_start_time );
+            addUInt16(&header, index[i].m_num_events );
+            addUInt32(&header, index[i].m_offset     );
+            addUInt32(&header, index[i].m_stored_size);
+            addUInt32(&header, index[i].m_raw_size   );
+        }
+    }   // for k<num_karts
 
+    std::vector<uint8_t> prefix;
+    addUInt32(&prefix, getBinaryReplayVersion());
+    addUInt32(&prefix, header.size());
+    fwrite(BINARY_MAGIC, 1, sizeof(BINARY_MAGIC), fd);
+    fwrite(prefix.data(), 1, prefix.size(), fd);
+    fwrite(header.data(), 1, header.size(), fd);
+    if(!chunks.empty())
+        fwrite(chunks.data(), 1, chunks.size(), fd);
+}   // saveBinary
@@ -62,6 +62,11 @@ private:
 
           ReplayRecorder();
          ~ReplayRecorder();
+    void  saveText(FILE *fd);
+    void  saveBinary(FILE *fd);
+    static void createChunk(const TransformEvent *events,
+                            unsigned int num_events,
+                            std::vector<uint8_t> *data);
 public:
     void  init();
     void  update(float dt);
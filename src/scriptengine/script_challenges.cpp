@@ -23,6 +23,7 @@
 #include "input/input_device.hpp"
 #include "input/input_manager.hpp"
 #include "modes/world.hpp"
+#include "scriptengine/script_engine.hpp"
 #include "states_screens/dialogs/tutorial_message_dialog.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_object.hpp"
@@ -46,13 +47,13 @@ namespace Scripting
 
         int getCompletedChallengesCount()
         {
-            ::Track* track = World::getWorld()->getTrack();
+            ::Track* track = getScriptWorld()->getTrack();
             return track->getNumOfCompletedChallenges();
         }
 
         int getChallengeCount()
         {
-            ::Track* track = World::getWorld()->getTrack();
+            ::Track* track = getScriptWorld()->getTrack();
             return track->getChallengeList().size();
         }
 
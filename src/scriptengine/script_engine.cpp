@@ -18,6 +18,7 @@
 
 #include <assert.h>
 #include <angelscript.h>
+#include "config/user_config.hpp"
 #include "io/file_manager.hpp"
 #include "karts/kart.hpp"
 #include "modes/world.hpp"
@@ -34,7 +35,15 @@
 #include "states_screens/dialogs/tutorial_message_dialog.hpp"
 #include "tracks/track_object_manager.hpp"
 #include "tracks/track.hpp"
+#include "utils/constants.hpp"
 #include "utils/profiler.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/synchronised.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
 
 
 using namespace Scripting;
@@ -43,6 +52,192 @@ namespace Scripting
 {
     const char* MODULE_ID_MAIN_SCRIPT_FILE = "main";
 
+    /** Identifies the first bytes of a compiled script in the cache. */
+    const char BYTECODE_MAGIC[4] = { 'S', 'T', 'K', 'S' };
+
+    /** Last id given to the function cache of a script engine. Engines of
+     *  different worlds can be created in different threads. */
+    static std::atomic<unsigned> g_last_cache_id(0);
+
+    /** Content of the bytecode cache files read or written so far. Compiled
+     *  scripts never change while STK runs, so the script engines of all
+     *  worlds share them, and each file is only read once. */
+    static Synchronised<std::map<std::string, std::string> > g_bytecode_files;
+
+    // ------------------------------------------------------------------------
+    /** Writes the bytecode of a module to a file. */
+    class BytecodeWriter : public asIBinaryStream
+    {
+    private:
+        FILE *m_file;
+        bool  m_ok;
+    public:
+        BytecodeWriter(FILE *file) : m_file(file), m_ok(true) {}
+        virtual void Write(const void *ptr, asUINT size)
+        {
+            if (size > 0 && fwrite(ptr, size, 1, m_file) != 1)
+                m_ok = false;
+        }   // Write
+        virtual void Read(void *ptr, asUINT size) { assert(false); }
+        bool isOk() const { return m_ok; }
+    };   // BytecodeWriter
+
+    // ------------------------------------------------------------------------
+    /** Reads the bytecode of a module from the content of a cache file. A
+     *  truncated file gives zeros, which makes loading the module fail. */
+    class BytecodeReader : public asIBinaryStream
+    {
+    private:
+        const std::string &m_data;
+        size_t             m_pos;
+    public:
+        BytecodeReader(const std::string &data, size_t pos)
+            : m_data(data), m_pos(pos) {}
+        virtual void Read(void *ptr, asUINT size)
+        {
+            if (m_pos + size > m_data.size())
+            {
+                memset(ptr, 0, size);
+                m_pos = m_data.size();
+                return;
+            }
+            memcpy(ptr, &m_data[m_pos], size);
+            m_pos += size;
+        }   // Read
+        virtual void Write(const void *ptr, asUINT size) { assert(false); }
+    };   // BytecodeReader
+
+    // ------------------------------------------------------------------------
+    /** Computes the FNV-1a hash identifying a compiled script: its source and
+     *  the versions of angelscript and STK, since the functions registered
+     *  by STK can change between versions. */
+    uint64_t hashScript(const std::string &script)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        std::string key = std::string(ANGELSCRIPT_VERSION_STRING) + "|" +
+                          STK_VERSION + "|";
+        for (unsigned i = 0; i < 2; i++)
+        {
+            const std::string &s = i == 0 ? key : script;
+            for (size_t j = 0; j < s.size(); j++)
+            {
+                hash ^= (unsigned char)s[j];
+                hash *= 1099511628211ULL;
+            }
+        }
+        return hash;
+    }   // hashScript
+
+    // ------------------------------------------------------------------------
+    /** Returns the name of the file a script of a track is cached in. */
+    std::string getBytecodeFile(const std::string &track,
+                                const std::string &script_name)
+    {
+        return file_manager->getCachedScriptsDir() + track + "-" +
+               StringUtils::removeExtension(script_name) + ".asc";
+    }   // getBytecodeFile
+
+    // ------------------------------------------------------------------------
+    /** Returns the content of a bytecode cache file, reading it only if no
+     *  other script engine did so before.
+     *  \return An empty string if the file doesn't exist.
+     */
+    std::string readBytecodeFile(const std::string &file_name)
+    {
+        std::string data;
+        g_bytecode_files.lock();
+        std::map<std::string, std::string> &files = g_bytecode_files.getData();
+        std::map<std::string, std::string>::const_iterator it =
+                                                        files.find(file_name);
+        if (it != files.end())
+        {
+            data = it->second;
+            g_bytecode_files.unlock();
+            return data;
+        }
+
+        FILE *f = fopen(file_name.c_str(), "rb");
+        if (f != NULL)
+        {
+            fseek(f, 0, SEEK_END);
+            long len = ftell(f);
+            fseek(f, 0, SEEK_SET);
+            if (len > 0)
+            {
+                data.resize(len);
+                if (fread(&data[0], len, 1, f) != 1)
+                    data.clear();
+            }
+            fclose(f);
+            files[file_name] = data;
+        }
+        g_bytecode_files.unlock();
+        return data;
+    }   // readBytecodeFile
+
+    // ------------------------------------------------------------------------
+    /** Loads a module from its cached bytecode.
+     *  \param hash Hash of the script, see hashScript.
+     *  \return False if the cache doesn't exist, is outdated or can't be
+     *          loaded.
+     */
+    bool loadBytecode(asIScriptModule *mod, const std::string &file_name,
+                      uint64_t hash)
+    {
+        const size_t header_size = sizeof(BYTECODE_MAGIC) + sizeof(hash);
+        const std::string data = readBytecodeFile(file_name);
+
+        uint64_t cached_hash;
+        if (data.size() <= header_size ||
+            memcmp(&data[0], BYTECODE_MAGIC, sizeof(BYTECODE_MAGIC)) != 0)
+            return false;
+        memcpy(&cached_hash, &data[sizeof(BYTECODE_MAGIC)], sizeof(hash));
+        if (cached_hash != hash)
+            return false;
+
+        BytecodeReader reader(data, header_size);
+        if (mod->LoadByteCode(&reader) < 0)
+        {
+            Log::warn("Scripting", "Can't load cached script '%s'.",
+                      file_name.c_str());
+            return false;
+        }
+        return true;
+    }   // loadBytecode
+
+    // ------------------------------------------------------------------------
+    /** Saves the bytecode of a compiled module, so that it doesn't need to
+     *  be compiled again the next time the track is played. */
+    void saveBytecode(asIScriptModule *mod, const std::string &file_name,
+                      uint64_t hash)
+    {
+        // Forget the old content, and keep other engines from reading the
+        // file while it is written
+        g_bytecode_files.lock();
+        g_bytecode_files.getData().erase(file_name);
+        FILE *f = fopen(file_name.c_str(), "wb");
+        if (f == NULL)
+        {
+            g_bytecode_files.unlock();
+            Log::warn("Scripting", "Can't write cached script '%s'.",
+                      file_name.c_str());
+            return;
+        }
+        BytecodeWriter writer(f);
+        bool ok = fwrite(BYTECODE_MAGIC, sizeof(BYTECODE_MAGIC), 1, f) == 1 &&
+                  fwrite(&hash, sizeof(hash), 1, f) == 1;
+        // Keep the debug information, it gives the lines of script errors
+        ok = ok && mod->SaveByteCode(&writer) >= 0 && writer.isOk();
+        fclose(f);
+        g_bytecode_files.unlock();
+        if (!ok)
+        {
+            Log::warn("Scripting", "Can't write cached script '%s'.",
+                      file_name.c_str());
+            remove(file_name.c_str());
+        }
+    }   // saveBytecode
+
     void AngelScript_ErrorCallback (const asSMessageInfo *msg, void *param)
     {
         const char *type = "ERR ";
@@ -55,9 +250,31 @@ namespace Scripting
     }
 
 
-    //Constructor, creates a new Scripting Engine using AngelScript
-    ScriptEngine::ScriptEngine()
+    //-----------------------------------------------------------------------------
+    /** Returns the world of the script engine which runs the current script,
+     *  the script functions of STK use this instead of World::getWorld() so
+     *  that they act on the race the script belongs to.
+     */
+    ::World* getScriptWorld()
+    {
+        asIScriptContext *ctx = asGetActiveContext();
+        if (ctx)
+        {
+            ScriptEngine *script_engine =
+                              (ScriptEngine*)ctx->GetEngine()->GetUserData();
+            if (script_engine)
+                return script_engine->getWorld();
+        }
+        return World::getWorld();
+    }   // getScriptWorld
+
+    //-----------------------------------------------------------------------------
+    /** Creates a new Scripting Engine using AngelScript.
+     *  \param world The world the scripts of this engine belong to.
+     */
+    ScriptEngine::ScriptEngine(::World *world)
     {
+        m_world = world;
         // Create the script engine
         m_engine = asCreateScriptEngine(ANGELSCRIPT_VERSION);
         if (m_engine == NULL)
@@ -68,27 +285,161 @@ namespace Scripting
         // The script compiler will write any compiler messages to the callback.
         m_engine->SetMessageCallback(asFUNCTION(AngelScript_ErrorCallback), 0, asCALL_CDECL);
 
+        // Contexts are reused instead of being created for each function run
+        m_engine->SetContextCallbacks(requestContext, returnContext, this);
+        // Lets the script functions find the world they belong to
+        m_engine->SetUserData(this);
+
         // Configure the script engine with all the functions, 
         // and variables that the script should be able to use.
         configureEngine(m_engine);
+        m_cache_id = ++g_last_cache_id;
+
+        m_profiling        = UserConfigParams::m_script_profiling;
+        m_time_budget      = UserConfigParams::m_script_time_budget;
+        m_frame_time       = 0;
+        m_deadline         = -1;
+        m_last_sample_time = 0;
+        m_execution_depth  = 0;
     }
 
     ScriptEngine::~ScriptEngine()
     {
+        cleanupCache();
+        for (unsigned i = 0; i < m_context_pool.size(); i++)
+            m_context_pool[i]->Release();
+        m_context_pool.clear();
         // Release the engine
         m_engine->Release();
     }
 
+    //-----------------------------------------------------------------------------
+    /** Called by angelscript when a context is needed, returns a pooled one
+     *  if available. */
+    asIScriptContext* ScriptEngine::requestContext(asIScriptEngine *engine,
+                                                   void *param)
+    {
+        ScriptEngine *script_engine = (ScriptEngine*)param;
+        if (script_engine->m_context_pool.empty())
+        {
+            asIScriptContext *ctx = engine->CreateContext();
+            // The line callback enforces the time budget and samples the
+            // running functions, it is only set if needed since it is called
+            // for each statement
+            if (ctx && (script_engine->m_profiling ||
+                        script_engine->m_time_budget > 0))
+            {
+                ctx->SetLineCallback(asFUNCTION(lineCallback), param,
+                                     asCALL_CDECL);
+            }
+            return ctx;
+        }
+        asIScriptContext *ctx = script_engine->m_context_pool.back();
+        script_engine->m_context_pool.pop_back();
+        return ctx;
+    }   // requestContext
+
+    //-----------------------------------------------------------------------------
+    /** Called by angelscript when a context isn't needed anymore, keeps it
+     *  for the next function to run. */
+    void ScriptEngine::returnContext(asIScriptEngine *engine,
+                                     asIScriptContext *ctx, void *param)
+    {
+        ScriptEngine *script_engine = (ScriptEngine*)param;
+        ctx->Unprepare();
+        script_engine->m_context_pool.push_back(ctx);
+    }   // returnContext
+
+    //-----------------------------------------------------------------------------
+    /** Called by angelscript before each statement. Aborts the scripts when
+     *  they ran out of time in this frame, and if profiling adds the time
+     *  since the last statement to the running function.
+     */
+    void ScriptEngine::lineCallback(asIScriptContext *ctx, void *param)
+    {
+        ScriptEngine *script_engine = (ScriptEngine*)param;
+        const double now = getTimeMilliseconds();
+        if (script_engine->m_profiling)
+        {
+            asIScriptFunction *func = ctx->GetFunction();
+            if (func)
+            {
+                script_engine->getStats(func).m_self_time +=
+                                    now - script_engine->m_last_sample_time;
+            }
+            script_engine->m_last_sample_time = now;
+        }
+        if (script_engine->m_deadline >= 0 && now > script_engine->m_deadline)
+            ctx->Abort();
+    }   // lineCallback
+
+    //-----------------------------------------------------------------------------
+    /** Returns the statistics of a function, creating them if needed. */
+    ScriptEngine::FunctionStats&
+                      ScriptEngine::getStats(const asIScriptFunction *func)
+    {
+        auto it = m_stats.find(func);
+        if (it != m_stats.end())
+            return it->second;
+        FunctionStats &stats = m_stats[func];
+        stats.m_name       = func->GetDeclaration();
+        stats.m_calls      = 0;
+        stats.m_total_time = 0;
+        stats.m_max_time   = 0;
+        stats.m_self_time  = 0;
+        return stats;
+    }   // getStats
+
+    //-----------------------------------------------------------------------------
+    /** Logs the script functions which took most time on this track, and
+     *  clears the statistics. */
+    void ScriptEngine::logStats()
+    {
+        if (m_stats.empty())
+            return;
+
+        std::vector<const FunctionStats*> sorted;
+        for (auto &it : m_stats)
+            sorted.push_back(&it.second);
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const FunctionStats *a, const FunctionStats *b)
+                  { return a->m_self_time > b->m_self_time; });
+
+        std::string track;
+        if (m_world && m_world->getTrack())
+            track = m_world->getTrack()->getIdent();
+        Log::info("Scripting", "Hottest script functions of track '%s':",
+                  track.c_str());
+        Log::info("Scripting", "   self ms  total ms   calls   max ms  function");
+        for (unsigned i = 0; i < sorted.size() && i < 10; i++)
+        {
+            Log::info("Scripting", "%10.3f%10.3f%8u%9.3f  %s",
+                      sorted[i]->m_self_time, sorted[i]->m_total_time,
+                      sorted[i]->m_calls, sorted[i]->m_max_time,
+                      sorted[i]->m_name.c_str());
+        }
+        m_stats.clear();
+    }   // logStats
+
+    //-----------------------------------------------------------------------------
+    /** Called at the start of each world update, gives the scripts a new time
+     *  budget. */
+    void ScriptEngine::startFrame()
+    {
+        m_frame_time = 0;
+    }   // startFrame
+
 
 
     /** Get Script By it's file name
+    *  \param track Ident of the track the script belongs to.
     *  \param string scriptname = name of script to get
     *  \return      The corresponding script
     */
-    std::string getScript(std::string fileName)
+    std::string getScript(const std::string &track, std::string fileName)
     {
         std::string script_dir = file_manager->getAsset(FileManager::SCRIPT, "");
-        script_dir += World::getWorld()->getTrack()->getIdent() + "/";
+        script_dir += track + "/";
 
         script_dir += fileName;
         FILE *f = fopen(script_dir.c_str(), "rb");
@@ -132,11 +483,12 @@ namespace Scripting
             return;
         }
 
-        asIScriptContext *ctx = m_engine->CreateContext();
+        asIScriptContext *ctx = m_engine->RequestContext();
         if (ctx == NULL)
         {
             Log::error("Scripting", "evalScript: Failed to create the context.");
             //m_engine->Release();
+            func->Release();
             return;
         }
 
@@ -144,7 +496,8 @@ namespace Scripting
         if (r < 0)
         {
             Log::error("Scripting", "evalScript: Failed to prepare the context.");
-            ctx->Release();
+            m_engine->ReturnContext(ctx);
+            func->Release();
             return;
         }
 
@@ -167,7 +520,7 @@ namespace Scripting
             }
         }
 
-        ctx->Release();
+        m_engine->ReturnContext(ctx);
         func->Release();
     }
 
@@ -201,66 +554,93 @@ namespace Scripting
         std::function<void(asIScriptContext*)> callback,
         std::function<void(asIScriptContext*)> get_return_value)
     {
-        int r; //int for error checking
+        asIScriptFunction *func = getFunction(function_name);
+        if (func == NULL)
+            return; // function unavailable
+        executeFunction(func, callback, get_return_value);
+    }
 
-        asIScriptFunction *func;
+    //-----------------------------------------------------------------------------
+    /** Runs a script function which is only looked up the first time it is
+     *  run with this script engine.
+     *  \param function The function to run.
+     *  \param callback Sets the arguments.
+     *  \param get_return_value Reads the return value.
+     */
+    void ScriptEngine::runFunction(ScriptFunction *function,
+        std::function<void(asIScriptContext*)> callback,
+        std::function<void(asIScriptContext*)> get_return_value)
+    {
+        if (function->empty())
+            return;
+        if (function->m_cache_id != m_cache_id)
+        {
+            function->m_function = getFunction(function->m_declaration);
+            function->m_cache_id = m_cache_id;
+        }
+        if (function->m_function == NULL)
+            return; // function unavailable
+        executeFunction(function->m_function, callback, get_return_value);
+    }   // runFunction
+
+    //-----------------------------------------------------------------------------
+    /** Returns the function with the given declaration, compiling the script
+     *  of the track first if needed. Functions are only searched once, the
+     *  result (even if the function doesn't exist) is kept in the cache.
+     *  \param declaration Declaration of the function, e.g. "void onStart()".
+     *  \return The function, or NULL if it is unavailable.
+     */
+    asIScriptFunction* ScriptEngine::getFunction(const std::string &declaration)
+    {
+        auto cached_function = m_functions_cache.find(declaration);
+        if (cached_function != m_functions_cache.end())
+            return cached_function->second;
 
         // TODO: allow splitting in multiple files
         std::string script_filename = "scripting.as";
         auto cached_script = m_loaded_files.find(script_filename);
-        auto cached_function = m_functions_cache.find(function_name);
-
         if (cached_script == m_loaded_files.end())
         {
             // Compile the script code
             Log::info("Scripting", "Checking for script file '%s'", script_filename.c_str());
-            r = compileScript(m_engine, script_filename);
+            int r = compileScript(m_engine, script_filename);
             if (r < 0)
-            {
                 Log::info("Scripting", "Script '%s' is not available", script_filename.c_str());
-                m_loaded_files[script_filename] = false;
-                m_functions_cache[function_name] = NULL; // remember that this script is unavailable
-                return;
-            }
-
-            m_loaded_files[script_filename] = true;
-        }
-        else if (cached_script->second == false)
-        {
-            return; // script file unavailable
+            m_loaded_files[script_filename] = r >= 0;
+            cached_script = m_loaded_files.find(script_filename);
         }
 
-        if (cached_function == m_functions_cache.end())
+        asIScriptFunction *func = NULL;
+        if (cached_script->second)
         {
             // Find the function for the function we want to execute.
             //      This is how you call a normal function with arguments
             //      asIScriptFunction *func = engine->GetModule(0)->GetFunctionByDecl("void func(arg1Type, arg2Type)");
             func = m_engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE)
-                        ->GetFunctionByDecl(function_name.c_str());
-        
+                        ->GetFunctionByDecl(declaration.c_str());
             if (func == NULL)
-            {
-                Log::debug("Scripting", "Scripting function was not found : %s", function_name.c_str());
-                m_loaded_files[function_name] = NULL; // remember that this script is unavailable
-                return;
-            }
-
-            m_functions_cache[function_name] = func;
-            func->AddRef();
-        }
-        else
-        {
-            // Script present in cache
-            func = cached_function->second;
+                Log::debug("Scripting", "Scripting function was not found : %s", declaration.c_str());
+            else
+                func->AddRef();
         }
 
-        if (func == NULL)
-        {
-            return; // function unavailable
-        }
+        // Remember unavailable functions too, so they are not searched again
+        m_functions_cache[declaration] = func;
+        return func;
+    }   // getFunction
 
-        // Create a context that will execute the script.
-        asIScriptContext *ctx = m_engine->CreateContext();
+    //-----------------------------------------------------------------------------
+    /** Runs a script function in a pooled context.
+     *  \param callback If set, called to set the arguments.
+     *  \param get_return_value If set, called after the function finished.
+     */
+    void ScriptEngine::executeFunction(asIScriptFunction *func,
+        const std::function<void(asIScriptContext*)> &callback,
+        const std::function<void(asIScriptContext*)> &get_return_value)
+    {
+        // Get a context that will execute the script. Contexts are pooled,
+        // functions run by a script get another context from the pool.
+        asIScriptContext *ctx = m_engine->RequestContext();
         if (ctx == NULL)
         {
             Log::error("Scripting", "Failed to create the context.");
@@ -270,14 +650,12 @@ namespace Scripting
 
         // Prepare the script context with the function we wish to execute. Prepare()
         // must be called on the context before each new script function that will be
-        // executed. Note, that if because we intend to execute the same function 
-        // several times, we will store the function returned by 
-        // GetFunctionByDecl(), so that this relatively slow call can be skipped.
-        r = ctx->Prepare(func);
+        // executed.
+        int r = ctx->Prepare(func);
         if (r < 0)
         {
             Log::error("Scripting", "Failed to prepare the context.");
-            ctx->Release();
+            m_engine->ReturnContext(ctx);
             //m_engine->Release();
             return;
         }
@@ -289,14 +667,44 @@ namespace Scripting
         if (callback)
             callback(ctx);
 
-        // Execute the function
+        // Execute the function. The budget is shared by all functions run in
+        // a frame, functions run by a script are part of the caller's time.
+        const double start = getTimeMilliseconds();
+        if (m_execution_depth == 0)
+        {
+            m_last_sample_time = start;
+            if (m_time_budget > 0)
+                m_deadline = start + std::max(0.0, m_time_budget - m_frame_time);
+        }
+        m_execution_depth++;
+        PROFILER_PUSH_CPU_MARKER("Script", 0xFF, 0x00, 0xFF);
         r = ctx->Execute();
+        PROFILER_POP_CPU_MARKER();
+        m_execution_depth--;
+
+        const double duration = getTimeMilliseconds() - start;
+        if (m_execution_depth == 0)
+        {
+            m_frame_time += duration;
+            m_deadline    = -1;
+            PROFILER_COUNT("Script time (us)", (int64_t)(duration * 1000));
+        }
+        if (m_profiling)
+        {
+            FunctionStats &stats = getStats(func);
+            stats.m_calls++;
+            stats.m_total_time += duration;
+            stats.m_max_time    = std::max(stats.m_max_time, duration);
+        }
+
         if (r != asEXECUTION_FINISHED)
         {
             // The execution didn't finish as we had planned. Determine why.
             if (r == asEXECUTION_ABORTED)
             {
-                Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
+                Log::error("Scripting", "'%s' was aborted, the scripts took "
+                           "more than %.1f ms in this frame.",
+                           func->GetDeclaration(), m_time_budget);
             }
             else if (r == asEXECUTION_EXCEPTION)
             {
@@ -325,14 +733,16 @@ namespace Scripting
                 get_return_value(ctx);
         }
 
-        // We must release the contexts when no longer using them
-        ctx->Release();
-    }
+        // Give the context back to the pool
+        m_engine->ReturnContext(ctx);
+    }   // executeFunction
 
     //-----------------------------------------------------------------------------
 
     void ScriptEngine::cleanupCache()
     {
+        if (m_profiling)
+            logStats();
         for (auto curr : m_functions_cache)
         {
             if (curr.second != NULL)
@@ -340,6 +750,8 @@ namespace Scripting
         }
         m_functions_cache.clear();
         m_loaded_files.clear();
+        // ScriptFunctions must look up their function again
+        m_cache_id = ++g_last_cache_id;
     }
 
     //-----------------------------------------------------------------------------
@@ -375,7 +787,8 @@ namespace Scripting
     {
         int r;
 
-        std::string script = getScript(scriptName);
+        const std::string &track = m_world->getTrack()->getIdent();
+        std::string script = getScript(track, scriptName);
         if (script.size() == 0)
         {
             // No such file
@@ -387,7 +800,15 @@ namespace Scripting
         // we can call AddScriptSection() several times for the same module and
         // the script engine will treat them all as if they were one. The script
         // section name, will allow us to localize any errors in the script code.
+        // Use the bytecode compiled the last time this script was played
+        const std::string bytecode_file = getBytecodeFile(track, scriptName);
+        const uint64_t hash = hashScript(script);
         asIScriptModule *mod = engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE, asGM_ALWAYS_CREATE);
+        if (loadBytecode(mod, bytecode_file, hash))
+            return 0;
+
+        // Start again with an empty module if loading failed half way
+        mod = engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE, asGM_ALWAYS_CREATE);
         r = mod->AddScriptSection("script", &script[0], script.size());
         if (r < 0)
         {
@@ -405,6 +826,7 @@ namespace Scripting
             Log::error("Scripting", "Build() failed");
             return -1;
         }
+        saveBytecode(mod, bytecode_file, hash);
 
         // The engine doesn't keep a copy of the script sections after Build() has
         // returned. So if the script needs to be recompiled, then all the script
@@ -19,19 +19,32 @@
 #ifndef HEADER_SCRIPT_ENGINE_HPP
 #define HEADER_SCRIPT_ENGINE_HPP
 
+#include "scriptengine/script_function.hpp"
+
 #include <string>
 #include <angelscript.h>
 #include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
 
 class TrackObjectPresentation;
+class World;
 
 namespace Scripting
 {
+    ::World* getScriptWorld();
+
+    /** The script engine of a world. Each world has its own engine with its
+     *  own compiled module and contexts, so that scripts of different races
+     *  don't share any state. Only the bytecode read from the cache files
+     *  is shared between the engines.
+     */
     class ScriptEngine
     {
     public:
 
-        ScriptEngine();
+        ScriptEngine(::World *world);
         ~ScriptEngine();
 
         void runFunction(std::string function_name);
@@ -40,16 +53,77 @@ namespace Scripting
         void runFunction(std::string function_name,
             std::function<void(asIScriptContext*)> callback,
             std::function<void(asIScriptContext*)> get_return_value);
+        void runFunction(ScriptFunction *function,
+            std::function<void(asIScriptContext*)> callback,
+            std::function<void(asIScriptContext*)> get_return_value =
+                std::function<void(asIScriptContext*)>());
         void evalScript(std::string script_fragment);
         void cleanupCache();
+        void startFrame();
+        // --------------------------------------------------------------------
+        /** Returns the world the scripts of this engine belong to. */
+        ::World* getWorld() const { return m_world; }
 
     private:
         asIScriptEngine *m_engine;
+        /** The world this engine runs the scripts of. */
+        ::World         *m_world;
         std::map<std::string, bool> m_loaded_files;
         std::map<std::string, asIScriptFunction*> m_functions_cache;
 
+        /** Identifies the content of m_functions_cache, changed each time
+         *  it is cleared so that ScriptFunction lookups from before are
+         *  recognized. Unique across all script engines. */
+        unsigned m_cache_id;
+
+        /** Contexts which finished executing and can be reused. */
+        std::vector<asIScriptContext*> m_context_pool;
+
+        /** Execution statistics of a script function on this track. */
+        struct FunctionStats
+        {
+            std::string m_name;
+            /** Number of runs from STK, and their total and longest time
+             *  in ms. */
+            unsigned    m_calls;
+            double      m_total_time;
+            double      m_max_time;
+            /** Time sampled in the function itself, including the STK
+             *  functions it calls, in ms. */
+            double      m_self_time;
+        };   // FunctionStats
+
+        /** Statistics of the functions run, only collected if
+         *  m_profiling. */
+        std::unordered_map<const asIScriptFunction*, FunctionStats> m_stats;
+        bool     m_profiling;
+        /** Time the scripts may run per frame in ms, 0 for no limit. */
+        float    m_time_budget;
+        /** Time spent in scripts in the current frame, in ms. */
+        double   m_frame_time;
+        /** Time at which the running scripts are aborted, 0 if none runs or
+         *  there is no limit. */
+        double   m_deadline;
+        /** Time of the last sample taken by the line callback. */
+        double   m_last_sample_time;
+        /** Number of functions being executed, more than 1 if a script
+         *  causes another function to run. */
+        unsigned m_execution_depth;
+
         void configureEngine(asIScriptEngine *engine);
         int  compileScript(asIScriptEngine *engine,std::string scriptName);
+        asIScriptFunction* getFunction(const std::string &declaration);
+        void executeFunction(asIScriptFunction *func,
+            const std::function<void(asIScriptContext*)> &callback,
+            const std::function<void(asIScriptContext*)> &get_return_value);
+
+        static asIScriptContext* requestContext(asIScriptEngine *engine,
+                                                void *param);
+        static void returnContext(asIScriptEngine *engine,
+                                  asIScriptContext *ctx, void *param);
+        static void lineCallback(asIScriptContext *ctx, void *param);
+        FunctionStats& getStats(const asIScriptFunction *func);
+        void logStats();
     };   // class ScriptEngine
 
 }
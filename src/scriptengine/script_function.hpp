@@ -0,0 +1,65 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_SCRIPT_FUNCTION_HPP
+#define HEADER_SCRIPT_FUNCTION_HPP
+
+#include <stddef.h>
+#include <string>
+
+class asIScriptFunction;
+
+namespace Scripting
+{
+    /** A script function given by its declaration, which is only looked up
+     *  in the script module the first time it is run. Callbacks that are run
+     *  often (e.g. on each collision) keep one of these, so that running
+     *  them neither builds the declaration nor searches it.
+     *  This header doesn't include angelscript, so that it can be used in
+     *  widely included headers.
+     */
+    class ScriptFunction
+    {
+        friend class ScriptEngine;
+    private:
+        std::string        m_declaration;
+        /** The function, or NULL if the script doesn't define it. */
+        asIScriptFunction *m_function;
+        /** Function cache of the script engine m_function was looked up in,
+         *  0 if it wasn't looked up yet. */
+        unsigned           m_cache_id;
+
+    public:
+        ScriptFunction() : m_function(NULL), m_cache_id(0) {}
+        // --------------------------------------------------------------------
+        /** Sets the declaration, e.g. "void onStart()". */
+        void setDeclaration(const std::string &declaration)
+        {
+            m_declaration = declaration;
+            m_function    = NULL;
+            m_cache_id    = 0;
+        }   // setDeclaration
+        // --------------------------------------------------------------------
+        /** Returns true if no declaration was set. */
+        bool empty() const { return m_declaration.empty(); }
+        // --------------------------------------------------------------------
+        const std::string& getDeclaration() const { return m_declaration; }
+    };   // class ScriptFunction
+
+}
+#endif
@@ -21,6 +21,7 @@
 #include "karts/kart.hpp"
 #include "modes/world.hpp"
 #include "script_kart.hpp"
+#include "scriptengine/script_engine.hpp"
 #include "scriptvec3.hpp"
 
 //debug
@@ -43,21 +44,21 @@ namespace Scripting
         /** Squashes the specified kart, for the specified time */
         void squash(int idKart, float time)
         {
-            AbstractKart* kart = World::getWorld()->getKart(idKart);
+            AbstractKart* kart = getScriptWorld()->getKart(idKart);
             kart->setSquash(time, 0.5);  //0.5 * max speed is new max for squashed duration
         }
 
         /** Teleports the kart to the specified Vec3 location */
         void teleport(int idKart, SimpleVec3* position)
         {
-            AbstractKart* kart = World::getWorld()->getKart(idKart);
+            AbstractKart* kart = getScriptWorld()->getKart(idKart);
             Vec3 v(position->getX(), position->getY(), position->getZ());
             kart->setXYZ(v);
-            unsigned int index = World::getWorld()->getRescuePositionIndex(kart);
-            btTransform s = World::getWorld()->getRescueTransform(index);
+            unsigned int index = getScriptWorld()->getRescuePositionIndex(kart);
+            btTransform s = getScriptWorld()->getRescueTransform(index);
             const btVector3 &xyz = s.getOrigin();
             s.setRotation(btQuaternion(btVector3(0.0f, 1.0f, 0.0f), 0.0f));
-            World::getWorld()->moveKartTo(kart, s);
+            getScriptWorld()->moveKartTo(kart, s);
         }
 
         /** Attempts to project kart to the given 2D location, to the position
@@ -94,7 +95,7 @@ namespace Scripting
         /** Returns the location of the corresponding kart. */
         SimpleVec3 getLocation(int idKart)
         {
-            AbstractKart* kart = World::getWorld()->getKart(idKart);
+            AbstractKart* kart = getScriptWorld()->getKart(idKart);
             Vec3 v = kart->getXYZ();
             return SimpleVec3(v.getX(), v.getY(), v.getZ());
         }
@@ -106,7 +107,7 @@ namespace Scripting
             float y = position->getY();
             float z = position->getZ();
 
-            AbstractKart* kart = World::getWorld()->getKart(idKart);
+            AbstractKart* kart = getScriptWorld()->getKart(idKart);
             kart->setVelocity(btVector3(x, y, z));
         }
 
@@ -23,6 +23,7 @@
 #include "input/input_device.hpp"
 #include "input/input_manager.hpp"
 #include "modes/world.hpp"
+#include "scriptengine/script_engine.hpp"
 #include "states_screens/dialogs/tutorial_message_dialog.hpp"
 #include "states_screens/dialogs/race_paused_dialog.hpp"
 #include "tracks/track.hpp"
@@ -50,7 +51,7 @@ namespace Scripting
         {
         std::string *str = name;
         std::string type = "mesh";
-        World::getWorld()->getTrack()->getTrackObjectManager()->disable(*str, type);
+        getScriptWorld()->getTrack()->getTrackObjectManager()->disable(*str, type);
         }*/
 
         /**
@@ -59,31 +60,31 @@ namespace Scripting
           */
         TrackObject* getTrackObject(std::string* objID)
         {
-            return World::getWorld()->getTrack()->getTrackObjectManager()->getTrackObject(*objID);
+            return getScriptWorld()->getTrack()->getTrackObjectManager()->getTrackObject(*objID);
         }
 
         /** Hide/disable a track object */
         void disableTrackObject(std::string* objID)
         {
-            World::getWorld()->getTrack()->getTrackObjectManager()->disable(*objID);
+            getScriptWorld()->getTrack()->getTrackObjectManager()->disable(*objID);
         }
 
         /** Show/enable a track objects */
         void enableTrackObject(std::string* objID)
         {
-            World::getWorld()->getTrack()->getTrackObjectManager()->enable(*objID);
+            getScriptWorld()->getTrack()->getTrackObjectManager()->enable(*objID);
         }
 
         /** Disables an action trigger of specified ID */
         void disableTrigger(std::string* triggerID)
         {
-            World::getWorld()->getTrack()->getTrackObjectManager()->disable(*triggerID);
+            getScriptWorld()->getTrack()->getTrackObjectManager()->disable(*triggerID);
         }
 
         /** Enables an action trigger of specified ID */
         void enableTrigger(std::string* triggerID)
         {
-            World::getWorld()->getTrack()->getTrackObjectManager()->enable(*triggerID);
+            getScriptWorld()->getTrack()->getTrackObjectManager()->enable(*triggerID);
         }
 
         /** Creates a trigger at the specified location */
@@ -100,13 +101,13 @@ namespace Scripting
             TrackObject* tobj = new TrackObject(posi, hpr, scale,
                 "none", newtrigger, false /* isDynamic */, NULL /* physics settings */);
             tobj->setID(*triggerID);
-            World::getWorld()->getTrack()->getTrackObjectManager()->insertObject(tobj);
+            getScriptWorld()->getTrack()->getTrackObjectManager()->insertObject(tobj);
         }
 
         /** Exits the race to the main menu */
         void exitRace()
         {
-            World::getWorld()->scheduleExitRace();
+            getScriptWorld()->scheduleExitRace();
         }
 
         void pauseRace()
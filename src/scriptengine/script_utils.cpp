@@ -23,6 +23,7 @@
 #include "input/input_device.hpp"
 #include "input/input_manager.hpp"
 #include "modes/world.hpp"
+#include "scriptengine/script_engine.hpp"
 #include "states_screens/dialogs/tutorial_message_dialog.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_object.hpp"
@@ -104,7 +105,7 @@ namespace Scripting
         /** Runs the script specified by the given string */
         void runScript(const std::string* str)
         {
-            ScriptEngine* script_engine = World::getWorld()->getScriptEngine();
+            ScriptEngine* script_engine = getScriptWorld()->getScriptEngine();
             script_engine->runFunction(*str);
         }
 
@@ -317,6 +317,8 @@ void AddonsLoading::startDownload()
     m_download_request = new Online::HTTPRequest(save, /*manage mem*/false,
                                                  /*priority*/5);
     m_download_request->setURL(m_addon.getZipFileName());
+    // Continue a download that was cancelled or interrupted before
+    m_download_request->setResumable(true);
     m_download_request->queue();
 
 }   // startDownload
@@ -295,8 +295,9 @@ void FeatureUnlockedCutScene::init()
         }
         else if (m_unlocked_stuff[n].m_unlocked_kart != NULL)
         {
-            KartModel *kart_model =
-                m_unlocked_stuff[n].m_unlocked_kart->getKartModelCopy();
+            const KartProperties *kp = kart_properties_manager->getLoadedKart(
+                          m_unlocked_stuff[n].m_unlocked_kart->getIdent());
+            KartModel *kart_model = kp->getKartModelCopy();
             m_all_kart_models.push_back(kart_model);
             m_unlocked_stuff[n].m_root_gift_node = kart_model->attachModel(true, false);
             m_unlocked_stuff[n].m_scale = 5.0f;
@@ -186,7 +186,7 @@ void GrandPrixLose::setKarts(std::vector<std::string> ident_arg)
     const int count = (int)ident_arg.size();
     for (int n=0; n<count; n++)
     {
-        const KartProperties* kart = kart_properties_manager->getKart(ident_arg[n]);
+        const KartProperties* kart = kart_properties_manager->getLoadedKart(ident_arg[n]);
         if (kart != NULL)
         {
             KartModel* kart_model = kart->getKartModelCopy();
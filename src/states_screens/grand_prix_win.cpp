@@ -297,7 +297,7 @@ void GrandPrixWin::setKarts(const std::string idents_arg[3])
 
     for (int i = 0; i < 3; i++)
     {
-        const KartProperties* kp = kart_properties_manager->getKart(idents[i]);
+        const KartProperties* kp = kart_properties_manager->getLoadedKart(idents[i]);
         if (kp == NULL) continue;
 
         KartModel* kart_model = kp->getKartModelCopy();
@@ -807,7 +807,7 @@ void KartSelectionScreen::updateKartStats(uint8_t widget_id,
     assert(w != NULL);
 
     const KartProperties *kp =
-                    kart_properties_manager->getKart(selection);
+                    kart_properties_manager->getLoadedKart(selection);
     if (kp != NULL)
     {
         w->setValue(KartStatsWidget::SKILL_MASS, (int)(kp->getMass()/5));
@@ -861,7 +861,7 @@ void KartSelectionScreen::updateKartWidgetModel(uint8_t widget_id,
     else
     {
         const KartProperties *kp =
-            kart_properties_manager->getKart(selection);
+            kart_properties_manager->getLoadedKart(selection);
         if (kp != NULL)
         {
             const KartModel &kart_model = kp->getMasterKartModel();
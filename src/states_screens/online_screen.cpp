@@ -167,22 +167,22 @@ void OnlineScreen::onUpdate(float delta)
  */
 void OnlineScreen::doQuickPlay()
 {
-    // Refresh server list.
+    // Refresh the server list, unless the cached one is recent enough
     HTTPRequest* refresh_request = ServersManager::get()->refreshRequest(false);
-    if (refresh_request != NULL) // consider request done
+    if (refresh_request != NULL)
     {
         refresh_request->executeNow();
         delete refresh_request;
     }
-    else
+
+    const Server *server = ServersManager::get()->getQuickPlay();
+    if (!server)
     {
         Log::error("OnlineScreen", "Could not get the server list.");
+        SFXManager::get()->quickSound("anvil");
         return;
     }
 
-    // select first one
-    const Server *server = ServersManager::get()->getQuickPlay();
-
     // do a join request
     XMLRequest *join_request = new RequestConnection::ServerJoinRequest();
     if (!join_request)
@@ -346,7 +346,6 @@ void RaceGUI::drawGlobalMiniMap()
     if(world->getTrack()->isArena() || world->getTrack()->isSoccer()) return;
 
     const video::ITexture *old_rtt_mini_map = world->getTrack()->getOldRttMiniMap();
-    const FrameBuffer* new_rtt_mini_map = world->getTrack()->getNewRttMiniMap();
 
     int upper_y = irr_driver->getActualScreenSize().Height - m_map_bottom - m_map_height;
     int lower_y = irr_driver->getActualScreenSize().Height - m_map_bottom;
@@ -361,14 +360,6 @@ void RaceGUI::drawGlobalMiniMap()
         draw2DImage(old_rtt_mini_map, dest, source,
                     NULL, NULL, true);
     }
-    else if (new_rtt_mini_map != NULL)
-    {
-        core::rect<s32> source(0, 0, (int)new_rtt_mini_map->getWidth(),
-                               (int)new_rtt_mini_map->getHeight());
-        draw2DImageFromRTT(new_rtt_mini_map->getRTT()[0],
-            new_rtt_mini_map->getWidth(), new_rtt_mini_map->getHeight(),
-            dest, source, NULL, video::SColor(127, 255, 255, 255), true);
-    }
 
     for(unsigned int i=0; i<world->getNumKarts(); i++)
     {
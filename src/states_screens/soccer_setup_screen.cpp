@@ -150,7 +150,7 @@ void SoccerSetupScreen::beforeAddingWidget()
         const RemoteKartInfo&   kart_info   = race_manager->getLocalKartInfo(i);
         const std::string&      kart_name   = kart_info.getKartName();
 
-        const KartProperties*   props       = kart_properties_manager->getKart(kart_name);
+        const KartProperties*   props       = kart_properties_manager->getLoadedKart(kart_name);
         const KartModel&        kart_model  = props->getMasterKartModel();
 
         // Add the view
@@ -31,6 +31,7 @@
 #include "guiengine/widgets/ribbon_widget.hpp"
 #include "guiengine/widgets/spinner_widget.hpp"
 #include "io/file_manager.hpp"
+#include "io/file_prefetcher.hpp"
 #include "karts/kart_properties.hpp"
 #include "karts/kart_properties_manager.hpp"
 #include "race/highscores.hpp"
@@ -97,6 +98,11 @@ void TrackInfoScreen::setTrack(Track *track)
  */
 void TrackInfoScreen::init()
 {
+    // Read the track files while the player is still in this screen, so
+    // that loading the track hits the file system cache
+    FilePrefetcher::prefetchDirectory(
+                                  StringUtils::getPath(m_track->getFilename()));
+
     const bool has_laps       = race_manager->modeHasLaps();
     const bool has_highscores = race_manager->modeHasHighscores();
 
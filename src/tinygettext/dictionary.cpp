@@ -20,8 +20,83 @@
 
 #include "utils/log.hpp"
 
+#include <istream>
+#include <ostream>
+
 namespace tinygettext {
 
+/** Identifies a translation cache, and its version. */
+static const unsigned int CACHE_MAGIC   = 0x53544b54;
+static const unsigned int CACHE_VERSION = 1;
+
+// ----------------------------------------------------------------------------
+static void write_uint(std::ostream& out, unsigned int n)
+{
+  out.write((const char*)&n, sizeof(n));
+}
+
+static void write_string(std::ostream& out, const std::string& s)
+{
+  write_uint(out, (unsigned int)s.size());
+  out.write(s.data(), s.size());
+}
+
+static void write_entries(std::ostream& out,
+                          const std::map<std::string,
+                                         std::vector<std::string> >& entries)
+{
+  write_uint(out, (unsigned int)entries.size());
+  for (std::map<std::string, std::vector<std::string> >::const_iterator
+       i = entries.begin(); i != entries.end(); ++i)
+  {
+    write_string(out, i->first);
+    write_uint(out, (unsigned int)i->second.size());
+    for (unsigned int j = 0; j < i->second.size(); j++)
+      write_string(out, i->second[j]);
+  }
+}
+
+static bool read_uint(std::istream& in, unsigned int* n)
+{
+  in.read((char*)n, sizeof(*n));
+  return in.good();
+}
+
+static bool read_string(std::istream& in, std::string* s)
+{
+  unsigned int size;
+  if (!read_uint(in, &size))
+    return false;
+  s->resize(size);
+  if (size > 0)
+    in.read(&(*s)[0], size);
+  return in.good();
+}
+
+static bool read_entries(std::istream& in,
+                         std::map<std::string,
+                                  std::vector<std::string> >* entries)
+{
+  unsigned int count;
+  if (!read_uint(in, &count))
+    return false;
+  std::string msgid;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    unsigned int num_msgstrs;
+    if (!read_string(in, &msgid) || !read_uint(in, &num_msgstrs))
+      return false;
+    std::vector<std::string>& msgstrs = (*entries)[msgid];
+    msgstrs.resize(num_msgstrs);
+    for (unsigned int j = 0; j < num_msgstrs; j++)
+    {
+      if (!read_string(in, &msgstrs[j]))
+        return false;
+    }
+  }
+  return true;
+}
+
 Dictionary::Dictionary(const std::string& charset_) :
   entries(),
   ctxt_entries(),
@@ -41,6 +116,53 @@ Dictionary::get_charset() const
   return charset;
 }
 
+bool
+Dictionary::write_cache(std::ostream& out) const
+{
+  write_uint(out, CACHE_MAGIC);
+  write_uint(out, CACHE_VERSION);
+  write_string(out, charset);
+  write_string(out, plural_forms.get_expression());
+  write_entries(out, entries);
+  write_uint(out, (unsigned int)ctxt_entries.size());
+  for (CtxtEntries::const_iterator i = ctxt_entries.begin();
+       i != ctxt_entries.end(); ++i)
+  {
+    write_string(out, i->first);
+    write_entries(out, i->second);
+  }
+  return out.good();
+}
+
+bool
+Dictionary::read_cache(std::istream& in)
+{
+  unsigned int magic, version;
+  std::string cache_charset, expression;
+  bool ok = read_uint(in, &magic) && magic == CACHE_MAGIC &&
+            read_uint(in, &version) && version == CACHE_VERSION &&
+            read_string(in, &cache_charset) && cache_charset == charset &&
+            read_string(in, &expression) && read_entries(in, &entries);
+
+  unsigned int num_ctxt = 0;
+  ok = ok && read_uint(in, &num_ctxt);
+  std::string msgctxt;
+  for (unsigned int i = 0; ok && i < num_ctxt; i++)
+  {
+    ok = read_string(in, &msgctxt) && read_entries(in, &ctxt_entries[msgctxt]);
+  }
+
+  if (!ok)
+  {
+    entries.clear();
+    ctxt_entries.clear();
+    return false;
+  }
+  if (!expression.empty())
+    plural_forms = PluralForms::from_string(expression);
+  return true;
+}
+
 void
 Dictionary::set_plural_forms(const PluralForms& plural_forms_)
 {
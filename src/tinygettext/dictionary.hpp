@@ -18,6 +18,7 @@
 #ifndef HEADER_TINYGETTEXT_DICTIONARY_HPP
 #define HEADER_TINYGETTEXT_DICTIONARY_HPP
 
+#include <iosfwd>
 #include <map>
 #include <vector>
 #include <string>
@@ -103,6 +104,14 @@ public:
     return func;
   }
 
+  /** Writes all messages and the plural forms to a binary cache, which
+      can be loaded much faster than the .po file they were parsed from. */
+  bool write_cache(std::ostream& out) const;
+
+  /** Loads the messages from a cache written with write_cache, returns
+      false (leaving the dictionary empty) if it is invalid. */
+  bool read_cache(std::istream& in);
+
   void addFallback(Dictionary* fallback)
   {
       m_has_fallback = true;
@@ -17,6 +17,7 @@
 
 #include "dictionary_manager.hpp"
 
+#include "io/file_manager.hpp"
 #include "utils/log.hpp"
 
 #include <memory>
@@ -153,25 +154,7 @@ DictionaryManager::get_dictionary(const Language& language)
 
       if (!best_filename.empty())
       {
-        std::string pofile = *p + "/" + best_filename;
-        try
-        {
-          std::auto_ptr<std::istream> in = filesystem->open_file(pofile);
-          if (!in.get())
-          {
-              Log::error("tinygettext", "error: failure opening: '%s'.",
-                         pofile.c_str());
-          }
-          else
-          {
-            POParser::parse(pofile, *in, *dict);
-          }
-        }
-        catch(std::exception& e)
-        {
-          Log::error("tinygettext", "error: failure parsing: '%s'.", pofile.c_str());
-          Log::error("tinygettext", "%s", e.what());
-        }
+        load_po_file(*p + "/" + best_filename, best_filename, *dict);
       }
     }
 
@@ -184,6 +167,54 @@ DictionaryManager::get_dictionary(const Language& language)
   }
 }
 
+/** Loads a .po file into a dictionary, from the cache if it is newer than
+    the .po file. Otherwise the file is parsed and the cache is written. */
+void
+DictionaryManager::load_po_file(const std::string& pofile,
+                                const std::string& filename, Dictionary& dict)
+{
+  std::string cache_file;
+  if (!cache_directory.empty())
+  {
+    cache_file = cache_directory + filename + ".cache";
+    if (file_manager->fileExists(cache_file) &&
+        file_manager->fileIsNewer(cache_file, pofile))
+    {
+      std::ifstream in(cache_file.c_str(), std::ios::binary);
+      if (in.is_open() && dict.read_cache(in))
+        return;
+      Log::warn("tinygettext", "Ignoring invalid cache '%s'.",
+                cache_file.c_str());
+    }
+  }
+
+  try
+  {
+    std::auto_ptr<std::istream> in = filesystem->open_file(pofile);
+    if (!in.get())
+    {
+        Log::error("tinygettext", "error: failure opening: '%s'.",
+                   pofile.c_str());
+        return;
+    }
+    POParser::parse(pofile, *in, dict);
+  }
+  catch(std::exception& e)
+  {
+    Log::error("tinygettext", "error: failure parsing: '%s'.", pofile.c_str());
+    Log::error("tinygettext", "%s", e.what());
+    return;
+  }
+
+  if (!cache_file.empty())
+  {
+    std::ofstream out(cache_file.c_str(), std::ios::binary);
+    if (!out.is_open() || !dict.write_cache(out))
+      Log::warn("tinygettext", "Can not write cache '%s'.",
+                cache_file.c_str());
+  }
+}
+
 std::set<Language>
 DictionaryManager::get_languages()
 {
@@ -245,6 +276,13 @@ DictionaryManager::get_use_fuzzy() const
   return use_fuzzy;
 }
 
+void
+DictionaryManager::set_cache_directory(const std::string& pathname)
+{
+  clear_cache();
+  cache_directory = pathname;
+}
+
 void
 DictionaryManager::add_directory(const std::string& pathname)
 {
@@ -46,6 +46,9 @@ private:
   std::string charset;
   bool        use_fuzzy;
 
+  /** Directory the parsed .po files are cached in, empty to disable. */
+  std::string cache_directory;
+
   Language    current_language;
   Dictionary* current_dict;
 
@@ -54,6 +57,8 @@ private:
   std::auto_ptr<FileSystem> filesystem;
 
   void clear_cache();
+  void load_po_file(const std::string& pofile, const std::string& filename,
+                    Dictionary& dict);
 
 #ifdef DEBUG
     unsigned int m_magic_number;
@@ -86,6 +91,10 @@ public:
       added directories have higher priority then later added ones */
   void add_directory(const std::string& pathname);
 
+  /** Set the directory that parsed .po files are cached in, so that they
+      are only parsed again when they change */
+  void set_cache_directory(const std::string& pathname);
+
   /** Return a set of the available languages in their country code */
   std::set<Language> get_languages();
 
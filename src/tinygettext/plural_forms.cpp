@@ -90,7 +90,9 @@ PluralForms::from_string(const std::string& str)
   tPluralForms::const_iterator it= plural_forms.find(space_less_str);
   if (it != plural_forms.end())
   {
-    return it->second;
+    PluralForms result = it->second;
+    result.expression = space_less_str;
+    return result;
   }
   else
   {
@@ -29,6 +29,8 @@ class PluralForms
 private:
   unsigned int nplural;
   PluralFunc   plural;
+  /** The Plural-Forms header this was created from, without spaces. */
+  std::string  expression;
 
 public:
   static PluralForms from_string(const std::string& str);
@@ -44,6 +46,7 @@ public:
   {}
 
   unsigned int get_nplural() const { return nplural; }
+  const std::string& get_expression() const { return expression; }
   unsigned int get_plural(int n) const { if (plural) return plural(n); else return 0; }
 
   bool operator==(const PluralForms& other) { return nplural == other.nplural && plural == other.plural; }
@@ -51,6 +51,9 @@ public:
     virtual bool isTriggered(const Vec3 &old_pos, const Vec3 &new_pos,
                              unsigned int indx) OVERRIDE;
     virtual void reset(const Track &track) OVERRIDE;
+    // ------------------------------------------------------------------------
+    /** Goals are only triggered by the soccer balls, see update. */
+    virtual bool isTriggeredByKarts() const OVERRIDE { return false; }
 };   // CheckLine
 
 #endif
@@ -37,9 +37,6 @@
 CheckLine::CheckLine(const XMLNode &node,  unsigned int index)
          : CheckStructure(node, index)
 {
-    // Note that when this is called the karts have not been allocated
-    // in world, so we can't call world->getNumKarts()
-    m_previous_sign.resize(race_manager->getNumberOfKarts());
     std::string p1_string("p1");
     std::string p2_string("p2");
 
@@ -116,15 +113,17 @@ CheckLine::~CheckLine()
 
 }   // CheckLine
 // ----------------------------------------------------------------------------
-void CheckLine::reset(const Track &track)
+/** A kart can only cross the line if its path overlaps the box around the
+ *  end points.
+ */
+bool CheckLine::getBoundingBox(Vec3 *min, Vec3 *max) const
 {
-    CheckStructure::reset(track);
-    for(unsigned int i=0; i<m_previous_sign.size(); i++)
-    {
-        core::vector2df p = m_previous_position[i].toIrrVector2d();
-        m_previous_sign[i] = m_line.getPointOrientation(p)>=0;
-    }
-}   // reset
+    *min = m_left_point;
+    min->min(m_right_point);
+    *max = m_left_point;
+    max->max(m_right_point);
+    return true;
+}   // getBoundingBox
 
 // ----------------------------------------------------------------------------
 void CheckLine::changeDebugColor(bool is_active)
@@ -153,12 +152,16 @@ void CheckLine::changeDebugColor(bool is_active)
 bool CheckLine::isTriggered(const Vec3 &old_pos, const Vec3 &new_pos,
                             unsigned int indx)
 {
+    // The side of the previous position is computed instead of stored,
+    // since karts are only tested when they are close to the line.
     core::vector2df p=new_pos.toIrrVector2d();
     bool sign = m_line.getPointOrientation(p)>=0;
+    bool previous_sign =
+        m_line.getPointOrientation(old_pos.toIrrVector2d())>=0;
     bool result;
     // If the sign has changed, i.e. the infinite line was crossed somewhere,
     // check if the finite line was actually crossed:
-    if(sign!=m_previous_sign[indx] &&
+    if(sign!=previous_sign &&
         m_line.intersectWith(core::line2df(old_pos.toIrrVector2d(),
                                            new_pos.toIrrVector2d()),
                              m_cross_point) )
@@ -186,6 +189,5 @@ bool CheckLine::isTriggered(const Vec3 &old_pos, const Vec3 &new_pos,
     }
     else
         result = false;
-    m_previous_sign[indx] = sign;
     return result;
 }   // isTriggered
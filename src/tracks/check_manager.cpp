@@ -20,8 +20,12 @@
 
 #include <string>
 #include <algorithm>
+#include <math.h>
 
+#include "config/user_config.hpp"
 #include "io/xml_node.hpp"
+#include "karts/abstract_kart.hpp"
+#include "modes/world.hpp"
 #include "tracks/ambient_light_sphere.hpp"
 #include "tracks/check_cannon.hpp"
 #include "tracks/check_goal.hpp"
@@ -31,6 +35,19 @@
 #include "tracks/track.hpp"
 
 CheckManager *CheckManager::m_check_manager = NULL;
+const float   CheckManager::CELL_SIZE       = 32.0f;
+
+// ----------------------------------------------------------------------------
+CheckManager::CheckManager()
+{
+    m_all_checks.clear();
+    m_grid_min_x  = m_grid_min_z = 0.0f;
+    m_cell_size   = CELL_SIZE;
+    m_grid_size_x = m_grid_size_z = 0;
+    m_test_count  = 0;
+}   // CheckManager
+
+// ----------------------------------------------------------------------------
 
 /** Loads all check structure informaiton from the specified xml file.
  */
@@ -92,8 +109,76 @@ void CheckManager::load(const XMLNode &node)
         }
 
     }
+    buildGrid();
 }   // load
 
+// ----------------------------------------------------------------------------
+/** Sorts all check structures that are triggered by karts into the grid. */
+void CheckManager::buildGrid()
+{
+    m_unbounded_checks.clear();
+    m_check_min.clear();
+    m_check_max.clear();
+    m_grid.clear();
+    m_last_tested.assign(m_all_checks.size(), 0);
+    m_test_count = 0;
+
+    Vec3 grid_min( 9999999.9f), grid_max(-9999999.9f);
+    bool has_bounded = false;
+    for(unsigned int i=0; i<m_all_checks.size(); i++)
+    {
+        Vec3 min, max;
+        const bool bounded = m_all_checks[i]->getBoundingBox(&min, &max);
+        m_check_min.push_back(min);
+        m_check_max.push_back(max);
+        if(!m_all_checks[i]->isTriggeredByKarts())
+            continue;
+        if(!bounded)
+        {
+            m_unbounded_checks.push_back(i);
+            continue;
+        }
+        grid_min.min(min);
+        grid_max.max(max);
+        has_bounded = true;
+    }
+    if(!has_bounded)
+    {
+        m_grid_size_x = m_grid_size_z = 0;
+        return;
+    }
+
+    // Increase the cell size on very large tracks to limit memory usage
+    m_cell_size = std::max(CELL_SIZE,
+                           std::max(grid_max.getX()-grid_min.getX(),
+                                    grid_max.getZ()-grid_min.getZ())
+                           / MAX_CELLS);
+    m_grid_min_x  = grid_min.getX();
+    m_grid_min_z  = grid_min.getZ();
+    m_grid_size_x = std::min(MAX_CELLS, 1 + (unsigned int)
+                      ((grid_max.getX()-grid_min.getX())/m_cell_size));
+    m_grid_size_z = std::min(MAX_CELLS, 1 + (unsigned int)
+                      ((grid_max.getZ()-grid_min.getZ())/m_cell_size));
+    m_grid.resize(m_grid_size_x*m_grid_size_z);
+
+    for(unsigned int i=0; i<m_all_checks.size(); i++)
+    {
+        if(!m_all_checks[i]->isTriggeredByKarts() ||
+           std::find(m_unbounded_checks.begin(), m_unbounded_checks.end(), i)
+                != m_unbounded_checks.end())
+            continue;
+        const int x0 = (int)((m_check_min[i].getX()-m_grid_min_x)/m_cell_size);
+        const int z0 = (int)((m_check_min[i].getZ()-m_grid_min_z)/m_cell_size);
+        const int x1 = std::min((int)m_grid_size_x-1, (int)
+                       ((m_check_max[i].getX()-m_grid_min_x)/m_cell_size));
+        const int z1 = std::min((int)m_grid_size_z-1, (int)
+                       ((m_check_max[i].getZ()-m_grid_min_z)/m_cell_size));
+        for(int z=z0; z<=z1; z++)
+            for(int x=x0; x<=x1; x++)
+                m_grid[z*m_grid_size_x+x].push_back(i);
+    }
+}   // buildGrid
+
 // ----------------------------------------------------------------------------
 /** Private destructor (to make sure it is only called using the static
  *  destroy function). Frees all check structures.
@@ -115,19 +200,112 @@ void CheckManager::reset(const Track &track)
     std::vector<CheckStructure*>::iterator i;
     for(i=m_all_checks.begin(); i!=m_all_checks.end(); i++)
         (*i)->reset(track);
+
+    m_previous_position.clear();
+    World *world = World::getWorld();
+    for(unsigned int k=0; k<world->getNumKarts(); k++)
+        m_previous_position.push_back(world->getKart(k)->getXYZ());
+    m_triggered.clear();
 }   // reset
 
 // ----------------------------------------------------------------------------
-/** Updates all animations. Called one per time step.
+/** Tests all karts against the check structures near their path, then
+ *  triggers all check structures that were crossed, and finally updates
+ *  all check structures. Called one per time step.
  *  \param dt Time since last call.
  */
 void CheckManager::update(float dt)
 {
+    World *world = World::getWorld();
+    m_triggered.clear();
+    for(unsigned int k=0; k<world->getNumKarts(); k++)
+    {
+        const AbstractKart *kart = world->getKart(k);
+        if(kart->getKartAnimation()) continue;
+        const Vec3 &xyz = kart->getFrontXYZ();
+        testKart(k, m_previous_position[k], xyz);
+        m_previous_position[k] = xyz;
+    }   // for k<getNumKarts
+
+    for(unsigned int i=0; i<m_triggered.size(); i++)
+    {
+        CheckStructure *cs = m_all_checks[m_triggered[i].first];
+        const unsigned int kart_index = m_triggered[i].second;
+        // An earlier trigger in this time step can have deactivated this
+        // structure, e.g. another lap line of the same group.
+        if(!cs->isActive(kart_index)) continue;
+        if(UserConfigParams::m_check_debug)
+            Log::info("CheckStructure",
+                      "Check structure %d triggered for kart %s.",
+                      cs->getIndex(),
+                      world->getKart(kart_index)->getIdent().c_str());
+        cs->trigger(kart_index);
+    }
+
     std::vector<CheckStructure*>::iterator i;
     for(i=m_all_checks.begin(); i!=m_all_checks.end(); i++)
         (*i)->update(dt);
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Tests all check structures near the path of a kart from old_pos to
+ *  new_pos, and adds the ones that were crossed to m_triggered.
+ */
+void CheckManager::testKart(unsigned int kart_index, const Vec3 &old_pos,
+                            const Vec3 &new_pos)
+{
+    m_test_count++;
+    for(unsigned int i=0; i<m_unbounded_checks.size(); i++)
+        testCheck(m_unbounded_checks[i], kart_index, old_pos, new_pos);
+
+    if(m_grid.empty()) return;
+
+    const float min_x = std::min(old_pos.getX(), new_pos.getX());
+    const float max_x = std::max(old_pos.getX(), new_pos.getX());
+    const float min_z = std::min(old_pos.getZ(), new_pos.getZ());
+    const float max_z = std::max(old_pos.getZ(), new_pos.getZ());
+    const int x0 = std::max(0, (int)floorf((min_x-m_grid_min_x)/m_cell_size));
+    const int z0 = std::max(0, (int)floorf((min_z-m_grid_min_z)/m_cell_size));
+    const int x1 = std::min((int)m_grid_size_x-1,
+                            (int)floorf((max_x-m_grid_min_x)/m_cell_size));
+    const int z1 = std::min((int)m_grid_size_z-1,
+                            (int)floorf((max_z-m_grid_min_z)/m_cell_size));
+    for(int z=z0; z<=z1; z++)
+    {
+        for(int x=x0; x<=x1; x++)
+        {
+            const std::vector<unsigned int> &cell =
+                                                m_grid[z*m_grid_size_x+x];
+            for(unsigned int j=0; j<cell.size(); j++)
+            {
+                const unsigned int i = cell[j];
+                if(m_last_tested[i]==m_test_count) continue;
+                m_last_tested[i] = m_test_count;
+                if(max_x < m_check_min[i].getX() ||
+                   min_x > m_check_max[i].getX() ||
+                   max_z < m_check_min[i].getZ() ||
+                   min_z > m_check_max[i].getZ()    )
+                    continue;
+                testCheck(i, kart_index, old_pos, new_pos);
+            }
+        }
+    }
+}   // testKart
+
+// ----------------------------------------------------------------------------
+/** Tests if a kart triggers a check structure, and if so adds it to the list
+ *  of triggered check structures. Only active structures are tested.
+ */
+void CheckManager::testCheck(unsigned int check_index,
+                             unsigned int kart_index,
+                             const Vec3 &old_pos, const Vec3 &new_pos)
+{
+    CheckStructure *cs = m_all_checks[check_index];
+    if(cs->isActive(kart_index) &&
+       cs->isTriggered(old_pos, new_pos, kart_index))
+        m_triggered.push_back(std::make_pair(check_index, kart_index));
+}   // testCheck
+
 // ----------------------------------------------------------------------------
 /** Returns the index of the first check structures that triggers a new
  *  lap to be counted. It aborts if no lap structure is defined.
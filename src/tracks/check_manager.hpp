@@ -19,19 +19,26 @@
 #ifndef HEADER_CHECK_MANAGER_HPP
 #define HEADER_CHECK_MANAGER_HPP
 
+#include "utils/aligned_array.hpp"
 #include "utils/no_copy.hpp"
+#include "utils/vec3.hpp"
 
 #include <assert.h>
 #include <string>
+#include <utility>
 #include <vector>
 
 class CheckStructure;
 class Track;
 class XMLNode;
-class Vec3;
 
 /**
   * \brief Controls all checks structures of a track.
+  * The check structures that are triggered by karts are sorted into a
+  * coarse grid on the XZ plane, so that each time step only the check
+  * structures near the path of a kart are tested. All triggered check
+  * structures are collected first and then triggered after all karts were
+  * tested.
   * \ingroup tracks
   */
 class CheckManager : public NoCopy
@@ -39,9 +46,50 @@ class CheckManager : public NoCopy
 private:
     std::vector<CheckStructure*> m_all_checks;
     static CheckManager         *m_check_manager;
+
+    /** Size of a grid cell. Karts move much less than this in a time
+     *  step, so usually only one cell is visited per kart. */
+    static const float           CELL_SIZE;
+
+    /** Maximum number of cells in each direction. */
+    static const unsigned int    MAX_CELLS = 128;
+
+    /** Indices of the check structures that can be triggered anywhere. */
+    std::vector<unsigned int>    m_unbounded_checks;
+
+    /** The bounding box of each check structure (only X and Z are used),
+     *  as returned by CheckStructure::getBoundingBox. */
+    AlignedArray<Vec3>           m_check_min, m_check_max;
+
+    /** For each grid cell the indices of the check structures whose bounding
+     *  box overlaps the cell. */
+    std::vector<std::vector<unsigned int> > m_grid;
+
+    /** Lower corner and size of the grid. */
+    float                        m_grid_min_x, m_grid_min_z, m_cell_size;
+    unsigned int                 m_grid_size_x, m_grid_size_z;
+
+    /** Time step in which a check structure was last tested for the
+     *  current kart, to test structures in several cells only once. */
+    std::vector<unsigned int>    m_last_tested;
+    unsigned int                 m_test_count;
+
+    /** The position of each kart in the previous time step. */
+    AlignedArray<Vec3>           m_previous_position;
+
+    /** The check structure (index) and kart (index) of all check
+     *  structures triggered in this time step. */
+    std::vector<std::pair<unsigned int, unsigned int> > m_triggered;
+
+    void   buildGrid();
+    void   testKart(unsigned int kart_index, const Vec3 &old_pos,
+                    const Vec3 &new_pos);
+    void   testCheck(unsigned int check_index, unsigned int kart_index,
+                     const Vec3 &old_pos, const Vec3 &new_pos);
+
            /** Private constructor, to make sure it is only called via
             *  the static create function. */
-           CheckManager()       {m_all_checks.clear();};
+           CheckManager();
           ~CheckManager();
 public:
     void   load(const XMLNode &node);
@@ -19,6 +19,7 @@
 #include "tracks/check_sphere.hpp"
 
 #include <string>
+#include <math.h>
 #include <stdio.h>
 
 #include "io/xml_node.hpp"
@@ -68,3 +69,16 @@ bool CheckSphere::isTriggered(const Vec3 &old_pos, const Vec3 &new_pos,
     return (old_dist2>=m_radius2 && new_dist2 < m_radius2) ||
            (old_dist2< m_radius2 && new_dist2 >=m_radius2);
 }   // isTriggered
+
+// ----------------------------------------------------------------------------
+/** A kart can only enter or leave the sphere if its path overlaps the box
+ *  around the sphere. Karts are tested again when they leave the box, so
+ *  the inside flags and distances stay correct for all karts inside.
+ */
+bool CheckSphere::getBoundingBox(Vec3 *min, Vec3 *max) const
+{
+    const float radius = sqrtf(m_radius2);
+    *min = m_center_point - Vec3(radius, radius, radius);
+    *max = m_center_point + Vec3(radius, radius, radius);
+    return true;
+}   // getBoundingBox
@@ -91,29 +91,6 @@ void CheckStructure::reset(const Track &track)
     }   // for i<getNumKarts
 }   // reset
 
-// ----------------------------------------------------------------------------
-/** Updates all check structures. Called one per time step.
- *  \param dt Time since last call.
- */
-void CheckStructure::update(float dt)
-{
-    World *world = World::getWorld();
-    for(unsigned int i=0; i<world->getNumKarts(); i++)
-    {
-        const Vec3 &xyz = world->getKart(i)->getFrontXYZ();
-        if(world->getKart(i)->getKartAnimation()) continue;
-        // Only check active checklines.
-        if(m_is_active[i] && isTriggered(m_previous_position[i], xyz, i))
-        {
-            if(UserConfigParams::m_check_debug)
-                Log::info("CheckStructure", "Check structure %d triggered for kart %s.",
-                          m_index, world->getKart(i)->getIdent().c_str());
-            trigger(i);
-        }
-        m_previous_position[i] = xyz;
-    }   // for i<getNumKarts
-}   // update
-
 // ----------------------------------------------------------------------------
 /** Changes the status (active/inactive) of all check structures contained
  *  in the index list indices.
@@ -104,10 +104,14 @@ private:
 public:
                 CheckStructure(const XMLNode &node, unsigned int index);
     virtual    ~CheckStructure() {};
-    virtual void update(float dt);
+    // ------------------------------------------------------------------------
+    /** Called once per time step after the check manager has tested all
+     *  karts, for check structures that need to do more than that. */
+    virtual void update(float dt) {}
     virtual void changeDebugColor(bool is_active) {}
     /** True if going from old_pos to new_pos crosses this checkline. This function
-     *  is called from update (of the checkline structure).
+     *  is called from CheckManager::update for each kart that is close
+     *  enough and for which this check structure is active.
      *  \param old_pos  Position in previous frame.
      *  \param new_pos  Position in current frame.
      *  \param indx     Index of the kart, can be used to store kart specific
@@ -118,6 +122,25 @@ public:
     virtual void trigger(unsigned int kart_index);
     virtual void reset(const Track &track);
 
+    // ------------------------------------------------------------------------
+    /** Returns in min and max (only X and Z are used) a box that contains
+     *  all kart paths that can trigger this check structure, used by the
+     *  check manager to only test karts nearby.
+     *  eturn False if this check structure can be triggered anywhere. */
+    virtual bool getBoundingBox(Vec3 *min, Vec3 *max) const { return false; }
+    // ------------------------------------------------------------------------
+    /** True if this check structure is triggered by karts, and should
+     *  therefore be tested by the check manager. */
+    virtual bool isTriggeredByKarts() const { return true; }
+    // ------------------------------------------------------------------------
+    /** Returns if this check structure is active for a kart. */
+    bool isActive(unsigned int kart_index) const
+    {
+        return m_is_active[kart_index];
+    }   // isActive
+    // ------------------------------------------------------------------------
+    /** Returns the index of this check structure. */
+    unsigned int getIndex() const { return m_index; }
     // ------------------------------------------------------------------------
     /** Returns the type of this check structure. */
     CheckType getType() const { return m_check_type; }
@@ -65,6 +65,12 @@ GraphNode::GraphNode(unsigned int quad_index, unsigned int node_index)
     // Only this 2d point is needed later
     m_lower_center_2d = core::vector2df(m_lower_center.getX(),
                                         m_lower_center.getZ() );
+    m_line_direction_2d = core::vector2df(m_upper_center.getX(),
+                                          m_upper_center.getZ())
+                        - m_lower_center_2d;
+    m_line_length_2d    = m_line_direction_2d.getLength();
+    if(m_line_length_2d>0)
+        m_line_direction_2d /= m_line_length_2d;
 
 }   // GraphNode
 
@@ -104,6 +110,7 @@ void GraphNode::addSuccessor(unsigned int to)
 void GraphNode::setupPathsToNode()
 {
     if(m_successor_nodes.size()<2) return;
+    assert(m_successor_nodes.size()<128);
 
     const unsigned int num_nodes = QuadGraph::get()->getNumNodes();
     m_path_to_node.resize(num_nodes);
@@ -153,7 +160,7 @@ void GraphNode::markAllSuccessorsToUse(unsigned int n,
     // End recursion if the path to this node has already been found.
     if( (*path_to_node)[m_node_index] >-1) return;
 
-    (*path_to_node)[m_node_index] = n;
+    (*path_to_node)[m_node_index] = (signed char)n;
     for(unsigned int i=0; i<getNumberOfSuccessors(); i++)
     {
         GraphNode &gn = QuadGraph::get()->getNode(getSuccessor(i));
@@ -38,6 +38,9 @@ class QuadGraph;
   */
 class GraphNode
 {
+    /** The quad graph saves and restores the computed data of the nodes in
+     *  its navigation cache. */
+    friend class QuadGraph;
 public:
     /** To indiciate in which direction the track is going:
      *  straight, left, right. The undefined direction is used by the
@@ -97,11 +100,19 @@ private:
       *  from the center of the drivelines anyway. */
      core::line2df  m_line;
 
-     typedef std::vector<int> PathToNodeVector;
+     /** Unit vector (in 2d) from the lower to the upper center, and the
+      *  length of m_line. Used to compute the distance from the center line
+      *  quickly in getDistanceToCenterLine(), which the AI calls many times
+      *  per frame. */
+     core::vector2df m_line_direction_2d;
+     float           m_line_length_2d;
+
+     typedef std::vector<signed char> PathToNodeVector;
      /** This vector is only used if the graph node has more than one
       *  successor. In this case m_path_to_node[X] will contain the index
       *  of the successor to use in order to reach graph node X for this
-      *  graph nodes.  */
+      *  graph nodes (-1 if X can't be reached). One byte per entry is
+      *  enough, since no node has more than 127 successors. */
      PathToNodeVector  m_path_to_node;
 
      /** The direction for each of the successors. */
@@ -132,6 +143,21 @@ public:
     void         addSuccessor (unsigned int to);
     void         getDistances(const Vec3 &xyz, Vec3 *result);
     float        getDistance2FromPoint(const Vec3 &xyz);
+    // ------------------------------------------------------------------------
+    /** Returns the distance (in 2d) between a point and the center line of
+     *  this node, i.e. the absolute value of the X coordinate computed by
+     *  getDistances(), but without the arc length and only one sqrt.
+     *  \param xyz The point for which the distance is computed.
+     */
+    float        getDistanceToCenterLine(const Vec3 &xyz) const
+    {
+        core::vector2df p(xyz.getX()-m_lower_center_2d.X,
+                          xyz.getZ()-m_lower_center_2d.Y);
+        float t = p.dotProduct(m_line_direction_2d);
+        if(t<0)                     t = 0;
+        else if(t>m_line_length_2d) t = m_line_length_2d;
+        return (p - m_line_direction_2d*t).getLength();
+    }   // getDistanceToCenterLine
     void         setupPathsToNode();
     void         setChecklineRequirements(int latest_checkline);
     void         setDirectionData(unsigned int successor, DirectionType dir,
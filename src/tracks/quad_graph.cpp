@@ -21,24 +21,105 @@
 #include "LinearMath/btTransform.h"
 
 #include <IMesh.h>
-#include <ICameraSceneNode.h>
-#include "graphics/central_settings.hpp"
 #include "config/user_config.hpp"
 #include "graphics/callbacks.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/screenquad.hpp"
 #include "graphics/shaders.hpp"
-#include "graphics/rtts.hpp"
 #include "io/file_manager.hpp"
 #include "io/xml_node.hpp"
 #include "modes/world.hpp"
+#include "physics/triangle_mesh.hpp"
 #include "tracks/check_lap.hpp"
 #include "tracks/check_line.hpp"
 #include "tracks/check_manager.hpp"
 #include "tracks/quad_set.hpp"
 #include "tracks/track.hpp"
 #include "graphics/glwrap.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+
+#ifndef WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
 
+/** Magic number and version at the start of the cached navigation data of
+ *  a quad graph. The version must be increased whenever the layout of the
+ *  data written by saveCache changes. */
+static const char     QUAD_GRAPH_CACHE_MAGIC[4] = { 'S', 'T', 'K', 'G' };
+static const uint32_t QUAD_GRAPH_CACHE_VERSION  = 1;
+
+// ----------------------------------------------------------------------------
+/** Appends the binary representation of a value to the cache data. */
+template<typename T>
+static void writeCacheValue(std::string *out, const T &value)
+{
+    out->append((const char*)&value, sizeof(T));
+}   // writeCacheValue
+
+// ----------------------------------------------------------------------------
+/** Appends a vector, preceded by its size, to the cache data. */
+template<typename T>
+static void writeCacheVector(std::string *out, const std::vector<T> &v)
+{
+    writeCacheValue(out, (uint32_t)v.size());
+    if(!v.empty())
+        out->append((const char*)&v[0], v.size()*sizeof(T));
+}   // writeCacheVector
+
+// ----------------------------------------------------------------------------
+/** Reads values from the cached navigation data, and detects truncated
+ *  data. */
+class QuadGraphCacheReader
+{
+private:
+    const char *m_pos;
+    const char *m_end;
+    bool        m_ok;
+public:
+    QuadGraphCacheReader(const char *data, size_t size)
+        : m_pos(data), m_end(data+size), m_ok(true) {}
+    // ------------------------------------------------------------------------
+    template<typename T> T read()
+    {
+        T value = T();
+        if(!m_ok || (size_t)(m_end-m_pos) < sizeof(T))
+        {
+            m_ok = false;
+            return value;
+        }
+        memcpy(&value, m_pos, sizeof(T));
+        m_pos += sizeof(T);
+        return value;
+    }   // read
+    // ------------------------------------------------------------------------
+    template<typename T> void readVector(std::vector<T> *v)
+    {
+        const uint32_t n = read<uint32_t>();
+        if(!m_ok || (size_t)(m_end-m_pos)/sizeof(T) < n)
+        {
+            m_ok = false;
+            v->clear();
+            return;
+        }
+        v->resize(n);
+        if(n>0)
+            memcpy(&(*v)[0], m_pos, n*sizeof(T));
+        m_pos += n*sizeof(T);
+    }   // readVector
+    // ------------------------------------------------------------------------
+    /** True if all values could be read, and nothing is left. */
+    bool isComplete() const { return m_ok && m_pos==m_end; }
+};   // QuadGraphCacheReader
+
+// ----------------------------------------------------------------------------
 const int QuadGraph::UNKNOWN_SECTOR  = -1;
 QuadGraph *QuadGraph::m_quad_graph = NULL;
 
@@ -55,12 +136,22 @@ QuadGraph::QuadGraph(const std::string &quad_file_name,
     m_mesh                 = NULL;
     m_mesh_buffer          = NULL;
     m_lap_length           = 0;
-    m_new_rtt              = NULL;
+    m_cache_dirty          = false;
+    m_paths_cached         = false;
+    m_has_checkline_requirements = false;
     QuadSet::create();
     QuadSet::get()->init(quad_file_name);
     m_quad_filename        = quad_file_name;
+    m_graph_filename       = graph_file_name;
     m_quad_graph           = this;
-    load(graph_file_name);
+    // The derived navigation data only depends on the quad and graph files,
+    // so it is only computed once and then loaded from the cache
+    if(!loadCache())
+    {
+        load(graph_file_name);
+        buildSectorGrid();
+        m_cache_dirty = true;
+    }
 }   // QuadGraph
 
 // -----------------------------------------------------------------------------
@@ -73,8 +164,6 @@ QuadGraph::~QuadGraph()
     }
     if(UserConfigParams::m_track_debug)
         cleanupDebugMesh();
-    if (m_new_rtt != NULL)
-        delete m_new_rtt;
 }   // ~QuadGraph
 
 // -----------------------------------------------------------------------------
@@ -207,6 +296,260 @@ void QuadGraph::load(const std::string &filename)
     }
 }   // load
 
+// ----------------------------------------------------------------------------
+/** Returns the file the navigation data of this graph is cached in. The
+ *  name depends on the track, the quad file of the graph mode and whether
+ *  the graph is reversed.
+ */
+std::string QuadGraph::getCacheFile() const
+{
+    const std::string track =
+        StringUtils::getBasename(StringUtils::getPath(m_quad_filename));
+    const std::string quads =
+        StringUtils::removeExtension(StringUtils::getBasename(m_quad_filename));
+    std::string dir = file_manager->getCachedMeshesDir() + "quad_graphs/";
+    file_manager->checkAndCreateDirectoryP(dir);
+    return dir + track + "-" + quads + (m_reverse ? "-reverse" : "")
+         + ".qgc";
+}   // getCacheFile
+
+// ----------------------------------------------------------------------------
+/** Loads the graph nodes with all derived data (successors, distances,
+ *  directions, paths to nodes and checkline requirements) and the sector
+ *  grid from the cache, which avoids parsing the graph file and computing
+ *  this data again. The cache is only used if it is newer than the quad
+ *  and graph file, and the cached checkline requirements only if the cache
+ *  is also newer than the scene file (which defines the checklines).
+ *  \return False if the cache doesn't exist, is outdated or invalid.
+ */
+bool QuadGraph::loadCache()
+{
+    const std::string cache_file = getCacheFile();
+    if(!file_manager->fileExists(cache_file) ||
+       file_manager->fileIsNewer(m_quad_filename, cache_file) ||
+       (file_manager->fileExists(m_graph_filename) &&
+        file_manager->fileIsNewer(m_graph_filename, cache_file)     ))
+        return false;
+
+    const char *data = NULL;
+    size_t size = 0;
+#ifdef WIN32
+    std::vector<char> content;
+    FILE *file = fopen(cache_file.c_str(), "rb");
+    if(!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if(file_size > 0)
+    {
+        content.resize(file_size);
+        if(fread(&content[0], file_size, 1, file) == 1)
+        {
+            data = &content[0];
+            size = file_size;
+        }
+    }
+    fclose(file);
+#else
+    int fd = open(cache_file.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size > 0)
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map != MAP_FAILED)
+    {
+        data = (const char*)map;
+        size = st.st_size;
+    }
+#endif
+
+    const unsigned int num_quads = QuadSet::get()->getNumberOfQuads();
+    bool has_checklines = false;
+    bool ok = data && size > 4 &&
+              memcmp(data, QUAD_GRAPH_CACHE_MAGIC, 4) == 0;
+    if(ok)
+    {
+        QuadGraphCacheReader reader(data+4, size-4);
+        ok = reader.read<uint32_t>() == QUAD_GRAPH_CACHE_VERSION   &&
+             reader.read<uint8_t>()  == (m_reverse ? 1 : 0)        &&
+             reader.read<uint32_t>() == num_quads;
+        const uint32_t num_nodes = reader.read<uint32_t>();
+        has_checklines   = reader.read<uint8_t>() != 0;
+        m_lap_length     = reader.read<float>();
+        m_grid_min_x     = reader.read<float>();
+        m_grid_min_z     = reader.read<float>();
+        m_grid_cell_size = reader.read<float>();
+        m_grid_size_x    = reader.read<int32_t>();
+        m_grid_size_z    = reader.read<int32_t>();
+        reader.readVector(&m_grid_start);
+        reader.readVector(&m_grid_nodes);
+        if(has_checklines)
+            m_cached_checkline_requirements.resize(num_nodes);
+        for(unsigned int i=0; ok && i<num_nodes; i++)
+        {
+            const uint32_t quad_index = reader.read<uint32_t>();
+            if(quad_index >= num_quads)
+            {
+                ok = false;
+                break;
+            }
+            GraphNode *node = new GraphNode(quad_index, i);
+            m_all_nodes.push_back(node);
+            node->m_distance_from_start = reader.read<float>();
+            reader.readVector(&node->m_successor_nodes);
+            reader.readVector(&node->m_predecessor_nodes);
+            reader.readVector(&node->m_distance_to_next);
+            reader.readVector(&node->m_angle_to_next);
+            reader.readVector(&node->m_direction);
+            reader.readVector(&node->m_last_index_same_direction);
+            reader.readVector(&node->m_path_to_node);
+            if(has_checklines)
+                reader.readVector(&m_cached_checkline_requirements[i]);
+        }
+        ok = ok && reader.isComplete();
+
+        // Make sure that invalid data can't result in out of bound accesses
+        if(m_grid_size_x<0 || m_grid_size_z<0 ||
+           (num_nodes>0 && m_grid_start.size()!=
+                          (size_t)m_grid_size_x*m_grid_size_z+1) ||
+           (!m_grid_start.empty() && m_grid_start.back()!=m_grid_nodes.size()))
+            ok = false;
+        for(unsigned int i=0; ok && i<m_grid_nodes.size(); i++)
+            ok = m_grid_nodes[i]>=0 && m_grid_nodes[i]<(int)num_nodes;
+        for(unsigned int i=0; ok && i<m_all_nodes.size(); i++)
+        {
+            const GraphNode *node = m_all_nodes[i];
+            const size_t n = node->m_successor_nodes.size();
+            ok = node->m_distance_to_next.size()          == n &&
+                 node->m_angle_to_next.size()             == n &&
+                 node->m_direction.size()                 == n &&
+                 node->m_last_index_same_direction.size() == n &&
+                 (node->m_path_to_node.empty() ||
+                  node->m_path_to_node.size()==num_nodes     );
+            for(unsigned int j=0; ok && j<n; j++)
+            {
+                ok = node->m_successor_nodes[j]>=0 &&
+                     node->m_successor_nodes[j]<(int)num_nodes &&
+                     node->m_last_index_same_direction[j]<num_nodes;
+            }
+            for(unsigned int j=0; ok && j<node->m_predecessor_nodes.size();
+                j++)
+            {
+                ok = node->m_predecessor_nodes[j]>=0 &&
+                     node->m_predecessor_nodes[j]<(int)num_nodes;
+            }
+        }
+    }
+#ifndef WIN32
+    if(data)
+        munmap((void*)data, size);
+#endif
+
+    if(!ok)
+    {
+        if(data)
+        {
+            Log::info("Quad Graph", "Discarding cached navigation data '%s'.",
+                      cache_file.c_str());
+            remove(cache_file.c_str());
+        }
+        for(unsigned int i=0; i<m_all_nodes.size(); i++)
+            delete m_all_nodes[i];
+        m_all_nodes.clear();
+        m_grid_start.clear();
+        m_grid_nodes.clear();
+        m_grid_size_x = m_grid_size_z = 0;
+        m_lap_length = 0;
+        m_cached_checkline_requirements.clear();
+        return false;
+    }
+
+    const std::string scene_file =
+        StringUtils::getPath(m_quad_filename) + "/scene.xml";
+    if(has_checklines && file_manager->fileExists(scene_file) &&
+       file_manager->fileIsNewer(scene_file, cache_file))
+        m_cached_checkline_requirements.clear();
+    m_paths_cached = true;
+    return true;
+}   // loadCache
+
+// ----------------------------------------------------------------------------
+/** Saves the navigation data in the cache if it was computed in this race
+ *  (see loadCache). Must be called once the paths were set up, and after
+ *  computeChecklineRequirements if the mode uses them. The data is first
+ *  written to a temporary file, so an interrupted write never leaves a
+ *  truncated cache file.
+ */
+void QuadGraph::saveCache()
+{
+    if(!m_cache_dirty)
+        return;
+    m_cache_dirty = false;
+
+    const bool pending_checklines =
+        m_cached_checkline_requirements.size()==m_all_nodes.size() &&
+        !m_all_nodes.empty();
+    const bool has_checklines = m_has_checkline_requirements ||
+                                pending_checklines;
+
+    std::string data(QUAD_GRAPH_CACHE_MAGIC, 4);
+    writeCacheValue(&data, QUAD_GRAPH_CACHE_VERSION);
+    writeCacheValue(&data, (uint8_t)(m_reverse ? 1 : 0));
+    writeCacheValue(&data, (uint32_t)QuadSet::get()->getNumberOfQuads());
+    writeCacheValue(&data, (uint32_t)m_all_nodes.size());
+    writeCacheValue(&data, (uint8_t)(has_checklines ? 1 : 0));
+    writeCacheValue(&data, m_lap_length);
+    writeCacheValue(&data, m_grid_min_x);
+    writeCacheValue(&data, m_grid_min_z);
+    writeCacheValue(&data, m_grid_cell_size);
+    writeCacheValue(&data, (int32_t)m_grid_size_x);
+    writeCacheValue(&data, (int32_t)m_grid_size_z);
+    writeCacheVector(&data, m_grid_start);
+    writeCacheVector(&data, m_grid_nodes);
+    for(unsigned int i=0; i<m_all_nodes.size(); i++)
+    {
+        const GraphNode *node = m_all_nodes[i];
+        writeCacheValue(&data, (uint32_t)node->m_quad_index);
+        writeCacheValue(&data, node->m_distance_from_start);
+        writeCacheVector(&data, node->m_successor_nodes);
+        writeCacheVector(&data, node->m_predecessor_nodes);
+        writeCacheVector(&data, node->m_distance_to_next);
+        writeCacheVector(&data, node->m_angle_to_next);
+        writeCacheVector(&data, node->m_direction);
+        writeCacheVector(&data, node->m_last_index_same_direction);
+        writeCacheVector(&data, node->m_path_to_node);
+        if(has_checklines)
+        {
+            writeCacheVector(&data, m_has_checkline_requirements
+                                    ? node->m_checkline_requirements
+                                    : m_cached_checkline_requirements[i]);
+        }
+    }
+
+    const std::string cache_file = getCacheFile();
+    const std::string tmp = cache_file + ".tmp";
+    FILE *file = fopen(tmp.c_str(), "wb");
+    if(!file)
+    {
+        Log::warn("Quad Graph", "Can't write cached navigation data '%s'.",
+                  tmp.c_str());
+        return;
+    }
+    bool ok = fwrite(data.data(), data.size(), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    remove(cache_file.c_str());
+    if(!ok || rename(tmp.c_str(), cache_file.c_str()) != 0)
+    {
+        Log::warn("Quad Graph", "Can't write cached navigation data '%s'.",
+                  cache_file.c_str());
+        remove(tmp.c_str());
+    }
+}   // saveCache
+
 // ----------------------------------------------------------------------------
 /** Returns the index of the first graph node (i.e. the graph node which
  *  will trigger a new lap when a kart first enters it). This is always
@@ -225,8 +568,20 @@ unsigned int QuadGraph::getStartNode() const
  */
 void QuadGraph::computeChecklineRequirements()
 {
+    m_has_checkline_requirements = true;
+    if(m_cached_checkline_requirements.size()==m_all_nodes.size())
+    {
+        for(unsigned int i=0; i<m_all_nodes.size(); i++)
+        {
+            m_all_nodes[i]->m_checkline_requirements.swap(
+                                            m_cached_checkline_requirements[i]);
+        }
+        m_cached_checkline_requirements.clear();
+        return;
+    }
     computeChecklineRequirements(m_all_nodes[0],
                                  CheckManager::get()->getLapLineIndex());
+    m_cache_dirty = true;
 }   // computeChecklineRequirements
 
 // ----------------------------------------------------------------------------
@@ -283,12 +638,52 @@ void QuadGraph::computeChecklineRequirements(GraphNode* node,
  */
 void QuadGraph::setupPaths()
 {
+    if(m_paths_cached)
+        return;
     for(unsigned int i=0; i<getNumNodes(); i++)
     {
         m_all_nodes[i]->setupPathsToNode();
     }
 }   // setupPaths
 
+// -----------------------------------------------------------------------------
+/** Returns if there might be track geometry (e.g. the ceiling of a tunnel)
+ *  above a point on a graph node, so that an upwards raycast can be avoided
+ *  on most of a track. This is determined once per node, by querying the
+ *  track mesh for triangles in the column above the bounding box of the
+ *  quad, starting a bit above its lowest point. Points outside of that box
+ *  are always reported to have terrain above.
+ *  \param node The graph node the point is on.
+ *  \param xyz The point.
+ */
+bool QuadGraph::hasTerrainAbove(int node, const Vec3 &xyz) const
+{
+    if(node==UNKNOWN_SECTOR)
+        return true;
+    const Quad &quad = getQuadOfNode(node);
+    Vec3 min = quad[0], max = quad[0];
+    for(unsigned int i=1; i<4; i++)
+    {
+        min.setMin(quad[i]);
+        max.setMax(quad[i]);
+    }
+    if(xyz.getX()<min.getX() || xyz.getX()>max.getX() ||
+       xyz.getZ()<min.getZ() || xyz.getZ()>max.getZ()    )
+        return true;
+
+    if(m_terrain_above.size()!=m_all_nodes.size())
+        m_terrain_above.assign(m_all_nodes.size(), -1);
+    if(m_terrain_above[node]<0)
+    {
+        min.setY(quad.getMinHeight()+1.0f);
+        max.setY(10000.0f);
+        const TriangleMesh &tm =
+                             World::getWorld()->getTrack()->getTriangleMesh();
+        m_terrain_above[node] = tm.hasTrianglesInBox(min, max) ? 1 : 0;
+    }
+    return m_terrain_above[node]==1;
+}   // hasTerrainAbove
+
 // -----------------------------------------------------------------------------
 /** This function sets a default successor for all graph nodes that currently
  *  don't have a successor defined. The default successor of node X is X+1.
@@ -473,30 +868,7 @@ void QuadGraph::createMesh(bool show_invisible,
     {
         video::S3DVertex lap_v[4];
         irr::u16         lap_ind[6];
-        video::SColor     c(128, 255, 0, 0);
-        m_all_nodes[0]->getQuad().getVertices(lap_v, *lap_color);
-
-        // Now scale the length (distance between vertix 0 and 3
-        // and between 1 and 2) to be 'length':
-        Vec3 bb_min, bb_max;
-        QuadSet::get()->getBoundingBox(&bb_min, &bb_max);
-        // Length of the lap line about 3% of the 'height'
-        // of the track.
-        const float length=(bb_max.getZ()-bb_min.getZ())*0.03f;
-
-        core::vector3df dl = lap_v[3].Pos-lap_v[0].Pos;
-        float ll2 = dl.getLengthSQ();
-        if(ll2<0.001)
-            lap_v[3].Pos = lap_v[0].Pos+core::vector3df(0, 0, 1);
-        else
-            lap_v[3].Pos = lap_v[0].Pos+dl*length/sqrt(ll2);
-
-        core::vector3df dr = lap_v[2].Pos-lap_v[1].Pos;
-        float lr2 = dr.getLengthSQ();
-        if(lr2<0.001)
-            lap_v[2].Pos = lap_v[1].Pos+core::vector3df(0, 0, 1);
-        else
-            lap_v[2].Pos = lap_v[1].Pos+dr*length/sqrt(lr2);
+        getLapLineVertices(lap_v, *lap_color);
         lap_ind[0] = 2;
         lap_ind[1] = 1;
         lap_ind[2] = 0;
@@ -533,6 +905,40 @@ void QuadGraph::createMesh(bool show_invisible,
     delete[] new_v;
 }   // createMesh
 
+// -----------------------------------------------------------------------------
+/** Computes the four vertices of the lap counting line shown on the mini
+ *  map: the first quad, shortened to about 3% of the 'height' of the track.
+ *  \param v Array of four vertices to fill.
+ *  \param color Colour of the lap line.
+ */
+void QuadGraph::getLapLineVertices(video::S3DVertex *v,
+                                   const video::SColor &color) const
+{
+    m_all_nodes[0]->getQuad().getVertices(v, color);
+
+    // Now scale the length (distance between vertix 0 and 3
+    // and between 1 and 2) to be 'length':
+    Vec3 bb_min, bb_max;
+    QuadSet::get()->getBoundingBox(&bb_min, &bb_max);
+    // Length of the lap line about 3% of the 'height'
+    // of the track.
+    const float length=(bb_max.getZ()-bb_min.getZ())*0.03f;
+
+    core::vector3df dl = v[3].Pos-v[0].Pos;
+    float ll2 = dl.getLengthSQ();
+    if(ll2<0.001)
+        v[3].Pos = v[0].Pos+core::vector3df(0, 0, 1);
+    else
+        v[3].Pos = v[0].Pos+dl*length/sqrt(ll2);
+
+    core::vector3df dr = v[2].Pos-v[1].Pos;
+    float lr2 = dr.getLengthSQ();
+    if(lr2<0.001)
+        v[2].Pos = v[1].Pos+core::vector3df(0, 0, 1);
+    else
+        v[2].Pos = v[1].Pos+dr*length/sqrt(lr2);
+}   // getLapLineVertices
+
 // -----------------------------------------------------------------------------
 
 /** Creates the debug mesh to display the quad graph on top of the track
@@ -809,6 +1215,168 @@ void QuadGraph::spatialToTrack(Vec3 *dst, const Vec3& xyz,
     getNode(sector).getDistances(xyz, dst);
 }   // spatialToTrack
 
+//-----------------------------------------------------------------------------
+/** Builds the sector grid: a uniform grid in the XZ plane, where each cell
+ *  stores the indices of all graph nodes whose quad overlaps the cell. The
+ *  cell size is the average extent of a quad, so that a cell only contains
+ *  a few nodes (plus the nodes of overlapping parts of the track, e.g. on
+ *  bridges), which makes the sector lookup O(1) on average.
+ */
+void QuadGraph::buildSectorGrid()
+{
+    m_grid_start.clear();
+    m_grid_nodes.clear();
+    m_grid_size_x = m_grid_size_z = 0;
+    if(m_all_nodes.empty())
+        return;
+
+    float min_x =  999999.9f, min_z =  999999.9f;
+    float max_x = -999999.9f, max_z = -999999.9f;
+    float sum_size = 0;
+    for(unsigned int i=0; i<m_all_nodes.size(); i++)
+    {
+        const Quad &q = getQuadOfNode(i);
+        float q_min_x = std::min(std::min(q[0].getX(), q[1].getX()),
+                                 std::min(q[2].getX(), q[3].getX()));
+        float q_max_x = std::max(std::max(q[0].getX(), q[1].getX()),
+                                 std::max(q[2].getX(), q[3].getX()));
+        float q_min_z = std::min(std::min(q[0].getZ(), q[1].getZ()),
+                                 std::min(q[2].getZ(), q[3].getZ()));
+        float q_max_z = std::max(std::max(q[0].getZ(), q[1].getZ()),
+                                 std::max(q[2].getZ(), q[3].getZ()));
+        min_x = std::min(min_x, q_min_x);
+        max_x = std::max(max_x, q_max_x);
+        min_z = std::min(min_z, q_min_z);
+        max_z = std::max(max_z, q_max_z);
+        sum_size += std::max(q_max_x-q_min_x, q_max_z-q_min_z);
+    }
+
+    // Limit the number of cells to 512x512, and avoid a zero cell size
+    // for degenerated quads.
+    m_grid_cell_size = std::max(sum_size/m_all_nodes.size(), 1.0f);
+    m_grid_cell_size = std::max(m_grid_cell_size,
+                                std::max(max_x-min_x, max_z-min_z)/512.0f);
+    m_grid_min_x  = min_x;
+    m_grid_min_z  = min_z;
+    m_grid_size_x = (int)((max_x-min_x)/m_grid_cell_size)+1;
+    m_grid_size_z = (int)((max_z-min_z)/m_grid_cell_size)+1;
+
+    // First count the nodes in each cell, then fill in the node indices.
+    std::vector< std::vector<int> > cells(m_grid_size_x*m_grid_size_z);
+    for(unsigned int i=0; i<m_all_nodes.size(); i++)
+    {
+        const Quad &q = getQuadOfNode(i);
+        int x0 = m_grid_size_x, x1 = -1, z0 = m_grid_size_z, z1 = -1;
+        for(unsigned int j=0; j<4; j++)
+        {
+            x0 = std::min(x0, getGridCellX(q[j].getX()));
+            x1 = std::max(x1, getGridCellX(q[j].getX()));
+            z0 = std::min(z0, getGridCellZ(q[j].getZ()));
+            z1 = std::max(z1, getGridCellZ(q[j].getZ()));
+        }
+        for(int z=z0; z<=z1; z++)
+            for(int x=x0; x<=x1; x++)
+                cells[z*m_grid_size_x+x].push_back(i);
+    }
+
+    m_grid_start.resize(cells.size()+1);
+    m_grid_start[0] = 0;
+    for(unsigned int i=0; i<cells.size(); i++)
+    {
+        m_grid_nodes.insert(m_grid_nodes.end(), cells[i].begin(),
+                            cells[i].end());
+        m_grid_start[i+1] = (unsigned int)m_grid_nodes.size();
+    }
+}   // buildSectorGrid
+
+//-----------------------------------------------------------------------------
+/** Returns the column of the sector grid for a X coordinate. Coordinates
+ *  outside of the grid are clamped to the first or last column. */
+int QuadGraph::getGridCellX(float x) const
+{
+    int i = (int)floorf((x-m_grid_min_x)/m_grid_cell_size);
+    return i<0 ? 0 : (i>=m_grid_size_x ? m_grid_size_x-1 : i);
+}   // getGridCellX
+
+//-----------------------------------------------------------------------------
+/** Returns the row of the sector grid for a Z coordinate. Coordinates
+ *  outside of the grid are clamped to the first or last row. */
+int QuadGraph::getGridCellZ(float z) const
+{
+    int i = (int)floorf((z-m_grid_min_z)/m_grid_cell_size);
+    return i<0 ? 0 : (i>=m_grid_size_z ? m_grid_size_z-1 : i);
+}   // getGridCellZ
+
+//-----------------------------------------------------------------------------
+/** Finds the graph node with the closest driveline to xyz (in 2d) using the
+ *  sector grid. The cells are tested in rings of increasing distance around
+ *  the cell of xyz, until no cell of the next ring can contain a closer
+ *  driveline. If several nodes have the same distance, the one that would
+ *  be tested first in a linear search starting at node 'first' is used, so
+ *  the result is the same as that of a linear search.
+ *  \param xyz The point for which to find the closest node.
+ *  \param first Node at which a linear search would start.
+ *  \param test_height If set, only nodes whose quad is between 1 below
+ *         and 5 above xyz are considered.
+ *  \param min_sector On return the closest node, or UNKNOWN_SECTOR.
+ *  \param min_dist_2 On return the squared distance to the closest node.
+ */
+void QuadGraph::findClosestInGrid(const Vec3 &xyz, int first,
+                                  bool test_height, int *min_sector,
+                                  float *min_dist_2) const
+{
+    const int n  = (int)m_all_nodes.size();
+    const int cx = getGridCellX(xyz.getX());
+    const int cz = getGridCellZ(xyz.getZ());
+    const int max_ring = std::max(std::max(cx, m_grid_size_x-1-cx),
+                                  std::max(cz, m_grid_size_z-1-cz));
+    *min_sector = UNKNOWN_SECTOR;
+    *min_dist_2 = 999999.0f*999999.0f;
+    int min_order = n;
+    for(int ring=0; ring<=max_ring; ring++)
+    {
+        // All cells of this ring are at least (ring-1) cells away from
+        // the (clamped) point xyz.
+        float d = (ring-1)*m_grid_cell_size;
+        if(*min_sector!=UNKNOWN_SECTOR && d>0 && d*d>*min_dist_2)
+            break;
+        for(int z=cz-ring; z<=cz+ring; z++)
+        {
+            if(z<0 || z>=m_grid_size_z) continue;
+            // Only the cells on the border of the ring are new.
+            bool border = z==cz-ring || z==cz+ring;
+            for(int x=cx-ring; x<=cx+ring; x+= border ? 1 : 2*ring)
+            {
+                if(x>=0 && x<m_grid_size_x)
+                {
+                    int cell = z*m_grid_size_x+x;
+                    for(unsigned int i=m_grid_start[cell];
+                        i<m_grid_start[cell+1]; i++)
+                    {
+                        int indx   = m_grid_nodes[i];
+                        float dist_2 =
+                            m_all_nodes[indx]->getDistance2FromPoint(xyz);
+                        if(dist_2>*min_dist_2) continue;
+                        int order = (indx-first+n) % n;
+                        if(dist_2==*min_dist_2 && order>=min_order)
+                            continue;
+                        if(test_height)
+                        {
+                            float dist = xyz.getY()
+                                       - getQuadOfNode(indx).getMinHeight();
+                            if(dist>=5.0f || dist<=-1.0f) continue;
+                        }
+                        *min_dist_2 = dist_2;
+                        *min_sector = indx;
+                        min_order   = order;
+                    }   // for i in cell
+                }
+                if(ring==0) break;
+            }   // for x
+        }   // for z
+    }   // for ring
+}   // findClosestInGrid
+
 //-----------------------------------------------------------------------------
 /** findRoadSector returns in which sector on the road the position
  *  xyz is. If xyz is not on top of the road, it sets UNKNOWN_SECTOR as sector.
@@ -848,6 +1416,38 @@ void QuadGraph::findRoadSector(const Vec3& xyz, int *sector,
     unsigned int max_count  = (*sector!=UNKNOWN_SECTOR && all_sectors!=NULL)
                             ? (unsigned int)all_sectors->size()
                             : (unsigned int)m_all_nodes.size();
+
+    // Without a list of sectors to test, only the nodes in the cell of the
+    // sector grid that contains xyz need to be tested.
+    if(max_count==m_all_nodes.size() && !m_grid_start.empty())
+    {
+        all_sectors = NULL;
+        const int n     = (int)m_all_nodes.size();
+        const int first = indx<n-1 ? indx+1 : 0;
+        int   min_order = n;
+        *sector = UNKNOWN_SECTOR;
+        int cell = getGridCellZ(xyz.getZ())*m_grid_size_x
+                 + getGridCellX(xyz.getX());
+        for(unsigned int i=m_grid_start[cell]; i<m_grid_start[cell+1]; i++)
+        {
+            indx = m_grid_nodes[i];
+            const Quad &q = getQuadOfNode(indx);
+            float dist    = xyz.getY() - q.getMinHeight();
+            // Same as below: if several quads are found, the lowest one is
+            // used, and for identical heights the one a linear search
+            // would have found first.
+            int order = (indx-first+n) % n;
+            if((dist < min_dist || (dist==min_dist && order<min_order)) &&
+                dist>-1.0f && q.pointInQuad(xyz))
+            {
+                min_dist  = dist;
+                min_order = order;
+                *sector   = indx;
+            }
+        }
+        return;
+    }
+
     *sector = UNKNOWN_SECTOR;
     for(unsigned int i=0; i<max_count; i++)
     {
@@ -928,6 +1528,24 @@ int QuadGraph::findOutOfRoadSector(const Vec3& xyz,
     int   min_sector = UNKNOWN_SECTOR;
     float min_dist_2 = 999999.0f*999999.0f;
 
+    // Without a list of sectors, use the sector grid to only test the
+    // drivelines close to xyz (with the same two phases as below).
+    if(!all_sectors && !m_grid_start.empty())
+    {
+        int first = current_sector+1 == (int)getNumNodes() ? 0
+                                                           : current_sector+1;
+        findClosestInGrid(xyz, first, /*test_height*/true, &min_sector,
+                          &min_dist_2);
+        if(min_sector==UNKNOWN_SECTOR)
+            findClosestInGrid(xyz, first, /*test_height*/false, &min_sector,
+                              &min_dist_2);
+        if(min_sector==UNKNOWN_SECTOR )
+        {
+            Log::info("Quad Grap", "unknown sector found.");
+        }
+        return min_sector;
+    }
+
     // If a kart is falling and in between (or too far below)
     // a driveline point it might not fulfill
     // the height condition. So we run the test twice: first with height
@@ -976,141 +1594,171 @@ int QuadGraph::findOutOfRoadSector(const Vec3& xyz,
 }   // findOutOfRoadSector
 
 //-----------------------------------------------------------------------------
-/** Takes a snapshot of the driveline quads so they can be used as minimap.
+/** Fills a triangle of the mini map. The XZ coordinates of the points
+ *  (converted to pixels) are used, pixels are covered if their center is
+ *  inside the triangle, independent of its orientation.
  */
-void QuadGraph::makeMiniMap(const core::dimension2du &dimension,
-                            const std::string &name,
-                            const video::SColor &fill_color,
-                            video::ITexture** oldRttMinimap,
-                            FrameBuffer** newRttMinimap)
+static void fillMiniMapTriangle(const core::vector2df &a,
+                                const core::vector2df &b,
+                                const core::vector2df &c,
+                                const video::SColor &color,
+                                const core::dimension2du &dimension,
+                                std::vector<video::SColor> *pixels)
 {
-    const SColor oldClearColor = World::getWorld()->getClearColor();
-    World::getWorld()->setClearbackBufferColor(SColor(0, 255, 255, 255));
-    World::getWorld()->forceFogDisabled(true);
-    *oldRttMinimap = NULL;
-    *newRttMinimap = NULL;
-
-    RTT* newRttProvider = NULL;
-    IrrDriver::RTTProvider* oldRttProvider = NULL;
-    if (CVS->isGLSL())
-    {
-        m_new_rtt = newRttProvider = new RTT(dimension.Width, dimension.Height);
-    }
-    else
-    {
-        oldRttProvider = new IrrDriver::RTTProvider(dimension, name, true);
-    }
-
-    irr_driver->getSceneManager()->setAmbientLight(video::SColor(255, 255, 255, 255));
+    const float area = (b.X-a.X)*(c.Y-a.Y) - (b.Y-a.Y)*(c.X-a.X);
+    if(area==0)
+        return;
 
-    video::SColor red(128, 255, 0, 0);
-    createMesh(/*show_invisible part of the track*/ false,
-               /*enable_transparency*/ false,
-               /*track_color*/    &fill_color,
-               /*lap line color*/  &red                       );
+    const int min_x = std::max(0, (int)floorf(std::min(a.X, std::min(b.X, c.X))));
+    const int max_x = std::min((int)dimension.Width-1,
+                               (int)ceilf(std::max(a.X, std::max(b.X, c.X))));
+    const int min_y = std::max(0, (int)floorf(std::min(a.Y, std::min(b.Y, c.Y))));
+    const int max_y = std::min((int)dimension.Height-1,
+                               (int)ceilf(std::max(a.Y, std::max(b.Y, c.Y))));
+    const float sign = area > 0 ? 1.0f : -1.0f;
 
-    m_node = irr_driver->addMesh(m_mesh, "mini_map");
-#ifdef DEBUG
-    m_node->setName("minimap-mesh");
-#endif
+    for(int y=min_y; y<=max_y; y++)
+    {
+        const float py = y + 0.5f;
+        for(int x=min_x; x<=max_x; x++)
+        {
+            const float px = x + 0.5f;
+            const float w0 = sign*((b.X-a.X)*(py-a.Y) - (b.Y-a.Y)*(px-a.X));
+            const float w1 = sign*((c.X-b.X)*(py-b.Y) - (c.Y-b.Y)*(px-b.X));
+            const float w2 = sign*((a.X-c.X)*(py-c.Y) - (a.Y-c.Y)*(px-c.X));
+            if(w0>=0 && w1>=0 && w2>=0)
+                (*pixels)[y*dimension.Width+x] = color;
+        }
+    }
+}   // fillMiniMapTriangle
 
-    m_node->setAutomaticCulling(0);
-    m_node->setMaterialFlag(video::EMF_LIGHTING, false);
+//-----------------------------------------------------------------------------
+/** Draws the visible driveline quads and the lap line into an image, as
+ *  seen from above. This only uses the CPU, so it works without a GL
+ *  context (e.g. on a server). The mapping is the one used by
+ *  mapPoint2MiniMap, with the Z axis pointing up in the image.
+ *  \param dimension Size of the image.
+ *  \param fill_color Colour of the quads.
+ *  \param pixels On return the pixels of the image, row by row.
+ */
+void QuadGraph::rasterizeMiniMap(const core::dimension2du &dimension,
+                                 const video::SColor &fill_color,
+                                 std::vector<video::SColor> *pixels) const
+{
+    pixels->assign(dimension.Width*dimension.Height,
+                   video::SColor(0, 255, 255, 255));
 
-    // Add the camera:
-    // ---------------
-    scene::ICameraSceneNode *camera = irr_driver->addCameraSceneNode();
     Vec3 bb_min, bb_max;
     QuadSet::get()->getBoundingBox(&bb_min, &bb_max);
-    Vec3 center = (bb_max+bb_min)*0.5f;
-
-    float dx = bb_max.getX()-bb_min.getX();
-    float dz = bb_max.getZ()-bb_min.getZ();
-
-    // Set the scaling correctly. Also the center point (which is used
-    // as the camera position) needs to be adjusted: the track must
-    // be aligned to the left/top of the texture which is used (otherwise
-    // mapPoint2MiniMap doesn't work), so adjust the camera position
-    // that the track is properly aligned (view from the side):
-    //          c        camera
-    //         / \       .
-    //        /   \     <--- camera angle
-    //       /     \     .
-    //      {  [-]  }   <--- track flat (viewed from the side)
-    // If [-] is the shorter side of the track, then the camera will
-    // actually render the area in { } - which is the length of the
-    // longer side of the track.
-    // To align the [-] side to the left, the camera must be moved
-    // the distance betwwen '{' and '[' to the right. This distance
-    // is exacly (longer_side - shorter_side) / 2.
-    // So, adjust the center point by this amount:
-    if(dz > dx)
-    {
-        center.setX(center.getX() + (dz-dx)*0.5f);
-        m_scaling = dimension.Width / dz;
-    }
-    else
-    {
-        center.setZ(center.getZ() + (dx-dz)*0.5f);
-        m_scaling = dimension.Width / dx;
-    }
+    const float range = std::max(bb_max.getX()-bb_min.getX(),
+                                 bb_max.getZ()-bb_min.getZ());
+    if(range<=0)
+        return;
+    const float scale_x = dimension.Width  / range;
+    const float scale_y = dimension.Height / range;
 
-    float range = (dx>dz) ? dx : dz;
+    video::S3DVertex v[4];
+    core::vector2df p[4];
+    for(unsigned int n=0; n<=m_all_nodes.size(); n++)
+    {
+        // The last iteration draws the lap line on top of the quads
+        if(n<m_all_nodes.size())
+        {
+            if(m_all_nodes[n]->getQuad().isInvisible())
+                continue;
+            m_all_nodes[n]->getQuad().getVertices(v, fill_color);
+        }
+        else
+            getLapLineVertices(v, video::SColor(128, 255, 0, 0));
 
-    core::matrix4 projection;
-    projection.buildProjectionMatrixOrthoLH(range /* width */,
-                                            range /* height */,
-                                            -1, bb_max.getY()-bb_min.getY()+1);
-    camera->setProjectionMatrix(projection, true);
+        for(unsigned int i=0; i<4; i++)
+        {
+            p[i].X = (v[i].Pos.X - bb_min.getX())*scale_x;
+            p[i].Y = dimension.Height - (v[i].Pos.Z - bb_min.getZ())*scale_y;
+        }
+        fillMiniMapTriangle(p[0], p[1], p[2], v[0].Color, dimension, pixels);
+        fillMiniMapTriangle(p[0], p[2], p[3], v[0].Color, dimension, pixels);
+    }
+}   // rasterizeMiniMap
 
-    irr_driver->suppressSkyBox();
-    irr_driver->clearLights();
+//-----------------------------------------------------------------------------
+/** Returns the file the mini map of this graph is cached in. The name
+ *  depends on the track, the quad file of the graph mode, whether the graph
+ *  is reversed and the size of the mini map.
+ */
+std::string QuadGraph::getMiniMapCacheFile(const core::dimension2du &dimension) const
+{
+    const std::string track =
+        StringUtils::getBasename(StringUtils::getPath(m_quad_filename));
+    const std::string quads =
+        StringUtils::removeExtension(StringUtils::getBasename(m_quad_filename));
+    std::string dir = file_manager->getCachedTexturesDir() + "minimaps/";
+    file_manager->checkAndCreateDirectoryP(dir);
+    return dir + track + "-" + quads + (m_reverse ? "-reverse-" : "-")
+         + StringUtils::toString(dimension.Width) + "x"
+         + StringUtils::toString(dimension.Height) + ".png";
+}   // getMiniMapCacheFile
 
-    // Adjust Y position by +1 for max, -1 for min - this helps in case that
-    // the maximum Y coordinate is negative (otherwise the minimap is mirrored)
-    // and avoids problems for tracks which have a flat (max Y = min Y) minimap.
-    camera->setPosition(core::vector3df(center.getX(), bb_min.getY() + 1.0f, center.getZ()));
-    //camera->setPosition(core::vector3df(center.getX() - 5.0f, bb_min.getY() - 1 - 5.0f, center.getZ() - 15.0f));
-    camera->setUpVector(core::vector3df(0, 0, 1));
-    camera->setTarget(core::vector3df(center.getX(),bb_min.getY()-1,center.getZ()));
-    //camera->setAspectRatio(1.0f);
-    camera->updateAbsolutePosition();
+//-----------------------------------------------------------------------------
+/** Creates the mini map texture of the driveline quads. The mini map is
+ *  only drawn once per track and graph mode and then saved in the cached
+ *  textures directory, later races load it from there (unless the quads
+ *  were changed since).
+ *  \param dimension Size of the mini map texture.
+ *  \param name Name of the texture.
+ *  \param fill_color Colour of the quads.
+ *  \return The texture, or NULL if it couldn't be created.
+ */
+video::ITexture *QuadGraph::makeMiniMap(const core::dimension2du &dimension,
+                                        const std::string &name,
+                                        const video::SColor &fill_color)
+{
+    Vec3 bb_min, bb_max;
+    QuadSet::get()->getBoundingBox(&bb_min, &bb_max);
+    m_min_coord = bb_min;
+    const float range = std::max(bb_max.getX()-bb_min.getX(),
+                                 bb_max.getZ()-bb_min.getZ());
+    m_scaling = range > 0 ? dimension.Width / range : 0;
 
-    video::ITexture* texture = NULL;
-    FrameBuffer* frame_buffer = NULL;
+    video::IVideoDriver *driver = irr_driver->getVideoDriver();
+    const std::string cache_file = getMiniMapCacheFile(dimension);
 
-    if (CVS->isGLSL())
+    video::IImage *image = NULL;
+    if(file_manager->fileExists(cache_file) &&
+       !file_manager->fileIsNewer(m_quad_filename, cache_file))
     {
-        frame_buffer = newRttProvider->render(camera, GUIEngine::getLatestDt());
+        image = driver->createImageFromFile(cache_file.c_str());
+        if(image && image->getDimension()!=dimension)
+        {
+            image->drop();
+            image = NULL;
+        }
     }
-    else
+
+    if(!image)
     {
-        texture = oldRttProvider->renderToTexture();
-        delete oldRttProvider;
+        std::vector<video::SColor> pixels;
+        rasterizeMiniMap(dimension, fill_color, &pixels);
+        image = driver->createImageFromData(video::ECF_A8R8G8B8, dimension,
+                                            &pixels[0],
+                                            /*ownForeignMemory*/false);
+        if(image && !driver->writeImageToFile(image, cache_file.c_str()))
+        {
+            Log::warn("Quad Graph", "Can't write mini map cache '%s'.",
+                      cache_file.c_str());
+        }
     }
 
-    cleanupDebugMesh();
-    irr_driver->removeCameraSceneNode(camera);
-    m_min_coord = bb_min;
-
-
-    if (texture == NULL && frame_buffer == NULL)
+    if(!image)
     {
-        Log::error("Quad Graph", "[makeMiniMap] WARNING: RTT does not appear to work,"
-                        "mini-map will not be available.");
+        Log::error("Quad Graph", "[makeMiniMap] Can't create the image, "
+                   "mini-map will not be available.");
+        return NULL;
     }
 
-    *oldRttMinimap = texture;
-    *newRttMinimap = frame_buffer;
-    World::getWorld()->setClearbackBufferColor(oldClearColor);
-    World::getWorld()->forceFogDisabled(false);
-
-    irr_driver->getSceneManager()->clear();
-    VAOManager::kill();
-    irr_driver->clearGlowingNodes();
-    irr_driver->clearLights();
-    irr_driver->clearForcedBloom();
-    irr_driver->clearBackgroundNodes();
+    video::ITexture *texture = driver->addTexture(name.c_str(), image);
+    image->drop();
+    return texture;
 }   // makeMiniMap
 
 //-----------------------------------------------------------------------------
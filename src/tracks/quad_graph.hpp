@@ -37,8 +37,6 @@ namespace irr
 using namespace irr;
 
 class CheckLine;
-class RTT;
-class FrameBuffer;
 
 /**
  *  \brief This class stores a graph of quads. It uses a 'simplified singleton'
@@ -56,8 +54,6 @@ class QuadGraph : public NoCopy
 private:
     static QuadGraph        *m_quad_graph;
 
-    RTT* m_new_rtt;
-
     /** The actual graph data structure. */
     std::vector<GraphNode*>  m_all_nodes;
     /** For debug mode only: the node of the debug mesh. */
@@ -79,9 +75,60 @@ private:
     /** Stores the filename - just used for error messages. */
     std::string              m_quad_filename;
 
+    /** Name of the graph file. The cached navigation data is only used if
+     *  it is newer than this file and the quad file. */
+    std::string              m_graph_filename;
+
+    /** True if the navigation data changed since it was loaded from (or
+     *  saved to) the cache, see saveCache. */
+    bool                     m_cache_dirty;
+
+    /** True if the paths to nodes were loaded from the cache, so that
+     *  setupPaths doesn't need to compute them. */
+    bool                     m_paths_cached;
+
+    /** True if computeChecklineRequirements was called. */
+    bool                     m_has_checkline_requirements;
+
+    /** Checkline requirements of each node loaded from the cache. They are
+     *  only applied to the nodes if computeChecklineRequirements is called,
+     *  since not all modes use them. */
+    std::vector< std::vector<int> > m_cached_checkline_requirements;
+
     /** Wether the graph should be reverted or not */
     bool                     m_reverse;
 
+    /** Minimum X and Z coordinate of the sector grid, which is a uniform
+     *  grid in the XZ plane used to speed up findRoadSector and
+     *  findOutOfRoadSector. */
+    float                    m_grid_min_x, m_grid_min_z;
+
+    /** Size of one cell of the sector grid. */
+    float                    m_grid_cell_size;
+
+    /** Number of cells of the sector grid along X and Z. */
+    int                      m_grid_size_x, m_grid_size_z;
+
+    /** The index of the first entry in m_grid_nodes of each cell (plus one
+     *  additional entry marking the end of the last cell). */
+    std::vector<unsigned int> m_grid_start;
+
+    /** For each cell the indices of all graph nodes whose quad overlaps
+     *  the cell. Since the driveline of a node is inside its quad, this
+     *  is also used for the driveline segments. */
+    std::vector<int>         m_grid_nodes;
+
+    /** For each graph node 1 if the track mesh might have triangles above
+     *  its quad (e.g. the ceiling of a tunnel), 0 if not, and -1 if this
+     *  has not been determined yet. See hasTerrainAbove. */
+    mutable std::vector<signed char> m_terrain_above;
+
+    void buildSectorGrid();
+    int  getGridCellX(float x) const;
+    int  getGridCellZ(float z) const;
+    void findClosestInGrid(const Vec3 &xyz, int first, bool test_height,
+                           int *min_sector, float *min_dist_2) const;
+
     void setDefaultSuccessors();
     void computeChecklineRequirements(GraphNode* node, int latest_checkline);
     void computeDirectionData();
@@ -90,11 +137,19 @@ private:
 
     void addSuccessor(unsigned int from, unsigned int to);
     void load         (const std::string &filename);
+    std::string getCacheFile() const;
+    bool loadCache();
     void computeDistanceFromStart(unsigned int start_node, float distance);
     void createMesh(bool show_invisible=true,
                     bool enable_transparency=false,
                     const video::SColor *track_color=NULL,
                     const video::SColor *lap_color=NULL);
+    void getLapLineVertices(video::S3DVertex *v,
+                            const video::SColor &color) const;
+    void rasterizeMiniMap(const core::dimension2du &dimension,
+                          const video::SColor &fill_color,
+                          std::vector<video::SColor> *pixels) const;
+    std::string getMiniMapCacheFile(const core::dimension2du &dimension) const;
     unsigned int getStartNode() const;
          QuadGraph     (const std::string &quad_file_name,
                         const std::string &graph_file_name,
@@ -122,17 +177,17 @@ public:
                                          float forwards_distance=1.5f,
                                          float sidewards_distance=1.5f,
                                          float upwards_distance=0.0f) const;
-    void        makeMiniMap(const core::dimension2du &where,
-                            const std::string &name,
-                            const video::SColor &fill_color,
-                            video::ITexture** oldRttMinimap,
-                            FrameBuffer** newRttMinimap);
+    video::ITexture *makeMiniMap(const core::dimension2du &where,
+                                 const std::string &name,
+                                 const video::SColor &fill_color);
     void         mapPoint2MiniMap(const Vec3 &xyz, Vec3 *out) const;
+    bool         hasTerrainAbove(int node, const Vec3 &xyz) const;
     void         updateDistancesForAllSuccessors(unsigned int indx,
                                                  float delta,
                                                  unsigned int count);
     void         setupPaths();
     void         computeChecklineRequirements();
+    void         saveCache();
 // ----------------------------------------------------------------------======
     /** Returns the one instance of this object. It is possible that there
      *  is no instance created (e.g. in battle mode, since it doesn't have
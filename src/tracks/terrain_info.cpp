@@ -32,8 +32,9 @@
  */
 TerrainInfo::TerrainInfo()
 {
-    m_last_material = NULL;
-    m_material      = NULL;
+    m_last_material    = NULL;
+    m_material         = NULL;
+    m_has_batch_result = false;
 }   // TerrainInfo
 
 //-----------------------------------------------------------------------------
@@ -43,8 +44,9 @@ TerrainInfo::TerrainInfo()
 TerrainInfo::TerrainInfo(const Vec3 &pos)
 {
     // initialise HoT
-    m_last_material = NULL;
-    m_material = NULL;
+    m_last_material    = NULL;
+    m_material         = NULL;
+    m_has_batch_result = false;
     update(pos);
 }   // TerrainInfo
 
@@ -77,6 +79,20 @@ void TerrainInfo::update(const btTransform &trans, const Vec3 &offset)
     btVector3 to(0, -10000.0f, 0);
     to = trans(to);
 
+    // Use the result of a batched raycast if it was done for the same ray
+    // (i.e. the object has not been moved since castRays was called).
+    if(m_has_batch_result)
+    {
+        m_has_batch_result = false;
+        if(m_batch_from==from && m_batch_to==to)
+        {
+            m_hit_point = m_batch_hit_point;
+            m_normal    = m_batch_normal;
+            m_material  = m_batch_material;
+            return;
+        }
+    }
+
     const TriangleMesh &tm = World::getWorld()->getTrack()->getTriangleMesh();
     tm.castRay(from, to, &m_hit_point, &m_material, &m_normal,
                /*interpolate*/true);
@@ -89,6 +105,45 @@ void TerrainInfo::update(const btTransform &trans, const Vec3 &offset)
                                &m_normal, /*interpolate*/true);
 }   // update
 
+// -----------------------------------------------------------------------------
+/** Casts the rays of several terrain info objects in one batch, first
+ *  against the track mesh, then against all driveable track objects. The
+ *  results are stored in each object and used by the next call to
+ *  update(trans, offset) with the same transform and offset.
+ *  \param infos The terrain info objects.
+ *  \param transforms The transform of each object.
+ *  \param offset The offset as used in update(trans, offset).
+ */
+void TerrainInfo::castRays(const std::vector<TerrainInfo*> &infos,
+                           const std::vector<btTransform> &transforms,
+                           const Vec3 &offset)
+{
+    assert(infos.size()==transforms.size());
+    std::vector<TriangleMesh::RayQuery> rays(infos.size());
+    for(unsigned int i=0; i<infos.size(); i++)
+    {
+        rays[i].m_from = transforms[i](offset);
+        rays[i].m_to   = transforms[i](btVector3(0, -10000.0f, 0));
+        // If nothing is hit, update() keeps the previous hit point.
+        rays[i].m_hit_point = infos[i]->m_hit_point;
+    }
+
+    const Track *track = World::getWorld()->getTrack();
+    track->getTriangleMesh().castRays(&rays, /*interpolate*/true);
+    track->getTrackObjectManager()->castRays(&rays, /*interpolate*/true);
+
+    for(unsigned int i=0; i<infos.size(); i++)
+    {
+        TerrainInfo *info        = infos[i];
+        info->m_has_batch_result = true;
+        info->m_batch_from       = rays[i].m_from;
+        info->m_batch_to         = rays[i].m_to;
+        info->m_batch_hit_point  = rays[i].m_hit_point;
+        info->m_batch_normal     = rays[i].m_normal;
+        info->m_batch_material   = rays[i].m_material;
+    }
+}   // castRays
+
 // -----------------------------------------------------------------------------
 /** Does a raycast upwards from the given position
 If the raycast indicated that the kart is 'under something' (i.e. a
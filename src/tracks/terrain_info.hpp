@@ -21,6 +21,8 @@
 
 #include "utils/vec3.hpp"
 
+#include <vector>
+
 class btTransform;
 class Material;
 
@@ -40,6 +42,15 @@ private:
     /** The point that was hit. */
     Vec3              m_hit_point;
 
+    /** If set, castRays has computed the result of the next raycast from
+     *  m_batch_from to m_batch_to (which is then used by update). */
+    bool              m_has_batch_result;
+    Vec3              m_batch_from;
+    Vec3              m_batch_to;
+    Vec3              m_batch_hit_point;
+    Vec3              m_batch_normal;
+    const Material   *m_batch_material;
+
 public:
              TerrainInfo();
              TerrainInfo(const Vec3 &pos);
@@ -49,6 +60,9 @@ public:
                             const Material **m);
     virtual void update(const btTransform &trans, const Vec3 &offset);
     virtual void update(const Vec3 &from);
+    static  void castRays(const std::vector<TerrainInfo*> &infos,
+                          const std::vector<btTransform> &transforms,
+                          const Vec3 &offset);
 
     // ------------------------------------------------------------------------
     /** Simple wrapper with no offset. */
@@ -41,6 +41,7 @@
 #include "graphics/stk_text_billboard.hpp"
 #include "guiengine/scalable_font.hpp"
 #include "io/file_manager.hpp"
+#include "io/utf_writer.hpp"
 #include "io/xml_node.hpp"
 #include "items/item.hpp"
 #include "items/item_manager.hpp"
@@ -62,6 +63,7 @@
 #include "tracks/track_object_manager.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
+#include "utils/profiler.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/translation.hpp"
 
@@ -73,6 +75,7 @@
 #include <ISceneManager.h>
 
 #include <iostream>
+#include <set>
 #include <stdexcept>
 #include <sstream>
 #include <wchar.h>
@@ -83,7 +86,7 @@ using namespace irr;
 const float Track::NOHIT           = -99999.9f;
 
 // ----------------------------------------------------------------------------
-Track::Track(const std::string &filename)
+Track::Track(const std::string &filename, const XMLNode *index_node)
 {
 #ifdef DEBUG
     m_magic_number          = 0x17AC3802;
@@ -108,6 +111,9 @@ Track::Track(const std::string &filename)
     m_version               = 0;
     m_track_mesh            = NULL;
     m_gfx_effect_mesh       = NULL;
+    m_prefetch_thread       = NULL;
+    m_quad_graph_thread     = NULL;
+    m_prefetch_abort.store(false);
     m_internal              = false;
     m_enable_auto_rescue    = true;  // Below set to false in arenas
     m_enable_push_back      = true;
@@ -118,7 +124,6 @@ Track::Track(const std::string &filename)
     m_is_cutscene           = false;
     m_camera_far            = 1000.0f;
     m_old_rtt_mini_map      = NULL;
-    m_new_rtt_mini_map      = NULL;
     m_bloom                 = true;
     m_bloom_threshold       = 0.75f;
     m_color_inlevel         = core::vector3df(0.0,1.0, 255.0);
@@ -129,6 +134,8 @@ Track::Track(const std::string &filename)
     m_caustics_speed        = 1.0f;
     m_shadows               = true;
     m_sky_particles         = NULL;
+    m_height_map_buffer     = 0;
+    m_height_map_texture    = 0;
     m_sky_dx                = 0.05f;
     m_sky_dy                = 0.0f;
     m_godrays_opacity       = 1.0f;
@@ -144,7 +151,11 @@ Track::Track(const std::string &filename)
     m_all_nodes.clear();
     m_static_physics_only_nodes.clear();
     m_all_cached_meshes.clear();
-    loadTrackInfo();
+    m_track_info_loaded = false;
+    if(index_node)
+        loadIndexInfo(*index_node);
+    else
+        loadTrackInfo();
 }   // Track
 
 //-----------------------------------------------------------------------------
@@ -266,12 +277,60 @@ void Track::reset()
     m_startup_run = false;
 }   // reset
 
+//-----------------------------------------------------------------------------
+/** Removes the meshes loaded by a track and their textures from irrlicht's
+ *  caches, unless they are still used.
+ *  \param meshes Meshes attached to a scene node, each mesh is in the list
+ *         once for each time it was loaded.
+ *  \param detached_meshes Meshes not attached to a scene node.
+ */
+void Track::releaseMeshes(std::vector<scene::IMesh*> *meshes,
+                          std::vector<scene::IMesh*> *detached_meshes)
+{
+    // Each mesh in meshes was loaded from a file, which means that the mesh
+    // is stored in irrlichts mesh cache. To clean everything loaded by the
+    // track, we drop the ref count for each mesh here, till the ref count
+    // is 1, which means the mesh is only contained in the mesh cache, and
+    // can therefore be removed. Meshes load more than once are in the list
+    // more than once (which is easier than storing the mesh only once, but
+    // then having to test for each mesh if it is already contained in the
+    // list or not).
+    for (unsigned int i = 0; i < meshes->size(); i++)
+    {
+        scene::IMesh *mesh = (*meshes)[i];
+        irr_driver->dropAllTextures(mesh);
+        // If a mesh is not in Irrlicht's texture cache, its refcount is
+        // 1 (since its scene node was removed, so the only other reference
+        // is in the list). In this case we only drop it once and don't try
+        // to remove it from the cache.
+        if (mesh->getReferenceCount() == 1)
+        {
+            mesh->drop();
+            continue;
+        }
+        mesh->drop();
+        if (mesh->getReferenceCount() == 1)
+            irr_driver->removeMeshFromCache(mesh);
+    }
+    meshes->clear();
+
+    // Now free meshes that are not associated to any scene node.
+    for (unsigned int i = 0; i < detached_meshes->size(); i++)
+    {
+        irr_driver->dropAllTextures((*detached_meshes)[i]);
+        irr_driver->removeMeshFromCache((*detached_meshes)[i]);
+    }
+    detached_meshes->clear();
+}   // releaseMeshes
+
 //-----------------------------------------------------------------------------
 /** Removes the physical body from the world.
  *  Called at the end of a race.
  */
 void Track::cleanup()
 {
+    // In case loading was aborted by an exception
+    joinLoadingThreads();
     QuadGraph::destroy();
     ItemManager::destroy();
     VAOManager::kill();
@@ -297,6 +356,15 @@ void Track::cleanup()
 
     m_all_emitters.clearAndDeleteAll();
 
+    m_height_map.clear();
+    if (m_height_map_texture)
+    {
+        glDeleteTextures(1, &m_height_map_texture);
+        glDeleteBuffers(1, &m_height_map_buffer);
+        m_height_map_texture = 0;
+        m_height_map_buffer  = 0;
+    }
+
     CheckManager::destroy();
 
     delete m_track_object_manager;
@@ -320,39 +388,10 @@ void Track::cleanup()
         irr_driver->cleanSunInterposer();
 
 
-    // The m_all_cached_mesh contains each mesh loaded from a file, which
-    // means that the mesh is stored in irrlichts mesh cache. To clean
-    // everything loaded by this track, we drop the ref count for each mesh
-    // here, till the ref count is 1, which means the mesh is only contained
-    // in the mesh cache, and can therefore be removed. Meshes load more
-    // than once are in m_all_cached_mesh more than once (which is easier
-    // than storing the mesh only once, but then having to test for each
-    // mesh if it is already contained in the list or not).
-    for (unsigned int i = 0; i < m_all_cached_meshes.size(); i++)
-    {
-        irr_driver->dropAllTextures(m_all_cached_meshes[i]);
-        // If a mesh is not in Irrlicht's texture cache, its refcount is
-        // 1 (since its scene node was removed, so the only other reference
-        // is in m_all_cached_meshes). In this case we only drop it once
-        // and don't try to remove it from the cache.
-        if (m_all_cached_meshes[i]->getReferenceCount() == 1)
-        {
-            m_all_cached_meshes[i]->drop();
-            continue;
-        }
-        m_all_cached_meshes[i]->drop();
-        if (m_all_cached_meshes[i]->getReferenceCount() == 1)
-            irr_driver->removeMeshFromCache(m_all_cached_meshes[i]);
-    }
-    m_all_cached_meshes.clear();
-
-    // Now free meshes that are not associated to any scene node.
-    for (unsigned int i = 0; i < m_detached_cached_meshes.size(); i++)
-    {
-        irr_driver->dropAllTextures(m_detached_cached_meshes[i]);
-        irr_driver->removeMeshFromCache(m_detached_cached_meshes[i]);
-    }
-    m_detached_cached_meshes.clear();
+    // Keep the meshes of the track in the caches for a while, in case the
+    // track is used again. The overworld keeps its materials anyway.
+    track_manager->cacheMeshes(m_ident, &m_all_cached_meshes,
+                               &m_detached_cached_meshes);
 
     if (m_old_rtt_mini_map)
     {
@@ -360,10 +399,6 @@ void Track::cleanup()
         irr_driver->removeTexture(m_old_rtt_mini_map);
         m_old_rtt_mini_map = NULL;
     }
-    if (m_new_rtt_mini_map)
-    {
-        m_new_rtt_mini_map = NULL; // already deleted by QuadGraph::~QuadGraph
-    }
 
     for(unsigned int i=0; i<m_sky_textures.size(); i++)
     {
@@ -466,6 +501,7 @@ void Track::loadTrackInfo()
     m_fog_height_end        = 100.0f;
     m_gravity               = 9.80665f;
     m_smooth_normals        = false;
+    m_dynamic_broadphase    = false;
     m_godrays               = false;
     m_godrays_opacity       = 1.0f;
     m_godrays_color         = video::SColor(255, 255, 255, 255);
@@ -524,6 +560,7 @@ void Track::loadTrackInfo()
         m_enable_auto_rescue = false;
     root->get("auto-rescue",           &m_enable_auto_rescue);
     root->get("smooth-normals",        &m_smooth_normals);
+    root->get("dynamic-broadphase",    &m_dynamic_broadphase);
     // Reverse is meaningless in arena
     if(m_is_arena || m_is_soccer)
         m_reverse_available = false;
@@ -574,8 +611,64 @@ void Track::loadTrackInfo()
         }
         delete easter;
     }
+    m_track_info_loaded = true;
 }   // loadTrackInfo
 
+//-----------------------------------------------------------------------------
+/** Only reads the information needed to list this track from an entry of
+ *  the track index, which uses the same attribute names as track.xml. The
+ *  rest of track.xml is read when the track is loaded.
+ *  \param node The index entry, see writeIndexInfo.
+ */
+void Track::loadIndexInfo(const XMLNode &node)
+{
+    node.get("name",                   &m_name);
+    node.get("designer",               &m_designer);
+    node.get("version",                &m_version);
+    node.get("screenshot",             &m_screenshot);
+    node.get("soccer",                 &m_is_soccer);
+    node.get("arena",                  &m_is_arena);
+    node.get("cutscene",               &m_is_cutscene);
+    node.get("groups",                 &m_groups);
+    node.get("internal",               &m_internal);
+    node.get("reverse",                &m_reverse_available);
+    node.get("default-number-of-laps", &m_default_number_of_laps);
+    node.get("easter-eggs",            &m_has_easter_eggs);
+    m_actual_number_of_laps = m_default_number_of_laps;
+    if(m_groups.size()==0) m_groups.push_back(DEFAULT_GROUP_NAME);
+    m_screenshot = m_root+m_screenshot;
+}   // loadIndexInfo
+
+//-----------------------------------------------------------------------------
+/** Writes the attributes read by loadIndexInfo for the entry of this track
+ *  in the track index.
+ *  \param writer The index file, the attributes are written inside of the
+ *         element of the entry.
+ */
+void Track::writeIndexInfo(UTFWriter *writer) const
+{
+    std::string groups;
+    for(unsigned int i=0; i<m_groups.size(); i++)
+        groups += (i==0 ? "" : " ") + m_groups[i];
+    std::string screenshot = m_screenshot;
+    if(screenshot.compare(0, m_root.size(), m_root)==0)
+        screenshot = screenshot.substr(m_root.size());
+
+    *writer << L" name=\"" << StringUtils::xmlEncode(m_name.c_str())
+            << L"\" designer=\"" << StringUtils::xmlEncode(m_designer)
+            << L"\" version=\"" << m_version
+            << L"\"\n         screenshot=\""
+            << StringUtils::xmlEncode(screenshot.c_str())
+            << L"\" groups=\"" << StringUtils::xmlEncode(groups.c_str())
+            << L"\" soccer=\"" << m_is_soccer
+            << L"\" arena=\"" << m_is_arena
+            << L"\" cutscene=\"" << m_is_cutscene
+            << L"\" internal=\"" << m_internal
+            << L"\"\n         reverse=\"" << m_reverse_available
+            << L"\" default-number-of-laps=\"" << m_default_number_of_laps
+            << L"\" easter-eggs=\"" << m_has_easter_eggs << L"\"";
+}   // writeIndexInfo
+
 //-----------------------------------------------------------------------------
 /** Loads all curves from the XML node.
  */
@@ -648,7 +741,17 @@ void Track::loadQuadGraph(unsigned int mode_id, const bool reverse)
                       m_root+m_all_modes[mode_id].m_graph_name,
                       reverse);
 
-    QuadGraph::get()->setupPaths();
+    // The paths are only needed by the AI and some items once the race
+    // starts, so they are computed while the rest of the track is loaded
+    // (see joinLoadingThreads).
+    m_quad_graph_thread = new pthread_t;
+    if(pthread_create(m_quad_graph_thread, NULL, &Track::setupQuadGraphPaths,
+                      this) != 0)
+    {
+        delete m_quad_graph_thread;
+        m_quad_graph_thread = NULL;
+        QuadGraph::get()->setupPaths();
+    }
 #ifdef DEBUG
     for(unsigned int i=0; i<QuadGraph::get()->getNumNodes(); i++)
     {
@@ -680,18 +783,14 @@ void Track::loadQuadGraph(unsigned int mode_id, const bool reverse)
         core::dimension2du size = m_mini_map_size
                                  .getOptimalSize(!nonpower,!nonsquare);
 
-        QuadGraph::get()->makeMiniMap(size, "minimap::" + m_ident, video::SColor(127, 255, 255, 255),
-            &m_old_rtt_mini_map, &m_new_rtt_mini_map);
+        m_old_rtt_mini_map = QuadGraph::get()->makeMiniMap(size,
+                                  "minimap::" + m_ident,
+                                  video::SColor(127, 255, 255, 255));
         if (m_old_rtt_mini_map)
         {
             m_minimap_x_scale = float(m_mini_map_size.Width) / float(m_old_rtt_mini_map->getSize().Width);
             m_minimap_y_scale = float(m_mini_map_size.Height) / float(m_old_rtt_mini_map->getSize().Height);
         }
-        else if (m_new_rtt_mini_map)
-        {
-            m_minimap_x_scale = float(m_mini_map_size.Width) / float(m_new_rtt_mini_map->getWidth());
-            m_minimap_y_scale = float(m_mini_map_size.Height) / float(m_new_rtt_mini_map->getHeight());
-        }
         else
         {
             m_minimap_x_scale = 0;
@@ -754,7 +853,11 @@ void Track::createPhysicsModel(unsigned int main_track_count)
     {
         convertTrackToBullet(m_all_nodes[i]);
     }
-    m_track_mesh->createPhysicalBody();
+    // Building the BVH of the track mesh takes a noticeable part of the
+    // loading time, so it is cached (and rebuilt if the mesh changes).
+    std::string bvh_file = file_manager->getCachedBvhDir() + m_ident + ".bvh";
+    m_track_mesh->createPhysicalBody((btCollisionObject::CollisionFlags)0,
+                                     bvh_file.c_str());
     m_gfx_effect_mesh->createCollisionShape();
 }   // createPhysicsModel
 
@@ -1073,7 +1176,8 @@ bool Track::loadMainTrack(const XMLNode &root)
     // could be relaxed to fix this, it is not certain how the physics
     // will handle items that are out of the AABB
     m_aabb_max.setY(m_aabb_max.getY()+30.0f);
-    World::getWorld()->getPhysics()->init(m_aabb_min, m_aabb_max);
+    World::getWorld()->getPhysics()->init(m_aabb_min, m_aabb_max,
+                                          m_dynamic_broadphase);
 
     ModelDefinitionLoader lodLoader(this);
 
@@ -1498,7 +1602,9 @@ void Track::update(float dt)
         m_animated_textures[i]->update(dt);
     }
     CheckManager::get()->update(dt);
+    PROFILER_PUSH_CPU_MARKER("Track::update (items)", 0x7F, 0x40, 0x00);
     ItemManager::get()->update(dt);
+    PROFILER_POP_CPU_MARKER();
 
     // TODO: enable onUpdate scripts if we ever find a compelling use for them
     //Scripting::ScriptEngine* script_engine = World::getWorld()->getScriptEngine();
@@ -1622,11 +1728,19 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     // Use m_filename to also get the path, not only the identifier
     irr_driver->setTextureErrorMessage("While loading track '%s'",
                                        m_filename                  );
+    if(!m_track_info_loaded)
+    {
+        // The number of laps might have been set already
+        const int laps = m_actual_number_of_laps;
+        loadTrackInfo();
+        m_actual_number_of_laps = laps;
+    }
     if(!m_reverse_available)
     {
         reverse_track = false;
     }
     CheckManager::create();
+    startPrefetchThread();
     assert(m_all_cached_meshes.size()==0);
     if(UserConfigParams::logMemory())
     {
@@ -1722,6 +1836,7 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
         std::ostringstream msg;
         msg<< "No track model defined in '"<<path
            <<"', aborting.";
+        joinLoadingThreads();
         throw std::runtime_error(msg.str());
     }
 
@@ -1793,6 +1908,11 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
 
     // Init all track objects
     m_track_object_manager->init();
+    if (CVS->isGLSL())
+    {
+        m_track_object_manager->createInstanceGroups();
+        irr_driver->warmupShaders();
+    }
 
 
     // ---- Fog
@@ -1939,11 +2059,16 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
                 irr_driver->getVideoDriver()->getTextureCount());
     }
 
+    joinLoadingThreads();
+
     World *world = World::getWorld();
     if (world->useChecklineRequirements())
     {
         QuadGraph::get()->computeChecklineRequirements();
     }
+    // All navigation data of the quad graph is known now
+    if (QuadGraph::get())
+        QuadGraph::get()->saveCache();
 
     EasterEggHunt *easter_world = dynamic_cast<EasterEggHunt*>(world);
     if(easter_world)
@@ -1955,6 +2080,85 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     irr_driver->unsetTextureErrorMessage();
 }   // loadTrackModel
 
+//-----------------------------------------------------------------------------
+/** Starts a thread that reads all files of the track directory. The data is
+ *  discarded, the only purpose is that the files are in the file cache of
+ *  the OS when the textures and models are loaded (which has to be done
+ *  on the main thread), so that loading does not wait for slow disks.
+ */
+void Track::startPrefetchThread()
+{
+    std::set<std::string> files;
+    file_manager->listFiles(files, m_root, /*make_full_path*/true);
+    m_prefetch_files.assign(files.begin(), files.end());
+    m_prefetch_abort.store(false);
+    m_prefetch_thread = new pthread_t;
+    if(pthread_create(m_prefetch_thread, NULL, &Track::prefetchFiles,
+                      this) != 0)
+    {
+        delete m_prefetch_thread;
+        m_prefetch_thread = NULL;
+    }
+}   // startPrefetchThread
+
+//-----------------------------------------------------------------------------
+/** The prefetch thread: reads all files in m_prefetch_files, until all are
+ *  read or m_prefetch_abort is set.
+ *  \param obj Pointer to the track.
+ */
+void *Track::prefetchFiles(void *obj)
+{
+    Track *track = (Track*)obj;
+    char buffer[65536];
+    for(unsigned int i=0; i<track->m_prefetch_files.size(); i++)
+    {
+        FILE *f = fopen(track->m_prefetch_files[i].c_str(), "rb");
+        if(!f)
+            continue;
+        while(!track->m_prefetch_abort.load() &&
+              fread(buffer, 1, sizeof(buffer), f) == sizeof(buffer))
+        {
+        }
+        fclose(f);
+        if(track->m_prefetch_abort.load())
+            break;
+    }
+    return NULL;
+}   // prefetchFiles
+
+//-----------------------------------------------------------------------------
+/** Thread function that computes the paths of the quad graph.
+ *  \param obj Pointer to the track.
+ */
+void *Track::setupQuadGraphPaths(void *obj)
+{
+    QuadGraph::get()->setupPaths();
+    return NULL;
+}   // setupQuadGraphPaths
+
+//-----------------------------------------------------------------------------
+/** Waits for the threads started while loading the track. The prefetch
+ *  thread is stopped, since the files it would still read are not needed
+ *  anymore.
+ */
+void Track::joinLoadingThreads()
+{
+    if(m_prefetch_thread)
+    {
+        m_prefetch_abort.store(true);
+        pthread_join(*m_prefetch_thread, NULL);
+        delete m_prefetch_thread;
+        m_prefetch_thread = NULL;
+        m_prefetch_files.clear();
+    }
+    if(m_quad_graph_thread)
+    {
+        pthread_join(*m_quad_graph_thread, NULL);
+        delete m_quad_graph_thread;
+        m_quad_graph_thread = NULL;
+    }
+}   // joinLoadingThreads
+
 //-----------------------------------------------------------------------------
 
 void Track::loadObjects(const XMLNode* root, const std::string& path, ModelDefinitionLoader& model_def_loader,
@@ -2347,10 +2551,17 @@ bool Track::setTerrainHeight(Vec3 *pos) const
 
 // ----------------------------------------------------------------------------
 
-std::vector< std::vector<float> > Track::buildHeightMap()
+/** Returns the height map of the track, used by the weather particles to
+ *  stop at the ground. The height of grid point (i, j) is at index
+ *  i*HEIGHT_MAP_RESOLUTION+j. It is baked once per track, since casting the
+ *  rays is expensive.
+ */
+const std::vector<float>& Track::getHeightMap()
 {
-    std::vector< std::vector<float> > out(HEIGHT_MAP_RESOLUTION);
+    if (!m_height_map.empty())
+        return m_height_map;
 
+    m_height_map.resize(HEIGHT_MAP_RESOLUTION * HEIGHT_MAP_RESOLUTION);
     float x = m_aabb_min.getX();
     const float x_len = m_aabb_max.getX() - m_aabb_min.getX();
     const float z_len = m_aabb_max.getZ() - m_aabb_min.getZ();
@@ -2364,7 +2575,6 @@ std::vector< std::vector<float> > Track::buildHeightMap()
 
     for (int i=0; i<HEIGHT_MAP_RESOLUTION; i++)
     {
-        out[i].resize(HEIGHT_MAP_RESOLUTION);
         float z = m_aabb_min.getZ();
 
         for (int j=0; j<HEIGHT_MAP_RESOLUTION; j++)
@@ -2376,13 +2586,34 @@ std::vector< std::vector<float> > Track::buildHeightMap()
             m_track_mesh->castRay(pos, to, &hitpoint, &material, &normal);
             z += z_step;
 
-            out[i][j] = hitpoint.getY();
+            m_height_map[i*HEIGHT_MAP_RESOLUTION + j] = hitpoint.getY();
         }   // j<HEIGHT_MAP_RESOLUTION
         x += x_step;
     }
 
-    return out;
-}   // buildHeightMap
+    return m_height_map;
+}   // getHeightMap
+
+// ----------------------------------------------------------------------------
+/** Returns a texture buffer with the height map for the GPU particles. It is
+ *  uploaded once and shared by all emitters.
+ */
+unsigned int Track::getHeightMapTexture()
+{
+    if (m_height_map_texture)
+        return m_height_map_texture;
+
+    const std::vector<float> &height_map = getHeightMap();
+    glGenBuffers(1, &m_height_map_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, m_height_map_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, height_map.size() * sizeof(float),
+                 height_map.data(), GL_STATIC_DRAW);
+    glGenTextures(1, &m_height_map_texture);
+    glBindTexture(GL_TEXTURE_BUFFER, m_height_map_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, m_height_map_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    return m_height_map_texture;
+}   // getHeightMapTexture
 
 // ----------------------------------------------------------------------------
 /** Returns the rotation of the sun. */
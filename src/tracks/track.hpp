@@ -26,6 +26,8 @@
   * objects.
   */
 
+#include <atomic>
+#include <pthread.h>
 #include <string>
 #include <vector>
 
@@ -58,6 +60,7 @@ class ParticleKind;
 class PhysicalObject;
 class TrackObjectManager;
 class TriangleMesh;
+class UTFWriter;
 class World;
 class XMLNode;
 namespace Scripting
@@ -175,6 +178,11 @@ private:
     /** The full filename of the config (xml) file. */
     std::string              m_filename;
 
+    /** False if this track was created from the track index, in which case
+     *  only the information needed to list the track is defined. The rest
+     *  is read from track.xml when the track is loaded. */
+    bool                     m_track_info_loaded;
+
     /** The base dir of all files of this track. */
     std::string              m_root;
     std::vector<std::string> m_groups;
@@ -315,6 +323,14 @@ private:
     /** Particles emitted from the sky (wheather) */
     ParticleKind*            m_sky_particles;
 
+    /** Heights of the track on a HEIGHT_MAP_RESOLUTION x
+     *  HEIGHT_MAP_RESOLUTION grid over its bounding box, baked the first
+     *  time it is needed and shared by all weather emitters. */
+    std::vector<float>       m_height_map;
+    /** Texture buffer with the height map for GPU particles, or 0. */
+    unsigned int             m_height_map_buffer;
+    unsigned int             m_height_map_texture;
+
     /** Use a special built-in wheather */
     bool                     m_weather_lightning;
     std::string              m_weather_sound;
@@ -363,6 +379,9 @@ private:
     bool                m_use_fog;
     /** True if this track supports using smoothed normals. */
     bool                m_smooth_normals;
+    /** True if the physics should use a dynamic AABB tree as broadphase
+     *  (for tracks with large extents or many moving objects). */
+    bool                m_dynamic_broadphase;
 
     float               m_fog_max;
     float               m_fog_start;
@@ -379,7 +398,6 @@ private:
 
     /** The texture for the mini map, which is displayed in the race gui. */
     video::ITexture         *m_old_rtt_mini_map;
-    FrameBuffer             *m_new_rtt_mini_map;
     core::dimension2du      m_mini_map_size;
     float                   m_minimap_x_scale;
     float                   m_minimap_y_scale;
@@ -415,7 +433,27 @@ private:
     /** The number of laps that is predefined in a track info dialog. */
     int m_actual_number_of_laps;
 
+    /** While the track is loaded, this thread reads all files of the track
+     *  directory, so that they are in the file cache of the OS when they
+     *  are used. NULL if no such thread is running. */
+    pthread_t *m_prefetch_thread;
+
+    /** The files read by the prefetch thread. */
+    std::vector<std::string> m_prefetch_files;
+
+    /** Set to stop the prefetch thread. */
+    std::atomic<bool> m_prefetch_abort;
+
+    /** Thread that computes the paths of the quad graph while the rest of
+     *  the track is loaded. NULL if no such thread is running. */
+    pthread_t *m_quad_graph_thread;
+
+    static void *prefetchFiles(void *obj);
+    static void *setupQuadGraphPaths(void *obj);
+    void startPrefetchThread();
+    void joinLoadingThreads();
     void loadTrackInfo();
+    void loadIndexInfo(const XMLNode &node);
     void loadQuadGraph(unsigned int mode_id, const bool reverse);
     void convertTrackToBullet(scene::ISceneNode *node);
     bool loadMainTrack(const XMLNode &node);
@@ -432,8 +470,10 @@ public:
 
     static const float NOHIT;
 
-                       Track             (const std::string &filename);
+                       Track             (const std::string &filename,
+                                          const XMLNode *index_node=NULL);
                       ~Track             ();
+    void               writeIndexInfo    (UTFWriter *writer) const;
     void               cleanup           ();
     void               removeCachedData  ();
     void               startMusic        () const;
@@ -460,11 +500,11 @@ public:
                                         unsigned int mode_id=0);
     bool findGround(AbstractKart *kart);
 
-    std::vector< std::vector<float> > buildHeightMap();
+    const std::vector<float>& getHeightMap();
+    unsigned int getHeightMapTexture();
     // ------------------------------------------------------------------------
     /** Returns the texture with the mini map for this track. */
     const video::ITexture*    getOldRttMiniMap() const { return m_old_rtt_mini_map; }
-    const FrameBuffer*        getNewRttMiniMap() const { return m_new_rtt_mini_map; }
     // ------------------------------------------------------------------------
     const core::dimension2du& getMiniMapSize() const { return m_mini_map_size; }
     // ------------------------------------------------------------------------
@@ -676,6 +716,9 @@ public:
     // ------------------------------------------------------------------------
     /** Adds mesh to cleanup list */
     void addCachedMesh(scene::IMesh* mesh) { m_all_cached_meshes.push_back(mesh); }
+    // ------------------------------------------------------------------------
+    static void releaseMeshes(std::vector<scene::IMesh*> *meshes,
+                              std::vector<scene::IMesh*> *detached_meshes);
 };   // class Track
 
 #endif
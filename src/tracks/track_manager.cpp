@@ -19,31 +19,48 @@
 #include "tracks/track_manager.hpp"
 
 #include "config/stk_config.hpp"
+#include "config/user_config.hpp"
 #include "graphics/irr_driver.hpp"
 #include "io/file_manager.hpp"
+#include "io/utf_writer.hpp"
+#include "io/xml_node.hpp"
 #include "tracks/track.hpp"
 
+#include <IMesh.h>
+#include <IMeshBuffer.h>
+
 #include <algorithm>
 #include <iostream>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <stdio.h>
+#include <sys/stat.h>
 
 TrackManager* track_manager = 0;
 std::vector<std::string>  TrackManager::m_track_search_path;
 
+/** Version of the track index file, increase it when the content of an
+ *  entry changes. */
+static const int TRACK_INDEX_VERSION = 1;
+
 /** Constructor (currently empty). The real work happens in loadTrackList.
  */
 TrackManager::TrackManager()
-{}   // TrackManager
+{
+    m_track_index         = NULL;
+    m_track_index_changed = false;
+}   // TrackManager
 
 //-----------------------------------------------------------------------------
 /** Delete all tracks.
  */
 TrackManager::~TrackManager()
 {
+    releaseCachedMeshes();
     for(Tracks::iterator i = m_tracks.begin(); i != m_tracks.end(); ++i)
         delete *i;
+    delete m_track_index;
 }   // ~TrackManager
 
 //-----------------------------------------------------------------------------
@@ -95,7 +112,106 @@ void TrackManager::removeAllCachedData()
 {
     for(Tracks::const_iterator i = m_tracks.begin(); i != m_tracks.end(); ++i)
         (*i)->removeCachedData();
+    releaseCachedMeshes();
 }   // removeAllCachedData
+
+//-----------------------------------------------------------------------------
+/** Estimates the memory used by meshes and their textures.
+ */
+static size_t getMeshesSize(const std::vector<irr::scene::IMesh*> &meshes)
+{
+    size_t size = 0;
+    std::set<const video::ITexture*> textures;
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        for (unsigned int j = 0; j < meshes[i]->getMeshBufferCount(); j++)
+        {
+            const scene::IMeshBuffer *mb = meshes[i]->getMeshBuffer(j);
+            size_t vertex_size = sizeof(video::S3DVertex);
+            if (mb->getVertexType() == video::EVT_2TCOORDS)
+                vertex_size = sizeof(video::S3DVertex2TCoords);
+            else if (mb->getVertexType() == video::EVT_TANGENTS)
+                vertex_size = sizeof(video::S3DVertexTangents);
+            size += mb->getVertexCount() * vertex_size;
+            size += mb->getIndexCount() *
+                    (mb->getIndexType() == video::EIT_16BIT ? 2 : 4);
+            for (unsigned int k = 0; k < video::MATERIAL_MAX_TEXTURES; k++)
+            {
+                const video::ITexture *t = mb->getMaterial().getTexture(k);
+                if (t && textures.insert(t).second)
+                {
+                    // 4 bytes per texel, plus a third for the mipmaps
+                    size += t->getSize().Width * t->getSize().Height * 16 / 3;
+                }
+            }
+        }
+    }
+    return size;
+}   // getMeshesSize
+
+//-----------------------------------------------------------------------------
+/** Takes over the meshes of a track that is cleaned up, so that they (and
+ *  their textures) stay in irrlicht's caches in case the track is used again
+ *  (e.g. in a GP or when a race is restarted). The least recently used
+ *  tracks are released once UserConfigParams::m_track_cache_size is
+ *  exceeded.
+ *  \param ident Identifier of the track.
+ *  \param meshes The meshes attached to scene nodes, see
+ *         Track::releaseMeshes. The vector is empty afterwards.
+ *  \param detached_meshes Meshes not attached to a scene node.
+ */
+void TrackManager::cacheMeshes(const std::string &ident,
+                               std::vector<irr::scene::IMesh*> *meshes,
+                               std::vector<irr::scene::IMesh*> *detached_meshes)
+{
+    m_cached_meshes.push_back(CachedMeshes());
+    CachedMeshes &cached = m_cached_meshes.back();
+    cached.m_ident = ident;
+    cached.m_meshes.swap(*meshes);
+    cached.m_detached_meshes.swap(*detached_meshes);
+    cached.m_size = getMeshesSize(cached.m_meshes) +
+                    getMeshesSize(cached.m_detached_meshes);
+
+    // If the track was cached before, its meshes are now referenced twice,
+    // so releasing the old entry keeps them in the caches.
+    for (unsigned int i = 0; i + 1 < m_cached_meshes.size(); i++)
+    {
+        if (m_cached_meshes[i].m_ident != ident)
+            continue;
+        Track::releaseMeshes(&m_cached_meshes[i].m_meshes,
+                             &m_cached_meshes[i].m_detached_meshes);
+        m_cached_meshes.erase(m_cached_meshes.begin() + i);
+        break;
+    }
+
+    const size_t budget =
+        (size_t)std::max(0, (int)UserConfigParams::m_track_cache_size)
+        * 1024 * 1024;
+    size_t total = 0;
+    for (unsigned int i = 0; i < m_cached_meshes.size(); i++)
+        total += m_cached_meshes[i].m_size;
+    while (!m_cached_meshes.empty() && total > budget)
+    {
+        CachedMeshes &oldest = m_cached_meshes.front();
+        total -= oldest.m_size;
+        Track::releaseMeshes(&oldest.m_meshes, &oldest.m_detached_meshes);
+        m_cached_meshes.erase(m_cached_meshes.begin());
+    }
+}   // cacheMeshes
+
+//-----------------------------------------------------------------------------
+/** Removes the meshes and textures of all cached tracks from irrlicht's
+ *  caches.
+ */
+void TrackManager::releaseCachedMeshes()
+{
+    for (unsigned int i = 0; i < m_cached_meshes.size(); i++)
+    {
+        Track::releaseMeshes(&m_cached_meshes[i].m_meshes,
+                             &m_cached_meshes[i].m_detached_meshes);
+    }
+    m_cached_meshes.clear();
+}   // releaseCachedMeshes
 //-----------------------------------------------------------------------------
 /** Sets all tracks that are not in the list a to be unavailable. This is used
  *  by the network manager upon receiving the list of available tracks from
@@ -145,6 +261,7 @@ void TrackManager::loadTrackList()
     m_soccer_arena_groups.clear();
     m_track_avail.clear();
     m_tracks.clear();
+    loadTrackIndex();
 
     for(unsigned int i=0; i<m_track_search_path.size(); i++)
     {
@@ -165,8 +282,83 @@ void TrackManager::loadTrackList()
             loadTrack(dir+*subdir+"/");
         }   // for dir in dirs
     }   // for i <m_track_search_path.size()
+
+    // Also rewrite the index if a track was removed
+    if(m_track_index_changed ||
+        m_track_index_entries.size()!=m_tracks.size())
+        saveTrackIndex();
+    delete m_track_index;
+    m_track_index = NULL;
+    m_track_index_entries.clear();
 }  // loadTrackList
 
+// ----------------------------------------------------------------------------
+/** Reads the track index from the config directory, see saveTrackIndex.
+ */
+void TrackManager::loadTrackIndex()
+{
+    delete m_track_index;
+    m_track_index_entries.clear();
+    m_track_index_changed = false;
+    m_track_index = file_manager->createXMLTree(
+                              file_manager->getUserConfigFile("track_index.xml"));
+    int version = 0;
+    if(!m_track_index || m_track_index->getName()!="track-index" ||
+        !m_track_index->get("version", &version) ||
+        version!=TRACK_INDEX_VERSION)
+    {
+        delete m_track_index;
+        m_track_index = NULL;
+        return;
+    }
+
+    for(unsigned int i=0; i<m_track_index->getNumNodes(); i++)
+    {
+        const XMLNode *node = m_track_index->getNode(i);
+        std::string dir;
+        if(node->getName()=="track" && node->get("dir", &dir))
+            m_track_index_entries[dir] = node;
+    }
+}   // loadTrackIndex
+
+// ----------------------------------------------------------------------------
+/** Writes the information needed to list all tracks to the track index in
+ *  the config directory, together with the modification time and size of
+ *  their track.xml file.
+ */
+void TrackManager::saveTrackIndex() const
+{
+    const std::string filename =
+                             file_manager->getUserConfigFile("track_index.xml");
+    try
+    {
+        UTFWriter index(filename.c_str());
+        index << L"<?xml version=\"1.0\"?>\n";
+        index << L"<track-index version=\"" << TRACK_INDEX_VERSION
+              << L"\">\n";
+        for(unsigned int i=0; i<m_tracks.size(); i++)
+        {
+            struct stat xml_stat;
+            if(stat(m_tracks[i]->getFilename().c_str(), &xml_stat)!=0)
+                continue;
+            index << L"  <track dir=\""
+                  << StringUtils::xmlEncode(m_all_track_dirs[i].c_str())
+                  << L"\" mtime=\"" << (int64_t)xml_stat.st_mtime
+                  << L"\" size=\""  << (int64_t)xml_stat.st_size
+                  << L"\"\n        ";
+            m_tracks[i]->writeIndexInfo(&index);
+            index << L"/>\n";
+        }
+        index << L"</track-index>\n";
+        index.close();
+    }
+    catch(std::exception &e)
+    {
+        Log::warn("TrackManager", "Problems saving the track index '%s': %s",
+                  filename.c_str(), e.what());
+    }
+}   // saveTrackIndex
+
 // ----------------------------------------------------------------------------
 /** Tries to load a track from a single directory. Returns true if a track was
  *  successfully loaded.
@@ -178,11 +370,30 @@ bool TrackManager::loadTrack(const std::string& dirname)
     if(!file_manager->fileExists(config_file))
         return false;
 
+    // Only use the index entry if track.xml did not change since the index
+    // was written, otherwise track.xml is parsed.
+    const XMLNode *index_node = NULL;
+    std::map<std::string, const XMLNode*>::const_iterator entry =
+                                            m_track_index_entries.find(dirname);
+    struct stat xml_stat;
+    if(entry!=m_track_index_entries.end() &&
+        stat(config_file.c_str(), &xml_stat)==0)
+    {
+        int64_t mtime = -1, size = -1;
+        entry->second->get("mtime", &mtime);
+        entry->second->get("size",  &size );
+        if(mtime==(int64_t)xml_stat.st_mtime &&
+            size==(int64_t)xml_stat.st_size)
+            index_node = entry->second;
+    }
+    if(!index_node)
+        m_track_index_changed = true;
+
     Track *track;
 
     try
     {
-        track = new Track(config_file);
+        track = new Track(config_file, index_node);
     }
     catch (std::exception& e)
     {
@@ -208,11 +419,7 @@ bool TrackManager::loadTrack(const std::string& dirname)
     m_track_avail.push_back(true);
     updateGroups(track);
 
-    // Populate the texture cache with track screenshots
-    // (internal tracks like end cutscene don't have screenshots)
-    if (!track->isInternal())
-        irr_driver->getTexture(track->getScreenshotFile());
-
+    // Screenshots are loaded when the track selection screens show them
     return true;
 }   // loadTrack
 
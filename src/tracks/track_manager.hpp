@@ -24,9 +24,17 @@
 #include <map>
 
 class Track;
+class XMLNode;
+namespace irr
+{
+    namespace scene { class IMesh; }
+}
 
 /**
   * \brief Simple class to load and manage track data, track names and such
+  * The information needed to list the tracks is cached in an index in the
+  * config directory, so that only new or changed track.xml files are parsed
+  * at startup. All other track information is read when a track is loaded.
   * \ingroup tracks
   */
 class TrackManager
@@ -67,7 +75,34 @@ private:
      */
     std::vector<bool>                        m_track_avail;
 
+    /** The track index read at startup, or NULL. */
+    XMLNode                                 *m_track_index;
+
+    /** The entry of the track index for each track directory. */
+    std::map<std::string, const XMLNode*>    m_track_index_entries;
+
+    /** True if the track index needs to be written again. */
+    bool                                     m_track_index_changed;
+
+    /** The meshes (and with them the textures) of a track that was cleaned
+     *  up, kept in irrlicht's caches so that loading the track again is
+     *  fast. */
+    struct CachedMeshes
+    {
+        std::string                      m_ident;
+        std::vector<irr::scene::IMesh*>  m_meshes;
+        std::vector<irr::scene::IMesh*>  m_detached_meshes;
+        /** Estimated memory used by the meshes and textures in bytes. */
+        size_t                           m_size;
+    };   // CachedMeshes
+
+    /** The cached meshes of recently used tracks, least recently used
+     *  first. */
+    std::vector<CachedMeshes>                m_cached_meshes;
+
     void          updateGroups(const Track* track);
+    void          loadTrackIndex();
+    void          saveTrackIndex() const;
 
 public:
                 TrackManager();
@@ -82,6 +117,10 @@ public:
     void  removeTrack(const std::string &ident);
     bool  loadTrack(const std::string& dirname);
     void  removeAllCachedData();
+    void  cacheMeshes(const std::string &ident,
+                      std::vector<irr::scene::IMesh*> *meshes,
+                      std::vector<irr::scene::IMesh*> *detached_meshes);
+    void  releaseCachedMeshes();
     int   getNumberOfRaceTracks() const;
     Track* getTrack(const std::string& ident) const;
     // ------------------------------------------------------------------------
@@ -60,6 +60,7 @@ TrackObject::TrackObject(const core::vector3df& xyz, const core::vector3df& hpr,
     m_init_hpr        = hpr;
     m_init_scale      = scale;
     m_enabled         = true;
+    m_is_near         = true;
     m_presentation    = NULL;
     m_animator        = NULL;
     m_physical_object = NULL;
@@ -95,6 +96,7 @@ void TrackObject::init(const XMLNode &xml_node, scene::ISceneNode* parent,
     m_init_hpr   = core::vector3df(0,0,0);
     m_init_scale = core::vector3df(1,1,1);
     m_enabled    = true;
+    m_is_near    = true;
     m_presentation = NULL;
     m_animator = NULL;
 
@@ -297,10 +299,33 @@ void TrackObject::setEnable(bool mode)
     if (m_presentation != NULL) m_presentation->setEnable(m_enabled);
 }   // setEnable
 
+// ----------------------------------------------------------------------------
+/** Returns the distance from the closest camera or kart up to which the
+ *  presentation of this object must be updated, or a negative value if it
+ *  must always be updated. Animated and physical objects are always
+ *  updated, since they move away from where they were registered.
+ */
+float TrackObject::getActivationRadius() const
+{
+    if (!m_presentation || m_animator || m_physical_object)
+        return -1.0f;
+    return m_presentation->getActivationRadius();
+}   // getActivationRadius
+
+// ----------------------------------------------------------------------------
+/** Called by the track object manager when a camera or kart gets within
+ *  the activation radius, or when all of them have moved away.
+ */
+void TrackObject::setIsNear(bool is_near)
+{
+    m_is_near = is_near;
+    if (m_presentation) m_presentation->onProximityChanged(is_near);
+}   // setIsNear
+
 // ----------------------------------------------------------------------------
 void TrackObject::update(float dt)
 {
-    if (m_presentation) m_presentation->update(dt);
+    if (m_presentation && m_is_near) m_presentation->update(dt);
 
     if (m_physical_object) m_physical_object->update(dt);
 
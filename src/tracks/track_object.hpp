@@ -52,6 +52,10 @@ private:
     /** True if the object is currently being displayed. */
     bool                     m_enabled;
 
+    /** False if the presentation doesn't need to be updated, because no
+     *  camera or kart is within its activation radius. */
+    bool                     m_is_near;
+
     TrackObjectPresentation* m_presentation;
 
 	std::string m_name;
@@ -109,6 +113,8 @@ public:
               bool isAbsoluteCoord);
 
     virtual void reset();
+    float getActivationRadius() const;
+    void  setIsNear(bool is_near);
     const core::vector3df& getPosition() const;
     const core::vector3df  getAbsolutePosition() const;
     const core::vector3df& getRotation() const;
@@ -141,6 +147,9 @@ public:
     // ------------------------------------------------------------------------
 	bool isEnabled() const { return m_enabled; }
     // ------------------------------------------------------------------------
+    /** Returns if a camera or kart is near enough to update the object. */
+    bool isNear() const { return m_is_near; }
+    // ------------------------------------------------------------------------
     bool isSoccerBall() const { return m_soccer_ball; }
     // ------------------------------------------------------------------------
     bool isGarage() const { return m_garage; }
@@ -20,16 +20,30 @@
 
 #include "animations/ipo.hpp"
 #include "animations/three_d_animation.hpp"
+#include "graphics/camera.hpp"
+#include "graphics/irr_driver.hpp"
 #include "graphics/lod_node.hpp"
 #include "graphics/material_manager.hpp"
+#include "graphics/stkinstancegroup.hpp"
+#include "graphics/stkmeshscenenode.hpp"
 #include "io/xml_node.hpp"
+#include "karts/abstract_kart.hpp"
+#include "modes/world.hpp"
 #include "physics/physical_object.hpp"
 #include "tracks/track_object.hpp"
 #include "utils/log.hpp"
 
+#include <ICameraSceneNode.h>
 #include <IMeshSceneNode.h>
 #include <ISceneManager.h>
 
+#include <algorithm>
+
+/** An object is activated when a camera or kart gets within its activation
+ *  radius, and only deactivated when all are further away than this factor
+ *  times the radius, so that objects at the border don't toggle. */
+static const float g_proximity_hysteresis = 1.25f;
+
 TrackObjectManager::TrackObjectManager()
 {
 }   // TrackObjectManager
@@ -37,6 +51,14 @@ TrackObjectManager::TrackObjectManager()
 // ----------------------------------------------------------------------------
 TrackObjectManager::~TrackObjectManager()
 {
+    // The objects remove their nodes from the groups, so they must be
+    // deleted before the groups.
+    m_all_objects.clearAndDeleteAll();
+    for (unsigned int i = 0; i < m_instance_groups.size(); i++)
+    {
+        m_instance_groups[i]->remove();
+        m_instance_groups[i]->drop();
+    }
 }   // ~TrackObjectManager
 
 // ----------------------------------------------------------------------------
@@ -71,7 +93,76 @@ void TrackObjectManager::init()
     {
         curr->init();
     }
-}   // reset
+    updateDriveableTree();
+    buildProximityTree();
+}   // init
+
+// ----------------------------------------------------------------------------
+/** Moves the nodes of static objects into groups, whose bounding volume
+ *  hierarchy is culled before their nodes are culled one by one. Objects
+ *  that show the same mesh share a group, and all others are put into one
+ *  group. Only objects that never move are grouped: no animations, no dynamic
+ *  physics, and no LOD (whose nodes change each frame). Must be called
+ *  after init, on the GLSL pipeline only.
+ */
+void TrackObjectManager::createInstanceGroups()
+{
+    scene::ISceneNode *root = irr_driver->getSceneManager()->getRootSceneNode();
+    std::map<scene::IMesh*, std::vector<STKMeshSceneNode*> > candidates;
+    for (TrackObject *curr : m_all_objects)
+    {
+        if (curr->getType() != "mesh" || curr->getAnimator())
+            continue;
+        const PhysicalObject *physics = curr->getPhysicalObject();
+        if (physics && physics->isDynamic())
+            continue;
+        TrackObjectPresentationSceneNode *presentation =
+            curr->getPresentation<TrackObjectPresentationSceneNode>();
+        if (!presentation)
+            continue;
+        STKMeshSceneNode *node =
+            dynamic_cast<STKMeshSceneNode*>(presentation->getNode());
+        if (!node || node->getParent() != root ||
+            !node->getChildren().empty() || node->isImmediateDraw() ||
+            !node->getMesh())
+            continue;
+        candidates[node->getMesh()].push_back(node);
+    }
+
+    // Meshes with a few instances go into the group of all other meshes
+    const unsigned int min_instances = 4;
+    unsigned int grouped = 0;
+    std::vector<STKMeshSceneNode*> others;
+    std::map<scene::IMesh*, std::vector<STKMeshSceneNode*> >::iterator it;
+    for (it = candidates.begin(); it != candidates.end(); it++)
+    {
+        if (it->second.size() < min_instances)
+        {
+            others.insert(others.end(), it->second.begin(), it->second.end());
+            it->second.clear();
+        }
+    }
+    candidates[NULL].swap(others);
+
+    for (it = candidates.begin(); it != candidates.end(); it++)
+    {
+        if (it->second.empty())
+            continue;
+        STKInstanceGroup *group =
+            new STKInstanceGroup(root, irr_driver->getSceneManager());
+        for (unsigned int i = 0; i < it->second.size(); i++)
+            group->addInstance(it->second[i]);
+        group->build();
+        m_instance_groups.push_back(group);
+        grouped += (unsigned int)it->second.size();
+    }
+    if (!m_instance_groups.empty())
+    {
+        Log::info("TrackObjectManager", "Grouped %u static objects into %u "
+                  "instance groups.", grouped,
+                  (unsigned int)m_instance_groups.size());
+    }
+}   // createInstanceGroups
 // ----------------------------------------------------------------------------
 /** Initialises all track objects.
  */
@@ -91,6 +182,7 @@ void TrackObjectManager::reset()
         }
         curr->setEnable(true);
     }
+    updateDriveableTree();
 }   // reset
 
 // ----------------------------------------------------------------------------
@@ -198,12 +290,163 @@ void TrackObjectManager::handleExplosion(const Vec3 &pos, const PhysicalObject *
 void TrackObjectManager::update(float dt)
 {
     TrackObject* curr;
+    updateProximity();
     for_in (curr, m_all_objects)
     {
         curr->update(dt);
     }
+    updateDriveableTree();
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Collects all objects with an activation radius, and inserts their
+ *  activation spheres into m_proximity_tree. Objects added after init are
+ *  not in the tree, they are always updated.
+ */
+void TrackObjectManager::buildProximityTree()
+{
+    for (unsigned int i = 0; i < m_proximity_leaves.size(); i++)
+        m_proximity_tree.remove(m_proximity_leaves[i]);
+    m_proximity_leaves.clear();
+    m_proximity_objects.clear();
+
+    TrackObject* curr;
+    for_in (curr, m_all_objects)
+    {
+        const float radius = curr->getActivationRadius();
+        if (radius <= 0)
+            continue;
+        const core::vector3df xyz = curr->getAbsolutePosition();
+        btDbvtVolume volume =
+            btDbvtVolume::FromCR(btVector3(xyz.X, xyz.Y, xyz.Z),
+                                 radius * g_proximity_hysteresis);
+        btDbvtNode *leaf = m_proximity_tree.insert(volume, NULL);
+        leaf->dataAsInt = (int)m_proximity_objects.size();
+        m_proximity_objects.push_back(curr);
+        m_proximity_leaves.push_back(leaf);
+    }
+}   // buildProximityTree
+
+// ----------------------------------------------------------------------------
+/** Determines which objects in m_proximity_tree have a camera or kart
+ *  within their activation radius, and activates or deactivates the
+ *  objects whose state changed.
+ */
+void TrackObjectManager::updateProximity()
+{
+    World *world = World::getWorld();
+    if (m_proximity_objects.empty() || !world)
+        return;
+
+    class ProximityCollector : public btDbvt::ICollide
+    {
+    public:
+        const std::vector<TrackObject*> *m_objects;
+        std::vector<bool>               *m_near;
+        btVector3                        m_point;
+        virtual void Process(const btDbvtNode *leaf)
+        {
+            const int i = leaf->dataAsInt;
+            // The leaf is the activation sphere enlarged by the hysteresis
+            const float outer = leaf->volume.Extents().getX();
+            const float inner = outer / g_proximity_hysteresis;
+            const float d2 = (leaf->volume.Center() - m_point).length2();
+            if (d2 < inner * inner ||
+                ((*m_objects)[i]->isNear() && d2 < outer * outer))
+                (*m_near)[i] = true;
+        }
+    };   // ProximityCollector
+
+    std::vector<bool> is_near(m_proximity_objects.size(), false);
+    ProximityCollector collector;
+    collector.m_objects = &m_proximity_objects;
+    collector.m_near    = &is_near;
+    for (unsigned int i = 0; i < Camera::getNumCameras(); i++)
+    {
+        const core::vector3df &xyz =
+            Camera::getCamera(i)->getCameraSceneNode()->getPosition();
+        collector.m_point = btVector3(xyz.X, xyz.Y, xyz.Z);
+        m_proximity_tree.collideTV(m_proximity_tree.m_root,
+                                   btDbvtVolume::FromCR(collector.m_point, 0),
+                                   collector);
+    }
+    for (unsigned int i = 0; i < world->getNumKarts(); i++)
+    {
+        collector.m_point = world->getKart(i)->getXYZ();
+        m_proximity_tree.collideTV(m_proximity_tree.m_root,
+                                   btDbvtVolume::FromCR(collector.m_point, 0),
+                                   collector);
+    }
+
+    for (unsigned int i = 0; i < m_proximity_objects.size(); i++)
+    {
+        if (m_proximity_objects[i]->isNear() != is_near[i])
+            m_proximity_objects[i]->setIsNear(is_near[i]);
+    }
+}   // updateProximity
+
+// ----------------------------------------------------------------------------
+/** Updates the bounding boxes of all driveable objects in the AABB tree,
+ *  and adds objects that are not yet in the tree. The boxes are enlarged
+ *  a little bit, so that the tree only needs to be changed if an
+ *  (animated) object has moved out of its enlarged box.
+ */
+void TrackObjectManager::updateDriveableTree()
+{
+    for(unsigned int i=0; i<m_driveable_objects.size(); i++)
+    {
+        btVector3 min(-99999.9f, -99999.9f, -99999.9f);
+        btVector3 max( 99999.9f,  99999.9f,  99999.9f);
+        PhysicalObject *po = m_driveable_objects[i].getPhysicalObject();
+        btRigidBody *body  = po ? po->getBody() : NULL;
+        if(body && body->getCollisionShape())
+            body->getCollisionShape()->getAabb(body->getWorldTransform(),
+                                               min, max);
+        btDbvtVolume volume = btDbvtVolume::FromMM(min, max);
+        if(i<m_driveable_leaves.size())
+        {
+            m_driveable_tree.update(m_driveable_leaves[i], volume, 0.5f);
+            continue;
+        }
+        btDbvtNode *leaf = m_driveable_tree.insert(volume, NULL);
+        leaf->dataAsInt  = i;
+        m_driveable_leaves.push_back(leaf);
+    }
+}   // updateDriveableTree
+
+// ----------------------------------------------------------------------------
+/** Finds all driveable objects whose bounding box is hit by a ray.
+ *  \param from/to The start and end point of the ray.
+ *  \param candidates On return the (sorted) indices of these objects in
+ *         m_driveable_objects.
+ */
+void TrackObjectManager::findDriveableCandidates(const btVector3 &from,
+                                                 const btVector3 &to,
+                                         std::vector<int> *candidates) const
+{
+    class CandidateCollector : public btDbvt::ICollide
+    {
+    public:
+        std::vector<int> *m_candidates;
+        virtual void Process(const btDbvtNode *leaf)
+        {
+            m_candidates->push_back(leaf->dataAsInt);
+        }
+    };   // CandidateCollector
+
+    candidates->clear();
+    CandidateCollector collector;
+    collector.m_candidates = candidates;
+    btDbvt::rayTest(m_driveable_tree.m_root, from, to, collector);
+    // Keep the order of m_driveable_objects, so that the result for
+    // objects at the same distance is the same as without the tree.
+    std::sort(candidates->begin(), candidates->end());
+    // Objects added since the last update are not in the tree yet.
+    for(unsigned int i=(unsigned int)m_driveable_leaves.size();
+        i<m_driveable_objects.size(); i++)
+        candidates->push_back(i);
+}   // findDriveableCandidates
+
 // ----------------------------------------------------------------------------
 /** Does a raycast against all driveable objects. This way part of the track
  *  can be a physical object, and can e.g. be animated. A separate list of all
@@ -236,8 +479,11 @@ void TrackObjectManager::castRay(const btVector3 &from,
     {
         distance = hit_point->distance(from);
     }
-    for (const TrackObject* curr : m_driveable_objects)
+    std::vector<int> candidates;
+    findDriveableCandidates(from, to, &candidates);
+    for (unsigned int i=0; i<candidates.size(); i++)
     {
+        const TrackObject *curr = m_driveable_objects.get(candidates[i]);
         btVector3 new_hit_point;
         const Material *new_material;
         btVector3 new_normal;
@@ -258,6 +504,52 @@ void TrackObjectManager::castRay(const btVector3 &from,
     }   // for all track objects.
 }   // castRay
 
+// ----------------------------------------------------------------------------
+/** Casts a batch of rays against all driveable track objects. The results
+ *  of each ray are only replaced if a track object is hit that is closer
+ *  than the current result (as in castRay), so the rays can first be cast
+ *  against the track mesh. Only the objects whose bounding box is hit by a
+ *  ray are tested.
+ *  \param rays The rays to cast and their results.
+ *  \param interpolate_normal If the normals should be interpolated.
+ */
+void TrackObjectManager::castRays(std::vector<TriangleMesh::RayQuery> *rays,
+                                  bool interpolate_normal) const
+{
+    std::vector<float> distance(rays->size(), 9999.9f);
+    for(unsigned int i=0; i<rays->size(); i++)
+    {
+        const TriangleMesh::RayQuery &ray = (*rays)[i];
+        if(ray.m_material)
+            distance[i] = ray.m_hit_point.distance(ray.m_from);
+    }
+
+    std::vector<int> candidates;
+    for(unsigned int i=0; i<rays->size(); i++)
+    {
+        TriangleMesh::RayQuery &ray = (*rays)[i];
+        findDriveableCandidates(ray.m_from, ray.m_to, &candidates);
+        for(unsigned int j=0; j<candidates.size(); j++)
+        {
+            const TrackObject *curr = m_driveable_objects.get(candidates[j]);
+            btVector3 new_hit_point;
+            const Material *new_material;
+            btVector3 new_normal;
+            if(!curr->castRay(ray.m_from, ray.m_to, &new_hit_point,
+                              &new_material, &new_normal, interpolate_normal))
+                continue;
+            float new_distance = new_hit_point.distance(ray.m_from);
+            if (new_distance < distance[i])
+            {
+                ray.m_material  = new_material;
+                ray.m_hit_point = new_hit_point;
+                ray.m_normal    = new_normal;
+                distance[i]     = new_distance;
+            }
+        }   // for j < candidates
+    }   // for i < rays
+}   // castRays
+
 // ----------------------------------------------------------------------------
 /** Enables or disables fog for a given scene node.
  *  \param node The node to adjust.
@@ -339,6 +631,21 @@ void TrackObjectManager::insertObject(TrackObject* object)
 void TrackObjectManager::removeObject(TrackObject* obj)
 {
     m_all_objects.remove(obj);
+    if(obj->isDriveable())
+    {
+        m_driveable_objects.remove(obj);
+        // Rebuild the tree, since the indices of the objects changed.
+        for(unsigned int i=0; i<m_driveable_leaves.size(); i++)
+            m_driveable_tree.remove(m_driveable_leaves[i]);
+        m_driveable_leaves.clear();
+        updateDriveableTree();
+    }
+    if (std::find(m_proximity_objects.begin(), m_proximity_objects.end(),
+                  obj) != m_proximity_objects.end())
+    {
+        // Rebuild the tree, since the indices of the objects changed.
+        buildProximityTree();
+    }
     delete obj;
 }   // removeObject
 
@@ -20,13 +20,17 @@
 #define HEADER_TRACK_OBJECT_MANAGER_HPP
 
 #include "physics/physical_object.hpp"
+#include "physics/triangle_mesh.hpp"
 #include "tracks/track_object.hpp"
 #include "utils/ptr_vector.hpp"
 
+#include "BulletCollision/BroadphaseCollision/btDbvt.h"
+
 class Track;
 class Vec3;
 class XMLNode;
 class LODNode;
+class STKInstanceGroup;
 
 #include <map>
 #include <vector>
@@ -51,11 +55,40 @@ protected:
     /** A second list which holds all objects that karts can drive on. */
     PtrVector<TrackObject, REF> m_driveable_objects;
 
+    /** A dynamic AABB tree of all driveable objects, used to only raycast
+     *  against objects whose bounding box is hit by the ray. */
+    btDbvt                   m_driveable_tree;
+
+    /** The leaf of each driveable object in m_driveable_tree (in the same
+     *  order as m_driveable_objects). */
+    std::vector<btDbvtNode*> m_driveable_leaves;
+
+    /** The groups of static objects with the same mesh. */
+    std::vector<STKInstanceGroup*> m_instance_groups;
+
+    /** The objects that only need to be updated while a camera or kart is
+     *  near them, see TrackObject::getActivationRadius. */
+    std::vector<TrackObject*> m_proximity_objects;
+
+    /** A tree of the activation spheres of m_proximity_objects (enlarged
+     *  by the hysteresis), the leaves store the index of their object. */
+    btDbvt                    m_proximity_tree;
+
+    /** The leaf of each object in m_proximity_tree. */
+    std::vector<btDbvtNode*>  m_proximity_leaves;
+
+    void updateDriveableTree();
+    void buildProximityTree();
+    void updateProximity();
+    void findDriveableCandidates(const btVector3 &from, const btVector3 &to,
+                                 std::vector<int> *candidates) const;
+
 public:
          TrackObjectManager();
         ~TrackObjectManager();
     void reset();
     void init();
+    void createInstanceGroups();
     void add(const XMLNode &xml_node, scene::ISceneNode* parent,
              ModelDefinitionLoader& model_def_loader);
     void update(float dt);
@@ -68,6 +101,8 @@ public:
                  const btVector3 &to, btVector3 *hit_point,
                  const Material **material, btVector3 *normal = NULL,
                  bool interpolate_normal = false) const;
+    void castRays(std::vector<TriangleMesh::RayQuery> *rays,
+                  bool interpolate_normal = false) const;
 
     /** Enable or disable fog on objects */
     void enableFog(bool enable);
@@ -572,6 +572,8 @@ TrackObjectPresentationSound::TrackObjectPresentationSound(
 
     float max_dist = 390.0f;
     xml_node.get("max_dist", &max_dist );
+    m_max_dist = max_dist;
+    m_ambient  = false;
 
     // first try track dir, then global dir
     std::string soundfile = World::getWorld()->getTrack()->getTrackFile(sound);
@@ -586,7 +588,6 @@ TrackObjectPresentationSound::TrackObjectPresentationSound(
                                       rolloff,
                                       max_dist,
                                       volume);
-    buffer->load();
 
     m_sound = SFXManager::get()->createSoundSource(buffer, true, true);
     if (m_sound != NULL)
@@ -596,6 +597,7 @@ TrackObjectPresentationSound::TrackObjectPresentationSound(
         {
             m_sound->setLoop(true);
             m_sound->play();
+            m_ambient = true;
         }
     }
     else
@@ -619,6 +621,23 @@ void TrackObjectPresentationSound::update(float dt)
     }
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Stops an ambient sound when no camera or kart is close enough to hear
+ *  it, and starts it again when one comes back.
+ */
+void TrackObjectPresentationSound::onProximityChanged(bool is_near)
+{
+    if (m_sound == NULL || !m_ambient)
+        return;
+    if (is_near)
+    {
+        m_sound->setPosition(m_xyz);
+        m_sound->play();
+    }
+    else
+        m_sound->stop();
+}   // onProximityChanged
+
 // ----------------------------------------------------------------------------
 void TrackObjectPresentationSound::onTriggerItemApproached(Item* who)
 {
@@ -641,6 +660,8 @@ void TrackObjectPresentationSound::triggerSound(bool loop)
 // ----------------------------------------------------------------------------
 void TrackObjectPresentationSound::stopSound()
 {
+    // A stopped ambient sound must not be restarted when a kart comes near
+    m_ambient = false;
     if (m_sound != NULL) m_sound->stop();
 }   // stopSound
 
@@ -732,6 +753,19 @@ void TrackObjectPresentationBillboard::update(float dt)
     }   // m_fade_out_when_close
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Shows the billboard fully opaque when all cameras are beyond the end of
+ *  the fade, since it isn't updated then.
+ */
+void TrackObjectPresentationBillboard::onProximityChanged(bool is_near)
+{
+    if (m_fade_out_when_close && !is_near)
+    {
+        scene::IBillboardSceneNode* node = (scene::IBillboardSceneNode*)m_node;
+        node->setColor(video::SColor(255, 255, 255, 255));
+    }
+}   // onProximityChanged
+
 // ----------------------------------------------------------------------------
 TrackObjectPresentationBillboard::~TrackObjectPresentationBillboard()
 {
@@ -747,6 +781,7 @@ TrackObjectPresentationParticles::TrackObjectPresentationParticles(
 {
     m_emitter = NULL;
     m_lod_emitter_node = NULL;
+    m_clip_distance = -1.0f;
 
     std::string path;
     xml_node.get("kind", &path);
@@ -774,6 +809,7 @@ TrackObjectPresentationParticles::TrackObjectPresentationParticles(
             m_node = lod;
             m_lod_emitter_node = lod;
             m_emitter = emitter;
+            m_clip_distance = (float)clip_distance;
         }
         else
         {
@@ -888,6 +924,8 @@ TrackObjectPresentationActionTrigger::TrackObjectPresentationActionTrigger(
 
     if (m_action.size() == 0)
         Log::warn("TrackObject", "Action-trigger has no action defined.");
+    else
+        m_action_function.setDeclaration("void " + m_action + "(int)");
 
     ItemManager::get()->newItem(m_init_xyz, trigger_distance, this);
 }   // TrackObjectPresentationActionTrigger
@@ -905,6 +943,7 @@ TrackObjectPresentationActionTrigger::TrackObjectPresentationActionTrigger(
     float trigger_distance = distance;
     m_action               = script_name;
     m_action_active        = true;
+    m_action_function.setDeclaration("void " + m_action + "(int)");
     ItemManager::get()->newItem(m_init_xyz, trigger_distance, this);
 }   // TrackObjectPresentationActionTrigger
 
@@ -920,6 +959,6 @@ void TrackObjectPresentationActionTrigger::onTriggerItemApproached(Item* who)
     Camera* camera = Camera::getActiveCamera();
     if (camera != NULL && camera->getKart() != NULL)
         idKart = camera->getKart()->getWorldKartId();
-    script_engine->runFunction("void " + m_action + "(int)",
+    script_engine->runFunction(&m_action_function,
         [=](asIScriptContext* ctx) { ctx->SetArgDWord(0, idKart); });
 }   // onTriggerItemApproached
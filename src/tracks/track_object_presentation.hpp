@@ -22,6 +22,7 @@
 
 #include "graphics/lod_node.hpp"
 #include "items/item.hpp"
+#include "scriptengine/script_function.hpp"
 #include "utils/cpp2011.hpp"
 #include "utils/no_copy.hpp"
 #include "utils/vec3.hpp"
@@ -84,6 +85,16 @@ public:
     virtual void move(const core::vector3df& xyz, const core::vector3df& hpr,
         const core::vector3df& scale, bool isAbsoluteCoord) {}
 
+    // ------------------------------------------------------------------------
+    /** Returns the distance from the closest camera or kart up to which this
+     *  presentation must be updated, or a negative value if it must always
+     *  be updated. */
+    virtual float getActivationRadius() const { return -1.0f; }
+    // ------------------------------------------------------------------------
+    /** Called when a camera or kart gets within the activation radius, or
+     *  when all of them have moved away. The presentation is not updated
+     *  while no camera or kart is near. */
+    virtual void onProximityChanged(bool is_near) {}
     // ------------------------------------------------------------------------
     /** Returns the position of this TrackObjectPresentation. */
     virtual const core::vector3df& getPosition() const { return m_init_xyz; }
@@ -256,6 +267,13 @@ private:
 
     core::vector3df m_xyz;
 
+    /** Distance beyond which the sound can't be heard. */
+    float m_max_dist;
+
+    /** True if this is a looped ambient sound, which is stopped while no
+     *  camera or kart is near it. */
+    bool m_ambient;
+
 public:
 
     TrackObjectPresentationSound(const XMLNode& xml_node,
@@ -263,6 +281,9 @@ public:
     virtual ~TrackObjectPresentationSound();
     virtual void onTriggerItemApproached(Item* who) OVERRIDE;
     virtual void update(float dt) OVERRIDE;
+    virtual void onProximityChanged(bool is_near) OVERRIDE;
+    // ------------------------------------------------------------------------
+    virtual float getActivationRadius() const OVERRIDE { return m_max_dist; }
     virtual void move(const core::vector3df& xyz, const core::vector3df& hpr,
         const core::vector3df& scale, bool isAbsoluteCoord) OVERRIDE;
     void triggerSound(bool loop);
@@ -291,6 +312,14 @@ public:
                                      scene::ISceneNode* parent);
     virtual ~TrackObjectPresentationBillboard();
     virtual void update(float dt) OVERRIDE;
+    virtual void onProximityChanged(bool is_near) OVERRIDE;
+    // ------------------------------------------------------------------------
+    /** The billboard only fades while a camera is closer than the end of
+     *  the fade. */
+    virtual float getActivationRadius() const OVERRIDE
+    {
+        return m_fade_out_when_close ? m_fade_out_end : -1.0f;
+    }   // getActivationRadius
 };   // TrackObjectPresentationBillboard
 
 
@@ -305,12 +334,23 @@ private:
     LODNode* m_lod_emitter_node;
     std::string m_trigger_condition;
 
+    /** Distance at which the LOD node hides the emitter, or -1. */
+    float m_clip_distance;
+
 public:
     TrackObjectPresentationParticles(const XMLNode& xml_node,
                                      scene::ISceneNode* parent);
     virtual ~TrackObjectPresentationParticles();
 
     virtual void update(float dt) OVERRIDE;
+    // ------------------------------------------------------------------------
+    /** Emitters that are hidden by a LOD node don't need to be updated
+     *  beyond that distance. */
+    virtual float getActivationRadius() const OVERRIDE
+    {
+        return m_clip_distance;
+    }   // getActivationRadius
+    // ------------------------------------------------------------------------
     void triggerParticles();
     void stop();
     void setRate(float rate);
@@ -347,6 +387,9 @@ private:
     /** For action trigger objects */
     std::string m_action;
 
+    /** The function "void m_action(int kart_id)" run by the trigger. */
+    Scripting::ScriptFunction m_action_function;
+
     bool m_action_active;
 
 public:
@@ -0,0 +1,114 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_LOCK_FREE_QUEUE_HPP
+#define HEADER_LOCK_FREE_QUEUE_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <atomic>
+
+/** A bounded lock-free queue for multiple producers and a single consumer.
+ *  Any thread can push elements, but only one thread at a time may pop
+ *  them (several consumer threads must serialise their pop calls, e.g.
+ *  with a mutex). Each slot of the ring buffer carries a sequence number
+ *  which tells producers and the consumer whether the slot is free or
+ *  filled, so that no locks are required.
+ *  \param T Type of the elements, should be cheap to copy (e.g. a pointer).
+ *  \param SIZE Number of slots, must be a power of two.
+ */
+template<typename T, unsigned int SIZE>
+class LockFreeQueue : public NoCopy
+{
+private:
+    static_assert((SIZE & (SIZE-1)) == 0, "SIZE must be a power of two");
+
+    struct Cell
+    {
+        std::atomic<unsigned int> m_sequence;
+        T                         m_data;
+    };   // Cell
+
+    Cell                      m_buffer[SIZE];
+
+    /** Position at which the next element will be pushed. */
+    std::atomic<unsigned int> m_push_pos;
+
+    /** Position from which the next element will be popped. Only accessed
+     *  by the consumer. */
+    unsigned int              m_pop_pos;
+
+public:
+    LockFreeQueue()
+    {
+        for (unsigned int i = 0; i < SIZE; i++)
+            m_buffer[i].m_sequence.store(i, std::memory_order_relaxed);
+        m_push_pos.store(0, std::memory_order_relaxed);
+        m_pop_pos = 0;
+    }   // LockFreeQueue
+
+    // ------------------------------------------------------------------------
+    /** Adds an element to the queue. Can be called from any thread.
+     *  \return False if the queue is full.
+     */
+    bool push(const T &data)
+    {
+        Cell *cell;
+        unsigned int pos = m_push_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &m_buffer[pos & (SIZE-1)];
+            unsigned int seq = cell->m_sequence.load(std::memory_order_acquire);
+            int diff = (int)(seq - pos);
+            if (diff == 0)
+            {
+                if (m_push_pos.compare_exchange_weak(pos, pos + 1,
+                                                 std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;   // full
+            else
+                pos = m_push_pos.load(std::memory_order_relaxed);
+        }
+        cell->m_data = data;
+        cell->m_sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }   // push
+
+    // ------------------------------------------------------------------------
+    /** Removes the oldest element from the queue. Must only be called by one
+     *  thread at a time.
+     *  \param data On return the element, if one was available.
+     *  \return False if the queue was empty.
+     */
+    bool pop(T *data)
+    {
+        Cell *cell = &m_buffer[m_pop_pos & (SIZE-1)];
+        unsigned int seq = cell->m_sequence.load(std::memory_order_acquire);
+        if ((int)(seq - (m_pop_pos + 1)) < 0)
+            return false;   // empty
+        *data = cell->m_data;
+        cell->m_sequence.store(m_pop_pos + SIZE, std::memory_order_release);
+        m_pop_pos++;
+        return true;
+    }   // pop
+
+};   // LockFreeQueue
+
+#endif
@@ -21,7 +21,12 @@
 #include "config/user_config.hpp"
 
 #include <cstdio>
+#include <map>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <time.h>
+#include <vector>
 
 #ifdef ANDROID
 #  include <android/log.h>
@@ -29,6 +34,8 @@
 
 #ifdef WIN32
 #  include <windows.h>
+#else
+#  include <sys/time.h>
 #endif
 
 Log::LogLevel Log::m_min_log_level = Log::LL_VERBOSE;
@@ -122,8 +129,192 @@ void Log::resetTerminalColor()
 }   // resetTerminalColor
 
 // ----------------------------------------------------------------------------
-/** This actually prints the log message. If log messages are not redirected
- *  to a file, it tries to select a terminal colour.
+/** Messages are formatted by the thread logging them, and written to the
+ *  console and log file by a writer thread, so that logging threads never
+ *  wait for the output. Errors and fatal messages are written before the
+ *  logging thread continues, so they are not lost if the game crashes.
+ */
+namespace LogWriter
+{
+    /** A formatted message waiting to be written. */
+    struct Message
+    {
+        int         m_level;
+        std::string m_text;
+    };   // Message
+
+    /** How often a format string was used in the current second. */
+    struct CallSiteRate
+    {
+        time_t m_second;
+        int    m_count;
+        int    m_dropped;
+    };   // CallSiteRate
+
+    enum WriterState { WS_NOT_STARTED, WS_RUNNING, WS_STOPPED };
+
+    /** Protects all data below. */
+    pthread_mutex_t     g_mutex        = PTHREAD_MUTEX_INITIALIZER;
+    /** Signals the writer thread that messages or the exit are waiting. */
+    pthread_cond_t      g_queued_cond  = PTHREAD_COND_INITIALIZER;
+    /** Signals flushBuffers that messages were written. */
+    pthread_cond_t      g_written_cond = PTHREAD_COND_INITIALIZER;
+    pthread_t           g_thread;
+    WriterState         g_state        = WS_NOT_STARTED;
+    bool                g_exit         = false;
+    std::vector<Message> g_queue;
+    /** Number of messages queued and written since the start, used to wait
+     *  until the messages queued before a flush are written. */
+    uint64_t            g_num_queued   = 0;
+    uint64_t            g_num_written  = 0;
+    std::map<const char*, CallSiteRate> g_call_sites;
+    /** Stores a small id for each thread that logged something. */
+    pthread_key_t       g_thread_id_key;
+    pthread_once_t      g_thread_id_once = PTHREAD_ONCE_INIT;
+    int                 g_last_thread_id = 0;
+
+    // ------------------------------------------------------------------------
+    void createThreadIdKey()
+    {
+        pthread_key_create(&g_thread_id_key, NULL);
+    }   // createThreadIdKey
+
+    // ------------------------------------------------------------------------
+    /** Returns the id of the calling thread, 1 for the first thread that logs
+     *  a message. Must be called with g_mutex locked. */
+    int getThreadId()
+    {
+        pthread_once(&g_thread_id_once, createThreadIdKey);
+        intptr_t id = (intptr_t)pthread_getspecific(g_thread_id_key);
+        if (id == 0)
+        {
+            id = ++g_last_thread_id;
+            pthread_setspecific(g_thread_id_key, (void*)id);
+        }
+        return (int)id;
+    }   // getThreadId
+
+    // ------------------------------------------------------------------------
+    /** Writes the local time with milliseconds as hh:mm:ss.mmm. */
+    void getTimeStamp(char *buffer, size_t size)
+    {
+#ifdef WIN32
+        SYSTEMTIME t;
+        GetLocalTime(&t);
+        snprintf(buffer, size, "%02d:%02d:%02d.%03d", t.wHour, t.wMinute,
+                 t.wSecond, t.wMilliseconds);
+#else
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        time_t seconds = tv.tv_sec;
+        struct tm t;
+        localtime_r(&seconds, &t);
+        snprintf(buffer, size, "%02d:%02d:%02d.%03d", t.tm_hour, t.tm_min,
+                 t.tm_sec, (int)(tv.tv_usec / 1000));
+#endif
+    }   // getTimeStamp
+}   // namespace LogWriter
+
+// ----------------------------------------------------------------------------
+/** Writes a formatted message to the console and the log file. If log
+ *  messages are not redirected to a file, it tries to select a terminal
+ *  colour. Only called from the writer thread, or when it is not running.
+ */
+void Log::writeMessage(int level, const std::string &text)
+{
+    // If we don't have a console file, write to stdout and hope for the best
+    if(!m_file_stdout || level >= LL_WARN ||
+        UserConfigParams::m_log_errors_to_console) // log to console & file
+    {
+        setTerminalColor((LogLevel)level);
+        fputs(text.c_str(), stdout);
+        resetTerminalColor();  // this prints a \n
+    }
+
+#if defined(_MSC_FULL_VER) && defined(_DEBUG)
+    OutputDebugString(text.c_str());
+    OutputDebugString("\r\n");
+#endif
+
+    if(m_file_stdout)
+    {
+        fputs(text.c_str(), m_file_stdout);
+        fputs("\n", m_file_stdout);
+    }
+}   // writeMessage
+
+// ----------------------------------------------------------------------------
+/** The writer thread, which writes the queued messages in batches so that
+ *  the lock is not held while writing. */
+void* Log::writerLoop(void *obj)
+{
+    using namespace LogWriter;
+    std::vector<Message> batch;
+    pthread_mutex_lock(&g_mutex);
+    while (true)
+    {
+        while (g_queue.empty() && !g_exit)
+            pthread_cond_wait(&g_queued_cond, &g_mutex);
+        if (g_queue.empty())
+            break;
+        batch.swap(g_queue);
+        pthread_mutex_unlock(&g_mutex);
+
+        for (unsigned int i = 0; i < batch.size(); i++)
+            writeMessage(batch[i].m_level, batch[i].m_text);
+
+        pthread_mutex_lock(&g_mutex);
+        g_num_written += batch.size();
+        batch.clear();
+        pthread_cond_broadcast(&g_written_cond);
+    }
+    pthread_mutex_unlock(&g_mutex);
+    return NULL;
+}   // writerLoop
+
+// ----------------------------------------------------------------------------
+/** Writes all queued messages and stops the writer thread. Messages logged
+ *  afterwards are written immediately. Also called at exit, e.g. after a
+ *  fatal error.
+ */
+void Log::stopWriter()
+{
+    using namespace LogWriter;
+    pthread_mutex_lock(&g_mutex);
+    if (g_state != WS_RUNNING)
+    {
+        g_state = WS_STOPPED;
+        pthread_mutex_unlock(&g_mutex);
+        return;
+    }
+    g_exit = true;
+    pthread_cond_signal(&g_queued_cond);
+    pthread_mutex_unlock(&g_mutex);
+    pthread_join(g_thread, NULL);
+
+    pthread_mutex_lock(&g_mutex);
+    g_state = WS_STOPPED;
+    pthread_cond_broadcast(&g_written_cond);
+    pthread_mutex_unlock(&g_mutex);
+}   // stopWriter
+
+// ----------------------------------------------------------------------------
+/** Waits until all messages logged so far are written. */
+void Log::flushBuffers()
+{
+    using namespace LogWriter;
+    pthread_mutex_lock(&g_mutex);
+    const uint64_t target = g_num_queued;
+    while (g_state == WS_RUNNING && g_num_written < target)
+        pthread_cond_wait(&g_written_cond, &g_mutex);
+    pthread_mutex_unlock(&g_mutex);
+}   // flushBuffers
+
+// ----------------------------------------------------------------------------
+/** This actually prints the log message: it is formatted with a time stamp
+ *  and the id of the logging thread, and queued for the writer thread.
+ *  Messages below LL_WARN are dropped if their call site logs too many per
+ *  second.
  *  \param level Log level of the message to print.
  *  \param format A printf-like format string.
  *  \param va_list The values to be printed for the format.
@@ -154,58 +345,101 @@ void Log::printMessage(int level, const char *component, const char *format,
     }
     __android_log_vprint(alp, "SuperTuxKart", format, args);
 #else
+    using namespace LogWriter;
     static const char *names[] = {"debug", "verbose  ", "info   ",
                                   "warn   ", "error  ", "fatal  "};
 
-    // Using a va_list twice produces undefined results, ie crash.
-    // So make a copy if we're going to use it twice.
+    // Check the rate of the call site before spending time on formatting
+    int dropped = 0;
+    pthread_mutex_lock(&g_mutex);
+    if (level < LL_WARN)
+    {
+        const time_t now = time(NULL);
+        CallSiteRate &rate = g_call_sites[format];
+        if (rate.m_second != now)
+        {
+            dropped = rate.m_dropped;
+            rate.m_second  = now;
+            rate.m_count   = 0;
+            rate.m_dropped = 0;
+        }
+        if (++rate.m_count > MAX_MESSAGES_PER_SECOND)
+        {
+            rate.m_dropped++;
+            pthread_mutex_unlock(&g_mutex);
+            return;
+        }
+    }
+    const int thread_id = getThreadId();
+    pthread_mutex_unlock(&g_mutex);
+
+    char time_stamp[16];
+    getTimeStamp(time_stamp, sizeof(time_stamp));
+    char prefix[128];
+    snprintf(prefix, sizeof(prefix), "[%s] %s t%d %s: ", names[level],
+             time_stamp, thread_id, component);
+
+    Message message;
+    message.m_level = level;
+    message.m_text  = prefix;
+    char buffer[1024];
     VALIST copy;
-    if (m_file_stdout)
+    va_copy(copy, args);
+    int len = vsnprintf(buffer, sizeof(buffer), format, copy);
+    va_end(copy);
+    if (len >= (int)sizeof(buffer))
     {
+        // Using a va_list twice produces undefined results, ie crash,
+        // so it was copied for the first attempt.
+        std::string long_text(len + 1, 0);
         va_copy(copy, args);
+        vsnprintf(&long_text[0], len + 1, format, copy);
+        va_end(copy);
+        long_text.resize(len);
+        message.m_text += long_text;
     }
-#if defined(_MSC_FULL_VER) && defined(_DEBUG)
-    VALIST copy2;
-    va_copy(copy2, args);
-#endif
+    else if (len > 0)
+        message.m_text += buffer;
 
-    // If we don't have a console file, write to stdout and hope for the best
-    if(!m_file_stdout || level >= LL_WARN ||
-        UserConfigParams::m_log_errors_to_console) // log to console & file
+    Message dropped_message;
+    if (dropped > 0)
     {
-        VALIST out;
-        va_copy(out, args);
-
-        setTerminalColor((LogLevel)level);
-        printf("[%s] %s: ", names[level], component);
-        vprintf(format, out);
-        resetTerminalColor();  // this prints a \n
-
-        va_end(out);
+        snprintf(buffer, sizeof(buffer), "[%s] %s t%d Log: %d messages like "
+                 "'%.60s' were dropped.", names[LL_WARN], time_stamp,
+                 thread_id, dropped, format);
+        dropped_message.m_level = LL_WARN;
+        dropped_message.m_text  = buffer;
     }
 
-#if defined(_MSC_FULL_VER) && defined(_DEBUG)
-    static char szBuff[2048];
-    vsnprintf(szBuff, sizeof(szBuff), format, copy2);
-
-    OutputDebugString("[");
-    OutputDebugString(names[level]);
-    OutputDebugString("] ");
-    OutputDebugString(component);
-    OutputDebugString(": ");
-    OutputDebugString(szBuff);
-    OutputDebugString("\r\n");
-#endif
-    
-
-    if(m_file_stdout)
+    pthread_mutex_lock(&g_mutex);
+    if (g_state == WS_NOT_STARTED)
     {
-        fprintf (m_file_stdout, "[%s] %s: ", names[level], component);
-        vfprintf(m_file_stdout, format, copy);
-        fprintf (m_file_stdout, "\n");
-        va_end(copy);
+        g_state = pthread_create(&g_thread, NULL, &Log::writerLoop, NULL) == 0
+                ? WS_RUNNING : WS_STOPPED;
+        if (g_state == WS_RUNNING)
+            atexit(&Log::stopWriter);
+    }
+    if (g_state != WS_RUNNING)
+    {
+        // No writer thread (anymore), e.g. while shutting down
+        pthread_mutex_unlock(&g_mutex);
+        if (dropped > 0)
+            writeMessage(dropped_message.m_level, dropped_message.m_text);
+        writeMessage(level, message.m_text);
+        return;
+    }
+    if (dropped > 0)
+    {
+        g_queue.push_back(dropped_message);
+        g_num_queued++;
     }
+    g_queue.push_back(message);
+    g_num_queued++;
+    pthread_cond_signal(&g_queued_cond);
+    pthread_mutex_unlock(&g_mutex);
 
+    if (level >= LL_ERROR)
+        flushBuffers();
 #endif
 }   // printMessage
 
@@ -217,6 +451,8 @@ void Log::printMessage(int level, const char *component, const char *format,
  */
 void Log::openOutputFiles(const std::string &logout)
 {
+    // Messages logged before go to the console only
+    flushBuffers();
     m_file_stdout = fopen(logout.c_str(), "w");
     if (!m_file_stdout)
     {
@@ -234,6 +470,8 @@ void Log::openOutputFiles(const std::string &logout)
 /** Function to close output files */
 void Log::closeOutputFiles()
 {
+    stopWriter();
     fclose(m_file_stdout);
+    m_file_stdout = NULL;
 } // closeOutputFiles
 
@@ -59,8 +59,15 @@ private:
     /** The file where stdout output will be written */
     static FILE* m_file_stdout;
 
-    static void setTerminalColor(LogLevel level);
-    static void resetTerminalColor();
+    /** Maximum number of messages below LL_WARN printed per second by one
+     *  call site (i.e. format string), further ones are dropped. */
+    static const int MAX_MESSAGES_PER_SECOND = 20;
+
+    static void  setTerminalColor(LogLevel level);
+    static void  resetTerminalColor();
+    static void  writeMessage(int level, const std::string &text);
+    static void* writerLoop(void *obj);
+    static void  stopWriter();
 
 public:
 
@@ -96,6 +103,8 @@ public:
 
     static void closeOutputFiles();
 
+    static void flushBuffers();
+
     // ------------------------------------------------------------------------
     /** Defines the minimum log level to be displayed. */
     static void setLogLevel(int n)
@@ -0,0 +1,115 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_OBJECT_POOL_HPP
+#define HEADER_OBJECT_POOL_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <new>
+#include <stddef.h>
+#include <vector>
+
+/** Recycles the memory of short lived objects of a class hierarchy, e.g.
+ *  all Flyables. The base class of the hierarchy uses this pool in its
+ *  class specific operator new and delete:
+ *
+ *      static void *operator new(size_t size)
+ *                         { return ObjectPool<Base>::allocate(size); }
+ *      static void  operator delete(void *p, size_t size)
+ *                         { ObjectPool<Base>::release(p, size);      }
+ *
+ *  Released memory is kept in a free list per object size (i.e. per
+ *  derived class), and handed out again to the next object of the same
+ *  size. So after a short while creating an object does not allocate
+ *  anymore. The objects are still constructed and destructed as before,
+ *  so the constructors provide the reset semantics.
+ *  The pool is not thread safe, it must only be used from one thread.
+ *  \param BASE Base class of the hierarchy of pooled objects (only used to
+ *         have a separate pool for each hierarchy).
+ */
+template<typename BASE>
+class ObjectPool : public NoCopy
+{
+private:
+    /** A list of free memory blocks of the same size. */
+    struct FreeList
+    {
+        size_t              m_size;
+        std::vector<void*>  m_blocks;
+    };   // FreeList
+
+    /** One free list for each size. There are only a few different sizes
+     *  (one for each derived class), so a linear search is fastest. */
+    std::vector<FreeList> m_free_lists;
+
+    // ------------------------------------------------------------------------
+    ObjectPool() {}
+    // ------------------------------------------------------------------------
+    ~ObjectPool()
+    {
+        for (unsigned int i = 0; i < m_free_lists.size(); i++)
+        {
+            for (unsigned int j = 0; j < m_free_lists[i].m_blocks.size(); j++)
+                ::operator delete(m_free_lists[i].m_blocks[j]);
+        }
+    }   // ~ObjectPool
+    // ------------------------------------------------------------------------
+    static ObjectPool *get()
+    {
+        static ObjectPool pool;
+        return &pool;
+    }   // get
+    // ------------------------------------------------------------------------
+    FreeList *getFreeList(size_t size)
+    {
+        for (unsigned int i = 0; i < m_free_lists.size(); i++)
+        {
+            if (m_free_lists[i].m_size == size)
+                return &m_free_lists[i];
+        }
+        m_free_lists.push_back(FreeList());
+        m_free_lists.back().m_size = size;
+        return &m_free_lists.back();
+    }   // getFreeList
+
+public:
+    // ------------------------------------------------------------------------
+    /** Returns a block of memory of the given size, reusing a released
+     *  block if possible. */
+    static void *allocate(size_t size)
+    {
+        FreeList *list = get()->getFreeList(size);
+        if (list->m_blocks.empty())
+            return ::operator new(size);
+        void *p = list->m_blocks.back();
+        list->m_blocks.pop_back();
+        return p;
+    }   // allocate
+    // ------------------------------------------------------------------------
+    /** Keeps a block of memory for reuse.
+     *  \param p The memory block.
+     *  \param size The size with which the block was allocated. */
+    static void release(void *p, size_t size)
+    {
+        if (!p) return;
+        get()->getFreeList(size)->m_blocks.push_back(p);
+    }   // release
+};   // ObjectPool
+
+#endif
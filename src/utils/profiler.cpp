@@ -21,6 +21,11 @@
 #include "guiengine/event_handler.hpp"
 #include "guiengine/engine.hpp"
 #include "guiengine/scalable_font.hpp"
+#include "io/file_manager.hpp"
+#include "modes/profile_world.hpp"
+#include "network/network_manager.hpp"
+#include "network/network_statistics.hpp"
+#include "utils/log.hpp"
 #include "utils/vs.hpp"
 
 #include <assert.h>
@@ -62,6 +67,13 @@ static const char* GPU_Phase[Q_LAST] =
 
 Profiler profiler;
 
+/** Returns the name of a GPU timer (see QueryPerf). */
+const char* getGPUPhaseName(unsigned phase)
+{
+    assert(phase < Q_LAST);
+    return GPU_Phase[phase];
+}   // getGPUPhaseName
+
 // Unit is in pencentage of the screen dimensions
 #define MARGIN_X    0.02f    // left and right margin
 #define MARGIN_Y    0.02f    // top margin
@@ -69,6 +81,12 @@ Profiler profiler;
 
 #define MARKERS_NAMES_POS      core::rect<s32>(50,100,150,200)
 #define GPU_MARKERS_NAMES_POS      core::rect<s32>(50,165,150,250)
+#define NETWORK_STATS_POS      core::rect<s32>(50,250,650,450)
+#define COUNTERS_POS           core::rect<s32>(700,100,1200,500)
+
+/** Interval at which the counters are written to a file in no graphics
+ *  mode, in milliseconds. */
+#define COUNTER_DUMP_INTERVAL 10000.0
 
 #define TIME_DRAWN_MS 30.0f // the width of the profiler corresponds to TIME_DRAWN_MS milliseconds
 
@@ -78,16 +96,21 @@ Profiler profiler;
 
     double getTimeMilliseconds()
     {
-        LARGE_INTEGER freq;
-        QueryPerformanceFrequency(&freq);
-        double perFreq = double(freq.QuadPart) / 1000.0;
+        // The frequency is fixed at boot, only query it once
+        static double per_freq = 0.0;
+        if (per_freq == 0.0)
+        {
+            LARGE_INTEGER freq;
+            QueryPerformanceFrequency(&freq);
+            per_freq = double(freq.QuadPart) / 1000.0;
+        }
 
         LARGE_INTEGER timer;
         QueryPerformanceCounter(&timer);
-        return double(timer.QuadPart) / perFreq;
+        return double(timer.QuadPart) / per_freq;
     }
 
-#else
+#elif defined(__APPLE__)
     #include <sys/time.h>
     double getTimeMilliseconds()
     {
@@ -95,28 +118,222 @@ Profiler profiler;
         gettimeofday(&tv, NULL);
         return double(tv.tv_sec * 1000) + (double(tv.tv_usec) / 1000.0);
     }
+#else
+    #include <time.h>
+    double getTimeMilliseconds()
+    {
+        // Monotonic, and read from the vdso without a system call
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return double(ts.tv_sec) * 1000.0 + double(ts.tv_nsec) / 1000000.0;
+    }
 #endif
 // --- End portable precise timer ---
 
 //-----------------------------------------------------------------------------
 Profiler::Profiler()
 {
-    m_thread_infos.resize(1);    // TODO: monothread now, should support multithreading
+    for (unsigned int i = 0; i < MAX_THREADS; i++)
+        m_thread_infos[i] = NULL;
+    m_num_thread_infos = 0;
+    pthread_key_create(&m_thread_key, &Profiler::releaseThread);
     m_write_id = 0;
     m_time_last_sync = getTimeMilliseconds();
+    m_frame_start[0] = m_frame_start[1] = m_time_last_sync;
     m_time_between_sync = 0.0;
     m_freeze_state = UNFROZEN;
     m_capture_report = false;
     m_first_capture_sweep = true;
     m_first_gpu_capture_sweep = true;
     m_capture_report_buffer = NULL;
+    m_accumulate_totals = false;
+    m_num_counters = 0;
+    pthread_mutex_init(&m_counters_mutex, NULL);
+    m_time_last_counter_dump = m_time_last_sync;
 }
 
 //-----------------------------------------------------------------------------
 Profiler::~Profiler()
 {
+    pthread_key_delete(m_thread_key);
+    pthread_mutex_destroy(&m_counters_mutex);
+    for (unsigned int i = 0; i < getNumThreadInfos(); i++)
+        delete m_thread_infos[i].load();
 }
 
+//-----------------------------------------------------------------------------
+/** Returns the markers of the calling thread, which are created the first
+ *  time a thread uses a marker. Returns NULL if too many threads use
+ *  markers.
+ */
+Profiler::ThreadInfo* Profiler::getThreadInfo()
+{
+    ThreadInfo *info = (ThreadInfo*)pthread_getspecific(m_thread_key);
+    if (!info)
+        info = registerThread();
+    return info;
+}   // getThreadInfo
+
+//-----------------------------------------------------------------------------
+/** Assigns a ThreadInfo to the calling thread without locking: the info of
+ *  a thread that exited is reused, otherwise a new slot is appended.
+ */
+Profiler::ThreadInfo* Profiler::registerThread()
+{
+    ThreadInfo *info = NULL;
+    const unsigned int count = getNumThreadInfos();
+    for (unsigned int i = 0; i < count && !info; i++)
+    {
+        ThreadInfo *candidate = m_thread_infos[i].load();
+        bool in_use = false;
+        if (candidate && candidate->in_use.compare_exchange_strong(in_use,
+                                                                   true))
+            info = candidate;
+    }
+
+    if (!info)
+    {
+        const unsigned int slot = m_num_thread_infos.fetch_add(1);
+        if (slot >= MAX_THREADS)
+            return NULL;
+        info = new ThreadInfo();
+        info->in_use = true;
+        m_thread_infos[slot].store(info);
+    }
+
+    info->depth = 0;
+    info->num_markers_done[0] = 0;
+    info->num_markers_done[1] = 0;
+    pthread_setspecific(m_thread_key, info);
+    return info;
+}   // registerThread
+
+//-----------------------------------------------------------------------------
+/** Called when a thread that used markers exits. */
+void Profiler::releaseThread(void *info)
+{
+    ((ThreadInfo*)info)->in_use = false;
+}   // releaseThread
+
+//-----------------------------------------------------------------------------
+/** Adds a value of the last frame. */
+void Profiler::History::add(double value)
+{
+    if (m_values.size() < SIZE)
+        m_values.push_back(value);
+    else
+        m_values[m_next] = value;
+    m_next = (m_next + 1) % SIZE;
+}   // History::add
+
+//-----------------------------------------------------------------------------
+/** Returns a percentile (fraction between 0 and 1) of the last frames. */
+double Profiler::History::getPercentile(float fraction) const
+{
+    if (m_values.empty())
+        return 0.0;
+    std::vector<double> values = m_values;
+    size_t n = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}   // History::getPercentile
+
+//-----------------------------------------------------------------------------
+/** Returns the id of the counter or gauge with the given name, which is
+ *  created if it doesn't exist yet. Used by PROFILER_COUNT and
+ *  PROFILER_SET_GAUGE, which call this only once per call site.
+ *  \param name Name of the counter, must be a static string.
+ *  \param is_gauge True if the value is kept between frames.
+ */
+unsigned int Profiler::registerCounter(const char *name, bool is_gauge)
+{
+    pthread_mutex_lock(&m_counters_mutex);
+    const unsigned int n = m_num_counters.load();
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (strcmp(m_counters[i].name, name) == 0)
+        {
+            pthread_mutex_unlock(&m_counters_mutex);
+            return i;
+        }
+    }
+    if (n >= MAX_COUNTERS)
+    {
+        pthread_mutex_unlock(&m_counters_mutex);
+        Log::warn("Profiler", "Too many counters, '%s' is ignored.", name);
+        return MAX_COUNTERS;
+    }
+    m_counters[n].name     = name;
+    m_counters[n].is_gauge = is_gauge;
+    m_counters[n].value    = 0;
+    m_num_counters.store(n + 1);
+    pthread_mutex_unlock(&m_counters_mutex);
+    return n;
+}   // registerCounter
+
+//-----------------------------------------------------------------------------
+/** Adds the frame time and the values of all counters of the last frame to
+ *  their histories, and resets the counters. In no graphics mode, the
+ *  percentiles are written to a file every COUNTER_DUMP_INTERVAL ms.
+ */
+void Profiler::updateCounters()
+{
+    m_frame_times.add(m_time_between_sync);
+    const unsigned int n = m_num_counters.load();
+    for (unsigned int i = 0; i < n; i++)
+    {
+        Counter &c = m_counters[i];
+        const int64_t value = c.is_gauge ? c.value.load()
+                                         : c.value.exchange(0);
+        c.history.add((double)value);
+    }
+
+    if (ProfileWorld::isNoGraphics() &&
+        m_time_last_sync - m_time_last_counter_dump >= COUNTER_DUMP_INTERVAL)
+    {
+        m_time_last_counter_dump = m_time_last_sync;
+        std::ofstream out(file_manager->getUserConfigFile("profiling_counters.txt")
+                          .c_str(), std::ios::out | std::ios::app);
+        writeCounters(out);
+        out << "\n";
+    }
+}   // updateCounters
+
+//-----------------------------------------------------------------------------
+/** Writes the last value and p50/p95/p99 of the frame time and of all
+ *  counters over the last History::SIZE frames. */
+void Profiler::writeCounters(std::ostream &out) const
+{
+    out.precision(4);
+    out << "Frame time: " << m_frame_times.getLast() << " ms (p50 "
+        << m_frame_times.getPercentile(0.5f) << ", p95 "
+        << m_frame_times.getPercentile(0.95f) << ", p99 "
+        << m_frame_times.getPercentile(0.99f) << ")\n";
+    const unsigned int n = m_num_counters.load();
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const Counter &c = m_counters[i];
+        out << c.name << ": " << c.history.getLast() << " (p50 "
+            << c.history.getPercentile(0.5f) << ", p95 "
+            << c.history.getPercentile(0.95f) << ", p99 "
+            << c.history.getPercentile(0.99f) << ")\n";
+    }
+}   // writeCounters
+
+//-----------------------------------------------------------------------------
+/** Starts (after clearing all previous totals) or stops accumulating the
+ *  time of the markers, and all results of the GPU timers. */
+void Profiler::setAccumulateTotals(bool accumulate)
+{
+    m_accumulate_totals = accumulate;
+    if (accumulate) m_marker_totals.clear();
+    if (irr_driver)
+    {
+        for (unsigned i = 0; i < Q_LAST; i++)
+            irr_driver->getGPUTimer(i).setAccumulate(accumulate);
+    }
+}   // setAccumulateTotals
+
 //-----------------------------------------------------------------------------
 
 void Profiler::setCaptureReport(bool captureReport)
@@ -130,6 +347,8 @@ void Profiler::setCaptureReport(bool captureReport)
         // all reasonable purposes. But it's not too clean to hardcode
         m_capture_report_buffer = new StringBuffer(20 * 1024 * 1024);
         m_gpu_capture_report_buffer = new StringBuffer(20 * 1024 * 1024);
+        m_trace_events.clear();
+        m_trace_events.reserve(256 * 1024);
     }
     else if (m_capture_report && !captureReport)
     {
@@ -144,6 +363,7 @@ void Profiler::setCaptureReport(bool captureReport)
             const char* str = m_gpu_capture_report_buffer->getRawBuffer();
             filewriter.write(str, strlen(str));
         }
+        writeTrace(file_manager->getUserConfigFile("profiling_trace.json"));
 
         m_capture_report = false;
 
@@ -152,47 +372,92 @@ void Profiler::setCaptureReport(bool captureReport)
 
         delete m_gpu_capture_report_buffer;
         m_gpu_capture_report_buffer = NULL;
+
+        m_trace_events.clear();
+        m_trace_events.shrink_to_fit();
     }
 }
 
 //-----------------------------------------------------------------------------
-/// Push a new marker that starts now
+/** Writes the markers of all threads captured since the report was started
+ *  in the Chrome trace event format, which can be loaded in
+ *  chrome://tracing or other trace viewers.
+ *  \param filename Name of the file to write.
+ */
+void Profiler::writeTrace(const std::string &filename) const
+{
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    out << "{\"traceEvents\":[\n";
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    for (unsigned int i = 0; i < m_trace_events.size(); i++)
+    {
+        const TraceEvent &e = m_trace_events[i];
+        out << (i == 0 ? "" : ",\n") << "{\"name\":\"";
+        for (const char *c = e.name; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                out << '\\';
+            out << *c;
+        }
+        // Times are in microseconds
+        out << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.thread
+            << ",\"ts\":" << e.start * 1000.0
+            << ",\"dur\":" << (e.end - e.start) * 1000.0 << "}";
+    }
+    out << "\n]}\n";
+}   // writeTrace
+
+//-----------------------------------------------------------------------------
+/** Push a new marker that starts now.
+ *  \param name Name of the marker. Only the pointer is stored, so this must
+ *         be a static string.
+ */
 void Profiler::pushCpuMarker(const char* name, const video::SColor& color)
 {
-    // Don't do anything when frozen
-    if(m_freeze_state == FROZEN || m_freeze_state == WAITING_FOR_UNFREEZE)
+    ThreadInfo *ti = getThreadInfo();
+    if (!ti)
         return;
 
-    ThreadInfo& ti = getThreadInfo();
-    MarkerStack& markers_stack = ti.markers_stack[m_write_id];
-    double  start = getTimeMilliseconds() - m_time_last_sync;
-    size_t  layer = markers_stack.size();
-
-    // Add to the stack of current markers
-    markers_stack.push(Marker(start, -1.0, name, color, layer));
+    // Deeper markers are only counted, so that pop stays balanced
+    if (ti->depth < MAX_DEPTH)
+    {
+        Marker &m = ti->markers_stack[ti->depth];
+        m.start = getTimeMilliseconds();
+        m.end   = -1.0;
+        m.name  = name;
+        m.layer = ti->depth;
+        m.color = color;
+    }
+    ti->depth++;
 }
 
 //-----------------------------------------------------------------------------
 /// Stop the last pushed marker
 void Profiler::popCpuMarker()
 {
-    // Don't do anything when frozen
-    if(m_freeze_state == FROZEN || m_freeze_state == WAITING_FOR_UNFREEZE)
+    ThreadInfo *ti = getThreadInfo();
+    if (!ti)
+        return;
+    assert(ti->depth > 0);
+    ti->depth--;
+    if (ti->depth >= MAX_DEPTH)
         return;
 
-    ThreadInfo&    ti = getThreadInfo();
-    assert(ti.markers_stack[m_write_id].size() > 0);
-
-    MarkerStack& markers_stack = ti.markers_stack[m_write_id];
-    MarkerList&  markers_done  = ti.markers_done[m_write_id];
+    // The stack is kept while frozen, only the finished markers are dropped
+    if(m_freeze_state == FROZEN || m_freeze_state == WAITING_FOR_UNFREEZE)
+        return;
 
-    // Update the date of end of the marker
-    Marker&     marker = markers_stack.top();
-    marker.end = getTimeMilliseconds() - m_time_last_sync;
+    const int write_id = m_write_id.load();
+    const unsigned int n = ti->num_markers_done[write_id].load();
+    if (n >= MAX_MARKERS)
+        return;
 
-    // Remove the marker from the stack and add it to the list of markers done
-    markers_done.push_front(marker);
-    markers_stack.pop();
+    Marker &marker = ti->markers_done[write_id][n];
+    marker     = ti->markers_stack[ti->depth];
+    marker.end = getTimeMilliseconds();
+    // Publish the marker after it was written
+    ti->num_markers_done[write_id].store(n + 1, std::memory_order_release);
 }
 
 //-----------------------------------------------------------------------------
@@ -206,51 +471,55 @@ void Profiler::synchronizeFrame()
     // Avoid using several times getTimeMilliseconds(), which would yield different results
     double now = getTimeMilliseconds();
 
-    // Swap buffers
-    int old_write_id = m_write_id;
-    m_write_id = !m_write_id;
-
-    // For each thread:
-    ThreadInfoList::iterator it_end = m_thread_infos.end();
-    for(ThreadInfoList::iterator it = m_thread_infos.begin() ; it != it_end ; it++)
+    // Swap buffers: empty the new buffers of all threads before switching
+    const int old_write_id = m_write_id.load();
+    const int new_write_id = !old_write_id;
+    const unsigned int num_threads = getNumThreadInfos();
+    for (unsigned int i = 0; i < num_threads; i++)
     {
-        // Get the thread information
-        ThreadInfo& ti = *it;
-
-        MarkerList&  old_markers_done  = ti.markers_done[old_write_id];
-        MarkerStack& old_markers_stack = ti.markers_stack[old_write_id];
-
-        MarkerList&  new_markers_done  = ti.markers_done[m_write_id];
-        MarkerStack& new_markers_stack = ti.markers_stack[m_write_id];
-
-        // Clear the containers for the new frame
-        new_markers_done.clear();
-        while(!new_markers_stack.empty())
-            new_markers_stack.pop();
-
-        // Finish the markers in the stack of the previous frame
-        // and start them for the next frame.
+        ThreadInfo *ti = m_thread_infos[i].load();
+        if (ti)
+            ti->num_markers_done[new_write_id] = 0;
+    }
+    m_frame_start[new_write_id] = now;
+    m_write_id.store(new_write_id);
 
-        // For each marker in the old stack:
-        while(!old_markers_stack.empty())
+    // Collect the markers of the previous frame for the totals and the trace
+    if (m_accumulate_totals || m_capture_report)
+    {
+        for (unsigned int i = 0; i < num_threads; i++)
         {
-            // - finish the marker for the previous frame and add it to the old "done" list
-            Marker& m = old_markers_stack.top();
-            m.end = now - m_time_last_sync;
-            old_markers_done.push_front(m);
-
-            // - start a new one for the new frame
-            Marker new_marker(0.0, -1.0, m.name.c_str(), m.color);
-            new_markers_stack.push(new_marker);
-
-            // - next iteration
-            old_markers_stack.pop();
+            ThreadInfo *ti = m_thread_infos[i].load();
+            if (!ti)
+                continue;
+            const unsigned int n = ti->num_markers_done[old_write_id].load(
+                                                    std::memory_order_acquire);
+            for (unsigned int j = 0; j < n; j++)
+            {
+                const Marker &m = ti->markers_done[old_write_id][j];
+                if (m_accumulate_totals)
+                {
+                    MarkerTotal &total = m_marker_totals[m.name];
+                    total.m_time += m.end - m.start;
+                    total.m_count++;
+                }
+                if (m_capture_report)
+                {
+                    TraceEvent e;
+                    e.start  = m.start;
+                    e.end    = m.end;
+                    e.name   = m.name;
+                    e.thread = i;
+                    m_trace_events.push_back(e);
+                }
+            }
         }
     }
 
     // Remember the date of last synchronization
     m_time_between_sync = now - m_time_last_sync;
     m_time_last_sync = now;
+    updateCounters();
 
     // Freeze/unfreeze as needed
     if(m_freeze_state == WAITING_FOR_FREEZE)
@@ -272,7 +541,7 @@ void Profiler::draw()
     // Force to show the pointer
     irr_driver->showPointer();
 
-    int read_id = !m_write_id;
+    int read_id = !m_write_id.load();
 
     // Compute some values for drawing (unit: pixels, but we keep floats for reducing errors accumulation)
     core::dimension2d<u32>    screen_size    = driver->getScreenSize();
@@ -281,19 +550,29 @@ void Profiler::draw()
     const double y_offset    = (MARGIN_Y + LINE_HEIGHT)*screen_size.Height;
     const double line_height = LINE_HEIGHT*screen_size.Height;
 
-    size_t nb_thread_infos = m_thread_infos.size();
-
+    size_t nb_thread_infos = getNumThreadInfos();
 
+    // Copy the finished markers of all threads, with times relative to the
+    // start of the frame
+    const double frame_start = m_frame_start[read_id];
+    std::vector<std::vector<Marker> > thread_markers(nb_thread_infos);
     double start = -1.0f;
     double end = -1.0f;
     for (size_t i = 0; i < nb_thread_infos; i++)
     {
-        MarkerList& markers = m_thread_infos[i].markers_done[read_id];
-
-        MarkerList::const_iterator it_end = markers.end();
-        for (MarkerList::const_iterator it = markers.begin(); it != it_end; it++)
+        const ThreadInfo *ti = m_thread_infos[i].load();
+        if (!ti)
+            continue;
+        const unsigned int n = ti->num_markers_done[read_id].load(
+                                                    std::memory_order_acquire);
+        std::vector<Marker> &markers = thread_markers[i];
+        // Outer markers are popped last, but must be drawn first
+        for (unsigned int j = n; j > 0; j--)
         {
-            const Marker& m = *it;
+            Marker m = ti->markers_done[read_id][j - 1];
+            m.start = std::max(m.start - frame_start, 0.0);
+            m.end   = std::max(m.end   - frame_start, m.start);
+            markers.push_back(m);
 
             if (start < 0.0) start = m.start;
             else start = std::min(start, m.start);
@@ -313,7 +592,7 @@ void Profiler::draw()
     for (size_t i = 0; i < nb_thread_infos; i++)
     {
         // Draw all markers
-        MarkerList& markers = m_thread_infos[i].markers_done[read_id];
+        const std::vector<Marker>& markers = thread_markers[i];
 
         if (markers.empty())
             continue;
@@ -325,10 +604,9 @@ void Profiler::draw()
             else
                 m_capture_report_buffer->getStdStream() << i << ";";
         }
-        MarkerList::const_iterator it_end = markers.end();
-        for (MarkerList::const_iterator it = markers.begin(); it != it_end; it++)
+        for (unsigned int j = 0; j < markers.size(); j++)
         {
-            const Marker&    m = *it;
+            const Marker&    m = markers[j];
             assert(m.end >= 0.0);
 
             if (m_capture_report)
@@ -449,12 +727,29 @@ void Profiler::draw()
         }
         font->draw(text, MARKERS_NAMES_POS, video::SColor(0xFF, 0xFF, 0x00, 0x00));
 
+        std::ostringstream counters;
+        writeCounters(counters);
+        font->draw(counters.str().c_str(), COUNTERS_POS,
+                   video::SColor(0xFF, 0x00, 0x00, 0x00));
+
         if (hovered_gpu_marker != Q_LAST)
         {
             std::ostringstream oss;
-            oss << GPU_Phase[hovered_gpu_marker] << " : " << hovered_gpu_marker_elapsed << " us";
+            const GPUTimer &timer = irr_driver->getGPUTimer(hovered_gpu_marker);
+            oss << GPU_Phase[hovered_gpu_marker] << " : " << hovered_gpu_marker_elapsed << " us"
+                << " (p50 " << timer.getRollingPercentile(0.5f)
+                << ", p95 " << timer.getRollingPercentile(0.95f)
+                << ", p99 " << timer.getRollingPercentile(0.99f) << " us)";
             font->draw(oss.str().c_str(), GPU_MARKERS_NAMES_POS, video::SColor(0xFF, 0xFF, 0x00, 0x00));
         }
+
+        // Show the network statistics if a network game is running
+        NetworkManager *network_manager = NetworkManager::getInstance();
+        if (network_manager && network_manager->getPeers().size() > 0)
+        {
+            std::string stats = NetworkStatistics::getInstance()->getSummary();
+            font->draw(stats.c_str(), NETWORK_STATS_POS, video::SColor(0xFF, 0x00, 0x00, 0xFF));
+        }
     }
 
     if (m_capture_report)
@@ -19,7 +19,9 @@
 #define PROFILER_HPP
 
 #include <irrlicht.h>
-#include <list>
+#include <atomic>
+#include <map>
+#include <pthread.h>
 #include <vector>
 #include <stack>
 #include <string>
@@ -27,6 +29,8 @@
 #include <ostream>
 #include <iostream>
 
+#include "utils/types.hpp"
+
 
 enum QueryPerf
 {
@@ -64,6 +68,7 @@ class Profiler;
 extern Profiler profiler;
 
 double getTimeMilliseconds();
+const char* getGPUPhaseName(unsigned phase);
 
 #define ENABLE_PROFILER
 
@@ -79,11 +84,31 @@ double getTimeMilliseconds();
 
     #define PROFILER_DRAW() \
         profiler.draw()
+
+    /** Adds n to the counter with the given (static) name. Counters are
+     *  reset each frame. */
+    #define PROFILER_COUNT(name, n)                                     \
+        do {                                                            \
+            static const unsigned int counter_id =                      \
+                profiler.registerCounter(name, /*is_gauge*/false);      \
+            profiler.addToCounter(counter_id, n);                       \
+        } while(0)
+
+    /** Sets the gauge with the given (static) name. Gauges keep their
+     *  value between frames. */
+    #define PROFILER_SET_GAUGE(name, value)                             \
+        do {                                                            \
+            static const unsigned int counter_id =                      \
+                profiler.registerCounter(name, /*is_gauge*/true);       \
+            profiler.setGauge(counter_id, value);                       \
+        } while(0)
 #else
     #define PROFILER_PUSH_CPU_MARKER(name, r, g, b)
     #define PROFILER_POP_CPU_MARKER()
     #define PROFILER_SYNC_FRAME()
     #define PROFILER_DRAW()
+    #define PROFILER_COUNT(name, n)
+    #define PROFILER_SET_GAUGE(name, value)
 #endif
 
 using namespace irr;
@@ -126,44 +151,64 @@ public:
 
 /**
   * \brief class that allows run-time graphical profiling through the use of markers
+  * Each thread writes its markers into fixed size buffers of its own, so
+  * that pushing and popping a marker neither locks nor allocates. Captured
+  * reports are also written as a Chrome trace with the markers of all
+  * threads.
   * \ingroup utils
   */
 class Profiler
 {
 private:
+    /** A marker, the name must be a static string. */
     struct Marker
     {
-        double  start;  // Times of start and end, in milliseconds,
-        double  end;    // relatively to the time of last synchronization
-        size_t  layer;
-
-        std::string     name;
+        /** Times of start and end, in milliseconds. */
+        double          start;
+        double          end;
+        const char     *name;
+        unsigned int    layer;
         video::SColor   color;
-
-        Marker(double start, double end, const char* name="N/A", const video::SColor& color=video::SColor(), size_t layer=0)
-            : start(start), end(end), layer(layer), name(name), color(color)
-        {
-        }
-
-        Marker(const Marker& ref)
-            : start(ref.start), end(ref.end), layer(ref.layer), name(ref.name), color(ref.color)
-        {
-        }
     };
 
-    typedef    std::list<Marker>   MarkerList;
-    typedef    std::stack<Marker>  MarkerStack;
-
+    /** Maximum number of nested markers of a thread. */
+    static const unsigned int MAX_DEPTH   = 32;
+    /** Maximum number of markers per thread and frame, further markers are
+     *  dropped. */
+    static const unsigned int MAX_MARKERS = 2048;
+    /** Maximum number of threads that use markers at the same time. */
+    static const unsigned int MAX_THREADS = 32;
+
+    /** The markers of a thread. Only the thread itself writes to it. The
+     *  finished markers are double buffered like the frames, the buffer
+     *  of the previous frame is read by the main thread. */
     struct ThreadInfo
     {
-        MarkerList   markers_done[2];
-        MarkerStack  markers_stack[2];
+        Marker        markers_stack[MAX_DEPTH];
+        unsigned int  depth;
+        Marker        markers_done[2][MAX_MARKERS];
+        std::atomic<unsigned int> num_markers_done[2];
+        /** False if the thread exited, so that the info can be reused. */
+        std::atomic<bool> in_use;
+    };
+
+    /** A finished marker of a captured report, for the trace export. */
+    struct TraceEvent
+    {
+        double        start;
+        double        end;
+        const char   *name;
+        unsigned int  thread;
     };
 
-    typedef    std::vector<ThreadInfo>  ThreadInfoList;
+    std::atomic<ThreadInfo*>   m_thread_infos[MAX_THREADS];
+    std::atomic<unsigned int>  m_num_thread_infos;
+    /** Stores the ThreadInfo of each thread. */
+    pthread_key_t   m_thread_key;
 
-    ThreadInfoList  m_thread_infos;
-    int             m_write_id;
+    std::atomic<int> m_write_id;
+    /** Time of the synchronization each buffer of markers started at. */
+    double          m_frame_start[2];
     double          m_time_last_sync;
     double          m_time_between_sync;
 
@@ -183,6 +228,65 @@ private:
     bool m_first_gpu_capture_sweep;
     StringBuffer* m_capture_report_buffer;
     StringBuffer* m_gpu_capture_report_buffer;
+    std::vector<TraceEvent> m_trace_events;
+
+    /** The values of the last frames, to compute percentiles. */
+    class History
+    {
+    private:
+        std::vector<double> m_values;
+        unsigned int        m_next;
+    public:
+        /** Number of frames that are kept. */
+        static const unsigned int SIZE = 256;
+        History() : m_next(0) {}
+        void   add(double value);
+        double getPercentile(float fraction) const;
+        /** Returns the value of the last frame. */
+        double getLast() const
+        {
+            if (m_values.empty()) return 0.0;
+            return m_values[(m_next + SIZE - 1) % SIZE];
+        }
+    };   // History
+
+    /** A counter (summed over a frame) or gauge (last value set). */
+    struct Counter
+    {
+        const char          *name;
+        bool                 is_gauge;
+        std::atomic<int64_t> value;
+        History              history;
+    };
+
+    /** Maximum number of counters and gauges. */
+    static const unsigned int MAX_COUNTERS = 64;
+    Counter                   m_counters[MAX_COUNTERS];
+    std::atomic<unsigned int> m_num_counters;
+    /** Protects the registration of counters. */
+    pthread_mutex_t           m_counters_mutex;
+    /** Frame times in milliseconds. */
+    History                   m_frame_times;
+    /** Time the counters were last written to a file. */
+    double                    m_time_last_counter_dump;
+
+public:
+    /** Accumulated time of all markers with the same name. */
+    struct MarkerTotal
+    {
+        /** Total time in milliseconds. */
+        double       m_time;
+        /** Number of times the marker was popped. */
+        unsigned int m_count;
+        MarkerTotal() : m_time(0.0), m_count(0) {}
+    };
+    typedef std::map<std::string, MarkerTotal> MarkerTotals;
+
+private:
+    /** If set, the time of each popped marker is added to m_marker_totals.
+     *  Used by the benchmark mode of ProfileWorld. */
+    bool         m_accumulate_totals;
+    MarkerTotals m_marker_totals;
 
 public:
     Profiler();
@@ -201,12 +305,44 @@ public:
 
     bool isFrozen() const { return m_freeze_state == FROZEN; }
 
+    void setAccumulateTotals(bool accumulate);
+    /** Returns the accumulated times of all markers by name. */
+    const MarkerTotals& getMarkerTotals() const { return m_marker_totals; }
+
+    unsigned int registerCounter(const char *name, bool is_gauge);
+    // ------------------------------------------------------------------------
+    /** Adds a value to a counter returned by registerCounter. Can be called
+     *  from any thread. */
+    void addToCounter(unsigned int id, int64_t n)
+    {
+        if (id < MAX_COUNTERS)
+            m_counters[id].value.fetch_add(n, std::memory_order_relaxed);
+    }   // addToCounter
+    // ------------------------------------------------------------------------
+    /** Sets the value of a gauge returned by registerCounter. */
+    void setGauge(unsigned int id, int64_t value)
+    {
+        if (id < MAX_COUNTERS)
+            m_counters[id].value.store(value, std::memory_order_relaxed);
+    }   // setGauge
+
 protected:
-    // TODO: detect on which thread this is called to support multithreading
-    ThreadInfo& getThreadInfo() { return m_thread_infos[0]; }
+    ThreadInfo* getThreadInfo();
+    // ------------------------------------------------------------------------
+    /** Returns the number of used slots in m_thread_infos. */
+    unsigned int getNumThreadInfos() const
+    {
+        const unsigned int n = m_num_thread_infos.load();
+        return n < MAX_THREADS ? n : MAX_THREADS;
+    }
+    // ------------------------------------------------------------------------
+    ThreadInfo* registerThread();
+    static void releaseThread(void *info);
+    void        writeTrace(const std::string &filename) const;
+    void        updateCounters();
+    void        writeCounters(std::ostream &out) const;
     void        drawBackground();
 
-
 };
 
 #endif // PROFILER_HPP
@@ -22,6 +22,7 @@
 
 #include "utils/log.hpp"
 #include "utils/time.hpp"
+#include "utils/types.hpp"
 #include "utils/utf8.h"
 #include "coreutil.h"
 
@@ -34,6 +35,25 @@
 
 namespace StringUtils
 {
+    /** Returns the number of leading ASCII characters of a string, testing
+     *  eight bytes at a time.
+     */
+    static size_t asciiPrefixLength(const char *s, size_t length)
+    {
+        size_t n = 0;
+        for (; n + 8 <= length; n += 8)
+        {
+            uint64_t word;
+            memcpy(&word, s + n, 8);
+            if (word & 0x8080808080808080ULL)
+                break;
+        }
+        while (n < length && (unsigned char)s[n] < 0x80)
+            n++;
+        return n;
+    }   // asciiPrefixLength
+
+    // ------------------------------------------------------------------------
     bool hasSuffix(const std::string& lhs, const std::string &rhs)
     {
         if (lhs.length() < rhs.length())
@@ -147,8 +167,14 @@ namespace StringUtils
      */
     std::string toLowerCase(const std::string& str)
     {
+        // Only ASCII letters are converted: ::tolower is slow, and depending
+        // on the locale it could change the bytes of UTF-8 characters.
         std::string name = str;
-        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        for (size_t i = 0; i < name.size(); i++)
+        {
+            if (name[i] >= 'A' && name[i] <= 'Z')
+                name[i] += 'a' - 'A';
+        }
         return name;
     }   // toLowerCase
 
@@ -581,6 +607,7 @@ namespace StringUtils
     irr::core::stringw xmlDecode(const std::string& input)
     {
         irr::core::stringw output;
+        output.reserve((irr::u32)input.size() + 1);
         std::string entity;
         bool isHex = false;
 
@@ -668,47 +695,85 @@ namespace StringUtils
      */
     std::string xmlEncode(const irr::core::stringw &s)
     {
-        std::ostringstream output;
+        std::string output;
+        output.reserve(s.size());
         for(unsigned int i=0; i<s.size(); i++)
         {
             if (s[i] >= 128 || s[i] == '&' || s[i] == '<' || s[i] == '>' || s[i] == '\"')
             {
-                output << "&#x" << std::hex << std::uppercase << s[i] << ";";
+                char entity[16];
+                snprintf(entity, sizeof(entity), "&#x%X;",
+                         (unsigned int)s[i]);
+                output += entity;
             }
             else
             {
-                irr::c8 c = (char)(s[i]);
-                output << c;
+                output += (char)(s[i]);
             }
         }
-        return output.str();
+        return output;
     }   // xmlEncode
 
     // ------------------------------------------------------------------------
 
     std::string wide_to_utf8(const wchar_t* input)
     {
-        static std::vector<char> utf8line;
-        utf8line.clear();
-
-        utf8::utf16to8(input, input + wcslen(input), back_inserter(utf8line));
-        utf8line.push_back(0);
+        std::string output;
+        wide_to_utf8(input, &output);
+        return output;
+    }   // wide_to_utf8
 
-        return std::string(&utf8line[0]);
-    }
+    // ------------------------------------------------------------------------
+    /** Converts a wide string to UTF-8 into an existing string, reusing its
+     *  memory. ASCII characters are copied directly, everything from the
+     *  first other character on is encoded by utf8::utf16to8.
+     */
+    void wide_to_utf8(const wchar_t* input, std::string* output)
+    {
+        const size_t length = wcslen(input);
+        output->resize(length);
+        size_t n = 0;
+        while (n < length && (unsigned int)input[n] < 0x80)
+        {
+            (*output)[n] = (char)input[n];
+            n++;
+        }
+        if (n == length)
+            return;
+        output->resize(n);
+        utf8::utf16to8(input + n, input + length, back_inserter(*output));
+    }   // wide_to_utf8
 
     // ------------------------------------------------------------------------
 
     irr::core::stringw utf8_to_wide(const char* input)
     {
-        static std::vector<wchar_t> utf16line;
-        utf16line.clear();
+        std::vector<wchar_t> wide;
+        utf8_to_wide(input, &wide);
+        return irr::core::stringw(&wide[0], (irr::u32)wide.size() - 1);
+    }   // utf8_to_wide
 
-        utf8::utf8to16(input, input + strlen(input), back_inserter(utf16line));
-        utf16line.push_back(0);
-
-        return irr::core::stringw(&utf16line[0]);
-    }
+    // ------------------------------------------------------------------------
+    /** Converts an UTF-8 string into a 0 terminated wide string in an
+     *  existing vector, reusing its memory. The ASCII prefix is tested eight
+     *  bytes at a time and copied directly, the rest is decoded by
+     *  utf8::utf8to16.
+     */
+    void utf8_to_wide(const char* input, std::vector<wchar_t>* output)
+    {
+        const size_t length = strlen(input);
+        const size_t ascii = asciiPrefixLength(input, length);
+        // No character needs more wide characters than it has UTF-8 bytes
+        output->resize(length + 1);
+        wchar_t *out = output->empty() ? NULL : &(*output)[0];
+        for (size_t i = 0; i < ascii; i++)
+            out[i] = (wchar_t)input[i];
+        wchar_t *end = out + ascii;
+        if (ascii < length)
+            end = utf8::utf8to16(input + ascii, input + length, end);
+        *end = 0;
+        output->resize(end - out + 1);
+    }   // utf8_to_wide
 
     // ------------------------------------------------------------------------
     /** Converts a version string (in the form of 'X.Y.Za-rcU' into an
@@ -366,7 +366,9 @@ namespace StringUtils
     // ------------------------------------------------------------------------
     
     std::string wide_to_utf8(const wchar_t* input);
+    void wide_to_utf8(const wchar_t* input, std::string* output);
     irr::core::stringw utf8_to_wide(const char* input);
+    void utf8_to_wide(const char* input, std::vector<wchar_t>* output);
 
 } // namespace StringUtils
 
@@ -173,6 +173,8 @@ wchar_t* fromFribidiChar(const FriBidiChar* str)
 // ----------------------------------------------------------------------------
 Translations::Translations() //: m_dictionary_manager("UTF-16")
 {
+    m_dictionary_manager.set_cache_directory(
+                                  file_manager->getCachedTranslationsDir());
     m_dictionary_manager.add_directory(
                         file_manager->getAsset(FileManager::TRANSLATION,""));
                         
@@ -442,28 +444,31 @@ const wchar_t* Translations::w_gettext(const char* original, const char* context
     Log::info("Translations", "Translating %s", original);
 #endif
 
-    const std::string& original_t = (context == NULL ?
-                                     m_dictionary.translate(original) :
-                                     m_dictionary.translate_ctxt(context, original));
-
-    if (original_t == original)
+    // Same key as the one gettext uses for messages with a context
+    std::string key;
+    if (context != NULL)
     {
-        m_converted_string = StringUtils::utf8_to_wide(original);
-
-#if TRANSLATE_VERBOSE
-        std::wcout << L"  translation : " << m_converted_string << std::endl;
-#endif
-        return m_converted_string.c_str();
+        key = context;
+        key += '\004';
+    }
+    key += original;
+
+    MutexLocker(m_w_gettext_cache);
+    std::unordered_map<std::string, core::stringw> &cache =
+                                                 m_w_gettext_cache.getData();
+    std::unordered_map<std::string, core::stringw>::iterator it =
+                                                           cache.find(key);
+    if (it == cache.end())
+    {
+        const std::string& original_t = (context == NULL ?
+                                    m_dictionary.translate(original) :
+                                    m_dictionary.translate_ctxt(context, original));
+        it = cache.insert(std::make_pair(key,
+                   StringUtils::utf8_to_wide(original_t.c_str()))).first;
     }
 
-    // print
-    //for (int n=0;; n+=4)
-
-    static core::stringw original_tw;
-    original_tw = StringUtils::utf8_to_wide(original_t.c_str());
-
-    const wchar_t* out_ptr = original_tw.c_str();
-    if (REMOVE_BOM) out_ptr++;
+    const wchar_t* out_ptr = it->second.c_str();
+    if (REMOVE_BOM && it->second.size() > 0) out_ptr++;
 
 #if TRANSLATE_VERBOSE
     std::wcout << L"  translation : " << out_ptr << std::endl;
@@ -22,7 +22,9 @@
 #include <irrString.h>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include "utils/string_utils.hpp"
+#include "utils/synchronised.hpp"
 
 #  include "tinygettext/tinygettext.hpp"
 
@@ -49,6 +51,12 @@ private:
     irr::core::stringw m_converted_string;
     bool m_rtl;
 
+    /** The wide strings returned by w_gettext, indexed by context and
+     *  message. Strings are never removed, so the returned pointers stay
+     *  valid for the lifetime of this object. */
+    Synchronised<std::unordered_map<std::string, irr::core::stringw> >
+                       m_w_gettext_cache;
+
     std::string m_current_language_name;
 
 public:
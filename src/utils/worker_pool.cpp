@@ -0,0 +1,207 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/worker_pool.hpp"
+
+#include "config/hardware_stats.hpp"
+#include "config/user_config.hpp"
+#include "utils/log.hpp"
+#include "utils/profiler.hpp"
+
+WorkerPool *WorkerPool::m_worker_pool = NULL;
+
+// ----------------------------------------------------------------------------
+/** Creates the worker pool. The number of threads is taken from
+ *  UserConfigParams::m_worker_threads, or the number of processors if that
+ *  is not positive.
+ */
+void WorkerPool::create()
+{
+    assert(!m_worker_pool);
+    int n = UserConfigParams::m_worker_threads;
+    if (n <= 0)
+        n = HardwareStats::getNumProcessors();
+    if (n < 1)
+        n = 1;
+    // Limit the number of threads, the jobs are fairly small
+    if (n > 16)
+        n = 16;
+    m_worker_pool = new WorkerPool(n - 1);
+}   // create
+
+// ----------------------------------------------------------------------------
+void WorkerPool::destroy()
+{
+    delete m_worker_pool;
+    m_worker_pool = NULL;
+}   // destroy
+
+// ----------------------------------------------------------------------------
+/** Starts the worker threads.
+ *  \param num_threads Number of threads in addition to the main thread.
+ */
+WorkerPool::WorkerPool(unsigned int num_threads)
+{
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_start_cond, NULL);
+    pthread_cond_init(&m_done_cond, NULL);
+    m_generation     = 0;
+    m_abort          = false;
+    m_active_workers = 0;
+    m_job            = NULL;
+    m_name           = NULL;
+    m_count          = 0;
+    m_chunk_size     = 1;
+    m_next.store(0);
+    m_busy.store(false);
+
+    for (unsigned int i = 0; i < num_threads; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, &WorkerPool::mainLoop, this) != 0)
+        {
+            Log::warn("WorkerPool", "Could only create %d worker threads.",
+                      i);
+            break;
+        }
+        m_threads.push_back(thread);
+    }
+    Log::info("WorkerPool", "Using %d threads for parallel updates.",
+              getNumThreads());
+}   // WorkerPool
+
+// ----------------------------------------------------------------------------
+WorkerPool::~WorkerPool()
+{
+    pthread_mutex_lock(&m_mutex);
+    m_abort = true;
+    pthread_cond_broadcast(&m_start_cond);
+    pthread_mutex_unlock(&m_mutex);
+    for (unsigned int i = 0; i < m_threads.size(); i++)
+        pthread_join(m_threads[i], NULL);
+    pthread_cond_destroy(&m_done_cond);
+    pthread_cond_destroy(&m_start_cond);
+    pthread_mutex_destroy(&m_mutex);
+}   // ~WorkerPool
+
+// ----------------------------------------------------------------------------
+/** The main loop of a worker thread: waits for a job and executes chunks
+ *  of it until all items are handed out.
+ */
+void *WorkerPool::mainLoop(void *obj)
+{
+    WorkerPool *pool = (WorkerPool*)obj;
+    pthread_mutex_lock(&pool->m_mutex);
+    unsigned int generation = pool->m_generation;
+    while (true)
+    {
+        while (!pool->m_abort && pool->m_generation == generation)
+            pthread_cond_wait(&pool->m_start_cond, &pool->m_mutex);
+        if (pool->m_abort)
+            break;
+        generation = pool->m_generation;
+        pthread_mutex_unlock(&pool->m_mutex);
+
+        pool->runChunks();
+
+        pthread_mutex_lock(&pool->m_mutex);
+        pool->m_active_workers--;
+        if (pool->m_active_workers == 0)
+            pthread_cond_signal(&pool->m_done_cond);
+    }
+    pthread_mutex_unlock(&pool->m_mutex);
+    return NULL;
+}   // mainLoop
+
+// ----------------------------------------------------------------------------
+/** Executes chunks of the current job until all items are handed out. If
+ *  the job has a name, a profiler marker is shown while this thread works
+ *  on it (but not if all chunks were taken by other threads).
+ */
+void WorkerPool::runChunks()
+{
+    bool marker = false;
+    while (true)
+    {
+        unsigned int first = m_next.fetch_add(m_chunk_size);
+        if (first >= m_count)
+            break;
+        if (m_name && !marker)
+        {
+            PROFILER_PUSH_CPU_MARKER(m_name, 0x40, 0x40, 0xFF);
+            marker = true;
+        }
+        unsigned int last = first + m_chunk_size;
+        if (last > m_count)
+            last = m_count;
+        (*m_job)(first, last);
+    }
+    if (marker)
+        PROFILER_POP_CPU_MARKER();
+}   // runChunks
+
+// ----------------------------------------------------------------------------
+/** Calls job for all items from 0 to count-1, in chunks of chunk_size
+ *  items, using all threads of the pool. Returns when all items are done.
+ *  \param count Number of items.
+ *  \param chunk_size Number of items handed to a thread at a time.
+ *  \param job The function processing a range of items. It must be safe
+ *         to execute it for different ranges in parallel.
+ *  \param name If not NULL, the profiler marker shown by each thread
+ *         working on the job. Must stay valid during the call.
+ */
+void WorkerPool::parallelFor(unsigned int count, unsigned int chunk_size,
+                             const Job &job, const char *name)
+{
+    if (count == 0)
+        return;
+    if (chunk_size == 0)
+        chunk_size = 1;
+    bool expected = false;
+    if (m_threads.empty() || count <= chunk_size ||
+        !m_busy.compare_exchange_strong(expected, true))
+    {
+        if (name)
+            PROFILER_PUSH_CPU_MARKER(name, 0x40, 0x40, 0xFF);
+        job(0, count);
+        if (name)
+            PROFILER_POP_CPU_MARKER();
+        return;
+    }
+
+    pthread_mutex_lock(&m_mutex);
+    m_job        = &job;
+    m_name       = name;
+    m_count      = count;
+    m_chunk_size = chunk_size;
+    m_next.store(0);
+    m_active_workers = (unsigned int)m_threads.size();
+    m_generation++;
+    pthread_cond_broadcast(&m_start_cond);
+    pthread_mutex_unlock(&m_mutex);
+
+    runChunks();
+
+    pthread_mutex_lock(&m_mutex);
+    while (m_active_workers > 0)
+        pthread_cond_wait(&m_done_cond, &m_mutex);
+    m_job  = NULL;
+    m_name = NULL;
+    pthread_mutex_unlock(&m_mutex);
+    m_busy.store(false);
+}   // parallelFor
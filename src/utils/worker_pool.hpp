@@ -0,0 +1,106 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2015 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_WORKER_POOL_HPP
+#define HEADER_WORKER_POOL_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <assert.h>
+#include <atomic>
+#include <functional>
+#include <pthread.h>
+#include <vector>
+
+/** A pool of worker threads which execute loops in parallel. The thread
+ *  calling parallelFor takes part in the work. The items are handed out in
+ *  chunks from a shared counter, so a thread that finishes its chunks early
+ *  takes over the remaining chunks (which balances the load like work
+ *  stealing, but without per thread queues).
+ *  A parallelFor called while another one is running (e.g. from inside a
+ *  job or from another thread) is executed serially by the calling thread.
+ *  A job can be given a name, which each thread working on it shows as a
+ *  profiler marker.
+ *  \ingroup utils
+ */
+class WorkerPool : public NoCopy
+{
+public:
+    /** A job processes the items first to last-1. */
+    typedef std::function<void(unsigned int first, unsigned int last)> Job;
+
+private:
+    static WorkerPool *m_worker_pool;
+
+    std::vector<pthread_t> m_threads;
+
+    /** Protects m_generation, m_abort and m_active_workers. */
+    pthread_mutex_t m_mutex;
+    /** Signalled when a new job is available or the pool is destroyed. */
+    pthread_cond_t  m_start_cond;
+    /** Signalled when the last worker finished the current job. */
+    pthread_cond_t  m_done_cond;
+
+    /** Increased for each job, so that the workers know about a new job. */
+    unsigned int    m_generation;
+    bool            m_abort;
+    /** Number of workers still working on the current job. */
+    unsigned int    m_active_workers;
+
+    /** The current job, the number of its items and the chunk size. */
+    const Job      *m_job;
+    /** Profiler marker name of the current job, or NULL. */
+    const char     *m_name;
+    unsigned int    m_count;
+    unsigned int    m_chunk_size;
+    /** The first item not yet handed out. */
+    std::atomic<unsigned int> m_next;
+    /** True while a job is executed. */
+    std::atomic<bool> m_busy;
+
+                 WorkerPool(unsigned int num_threads);
+                ~WorkerPool();
+    static void *mainLoop(void *obj);
+    void         runChunks();
+
+public:
+    static void create();
+    static void destroy();
+    // ------------------------------------------------------------------------
+    /** Returns true if the worker pool was created. */
+    static bool exists() { return m_worker_pool != NULL; }
+    // ------------------------------------------------------------------------
+    /** Returns the worker pool. */
+    static WorkerPool *get()
+    {
+        assert(m_worker_pool);
+        return m_worker_pool;
+    }   // get
+    // ------------------------------------------------------------------------
+    void parallelFor(unsigned int count, unsigned int chunk_size,
+                     const Job &job, const char *name = NULL);
+    // ------------------------------------------------------------------------
+    /** Returns the number of threads working on a job, including the
+     *  calling thread. */
+    unsigned int getNumThreads() const
+    {
+        return (unsigned int)m_threads.size() + 1;
+    }   // getNumThreads
+};   // WorkerPool
+
+#endif
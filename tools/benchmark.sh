@@ -0,0 +1,52 @@
+#!/bin/bash
+#
+# Runs the AI benchmark (see --benchmark in supertuxkart --help) for all
+# combinations of tracks and kart counts, and compares each run with the
+# report of the same combination in a baseline directory (if given).
+#
+# Usage: benchmark.sh path/to/supertuxkart output_dir [baseline_dir]
+#
+# The tracks, kart counts, laps, seed and the allowed regression (in
+# percent) can be changed with the environment variables TRACKS, KARTS,
+# LAPS, SEED and THRESHOLD. The exit code is 1 if any run regressed.
+
+stk=$1
+out=$2
+baseline=$3
+
+if [ -z "$stk" ] || [ -z "$out" ]; then
+    echo "Usage: $0 path/to/supertuxkart output_dir [baseline_dir]"
+    exit 2
+fi
+
+tracks=${TRACKS:-"lighthouse sandtrack snowmountain hacienda"}
+karts=${KARTS:-"4 8 16"}
+laps=${LAPS:-2}
+seed=${SEED:-1}
+threshold=${THRESHOLD:-10}
+
+mkdir -p "$out"
+result=0
+
+for track in $tracks; do
+    for num_karts in $karts; do
+        name=$track.$num_karts.json
+        args="--no-graphics --track=$track --numkarts=$num_karts \
+              --profile-laps=$laps --benchmark=$out/$name \
+              --benchmark-seed=$seed"
+        if [ -n "$baseline" ]; then
+            if [ -f "$baseline/$name" ]; then
+                args="$args --benchmark-baseline=$baseline/$name \
+                      --benchmark-threshold=$threshold"
+            else
+                echo "No baseline for $name."
+            fi
+        fi
+        if ! "$stk" $args > /dev/null; then
+            echo "Regression: $track with $num_karts karts."
+            result=1
+        fi
+    done
+done
+
+exit $result
@@ -2,6 +2,8 @@
 #include "IXMLWriter.h"
 #include <iostream>
 #include <fstream>
+#include <math.h>
+#include <vector>
 
 using namespace irr;
 
@@ -100,7 +102,7 @@ bool setUsedCharacters(const char* characters)
 	//
 
 	CFontTool::CFontTool(IrrlichtDevice* device) : FontSizes(fontsizes),
-			Device(device), UseAlphaChannel(false),
+			Device(device), UseAlphaChannel(false), DistanceFieldSpread(0),
 			// win specific
 			dc(0)
 	{
@@ -137,6 +139,7 @@ bool setUsedCharacters(const char* characters)
 			return false;
 
 		UseAlphaChannel = alpha;
+		DistanceFieldSpread = 0;
 		u32 currentImage = 0;
 
 		// create the font
@@ -460,7 +463,7 @@ bool setUsedCharacters(const char* characters)
 
 #else
 
-	CFontTool::CFontTool(IrrlichtDevice *device) : FontSizes(fontsizes), Device(device), UseAlphaChannel(false)
+	CFontTool::CFontTool(IrrlichtDevice *device) : FontSizes(fontsizes), Device(device), UseAlphaChannel(false), DistanceFieldSpread(0)
 	{
 		if (!XftInitFtLibrary())
 		{
@@ -531,6 +534,7 @@ bool setUsedCharacters(const char* characters)
 		Window win = RootWindow(display, screen);
 		Visual *visual = DefaultVisual(display, screen);
 		UseAlphaChannel = alpha;
+		DistanceFieldSpread = 0;
 		u32 currentImage = 0;
 
 		XftResult result;
@@ -736,6 +740,74 @@ bool setUsedCharacters(const char* characters)
 	}
 #endif
 
+	//! Replaces the alpha channel of the images with a signed distance field,
+	//! so that the font can be drawn at any scale with sharp edges. The
+	//! distance is computed separately for each character, within its area,
+	//! and stored as 0.5 + distance / (2 * spread), positive inside. The
+	//! images must have been created with an alpha channel.
+	bool CFontTool::makeDistanceField(u32 spread)
+	{
+		if (!UseAlphaChannel || DistanceFieldSpread != 0 || spread == 0)
+			return false;
+
+		for (u32 image = 0; image < currentImages.size(); ++image)
+		{
+			video::IImage *img = currentImages[image];
+			const core::dimension2du size = img->getDimension();
+
+			// Copy the coverage first, since the image is overwritten
+			std::vector<bool> inside(size.Width * size.Height, false);
+			for (u32 y = 0; y < size.Height; ++y)
+				for (u32 x = 0; x < size.Width; ++x)
+					inside[y * size.Width + x] = img->getPixel(x, y).getAlpha() >= 128;
+			img->fill(video::SColor(0, 255, 255, 255));
+
+			for (u32 a = 0; a < Areas.size(); ++a)
+			{
+				if (Areas[a].sourceimage != image)
+					continue;
+				core::rect<s32> r = Areas[a].rectangle;
+				r.clipAgainst(core::rect<s32>(0, 0, size.Width, size.Height));
+				for (s32 y = r.UpperLeftCorner.Y; y < r.LowerRightCorner.Y; ++y)
+				{
+					for (s32 x = r.UpperLeftCorner.X; x < r.LowerRightCorner.X; ++x)
+					{
+						const bool in = inside[y * size.Width + x];
+						// Search the closest pixel on the other side of the edge
+						s32 best = spread * spread;
+						const s32 s = (s32)spread;
+						for (s32 dy = -s; dy <= s; ++dy)
+						{
+							const s32 sy = y + dy;
+							if (sy < r.UpperLeftCorner.Y || sy >= r.LowerRightCorner.Y)
+								continue;
+							for (s32 dx = -s; dx <= s; ++dx)
+							{
+								const s32 sx = x + dx;
+								if (sx < r.UpperLeftCorner.X || sx >= r.LowerRightCorner.X)
+									continue;
+								if (inside[sy * size.Width + sx] != in && dx * dx + dy * dy < best)
+									best = dx * dx + dy * dy;
+							}
+						}
+						// The edge is half way between the two pixel centers
+						f32 distance = core::min_(sqrtf((f32)best) - 0.5f, (f32)spread);
+						if (!in)
+							distance = -distance;
+						const f32 value = core::clamp(0.5f + distance / (2.0f * spread), 0.0f, 1.0f);
+						img->setPixel(x, y, video::SColor((u32)(value * 255.0f + 0.5f), 255, 255, 255));
+					}
+				}
+			}
+
+			currentTextures[image]->drop();
+			currentTextures[image] = Device->getVideoDriver()->addTexture("GUIFontImage", img);
+			currentTextures[image]->grab();
+		}
+		DistanceFieldSpread = spread;
+		return true;
+	}
+
 	CFontTool::~CFontTool()
 	{
 #ifdef _IRR_WINDOWS_
@@ -788,10 +860,17 @@ bool CFontTool::saveBitmapFont(const c8 *filename, const c8* format)
 		imagename += format;
 		Device->getVideoDriver()->writeImageToFile(currentImages[i],imagename.c_str());
 
-		writer->writeElement(L"Texture", true,
-				L"index", core::stringw(i+offset_for_asian_fonts).c_str(),
-				L"filename", core::stringw(imagename.c_str()).c_str(),
-				L"hasAlpha", UseAlphaChannel ? L"true" : L"false");
+		if (DistanceFieldSpread > 0)
+			writer->writeElement(L"Texture", true,
+					L"index", core::stringw(i+offset_for_asian_fonts).c_str(),
+					L"filename", core::stringw(imagename.c_str()).c_str(),
+					L"hasAlpha", L"true",
+					L"distanceField", core::stringw(DistanceFieldSpread).c_str());
+		else
+			writer->writeElement(L"Texture", true,
+					L"index", core::stringw(i+offset_for_asian_fonts).c_str(),
+					L"filename", core::stringw(imagename.c_str()).c_str(),
+					L"hasAlpha", UseAlphaChannel ? L"true" : L"false");
 		writer->writeLineBreak();
 	}
 
@@ -35,6 +35,8 @@ namespace irr {
 				bool bold, bool italic, bool aa, bool alpha,
 				bool usedOnly=false,bool exclideLatin=false);
 
+		virtual bool makeDistanceField(u32 spread);
+
 		virtual bool saveBitmapFont(const c8* filename, const c8* format);
 
 		virtual void selectCharSet(u32 currentCharSet);
@@ -69,6 +71,10 @@ namespace irr {
 
 		bool UseAlphaChannel;
 
+		//! Distance in pixels covered by the distance field, 0 if the
+		//! images are plain bitmaps
+		u32 DistanceFieldSpread;
+
 		// windows
 		#ifdef _IRR_WINDOWS_
 		HDC dc;
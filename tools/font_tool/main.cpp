@@ -93,6 +93,9 @@ const wchar_t *helptext = L"This tool creates bitmap fonts for the Irrlicht Engi
 							L"will any fonts you create with FontTool";
 #endif
 
+// Distance in pixels covered by distance field fonts
+const u32 DISTANCE_FIELD_SPREAD = 4;
+
 enum MYGUI
 {
 	MYGUI_CHARSET  = 100,
@@ -241,11 +244,19 @@ public:
 					chk = (IGUICheckBox*)env->getRootGUIElement()->getElementFromId(202,true);
 					bool excludeLatin = chk->isChecked();
 
+					// distance fields are stored in the alpha channel
+					chk = (IGUICheckBox*)env->getRootGUIElement()->getElementFromId(203,true);
+					bool distanceField = chk->isChecked();
+					if (distanceField)
+						alpha = true;
+
 					// vector fonts disabled
 					//chk = (IGUICheckBox*)env->getRootGUIElement()->getElementFromId(MYGUI_VECTOR,true);
 					bool vec = false;//chk->isChecked();
 
 					FontTool->makeBitmapFont(fontname, charset, /*FontTool->FontSizes[fontsize]*/ fontsize, texturesizes[texwidth], texturesizes[texheight], bold, italic, aa, alpha, usedOnly, excludeLatin);
+					if (distanceField)
+						FontTool->makeDistanceField(DISTANCE_FIELD_SPREAD);
 
 					IGUIScrollBar* scrl = (IGUIScrollBar*)env->getRootGUIElement()->getElementFromId(MYGUI_CURRENTIMAGE,true);
 					scrl->setMax(FontTool->currentTextures.size() == 0 ? 0 : FontTool->currentTextures.size()-1);
@@ -434,6 +445,9 @@ void createGUI(IrrlichtDevice* device, CFontTool* fc)
 	env->addCheckBox(false, core::rect<s32>(xp,yp,int(scale*(xp+200)),yp+h),win, 202, L"Exclude basic latin");
 	yp += (s32)(h*1.5f);
 
+	env->addCheckBox(false, core::rect<s32>(xp,yp,int(scale*(xp+200)),yp+h),win, 203, L"Distance field");
+	yp += (s32)(h*1.5f);
+
 	/*
 	// vector fonts can't be loaded yet
 	env->addCheckBox(false, core::rect<s32>(xp,yp,xp+200,yp+h),win, MYGUI_VECTOR, L"Vector Font");
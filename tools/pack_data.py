@@ -0,0 +1,79 @@
+#!/usr/bin/env python
+#
+# (C) 2015 SuperTuxKart-Team, under the GPLv3
+#
+# Packs the assets of a data directory into one .stkpack file, which STK
+# mounts at startup in place of the loose files (see src/io/packed_archive.hpp).
+# Run it when making a release, after optimize_data.sh; the packed files can
+# then be removed from the installed data directory.
+#
+# Usage: pack_data.py [-z] <data directory> [output file]
+#   -z  compress files with zlib if it makes them at least 10% smaller
+#
+# Only files read through the irrlicht file system (textures, models and xml
+# files) are packed. stk_config.xml stays a loose file, it is used to find
+# the data directory.
+
+import os
+import struct
+import sys
+import zlib
+
+EXTENSIONS = (".png", ".jpg", ".jpeg", ".b3d", ".b3dz", ".spm", ".xml")
+EXCLUDED   = ("stk_config.xml",)
+# Already compressed formats, not worth compressing again
+COMPRESSED = (".png", ".jpg", ".jpeg", ".b3dz")
+ALIGNMENT  = 16
+HEADER     = struct.Struct("<4sIIIQQ")
+
+def collect(data_dir):
+    names = []
+    for root, dirs, files in os.walk(data_dir):
+        dirs.sort()
+        for f in sorted(files):
+            path = os.path.join(root, f)
+            name = os.path.relpath(path, data_dir).replace(os.sep, "/")
+            if name in EXCLUDED or not f.lower().endswith(EXTENSIONS):
+                continue
+            names.append(name)
+    return names
+
+def main():
+    args = sys.argv[1:]
+    compress = "-z" in args
+    args = [a for a in args if a != "-z"]
+    if len(args) < 1 or len(args) > 2:
+        print("Usage: pack_data.py [-z] <data directory> [output file]")
+        sys.exit(1)
+    data_dir = args[0]
+    output = args[1] if len(args) > 1 else os.path.join(data_dir,
+                                                        "assets.stkpack")
+
+    names = collect(data_dir)
+    index = b""
+    with open(output, "wb") as out:
+        out.write(b"\0" * HEADER.size)
+        for name in names:
+            with open(os.path.join(data_dir, name), "rb") as f:
+                content = f.read()
+            stored, method = content, 0
+            if compress and not name.lower().endswith(COMPRESSED):
+                packed = zlib.compress(content, 9)
+                if len(packed) < 0.9 * len(content):
+                    stored, method = packed, 1
+            padding = -out.tell() % ALIGNMENT
+            out.write(b"\0" * padding)
+            offset = out.tell()
+            out.write(stored)
+            encoded = name.encode("utf-8")
+            index += struct.pack("<QQQIH", offset, len(content), len(stored),
+                                 method, len(encoded)) + encoded
+        index_offset = out.tell()
+        out.write(index)
+        out.seek(0)
+        out.write(HEADER.pack(b"STKP", 1, len(names), 0, index_offset,
+                              len(index)))
+    print("Packed %d files into %s" % (len(names), output))
+
+if __name__ == "__main__":
+    main()